@@ -60,6 +60,39 @@ struct EcmpGroup
     std::vector<EcmpMember> members;
 };
 
+/**
+ * @brief Hash of a flow's 5-tuple (host byte order) deciding which ECMP member carries it.
+ *
+ * The Classifier picks SELECT group buckets with the same hash, so a path traced through a
+ * group of equally weighted buckets takes the member selectEcmpMember() returns.
+ */
+inline uint64_t
+ecmpFlowHash(uint32_t srcIp, uint32_t dstIp, uint8_t protocol, uint16_t srcPort, uint16_t dstPort)
+{
+    uint64_t h = (uint64_t(srcIp) << 32) | dstIp;
+    h ^= ((uint64_t(srcPort) << 24) | (uint64_t(dstPort) << 8) | protocol) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief Member of @p group carrying a flow whose ecmpFlowHash() is @p flowHash
+ *        (nullptr if the group has no members).
+ */
+inline const EcmpMember*
+selectEcmpMember(const EcmpGroup& group, uint64_t flowHash)
+{
+    if (group.members.empty())
+    {
+        return nullptr;
+    }
+    return &group.members[flowHash % group.members.size()];
+}
+
 
 inline std::string
 to_string(MemberType t)
@@ -182,6 +215,11 @@ struct EdgeProperties
 {
     bool isUp = true;
     bool isEnabled = true;
+
+    // Slot in TopologyAndFlowMonitor's LinkStatsTable / EdgeFlowTable. The live graph keeps
+    // only the initial values of the counters below and an empty flowSet; graph snapshots
+    // carry the current ones.
+    uint32_t statsId = 0;
     uint64_t leftBandwidth = 0;
     uint64_t linkBandwidth = MININET_INTERFACE_SPEED;
     uint64_t linkBandwidthUsage = 0;
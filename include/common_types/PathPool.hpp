@@ -0,0 +1,468 @@
+#pragma once
+
+#include <array>             // for array
+#include <atomic>            // for atomic
+#include <cstddef>           // for size_t, ptrdiff_t
+#include <cstdint>           // for uint16_t, uint32_t, uint64_t
+#include <iterator>          // for input_iterator_tag
+#include <mutex>             // for mutex, lock_guard
+#include <nlohmann/json.hpp> // for json
+#include <stdexcept>         // for length_error
+#include <unordered_map>     // for unordered_map, unordered_multimap
+#include <utility>           // for pair, exchange, swap
+#include <vector>            // for vector
+
+namespace sflow
+{
+
+/**
+ * @brief End-to-end path represented as (node, interface) hops.
+ *
+ * Each element stores a datapath or host identifier together with the
+ * outgoing interface used at that hop.
+ */
+typedef std::vector<std::pair<uint64_t, uint32_t>> Path;
+
+#define PATH_POOL_CHUNK_SIZE 1024      // path slots allocated at a time
+#define PATH_POOL_MAX_CHUNKS 4096      // at most 4M distinct paths alive at once
+#define PATH_POOL_COMPACT_NODES 65536  // nodes (dpids, host IPs) with a 16-bit index
+
+/**
+ * @brief Process-wide store of distinct paths, shared through refcounted 32-bit ids.
+ *
+ * Thousands of flows follow the same few paths, so each distinct Path is stored once and
+ * referenced by id (0 is the empty path); PathHandle manages the references. A stored path
+ * is immutable while referenced, so reading it takes no lock.
+ *
+ * Hops are packed into 32 bits, a 16-bit node index plus a 16-bit port, when every port
+ * fits and the pool still has room in its node dictionary (the first
+ * PATH_POOL_COMPACT_NODES distinct dpids and host IPs seen). Other paths keep the full
+ * 12-byte hops.
+ *
+ * intern() and the release of a last reference take the pool mutex; retain() and reads are
+ * lock-free.
+ */
+class PathPool
+{
+  public:
+    static PathPool& instance()
+    {
+        static PathPool pool;
+        return pool;
+    }
+
+    PathPool(const PathPool&) = delete;
+    PathPool& operator=(const PathPool&) = delete;
+
+    ~PathPool()
+    {
+        for (auto& chunk : m_chunks)
+        {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Id of @p path, with one reference taken for the caller (0 for an empty path).
+     * @throws std::length_error if PATH_POOL_MAX_CHUNKS would be exceeded.
+     */
+    uint32_t intern(const Path& path)
+    {
+        if (path.empty())
+        {
+            return 0;
+        }
+        const size_t hash = hashPath(path);
+        std::lock_guard lock(m_mutex);
+        auto [first, last] = m_byHash.equal_range(hash);
+        for (auto it = first; it != last; ++it)
+        {
+            Entry& entry = entryAt(it->second);
+            if (equals(entry, path))
+            {
+                entry.refs.fetch_add(1, std::memory_order_relaxed);
+                return it->second;
+            }
+        }
+
+        uint32_t id = allocateNoLock();
+        Entry& entry = entryAt(id);
+        entry.hash = hash;
+        entry.hopCount = static_cast<uint32_t>(path.size());
+        entry.compact.clear();
+        entry.wide.clear();
+        if (!encodeNoLock(path, entry.compact))
+        {
+            entry.compact.clear();
+            entry.wide = path;
+        }
+        entry.refs.store(1, std::memory_order_relaxed);
+        m_byHash.emplace(hash, id);
+        m_live.fetch_add(1, std::memory_order_relaxed);
+        (entry.compact.empty() ? m_wide : m_compact).fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+    /**
+     * @brief Take another reference on @p id (the caller already holds one).
+     */
+    void retain(uint32_t id)
+    {
+        if (id != 0)
+        {
+            entryAt(id).refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Drop a reference on @p id; the path is freed with its last reference.
+     */
+    void release(uint32_t id)
+    {
+        if (id == 0)
+        {
+            return;
+        }
+        Entry& entry = entryAt(id);
+        // Dropping to zero races with intern() reviving the entry, so it happens under the
+        // mutex; other releases need no lock
+        uint32_t refs = entry.refs.load(std::memory_order_relaxed);
+        while (refs > 1)
+        {
+            if (entry.refs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel))
+            {
+                return;
+            }
+        }
+        std::lock_guard lock(m_mutex);
+        if (entry.refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        {
+            return;
+        }
+        auto [first, last] = m_byHash.equal_range(entry.hash);
+        for (auto it = first; it != last; ++it)
+        {
+            if (it->second == id)
+            {
+                m_byHash.erase(it);
+                break;
+            }
+        }
+        m_live.fetch_sub(1, std::memory_order_relaxed);
+        (entry.compact.empty() ? m_wide : m_compact).fetch_sub(1, std::memory_order_relaxed);
+        m_free.push_back(id);
+    }
+
+    size_t size(uint32_t id) const
+    {
+        return id == 0 ? 0 : entryAt(id).hopCount;
+    }
+
+    /// Hash of the hops of @p id (0 for the empty path); unlike the id, it is the same in
+    /// every run for the same path.
+    size_t fingerprint(uint32_t id) const
+    {
+        return id == 0 ? 0 : entryAt(id).hash;
+    }
+
+    /**
+     * @brief Hop @p index of path @p id (which the caller holds a reference on).
+     */
+    std::pair<uint64_t, uint32_t> hop(uint32_t id, size_t index) const
+    {
+        const Entry& entry = entryAt(id);
+        if (entry.compact.empty())
+        {
+            return entry.wide[index];
+        }
+        uint32_t word = entry.compact[index];
+        return {m_nodes[word >> 16], word & 0xFFFFu};
+    }
+
+    /**
+     * @brief {"paths", "compact_paths", "wide_paths", "nodes"}.
+     */
+    nlohmann::json statsJson() const
+    {
+        std::lock_guard lock(m_mutex);
+        return nlohmann::json{{"paths", m_live.load(std::memory_order_relaxed)},
+                              {"compact_paths", m_compact.load(std::memory_order_relaxed)},
+                              {"wide_paths", m_wide.load(std::memory_order_relaxed)},
+                              {"nodes", m_nodeIndex.size()}};
+    }
+
+    /**
+     * @brief Estimated heap bytes of the pool: its slot chunks, the hops of every stored
+     *        path and its indexes.
+     */
+    size_t memoryBytes() const
+    {
+        std::lock_guard lock(m_mutex);
+        const size_t chunks = (m_next + PATH_POOL_CHUNK_SIZE - 1) / PATH_POOL_CHUNK_SIZE;
+        size_t bytes = chunks * PATH_POOL_CHUNK_SIZE * sizeof(Entry);
+        for (uint32_t id = 1; id <= m_next; ++id)
+        {
+            const Entry& entry = entryAt(id);
+            bytes += entry.compact.capacity() * sizeof(uint32_t) +
+                     entry.wide.capacity() * sizeof(Path::value_type);
+        }
+        // Hash nodes carry a next pointer; each bucket is a pointer
+        bytes += m_free.capacity() * sizeof(uint32_t) +
+                 m_byHash.size() * (sizeof(void*) + sizeof(std::pair<size_t, uint32_t>)) +
+                 m_byHash.bucket_count() * sizeof(void*) +
+                 m_nodeIndex.size() * (2 * sizeof(void*) + sizeof(std::pair<uint64_t, uint16_t>)) +
+                 m_nodeIndex.bucket_count() * sizeof(void*);
+        return bytes;
+    }
+
+  private:
+    struct Entry
+    {
+        std::atomic<uint32_t> refs{0};
+        uint32_t hopCount = 0;
+        size_t hash = 0;
+        std::vector<uint32_t> compact; // (node index << 16) | port per hop, if packable
+        Path wide;                     // the hops as given, if not
+    };
+
+    PathPool() = default;
+
+    static size_t hashPath(const Path& path)
+    {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (const auto& [node, port] : path)
+        {
+            h = (h ^ node) * 0x100000001B3ULL;
+            h = (h ^ port) * 0x100000001B3ULL;
+        }
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    Entry& entryAt(uint32_t id) const
+    {
+        const uint32_t slot = id - 1;
+        return m_chunks[slot / PATH_POOL_CHUNK_SIZE].load(
+            std::memory_order_acquire)[slot % PATH_POOL_CHUNK_SIZE];
+    }
+
+    bool equals(const Entry& entry, const Path& path) const
+    {
+        if (entry.hopCount != path.size())
+        {
+            return false;
+        }
+        if (entry.compact.empty())
+        {
+            return entry.wide == path;
+        }
+        for (size_t i = 0; i < path.size(); ++i)
+        {
+            uint32_t word = entry.compact[i];
+            if (m_nodes[word >> 16] != path[i].first || (word & 0xFFFFu) != path[i].second)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Pack @p path into @p out; false if a port or node does not fit (caller holds m_mutex)
+    bool encodeNoLock(const Path& path, std::vector<uint32_t>& out)
+    {
+        out.reserve(path.size());
+        for (const auto& [node, port] : path)
+        {
+            if (port > 0xFFFFu)
+            {
+                return false;
+            }
+            auto it = m_nodeIndex.find(node);
+            if (it == m_nodeIndex.end())
+            {
+                if (m_nodeIndex.size() >= PATH_POOL_COMPACT_NODES)
+                {
+                    return false;
+                }
+                uint16_t index = static_cast<uint16_t>(m_nodeIndex.size());
+                m_nodes[index] = node;
+                it = m_nodeIndex.emplace(node, index).first;
+            }
+            out.push_back((uint32_t(it->second) << 16) | port);
+        }
+        return true;
+    }
+
+    // Caller holds m_mutex
+    uint32_t allocateNoLock()
+    {
+        if (!m_free.empty())
+        {
+            uint32_t id = m_free.back();
+            m_free.pop_back();
+            return id;
+        }
+        const uint32_t slot = m_next;
+        const size_t chunk = slot / PATH_POOL_CHUNK_SIZE;
+        if (chunk >= PATH_POOL_MAX_CHUNKS)
+        {
+            throw std::length_error("PathPool full");
+        }
+        if (slot % PATH_POOL_CHUNK_SIZE == 0)
+        {
+            m_chunks[chunk].store(new Entry[PATH_POOL_CHUNK_SIZE], std::memory_order_release);
+        }
+        ++m_next;
+        return slot + 1;
+    }
+
+    mutable std::mutex m_mutex;
+    std::array<std::atomic<Entry*>, PATH_POOL_MAX_CHUNKS> m_chunks{};
+    uint32_t m_next = 0;          // slots handed out so far
+    std::vector<uint32_t> m_free; // ids of freed slots
+    std::unordered_multimap<size_t, uint32_t> m_byHash;
+    // Node dictionary of the packed hops; entries are only ever appended
+    std::unordered_map<uint64_t, uint16_t> m_nodeIndex;
+    std::array<uint64_t, PATH_POOL_COMPACT_NODES> m_nodes{};
+    std::atomic<size_t> m_live{0};
+    std::atomic<size_t> m_compact{0};
+    std::atomic<size_t> m_wide{0};
+};
+
+/**
+ * @brief Shared, immutable reference to a path in the PathPool (4 bytes).
+ *
+ * Copying a handle takes a reference instead of copying the hops. Two handles are equal
+ * exactly when their paths are, because the pool stores each distinct path once.
+ * Iterating yields the hops as (node, interface) pairs by value.
+ */
+class PathHandle
+{
+  public:
+    class const_iterator
+    {
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<uint64_t, uint32_t>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        const_iterator() = default;
+        const_iterator(uint32_t id, size_t index)
+            : m_id(id),
+              m_index(index)
+        {
+        }
+
+        value_type operator*() const
+        {
+            return PathPool::instance().hop(m_id, m_index);
+        }
+
+        const_iterator& operator++()
+        {
+            ++m_index;
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator old = *this;
+            ++m_index;
+            return old;
+        }
+
+        bool operator==(const const_iterator& o) const = default;
+
+      private:
+        uint32_t m_id = 0;
+        size_t m_index = 0;
+    };
+
+    PathHandle() = default;
+
+    explicit PathHandle(const Path& path)
+        : m_id(PathPool::instance().intern(path))
+    {
+    }
+
+    PathHandle(const PathHandle& o)
+        : m_id(o.m_id)
+    {
+        PathPool::instance().retain(m_id);
+    }
+
+    PathHandle(PathHandle&& o) noexcept
+        : m_id(std::exchange(o.m_id, 0))
+    {
+    }
+
+    PathHandle& operator=(PathHandle o) noexcept
+    {
+        std::swap(m_id, o.m_id);
+        return *this;
+    }
+
+    ~PathHandle()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        PathPool::instance().release(std::exchange(m_id, 0));
+    }
+
+    bool empty() const
+    {
+        return m_id == 0;
+    }
+
+    size_t size() const
+    {
+        return PathPool::instance().size(m_id);
+    }
+
+    uint32_t id() const
+    {
+        return m_id;
+    }
+
+    size_t fingerprint() const
+    {
+        return PathPool::instance().fingerprint(m_id);
+    }
+
+    std::pair<uint64_t, uint32_t> operator[](size_t index) const
+    {
+        return PathPool::instance().hop(m_id, index);
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(m_id, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(m_id, size());
+    }
+
+    /**
+     * @brief Copy of the hops.
+     */
+    Path path() const
+    {
+        return Path(begin(), end());
+    }
+
+    bool operator==(const PathHandle& o) const
+    {
+        return m_id == o.m_id;
+    }
+
+  private:
+    uint32_t m_id = 0;
+};
+
+} // namespace sflow
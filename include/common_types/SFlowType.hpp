@@ -1,5 +1,10 @@
 #pragma once
 
+#include "common_types/PathPool.hpp"
+#include "utils/Hash.hpp"
+#include "utils/SmallFlatMap.hpp"
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstdint>
 #include <map>
@@ -58,14 +63,6 @@ struct AgentKey
     }
 };
 
-/**
- * @brief End-to-end path represented as (node, interface) hops.
- *
- * Each element stores a datapath or host identifier together with the
- * outgoing interface used at that hop.
- */
-typedef std::vector<std::pair<uint64_t, uint32_t>> Path;
-
 /**
  * @brief Minimal sFlow sample data used for rate calculations.
  *
@@ -103,7 +100,8 @@ class AutoRefreshQueue
     {
         m_queue.push_back(sample);
         m_sum += sample.packetFrameLengthInByte;
-        refresh();
+        // The sample's receive time stands for now, saving a clock read per sample
+        refresh(sample.timestampInMilliseconds);
     }
 
     /**
@@ -114,10 +112,26 @@ class AutoRefreshQueue
      */
     uint64_t getSum()
     {
-        refresh();
+        refresh(duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
         return m_sum;
     }
 
+    /**
+     * @brief Same sum without pruning: stale samples are skipped rather than removed, so
+     *        readers holding only a shared lock can call it.
+     */
+    uint64_t getSum() const
+    {
+        uint64_t sum = m_sum;
+        for (auto it = m_queue.begin(), live = firstLive(); it != live; ++it)
+        {
+            sum -= it->packetFrameLengthInByte;
+        }
+        return sum;
+    }
+
     /**
      * @brief Clears all samples and resets the accumulated sum.
      */
@@ -132,21 +146,28 @@ class AutoRefreshQueue
      */
     size_t size() const
     {
-        return m_queue.size();
+        return static_cast<size_t>(m_queue.end() - firstLive());
     }
 
   private:
+    std::deque<ExtractedSFlowData>::const_iterator firstLive() const
+    {
+        const int64_t now = duration_cast<std::chrono::milliseconds>(
+                                std::chrono::steady_clock::now().time_since_epoch())
+                                .count();
+        return std::find_if(m_queue.begin(), m_queue.end(), [&](const ExtractedSFlowData& s) {
+            return now - s.timestampInMilliseconds <= m_interval;
+        });
+    }
+
     /**
      * @brief Removes samples older than the configured interval.
      *
-     * Compares each sample timestamp against the current time and drops
+     * Compares each sample timestamp against @p now (steady clock, ms) and drops
      * those that fall outside the time window, updating the running sum.
      */
-    void refresh()
+    void refresh(int64_t now)
     {
-        int64_t now = duration_cast<std::chrono::milliseconds>(
-                          std::chrono::steady_clock::now().time_since_epoch())
-                          .count();
         while (!m_queue.empty() && now - m_queue.front().timestampInMilliseconds > m_interval)
         {
             m_sum -= m_queue.front().packetFrameLengthInByte;
@@ -159,6 +180,109 @@ class AutoRefreshQueue
     uint64_t m_sum;
 };
 
+/**
+ * @brief Fixed-bucket time wheel over packet samples.
+ *
+ * Drop-in alternative to AutoRefreshQueue: the window is split into BUCKETS slots of
+ * (interval / BUCKETS) ms, each holding a byte and packet count. push() only touches the
+ * slot of the sample's timestamp, and getSum()/size() add up the slots still inside the
+ * window, so both are O(BUCKETS) with no heap allocation regardless of the packet rate.
+ *
+ * The window edge is rounded to the slot width (100 ms for TIME_UNIT_INTERVAL).
+ */
+class TimeWheelRateCounter
+{
+  public:
+    static constexpr size_t BUCKETS = 10;
+
+    explicit TimeWheelRateCounter(int64_t interval = TIME_UNIT_INTERVAL)
+        : m_slotWidth(std::max<int64_t>(1, interval / static_cast<int64_t>(BUCKETS)))
+    {
+    }
+
+    /**
+     * @brief Adds a sample to the slot of its timestamp, recycling the slot if it is stale.
+     */
+    void push(const ExtractedSFlowData& sample)
+    {
+        int64_t slot = sample.timestampInMilliseconds / m_slotWidth;
+        Bucket& b = m_buckets[static_cast<size_t>(slot) % BUCKETS];
+        if (b.slot != slot)
+        {
+            b = Bucket{slot, 0, 0};
+        }
+        b.bytes += sample.packetFrameLengthInByte;
+        b.packets += 1;
+    }
+
+    /**
+     * @brief Returns the sum of packet lengths in the current window.
+     */
+    uint64_t getSum() const
+    {
+        uint64_t sum = 0;
+        forEachLiveBucket([&](const Bucket& b) { sum += b.bytes; });
+        return sum;
+    }
+
+    /**
+     * @brief Clears all samples and resets the accumulated sum.
+     */
+    void clear()
+    {
+        m_buckets.fill(Bucket{});
+    }
+
+    /**
+     * @brief Returns how many samples are currently in the window.
+     */
+    size_t size() const
+    {
+        size_t packets = 0;
+        forEachLiveBucket([&](const Bucket& b) { packets += b.packets; });
+        return packets;
+    }
+
+  private:
+    struct Bucket
+    {
+        int64_t slot = -1;
+        uint64_t bytes = 0;
+        uint32_t packets = 0;
+    };
+
+    template <typename Fn>
+    void forEachLiveBucket(Fn&& fn) const
+    {
+        int64_t now = duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count();
+        int64_t nowSlot = now / m_slotWidth;
+        for (const auto& b : m_buckets)
+        {
+            if (b.slot >= 0 && b.slot <= nowSlot && nowSlot - b.slot < int64_t(BUCKETS))
+            {
+                fn(b);
+            }
+        }
+    }
+
+    std::array<Bucket, BUCKETS> m_buckets{};
+    int64_t m_slotWidth;
+};
+
+/**
+ * @brief Window implementation used by FlowStats::packetQueue.
+ *
+ * The time wheel is the default; configure with -DNDT_PACKET_QUEUE_DEQUE=ON to fall back to
+ * the exact, per-sample AutoRefreshQueue.
+ */
+#ifdef NDT_PACKET_QUEUE_DEQUE
+using PacketRateWindow = AutoRefreshQueue;
+#else
+using PacketRateWindow = TimeWheelRateCounter;
+#endif
+
 /**
  * @brief Per-flow traffic counters and derived rates.
  *
@@ -179,7 +303,25 @@ struct FlowStats
     uint64_t avgByteRateInBps = 0;
     uint64_t avgPacketRate = 0;
     uint32_t samplingRate = 1;
-    AutoRefreshQueue packetQueue;
+    PacketRateWindow packetQueue;
+};
+
+/**
+ * @brief Per-agent statistics of one flow.
+ *
+ * Most flows are observed by only a few agents, so the first AGENT_STATS_INLINE entries
+ * live inside FlowInfo and need no allocation; further agents spill into a vector.
+ */
+constexpr size_t AGENT_STATS_INLINE = 4;
+using AgentFlowStatsMap = utils::SmallFlatMap<AgentKey, FlowStats, AGENT_STATS_INLINE>;
+
+/**
+ * @brief Sending rate of a flow over the last TIME_UNIT_INTERVAL (FlowInfo::immediateRate()).
+ */
+struct ImmediateRate
+{
+    uint64_t bps = 0;
+    uint64_t pps = 0;
 };
 
 /**
@@ -196,7 +338,7 @@ struct FlowInfo
      * The key identifies the sFlow agent and interface; the value
      * describes counters and computed rates for that agent.
      */
-    std::map<AgentKey, FlowStats> agentFlowStats;
+    AgentFlowStatsMap agentFlowStats;
     uint64_t estimatedFlowSendingRatePeriodically = 0;
     uint64_t estimatedFlowSendingRateImmediately = 0;
     uint64_t estimatedPacketSendingRatePeriodically = 0;
@@ -207,30 +349,109 @@ struct FlowInfo
     bool isElephantFlowImmediately = false;
     bool isAck = false;
     bool isPureAck = false;
-    Path flowPath;
-};
+    // Pure ACKs of the opposite direction merged into this TCP flow (bidirectional mode),
+    // scaled by the sampling rate like the rates
+    uint64_t reverseAckBytes = 0;
+    uint64_t reverseAckPackets = 0;
+    // Interned in the PathPool: flows on the same path share one copy of its hops
+    PathHandle flowPath;
+    // Set while the flow is queued for the next periodic rate estimation (collector internal)
+    bool pendingRateUpdate = false;
+    // Collector flow version when this entry last changed, for delta queries (collector internal)
+    uint64_t changedVersion = 0;
+    // Classifier rules version flowPath was resolved against (collector internal)
+    uint64_t pathVersion = 0;
+    // 5-tuple of the sample that created the entry; the path of an aggregated flow is that
+    // of this one (collector internal)
+    FlowKey sampleKey{};
+    // Agent of flowPath's first switch, 0 while unknown (collector internal)
+    uint32_t firstHopAgent = 0;
+    // Set while the flow is queued for touching the links of its path (collector internal)
+    bool pathTouchPending = false;
+    // Set once ElephantFlowDetected was published, cleared with ElephantFlowEnded; unlike
+    // isElephantFlowPeriodically it follows the hysteresis band (collector internal)
+    bool elephantAnnounced = false;
 
-template <typename T>
-inline void
-hashCombine(std::size_t& seed, const T& val)
-{
-    seed ^= std::hash<T>{}(val) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-}
+    /**
+     * @brief Rate from the agents' packetQueue windows, scaled by their sampling rates and
+     *        averaged over the agents that sampled the flow within the window; zero without
+     *        any. Only reads the windows, so a shared lock on the flow's shard suffices.
+     */
+    ImmediateRate immediateRate() const
+    {
+        uint64_t bytes = 0;
+        uint64_t packets = 0;
+        uint64_t hops = 0;
+        for (const auto& [agent, stats] : agentFlowStats)
+        {
+            const uint64_t samples = stats.packetQueue.size();
+            if (samples == 0)
+            {
+                continue;
+            }
+            const uint64_t samplingRate = stats.samplingRate > 0 ? stats.samplingRate : 1;
+            bytes += stats.packetQueue.getSum() * samplingRate;
+            packets += samples * samplingRate;
+            ++hops;
+        }
+        if (hops == 0)
+        {
+            return {};
+        }
+        return {bytes * 8 / hops, packets / hops};
+    }
 
-struct FlowKeyHash
+    /**
+     * @brief Return to the default state but keep heap capacity (agent overflow), so a
+     *        recycled FlowInfo can be handed to a new flow without reallocating.
+     */
+    void reset()
+    {
+        agentFlowStats.clear();
+        estimatedFlowSendingRatePeriodically = 0;
+        estimatedFlowSendingRateImmediately = 0;
+        estimatedPacketSendingRatePeriodically = 0;
+        estimatedPacketSendingRateImmediately = 0;
+        startTime = 0;
+        endTime = 0;
+        isElephantFlowPeriodically = false;
+        isElephantFlowImmediately = false;
+        isAck = false;
+        isPureAck = false;
+        reverseAckBytes = 0;
+        reverseAckPackets = 0;
+        flowPath.reset();
+        pendingRateUpdate = false;
+        changedVersion = 0;
+        pathVersion = 0;
+        sampleKey = {};
+        firstHopAgent = 0;
+        pathTouchPending = false;
+        elephantAnnounced = false;
+    }
+};
+
+/**
+ * @brief Hash of the FlowKey 5-tuple, packed into two words for @p Policy.
+ *
+ * Every output bit depends on every input bit, so the same hash serves the flow shards
+ * (low bits), the open-addressing flow table (high bits as control tags) and the
+ * admission sketch.
+ */
+template <typename Policy = utils::DefaultHashPolicy>
+struct BasicFlowKeyHash
 {
-    std::size_t operator()(const FlowKey& key) const
+    std::size_t operator()(const FlowKey& key) const noexcept
     {
-        std::size_t seed = 0;
-        hashCombine(seed, key.srcIP);
-        hashCombine(seed, key.dstIP);
-        hashCombine(seed, key.srcPort);
-        hashCombine(seed, key.dstPort);
-        hashCombine(seed, key.protocol);
-        return seed;
+        return utils::hashWords<Policy>(
+            {(uint64_t(key.srcIP) << 32) | key.dstIP,
+             (uint64_t(key.srcPort) << 24) | (uint64_t(key.dstPort) << 8) | key.protocol});
     }
 };
 
+using FlowKeyHash = BasicFlowKeyHash<>;
+using FlowKeyMixHash = FlowKeyHash; // the name the flow table and admission sketch use
+
 /**
  * @brief Cached counter state for a single link.
  *
@@ -289,14 +510,8 @@ struct KeyHash
 {
     size_t operator()(const Key& k) const noexcept
     {
-        auto h1 = std::hash<uint32_t>{}(std::get<0>(k));
-        auto h2 = std::hash<uint32_t>{}(std::get<1>(k));
-        auto h3 = std::hash<uint32_t>{}(std::get<2>(k));
-        // simple hash-combine
-        size_t h = h1;
-        h ^= h2 + 0x9e3779b9 + (h << 6) + (h >> 2);
-        h ^= h3 + 0x9e3779b9 + (h << 6) + (h >> 2);
-        return h;
+        return utils::hashWords(
+            {(uint64_t(std::get<0>(k)) << 32) | std::get<1>(k), std::get<2>(k)});
     }
 };
 
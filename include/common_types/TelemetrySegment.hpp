@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm> // for min
+#include <atomic>    // for atomic, atomic_thread_fence
+#include <cstdint>   // for uint8_t, uint16_t, uint32_t, uint64_t, int64_t
+#include <cstring>   // for memcmp, memcpy
+#include <optional>  // for optional
+#include <utility>   // for exchange, swap
+#include <vector>    // for vector
+
+#include <fcntl.h>    // for O_RDONLY
+#include <sys/mman.h> // for mmap, munmap, shm_open
+#include <sys/stat.h> // for fstat
+#include <unistd.h>   // for close
+
+#define TELEMETRY_SEGMENT_NAME "/ndt_telemetry" // shm_open name, i.e. /dev/shm/ndt_telemetry
+
+/**
+ * @brief Layout of the shared-memory telemetry segment, and a header-only reader for it.
+ *
+ * Started with `--telemetry-shm`, NDT keeps link counters, the fastest flows and the traffic
+ * matrix in a POSIX shared-memory object that it rewrites at every rate tick. Applications on
+ * the same host map it read-only with Reader and copy what they need without a syscall or any
+ * parsing; this header depends only on the standard library and POSIX, so they can include it
+ * on its own.
+ *
+ * The segment is one Segment struct: a header and three fixed-capacity sections. Each section
+ * is guarded by its own sequence lock: the writer makes @c seq odd, rewrites the records and
+ * makes it even again, and a reader retries a copy during which @c seq was odd or changed.
+ * Integers are in the byte order of the host; IPv4 addresses in network order as everywhere
+ * in NDT. LAYOUT_VERSION changes with any change to these structs.
+ */
+namespace telemetry
+{
+
+inline constexpr char MAGIC[4] = {'N', 'D', 'T', 'M'};
+inline constexpr uint16_t LAYOUT_VERSION = 1;
+
+inline constexpr uint32_t MAX_LINKS = 4096;
+inline constexpr uint32_t MAX_TOP_FLOWS = 64;
+inline constexpr uint32_t MAX_MATRIX_CELLS = 65536;
+
+enum : uint32_t
+{
+    LINK_UP = 1,
+};
+
+struct LinkRecord
+{
+    uint64_t srcDpid;
+    uint64_t dstDpid;
+    uint32_t srcInterface;
+    uint32_t dstInterface;
+    uint64_t linkBandwidth;      // bps
+    uint64_t linkBandwidthUsage; // bps
+    uint64_t leftBandwidth;      // bps; from flow samples in Mininet mode
+    double utilization;          // percent
+    uint32_t flowCount;
+    uint32_t flags; // LINK_*
+};
+
+struct FlowRecord
+{
+    uint32_t srcIp;
+    uint32_t dstIp;
+    uint16_t srcPort;
+    uint16_t dstPort;
+    uint8_t protocol;
+    uint8_t reserved[3];
+    uint64_t rateBps; // estimatedFlowSendingRateImmediately
+};
+
+struct MatrixCell
+{
+    uint32_t srcIp;
+    uint32_t dstIp;
+    uint64_t bps; // sum of the periodic rates of the flows from srcIp to dstIp
+};
+
+template <typename Record, uint32_t Capacity>
+struct Section
+{
+    std::atomic<uint64_t> seq; // odd while the writer is rewriting the section
+    uint64_t version;          // publications of this section so far
+    int64_t updatedAtMs;       // Unix time of the latest one
+    uint32_t count;            // records[0, count) are valid
+    uint32_t dropped;          // records past Capacity left out of the latest one
+    Record records[Capacity];
+};
+
+using LinkSection = Section<LinkRecord, MAX_LINKS>;          // every directed link
+using FlowSection = Section<FlowRecord, MAX_TOP_FLOWS>;      // fastest flows, fastest first
+using MatrixSection = Section<MatrixCell, MAX_MATRIX_CELLS>; // non-zero cells
+
+struct Segment
+{
+    char magic[4]; // MAGIC, written last when the segment is created
+    uint16_t layoutVersion;
+    uint16_t reserved;
+    uint32_t segmentSize; // sizeof(Segment)
+    uint32_t writerPid;
+    alignas(64) LinkSection links;
+    alignas(64) FlowSection topFlows;
+    alignas(64) MatrixSection matrix;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(sizeof(LinkRecord) == 64 && sizeof(FlowRecord) == 24 && sizeof(MatrixCell) == 16);
+
+/**
+ * @brief Read-only mapping of the telemetry segment.
+ *
+ * Reading a section copies it into a caller-owned vector whose capacity is kept across
+ * reads, so a poll loop does no syscalls and, after the first read, no allocations. A
+ * mapping stays valid after NDT exits; check updatedAtMs to tell stale data. Not
+ * thread-safe: use one Reader per thread.
+ */
+class Reader
+{
+  public:
+    /// Map the segment @p name; nullopt if it does not exist or has another layout.
+    static std::optional<Reader> open(const char* name = TELEMETRY_SEGMENT_NAME)
+    {
+        const int fd = ::shm_open(name, O_RDONLY, 0);
+        if (fd < 0)
+        {
+            return std::nullopt;
+        }
+        struct stat st{};
+        void* mapping = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Segment))
+        {
+            mapping = ::mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            return std::nullopt;
+        }
+        Reader reader(static_cast<const Segment*>(mapping));
+        const Segment& s = *reader.m_segment;
+        if (std::memcmp(s.magic, MAGIC, sizeof(MAGIC)) != 0 || s.layoutVersion != LAYOUT_VERSION ||
+            s.segmentSize != sizeof(Segment))
+        {
+            return std::nullopt;
+        }
+        return reader;
+    }
+
+    Reader(Reader&& other) noexcept
+        : m_segment(std::exchange(other.m_segment, nullptr))
+    {
+    }
+
+    Reader& operator=(Reader&& other) noexcept
+    {
+        std::swap(m_segment, other.m_segment);
+        return *this;
+    }
+
+    ~Reader()
+    {
+        if (m_segment)
+        {
+            ::munmap(const_cast<Segment*>(m_segment), sizeof(Segment));
+        }
+    }
+
+    const Segment& segment() const
+    {
+        return *m_segment;
+    }
+
+    /// Copy the links into @p out; false if the writer kept the section busy for too long.
+    bool links(std::vector<LinkRecord>& out, uint64_t* version = nullptr) const
+    {
+        return read(m_segment->links, out, version);
+    }
+
+    bool topFlows(std::vector<FlowRecord>& out, uint64_t* version = nullptr) const
+    {
+        return read(m_segment->topFlows, out, version);
+    }
+
+    bool matrix(std::vector<MatrixCell>& out, uint64_t* version = nullptr) const
+    {
+        return read(m_segment->matrix, out, version);
+    }
+
+    /// Cheap change check, e.g. on segment().links: it moves with every publication.
+    template <typename Record, uint32_t Capacity>
+    static uint64_t sequence(const Section<Record, Capacity>& section)
+    {
+        return section.seq.load(std::memory_order_acquire);
+    }
+
+  private:
+    static constexpr int MAX_ATTEMPTS = 64;
+
+    explicit Reader(const Segment* segment)
+        : m_segment(segment)
+    {
+    }
+
+    template <typename Record, uint32_t Capacity>
+    static bool read(const Section<Record, Capacity>& section,
+                     std::vector<Record>& out,
+                     uint64_t* version)
+    {
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt)
+        {
+            const uint64_t before = section.seq.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                continue;
+            }
+            const uint32_t count = std::min(section.count, Capacity);
+            out.resize(count);
+            std::memcpy(out.data(), section.records, count * sizeof(Record));
+            const uint64_t published = section.version;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (section.seq.load(std::memory_order_relaxed) == before)
+            {
+                if (version)
+                {
+                    *version = published;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const Segment* m_segment;
+};
+
+} // namespace telemetry
@@ -1,12 +1,40 @@
 #pragma once
 
-#include <any>           // for any
-#include <functional>    // for function
-#include <mutex>         // for unique_lock
-#include <shared_mutex>  // for shared_lock, shared_mutex
-#include <unordered_map> // for unordered_map, operator==, _Node_const_iter...
-#include <utility>       // for move, pair
-#include <vector>        // for vector
+#include "utils/FlightRecorder.hpp" // for FlightRecorder
+#include "utils/MpmcQueue.hpp"      // for MpmcQueue
+#include "utils/Tracing.hpp"        // for Tracer
+#include <algorithm>                // for min
+#include <any>                      // for any
+#include <array>                    // for array
+#include <atomic>                   // for atomic
+#include <chrono>                   // for steady_clock, milliseconds
+#include <condition_variable>       // for condition_variable
+#include <deque>                    // for deque
+#include <cstdint>                  // for uint64_t
+#include <exception>                // for exception
+#include <functional>               // for function
+#include <map>                      // for map
+#include <memory>                   // for shared_ptr, unique_ptr
+#include <mutex>                    // for mutex
+#include <nlohmann/json.hpp>        // for json
+#include <optional>                 // for optional
+#include <thread>                   // for thread
+#include <type_traits>              // for is_same_v, invoke_result_t
+#include <typeindex>                // for type_index
+#include <unordered_map>            // for unordered_map, operator==, _Node_const_iter...
+#include <utility>                  // for move, pair
+#include <vector>                   // for vector
+
+#define EVENT_BUS_WORKERS 2            // default threads running the handlers
+#define EVENT_BUS_QUEUE_CAPACITY 4096  // events queued per channel and per worker
+#define EVENT_BUS_COALESCE_MS 5        // default window merging LinkStateChanged events
+
+namespace utils
+{
+class Counter;
+class Gauge;
+class Histogram;
+} // namespace utils
 
 // Define supported event types
 enum class EventType
@@ -18,9 +46,19 @@ enum class EventType
     LinkRecoveryDetected, // 4. A link recovery has been detected in the topology (triggered by Ryu
                           // request)
     SwitchEntered,
-    SwitchExited
+    SwitchExited,
+    LinkStateChanged,      // Edges that went down or up, merged over the coalescing window
+    IdleFlowsPurged,       // All the flows one expiry pass removed
+    LinkCongestionChanged, // Edges whose utilisation crossed CONGESTION_HOTSPOT_PERCENT
+    ElephantFlowDetected,  // Flows whose periodic rate reached MICE_FLOW_UNDER_THRESHOLD
+    ElephantFlowEnded      // Elephant flows whose rate fell below the hysteresis band
 };
 
+inline constexpr size_t EVENT_TYPE_COUNT = 11;
+
+/// "flow_added", "link_failure_detected", ... as used in stats and metric labels.
+const char* eventTypeName(EventType type);
+
 // Event structure containing type and payload
 struct Event
 {
@@ -28,33 +66,596 @@ struct Event
     std::any payload; // Can hold any payload data, e.g., PacketInPayload
 };
 
+/// What a full EventBus channel does with one more event.
+enum class OverflowPolicy : uint8_t
+{
+    Block,      // the publisher waits for room
+    DropOldest, // the oldest queued event is dropped
+    LatestByKey // a queued event with the same key is replaced; a new key drops the oldest
+};
+
+/// A payload that channels can coalesce: merge() folds a later payload into this one.
+template <typename Payload>
+concept MergeablePayload = requires(Payload& into, Payload&& next) {
+    into.merge(std::move(next));
+};
+
+/**
+ * @brief Publish/subscribe bus between the NDT components and the routing apps.
+ *
+ * Events are published on channels. channel<Payload>(type) is the typed channel of @p type:
+ * its handlers take a const Payload&, and publish() moves the payload into one of the
+ * channel's pooled slots (a lock-free MPMC queue), so an event costs no allocation, no
+ * std::any and no RTTI. Look a channel up once and keep the reference; it lives as long as
+ * the bus. The untyped API (registerHandler() / emit() with an Event) is a channel of Events
+ * per type; handlers registered with it also see the events of the typed channels of their
+ * type, as an Event whose payload is a copy (made only when such a handler exists).
+ *
+ * Publishing queues the event and returns; a pool of worker threads runs the handlers.
+ * Events whose order matters to each other share a worker and run in publish order: link
+ * failures and recoveries, switches entering and exiting, and flow additions and purges each
+ * form one such group. With zero workers publishing runs the handlers on the caller's
+ * thread, as emitSync() always does.
+ *
+ * A channel of a MergeablePayload can coalesce: once coalesce() set a window, the first
+ * publish opens it and the payloads published until it closes are merged into that one, which
+ * is then queued as a single event. A flapping link thus costs its handlers one call per
+ * window rather than one per change; the price is up to a window of latency.
+ *
+ * Each channel holds up to its capacity (EVENT_BUS_QUEUE_CAPACITY at most) of queued events, and
+ * each worker EVENT_BUS_QUEUE_CAPACITY pending deliveries. What a full channel does is its
+ * OverflowPolicy. Block, the default, makes publishing wait for room (from a handler of that
+ * worker, by running the oldest pending delivery in place), so nothing is lost but a slow
+ * handler slows the publishers down. DropOldest and LatestByKey never wait: they give up the
+ * oldest events, or keep only the latest event per key (a FlowKey, an edge), so an event storm
+ * costs bounded memory and the handlers see the freshest state. A channel with either of
+ * these has at most one delivery pending at its worker at a time, so under load its events
+ * take turns with the other events of the worker rather than keeping strict publish order
+ * with them. Queue depth, drops and merges are exported per event type.
+ *
+ * Handlers are called without any lock held, so a handler may subscribe more handlers or
+ * publish events. An exception thrown by a handler run by a worker is logged and dropped. The
+ * time events wait for a worker and the time their handlers take are recorded per event type.
+ */
 class EventBus
 {
   public:
     using Handler = std::function<void(const Event&)>;
 
+    /// What the workers see of a channel.
+    class ChannelBase
+    {
+      public:
+        virtual ~ChannelBase() = default;
+
+        ChannelBase(const ChannelBase&) = delete;
+        ChannelBase& operator=(const ChannelBase&) = delete;
+
+      protected:
+        friend class EventBus;
+
+        ChannelBase(EventBus& bus, EventType type);
+
+        // Deliver the oldest queued payload (on the channel's worker)
+        virtual void runOne() = 0;
+        // Queue the payload merged over the coalescing window that just closed
+        virtual void flush() = 0;
+
+        EventBus& m_bus;
+        const EventType m_type;
+        const size_t m_worker; // index into m_bus.m_workers, when there are workers
+    };
+
+    /// Typed events of one EventType, see EventBus.
+    template <typename Payload>
+    class Channel : public ChannelBase
+    {
+      public:
+        using Handler = std::function<void(const Payload&)>;
+
+        void subscribe(Handler handler);
+
+        /// Queue @p payload for the handlers, or merge it into the coalescing window.
+        void publish(Payload payload);
+
+        /// Merge the payloads published within @p window of each other into one event;
+        /// zero turns coalescing off. Without workers, payloads are never held back.
+        void coalesce(std::chrono::milliseconds window);
+
+        /// Hold at most @p capacity queued events (EVENT_BUS_QUEUE_CAPACITY at most) before the
+        /// overflow policy applies.
+        void setCapacity(size_t capacity);
+
+        /// Drop the oldest queued event when full rather than wait. Call before publishing.
+        void dropOldest();
+
+        /// Queue only the latest payload per @p key(payload), e.g. per FlowKey or edge; when
+        /// there are capacity keys queued already, a new key drops the oldest. The key type
+        /// needs std::hash. Call before publishing.
+        template <typename KeyFn>
+        void keepLatestBy(KeyFn key);
+
+      private:
+        friend class EventBus;
+
+        // Queued payloads of LatestByKey, oldest key first
+        struct KeyedSlots
+        {
+            virtual ~KeyedSlots() = default;
+            // False if @p payload replaced one queued with the same key
+            virtual bool put(Payload&& payload) = 0;
+            virtual bool take(Payload& out) = 0;
+            virtual size_t size() const = 0;
+        };
+
+        template <typename Key>
+        struct KeyedSlotsFor : KeyedSlots
+        {
+            explicit KeyedSlotsFor(std::function<Key(const Payload&)> keyOf)
+                : key(std::move(keyOf))
+            {
+            }
+
+            bool put(Payload&& payload) override
+            {
+                Key k = key(payload);
+                auto [it, inserted] = latest.insert_or_assign(k, std::move(payload));
+                if (inserted)
+                {
+                    order.push_back(std::move(k));
+                }
+                return inserted;
+            }
+
+            bool take(Payload& out) override
+            {
+                if (order.empty())
+                {
+                    return false;
+                }
+                auto it = latest.find(order.front());
+                out = std::move(it->second);
+                latest.erase(it);
+                order.pop_front();
+                return true;
+            }
+
+            size_t size() const override
+            {
+                return order.size();
+            }
+
+            std::function<Key(const Payload&)> key;
+            std::unordered_map<Key, Payload> latest;
+            std::deque<Key> order;
+        };
+
+        Channel(EventBus& bus, EventType type);
+
+        void enqueue(Payload&& payload);
+        // Have one delivery pending at the worker (lossy policies)
+        void scheduleOnce();
+        bool takeOne(Payload& out);
+        void runOne() override;
+        void flush() override;
+        // Events queued and not delivered yet
+        size_t queued();
+        // Run the handlers on @p payload, timing them; @p rethrow lets their exceptions through
+        void deliver(const Payload& payload, bool rethrow);
+        std::shared_ptr<const std::vector<Handler>> handlers() const;
+
+        utils::MpmcQueue<Payload> m_slots;
+        mutable std::mutex m_handlersMutex; // guards the m_handlers pointer only
+        std::shared_ptr<const std::vector<Handler>> m_handlers;
+
+        std::atomic<int64_t> m_windowMs{0};
+        std::mutex m_pendingMutex;
+        std::optional<Payload> m_pending; // merged payload of the open window
+
+        std::atomic<size_t> m_capacity{EVENT_BUS_QUEUE_CAPACITY};
+        std::atomic<OverflowPolicy> m_policy{OverflowPolicy::Block};
+        std::atomic<int64_t> m_depth{0};      // payloads queued, in m_slots or m_keyed
+        std::atomic<bool> m_scheduled{false}; // a delivery is pending at the worker
+        std::mutex m_keyedMutex;
+        std::unique_ptr<KeyedSlots> m_keyed; // of LatestByKey
+    };
+
+    explicit EventBus(unsigned workers = EVENT_BUS_WORKERS);
+    /// Runs the events still queued, then stops the workers.
+    ~EventBus();
+
+    EventBus(const EventBus&) = delete;
+    EventBus& operator=(const EventBus&) = delete;
+
+    /// The typed channel of @p type carrying @p Payload, created on first use.
+    template <typename Payload>
+    Channel<Payload>& channel(EventType type);
+
     // Register a handler for a specific event type
-    void registerHandler(EventType type, Handler handler)
+    void registerHandler(EventType type, Handler handler);
+
+    /// Queue @p event for the workers.
+    void emit(Event event);
+
+    /// Run the handlers of @p event on the caller's thread before returning; their
+    /// exceptions propagate.
+    void emitSync(const Event& event);
+
+    /// Per event type: {"emitted", "coalesced", "queued", "dropped", "merged", "handled",
+    /// "handler_errors", "mean_handler_ms", "max_handler_ms"}, and "workers" with the
+    /// deliveries pending at each.
+    nlohmann::json statsJson() const;
+
+  private:
+    using HandlerMap = std::unordered_map<EventType, std::vector<Handler>>;
+
+    // A delivery pending at a worker: run the oldest payload of @c channel
+    struct Task
+    {
+        ChannelBase* channel = nullptr;
+        std::chrono::steady_clock::time_point emittedAt;
+    };
+
+    struct Worker
+    {
+        explicit Worker(size_t capacity)
+            : queue(capacity)
+        {
+        }
+
+        utils::MpmcQueue<Task> queue;
+        std::atomic<uint64_t> signal{0}; // bumped after each push, waited on when idle
+        std::thread thread;
+    };
+
+    struct TypeStats
+    {
+        std::atomic<uint64_t> emitted{0};
+        std::atomic<uint64_t> coalesced{0}; // merged into an earlier event
+        std::atomic<uint64_t> handled{0};
+        std::atomic<uint64_t> handlerErrors{0};
+        std::atomic<uint64_t> handlerNs{0};
+        std::atomic<uint64_t> maxHandlerNs{0};
+        utils::Histogram* handlerSeconds = nullptr;
+        utils::Histogram* queueSeconds = nullptr;
+        utils::Gauge* queued = nullptr;
+        utils::Counter* dropped = nullptr;
+        utils::Counter* merged = nullptr;
+        std::atomic<bool> hasUntypedHandlers{false};
+    };
+
+    std::shared_ptr<const HandlerMap> handlers() const;
+    // Run the untyped handlers of @p event
+    void callUntyped(const Event& event, bool rethrow);
+    // Count handler exception @p e of @p type, then log it or (@p rethrow) throw it on; called
+    // from the catch block
+    void handlerFailed(EventType type, const std::exception& e, bool rethrow);
+    void recordHandled(EventType type, std::chrono::steady_clock::duration elapsed);
+    void recordEmitted(EventType type)
+    {
+        m_stats[static_cast<size_t>(type)].emitted.fetch_add(1, std::memory_order_relaxed);
+        utils::FlightRecorder::instance().recordEvent(static_cast<uint8_t>(type), false);
+    }
+    void recordCoalesced(EventType type)
+    {
+        m_stats[static_cast<size_t>(type)].coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+    void recordQueued(EventType type, double delta);
+    void recordDropped(EventType type);
+    void recordMerged(EventType type);
+    bool hasUntypedHandlers(EventType type) const
+    {
+        return m_stats[static_cast<size_t>(type)].hasUntypedHandlers.load(
+            std::memory_order_relaxed);
+    }
+    bool synchronous() const
     {
-        std::unique_lock lock(m_mutex);
-        m_handlers[type].push_back(std::move(handler));
+        return m_workers.empty();
     }
+    // Called while a push to the queues of worker @p index fails
+    void waitForRoom(size_t index);
+    // Queue a delivery of @p channel's oldest payload at its worker
+    void schedule(ChannelBase& channel);
+    // Run the oldest pending delivery of worker @p index; false if there is none
+    bool runNext(size_t index);
+    void workerLoop(size_t index);
+    // Have @p channel flushed after @p window; false once the bus is shutting down
+    bool flushAfter(ChannelBase& channel, std::chrono::milliseconds window);
+    void flushLoop();
+
+    mutable std::mutex m_handlersMutex; // guards the m_handlers pointer only
+    std::shared_ptr<const HandlerMap> m_handlers;
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool> m_stopping{false};
+    std::array<TypeStats, EVENT_TYPE_COUNT> m_stats;
+
+    // Coalescing windows still open, closed by m_flusher
+    std::mutex m_flushMutex;
+    std::condition_variable m_flushCv;
+    std::vector<std::pair<std::chrono::steady_clock::time_point, ChannelBase*>> m_flushes;
+    bool m_flushStopping = false;
+    std::thread m_flusher;
+
+    std::mutex m_channelsMutex;
+    std::map<std::pair<EventType, std::type_index>, std::unique_ptr<ChannelBase>> m_channels;
+    std::array<Channel<Event>*, EVENT_TYPE_COUNT> m_eventChannels{}; // of emit()
+};
+
+template <typename Payload>
+EventBus::Channel<Payload>::Channel(EventBus& bus, EventType type)
+    : ChannelBase(bus, type),
+      m_slots(EVENT_BUS_QUEUE_CAPACITY),
+      m_handlers(std::make_shared<std::vector<Handler>>())
+{
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::subscribe(Handler handler)
+{
+    // Copy on write: deliveries in progress keep the handlers they started with
+    std::lock_guard<std::mutex> lock(m_handlersMutex);
+    auto next = std::make_shared<std::vector<Handler>>(*m_handlers);
+    next->push_back(std::move(handler));
+    m_handlers = std::move(next);
+}
 
-    // Emit an event (synchronously calls all registered handlers)
-    void emit(const Event& event) const
+template <typename Payload>
+std::shared_ptr<const std::vector<typename EventBus::Channel<Payload>::Handler>>
+EventBus::Channel<Payload>::handlers() const
+{
+    std::lock_guard<std::mutex> lock(m_handlersMutex);
+    return m_handlers;
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::publish(Payload payload)
+{
+    m_bus.recordEmitted(m_type);
+    if (m_bus.synchronous())
+    {
+        deliver(payload, true);
+        return;
+    }
+    if constexpr (MergeablePayload<Payload>)
     {
-        std::shared_lock lock(m_mutex);
-        auto it = m_handlers.find(event.type);
-        if (it != m_handlers.end())
+        const int64_t windowMs = m_windowMs.load(std::memory_order_relaxed);
+        if (windowMs > 0)
         {
-            for (const auto& handler : it->second)
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            if (m_pending)
             {
-                handler(event); // Call all handlers for this event
+                m_pending->merge(std::move(payload));
+                m_bus.recordCoalesced(m_type);
+                return;
             }
+            if (m_bus.flushAfter(*this, std::chrono::milliseconds(windowMs)))
+            {
+                m_pending.emplace(std::move(payload));
+                return;
+            }
+            // The bus is shutting down: no window would close, queue it now
         }
     }
+    enqueue(std::move(payload));
+}
 
-  private:
-    mutable std::shared_mutex m_mutex;
-    std::unordered_map<EventType, std::vector<Handler>> m_handlers;
-};
+template <typename Payload>
+void
+EventBus::Channel<Payload>::coalesce(std::chrono::milliseconds window)
+{
+    static_assert(MergeablePayload<Payload>, "coalescing needs Payload::merge(Payload&&)");
+    m_windowMs.store(window.count(), std::memory_order_relaxed);
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::setCapacity(size_t capacity)
+{
+    m_capacity.store(std::min<size_t>(capacity, EVENT_BUS_QUEUE_CAPACITY),
+                     std::memory_order_relaxed);
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::dropOldest()
+{
+    m_policy.store(OverflowPolicy::DropOldest);
+}
+
+template <typename Payload>
+template <typename KeyFn>
+void
+EventBus::Channel<Payload>::keepLatestBy(KeyFn key)
+{
+    using Key = std::decay_t<std::invoke_result_t<KeyFn&, const Payload&>>;
+    std::lock_guard<std::mutex> lock(m_keyedMutex);
+    m_keyed = std::make_unique<KeyedSlotsFor<Key>>(std::move(key));
+    m_policy.store(OverflowPolicy::LatestByKey);
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::enqueue(Payload&& payload)
+{
+    const size_t capacity = m_capacity.load(std::memory_order_relaxed);
+    switch (m_policy.load())
+    {
+    case OverflowPolicy::Block:
+        // The slot first: the worker pops a payload for each delivery it runs
+        while (m_depth.load() >= static_cast<int64_t>(capacity) ||
+               !m_slots.tryPush(std::move(payload)))
+        {
+            m_bus.waitForRoom(m_worker);
+        }
+        m_depth.fetch_add(1);
+        m_bus.recordQueued(m_type, 1);
+        m_bus.schedule(*this);
+        return;
+    case OverflowPolicy::DropOldest:
+        while (m_depth.load() >= static_cast<int64_t>(capacity) ||
+               !m_slots.tryPush(std::move(payload)))
+        {
+            Payload dropped;
+            if (m_slots.tryPop(dropped))
+            {
+                m_depth.fetch_sub(1);
+                m_bus.recordDropped(m_type);
+            }
+        }
+        m_depth.fetch_add(1);
+        m_bus.recordQueued(m_type, 1);
+        break;
+    case OverflowPolicy::LatestByKey: {
+        std::lock_guard<std::mutex> lock(m_keyedMutex);
+        if (!m_keyed->put(std::move(payload)))
+        {
+            m_bus.recordMerged(m_type); // its delivery is pending already
+            return;
+        }
+        m_depth.fetch_add(1);
+        m_bus.recordQueued(m_type, 1);
+        Payload dropped;
+        if (m_keyed->size() > capacity && m_keyed->take(dropped))
+        {
+            m_depth.fetch_sub(1);
+            m_bus.recordDropped(m_type);
+        }
+        break;
+    }
+    }
+    scheduleOnce();
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::scheduleOnce()
+{
+    // m_depth and m_scheduled are sequentially consistent: either runOne() sees the payload
+    // just queued, or this sees m_scheduled cleared
+    if (!m_scheduled.exchange(true))
+    {
+        m_bus.schedule(*this);
+    }
+}
+
+template <typename Payload>
+bool
+EventBus::Channel<Payload>::takeOne(Payload& out)
+{
+    bool taken = false;
+    if (m_policy.load() == OverflowPolicy::LatestByKey)
+    {
+        std::lock_guard<std::mutex> lock(m_keyedMutex);
+        taken = m_keyed->take(out);
+    }
+    else
+    {
+        taken = m_slots.tryPop(out);
+    }
+    if (taken)
+    {
+        m_depth.fetch_sub(1);
+    }
+    return taken;
+}
+
+template <typename Payload>
+size_t
+EventBus::Channel<Payload>::queued()
+{
+    // Briefly negative while a Block payload is popped before its publisher counted it
+    return static_cast<size_t>(std::max<int64_t>(m_depth.load(), 0));
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::flush()
+{
+    std::optional<Payload> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        pending.swap(m_pending);
+    }
+    if (pending)
+    {
+        enqueue(std::move(*pending));
+    }
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::runOne()
+{
+    Payload payload;
+    const bool taken = takeOne(payload);
+    if (m_policy.load() != OverflowPolicy::Block)
+    {
+        // Back of the line for the next one, behind the other events of the worker
+        m_scheduled.store(false);
+        if (queued() > 0 && !m_scheduled.exchange(true))
+        {
+            m_bus.schedule(*this);
+        }
+    }
+    if (taken)
+    {
+        m_bus.recordQueued(m_type, -1);
+        deliver(payload, false);
+    }
+}
+
+template <typename Payload>
+void
+EventBus::Channel<Payload>::deliver(const Payload& payload, bool rethrow)
+{
+    const auto start = std::chrono::steady_clock::now();
+    if constexpr (std::is_same_v<Payload, Event>)
+    {
+        m_bus.callUntyped(payload, rethrow);
+    }
+    else
+    {
+        for (const auto& handler : *handlers())
+        {
+            try
+            {
+                handler(payload);
+            }
+            catch (const std::exception& e)
+            {
+                m_bus.handlerFailed(m_type, e, rethrow);
+            }
+        }
+        if (m_bus.hasUntypedHandlers(m_type))
+        {
+            m_bus.callUntyped(Event{m_type, payload}, rethrow);
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+    m_bus.recordHandled(m_type, end - start);
+    if constexpr (requires { payload.trace; payload.publishedAt; })
+    {
+        // From the publish, through coalescing and the queue, until the handlers returned
+        utils::Tracer::instance().span(payload.trace,
+                                       "handler_dispatch",
+                                       payload.publishedAt,
+                                       end,
+                                       {{"handlers", handlers()->size()}});
+    }
+}
+
+template <typename Payload>
+EventBus::Channel<Payload>&
+EventBus::channel(EventType type)
+{
+    std::lock_guard<std::mutex> lock(m_channelsMutex);
+    auto& slot = m_channels[{type, std::type_index(typeid(Payload))}];
+    if (!slot)
+    {
+        slot.reset(new Channel<Payload>(*this, type));
+    }
+    return static_cast<Channel<Payload>&>(*slot);
+}
@@ -3,8 +3,12 @@
 #include "common_types/GraphTypes.hpp"
 #include "common_types/SFlowType.hpp"
 #include "event_system/PayloadTypes.hpp"
+#include "utils/Tracing.hpp"
+#include <algorithm>
 #include <boost/graph/graph_traits.hpp>
+#include <chrono>
 #include <functional>
+#include <vector>
 
 struct FlowAddedEventData
 {
@@ -15,9 +19,121 @@ struct FlowAddedEventData
 struct LinkFailureEventData
 {
     Graph::edge_descriptor failedEdge;
+    LinkFailedEventPayload link; // failedEdge's ends
+    // Flows whose resolved path crossed failedEdge, already queued for path re-resolution;
+    // empty when the failure was only reported, not applied to the topology
+    std::vector<sflow::FlowKey> affectedFlows;
+    LinkFailureCause cause = LinkFailureCause::Controller;
+    double confidence = 1.0; // in (0, 1]; below 1 for a failure inferred from missing samples
+    bool applied = false;    // failedEdge (and its reverse) were set down
 };
 
 struct IdleFlowPurgedEventData
 {
     sflow::FlowKey flowKey;
-};
\ No newline at end of file
+};
+
+struct IdleFlowsPurgedEventData
+{
+    std::vector<sflow::FlowKey> flowKeys;
+
+    void merge(IdleFlowsPurgedEventData&& next)
+    {
+        flowKeys.insert(flowKeys.end(), next.flowKeys.begin(), next.flowKeys.end());
+    }
+};
+
+struct ElephantFlowEventData
+{
+    struct Flow
+    {
+        sflow::FlowKey flowKey;
+        uint64_t rateBps = 0;   // periodic rate of the tick that crossed the threshold
+        sflow::PathHandle path; // resolved path at that tick, empty while unknown
+    };
+
+    // Flows that crossed in one rate tick, in shard order
+    std::vector<Flow> flows;
+
+    void merge(ElephantFlowEventData&& next)
+    {
+        flows.insert(flows.end(),
+                     std::make_move_iterator(next.flows.begin()),
+                     std::make_move_iterator(next.flows.end()));
+    }
+};
+
+struct LinkStateChangedEventData
+{
+    struct Change
+    {
+        Graph::edge_descriptor edge;
+        bool up = false;
+    };
+
+    // Latest state of each edge that changed, in the order they first changed
+    std::vector<Change> changes;
+    // Flows whose resolved path crossed an edge that went down, already queued for path
+    // re-resolution
+    std::vector<sflow::FlowKey> affectedFlows;
+    // Failover trace of the first traced change merged in, and when it was published (the
+    // handler dispatch span runs from there until the handlers return)
+    utils::TraceId trace;
+    std::chrono::steady_clock::time_point publishedAt;
+
+    void merge(LinkStateChangedEventData&& next)
+    {
+        if (!trace)
+        {
+            trace = next.trace;
+            publishedAt = next.publishedAt;
+        }
+        for (const Change& change : next.changes)
+        {
+            auto it = std::find_if(changes.begin(), changes.end(), [&](const Change& seen) {
+                return seen.edge == change.edge;
+            });
+            if (it != changes.end())
+            {
+                it->up = change.up;
+            }
+            else
+            {
+                changes.push_back(change);
+            }
+        }
+        affectedFlows.insert(
+            affectedFlows.end(), next.affectedFlows.begin(), next.affectedFlows.end());
+    }
+};
+
+struct LinkCongestionChangedEventData
+{
+    struct Change
+    {
+        Graph::edge_descriptor edge;
+        bool congested = false; // at or above CONGESTION_HOTSPOT_PERCENT
+        double utilization = 0;
+    };
+
+    // Latest state of each edge that crossed the threshold, in the order they first crossed
+    std::vector<Change> changes;
+
+    void merge(LinkCongestionChangedEventData&& next)
+    {
+        for (const Change& change : next.changes)
+        {
+            auto it = std::find_if(changes.begin(), changes.end(), [&](const Change& seen) {
+                return seen.edge == change.edge;
+            });
+            if (it != changes.end())
+            {
+                *it = change;
+            }
+            else
+            {
+                changes.push_back(change);
+            }
+        }
+    }
+};
@@ -18,3 +18,29 @@ struct LinkFailedEventPayload
     uint64_t dstDpid;
     uint32_t dstInterface;
 };
+
+// What found a link failed
+enum class LinkFailureCause : uint8_t
+{
+    Controller,      // POST /ndt/link_failure_detected
+    OperDown,        // sFlow counter samples report the port's ifOperStatus down
+    AdminDown,       // ... or its ifAdminStatus down
+    CountersStopped, // the port's sFlow counter samples stopped coming
+};
+
+inline const char*
+linkFailureCauseName(LinkFailureCause cause)
+{
+    switch (cause)
+    {
+    case LinkFailureCause::Controller:
+        return "controller";
+    case LinkFailureCause::OperDown:
+        return "oper_down";
+    case LinkFailureCause::AdminDown:
+        return "admin_down";
+    case LinkFailureCause::CountersStopped:
+        return "counters_stopped";
+    }
+    return "unknown";
+}
@@ -1,15 +1,21 @@
 #pragma once
 
 #include "common_types/AppTypes.hpp"
+#include "utils/TaskScheduler.hpp"
 #include <filesystem>
 #include <mutex>
 #include <optional>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
-namespace fs = std::filesystem;
+#define NFS_EXPORTS_FILE "/etc/exports"
+#define NFS_EXPORT_OPTIONS "*(rw,sync,no_subtree_check,root_squash,all_squash)"
+#define NFS_RECONCILE_DEBOUNCE_MS 500 // registrations within it share one exports reload
+#define NFS_RECONCILE_PERIOD_MS 60000 // a failed reload is retried this often
 
+namespace fs = std::filesystem;
 
 /**
  * @brief Manages per-application registration and NFS-backed workspace setup.
@@ -19,10 +25,13 @@ namespace fs = std::filesystem;
  * provisions an isolated per-app directory under the configured NFS export
  * directory (e.g., /srv/nfs/sim/<appId>/).
  *
- * It updates NFS server configuration to export/mount the per-app directory,
- * reloads the NFS server when required, and performs cleanup of application
- * folders and stale NFS entries. All public APIs are thread-safe via an
- * internal mutex.
+ * The per-app directories to export are kept in memory. A change marks them dirty
+ * and brings a reconciliation forward to NFS_RECONCILE_DEBOUNCE_MS later, on the
+ * task scheduler: it rewrites the NDT entries of NFS_EXPORTS_FILE in one temporary
+ * file renamed over it, keeping the other entries, and reloads the exports once. A
+ * burst of registrations therefore costs one reload, and none on the HTTP thread.
+ * Application folders and stale entries of a previous run are removed the same way.
+ * All public APIs are thread-safe via an internal mutex.
  *
  * Typical usage:
  *  - registerApplication() to obtain an appId and store the callback URL
@@ -39,13 +48,16 @@ class ApplicationManager
     // Register a new application and get its App ID
     int registerApplication(const std::string& appName, const std::string& simulationCompletedUrl);
 
-    // Set up NFS configuration for the application
+    // Create the application's directory and queue its export; false if it cannot be created
     bool setupNFSForApp(int appId);
 
     std::optional<std::string> getSimulationCompletedUrl(int appId) const;
 
+    // Workspace directory of a registered application (nfsExportDir/<appId>)
+    std::optional<std::string> getAppDirectory(int appId) const;
+
   private:
-    std::mutex m_mutex;
+    mutable std::mutex m_mutex;
     int m_nextAppId;
     std::unordered_map<int, RegisteredApp> m_registeredApps;
 
@@ -54,11 +66,20 @@ class ApplicationManager
 
     std::vector<std::string> m_registeredFolders;
 
-    bool updateNFSConfig(int appId, const std::string& appDir);
+    std::set<std::string> m_exports; // app directories that should be exported
+    bool m_exportsDirty = false;     // m_exports differs from what was last applied
+    bool m_reconcilePending = false; // a debounced reconciliation is due
+    std::mutex m_reconcileMutex;     // one rewrite of the exports file at a time
+    utils::TaskScheduler::TaskId m_reconcileTask = 0;
+
+    // Debounce a reconciliation of the exports (m_mutex held)
+    void requestReconcile();
+    // Apply m_exports to the exports file and reload the NFS server if it is dirty
+    void reconcileExports();
+    bool writeExportsFile(const std::set<std::string>& exports);
     bool reloadNFSServer();
     void cleanupNFS();
     bool chownRecursive(const fs::path& root, const std::string& user, const std::string& group);
     void cleanupAppFolder(const std::string& folderPath);
     void cleanupStaleEntries();
-    
 };
@@ -1,12 +1,32 @@
 #pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define SIM_MAX_INFLIGHT 4            // run requests sent to the simulator at once
+#define SIM_MAX_QUEUED 64             // further requests wait; beyond, they are refused
+#define SIM_REQUEST_TIMEOUT_MS 10000  // to connect to the simulator, and for its answer
+#define SIM_REQUEST_RETRIES 2         // extra attempts after a transport error
+#define SIM_MAX_RECORDS 1024          // simulations kept for status queries, oldest dropped first
 
 class ApplicationManager;
 
+namespace utils
+{
+class Counter;
+class Gauge;
+}
+
 /**
  * @brief Coordinates simulation execution requests and result forwarding.
  *
@@ -17,16 +37,24 @@ class ApplicationManager;
  * ApplicationManager.
  *
  * Typical flow:
- *  1. requestSimulation(body): send a run request to SIM_SERVER_URL for an app/case
- *  2. onSimulationResult(appId, body): invoked by the network layer upon completion
+ *  1. requestSimulation(body): queue a run request to SIM_SERVER_URL for an app/case and
+ *     return its simulation id at once
+ *  2. the request is sent through the shared utils::HttpClient, at most SIM_MAX_INFLIGHT at a
+ *     time; statusJson(id) tells whether the simulator accepted it
+ *  3. onSimulationResult(appId, body): invoked by the network layer upon completion
  *     - looks up the application's "simulation completed" callback via ApplicationManager
- *     - forwards the result payload to that callback (implementation-dependent)
+ *     - forwards the result payload to that callback
+ *
+ * A burst of what-if requests from several applications therefore costs neither threads nor
+ * HTTP handler time: it waits in a queue of at most SIM_MAX_QUEUED and is drained over the
+ * simulator's pooled connections.
  *
  * Notes:
  *  - This class does not own ApplicationManager; it stores a shared_ptr reference.
- *  - Thread-safety depends on ApplicationManager and the caller's network layer threading model.
+ *  - Must be owned by a shared_ptr: pending requests hold a weak reference to it.
+ *  - Thread-safe.
  */
-class SimulationRequestManager
+class SimulationRequestManager : public std::enable_shared_from_this<SimulationRequestManager>
 {
   public:
     SimulationRequestManager(std::shared_ptr<ApplicationManager> appManager,
@@ -34,26 +62,78 @@ class SimulationRequestManager
     ~SimulationRequestManager();
 
     /**
-     * @brief Asynchronously request the simulator server to run a case
-     * @param simulatorName  Name of the simulator
-     * @param version        Version of the simulator
-     * @param appId          Application ID
-     * @param caseId         Case ID
-     * @param inputFilePath  Path to the input file for the simulation
+     * @brief Queue a request for the simulator server to run a case
+     * @param body  JSON with the simulator name and version, the app_id and case_id, and the
+     *              input file of the simulation
+     * @return The simulation id, or nullopt if SIM_MAX_QUEUED requests are already waiting
      */
-    std::string requestSimulation(const std::string& body);
+    std::optional<uint64_t> requestSimulation(const std::string& body);
 
     /**
      * @brief This method should be called by the network layer when the simulator server
      *        notifies that the simulation has finished. It will forward the result
      *        back to the application via the registered callback.
-     * @param appId            Application ID
-     * @param caseId           Case ID
-     * @param outputFilePath   Path to the output file produced by the simulation
+     * @param appId  Application ID
+     * @param body   Result from the simulator, with the case_id and output file
      */
     void onSimulationResult(int appId, const std::string& body);
 
+    /**
+     * @brief {"simulation_id", "app_id", "case_id", "state": "queued"|"submitting"|"running"|
+     *        "failed"|"completed", "elapsed_ms", "simulator_status", "simulator_response",
+     *        "error"}, or nullopt for an unknown (or already dropped) id.
+     */
+    std::optional<nlohmann::json> statusJson(uint64_t id) const;
+
+    /// {"queued", "inflight", "submitted", "failed", "rejected", "completed", "kept"}
+    nlohmann::json statsJson() const;
+
   private:
+    enum class State
+    {
+        Queued,
+        Submitting,
+        Running, // accepted by the simulator
+        Failed,
+        Completed,
+    };
+
+    struct Simulation
+    {
+        uint64_t id = 0;
+        std::string appId;
+        std::string caseId;
+        std::string body; // until sent
+        State state = State::Queued;
+        unsigned simulatorStatus = 0;
+        std::string simulatorResponse;
+        std::string error;
+        std::chrono::steady_clock::time_point createdAt;
+    };
+
+    // Take queued requests, up to SIM_MAX_INFLIGHT in flight, into @p out (m_mutex held)
+    void dispatchLocked(std::vector<std::pair<uint64_t, std::string>>& out);
+    // POST each (id, body) to the simulator
+    void send(std::vector<std::pair<uint64_t, std::string>> requests);
+    void onSubmitted(uint64_t id, unsigned status, std::string response, std::string error);
+    // Drop the oldest finished records beyond SIM_MAX_RECORDS (m_mutex held)
+    void trimLocked();
+    void updateGauges();
+
     std::shared_ptr<ApplicationManager> m_applicatonManager;
     std::string SIM_SERVER_URL;
-};
\ No newline at end of file
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, Simulation> m_simulations;
+    std::deque<uint64_t> m_order; // ids by age, for eviction
+    std::deque<uint64_t> m_queue; // waiting to be sent
+    size_t m_inflight = 0;
+    uint64_t m_nextId = 1;
+
+    utils::Gauge& m_queuedGauge;
+    utils::Gauge& m_inflightGauge;
+    utils::Counter& m_submitted;
+    utils::Counter& m_failed;
+    utils::Counter& m_rejected;
+    utils::Counter& m_completed;
+};
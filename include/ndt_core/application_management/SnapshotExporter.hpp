@@ -0,0 +1,213 @@
+#pragma once
+
+#include "utils/TaskScheduler.hpp" // for TaskScheduler
+#include <atomic>                  // for atomic
+#include <chrono>                  // for milliseconds, steady_clock
+#include <cstdint>                 // for uint8_t, uint16_t, uint32_t, uint64_t, int64_t
+#include <memory>                  // for shared_ptr
+#include <mutex>                   // for mutex
+#include <nlohmann/json.hpp>       // for json
+#include <optional>                // for optional
+#include <string>                  // for string
+#include <unordered_map>           // for unordered_map
+#include <vector>                  // for vector
+
+#define SNAPSHOT_FILE_NAME "ndt_snapshot.bin" // written into each application's NFS directory
+#define SNAPSHOT_REUSE_MS 1000                // an encoded snapshot this young is written as is
+#define SNAPSHOT_MIN_INTERVAL_MS 1000         // shortest period of scheduled exports
+
+class TopologyAndFlowMonitor;
+class ApplicationManager;
+
+namespace sflow
+{
+class FlowLinkUsageCollector;
+}
+
+/**
+ * @brief Layout of the snapshot file, for simulators that mmap it.
+ *
+ * The file starts with a FileHeader and FileHeader::sectionCount SectionEntry records; each
+ * section is an array of @c count fixed-size records at @c offset (8-byte aligned). Integers
+ * are in the byte order of the writer, recorded in FileHeader::byteOrder, and IPv4 addresses
+ * in network order as everywhere in NDT. Readers skip sections with unknown ids and ignore
+ * record bytes past the fields they know, so later versions can append both.
+ *
+ * Vertex and edge ids are those of CsrGraph: the edges are grouped by source vertex, and the
+ * out-edges of vertex v are [OutOffsets[v], OutOffsets[v + 1]).
+ */
+namespace snapshot
+{
+
+inline constexpr char MAGIC[4] = {'N', 'D', 'T', 'S'};
+inline constexpr uint16_t FORMAT_VERSION = 1;
+inline constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+enum class SectionId : uint32_t
+{
+    Vertices = 1,   // VertexRecord
+    OutOffsets = 2, // uint32_t, vertex count + 1
+    Edges = 3,      // EdgeRecord
+    Flows = 4,      // FlowRecord
+    PathHops = 5,   // PathHopRecord, referenced by FlowRecord
+};
+
+struct FileHeader
+{
+    char magic[4];
+    uint16_t formatVersion;
+    uint16_t headerSize; // sizeof(FileHeader)
+    uint32_t byteOrder;  // BYTE_ORDER_MARK as written
+    uint32_t sectionCount;
+    uint64_t graphVersion;
+    int64_t takenAtMs; // Unix time
+};
+
+struct SectionEntry
+{
+    uint32_t id; // SectionId
+    uint32_t recordSize;
+    uint64_t offset; // from the start of the file
+    uint64_t count;
+};
+
+enum : uint8_t
+{
+    FLAG_UP = 1,
+    FLAG_ENABLED = 2,
+};
+
+struct VertexRecord
+{
+    uint64_t dpid; // 0 for hosts
+    uint64_t mac;
+    uint32_t ip;   // first address, 0 if none
+    uint8_t type;  // VertexType: 0 switch, 1 host
+    uint8_t flags; // FLAG_UP | FLAG_ENABLED
+    uint16_t reserved;
+};
+
+struct EdgeRecord
+{
+    uint32_t source; // vertex ids
+    uint32_t target;
+    uint32_t srcInterface;
+    uint32_t dstInterface;
+    uint64_t linkBandwidth; // bps
+    uint64_t linkBandwidthUsage;
+    double utilization; // percent
+    uint32_t flowCount;
+    uint32_t flags; // FLAG_UP, and FLAG_ENABLED when also enabled
+};
+
+enum : uint8_t
+{
+    FLOW_ELEPHANT = 1, // isElephantFlowImmediately
+    FLOW_ACK = 2,
+};
+
+struct FlowRecord
+{
+    uint32_t srcIp;
+    uint32_t dstIp;
+    uint16_t srcPort;
+    uint16_t dstPort;
+    uint8_t protocol;
+    uint8_t flags; // FLOW_*
+    uint16_t reserved;
+    uint64_t rateBps; // estimatedFlowSendingRateImmediately
+    uint64_t packetRate;
+    int64_t startMs;
+    int64_t endMs;
+    uint32_t pathOffset; // first PathHopRecord of the flow's path
+    uint32_t pathLength; // 0 if the path is unknown
+};
+
+struct PathHopRecord
+{
+    uint64_t dpid;
+    uint32_t outPort;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FileHeader) == 32 && sizeof(SectionEntry) == 24);
+static_assert(sizeof(VertexRecord) == 24 && sizeof(EdgeRecord) == 48);
+static_assert(sizeof(FlowRecord) == 56 && sizeof(PathHopRecord) == 16);
+
+} // namespace snapshot
+
+/**
+ * @brief Writes the topology, link counters and flow table as one binary file (see
+ *        snapshot::FileHeader) into the NFS directories of simulation applications.
+ *
+ * Simulators reading the state over the REST API parse a large JSON body per fetch, and
+ * each fetch costs the server the same encoding again. The snapshot is encoded once into
+ * fixed-size records that a simulator can mmap and index directly; an encoded snapshot
+ * younger than SNAPSHOT_REUSE_MS is shared by all exports, so periodic exports to many
+ * applications cost one encoding per period.
+ *
+ * The file is written beside the target and renamed over it, so a reader always maps a
+ * complete snapshot, and one that keeps an old mapping is not disturbed by the next export.
+ *
+ * Thread-safe.
+ */
+class SnapshotExporter
+{
+  public:
+    SnapshotExporter(std::shared_ptr<TopologyAndFlowMonitor> topologyAndFlowMonitor,
+                     std::shared_ptr<sflow::FlowLinkUsageCollector> collector,
+                     std::shared_ptr<ApplicationManager> appManager);
+    ~SnapshotExporter();
+
+    SnapshotExporter(const SnapshotExporter&) = delete;
+    SnapshotExporter& operator=(const SnapshotExporter&) = delete;
+
+    /**
+     * @brief Write a snapshot into the directory of application @p appId.
+     * @return {"path", "graph_version", "bytes", "vertices", "edges", "flows", "path_hops"},
+     *         or nullopt if the application is unknown.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    std::optional<nlohmann::json> exportForApp(int appId);
+
+    /**
+     * @brief Export for @p appId every @p interval (at least SNAPSHOT_MIN_INTERVAL_MS), or
+     *        stop doing so if it is zero; the first export is one interval away. False if the
+     *        application is unknown.
+     */
+    bool schedule(int appId, std::chrono::milliseconds interval);
+
+    /// {"exports", "encodings", "failures", "scheduled_apps", "last_bytes"}
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Encoded
+    {
+        std::vector<char> bytes;
+        uint64_t graphVersion = 0;
+        size_t vertices = 0;
+        size_t edges = 0;
+        size_t flows = 0;
+        size_t pathHops = 0;
+        std::chrono::steady_clock::time_point encodedAt;
+    };
+
+    // The latest encoding, made now if older than SNAPSHOT_REUSE_MS
+    std::shared_ptr<const Encoded> current();
+    std::shared_ptr<const Encoded> encode() const;
+
+    std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
+    std::shared_ptr<sflow::FlowLinkUsageCollector> m_collector;
+    std::shared_ptr<ApplicationManager> m_appManager;
+
+    std::mutex m_encodeMutex; // one encoding at a time; later callers share it
+    std::shared_ptr<const Encoded> m_encoded;
+
+    mutable std::mutex m_scheduleMutex;
+    std::unordered_map<int, utils::TaskScheduler::TaskId> m_scheduled; // app id -> task
+
+    std::atomic<uint64_t> m_exports{0};
+    std::atomic<uint64_t> m_encodings{0};
+    std::atomic<uint64_t> m_failures{0};
+    std::atomic<uint64_t> m_lastBytes{0};
+};
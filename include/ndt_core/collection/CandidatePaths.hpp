@@ -0,0 +1,132 @@
+#pragma once
+
+#include "common_types/SFlowType.hpp"       // for Path
+#include "ndt_core/collection/CsrGraph.hpp" // for CsrGraph
+#include <atomic>                           // for atomic
+#include <cstddef>                          // for size_t
+#include <cstdint>                          // for uint64_t
+#include <mutex>                            // for mutex
+#include <nlohmann/json.hpp>                // for json
+#include <optional>                         // for optional
+#include <unordered_map>                    // for unordered_map
+#include <vector>                           // for vector
+
+#define CANDIDATE_PATHS_DEFAULT_K 4          // candidate paths returned per switch pair
+#define CANDIDATE_PATHS_DEFAULT_MAX_HOPS 16  // longer candidates are dropped
+#define CANDIDATE_PATHS_CACHE_MAX_PAIRS 4096 // the cache starts over when it grows past this
+#define ALL_PATHS_DEFAULT_MAX_PATHS 256      // simple paths enumerated per switch pair
+#define ALL_PATHS_TIME_BUDGET_MS 20          // an enumeration stops with what it has after this
+#define ALL_PATHS_CLOCK_STRIDE 1024          // DFS steps between two looks at the clock
+
+/**
+ * @brief Link cost used to rank candidate paths. Every hop costs 1, plus:
+ */
+enum class PathWeight
+{
+    HOP_COUNT,      // nothing
+    UTILIZATION,    // EdgeProperties::linkBandwidthUtilization / 100
+    LEFT_BANDWIDTH, // the used fraction 1 - leftBandwidth / linkBandwidth
+};
+
+enum class PathSearch
+{
+    K_SHORTEST, // kShortestSwitchPaths(): the k cheapest by weight
+    ALL_SIMPLE, // allSimpleSwitchPaths(): the first k found by depth-first enumeration
+};
+
+struct CandidatePathOptions
+{
+    size_t k = CANDIDATE_PATHS_DEFAULT_K;
+    size_t maxHops = CANDIDATE_PATHS_DEFAULT_MAX_HOPS; // switch-to-switch links
+    PathWeight weight = PathWeight::UTILIZATION;       // K_SHORTEST only
+    PathSearch search = PathSearch::K_SHORTEST;
+    uint32_t timeBudgetMs = ALL_PATHS_TIME_BUDGET_MS; // ALL_SIMPLE only
+
+    bool operator==(const CandidatePathOptions& o) const = default;
+};
+
+/**
+ * @brief The K cheapest loop-free switch paths between two switches (Yen's algorithm).
+ *
+ * Only up and enabled switches and links are used. A path is returned as one
+ * (dpid, output port) pair per switch, ending with (dstDpid, 0), the same hops
+ * TopologyAndFlowMonitor::getAllPathsBetweenTwoHosts() lists between its host entries.
+ * Paths come cheapest first; ties keep the order in which they were found.
+ */
+std::vector<sflow::Path> kShortestSwitchPaths(const CsrGraph& graph,
+                                              CsrGraph::VertexId src,
+                                              CsrGraph::VertexId dst,
+                                              const CandidatePathOptions& options);
+
+/**
+ * @brief Loop-free switch paths between two switches, depth first over the out-edges in CSR
+ *        order, bounded by options.k paths, options.maxHops links and options.timeBudgetMs.
+ *
+ * The enumeration is iterative over stacks sized once for maxHops, so it neither recurses
+ * nor allocates per step. Same usable switches and links and path format as
+ * kShortestSwitchPaths(). On meshed fabrics the number of simple paths grows exponentially:
+ * a search stopped by a bound returns the paths found so far, in discovery order.
+ */
+std::vector<sflow::Path> allSimpleSwitchPaths(const CsrGraph& graph,
+                                              CsrGraph::VertexId src,
+                                              CsrGraph::VertexId dst,
+                                              const CandidatePathOptions& options);
+
+/**
+ * @brief kShortestSwitchPaths() or allSimpleSwitchPaths() results per (source switch,
+ *        destination switch, options), valid for one graph version.
+ *
+ * A lookup for a newer version than the cached one drops everything, so link failures,
+ * recoveries and enable/disable changes are picked up on the next call; lookups and inserts
+ * for an older version miss and are ignored. Link counters are not part of the graph
+ * version: under a load-based PathWeight the ranking reflects the load at the time the pair
+ * was first computed in that version.
+ *
+ * Thread-safe.
+ */
+class CandidatePathCache
+{
+  public:
+    std::optional<std::vector<sflow::Path>> find(uint64_t graphVersion,
+                                                 uint64_t srcDpid,
+                                                 uint64_t dstDpid,
+                                                 const CandidatePathOptions& options);
+
+    void insert(uint64_t graphVersion,
+                uint64_t srcDpid,
+                uint64_t dstDpid,
+                const CandidatePathOptions& options,
+                std::vector<sflow::Path> paths);
+
+    /**
+     * @brief {"pairs", "version", "hits", "misses"}.
+     */
+    nlohmann::json statsJson() const;
+
+    /// Estimated heap bytes of the cached pairs and their paths.
+    size_t memoryBytes() const;
+
+  private:
+    struct Key
+    {
+        uint64_t srcDpid;
+        uint64_t dstDpid;
+        CandidatePathOptions options;
+
+        bool operator==(const Key& o) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    // Drop the entries of an older version than @p graphVersion (caller holds m_mutex)
+    void syncVersion(uint64_t graphVersion);
+
+    mutable std::mutex m_mutex;
+    uint64_t m_version = 0;
+    std::unordered_map<Key, std::vector<sflow::Path>, KeyHash> m_paths;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
@@ -2,10 +2,27 @@
 
 #include <cstdint>
 #include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <nlohmann/json.hpp>
 
+#include "utils/MemoryAccounting.hpp"
+
+#define CLASSIFIER_EMC_MIN_ENTRIES 256  // exact-match cache slots of a switch with few rules
+#define CLASSIFIER_EMC_MAX_ENTRIES 8192 // ... and at most, however many rules it has
+#define CLASSIFIER_EMC_SHARDS 16        // locks per switch's cache, so readers rarely contend
+#define CLASSIFIER_UPDATE_MAX_WORKERS 8 // threads updating and compiling switches in parallel
+
+namespace sflow
+{
+struct FlowChange;
+struct FlowDiff;
+} // namespace sflow
+
 namespace ndtClassifier
 {
 /**
@@ -19,8 +36,10 @@ namespace ndtClassifier
  *
  * Typically workflow:
  * 1. Poll all switches -> JSON result
- * 2. Call Classifier::updateFromQueriedTables(json)
- * 3. For each detected flow key, call Classifier::lookup(dpid, flowkey)
+ * 2. Call Classifier::updateFromQueriedTables(json), and
+ *    Classifier::updateGroupsFromQueriedTables(json) with the polled group descriptions
+ * 3. For each detected flow key, call Classifier::lookup(dpid, flowkey), or
+ *    Classifier::lookupPipeline(dpid, flowkey) to follow goto_table and groups
  *
  * @par Supported JSON shapes
  * - Shape A:
@@ -118,10 +137,62 @@ struct RuleEffect
     /** @brief output ports parsed from actions such as "OUTPUT:1". */
     std::vector<uint32_t> outputPorts;
 
-    /** @brief Group ID parsed from "GROUP:<id>" (group resolution is out of scope here). */
+    /** @brief Group ID parsed from "GROUP:<id>" (resolved by Classifier::lookupPipeline()). */
     std::optional<uint32_t> groupId;
 };
 
+/** @brief OpenFlow group type (ofp_group_type). */
+enum class GroupType
+{
+    ALL,          // every bucket
+    SELECT,       // one bucket, chosen per flow
+    INDIRECT,     // the single bucket
+    FAST_FAILOVER // the first live bucket
+};
+
+/**
+ * @brief Where a key ends up after a switch's whole pipeline (Classifier::lookupPipeline()).
+ */
+struct PipelineEffect
+{
+    /** @brief Output ports of every matched rule and executed group bucket, in order. */
+    std::vector<uint32_t> outputPorts;
+
+    /** @brief Tables that matched the key, starting with table 0. */
+    std::vector<uint8_t> tables;
+
+    /** @brief Groups executed, in order (chained groups included). */
+    std::vector<uint32_t> groups;
+
+    /** @brief Whether a rule or bucket referenced a group the last group poll did not list. */
+    bool unresolvedGroup = false;
+};
+
+/**
+ * @brief A flow-mod a switch accepted, for Classifier::applyFlowMods().
+ *
+ * The fields are those sent to Ryu's /stats/flowentry/{add,modify,delete,delete_strict}:
+ * a match object, and actions as Ryu takes them ({"type": "OUTPUT", "port": 1}) or prints
+ * them ("OUTPUT:1").
+ */
+struct FlowMod
+{
+    enum class Command : uint8_t
+    {
+        Add,
+        Modify,      // non-strict
+        Delete,      // non-strict
+        DeleteStrict
+    };
+
+    uint64_t dpid = 0;
+    Command command = Command::Add;
+    uint8_t tableId = 0;
+    int priority = 0;
+    nlohmann::json match;
+    nlohmann::json actions;
+};
+
 /** @brief OpenFlow classifier supporting incremental updates from periodic polling.
  *
  * @details
@@ -130,8 +201,16 @@ struct RuleEffect
  *
  * Internally uses an OVS-like approach:
  * - rules grouped by identical masks into subtables
- * - hash lookup by (key & mask) within each subtable
+ * - hash lookup by (key & mask) within each subtable, keyed by the bytes the mask covers
  * - choose highest-priority match
+ * - rules with the same actions share one RuleEffect
+ * - a per-switch exact-match cache in front, so a key looked up again on the same rules
+ *   costs one probe (lookupBatch() goes to the subtables directly)
+ *
+ * Lookups never wait for an update: the writer builds read-only copies of the tables it
+ * changed and publishes them with a pointer swap (read-copy-update). A lookup sees either
+ * the rules before or after an update, and getRulesVersion() only moves once the new rules
+ * are visible to lookups.
  */
 class Classifier
 {
@@ -159,9 +238,87 @@ class Classifier
      * Performs an incremental mark-and-sweep:
      * - rules seen in the new poll are kept/updated
      * - rules not present are removed
+     *
+     * A switch whose flow entries are the same as in its previous poll, apart from their
+     * counters (byte_count, packet_count, duration, idle/hard age), is skipped without
+     * parsing them.
+     *
+     * Switches are independent: each is parsed, updated and compiled on its own thread (up
+     * to CLASSIFIER_UPDATE_MAX_WORKERS), so an update takes about as long as its largest
+     * table. Lookups keep reading the previous rules meanwhile and never wait for it.
+     *
+     * Concurrent calls are serialized.
      */
     void updateFromQueriedTables(const json& newTables);
 
+    /** @brief updateFromQueriedTables() from the raw text of Ryu /stats/flow/<dpid>
+     *         responses, without building a JSON DOM.
+     *
+     * @param responses (dpid, response body) per polled switch.
+     *
+     * @details
+     * The text is streamed through a SAX parser twice at most: once to fingerprint the
+     * entries (counters excluded), and again to read the rules only if the fingerprint
+     * differs from the switch's previous poll. Malformed or empty responses leave the switch
+     * unchanged. The fingerprint differs from the one updateFromQueriedTables() keeps, so
+     * switching a switch between the two costs one full update.
+     *
+     * Concurrent calls, also with updateFromQueriedTables(), are serialized.
+     */
+    void updateFromFlowStatsText(const std::vector<std::pair<uint64_t, std::string>>& responses);
+
+    /** @brief Apply rule changes computed elsewhere (e.g. sflow::getFlowTableDiff()) without
+     *         a poll.
+     *
+     * @param diffs Per-switch added, removed and modified IPv4 destination rules.
+     * @param tableId OpenFlow table the rules live in (default 0).
+     *
+     * @details
+     * Each FlowChange stands for the rule matching eth_type 0x0800 and ipv4_dst
+     * dstNet/dstMask at its priority, with the single action OUTPUT:<port>; dstNet is in
+     * network byte order, dstMask in host byte order. Removed and modified changes drop the
+     * rule with oldOutInterface; added and modified ones insert it with newOutInterface.
+     * The next updateFromQueriedTables() of a switch parses its poll in full again, so the
+     * polled table stays the reference.
+     *
+     * Concurrent calls, also with updateFromQueriedTables(), are serialized.
+     */
+    void applyFlowDiffs(const std::vector<sflow::FlowDiff>& diffs, uint8_t tableId = 0);
+
+    /** @brief Write flow-mods the switches accepted through to the rules, ahead of the next
+     *         poll.
+     *
+     * @param mods Flow-mods in the order they were applied.
+     *
+     * @details
+     * Each mod changes the rules as the switch did:
+     * - Add replaces the rule with the same match and priority
+     * - Modify sets the actions of every rule whose match is the mod's or more specific,
+     *   whatever its priority
+     * - Delete removes those same rules, DeleteStrict only the one with the same match and
+     *   priority
+     * Like applyFlowDiffs(), the next poll of a changed switch is parsed in full, so the
+     * polled table reconciles whatever the mods got wrong.
+     *
+     * Concurrent calls, also with updateFromQueriedTables(), are serialized.
+     */
+    void applyFlowMods(const std::vector<FlowMod>& mods);
+
+    /** @brief Update the group tables from polled group descriptions.
+     *
+     * @param newGroups JSON array of {"dpid": <dpid>, "groups": <Ryu /stats/groupdesc/<dpid>
+     *        response>}, i.e. a list of {"group_id", "type", "buckets": [{"weight",
+     *        "actions"}]} either directly or under the dpid key.
+     *
+     * @details
+     * Replaces the groups of every listed switch (an empty list removes them). A switch whose
+     * description is unchanged since its last poll is skipped; a change bumps
+     * getRulesVersion() like a rule change.
+     *
+     * Concurrent calls, also with updateFromQueriedTables(), are serialized.
+     */
+    void updateGroupsFromQueriedTables(const json& newGroups);
+
     /** @brief Lookup the best matching rule effect for a given packet/flow key.
      *
      * @param dpid Switch datapath ID.
@@ -171,9 +328,150 @@ class Classifier
      */
     std::optional<RuleEffect> lookup(uint64_t dpid, const FlowKey& key, uint8_t tableId = 0) const;
 
+    /** @brief lookup() that also reports which key bits the result depended on.
+     *
+     * @param[in,out] consulted OR-ed with the masks of every subtable the lookup probed,
+     *        in FlowKey layout (e.g. ipv4Dst = 0xffffff00 for rules matching a /24).
+     *
+     * @details
+     * Any key that equals @p key on the bits set in @p consulted gets the same result from
+     * this switch until its rules change (see getRulesVersion(dpid)), so callers can cache
+     * the result per masked key, like an OVS megaflow.
+     */
+    std::optional<RuleEffect> lookupWithMask(uint64_t dpid,
+                                             const FlowKey& key,
+                                             FlowKey& consulted,
+                                             uint8_t tableId = 0) const;
+
+    /** @brief lookup() without copying the effect.
+     *
+     * @param consulted As for lookupWithMask(); may be null.
+     * @return The matched rule's effect, or nullptr if no rule matched.
+     *
+     * @details
+     * The effect belongs to the view this thread last loaded, which the thread keeps alive
+     * until its next lookup of any kind on this Classifier; copy what must outlive that.
+     * lookup() and lookupWithMask() are this plus a copy.
+     */
+    const RuleEffect* lookupEffect(uint64_t dpid,
+                                   const FlowKey& key,
+                                   FlowKey* consulted = nullptr,
+                                   uint8_t tableId = 0) const;
+
+    /** @brief Run @p key through the pipeline of switch @p dpid.
+     *
+     * @details
+     * Starts at table 0 and follows goto_table while it moves to a later table; a miss in a
+     * later table ends the pipeline. Groups are resolved from the last group poll, chained
+     * groups included:
+     * - ALL: every bucket
+     * - SELECT: one bucket chosen by ecmpFlowHash() of the key's 5-tuple, weighted by the
+     *   bucket weights (with equal weights, the bucket selectEcmpMember() would pick)
+     * - INDIRECT, FAST_FAILOVER: the first bucket (port liveness is not tracked)
+     *
+     * @return std::nullopt if the switch is unknown or table 0 has no matching rule.
+     */
+    std::optional<PipelineEffect> lookupPipeline(uint64_t dpid, const FlowKey& key) const;
+
+    /** @brief lookupPipeline() that also reports which key bits the result depended on.
+     *
+     * @param[in,out] consulted As for lookupWithMask(), over every table probed; a SELECT
+     *        group adds the 5-tuple fields its hash reads.
+     */
+    std::optional<PipelineEffect> lookupPipelineWithMask(uint64_t dpid,
+                                                         const FlowKey& key,
+                                                         FlowKey& consulted) const;
+
+    /** @brief lookupPipeline() into a caller-owned @p out, for per-hop path tracing.
+     *
+     * @param consulted As for lookupPipelineWithMask(); may be null.
+     * @return false, with @p out cleared, where lookupPipeline() returns std::nullopt.
+     *
+     * @details
+     * @p out is cleared but keeps its capacity, so reusing one PipelineEffect across calls
+     * (e.g. a thread_local one) makes steady-state lookups allocation-free.
+     */
+    bool lookupPipelineInto(uint64_t dpid,
+                            const FlowKey& key,
+                            FlowKey* consulted,
+                            PipelineEffect& out) const;
+
+    /** @brief lookup() for many keys of one switch and table at once.
+     *
+     * @param dpid Switch datapath ID.
+     * @param keys Packet/flow keys.
+     * @param[out] out Effect per key (std::nullopt if no match); must be as long as @p keys.
+     * @param tableId OpenFlow table ID (default 0).
+     *
+     * @details
+     * Packs the keys once, then evaluates the table one subtable at a
+     * time across the whole batch, gathering only the key bytes that subtable's mask covers.
+     * Unlike lookup(), misses are not logged.
+     *
+     * @throws std::invalid_argument if @p out and @p keys differ in size.
+     */
+    void lookupBatch(uint64_t dpid,
+                     std::span<const FlowKey> keys,
+                     std::span<std::optional<RuleEffect>> out,
+                     uint8_t tableId = 0) const;
+
     /** @brief Get the number of stored rules for a given switch. */
     size_t getRuleCount(uint64_t dpid) const;
 
+    /** @brief The rules of switch @p dpid that a sflow::FlowChange can stand for.
+     *
+     * @details
+     * Those in table @p tableId matching exactly eth_type 0x0800 and an ipv4_dst prefix,
+     * with the single action OUTPUT:<port>, as FlowChanges adding them (dstNet in network
+     * byte order, dstMask in host byte order, newOutInterface the port), in no particular
+     * order. Other rules of the switch are left out. Reads the writer's rules, so it
+     * includes flow-mods applyFlowMods() wrote through, and waits for a running update.
+     */
+    std::vector<sflow::FlowChange> getIpv4DstRules(uint64_t dpid, uint8_t tableId = 0) const;
+
+    /** @brief Counter bumped whenever a poll adds or removes a rule or group on any switch.
+     *
+     * @details
+     * Polls that return the same rules leave it unchanged, so callers caching lookup results
+     * only need to revisit them when this value moves.
+     */
+    uint64_t getRulesVersion() const;
+
+    /** @brief getRulesVersion() value at the last rule change of switch @p dpid (0 if unknown).
+     *
+     * @details
+     * A lookup result obtained while getRulesVersion() returned V is still current for this
+     * switch as long as the returned value is not greater than V.
+     */
+    uint64_t getRulesVersion(uint64_t dpid) const;
+
+    /** @brief getRulesVersion(dpid) of every known switch. */
+    std::unordered_map<uint64_t, uint64_t> getRulesVersions() const;
+
+    /** @brief Size and update counters, for profiling the classifier on live tables.
+     *
+     * @details
+     * {"switches", "rules", "groups", "masks", "effects" (distinct rule effects), "subtables",
+     *  "rule_bytes" (estimated heap bytes of the writer's rules and subtables),
+     *  "compiled_bytes" (heap bytes of the published lookup tables), "bytes_per_rule",
+     *  "exact_match_cache": {"entries", "hits", "misses", "hit_rate"} over all switches,
+     *  "polls" (switch tables polled), "polls_skipped" (unchanged since their last poll),
+     *  "rules_parsed", "diff_changes" (FlowChanges applied by applyFlowDiffs()),
+     *  "flow_mods" (written through by applyFlowMods()),
+     *  "update_seconds" (spent on updates), "rules_parsed_per_second"}.
+     *
+     * Waits for a running update.
+     */
+    json statsJson() const;
+
+    /** @brief Estimated memory of the writer's rules, subtables, masks and effects, and of the
+     *         published lookup tables and exact-match caches, with the bytes per rule; for
+     *         utils::MemoryAccounting.
+     *
+     * Waits for a running update. A view still held by a reader is not counted.
+     */
+    utils::MemoryUsage memoryUsage() const;
+
   private:
     /** @brief Hidden implementation (defined in Classifier.cpp). */
     struct Impl;
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ndt_core/collection/FlowLinkUsageCollector.hpp" // for IngestRecord
+#include <atomic>                                          // for atomic
+#include <cstdint>                                         // for uint16_t, uint64_t
+#include <nlohmann/json.hpp>                               // for json
+#include <string>                                          // for string
+#include <vector>                                          // for vector
+
+#define CLUSTER_PORT 6344         // default port the coordinator receives the nodes' samples on
+#define CLUSTER_MESSAGE_SIZE 1400 // largest message a node sends (one UDP datagram)
+#define CLUSTER_MAGIC 0x4e445443  // "NDTC"
+#define CLUSTER_VERSION 2
+
+namespace sflow
+{
+
+/**
+ * @brief Role of this process in a collector cluster; both empty is a standalone collector.
+ *
+ * A node decodes the sFlow of the agents that send to it and forwards the decoded samples
+ * to the coordinator instead of applying them. The coordinator applies what its nodes send
+ * as if it had decoded it, next to the sFlow it receives itself, and serves the HTTP API.
+ * Agents are spread across the nodes by their sFlow collector setting.
+ */
+struct ClusterConfig
+{
+    std::string coordinator; // node: "host:port" of the coordinator
+    uint16_t listenPort = 0; // coordinator: UDP port of the nodes' messages; 0: not one
+};
+
+/**
+ * @brief Appends to @p out the messages carrying @p records, each at most
+ *        CLUSTER_MESSAGE_SIZE bytes.
+ *
+ * A message is a header (magic, version, record count, base time) and the records packed
+ * field by field in network order: 44 bytes per flow sample against the 100 to 200 of
+ * the sample in the sFlow datagram. Times travel as the system clock, offset from the base.
+ */
+void encodeClusterMessages(const std::vector<IngestRecord>& records,
+                           std::vector<std::string>& out);
+
+/**
+ * @brief Appends the records of one message to @p out, timed on this process' clocks.
+ *
+ * @return false, appending nothing, if the message is not a whole CLUSTER_VERSION message.
+ */
+bool decodeClusterMessage(const char* data, size_t length, std::vector<IngestRecord>& out);
+
+/**
+ * @brief Sends a node's decoded samples to the coordinator over UDP.
+ *
+ * send() is called by the ingest workers with their batches and sends right away on one
+ * connected socket, so nothing is queued; a message the socket refuses is counted and lost,
+ * as an sFlow datagram would be.
+ */
+class ClusterForwarder
+{
+  public:
+    explicit ClusterForwarder(std::string coordinator);
+    ~ClusterForwarder();
+
+    ClusterForwarder(const ClusterForwarder&) = delete;
+    ClusterForwarder& operator=(const ClusterForwarder&) = delete;
+
+    /// Resolve and connect to the coordinator; false if it cannot.
+    bool open();
+
+    /// Forward @p records. Thread-safe.
+    void send(const std::vector<IngestRecord>& records);
+
+    /// {"coordinator", "messages", "records", "bytes", "errors"}
+    nlohmann::json statsJson() const;
+
+  private:
+    std::string m_coordinator;
+    int m_fd = -1;
+
+    std::atomic<uint64_t> m_messages{0};
+    std::atomic<uint64_t> m_records{0};
+    std::atomic<uint64_t> m_bytes{0};
+    std::atomic<uint64_t> m_errors{0};
+};
+
+} // namespace sflow
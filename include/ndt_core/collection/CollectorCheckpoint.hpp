@@ -0,0 +1,108 @@
+#pragma once
+
+#include "common_types/SFlowType.hpp" // for FlowKey, FlowInfo, CounterInfo
+#include <cstdint>                    // for uint64_t, int64_t
+#include <nlohmann/json.hpp>          // for json
+#include <optional>                   // for optional
+#include <string>                     // for string
+#include <utility>                    // for pair
+#include <vector>                     // for vector
+
+#define CHECKPOINT_INTERVAL_MS 5000 // how often a running collector writes its checkpoint
+#define CHECKPOINT_MAX_AGE_MS 60000 // an older checkpoint is not restored
+#define CHECKPOINT_MAGIC 0x4e44544b // "NDTK"
+#define CHECKPOINT_VERSION 1
+
+namespace sflow
+{
+
+/**
+ * @brief When and against which topology a checkpoint was taken.
+ */
+struct CheckpointHeader
+{
+    int64_t savedSystemMs = 0;
+    int64_t savedSteadyMs = 0;
+    uint64_t topologyFingerprint = 0; // of the switches' addresses; 0 if none were known
+    bool delta = false; // only what changed since the previous one, removed flows listed
+};
+
+/**
+ * @brief What the checkpoints of a replication stream have covered so far; a default one
+ *        asks for everything.
+ */
+struct CheckpointCursor
+{
+    uint64_t flowVersion = 0;  // FlowLinkUsageCollector flow version
+    uint64_t rulesVersion = 0; // Classifier rules version of the tables sent last
+};
+
+/**
+ * @brief Builds a checkpoint of the collector in memory and writes it out in one go.
+ *
+ * The file is the header followed by tagged records in network order: flows (their rates,
+ * times, flags and per-agent counters, without the sample windows and paths, which the
+ * collector rebuilds), removed flows (deltas only), link counter reports, and the OpenFlow
+ * tables as CBOR. A CRC32 of everything before it ends the file, so a torn or truncated file
+ * is rejected as a whole. The same bytes are the state frames of StateReplicator.
+ *
+ * Not thread-safe; add*() are meant to be called under the lock of what they read.
+ */
+class CheckpointWriter
+{
+  public:
+    explicit CheckpointWriter(const CheckpointHeader& header);
+
+    void addFlow(const FlowKey& key, const FlowInfo& info);
+    void addRemovedFlow(const FlowKey& key);
+    void addCounter(uint64_t key, const CounterInfo& info);
+    /// Tables as DeviceConfigurationAndPowerManager::getOpenFlowTables() returns them.
+    void addRules(const nlohmann::json& tables);
+
+    /// The whole checkpoint, checksum included.
+    std::string finish() const;
+
+    /**
+     * @brief Write the checkpoint to @p path + ".tmp", sync it and rename it over @p path,
+     *        so @p path always holds a whole checkpoint.
+     *
+     * @return Bytes written, or 0 on failure (logged; @p path is left as it was).
+     */
+    size_t commit(const std::string& path);
+
+  private:
+    std::string m_buffer;
+};
+
+/**
+ * @brief Contents of a checkpoint file.
+ *
+ * Times are as saved: FlowInfo times on the system clock, CounterInfo report times on the
+ * steady clock of the process that saved them.
+ */
+struct Checkpoint
+{
+    CheckpointHeader header;
+    std::vector<std::pair<FlowKey, FlowInfo>> flows;
+    std::vector<FlowKey> removed;
+    std::vector<std::pair<uint64_t, CounterInfo>> counters;
+    nlohmann::json rules; // null if none were saved
+};
+
+/**
+ * @brief Decode a checkpoint from finish().
+ *
+ * @return std::nullopt if @p data is truncated, corrupt or of another CHECKPOINT_VERSION,
+ *         with @p error saying which.
+ */
+std::optional<Checkpoint> decodeCheckpoint(const std::string& data, std::string& error);
+
+/**
+ * @brief Read the checkpoint at @p path.
+ *
+ * @return std::nullopt if there is none, or it is truncated, corrupt or of another
+ *         CHECKPOINT_VERSION (logged).
+ */
+std::optional<Checkpoint> readCheckpoint(const std::string& path);
+
+} // namespace sflow
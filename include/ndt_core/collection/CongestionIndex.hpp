@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>  // for atomic
+#include <cstddef> // for size_t
+#include <cstdint> // for uint8_t, uint32_t
+#include <memory>  // for unique_ptr
+#include <mutex>   // for mutex
+#include <span>    // for span
+#include <vector>  // for vector
+
+#define CONGESTION_BUCKETS 101        // 1%-wide utilisation buckets, the last one holds >= 100%
+#define CONGESTION_HOTSPOT_PERCENT 80 // crossing it either way publishes LinkCongestionChanged
+
+/**
+ * @brief Edges bucketed by link utilisation, indexed by EdgeProperties::statsId.
+ *
+ * Each edge sits in the bucket of its integer utilisation percent. An update that keeps the
+ * edge in its bucket only reads one atomic; moving it takes the index lock and swaps it out
+ * of its old bucket in O(1). visitDescending() walks the buckets from the most utilised
+ * down, so the K most congested edges or those above a threshold cost the buckets holding
+ * them, not a scan and sort of every link. Edges within a bucket are in no particular order.
+ *
+ * Like LinkStatsTable, reset() must be called with the unique graph lock held; the other
+ * members are thread-safe.
+ */
+class CongestionIndex
+{
+  public:
+    using EdgeId = uint32_t;
+
+    /// Size the index for edge ids below @p edges, all at 0% utilisation.
+    void reset(size_t edges);
+
+    /**
+     * @brief Record @p utilization (percent) for edge @p id.
+     * @return True if the edge crossed CONGESTION_HOTSPOT_PERCENT, either way.
+     */
+    bool update(EdgeId id, double utilization);
+
+    /// Whether edge @p id is at or above CONGESTION_HOTSPOT_PERCENT.
+    bool isHotspot(EdgeId id) const;
+
+    /**
+     * @brief Call @p visit with the edges of each bucket, from the most utilised down to the
+     *        bucket of @p minUtilization, until it returns false.
+     *
+     * Each bucket is copied under the index lock and visited without it, so @p visit may
+     * read LinkStatsTable, whose modify() updates the index. An edge that changes bucket
+     * during the walk may be visited twice or not at all.
+     */
+    template <typename F>
+    void visitDescending(double minUtilization, F&& visit) const
+    {
+        std::vector<EdgeId> edges;
+        for (size_t bucket = CONGESTION_BUCKETS; bucket-- > bucketOf(minUtilization);)
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                edges.assign(m_buckets[bucket].begin(), m_buckets[bucket].end());
+            }
+            if (!edges.empty() && !visit(std::span<const EdgeId>(edges)))
+            {
+                return;
+            }
+        }
+    }
+
+    static size_t bucketOf(double utilization)
+    {
+        if (!(utilization > 0))
+        {
+            return 0;
+        }
+        return utilization >= CONGESTION_BUCKETS - 1 ? CONGESTION_BUCKETS - 1
+                                                     : static_cast<size_t>(utilization);
+    }
+
+    /// Bytes of the buckets and the per-edge positions.
+    size_t memoryBytes() const;
+
+  private:
+    mutable std::mutex m_mutex;
+    std::vector<EdgeId> m_buckets[CONGESTION_BUCKETS];
+    // Per edge: its bucket (read without the lock to skip no-op updates) and its position
+    // in that bucket
+    std::unique_ptr<std::atomic<uint8_t>[]> m_bucketOf;
+    std::vector<uint32_t> m_position;
+    size_t m_size = 0;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "common_types/GraphTypes.hpp" // for Graph
+#include <cstddef>                     // for size_t
+#include <cstdint>                     // for uint8_t, uint32_t, uint64_t
+#include <optional>                    // for optional
+#include <span>                        // for span
+#include <utility>                     // for pair
+#include <vector>                      // for vector
+
+/**
+ * @brief Compressed-sparse-row copy of a topology Graph for read-only scans and searches.
+ *
+ * The Graph keeps each out-edge list in a tree and every EdgeProperties carries a flow map
+ * and two IP vectors, so walking it chases a pointer per edge. Here the edges are numbered
+ * densely, grouped by source vertex and, within a vertex, ordered by target (the order of
+ * boost::out_edges()); the out-edges of vertex v are the ids [outBegin(v), outEnd(v)).
+ * Everything the analytics and path searches read lives in one array per field, indexed by
+ * vertex or edge id.
+ *
+ * Vertex ids are the Graph's vertex descriptors (vecS), so a vertex's other properties are
+ * one lookup in the Graph the view was built from; edgeDescriptor() leads back to an
+ * edge's. The view is immutable and never follows later changes of the Graph.
+ */
+class CsrGraph
+{
+  public:
+    using VertexId = uint32_t;
+    using EdgeId = uint32_t;
+
+    static constexpr EdgeId NO_EDGE = UINT32_MAX;
+
+    static CsrGraph build(const Graph& graph);
+
+    size_t vertexCount() const
+    {
+        return m_vertexDpid.size();
+    }
+
+    size_t edgeCount() const
+    {
+        return m_target.size();
+    }
+
+    /// Heap bytes of the arrays.
+    size_t memoryBytes() const;
+
+    // Vertices
+    uint64_t dpid(VertexId v) const
+    {
+        return m_vertexDpid[v];
+    }
+
+    bool isSwitch(VertexId v) const
+    {
+        return m_vertexFlags[v] & SWITCH;
+    }
+
+    bool vertexUsable(VertexId v) const // up and enabled
+    {
+        return (m_vertexFlags[v] & USABLE) == USABLE;
+    }
+
+    std::optional<VertexId> switchByDpid(uint64_t dpid) const; // first switch in vertex order
+
+    EdgeId outBegin(VertexId v) const
+    {
+        return m_outOffsets[v];
+    }
+
+    EdgeId outEnd(VertexId v) const
+    {
+        return m_outOffsets[v + 1];
+    }
+
+    // Edges ending at @p v, by increasing id
+    std::span<const EdgeId> inEdges(VertexId v) const
+    {
+        return {m_inEdges.data() + m_inOffsets[v], m_inEdges.data() + m_inOffsets[v + 1]};
+    }
+
+    // Edges
+    VertexId source(EdgeId e) const
+    {
+        return m_source[e];
+    }
+
+    VertexId target(EdgeId e) const
+    {
+        return m_target[e];
+    }
+
+    std::optional<EdgeId> findEdge(VertexId u, VertexId v) const;
+
+    EdgeId reverse(EdgeId e) const // the target -> source edge, or NO_EDGE
+    {
+        return m_reverse[e];
+    }
+
+    bool edgeUp(EdgeId e) const
+    {
+        return m_edgeFlags[e] & UP;
+    }
+
+    bool edgeUsable(EdgeId e) const // up and enabled
+    {
+        return (m_edgeFlags[e] & USABLE) == USABLE;
+    }
+
+    uint32_t srcInterface(EdgeId e) const
+    {
+        return m_srcInterface[e];
+    }
+
+    uint32_t dstInterface(EdgeId e) const
+    {
+        return m_dstInterface[e];
+    }
+
+    uint64_t linkBandwidth(EdgeId e) const
+    {
+        return m_linkBandwidth[e];
+    }
+
+    uint64_t linkBandwidthUsage(EdgeId e) const
+    {
+        return m_linkBandwidthUsage[e];
+    }
+
+    uint64_t leftBandwidth(EdgeId e) const
+    {
+        return m_leftBandwidth[e];
+    }
+
+    double utilization(EdgeId e) const
+    {
+        return m_utilization[e];
+    }
+
+    size_t flowCount(EdgeId e) const
+    {
+        return m_flowCount[e];
+    }
+
+    Graph::edge_descriptor edgeDescriptor(EdgeId e) const
+    {
+        return m_descriptor[e];
+    }
+
+  private:
+    enum Flags : uint8_t
+    {
+        UP = 1,
+        ENABLED = 2,
+        USABLE = UP | ENABLED,
+        SWITCH = 4,
+    };
+
+    std::vector<uint64_t> m_vertexDpid;
+    std::vector<uint8_t> m_vertexFlags;
+    std::vector<EdgeId> m_outOffsets; // vertexCount() + 1 entries
+    std::vector<EdgeId> m_inOffsets;  // vertexCount() + 1 entries
+    std::vector<EdgeId> m_inEdges;
+    std::vector<std::pair<uint64_t, VertexId>> m_switchByDpid; // sorted by dpid
+
+    std::vector<VertexId> m_source;
+    std::vector<VertexId> m_target;
+    std::vector<EdgeId> m_reverse;
+    std::vector<uint8_t> m_edgeFlags;
+    std::vector<uint32_t> m_srcInterface;
+    std::vector<uint32_t> m_dstInterface;
+    std::vector<uint64_t> m_linkBandwidth;
+    std::vector<uint64_t> m_linkBandwidthUsage;
+    std::vector<uint64_t> m_leftBandwidth;
+    std::vector<double> m_utilization;
+    std::vector<uint32_t> m_flowCount;
+    std::vector<Graph::edge_descriptor> m_descriptor;
+};
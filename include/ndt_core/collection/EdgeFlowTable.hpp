@@ -0,0 +1,166 @@
+#pragma once
+
+#include "common_types/GraphTypes.hpp" // for Graph, TimePoint
+#include "common_types/SFlowType.hpp"  // for FlowKey, FlowKeyHash
+#include <array>                       // for array
+#include <atomic>                      // for atomic
+#include <cstddef>                     // for size_t
+#include <cstdint>                     // for uint32_t, uint64_t, int64_t
+#include <memory>                      // for unique_ptr
+#include <set>                         // for set
+#include <shared_mutex>                // for shared_mutex
+#include <unordered_set>               // for unordered_set
+#include <vector>                      // for vector
+
+/**
+ * @brief Which flows were recently seen on each edge, indexed by EdgeProperties::statsId.
+ *
+ * Membership is tracked in generations instead of per-flow timestamps. The owner calls
+ * rotate() once per tick; each edge keeps one flow set per live generation, and a sighting
+ * puts its flow into the current generation's set. A flow not seen for GENERATIONS ticks
+ * drops out when its (oldest) set is cleared, so expiry is a per-edge set clear instead of a
+ * comparison per entry. With a 1s tick and 3 generations a flow leaves an edge 2-3s after
+ * its last sample.
+ *
+ * Locking: each edge has its own bucket lock. A flow already in the current generation
+ * only needs the shared bucket lock for its lookup; the first sighting per generation takes
+ * the unique one. Buckets catch up with the global generation lazily (on touch) or in
+ * rotate()'s sweep.
+ *
+ * Each vertex keeps the number of memberships on the edges ending at it, adjusted on every
+ * join and expiry, so the flows entering a switch are one read. A flow arriving over two
+ * edges counts twice, as it does when the edges' counts are added up.
+ *
+ * Like LinkStatsTable, reset() must be called with the unique graph lock held and every
+ * other member with at least the shared graph lock, so the bucket array stays in place.
+ */
+class EdgeFlowTable
+{
+  public:
+    using EdgeId = uint32_t;
+
+    static constexpr size_t GENERATIONS = 3;
+
+    /**
+     * @brief Drop all memberships and size the table for @p graph's edges.
+     */
+    void reset(const Graph& graph);
+
+    /**
+     * @brief Record that @p key was seen on edge @p id in the current generation.
+     * @return true if the flow was not on the edge before.
+     */
+    bool touch(EdgeId id, const sflow::FlowKey& key);
+
+    /**
+     * @brief Start a new generation and clear every edge's expired set.
+     * @return Number of memberships that expired in this tick.
+     */
+    size_t rotate(TimePoint now);
+
+    /**
+     * @brief Number of flows currently on edge @p id.
+     */
+    size_t count(EdgeId id) const;
+
+    std::set<sflow::FlowKey> flows(EdgeId id) const;
+
+    /**
+     * @brief Sum of count() over the edges ending at @p vertex (0 if unknown).
+     *
+     * Memberships that expired in the current tick are dropped once rotate() sweeps their
+     * edge.
+     */
+    uint64_t flowsInto(size_t vertex) const;
+
+    /**
+     * @brief Copy every edge's memberships into its EdgeProperties::flowSet.
+     *
+     * The last-seen time of each flow is the start of the generation it was last seen in.
+     */
+    void materialize(Graph& graph) const;
+
+    /**
+     * @brief Fill @p out (indexed by edge id) with the epoch of each edge's last membership
+     *        change. An edge whose stamp is greater than an epoch() read earlier changed
+     *        after that read.
+     */
+    void modifiedAt(std::vector<uint64_t>& out) const;
+
+    /**
+     * @brief Counter bumped whenever a flow joins or leaves an edge (not on refreshes).
+     */
+    uint64_t epoch() const
+    {
+        return m_epoch.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Memberships expired by the most recent rotate() (including lazy catch-ups).
+     */
+    uint64_t lastTickExpired() const
+    {
+        return m_lastTickExpired.load(std::memory_order_relaxed);
+    }
+
+    uint64_t totalExpired() const
+    {
+        return m_totalExpired.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Estimated heap bytes of the buckets and every edge's flow sets (each bucket
+     *        read under its shared lock).
+     */
+    size_t memoryBytes() const;
+
+  private:
+    using FlowSet = std::unordered_set<sflow::FlowKey, sflow::FlowKeyHash>;
+
+    struct alignas(64) Bucket
+    {
+        mutable std::shared_mutex mutex;
+        // Set of the generation g lives at index g % GENERATIONS
+        std::array<FlowSet, GENERATIONS> sets;
+        // Newest generation this bucket has been caught up to
+        uint64_t generation = 0;
+        // epoch() value of the last join or expiry on this edge
+        uint64_t modifiedAt = 0;
+        // Vertex the edge ends at, set by reset()
+        uint32_t target = 0;
+    };
+
+    /**
+     * @brief Clear the sets that fell out of the window ending at @p generation.
+     *
+     * Caller holds the bucket's unique lock. Returns the number of flows dropped.
+     */
+    static size_t catchUp(Bucket& bucket, uint64_t generation);
+
+    /**
+     * @brief True if the set at @p age generations behind the bucket is still live.
+     */
+    bool isLive(const Bucket& bucket, size_t age) const;
+
+    /**
+     * @brief Record a membership change on @p bucket (caller holds its unique lock).
+     */
+    void stamp(Bucket& bucket);
+
+    /**
+     * @brief Account @p n memberships dropped from @p bucket by catchUp().
+     */
+    void addExpired(const Bucket& bucket, size_t n);
+
+    std::unique_ptr<Bucket[]> m_buckets;
+    size_t m_size = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_flowsInto; // indexed by vertex
+    size_t m_vertexCount = 0;
+    std::atomic<uint64_t> m_generation{0};
+    // Start time (Clock ticks) of generation g, at index g % GENERATIONS
+    std::array<std::atomic<int64_t>, GENERATIONS> m_generationStart{};
+    std::atomic<uint64_t> m_epoch{0};
+    std::atomic<uint64_t> m_pendingExpired{0};
+    std::atomic<uint64_t> m_lastTickExpired{0};
+    std::atomic<uint64_t> m_totalExpired{0};
+};
@@ -1,19 +1,49 @@
 #pragma once
 
-#include "common_types/SFlowType.hpp" // for Path, CounterInfo, FlowInfo
-#include "utils/Utils.hpp"            // for DeploymentMode
-#include <atomic>                     // for atomic
-#include <cstdint>                    // for uint32_t
-#include <map>                        // for map
-#include <memory>                     // for shared_ptr
-#include <mutex>                      // for mutex
-#include <nlohmann/json.hpp>          // for json
-#include <shared_mutex>               // for shared_mutex
-#include <string>                     // for string
-#include <thread>                     // for thread
-#include <unordered_map>              // for unordered_map
-#include <utility>                    // for pair
-#include <vector>                     // for vector
+#include "common_types/SFlowType.hpp"                  // for Path, CounterInfo, FlowInfo
+#include "event_system/EventPayloads.hpp"              // for ElephantFlowEventData
+#include "ndt_core/collection/FlowPathCache.hpp"       // for FlowPathCache
+#include "ndt_core/collection/FlowRecordExporter.hpp"  // for FlowRecordExporter
+#include "ndt_core/collection/IngestFilter.hpp"        // for IngestFilterSpec
+#include "ndt_core/collection/LinkLivenessMonitor.hpp" // for LinkLivenessMonitor
+#include "ndt_core/collection/SFlowDecoder.hpp"        // for CounterSampleRecord, FlowSampleRecord
+#include "ndt_core/collection/TrafficMatrix.hpp"       // for TrafficMatrix
+#include "utils/CountMinSketch.hpp"                    // for CountMinSketch
+#include "utils/FlatHashMap.hpp"                       // for FlatHashMap
+#include "utils/MemoryAccounting.hpp"                  // for MemoryUsage
+#include "utils/MemoryPolicy.hpp"                      // for PolicyAllocator
+#include "utils/Metrics.hpp"                           // for Histogram
+#include "utils/RecyclePool.hpp"                       // for RecyclePool
+#include "utils/SpscRing.hpp"                          // for SpscRing
+#include "utils/TaskScheduler.hpp"                     // for TaskScheduler
+#include "utils/TimerWheel.hpp"                        // for TimerWheel
+#include "utils/Tracing.hpp"                           // for TraceId
+#include "utils/Utils.hpp"                             // for DeploymentMode
+#include <algorithm>                                   // for min
+#include <array>                                       // for array
+#include <atomic>                                      // for atomic
+#include <chrono>                                      // for steady_clock
+#include <condition_variable>                          // for condition_variable
+#include <cstdint>                                     // for uint32_t, uint64_t
+#include <deque>                                       // for deque
+#include <functional>                                  // for function
+#include <map>                                         // for map
+#include <memory>                                      // for shared_ptr
+#include <mutex>                                       // for mutex
+#include <nlohmann/json.hpp>                           // for json
+#include <optional>                                    // for optional
+#include <random>                                      // for mt19937, random_device
+#include <shared_mutex>                                // for shared_mutex
+#include <span>                                        // for span
+#include <string>                                      // for string
+#include <string_view>                                 // for string_view
+#include <thread>                                      // for thread
+#include <tuple>                                       // for tuple
+#include <unordered_map>                               // for unordered_map
+#include <unordered_set>                               // for unordered_set
+#include <utility>                                     // for pair
+#include <variant>                                     // for variant
+#include <vector>                                      // for vector
 
 class DeviceConfigurationAndPowerManager; // lines 48-48
 class EventBus;                           // lines 47-47
@@ -28,16 +58,210 @@ struct FlowKey;
 
 namespace sflow
 {
+class CheckpointWriter;
+class ClusterForwarder;
+class SamplingRateController;
+class TelemetrySegmentWriter;
+class UringReceiver;
+struct Checkpoint;
+struct CheckpointCursor;
+struct ClusterConfig;
+struct SamplingControlConfig;
 
+// Defaults of the runtime parameters "sflow.port", "sflow.buffer_bytes", "flow.idle_timeout_ms",
+// "flow.cold_after_ms", "sflow.recv_batch" and "sflow.rcvbuf_bytes" (utils::RuntimeConfig)
 #define SFLOW_PORT 6343
 #define BUFFER_SIZE 65535
 #define FLOW_IDLE_TIMEOUT 15000 // milliseconds
+#define FLOW_COLD_AFTER 5000    // milliseconds; 0 keeps every flow hot until it is purged
+#define SFLOW_RECV_BATCH_SIZE 32
+#define SFLOW_RECV_BATCH_MAX 1024
+#define SFLOW_RCVBUF_BYTES (4 << 20)
+#define FLOW_TABLE_SHARD_COUNT 16
+#define FLOW_POOL_MAX_IDLE_PER_SHARD 256 // recycled FlowInfo objects kept per shard
+#define FLOW_EXPIRY_TICK_MS 1000          // granularity of idle expiry (purge interval)
+#define FLOW_EXPIRY_WHEEL_SLOTS 32        // 32 s horizon, longer than FLOW_IDLE_TIMEOUT
+#define FLOW_DELTA_TOMBSTONES 4096        // purged flow keys kept for delta queries
+#define FLOW_TOPK_TRACKED 64              // fastest flows kept ranked for getTopKFlowInfoJson
+#define FLOW_TOPK_CANDIDATES 4            // per flow asked for, top-K candidates by periodic rate
+#define FLOW_QUERY_MAX_LIMIT 1000         // largest page queryFlowsJson() returns
+#define FLOW_PATH_RECHECK_MS 100          // path thread checks classifier/topology versions
+#define FLOW_PATH_WORKERS 4               // threads (and cache partitions) resolving paths
+#define FLOW_PATH_PARALLEL_MIN 2048       // smaller passes are resolved on the path thread
+#define FLOW_PATH_COMMIT_BATCH 256        // resolved paths committed per round of shard locks
+#define FLOW_ADMIT_FREE_FLOWS 4096        // per shard; up to it every new flow gets an entry
+#define FLOW_ADMIT_MIN_BYTES 262144       // beyond, a new flow needs this many estimated bytes
+#define FLOW_ADMIT_SKETCH_WIDTH 4096      // counters per row of a shard's admission sketch
+#define FLOW_ADMIT_SKETCH_DEPTH 4         // rows of a shard's admission sketch
+#define FLOW_TABLE_MAX_FLOWS 1048576      // default bound of the flow table (FlowTableLimits)
+#define FLOW_EVICTION_SAMPLES 8           // flows compared to pick one to evict
+#define FLOW_JSON_MAX_WORKERS 4           // threads serialising shards in getFlowInfoJsonText
+#define ELEPHANT_FLOW_HYSTERESIS 20        // % below MICE_FLOW_UNDER_THRESHOLD an elephant ends
+
+/**
+ * @brief Configuration of the sFlow receive path.
+ *
+ * With workerCount == 1 the collector opens a single UDP socket, as it always has.
+ * With workerCount > 1 every worker thread opens its own socket on SFLOW_PORT with
+ * SO_REUSEPORT, and the kernel spreads datagrams across them by hashing the sender
+ * address (so all datagrams of one agent land on the same worker).
+ *
+ * With ioUring each worker receives from its socket through a UringReceiver instead of
+ * poll() and recvmmsg(), and falls back to them where the build or the kernel lacks it.
+ *
+ * With kernelFilter the sockets carry a compileIngestFilter() program for the switches of
+ * the topology (re-attached when they change), dropping counter-only datagrams in MININET
+ * mode, where counter samples are ignored.
+ *
+ * With a captureInterface the workers read the datagrams from a PacketRingCapture on that
+ * interface instead of UDP sockets, spread by one PACKET_FANOUT_HASH group the same way.
+ */
+struct IngestConfig
+{
+    size_t workerCount = 1;
+    bool pinToCpu = false;      // pin worker i to CPU (i % hardware_concurrency)
+    std::vector<unsigned> cpus; // instead, pin worker i to cpus[i % cpus.size()]
+    // When > 0, each receive worker only decodes and pushes records into an SPSC ring of this
+    // many entries; a dedicated aggregator thread per worker applies them to the flow table.
+    // 0 keeps decode and apply inline on the receive thread.
+    size_t ringCapacity = 0;
+    bool ioUring = false;
+    bool kernelFilter = false;
+    std::string captureInterface; // empty: UDP sockets on SFLOW_PORT
+};
+
+/**
+ * @brief Which flow a full flow table shard evicts for a new one.
+ */
+enum class FlowEvictionPolicy
+{
+    LeastRecent, // the one with the oldest endTime
+    LowestRate,  // the one with the lowest FlowInfo::immediateRate()
+};
+
+/**
+ * @brief Bounds of the flow table, split evenly across its shards.
+ *
+ * The bound counts a shard's hot and cold flows together. A new flow arriving at a shard at
+ * its bound evicts the least recent of FLOW_EVICTION_SAMPLES cold flows if the shard has
+ * any, and otherwise one of FLOW_EVICTION_SAMPLES hot flows chosen by @c policy; both are
+ * taken from where the shard's previous eviction stopped. Elephant flows are never evicted:
+ * when all the compared flows are elephants the new flow is rejected.
+ * @c maxBytes is turned into a number of flows by the size of a table entry; agents beyond
+ * AGENT_STATS_INLINE per flow are not counted.
+ */
+struct FlowTableLimits
+{
+    size_t maxFlows = FLOW_TABLE_MAX_FLOWS; // 0: no bound on the count
+    size_t maxBytes = 0;                    // 0: no bound on the memory
+    FlowEvictionPolicy policy = FlowEvictionPolicy::LeastRecent;
+};
+
+/**
+ * @brief Key of the flow table entries.
+ */
+enum class FlowAggregation
+{
+    FiveTuple,  // one entry per 5-tuple (ICMP: type and code in place of the ports)
+    HostPair,   // one entry per (source, destination) address
+    PrefixPair, // one entry per (source prefix, destination prefix)
+};
+
+/**
+ * @brief How finely the flow table keeps flows.
+ *
+ * Aggregated entries have the ports and protocol of their key set to 0, which no sampled
+ * flow has, and the addresses masked to the prefix lengths (32 for HostPair). Rates, the
+ * elephant flags, admission and eviction work on the aggregate as on any flow; its path is
+ * that of the first 5-tuple sampled into it. With @c keepFiveTuple the table keeps both the
+ * 5-tuple entries and the aggregates, and only the former touch the links' flow sets.
+ */
+struct FlowAggregationConfig
+{
+    FlowAggregation mode = FlowAggregation::FiveTuple;
+    uint8_t srcPrefixLength = 24; // PrefixPair only
+    uint8_t dstPrefixLength = 24;
+    bool keepFiveTuple = false;
+};
+
+/**
+ * @brief Filter of FlowLinkUsageCollector::visitFlows() and queryFlowsJson().
+ *
+ * Unset members match every flow; set members must all match. Addresses are in network
+ * order and prefix masks follow utils::prefixToMaskHost().
+ */
+struct FlowQuery
+{
+    std::optional<std::pair<uint32_t, uint8_t>> srcPrefix; // (address, prefix length)
+    std::optional<std::pair<uint32_t, uint8_t>> dstPrefix;
+    std::optional<uint8_t> protocol;
+    std::optional<uint16_t> srcPort;
+    std::optional<uint16_t> dstPort;
+    std::optional<uint16_t> port;                      // either the source or destination port
+    std::optional<bool> elephant;                      // by FlowInfo::immediateRate()
+    uint64_t minRateBps = 0;                           // FlowInfo::immediateRate().bps
+    std::optional<uint64_t> dpid;                      // flowPath passes this switch
+    std::optional<std::pair<uint64_t, uint64_t>> edge; // flowPath has this (src, dst) hop
+
+    bool matches(const FlowKey& key, const FlowInfo& info) const;
+};
+
+/**
+ * @brief When a datagram arrived, on both clocks the flow table uses.
+ *
+ * Taken from the kernel's receive timestamp (SO_TIMESTAMPNS) when there is one, translated
+ * to the steady clock through one pair of clock reads per recvmmsg batch; otherwise both
+ * are that batch's reads. Every sample of the datagram shares it.
+ */
+struct IngestTime
+{
+    int64_t steadyMs = 0; // utils::getCurrentTimeMillisSteadyClock() scale
+    int64_t systemMs = 0; // utils::getCurrentTimeMillisSystemClock() scale
+};
+
+/**
+ * @brief A decoded sample handed from a receive worker to its aggregator.
+ */
+struct IngestRecord
+{
+    uint32_t agentIp = 0;
+    std::variant<CounterSampleRecord, FlowSampleRecord> sample;
+    IngestTime time;
+};
+
+/**
+ * @brief Receive counters of one ingest worker.
+ *
+ * Updated by the owning worker only; read concurrently by getIngestStatsJson() and
+ * appendMetrics().
+ */
+struct IngestWorkerStats
+{
+    std::atomic<uint64_t> datagramsReceived{0};
+    std::atomic<uint64_t> bytesReceived{0};
+    std::atomic<uint64_t> datagramsTruncated{0};
+    std::atomic<uint64_t> kernelDrops{0}; // cumulative SO_RXQ_OVFL count of the socket
+    std::atomic<uint64_t> ringOverflows{0}; // records dropped because the ring was full
+    std::atomic<uint64_t> recordsApplied{0};
+    std::atomic<uint64_t> flowSamplesApplied{0};
+    std::atomic<uint64_t> flowShardLocks{0}; // flowSamplesApplied / flowShardLocks = batching
+    std::atomic<uint64_t> flowSamplesDecoded{0};
+    std::atomic<uint64_t> counterSamplesDecoded{0};
+    std::atomic<uint64_t> malformedDatagrams{0}; // not sFlow v5, or cut short
+    std::atomic<uint64_t> sampleErrors{0};       // truncated samples and unknown sample types
+    utils::Histogram* decodeLatency = nullptr;   // handlePacket() per datagram
+
+    // Flow samples per agent since the last sampling control step; only kept when the
+    // sampling control is on
+    std::mutex agentSamplesMutex;
+    std::unordered_map<uint32_t, uint64_t> agentFlowSamples;
+};
 
 /**
  * @brief Collects sFlow samples and derives per-flow / per-link usage and paths.
  *
  * FlowLinkUsageCollector listens for sFlow datagrams (flow samples + counter samples),
- * maintains an in-memory flow table (m_flowInfoTable) and per-interface counter snapshots
+ * maintains an in-memory flow table (m_flowInfoShards) and per-interface counter snapshots
  * (m_counterReports), and periodically computes average sending rates and other statistics.
  *
  * It also maintains a (src,dst) -> Path mapping and switch-count metadata, and can refresh
@@ -45,7 +269,10 @@ namespace sflow
  *
  * Concurrency:
  *  - start()/stop() control background threads.
- *  - m_flowInfoTable is protected by a shared mutex (readers/writers).
+ *  - the flow table is split into FLOW_TABLE_SHARD_COUNT shards, each protected by its
+ *    own shared mutex (readers/writers); readers iterate shard by shard.
+ *  - handlePacket() may run on several ingest workers at once; m_counterReports is
+ *    guarded by m_counterReportsMutex.
  *  - counter report map and IF-index mapping are updated internally; callers should treat
  *    returned data as snapshots.
  *
@@ -67,37 +294,360 @@ class FlowLinkUsageCollector
     /**
      * @brief Start sFlow reception and background maintenance threads.
      *
-     * Creates/opens the UDP socket (SFLOW_PORT) and launches worker threads:
-     *  - packet receive loop
+     * Launches worker threads:
+     *  - packet receive loop(s), one per IngestConfig::workerCount, each owning a UDP
+     *    socket on SFLOW_PORT
      *  - periodic average-rate calculation
      *  - idle-flow purge loop
      *  - optional debug/testing tasks (if enabled)
      *
+     * Reads its runtime parameters first (utils::RuntimeConfig): the port and receive buffer
+     * size apply from here on; the receive batch, socket buffer and idle timeout also
+     * change live.
      */
     void start();
+    /**
+     * @brief Configure the number of sFlow receive workers.
+     *
+     * Must be called before start(); later calls have no effect on running workers.
+     *
+     * @param config Worker count (0 is treated as 1) and CPU pinning policy.
+     */
+    void setIngestConfig(const IngestConfig& config);
+    /**
+     * @brief Export a record of every purged flow as configured (see FlowRecordExporter).
+     *
+     * Must be called before start(); an empty config leaves export off.
+     */
+    void setFlowExportConfig(const FlowExportConfig& config);
+    /**
+     * @brief Publish links, top flows and the traffic matrix to the shared-memory segment
+     *        @p name at every rate tick (see telemetry::Segment).
+     *
+     * Must be called before start(); an empty name leaves it off.
+     */
+    void setTelemetrySegment(const std::string& name);
+    /**
+     * @brief Adapt the agents' sampling rates to the collector's sample budget as
+     *        configured (see SamplingRateController).
+     *
+     * Must be called before start(); a zero maxSamplesPerSecond leaves it off.
+     */
+    void setSamplingControl(const SamplingControlConfig& config);
+    /**
+     * @brief Take part in a collector cluster (see ClusterConfig): as a node, decoded samples
+     *        go to the coordinator instead of the flow table; as the coordinator, the nodes'
+     *        samples are received and applied as well.
+     *
+     * Must be called before start(). A node that cannot reach its coordinator at start()
+     * applies its samples itself.
+     */
+    void setClusterConfig(const ClusterConfig& config);
+    /**
+     * @brief Checkpoint the collector to @p path every CHECKPOINT_INTERVAL_MS and at stop(),
+     *        and restore it at start() (see CollectorCheckpoint).
+     *
+     * The flows, their rates and per-agent counters come back if they have not gone idle
+     * meanwhile. The OpenFlow tables (into the classifier, so paths resolve before the first
+     * poll) and the link counter reports (so the first counter sample of a link yields a
+     * rate) only come back if the switches of the topology are those of the checkpoint.
+     * Nothing is restored from a checkpoint older than CHECKPOINT_MAX_AGE_MS. Must be called
+     * before start(); an empty path leaves it off.
+     */
+    void setCheckpointPath(const std::string& path);
+    /**
+     * @brief Bound the flow table (see FlowTableLimits). Must be called before start().
+     */
+    void setFlowTableLimits(const FlowTableLimits& limits);
+    /**
+     * @brief Set the flow table's granularity (see FlowAggregationConfig). Must be called
+     *        before start().
+     */
+    void setFlowAggregation(const FlowAggregationConfig& config);
+    /**
+     * @brief Merge the pure ACKs of a TCP connection into the flow of the opposite direction
+     *        (FlowInfo::reverseAckBytes/Packets) instead of giving them an entry, a rate and
+     *        a path of their own. Both directions of a connection map to one shard, so the
+     *        data flow is found under the same lock. Must be called before start().
+     */
+    void setBidirectionalFlows(bool enabled);
+    /**
+     * @brief Count a flow's samples only at the first switch of its path once that is known.
+     *
+     * Every switch on a path samples the flow, so without this each hop's samples update the
+     * flow's counters and the links' flow sets, and the rates are averaged over the hops.
+     * With it, samples from other switches only keep the flow alive, and the flow's links
+     * are touched from its resolved path once per rate tick instead of once per sample.
+     * Flows without a path yet, and aggregated flows, keep counting every hop. Must be
+     * called before start().
+     */
+    void setFirstHopSampling(bool enabled);
+    /// Confine the path resolution thread to @p cpus (none: any). Must be called before start().
+    void setPathThreadCpus(std::vector<unsigned> cpus);
+    /**
+     * @brief Switch the periodic rate estimation between full and incremental sweeps.
+     *
+     * The full sweep visits every flow of every shard once per second under the shard lock.
+     * The incremental sweep only visits flows that received samples during the last interval
+     * (plus, once more, flows that just went quiet so their per-agent rates drop to zero),
+     * and computes their rates from a snapshot taken under the lock, outside of it. Both modes
+     * produce the same rates. May be changed at any time.
+     */
+    void setIncrementalRateEstimation(bool enabled);
+    /**
+     * @brief Return per-worker receive/drop counters as JSON.
+     *
+     * Each array element contains worker id, datagrams/bytes received, truncated
+     * datagrams and kernel socket drops (SO_RXQ_OVFL). When the decoupled pipeline is
+     * enabled it also reports ring occupancy/capacity and ring overflows. samples_per_lock
+     * is the average number of flow samples applied per flow-table shard lock.
+     */
+    nlohmann::json getIngestStatsJson() const;
+
+    /**
+     * @brief The in-kernel filter of the sFlow sockets (IngestConfig::kernelFilter):
+     *        {"enabled", "agents" (0: every agent), "drop_counter_only", "instructions",
+     *        "sockets", "updates", "attach_failures"}. What it drops is counted in the
+     *        workers' kernel_drops.
+     */
+    nlohmann::json getIngestFilterStatsJson() const;
+
+    /**
+     * @brief The adaptive sampling rate control: {"enabled"} and, when enabled, the fields of
+     *        SamplingRateController::statsJson().
+     */
+    nlohmann::json getSamplingControlStatsJson() const;
+
+    /**
+     * @brief Appends the ingest counters of every worker and the flow table size to @p out, in
+     *        the Prometheus text format (see utils::MetricsRegistry).
+     */
+    void appendMetrics(std::string& out) const;
+
+    /**
+     * @brief FlowInfo recycling statistics summed over all flow table shards.
+     *
+     * New flows take a FlowInfo recycled from a purged flow when one is available, so the
+     * buffers it owns are reused. Reports parked objects, acquisitions, how many of them were
+     * served from the pool (reuse_rate = reused / acquired), and purged objects recycled or
+     * dropped because the pool was full.
+     */
+    nlohmann::json getFlowPoolStatsJson() const;
+
+    /**
+     * @brief Flow table admission statistics summed over all shards.
+     *
+     * A shard holding FLOW_ADMIT_FREE_FLOWS flows is "engaged": a sample of a flow it does not
+     * know only adds its estimated bytes (frame length times sampling rate) to the shard's
+     * Count-Min sketch, and the flow gets an entry once the sketch, halved every purge tick,
+     * reaches FLOW_ADMIT_MIN_BYTES for it. Reports the engaged shards, the samples and
+     * estimated bytes held back that way, the flows promoted and the sketches' memory, and
+     * the FlowTableLimits bound per shard with the flows evicted and rejected at it.
+     */
+    nlohmann::json getFlowAdmissionStatsJson() const;
+
+    /**
+     * @brief Hot and cold flow counts summed over all shards.
+     *
+     * A flow without samples for flow.cold_after_ms (but not yet flow.idle_timeout_ms) is
+     * demoted by the purge task to a compact cold record: its periodic rates, times and path,
+     * without the per-agent counters and rate windows. Its next sample promotes it back to a
+     * full entry. Queries list cold flows like the others, with immediate rates of zero.
+     * Reports both counts, the bytes of their tables, and the demotions and promotions.
+     */
+    nlohmann::json getFlowTierStatsJson() const;
+
+    /**
+     * @brief Estimated memory of the flow tables and the collector's other large containers
+     *        (path index, path pool, caches, queues, ingest rings), with the bytes per flow
+     *        over hot and cold flows; for utils::MemoryAccounting.
+     *
+     * Walks the flows of each shard under its shared lock, for their per-agent overflow.
+     */
+    utils::MemoryUsage memoryUsage();
+
+    /**
+     * @brief The traffic matrix of the flows' periodic rates (see TrafficMatrix), updated at
+     *        each rate tick from the flows whose rate changed. Counts the aggregate entries
+     *        when only those are kept, and only the 5-tuple ones when both are.
+     */
+    const TrafficMatrix& trafficMatrix() const
+    {
+        return m_trafficMatrix;
+    }
+
+    /**
+     * @brief FlowRecordExporter statistics, or null when export is off.
+     */
+    nlohmann::json getFlowExportStatsJson() const;
+    /**
+     * @brief TelemetrySegmentWriter statistics, or null when the segment is off.
+     */
+    nlohmann::json getTelemetrySegmentStatsJson() const;
+    /**
+     * @brief The data-plane link failure detector: LinkLivenessMonitor::statsJson() plus
+     *        {"apply", "applied", "restored"}, or null in MININET mode.
+     */
+    nlohmann::json getLinkLivenessStatsJson() const;
+    /**
+     * @brief {"node": ClusterForwarder::statsJson() or null, "coordinator": {"port",
+     *        "messages", "bytes", "malformed", "records"} or null}.
+     */
+    nlohmann::json getClusterStatsJson() const;
+    /**
+     * @brief {"path", "writes", "failures", "bytes" (of the last write), "restored": {"age_ms",
+     *        "flows", "counters", "rules"} or null}, or null when checkpointing is off.
+     */
+    nlohmann::json getCheckpointStatsJson() const;
+    /**
+     * @brief Hit, miss and invalidation counters of the flow path cache (FlowPathCache),
+     *        summed over its FLOW_PATH_WORKERS partitions.
+     */
+    nlohmann::json getPathCacheStatsJson() const;
+    /**
+     * @brief Size, memory and update counters of the classifier the paths are traced with
+     *        (ndtClassifier::Classifier::statsJson()).
+     */
+    nlohmann::json getClassifierStatsJson() const;
     /**
      * @brief Stop all worker threads and close the sFlow socket.
      *
-     * Signals threads to exit (m_running=false), joins them, and releases socket resources.
+     * Signals threads to exit (m_running=false) and joins them, and cancels the periodic
+     * tasks; receive workers close their own sockets on exit.
      * Safe to call during shutdown.
      */
     void stop();
 
-    // TODO: Prevent to get the whole flow table
     /**
      * @brief Return a snapshot of the current flow table.
      *
      * The returned map is a copy of internal state, keyed by FlowKey with FlowInfo values.
-     * Intended for external consumers (e.g., REST handlers) to query current flow statistics.
      *
-     * @note Copying the whole table can be expensive for large workloads.
-     *       Consider adding query filters or a "top-K" interface for production use.
+     * @note Copying the whole table can be expensive for large workloads. Prefer
+     *       visitFlows() or queryFlowsJson(), which only touch the matching flows.
      */
     std::unordered_map<FlowKey, FlowInfo, FlowKeyHash> getFlowInfoTable();
 
+    /**
+     * @brief Called for each matching flow; return false to stop the scan.
+     */
+    using FlowVisitor = std::function<bool(const FlowKey&, const FlowInfo&)>;
+
+    /**
+     * @brief Run @p visitor on every flow matching @p query, in no particular order.
+     *
+     * The visitor runs under the shared lock of the flow's shard and sees the live entry,
+     * so nothing is copied; it must not call back into the collector or keep references.
+     *
+     * @return Number of matching flows visited.
+     */
+    size_t visitFlows(const FlowQuery& query, const FlowVisitor& visitor) const;
+
+    /**
+     * @brief One page of the flows matching @p query, in the getFlowInfoJson() format.
+     *
+     * Returns {"flows": [...], "next_cursor": string|null}. Pass "next_cursor" back as
+     * @p cursor (empty for the first page) to continue; null means the scan is complete.
+     * Pages are ordered by shard and flow key, so flows added or purged between pages do
+     * not shift the ones not yet returned. @p limit is clamped to [1, FLOW_QUERY_MAX_LIMIT].
+     *
+     * @throws std::invalid_argument if @p cursor is malformed.
+     */
+    nlohmann::json queryFlowsJson(const FlowQuery& query,
+                                  std::string_view cursor,
+                                  size_t limit) const;
+
+    /**
+     * @brief Every flow, as a JSON array of the objects flowInfoToJson() builds.
+     *
+     * Each shard is copied into compact records under its shared lock and formatted after
+     * the lock is released, so ingest waits for a copy of the shard, not for JSON building.
+     */
     nlohmann::json getFlowInfoJson();
+
+    /**
+     * @brief getFlowInfoJson().dump(), without building the DOM of the whole table.
+     *
+     * Shards are claimed by up to FLOW_JSON_MAX_WORKERS threads (the calling one included);
+     * each copies a shard like getFlowInfoJson() and serialises it into its own fragment,
+     * and the fragments are joined in shard order.
+     */
+    std::string getFlowInfoJsonText() const;
+
+    /**
+     * @brief Version of the flow table, for ETags and delta queries.
+     *
+     * Advances only when a flow was added, changed or purged since the previous call, so
+     * two calls returning the same value mean the table content did not change in between.
+     */
+    uint64_t publishFlowVersion();
+
+    /**
+     * @brief Flows that changed since version @p since (a value from an earlier response).
+     *
+     * Returns {"version", "full", "flows", "removed"}: "flows" lists flows (in the
+     * getFlowInfoJson() format) added or changed at or after @p since and "removed" the keys
+     * purged since then. When @p since is too old to answer from the remembered purges
+     * (FLOW_DELTA_TOMBSTONES), "full" is true and "flows" holds the whole table.
+     * A flow may be reported again in the next delta; clients should upsert.
+     */
+    nlohmann::json getFlowInfoDeltaJson(uint64_t since);
+
+    /**
+     * @brief Encode the state that changed since @p cursor as a checkpoint and advance
+     *        @p cursor past it, for a hot standby (StateReplicator).
+     *
+     * A delta holds the flows changed and removed as getFlowInfoDeltaJson() reports them, all
+     * link counter reports, and the OpenFlow tables if the classifier's rules changed. A
+     * default or too old @p cursor gets a full checkpoint instead.
+     */
+    CheckpointWriter encodeState(CheckpointCursor& cursor);
+    /**
+     * @brief Apply a checkpoint a primary's encodeState() made: its flows replace ours (a
+     *        full one also drops the flows it does not list) and its removed flows are purged.
+     *
+     * Paths are resolved here, against the replicated rules. Thread-safe.
+     */
+    void applyReplicatedState(Checkpoint& state);
+
+    /**
+     * @brief Flows whose resolved path leaves switch @p dpid through @p port, i.e. crosses
+     *        the edge starting there.
+     *
+     * Answered from a reverse index the path thread keeps next to each flow's flowPath, so
+     * the cost follows the number of affected flows. The flows are queued for path
+     * re-resolution and the path thread is woken; their current paths stay until then.
+     * With a failover @p trace, the pass that re-resolves them records its path_computation
+     * span, from now until the pass is done.
+     */
+    std::vector<FlowKey> invalidatePathsThrough(uint64_t dpid,
+                                                uint32_t port,
+                                                utils::TraceId trace = {});
+
+    /**
+     * @brief The @p k flows with the highest immediate sending rate, fastest first.
+     *
+     * With the immediate-rate sweep on (runtime parameter flow_rates.immediate_sweep), it
+     * keeps the FLOW_TOPK_TRACKED fastest flows ranked, so for k up to that bound only the
+     * ranked flows are looked up. Otherwise (or for larger k, or a ranking that lost too many
+     * flows to purges) the k * FLOW_TOPK_CANDIDATES fastest flows by periodic rate are
+     * evaluated with getImmediateRates() and ranked.
+     */
     nlohmann::json getTopKFlowInfoJson(int k);
 
+    /**
+     * @brief Immediate rate of flow @p key, evaluated now from its packetQueue windows under
+     *        its shard's read lock; nullopt for an unknown flow.
+     */
+    std::optional<ImmediateRate> getImmediateRate(const FlowKey& key) const;
+
+    /**
+     * @brief getImmediateRate() of each of @p keys, in their order, taking every shard's
+     *        read lock at most once.
+     */
+    std::vector<std::optional<ImmediateRate>> getImmediateRates(
+        std::span<const FlowKey> keys) const;
+
     /**
      * @brief Replace the entire (src,dst)->Path map using a vector of paths.
      *
@@ -136,38 +686,513 @@ class FlowLinkUsageCollector
      * @return Map from (srcIp,dstIp) to switch count.
      */
     std::map<std::pair<uint32_t, uint32_t>, size_t> getAllSwitchCounts();
+    /**
+     * @brief Residual bandwidth of the known path of each (srcIp, dstIp) of @p ipPairs, as
+     *        TopologyAndFlowMonitor::getPathResiduals() gives it; nullopt if the pair has no
+     *        known path.
+     */
+    std::vector<std::optional<uint64_t>> getHostPairResiduals(
+        const std::vector<std::pair<uint32_t, uint32_t>>& ipPairs);
 
+    /**
+     * @brief Known path of each (source, destination) host of @p pairs, in order.
+     *
+     * Hosts are device names, or dotted IPv4 addresses for hosts without one. Names and the
+     * switches' names are resolved through the topology index and the pairs looked up in the
+     * published host pair table, with no copy of the graph or of the table, whatever the
+     * number of pairs.
+     *
+     * @return One entry per pair: {"source_host", "destination_host", "switch_path" (switch
+     *         names), "switch_count"}, or {"source_host", "destination_host", "error",
+     *         "missing_hosts"?}.
+     */
+    json getPathsBetweenHostsJson(
+        const std::vector<std::pair<std::string, std::string>>& pairs);
+    /// getPathsBetweenHostsJson() for one pair.
     json getPathBetweenHostsJson(const std::string& srcHostName, const std::string& dstHostName);
 
   private:
     inline std::string ourIpToString(uint32_t ipFront, uint32_t ipBack);
-    inline uint32_t ipFromFrontBack(uint32_t ipFront, uint32_t ipBack);
+    // One tick of the periodic rate estimation (rate task)
     void calAvgFlowSendingRatesPeriodically();
+    struct FlowTableShard;
+    /**
+     * @brief Scratch buffers of the periodic rate sweeps, reused across ticks.
+     *
+     * The counters of each (flow, agent) pair a sweep takes go to one slot of the arrays
+     * below, a flow's agents in consecutive slots, so the per-agent rates of a whole shard
+     * are one vectorised pass over contiguous memory (utils::counterRates()).
+     */
+    struct RateScratch
+    {
+        struct Flow
+        {
+            FlowKey key;
+            int64_t startTime;
+            size_t agentBegin; // first slot
+            size_t agentCount;
+            uint64_t flowRate = 0;
+            uint64_t packetRate = 0;
+            int hops = 0;
+        };
+        std::vector<FlowKey> keys;
+        std::vector<Flow> flows;
+        // Per slot: summed ingress and egress counters, and the rates computed from them
+        std::vector<uint64_t> bytesCurrent;
+        std::vector<uint64_t> bytesPrevious;
+        std::vector<uint64_t> packetsCurrent;
+        std::vector<uint64_t> packetsPrevious;
+        std::vector<uint32_t> samplingRates; // 1 for agents that reported none
+        std::vector<uint64_t> byteRates;     // bits per second
+        std::vector<uint64_t> packetRates;
+
+        // Drop the flows and slots; keys and capacity stay
+        void clear();
+        size_t slots() const
+        {
+            return samplingRates.size();
+        }
+    };
+    // @p followUps: flows with a non-zero per-agent rate after the previous tick (either
+    // sweep); replaced by this tick's ones on return
+    void estimateShardRatesIncrementally(FlowTableShard& shard,
+                                         std::vector<FlowKey>& followUps,
+                                         RateScratch& scratch);
+    void estimateShardRatesFully(FlowTableShard& shard,
+                                 std::vector<FlowKey>& followUps,
+                                 RateScratch& scratch);
+    // Append the flow and slots of @p info's counters to @p scratch and roll the counters
+    // over (shard lock held)
+    static void takeRateCounters(const FlowKey& key, FlowInfo& info, RateScratch& scratch);
+    // Rates of every slot, the flows' totals, and their keys still moving into @p followUps
+    static void computeRates(RateScratch& scratch, std::vector<FlowKey>& followUps);
+    // Store the rates of @p flow into @p info, its flow entry (rate task, shard lock held)
+    void applyRates(const RateScratch::Flow& flow, FlowInfo& info, const RateScratch& scratch);
+    // Queue the traffic matrix change of @p key's periodic rate going from @p from to @p to
+    // (rate task, shard lock held)
+    void noteRateChange(const FlowKey& key, uint64_t from, uint64_t to);
+    // Queue the elephant transition of @p key, if its new periodic rate crossed
+    // MICE_FLOW_UNDER_THRESHOLD or fell ELEPHANT_FLOW_HYSTERESIS % below it (rate task, shard
+    // lock held)
+    void noteElephantState(const FlowKey& key, FlowInfo& info);
+    // Publish the transitions queued by this tick (rate task, no shard lock held)
+    void publishElephantTransitions();
+    // Rewrite the shared-memory telemetry segment (rate task)
+    void publishTelemetrySegment();
+    bool inTrafficMatrix(const FlowKey& key) const;
+    // Drop the shard's pending-update queue after a full sweep covered it (lock held)
+    void clearPendingRateUpdates(FlowTableShard& shard);
     void calAvgFlowSendingRatesImmediately();
+    // (immediate rate, key); ordered so that std::greater puts the fastest flow first
+    using RankedFlow = std::pair<uint64_t, FlowKey>;
+    // The k fastest flows by immediate rate, fastest first, out of the k *
+    // FLOW_TOPK_CANDIDATES fastest by periodic (or last swept immediate) rate
+    std::vector<RankedFlow> selectTopKFlows(size_t k) const;
+    // One call of the randomly timed rate test, a whole-table immediate-rate sweep when
+    // flow_rates.immediate_sweep is on; schedules its next call
     void testCalAvgFlowSendingRatesRandomly();
-    void run();
-    void handlePacket(char* buffer);
+    void run(size_t workerId);
+    void aggregate(size_t workerId);
+    int openIngestSocket(bool reusePort, uint16_t port = SFLOW_PORT);
+    // Coordinator: receive and apply the records of the cluster's nodes
+    void receiveFromNodes();
+    // Write m_checkpointPath (scheduled task, and stop())
+    void writeCheckpoint();
+    // Load m_checkpointPath into the flow table, counter reports and classifier (start())
+    void restoreCheckpoint();
+    struct AppliedState
+    {
+        size_t flows = 0;
+        size_t removed = 0;
+        size_t counters = 0;
+        size_t rules = 0;
+        bool topologyMatched = false;
+    };
+    // Load @p state, overwriting flows we have if @p replace (else they are kept)
+    AppliedState applyCheckpoint(Checkpoint& state, bool replace);
+    // Hash of the switches' addresses, 0 while there are none
+    uint64_t topologyFingerprint() const;
+    // Read the parameters of start() and take their later changes (RuntimeConfig)
+    void defineRuntimeParameters();
+    int64_t flowIdleTimeout() const
+    {
+        return m_flowIdleTimeoutMs.load(std::memory_order_relaxed);
+    }
+    // Idle time after which a hot flow is due for demotion, or for purging if that comes first
+    int64_t flowHotTimeout() const
+    {
+        const int64_t coldAfter = m_flowColdAfterMs.load(std::memory_order_relaxed);
+        return coldAfter != 0 ? std::min(coldAfter, flowIdleTimeout()) : flowIdleTimeout();
+    }
+    // Sockets of run() get the current ingest filter and later updates of it
+    void registerIngestSocket(int sockfd);
+    void unregisterIngestSocket(int sockfd);
+    // Recompile the ingest filter if the switches changed (scheduled task)
+    void refreshIngestFilter();
+    bool attachIngestFilter(int sockfd); // m_ingestFilterMutex held
+    // Hand the last period's per-agent flow samples to m_samplingController (scheduled task)
+    void controlSampling();
+    // Flows on the link of port (@p agentIp, @p ifIndex), 0 if it has no link
+    size_t linkFlowCount(uint32_t agentIp, uint32_t ifIndex) const;
+    // Look for ports whose counter samples stopped (scheduled task)
+    void sweepLinkLiveness();
+    /**
+     * @brief Publish the failures m_linkLiveness found as LinkFailureDetected events, setting
+     *        the link down when "link_liveness.apply" is on and the confidence reaches
+     *        LINK_LIVENESS_APPLY_CONFIDENCE, and bring back up the links it set down once
+     *        their port recovers.
+     */
+    void handleLinkTransitions(const std::vector<LinkLivenessMonitor::Transition>& transitions);
+    // Receive loop of run() over io_uring; returns when stopped or if the kernel cannot
+    void receiveWithUring(size_t workerId, UringReceiver& receiver);
+    // Receive loop of run() over a PacketRingCapture
+    void captureFromRing(size_t workerId);
+    void handlePacket(const char* buffer,
+                      size_t length,
+                      size_t workerId,
+                      const IngestTime& time,
+                      std::vector<IngestRecord>& batch);
+
+    /**
+     * @brief A flow sample resolved to its flow-table key, ready to be applied.
+     */
+    struct PreparedFlowSample
+    {
+        FlowKey key;       // of the table entry, aggregated or not
+        FlowKey sampleKey; // 5-tuple of the sample
+        AgentKey agentKey;
+        size_t shard;
+        uint32_t frameLength;
+        uint32_t samplingRate;
+        bool isIngress;
+        bool isAck;
+        bool isPureAck;
+        IngestTime time;
+        bool admitted = true; // false if the flow table held it back (see updateFlowInfo())
+        bool touchesEdges = true;
+    };
+
+    /**
+     * @brief Apply a batch of decoded records, taking each flow-table shard lock once.
+     *
+     * Flow samples are grouped by shard and applied under a single acquisition per shard;
+     * counter samples go through applyCounterSamples() together. A cluster node forwards
+     * them to its coordinator instead. Clears @p records.
+     */
+    void applyRecords(std::vector<IngestRecord>& records, IngestWorkerStats& stats);
+
+    // Link counters derived from one counter sample, for TopologyAndFlowMonitor::updateLinkInfo()
+    struct LinkCounterUpdate
+    {
+        std::pair<uint32_t, uint32_t> agentIpAndPort;
+        uint64_t leftIn;
+        uint64_t leftOut;
+        uint64_t interfaceSpeed;
+    };
+
+    // (agent, sample, IngestTime::steadyMs)
+    using TimedCounterSample = std::tuple<uint32_t, CounterSampleRecord, int64_t>;
+    /**
+     * @brief Apply the counter samples of one batch under a single m_counterReportsMutex
+     *        acquisition, then push the resulting link updates with the mutex released.
+     */
+    void applyCounterSamples(const std::vector<TimedCounterSample>& samples);
+    /**
+     * @brief Advance the counters of (@p agentIp, rec.interfaceIndex) to @p rec, received at
+     *        @p nowMs, and return the link update it yields, if any.
+     *
+     * Caller holds m_counterReportsMutex.
+     */
+    std::optional<LinkCounterUpdate> handleCounterSample(uint32_t agentIp,
+                                                         const CounterSampleRecord& rec,
+                                                         int64_t nowMs);
+    std::optional<PreparedFlowSample> prepareFlowSample(uint32_t agentIp,
+                                                        const FlowSampleRecord& rec,
+                                                        const IngestTime& time);
+    // Key of the aggregate @p key belongs to under m_aggregation
+    FlowKey aggregateKey(const FlowKey& key) const;
+    void touchFlowEdges(const PreparedFlowSample& sample);
+    static nlohmann::json flowInfoToJson(const FlowKey& key, const FlowInfo& info);
+
+    // The fields of a flow flowInfoToJson() reports, copied out under its shard lock
+    struct FlowJsonRecord
+    {
+        FlowKey key;
+        uint64_t flowRatePeriodically;
+        uint64_t flowRateImmediately;
+        uint64_t packetRatePeriodically;
+        uint64_t packetRateImmediately;
+        uint64_t reverseAckBytes;
+        uint64_t reverseAckPackets;
+        int64_t startTime;
+        int64_t endTime;
+        PathHandle path; // holds the interned hops, not a copy of them
+    };
+    static FlowJsonRecord flowJsonRecord(const FlowKey& key, const FlowInfo& info);
+    static nlohmann::json flowRecordToJson(const FlowJsonRecord& record);
+    // Replace @p out with the records of shard @p s, taken under its shared lock
+    void snapshotFlowShard(size_t s, std::vector<FlowJsonRecord>& out) const;
+    // Stamp @p info with the current flow version (caller holds its shard lock)
+    void markFlowChanged(FlowInfo& info);
+    // Remember a purged flow for delta queries (caller holds its shard lock)
+    void recordFlowRemoval(const FlowKey& key);
+    // Move @p key in m_hopFlows from the switch hops of @p oldPath to those of @p newPath
+    // (caller holds m_hopFlowsMutex)
+    void reindexFlowPathNoLock(const FlowKey& key,
+                               const PathHandle& oldPath,
+                               const PathHandle& newPath);
+    // One pass of idle-flow expiry (purge task)
     void purgeIdleFlows();
     void fetchAllDestinationPaths();
     void calFlowPathByQueried();
 
-    std::unordered_map<FlowKey, FlowInfo, FlowKeyHash> m_flowInfoTable;
+    // Open addressing keeps a shard's flows in one contiguous slot array, in huge pages once
+    // it is large (utils::MemoryPolicy)
+    using FlowInfoMap = utils::FlatHashMap<
+        FlowKey,
+        FlowInfo,
+        FlowKeyMixHash,
+        std::equal_to<FlowKey>,
+        utils::PolicyAllocator<std::pair<FlowKey, FlowInfo>, utils::MemoryKind::FlowTable>>;
+
+    // What a demoted flow keeps of its FlowInfo: about a fourteenth of its size, since the
+    // per-agent counters and rate windows are left behind
+    struct ColdFlow
+    {
+        uint64_t flowRatePeriodically = 0;
+        uint64_t packetRatePeriodically = 0;
+        uint64_t reverseAckBytes = 0;
+        uint64_t reverseAckPackets = 0;
+        int64_t startTime = 0;
+        int64_t endTime = 0;
+        uint64_t changedVersion = 0;
+        PathHandle flowPath; // still indexed in m_hopFlows
+        FlowKey sampleKey{};
+        uint32_t firstHopAgent = 0;
+        bool isElephantFlowPeriodically = false;
+        bool elephantAnnounced = false;
+        bool isAck = false;
+        bool isPureAck = false;
+    };
+    using ColdFlowMap = utils::FlatHashMap<
+        FlowKey,
+        ColdFlow,
+        FlowKeyMixHash,
+        std::equal_to<FlowKey>,
+        utils::PolicyAllocator<std::pair<FlowKey, ColdFlow>, utils::MemoryKind::FlowTable>>;
+
+    /**
+     * @brief One slice of the flow table, selected by flowShardIndex().
+     *
+     * Ingest workers, the rate threads and the purge thread lock only the shard they
+     * touch, so they no longer serialize on a single table-wide mutex.
+     */
+    struct FlowTableShard
+    {
+        mutable std::shared_mutex mutex;
+        FlowInfoMap table;
+        // Flows demoted for idling flow.cold_after_ms, never in table at the same time; they
+        // keep their expiry entry (guarded by mutex)
+        ColdFlowMap cold;
+        uint64_t demotions = 0;
+        uint64_t coldPromotions = 0;
+        // Purged FlowInfo objects, reused for new flows of this shard (guarded by mutex)
+        utils::RecyclePool<FlowInfo> pool{FLOW_POOL_MAX_IDLE_PER_SHARD};
+        // One entry per flow, due flowHotTimeout() after its last known endTime (a cold
+        // flow: flowIdleTimeout()); the purge thread re-checks due flows, demotes or purges
+        // them and reschedules the ones that saw traffic meanwhile (guarded by mutex)
+        utils::TimerWheel<FlowKey> expiry{FLOW_EXPIRY_TICK_MS, FLOW_EXPIRY_WHEEL_SLOTS};
+        // Flows sampled since the last periodic rate tick, each once (pendingRateUpdate set);
+        // guarded by mutex
+        std::vector<FlowKey> rateDirty;
+        // Flows created since the path thread last ran, still without a path, or whose path
+        // was invalidated (guarded by mutex)
+        std::vector<FlowKey> pathPending;
+        // Estimated recent bytes of flows without an entry, consulted once the shard holds
+        // FLOW_ADMIT_FREE_FLOWS flows; halved by the purge task (guarded by mutex)
+        utils::CountMinSketch admission{FLOW_ADMIT_SKETCH_WIDTH, FLOW_ADMIT_SKETCH_DEPTH};
+        uint64_t heldBackSamples = 0;
+        uint64_t heldBackBytes = 0;
+        uint64_t promoted = 0; // flows given an entry through the sketch
+        // Slot where the next eviction starts comparing flows (guarded by mutex)
+        size_t evictionHand = 0;
+        size_t coldEvictionHand = 0; // the same over the cold flows
+        uint64_t evicted = 0;
+        uint64_t rejected = 0; // new flows refused because only elephants were found to evict
+        uint64_t reverseAcksMerged = 0;
+        uint64_t otherHopSamples = 0; // not counted, see setFirstHopSampling()
+        // Flows sampled at their first hop since the last rate tick (guarded by mutex)
+        std::vector<FlowKey> pathTouches;
+        // Evicted since the last purge pass, which announces them with the purged flows
+        // (guarded by mutex)
+        std::vector<FlowKey> evictedKeys;
+    };
+
+    // (dpid, output port) of a switch hop of FlowInfo::flowPath
+    using PathHop = std::pair<uint64_t, uint32_t>;
+    struct PathHopHash
+    {
+        size_t operator()(const PathHop& hop) const
+        {
+            return std::hash<uint64_t>{}(hop.first * 0x9E3779B97F4A7C15ULL ^ hop.second);
+        }
+    };
+
+    size_t flowShardIndex(const FlowKey& key) const;
+    FlowTableShard& flowShardFor(const FlowKey& key);
+    // Caller holds the unique lock of @p shard. False if the sample is of a flow without an
+    // entry that the shard does not admit yet (only counted in the sketch) or has no room for.
+    bool updateFlowInfo(FlowTableShard& shard, PreparedFlowSample& sample);
+    // Touch the links of the flows in the shards' pathTouches (rate task)
+    void touchFlowPaths();
+    // Count pure-ACK @p sample into the flow of the opposite direction; false if @p shard has
+    // none (caller holds the unique lock of @p shard)
+    bool mergeReverseAck(FlowTableShard& shard, const PreparedFlowSample& sample);
+    // Make room for a new flow in @p shard at its bound, taking a cold flow first; false if
+    // only elephants were found (caller holds the unique lock of @p shard)
+    bool evictFlowNoLock(FlowTableShard& shard);
+    // Export, unindex and erase the flow at @p it (caller holds the unique lock of @p shard)
+    void removeFlowNoLock(FlowTableShard& shard, FlowInfoMap::iterator it);
+    // The same for the cold flow at @p it
+    void removeColdFlowNoLock(FlowTableShard& shard, ColdFlowMap::iterator it);
+    // Take flow @p key out of the traffic matrix, hand it to the exporter and unindex its
+    // path (caller holds its shard's unique lock)
+    void retireFlowNoLock(const FlowKey& key, const FlowInfo& info);
+    // Replace the hot flow at @p it by a cold record; false, leaving it hot, while it still
+    // awaits a rate tick or path touch or has a periodic rate (unique lock of @p shard held)
+    bool demoteFlowNoLock(FlowTableShard& shard, FlowInfoMap::iterator it);
+    // The hot entry of @p key, promoting the cold record first if that is what the shard
+    // holds; end() if it has neither (caller holds the unique lock of @p shard)
+    FlowInfoMap::iterator findHotFlowNoLock(FlowTableShard& shard, const FlowKey& key);
+    // Call @p fn(key, info) for each flow of @p shard, the cold ones through a FlowInfo
+    // filled in from their record; stops when @p fn returns false (shard lock held)
+    template <typename Fn>
+    static bool forEachFlowNoLock(const FlowTableShard& shard, Fn&& fn);
+    // Fill @p info with what @p cold keeps of a flow (no agents, so no immediate rate)
+    static void coldFlowInfo(const ColdFlow& cold, FlowInfo& info);
 
-    // key -> agent_ip and port
-    // value -> last_report_time, last_received_input_octets and
+    // Approximate memory of one flow table entry, for FlowTableLimits::maxBytes
+    static constexpr size_t FLOW_ENTRY_BYTES = (sizeof(FlowKey) + sizeof(FlowInfo) + 1) * 8 / 7;
+
+    std::array<FlowTableShard, FLOW_TABLE_SHARD_COUNT> m_flowInfoShards;
+
+    // Keys are agent ip << 32 | ifIndex (see counterKey())
+    struct CounterKeyHash
+    {
+        size_t operator()(uint64_t key) const
+        {
+            uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 32;
+            h *= 0xD6E8FEB86659FD93ULL;
+            h ^= h >> 32;
+            return static_cast<size_t>(h);
+        }
+    };
+
+    static uint64_t counterKey(uint32_t agentIp, uint32_t ifIndex)
+    {
+        return (uint64_t(agentIp) << 32) | ifIndex;
+    }
+
+    // (agent ip, ifIndex) -> last_report_time, last_received_input_octets and
     // last_received_output_octets, ...
-    std::map<std::pair<uint32_t, uint32_t>, CounterInfo> m_counterReports;
+    utils::FlatHashMap<uint64_t, CounterInfo, CounterKeyHash> m_counterReports;
+    std::mutex m_counterReportsMutex; // ingest workers and the rate thread share it
 
-    std::atomic<int> m_sockfd{-1};
     std::atomic<bool> m_running{false};
 
-    std::thread m_pktRcvThread;
-    std::thread m_calAvgFlowSendingRateThreadPeriodically;
-    std::thread m_testCalAvgFlowSendingRatesRandomly;
-    std::thread m_purgeThread;
-    std::thread m_calFlowPathByQueried;
+    IngestConfig m_ingestConfig;
+    std::unique_ptr<FlowRecordExporter> m_flowExporter; // set when export is configured
+    std::unique_ptr<TelemetrySegmentWriter> m_telemetrySegment; // set when configured
+    std::unique_ptr<SamplingRateController> m_samplingController; // set when configured
+    std::unique_ptr<LinkLivenessMonitor> m_linkLiveness; // set by start() unless MININET
+    std::atomic<bool> m_linkLivenessApply{true};         // runtime parameter link_liveness.apply
+    std::mutex m_livenessDownMutex;
+    std::unordered_set<uint64_t> m_livenessDownPorts; // counterKey()s of links it set down
+    std::atomic<uint64_t> m_livenessApplied{0};
+    std::atomic<uint64_t> m_livenessRestored{0};
+    std::unique_ptr<ClusterForwarder> m_clusterForwarder; // set on a cluster node
+    uint16_t m_clusterListenPort = 0;                      // set on the cluster's coordinator
+    IngestWorkerStats m_clusterStats;                      // of receiveFromNodes()
+    std::thread m_clusterThread;
+    std::string m_checkpointPath; // empty: no checkpoints
+    std::atomic<uint64_t> m_checkpointWrites{0};
+    std::atomic<uint64_t> m_checkpointFailures{0};
+    std::atomic<uint64_t> m_checkpointBytes{0};
+    nlohmann::json m_checkpointRestored; // set by start(), before the API can ask
+    uint64_t m_samplingDrops = 0; // kernel drops and ring overflows at the last control step
+    FlowTableLimits m_flowTableLimits;
+    FlowAggregationConfig m_aggregation;
+    bool m_bidirectionalFlows = false;
+    bool m_firstHopSampling = false;
+    size_t m_shardFlowCap = 0; // flows per shard from m_flowTableLimits; 0: unbounded
+    std::atomic<bool> m_incrementalRates{false};
+
+    // Flow versioning. Readers advance m_flowVersion (publishFlowVersion) and writers stamp
+    // flows with its current value, so the ingest path only loads it.
+    std::atomic<uint64_t> m_flowVersion{1};
+    std::atomic<bool> m_flowsChanged{false};
+    std::mutex m_flowRemovalsMutex;
+    std::deque<std::pair<uint64_t, FlowKey>> m_flowRemovals; // (version, key), oldest first
+    uint64_t m_flowRemovalsFloor = 0; // newest version among tombstones already dropped
+
+    // Fastest flows of the last immediate-rate sweep, fastest first (at most
+    // FLOW_TOPK_TRACKED); empty until the first sweep and while the sweep is off
+    std::atomic<bool> m_immediateSweep{false}; // runtime parameter flow_rates.immediate_sweep
+    std::mutex m_topFlowsMutex;
+    std::vector<RankedFlow> m_topFlows;
+
+    // Path resolution is event driven: new flows set m_pathWork and wake the path thread,
+    // which otherwise only wakes every FLOW_PATH_RECHECK_MS to compare the classifier and
+    // topology versions with the ones the current paths were resolved against
+    std::mutex m_pathMutex;
+    std::condition_variable m_pathCv;
+    std::atomic<bool> m_pathWork{false};
+    // Failover traces waiting for the next pass, and when each was queued (under m_pathMutex)
+    std::vector<std::pair<utils::TraceId, std::chrono::steady_clock::time_point>> m_pathTraces;
+    // Reverse index of flowPath: the flows leaving each switch through each port. Updated
+    // with the paths, lock order shard mutex -> m_hopFlowsMutex
+    std::mutex m_hopFlowsMutex;
+    std::unordered_map<PathHop, std::unordered_set<FlowKey, FlowKeyHash>, PathHopHash>
+        m_hopFlows;
+    // Classifier walks shared by flows of one forwarding class. Flows are partitioned across
+    // path workers by source IP, so all flows of a host (and thus of its ingress switch) hit
+    // the same cache; each partition is only touched by the worker resolving it
+    std::array<FlowPathCache, FLOW_PATH_WORKERS> m_pathCaches;
 
-    mutable std::shared_mutex m_flowInfoTableMutex;
+    std::vector<std::thread> m_pktRcvThreads;
+    std::vector<std::unique_ptr<IngestWorkerStats>> m_ingestStats;
+    std::vector<std::unique_ptr<utils::SpscRing<IngestRecord>>> m_ingestRings;
+    std::vector<std::thread> m_aggregatorThreads;
+
+    // Runtime parameters; the atomic ones change while running
+    uint16_t m_sflowPort = SFLOW_PORT;
+    size_t m_recvBufferBytes = BUFFER_SIZE;
+    std::atomic<int> m_recvBatch{SFLOW_RECV_BATCH_SIZE};
+    std::atomic<int> m_rcvbufBytes{SFLOW_RCVBUF_BYTES};
+    std::atomic<int64_t> m_flowIdleTimeoutMs{FLOW_IDLE_TIMEOUT};
+    std::atomic<int64_t> m_flowColdAfterMs{FLOW_COLD_AFTER};
+
+    mutable std::mutex m_ingestFilterMutex;
+    std::vector<int> m_ingestSockets;
+    IngestFilterSpec m_ingestFilterSpec;
+    std::vector<sock_filter> m_ingestFilter; // empty until the first refresh
+    uint64_t m_ingestFilterUpdates = 0;
+    uint64_t m_ingestFilterFailures = 0;
+
+    // Rate tick, random rate test and purge, on the process-wide task scheduler
+    std::vector<utils::TaskScheduler::TaskId> m_periodicTasks;
+    std::thread m_calFlowPathByQueried;
+    std::vector<unsigned> m_pathThreadCpus;
+    // Rate task only: flows to revisit per shard, and the incremental sweep's buffers
+    std::array<std::vector<FlowKey>, FLOW_TABLE_SHARD_COUNT> m_rateFollowUps;
+    RateScratch m_rateScratch;
+    std::vector<TrafficMatrix::Delta> m_matrixDeltas;
+    ElephantFlowEventData m_elephantsDetected;
+    ElephantFlowEventData m_elephantsEnded;
+    std::vector<std::tuple<FlowKey, uint32_t, PathHandle>> m_pathTouchScratch;
+    TrafficMatrix m_trafficMatrix;
+    std::mt19937 m_randomRateTestGen{std::random_device{}()};
 
     std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
     std::shared_ptr<FlowRoutingManager> m_flowRoutingManager;
@@ -176,16 +1201,80 @@ class FlowLinkUsageCollector
 
     utils::DeploymentMode m_mode;
 
+    // Mininet: sFlow ifIndex -> OpenFlow port of the switch ports
+    using IfIndexMap = std::unordered_map<uint32_t, uint32_t>;
+
+    // Follow the port map through OvsdbMonitor, or read it once from ovs-vsctl without OVSDB
+    void startIfIndexMap();
     void populateIfIndexToOfportMap();
-    std::unordered_map<uint32_t, uint32_t> m_ifIndexToOfportMap;
-    std::mutex m_ifIndexMapMutex; // To protect the map during population and access
+    void publishIfIndexMap(std::shared_ptr<const IfIndexMap> map);
+    /**
+     * @brief The current port map, as seen by the calling thread: a lock-free version check
+     *        unless a new map was published since, like hostPairs().
+     */
+    const IfIndexMap& ifIndexToOfport() const;
 
-    // key -> (src ip, dst ip), value -> full path
-    std::map<std::pair<uint32_t, uint32_t>, Path> m_allPathMap;
+    // Replaced whole by publishIfIndexMap(), never modified once published
+    std::shared_ptr<const IfIndexMap> m_ifIndexToOfport = std::make_shared<const IfIndexMap>();
+    mutable std::mutex m_ifIndexMapMutex;
+    std::atomic<uint64_t> m_ifIndexMapVersion{0};
+    uint64_t m_ovsdbListener = 0; // OvsdbMonitor subscription, 0 if none
+
+    /**
+     * @brief Known path of a (src ip, dst ip) pair, as set by setAllPaths()/setAllPath().
+     */
+    struct HostPairRoute
+    {
+        PathHandle path;        // full path, host to host
+        size_t switchCount = 0; // path.size() - 2: the hops between the two hosts
+    };
+
+    // Keys are src ip << 32 | dst ip (see hostPairKey())
+    struct HostPairHash
+    {
+        size_t operator()(uint64_t pair) const
+        {
+            uint64_t h = pair * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 32;
+            h *= 0xD6E8FEB86659FD93ULL;
+            h ^= h >> 32;
+            return static_cast<size_t>(h);
+        }
+    };
+    using HostPairTable = utils::FlatHashMap<uint64_t, HostPairRoute, HostPairHash>;
+
+    static uint64_t hostPairKey(uint32_t srcIp, uint32_t dstIp)
+    {
+        return (uint64_t(srcIp) << 32) | dstIp;
+    }
+
+    /**
+     * @brief The current host pair table; it is never modified once published.
+     */
+    std::shared_ptr<const HostPairTable> hostPairsSnapshot() const;
+
+    /**
+     * @brief The current host pair table, as seen by the calling thread.
+     *
+     * Each thread keeps the table it last loaded and only goes through m_hostPairsMutex when
+     * m_hostPairsVersion has moved since, so the per-sample lookup in touchFlowEdges() is a
+     * lock-free version check plus one flat hash probe. The reference stays valid until the
+     * thread's next call.
+     */
+    const HostPairTable& hostPairs() const;
+
+    /**
+     * @brief Copy the current table, let @p update modify the copy, and publish it.
+     */
+    void updateHostPairs(const std::function<void(HostPairTable&)>& update);
 
-    // calc the count of switch
-    std::map<std::pair<uint32_t, uint32_t>, size_t> m_switchCountMap;
-    mutable std::shared_mutex m_switchCountMapMutex;
+    // (src ip, dst ip) -> path and switch count. Readers take their own reference to the
+    // table; setters replace it whole (copy-on-write) under m_hostPairsMutex.
+    std::shared_ptr<const HostPairTable> m_hostPairs = std::make_shared<const HostPairTable>();
+    mutable std::mutex m_hostPairsMutex;
+    // Changes with every published table; unique across collector instances (0: the initial,
+    // empty table)
+    std::atomic<uint64_t> m_hostPairsVersion{0};
 
     std::shared_ptr<ndtClassifier::Classifier> m_classifier;
 };
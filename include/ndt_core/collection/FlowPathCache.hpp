@@ -0,0 +1,127 @@
+#pragma once
+
+#include "common_types/SFlowType.hpp"          // for Path
+#include "ndt_core/collection/Classifier.hpp" // for FlowKey
+#include <atomic>                              // for atomic
+#include <cstddef>                             // for size_t
+#include <cstdint>                             // for uint32_t, uint64_t
+#include <nlohmann/json.hpp>                   // for json
+#include <unordered_map>                       // for unordered_map
+#include <vector>                              // for vector
+
+namespace sflow
+{
+
+#define FLOW_PATH_CACHE_MAX_ENTRIES 65536 // the cache starts over when it grows past this
+
+/**
+ * @brief Memoised classifier walks, shared by flows of one forwarding equivalence class.
+ *
+ * An entry stores how a lookup key travels from an ingress switch to the host it ends at.
+ * It is keyed by the ingress switch and by the key masked with the union of the subtable
+ * masks the walk consulted (Classifier::lookupWithMask()). Any flow that agrees on those
+ * bits follows the same switches, whatever its other fields are, like an OVS megaflow.
+ *
+ * An entry depends on the rules of every switch it looked up. invalidate() drops the
+ * entries whose switches changed after they were resolved; clear() drops everything (for
+ * topology changes).
+ *
+ * Not thread-safe: each instance is used by one path resolution worker at a time. Only the
+ * counters reported by stats() may be read concurrently.
+ */
+class FlowPathCache
+{
+  public:
+    struct Entry
+    {
+        bool ok = false;                   // false if the walk failed (no rule, no edge, loop)
+        Path hops;                         // (dpid, output port) of every switch traversed
+        std::vector<uint32_t> terminalIps; // IPs of the host vertex the walk ended at
+        std::vector<uint64_t> switches;    // every switch whose rules were looked up
+        uint64_t rulesVersion = 0;         // Classifier::getRulesVersion() when resolved
+    };
+
+    struct Stats
+    {
+        uint64_t entries = 0;
+        uint64_t masks = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0;
+
+        Stats& operator+=(const Stats& o);
+
+        /**
+         * @brief {"entries", "masks", "hits", "misses", "hit_rate", "invalidations"}.
+         */
+        nlohmann::json toJson() const;
+    };
+
+    /**
+     * @brief Entry covering @p key from @p ingressDpid, or nullptr (counts a hit or miss).
+     *
+     * The pointer stays valid until the next insert(), invalidate() or clear().
+     */
+    const Entry* find(uint64_t ingressDpid, const ndtClassifier::FlowKey& key);
+
+    /**
+     * @brief Remember @p entry for every key equal to @p key on the bits of @p consulted.
+     */
+    void insert(uint64_t ingressDpid,
+                const ndtClassifier::FlowKey& key,
+                const ndtClassifier::FlowKey& consulted,
+                Entry entry);
+
+    /**
+     * @brief Drop entries depending on a switch whose version in @p switchVersions (as
+     *        returned by Classifier::getRulesVersions()) is newer than the entry.
+     * @return Number of entries dropped.
+     */
+    size_t invalidate(const std::unordered_map<uint64_t, uint64_t>& switchVersions);
+
+    /**
+     * @brief Drop every entry and mask.
+     */
+    void clear();
+
+    /**
+     * @brief Current counters (safe to call from any thread).
+     */
+    Stats stats() const;
+
+    /**
+     * @brief Estimated heap bytes of the entries and masks, from the counters (safe to call
+     *        from any thread); the hops each entry keeps are not counted.
+     */
+    size_t memoryBytes() const;
+
+  private:
+    struct Key
+    {
+        uint64_t ingressDpid;
+        uint32_t maskIndex; // into m_masks[ingressDpid]
+        ndtClassifier::FlowKey masked;
+
+        bool operator==(const Key& o) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    static ndtClassifier::FlowKey applyMask(const ndtClassifier::FlowKey& key,
+                                            const ndtClassifier::FlowKey& mask);
+
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+    // Distinct consulted masks per ingress switch, probed in insertion order by find()
+    std::unordered_map<uint64_t, std::vector<ndtClassifier::FlowKey>> m_masks;
+
+    std::atomic<size_t> m_size{0};
+    std::atomic<size_t> m_maskCount{0};
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_invalidations{0};
+};
+
+} // namespace sflow
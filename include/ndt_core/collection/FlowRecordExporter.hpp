@@ -0,0 +1,121 @@
+#pragma once
+
+#include "common_types/SFlowType.hpp" // for FlowKey, FlowInfo
+#include "utils/HistoryWriter.hpp"    // for HistoryFile
+#include "utils/MpmcQueue.hpp"        // for MpmcQueue
+#include <atomic>                     // for atomic
+#include <chrono>                     // for steady_clock
+#include <condition_variable>         // for condition_variable
+#include <cstdint>                    // for uint64_t, int64_t
+#include <memory>                     // for shared_ptr
+#include <mutex>                      // for mutex
+#include <nlohmann/json.hpp>          // for json
+#include <string>                     // for string
+#include <thread>                     // for thread
+#include <vector>                     // for vector
+
+#define FLOW_EXPORT_QUEUE_CAPACITY 65536 // records waiting for the writer; more are dropped
+#define FLOW_EXPORT_BATCH 1024           // records per write (one gzip member)
+#define FLOW_EXPORT_FLUSH_MS 1000        // a partial batch is written after this long
+#define FLOW_EXPORT_SEGMENT_SECONDS 3600 // a new segment file is started this often
+#define FLOW_EXPORT_IPFIX_MTU 1400       // largest IPFIX message sent over UDP
+#define FLOW_EXPORT_IPFIX_TEMPLATE_S 60  // the template is resent this often (RFC 7011 10.3.6)
+#define FLOW_EXPORT_IPFIX_PEN 32473      // enterprise number of the path/elephant elements
+
+namespace sflow
+{
+
+/**
+ * @brief Where FlowRecordExporter sends the records; both empty turns export off.
+ */
+struct FlowExportConfig
+{
+    std::string directory;      // segment files flows-YYYYMMDD-HHMMSS.csv.gz are written here
+    std::string ipfixCollector; // "host:port" of an IPFIX collector (UDP)
+};
+
+/**
+ * @brief Accounting record of one flow, taken when the flow is purged.
+ *
+ * Bytes and packets are the sampled counts scaled by the sampling rate, from the agent that
+ * saw the most of the flow.
+ */
+struct FlowRecord
+{
+    FlowKey key{};
+    int64_t startMs = 0;
+    int64_t endMs = 0;
+    uint64_t bytes = 0;
+    uint64_t packets = 0;
+    uint64_t pathId = 0; // PathHandle::fingerprint() of the flow's path, 0 if none
+    uint16_t pathHops = 0;
+    bool elephantPeriodically = false;
+    bool elephantImmediately = false;
+
+    static FlowRecord from(const FlowKey& key, const FlowInfo& info);
+};
+
+/**
+ * @brief Exports the records of purged flows to compressed segment files and/or IPFIX.
+ *
+ * offer() only pushes into a bounded lock-free queue and never blocks; when the queue is
+ * full the record is dropped and counted. A writer thread drains the queue in batches of up
+ * to FLOW_EXPORT_BATCH records (or whatever arrived within FLOW_EXPORT_FLUSH_MS) and
+ *   - appends each batch as one gzip member of CSV lines to the current segment file,
+ *     through utils::HistoryWriter (so not while historical logging is disabled), and the
+ *     files can be read with zcat while they grow;
+ *   - sends them as IPFIX (RFC 7011) data sets over UDP, with the template in front of the
+ *     first message and every FLOW_EXPORT_IPFIX_TEMPLATE_S seconds.
+ */
+class FlowRecordExporter
+{
+  public:
+    explicit FlowRecordExporter(FlowExportConfig config);
+    ~FlowRecordExporter();
+
+    FlowRecordExporter(const FlowRecordExporter&) = delete;
+    FlowRecordExporter& operator=(const FlowRecordExporter&) = delete;
+
+    /// Start the writer thread.
+    void start();
+
+    /// Write what is queued and join the writer.
+    void stop();
+
+    /// Queue @p record for export; false (and counted as dropped) if the queue is full.
+    bool offer(FlowRecord record);
+
+    /// {"queued", "offered", "dropped", "written", "segments", "ipfix_messages", "errors"}.
+    nlohmann::json statsJson() const;
+
+  private:
+    void run();
+    void writeBatch(const std::vector<FlowRecord>& batch);
+    void writeSegment(const std::vector<FlowRecord>& batch);
+    void sendIpfix(const std::vector<FlowRecord>& batch);
+    bool openIpfixSocket();
+
+    FlowExportConfig m_config;
+    utils::MpmcQueue<FlowRecord> m_queue{FLOW_EXPORT_QUEUE_CAPACITY};
+    std::atomic<bool> m_running{false};
+    std::thread m_thread;
+    std::mutex m_wakeMutex; // only for the writer's timed wait
+    std::condition_variable m_wakeCv;
+
+    // Writer thread only
+    std::shared_ptr<utils::HistoryFile> m_segment;
+    std::chrono::steady_clock::time_point m_segmentOpened;
+    int m_ipfixFd = -1;
+    uint32_t m_ipfixSequence = 0; // data records sent, as RFC 7011 counts them
+    std::chrono::steady_clock::time_point m_templateSent;
+    bool m_templateDue = true;
+
+    std::atomic<uint64_t> m_offered{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_segments{0};
+    std::atomic<uint64_t> m_ipfixMessages{0};
+    std::atomic<uint64_t> m_errors{0};
+};
+
+} // namespace sflow
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>        // for uint32_t
+#include <linux/filter.h> // for sock_filter
+#include <vector>         // for vector
+
+#define INGEST_FILTER_MAX_AGENTS 1024   // beyond it the filter accepts every agent
+#define INGEST_FILTER_SAMPLE_SCAN 8     // samples looked at for a flow sample
+#define INGEST_FILTER_REFRESH_MS 5000   // how often the agents are compared with the topology
+
+namespace sflow
+{
+
+/**
+ * @brief What the in-kernel filter of the sFlow sockets lets through.
+ */
+struct IngestFilterSpec
+{
+    std::vector<uint32_t> agents; // network order, sorted; empty accepts every agent
+    bool dropCounterOnly = false; // datagrams without a flow sample are dropped
+
+    bool operator==(const IngestFilterSpec&) const = default;
+};
+
+/**
+ * @brief Classic BPF program for SO_ATTACH_FILTER on an sFlow UDP socket.
+ *
+ * It drops in the kernel, before the datagram is queued to the socket, what handlePacket()
+ * would reject or ignore: datagrams that are not sFlow v5 with an IPv4 agent, agents not in
+ * @c agents, and with @c dropCounterOnly datagrams whose first INGEST_FILTER_SAMPLE_SCAN
+ * samples are all something other than flow samples (a datagram with more samples than that
+ * is let through). The kernel counts what it drops in the socket's drop counter, so it shows
+ * in the SO_RXQ_OVFL count with queue overflows.
+ *
+ * Agents are compared one by one, two instructions each, so more than INGEST_FILTER_MAX_AGENTS
+ * leaves the agent check out rather than approach BPF_MAXINSNS.
+ */
+std::vector<sock_filter> compileIngestFilter(const IngestFilterSpec& spec);
+
+} // namespace sflow
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "event_system/PayloadTypes.hpp" // for LinkFailureCause
+#include <cstddef>                       // for size_t
+#include <cstdint>                       // for uint32_t, uint64_t, int64_t
+#include <functional>                    // for function
+#include <mutex>                         // for mutex
+#include <nlohmann/json.hpp>             // for json
+#include <unordered_map>                 // for unordered_map
+#include <vector>                        // for vector
+
+#define LINK_LIVENESS_SWEEP_MS 250         // overdue ports are looked for this often
+#define LINK_LIVENESS_MIN_REPORTS 3        // counter reports before a port's cadence is trusted
+#define LINK_LIVENESS_MIN_INTERVAL_MS 1000 // closer reports are duplicates, not the cadence
+#define LINK_LIVENESS_GRACE 0.5            // share of its cadence a report may be late ...
+#define LINK_LIVENESS_JITTER_MS 500        // ... plus this much
+#define LINK_LIVENESS_DRAIN_MIN_FLOWS 4    // flows a link needs before its draining counts
+#define LINK_LIVENESS_MIN_CONFIDENCE 0.5   // weaker suspicions are not reported
+#define LINK_LIVENESS_APPLY_CONFIDENCE 0.9 // detections that take the link down
+
+namespace sflow
+{
+
+/**
+ * @brief Passive data-plane link failure detection from the sFlow counter samples.
+ *
+ * Every agent exports a counter sample per port at a steady polling interval, and the sample
+ * carries the port's ifAdminStatus / ifOperStatus. A sample reporting the port down is a
+ * failure of certainty 1, detected as soon as the sample arrives. A port whose samples stop
+ * is suspected once it is LINK_LIVENESS_GRACE of its own cadence (an average of its recent
+ * intervals) plus LINK_LIVENESS_JITTER_MS late, with a confidence that weighs the other
+ * evidence:
+ *   - 0.5 for the missing samples alone;
+ *   - +0.3 if the agent went on reporting other ports after this one was due (the agent and
+ *     the path to the collector work), -0.3 if it fell silent altogether;
+ *   - +0.2 if the flows seen on the port's link drained to a quarter or less.
+ * A suspicion is re-scored at every sweep and reported again when its confidence rises, so
+ * a caller acting at LINK_LIVENESS_APPLY_CONFIDENCE sees it cross. The next sample reporting
+ * the port up is its recovery.
+ *
+ * Ports are keyed by (agent, ifIndex) and know nothing of the topology; the caller maps them
+ * to links. Thread-safe.
+ */
+class LinkLivenessMonitor
+{
+  public:
+    /// A port found failed, or working again after a reported failure.
+    struct Transition
+    {
+        uint32_t agentIp; // network order
+        uint32_t ifIndex;
+        bool down;
+        LinkFailureCause cause; // of the failure, also for its recovery
+        double confidence;      // 1 for a recovery
+        int64_t silentMs;       // since the port's previous counter sample
+    };
+
+    /**
+     * @brief Counter sample of port (@p agentIp, @p ifIndex) with ifStatus @p status
+     *        (IF_STATUS_* bits), received at @p nowMs (steady clock) while @p flows flows were
+     *        on its link. Appends to @p out when it reports the port down, or up again.
+     */
+    void observe(uint32_t agentIp,
+                 uint32_t ifIndex,
+                 uint32_t status,
+                 size_t flows,
+                 int64_t nowMs,
+                 std::vector<Transition>& out);
+
+    /**
+     * @brief Score the ports overdue at @p nowMs, appending to @p out those newly suspected or
+     *        suspected with more confidence. @p flowsOn(agentIp, ifIndex) gives the flows on a
+     *        port's link now; it is called with the monitor's lock held.
+     */
+    void sweep(int64_t nowMs,
+               const std::function<size_t(uint32_t, uint32_t)>& flowsOn,
+               std::vector<Transition>& out);
+
+    /// {"ports", "down", "detections": {cause: count}, "recoveries"}
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Port
+    {
+        int64_t lastMs = 0;
+        double intervalMs = 0; // moving average of the reporting interval
+        uint32_t reports = 0;  // up to LINK_LIVENESS_MIN_REPORTS
+        size_t flows = 0;      // on the link at the last sample reporting it up
+        bool down = false;     // reported failed and not recovered since
+        LinkFailureCause cause = LinkFailureCause::CountersStopped;
+        double confidence = 0; // of the last failure reported
+    };
+
+    static uint64_t portKey(uint32_t agentIp, uint32_t ifIndex)
+    {
+        return static_cast<uint64_t>(agentIp) << 32 | ifIndex;
+    }
+
+    void countDetection(LinkFailureCause cause);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, Port> m_ports;
+    std::unordered_map<uint32_t, int64_t> m_agentLastMs; // latest counter sample of each agent
+    uint64_t m_operDown = 0;
+    uint64_t m_adminDown = 0;
+    uint64_t m_countersStopped = 0;
+    uint64_t m_recoveries = 0;
+};
+
+} // namespace sflow
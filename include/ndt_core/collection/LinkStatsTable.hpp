@@ -0,0 +1,211 @@
+#pragma once
+
+#include "common_types/GraphTypes.hpp" // for Graph, EdgeProperties
+#include <array>                       // for array
+#include <atomic>                      // for atomic
+#include <cstddef>                     // for size_t
+#include <cstdint>                     // for uint32_t, uint64_t
+#include <memory>                      // for unique_ptr
+#include <vector>                      // for vector
+
+#define FABRIC_USAGE_BUCKETS 101 // 1%-wide buckets of the fabric usage histogram, last >= 100%
+
+/**
+ * @brief Link utilisation counters of one directed edge.
+ *
+ * Same fields and meaning as the corresponding members of EdgeProperties.
+ */
+struct LinkStats
+{
+    uint64_t leftBandwidth = 0;
+    uint64_t linkBandwidth = 0;
+    uint64_t linkBandwidthUsage = 0;
+    double linkBandwidthUtilization = 0;
+    uint64_t leftBandwidthFromFlowSample = 0;
+};
+
+/**
+ * @brief Dense per-edge telemetry, indexed by EdgeProperties::statsId.
+ *
+ * The sFlow threads update link counters continuously while the topology itself rarely
+ * changes. Keeping the counters here lets writers update them while holding only the
+ * shared graph lock, and lets readers scan one contiguous array instead of walking the
+ * graph's edge lists.
+ *
+ * Each slot is a seqlock: writers serialise on the (odd) sequence number, readers retry
+ * until they see the same even sequence before and after copying the fields, so a read
+ * never mixes two updates.
+ *
+ * The table also keeps the sum of linkBandwidthUsage over the edges entering and leaving
+ * each vertex, adjusted by every modify(), so the load of a switch is one read instead of
+ * a scan of the graph's edges.
+ *
+ * Likewise it keeps the count, sum and 1%-bucket histogram of linkBandwidthUsage /
+ * linkBandwidth over the fabric links: up edges between two switches with non-zero usage.
+ * These are atomics outside the slots, so the fabric average and percentiles read in O(1)
+ * without any lock; the count and the sum are read separately and may be one update apart.
+ *
+ * Sizing: reset() reallocates the slots and must be called with the unique graph lock
+ * held; read() and modify() need at least the shared graph lock so the array cannot be
+ * replaced underneath them.
+ */
+class LinkStatsTable
+{
+  public:
+    using EdgeId = uint32_t;
+
+    /**
+     * @brief Size the table for @p graph and seed every slot from its EdgeProperties.
+     */
+    void reset(const Graph& graph);
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    /// Bytes of the edge slots and vertex loads.
+    size_t memoryBytes() const
+    {
+        return m_size * sizeof(Slot) + m_vertexCount * sizeof(VertexLoad);
+    }
+
+    /**
+     * @brief Consistent copy of the counters of edge @p id (zeros if out of range).
+     */
+    LinkStats read(EdgeId id) const;
+
+    /**
+     * @brief Sum of linkBandwidthUsage over the edges ending at @p vertex (0 if unknown).
+     */
+    uint64_t ingressLoad(size_t vertex) const;
+
+    /**
+     * @brief Sum of linkBandwidthUsage over the edges starting at @p vertex (0 if unknown).
+     */
+    uint64_t egressLoad(size_t vertex) const;
+
+    /**
+     * @brief Record whether edge @p id is up; only up edges count towards the fabric summary.
+     *
+     * Needs the unique graph lock, like every change of EdgeProperties::isUp it mirrors.
+     */
+    void setUp(EdgeId id, bool up);
+
+    /// Fabric links currently carrying traffic.
+    size_t fabricLinks() const;
+
+    /// Mean linkBandwidthUsage / linkBandwidth over the fabric links (0 if there are none).
+    double fabricAverageUsage() const;
+
+    /**
+     * @brief Usage ratio that a fraction @p q of the fabric links do not exceed, to the 1%
+     *        of the histogram bucket holding it (0 if there are no fabric links).
+     */
+    double fabricUsagePercentile(double q) const;
+
+    /**
+     * @brief Copy the counters of every edge of @p graph into its EdgeProperties.
+     */
+    void materialize(Graph& graph) const;
+
+    /**
+     * @brief Read-modify-write the counters of edge @p id as one atomic update.
+     *
+     * @p fn receives a LinkStats& holding the current values and edits it in place.
+     */
+    template <typename Fn>
+    void modify(EdgeId id, Fn&& fn)
+    {
+        if (id >= m_size)
+        {
+            return;
+        }
+        Slot& slot = m_slots[id];
+        uint32_t seq = lockSlot(slot);
+        LinkStats stats = loadFields(slot);
+        const LinkStats before = stats;
+        const uint64_t usage = stats.linkBandwidthUsage;
+        fn(stats);
+        storeFields(slot, stats);
+        if (slot.fabric && slot.up)
+        {
+            moveFabricShare(fabricShare(before), fabricShare(stats));
+        }
+        // Unsigned wrap-around turns the difference into a decrement when usage falls
+        const uint64_t delta = stats.linkBandwidthUsage - usage;
+        if (delta != 0)
+        {
+            m_loads[slot.target].ingress.fetch_add(delta, std::memory_order_relaxed);
+            m_loads[slot.source].egress.fetch_add(delta, std::memory_order_relaxed);
+        }
+        // Release: a reader that sees the new epoch also sees this slot locked or updated
+        slot.modifiedAt.store(m_epoch.fetch_add(1, std::memory_order_acq_rel) + 1,
+                              std::memory_order_relaxed);
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief Fill @p out (indexed by edge id) with the epoch of each edge's last update.
+     *
+     * An edge whose stamp is greater than an epoch() read earlier changed after that read.
+     */
+    void modifiedAt(std::vector<uint64_t>& out) const;
+
+    /**
+     * @brief Counter bumped by every modify(); lets snapshot caches detect stale copies.
+     */
+    uint64_t epoch() const
+    {
+        return m_epoch.load(std::memory_order_acquire);
+    }
+
+  private:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint32_t> seq{0};
+        std::atomic<uint64_t> leftBandwidth{0};
+        std::atomic<uint64_t> linkBandwidth{0};
+        std::atomic<uint64_t> linkBandwidthUsage{0};
+        std::atomic<double> linkBandwidthUtilization{0};
+        std::atomic<uint64_t> leftBandwidthFromFlowSample{0};
+        std::atomic<uint64_t> modifiedAt{0};
+        uint32_t source = 0; // vertices of the edge, set by reset()
+        uint32_t target = 0;
+        bool fabric = false; // both ends are switches, set by reset()
+        bool up = false;     // EdgeProperties::isUp, see setUp()
+    };
+
+    // Contribution of one edge to the fabric summary
+    struct FabricShare
+    {
+        bool counted = false;
+        uint64_t ppb = 0; // usage ratio in parts per billion, so sums stay exact
+        bool operator==(const FabricShare&) const = default;
+    };
+
+    struct VertexLoad
+    {
+        std::atomic<uint64_t> ingress{0};
+        std::atomic<uint64_t> egress{0};
+    };
+
+    /**
+     * @brief Spin until the slot's sequence is even and flip it to odd.
+     * @return The even sequence number that was replaced.
+     */
+    static uint32_t lockSlot(Slot& slot);
+    static LinkStats loadFields(const Slot& slot);
+    static void storeFields(Slot& slot, const LinkStats& stats);
+    static FabricShare fabricShare(const LinkStats& stats);
+    void moveFabricShare(const FabricShare& from, const FabricShare& to);
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_size = 0;
+    std::unique_ptr<VertexLoad[]> m_loads;
+    size_t m_vertexCount = 0;
+    std::atomic<uint64_t> m_epoch{0};
+    std::atomic<uint64_t> m_fabricLinks{0};
+    std::atomic<uint64_t> m_fabricSumPpb{0};
+    std::array<std::atomic<uint64_t>, FABRIC_USAGE_BUCKETS> m_fabricHistogram{};
+};
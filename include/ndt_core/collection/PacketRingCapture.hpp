@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint16_t, uint32_t, uint64_t, int64_t
+#include <string>  // for string
+#include <vector>  // for vector
+
+#define PACKET_RING_BLOCK_SIZE (1 << 22) // bytes per ring block, a multiple of the page size
+#define PACKET_RING_BLOCK_COUNT 32       // blocks per worker (128 MiB of ring)
+#define PACKET_RING_FRAME_SIZE 2048      // nominal frame size TPACKET_V3 asks for
+#define PACKET_RING_BLOCK_TIMEOUT_MS 8   // a partly filled block is handed over after this
+
+struct tpacket_block_desc;
+
+namespace sflow
+{
+
+/**
+ * @brief sFlow datagrams read from an AF_PACKET TPACKET_V3 receive ring.
+ *
+ * The kernel copies frames into a ring shared with the process in blocks of many frames and
+ * hands a block over once it is full or PACKET_RING_BLOCK_TIMEOUT_MS old, so one poll()
+ * wakeup delivers hundreds of datagrams and none of them is copied again: the UDP payload is
+ * handed to the caller where it lies in the ring. A classic BPF filter keeps everything but
+ * unfragmented IPv4 UDP to the sFlow port out of the ring.
+ *
+ * The frames bypass the UDP socket layer, so nothing needs to listen on the port; with
+ * several workers each opens its own ring in one PACKET_FANOUT_HASH group, which spreads
+ * the datagrams by flow hash (all datagrams of one agent land on the same worker).
+ *
+ * Owned by one thread.
+ */
+class PacketRingCapture
+{
+  public:
+    struct Datagram
+    {
+        const char* data; // UDP payload, valid until the next poll()
+        size_t length;
+        int64_t receivedMs; // kernel receive time, utils::getCurrentTimeMillisSystemClock()
+    };
+
+    /**
+     * @brief Open the ring on @p interface for UDP datagrams to @p port, joining fanout
+     *        group @p fanoutGroup if it is not negative.
+     * @throws std::runtime_error if the socket or the ring cannot be set up (AF_PACKET needs
+     *         CAP_NET_RAW).
+     */
+    PacketRingCapture(const std::string& interface, uint16_t port, int fanoutGroup);
+    ~PacketRingCapture();
+
+    PacketRingCapture(const PacketRingCapture&) = delete;
+    PacketRingCapture& operator=(const PacketRingCapture&) = delete;
+
+    /**
+     * @brief Wait up to @p timeoutMs for a block, then append the datagrams of every block
+     *        the kernel has handed over to @p out (cleared first).
+     *
+     * The blocks read by the previous call are given back to the kernel first, so the
+     * datagrams of that call are no longer valid.
+     * @return false if the socket failed.
+     */
+    bool poll(int timeoutMs, std::vector<Datagram>& out);
+
+    /// Frames the ring had no room for, since the ring was opened (PACKET_STATISTICS)
+    uint64_t kernelDrops();
+    /// Frames that passed the filter but did not hold a whole UDP datagram
+    uint64_t malformedFrames() const
+    {
+        return m_malformed;
+    }
+
+  private:
+    tpacket_block_desc* block(size_t index) const;
+    void releaseBlocks();
+
+    int m_fd = -1;
+    char* m_ring = nullptr;
+    size_t m_ringSize = 0;
+    size_t m_nextBlock = 0;
+    size_t m_heldBlocks = 0; // blocks read by the last poll(), from m_nextBlock - m_heldBlocks
+    uint64_t m_drops = 0;
+    uint64_t m_malformed = 0;
+};
+
+} // namespace sflow
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "common_types/PathPool.hpp" // for PathHandle
+#include <atomic>                    // for atomic
+#include <cstddef>                   // for size_t
+#include <cstdint>                   // for uint32_t, uint64_t
+#include <memory>                    // for unique_ptr
+#include <nlohmann/json.hpp>         // for json
+#include <optional>                  // for optional
+#include <shared_mutex>              // for shared_mutex
+#include <unordered_map>             // for unordered_map
+#include <utility>                   // for pair
+#include <vector>                    // for vector
+
+#define PATH_RESIDUAL_CHANGE_PERCENT 5      // leftBandwidth moves, in % of the link, that count
+#define PATH_RESIDUAL_CACHE_MAX_PATHS 65536 // the cache starts over when it grows past this
+
+/**
+ * @brief Bottleneck residual bandwidth (the smallest leftBandwidth of its edges) of interned
+ *        paths, indexed by PathPool id, valid for one graph version.
+ *
+ * Each edge (EdgeProperties::statsId) carries a generation, bumped by update() whenever its
+ * leftBandwidth has moved more than PATH_RESIDUAL_CHANGE_PERCENT of the link bandwidth since
+ * the last bump. An entry keeps the generations of its edges as they were when it was
+ * computed and is valid while none has moved, so a lookup costs one hash probe and one read
+ * per hop however often the counters update, and returns a residual within that margin of
+ * the current one. Link state and topology changes go through the graph version, which
+ * drops every entry like CandidatePathCache does. Entries hold their PathHandle, so a path
+ * id is not reused while cached.
+ *
+ * Like CongestionIndex, reset() must be called with the unique graph lock held and update()
+ * from inside LinkStatsTable::modify() of the edge; the other members are thread-safe.
+ */
+class PathResidualCache
+{
+  public:
+    using EdgeId = uint32_t;
+
+    /// Size the generations for edge ids below @p edges and drop every entry.
+    void reset(size_t edges);
+
+    /// Record edge @p id's new @p leftBandwidth out of @p linkBandwidth.
+    void update(EdgeId id, uint64_t leftBandwidth, uint64_t linkBandwidth);
+
+    /// Current generation of edge @p id (0 if out of range).
+    uint64_t generation(EdgeId id) const;
+
+    /// The cached residual of @p path at @p graphVersion, if still valid.
+    std::optional<uint64_t> find(uint64_t graphVersion, const sflow::PathHandle& path) const;
+
+    /**
+     * @brief Cache @p residual for @p path at @p graphVersion, computed from @p edges with
+     *        the generations each had before its counters were read.
+     */
+    void insert(uint64_t graphVersion,
+                const sflow::PathHandle& path,
+                uint64_t residual,
+                std::vector<std::pair<EdgeId, uint64_t>> edges);
+
+    /// {"paths", "version", "hits", "misses", "stale"}
+    nlohmann::json statsJson() const;
+
+    /// Estimated heap bytes of the edge marks and the cached paths.
+    size_t memoryBytes() const;
+
+  private:
+    struct Entry
+    {
+        sflow::PathHandle path; // keeps the id interned
+        uint64_t residual = 0;
+        std::vector<std::pair<EdgeId, uint64_t>> edges; // (edge, generation)
+    };
+
+    struct EdgeMark
+    {
+        std::atomic<uint64_t> generation{0};
+        uint64_t leftBandwidth = 0; // at the last bump; written under the LinkStatsTable slot
+    };
+
+    std::unique_ptr<EdgeMark[]> m_marks;
+    size_t m_size = 0;
+
+    mutable std::shared_mutex m_mutex; // guards the entries and m_version
+    uint64_t m_version = 0;
+    std::unordered_map<uint32_t, Entry> m_entries;
+    mutable std::atomic<uint64_t> m_hits{0};
+    mutable std::atomic<uint64_t> m_misses{0};
+    mutable std::atomic<uint64_t> m_stale{0}; // misses on an entry an edge change outdated
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "common_types/GraphTypes.hpp"      // for Graph
+#include "common_types/SFlowType.hpp"       // for Path, Key, KeyHash
+#include "ndt_core/collection/CsrGraph.hpp" // for CsrGraph
+#include <cstddef>                          // for size_t
+#include <cstdint>                          // for uint32_t, uint64_t
+#include <tuple>                            // for tuple
+#include <unordered_map>                    // for unordered_map
+#include <unordered_set>                    // for unordered_set
+#include <utility>                          // for pair
+#include <vector>                           // for vector
+
+#define ROUTING_MAX_WORKERS 8 // threads computeAll() spreads destinations over
+
+/**
+ * @brief Destination-rooted shortest-path forwarding over a topology Graph.
+ *
+ * For each destination host, a BFS from the switch it is attached to, over the up and
+ * enabled vertices and edges, gives every reached switch a /32 rule (priority 100) towards
+ * the host and every source host a path to it. Among equally short next hops the BFS
+ * visits neighbours in the order of a per-destination hash of their dpid, so different
+ * destinations spread over parallel links. This is what
+ * TopologyAndFlowMonitor::bfsAllPathsToDst() has always computed.
+ *
+ * The BFS walks a CsrGraph built once per engine and keeps its state in vertex-indexed
+ * arrays that are reused from one destination to the next (a visit stamp replaces
+ * clearing), so routing does not allocate or chase pointers per BFS step. Rules are
+ * deduplicated by (net, mask, priority) through hashed per-switch sets instead of a scan of
+ * the switch's rule list.
+ *
+ * computeAll() spreads destinations over worker threads, each with its own scratch
+ * buffers, and merges their rules in destination order, so its output does not depend on
+ * the number of threads. The engine works on the graph as it was when constructed.
+ */
+class RoutingEngine
+{
+  public:
+    using Vertex = Graph::vertex_descriptor;
+    using Rule = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>; // net, mask, out, priority
+    using OpenflowTables = std::unordered_map<uint64_t, std::vector<Rule>>;
+
+    /**
+     * @brief A host and the switch port it hangs off (EdgeProperties::dstInterface of its
+     *        host -> switch edge).
+     */
+    struct Host
+    {
+        uint32_t ip;
+        Vertex vertex;
+        Vertex attachedSwitch;
+        uint32_t switchPort;
+    };
+
+    /**
+     * @brief Route between @p hosts in @p graph; @p hosts must outlive the engine.
+     */
+    RoutingEngine(const Graph& graph, const std::vector<Host>& hosts);
+
+    /**
+     * @brief Rules and paths towards @p dstIp, whose host vertex hangs off @p dstSwitch.
+     *
+     * @p dstHost may be null_vertex() if the host is not in the graph; then only the rules
+     * of the switches reaching @p dstSwitch are computed and no path is returned. New rules
+     * are appended to @p tables; a rule whose (net, mask, priority) a switch already has is
+     * skipped.
+     *
+     * @return One path per source host other than @p dstIp whose switch reaches
+     *         @p dstSwitch, from (srcIp, switchPort) to (dstIp, 0).
+     */
+    std::vector<sflow::Path> computeToDestination(uint32_t dstIp,
+                                                  Vertex dstHost,
+                                                  Vertex dstSwitch,
+                                                  OpenflowTables& tables);
+
+    /**
+     * @brief computeToDestination() for every host, on up to @p workers threads
+     *        (0: hardware concurrency, capped at ROUTING_MAX_WORKERS).
+     * @return The paths of all destinations, grouped by destination in host order.
+     */
+    std::vector<sflow::Path> computeAll(OpenflowTables& tables, size_t workers = 0);
+
+  private:
+    // Per-thread BFS state, indexed by vertex
+    struct Scratch
+    {
+        std::vector<uint32_t> visited; // == stamp if reached in the current BFS
+        std::vector<Vertex> parent;    // next hop towards the destination
+        std::vector<uint32_t> outPort; // port of the vertex -> parent edge
+        std::vector<char> hasOutPort;  // whether the vertex -> parent edge exists
+        std::vector<Vertex> queue;
+        std::vector<std::pair<uint64_t, CsrGraph::EdgeId>> neighbors; // (tie-break rank, edge)
+        uint32_t stamp = 0;
+    };
+
+    // Output of one destination before it is merged into the tables
+    struct Routes
+    {
+        std::vector<std::pair<uint64_t, Rule>> rules; // (dpid, rule) in discovery order
+        std::vector<sflow::Path> paths;
+    };
+
+    using RuleSet = std::unordered_set<sflow::Key, sflow::KeyHash>; // (net, mask, priority)
+    using RuleSets = std::unordered_map<uint64_t, RuleSet>;
+
+    /**
+     * @brief Rank deciding the BFS order of equally short next hops: the first 8 bytes of
+     *        SHA-256 over the dotted @p dstIp followed by the decimal @p dpid.
+     */
+    static uint64_t tieBreakRank(const char* dstIpText, size_t dstIpLength, uint64_t dpid);
+
+    void route(uint32_t dstIp,
+               Vertex dstHost,
+               Vertex dstSwitch,
+               Scratch& scratch,
+               Routes& out) const;
+
+    /**
+     * @brief Append the rules of @p routes that @p tables does not have yet.
+     *
+     * @p known caches the rule identities of every switch of @p tables seen so far; a
+     * switch's set is built from its table the first time one of its rules is merged.
+     */
+    static void merge(Routes& routes, OpenflowTables& tables, RuleSets& known);
+
+    CsrGraph m_csr;
+    const std::vector<Host>& m_hosts;
+    Scratch m_scratch; // used by the calling thread
+};
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint32_t, uint64_t
+#include <optional> // for optional
+
+namespace sflow
+{
+
+/**
+ * @file SFlowDecoder.hpp
+ * @brief Zero-copy, bounds-checked views over raw sFlow v5 datagrams.
+ *
+ * @details
+ * The views never copy or allocate: they keep a pointer into the receive buffer and
+ * read big-endian 32-bit words on demand. Every read is checked against the datagram
+ * length (and against the declared sample length), so truncated or malformed datagrams
+ * make the decoders return std::nullopt instead of reading past the buffer.
+ *
+ * Typical use:
+ * @code
+ * DatagramView dg(buffer, length);
+ * if (!dg.valid()) return;
+ * for (SampleView sample : dg)
+ * {
+ *     if (sample.isCounterSample()) { auto c = decodeCounterSample(sample); ... }
+ *     else if (sample.isFlowSample()) { auto f = decodeFlowSample(sample, mininet); ... }
+ * }
+ * @endcode
+ *
+ * @par Vendor layouts
+ * Field offsets follow what the switches in our testbeds export, one layout struct each
+ * (see the layout namespace):
+ * - Counter samples: Brocade type 2 (base offset 4, one leading record), HPE type 4
+ *   (base offset 5).
+ * - Flow samples: Brocade / Open vSwitch type 1, HPE type 3. On Mininet (hsflowd on OVS)
+ *   the first record of a type 1 sample is skipped before reading the header record.
+ *
+ * The decoders are templates over the layout, so every offset is a constant. The ingest
+ * path picks a DecoderProfile per agent once and calls its decoders directly; adding a
+ * vendor is a layout struct, its explicit instantiation and a profile.
+ */
+
+/**
+ * @brief A single sample inside a datagram (type word, length word, then body).
+ *
+ * Offsets passed to word() are in 32-bit words relative to the sample's type word,
+ * which is how the vendor layouts are documented in the decoders.
+ */
+class SampleView
+{
+  public:
+    SampleView() = default;
+    SampleView(const unsigned char* base, size_t words)
+        : m_base(base),
+          m_words(words)
+    {
+    }
+
+    uint32_t type() const;
+    /**
+     * @brief Declared body length in bytes (second word of the sample).
+     */
+    uint32_t length() const;
+    /**
+     * @brief Number of 32-bit words covered by this sample, including type and length.
+     */
+    size_t sizeInWords() const
+    {
+        return m_words;
+    }
+
+    /**
+     * @brief Read the host-order word at @p offset, failing if it lies outside the sample.
+     */
+    bool word(size_t offset, uint32_t& out) const;
+
+    bool isCounterSample() const
+    {
+        uint32_t t = type();
+        return t == 2 || t == 4;
+    }
+
+    bool isFlowSample() const
+    {
+        uint32_t t = type();
+        return t == 1 || t == 3;
+    }
+
+  private:
+    const unsigned char* m_base = nullptr;
+    size_t m_words = 0;
+};
+
+/**
+ * @brief Forward iterator over the samples of a DatagramView.
+ *
+ * Stops early (compares equal to end) when a sample's declared length runs past the end
+ * of the datagram, so a truncated datagram yields only its complete samples.
+ */
+class SampleIterator
+{
+  public:
+    SampleIterator() = default;
+    SampleIterator(const unsigned char* cursor, const unsigned char* end, uint32_t remaining);
+
+    const SampleView& operator*() const
+    {
+        return m_current;
+    }
+
+    const SampleView* operator->() const
+    {
+        return &m_current;
+    }
+
+    SampleIterator& operator++();
+
+    bool operator==(const SampleIterator& other) const
+    {
+        return m_remaining == other.m_remaining;
+    }
+
+  private:
+    void load();
+
+    const unsigned char* m_cursor = nullptr;
+    const unsigned char* m_end = nullptr;
+    uint32_t m_remaining = 0;
+    SampleView m_current;
+};
+
+/**
+ * @brief Read-only view of an sFlow v5 datagram with an IPv4 agent address.
+ */
+class DatagramView
+{
+  public:
+    DatagramView(const char* buffer, size_t length);
+
+    /**
+     * @brief True when the header is complete, the version is 5 and the agent is IPv4.
+     */
+    bool valid() const
+    {
+        return m_valid;
+    }
+
+    uint32_t version() const
+    {
+        return m_version;
+    }
+
+    /**
+     * @brief Agent IPv4 address in network byte order (as used by AgentKey).
+     */
+    uint32_t agentIp() const
+    {
+        return m_agentIp;
+    }
+
+    uint32_t sampleCount() const
+    {
+        return m_sampleCount;
+    }
+
+    SampleIterator begin() const;
+    SampleIterator end() const;
+
+  private:
+    const unsigned char* m_data;
+    size_t m_length;
+    bool m_valid = false;
+    uint32_t m_version = 0;
+    uint32_t m_agentIp = 0;
+    uint32_t m_sampleCount = 0;
+};
+
+// ifStatus bits of the generic interface counters (ifAdminStatus / ifOperStatus up)
+inline constexpr uint32_t IF_STATUS_ADMIN_UP = 1;
+inline constexpr uint32_t IF_STATUS_OPER_UP = 2;
+
+/**
+ * @brief Interface counters extracted from a counter sample.
+ */
+struct CounterSampleRecord
+{
+    uint32_t sampleType = 0;
+    uint32_t sampleLength = 0;
+    uint32_t interfaceIndex = 0;
+    uint32_t interfaceStatus = IF_STATUS_ADMIN_UP | IF_STATUS_OPER_UP; // IF_STATUS_* bits
+    uint64_t interfaceSpeed = 0;
+    uint64_t inputOctets = 0;
+    uint64_t outputOctets = 0;
+};
+
+/**
+ * @brief Header fields extracted from a flow sample.
+ *
+ * Only etherType is meaningful when isIpv4() is false; L4 fields are zero when they do
+ * not apply (ports for ICMP, ICMP type/code for TCP/UDP).
+ */
+struct FlowSampleRecord
+{
+    uint32_t sampleType = 0;
+    uint32_t samplingRate = 0;
+    uint32_t inputPort = 0;
+    uint32_t outputPort = 0;
+    uint32_t frameLength = 0;
+    uint16_t etherType = 0;
+    uint8_t protocol = 0;
+    uint32_t srcIp = 0; // network byte order
+    uint32_t dstIp = 0; // network byte order
+    uint16_t srcPort = 0;
+    uint16_t dstPort = 0;
+    uint16_t icmpType = 0;
+    uint16_t icmpCode = 0;
+    bool isAck = false;
+
+    bool isIpv4() const
+    {
+        return etherType == 0x0800;
+    }
+};
+
+/**
+ * @brief Word offsets of the vendor sample layouts, relative to the sample's type word.
+ */
+namespace layout
+{
+
+struct BrocadeCounters
+{
+    static constexpr uint32_t TYPE = 2;
+    static constexpr size_t BASE = 4 + 15; // generic interface counters after a 15-word record
+};
+
+struct HpeCounters
+{
+    static constexpr uint32_t TYPE = 4;
+    static constexpr size_t BASE = 5;
+};
+
+struct BrocadeFlows
+{
+    static constexpr uint32_t TYPE = 1;
+    static constexpr size_t SAMPLING_RATE = 4;
+    static constexpr size_t INPUT_PORT = 7;
+    static constexpr std::optional<size_t> OUTPUT_PORT = std::nullopt;
+    // Word holding the length of a leading record to skip; nullopt if there is none
+    static constexpr std::optional<size_t> LEADING_RECORD_LENGTH = std::nullopt;
+    static constexpr size_t FRAME_LENGTH = 13;
+    static constexpr size_t ETHER_TYPE = 19; // high half
+    static constexpr size_t HEADER = 21;     // IPv4 protocol in the low byte
+};
+
+// hsflowd on Open vSwitch (Mininet): a Brocade layout behind one extra record
+struct MininetFlows : BrocadeFlows
+{
+    static constexpr std::optional<size_t> LEADING_RECORD_LENGTH = 11;
+};
+
+struct HpeFlows
+{
+    static constexpr uint32_t TYPE = 3;
+    static constexpr size_t SAMPLING_RATE = 5;
+    static constexpr size_t INPUT_PORT = 9;
+    static constexpr std::optional<size_t> OUTPUT_PORT = 11;
+    static constexpr std::optional<size_t> LEADING_RECORD_LENGTH = std::nullopt;
+    static constexpr size_t FRAME_LENGTH = 12 + 4;
+    static constexpr size_t ETHER_TYPE = 12 + 6 + 5;
+    static constexpr size_t HEADER = 12 + 6 + 7;
+};
+
+} // namespace layout
+
+/**
+ * @brief Decode a counter sample laid out as @p Layout (a layout::*Counters).
+ * @return std::nullopt if the sample is of another type or too short for the layout.
+ */
+template <typename Layout>
+std::optional<CounterSampleRecord> decodeCounterSampleAs(const SampleView& sample);
+
+/**
+ * @brief Decode a flow sample laid out as @p Layout (a layout::*Flows).
+ * @return std::nullopt if the sample is of another type or too short for the layout.
+ */
+template <typename Layout>
+std::optional<FlowSampleRecord> decodeFlowSampleAs(const SampleView& sample);
+
+/**
+ * @brief The decoders of one kind of agent, for the sample types it sends.
+ */
+struct DecoderProfile
+{
+    const char* name;
+    uint32_t counterType;
+    std::optional<CounterSampleRecord> (*decodeCounters)(const SampleView&);
+    uint32_t flowType;
+    std::optional<FlowSampleRecord> (*decodeFlows)(const SampleView&);
+
+    bool decodes(uint32_t type) const
+    {
+        return type == counterType || type == flowType;
+    }
+};
+
+/**
+ * @brief Profile of an agent that sends samples of @p type; nullptr if no known agent does.
+ * @param mininet Type 1 samples come from hsflowd on OVS (layout::MininetFlows).
+ */
+const DecoderProfile* profileForSampleType(uint32_t type, bool mininet);
+
+/**
+ * @brief Decode a Brocade (type 2) or HPE (type 4) counter sample.
+ * @return std::nullopt if the sample is of another type or too short for its layout.
+ */
+std::optional<CounterSampleRecord> decodeCounterSample(const SampleView& sample);
+
+/**
+ * @brief Decode a type 1 or HPE (type 3) flow sample.
+ *
+ * @param sample  Sample view positioned on the flow sample.
+ * @param mininet Skip the leading record that hsflowd on OVS emits for type 1 samples.
+ * @return std::nullopt if the sample is of another type or too short for its layout.
+ */
+std::optional<FlowSampleRecord> decodeFlowSample(const SampleView& sample, bool mininet);
+
+} // namespace sflow
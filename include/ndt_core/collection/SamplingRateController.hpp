@@ -0,0 +1,98 @@
+#pragma once
+
+#include "utils/SnmpClient.hpp" // for SnmpOid
+#include <cstdint>              // for uint32_t, uint64_t, int64_t
+#include <mutex>                // for mutex
+#include <nlohmann/json.hpp>    // for json
+#include <string>               // for string
+#include <unordered_map>        // for unordered_map
+#include <vector>               // for vector
+
+#define SAMPLING_CONTROL_PERIOD_MS 10000 // one control step per period
+#define SAMPLING_CONTROL_HIGH 0.9        // above this share of the budget, rates go up
+#define SAMPLING_CONTROL_LOW 0.4         // below it, raised rates come back down
+#define SAMPLING_CONTROL_TARGET 0.7      // share of the budget a step aims at
+// sFlowFsPacketSamplingRate of the sFlow MIB (sFlowAgent.sFlowFsTable.sFlowFsEntry.4)
+#define SAMPLING_CONTROL_RATE_OID "1.3.6.1.4.1.14706.1.1.5.1.4"
+
+namespace sflow
+{
+
+/**
+ * @brief Bounds of the adaptive sampling rate control; it is off unless
+ *        maxSamplesPerSecond is set.
+ */
+struct SamplingControlConfig
+{
+    uint64_t maxSamplesPerSecond = 0; // flow samples the collector should take, all agents
+    uint32_t maxSamplingRate = 65536; // never sample more sparsely than 1 in this
+    std::string community = "private"; // SNMP community with write access to the sFlow MIB
+};
+
+/**
+ * @brief Flow samples one agent sent per second over the last control period.
+ */
+struct AgentSampleLoad
+{
+    uint32_t agentIp; // network order
+    double samplesPerSecond;
+};
+
+/**
+ * @brief Keeps the flow sample load within SamplingControlConfig::maxSamplesPerSecond by
+ *        changing the sampling rates of the agents over SNMP (sFlow MIB).
+ *
+ * When the load is above SAMPLING_CONTROL_HIGH of the budget, or the collector dropped
+ * datagrams, the busiest agents get their sampling rate doubled (half the samples) until the
+ * projected load is SAMPLING_CONTROL_TARGET of the budget. Below SAMPLING_CONTROL_LOW, the
+ * agents it raised are halved back, the quietest first, never below the rate they had when
+ * first seen. Rates estimated from the samples are scaled by the sampling rate of each
+ * sample, so they stay unbiased across changes; only their variance grows.
+ *
+ * An agent's sampler rows are found by walking sFlowFsPacketSamplingRate, and a change sets
+ * every row of the agent. A step that changed rates is followed by one that only measures,
+ * since its period straddles the change, and no step runs while a SET is unanswered.
+ *
+ * Thread-safe; SNMP replies are applied on the SnmpClient thread.
+ */
+class SamplingRateController
+{
+  public:
+    explicit SamplingRateController(SamplingControlConfig config);
+
+    /// One control step over the last period's @p loads; @p dropping if datagrams were lost.
+    void step(const std::vector<AgentSampleLoad>& loads, bool dropping);
+
+    /// {"max_samples_per_second", "last_load", "agents": [{"agent", "rate", "initial_rate",
+    ///  "rows"}], "raises", "restores", "snmp_failures"}
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Agent
+    {
+        std::vector<utils::SnmpOid> rows; // sFlowFsPacketSamplingRate instances
+        uint32_t initialRate = 0;
+        uint32_t rate = 0;
+        bool discovering = false;
+        bool unsupported = false; // no sampler rows, or no answer to the walk
+    };
+
+    // Walk the sampler rows of @p agentIp (m_mutex held)
+    void discover(uint32_t agentIp, Agent& agent);
+    // Set every row of @p agentIp to @p rate (m_mutex held)
+    void push(uint32_t agentIp, Agent& agent, uint32_t rate);
+
+    const SamplingControlConfig m_config;
+    const utils::SnmpOid m_rateOid;
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint32_t, Agent> m_agents;
+    size_t m_inFlight = 0;  // SETs not answered yet
+    bool m_changed = false; // the last step changed rates
+    double m_lastLoad = 0;
+    uint64_t m_raises = 0;
+    uint64_t m_restores = 0;
+    uint64_t m_snmpFailures = 0;
+};
+
+} // namespace sflow
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "utils/FlatHashMap.hpp" // for FlatHashMap
+#include <cstddef>               // for size_t
+#include <cstdint>               // for uint32_t, uint64_t
+#include <optional>              // for optional
+
+/**
+ * @brief Bidirectional map between switch DPIDs and their (first) IPv4 address.
+ *
+ * Both directions are integer-keyed flat hash maps, so a lookup is one probe with no string
+ * conversion; addresses are formatted only where they leave the process (JSON, SSH, SNMP).
+ * A DPID or address inserted again replaces its previous pair.
+ */
+class SwitchAddressMap
+{
+  public:
+    void insert(uint64_t dpid, uint32_t ip)
+    {
+        if (auto old = ipOf(dpid))
+        {
+            m_dpidByIp.erase(*old);
+        }
+        if (auto old = dpidOf(ip))
+        {
+            m_ipByDpid.erase(*old);
+        }
+        m_ipByDpid[dpid] = ip;
+        m_dpidByIp[ip] = dpid;
+    }
+
+    /// IPv4 address (network byte order) of the switch @p dpid.
+    std::optional<uint32_t> ipOf(uint64_t dpid) const
+    {
+        auto it = m_ipByDpid.find(dpid);
+        if (it == m_ipByDpid.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    /// DPID of the switch with IPv4 address @p ip (network byte order).
+    std::optional<uint64_t> dpidOf(uint32_t ip) const
+    {
+        auto it = m_dpidByIp.find(ip);
+        if (it == m_dpidByIp.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    size_t size() const
+    {
+        return m_ipByDpid.size();
+    }
+
+    void clear()
+    {
+        m_ipByDpid.clear();
+        m_dpidByIp.clear();
+    }
+
+    template <typename F>
+    void forEach(F&& visit) const
+    {
+        for (const auto& [dpid, ip] : m_ipByDpid)
+        {
+            visit(dpid, ip);
+        }
+    }
+
+  private:
+    // Spreads the key over all 64 bits, as FlatHashMap needs
+    struct Hash
+    {
+        size_t operator()(uint64_t key) const
+        {
+            uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 32;
+            h *= 0xD6E8FEB86659FD93ULL;
+            h ^= h >> 32;
+            return static_cast<size_t>(h);
+        }
+    };
+
+    utils::FlatHashMap<uint64_t, uint32_t, Hash> m_ipByDpid;
+    utils::FlatHashMap<uint32_t, uint64_t, Hash> m_dpidByIp;
+};
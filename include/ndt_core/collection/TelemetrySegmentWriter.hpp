@@ -0,0 +1,75 @@
+#pragma once
+
+#include "common_types/GraphTypes.hpp"          // for Graph
+#include "common_types/SFlowType.hpp"           // for FlowKey
+#include "common_types/TelemetrySegment.hpp"    // for Segment
+#include "ndt_core/collection/TrafficMatrix.hpp" // for TrafficMatrix
+#include <atomic>                               // for atomic
+#include <cstdint>                              // for uint64_t
+#include <nlohmann/json.hpp>                    // for json
+#include <span>                                 // for span
+#include <string>                               // for string
+#include <utility>                              // for pair
+#include <vector>                               // for vector
+
+namespace sflow
+{
+
+/**
+ * @brief Writer side of the shared-memory telemetry segment (see telemetry::Segment).
+ *
+ * open() creates or reuses the POSIX shared-memory object and maps it; the collector then
+ * publishes the links, its fastest flows and the traffic matrix at every rate tick. Each
+ * publish rewrites one section under its sequence lock, so readers never block the writer
+ * and a reader's copy is either the previous publication or the new one. close() unlinks the
+ * object; readers that still map it keep the last publication.
+ *
+ * Called from the collector's rate task only.
+ */
+class TelemetrySegmentWriter
+{
+  public:
+    explicit TelemetrySegmentWriter(std::string name);
+    ~TelemetrySegmentWriter();
+
+    TelemetrySegmentWriter(const TelemetrySegmentWriter&) = delete;
+    TelemetrySegmentWriter& operator=(const TelemetrySegmentWriter&) = delete;
+
+    /// Create (or take over) and map the segment; false, logged, if that fails.
+    bool open();
+    void close();
+
+    /// Every directed link of @p graph; left bandwidth from flow samples if @p fromFlowSamples.
+    void publishLinks(const Graph& graph, bool fromFlowSamples);
+
+    /// @p ranked as (rate, flow) pairs in any order; written fastest first.
+    void publishTopFlows(std::span<const std::pair<uint64_t, FlowKey>> ranked);
+
+    void publishMatrix(const TrafficMatrix& matrix);
+
+    /// {"name", "mapped", "bytes", "publications", "links", "top_flows", "matrix_cells",
+    ///  "dropped"}
+    nlohmann::json statsJson() const;
+
+  private:
+    // Open @p section for rewriting; it stays odd until endWrite()
+    template <typename Section>
+    static void beginWrite(Section& section);
+    template <typename Section>
+    static void endWrite(Section& section, uint32_t count, uint32_t dropped);
+
+    std::string m_name;
+    telemetry::Segment* m_segment = nullptr;
+
+    std::vector<std::pair<uint64_t, FlowKey>> m_rankedScratch;
+    std::vector<TrafficMatrix::Cell> m_cellScratch;
+
+    std::atomic<bool> m_mapped{false};
+    std::atomic<uint64_t> m_publications{0};
+    std::atomic<uint64_t> m_links{0};
+    std::atomic<uint64_t> m_topFlows{0};
+    std::atomic<uint64_t> m_matrixCells{0};
+    std::atomic<uint64_t> m_dropped{0};
+};
+
+} // namespace sflow
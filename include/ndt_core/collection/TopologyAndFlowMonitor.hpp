@@ -1,37 +1,160 @@
 #pragma once
 
 #include "../setting/AppConfig.hpp"
-#include "common_types/GraphTypes.hpp" // for Graph
-#include "common_types/SFlowType.hpp"  // for FlowKey, Path
-#include "utils/Utils.hpp"             // for DeploymentMode
-#include <array>                       // for array
-#include <atomic>                      // for atomic
-#include <cstdint>                     // for uint32_t, uint64_t, int64_t
-#include <map>                         // for map
-#include <memory>                      // for shared_ptr
-#include <mutex>                       // for mutex
-#include <nlohmann/json.hpp>           // for json
-#include <optional>                    // for optional
-#include <set>                         // for set
-#include <shared_mutex>                // for shared_mutex
-#include <string>                      // for string, allocator
-#include <thread>                      // for thread
-#include <unordered_map>               // for unordered_map
-#include <utility>                     // for pair
-#include <vector>                      // for vector
-
-
-static const std::string TOPOLOGY_FILE = AppConfig::TOPOLOGY_FILE;
-
-static const std::string TOPOLOGY_FILE_MININET = AppConfig::TOPOLOGY_FILE_MININET;
+#include "common_types/GraphTypes.hpp"               // for Graph
+#include "common_types/SFlowType.hpp"                // for FlowKey, Path
+#include "event_system/EventPayloads.hpp"            // for LinkStateChangedEventData
+#include "ndt_core/collection/CandidatePaths.hpp"    // for CandidatePathCache
+#include "ndt_core/collection/CongestionIndex.hpp"   // for CongestionIndex
+#include "ndt_core/collection/CsrGraph.hpp"          // for CsrGraph
+#include "ndt_core/collection/EdgeFlowTable.hpp"     // for EdgeFlowTable
+#include "ndt_core/collection/LinkStatsTable.hpp"    // for LinkStatsTable
+#include "ndt_core/collection/PathResidualCache.hpp" // for PathResidualCache
+#include "ndt_core/collection/RoutingEngine.hpp"     // for RoutingEngine
+#include "ndt_core/collection/SwitchAddressMap.hpp"  // for SwitchAddressMap
+#include "ndt_core/collection/TopologyCache.hpp"     // for StaticTopology
+#include "ndt_core/collection/TopologyIndex.hpp"     // for TopologyIndex
+#include "utils/MemoryAccounting.hpp"                // for MemoryUsage
+#include "utils/RuntimeConfig.hpp"                   // for RuntimeConfig
+#include "utils/TaskScheduler.hpp"                   // for TaskScheduler
+#include "utils/Utils.hpp"                           // for DeploymentMode
+#include <array>                                     // for array
+#include <atomic>                                    // for atomic
+#include <chrono>                                    // for milliseconds, steady_clock
+#include <cstdint>                                   // for uint32_t, uint64_t, int64_t
+#include <memory>                                    // for shared_ptr
+#include <mutex>                                     // for mutex
+#include <nlohmann/json.hpp>                         // for json
+#include <optional>                                  // for optional
+#include <set>                                       // for set
+#include <shared_mutex>                              // for shared_mutex
+#include <string>                                    // for string, allocator
+#include <string_view>                               // for string_view
+#include <thread>                                    // for thread
+#include <tuple>                                     // for tuple
+#include <unordered_map>                             // for unordered_map
+#include <utility>                                   // for pair
+#include <vector>                                    // for vector
+
+// Site parameters: AppConfig's values unless the runtime configuration file sets them (read
+// at first use)
+inline const std::string&
+topologyFile()
+{
+    static const std::string path = utils::RuntimeConfig::instance().defineString(
+        "site.topology_file", "Static topology of the testbed", AppConfig::TOPOLOGY_FILE);
+    return path;
+}
+
+inline const std::string&
+topologyFileMininet()
+{
+    static const std::string path =
+        utils::RuntimeConfig::instance().defineString("site.topology_file_mininet",
+                                                      "Static topology of the Mininet network",
+                                                      AppConfig::TOPOLOGY_FILE_MININET);
+    return path;
+}
+
+// "host:port" of Ryu's REST API
+inline const std::string&
+ryuAddress()
+{
+    static const std::string address = utils::RuntimeConfig::instance().defineString(
+        "site.ryu_address", "host:port of Ryu's REST API", AppConfig::RYU_IP_AND_PORT);
+    return address;
+}
+
+// Further Ryu instances, each serving a group of switches: "host:port=dpids;host:port=dpids"
+// with dpids a comma-separated list of decimal ids and first-last ranges. Switches not listed
+// are served by ryuAddress(); "none" sends everything there.
+inline const std::string&
+ryuShards()
+{
+    static const std::string shards = utils::RuntimeConfig::instance().defineString(
+        "site.ryu_shards", "host:port=dpids;... of Ryu instances serving some switches", "none");
+    return shards;
+}
+
+// "host:port" of the Ryu instance serving switch @p dpid
+const std::string& ryuAddressFor(uint64_t dpid);
+
+// Every Ryu instance, ryuAddress() first
+const std::vector<std::string>& ryuAddresses();
 
 static constexpr uint64_t EMPTY_LINK_THRESHOLD = 700000000;
 static constexpr uint64_t MICE_FLOW_UNDER_THRESHOLD = 10000000;
 
+#define TOPOLOGY_RESYNC_INTERVAL_S 300 // full re-fetch from Ryu, in case events were missed
+
 using json = nlohmann::json;
 
 class EventBus;
 
+/**
+ * @brief Read-only copy of the topology graph as of one graph version.
+ */
+struct GraphSnapshot
+{
+    Graph graph;
+    CsrGraph csr; // dense view of graph, for scans and path searches
+    uint64_t version = 0;
+    uint64_t statsEpoch = 0; // LinkStatsTable::epoch() at copy time
+    uint64_t flowsEpoch = 0; // EdgeFlowTable::epoch() at copy time
+    // Indexed by EdgeProperties::statsId: stamps of each edge's last counter update and last
+    // flow membership change, comparable with statsEpoch / flowsEpoch
+    std::vector<uint64_t> statsModifiedAt;
+    std::vector<uint64_t> flowsModifiedAt;
+    std::chrono::steady_clock::time_point takenAt;
+
+    /**
+     * @brief "<version>-<statsEpoch>-<flowsEpoch>": ETag of the snapshot and cursor for
+     *        delta queries.
+     */
+    std::string versionToken() const;
+
+    /**
+     * @brief True if @p edge may have changed after a snapshot with the given epochs.
+     */
+    bool edgeChangedSince(const EdgeProperties& edge,
+                          uint64_t sinceStatsEpoch,
+                          uint64_t sinceFlowsEpoch) const;
+};
+
+/**
+ * @brief Traffic through one switch, summed over its links as the counters are updated.
+ */
+struct SwitchLoad
+{
+    uint64_t ingressBps = 0; // linkBandwidthUsage of the edges ending at the switch
+    uint64_t egressBps = 0;  // linkBandwidthUsage of the edges starting at it
+    uint64_t flows = 0;      // flow memberships of the edges ending at it
+};
+
+/**
+ * @brief One change reported by Ryu's topology events.
+ *
+ * @c body is the switch, link or host object in the JSON form of Ryu's topology REST API
+ * ({"dpid"}, {"src": {"dpid", "port_no"}, "dst": {...}}, {"mac", "ipv4", "port": {"dpid"}}).
+ */
+struct TopologyEvent
+{
+    enum class Type
+    {
+        SwitchEnter,
+        SwitchLeave,
+        LinkAdd,
+        LinkDelete,
+        HostAdd,
+    };
+
+    Type type;
+    json body;
+
+    /// "switch_enter", "switch_leave", "link_add", "link_delete" or "host_add".
+    static std::optional<Type> parseType(std::string_view name);
+};
+
 class TopologyAndFlowMonitor
 {
   public:
@@ -44,9 +167,11 @@ class TopologyAndFlowMonitor
     /**
      * @brief Starts the topology and flow monitoring services.
      *
-     * This function sets the running flag to true and spawns two background threads:
+     * This function sets the running flag to true and starts:
      * 1. The main monitoring thread (run) for fetching topology data.
-     * 2. The flow flushing thread (flushEdgeFlowLoop) for cleaning up stale flows.
+     * 2. The edge flow flushing task (flushEdgeFlows, every second on the process-wide
+     *    utils::TaskScheduler) for cleaning up stale flows.
+     * 3. The full topology resync from Ryu (every TOPOLOGY_RESYNC_INTERVAL_S, same scheduler).
      */
     void start();
 
@@ -54,7 +179,7 @@ class TopologyAndFlowMonitor
      * @brief Destructor for the TopologyAndFlowMonitor class.
      *
      * Calls the stop() method to terminate the monitoring thread and the edge flow
-     * flushing thread, ensuring a clean shutdown and proper resource release.
+     * flushing task, ensuring a clean shutdown and proper resource release.
      */
     void stop();
 
@@ -71,13 +196,32 @@ class TopologyAndFlowMonitor
      *
      * @param path The file system path to the JSON topology file.
      *
+     * The parsed topology is kept in a compiled cache next to the file (see TopologyCache.hpp);
+     * while the file is unchanged, later starts load the cache instead of parsing the JSON.
+     *
      * @note If the file cannot be opened, an error is logged and the function returns without
      * modifying the graph.
      * @note If an edge's source or destination cannot be resolved in the graph, the edge is skipped
      * and a warning is logged.
+     *
+     * run() calls it with the configured file at start; tools call it directly to load a
+     * topology without a controller. Switches, hosts and links stay down until
+     * applyTopologyEvents() reports them.
      */
+    void loadStaticTopology(const std::string& path);
+
     void logGraph();
 
+    /**
+     * @brief Apply @p events to the graph in one batch, under a single write lock (one graph
+     *        version bump), in order. Events naming devices or links missing from the static
+     *        topology, or malformed ones, are logged and skipped.
+     *
+     * @return The edges whose state changed, for a LinkStateChanged event; affectedFlows is
+     *         left to the caller, which owns the flow paths.
+     */
+    LinkStateChangedEventData applyTopologyEvents(const std::vector<TopologyEvent>& events);
+
     void updateLinkInfo(std::pair<uint32_t, uint32_t> agentIpAndPort,
                         uint64_t leftIn,
                         uint64_t leftOut,
@@ -99,6 +243,9 @@ class TopologyAndFlowMonitor
     std::optional<Graph::edge_descriptor> findReverseEdgeByAgentIpAndPortNoLock(
         const std::pair<uint32_t, uint32_t>& agentIpAndPort) const;
 
+    /// The target -> source edge of @p e, if the graph has one. One index lookup, no scan.
+    std::optional<Graph::edge_descriptor> findReverseEdge(Graph::edge_descriptor e) const;
+
     std::optional<std::pair<uint32_t, uint32_t>> getAgentKeyFromTheOtherSide(
         const std::pair<uint32_t, uint32_t>& agentIpAndPort) const;
     std::optional<std::pair<uint32_t, uint32_t>> getAgentKeyFromTheOtherSideNoLock(
@@ -122,12 +269,61 @@ class TopologyAndFlowMonitor
     std::optional<Graph::edge_descriptor> findReverseEdgeByHostIp(uint32_t hostIp) const;
     std::optional<Graph::edge_descriptor> findReverseEdgeByHostIp(
         std::vector<uint32_t> hostIp) const;
+    /**
+     * @brief Access edge, switch and port of the host with @p hostIp, from the topology
+     *        index: one hash probe, kept up to date with the static topology and Ryu updates.
+     */
+    std::optional<TopologyIndex::HostAttachment> findHostAttachment(uint32_t hostIp) const;
+    std::optional<TopologyIndex::HostAttachment> findHostAttachmentNoLock(uint32_t hostIp) const;
 
     std::optional<Graph::edge_descriptor> findEdgeBySrcAndDstIp(uint32_t srcIp,
                                                                 uint32_t dstIp) const;
     std::optional<Graph::edge_descriptor> findEdgeBySrcAndDstIpNoLock(uint32_t srcIp,
                                                                       uint32_t dstIp) const;
 
+    /**
+     * @brief Several graph mutations under one write lock: one graph version bump, at most one
+     *        index rebuild, and the link state changes gathered for a single LinkStateChanged
+     *        event instead of one per edge.
+     *
+     * Obtained from beginGraphTransaction(); holds the lock until commit() or destruction, so
+     * keep it to the mutations and the lookups they need. Mutations apply as they are made,
+     * there is no rollback.
+     */
+    class GraphTransaction
+    {
+      public:
+        GraphTransaction(GraphTransaction&&) = default;
+        ~GraphTransaction();
+
+        void setEdgeUp(Graph::edge_descriptor e, bool up);
+        void setEdgeEnabled(Graph::edge_descriptor e, bool enabled);
+        void setVertexUp(Graph::vertex_descriptor v, bool up);
+        void setVertexEnabled(Graph::vertex_descriptor v, bool enabled);
+        void setVertexDeviceName(Graph::vertex_descriptor v, std::string name);
+        void setVertexNickname(Graph::vertex_descriptor v, std::string name);
+
+        /**
+         * @brief Rebuild the index if a mutation changed an indexed property and release the
+         *        lock.
+         * @return The edges whose isUp changed, in order, for one LinkStateChanged event;
+         *         affectedFlows is left to the caller, like applyTopologyEvents().
+         */
+        LinkStateChangedEventData commit();
+
+      private:
+        friend class TopologyAndFlowMonitor;
+        explicit GraphTransaction(TopologyAndFlowMonitor& monitor);
+
+        TopologyAndFlowMonitor* m_monitor;
+        std::unique_lock<std::shared_mutex> m_lock;
+        LinkStateChangedEventData m_changes;
+        bool m_rebuildIndex = false;
+    };
+
+    GraphTransaction beginGraphTransaction();
+
+    // One-mutation transactions
     void setEdgeDown(Graph::edge_descriptor e);
     void setEdgeDownNoLock(Graph::edge_descriptor e);
     void setEdgeUp(Graph::edge_descriptor e);
@@ -142,16 +338,70 @@ class TopologyAndFlowMonitor
     void setVertexEnable(Graph::vertex_descriptor v);
     void setVertexDisable(Graph::vertex_descriptor v);
     std::pair<uint64_t, uint32_t> getEdgeStats(Graph::edge_descriptor e) const;
+    /**
+     * @brief Load of the switch @p dpid, kept up to date by updateLinkInfo(),
+     *        updateLinkInfoLeftLinkBandwidth() and the edge-flow updates; nullopt if there
+     *        is no such switch. Costs one index lookup, no scan.
+     */
+    std::optional<SwitchLoad> getSwitchLoad(uint64_t dpid) const;
     std::pair<uint64_t, uint32_t> getEdgeStatsNoLock(Graph::edge_descriptor e) const;
     std::set<sflow::FlowKey> getEdgeFlowSet(Graph::edge_descriptor e) const;
     std::set<sflow::FlowKey> getEdgeFlowSetNoLock(Graph::edge_descriptor e) const;
+    /**
+     * @brief Deep copy of the graph. Prefer getGraphSnapshot() for read-only use.
+     */
     Graph getGraph() const;
+    /**
+     * @brief Immutable copy of the graph at the current version.
+     *
+     * Snapshots are shared: callers that ask while the graph is unchanged get the same
+     * object, so the deep copy is paid once per graph mutation instead of once per request.
+     */
+    std::shared_ptr<const GraphSnapshot> getGraphSnapshot() const;
+    /**
+     * @brief Like getGraphSnapshot(), but reuses a cached snapshot younger than @p maxAge
+     *        even if the graph has changed since. For readers that tolerate slightly stale
+     *        link statistics (e.g. periodic reports) while counters update continuously.
+     */
+    std::shared_ptr<const GraphSnapshot> getGraphSnapshot(std::chrono::milliseconds maxAge) const;
+    /**
+     * @brief Monotonic counter bumped by every write to the graph.
+     */
+    uint64_t getGraphVersion() const;
+    /**
+     * @brief Counter bumped whenever the lookup index behind the find* functions is rebuilt
+     *        (vertices or edges added, indexed properties changed), but not by link or switch
+     *        state changes.
+     */
+    uint64_t getIndexVersion() const;
     void setVertexDeviceName(Graph::vertex_descriptor v, std::string name);
     void setVertexNickname(Graph::vertex_descriptor v, std::string name);
     bool getVertexIsEnabled(Graph::vertex_descriptor v);
     void setMininetBridgePorts(Graph::vertex_descriptor v, std::vector<std::string> ports);
     std::vector<std::string> getMininetBridgePorts(Graph::vertex_descriptor v);
-    double getAvgLinkUsage(const Graph& g) const;
+    /**
+     * @brief Mean linkBandwidthUsage / linkBandwidth over the up switch-to-switch edges with
+     *        non-zero usage, kept by m_linkStats as counters change (0 if there are none).
+     */
+    double getAvgLinkUsage() const;
+    /// Usage ratio that a fraction @p q of those edges do not exceed, to 1%.
+    double getLinkUsagePercentile(double q) const
+    {
+        return m_linkStats.fabricUsagePercentile(q);
+    }
+    /// Edges counted by getAvgLinkUsage().
+    size_t getActiveFabricLinks() const
+    {
+        return m_linkStats.fabricLinks();
+    }
+    /// Appends the fabric usage summary (average, quantiles, active links) to @p out.
+    void appendMetrics(std::string& out) const;
+    /**
+     * @brief Estimated memory of the graph and its indexes, the link and edge-flow tables,
+     *        the path caches and the current snapshot (with its edges' flowSets), with the
+     *        bytes per edge; for utils::MemoryAccounting.
+     */
+    utils::MemoryUsage memoryUsage() const;
 
     std::optional<Graph::vertex_descriptor> findSwitchByDpid(uint64_t dpid) const;
     std::optional<Graph::vertex_descriptor> findSwitchByDpidNoLock(uint64_t dpid) const;
@@ -170,19 +420,77 @@ class TopologyAndFlowMonitor
     std::optional<Graph::vertex_descriptor> findVertexByDeviceName(const std::string& name) const;
     std::optional<Graph::vertex_descriptor> findVertexByDeviceNameNoLock(
         const std::string& name) const;
+    /**
+     * @brief First IPv4 address (network byte order) of the vertex of each device name of
+     *        @p names; nullopt if no vertex has that name or it has no address. One shared
+     *        graph lock and one index lookup per name, no graph copy.
+     */
+    std::vector<std::optional<uint32_t>> getIpsByDeviceName(
+        const std::vector<std::string>& names) const;
+    /**
+     * @brief Device name of the switch of each DPID of @p dpids; empty if unknown. One shared
+     *        graph lock and one index lookup per DPID, no graph copy.
+     */
+    std::vector<std::string> getSwitchNamesByDpid(const std::vector<uint64_t>& dpids) const;
+
+    /// IPv4 address (network byte order) of switch @p dpid, from the static topology.
+    std::optional<uint32_t> getSwitchIpByDpid(uint64_t dpid) const;
+    /// DPID of the switch with IPv4 address @p ip (network byte order).
+    std::optional<uint64_t> getSwitchDpidByIp(uint32_t ip) const;
+    /// Addresses of all switches with one (network byte order), sorted.
+    std::vector<uint32_t> getSwitchIps() const;
+    /// getSwitchIpByDpid() as a dotted string, for callers that pass it on as text.
+    std::optional<std::string> getSwitchIpStrByDpid(uint64_t dpid) const;
+    /// getSwitchDpidByIp() for a dotted string; nullopt if it is not an address.
+    std::optional<uint64_t> getSwitchDpidByIpStr(const std::string& ip) const;
 
-    std::map<uint64_t, std::string> m_dpidToIpStrMap;
-    std::map<std::string, std::string> m_dpidStrToIpStrMap;
-    std::map<std::string, uint64_t> m_ipStrToDpidMap;
-    std::map<std::string, std::string> m_ipStrToDpidStrMap;
-
+    /**
+     * @brief Simple paths between two switches: getCandidatePaths() with PathSearch::ALL_SIMPLE,
+     *        at most ALL_PATHS_DEFAULT_MAX_PATHS paths found within ALL_PATHS_TIME_BUDGET_MS.
+     *        Runs on the graph snapshot without the graph lock; cached like getCandidatePaths().
+     */
     std::vector<sflow::Path> getAllPathsBetweenTwoHosts(sflow::FlowKey flowKey,
                                                         uint64_t swDpid,
                                                         uint64_t dstSwDpid);
+    /**
+     * @brief The options.k cheapest paths of @p flowKey's hosts through switches @p swDpid and
+     *        @p dstSwDpid (kShortestSwitchPaths() over the graph snapshot), or the first
+     *        options.k found with PathSearch::ALL_SIMPLE (allSimpleSwitchPaths()).
+     *
+     * Same format as getAllPathsBetweenTwoHosts(). Results are cached per switch pair until
+     * the graph version changes.
+     */
+    std::vector<sflow::Path> getCandidatePaths(const sflow::FlowKey& flowKey,
+                                               uint64_t swDpid,
+                                               uint64_t dstSwDpid,
+                                               const CandidatePathOptions& options = {});
+    /**
+     * @brief Counters of the getCandidatePaths() cache.
+     */
+    json getCandidatePathCacheStatsJson() const;
+
+    /**
+     * @brief Bottleneck residual bandwidth of each of @p paths: the smallest leftBandwidth
+     *        of the edges out of its hops (and from its first hop if that is a host), 0 if
+     *        one of them is down or disabled; nullopt for a path with no known edge.
+     *
+     * Served from a PathResidualCache under one shared graph lock, so a path whose links
+     * have not moved by PATH_RESIDUAL_CHANGE_PERCENT costs a hash probe.
+     */
+    std::vector<std::optional<uint64_t>> getPathResiduals(
+        const std::vector<sflow::PathHandle>& paths);
+    /**
+     * @brief Counters of the getPathResiduals() cache.
+     */
+    json getPathResidualCacheStatsJson() const;
 
     void disableSwitchAndEdges(uint64_t dpid);
     void enableSwitchAndEdges(uint64_t dpid);
 
+    /**
+     * @brief Shortest-path /32 rules towards @p dstIp and the paths of @p allHostIps to it
+     *        (see RoutingEngine).
+     */
     std::vector<sflow::Path> bfsAllPathsToDst(
         const Graph& g,
         Graph::vertex_descriptor dstSwitch,
@@ -191,7 +499,22 @@ class TopologyAndFlowMonitor
         std::unordered_map<uint64_t,
                            std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>>>&
             newOpenflowTables);
+    /**
+     * @brief bfsAllPathsToDst() towards every host of @p allHostIps, computed in parallel.
+     *
+     * Same rules and paths as calling bfsAllPathsToDst() for each host in order, for a full
+     * recompute after a link change.
+     */
+    std::vector<sflow::Path> bfsAllPathsToAllDsts(
+        const Graph& g,
+        const std::vector<uint32_t>& allHostIps,
+        RoutingEngine::OpenflowTables& newOpenflowTables);
 
+    /**
+     * @brief The static attributes of every vertex and edge, serialised ({"nodes", "edges"}).
+     *
+     * They only change with getIndexVersion(), which callers can use as a cache key.
+     */
     json getStaticTopologyJson();
 
     // for llm
@@ -199,33 +522,117 @@ class TopologyAndFlowMonitor
     json getTopKCongestedLinksJson(int k);
     // for llm
 
+    /**
+     * @brief Links whose busier direction is at least @p minUtilization percent, most
+     *        utilised first, at most @p k of them (0: all).
+     *
+     * Read from the congestion index, so the cost is that of the buckets holding the result,
+     * not of every link. A link is reported only if both its directions are up and enabled,
+     * as {"<ip1>_to_<ip2>": {...}, "<ip2>_to_<ip1>": {...}, "max_utilization"}.
+     */
+    json getCongestedLinksJson(size_t k, double minUtilization);
+
     bool touchEdgeFlow(Graph::edge_descriptor e, const sflow::FlowKey& key);
+    /**
+     * @brief touchEdgeFlow() for @p key on the edges of a path: from host @p srcHostIp to its
+     *        switch, then out of each hop of @p path. One graph lock for the whole path.
+     * @return The number of edges touched.
+     */
+    size_t touchPathFlow(const sflow::FlowKey& key,
+                         uint32_t srcHostIp,
+                         const sflow::PathHandle& path);
+    /**
+     * @brief Edge flow membership expiry: memberships dropped in the last one-second tick
+     *        and in total since start.
+     */
+    json getEdgeFlowExpiryStatsJson() const;
 
   private:
     std::mutex m_configurationFileMutex;
     void run();
 
-    void fetchAndUpdateTopologyData();
-    void updateSwitches(const std::string& topologyData);
-    void updateHosts(const std::string& topologyData);
-    void updateLinks(const std::string& topologyData);
+    /**
+     * @brief GET switches, hosts and links from Ryu and apply them as one event batch.
+     *
+     * Run at start and every TOPOLOGY_RESYNC_INTERVAL_S as a safety net; between resyncs the
+     * graph follows the events Ryu pushes (applyTopologyEvents()).
+     */
+    void resyncFromController();
     void updateGraph(const std::string&, const std::string&, const std::string&);
+    void applySwitchNoLock(const json& sw, bool up);
+    void applyLinkNoLock(const json& link, bool up, LinkStateChangedEventData& changes);
+    void applyHostNoLock(const json& host, LinkStateChangedEventData& changes);
 
     void loadStaticTopologyFromFile(const std::string& path);
+    /**
+     * @brief Vertices and edges of a static topology file, endpoints resolved; edges whose
+     *        endpoints are not in the file are logged and dropped.
+     */
+    StaticTopology parseStaticTopology(const json& j) const;
     void initializeMappingsFromGraph();
-    void flushEdgeFlowLoop();
-
-    uint64_t hashDstIp(const std::string& str);
+    void flushEdgeFlows();
+    /**
+     * @brief Move edge @p e to the congestion bucket of @p utilization; if it crossed
+     *        CONGESTION_HOTSPOT_PERCENT, add it to @p changes.
+     *
+     * Called from inside m_linkStats.modify(), so updates of one edge reach the index in
+     * order.
+     */
+    void trackUtilization(Graph::edge_descriptor e,
+                          uint32_t statsId,
+                          double utilization,
+                          LinkCongestionChangedEventData& changes);
+    // Publish @p changes if there are any; the caller must not hold the graph lock
+    void publishCongestion(LinkCongestionChangedEventData&& changes);
+    /**
+     * @brief Replace m_index with one built from the current graph.
+     *
+     * Caller holds the unique graph lock. Called after the static topology is loaded, after
+     * each Ryu link update and whenever an indexed vertex property (device name) changes.
+     */
+    void rebuildIndexNoLock();
+    /**
+     * @brief Take the unique graph lock and mark the graph as modified.
+     *
+     * Every write to *m_graph goes through this so cached snapshots are invalidated.
+     */
+    std::unique_lock<std::shared_mutex> lockGraphForWrite();
+    // disableSwitchAndEdges() / enableSwitchAndEdges(), in O(degree)
+    void setSwitchAndEdgesEnabled(uint64_t dpid, bool enabled);
 
-    std::array<std::string, 3> m_ryuUrl;
+    /**
+     * @brief Host vertex and attachment of every IP of @p hostIps that has both.
+     */
+    std::vector<RoutingEngine::Host> routingHosts(const Graph& g,
+                                                  const std::vector<uint32_t>& hostIps) const;
 
     std::atomic<bool> m_running{false};
 
     std::thread m_thread;
-    std::thread m_flushEdgeFlowLoop;
+    utils::TaskScheduler::TaskId m_flushEdgeFlowsTask = 0;
+    utils::TaskScheduler::TaskId m_resyncTask = 0;
 
     std::shared_ptr<Graph> m_graph;
     std::shared_ptr<std::shared_mutex> m_graphMutex;
+    // Lookup tables behind the find* functions; guarded by *m_graphMutex
+    TopologyIndex m_index;
+    // Switch DPID <-> IP, built once the static topology is loaded; guarded by *m_graphMutex
+    SwitchAddressMap m_switchAddresses;
+    // Hot link counters, one slot per edge (EdgeProperties::statsId). Updated under the shared
+    // graph lock; resized only under the unique one
+    LinkStatsTable m_linkStats;
+    // Flows seen per edge, same indexing and locking rules as m_linkStats
+    EdgeFlowTable m_edgeFlows;
+    // Edges by utilisation, same indexing as m_linkStats; updated by its modify() callers
+    CongestionIndex m_congestion;
+    // Path bottleneck residuals, same indexing as m_linkStats; updated by its modify() callers
+    PathResidualCache m_pathResiduals;
+    std::atomic<uint64_t> m_graphVersion{0};
+    std::atomic<uint64_t> m_indexVersion{0};
+    // Most recent snapshot handed out; rebuilt lazily. Lock order: m_snapshotMutex, then graph
+    CandidatePathCache m_candidatePaths;
+    mutable std::mutex m_snapshotMutex;
+    mutable std::shared_ptr<const GraphSnapshot> m_snapshot;
     std::shared_ptr<EventBus> m_eventBus;
 
     utils::DeploymentMode m_mode;
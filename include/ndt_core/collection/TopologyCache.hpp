@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common_types/GraphTypes.hpp" // for VertexProperties, EdgeProperties
+#include <cstdint>                     // for uint32_t, uint64_t
+#include <optional>                    // for optional
+#include <string>                      // for string
+#include <string_view>                 // for string_view
+#include <vector>                      // for vector
+
+#define TOPOLOGY_CACHE_SUFFIX ".cache" // compiled copy of a topology file, named *.json.cache
+
+/**
+ * @brief The vertices and edges of a static topology file, ready to be added to the graph.
+ *
+ * Edge endpoints are already resolved to indexes into @c vertices, so building the graph
+ * needs no lookups.
+ */
+struct StaticTopology
+{
+    struct Edge
+    {
+        uint32_t src = 0;
+        uint32_t dst = 0;
+        EdgeProperties props;
+    };
+
+    std::vector<VertexProperties> vertices;
+    std::vector<Edge> edges;
+};
+
+/**
+ * @brief Compiled cache of a static topology file, so a restart skips parsing the JSON.
+ *
+ * The cache file next to the topology file starts with the magic "NDTT1\n", then the varint
+ * FNV-1a hash of the JSON it was compiled from and the deployment mode, the vertex count and
+ * the vertices, the edge count and the edges. Numbers are varints, strings and lists a
+ * varint length followed by their items; only the fields the JSON sets are stored.
+ *
+ * load() maps the file and decodes it in one pass; a cache of another source hash, mode or
+ * format version, or one cut short, is ignored and the caller parses the JSON instead.
+ * store() writes a temporary file and renames it, so readers never see a partial cache.
+ */
+namespace topology_cache
+{
+
+/// FNV-1a hash of @p data, the key a cache is valid for.
+uint64_t hash(std::string_view data);
+
+/// The topology in @p path, or nullopt if there is no cache for @p sourceHash and @p mode.
+std::optional<StaticTopology> load(const std::string& path, uint64_t sourceHash, int mode);
+
+/// Write @p topology to @p path as the cache of @p sourceHash and @p mode; false on failure.
+bool store(const std::string& path,
+           uint64_t sourceHash,
+           int mode,
+           const StaticTopology& topology);
+
+} // namespace topology_cache
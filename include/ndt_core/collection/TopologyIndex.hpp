@@ -0,0 +1,162 @@
+#pragma once
+
+#include "common_types/GraphTypes.hpp" // for Graph
+#include "utils/Hash.hpp"              // for hashWords
+#include <cstdint>                     // for uint32_t, uint64_t
+#include <optional>                    // for optional
+#include <string>                      // for string
+#include <unordered_map>               // for unordered_map
+#include <utility>                     // for pair
+#include <vector>                      // for vector
+
+/**
+ * @brief Hash lookup tables over a topology Graph.
+ *
+ * Replaces the linear vertex / edge scans of TopologyAndFlowMonitor's find* functions.
+ * Every table keeps the first match in boost::vertices() / boost::edges() order, so the
+ * lookups return exactly what the former scans returned.
+ *
+ * It also stands in for what a bidirectionalS graph would keep: the in-edges of each vertex
+ * and the reverse of each edge, so per-vertex and reverse-edge operations cost O(degree) and
+ * O(1) without widening every Graph copy.
+ *
+ * The index holds descriptors only, which stay valid as long as no vertex or edge is
+ * removed from the graph. It is built in one go by build() and replaced as a whole
+ * whenever the graph (or an indexed property such as deviceName) changes; the owner
+ * guards it with the same lock as the graph.
+ */
+class TopologyIndex
+{
+  public:
+    using Vertex = Graph::vertex_descriptor;
+    using Edge = Graph::edge_descriptor;
+
+    /// Where a host is plugged in: its host -> switch access edge and the switch port.
+    struct HostAttachment
+    {
+        Vertex host;
+        Edge accessEdge;
+        Vertex attachedSwitch;
+        uint64_t dpid = 0;
+        uint32_t port = 0; // dstInterface of accessEdge
+    };
+
+    static TopologyIndex build(const Graph& graph);
+
+    // Vertices
+    std::optional<Vertex> switchByDpid(uint64_t dpid) const;
+    std::optional<Vertex> switchByIp(uint32_t ip) const; // matches the switch's first IP
+    std::optional<Vertex> vertexByIp(uint32_t ip) const; // matches any IP of a vertex
+    std::optional<Vertex> vertexByMac(uint64_t mac) const;
+    std::optional<Vertex> vertexByDeviceName(const std::string& name) const;
+    std::optional<Vertex> vertexByMininetBridgeName(const std::string& name) const;
+
+    // Edges
+    std::optional<Edge> edgeByDpidAndPort(uint64_t srcDpid, uint32_t srcInterface) const;
+    std::optional<Edge> edgeBySrcAndDstDpid(uint64_t srcDpid, uint64_t dstDpid) const;
+    std::optional<Edge> edgeBySrcIp(uint32_t ip) const; // any IP in srcIp
+    std::optional<Edge> edgeByDstIp(uint32_t ip) const; // any IP in dstIp
+    std::optional<Edge> edgeBySrcAndDstIp(uint32_t srcIp, uint32_t dstIp) const;
+    // Whole-list matches: srcIp / dstIp equal to @p ips
+    std::optional<Edge> edgeBySrcIps(const std::vector<uint32_t>& ips) const;
+    std::optional<Edge> edgeByDstIps(const std::vector<uint32_t>& ips) const;
+    // Keyed by every IP of the host; only edges from a HOST vertex to a SWITCH one count
+    std::optional<HostAttachment> hostAttachment(uint32_t hostIp) const;
+    // Keyed by the sFlow agent address, i.e. (srcIp.front(), srcInterface)
+    std::optional<Edge> edgeByAgentIpAndPort(uint32_t agentIp, uint32_t port) const;
+    // The target -> source edge of edgeByAgentIpAndPort(), if the graph has one
+    std::optional<Edge> reverseEdgeByAgentIpAndPort(uint32_t agentIp, uint32_t port) const;
+    // (srcIp.front(), srcInterface) of the edge whose (dstIp.front(), dstInterface) is given
+    std::optional<std::pair<uint32_t, uint32_t>> otherSideOfAgentPort(uint32_t agentIp,
+                                                                      uint32_t port) const;
+    // The edge whose EdgeProperties::statsId is @p id
+    std::optional<Edge> edgeByStatsId(uint32_t id) const;
+    // The target -> source edge of the edge with statsId @p id, if the graph has one
+    std::optional<Edge> reverseEdgeByStatsId(uint32_t id) const;
+    // Edges whose target is @p v; the graph is directedS, boost::out_edges() has the others
+    const std::vector<Edge>& inEdges(Vertex v) const;
+
+    size_t vertexCount() const
+    {
+        return m_vertexCount;
+    }
+
+    size_t edgeCount() const
+    {
+        return m_edgeCount;
+    }
+
+    /// Estimated heap bytes of the lookup tables.
+    size_t memoryBytes() const;
+
+  private:
+    struct PairHash
+    {
+        template <typename A, typename B>
+        size_t operator()(const std::pair<A, B>& p) const
+        {
+            return utils::hashWords({uint64_t(p.first), uint64_t(p.second)});
+        }
+    };
+
+    struct IpListHash
+    {
+        size_t operator()(const std::vector<uint32_t>& ips) const
+        {
+            // Two addresses per word, chained through the previous hash
+            size_t seed = ips.size();
+            for (size_t i = 0; i < ips.size(); i += 2)
+            {
+                const uint64_t next = i + 1 < ips.size() ? ips[i + 1] : 0;
+                seed = utils::hashWords({seed, (uint64_t(ips[i]) << 32) | next});
+            }
+            return seed;
+        }
+    };
+
+    struct AgentPortEdges
+    {
+        Edge edge;
+        std::optional<Edge> reverse;
+    };
+
+    template <typename Map, typename Key>
+    static std::optional<typename Map::mapped_type> lookup(const Map& map, const Key& key)
+    {
+        auto it = map.find(key);
+        if (it == map.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    static uint64_t agentPortKey(uint32_t agentIp, uint32_t port)
+    {
+        return (static_cast<uint64_t>(agentIp) << 32) | port;
+    }
+
+    std::unordered_map<uint64_t, Vertex> m_switchByDpid;
+    std::unordered_map<uint32_t, Vertex> m_switchByIp;
+    std::unordered_map<uint32_t, Vertex> m_vertexByIp;
+    std::unordered_map<uint64_t, Vertex> m_vertexByMac;
+    std::unordered_map<std::string, Vertex> m_vertexByDeviceName;
+    std::unordered_map<std::string, Vertex> m_vertexByBridgeName;
+
+    std::unordered_map<std::pair<uint64_t, uint32_t>, Edge, PairHash> m_edgeByDpidAndPort;
+    std::unordered_map<std::pair<uint64_t, uint64_t>, Edge, PairHash> m_edgeBySrcAndDstDpid;
+    std::unordered_map<uint32_t, Edge> m_edgeBySrcIp;
+    std::unordered_map<uint32_t, Edge> m_edgeByDstIp;
+    std::unordered_map<std::pair<uint32_t, uint32_t>, Edge, PairHash> m_edgeBySrcAndDstIp;
+    std::unordered_map<std::vector<uint32_t>, Edge, IpListHash> m_edgeBySrcIps;
+    std::unordered_map<std::vector<uint32_t>, Edge, IpListHash> m_edgeByDstIps;
+    std::unordered_map<uint32_t, HostAttachment> m_hostAttachments;
+    std::unordered_map<uint64_t, AgentPortEdges> m_edgeByAgentPort;
+    std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> m_otherSideByAgentPort;
+    std::vector<std::optional<Edge>> m_edgeByStatsId;
+    std::vector<std::optional<Edge>> m_reverseByStatsId;
+    std::vector<std::vector<Edge>> m_inEdges; // by vertex (vecS: the descriptor is the index)
+
+    size_t m_vertexCount = 0;
+    size_t m_edgeCount = 0;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>           // for size_t
+#include <cstdint>           // for uint32_t, uint64_t, int64_t
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <span>              // for span
+#include <unordered_map>     // for unordered_map
+#include <vector>            // for vector
+
+#define TRAFFIC_MATRIX_MAX_HOSTS 2048 // endpoints beyond it are left out (32 MiB at most)
+
+/**
+ * @brief Host-to-host traffic matrix, kept up to date from the changes of flow rates.
+ *
+ * Endpoints get dense ids in the order they are first seen and the matrix is a square array
+ * of bps indexed by them, grown by doubling. The collector adds the difference each rate tick
+ * makes to a flow's periodic rate and subtracts the rate of a flow that leaves the table, so
+ * a cell is the sum of the periodic rates of the flows between its two endpoints without the
+ * flow table ever being scanned for it. Ids are not reused; flows of endpoints past
+ * TRAFFIC_MATRIX_MAX_HOSTS are counted as untracked.
+ *
+ * Thread-safe.
+ */
+class TrafficMatrix
+{
+  public:
+    struct Delta
+    {
+        uint32_t srcIp; // network order
+        uint32_t dstIp;
+        int64_t bps;
+    };
+
+    struct Cell
+    {
+        uint32_t srcIp; // network order
+        uint32_t dstIp;
+        uint64_t bps;
+    };
+
+    /// Apply @p deltas under one lock.
+    void apply(std::span<const Delta> deltas);
+
+    /// Mark the end of a rate tick: version() changes if a cell did since the last one.
+    void tick();
+
+    uint64_t version() const;
+
+    /**
+     * @brief {"version", "hosts": [ip, ...], "matrix": [[src, dst, bps], ...]}: the cells of
+     *        at least @p minBps (and not 0), src and dst indexing "hosts".
+     */
+    nlohmann::json sparseJson(uint64_t minBps) const;
+
+    /**
+     * @brief Replace @p out with the non-zero cells, source by source, keeping its capacity.
+     * @return The version they belong to.
+     */
+    uint64_t cells(std::vector<Cell>& out) const;
+
+    /// {"hosts", "capacity", "nonzero_cells", "untracked_deltas", "memory_bytes", "version"}
+    nlohmann::json statsJson() const;
+
+  private:
+    // Id of @p ip, assigned if new; SIZE_MAX once TRAFFIC_MATRIX_MAX_HOSTS are known
+    size_t hostId(uint32_t ip);
+    void grow(size_t capacity);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint32_t, uint32_t> m_ids; // ip -> id
+    std::vector<uint32_t> m_hosts;                // id -> ip
+    size_t m_capacity = 0;
+    std::vector<uint64_t> m_cells; // m_capacity x m_capacity, row = source
+    size_t m_nonzero = 0;
+    bool m_changed = false;
+    uint64_t m_version = 0;
+    uint64_t m_untracked = 0;
+};
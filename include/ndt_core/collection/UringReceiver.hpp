@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t
+#include <memory>  // for unique_ptr
+#include <vector>  // for vector
+
+#define SFLOW_URING_BUFFERS 512      // receive buffers provided per worker, a power of two
+#define SFLOW_URING_BUFFER_SIZE 9472 // a jumbo-frame datagram with its recvmsg header
+
+namespace sflow
+{
+
+/**
+ * @brief Datagrams of a bound UDP socket received through io_uring multishot recvmsg.
+ *
+ * One armed request keeps completing, once per datagram, into buffers the kernel takes from
+ * a provided buffer ring. A burst is collected by one io_uring_enter() however many
+ * datagrams it holds, and by none when completions are already waiting, where poll() and
+ * recvmmsg() cost two system calls per wakeup for at most SFLOW_RECV_BATCH_SIZE datagrams.
+ *
+ * Needs a build with liburing (NDT_HAVE_LIBURING) and a kernel with multishot recvmsg
+ * (6.0): create() returns nullptr without the one, poll() returns false on the other, and
+ * the caller keeps receiving with recvmmsg().
+ *
+ * Owned by one thread.
+ */
+class UringReceiver
+{
+  public:
+    struct Datagram
+    {
+        const char* data; // valid until the next poll()
+        size_t length;
+        bool truncated;      // longer than SFLOW_URING_BUFFER_SIZE allows
+        int64_t receivedMs;  // SO_TIMESTAMPNS, system clock; 0 if not stamped
+        int64_t socketDrops; // SO_RXQ_OVFL count; -1 if not reported
+    };
+
+    /// Receiver on @p sockfd, which it does not own; nullptr if io_uring is unavailable.
+    static std::unique_ptr<UringReceiver> create(int sockfd);
+    ~UringReceiver();
+
+    UringReceiver(const UringReceiver&) = delete;
+    UringReceiver& operator=(const UringReceiver&) = delete;
+
+    /**
+     * @brief Wait up to @p timeoutMs for datagrams, then append all that have completed to
+     *        @p out (cleared first).
+     *
+     * The buffers of the previous call are given back to the kernel first, so its datagrams
+     * are no longer valid.
+     * @return false if the kernel cannot receive this way; nothing was received then.
+     */
+    bool poll(int timeoutMs, std::vector<Datagram>& out);
+
+  private:
+    struct State; // keeps liburing out of this header
+
+    explicit UringReceiver(std::unique_ptr<State> state);
+
+    std::unique_ptr<State> m_state;
+};
+
+} // namespace sflow
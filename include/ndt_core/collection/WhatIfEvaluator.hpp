@@ -0,0 +1,109 @@
+#pragma once
+
+#include "common_types/SFlowType.hpp"       // for Path
+#include "ndt_core/collection/CsrGraph.hpp" // for CsrGraph
+#include <cstddef>                          // for size_t
+#include <cstdint>                          // for uint32_t, uint64_t, int64_t
+#include <memory>                           // for shared_ptr
+#include <optional>                         // for optional
+#include <unordered_map>                    // for unordered_map
+#include <utility>                          // for pair
+#include <vector>                           // for vector
+
+struct GraphSnapshot;
+
+#define WHAT_IF_MAX_SCENARIOS 10000      // scenarios one request may evaluate
+#define WHAT_IF_TOP_LINKS 10             // changed links listed per scenario by default
+#define WHAT_IF_SNAPSHOT_MAX_AGE_MS 1000 // age of the graph snapshot a request may reuse
+
+/**
+ * @brief Traffic moved from one path to another: @c bps leaves each edge of @c oldPath and is
+ *        added to each edge of @c newPath.
+ *
+ * Paths are hops as flows carry them, (dpid, output port) per switch; hops that are no
+ * switch's (the source host, the final (dstIp, 0)) are skipped. An empty oldPath adds
+ * traffic not on the network yet.
+ */
+struct PathMove
+{
+    uint64_t bps = 0;
+    sflow::Path oldPath;
+    sflow::Path newPath;
+};
+
+/**
+ * @brief Utilisation of the links if some traffic took other paths, computed on a graph
+ *        snapshot without touching the network.
+ */
+struct WhatIfResult
+{
+    struct Link
+    {
+        CsrGraph::EdgeId edge = CsrGraph::NO_EDGE;
+        double before = 0; // utilisation in percent
+        double after = 0;
+    };
+
+    double maxBefore = 0; // highest utilisation over the usable links
+    double maxAfter = 0;
+    CsrGraph::EdgeId maxAfterEdge = CsrGraph::NO_EDGE;
+    std::vector<Link> changed; // links whose load changed, highest after first
+    size_t unknownHops = 0;    // switch hops with no usable link out of that port
+};
+
+/**
+ * @brief In-process what-if evaluator of link loads: the per-link utilisation and the
+ *        maximum utilisation after moving traffic between paths (PathMove).
+ *
+ * Built once per graph snapshot: the load, capacity and utilisation of every usable edge in
+ * flat arrays, an index from (dpid, output port) to the edge, and the edges in order of
+ * falling utilisation. An evaluation then only touches the edges of the moved paths: their
+ * loads change by the moved rates, and the highest utilisation of the others is the first
+ * untouched edge of that order. The cost follows the number of hops moved, not the size of
+ * the network.
+ *
+ * The loads are the links' measured linkBandwidthUsage, so moving a flow is measured
+ * against the load it adds today (its periodic rate). Immutable after construction and
+ * thread-safe.
+ */
+class WhatIfEvaluator
+{
+  public:
+    explicit WhatIfEvaluator(std::shared_ptr<const GraphSnapshot> snapshot);
+
+    /// The evaluator of the latest snapshot given to it or of @p snapshot, made if needed.
+    static std::shared_ptr<const WhatIfEvaluator> forSnapshot(
+        std::shared_ptr<const GraphSnapshot> snapshot);
+
+    /**
+     * @brief Apply all of @p moves (one scenario) and report the links they change; at most
+     *        @p topLinks in WhatIfResult::changed (all if 0).
+     */
+    WhatIfResult evaluate(const std::vector<PathMove>& moves, size_t topLinks = 0) const;
+
+    /// The edge leaving switch @p dpid through @p port, if it is usable.
+    std::optional<CsrGraph::EdgeId> edgeAt(uint64_t dpid, uint32_t port) const;
+
+    /**
+     * @brief The hops of a path through switches @p dpids in order, ending at host @p dstIp
+     *        (0: end at the last switch), as flows carry them; nullopt if two consecutive
+     *        switches, or the last one and the host, have no usable link.
+     */
+    std::optional<sflow::Path> pathThrough(const std::vector<uint64_t>& dpids,
+                                           uint32_t dstIp) const;
+
+    const GraphSnapshot& snapshot() const
+    {
+        return *m_snapshot;
+    }
+
+  private:
+    double utilization(CsrGraph::EdgeId e, int64_t extraBps) const;
+
+    std::shared_ptr<const GraphSnapshot> m_snapshot;
+    std::vector<uint64_t> m_usage;                 // bps, by edge id
+    std::vector<uint64_t> m_capacity;              // bps, 0 if unknown or unusable
+    std::vector<CsrGraph::EdgeId> m_byUtilization; // edges with a capacity, busiest first
+    std::unordered_map<uint64_t, std::unordered_map<uint32_t, CsrGraph::EdgeId>> m_edgeAt;
+    std::unordered_map<uint32_t, CsrGraph::VertexId> m_hostByIp;
+};
@@ -1,14 +1,32 @@
 #pragma once
 
-#include "utils/Utils.hpp"    // for DeploymentMode
-#include <atomic>             // for atomic
-#include <chrono>             // for minutes
-#include <memory>             // for shared_ptr
-#include <thread>             // for thread
-class TopologyAndFlowMonitor; // lines 34-34
+#include "ndt_core/data_management/RecentHistory.hpp" // for RecentHistory
+#include "utils/TaskScheduler.hpp"                     // for TaskScheduler
+#include "utils/Utils.hpp"                             // for DeploymentMode
+#include <atomic>                                      // for atomic
+#include <chrono>                                      // for minutes
+#include <cstdint>                                     // for int64_t
+#include <memory>                                      // for shared_ptr
+#include <nlohmann/json.hpp>                           // for json
+#include <string>                                      // for string
+class LinkHistoryWriter;
+class TopologyAndFlowMonitor;                          // lines 34-34
+namespace sflow
+{
+class FlowLinkUsageCollector;
+} // namespace sflow
+
+#define HISTORICAL_DATA_DIR "/home/of-controller-sflow-collector/LinkData/"
+#define HISTORY_QUERY_MAX_STEPS 10000 // steps one queryLinkHistory() may return
+#define HISTORY_QUERY_MAX_DAYS 31     // day files one queryLinkHistory() may read
 
 /**
- * @brief Periodically records historical link-bandwidth usage.
+ * @brief Records historical link-bandwidth usage and flow rates.
+ *
+ * Every second the recording task (on utils::TaskScheduler) samples the usage of each edge
+ * and the rate of each flow into a RecentHistory. In testbed mode, while logging is enabled, it
+ * also appends the minute rollups of the edges to YYYYMMDD-1m.ndth and their rollups over
+ * @c interval to YYYYMMDD.ndth (see LinkHistoryWriter), committed by utils::HistoryWriter.
  */
 class HistoricalDataManager
 {
@@ -17,29 +35,60 @@ class HistoricalDataManager
     /**
      * @param monitor  Shared pointer to the topology & flow monitor
      *                 from which to fetch bandwidth data.
-     * @param interval Interval between recordings (default: 5 minutes).
+     * @param interval Period of the rollups written to the day file (default: 5 minutes).
+     * @param collector Source of the flow rates; without one only edges are recorded.
      */
     HistoricalDataManager(std::shared_ptr<TopologyAndFlowMonitor> monitor,
                           int mode,
-                          std::chrono::minutes interval = DEFAULT_INTERVAL);
+                          std::chrono::minutes interval = DEFAULT_INTERVAL,
+                          std::shared_ptr<sflow::FlowLinkUsageCollector> collector = nullptr);
 
     ~HistoricalDataManager();
 
-    /// Start the recording thread.
+    /// Start the recording task.
     void start();
 
-    /// Request shutdown and join the thread.
+    /// Cancel the recording task, waiting for a sample in progress.
     void stop();
+
+    /// Turn the recording of history files on or off, through utils::HistoryWriter.
     void setLoggingState(bool enable);
 
+    /**
+     * @brief Usage of the edge from @p srcId to @p dstId in [@p fromMs, @p toMs], from the day
+     *        files, aggregated per @p stepMs.
+     *
+     * Reads the minute rollups of each day (YYYYMMDD-1m.ndth), or its day file where there are
+     * none, through their time index. Returns {"src", "dst", "from_ms", "to_ms", "step_ms",
+     * "steps": [{"start_ms", "samples", "avg", "max", "p95", "link_bandwidth"}]} with the
+     * usage in bps, for the steps that have samples. The caller bounds the range by
+     * HISTORY_QUERY_MAX_STEPS and HISTORY_QUERY_MAX_DAYS.
+     */
+    nlohmann::json queryLinkHistory(const std::string& srcId,
+                                    const std::string& dstId,
+                                    int64_t fromMs,
+                                    int64_t toMs,
+                                    int64_t stepMs) const;
+
+    /// Last minutes of edge usage and flow rates; safe to read from any thread.
+    const RecentHistory& recentHistory() const
+    {
+        return m_recentHistory;
+    }
+
   private:
-    /// Main loop executed in the background thread.
-    void run();
+    /// One sample of every edge and flow, and the rollups it closed; run every second.
+    void sample();
 
     std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
+    std::shared_ptr<sflow::FlowLinkUsageCollector> m_collector;
     utils::DeploymentMode m_mode;
     std::chrono::minutes m_interval;
     std::atomic<bool> m_running{false};
-    std::thread m_thread;
-    std::atomic<bool> m_loggingEnabled{true}; 
+    utils::TaskScheduler::TaskId m_task = 0;
+    RecentHistory m_recentHistory;
+    // Recording task only: writers of the current day's files
+    std::unique_ptr<LinkHistoryWriter> m_minuteWriter;
+    std::unique_ptr<LinkHistoryWriter> m_periodWriter;
+    int64_t m_lastEvictMs = 0;
 };
\ No newline at end of file
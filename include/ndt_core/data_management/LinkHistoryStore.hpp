@@ -0,0 +1,203 @@
+#pragma once
+
+#include "utils/HistoryWriter.hpp" // for HistoryFile
+#include <cstddef>                 // for size_t
+#include <cstdint>                 // for int64_t, uint32_t, uint64_t
+#include <functional>              // for function
+#include <limits>                  // for numeric_limits
+#include <map>                     // for map
+#include <memory>                  // for shared_ptr
+#include <string>                  // for string
+#include <utility>                 // for pair
+#include <vector>                  // for vector
+
+#define LINK_HISTORY_FILE_SUFFIX ".ndth"  // one file per day, named YYYYMMDD.ndth
+#define LINK_HISTORY_INDEX_SUFFIX ".idx"  // time index of a history file, named *.ndth.idx
+#define LINK_HISTORY_KEYFRAME_SAMPLES 60  // samples between keyframes (seek points)
+
+/// One edge of a link history file, named the way HistoricalDataManager names its endpoints.
+struct LinkHistoryEdge
+{
+    std::string srcType; // "switch" or "host"
+    std::string srcId;   // dpid of a switch, MAC of a host
+    std::string dstType;
+    std::string dstId;
+};
+
+/// One edge's bandwidth at one sample.
+struct LinkHistorySample
+{
+    int64_t timestampMs = 0; // since the Unix epoch
+    uint32_t edgeId = 0;     // index into LinkHistoryReader::edges()
+    uint64_t linkBandwidth = 0;
+    uint64_t linkBandwidthUsage = 0;
+};
+
+/// A sample a read can start at, see LinkHistoryReader.
+struct LinkHistoryKeyframe
+{
+    int64_t timestampMs = 0;
+    uint64_t offset = 0;    // of its 'K' record in the history file
+    uint32_t edgeCount = 0; // edges defined before it
+};
+
+/**
+ * @brief Reads a link history file written by LinkHistoryWriter.
+ *
+ * The file starts with the magic "NDTH1\n", followed by records that each start with a tag
+ * byte:
+ *   - 'E' defines the next edge id (0, 1, ...): srcType, srcId, dstType and dstId, each a
+ *     varint length and the bytes.
+ *   - 'S' is one sample of many edges: the zigzag varint change of the timestamp (ms) since the
+ *     previous sample (the first one counts from the epoch), a varint count, then three
+ *     columns of that many values: the edge ids in ascending order as varint gaps, and the
+ *     link bandwidth and usage of each, as the zigzag varint change since that edge's previous
+ *     sample in the file.
+ *   - 'K' is a keyframe: an 'S' record whose timestamp and values are not relative to
+ *     anything before it (changes from 0), so decoding can start there.
+ *
+ * Bandwidths rarely change between samples, so a sample takes about three bytes per edge.
+ * A record cut short (the process died mid-write) ends the readable part of the file.
+ *
+ * Next to the file, *.ndth.idx holds its sparse time index: the magic "NDTI1\n", the 'E'
+ * records of the history file, and per keyframe a 'K' tag followed by the varint zigzag
+ * timestamp, offset and edge count. With it, opening a file reads only the index and scan()
+ * reads only the keyframe intervals that overlap the range. An index missing the latest
+ * records (the process died between the two writes) costs a longer read, never a wrong one.
+ */
+class LinkHistoryReader
+{
+  public:
+    /**
+     * @brief Open @p path; ok() is false when it cannot be read or is not a history file.
+     *
+     * @param useIndex Load the index file when there is one. Otherwise, or when it is missing
+     *                 or unreadable, the whole history file is decoded once to build the
+     *                 index, and validBytes() is known.
+     */
+    explicit LinkHistoryReader(const std::string& path, bool useIndex = true);
+
+    bool ok() const
+    {
+        return m_ok;
+    }
+
+    /// Indexed by edge id.
+    const std::vector<LinkHistoryEdge>& edges() const
+    {
+        return m_edges;
+    }
+
+    /// Id of the edge from @p srcId to @p dstId, or -1.
+    int64_t findEdge(const std::string& srcId, const std::string& dstId) const;
+
+    /// In file (time) order; the first one stands for the start of the file.
+    const std::vector<LinkHistoryKeyframe>& keyframes() const
+    {
+        return m_keyframes;
+    }
+
+    /// Call @p visit on each sample taken in [@p fromMs, @p toMs], in file (time) order.
+    /// Reads the file from the last keyframe at or before @p fromMs up to the first one after
+    /// @p toMs.
+    void scan(const std::function<void(const LinkHistorySample&)>& visit,
+              int64_t fromMs = std::numeric_limits<int64_t>::min(),
+              int64_t toMs = std::numeric_limits<int64_t>::max()) const;
+
+    /// Length of the complete records, from the start of the file; only known when the file
+    /// was decoded rather than its index loaded.
+    size_t validBytes() const
+    {
+        return m_validBytes;
+    }
+
+  private:
+    // Read the index file of m_path into m_edges and m_keyframes
+    bool loadIndex();
+
+    // Decode the records of @p data from @p pos, which is at a keyframe after @p edgeCount
+    // edge definitions (or at the start of the file), until a sample after @p toMs. Edges
+    // defined on the way are added to @p edges and keyframes to @p keyframes (if set); samples
+    // in range are passed to @p visit (if set). Returns the end of the complete records.
+    static size_t decode(const std::string& data,
+                         size_t pos,
+                         uint64_t baseOffset,
+                         uint32_t edgeCount,
+                         std::vector<LinkHistoryEdge>* edges,
+                         std::vector<LinkHistoryKeyframe>* keyframes,
+                         const std::function<void(const LinkHistorySample&)>* visit,
+                         int64_t fromMs,
+                         int64_t toMs);
+
+    std::string m_path;
+    bool m_ok = false;
+    std::vector<LinkHistoryEdge> m_edges;
+    std::vector<LinkHistoryKeyframe> m_keyframes;
+    size_t m_validBytes = 0;
+};
+
+/**
+ * @brief Appends link bandwidth samples to one day's history file, see LinkHistoryReader.
+ *
+ * A sample, with the definitions of the edges it brings in, is encoded in memory and submitted
+ * as one record to utils::HistoryWriter, which appends it to the file. Every
+ * LINK_HISTORY_KEYFRAME_SAMPLES samples it writes a keyframe, and the new edges and keyframes
+ * are submitted to the index file after the history file. Once a record is refused or fails
+ * to be written the writer is no longer ok() and is replaced: opening an existing file
+ * replays it to recover the edge ids and the values the deltas are taken from, cuts off a
+ * truncated last record and rewrites the index, synchronously.
+ *
+ * Not thread-safe; HistoricalDataManager uses one from its recording thread.
+ */
+class LinkHistoryWriter
+{
+  public:
+    struct Entry
+    {
+        const LinkHistoryEdge* edge = nullptr;
+        uint64_t linkBandwidth = 0;
+        uint64_t linkBandwidthUsage = 0;
+    };
+
+    /// Open @p path for appending, creating it if needed; ok() tells whether that worked.
+    explicit LinkHistoryWriter(std::string path);
+    ~LinkHistoryWriter();
+
+    LinkHistoryWriter(const LinkHistoryWriter&) = delete;
+    LinkHistoryWriter& operator=(const LinkHistoryWriter&) = delete;
+
+    bool ok() const
+    {
+        return m_file && !m_file->failed();
+    }
+
+    const std::string& path() const
+    {
+        return m_path;
+    }
+
+    /// Append one sample of @p entries taken at @p timestampMs; false if the write failed.
+    bool append(int64_t timestampMs, const std::vector<Entry>& entries);
+
+  private:
+    struct Last
+    {
+        uint64_t linkBandwidth = 0;
+        uint64_t linkBandwidthUsage = 0;
+    };
+
+    // Rewrite the index file from @p edges and @p keyframes (the first one excluded)
+    void writeIndex(const std::vector<LinkHistoryEdge>& edges,
+                    const std::vector<LinkHistoryKeyframe>& keyframes);
+
+    std::string m_path;
+    std::shared_ptr<utils::HistoryFile> m_file;
+    std::shared_ptr<utils::HistoryFile> m_indexFile;
+    uint64_t m_size = 0;          // of the history file
+    uint32_t m_sinceKeyframe = 0; // samples written since the last keyframe
+    int64_t m_lastTimestampMs = 0;
+    std::map<std::pair<std::string, std::string>, uint32_t> m_ids; // (srcId, dstId) -> edge id
+    std::vector<Last> m_last;                                       // by edge id
+    std::string m_buffer;
+    std::string m_indexBuffer;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "common_types/SFlowType.hpp" // for FlowKey, FlowKeyHash
+#include "utils/SeriesRing.hpp"       // for SeriesRing, SeriesPoint
+#include <atomic>                     // for atomic
+#include <cstdint>                    // for int64_t, uint64_t
+#include <map>                        // for map
+#include <memory>                     // for unique_ptr
+#include <nlohmann/json.hpp>          // for json
+#include <optional>                   // for optional
+#include <shared_mutex>               // for shared_mutex
+#include <unordered_map>              // for unordered_map
+#include <utility>                    // for pair
+#include <vector>                     // for vector
+
+#define HISTORY_SECOND_POINTS 600    // 1 s points kept per edge and flow (10 minutes)
+#define HISTORY_MINUTE_POINTS 180    // 1 min rollups kept per edge and flow (3 hours)
+#define HISTORY_MAX_FLOW_SERIES 4096 // flows with a history at once; others are skipped
+
+/**
+ * @brief Second-level history of the link usage and flow rates of the last minutes.
+ *
+ * Every edge and active flow gets a series: a ring of its 1 s points and a ring of their 1 min
+ * rollups (mean and peak). Recording also rolls the points up per @c persistPeriod, for the
+ * persistent store.
+ *
+ * One thread records (HistoricalDataManager's sampler) and any thread reads. The rings are
+ * lock-free (utils::SeriesRing); the map of series is locked shared by readers and exclusively
+ * only while the recorder adds or drops a series, so recording an existing series never waits.
+ */
+class RecentHistory
+{
+  public:
+    /// (src, dst) of an edge: the dpid of a switch endpoint, the MAC of a host endpoint.
+    using EdgeKey = std::pair<uint64_t, uint64_t>;
+
+    enum class Resolution
+    {
+        Second,
+        Minute
+    };
+
+    /// Rollups that a recorded point completed.
+    struct Closed
+    {
+        std::optional<utils::SeriesPoint> minute;
+        std::optional<utils::SeriesPoint> period; // of persistPeriod
+    };
+
+    explicit RecentHistory(int64_t persistPeriodMs);
+
+    /// Record the usage (bps) of @p edge at @p timestampMs. Recorder thread only.
+    Closed recordEdge(const EdgeKey& edge, int64_t timestampMs, uint64_t usage);
+
+    /// Record the rate (bps) of @p flow at @p timestampMs; a flow without a series gets one
+    /// unless HISTORY_MAX_FLOW_SERIES flows have one already. Recorder thread only.
+    void recordFlow(const sflow::FlowKey& flow, int64_t timestampMs, uint64_t rateBps);
+
+    /// Whether @p flow has a series. Recorder thread only.
+    bool tracksFlow(const sflow::FlowKey& flow) const;
+
+    /// Drop the series without a point in the last HISTORY_SECOND_POINTS seconds. Recorder
+    /// thread only.
+    void evictIdle(int64_t nowMs);
+
+    /// Points of @p edge in [@p fromMs, @p toMs], oldest first; empty if it has no series.
+    std::vector<utils::SeriesPoint> edgeHistory(const EdgeKey& edge,
+                                                Resolution resolution,
+                                                int64_t fromMs,
+                                                int64_t toMs) const;
+
+    /// Points of @p flow in [@p fromMs, @p toMs], oldest first; empty if it has no series.
+    std::vector<utils::SeriesPoint> flowHistory(const sflow::FlowKey& flow,
+                                                Resolution resolution,
+                                                int64_t fromMs,
+                                                int64_t toMs) const;
+
+    /// {"edges", "flows", "flows_skipped"}.
+    nlohmann::json statsJson() const;
+
+  private:
+    // Mean and peak of the points of one period
+    struct Rollup
+    {
+        int64_t startMs = -1; // -1: no point yet
+        uint64_t sum = 0;
+        uint64_t peak = 0;
+        uint64_t count = 0;
+
+        // Add @p point; returns the rollup of the previous period if @p point starts a new one
+        std::optional<utils::SeriesPoint> add(int64_t periodMs, const utils::SeriesPoint& point);
+    };
+
+    struct Series
+    {
+        Series()
+            : seconds(HISTORY_SECOND_POINTS),
+              minutes(HISTORY_MINUTE_POINTS)
+        {
+        }
+
+        utils::SeriesRing seconds;
+        utils::SeriesRing minutes;
+        // Recorder thread only
+        Rollup minute;
+        Rollup period;
+        int64_t lastMs = 0;
+    };
+
+    Closed record(Series& series, int64_t timestampMs, uint64_t value);
+    static std::vector<utils::SeriesPoint> read(const Series* series,
+                                                Resolution resolution,
+                                                int64_t fromMs,
+                                                int64_t toMs);
+
+    const int64_t m_persistPeriodMs;
+
+    mutable std::shared_mutex m_mutex; // guards the maps, not the series
+    std::map<EdgeKey, std::unique_ptr<Series>> m_edges;
+    std::unordered_map<sflow::FlowKey, std::unique_ptr<Series>, sflow::FlowKeyHash> m_flows;
+    std::atomic<uint64_t> m_flowsSkipped{0};
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "utils/Metrics.hpp"  // for Gauge, Counter
+#include <atomic>             // for atomic
+#include <condition_variable> // for condition_variable
+#include <cstdint>            // for uint16_t, int64_t
+#include <functional>         // for function
+#include <memory>             // for shared_ptr
+#include <mutex>              // for mutex
+#include <string>             // for string
+#include <thread>             // for thread
+class LockManager;
+namespace sflow
+{
+class FlowLinkUsageCollector;
+} // namespace sflow
+
+#define REPLICATION_PORT 6345             // default TCP port a standby takes the state on
+#define REPLICATION_INTERVAL_MS 500       // how often the primary ships what changed
+#define REPLICATION_FAILOVER_MS 3000      // a standby takes over after its primary is this silent
+#define REPLICATION_RETRY_MS 1000         // the primary's wait before connecting again
+#define REPLICATION_MAX_FRAME (256 << 20) // larger frames end the connection
+
+/**
+ * @brief Role of this process in a hot-standby pair; both empty replicates nothing.
+ */
+struct ReplicationConfig
+{
+    std::string standby;     // primary: "host:port" of the standby
+    uint16_t listenPort = 0; // standby: TCP port the primary connects to; 0: not a standby
+};
+
+/**
+ * @brief Keeps a standby's collector and leases in step with the primary's, so the standby
+ *        can take over the HTTP API with the live state.
+ *
+ * The primary connects to the standby and, every REPLICATION_INTERVAL_MS, sends the
+ * collector state that changed since the last frame (FlowLinkUsageCollector::encodeState():
+ * flows, removed flows, link counter reports and the OpenFlow tables when the classifier's
+ * rules changed) and the LockManager leases. A new connection starts with the whole state.
+ * Frames are a 4-byte length, a kind byte and the payload; the standby acknowledges each
+ * state with the time it was taken.
+ *
+ * The standby applies the frames to its own collector and LockManager while its HTTP server
+ * stays down. Once a primary it has heard from is silent for REPLICATION_FAILOVER_MS, it
+ * stops listening and starts the server (the onTakeover callback); moving the clients, e.g.
+ * a virtual IP, is left to the deployment.
+ *
+ * Replication lag is the ndt_replication_lag_seconds gauge: on the primary, the age of the
+ * newest state the standby acknowledged; on the standby, of the newest state it applied.
+ */
+class StateReplicator
+{
+  public:
+    using Takeover = std::function<void()>;
+
+    StateReplicator(ReplicationConfig config,
+                    std::shared_ptr<sflow::FlowLinkUsageCollector> collector,
+                    std::shared_ptr<LockManager> lockManager);
+    ~StateReplicator();
+
+    StateReplicator(const StateReplicator&) = delete;
+    StateReplicator& operator=(const StateReplicator&) = delete;
+
+    /**
+     * @brief Start replicating after the collector has started. A standby calls
+     *        @p onTakeover, on its thread, when it takes over; otherwise it is called here.
+     */
+    void start(Takeover onTakeover);
+    void stop();
+
+  private:
+    void runPrimary();
+    void runStandby();
+    bool connectToStandby();
+    bool sendFrame(char kind, const std::string& payload);
+    // Primary: read the standby's acknowledgements without blocking; false if it hung up
+    bool readAcks();
+    // Standby: apply one frame from the primary
+    void applyFrame(char kind, const std::string& payload);
+    void closeConnection();
+    // Sleep @p ms unless stop() is called meanwhile
+    void waitFor(int64_t ms);
+
+    ReplicationConfig m_config;
+    std::shared_ptr<sflow::FlowLinkUsageCollector> m_collector;
+    std::shared_ptr<LockManager> m_lockManager;
+    Takeover m_onTakeover;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::mutex m_waitMutex;
+    std::condition_variable m_waitCv;
+
+    // Used by m_thread only
+    int m_listenFd = -1;
+    int m_fd = -1;
+    std::string m_inbox; // bytes received and not yet framed
+    int64_t m_ackedSystemMs = 0;
+
+    utils::Gauge& m_lag;
+    utils::Counter& m_bytes;
+    utils::Counter& m_resyncs; // connections started over with the whole state
+};
@@ -20,6 +20,8 @@ class IntentTranslator;
 class HistoricalDataManager;
 class Controller;
 class LockManager;
+class TelemetryHub;
+class SnapshotExporter;
 
 namespace boost
 {
@@ -35,6 +37,7 @@ class FlowLinkUsageCollector;
 } // namespace sflow
 
 #define NDT_PORT 8000
+#define NDT_IO_THREADS 0 // threads running the server io_context; 0 means one per core
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -54,10 +57,13 @@ using json = nlohmann::json;
  *  - publishes/consumes internal events via EventBus.
  *
  * The server runs on a dedicated thread and tracks active sockets so it can stop
- * gracefully. Behavior may differ based on deployment mode (e.g., MININET vs TESTBED).
+ * gracefully. The io_context is run by ioThreads threads; each accepted connection gets its
+ * own strand, so one HttpSession's handlers never run concurrently with each other. Behavior may differ based on deployment mode (e.g., MININET vs TESTBED).
  *
  * Threading:
- *  - runServer()/start() launch the accept loop in m_serverThread.
+ *  - runServer()/start() launch the accept loop in m_serverThread, which runs the
+ *    io_context on ioThreads threads. The io_context must be constructed with the same
+ *    number as its concurrency hint (see resolveIoThreads()).
  *  - stop() requests shutdown, closes acceptor/sockets, and joins the server thread.
  */
 class ControllerAndOtherEventHandler
@@ -78,6 +84,7 @@ class ControllerAndOtherEventHandler
         std::shared_ptr<Controller> ctrl,
         std::shared_ptr<LockManager> lockManager,
         int mode,
+        unsigned ioThreads,
         std::string api_url = "http://localhost:8000/ndt");
     ~ControllerAndOtherEventHandler();
 
@@ -106,11 +113,18 @@ class ControllerAndOtherEventHandler
 
     json parseFlowStatsText(const std::string& responseText);
 
+    /**
+     * @brief Number of threads to run the server io_context with: @p requested, or one per
+     *        core when it is 0 (never less than 1).
+     */
+    static unsigned resolveIoThreads(unsigned requested = NDT_IO_THREADS);
+
   private:
     void doAccept();
 
     std::atomic<bool> m_serverRunning{false};
     net::io_context& m_ioContext;
+    unsigned m_ioThreads;
 
     std::unique_ptr<tcp::acceptor> m_serverAcceptor;
     std::thread m_serverThread;
@@ -133,4 +147,8 @@ class ControllerAndOtherEventHandler
     std::unordered_set<std::shared_ptr<tcp::socket>> m_activeSockets;
 
     std::shared_ptr<LockManager> m_lockManager;
+    // Shared by the telemetry stream subscribers; runs between start() and stop()
+    std::shared_ptr<TelemetryHub> m_telemetryHub;
+    // Binary state snapshots written into the applications' NFS directories
+    std::shared_ptr<SnapshotExporter> m_snapshotExporter;
 };
\ No newline at end of file
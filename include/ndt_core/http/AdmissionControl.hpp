@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>                      // for atomic
+#include <boost/asio/ip/address.hpp>   // for address
+#include <chrono>                      // for steady_clock
+#include <cstdint>                     // for uint64_t
+#include <map>                         // for map
+#include <mutex>                       // for mutex
+#include <nlohmann/json.hpp>           // for json
+#include <string>                      // for string
+#include <string_view>                 // for string_view
+#include <unordered_map>               // for unordered_map
+
+#define NDT_MAX_CONNECTIONS 256          // beyond this only control-plane requests are served
+#define NDT_CONNECTION_RESERVE 32        // extra connections kept open for control-plane calls
+#define NDT_RATE_LIMIT_RPS 50            // sustained requests per second per client address
+#define NDT_RATE_LIMIT_BURST 100         // requests a client may send at once
+#define NDT_RATE_LIMIT_MAX_CLIENTS 4096  // tracked addresses before idle ones are dropped
+#define NDT_HEAVY_MAX_IN_FLIGHT 4        // concurrent requests per heavy endpoint
+
+/**
+ * @brief How a route is treated by AdmissionControl.
+ *
+ *  - Normal: subject to the connection cap and the per-client rate limit.
+ *  - Heavy: also limited to NDT_HEAVY_MAX_IN_FLIGHT concurrent requests per endpoint.
+ *  - ControlPlane: never rejected (controller notifications, locks), so its latency holds
+ *    while the server sheds other load.
+ */
+enum class Admission
+{
+    Normal,
+    Heavy,
+    ControlPlane,
+};
+
+/**
+ * @brief Load shedding of the NDT HTTP server, shared by every session.
+ *
+ * Connections are counted from accept to close. Up to NDT_MAX_CONNECTIONS of them are
+ * served normally; the next NDT_CONNECTION_RESERVE only get control-plane requests answered
+ * (others get 503), and further ones are closed at accept. Each client address has a token
+ * bucket of NDT_RATE_LIMIT_BURST tokens refilled at NDT_RATE_LIMIT_RPS (429 when empty), and
+ * heavy endpoints admit NDT_HEAVY_MAX_IN_FLIGHT requests at a time (503 beyond).
+ */
+class AdmissionControl
+{
+  public:
+    /**
+     * @brief Counts one connection from construction to destruction; move-only so a session
+     *        can hand it to whatever takes over its socket.
+     */
+    class ConnectionSlot
+    {
+      public:
+        ConnectionSlot() = default;
+        explicit ConnectionSlot(bool overCapacity);
+        ConnectionSlot(ConnectionSlot&& other) noexcept;
+        ConnectionSlot& operator=(ConnectionSlot&& other) noexcept;
+        ConnectionSlot(const ConnectionSlot&) = delete;
+        ConnectionSlot& operator=(const ConnectionSlot&) = delete;
+        ~ConnectionSlot();
+
+        /// Accepted beyond NDT_MAX_CONNECTIONS: serve control-plane requests only.
+        bool overCapacity() const
+        {
+            return m_overCapacity;
+        }
+
+        /// Same capacity verdict, counting nothing: for the streams of an HTTP/2 connection.
+        ConnectionSlot borrow() const;
+
+      private:
+        bool m_held = false;
+        bool m_overCapacity = false;
+    };
+
+    static AdmissionControl& instance();
+
+    AdmissionControl(const AdmissionControl&) = delete;
+    AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+    /// Count a new connection; false when it must be closed right away.
+    bool openConnection(ConnectionSlot& slot);
+
+    /// Take a token from @p client's bucket; false means answer 429.
+    bool allowRequest(const boost::asio::ip::address& client);
+
+    /// Enter heavy endpoint @p path; false means answer 503. Pair with leaveHeavy().
+    bool enterHeavy(std::string_view path);
+    void leaveHeavy(std::string_view path);
+
+    /// Count a request refused because its connection is over capacity.
+    void recordOverCapacity();
+
+    /**
+     * @brief {"connections", "max_connections", "rejected_connections", "over_capacity",
+     *        "rate_limited", "clients", "endpoint_busy": {path: count}}
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    AdmissionControl() = default;
+
+    struct Bucket
+    {
+        double tokens = NDT_RATE_LIMIT_BURST;
+        std::chrono::steady_clock::time_point refilledAt;
+    };
+
+    struct Endpoint
+    {
+        unsigned inFlight = 0;
+        uint64_t busy = 0;
+    };
+
+    std::atomic<uint64_t> m_connections{0};
+    std::atomic<uint64_t> m_rejectedConnections{0};
+    std::atomic<uint64_t> m_overCapacity{0};
+    std::atomic<uint64_t> m_rateLimited{0};
+
+    mutable std::mutex m_bucketsMutex;
+    std::map<boost::asio::ip::address, Bucket> m_buckets; // ordered: address has no std::hash
+
+    mutable std::mutex m_endpointsMutex;
+    std::unordered_map<std::string, Endpoint> m_endpoints;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ndt_core/http/AdmissionControl.hpp" // for AdmissionControl
+#include "ndt_core/http/HttpSession.hpp"      // for HttpSession
+#include <boost/asio/ip/tcp.hpp>              // for tcp
+#include <cstdint>                            // for int32_t, uint64_t
+#include <functional>                         // for function
+#include <memory>                             // for shared_ptr, unique_ptr
+#include <string>                             // for string
+#include <string_view>                        // for string_view
+#include <unordered_map>                      // for unordered_map
+#include <vector>                             // for vector
+
+#define HTTP2_MAX_CONCURRENT_STREAMS 256 // SETTINGS_MAX_CONCURRENT_STREAMS we advertise
+#define HTTP2_READ_CHUNK 16384           // bytes read from the socket at once
+#define HTTP2_WRITE_BATCH 65536          // frames gathered into one socket write
+#define HTTP2_IDLE_SESSIONS 16           // stream HttpSessions kept for reuse per connection
+
+struct nghttp2_session;
+
+/**
+ * @brief HTTP/2 over cleartext TCP (h2c) on the REST port, one stream per request.
+ *
+ * HttpSession hands its socket over when a connection starts with the HTTP/2 client preface
+ * (prior knowledge) or when a request asks for "Upgrade: h2c"; that request is then answered
+ * as stream 1. Frames are parsed and written by nghttp2, which also does HPACK and flow
+ * control. Each request is routed by an HttpSession of its own (HttpSession::serveStream())
+ * sharing the connection's strand, admission slot and client address, so a stream waiting
+ * on a blocking or lock-waiting route does not hold up the others. Responses go out as their
+ * handlers finish, in any order.
+ *
+ * GET /ndt/telemetry_stream needs HTTP/1.1 and is refused on a stream.
+ *
+ * Needs a build with nghttp2 (NDT_HAVE_NGHTTP2); without it supported() is false and the
+ * server speaks HTTP/1.1 only.
+ */
+class Http2Session : public std::enable_shared_from_this<Http2Session>
+{
+  public:
+    using StreamFactory = std::function<std::shared_ptr<HttpSession>()>;
+
+    static constexpr std::string_view PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+    static bool supported();
+
+    /// @p streams makes the HttpSession that serves one request.
+    Http2Session(tcp::socket socket, AdmissionControl::ConnectionSlot slot, StreamFactory streams);
+    ~Http2Session();
+
+    Http2Session(const Http2Session&) = delete;
+    Http2Session& operator=(const Http2Session&) = delete;
+
+    /// Serve the connection; @p received holds the bytes already read from it.
+    void start(std::string_view received);
+
+    /**
+     * @brief Serve a connection upgraded from HTTP/1.1 after its 101 was written: @p settings
+     *        is the HTTP2-Settings header of @p request, which is answered as stream 1.
+     */
+    void startUpgraded(std::string_view received,
+                       std::string_view settings,
+                       http::request<http::string_body> request);
+
+  private:
+    struct Stream;
+    struct Callbacks; // nghttp2 callbacks, kept out of this header
+
+    bool open();
+    // Feed @p data to nghttp2; false, connection closed, on a protocol error
+    bool receive(std::string_view data);
+    void readMore();
+    // Write what nghttp2 has queued, or close once neither side has more to say
+    void flush();
+    void close();
+
+    void dispatch(int32_t streamId);
+    void respond(int32_t streamId,
+                 std::shared_ptr<HttpSession> session,
+                 std::shared_ptr<http::response<http::string_body>> response);
+    Stream* findStream(int32_t streamId);
+
+    tcp::socket m_socket;
+    AdmissionControl::ConnectionSlot m_slot;
+    StreamFactory m_streams;
+    nghttp2_session* m_session = nullptr;
+
+    std::unordered_map<int32_t, std::unique_ptr<Stream>> m_open;
+    std::vector<std::shared_ptr<HttpSession>> m_idle;
+
+    std::vector<char> m_in;
+    std::string m_out; // being written while m_writing
+    bool m_writing = false;
+    bool m_receiving = false; // inside receive(): nghttp2 must not be asked to send
+    bool m_closed = false;
+};
@@ -1,14 +1,31 @@
 #pragma once
 
+#include "ndt_core/http/AdmissionControl.hpp"
+#include "utils/JsonArena.hpp" // For utils::JsonArena
+#include "utils/MemoryAccounting.hpp" // For utils::MemoryUsage
+#include "utils/Metrics.hpp" // For utils::Histogram
 #include "utils/Utils.hpp" // For utils::DeploymentMode
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 using json = nlohmann::json;
 
+#define NDT_HTTP_BODY_LIMIT (1024 * 1024)             // request body cap (Beast's default)
+#define NDT_HTTP_LARGE_BODY_LIMIT (64 * 1024 * 1024)  // for routes with Route::largeBody
+#define NDT_BATCH_MAX_QUERIES 1000                    // sub-queries per /ndt/batch request
+#define NDT_HTTP_BODY_BUFFER_KEEP (1024 * 1024)       // response buffer kept for the next request
+
 // Forward declarations to reduce header dependencies
 class TopologyAndFlowMonitor;
 class EventBus;
@@ -20,17 +37,50 @@ class IntentTranslator;
 class HistoricalDataManager;
 class Controller;
 class LockManager;
+class TelemetryHub;
+class SnapshotExporter;
 
 namespace sflow
 {
 class FlowLinkUsageCollector;
 }
 
+namespace utils
+{
+class EncodedBodyCache;
+}
+
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace net = boost::asio;
 using tcp = net::ip::tcp;
 
+/**
+ * @brief Query parameters of a request target ("a=1&b=2"), split once per request.
+ *
+ * The names and values are views into the request target; the parameters are not
+ * percent-decoded.
+ */
+class QueryParams
+{
+  public:
+    QueryParams() = default;
+    explicit QueryParams(std::string_view query);
+
+    /// Value of parameter @p key ("" if absent); the first one if it is repeated.
+    std::string get(std::string_view key) const;
+
+    /// The whole query string, e.g. as a cache key.
+    std::string_view raw() const
+    {
+        return m_raw;
+    }
+
+  private:
+    std::string_view m_raw;
+    std::vector<std::pair<std::string_view, std::string_view>> m_params;
+};
+
 /**
  * @class HttpSession
  * @brief Manages an asynchronous HTTP server session using Boost.Beast.
@@ -61,24 +111,135 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
         std::shared_ptr<IntentTranslator> intentTranslator,
         std::shared_ptr<HistoricalDataManager> historicalDataManager,
         std::shared_ptr<Controller> ctrl,
-        std::shared_ptr<LockManager> lockManager);
+        std::shared_ptr<LockManager> lockManager,
+        std::shared_ptr<TelemetryHub> telemetryHub,
+        std::shared_ptr<SnapshotExporter> snapshotExporter,
+        AdmissionControl::ConnectionSlot slot);
 
     /**
      * @brief Starts the asynchronous operation for the session.
      */
     void start();
 
+    using StreamDone = std::function<void(std::shared_ptr<http::response<http::string_body>>)>;
+
+    /**
+     * @brief A session with the same dependencies, admission verdict and client address but no
+     *        socket of its own, to serve requests arriving on the streams of an HTTP/2 connection.
+     */
+    std::shared_ptr<HttpSession> streamSession();
+
+    /**
+     * @brief Route @p request, which arrived on an HTTP/2 stream, and hand its response to
+     *        @p done instead of writing it; call again for the next one once @p done has run.
+     *
+     * @p done runs on this session's executor, possibly before serveStream() returns.
+     */
+    void serveStream(http::request<http::string_body> request, StreamDone done);
+
+    /// Body limit of a request for @p target: NDT_HTTP_LARGE_BODY_LIMIT on Route::largeBody.
+    static std::uint64_t bodyLimit(std::string_view target);
+
+    /// Encoded bodies held by the response caches of the read-only GET endpoints.
+    static utils::MemoryUsage memoryUsage();
+
   private:
     // --- Asynchronous Operation Handlers ---
+    // The header is read first, so the body limit can follow the route and a client that sent
+    // "Expect: 100-continue" gets its 100 at once. Pipelined requests wait in m_buffer and are
+    // served in order.
     void readRequest();
+    // A connection starting with Http2Session::PREFACE is handed to an Http2Session
+    void detectHttp2();
+    void startHttp2();
+    // Answer "Upgrade: h2c" with 101 and go on as HTTP/2; false when the request does not ask
+    bool upgradeToHttp2();
+    void onReadHeader(beast::error_code ec, std::size_t bytesTransferred);
+    void readBody();
     void onRead(beast::error_code ec, std::size_t bytesTransferred);
+    // Answers 413 without reading the body, then closes the connection
+    void rejectBody(std::uint64_t limit);
     void writeResponse();
+    // writeResponse() of a request served by serveStream()
+    void finishStream();
     void onWrite(beast::error_code ec, std::size_t bytesTransferred);
     void closeSocket();
 
     // --- Request Routing and Handling ---
+    using Handler = void (HttpSession::*)(http::response<http::string_body>&);
+
+    /// Handlers of one path, per method; nullptr when the path doesn't take that method.
+    struct Route
+    {
+        Handler get = nullptr;
+        Handler post = nullptr;
+        bool blocking = false; // run on utils::BlockingPool, off the I/O threads
+        Admission admission = Admission::Normal;
+        bool largeBody = false; // body up to NDT_HTTP_LARGE_BODY_LIMIT, not NDT_HTTP_BODY_LIMIT
+    };
+
+    /**
+     * @brief The API routes, by path (the target without its query string).
+     *
+     * Built once; handleRequest() finds the handler with one hash lookup, however many
+     * endpoints there are, and parses the query string into m_query for it.
+     */
+    static const std::unordered_map<std::string_view, Route>& routes();
+
+    /**
+     * @brief Route the request in m_req and write the response.
+     *
+     * A blocking handler runs on utils::BlockingPool and the response is written back on the
+     * session's executor; when the pool's queue is full the answer is 503 Server busy.
+     */
     void handleRequest();
 
+    /**
+     * @brief Hand the connection over to a TelemetryStreamSession (GET /ndt/telemetry_stream).
+     *
+     * Query parameters (all optional): interval_ms=<n> push cadence (default
+     * TELEMETRY_STREAM_DEFAULT_INTERVAL_MS), dpid=<n>, edge=<src_dpid>-<dst_dpid>,
+     * src=<ip>[/<len>] and dst=<ip>[/<len>] (see TelemetryFilter). Returns false, with @p res
+     * set to 400, when a parameter is malformed; the session then answers normally.
+     */
+    bool startTelemetryStream(http::response<http::string_body>& res);
+
+    /**
+     * @brief Queue a POST /ndt/acquire_lock with "wait_ms" in the LockManager and answer it
+     *        when the lease is granted, or with 423 once the wait is over.
+     *
+     * The session reads nothing meanwhile, like for a blocking route, but no thread waits: a
+     * timer on the session's executor ends the wait, and the request leaves the queue when
+     * the client disconnects. Returns false, leaving @p response to handleAcquireLock(), for
+     * a request that does not wait or is malformed.
+     */
+    bool startLockWait(const std::shared_ptr<http::response<http::string_body>>& response);
+
+    /**
+     * @brief Apply AdmissionControl to a request for @p path; false, with @p res set to 429
+     *        or 503, when it is refused. A Heavy request admitted here must be followed by
+     *        AdmissionControl::leaveHeavy(@p path).
+     */
+    bool admit(Admission admission, std::string_view path,
+               http::response<http::string_body>& res);
+
+    /// Call @p handler, turning an exception it throws into an error response.
+    void runHandler(Handler handler, http::response<http::string_body>& res);
+
+    /**
+     * @brief Set the body of @p res to the JSON text @p render returns, converted to the
+     *        format of the request's Accept header (JSON, CBOR or MessagePack) and compressed
+     *        per its Accept-Encoding (gzip, or zstd when built with it).
+     *
+     * With @p cache, the body of parameters @p key at data version @p version is rendered
+     * and encoded once and shared by every request for it (see utils::EncodedBodyCache).
+     */
+    void writeEncodedBody(http::response<http::string_body>& res,
+                          const std::function<std::string()>& render,
+                          utils::EncodedBodyCache* cache = nullptr,
+                          std::string_view key = {},
+                          std::string_view version = {});
+
     // Each API endpoint gets its own handler function for clarity.
     /**
      * @brief Handles a link-failure notification sent by the Ryu controller.
@@ -86,7 +247,8 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      * This HTTP handler is invoked by Ryu when a link-down event is detected in the OpenFlow
      * network (e.g., port/link failure). It parses the request payload, marks the corresponding
      * directed edge(s) as DOWN in the topology monitor (both directions if present), and emits
-     * LinkFailureDetected events on the internal event bus.
+     * LinkFailureDetected events on the internal event bus. Each event lists the flows whose
+     * path crossed the edge (FlowLinkUsageCollector::invalidatePathsThrough()).
      *
      * Error responses:
      * - 400 Bad Request if the payload is invalid
@@ -116,6 +278,22 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      *       not directly by the switches.
      */
     void handleLinkRecovery(http::response<http::string_body>& res);
+    /**
+     * @brief Applies a batch of Ryu topology events (switch enter/leave, link add/delete,
+     *        host add) to the topology in one locked update.
+     *
+     * Body: {"events": [{"type": "link_delete", "link": {...}}, ...]}, each event carrying a
+     * "switch", "link" or "host" object in the form of Ryu's topology REST API. Links that
+     * went down have the paths through them invalidated, and all state changes are published
+     * as one LinkStateChanged event, as handleLinkFailure() / handleLinkRecovery() do.
+     *
+     * Error responses:
+     * - 400 Bad Request: malformed body or unknown event type (nothing applied)
+     *
+     * @note Pushed by the Ryu application; the full re-fetch from Ryu's REST API only runs
+     *       every TOPOLOGY_RESYNC_INTERVAL_S as a safety net.
+     */
+    void handleTopologyEvents(http::response<http::string_body>& res);
     /**
      * @brief Returns the current topology graph (nodes + edges) as JSON.
      *
@@ -125,6 +303,21 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      *   - "edges": per-link attributes including state (is_up), bandwidth/usage/utilization,
      *              endpoints (dpid/interface/ip), flow_set, and enable flags.
      *
+     * Optional query parameters:
+     *   - fields=a,b,...: keep only the listed members in every node and edge object.
+     *   - exclude_flow_set=true: omit the per-edge "flow_set" arrays.
+     *   - since=<version>: delta mode. The body gains "full" and "version" members and
+     *     "edges" only lists links whose counters or flow sets changed after <version>; "nodes"
+     *     is empty. If the topology itself changed meanwhile the full graph is returned with
+     *     "full": true.
+     *
+     * Every response carries an ETag holding the snapshot version ("<topology>-<stats>-<flows>");
+     * a request whose If-None-Match matches it gets 304 Not Modified with no body.
+     *
+     * The body is written directly from a graph snapshot with utils::JsonWriter; no json
+     * DOM is built. It honours Accept and Accept-Encoding (see writeEncodedBody()); each
+     * query is rendered and encoded once per snapshot version for all pollers.
+     *
      * @param[out] res HTTP response containing the serialized graph JSON.
      *
      * @note Intended for clients that need to visualize or consume the live network graph
@@ -140,18 +333,157 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      * 5-tuple (src/dst IP, src/dst port, protocol), estimated sending/packet rates (periodic
      * and immediate), first/latest sampled timestamps, and the computed path (node/interface list).
      *
+     * The response's ETag is the collector's flow version and If-None-Match is honoured
+     * (304 when no flow changed). With ?since=<version> the body is the delta object of
+     * FlowLinkUsageCollector::getFlowInfoDeltaJson() instead of the array. Accept and
+     * Accept-Encoding are honoured; each body is encoded once per flow version.
+     *
      * @param[out] res HTTP response whose body is set to the serialized detected-flow JSON.
      *
      * @note Intended for clients such as a dashboard/GUI to query live flow visibility.
      */
     void handleGetDetectedFlowData(http::response<http::string_body>& res);
+    /**
+     * @brief Returns one page of the detected flows matching a filter.
+     *
+     * Query parameters (all optional, combined with AND):
+     *   - src=<ip>[/<len>], dst=<ip>[/<len>]: source/destination address or prefix
+     *   - protocol=<n>, src_port=<n>, dst_port=<n>, port=<n> (either side)
+     *   - elephant=true|false, min_rate_bps=<n>: on the rate of the last second
+     *   - dpid=<n>: the flow's path passes this switch
+     *   - edge=<src_dpid>-<dst_dpid>: the flow's path uses this link
+     *   - limit=<n> (default 100, at most FLOW_QUERY_MAX_LIMIT), cursor=<next_cursor>
+     *
+     * The body is {"flows": [...], "next_cursor": string|null} as produced by
+     * FlowLinkUsageCollector::queryFlowsJson(); flows use the get_detected_flow_data format.
+     * Malformed parameters yield 400.
+     *
+     * @param[out] res HTTP response whose body is set to the serialized page.
+     */
+    void handleQueryFlows(http::response<http::string_body>& res);
+    /**
+     * @brief Returns the host-to-host traffic matrix of the flows' periodic rates.
+     *
+     * Query: min_bps= (leave out smaller cells, default 0). The body is
+     * TrafficMatrix::sparseJson(): {"version", "hosts": [ip], "matrix": [[src, dst, bps]]},
+     * src and dst indexing "hosts". The collector keeps the matrix up to date, so this costs
+     * the non-zero cells rather than a pass over the flow table. The ETag is the matrix
+     * version; CBOR and MessagePack are negotiated as for get_detected_flow_data.
+     *
+     * @param[out] res HTTP response returned to the caller.
+     */
+    void handleGetTrafficMatrix(http::response<http::string_body>& res);
+    /**
+     * @brief Returns internal statistics of the sFlow collector as JSON.
+     *
+     * The body has these members:
+     *   - "ingest_workers": per receive worker datagram/drop/batching counters
+     *   - "flow_pool": FlowInfo recycling counters of the flow table
+     *   - "flow_tiers": hot and cold flows of the flow table, demotions and promotions
+     *   - "flow_export": records of purged flows queued, dropped and written (null when
+     *     export is off)
+     *   - "path_cache": hit rate and invalidations of the flow path cache
+     *   - "path_pool": distinct interned flow paths, and how many of them are packed
+     *   - "classifier": rule counts, memory per rule and poll/update throughput of the
+     *     OpenFlow classifier
+     *   - "edge_flow_expiry": edge flow memberships expired per tick and in total
+     *   - "http_client": requests, retries and connection reuse of the outgoing HTTP client
+     *   - "snmp_client": requests, retries and timeouts of the device health SNMP client
+     *   - "liveness": ICMP RTT and loss per switch address (TESTBED mode)
+     *   - "poll_scheduler": polls, failures and switches backing off per telemetry metric
+     *   - "ssh_sessions": sessions, failures and reconnects of the pooled SSH connection to
+     *     each switch
+     *   - "event_bus": events emitted, coalesced, queued, dropped, merged and handled, and
+     *     handler time, per event type
+     *   - "response_cache": hits and encodes of the shared bodies of the read-only endpoints
+     *   - "telemetry_stream": subscribers and update sizes of the telemetry stream hub
+     *   - "admission": connections and requests refused by AdmissionControl
+     *   - "flow_batches": flow batches tracked, pending and completed
+     *   - "recent_history": edges and flows with an in-memory history, and flows skipped
+     *
+     * @param[out] res HTTP response whose body is set to the serialized statistics.
+     *
+     * @note Intended for operators profiling the collector under load.
+     */
+    void handleGetCollectorStats(http::response<http::string_body>& res);
+    /**
+     * @brief Reports which subsystems have started and are warm (utils::Startup).
+     *
+     * Responses:
+     *   - 200 OK: {"ready": true, "subsystems": {...}} once all of them are warm
+     *   - 503 Service Unavailable: the same document while one is still warming up or failed
+     */
+    void handleGetReadiness(http::response<http::string_body>& res);
+    /**
+     * @brief Lists the long-lived threads (utils::ThreadRegistry) with their CPU time,
+     *        wakeups and last iteration, the busiest first, to see which one burns CPU.
+     */
+    void handleGetThreads(http::response<http::string_body>& res);
+    /**
+     * @brief Serves the latest failover traces (utils::Tracer), newest first, as an OTLP/JSON
+     *        ExportTraceServiceRequest that an OpenTelemetry collector or viewer can ingest.
+     *
+     * Query: limit (default 20) traces at most.
+     */
+    void handleGetTraces(http::response<http::string_body>& res);
+    /**
+     * @brief Samples the process for a pprof-readable CPU profile (utils::Profiler), or
+     *        returns the sampled live heap with type=heap. Only with --enable-profiling.
+     *
+     * Query: seconds (default 10), hz (default PROFILER_DEFAULT_HZ), type (cpu or heap).
+     * Blocks for the whole profile, so it runs on the blocking pool.
+     */
+    void handleGetProfile(http::response<http::string_body>& res);
+
+    /**
+     * @brief The recent records of every thread in utils::FlightRecorder, as JSON or
+     *        (format=binary) in the crash dump's format.
+     *
+     * Query: kind (sample, classifier_miss, flow_job or event), limit (newest records per
+     * thread), format (json or binary).
+     */
+    void handleGetFlightRecorder(http::response<http::string_body>& res);
+    /**
+     * @brief Estimated memory of each subsystem's major containers, with bytes per flow and
+     *        per rule, from utils::MemoryAccounting's last refresh.
+     *
+     * Query: refresh=1 runs the estimators first rather than serving results up to
+     * MEMORY_ACCOUNTING_PERIOD_MS old.
+     */
+    void handleGetMemory(http::response<http::string_body>& res);
+    /**
+     * @brief Serves the runtime parameters (utils::RuntimeConfig): per name, its value,
+     *        default, range, whether it is live and what it tunes.
+     */
+    void handleGetRuntimeConfig(http::response<http::string_body>& res);
+    /**
+     * @brief Sets live runtime parameters from a JSON body {"name": value, ...}, all or none.
+     *
+     * Responses:
+     *   - 200 OK: the parameters, as handleGetRuntimeConfig() serves them
+     *   - 400 Bad Request: {"error": "..."} if a name is unknown or not live, or a value is
+     *     out of range; nothing is changed
+     */
+    void handleSetRuntimeConfig(http::response<http::string_body>& res);
+    /**
+     * @brief Serves the server's metrics in the Prometheus text format (version 0.0.4).
+     *
+     * Besides everything in utils::MetricsRegistry (sFlow decode time, Classifier lookup time,
+     * poller cycle times, HTTP request latency per route), adds the sFlow ingest counters and
+     * flow table size of the collector, the FlowDispatcher queues and the blocking pool
+     * occupancy, read at scrape time.
+     *
+     * @param[out] res HTTP response with the exposition as body.
+     */
+    void handleGetMetrics(http::response<http::string_body>& res);
     /**
      * @brief Returns the cached OpenFlow flow entries for all switches as JSON.
      *
      * This HTTP handler serves a snapshot of the current OpenFlow tables maintained by
      * DeviceConfigurationAndPowerManager. The data is read from an in-memory cache that is
      * periodically refreshed by a background worker, so the response may be up to one update
-     * interval stale.
+     * interval stale. Accept and Accept-Encoding are honoured; the tables are encoded once
+     * per refresh.
      *
      * @param[out] res HTTP response whose body is set to the JSON-serialized OpenFlow tables.
      *
@@ -236,62 +568,51 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      */
     void handleModifyFlowEntry(http::response<http::string_body>& res);
     /**
-     * @brief Installs an OpenFlow group entry via the Ryu REST API.
-     *
-     * This HTTP handler is invoked by the Ryu application (or a northbound client) with a JSON
-     * payload describing a group entry. The payload is forwarded to FlowRoutingManager, which
-     * relays the request to Ryu's REST endpoint (/stats/groupentry/add).
+     * @brief Installs an OpenFlow group entry (one Ryu /stats/groupentry body, with
+     *        "dpid" and "group_id") by wrapping it into a batch request under
+     *        "install_group_entries" and forwarding it to processFlowBatch().
      *
-     * @param[out] res HTTP response returned to the caller (JSON acknowledgement).
-     *
-     * @note The request body must be valid JSON in the format expected by Ryu's group-entry API.
+     * @param[out] res HTTP response returned to the caller.
      */
     void handleInstallGroupEntry(http::response<http::string_body>& res);
     /**
-     * @brief Deletes an OpenFlow group entry via the Ryu REST API.
+     * @brief Deletes an OpenFlow group entry (one Ryu /stats/groupentry body, with
+     *        "dpid" and "group_id") by wrapping it into a batch request under
+     *        "delete_group_entries" and forwarding it to processFlowBatch().
      *
-     * Parses the JSON request body that identifies the group entry to remove and forwards it
-     * to FlowRoutingManager, which calls Ryu's REST endpoint (/stats/groupentry/delete).
-     *
-     * @param[out] res HTTP response returned to the caller (JSON acknowledgement).
+     * @param[out] res HTTP response returned to the caller.
      */
     void handleDeleteGroupEntry(http::response<http::string_body>& res);
     /**
-     * @brief Modifies an existing OpenFlow group entry via the Ryu REST API.
-     *
-     * Parses the JSON request body describing the updated group entry and forwards it to
-     * FlowRoutingManager, which calls Ryu's REST endpoint (/stats/groupentry/modify).
+     * @brief Modifies an OpenFlow group entry (one Ryu /stats/groupentry body, with
+     *        "dpid" and "group_id") by wrapping it into a batch request under
+     *        "modify_group_entries" and forwarding it to processFlowBatch().
      *
-     * @param[out] res HTTP response returned to the caller (JSON acknowledgement).
+     * @param[out] res HTTP response returned to the caller.
      */
     void handleModifyGroupEntry(http::response<http::string_body>& res);
     /**
-     * @brief Installs an OpenFlow meter entry via the Ryu REST API.
-     *
-     * Parses the JSON request body describing a meter entry and forwards it to FlowRoutingManager,
-     * which calls Ryu's REST endpoint (/stats/meterentry/add).
-     *
-     * @param[out] res HTTP response returned to the caller (JSON acknowledgement).
+     * @brief Installs an OpenFlow meter entry (one Ryu /stats/meterentry body, with
+     *        "dpid" and "meter_id") by wrapping it into a batch request under
+     *        "install_meter_entries" and forwarding it to processFlowBatch().
      *
-     * @note The request body must be valid JSON in the format expected by Ryu's meter-entry API.
+     * @param[out] res HTTP response returned to the caller.
      */
     void handleInstallMeterEntry(http::response<http::string_body>& res);
     /**
-     * @brief Deletes an OpenFlow meter entry via the Ryu REST API.
-     *
-     * Parses the JSON request body that identifies the meter entry to remove and forwards it to
-     * FlowRoutingManager, which calls Ryu's REST endpoint (/stats/meterentry/delete).
+     * @brief Deletes an OpenFlow meter entry (one Ryu /stats/meterentry body, with
+     *        "dpid" and "meter_id") by wrapping it into a batch request under
+     *        "delete_meter_entries" and forwarding it to processFlowBatch().
      *
-     * @param[out] res HTTP response returned to the caller (JSON acknowledgement).
+     * @param[out] res HTTP response returned to the caller.
      */
     void handleDeleteMeterEntry(http::response<http::string_body>& res);
     /**
-     * @brief Modifies an existing OpenFlow meter entry via the Ryu REST API.
+     * @brief Modifies an OpenFlow meter entry (one Ryu /stats/meterentry body, with
+     *        "dpid" and "meter_id") by wrapping it into a batch request under
+     *        "modify_meter_entries" and forwarding it to processFlowBatch().
      *
-     * Parses the JSON request body describing the updated meter entry and forwards it to
-     * FlowRoutingManager, which calls Ryu's REST endpoint (/stats/meterentry/modify).
-     *
-     * @param[out] res HTTP response returned to the caller (JSON acknowledgement).
+     * @param[out] res HTTP response returned to the caller.
      */
     void handleModifyMeterEntry(http::response<http::string_body>& res);
     /**
@@ -302,17 +623,72 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      *   - "modify_flow_entries" : [ ... ]
      *   - "delete_flow_entries" : [ ... ]
      *
-     * The request is validated and executed by processFlowBatch().
+     * and optionally "install_group_entries", "modify_group_entries", "delete_group_entries"
+     * and the same three for meters, each a list of Ryu group or meter entries.
+     *
+     * The request is validated and executed by processFlowBatch(). With "async": true in the
+     * body (or ?async=1) the response is 202 with the batch id, as soon as the jobs are queued.
      *
      * @param[out] res HTTP response returned to the caller.
      */
     void handleInstallModifyDeleteFlowEntries(http::response<http::string_body>& res);
+    /**
+     * @brief Brings the IPv4 destination rules of an app namespace on some switches to a
+     *        desired set, sending only the difference (POST /ndt/reconcile_flow_entries).
+     *
+     * Body: {"namespace", "switches": [{"dpid", "flow_entries": [install entries]}]}, plus
+     * the "lane", "deadline_ms", "async" and "trace_id" of processFlowBatch(). Each switch is
+     * diffed by FlowReconciler::reconcile() and the delta queued as one flow batch.
+     *
+     * Responses:
+     *   - 200 OK (202 in async mode): processFlowBatch()'s answer plus "switches":
+     *     [{"dpid", "added", "modified", "removed", "unchanged"}]; without a batch_id if
+     *     nothing had to change
+     *   - 400 Bad Request if an entry is not an eth_type 2048 / ipv4_dst / single OUTPUT rule
+     *
+     * @param[out] res HTTP response returned to the caller.
+     */
+    void handleReconcileFlowEntries(http::response<http::string_body>& res);
+    /**
+     * @brief Evaluates candidate reroutes against the current link loads without touching the
+     *        network (WhatIfEvaluator).
+     *
+     * Body: {"scenarios": [{"moves": [{"src_ip", "dst_ip", "src_port"?, "dst_port"?,
+     * "protocol"?, "path", "bps"?}]}], "top_links"?}. "path" is the switch dpids in order or
+     * explicit [dpid, output port] hops. Without "bps" a move takes every matching flow off
+     * its current path at its periodic rate; with it, the move is that much new traffic.
+     * Each scenario applies all of its moves at once; scenarios are independent.
+     *
+     * Responses:
+     *   - 200 OK: {"graph_version", "max_utilization_before", "results": [{
+     *     "max_utilization_after", "max_utilization_delta", "max_link", "moved_bps", "flows",
+     *     "links", "unknown_hops"} or {"error"}], "elapsed_us"}; utilisation in percent
+     *   - 400 Bad Request on a malformed body or more than WHAT_IF_MAX_SCENARIOS scenarios
+     *
+     * @param[out] res HTTP response returned to the caller.
+     */
+    void handleWhatIfLinkLoad(http::response<http::string_body>& res);
+    /**
+     * @brief Bottleneck residual bandwidth of the known paths of many host pairs at once.
+     *
+     * Body: {"pairs": [{"src_ip", "dst_ip"}]}. Each pair's path is the one the host pair
+     * table holds (inform_all_destination_paths); its residual is the smallest leftBandwidth
+     * on it, cached per path until one of its links moves by PATH_RESIDUAL_CHANGE_PERCENT.
+     *
+     * Responses:
+     *   - 200 OK: {"residuals": [bps or null for a pair without a known path]}, in request
+     *     order
+     *   - 400 Bad Request on a malformed body or address
+     *
+     * @param[out] res HTTP response returned to the caller.
+     */
+    void handleGetPathResiduals(http::response<http::string_body>& res);
     /**
      * @brief Returns the latest cached CPU utilization report as JSON.
      *
      * This HTTP handler serves a snapshot of CPU utilization metrics collected by
      * DeviceConfigurationAndPowerManager. The response is backed by an in-memory cache
-     * (m_cachedCpuReport) that is refreshed asynchronously by statusUpdateWorker(), so the
+     * (DeviceStatus::cpu) that is refreshed asynchronously by statusUpdateWorker(), so the
      * returned data may lag behind real-time device readings by up to the polling interval.
      *
      * @param[out] res HTTP response whose body is set to the JSON-serialized CPU report.
@@ -325,7 +701,7 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      *
      * This HTTP handler serves a snapshot of memory utilization metrics collected by
      * DeviceConfigurationAndPowerManager. The response is backed by an in-memory cache
-     * (m_cachedMemoryReport) that is refreshed asynchronously by statusUpdateWorker(), so the
+     * (DeviceStatus::memory) that is refreshed asynchronously by statusUpdateWorker(), so the
      * returned data may be slightly stale relative to the current device state.
      *
      * @param[out] res HTTP response whose body is set to the JSON-serialized memory report.
@@ -370,15 +746,16 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      */
     void handleModifyDeviceName(http::response<http::string_body>& res);
     /**
-     * @brief Receives a simulation case request and forwards it to the external simulation server.
+     * @brief Receives a simulation case request and queues it for the external simulation server.
      *
-     * This HTTP handler accepts a JSON request body describing a simulation case, then delegates
-     * to SimulationRequestManager::requestSimulation() to POST the payload to the configured
-     * simulation server (SIM_SERVER_URL). The handler responds with HTTP 202 (Accepted) and a
-     * JSON acknowledgement containing the simulation server's response string.
+     * This HTTP handler accepts a JSON request body describing a simulation case and hands it to
+     * SimulationRequestManager::requestSimulation(), which POSTs it to the configured simulation
+     * server (SIM_SERVER_URL) in the background. The handler does not wait for the simulator.
      *
      * Response:
-     *   - 202 Accepted with {"status":"<simulation_server_response>"} on success
+     *   - 202 Accepted with {"status":"queued","simulation_id":N}; poll
+     *     GET /ndt/simulation_status?id=N for whether the simulator accepted it
+     *   - 503 Service Unavailable if SIM_MAX_QUEUED requests are already waiting
      *
      * @param[out] res HTTP response returned to the caller.
      *
@@ -403,6 +780,30 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      * acknowledges receipt and initiation of forwarding.
      */
     void handleSimulationCompleted(http::response<http::string_body>& res);
+    /**
+     * @brief Returns the state of a simulation request (GET /ndt/simulation_status?id=).
+     *
+     * Responses:
+     *   - 200 OK: SimulationRequestManager::statusJson() of the request
+     *   - 400 Bad Request if id is missing or not a number
+     *   - 404 Not Found if the id is unknown or was dropped
+     */
+    void handleGetSimulationStatus(http::response<http::string_body>& res);
+    /**
+     * @brief Writes a binary snapshot of the topology and flows into an application's NFS
+     *        directory (POST /ndt/export_snapshot, {"app_id": N, "interval_ms": optional}).
+     *
+     * A simulator can mmap the file instead of fetching and parsing the JSON state; the format
+     * is described in SnapshotExporter.hpp. With "interval_ms" the export is also repeated at
+     * that period from the task scheduler, and 0 stops the repetition.
+     *
+     * Responses:
+     *   - 200 OK: SnapshotExporter::exportForApp() result, plus the effective "interval_ms"
+     *   - 400 Bad Request if app_id is missing or interval_ms is negative
+     *   - 404 Not Found if the application is not registered
+     *   - 500 Internal Server Error if the file cannot be written
+     */
+    void handleExportSnapshot(http::response<http::string_body>& res);
     void handleGetStaticTopology(http::response<http::string_body>& res);
     /**
      * @brief Receives and stores all-destination paths computed/installed by the Ryu controller.
@@ -460,7 +861,7 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      *
      * This HTTP handler serves a snapshot of device temperature metrics maintained by
      * DeviceConfigurationAndPowerManager. The data is returned from an in-memory cache
-     * (m_cachedTemperatureReport) that is refreshed asynchronously by statusUpdateWorker(),
+     * (DeviceStatus::temperature) that is refreshed asynchronously by statusUpdateWorker(),
      * therefore the response may lag behind real-time readings by up to the polling interval.
      *
      * @param[out] res HTTP response whose body is set to the JSON-serialized temperature report.
@@ -501,8 +902,84 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      * hosts).
      */
     void handleGetPathSwitchCount(http::response<http::string_body>& res);
+    /**
+     * @brief Known paths of many host pairs in one request
+     *        (FlowLinkUsageCollector::getPathsBetweenHostsJson()).
+     *
+     * Body: {"pairs": [{"src", "dst"}]}, hosts by device name or IPv4 address.
+     *
+     * Responses:
+     *   - 200 OK: {"paths": [one entry per pair, in request order]}; a pair without a path
+     *     or with an unknown host has "error" instead of "switch_path" and "switch_count"
+     *   - 400 Bad Request on a malformed body
+     *
+     * @param[out] res HTTP response returned to the caller.
+     */
+    void handleGetPathsBetweenHosts(http::response<http::string_body>& res);
+    /**
+     * @brief Many telemetry sub-queries in one request, answered from one graph snapshot and
+     *        one DeviceStatus report so the results describe the same moment.
+     *
+     * Body: {"queries": [{"type", "id"?, ...}]}, at most NDT_BATCH_MAX_QUERIES, of types:
+     *   - "device_metrics": "device" (name, IP or DPID), "metrics"? (subset of "power",
+     *     "cpu", "memory", "temperature"; all by default), from the cached reports
+     *   - "link_bandwidth": "src", "dst" (switches as above), both directions of the link
+     *   - "switch_count": "src_ip", "dst_ip"
+     *   - "path": "src", "dst" (hosts), as getPathsBetweenHostsJson()
+     *
+     * Responses:
+     *   - 200 OK: {"graph_version", "status_version", "results": [one per query, in order,
+     *     with its "id"; {"error"} if it failed]}
+     *   - 400 Bad Request on a malformed body or too many queries
+     *
+     * @param[out] res HTTP response returned to the caller.
+     */
+    void handleBatch(http::response<http::string_body>& res);
     void handleGetOpenflowCapacity(http::response<http::string_body>& res);
     void handleSetHistoricalLoggingState(http::response<http::string_body>& res);
+    /**
+     * @brief Returns the recent usage of one link from HistoricalDataManager's RecentHistory.
+     *
+     * Query parameters:
+     *   - src=<endpoint>, dst=<endpoint> (required): a switch by dpid, a host by MAC
+     *   - from=<ms>, to=<ms>: time range in ms since the epoch (default: all kept points)
+     *   - resolution=1s|1m: 1 s samples (last HISTORY_SECOND_POINTS) or 1 min rollups (last
+     *     HISTORY_MINUTE_POINTS); default 1s
+     *
+     * The body is {"points": [{"timestamp_ms", "value", "peak"}, ...]}, oldest first, with the
+     * usage in bps; a 1m point holds the mean and the peak of its minute. A link without
+     * history has no points. Malformed parameters yield 400.
+     *
+     * @param[out] res HTTP response whose body is set to the serialized points.
+     */
+    void handleGetLinkHistory(http::response<http::string_body>& res);
+    /**
+     * @brief Returns the recent sending rate of one flow, like handleGetLinkHistory().
+     *
+     * The flow is given by src_ip=, dst_ip=, src_port=, dst_port= and protocol= (all
+     * required); from=, to= and resolution= are those of handleGetLinkHistory(). Only flows
+     * seen while fewer than HISTORY_MAX_FLOW_SERIES flows had a history are recorded.
+     *
+     * @param[out] res HTTP response whose body is set to the serialized points.
+     */
+    void handleGetFlowHistory(http::response<http::string_body>& res);
+    /**
+     * @brief Returns the recorded usage of one link over a time range, aggregated per step.
+     *
+     * Query parameters:
+     *   - src=<id>, dst=<id> (required): the endpoints as named in the history files, a
+     *     switch by dpid and a host by MAC
+     *   - from=<ms>, to=<ms>: ms since the epoch (default: the last hour)
+     *   - step=<ms>: aggregation step (default 60000)
+     *
+     * The body is HistoricalDataManager::queryLinkHistory(): per step with samples, their
+     * count and the avg, max and p95 usage in bps. Ranges over HISTORY_QUERY_MAX_DAYS days or
+     * HISTORY_QUERY_MAX_STEPS steps, and malformed parameters, yield 400. Runs on the
+     * blocking pool, as it reads the day files.
+     *
+     * @param[out] res HTTP response whose body is set to the serialized steps.
+     */
+    void handleQueryLinkHistory(http::response<http::string_body>& res);
     /**
      * @brief Returns the average utilization of active inter-switch links in the current topology.
      *
@@ -514,26 +991,44 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      *
      * For each qualifying directed edge, utilization is computed as:
      *   linkBandwidthUsage / linkBandwidth
-     * and the handler returns the arithmetic mean across all qualifying edges.
+     * and the handler returns the arithmetic mean across all qualifying edges, with their
+     * count and the 50th, 90th and 99th percentiles (to 1%). TopologyAndFlowMonitor keeps
+     * these up to date as counters change, so the request does not copy or scan the graph.
      *
      * Response:
-     *   - 200 OK: {"status":"success","avg_link_usage":<double>}
+     *   - 200 OK: {"status":"success","avg_link_usage":<double>,"active_links":<uint>,
+     *              "link_usage_percentiles":{"p50","p90","p99"}}
      *
      * @param[out] res HTTP response returned to the caller (JSON).
      *
      * @note If no qualifying links exist, avg_link_usage is 0.
      */
     void handleGetAvgLinkUsage(http::response<http::string_body>& res);
+    /**
+     * @brief Returns the links whose busier direction is at least min_utilization percent.
+     *
+     * Query: min_utilization= (percent, default CONGESTION_HOTSPOT_PERCENT) and k= (at most
+     * this many links, default all). The links come most utilised first, read from the
+     * congestion index of TopologyAndFlowMonitor::getCongestedLinksJson(), so the request
+     * costs the links returned rather than a scan of the topology.
+     *
+     * Response:
+     *   - 200 OK: {"status":"success","min_utilization":<double>,"links":[...]}
+     *   - 400 Bad Request: {"error":"Invalid parameter: <name>"}
+     *
+     * @param[out] res HTTP response returned to the caller (JSON).
+     */
+    void handleGetCongestedLinks(http::response<http::string_body>& res);
     /**
      * @brief Returns the total incoming traffic load (bps) entering a given switch.
      *
      * This HTTP handler expects a JSON request body containing:
      *   - "dpid" (uint64): datapath ID of the target switch.
      *
-     * It scans the current topology graph and sums the link bandwidth usage
-     * (edge.linkBandwidthUsage) of all directed edges whose destination switch matches the given
-     * dpid (i.e., edges where e.dstDpid == dpid). The resulting sum represents the aggregate input
-     * traffic load currently arriving at that switch (in bits per second).
+     * It returns the sum of the link bandwidth usage (edge.linkBandwidthUsage) of all directed
+     * edges ending at the switch, which TopologyAndFlowMonitor::getSwitchLoad() keeps up to date
+     * as link counters change, so the request does not scan the graph. The sum represents the
+     * aggregate input traffic load currently arriving at that switch (in bits per second).
      *
      * Response:
      *   - success: {"status":"success","total_input_traffic_load_bps":<uint64>}
@@ -541,7 +1036,7 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      *
      * @param[out] res HTTP response returned to the caller (JSON).
      *
-     * @note This sums per-edge usage values from the in-memory graph snapshot. It does not
+     * @note This sums the current per-edge usage values. It does not
      *       account for link direction normalization or packet drops; it simply aggregates
      *       all edges terminating at the specified dpid.
      */
@@ -552,13 +1047,13 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      * This HTTP handler expects a JSON request body containing:
      *   - "dpid" (uint64): datapath ID of the target switch.
      *
-     * It takes a snapshot of the current topology graph and iterates over all directed edges.
-     * For each edge whose destination switch matches the given dpid (e.dstDpid == dpid), it adds
-     * the size of that edge's flowSet to an accumulator. The final value represents the total
-     * count of flow identifiers currently associated with incoming links to the specified switch.
+     * It returns the number of flows on each directed edge ending at the switch, added up; the
+     * per-switch total is kept by TopologyAndFlowMonitor::getSwitchLoad() as flows join and
+     * leave edges, so the request does not scan the graph. The value represents the total count
+     * of flow identifiers currently associated with incoming links to the specified switch.
      *
      * Response:
-     *   - success: {"status":"success","num_of_flows":<int>}
+     *   - success: {"status":"success","num_of_flows":<uint64>}
      *   - error  : {"status":"error","message":"dpid missing"} if "dpid" is not provided
      *
      * @param[out] res HTTP response returned to the caller (JSON).
@@ -568,20 +1063,25 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      */
     void handleGetNumOfFlowsPassingASwitch(http::response<http::string_body>& res);
     /**
-     * @brief Attempts to acquire a global application lock to prevent conflicting operations.
-     *
-     * This endpoint provides mutual exclusion for operations that should not run concurrently
-     * across applications (e.g., topology updates, flow programming, power actions). The caller
-     * may specify a lock "type" and a time-to-live ("ttl") in seconds; if the request body is
-     * missing/invalid JSON, default values are used.
+     * @brief Leases locks that keep applications' conflicting operations apart (see
+     *        LockManager).
      *
      * Request body (optional JSON):
-     *   - "type": string lock category/name (defaults to LockManager::DEFAULT_LOCK_TYPE_STR)
-     *   - "ttl" : integer TTL seconds (defaults to LockManager::DEFAULT_TTL_SECONDS)
+     *   - "resources": array of resource names taken all at once: "routing_lock",
+     *     "graph_lock", "power_lock", "switch:<dpid>", "link:<dpid>-<dpid>", "flow:<prefix>"
+     *   - "type": one global lock, used when "resources" is absent (defaults to
+     *     LockManager::DEFAULT_LOCK_TYPE_STR); such a lease may also be renewed and released
+     *     by "type" as before
+     *   - "ttl" : integer TTL seconds (defaults to LockManager::DEFAULT_TTL_SECONDS, at most
+     *     LOCK_MAX_TTL_SECONDS)
+     *   - "wait_ms": wait up to this long (at most LOCK_MAX_WAIT_MS) for the resources to be
+     *     free instead of failing at once; see startLockWait()
      *
      * Responses:
-     *   - 200 OK:   {"status":"locked","type":"...","ttl":N} if the lock is acquired
-     *   - 423 Locked: {"error":"Lock acquisition failed", ...} if already held or invalid type
+     *   - 200 OK: {"status":"locked","token":N,"resources":[...],"ttl":N} (and "type" when
+     *     requested by type); the token renews and releases the lease
+     *   - 400 Bad Request if "resources" is malformed
+     *   - 423 Locked: {"error":"Lock acquisition failed", ...} if held, or an invalid type
      *   - 500 Internal Server Error on unexpected failures
      *
      * @param[out] res HTTP response returned to the caller (JSON).
@@ -590,44 +1090,65 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
      */
     void handleAcquireLock(http::response<http::string_body>& res);
     /**
-     * @brief Renews (extends) an existing application lock to prevent it from expiring.
-     *
-     * This endpoint extends the TTL of an already-held lock to maintain exclusive access while
-     * a long-running operation is in progress. The caller may specify "type" and "ttl"; missing
-     * or invalid JSON falls back to LockManager defaults.
+     * @brief Renews (extends) a held lease to prevent it from expiring.
      *
      * Request body (optional JSON):
+     *   - "token": the lease to renew; without it the lease taken by "type"
      *   - "type": string lock category/name (defaults to LockManager::DEFAULT_LOCK_TYPE_STR)
      *   - "ttl" : integer TTL seconds (defaults to LockManager::DEFAULT_TTL_SECONDS)
      *
      * Responses:
-     *   - 200 OK: {"status":"renewed","type":"...","ttl":N} if renewal succeeds
-     *   - 412 Precondition Failed if the lock is expired, not held, or the type is invalid
+     *   - 200 OK: {"status":"renewed","token":N,"ttl":N} or {"status":"renewed","type":"...",
+     *     "ttl":N} if renewal succeeds
+     *   - 412 Precondition Failed if the lease is expired, not held, or the type is invalid
      *   - 400 Bad Request for malformed requests (fallback error path)
      *
      * @param[out] res HTTP response returned to the caller (JSON).
      */
     void handleRenewLock(http::response<http::string_body>& res);
     /**
-     * @brief Releases an application lock, allowing other applications to proceed.
-     *
-     * This endpoint unlocks the specified lock type (or the default lock type if not provided).
-     * It is used when the caller finishes a protected operation and wants to relinquish exclusive
-     * access so that other applications can acquire the lock.
+     * @brief Releases a lease, allowing other applications (or their queued acquires) to
+     *        proceed.
      *
      * Request body (optional JSON):
+     *   - "token": the lease to release; without it the lease taken by "type"
      *   - "type": string lock category/name (defaults to LockManager::DEFAULT_LOCK_TYPE_STR)
      *
      * Responses:
-     *   - 200 OK: {"status":"released","type":"..."} on success
+     *   - 200 OK: {"status":"released","token":N} or {"status":"released","type":"..."}
+     *   - 412 Precondition Failed if the token's lease is no longer held
      *   - 500 Internal Server Error if releasing fails unexpectedly
      *
      * @param[out] res HTTP response returned to the caller (JSON).
      */
     void handleReleaseLock(http::response<http::string_body>& res);
 
+    /**
+     * @brief Returns the completion status of a flow batch (GET /ndt/flow_batch_status?id=).
+     *
+     * Responses:
+     *   - 200 OK: FlowBatchTracker::statusJson() of the batch
+     *   - 400 Bad Request if id is missing or not a number
+     *   - 404 Not Found if the batch is unknown or no longer kept
+     *
+     * @param[out] res HTTP response returned to the caller (JSON).
+     */
+    void handleGetFlowBatchStatus(http::response<http::string_body>& res);
+
+    /**
+     * @brief Validates the install/modify/delete arrays of @p j, queues them on the
+     *        FlowDispatcher as one tracked batch and sets @p res.
+     *
+     * Group and meter entries are queued ahead of the flow entries; the dispatcher keeps a
+     * group or meter install before the flows of the same burst and a delete after them.
+     *
+     * Every response carries the batch id for GET /ndt/flow_batch_status. In async mode
+     * ("async": true in @p j, or ?async=1) the response is 202 Accepted and the OpenFlow table
+     * cache is updated after it is written; otherwise 200 once both are done.
+     */
     void processFlowBatch(const json& j, http::response<http::string_body>& res);
 
+    // Work to run on utils::BlockingPool once the response is written
     std::function<void()> after_write_;
 
     void doClose()
@@ -639,10 +1160,23 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
     // --- Member Variables ---
     tcp::socket m_socket;
     beast::flat_buffer m_buffer;
+    std::optional<http::request_parser<http::string_body>> m_parser; // of the next request
+    std::uint64_t m_bodyLimit = NDT_HTTP_BODY_LIMIT;               // of the request in m_parser
+    http::response<http::empty_body> m_continue; // 100 Continue, kept alive while written
     http::request<http::string_body> m_req;
+    QueryParams m_query; // of m_req, set by handleRequest()
+
+    // Latency of the request being served, observed once its response is written
+    utils::Histogram* m_requestLatency = nullptr;
+    std::chrono::steady_clock::time_point m_requestStart;
 
     // The response must be stored in a shared_ptr to keep it alive during async write
     std::shared_ptr<http::response<http::string_body>> m_res;
+    // Body of the last response sent, emptied, handed to the next one on this connection so
+    // bodies written in place (utils::dumpInto, JsonWriter) reuse its capacity
+    std::string m_bodyBuffer;
+    // Backs the ArenaJson DOMs of the handler being run (see runHandler())
+    utils::JsonArena m_arena;
 
     // Core application components (dependencies)
     std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
@@ -657,4 +1191,10 @@ class HttpSession : public std::enable_shared_from_this<HttpSession>
     std::shared_ptr<HistoricalDataManager> m_historicalDataManager;
     std::shared_ptr<Controller> m_controller;
     std::shared_ptr<LockManager> m_lockManager;
+    std::shared_ptr<TelemetryHub> m_telemetryHub;
+    std::shared_ptr<SnapshotExporter> m_snapshotExporter;
+
+    AdmissionControl::ConnectionSlot m_slot;
+    net::ip::address m_clientAddress; // rate limiting key
+    StreamDone m_streamDone;          // set while serving an HTTP/2 stream
 };
\ No newline at end of file
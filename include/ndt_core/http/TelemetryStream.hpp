@@ -0,0 +1,215 @@
+#pragma once
+
+#include "common_types/SFlowType.hpp" // for FlowKey
+#include "ndt_core/http/AdmissionControl.hpp" // for AdmissionControl
+#include "utils/Utils.hpp"            // for DeploymentMode
+#include <atomic>                     // for atomic
+#include <boost/asio/ip/tcp.hpp>      // for tcp
+#include <boost/asio/steady_timer.hpp> // for steady_timer
+#include <chrono>                     // for milliseconds
+#include <condition_variable>         // for condition_variable
+#include <cstdint>                    // for uint64_t
+#include <deque>                      // for deque
+#include <memory>                     // for shared_ptr
+#include <mutex>                      // for mutex
+#include <nlohmann/json.hpp>          // for json
+#include <optional>                   // for optional
+#include <string>                     // for string
+#include <thread>                     // for thread
+#include <utility>                    // for pair
+#include <vector>                     // for vector
+
+class EventBus;
+struct ElephantFlowEventData;
+class TopologyAndFlowMonitor;
+
+namespace sflow
+{
+class FlowLinkUsageCollector;
+}
+
+#define TELEMETRY_HUB_TICK_MS 250                  // how often the hub looks for new changes
+#define TELEMETRY_HUB_HISTORY 64                   // updates kept for subscribers catching up
+#define TELEMETRY_STREAM_DEFAULT_INTERVAL_MS 1000  // push cadence without ?interval_ms=
+#define TELEMETRY_STREAM_MIN_INTERVAL_MS 100       // smaller ?interval_ms= values are raised
+#define TELEMETRY_STREAM_HEARTBEAT_MS 15000        // comment line sent when nothing changed
+
+/**
+ * @brief Link or flow of a TelemetryUpdate, serialised once for every subscriber.
+ */
+struct TelemetryEdgeItem
+{
+    uint64_t srcDpid = 0;
+    uint64_t dstDpid = 0;
+    uint32_t srcInterface = 0;
+    uint32_t dstInterface = 0;
+    std::string json;
+};
+
+struct TelemetryFlowItem
+{
+    sflow::FlowKey key{};
+    std::vector<uint64_t> pathDpids; // switches of the flow's path, in order
+    std::string json;                // the get_detected_flow_data object; key only if removed
+};
+
+/**
+ * @brief What changed between two hub ticks.
+ *
+ * With @c topologyChanged the graph itself changed and @c edges lists every link; with
+ * @c flowsFull the collector could not answer a delta and @c flows lists every flow.
+ */
+struct TelemetryUpdate
+{
+    uint64_t seq = 0;
+    bool topologyChanged = false;
+    bool flowsFull = false;
+    std::vector<TelemetryEdgeItem> edges;
+    std::vector<TelemetryFlowItem> flows;
+    std::vector<TelemetryFlowItem> removedFlows;
+    // Elephant transitions published since the previous tick, oldest first; json has "event"
+    // ("detected" or "ended"), the 5-tuple and "rate_bps"
+    std::vector<TelemetryFlowItem> elephantFlows;
+};
+
+/**
+ * @brief Subscriber side filter of a telemetry stream. Unset members match everything.
+ *
+ * dpid and edge apply to links (an endpoint / the directed link) and to flows (a switch /
+ * a hop of their path); the prefixes only to flows. Addresses are in network order.
+ */
+struct TelemetryFilter
+{
+    std::optional<uint64_t> dpid;
+    std::optional<std::pair<uint64_t, uint64_t>> edge;
+    std::optional<std::pair<uint32_t, uint8_t>> srcPrefix; // (address, prefix length)
+    std::optional<std::pair<uint32_t, uint8_t>> dstPrefix;
+
+    bool matches(const TelemetryEdgeItem& edge) const;
+    bool matches(const TelemetryFlowItem& flow) const;
+};
+
+/**
+ * @brief Turns link counter and flow rate changes into a shared sequence of deltas for the
+ *        telemetry stream (GET /ndt/telemetry_stream).
+ *
+ * Every TELEMETRY_HUB_TICK_MS, while anyone is subscribed, the hub compares the latest graph
+ * snapshot with the previous one (edges whose counters or flow sets changed, as updated by
+ * updateLinkInfo) and asks the collector for the flows changed since the last flow version
+ * (stamped by the once-per-second rate tick). The result is serialised once into a
+ * TelemetryUpdate and kept for TELEMETRY_HUB_HISTORY ticks, so the cost of a tick follows the
+ * number of changes, not the number of subscribers.
+ *
+ * With followElephantFlows(), the ElephantFlowDetected and ElephantFlowEnded events the bus
+ * delivers meanwhile ride along in the next update.
+ */
+class TelemetryHub : public std::enable_shared_from_this<TelemetryHub>
+{
+  public:
+    TelemetryHub(std::shared_ptr<TopologyAndFlowMonitor> topologyAndFlowMonitor,
+                 std::shared_ptr<sflow::FlowLinkUsageCollector> collector,
+                 utils::DeploymentMode mode);
+    ~TelemetryHub();
+
+    void start();
+    void stop();
+
+    /// Subscribe to the elephant flow events of @p bus (once; the hub must be owned by a
+    /// shared_ptr). Events arriving while nobody is subscribed are dropped.
+    void followElephantFlows(EventBus& bus);
+
+    /// Count a subscriber; the hub only works while there is one.
+    void subscribe();
+    void unsubscribe();
+
+    /// Sequence number of the newest update (0 before the first one).
+    uint64_t latestSeq() const;
+
+    /**
+     * @brief Updates after @p seq, oldest first. Sets @p gap when some of them were already
+     *        dropped from the history; the caller then has to resynchronise.
+     */
+    std::vector<std::shared_ptr<const TelemetryUpdate>> updatesSince(uint64_t seq,
+                                                                     bool& gap) const;
+
+    /// {"subscribers", "updates", "last_edges", "last_flows", "tick_ms"}
+    nlohmann::json statsJson() const;
+
+  private:
+    void run();
+    // Builds the update of one tick; nullptr when nothing changed
+    std::shared_ptr<TelemetryUpdate> collect();
+    void resetBaseline();
+    void queueElephantFlows(const ElephantFlowEventData& data, const char* event);
+
+    std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
+    std::shared_ptr<sflow::FlowLinkUsageCollector> m_collector;
+    utils::DeploymentMode m_mode;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
+    std::atomic<uint64_t> m_subscribers{0};
+
+    // Owned by the hub thread: what the previous tick saw
+    bool m_baselined = false;
+    uint64_t m_topologyVersion = 0;
+    uint64_t m_statsEpoch = 0;
+    uint64_t m_flowsEpoch = 0;
+    uint64_t m_flowVersion = 0;
+
+    mutable std::mutex m_historyMutex;
+    std::deque<std::shared_ptr<const TelemetryUpdate>> m_history;
+    uint64_t m_nextSeq = 1;
+
+    std::mutex m_elephantsMutex;
+    std::vector<TelemetryFlowItem> m_elephants; // queued for the next tick
+
+    std::atomic<uint64_t> m_lastEdges{0};
+    std::atomic<uint64_t> m_lastFlows{0};
+};
+
+/**
+ * @brief One Server-Sent Events subscriber of the TelemetryHub.
+ *
+ * Takes over the socket of the HttpSession that received GET /ndt/telemetry_stream, writes the
+ * event-stream header, then every interval merges the hub updates it has not sent yet (the
+ * newest state of each link and flow wins), applies its filter and writes one "telemetry"
+ * event. Its data is {"seq", "topology_changed", "flows_full", "edges", "flows",
+ * "removed_flows", "elephant_flows"}; elephant transitions are all kept, in order. A
+ * subscriber that fell more than TELEMETRY_HUB_HISTORY ticks behind gets a "resync" event
+ * instead and should reload get_graph_data and get_detected_flow_data.
+ *
+ * The response has no length and the connection closes when the stream ends; it ends when a
+ * write fails.
+ */
+class TelemetryStreamSession : public std::enable_shared_from_this<TelemetryStreamSession>
+{
+  public:
+    TelemetryStreamSession(boost::asio::ip::tcp::socket socket,
+                           AdmissionControl::ConnectionSlot slot,
+                           std::shared_ptr<TelemetryHub> hub,
+                           TelemetryFilter filter,
+                           std::chrono::milliseconds interval);
+    ~TelemetryStreamSession();
+
+    void start();
+
+  private:
+    void scheduleTick();
+    void onTick();
+    void write(std::string data);
+    // Appends the "telemetry" event of @p updates to m_out; false when it would be empty
+    bool appendEvent(const std::vector<std::shared_ptr<const TelemetryUpdate>>& updates);
+
+    boost::asio::ip::tcp::socket m_socket;
+    AdmissionControl::ConnectionSlot m_slot; // the stream still counts as a connection
+    boost::asio::steady_timer m_timer;
+    std::shared_ptr<TelemetryHub> m_hub;
+    TelemetryFilter m_filter;
+    std::chrono::milliseconds m_interval;
+    uint64_t m_seq = 0;
+    std::chrono::steady_clock::time_point m_lastWrite;
+    std::string m_out;
+};
@@ -2,6 +2,10 @@
 #include <nlohmann/json.hpp>
 #include <string>
 #include <map>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include "ndt_core/intent_translator/LLMAgent.hpp"
 #include "ndt_core/intent_translator/LLMResponseTypes.hpp"
 #include "ndt_core/power_management/DeviceConfigurationAndPowerManager.hpp"
@@ -13,6 +17,9 @@
 
 using json = nlohmann::json;
 
+#define INTENT_CACHE_TTL_MS 30000     // a read-only intent is answered from the cache this long
+#define INTENT_CACHE_MAX_ENTRIES 256  // the entry expiring first makes room for a new one
+
 class IntentTranslator
 {
     public:
@@ -25,11 +32,41 @@ class IntentTranslator
         );
         std::unique_ptr<llmResponse::LLMResponse> inputTextIntent(std::string inputText, const std::string &sessionId);
         void cleanSession(const std::string &sessionId);
+        // Estimated bytes of both agents (containers prefixed "answer_" and "validation_") and
+        // of the intent cache
+        utils::MemoryUsage memoryUsage();
 
     private:
+        // An answer of the answer agent cached under the normalised text that produced it
+        struct CachedIntent
+        {
+            json answer;
+            std::chrono::steady_clock::time_point expiresAt;
+        };
+
         json performAgentsNegotiation(const std::string &sessionId);
+        static std::string normalizeIntent(const std::string &inputText);
+        std::optional<json> lookupCachedAnswer(const std::string &key);
+        /**
+         * @brief Remember @p answer, before its tasks run, if every task is read-only.
+         *
+         * A hit skips the answer agent but runs the tasks again, so the results are fresh;
+         * only the mapping from text to tasks is reused, for INTENT_CACHE_TTL_MS.
+         */
+        void cacheAnswer(const std::string &key, const llmResponse::Answer &answer);
+        /**
+         * @brief Perform @p tasks and store each result in it.
+         *
+         * Consecutive read-only tasks run concurrently, and so do consecutive mutating tasks
+         * on different devices; those on one device keep their order, and reads never overlap
+         * mutations. The first failure is rethrown once its stage has finished, and the
+         * stages after it are not run.
+         */
+        void performTasks(const std::vector<std::unique_ptr<llmResponse::Task>>& tasks);
         std::string performTask(llmResponse::Task* task);
+        optional<uint32_t> findSwitchIpByName(const std::string &switchName);
         optional<std::string> getSwitchIpByName(const std::string &switchName);
+        optional<uint64_t> getSwitchDpidByName(const std::string &switchName);
 
         std::shared_ptr<DeviceConfigurationAndPowerManager> m_deviceConfigManager;
         std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
@@ -41,4 +78,7 @@ class IntentTranslator
         std::string m_validationAgentPromptFilePath = "../src/ndt_core/intent_translator/validation_agent_prompt.txt";
         
         std::optional<nlohmann::json> getFlowEntriesForSwitch(const std::string& deviceName);
+
+        std::mutex m_intentCacheMutex;
+        std::unordered_map<std::string, CachedIntent> m_intentCache;
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 #include <nlohmann/json.hpp>
-#include <map>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <mutex>
 #include <vector>
 
 #include "utils/Logger.hpp"
@@ -8,9 +11,19 @@
 #include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
 #include "ndt_core/power_management/DeviceConfigurationAndPowerManager.hpp"
 #include "ndt_core/intent_translator/LLMResponseTypes.hpp"
+#include "ndt_core/intent_translator/SessionStore.hpp"
+#include "utils/MemoryAccounting.hpp"
+#include "utils/Metrics.hpp"
 
 using json = nlohmann::json;
 
+#define LLM_AGENT_API_URL "https://api.openai.com/v1/responses"
+#define LLM_AGENT_READ_TIMEOUT_MS 120000       // longest silence while the answer streams
+#define LLM_AGENT_MAX_ATTEMPTS 4               // calls made before giving up on an input
+#define LLM_AGENT_BACKOFF_BASE_MS 500          // ceiling of the first retry delay, doubled after
+#define LLM_AGENT_BACKOFF_MAX_MS 16000         // ceiling of any retry delay
+#define LLM_AGENT_RATE_LIMIT_INTERVAL_MS 20000 // between calls of a rate-limited model
+
 class LLMAgent
 {
     public:
@@ -26,22 +39,67 @@ class LLMAgent
         );
         std::unique_ptr<llmResponse::LLMResponse> callOpenAIApi(const std::string &inputText, const std::string &sessionId);
         std::vector<std::pair<Role, json>> getSessionMsgs(const std::string &sessionId);
+        // Whether @p sessionId has exchanged any message with this agent
+        bool hasSession(const std::string &sessionId);
         void addMsgToSession(const std::string &sessionId, Role role, const json &msg);
         void cleanSession(const std::string &sessionId);
+        // Estimated bytes of the sessions, the system prompt and the rendered context sections
+        utils::MemoryUsage memoryUsage();
 
     private:
+        // What a session was last sent of each context section, by hash of its text (0: never)
+        struct SessionContext
+        {
+            size_t topologyHash = 0;
+            size_t flowEntriesHash = 0;
+        };
+        // A context section rendered for one version of its source
+        struct RenderedContext
+        {
+            uint64_t version = 0;
+            std::string text;
+            bool valid = false;
+        };
+
         std::string shellEscapeSingleQuotes(const std::string &str);
-        std::string getLastMsgId(const std::string &sessionId) const;
+        // One conversation; messages holds the last LLM_SESSION_MAX_MESSAGES of it
+        struct Session
+        {
+            std::deque<std::pair<Role, json>> messages;
+            std::pair<int, int> tokens{0, 0}; // {input tokens, output tokens}
+            SessionContext context;
+            size_t responses = 0;
+            int64_t responseTimeMs = 0; // summed over the responses
+        };
+
+        std::string getLastMsgId(const std::string &sessionId);
         std::string getCurrentTopology();
         std::string getCurrentFlowEntries();
+        // The system prompt file, read again only when its modification time changes
+        std::string getSystemPrompt();
+        // The topology and flow entry sections that differ from what @p sessionId was last
+        // sent, or "" if none does; @p sent receives what the session will have seen once the
+        // call succeeds
+        std::string getContextUpdate(const std::string &sessionId, SessionContext &sent);
+        // For rate-limited models, wait until LLM_AGENT_RATE_LIMIT_INTERVAL_MS after the
+        // previous call started; answers are no longer held back by the interval
+        void waitForRateLimit();
 
         std::string m_systemPromptFilePath;
         std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
         std::shared_ptr<DeviceConfigurationAndPowerManager> m_deviceConfigManager;
         std::string m_model;
         std::string m_apiKey;
-        std::map<std::string, std::vector<std::pair<Role, json>>> m_sessionIdToMsgMap;
-        std::map<std::string, std::pair<int, int>> m_sessionTokensCount; // session id -> {input tokens, output tokens}
-        std::vector<int> m_responseTime;
+        SessionStore<Session> m_sessions;
+        utils::Histogram* m_responseTime = nullptr; // ndt_llm_response_seconds of this agent
         bool m_rateLimit = false;
+        std::mutex m_promptMutex;
+        std::string m_systemPrompt;
+        std::filesystem::file_time_type m_systemPromptModified{};
+        bool m_systemPromptLoaded = false;
+        std::mutex m_contextMutex;
+        RenderedContext m_topologyContext;     // keyed by the graph version
+        RenderedContext m_flowEntriesContext;  // keyed by the OpenFlow tables version
+        std::mutex m_rateLimitMutex;
+        std::chrono::steady_clock::time_point m_nextCallAt{};
 };
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
+#include <array>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 using json = nlohmann::json;
 
@@ -229,213 +233,22 @@ taskTypeToString(TaskType t)
 }
 
 inline TaskType
-taskTypeFromString(std::string s)
+taskTypeFromString(std::string_view s)
 {
-    if (s == "DisableSwitch")
-    {
-        return DISABLE_SWITCH;
-    }
-    if (s == "EnableSwitch")
-    {
-        return ENABLE_SWITCH;
-    }
-    if (s == "PowerOffSwitch")
-    {
-        return POWEROFF_SWITCH;
-    }
-    if (s == "PowerOnSwitch")
-    {
-        return POWERON_SWITCH;
-    }
-    if (s == "InstallFlowEntry")
-    {
-        return INSTALL_FLOW_ENTRY;
-    }
-    if (s == "ModifyFlowEntry")
-    {
-        return MODIFY_FLOW_ENTRY;
-    }
-    if (s == "DeleteFlowEntry")
-    {
-        return DELETE_FLOW_ENTRY;
-    }
-    if (s == "GetTopKFlows")
-    {
-        return GET_TOP_K_FLOWS;
-    }
-    if (s == "GetSwitchCpuUtilization")
-    {
-        return GET_SWITCH_CPU_UTILIZATION;
-    }
-    if (s == "GetTotalPowerConsumption") 
-    {
-        return GET_TOTAL_POWER_CONSUMPTION;
-    }
-    if (s == "GetASwitchCpuUtilization")
-    {
-        return GET_A_SWITCH_CPU_UTILIZATION;
-    }
-    if (s == "GetASwitchPowerConsumption")
-    {
-        return GET_A_SWITCH_POWER_CONSUMPTION;
-    }
-    if (s == "GetALinkBandwidthUtilization")
-    {
-        return GET_A_LINK_BANDWIDTH_UTILIZATION;
-    }
-    if (s == "GetTopKCongestedLinks")
-    {
-        return GET_TOP_K_CONGESTED_LINKS;
-    }
-    if (s == "GetTopKBandwidthUsers")
-    {
-        return GET_TOP_K_BANDWIDTH_USERS;
-    }
-    if (s == "GetPath")
-    {
-        return GET_PATH;
-    }
-    if (s == "GetActiveFlowCount")
-    {
-        return GET_ACTIVE_FLOW_COUNT;
-    }
-    if (s == "GetFlowEntryCount")
-    {
-        return GET_FLOW_ENTRY_COUNT;
-    }
-    if (s == "GetFlowEntries")
-    {
-        return GET_FLOW_ENTRIES;
-    }
-    if (s == "GetNetworkTopology")
-    {
-        return GET_NETWORK_TOPOLOGY;
-    }
-    if (s == "GetAllHosts")
-    {
-        return GET_ALL_HOSTS;
-    }
-    if (s == "BlockHost")
-    {
-        return BLOCK_HOST;
-    }
-    if (s == "GetLinkLatency")
-    {
-        return GET_LINK_LATENCY;
-    }
-    if (s == "GetPacketLossRate")
-    {
-        return GET_PACKET_LOSS_RATE;
-    }
-    if (s == "GetSwitchPorts")
-    {
-        return GET_SWITCH_PORTS;
-    }
-    if (s == "RerouteFlow")
-    {
-        return REROUTE_FLOW;
-    }
-    if (s == "GetSwitchMemoryUtilization")
-    {
-        return GET_SWITCH_MEMORY_UTILIZATION;
-    }
-    if (s == "GetSwitchTemperature")
-    {
-        return GET_SWITCH_TEMPERATURE;
-    }
-    if (s == "SetSwitchPowerState")
-    {
-        return SET_SWITCH_POWER_STATE;
-    }
-    if (s == "GetPathSwitchCount")
-    {
-        return GET_PATH_SWITCH_COUNT;
-    }
-    if (s == "SetDeviceNickname")
-    {
-        return SET_DEVICE_NICKNAME;
-    }
-    if (s == "ToggleHistoricalLogging")
-    {
-        return TOGGLE_HISTORICAL_LOGGING;
-    }
-    if (s == "GetSwitchCapabilities")
-    {
-        return GET_SWITCH_CAPABILITIES;
-    }
-    if (s == "InstallGroupEntry")
-    {
-        return INSTALL_GROUP_ENTRY;
-    }
-    if (s == "InstallMeterEntry")
-    {
-        return INSTALL_METER_ENTRY;
-    }
-
-
-    if (s == "GetDeviceUptime")
-    {
-        return GET_DEVICE_UPTIME;
-    }
-    if (s == "RestartDevice")
-    {
-        return RESTART_DEVICE;
-    }
-    if (s == "BackupConfiguration")
-    {
-        return BACKUP_CONFIGURATION;
-    }
-    if (s == "RestoreConfiguration")
-    {
-        return RESTORE_CONFIGURATION;
-    }
-    if (s == "PingHost")
-    {
-        return PING_HOST;
-    }
-    if (s == "TracerouteHost")
-    {
-        return TRACEROUTE_HOST;
-    }
-    if (s == "GetArpTable")
-    {
-        return GET_ARP_TABLE;
-    }
-    if (s == "GetMacTable")
-    {
-        return GET_MAC_TABLE;
-    }
-    if (s == "SetPortStatus")
-    {
-        return SET_PORT_STATUS;
-    }
-    if (s == "GetPortStatistics")
-    {
-        return GET_PORT_STATISTICS;
-    }
-    if (s == "GetDeviceLogs")
-    {
-        return GET_DEVICE_LOGS;
-    }
-    if (s == "ClearDeviceLogs")
-    {
-        return CLEAR_DEVICE_LOGS;
-    }
-    if (s == "UpdateDeviceFirmware")
-    {
-        return UPDATE_DEVICE_FIRMWARE;
-    }
-    if (s == "GetDeviceHealth")
-    {
-        return GET_DEVICE_HEALTH;
-    }
-    if (s == "MonitorRealTimeTraffic")
+    // Built once from taskTypeToString(), so the two cannot disagree
+    static const std::unordered_map<std::string_view, TaskType> byName = [] {
+        std::unordered_map<std::string_view, TaskType> names;
+        for (int t = DISABLE_SWITCH; t <= REQUEST_UI_FORM; ++t)
+        {
+            names.emplace(taskTypeToString(static_cast<TaskType>(t)), static_cast<TaskType>(t));
+        }
+        return names;
+    }();
+    auto it = byName.find(s);
+    if (it != byName.end())
     {
-        return MONITOR_REAL_TIME_TRAFFIC;
+        return it->second;
     }
-    if (s == "RequestUIForm"){
-        return REQUEST_UI_FORM;
-    } 
 
     // TODO: switch this to error log
     throw std::runtime_error("unknown task type: " + std::string{s});
@@ -1966,173 +1779,93 @@ from_json(const nlohmann::json& j, RequestUIFormTask& task)
 
 // ====================== serilalizer and deserializer for Task ======================
 
-inline void
-to_json(nlohmann::json& j, const std::unique_ptr<Task>& p)
+// Every task type with its class, in TaskType order
+#define LLM_TASK_LIST(X) \
+    X(DISABLE_SWITCH, DisableSwitchTask)                                  \
+    X(ENABLE_SWITCH, EnableSwitchTask)                                    \
+    X(POWEROFF_SWITCH, PowerOffSwitchTask)                                \
+    X(POWERON_SWITCH, PowerOnSwitchTask)                                  \
+    X(INSTALL_FLOW_ENTRY, InstallFlowEntryTask)                           \
+    X(MODIFY_FLOW_ENTRY, ModifyFlowEntryTask)                             \
+    X(DELETE_FLOW_ENTRY, DeleteFlowEntryTask)                             \
+    X(GET_TOP_K_FLOWS, GetTopKFlowsTask)                                  \
+    X(GET_SWITCH_CPU_UTILIZATION, GetSwitchCpuUtilizationTask)            \
+    X(GET_TOTAL_POWER_CONSUMPTION, GetTotalPowerConsumptionTask)          \
+    X(GET_A_SWITCH_CPU_UTILIZATION, GetASwitchCpuUtilizationTask)         \
+    X(GET_A_SWITCH_POWER_CONSUMPTION, GetASwitchPowerConsumptionTask)     \
+    X(GET_A_LINK_BANDWIDTH_UTILIZATION, GetALinkBandwidthUtilizationTask) \
+    X(GET_TOP_K_CONGESTED_LINKS, GetTopKCongestedLinksTask)               \
+    X(GET_TOP_K_BANDWIDTH_USERS, GetTopKBandwidthUsersTask)               \
+    X(GET_PATH, GetPathTask)                                              \
+    X(GET_ACTIVE_FLOW_COUNT, GetActiveFlowCountTask)                      \
+    X(GET_FLOW_ENTRY_COUNT, GetFlowEntryCountTask)                        \
+    X(GET_FLOW_ENTRIES, GetFlowEntriesTask)                               \
+    X(GET_NETWORK_TOPOLOGY, GetNetworkTopologyTask)                       \
+    X(GET_ALL_HOSTS, GetAllHostsTask)                                     \
+    X(BLOCK_HOST, BlockHostTask)                                          \
+    X(GET_LINK_LATENCY, GetLinkLatencyTask)                               \
+    X(GET_PACKET_LOSS_RATE, GetPacketLossRateTask)                        \
+    X(GET_SWITCH_PORTS, GetSwitchPortsTask)                               \
+    X(REROUTE_FLOW, RerouteFlowTask)                                      \
+    X(GET_SWITCH_MEMORY_UTILIZATION, GetSwitchMemoryUtilizationTask)      \
+    X(GET_SWITCH_TEMPERATURE, GetSwitchTemperatureTask)                   \
+    X(SET_SWITCH_POWER_STATE, SetSwitchPowerStateTask)                    \
+    X(GET_PATH_SWITCH_COUNT, GetPathSwitchCountTask)                      \
+    X(SET_DEVICE_NICKNAME, SetDeviceNicknameTask)                         \
+    X(TOGGLE_HISTORICAL_LOGGING, ToggleHistoricalLoggingTask)             \
+    X(GET_SWITCH_CAPABILITIES, GetSwitchCapabilitiesTask)                 \
+    X(INSTALL_GROUP_ENTRY, InstallGroupEntryTask)                         \
+    X(INSTALL_METER_ENTRY, InstallMeterEntryTask)                         \
+    X(GET_DEVICE_UPTIME, GetDeviceUptimeTask)                             \
+    X(RESTART_DEVICE, RestartDeviceTask)                                  \
+    X(BACKUP_CONFIGURATION, BackupConfigurationTask)                      \
+    X(RESTORE_CONFIGURATION, RestoreConfigurationTask)                    \
+    X(PING_HOST, PingHostTask)                                            \
+    X(TRACEROUTE_HOST, TracerouteHostTask)                                \
+    X(GET_ARP_TABLE, GetArpTableTask)                                     \
+    X(GET_MAC_TABLE, GetMacTableTask)                                     \
+    X(SET_PORT_STATUS, SetPortStatusTask)                                 \
+    X(GET_PORT_STATISTICS, GetPortStatisticsTask)                         \
+    X(GET_DEVICE_LOGS, GetDeviceLogsTask)                                 \
+    X(CLEAR_DEVICE_LOGS, ClearDeviceLogsTask)                             \
+    X(UPDATE_DEVICE_FIRMWARE, UpdateDeviceFirmwareTask)                   \
+    X(GET_DEVICE_HEALTH, GetDeviceHealthTask)                             \
+    X(MONITOR_REAL_TIME_TRAFFIC, MonitorRealTimeTrafficTask)              \
+    X(REQUEST_UI_FORM, RequestUIFormTask)
+
+inline constexpr size_t TASK_TYPE_COUNT = REQUEST_UI_FORM + 1;
+
+/// The Task subclass of each TaskType.
+template <TaskType T>
+struct TaskClass;
+
+#define LLM_TASK_CLASS(type, cls)                                                                  \
+    template <>                                                                                    \
+    struct TaskClass<type>                                                                         \
+    {                                                                                              \
+        using Type = cls;                                                                          \
+    };
+LLM_TASK_LIST(LLM_TASK_CLASS)
+#undef LLM_TASK_CLASS
+
+/**
+ * @brief @p task as the class of its type, without RTTI.
+ *
+ * Tasks are only built by from_json(), which gives each the class of its type, so the tag
+ * decides the class and a static_cast is enough.
+ */
+template <TaskType T>
+inline typename TaskClass<T>::Type&
+taskAs(Task& task)
 {
-    if (!p)
-    {
-        j = nullptr;
-        return;
-    }
-    switch (p->type)
-    {
-    case DISABLE_SWITCH:
-        j = static_cast<const DisableSwitchTask&>(*p);
-        break;
-    case ENABLE_SWITCH:
-        j = static_cast<const EnableSwitchTask&>(*p);
-        break;
-    case POWEROFF_SWITCH:
-        j = static_cast<const PowerOffSwitchTask&>(*p);
-        break;
-    case POWERON_SWITCH:
-        j = static_cast<const PowerOnSwitchTask&>(*p);
-        break;
-    case INSTALL_FLOW_ENTRY:
-        j = static_cast<const InstallFlowEntryTask&>(*p);
-        break;
-    case MODIFY_FLOW_ENTRY:
-        j = static_cast<const ModifyFlowEntryTask&>(*p);
-        break;
-    case DELETE_FLOW_ENTRY:
-        j = static_cast<const DeleteFlowEntryTask&>(*p);
-        break;
-    case GET_TOP_K_FLOWS:
-        j = static_cast<const GetTopKFlowsTask&>(*p);
-        break;
-    case GET_SWITCH_CPU_UTILIZATION:
-        j = static_cast<const GetSwitchCpuUtilizationTask&>(*p);
-        break;
-    case GET_TOTAL_POWER_CONSUMPTION: 
-        j = static_cast<const GetTotalPowerConsumptionTask&>(*p);
-        break;
-    case GET_A_SWITCH_CPU_UTILIZATION:
-        j = static_cast<const GetASwitchCpuUtilizationTask&>(*p);
-        break;
-    case GET_A_SWITCH_POWER_CONSUMPTION:
-        j = static_cast<const GetASwitchPowerConsumptionTask&>(*p);
-        break;
-    case GET_A_LINK_BANDWIDTH_UTILIZATION:
-        j = static_cast<const GetALinkBandwidthUtilizationTask&>(*p);
-        break;
-    case GET_TOP_K_CONGESTED_LINKS:
-        j = static_cast<const GetTopKCongestedLinksTask&>(*p);
-        break;
-    case GET_TOP_K_BANDWIDTH_USERS:
-        j = static_cast<const GetTopKBandwidthUsersTask&>(*p);
-        break;
-    case GET_PATH:
-        j = static_cast<const GetPathTask&>(*p);
-        break;
-    case GET_ACTIVE_FLOW_COUNT:
-        j = static_cast<const GetActiveFlowCountTask&>(*p);
-        break;
-    case GET_FLOW_ENTRY_COUNT:
-        j = static_cast<const GetFlowEntryCountTask&>(*p);
-        break;
-    case GET_FLOW_ENTRIES:
-        j = static_cast<const GetFlowEntriesTask&>(*p);
-        break;
-        
-    case GET_NETWORK_TOPOLOGY:
-        j = static_cast<const GetNetworkTopologyTask&>(*p);
-        break;
-    case GET_ALL_HOSTS:
-        j = static_cast<const GetAllHostsTask&>(*p);
-        break;
-    case BLOCK_HOST:
-        j = static_cast<const BlockHostTask&>(*p);
-        break;
-    case GET_LINK_LATENCY:
-        j = static_cast<const GetLinkLatencyTask&>(*p);
-        break;
-    case GET_PACKET_LOSS_RATE:
-        j = static_cast<const GetPacketLossRateTask&>(*p);
-        break;
-    case GET_SWITCH_PORTS:
-        j = static_cast<const GetSwitchPortsTask&>(*p);
-        break;
-    case REROUTE_FLOW:
-        j = static_cast<const RerouteFlowTask&>(*p);
-        break;
-    case GET_SWITCH_MEMORY_UTILIZATION:
-        j = static_cast<const GetSwitchMemoryUtilizationTask&>(*p);
-        break;
-    case GET_SWITCH_TEMPERATURE:
-        j = static_cast<const GetSwitchTemperatureTask&>(*p);
-        break;
-    case SET_SWITCH_POWER_STATE:
-        j = static_cast<const SetSwitchPowerStateTask&>(*p);
-        break;
-    case GET_PATH_SWITCH_COUNT:
-        j = static_cast<const GetPathSwitchCountTask&>(*p);
-        break;
-    case SET_DEVICE_NICKNAME:
-        j = static_cast<const SetDeviceNicknameTask&>(*p);
-        break;
-    case TOGGLE_HISTORICAL_LOGGING:
-        j = static_cast<const ToggleHistoricalLoggingTask&>(*p);
-        break;
-    case GET_SWITCH_CAPABILITIES:
-        j = static_cast<const GetSwitchCapabilitiesTask&>(*p);
-        break;
-    case INSTALL_GROUP_ENTRY:
-        j = static_cast<const InstallGroupEntryTask&>(*p);
-        break;
-    case INSTALL_METER_ENTRY:
-        j = static_cast<const InstallMeterEntryTask&>(*p);
-        break;
-    
-        
-    case GET_DEVICE_UPTIME:
-        j = static_cast<const GetDeviceUptimeTask&>(*p);
-        break;
-    case RESTART_DEVICE:
-        j = static_cast<const RestartDeviceTask&>(*p);
-        break;
-    case BACKUP_CONFIGURATION:
-        j = static_cast<const BackupConfigurationTask&>(*p);
-        break;
-    case RESTORE_CONFIGURATION:
-        j = static_cast<const RestoreConfigurationTask&>(*p);
-        break;
-    case PING_HOST:
-        j = static_cast<const PingHostTask&>(*p);
-        break;
-    case TRACEROUTE_HOST:
-        j = static_cast<const TracerouteHostTask&>(*p);
-        break;
-    case GET_ARP_TABLE:
-        j = static_cast<const GetArpTableTask&>(*p);
-        break;
-    case GET_MAC_TABLE:
-        j = static_cast<const GetMacTableTask&>(*p);
-        break;
-    case SET_PORT_STATUS:
-        j = static_cast<const SetPortStatusTask&>(*p);
-        break;
-    case GET_PORT_STATISTICS:
-        j = static_cast<const GetPortStatisticsTask&>(*p);
-        break;
-    case GET_DEVICE_LOGS:
-        j = static_cast<const GetDeviceLogsTask&>(*p);
-        break;
-    case CLEAR_DEVICE_LOGS:
-        j = static_cast<const ClearDeviceLogsTask&>(*p);
-        break;
-    case UPDATE_DEVICE_FIRMWARE:
-        j = static_cast<const UpdateDeviceFirmwareTask&>(*p);
-        break;
-    case GET_DEVICE_HEALTH:
-        j = static_cast<const GetDeviceHealthTask&>(*p);
-        break;
-    case MONITOR_REAL_TIME_TRAFFIC:
-        j = static_cast<const MonitorRealTimeTrafficTask&>(*p);
-        break;
-    case REQUEST_UI_FORM:
-        j = static_cast<const RequestUIFormTask&>(*p);
-        break;
-    }
+    return static_cast<typename TaskClass<T>::Type&>(task);
+}
+
+template <TaskType T>
+inline const typename TaskClass<T>::Type&
+taskAs(const Task& task)
+{
+    return static_cast<const typename TaskClass<T>::Type&>(task);
 }
 
 template <class T>
@@ -2144,172 +1877,60 @@ make_from_json(const json& j)
     return ptr;
 }
 
-inline void
-from_json(const json& j, std::unique_ptr<Task>& p)
+template <class T>
+void
+task_json_of(json& j, const Task& t)
 {
-    switch (taskTypeFromString(j.at("type").get<std::string>()))
-    {
-    case DISABLE_SWITCH:
-        p = make_from_json<DisableSwitchTask>(j);
-        break;
-    case ENABLE_SWITCH:
-        p = make_from_json<EnableSwitchTask>(j);
-        break;
-    case POWEROFF_SWITCH:
-        p = make_from_json<PowerOffSwitchTask>(j);
-        break;
-    case POWERON_SWITCH:
-        p = make_from_json<PowerOnSwitchTask>(j);
-        break;
-    case INSTALL_FLOW_ENTRY:
-        p = make_from_json<InstallFlowEntryTask>(j);
-        break;
-    case MODIFY_FLOW_ENTRY:
-        p = make_from_json<ModifyFlowEntryTask>(j);
-        break;
-    case DELETE_FLOW_ENTRY:
-        p = make_from_json<DeleteFlowEntryTask>(j);
-        break;
-    case GET_TOP_K_FLOWS:
-        p = make_from_json<GetTopKFlowsTask>(j);
-        break;
-    case GET_SWITCH_CPU_UTILIZATION:
-        p = make_from_json<GetSwitchCpuUtilizationTask>(j);
-        break;
-    case GET_TOTAL_POWER_CONSUMPTION:
-        p = make_from_json<GetTotalPowerConsumptionTask>(j);
-        break;
-    case GET_A_SWITCH_CPU_UTILIZATION:
-        p = make_from_json<GetASwitchCpuUtilizationTask>(j);
-        break;
-    case GET_A_SWITCH_POWER_CONSUMPTION:
-        p = make_from_json<GetASwitchPowerConsumptionTask>(j);
-        break;
-    case GET_A_LINK_BANDWIDTH_UTILIZATION:
-        p = make_from_json<GetALinkBandwidthUtilizationTask>(j);
-        break;
-    case GET_TOP_K_CONGESTED_LINKS:
-        p = make_from_json<GetTopKCongestedLinksTask>(j);
-        break;
-    case GET_TOP_K_BANDWIDTH_USERS:
-        p = make_from_json<GetTopKBandwidthUsersTask>(j);
-        break;
-    case GET_PATH:
-        p = make_from_json<GetPathTask>(j);
-        break;
-    case GET_ACTIVE_FLOW_COUNT:
-        p = make_from_json<GetActiveFlowCountTask>(j);
-        break;
-    case GET_FLOW_ENTRY_COUNT:
-        p = make_from_json<GetFlowEntryCountTask>(j);
-        break;
-    case GET_FLOW_ENTRIES:
-        p = make_from_json<GetFlowEntriesTask>(j);
-        break;
+    j = static_cast<const T&>(t);
+}
 
+/// How a task type is read from and written to JSON; TASK_CODECS[type] holds its entry.
+struct TaskCodec
+{
+    TaskType type;
+    std::unique_ptr<Task> (*parse)(const json&);
+    void (*write)(json&, const Task&);
+};
 
-    case GET_NETWORK_TOPOLOGY:
-        p = make_from_json<GetNetworkTopologyTask>(j);
-        break;
-    case GET_ALL_HOSTS:
-        p = make_from_json<GetAllHostsTask>(j);
-        break;
-    case BLOCK_HOST:
-        p = make_from_json<BlockHostTask>(j);
-        break;
-    case GET_LINK_LATENCY:
-        p = make_from_json<GetLinkLatencyTask>(j);
-        break;
-    case GET_PACKET_LOSS_RATE:
-        p = make_from_json<GetPacketLossRateTask>(j);
-        break;
-    case GET_SWITCH_PORTS:
-        p = make_from_json<GetSwitchPortsTask>(j);
-        break;
-    case REROUTE_FLOW:
-        p = make_from_json<RerouteFlowTask>(j);
-        break;
-    case GET_SWITCH_MEMORY_UTILIZATION:
-        p = make_from_json<GetSwitchMemoryUtilizationTask>(j);
-        break;
-    case GET_SWITCH_TEMPERATURE:
-        p = make_from_json<GetSwitchTemperatureTask>(j);
-        break;
-    case SET_SWITCH_POWER_STATE:
-        p = make_from_json<SetSwitchPowerStateTask>(j);
-        break;
-    case GET_PATH_SWITCH_COUNT:
-        p = make_from_json<GetPathSwitchCountTask>(j);
-        break;
-    case SET_DEVICE_NICKNAME:
-        p = make_from_json<SetDeviceNicknameTask>(j);
-        break;
-    case TOGGLE_HISTORICAL_LOGGING:
-        p = make_from_json<ToggleHistoricalLoggingTask>(j);
-        break;
-    case GET_SWITCH_CAPABILITIES:
-        p = make_from_json<GetSwitchCapabilitiesTask>(j);
-        break;
-    case INSTALL_GROUP_ENTRY:
-        p = make_from_json<InstallGroupEntryTask>(j);
-        break;
-    case INSTALL_METER_ENTRY:    
-        p = make_from_json<InstallMeterEntryTask>(j);
-        break;
+inline constexpr std::array<TaskCodec, TASK_TYPE_COUNT> TASK_CODECS = {{
+#define LLM_TASK_CODEC(type, cls) {type, &make_from_json<cls>, &task_json_of<cls>},
+    LLM_TASK_LIST(LLM_TASK_CODEC)
+#undef LLM_TASK_CODEC
+}};
 
+constexpr bool
+taskCodecsInOrder()
+{
+    for (size_t i = 0; i < TASK_CODECS.size(); ++i)
+    {
+        if (TASK_CODECS[i].type != static_cast<TaskType>(i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(taskCodecsInOrder(), "LLM_TASK_LIST must follow the TaskType order");
 
-        
-    case GET_DEVICE_UPTIME:
-        p = make_from_json<GetDeviceUptimeTask>(j);
-        break;
-    case RESTART_DEVICE:
-        p = make_from_json<RestartDeviceTask>(j);
-        break;
-    case BACKUP_CONFIGURATION:
-        p = make_from_json<BackupConfigurationTask>(j);
-        break;
-    case RESTORE_CONFIGURATION:
-        p = make_from_json<RestoreConfigurationTask>(j);
-        break;
-    case PING_HOST:
-        p = make_from_json<PingHostTask>(j);
-        break;
-    case TRACEROUTE_HOST:
-        p = make_from_json<TracerouteHostTask>(j);
-        break;
-    case GET_ARP_TABLE:
-        p = make_from_json<GetArpTableTask>(j);
-        break;
-    case GET_MAC_TABLE:
-        p = make_from_json<GetMacTableTask>(j);
-        break;
-    case SET_PORT_STATUS:
-        p = make_from_json<SetPortStatusTask>(j);
-        break;
-    case GET_PORT_STATISTICS:
-        p = make_from_json<GetPortStatisticsTask>(j);
-        break;
-    case GET_DEVICE_LOGS:
-        p = make_from_json<GetDeviceLogsTask>(j);
-        break;
-    case CLEAR_DEVICE_LOGS:
-        p = make_from_json<ClearDeviceLogsTask>(j);
-        break;
-    case UPDATE_DEVICE_FIRMWARE:
-        p = make_from_json<UpdateDeviceFirmwareTask>(j);
-        break;
-    case GET_DEVICE_HEALTH:
-        p = make_from_json<GetDeviceHealthTask>(j);
-        break;
-    case MONITOR_REAL_TIME_TRAFFIC:
-        p = make_from_json<MonitorRealTimeTrafficTask>(j);
-        break;
-    case REQUEST_UI_FORM:
-        p = make_from_json<RequestUIFormTask>(j);
-        break;
-    default:
+inline void
+to_json(nlohmann::json& j, const std::unique_ptr<Task>& p)
+{
+    if (!p)
+    {
+        j = nullptr;
+        return;
+    }
+    if (static_cast<size_t>(p->type) >= TASK_TYPE_COUNT)
+    {
         throw std::runtime_error("unknown Task type");
     }
+    TASK_CODECS[p->type].write(j, *p);
+}
+
+inline void
+from_json(const json& j, std::unique_ptr<Task>& p)
+{
+    p = TASK_CODECS[taskTypeFromString(j.at("type").get<std::string>())].parse(j);
 }
 
 // ================================ ANSWER ========================================
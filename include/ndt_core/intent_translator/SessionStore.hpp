@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>         // for array
+#include <chrono>        // for steady_clock, milliseconds
+#include <cstddef>       // for size_t
+#include <functional>    // for hash
+#include <list>          // for list
+#include <mutex>         // for mutex, lock_guard
+#include <optional>      // for optional
+#include <string>        // for string
+#include <unordered_map> // for unordered_map
+#include <utility>       // for move
+
+#include "utils/MemoryAccounting.hpp" // for heapBytes
+
+#define LLM_SESSION_SHARDS 8                  // independently locked parts of a store
+#define LLM_SESSION_MAX_SESSIONS 1024         // least recently used beyond it are dropped
+#define LLM_SESSION_TTL_MS (30LL * 60 * 1000) // sessions unused this long are dropped
+#define LLM_SESSION_MAX_MESSAGES 64           // older messages of a session are dropped
+
+/**
+ * @brief Conversations of an LLMAgent by session id, bounded in count and age.
+ *
+ * Sessions are spread over LLM_SESSION_SHARDS shards by hash of their id, each with its own
+ * lock, so intents of different sessions rarely wait for each other. A shard keeps its
+ * sessions in least-recently-used order; any access moves a session to the front, and each
+ * access also drops, from the back, sessions idle for LLM_SESSION_TTL_MS and those beyond
+ * the shard's share of LLM_SESSION_MAX_SESSIONS. A client that never calls cleanSession()
+ * therefore leaves nothing behind for longer than the TTL.
+ *
+ * The callbacks run with the shard locked: they should only touch the session.
+ */
+template <typename Session>
+class SessionStore
+{
+  public:
+    /// Call @p fn with the session of @p id, created empty if missing, and return its result.
+    template <typename F>
+    decltype(auto) update(const std::string& id, F&& fn)
+    {
+        Shard& shard = shardOf(id);
+        std::lock_guard lock(shard.mutex);
+        const auto now = std::chrono::steady_clock::now();
+        auto it = shard.sessions.find(id);
+        if (it == shard.sessions.end())
+        {
+            shard.lru.push_front(id);
+            it = shard.sessions.emplace(id, Entry{Session{}, now, shard.lru.begin()}).first;
+        }
+        touch(shard, it->second, now);
+        evict(shard, now);
+        return fn(it->second.session);
+    }
+
+    /// Call @p fn with the session of @p id if there is one; returns whether there was.
+    template <typename F>
+    bool read(const std::string& id, F&& fn)
+    {
+        Shard& shard = shardOf(id);
+        std::lock_guard lock(shard.mutex);
+        const auto now = std::chrono::steady_clock::now();
+        evict(shard, now);
+        auto it = shard.sessions.find(id);
+        if (it == shard.sessions.end())
+        {
+            return false;
+        }
+        touch(shard, it->second, now);
+        fn(static_cast<const Session&>(it->second.session));
+        return true;
+    }
+
+    bool contains(const std::string& id)
+    {
+        return read(id, [](const Session&) {});
+    }
+
+    /// Remove the session of @p id and return it.
+    std::optional<Session> take(const std::string& id)
+    {
+        Shard& shard = shardOf(id);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.sessions.find(id);
+        if (it == shard.sessions.end())
+        {
+            return std::nullopt;
+        }
+        std::optional<Session> session(std::move(it->second.session));
+        shard.lru.erase(it->second.lru);
+        shard.sessions.erase(it);
+        return session;
+    }
+
+    size_t size() const
+    {
+        size_t count = 0;
+        for (const Shard& shard : m_shards)
+        {
+            std::lock_guard lock(shard.mutex);
+            count += shard.sessions.size();
+        }
+        return count;
+    }
+
+    /**
+     * @brief Estimated bytes of the sessions, their ids and the LRU lists, plus what
+     *        @p sessionBytes (size_t(const Session&)) says each session owns.
+     */
+    template <typename F>
+    size_t memoryBytes(F&& sessionBytes) const
+    {
+        size_t bytes = 0;
+        for (const Shard& shard : m_shards)
+        {
+            std::lock_guard lock(shard.mutex);
+            bytes += utils::heapBytes(shard.sessions) + utils::heapBytes(shard.lru);
+            for (const auto& [id, entry] : shard.sessions)
+            {
+                // Once as the key and once in the LRU list
+                bytes += 2 * utils::heapBytes(id) + sessionBytes(entry.session);
+            }
+        }
+        return bytes;
+    }
+
+  private:
+    struct Entry
+    {
+        Session session;
+        std::chrono::steady_clock::time_point lastUsed;
+        std::list<std::string>::iterator lru;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Entry> sessions;
+        std::list<std::string> lru; // ids, most recently used first
+    };
+
+    static constexpr size_t SHARD_CAPACITY =
+        (LLM_SESSION_MAX_SESSIONS + LLM_SESSION_SHARDS - 1) / LLM_SESSION_SHARDS;
+
+    Shard& shardOf(const std::string& id)
+    {
+        return m_shards[std::hash<std::string>{}(id) % LLM_SESSION_SHARDS];
+    }
+
+    static void touch(Shard& shard, Entry& entry, std::chrono::steady_clock::time_point now)
+    {
+        entry.lastUsed = now;
+        shard.lru.splice(shard.lru.begin(), shard.lru, entry.lru);
+    }
+
+    static void evict(Shard& shard, std::chrono::steady_clock::time_point now)
+    {
+        const auto oldest = now - std::chrono::milliseconds(LLM_SESSION_TTL_MS);
+        while (!shard.lru.empty())
+        {
+            auto it = shard.sessions.find(shard.lru.back());
+            if (shard.sessions.size() <= SHARD_CAPACITY && it->second.lastUsed >= oldest)
+            {
+                return;
+            }
+            shard.sessions.erase(it);
+            shard.lru.pop_back();
+        }
+    }
+
+    std::array<Shard, LLM_SESSION_SHARDS> m_shards;
+};
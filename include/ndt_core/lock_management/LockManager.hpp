@@ -1,121 +1,173 @@
 #pragma once
-#include <chrono>
-#include <mutex>
-#include <string>
-#include <unordered_map>
-#include "utils/Logger.hpp"
-
-// Define available lock types using an Enum Class for type safety
-enum class LockType {
-    Routing,
-    Graph,
-    Power,
-    Unknown // Used to indicate an invalid string input
-};
-
-// Structure to hold the state of a single lock
-struct LockState {
-    bool isLocked = false;
-    std::chrono::steady_clock::time_point expiryTime;
-};
 
+#include "utils/Metrics.hpp"       // for Histogram, Counter
+#include "utils/TaskScheduler.hpp" // for TaskScheduler
+#include <chrono>                  // for steady_clock
+#include <cstddef>                 // for size_t
+#include <cstdint>                 // for uint64_t
+#include <functional>              // for function
+#include <list>                    // for list
+#include <mutex>                   // for mutex
+#include <nlohmann/json.hpp>       // for json
+#include <optional>                // for optional
+#include <string>                  // for string
+#include <unordered_map>           // for unordered_map
+#include <vector>                  // for vector
+
+#define LOCK_MAX_TTL_SECONDS 300   // longer lease TTLs are capped to it
+#define LOCK_MAX_WAIT_MS 30000     // longest an acquire may wait in the queue
+#define LOCK_MAX_RESOURCES 256     // resources one lease may hold
+#define LOCK_MAX_WAITERS 1024      // queued acquires beyond it fail at once
+#define LOCK_EXPIRY_CHECK_MS 1000  // waiters are re-checked at least this often
+
+/**
+ * @brief Leases on named resources that NDT applications use to coordinate their changes.
+ *
+ * Resources are the three global locks "routing_lock", "graph_lock" and "power_lock", and
+ * fine-grained ones in the routing domain: "switch:<dpid>", "link:<dpid>-<dpid>" (either
+ * order) and "flow:<prefix>". A lease on routing_lock conflicts with every routing-domain
+ * resource and the other way round, so applications still using it exclude all fine-grained
+ * holders; otherwise two resources conflict only if they are the same.
+ *
+ * A lease takes all of its resources at once or none of them, so holders never wait while
+ * holding a part of what they need and no deadlock between leases is possible. It is
+ * identified by a fencing token, increasing over the life of the process: only the token
+ * renews or releases it, and a device or application that remembers the highest token it
+ * has seen can reject writes from a holder whose lease expired meanwhile. Leases expire
+ * after their TTL unless renewed.
+ *
+ * An acquire that cannot be granted may wait: waiters are granted in arrival order, and a
+ * new acquire does not overtake a waiter that needs one of its resources, so a lease on
+ * many resources is not starved by a stream of small ones.
+ *
+ * The name-based calls keep the old single-lock API: their leases (on one global lock) may
+ * be renewed and released by anyone naming the lock, as before.
+ */
 class LockManager
 {
   public:
-    // --- Constants for Default Values (Single Source of Truth) ---
     static constexpr int DEFAULT_TTL_SECONDS = 5;
     static constexpr const char* DEFAULT_LOCK_TYPE_STR = "routing_lock";
 
-  private:
-    std::mutex m_mutex; 
-    // Using Enum as the key for the map is more efficient than using strings
-    std::unordered_map<LockType, LockState> m_locks;
+    using Token = uint64_t;
+    using WaitId = uint64_t;
+    /// Receives the lease token, or nullopt if the wait was given up (see cancelWait())
+    using Granted = std::function<void(std::optional<Token>)>;
 
-    /**
-     * @brief Helper function to convert string input to LockType enum.
-     * This enforces the naming convention (routing_lock, graph_lock, power_lock).
-     */
-    LockType stringToLockType(const std::string& str) {
-        if (str == "routing_lock") return LockType::Routing;
-        if (str == "graph_lock")   return LockType::Graph;
-        if (str == "power_lock")   return LockType::Power;
-        return LockType::Unknown;
-    }
+    LockManager();
+    LockManager(const LockManager&) = delete;
+    LockManager& operator=(const LockManager&) = delete;
+    ~LockManager();
+
+    /// Canonical name of resource @p name ("link:7-3" is "link:3-7"), or nullopt if invalid.
+    static std::optional<std::string> normalizeResource(const std::string& name);
+
+    /// Whether @p typeStr names one of the global locks.
+    bool isValidType(const std::string& typeStr) const;
 
-  public:
     /**
-     * @brief Check if the provided lock type string is valid.
+     * @brief Lease the canonical resources @p resources for @p ttlSeconds if none is held or
+     *        wanted by a waiter; nullopt otherwise. A legacy lease is also reachable by name.
      */
-    bool isValidType(const std::string& typeStr) {
-        return stringToLockType(typeStr) != LockType::Unknown;
-    }
+    std::optional<Token> tryAcquire(std::vector<std::string> resources,
+                                    int ttlSeconds,
+                                    bool legacy = false);
 
     /**
-     * @brief Attempt to acquire a lock.
-     * @param lockNameStr The string name of the lock (e.g., "routing_lock").
-     * @param ttlSeconds Time-To-Live in seconds.
-     * @return true if acquired successfully, false if busy or invalid name.
+     * @brief Lease @p resources as tryAcquire() does or, if @p wait, queue until they are free.
+     *
+     * @p done is called exactly once: with the token, possibly before this returns, or with
+     * nullopt when not waiting or the queue is full. It runs without the manager's lock
+     * held, on the thread releasing the resources or the scheduler thread expiring a lease.
+     *
+     * @return 0 if @p done has been called, else the id for cancelWait().
      */
-    bool acquireLock(const std::string& lockNameStr, int ttlSeconds)
-    {
-        // 1. Convert string to Enum
-        LockType type = stringToLockType(lockNameStr);
-
-        // 2. Validation: Reject unknown lock types
-        if (type == LockType::Unknown) {
-            SPDLOG_LOGGER_WARN(Logger::instance(), "Invalid lock type requested: {}", lockNameStr);
-            return false; 
-        }
-
-        std::lock_guard<std::mutex> lock(m_mutex);
-        
-        // 3. Access lock state using the Enum key
-        LockState& state = m_locks[type];
-        auto now = std::chrono::steady_clock::now();
-
-        // 4. Check if it is currently locked and has not expired
-        if (state.isLocked && now < state.expiryTime)
-        {
-            return false; // Lock is held by someone else
-        }
-
-        // 5. Acquire the lock
-        state.isLocked = true;
-        state.expiryTime = now + std::chrono::seconds(ttlSeconds);
-        return true;
-    }
+    WaitId acquireAsync(std::vector<std::string> resources,
+                        int ttlSeconds,
+                        Granted done,
+                        bool legacy = false,
+                        bool wait = true);
 
     /**
-     * @brief Release a lock.
+     * @brief Give up waiting; true if @p id was still queued, in which case its callback is
+     *        dropped uncalled. False means the lease was granted (or is being).
      */
-    void unlock(const std::string& lockNameStr)
-    {
-        LockType type = stringToLockType(lockNameStr);
-        if (type == LockType::Unknown) return;
+    bool cancelWait(WaitId id);
 
-        std::lock_guard<std::mutex> lock(m_mutex);
-        if (m_locks.find(type) != m_locks.end()) {
-            m_locks[type].isLocked = false;
-        }
-    }
+    /// Extend lease @p token to expire @p ttlSeconds from now; false if it is not held.
+    bool renew(Token token, int ttlSeconds);
+
+    /// End lease @p token; false if it is not held (expired or already released).
+    bool release(Token token);
+
+    // Single global lock by name, without a token
+    bool acquireLock(const std::string& lockNameStr, int ttlSeconds);
+    bool renew(const std::string& lockNameStr, int ttlSeconds);
+    void unlock(const std::string& lockNameStr);
+
+    /// {"leases": [{"token", "resources", "expires_in_ms"}], "waiters", "next_token"}
+    nlohmann::json statusJson();
+
+    /// {"leases": [{"token", "resources", "expires_in_ms", "legacy"}], "next_token"}
+    nlohmann::json exportLeases();
 
     /**
-     * @brief Renew the TTL of a lock.
+     * @brief Replace the leases with those of @p exported (another manager's exportLeases()),
+     *        tokens included, for a hot standby taking over from it.
+     *
+     * Holders keep renewing and releasing with the tokens they have, and tokens granted from
+     * here on stay above every imported one. Waiters are left queued.
      */
-    bool renew(const std::string& lockNameStr, int ttlSeconds)
+    void importLeases(const nlohmann::json& exported);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Lease
     {
-        LockType type = stringToLockType(lockNameStr);
-        if (type == LockType::Unknown) return false;
-
-        std::lock_guard<std::mutex> lock(m_mutex);
-        
-        // Cannot renew if the lock entry doesn't exist or is not currently locked
-        if (m_locks.find(type) == m_locks.end() || !m_locks[type].isLocked) {
-            return false;
-        }
-
-        // Extend the expiry time
-        m_locks[type].expiryTime = std::chrono::steady_clock::now() + std::chrono::seconds(ttlSeconds);
-        return true;
-    }
-};
\ No newline at end of file
+        std::vector<std::string> resources;
+        Clock::time_point expiry;
+        bool legacy = false;
+    };
+
+    struct Waiter
+    {
+        WaitId id = 0;
+        std::vector<std::string> resources;
+        int ttlSeconds = 0;
+        bool legacy = false;
+        Granted done;
+        Clock::time_point queuedAt;
+    };
+
+    using Ready = std::vector<std::pair<Granted, Token>>;
+
+    // All members below run with m_mutex held
+    void reapExpired(Clock::time_point now);
+    bool isFree(const std::vector<std::string>& resources) const;
+    bool queuedBefore(const std::vector<std::string>& resources,
+                      std::list<Waiter>::const_iterator end) const;
+    Token grant(const std::vector<std::string>& resources,
+                int ttlSeconds,
+                bool legacy,
+                Clock::time_point now);
+    void endLease(Token token);
+    // Grant waiters that became free into @p ready; the earliest expiry blocking the rest
+    std::optional<Clock::time_point> grantWaiters(Clock::time_point now, Ready& ready);
+
+    // Expire leases and grant waiters, then call their callbacks
+    void pump();
+    void finish(Ready& ready, std::optional<Clock::time_point> wakeAt);
+
+    std::mutex m_mutex;
+    std::unordered_map<Token, Lease> m_leases;
+    std::unordered_map<std::string, Token> m_holders; // resource -> lease holding it
+    size_t m_routingDomainHeld = 0;                   // held switch:, link: and flow: resources
+    std::list<Waiter> m_waiters;                      // in arrival order
+    Token m_nextToken = 1;
+    WaitId m_nextWaitId = 1;
+
+    utils::TaskScheduler::TaskId m_expiryTask = 0;
+    utils::Histogram& m_waitTime;     // from queueing to grant
+    utils::Counter& m_abandonedWaits; // given up by timeout or disconnect
+};
@@ -1,15 +1,22 @@
 #pragma once
 
-#include "utils/Utils.hpp"   // for DeploymentMode
-#include <atomic>            // for atomic
-#include <memory>            // for shared_ptr
-#include <nlohmann/json.hpp> // for json
+#include "ndt_core/power_management/PollScheduler.hpp" // for PollScheduler
+#include "utils/MemoryAccounting.hpp"                   // for MemoryUsage
+#include "utils/StopSignal.hpp"                         // for StopSignal
+#include "utils/TaskScheduler.hpp"                      // for TaskScheduler
+#include "utils/Utils.hpp"                              // for DeploymentMode
+#include <atomic>                                       // for atomic
+#include <filesystem>                                   // for file_time_type
+#include <memory>                                       // for shared_ptr
+#include <mutex>                                        // for mutex
+#include <nlohmann/json.hpp>                            // for json
+#include <optional>                                     // for optional
 #include <shared_mutex>
 #include <stdint.h>           // for uint32_t, uint64_t
 #include <string>             // for string, basic_string
-#include <thread>             // for thread
 #include <tuple>              // for tuple
 #include <unordered_map>      // for unordered_map
+#include <utility>            // for pair
 #include <vector>             // for vector
 class TopologyAndFlowMonitor; // lines 34-34
 
@@ -20,6 +27,11 @@ namespace ndtClassifier
 class Classifier;
 }
 
+namespace utils
+{
+class IcmpProber;
+}
+
 /**
  * @brief Mapping between a switch management IP and its smart plug control endpoint.
  *
@@ -30,10 +42,67 @@ struct SwitchInfo
     std::string switchIp;
     std::string plugIp;
     int plugIdx;
+    uint64_t dpid = 0; // 0 when the topology file gives none
+};
+
+/**
+ * @brief The smart plug of each switch as loaded from the topology file, indexed by switch
+ *        management IP and by DPID. Immutable once published.
+ */
+struct SmartPlugTable
+{
+    std::vector<SwitchInfo> switches; // in file order
+    std::unordered_map<std::string, size_t> byIp;
+    std::unordered_map<uint64_t, size_t> byDpid;
+
+    /// The plug of the switch at @p ip, or nullptr.
+    const SwitchInfo* findByIp(const std::string& ip) const;
+    /// The plug of switch @p dpid, or nullptr.
+    const SwitchInfo* findByDpid(uint64_t dpid) const;
 };
 
 // This should align with real-world smart plug configuration
 
+/// One switch's latest reading of a status metric.
+struct DeviceMetric
+{
+    enum class State : uint8_t
+    {
+        Ok,
+        Down,        // the switch is down
+        Unsupported, // the switch cannot report this metric
+    };
+
+    uint64_t dpid = 0;
+    uint32_t ip = 0;   // management address, network order
+    int64_t value = 0; // mW, percent or degrees Celsius; -1 when the switch gave none
+    State state = State::Ok;
+
+    bool operator==(const DeviceMetric& o) const = default;
+};
+
+/// The readings of one metric, sorted by dpid.
+using DeviceMetrics = std::vector<DeviceMetric>;
+
+/**
+ * @brief The power, CPU, memory and temperature reports of the status worker.
+ *
+ * Published as a whole and never modified afterwards, so readers share it without copying.
+ * Power has an entry per switch (0 mW when down); CPU and memory one per switch that is up;
+ * temperature one per switch, Down or Unsupported when it has no reading.
+ */
+struct DeviceStatus
+{
+    DeviceMetrics power;
+    DeviceMetrics cpu;
+    DeviceMetrics memory;
+    DeviceMetrics temperature;
+    uint64_t version = 0; // statusVersion() of this snapshot
+
+    /// The reading of @p dpid in @p metrics, or nullptr.
+    static const DeviceMetric* find(const DeviceMetrics& metrics, uint64_t dpid);
+};
+
 /**
  * @brief Central manager for switch power control and device status telemetry.
  *
@@ -44,15 +113,25 @@ struct SwitchInfo
  *  - fetch and cache OpenFlow table snapshots for switches, and
  *  - expose results in JSON form for REST/API handlers.
  *
- * The class runs background worker threads when start() is called:
- *  - a ping worker to track reachability (optional/implementation-defined),
+ * The class runs background tasks on the process-wide utils::TaskScheduler when start() is
+ * called:
+ *  - a ping worker to track reachability: in TESTBED mode an IcmpProber echoes every switch
+ *    address at once and marks the switches up or down; it also reloads the smart plug
+ *    table when the topology file was modified,
  *  - a status update worker that refreshes cached telemetry,
  *  - an OpenFlow table update worker that refreshes cached flow tables.
  *
+ * The two update workers poll through a PollScheduler: each switch is polled for each metric
+ * on its own jittered interval, a switch that does not answer is backed off (keeping its last
+ * values), and requestOpenFlowTablesPoll() re-polls a switch's table soon after a flow push.
+ * After each round a worker's task is set to run again at PollScheduler::nextWake().
+ *
  * Concurrency:
- *  - Cached status JSON is protected by m_statusMutex (shared_mutex).
- *  - Cached OpenFlow tables are protected by m_openflowTablesMutex.
- *  - Public getters return snapshots from the cache.
+ *  - The status reports are a DeviceStatus snapshot, swapped under m_statusMutex.
+ *  - Cached OpenFlow tables are protected by m_openflowTablesMutex, and shared with readers
+ *    until the next change copies them.
+ *  - Public getters return snapshots from the cache; the JSON getters serialise them, and
+ *    HttpSession caches those bodies per statusVersion() / openFlowTablesVersion().
  *
  * Deployment:
  *  - TESTBED mode controls real hardware using the smart plug table and GW_IP gateway URL.
@@ -72,6 +151,7 @@ class DeviceConfigurationAndPowerManager
                                        int mode,
                                        std::string gwUrl,
                                        std::shared_ptr<ndtClassifier::Classifier> classifier);
+    ~DeviceConfigurationAndPowerManager(); // where IcmpProber is complete
 
     /**
      * @brief Query power state for one or more switches.
@@ -106,10 +186,13 @@ class DeviceConfigurationAndPowerManager
      */
     bool setSwitchPowerState(const std::string& ip, const std::string& action);
 
+    /// The latest status reports, shared with the status worker rather than copied.
+    std::shared_ptr<const DeviceStatus> getDeviceStatus() const;
+
     /**
      * @brief Get the latest cached power report for all devices.
      *
-     * @return JSON snapshot of the most recent power report.
+     * @return [{"dpid", "power_consumed"}] in mW, serialised from getDeviceStatus().
      */
     json getPowerReport();
     /**
@@ -119,10 +202,36 @@ class DeviceConfigurationAndPowerManager
     /**
      * @brief Get the latest cached OpenFlow table snapshot as JSON.
      *
+     * The poller keeps the raw Ryu responses; the first call after a poll parses them.
+     *
      * @return JSON describing OpenFlow tables for switches (schema implementation-defined).
      */
     json getOpenFlowTables();
 
+    /// getOpenFlowTables() without copying: the snapshot stays valid after later polls.
+    std::shared_ptr<const json> getOpenFlowTablesSnapshot();
+
+    /// Bumped whenever the power, CPU, memory and temperature reports are refreshed.
+    uint64_t statusVersion() const;
+
+    /// Bumped whenever the OpenFlow table snapshot changes (poll or updateOpenFlowTables()).
+    uint64_t openFlowTablesVersion() const;
+
+    /// The smart plug table (TESTBED mode), reloaded by the ping worker when the file changes.
+    std::shared_ptr<const SmartPlugTable> getSmartPlugTable() const;
+
+    /// RTT and loss per switch address from the ping worker (TESTBED mode), see IcmpProber.
+    json getLivenessStatsJson() const;
+
+    /// Polls, failures and switches backing off per metric, see PollScheduler.
+    json getPollSchedulerStatsJson() const;
+
+    /// Estimated bytes of the status snapshot, cached OpenFlow tables and smart plug table.
+    utils::MemoryUsage memoryUsage() const;
+
+    /// Re-poll the OpenFlow table of @p dpid soon, e.g. after flows were pushed to it.
+    void requestOpenFlowTablesPoll(uint64_t dpid);
+
     /**
      * @brief Get the latest cached CPU utilization report.
      */
@@ -159,13 +268,14 @@ class DeviceConfigurationAndPowerManager
     /**
      * @brief Start background workers that refresh cached status and OpenFlow tables.
      *
-     * Launches m_pingThread, m_statusUpdateThread and m_openflowTablesUpdateThread.
+     * Schedules the ping, status update and OpenFlow table update tasks.
      */
     void start();
     /**
      * @brief Stop all background workers and release resources.
      *
-     * Signals shutdown, joins threads, and leaves cached values intact.
+     * Signals shutdown, cancels the tasks (waiting for rounds in progress), and leaves cached
+     * values intact.
      */
     void stop();
 
@@ -173,9 +283,17 @@ class DeviceConfigurationAndPowerManager
     std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
     utils::DeploymentMode m_mode;
     std::atomic<bool> m_running{false};
-    std::thread m_pingThread;
+    PollScheduler m_pollScheduler;
+    utils::StopSignal m_stop; // ends pending ping retries on stop()
+    utils::TaskScheduler::TaskId m_pingTask = 0;
+    // Probes switch liveness; null when no ICMP socket could be opened (pingSwitch() is used)
+    std::unique_ptr<utils::IcmpProber> m_icmpProber;
 
+    // Load the smart plug table from the topology file at @p path and publish it; the table
+    // in use stays when the file cannot be read
     void fetchSmartPlugInfoFromFile(const std::string& path);
+    // fetchSmartPlugInfoFromFile() if the file was modified since the last load
+    void reloadSmartPlugTableIfChanged(const std::string& path);
     // Extract "ip" parameter from target; empty if absent
     std::string parseIpParam(const std::string& target) const;
 
@@ -187,7 +305,8 @@ class DeviceConfigurationAndPowerManager
     json parseFlowStatsTextToJson(const std::string& responseText) const;
 
     bool pingSwitch(const std::string& ip, int timeout_sec);
-    void pingWorker(int interval_sec);
+    // One round of liveness probes (ping task)
+    void pingWorker();
 
     // Helpers for TESTBED mode
     bool setPowerStateTestbed(const SwitchInfo& si, const std::string& action);
@@ -195,33 +314,50 @@ class DeviceConfigurationAndPowerManager
     bool setPowerStateMininet(uint32_t ipUint, const std::string& action);
 
     /**
-     * @brief The main loop for the m_statsUpdateThread.
+     * @brief One round of the status update task.
      *
-     * Periodically calls all the "fetch...Internal" functions and
-     * updates the cached member variables under a lock.
+     * Calls all the "fetch...Internal" functions for the switches m_pollScheduler has due
+     * and updates the cached member variables that changed under a lock.
      */
     void statusUpdateWorker();
     void openflowTablesUpdateWorker();
     // --- The *actual* (slow) data-fetching functions ---
-    // These are the original implementations, just renamed.
-    json fetchPowerReportInternal();
-    json fetchMemoryReportInternal();
-    json fetchCpuReportInternal();
-    json fetchTemperatureReportInternal();
-    json fetchOpenFlowTablesInternal();
-
-    std::vector<SwitchInfo> switchSmartPlugTable;
-
-    std::thread m_statusUpdateThread;
-    std::thread m_openflowTablesUpdateThread;
-    mutable std::shared_mutex m_statusMutex;
+    // Each polls the switches due for its metric, reports the outcomes to m_pollScheduler
+    // and takes the other switches' readings from @p previous (the cached report); nullopt
+    // when the report equals @p previous.
+    std::optional<DeviceMetrics> fetchPowerReportInternal(const DeviceMetrics& previous);
+    std::optional<DeviceMetrics> fetchMemoryReportInternal(const DeviceMetrics& previous);
+    std::optional<DeviceMetrics> fetchCpuReportInternal(const DeviceMetrics& previous);
+    std::optional<DeviceMetrics> fetchTemperatureReportInternal(const DeviceMetrics& previous);
+
+    // (dpid, raw /stats/flow/<dpid> response) per polled switch
+    using FlowStatsResponses = std::vector<std::pair<uint64_t, std::string>>;
+    // Polls the due switches that are up and feeds the classifier; returns the raw responses
+    // of those that answered, and every switch that is up in @p upDpids
+    FlowStatsResponses fetchOpenFlowTablesInternal(std::vector<uint64_t>& upDpids);
+    // Merge m_cachedFlowStats into m_cachedOpenFlowTables if a poll arrived since the last
+    // time (caller holds m_openflowTablesMutex exclusively)
+    void materializeOpenFlowTablesNoLock();
+    // m_cachedOpenFlowTables, copied first if a reader still shares it (caller holds
+    // m_openflowTablesMutex exclusively)
+    json& mutableOpenFlowTablesNoLock();
+
+    mutable std::mutex m_smartPlugMutex; // guards the m_smartPlugTable pointer only
+    std::shared_ptr<const SmartPlugTable> m_smartPlugTable;
+    std::filesystem::file_time_type m_smartPlugFileTime; // of the last load
+
+    utils::TaskScheduler::TaskId m_statusUpdateTask = 0;
+    // Read by requestOpenFlowTablesPoll() from any thread
+    std::atomic<utils::TaskScheduler::TaskId> m_openflowTablesUpdateTask{0};
+    mutable std::mutex m_statusMutex; // guards the m_deviceStatus pointer only
     mutable std::shared_mutex m_openflowTablesMutex;
 
-    json m_cachedPowerReport;
-    json m_cachedCpuReport;
-    json m_cachedMemoryReport;
-    json m_cachedTemperatureReport;
-    json m_cachedOpenFlowTables;
+    std::shared_ptr<const DeviceStatus> m_deviceStatus;
+    std::shared_ptr<json> m_cachedOpenFlowTables; // copied on write while readers share it
+    FlowStatsResponses m_cachedFlowStats;         // polls since the last materialization
+    bool m_openflowTablesStale = false;           // m_cachedOpenFlowTables is out of date
+    std::atomic<uint64_t> m_openflowTablesVersion{0};
+    std::atomic<uint64_t> m_statusVersion{0};
 
     std::string GW_IP;
 
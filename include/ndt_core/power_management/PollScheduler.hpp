@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>             // for array
+#include <chrono>            // for milliseconds, steady_clock
+#include <cstdint>           // for uint64_t
+#include <initializer_list>  // for initializer_list
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <random>            // for mt19937
+#include <unordered_map>     // for unordered_map
+
+#define POLL_INTERVAL_POWER_MS 10000           // base interval of each metric
+#define POLL_INTERVAL_CPU_MS 10000
+#define POLL_INTERVAL_MEMORY_MS 30000
+#define POLL_INTERVAL_TEMPERATURE_MS 30000
+#define POLL_INTERVAL_OPENFLOW_TABLES_MS 10000
+#define POLL_SCHEDULER_JITTER_PERCENT 10       // next polls move by up to +-10% of the interval
+#define POLL_SCHEDULER_MAX_BACKOFF_MS 300000   // longest interval of a device that keeps failing
+#define POLL_SCHEDULER_SOON_MS 500             // pollSoon() delay, so a burst of pushes polls once
+#define POLL_SCHEDULER_COALESCE_MS 1000        // devices due this close together share a poll
+#define POLL_SCHEDULER_MAX_SLEEP_MS 1000       // nextWake() is at most this far ahead
+
+/// What a poll reads from a device.
+enum class PollMetric
+{
+    Power,
+    Cpu,
+    Memory,
+    Temperature,
+    OpenFlowTables,
+};
+
+inline constexpr size_t POLL_METRIC_COUNT = 5;
+
+/**
+ * @brief Decides when each (metric, device) pair is polled next.
+ *
+ * Devices are keys chosen by the caller (a switch IP for the telemetry metrics, a DPID for
+ * OpenFlow tables). A device is due immediately the first time it is seen. After each poll
+ * the caller reports the outcome, and the device's next poll is set to
+ *  - the metric's interval after a success,
+ *  - interval * 2^failures after failures in a row, capped at POLL_SCHEDULER_MAX_BACKOFF_MS,
+ * each moved by a random +-POLL_SCHEDULER_JITTER_PERCENT, so devices drift apart instead of
+ * being polled in lockstep. pollSoon() brings a device's next poll forward to
+ * POLL_SCHEDULER_SOON_MS from now, e.g. after a flow push changed its table.
+ *
+ * A poll task polls the devices of its metrics for which due() holds, then runs again at
+ * nextWake(); due() looks POLL_SCHEDULER_COALESCE_MS ahead so that devices almost due go in
+ * the same poll.
+ *
+ * Thread-safe.
+ */
+class PollScheduler
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Intervals come from the live runtime parameters poll.<metric>_interval_ms.
+    PollScheduler();
+
+    /// Whether @p device should be polled for @p metric now.
+    bool due(PollMetric metric, uint64_t device) const;
+
+    /// Schedule the next poll of @p device for @p metric after a poll that succeeded or not.
+    void report(PollMetric metric, uint64_t device, bool ok);
+
+    /**
+     * @brief Poll @p device for @p metric within POLL_SCHEDULER_SOON_MS, even if backing off.
+     * @return When the device is due now, for the caller to wake its poll task.
+     */
+    Clock::time_point pollSoon(PollMetric metric, uint64_t device);
+
+    /**
+     * @brief When a poll of @p metrics is next needed: the first device due in the future,
+     *        or POLL_SCHEDULER_MAX_SLEEP_MS from now at the latest (so new devices are found).
+     */
+    Clock::time_point nextWake(std::initializer_list<PollMetric> metrics) const;
+
+    /// Poll @p metric every @p interval from each device's next poll on.
+    void setInterval(PollMetric metric, std::chrono::milliseconds interval);
+
+    /**
+     * @brief Per metric: {"interval_ms", "devices", "backing_off", "polls", "failures",
+     *        "soon_requests"}.
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    struct DeviceState
+    {
+        Clock::time_point nextDue;
+        unsigned failures = 0; // in a row
+    };
+
+    struct MetricState
+    {
+        std::chrono::milliseconds interval;
+        std::unordered_map<uint64_t, DeviceState> devices;
+        uint64_t polls = 0;
+        uint64_t failures = 0;
+        uint64_t soonRequests = 0;
+    };
+
+    // Interval scaled by the backoff of @p failures, with jitter (caller holds m_mutex)
+    Clock::duration nextIntervalNoLock(const MetricState& state, unsigned failures);
+
+    mutable std::mutex m_mutex;
+    std::array<MetricState, POLL_METRIC_COUNT> m_metrics;
+    std::mt19937 m_random;
+};
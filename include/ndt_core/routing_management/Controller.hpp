@@ -1,14 +1,25 @@
 #pragma once
+#include "ndt_core/routing_management/FlowBatchTracker.hpp"
 #include "ndt_core/routing_management/FlowDispatcher.hpp"
+#include "ndt_core/routing_management/FlowReconciler.hpp"
+#include "ndt_core/routing_management/FlowTableCapacity.hpp"
 
+class FastReroute;
 class FlowRoutingManager;
 
+namespace ndtClassifier
+{
+class Classifier;
+}
+
 /**
  * @brief Owns long-lived control-plane components and exposes a shared FlowDispatcher.
  *
  * Controller wires together the FlowRoutingManager with a single FlowDispatcher instance
  * that is shared across all sessions/requests. The dispatcher is constructed with a sender
- * callback that ultimately applies FlowJobs through the FlowRoutingManager.
+ * callback that ultimately applies FlowJobs through the FlowRoutingManager, then writes the
+ * jobs the switch accepted through to the Classifier (Classifier::applyFlowMods()), so flow
+ * paths follow a reroute without waiting for the next OpenFlow table poll.
  *
  * Lifetime / ordering:
  *  - m_flowRoutingManager is declared before dispatcher_ to ensure it is constructed first
@@ -22,8 +33,10 @@ class Controller
      *
      * @param flowRoutingManager Shared routing manager used by the dispatcher sender callback
      *                           to install/modify/delete flow rules.
+     * @param classifier         Classifier the applied jobs are written through to; may be null.
      */
-    Controller(std::shared_ptr<FlowRoutingManager> flowRoutingManager);
+    Controller(std::shared_ptr<FlowRoutingManager> flowRoutingManager,
+               std::shared_ptr<ndtClassifier::Classifier> classifier = nullptr);
 
     /**
      * @brief Destroy the controller and release owned resources.
@@ -43,9 +56,68 @@ class Controller
         return dispatcher_;
     }
 
+    /**
+     * @brief Completion status of the flow batches enqueued on the dispatcher.
+     *
+     * Returned reference is valid as long as this Controller instance lives.
+     */
+    FlowBatchTracker& batchTracker()
+    {
+        return batchTracker_;
+    }
+
+    /**
+     * @brief Flow table room of each switch, to admit flow batches before they are enqueued
+     *        on dispatcher(); installed entries are the classifier's rule counts.
+     *
+     * Returned reference is valid as long as this Controller instance lives.
+     */
+    FlowTableCapacity& capacity()
+    {
+        return capacity_;
+    }
+
+    /**
+     * @brief Desired-state reconciliation against the classifier's rules; its jobs go to
+     *        dispatcher() like any others.
+     *
+     * Returned reference is valid as long as this Controller instance lives.
+     */
+    FlowReconciler& reconciler()
+    {
+        return reconciler_;
+    }
+
+    /// Precomputed link-failure reroutes, or null if not enabled (--fast-reroute).
+    const std::shared_ptr<FastReroute>& fastReroute() const
+    {
+        return fastReroute_;
+    }
+
+    /// Not synchronized with the readers: set it before serving requests.
+    void setFastReroute(std::shared_ptr<FastReroute> fastReroute)
+    {
+        fastReroute_ = std::move(fastReroute);
+    }
+
   private:
-    // Declare m_flowRoutingManager BEFORE dispatcher_ so it's constructed first
+    // Apply the jobs of @p batch that succeeded in @p results to m_classifier
+    void writeThrough(const std::vector<FlowJob>& batch, const std::vector<bool>& results);
+    // Record the southbound_send (@p sendStart to @p sent) and classifier_confirmation (to
+    // @p confirmed, the write-through) spans of each failover trace with jobs in @p batch
+    void traceBurst(const std::vector<FlowJob>& batch,
+                    std::chrono::steady_clock::time_point sendStart,
+                    std::chrono::steady_clock::time_point sent,
+                    std::chrono::steady_clock::time_point confirmed);
+
+    // Declare m_flowRoutingManager and m_classifier BEFORE dispatcher_ so they're constructed
+    // first
     std::shared_ptr<FlowRoutingManager> m_flowRoutingManager;
+    std::shared_ptr<ndtClassifier::Classifier> m_classifier;
 
     FlowDispatcher dispatcher_; // long-lived, shared by all sessions
+    FlowBatchTracker batchTracker_;
+    FlowTableCapacity capacity_;
+    FlowReconciler reconciler_;
+    std::shared_ptr<FastReroute> fastReroute_;
 };
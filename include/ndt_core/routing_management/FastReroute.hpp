@@ -0,0 +1,93 @@
+#pragma once
+#include "ndt_core/routing_management/FlowJob.hpp"
+#include "utils/TaskScheduler.hpp"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <utility>
+#include <vector>
+
+#define FAST_REROUTE_REFRESH_MS 1000 // how often the backup table catches up with the network
+
+class Controller;
+class EventBus;
+class TopologyAndFlowMonitor;
+struct LinkStateChangedEventData;
+
+/**
+ * @brief Backup forwarding changes precomputed for the failure of each switch-to-switch link,
+ *        pushed as urgent flow jobs the moment the link is reported down.
+ *
+ * For every link, the destinations of the flows the edge-flow index currently sees on it (in
+ * either direction) are routed by RoutingEngine twice: on the graph as it is and with the
+ * link down. The /32 rules (priority 100) that differ, on whichever switch, are the link's
+ * backup jobs. A refresh every FAST_REROUTE_REFRESH_MS redoes every link after a graph
+ * change (topology or link state), and otherwise only the links whose flows changed. The
+ * routing is by hop count, so link utilisation does not change the result.
+ *
+ * Subscribed to LinkStateChanged: each link with a direction gone down has its jobs queued
+ * on the Controller's dispatcher in the urgent lane as one tracked batch, under the event's
+ * failover trace, without computing anything. A link's jobs are sent once until the next
+ * refresh recomputes them. They assume that link is the only failure; the routing apps may
+ * follow with corrections of their own.
+ */
+class FastReroute
+{
+  public:
+    /// @p controller receives the jobs and must outlive this object.
+    FastReroute(std::shared_ptr<TopologyAndFlowMonitor> topologyMonitor, Controller& controller);
+    ~FastReroute();
+
+    FastReroute(const FastReroute&) = delete;
+    FastReroute& operator=(const FastReroute&) = delete;
+
+    /// Subscribe to @p eventBus's link changes and start the refreshes; this object must
+    /// outlive the bus's handlers.
+    void start(EventBus& eventBus);
+    void stop();
+
+    /// Bring the backup table up to date with the current graph snapshot.
+    void refresh();
+
+    /**
+     * @brief Queue the backup jobs of every link @p event reports down.
+     * @return The number of jobs queued.
+     */
+    size_t onLinkStateChanged(const LinkStateChangedEventData& event);
+
+    /// {"links", "destinations", "jobs", "refreshes", "links_recomputed", "last_refresh_ms",
+    ///  "failovers", "jobs_sent", "misses"}
+    nlohmann::json statsJson() const;
+
+  private:
+    // A link by its two switch vertices, lower index first. Vertices are never removed from
+    // the graph, so their indices stay valid across versions.
+    using LinkKey = std::pair<size_t, size_t>;
+
+    struct Backup
+    {
+        std::vector<uint32_t> destinations; // sorted, network byte order
+        std::vector<FlowJob> jobs;
+        bool sent = false;
+    };
+
+    std::shared_ptr<TopologyAndFlowMonitor> m_topologyMonitor;
+    Controller& m_controller;
+    utils::TaskScheduler::TaskId m_refreshTask = 0;
+
+    std::mutex m_refreshMutex; // one refresh at a time; guards the two below
+    uint64_t m_graphVersion = 0;
+    uint64_t m_flowsEpoch = 0;
+
+    mutable std::mutex m_mutex; // guards everything below
+    std::map<LinkKey, Backup> m_backups;
+    uint64_t m_refreshes = 0;
+    uint64_t m_linksRecomputed = 0;
+    std::chrono::steady_clock::duration m_lastRefresh{};
+    uint64_t m_failovers = 0;
+    uint64_t m_jobsSent = 0;
+    uint64_t m_misses = 0; // links reported down with no backup jobs
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include "ndt_core/routing_management/FlowJob.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#define FLOW_BATCH_TRACKER_MAX_BATCHES 1024 // batches kept for status queries, oldest dropped first
+
+/**
+ * @brief Completion tracking of flow batches handed to the FlowDispatcher.
+ *
+ * track() gives a batch an id and sets the onDone of each of its jobs, so the dispatcher
+ * reports every job's FlowJobOutcome to it. statusJson() then tells whether the batch is still
+ * pending and which of its jobs failed or expired. The jobs report to the batch itself, not to
+ * the tracker, so a batch dropped from the tracker (beyond FLOW_BATCH_TRACKER_MAX_BATCHES) is
+ * still safe to complete.
+ *
+ * A batch of a failover trace (its jobs' FlowJob::trace) completes that trace's piece of work
+ * (utils::Tracer::complete()) when its last job reports.
+ *
+ * Thread-safe.
+ */
+class FlowBatchTracker
+{
+  public:
+    /// Register @p jobs (in request order) as one batch and hook their onDone, after any
+    /// already set; returns its id.
+    uint64_t track(std::vector<FlowJob>& jobs);
+
+    /**
+     * @brief {"batch_id", "state": "pending"|"done", "total", "applied", "failed", "expired",
+     *        "elapsed_ms", "failed_jobs": [index], "expired_jobs": [index]}, or nullopt for an
+     *        unknown (or already dropped) id. Indices refer to the jobs passed to track().
+     */
+    std::optional<nlohmann::json> statusJson(uint64_t id) const;
+
+    /// {"batches", "pending", "completed", "kept"}
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Batch
+    {
+        explicit Batch(uint64_t id, size_t jobs)
+            : id(id),
+              outcomes(jobs),
+              remaining(jobs),
+              createdAt(std::chrono::steady_clock::now())
+        {
+        }
+
+        void report(size_t index, FlowJobOutcome outcome);
+        nlohmann::json toJson() const;
+
+        const uint64_t id;
+        mutable std::mutex mtx;
+        std::vector<std::optional<FlowJobOutcome>> outcomes;
+        size_t remaining;
+        std::chrono::steady_clock::time_point createdAt;
+        std::chrono::steady_clock::time_point doneAt;
+        utils::TraceId trace;
+        std::shared_ptr<std::atomic<uint64_t>> completedCounter; // shared with the tracker
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Batch>> m_batches;
+    std::deque<uint64_t> m_order; // ids by age, for eviction
+    uint64_t m_nextId = 1;
+
+    // Batches that finished, counted by the batches themselves
+    std::shared_ptr<std::atomic<uint64_t>> m_completed =
+        std::make_shared<std::atomic<uint64_t>>(0);
+};
@@ -1,14 +1,24 @@
 #pragma once
 #include "ndt_core/routing_management/FlowJob.hpp"
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <string>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
+#define FLOW_DISPATCHER_NORMAL_MAX_WAIT_MS 200 // a normal job waiting longer goes before urgent ones
+#define FLOW_DISPATCHER_BULK_MAX_WAIT_MS 2000  // likewise for a bulk job
+#define FLOW_DISPATCHER_WAIT_BUCKETS 14        // wait histogram: < 1, 2, 4, ... 4096 ms, and longer
+#define FLOW_DISPATCHER_BURST_SIZE 2000        // default burst size of the controller's dispatcher
+
 /**
  * @brief Per-switch (per-DPID) flow job dispatcher with batching.
  *
@@ -16,35 +26,82 @@
  * queueing jobs and sending them asynchronously to a provided southbound sender function.
  *
  * Design:
- *  - Maintains one FIFO queue per switch DPID (queues_).
- *  - Spawns one worker thread per active DPID (workers_) that drains its queue.
+ *  - Maintains one set of FIFO queues per switch DPID (queues_), one per FlowLane, each set
+ *    with its own lock and condition variable, so an enqueue wakes only the worker of its switch.
+ *  - Spawns one worker thread per active DPID that drains its queue.
  *  - Sends jobs in batches (bursts) up to burstSize_ to reduce overhead.
  *
  * The sender callback is responsible for actually applying the batch (e.g., install/modify/delete
- * OpenFlow entries) and for any additional synchronization with the controller datapath.
+ * OpenFlow entries) as one southbound push and reports the outcome of each job. With
+ * fencePerBurst set it is asked to return only once the switch has applied the burst (a barrier),
+ * so a burst never overtakes the previous one.
+ *
+ * Lanes:
+ *  - A burst takes Urgent jobs first, then Normal, then Bulk.
+ *  - Anti-starvation: a Normal or Bulk lane whose oldest job has waited longer than
+ *    FLOW_DISPATCHER_NORMAL_MAX_WAIT_MS / FLOW_DISPATCHER_BULK_MAX_WAIT_MS goes first.
+ *  - A job whose deadline has passed when its burst is built is dropped and counted as expired.
+ *  - Per lane, the jobs queued over all switches and a histogram of their queueing time are
+ *    reported by statsJson().
+ *
+ * Coalescing:
+ *  - Before a burst is sent, its jobs are merged per entry (dpid, priority, match): only the
+ *    net effect of the ops on an entry is sent, where the last of them was. Install then
+ *    Modify is one Install with the new actions, Install then Delete cancels out (the entry
+ *    is assumed not to have existed before the Install), a Delete or Install replaces what
+ *    came before. A non-strict delete (priority -1) is never merged and nothing merges
+ *    across it. The ops saved are counted as coalesced jobs.
+ *
+ * Groups and meters:
+ *  - Group and meter jobs (FlowJob::target) share the switch's queues and bursts with flow
+ *    jobs and are coalesced per group or meter id like flow entries.
+ *  - Within a burst, groups and meters are added and modified first, then the flow jobs are
+ *    sent, then groups and meters are deleted, each kind in its queue order; so a flow entry
+ *    never references a group or meter its burst has yet to create or has already removed.
+ *    Across bursts, queue order holds: enqueue a group in the same lane as, and before, the
+ *    flow entries referencing it.
+ *
+ * Tracing:
+ *  - For the jobs of each failover trace (FlowJob::trace) in a burst, the wait from the oldest
+ *    one's enqueue until the burst was taken is recorded as its dispatcher_queue span.
+ *
+ * Each burst's latency (the sender call) and its failed jobs are counted; see statsJson().
+ * A burst that applied any job is announced to the setOnBurstApplied() callback, e.g. so the
+ * switch's flow table is re-polled.
+ *
+ * Completion:
+ *  - Every job's onDone, if set, is called once with its outcome: after its burst is sent,
+ *    or when it expires. A job merged away by coalescing reports the outcome of the job it was
+ *    merged into; a pair that cancels out reports Applied without anything being sent.
  *
  * Concurrency:
- *  - enqueue() is thread-safe.
- *  - Workers block on a condition variable when no work is available.
+ *  - enqueue() is thread-safe. It finds the switch's queue under a shared lock of the map
+ *    (exclusive only the first time a DPID is seen) and then locks that queue alone.
+ *  - Workers block on their switch's condition variable when no work is available.
  *  - start()/stop() control the lifetime of worker threads.
  *
  * Ordering:
- *  - Jobs targeting the same DPID are processed in FIFO order.
+ *  - Jobs targeting the same DPID and lane are processed in FIFO order; a job of a higher lane
+ *    may overtake earlier ones of lower lanes.
  *  - Different DPIDs are processed independently (parallelism across switches).
  */
 class FlowDispatcher
 {
   public:
-    using SenderFn = std::function<void(const std::vector<FlowJob>& batch)>;
+    /// Applies @p batch (one DPID, in order) and returns whether each job succeeded; with
+    /// @p fence set, returns once the switch has applied them.
+    using SenderFn =
+        std::function<std::vector<bool>(const std::vector<FlowJob>& batch, bool fence)>;
+    /// Told the DPID of each burst that applied at least one job, on its worker thread.
+    using BurstFn = std::function<void(uint64_t dpid)>;
 
     /**
      * @brief Construct a dispatcher.
      *
      * @param sender        Callback invoked by worker threads to send a batch of jobs.
      * @param burstSize     Max number of jobs to send per batch (per DPID) before yielding.
-     * @param fencePerBurst If true, enforces a "fence" between bursts (implementation-defined),
-     *                      typically used to guarantee completion/ordering semantics across
-     * batches.
+     * @param fencePerBurst If true, the sender is asked to fence each burst with a barrier,
+     *                      guaranteeing completion/ordering across batches.
      */
     explicit FlowDispatcher(SenderFn sender, size_t burstSize = 2000, bool fencePerBurst = false);
 
@@ -66,7 +123,7 @@ class FlowDispatcher
     /**
      * @brief Stop the dispatcher and join worker threads.
      *
-     * Signals all workers to exit, wakes them via cv_, and joins all threads.
+     * Signals all workers to exit, wakes each via its switch's cv, and joins all threads.
      * Safe to call multiple times.
      */
     void stop();
@@ -88,21 +145,111 @@ class FlowDispatcher
      */
     void enqueue(std::vector<FlowJob> jobs); // bulk
 
+    /**
+     * @brief Set the callback told about applied bursts.
+     *
+     * Not synchronized with the workers: set it before the first enqueue().
+     */
+    void setOnBurstApplied(BurstFn fn);
+
+    /// Change the largest burst (at least 1); bursts taken from now on use it. Thread-safe.
+    void setBurstSize(size_t burstSize);
+
+    /**
+     * @brief {"bursts", "jobs", "failed_jobs", "coalesced_jobs", "fence_per_burst", "last_burst_ms",
+     *        "max_burst_ms", "mean_burst_ms"}, over all DPIDs.
+     */
+    nlohmann::json statsJson() const;
+
+    /// The same numbers in the Prometheus text format, appended to @p out (see GET /metrics).
+    void appendMetrics(std::string& out) const;
+
   private:
-    /// Worker thread for one DPID: waits for jobs, pops from queues_[dpid], and calls sender_ in
+    struct Pending
+    {
+        FlowJob job;
+        std::chrono::steady_clock::time_point enqueuedAt;
+    };
+
+    /// Pending jobs of one switch, per lane, and the worker draining them.
+    struct SwitchQueue
+    {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::array<std::deque<Pending>, FLOW_LANE_COUNT> lanes;
+        std::thread worker;
+
+        bool empty() const
+        {
+            return lanes[0].empty() && lanes[1].empty() && lanes[2].empty();
+        }
+    };
+
+    /// The jobs of one trace in a burst, and the oldest one's enqueue time.
+    struct TracedWait
+    {
+        utils::TraceId trace;
+        std::chrono::steady_clock::time_point enqueuedAt;
+        size_t jobs = 0;
+    };
+
+    /// Per-lane queue counters, over all switches.
+    struct LaneStats
+    {
+        std::atomic<uint64_t> queued{0};
+        std::atomic<uint64_t> expired{0};
+        std::array<std::atomic<uint64_t>, FLOW_DISPATCHER_WAIT_BUCKETS> waitHistogram{};
+    };
+
+    /// Worker thread for one DPID: waits for jobs, pops from @p sq, and calls sender_ in
     /// bursts.
-    void workerLoop_(uint64_t dpid);
+    void workerLoop_(SwitchQueue& sq, uint64_t dpid);
+
+    /// The queue of @p dpid, created on first use.
+    SwitchQueue& queueFor_(uint64_t dpid);
 
-    // One queue per DPID
-    std::unordered_map<uint64_t, std::deque<FlowJob>> queues_;
-    std::unordered_map<uint64_t, std::thread> workers_;
+    /// Appends @p jobs (all for @p dpid) to its queue, starting its worker if needed.
+    void push_(uint64_t dpid, std::vector<FlowJob>& jobs);
 
-    std::mutex mtx_;
-    std::condition_variable cv_;
+    /// Moves up to burstSize_ jobs of @p sq into @p burst, in lane order (see Lanes above),
+    /// and notes their traces in @p traced. Called with sq.mtx held.
+    void takeBurst_(SwitchQueue& sq, std::vector<FlowJob>& burst,
+                    std::vector<TracedWait>& traced);
+
+    /// Counts a job of @p trace enqueued at @p enqueuedAt into @p traced.
+    static void noteTraced_(std::vector<TracedWait>& traced, utils::TraceId trace,
+                            std::chrono::steady_clock::time_point enqueuedAt);
+
+    /// Merges the jobs of @p burst per entry (see Coalescing above); returns the ops saved.
+    static size_t coalesce_(std::vector<FlowJob>& burst);
+
+    /// Moves the group and meter jobs of @p burst around its flow jobs (see Groups and
+    /// meters above), keeping the order within each kind.
+    static void orderDependencies_(std::vector<FlowJob>& burst);
+
+    /// Calls the onDone of each job of @p burst with its entry of @p results (Failed if none).
+    static void complete_(std::vector<FlowJob>& burst, const std::vector<bool>& results);
+
+    /// Counts one sent burst taking @p latency with @p failed of its @p jobs failing.
+    void recordBurst_(size_t jobs, size_t failed, std::chrono::nanoseconds latency);
+
+    // One queue per DPID; entries are never removed, so references stay valid
+    std::unordered_map<uint64_t, std::unique_ptr<SwitchQueue>> queues_;
+    std::shared_mutex queuesMtx_;
     std::atomic<bool> running_{false};
 
     // Sender callback that applies a batch of FlowJobs to the datapath/controller.
     SenderFn sender_;
-    size_t burstSize_;
+    BurstFn onBurstApplied_;
+    std::atomic<size_t> burstSize_;
     bool fencePerBurst_;
+
+    std::atomic<uint64_t> bursts_{0};
+    std::atomic<uint64_t> jobsSent_{0};
+    std::atomic<uint64_t> jobsFailed_{0};
+    std::atomic<uint64_t> coalescedJobs_{0};
+    std::atomic<uint64_t> burstNs_{0};
+    std::atomic<uint64_t> lastBurstNs_{0};
+    std::atomic<uint64_t> maxBurstNs_{0};
+    std::array<LaneStats, FLOW_LANE_COUNT> laneStats_;
 };
@@ -1,8 +1,13 @@
 #pragma once
+#include "utils/Tracing.hpp"
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <string>
+#include <string_view>
 
 /**
  * @brief Operation type for a flow rule update.
@@ -14,6 +19,109 @@ enum class FlowOp : uint8_t
     Delete
 };
 
+/**
+ * @brief What a FlowJob changes on its switch: a flow entry, or a group or meter that flow
+ *        entries may reference.
+ */
+enum class FlowTarget : uint8_t
+{
+    Flow,
+    Group,
+    Meter
+};
+
+inline const char*
+toString(FlowTarget target)
+{
+    switch (target)
+    {
+    case FlowTarget::Flow:
+        return "flow";
+    case FlowTarget::Group:
+        return "group";
+    case FlowTarget::Meter:
+        return "meter";
+    }
+    return "flow";
+}
+
+/**
+ * @brief Priority class of a flow rule update in the FlowDispatcher.
+ *
+ * Urgent jobs (e.g. failover reroutes) are sent before Normal ones, Normal before Bulk.
+ */
+enum class FlowLane : uint8_t
+{
+    Urgent,
+    Normal,
+    Bulk
+};
+
+inline constexpr size_t FLOW_LANE_COUNT = 3;
+
+inline const char*
+toString(FlowLane lane)
+{
+    switch (lane)
+    {
+    case FlowLane::Urgent:
+        return "urgent";
+    case FlowLane::Normal:
+        return "normal";
+    case FlowLane::Bulk:
+        return "bulk";
+    }
+    return "normal";
+}
+
+/// "urgent", "normal" or "bulk"; nullopt for anything else.
+inline std::optional<FlowLane>
+flowLaneFromString(std::string_view name)
+{
+    if (name == "urgent")
+    {
+        return FlowLane::Urgent;
+    }
+    if (name == "normal")
+    {
+        return FlowLane::Normal;
+    }
+    if (name == "bulk")
+    {
+        return FlowLane::Bulk;
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief What became of a FlowJob in the FlowDispatcher.
+ *
+ * Applied: the sender reported success, or the job was merged into one that did (see
+ * FlowDispatcher coalescing). Failed: the sender reported failure. Expired: dropped from the
+ * queue past its deadline.
+ */
+enum class FlowJobOutcome : uint8_t
+{
+    Applied,
+    Failed,
+    Expired
+};
+
+inline const char*
+toString(FlowJobOutcome outcome)
+{
+    switch (outcome)
+    {
+    case FlowJobOutcome::Applied:
+        return "applied";
+    case FlowJobOutcome::Failed:
+        return "failed";
+    case FlowJobOutcome::Expired:
+        return "expired";
+    }
+    return "failed";
+}
+
 /**
  * @brief A unit of work for OpenFlow rule updates.
  *
@@ -29,6 +137,17 @@ enum class FlowOp : uint8_t
  *  - actions: Actions in JSON form (e.g., OUTPUT port).
  *  - idleTimeout: Optional idle timeout in seconds (0 means no idle timeout unless your controller
  *    interprets it differently).
+ *  - lane: Priority class in the dispatcher queues.
+ *  - deadline: Optional latest time to send the job; a job still queued past it is dropped.
+ *  - onDone: Optional; called once by the dispatcher with the job's outcome, on a dispatcher
+ *    worker thread and possibly under its queue lock, so it must be quick and must not enqueue.
+ *  - trace: Optional failover trace (utils::Tracer) the job belongs to; the dispatcher and
+ *    the sender record their stages of it.
+ *  - target: Flow for a flow entry (the default). For Group and Meter, op applies to the
+ *    group or meter described by entry, and priority, match, actions and idleTimeout are
+ *    unused.
+ *  - entry: Group or meter entry as Ryu's /stats/groupentry or /stats/meterentry takes it
+ *    (with "dpid" and "group_id" or "meter_id").
  */
 
 struct FlowJob {
@@ -39,5 +158,15 @@ struct FlowJob {
     nlohmann::json actions;
 
     int idleTimeout = 0;
+
+    FlowLane lane = FlowLane::Normal;
+    std::optional<std::chrono::steady_clock::time_point> deadline{};
+
+    std::function<void(FlowJobOutcome)> onDone{};
+
+    utils::TraceId trace{};
+
+    FlowTarget target = FlowTarget::Flow;
+    nlohmann::json entry{};
 };
 
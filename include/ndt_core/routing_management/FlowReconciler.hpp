@@ -0,0 +1,94 @@
+#pragma once
+#include "common_types/SFlowType.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace ndtClassifier
+{
+class Classifier;
+}
+
+/**
+ * @brief Desired-state reconciliation of flow rules: an app states the rules it wants on a
+ *        switch, and only the difference to what the switch has is sent.
+ *
+ * Rules are of the shape sflow::FlowChange describes (eth_type 0x0800, an ipv4_dst prefix,
+ * a priority and one OUTPUT port). reconcile() reads the switch's current rules of that
+ * shape from the Classifier and diffs them with sflow::getFlowTableDiff(): desired rules the
+ * switch lacks are added, those with another port modified, and nothing else is sent.
+ *
+ * Each app submits under a namespace. A rule the switch has but the desired set lacks is only
+ * removed if the namespace owns it, i.e. listed it in an earlier reconcile() for the same
+ * switch, so apps sharing a switch do not delete each other's rules. Ownership is
+ * kept in memory: after a restart, rules an app dropped meanwhile stay until removed
+ * explicitly. A rule that was to be removed stays owned until the classifier no longer shows
+ * it, so a failed delete is retried by the next reconcile().
+ *
+ * The classifier follows the applied jobs through Classifier::applyFlowMods() and the table
+ * polls; a reconcile() racing jobs still queued may send some of them again, which is
+ * harmless as adds and strict deletes are idempotent.
+ *
+ * Thread-safe; reconciles run one at a time.
+ */
+class FlowReconciler
+{
+  public:
+    /// @param classifier Source of the switches' current rules; null means none are known.
+    explicit FlowReconciler(std::shared_ptr<ndtClassifier::Classifier> classifier);
+
+    /**
+     * @brief The rule of a desired-set entry: {"priority", "match": {"eth_type": 2048,
+     *        "ipv4_dst": "a.b.c.d[/len|/mask]"}, "actions": [{"type": "OUTPUT", "port": n}]}
+     *        (dl_type and nw_dst also accepted), as a FlowChange adding it.
+     *
+     * @throws std::invalid_argument for anything a FlowChange cannot stand for.
+     */
+    static sflow::FlowChange parseEntry(const nlohmann::json& entry);
+
+    /**
+     * @brief The flow batch carrying out @p diffs, as POST
+     *        /ndt/install_flow_entries_modify_flow_entries_and_delete_flow_entries takes it:
+     *        added and modified rules under "install_flow_entries" (an add replaces the rule
+     *        with the same match and priority), removed ones under "delete_flow_entries" with
+     *        their priority, so they are deleted strictly.
+     */
+    static nlohmann::json toFlowBatch(const std::vector<sflow::FlowDiff>& diffs);
+
+    /**
+     * @brief Diff @p desired, the full rule set of namespace @p ns on switch @p dpid, against
+     *        the switch's table 0 and take ownership of it (flow jobs only go to table 0).
+     *
+     * @param[out] unchanged Desired rules the switch already has.
+     * @return The delta; empty lists if the switch is already as desired.
+     */
+    sflow::FlowDiff reconcile(const std::string& ns,
+                              uint64_t dpid,
+                              const std::vector<sflow::FlowChange>& desired,
+                              size_t& unchanged);
+
+    /// {"namespaces", "owned_rules", "reconciles", "desired_rules", "added", "modified",
+    ///  "removed", "unchanged"}
+    nlohmann::json statsJson() const;
+
+  private:
+    using Scope = std::pair<std::string, uint64_t>; // (namespace, dpid)
+    using RuleSet = std::unordered_set<sflow::Key, sflow::KeyHash>; // (net, mask, priority)
+
+    std::shared_ptr<ndtClassifier::Classifier> m_classifier;
+
+    mutable std::mutex m_mutex; // guards everything below
+    std::map<Scope, RuleSet> m_owned;
+    uint64_t m_reconciles = 0;
+    uint64_t m_desired = 0;
+    uint64_t m_added = 0;
+    uint64_t m_modified = 0;
+    uint64_t m_removed = 0;
+    uint64_t m_unchanged = 0;
+};
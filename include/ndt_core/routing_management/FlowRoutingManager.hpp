@@ -6,7 +6,9 @@
 #include <optional>                   // for optional
 #include <stdint.h>                   // for uint64_t
 #include <string>                     // for string
+#include <vector>                     // for vector
 class EventBus;                       // lines 44-44
+class OpenFlowChannel;
 class TopologyAndFlowMonitor;         // lines 36-36
 
 namespace sflow
@@ -14,6 +16,7 @@ namespace sflow
 class FlowLinkUsageCollector;
 } // namespace sflow
 struct FlowAddedEventPayload;
+struct FlowJob;
 
 using json = nlohmann::json;
 using namespace std;
@@ -66,7 +69,7 @@ class FlowRoutingManager
      * @param match    Flow match fields in JSON format (e.g., eth_type, ipv4_dst).
      * @param priority Rule priority. Use -1 to perform non-strict delete.
      *
-     * @note This function calls the local controller REST API via curl.
+     * @note This function calls the local controller REST API through utils::HttpClient.
      */
     void deleteAnEntry(uint64_t dpid, json match, int priority = -1);
     /**
@@ -89,6 +92,33 @@ class FlowRoutingManager
      */
     void modifyAnEntry(uint64_t dpid, int priority, json match, json action);
 
+    /**
+     * @brief Apply a burst of flow jobs for one switch, in order, as a single pipelined
+     *        sequence of Ryu REST calls on one connection.
+     *
+     * Group and meter jobs go to /stats/groupentry and /stats/meterentry, flow jobs to
+     * /stats/flowentry.
+     *
+     * Ryu's REST API has no barrier call. With @p barrier set, a description stats request
+     * (GET /stats/desc/<dpid>) follows the flow-mods; Ryu answers it once the switch replied,
+     * which, for switches handling messages in order such as Open vSwitch, is after the
+     * flow-mods took effect. If the barrier fails, every job is reported as failed.
+     *
+     * With an OpenFlow channel set (setOpenFlowChannel()), the burst goes to the switch over
+     * it instead, fenced by a real BARRIER_REQUEST, and only falls back to Ryu when the
+     * channel cannot take it.
+     *
+     * @param jobs    Jobs, all with the same dpid.
+     * @param barrier Wait until the switch has processed the flow-mods.
+     * @return Whether each job was accepted, in the order of @p jobs.
+     */
+    std::vector<bool> applyFlowJobs(const std::vector<FlowJob>& jobs, bool barrier);
+
+    /// Push flow-mod bursts over @p channel, Ryu's REST API remaining the fallback.
+    void setOpenFlowChannel(std::shared_ptr<OpenFlowChannel> channel);
+    /// OpenFlowChannel::statsJson() of the channel, or null without one.
+    json openFlowStatsJson() const;
+
     /**
      * @brief Install a group entry.
      *
@@ -128,8 +158,15 @@ class FlowRoutingManager
     void modifyAMeterEntry(json j);
 
   private:
+    /**
+     * @brief POST @p body to the Ryu REST API at @p path (e.g. "/stats/flowentry/add") and
+     *        wait for the answer, logging it when the request fails.
+     */
+    void postToRyu(const std::string& path, const json& body);
+
     std::shared_ptr<EventBus> m_eventBus;
 
     std::shared_ptr<TopologyAndFlowMonitor> m_topologyAndFlowMonitor;
     std::shared_ptr<sflow::FlowLinkUsageCollector> m_flowLinkUsageCollector;
+    std::shared_ptr<OpenFlowChannel> m_openFlowChannel; // set before the dispatcher starts
 };
\ No newline at end of file
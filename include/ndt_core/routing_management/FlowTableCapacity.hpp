@@ -0,0 +1,102 @@
+#pragma once
+#include "ndt_core/routing_management/FlowJob.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define FLOW_CAPACITY_HEADROOM_PERCENT 95 // share of a switch's flow table admission may fill
+
+/**
+ * @brief Flow table occupancy of each switch, checked before flow batches are queued.
+ *
+ * A switch's occupancy is the entries it holds (the Classifier's rule count of it) plus the
+ * installs admitted but not yet reported by the dispatcher. A batch whose installs, net of its
+ * strict deletes, would take any switch past its headroom share of the table is refused as a
+ * whole, before anything is queued, with a hint per switch: how many entries to free, and that
+ * entries of lower priority than the batch's installs there are the ones to go.
+ *
+ * Table sizes come from the limit source, asked the first time a switch is seen (and again
+ * while it does not know the switch); a switch of unknown size is never refused. Admitted jobs
+ * keep their reservation until their onDone reports them.
+ *
+ * Thread-safe.
+ */
+class FlowTableCapacity
+{
+  public:
+    /// Entries a switch holds now.
+    using CountFn = std::function<size_t(uint64_t dpid)>;
+    /// Flow entries a switch can hold over all its tables; nullopt if not known.
+    using LimitFn = std::function<std::optional<size_t>(uint64_t dpid)>;
+
+    /// A switch that cannot take a batch.
+    struct Rejection
+    {
+        uint64_t dpid;
+        size_t limit;      // headroom share of the table
+        size_t installed;  // entries it holds
+        size_t pending;    // admitted installs not reported yet
+        size_t requested;  // net new entries of the batch
+        int belowPriority; // lowest install priority of the batch on this switch
+
+        /// {"dpid", "limit", "installed", "pending", "requested",
+        ///  "evict_hint": {"entries", "below_priority"}}
+        nlohmann::json toJson() const;
+    };
+
+    explicit FlowTableCapacity(CountFn installed);
+
+    /// Not synchronized with admit(): set it before serving requests.
+    void setLimitSource(LimitFn limit);
+
+    /// Percentage (1-100) of a table admission fills. Thread-safe.
+    void setHeadroom(unsigned percent);
+
+    /**
+     * @brief Reserve room for @p jobs, wrapping the onDone of those that add or remove an
+     *        entry to give it back; or, if a switch lacks room, reserve nothing and return
+     *        every such switch.
+     */
+    std::vector<Rejection> admit(std::vector<FlowJob>& jobs);
+
+    /**
+     * @brief Flow table sizes per switch model, the sum of the "max_entries" of its "tables",
+     *        from a document like doc/OpenflowCapacity.json.
+     */
+    static std::unordered_map<std::string, size_t> tableSizesByModel(
+        const nlohmann::json& capacity);
+
+    /// {"headroom_percent", "admitted_batches", "rejected_batches", "rejected_jobs",
+    ///  "switches": [{"dpid", "limit", "installed", "pending"}]}
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Switch
+    {
+        std::optional<size_t> table; // entries over all tables, once known
+        std::atomic<int64_t> pending{0};
+    };
+
+    // The entry of @p dpid, created and sized on first use (m_mutex held)
+    Switch& switchFor(uint64_t dpid);
+    size_t limitOf(const Switch& sw) const;
+
+    CountFn m_installed;
+    LimitFn m_limit;
+    std::atomic<unsigned> m_headroom{FLOW_CAPACITY_HEADROOM_PERCENT};
+
+    mutable std::mutex m_mutex;
+    // Entries are never removed, so the onDone hooks may keep pointers to them
+    std::unordered_map<uint64_t, std::unique_ptr<Switch>> m_switches;
+    std::atomic<uint64_t> m_admitted{0};
+    std::atomic<uint64_t> m_rejected{0};
+    std::atomic<uint64_t> m_rejectedJobs{0};
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>            // for atomic
+#include <chrono>            // for steady_clock
+#include <cstdint>           // for uint32_t, uint64_t
+#include <memory>            // for unique_ptr
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <optional>          // for optional
+#include <string>            // for string
+#include <unordered_map>     // for unordered_map
+#include <vector>            // for vector
+
+struct FlowJob;
+
+#define OPENFLOW_CONNECT_TIMEOUT_MS 1000 // connecting plus the HELLO and FEATURES handshake
+#define OPENFLOW_BARRIER_TIMEOUT_MS 5000 // wait for the BARRIER_REPLY closing a burst
+#define OPENFLOW_RETRY_MS 10000          // an unreachable switch goes through Ryu this long
+
+/**
+ * @brief The OpenFlow 1.3 FLOW_MOD applying @p job, with transaction id @p xid.
+ *
+ * The match and actions are read as Ryu's /stats/flowentry takes them. Supported match
+ * fields: in_port, metadata, eth_src/dl_src, eth_dst/dl_dst, eth_type/dl_type, vlan_vid,
+ * ip_proto/nw_proto, ipv4_src/nw_src, ipv4_dst/nw_dst (with a prefix length or mask),
+ * tcp_*, udp_* and tp_src/tp_dst. Supported actions: OUTPUT, GROUP and GOTO_TABLE.
+ *
+ * @return The encoded message, or nullopt if the job uses anything else or is a group or
+ *         meter job.
+ */
+std::optional<std::string> encodeFlowMod(const FlowJob& job, uint32_t xid);
+
+/**
+ * @brief Direct OpenFlow 1.3 connections to the switches, for pushing flow-mods without
+ *        going through Ryu's REST API.
+ *
+ * Open vSwitch serves extra OpenFlow connections next to its controller's, the same ones
+ * ovs-ofctl uses: a unix socket per bridge (/var/run/openvswitch/<bridge>.mgmt) or a
+ * "ptcp:" listener set with ovs-vsctl set-controller. The channel connects to each switch on
+ * first use at the endpoint made from a template, "unix:<path>" or "tcp:<host>:<port>" with
+ * {dpid} replaced by the switch's decimal datapath id, and checks the FEATURES_REPLY is
+ * from that switch.
+ *
+ * apply() writes a burst of binary FLOW_MODs back to back and, when fenced, one
+ * BARRIER_REQUEST after them; the switch answers it once it processed every flow-mod, and an
+ * ERROR carrying a flow-mod's xid marks that job failed. Ryu still owns the switches: it
+ * keeps its own connection and receives the switch's events.
+ *
+ * A switch that cannot be reached, or a burst using anything encodeFlowMod() does not
+ * support, is left to the caller (nullopt) to send through Ryu; an unreachable switch is
+ * retried after OPENFLOW_RETRY_MS. Bursts of different switches run concurrently, those of
+ * one switch in turn.
+ */
+class OpenFlowChannel
+{
+  public:
+    explicit OpenFlowChannel(std::string endpointTemplate);
+    ~OpenFlowChannel();
+
+    OpenFlowChannel(const OpenFlowChannel&) = delete;
+    OpenFlowChannel& operator=(const OpenFlowChannel&) = delete;
+
+    /**
+     * @brief Apply @p jobs, all of one switch, in order.
+     *
+     * @param barrier Wait until the switch has processed the flow-mods; without it every
+     *        job the switch was sent counts as applied, and errors are only logged later.
+     * @return Whether each job was applied, in the order of @p jobs; nullopt if nothing was
+     *         sent and the caller should use Ryu instead.
+     */
+    std::optional<std::vector<bool>> apply(const std::vector<FlowJob>& jobs, bool barrier);
+
+    /// {"endpoint", "switches": {dpid: {"connected", "flow_mods", "errors"}}}
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Connection
+    {
+        std::mutex mutex; // one burst at a time
+        int fd = -1;
+        uint32_t nextXid = 1;
+        std::string pending; // bytes read but not yet a whole message
+        std::chrono::steady_clock::time_point retryAt{};
+        std::atomic<bool> connected{false};
+        std::atomic<uint64_t> flowMods{0}; // sent
+        std::atomic<uint64_t> errors{0};   // ERROR replies to them
+    };
+
+    enum class ReadResult
+    {
+        Message,
+        Timeout,
+        Closed
+    };
+
+    Connection& connectionFor(uint64_t dpid);
+    // Connect and handshake (caller holds connection.mutex)
+    bool connectNoLock(Connection& connection, uint64_t dpid);
+    void closeNoLock(Connection& connection);
+    bool sendAllNoLock(Connection& connection, const std::string& bytes);
+    /**
+     * Read the next whole message into @p message, answering echo requests on the way. A zero
+     * @p timeout only takes what has already arrived.
+     */
+    ReadResult readMessageNoLock(Connection& connection,
+                                 std::string& message,
+                                 std::chrono::milliseconds timeout);
+    // Handle what the switch sent since the last burst; false if it closed the connection
+    bool drainNoLock(Connection& connection, uint64_t dpid);
+
+    const std::string m_endpointTemplate;
+    mutable std::mutex m_mutex; // guards m_connections (not the connections)
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> m_connections;
+};
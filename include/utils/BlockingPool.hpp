@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>                      // for atomic
+#include <boost/asio/thread_pool.hpp>  // for thread_pool
+#include <chrono>                      // for steady_clock
+#include <cstdint>                     // for uint64_t
+#include <functional>                  // for function
+#include <nlohmann/json.hpp>           // for json
+
+#define BLOCKING_POOL_THREADS 4      // threads running blocking work
+#define BLOCKING_POOL_MAX_QUEUED 256 // tryPost() refuses work while this many tasks wait
+
+namespace utils
+{
+
+/**
+ * @brief Process-wide pool of threads for work that blocks (controller and plug calls, the
+ *        LLM, file reads), so it doesn't hold up the Asio I/O threads of the NDT server.
+ *
+ * tryPost() is bounded: when BLOCKING_POOL_MAX_QUEUED tasks are already waiting it refuses
+ * the work and the caller answers "busy" instead of queueing without limit. post() always
+ * queues, for work that was already promised.
+ *
+ * An exception thrown by a task is logged and dropped.
+ */
+class BlockingPool
+{
+  public:
+    static BlockingPool& instance();
+
+    BlockingPool(const BlockingPool&) = delete;
+    BlockingPool& operator=(const BlockingPool&) = delete;
+    ~BlockingPool();
+
+    /// Queue @p work unless the queue is full; returns whether it was queued.
+    bool tryPost(std::function<void()> work);
+
+    /// Queue @p work whatever the queue length.
+    void post(std::function<void()> work);
+
+    /**
+     * @brief {"threads", "queued", "running", "completed", "rejected", "mean_wait_ms",
+     *        "max_wait_ms", "mean_run_ms", "max_run_ms"}; wait is the time a task spent
+     *        queued, run the time it took.
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    BlockingPool();
+
+    void run(const std::function<void()>& work, std::chrono::steady_clock::time_point queuedAt);
+
+    boost::asio::thread_pool m_pool;
+
+    std::atomic<uint64_t> m_queued{0};
+    std::atomic<uint64_t> m_running{0};
+    std::atomic<uint64_t> m_completed{0};
+    std::atomic<uint64_t> m_rejected{0};
+    std::atomic<uint64_t> m_waitNs{0};
+    std::atomic<uint64_t> m_maxWaitNs{0};
+    std::atomic<uint64_t> m_runNs{0};
+    std::atomic<uint64_t> m_maxRunNs{0};
+};
+
+} // namespace utils
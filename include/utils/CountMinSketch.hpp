@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm> // for min
+#include <cstddef>   // for size_t
+#include <cstdint>   // for uint32_t, uint64_t
+#include <limits>    // for numeric_limits
+#include <vector>    // for vector
+
+namespace utils
+{
+
+/**
+ * @brief Count-Min sketch: approximate per-key totals in fixed memory, whatever the number of
+ *        keys.
+ *
+ * Each of @c depth rows holds @c width counters and a key maps to one counter per row, picked
+ * from its 64-bit hash by double hashing. The estimate of a key is the smallest of its
+ * counters, so it never undercounts; it overcounts by keys colliding in every row, at most
+ * about total / width with high probability. add() updates conservatively (raises only the
+ * counters below the new estimate), which keeps the overcount of light keys low.
+ *
+ * decay() halves every counter, so totals describe recent traffic rather than all of it.
+ * Counters saturate instead of wrapping.
+ *
+ * Not thread-safe: callers serialize access.
+ */
+class CountMinSketch
+{
+  public:
+    /// @p width is rounded up to a power of two.
+    CountMinSketch(size_t width, size_t depth)
+        : m_depth(depth)
+    {
+        size_t rounded = 1;
+        while (rounded < width)
+        {
+            rounded <<= 1;
+        }
+        m_mask = rounded - 1;
+        m_counters.assign(rounded * depth, 0);
+    }
+
+    /// Add @p amount to the key with hash @p hash and return its new estimate.
+    uint32_t add(uint64_t hash, uint32_t amount)
+    {
+        const uint32_t current = estimate(hash);
+        const uint64_t wanted = uint64_t(current) + amount;
+        const uint32_t target = static_cast<uint32_t>(
+            std::min<uint64_t>(wanted, std::numeric_limits<uint32_t>::max()));
+        for (size_t row = 0; row < m_depth; ++row)
+        {
+            uint32_t& counter = m_counters[index(hash, row)];
+            if (counter < target)
+            {
+                counter = target;
+            }
+        }
+        return target;
+    }
+
+    uint32_t estimate(uint64_t hash) const
+    {
+        uint32_t result = std::numeric_limits<uint32_t>::max();
+        for (size_t row = 0; row < m_depth; ++row)
+        {
+            result = std::min(result, m_counters[index(hash, row)]);
+        }
+        return result;
+    }
+
+    void decay()
+    {
+        for (auto& counter : m_counters)
+        {
+            counter >>= 1;
+        }
+    }
+
+    size_t memoryBytes() const
+    {
+        return m_counters.size() * sizeof(uint32_t);
+    }
+
+  private:
+    size_t index(uint64_t hash, size_t row) const
+    {
+        // Kirsch-Mitzenmacher: h1 + row * h2 behaves like independent hashes per row
+        const uint64_t h1 = hash;
+        const uint64_t h2 = (hash >> 32) | 1;
+        return row * (m_mask + 1) + static_cast<size_t>((h1 + row * h2) & m_mask);
+    }
+
+    size_t m_depth;
+    size_t m_mask = 0;
+    std::vector<uint32_t> m_counters; // depth rows of width counters
+};
+
+} // namespace utils
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint32_t, uint64_t
+
+namespace utils
+{
+
+/**
+ * @brief out[i] = ((current[i] - previous[i]) << shift) * samplingRate[i] for i < n, wrapping
+ *        modulo 2^64 like the scalar expression.
+ *
+ * The rate tick runs it over the struct-of-arrays counter slots of a whole flow table shard
+ * (shift 3 turns byte counts into bits). On CPUs with AVX2, checked once at the first call,
+ * four slots are computed per instruction; a scalar loop serves the others. The arrays may
+ * not overlap @p out.
+ */
+void counterRates(const uint64_t* current,
+                  const uint64_t* previous,
+                  const uint32_t* samplingRate,
+                  unsigned shift,
+                  uint64_t* out,
+                  size_t n);
+
+/// Whether counterRates() takes the AVX2 path on this CPU.
+bool counterRatesVectorized();
+
+} // namespace utils
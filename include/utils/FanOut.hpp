@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>      // for milliseconds
+#include <cstddef>     // for size_t
+#include <functional>  // for function
+#include <string_view> // for string_view
+
+#define FAN_OUT_MAX_CONCURRENCY 16  // targets of one fan-out worked on at once
+#define FAN_OUT_SLOW_TARGET_MS 5000 // a target taking longer is logged
+
+namespace utils
+{
+
+/**
+ * @brief Runs @p task(i) for every i in [0, @p count) with up to @p maxConcurrency of them at
+ *        once, and returns when all have finished.
+ *
+ * For per-switch polls whose calls block (ping, SSH, a synchronous client call): the cycle
+ * then takes about as long as its slowest switch instead of the sum over all switches. The
+ * calling thread takes part, and the extra threads live only for the call. Each task bounds
+ * its own time (ping -W, client timeouts); one that still exceeds @p slowTarget is logged
+ * under @p name, as is an exception it throws, which does not stop the other tasks.
+ */
+void fanOut(std::string_view name,
+            size_t count,
+            const std::function<void(size_t)>& task,
+            size_t maxConcurrency = FAN_OUT_MAX_CONCURRENCY,
+            std::chrono::milliseconds slowTarget =
+                std::chrono::milliseconds(FAN_OUT_SLOW_TARGET_MS));
+
+} // namespace utils
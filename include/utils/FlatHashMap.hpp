@@ -0,0 +1,456 @@
+#pragma once
+
+#include <cstddef>     // for size_t
+#include <cstdint>     // for int8_t, uint8_t
+#include <functional>  // for equal_to, hash
+#include <iterator>    // for forward_iterator_tag
+#include <memory>      // for allocator, allocator_traits
+#include <new>         // for placement new
+#include <tuple>       // for forward_as_tuple
+#include <type_traits> // for conditional_t
+#include <utility>     // for pair, move, forward, piecewise_construct
+
+namespace utils
+{
+
+/**
+ * @brief Open-addressing hash map with one control byte per slot (Swiss-table layout).
+ *
+ * Slots live in a single contiguous array, so a lookup touches the control byte array and
+ * at most a few neighbouring slots instead of chasing per-node pointers. Each control byte
+ * holds 7 bits of the hash (so most mismatches are rejected without touching the slot) or
+ * marks the slot empty / deleted. Probing is linear; the table grows at 7/8 occupancy.
+ *
+ * Differences from std::unordered_map that callers should know about:
+ *  - Insertion may rehash and move every element: pointers/references/iterators are
+ *    invalidated by try_emplace()/operator[] (but not by erase()).
+ *  - erase() leaves a tombstone and never moves other elements, so erasing while iterating
+ *    (it = map.erase(it)) is safe.
+ *  - value_type is std::pair<K, V>; callers must not modify the key through an iterator.
+ *
+ * @tparam Hash Should spread entropy into all 64 bits; the low bits pick the slot and the
+ *              top 7 bits are stored in the control byte.
+ * @tparam Alloc Stateless allocator of the slot and control byte arrays (e.g.
+ *               PolicyAllocator, for tables that belong in huge pages).
+ */
+template <typename K,
+          typename V,
+          typename Hash = std::hash<K>,
+          typename Eq = std::equal_to<K>,
+          typename Alloc = std::allocator<std::pair<K, V>>>
+class FlatHashMap
+{
+  public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using size_type = size_t;
+
+    template <bool Const>
+    class Iterator
+    {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using MapPtr = std::conditional_t<Const, const FlatHashMap*, FlatHashMap*>;
+
+        Iterator() = default;
+
+        Iterator(MapPtr map, size_t index)
+            : m_map(map),
+              m_index(index)
+        {
+            skipToFull();
+        }
+
+        // iterator -> const_iterator
+        operator Iterator<true>() const
+        {
+            return Iterator<true>(m_map, m_index);
+        }
+
+        reference operator*() const
+        {
+            return m_map->m_slots[m_index];
+        }
+
+        pointer operator->() const
+        {
+            return &m_map->m_slots[m_index];
+        }
+
+        Iterator& operator++()
+        {
+            ++m_index;
+            skipToFull();
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return m_index == other.m_index;
+        }
+
+        size_t index() const
+        {
+            return m_index;
+        }
+
+      private:
+        void skipToFull()
+        {
+            while (m_index < m_map->m_capacity && !isFull(m_map->m_ctrl[m_index]))
+            {
+                ++m_index;
+            }
+        }
+
+        MapPtr m_map = nullptr;
+        size_t m_index = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatHashMap() = default;
+
+    FlatHashMap(const FlatHashMap& other)
+    {
+        reserve(other.m_size);
+        for (const auto& kv : other)
+        {
+            try_emplace(kv.first, kv.second);
+        }
+    }
+
+    FlatHashMap(FlatHashMap&& other) noexcept
+    {
+        swap(other);
+    }
+
+    FlatHashMap& operator=(FlatHashMap other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHashMap()
+    {
+        destroyAll();
+        deallocate();
+    }
+
+    void swap(FlatHashMap& other) noexcept
+    {
+        std::swap(m_ctrl, other.m_ctrl);
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_deleted, other.m_deleted);
+    }
+
+    iterator begin()
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end()
+    {
+        return iterator(this, m_capacity);
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, m_capacity);
+    }
+
+    /**
+     * @brief First element in slot @p slot or after it, end() if none; with
+     *        iterator::index() a caller can resume a sweep over the slots where it left off.
+     */
+    iterator fromSlot(size_t slot)
+    {
+        return iterator(this, slot < m_capacity ? slot : m_capacity);
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    /**
+     * @brief Number of slots currently allocated (always a power of two, or 0).
+     */
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    void clear()
+    {
+        destroyAll();
+        for (size_t i = 0; i < m_capacity; ++i)
+        {
+            m_ctrl[i] = CTRL_EMPTY;
+        }
+        m_size = 0;
+        m_deleted = 0;
+    }
+
+    void reserve(size_t n)
+    {
+        size_t needed = MIN_CAPACITY;
+        while (needed * 7 / 8 <= n)
+        {
+            needed <<= 1;
+        }
+        if (needed > m_capacity)
+        {
+            rehash(needed);
+        }
+    }
+
+    /**
+     * @brief Rehash into the fewest slots that hold the current elements (MIN_CAPACITY at
+     *        least), if that is fewer than now. Invalidates iterators like an insertion.
+     */
+    void shrink_to_fit()
+    {
+        size_t needed = MIN_CAPACITY;
+        while (needed * 7 / 8 <= m_size)
+        {
+            needed <<= 1;
+        }
+        if (needed < m_capacity)
+        {
+            rehash(needed);
+        }
+    }
+
+    iterator find(const K& key)
+    {
+        return iterator(this, findIndex(key));
+    }
+
+    const_iterator find(const K& key) const
+    {
+        return const_iterator(this, findIndex(key));
+    }
+
+    size_t count(const K& key) const
+    {
+        return findIndex(key) != m_capacity ? 1 : 0;
+    }
+
+    bool contains(const K& key) const
+    {
+        return count(key) != 0;
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args)
+    {
+        const size_t hash = Hash{}(key);
+        size_t found = findIndex(key, hash);
+        if (found != m_capacity)
+        {
+            return {iterator(this, found), false};
+        }
+
+        if ((m_size + m_deleted + 1) * 8 > m_capacity * 7)
+        {
+            // Grow when genuinely full; otherwise just flush tombstones
+            rehash(m_capacity == 0 ? MIN_CAPACITY
+                                   : (m_size * 2 >= m_capacity ? m_capacity * 2 : m_capacity));
+        }
+
+        size_t idx = hash & (m_capacity - 1);
+        while (isFull(m_ctrl[idx]))
+        {
+            idx = (idx + 1) & (m_capacity - 1);
+        }
+        if (m_ctrl[idx] == CTRL_DELETED)
+        {
+            --m_deleted;
+        }
+        ::new (static_cast<void*>(&m_slots[idx]))
+            value_type(std::piecewise_construct,
+                       std::forward_as_tuple(key),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+        m_ctrl[idx] = h2(hash);
+        ++m_size;
+        return {iterator(this, idx), true};
+    }
+
+    V& operator[](const K& key)
+    {
+        return try_emplace(key).first->second;
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        size_t idx = pos.index();
+        m_slots[idx].~value_type();
+        --m_size;
+        // A slot followed by an empty one never sits inside a longer probe chain
+        if (m_ctrl[(idx + 1) & (m_capacity - 1)] == CTRL_EMPTY)
+        {
+            m_ctrl[idx] = CTRL_EMPTY;
+        }
+        else
+        {
+            m_ctrl[idx] = CTRL_DELETED;
+            ++m_deleted;
+        }
+        return iterator(this, idx + 1);
+    }
+
+    iterator erase(iterator pos)
+    {
+        return erase(const_iterator(pos));
+    }
+
+    size_t erase(const K& key)
+    {
+        size_t idx = findIndex(key);
+        if (idx == m_capacity)
+        {
+            return 0;
+        }
+        erase(const_iterator(this, idx));
+        return 1;
+    }
+
+  private:
+    static constexpr int8_t CTRL_EMPTY = -128;
+    static constexpr int8_t CTRL_DELETED = -2;
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    using SlotAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<value_type>;
+    using CtrlAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<int8_t>;
+
+    static bool isFull(int8_t c)
+    {
+        return c >= 0;
+    }
+
+    static int8_t h2(size_t hash)
+    {
+        return static_cast<int8_t>(hash >> (sizeof(size_t) * 8 - 7));
+    }
+
+    size_t findIndex(const K& key) const
+    {
+        return findIndex(key, Hash{}(key));
+    }
+
+    size_t findIndex(const K& key, size_t hash) const
+    {
+        if (m_capacity == 0)
+        {
+            return 0;
+        }
+        const int8_t tag = h2(hash);
+        size_t idx = hash & (m_capacity - 1);
+        // Load factor stays below 7/8, so an empty slot always terminates the probe
+        while (m_ctrl[idx] != CTRL_EMPTY)
+        {
+            if (m_ctrl[idx] == tag && Eq{}(m_slots[idx].first, key))
+            {
+                return idx;
+            }
+            idx = (idx + 1) & (m_capacity - 1);
+        }
+        return m_capacity;
+    }
+
+    void rehash(size_t newCapacity)
+    {
+        int8_t* oldCtrl = m_ctrl;
+        value_type* oldSlots = m_slots;
+        size_t oldCapacity = m_capacity;
+
+        m_ctrl = CtrlAlloc{}.allocate(newCapacity);
+        for (size_t i = 0; i < newCapacity; ++i)
+        {
+            m_ctrl[i] = CTRL_EMPTY;
+        }
+        m_slots = SlotAlloc{}.allocate(newCapacity);
+        m_capacity = newCapacity;
+        m_deleted = 0;
+
+        for (size_t i = 0; i < oldCapacity; ++i)
+        {
+            if (!isFull(oldCtrl[i]))
+            {
+                continue;
+            }
+            const size_t hash = Hash{}(oldSlots[i].first);
+            size_t idx = hash & (m_capacity - 1);
+            while (m_ctrl[idx] != CTRL_EMPTY)
+            {
+                idx = (idx + 1) & (m_capacity - 1);
+            }
+            ::new (static_cast<void*>(&m_slots[idx])) value_type(std::move(oldSlots[i]));
+            m_ctrl[idx] = h2(hash);
+            oldSlots[i].~value_type();
+        }
+
+        if (oldSlots != nullptr)
+        {
+            SlotAlloc{}.deallocate(oldSlots, oldCapacity);
+            CtrlAlloc{}.deallocate(oldCtrl, oldCapacity);
+        }
+    }
+
+    void destroyAll()
+    {
+        for (size_t i = 0; i < m_capacity; ++i)
+        {
+            if (isFull(m_ctrl[i]))
+            {
+                m_slots[i].~value_type();
+            }
+        }
+    }
+
+    void deallocate()
+    {
+        if (m_slots != nullptr)
+        {
+            SlotAlloc{}.deallocate(m_slots, m_capacity);
+            CtrlAlloc{}.deallocate(m_ctrl, m_capacity);
+            m_slots = nullptr;
+            m_ctrl = nullptr;
+        }
+        m_capacity = 0;
+    }
+
+    int8_t* m_ctrl = nullptr;
+    value_type* m_slots = nullptr;
+    size_t m_capacity = 0;
+    size_t m_size = 0;
+    size_t m_deleted = 0;
+};
+
+} // namespace utils
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>            // for atomic
+#include <cstddef>           // for size_t
+#include <cstdint>           // for uint64_t, int64_t
+#include <memory>            // for unique_ptr
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <optional>          // for optional
+#include <string>            // for string
+#include <string_view>       // for string_view
+#include <vector>            // for vector
+
+#define FLIGHT_RECORDER_RECORDS 4096    // default records kept per thread (192 KiB)
+#define FLIGHT_RECORDER_MAX_THREADS 256 // rings at most; later threads record nothing
+#define FLIGHT_RECORDER_DUMP_PATH "ndt_flight_recorder.bin" // crash dump, in the working dir
+
+namespace utils
+{
+
+/// What a FlightRecord describes; the meaning of its fields depends on it.
+enum class FlightRecordKind : uint8_t
+{
+    Sample,         // an sFlow sample decoded (code: 0 flow, 1 counter)
+    ClassifierMiss, // a classifier lookup that matched nothing (code: 0 no switch, 1 no rule)
+    FlowJob,        // a FlowJob sent to its switch (code: FlowOp)
+    Event           // an EventBus event (code: EventType)
+};
+
+/**
+ * @brief One fixed-size binary record, 48 bytes.
+ *
+ * | kind           | small                  | value      | words                               |
+ * | -------------- | ---------------------- | ---------- | ----------------------------------- |
+ * | Sample flow    | IP protocol            | agent IP   | src<<32 dst IP, sport<<16 dport,    |
+ * |                |                        |            | in<<32 out port, frame length       |
+ * | Sample counter |                        | agent IP   | ifIndex, in octets, out octets,     |
+ * |                |                        |            | ifStatus                            |
+ * | ClassifierMiss | IP protocol            | table id   | dpid, src<<32 dst IP,               |
+ * |                |                        |            | sport<<16 dport, in_port            |
+ * | FlowJob        | FlowTarget<<8 FlowLane | 1 if sent  | dpid, priority                      |
+ * | Event          | 0 emitted, 1 handled   |            | handler time in ns                  |
+ *
+ * Addresses are kept in the byte order their source has them (network order for samples,
+ * host order in the classifier); decode() prints both the way their source logs them.
+ */
+struct FlightRecord
+{
+    int64_t timeNs = 0; // CLOCK_MONOTONIC
+    FlightRecordKind kind = FlightRecordKind::Sample;
+    uint8_t code = 0;
+    uint16_t small = 0;
+    uint32_t value = 0;
+    uint64_t words[4] = {};
+};
+
+static_assert(sizeof(FlightRecord) == 48);
+
+/**
+ * @brief Always-on post-mortem record of the recent work of every thread: decoded sFlow
+ *        samples, classifier misses, FlowJobs sent and EventBus events.
+ *
+ * Each thread writes to a ring of its own, allocated on its first record, so recording takes
+ * no lock and costs a clock read and a 48-byte store. A ring keeps the thread's last
+ * configure()d number of records, the oldest overwritten. Rings of exited threads are kept
+ * (a crash often follows a thread's death) until FLIGHT_RECORDER_MAX_THREADS rings exist,
+ * then handed to new threads.
+ *
+ * dump() copies all rings into a binary image, which decode() turns into JSON; GET
+ * /ndt/debug/flight_recorder serves either. installCrashHandler() writes the same image to a
+ * file on SIGSEGV, SIGBUS, SIGILL, SIGFPE and SIGABRT, using only async-signal-safe calls;
+ * ndt_flight_dump decodes it.
+ *
+ * Records being overwritten while dump() runs are left out rather than read torn.
+ */
+class FlightRecorder
+{
+  public:
+    static FlightRecorder& instance();
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    /// Records kept per thread, rounded up to a power of two; 0 disables recording. Call
+    /// before any thread records.
+    void configure(size_t recordsPerThread);
+    bool enabled() const;
+
+    void record(FlightRecordKind kind,
+                uint8_t code,
+                uint16_t small,
+                uint32_t value,
+                uint64_t w0 = 0,
+                uint64_t w1 = 0,
+                uint64_t w2 = 0,
+                uint64_t w3 = 0);
+
+    void recordFlowSample(uint32_t agentIp,
+                          uint32_t srcIp,
+                          uint32_t dstIp,
+                          uint16_t srcPort,
+                          uint16_t dstPort,
+                          uint8_t protocol,
+                          uint32_t inputPort,
+                          uint32_t outputPort,
+                          uint32_t frameLength)
+    {
+        record(FlightRecordKind::Sample,
+               0,
+               protocol,
+               agentIp,
+               static_cast<uint64_t>(srcIp) << 32 | dstIp,
+               static_cast<uint64_t>(srcPort) << 16 | dstPort,
+               static_cast<uint64_t>(inputPort) << 32 | outputPort,
+               frameLength);
+    }
+
+    void recordCounterSample(uint32_t agentIp,
+                             uint32_t interfaceIndex,
+                             uint64_t inputOctets,
+                             uint64_t outputOctets,
+                             uint32_t interfaceStatus)
+    {
+        record(FlightRecordKind::Sample,
+               1,
+               0,
+               agentIp,
+               interfaceIndex,
+               inputOctets,
+               outputOctets,
+               interfaceStatus);
+    }
+
+    void recordClassifierMiss(bool switchKnown,
+                              uint64_t dpid,
+                              uint8_t tableId,
+                              uint32_t inPort,
+                              uint8_t protocol,
+                              uint32_t srcIp,
+                              uint32_t dstIp,
+                              uint16_t srcPort,
+                              uint16_t dstPort)
+    {
+        record(FlightRecordKind::ClassifierMiss,
+               switchKnown ? 1 : 0,
+               protocol,
+               tableId,
+               dpid,
+               static_cast<uint64_t>(srcIp) << 32 | dstIp,
+               static_cast<uint64_t>(srcPort) << 16 | dstPort,
+               inPort);
+    }
+
+    void recordFlowJob(
+        uint64_t dpid, uint8_t op, uint8_t target, uint8_t lane, int priority, bool sent)
+    {
+        record(FlightRecordKind::FlowJob,
+               op,
+               static_cast<uint16_t>(target << 8 | lane),
+               sent ? 1 : 0,
+               dpid,
+               static_cast<uint64_t>(static_cast<int64_t>(priority)));
+    }
+
+    void recordEvent(uint8_t type, bool handled, uint64_t handlerNs = 0)
+    {
+        record(FlightRecordKind::Event, type, handled ? 1 : 0, 0, handlerNs);
+    }
+
+    /**
+     * @brief Write dump()'s image to @p path when the process crashes, then let the signal
+     *        take its default action (a core dump, where enabled).
+     */
+    void installCrashHandler(const std::string& path);
+
+    /// Binary image of all rings: a header, then per ring its thread and records, oldest first.
+    std::string dump() const;
+
+    /**
+     * @brief dump()'s image as {"dumped_at_ns", "threads": [{"tid", "name", "live",
+     *        "records": [...]}]}, each record with "time_ns" (Unix), "kind" and its fields.
+     * @param kind Only records of this kind.
+     * @param limit The newest records at most per thread.
+     * @throws std::invalid_argument if @p image is not such an image.
+     */
+    static nlohmann::json decode(std::string_view image,
+                                 std::optional<FlightRecordKind> kind = std::nullopt,
+                                 size_t limit = SIZE_MAX);
+
+    /// "sample", "classifier_miss", "flow_job", "event"; nullopt for other names.
+    static std::optional<FlightRecordKind> kindFromName(std::string_view name);
+
+    struct Ring; // one thread's records
+
+  private:
+    FlightRecorder() = default;
+
+    Ring* attach();
+    // dump()'s image written to @p fd without allocating or locking, for the crash handler
+    void writeImage(int fd) const;
+    static void onCrash(int signal);
+
+    std::atomic<size_t> m_recordsPerThread{0};
+    std::mutex m_attachMutex; // taken by a thread's first record, and when it exits
+    std::atomic<Ring*> m_rings[FLIGHT_RECORDER_MAX_THREADS] = {};
+    std::atomic<size_t> m_ringCount{0};
+    std::vector<std::unique_ptr<Ring>> m_ringStorage; // under m_attachMutex
+    char m_crashPath[4096] = {};
+};
+
+} // namespace utils
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>          // for size_t
+#include <cstdint>          // for uint64_t
+#include <initializer_list> // for initializer_list
+#if defined(__SSE4_2__)
+#include <nmmintrin.h> // for _mm_crc32_u64
+#endif
+
+namespace utils
+{
+
+/**
+ * @brief Hash policies over a key packed into 64-bit words.
+ *
+ * A policy has `static uint64_t hash(const uint64_t* words, size_t count)`. The key hashes
+ * (sflow::FlowKeyHash, the classifier's KeyBytesHash, the topology index's pair hashes, ...)
+ * take one as a template parameter, defaulting to DefaultHashPolicy, and pack their fields
+ * into words themselves, so the policy never sees padding.
+ *
+ * Unlike boost-style hashCombine over std::hash<uint32_t> (the identity on libstdc++), each
+ * output bit depends on every input bit: sequential addresses and ports spread over the whole
+ * table, and the high bits FlatHashMap keeps as control tags are as good as the low ones.
+ */
+
+// GCC and Clang extension; __extension__ keeps -Wpedantic quiet about it
+__extension__ typedef unsigned __int128 uint128;
+
+/// High and low halves of the 128-bit product, folded (the "mum" step of wyhash).
+inline uint64_t
+mum(uint64_t a, uint64_t b) noexcept
+{
+    const uint128 product = static_cast<uint128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+/**
+ * @brief wyhash-style mixing: one 64x64->128 multiply per two words, then a final one.
+ *
+ * Portable and the same on every CPU, so it may back values that leave the process.
+ */
+struct WyHashPolicy
+{
+    static constexpr uint64_t P0 = 0xa0761d6478bd642fULL;
+    static constexpr uint64_t P1 = 0xe7037ed1a0b428dbULL;
+    static constexpr uint64_t P2 = 0x8ebc6af09c88c6e3ULL;
+    static constexpr uint64_t P3 = 0x589965cc75374cc3ULL;
+
+    static uint64_t hash(const uint64_t* words, size_t count) noexcept
+    {
+        uint64_t h = P0 ^ count;
+        size_t i = 0;
+        for (; i + 1 < count; i += 2)
+        {
+            h = mum(words[i] ^ P1 ^ h, words[i + 1] ^ P2);
+        }
+        if (i < count)
+        {
+            h = mum(words[i] ^ P1 ^ h, P3);
+        }
+        return mum(h ^ P0, count ^ P1);
+    }
+};
+
+#if defined(__SSE4_2__)
+/**
+ * @brief Two CRC32C lanes (one instruction per word each) finished by one multiply.
+ *
+ * Faster than WyHashPolicy on long keys where SSE4.2 is enabled at build time; the values
+ * differ from one build to another, so use it only for in-process tables.
+ */
+struct Crc32cHashPolicy
+{
+    static uint64_t hash(const uint64_t* words, size_t count) noexcept
+    {
+        uint64_t lo = 0xFFFFFFFFULL;
+        uint64_t hi = count;
+        for (size_t i = 0; i < count; ++i)
+        {
+            lo = _mm_crc32_u64(lo, words[i]);
+            hi = _mm_crc32_u64(hi, (words[i] >> 32) | (words[i] << 32));
+        }
+        return mum((lo << 32 | hi) ^ WyHashPolicy::P0, WyHashPolicy::P1);
+    }
+};
+#endif
+
+using DefaultHashPolicy = WyHashPolicy;
+
+/// Hash of @p words under @p Policy, e.g. hashWords({a, b}) for a two-word key.
+template <typename Policy = DefaultHashPolicy>
+inline size_t
+hashWords(std::initializer_list<uint64_t> words) noexcept
+{
+    return static_cast<size_t>(Policy::hash(words.begin(), words.size()));
+}
+
+} // namespace utils
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>             // for atomic
+#include <chrono>             // for steady_clock
+#include <condition_variable> // for condition_variable
+#include <cstddef>            // for size_t
+#include <cstdint>            // for uint64_t
+#include <memory>             // for shared_ptr
+#include <mutex>              // for mutex
+#include <nlohmann/json.hpp>  // for json
+#include <string>             // for string
+#include <thread>             // for thread
+#include <vector>             // for vector
+
+#define HISTORY_WRITER_COMMIT_MS 200          // records are gathered this long into one commit
+#define HISTORY_WRITER_COMMIT_BYTES (1 << 20) // ... or until this much is queued
+#define HISTORY_WRITER_SYNC_MS 5000           // a file written to is fdatasync'ed this often
+#define HISTORY_WRITER_QUEUE_BYTES (64 << 20) // beyond this much queued, records are refused
+
+namespace utils
+{
+
+/**
+ * @brief A file appended to through HistoryWriter; the descriptor is closed with the last
+ *        reference, once the writer is done with it.
+ */
+class HistoryFile
+{
+  public:
+    /// Take @p fd, opened for appending to @p path.
+    HistoryFile(int fd, std::string path);
+    ~HistoryFile();
+
+    HistoryFile(const HistoryFile&) = delete;
+    HistoryFile& operator=(const HistoryFile&) = delete;
+
+    const std::string& path() const
+    {
+        return m_path;
+    }
+
+    /**
+     * @brief Whether a record for the file was refused or failed to be written. Its records
+     *        not written yet are dropped then, so the file ends at a record boundary; its
+     *        producer opens it again (after HistoryWriter::flush()) to carry on.
+     */
+    bool failed() const
+    {
+        return m_failed.load(std::memory_order_acquire);
+    }
+
+  private:
+    friend class HistoryWriter;
+
+    int m_fd;
+    std::string m_path;
+    std::atomic<bool> m_failed{false};
+    bool m_dirty = false; // writer thread: written since its last fdatasync
+};
+
+/**
+ * @brief The one thread that appends the historical records (link history samples and their
+ *        index, flow record segments) to disk.
+ *
+ * Producers submit() the encoded bytes of a record and go on; the writer gathers what arrives
+ * within HISTORY_WRITER_COMMIT_MS and commits it with one write() per file, the records of a
+ * file concatenated in the order they were submitted and the files in the order they first
+ * appear, so a record submitted after another one is never on disk before it. Each file
+ * written to is fdatasync'ed at most every HISTORY_WRITER_SYNC_MS, and at flush().
+ *
+ * While logging is disabled (setEnabled(false), see POST /ndt/historical_logging) records are
+ * refused, as they are when more than HISTORY_WRITER_QUEUE_BYTES wait; a refused record fails
+ * its file. Thread-safe.
+ */
+class HistoryWriter
+{
+  public:
+    static HistoryWriter& instance();
+
+    HistoryWriter(const HistoryWriter&) = delete;
+    HistoryWriter& operator=(const HistoryWriter&) = delete;
+    ~HistoryWriter();
+
+    /// Queue @p bytes to be appended to @p file; false, failing the file, if refused.
+    bool submit(const std::shared_ptr<HistoryFile>& file, std::string bytes);
+
+    /// Commit and fdatasync everything submitted before the call, then return.
+    void flush();
+
+    /// Flush, then end the writer thread; later records are refused.
+    void stop();
+
+    void setEnabled(bool enable);
+
+    bool enabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief {"enabled", "queued_bytes", "submitted", "refused", "commits", "writes",
+     *        "bytes", "syncs", "errors", "max_commit_ms"}
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Record
+    {
+        std::shared_ptr<HistoryFile> file;
+        std::string bytes;
+    };
+
+    HistoryWriter();
+
+    void run();
+    // Append @p records, gathered in one commit
+    void commit(std::vector<Record>& records);
+    // fdatasync the files written since their last one (all of them if @p all)
+    void sync(bool all);
+    void refuse(HistoryFile& file);
+
+    std::atomic<bool> m_enabled{true};
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeCv; // a commit is due, or stopping
+    std::condition_variable m_doneCv; // a flush completed
+    std::vector<Record> m_queue;
+    size_t m_queuedBytes = 0;
+    uint64_t m_submittedSeq = 0; // records accepted so far
+    uint64_t m_syncedSeq = 0;    // of which committed and fdatasync'ed by a flush
+    bool m_flushWanted = false;
+    bool m_running = true;
+
+    // Writer thread: files written to since their last fdatasync
+    std::vector<std::shared_ptr<HistoryFile>> m_unsynced;
+    std::chrono::steady_clock::time_point m_lastSync;
+
+    std::atomic<uint64_t> m_refused{0};
+    std::atomic<uint64_t> m_commits{0};
+    std::atomic<uint64_t> m_writes{0};
+    std::atomic<uint64_t> m_bytes{0};
+    std::atomic<uint64_t> m_syncs{0};
+    std::atomic<uint64_t> m_errors{0};
+    std::atomic<uint64_t> m_maxCommitNs{0};
+
+    std::thread m_thread; // last: started once the rest is constructed
+};
+
+} // namespace utils
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>                              // for atomic
+#include <boost/asio/executor_work_guard.hpp>  // for executor_work_guard
+#include <boost/asio/io_context.hpp>           // for io_context
+#include <boost/beast/core/tcp_stream.hpp>     // for tcp_stream
+#include <boost/beast/http/verb.hpp>           // for verb
+#include <boost/system/error_code.hpp>         // for error_code
+#include <chrono>                              // for milliseconds
+#include <cstdint>                             // for uint64_t
+#include <deque>                               // for deque
+#include <functional>                          // for function
+#include <future>                              // for future
+#include <memory>                              // for shared_ptr, unique_ptr
+#include <mutex>                               // for mutex
+#include <nlohmann/json.hpp>                   // for json
+#include <string>                              // for string
+#include <thread>                              // for thread
+#include <unordered_map>                       // for unordered_map
+#include <utility>                             // for pair
+#include <vector>                              // for vector
+
+#define HTTP_CLIENT_THREADS 2                       // I/O threads running the requests
+#define HTTP_CLIENT_TIMEOUT_MS 5000                 // to connect, and for each response
+#define HTTP_CLIENT_RETRIES 2                       // extra attempts after a transport error
+#define HTTP_CLIENT_MAX_CONNECTIONS_PER_HOST 8      // further requests wait for a connection
+#define HTTP_CLIENT_MAX_BODY_BYTES (256ULL << 20)   // larger responses fail
+
+namespace utils
+{
+
+/**
+ * @brief Outcome of an HttpClient request.
+ *
+ * A transport failure (no connection, timeout, malformed response) leaves status 0 and an
+ * empty body and sets @c error; an HTTP error status is a response like any other.
+ */
+struct HttpResponse
+{
+    unsigned status = 0;
+    std::string body;
+    boost::system::error_code error;
+
+    bool ok() const
+    {
+        return !error && status >= 200 && status < 300;
+    }
+};
+
+/**
+ * @brief One request of an HttpClient::pipeline().
+ */
+struct HttpRequest
+{
+    boost::beast::http::verb method = boost::beast::http::verb::get;
+    std::string url;
+    std::string body;
+};
+
+struct HttpRequestOptions
+{
+    std::chrono::milliseconds timeout{HTTP_CLIENT_TIMEOUT_MS};
+    unsigned retries = HTTP_CLIENT_RETRIES;
+    std::string contentType = "application/json"; // sent with a non-empty body
+    std::vector<std::pair<std::string, std::string>> headers;
+};
+
+/**
+ * @brief Process-wide HTTP/1.1 client with keep-alive connections reused per host.
+ *
+ * Replaces forking curl for the controller, simulator and smart-plug calls. Requests run
+ * on HTTP_CLIENT_THREADS threads of the client's own io_context; at most
+ * HTTP_CLIENT_MAX_CONNECTIONS_PER_HOST are open to one host:port, further requests queue
+ * for the next free one. A finished connection the server keeps alive goes back to its host.
+ *
+ * A request fails when connecting or waiting for its response takes longer than
+ * options.timeout. After a transport error it is sent again on a new connection up to
+ * options.retries times; failing on a reused connection the server had already closed does
+ * not count as an attempt. Requests are retried whatever their method, so they should be
+ * idempotent, as the Ryu REST calls are.
+ *
+ * pipeline() writes a sequence of requests to one host back to back on a single connection
+ * (HTTP/1.1 pipelining). The server handles them in order and the whole sequence costs about
+ * one round trip instead of one per request.
+ *
+ * Only http:// URLs are supported; see utils::httpsPost() for TLS.
+ *
+ * Callbacks run on a client thread and must not block: request() from a callback throws.
+ */
+class HttpClient
+{
+  public:
+    using Callback = std::function<void(HttpResponse)>;
+
+    static HttpClient& instance();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+    ~HttpClient();
+
+    /**
+     * @brief Send a request and call @p done with its outcome on a client thread.
+     * @throws std::invalid_argument if @p url is not an http:// URL with a host.
+     */
+    void asyncRequest(boost::beast::http::verb method,
+                      const std::string& url,
+                      std::string body,
+                      Callback done,
+                      const HttpRequestOptions& options = {});
+
+    /**
+     * @brief asyncRequest() whose outcome is delivered through a future.
+     */
+    std::future<HttpResponse> asyncRequest(boost::beast::http::verb method,
+                                           const std::string& url,
+                                           std::string body = {},
+                                           const HttpRequestOptions& options = {});
+
+    /**
+     * @brief Send a request and wait for its outcome.
+     * @throws std::invalid_argument if @p url is not an http:// URL with a host.
+     * @throws std::logic_error when called from an HttpClient callback.
+     */
+    HttpResponse request(boost::beast::http::verb method,
+                         const std::string& url,
+                         std::string body = {},
+                         const HttpRequestOptions& options = {});
+
+    /**
+     * @brief Send @p requests, which must all go to the same host:port, on one connection
+     *        and call @p done with their outcomes, in order, on a client thread.
+     *
+     * options.retries does not apply: after a transport error the request that failed and
+     * all after it report it, since the server may have handled some of them.
+     *
+     * @throws std::invalid_argument if a URL is not http:// or the hosts differ.
+     */
+    void asyncPipeline(std::vector<HttpRequest> requests,
+                       std::function<void(std::vector<HttpResponse>)> done,
+                       const HttpRequestOptions& options = {});
+
+    /**
+     * @brief asyncPipeline(), waiting for the outcomes.
+     * @throws std::logic_error when called from an HttpClient callback.
+     */
+    std::vector<HttpResponse> pipeline(std::vector<HttpRequest> requests,
+                                       const HttpRequestOptions& options = {});
+
+    HttpResponse get(const std::string& url, const HttpRequestOptions& options = {});
+
+    HttpResponse post(const std::string& url,
+                      std::string body,
+                      const HttpRequestOptions& options = {});
+
+    /**
+     * @brief {"requests", "pipelined_requests", "failures", "retries", "connections_opened",
+     *        "connections_reused", "stale_connections", "open_connections",
+     *        "idle_connections", "queued_requests"}.
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    class Operation;
+
+    // Connections of one host:port (guarded by m_poolMutex)
+    struct HostPool
+    {
+        size_t open = 0; // connections handed out or idle, and connects in progress
+        std::vector<std::unique_ptr<boost::beast::tcp_stream>> idle;
+        std::deque<std::shared_ptr<Operation>> waiting;
+    };
+
+    HttpClient();
+
+    // Give @p op a connection slot of its host, now or when one is released
+    void acquire(const std::shared_ptr<Operation>& op);
+    // Return the slot of a finished request, with its connection if it can be reused
+    void release(const std::string& hostKey, std::unique_ptr<boost::beast::tcp_stream> stream);
+
+    boost::asio::io_context m_ioc;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> m_work;
+    std::vector<std::thread> m_threads;
+
+    mutable std::mutex m_poolMutex;
+    std::unordered_map<std::string, HostPool> m_hosts;
+
+    std::atomic<uint64_t> m_requests{0};
+    std::atomic<uint64_t> m_pipelinedRequests{0};
+    std::atomic<uint64_t> m_failures{0};
+    std::atomic<uint64_t> m_retries{0};
+    std::atomic<uint64_t> m_connectionsOpened{0};
+    std::atomic<uint64_t> m_connectionsReused{0};
+    std::atomic<uint64_t> m_staleConnections{0};
+};
+
+} // namespace utils
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>             // for array
+#include <atomic>            // for atomic
+#include <cstdint>           // for uint64_t
+#include <functional>        // for function
+#include <memory>            // for shared_ptr
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <string>            // for string
+#include <string_view>       // for string_view
+#include <unordered_map>     // for unordered_map
+
+#define HTTP_COMPRESS_MIN_BYTES 1024 // smaller bodies are sent uncompressed
+#define HTTP_GZIP_LEVEL 6            // zlib level for Content-Encoding: gzip
+#define HTTP_ZSTD_LEVEL 3            // zstd level for Content-Encoding: zstd (NDT_HAVE_ZSTD)
+#define HTTP_BODY_CACHE_MAX_KEYS 16  // parameter sets kept per EncodedBodyCache (LRU)
+
+namespace utils
+{
+
+/// Content-Encoding of a response body.
+enum class ContentEncoding
+{
+    Identity,
+    Gzip,
+    Zstd,
+};
+
+/// Representation of a JSON document in a response body.
+enum class BodyFormat
+{
+    Json,
+    Cbor,
+    MsgPack,
+};
+
+/// Content-Encoding header value ("" for Identity).
+std::string_view toString(ContentEncoding encoding);
+
+/// Content-Type header value.
+std::string_view contentType(BodyFormat format);
+
+/**
+ * @brief Best encoding offered by an Accept-Encoding header: zstd (when built with
+ *        NDT_HAVE_ZSTD), then gzip, else Identity. Codings with q=0 are refused.
+ */
+ContentEncoding negotiateEncoding(std::string_view acceptEncoding);
+
+/**
+ * @brief Format asked for by an Accept header: the first of application/cbor and
+ *        application/msgpack (or x-msgpack, vnd.msgpack) it lists, else Json.
+ */
+BodyFormat negotiateFormat(std::string_view accept);
+
+/**
+ * @brief A response body ready to send. @c encoding is what was applied, which is Identity
+ *        for bodies under HTTP_COMPRESS_MIN_BYTES whatever was asked for.
+ */
+struct EncodedBody
+{
+    std::shared_ptr<const std::string> data;
+    BodyFormat format = BodyFormat::Json;
+    ContentEncoding encoding = ContentEncoding::Identity;
+};
+
+/// Convert JSON text @p json to @p format and compress it with @p encoding.
+EncodedBody encodeBody(std::string json, BodyFormat format, ContentEncoding encoding);
+
+/**
+ * @brief Encoded bodies of one endpoint, shared by all sessions.
+ *
+ * Entries are keyed by the request parameters that shape the body (@p key, "" when there are
+ * none) and tagged with the version of the data they were built from. The JSON text of a
+ * key and version is rendered once, and each format/encoding pair of it is produced once,
+ * the first time a client asks for it. A request for a newer version replaces the entry.
+ * At most HTTP_BODY_CACHE_MAX_KEYS keys are kept; the least recently used one goes first.
+ * Concurrent requests wait for the one doing the work and then reuse its result.
+ */
+class EncodedBodyCache
+{
+  public:
+    /// Body of @p key at @p version in @p format and @p encoding; @p render returns its JSON.
+    EncodedBody get(std::string_view key, std::string_view version, BodyFormat format,
+                    ContentEncoding encoding, const std::function<std::string()>& render);
+
+    /// {"keys", "hits", "renders", "encodes", "cached_bytes"}
+    nlohmann::json statsJson() const;
+
+  private:
+    static constexpr size_t kEncodings = 3;
+    static constexpr size_t kVariants = 3 * kEncodings;
+
+    struct Entry
+    {
+        std::string version;
+        std::shared_ptr<const std::string> json;
+        std::array<EncodedBody, kVariants> variants;
+        uint64_t bytes = 0;
+        uint64_t lastUse = 0;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    uint64_t m_uses = 0;
+
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_renders{0};
+    std::atomic<uint64_t> m_encodes{0};
+    std::atomic<uint64_t> m_cachedBytes{0};
+};
+
+} // namespace utils
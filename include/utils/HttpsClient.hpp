@@ -0,0 +1,93 @@
+#pragma once
+
+#include "utils/HttpClient.hpp"       // for HttpResponse, HttpRequestOptions
+#include <atomic>                     // for atomic
+#include <boost/asio/ssl/context.hpp> // for context
+#include <chrono>                     // for milliseconds
+#include <cstdint>                    // for uint64_t
+#include <functional>                 // for function
+#include <memory>                     // for unique_ptr
+#include <mutex>                      // for mutex
+#include <nlohmann/json.hpp>          // for json
+#include <string>                     // for string
+#include <string_view>                // for string_view
+#include <unordered_map>              // for unordered_map
+#include <vector>                     // for vector
+
+#define HTTPS_CLIENT_MAX_IDLE_PER_HOST 4   // idle connections kept per host:port
+#define HTTPS_CLIENT_IDLE_TIMEOUT_MS 50000 // idle longer and the server may have closed it
+#define HTTPS_CLIENT_READ_CHUNK 8192       // bytes handed to a chunk callback at most
+
+namespace utils
+{
+
+/**
+ * @brief Process-wide HTTPS/1.1 client keeping TLS connections alive between requests.
+ *
+ * utils::httpsPost() resolves, connects and handshakes for every call; for the LLM endpoint
+ * that is a few round trips before the request is even sent. Here a finished connection the
+ * server keeps alive is parked per host:port (at most HTTPS_CLIENT_MAX_IDLE_PER_HOST, for up
+ * to HTTPS_CLIENT_IDLE_TIMEOUT_MS) and the next request to the host reuses it.
+ *
+ * Requests are synchronous and run on the calling thread, which should be one that may block
+ * (a BlockingPool task). options.timeout bounds connecting, the handshake, writing, and each
+ * read, so a streamed response may take longer in total as long as it keeps arriving.
+ *
+ * A request is sent again only when it failed on a reused connection before any response
+ * byte came back, which is a connection the server closed meanwhile. options.retries does
+ * not apply: a POST to the LLM may not be idempotent, so the caller decides what to retry.
+ * Peer certificates are verified against the system trust store and the URL's host name.
+ */
+class HttpsClient
+{
+  public:
+    /// Receives the response body piece by piece, in order, on the requesting thread
+    using ChunkCallback = std::function<void(std::string_view)>;
+
+    static HttpsClient& instance();
+
+    HttpsClient(const HttpsClient&) = delete;
+    HttpsClient& operator=(const HttpsClient&) = delete;
+    ~HttpsClient();
+
+    /**
+     * @brief POST @p body to @p url and wait for the response.
+     *
+     * With @p onChunk the body is passed to it as it arrives and the returned body stays
+     * empty, so server-sent events can be handled before the response completes.
+     *
+     * @throws std::invalid_argument if @p url is not an https:// URL with a host.
+     */
+    HttpResponse post(const std::string& url,
+                      std::string body,
+                      const HttpRequestOptions& options = {},
+                      const ChunkCallback& onChunk = {});
+
+    /**
+     * @brief {"requests", "failures", "connections_opened", "connections_reused",
+     *        "stale_connections", "idle_connections"}.
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Connection;
+
+    HttpsClient();
+
+    // An idle connection to @p hostKey younger than HTTPS_CLIENT_IDLE_TIMEOUT_MS, or null
+    std::unique_ptr<Connection> takeIdle(const std::string& hostKey);
+    void putIdle(const std::string& hostKey, std::unique_ptr<Connection> connection);
+
+    boost::asio::ssl::context m_ssl;
+
+    mutable std::mutex m_idleMutex;
+    std::unordered_map<std::string, std::vector<std::unique_ptr<Connection>>> m_idle;
+
+    std::atomic<uint64_t> m_requests{0};
+    std::atomic<uint64_t> m_failures{0};
+    std::atomic<uint64_t> m_connectionsOpened{0};
+    std::atomic<uint64_t> m_connectionsReused{0};
+    std::atomic<uint64_t> m_staleConnections{0};
+};
+
+} // namespace utils
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>            // for milliseconds
+#include <cstdint>           // for uint16_t, uint32_t
+#include <map>               // for map
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <vector>            // for vector
+
+#define ICMP_PROBE_TIMEOUT_MS 1000 // wait for an echo reply before sending again
+#define ICMP_PROBE_ATTEMPTS 3      // echo requests per address before it counts as down
+#define ICMP_RTT_EWMA_WEIGHT 0.2   // weight of the newest sample in the smoothed RTT
+
+namespace utils
+{
+
+/// Outcome of probing one address.
+struct IcmpProbeResult
+{
+    bool alive = false;
+    double rttMs = 0.0; // of the reply, when alive
+};
+
+/**
+ * @brief In-process ICMP echo prober for switch liveness.
+ *
+ * probe() sends an echo request to every address at once and waits for the replies,
+ * matching each to its request by sequence number (and identifier on a raw socket). An
+ * address still silent after ICMP_PROBE_TIMEOUT_MS is sent another request, up to
+ * ICMP_PROBE_ATTEMPTS in all, so one probe of any number of switches lasts at most
+ * ICMP_PROBE_ATTEMPTS * ICMP_PROBE_TIMEOUT_MS.
+ *
+ * Uses an unprivileged ICMP datagram socket (net.ipv4.ping_group_range) when the kernel
+ * allows it, else a raw socket (CAP_NET_RAW). RTT and loss are kept per address for
+ * statsJson().
+ *
+ * probe() is meant for one caller at a time; statsJson() may be called from any thread.
+ */
+class IcmpProber
+{
+  public:
+    /// Opens the socket; throws std::system_error when neither kind may be opened.
+    IcmpProber();
+    ~IcmpProber();
+
+    IcmpProber(const IcmpProber&) = delete;
+    IcmpProber& operator=(const IcmpProber&) = delete;
+
+    /// Probe @p ips (network byte order); the results are in the same order.
+    std::vector<IcmpProbeResult> probe(const std::vector<uint32_t>& ips);
+
+    /**
+     * @brief {"socket": "dgram"|"raw", "probes", "devices": {ip: {"sent", "received",
+     *        "loss", "last_rtt_ms", "avg_rtt_ms", "alive"}}}
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    struct DeviceStats
+    {
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        double lastRttMs = 0.0;
+        double avgRttMs = 0.0; // EWMA
+        bool alive = false;
+    };
+
+    // Send one echo request with @p seq to @p ip; false if the send failed
+    bool sendEcho(uint32_t ip, uint16_t seq);
+
+    int m_fd = -1;
+    bool m_raw = false;    // raw socket: replies carry the IP header and every ICMP packet
+    uint16_t m_id = 0;     // echo identifier (raw socket; the kernel sets it on a dgram one)
+    uint16_t m_nextSeq = 0;
+    uint64_t m_probes = 0;
+
+    mutable std::mutex m_statsMutex;
+    std::map<uint32_t, DeviceStats> m_devices;
+};
+
+} // namespace utils
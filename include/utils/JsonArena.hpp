@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>           // for byte, size_t
+#include <cstdint>           // for int64_t, uint64_t
+#include <map>               // for map
+#include <memory_resource>   // for monotonic_buffer_resource, memory_resource
+#include <new>               // for operator new, operator delete
+#include <nlohmann/json.hpp> // for basic_json
+#include <string>            // for string
+#include <vector>            // for vector
+
+#define JSON_ARENA_INITIAL_BYTES 65536 // first block of a JsonArena, kept across requests
+
+namespace utils
+{
+
+/**
+ * @brief Per-request bump allocator for the JSON DOMs an HTTP handler builds.
+ *
+ * A session owns one arena and opens a Scope around each handler: while it is open,
+ * ArenaJson values made on that thread take their nodes from the arena's
+ * std::pmr::monotonic_buffer_resource, where an allocation is a pointer bump and a free is a
+ * no-op. Closing the scope releases everything at once and keeps the initial block for the
+ * next request on the connection.
+ *
+ * nlohmann::basic_json default-constructs its allocators, so the arena is found through a
+ * thread-local pointer rather than passed in. ArenaJson values must therefore be created and
+ * destroyed inside the same Scope (locals of the handler); outside any scope they fall back
+ * to the heap.
+ */
+class JsonArena
+{
+  public:
+    JsonArena()
+        : m_initial(JSON_ARENA_INITIAL_BYTES),
+          m_resource(m_initial.data(), m_initial.size())
+    {
+    }
+
+    JsonArena(const JsonArena&) = delete;
+    JsonArena& operator=(const JsonArena&) = delete;
+
+    class Scope
+    {
+      public:
+        explicit Scope(JsonArena& arena)
+            : m_arena(arena),
+              m_previous(current())
+        {
+            t_current = &arena.m_resource;
+        }
+
+        ~Scope()
+        {
+            t_current = m_previous;
+            m_arena.m_resource.release();
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        JsonArena& m_arena;
+        std::pmr::memory_resource* m_previous;
+    };
+
+    /// The arena of the innermost open Scope on this thread, nullptr if none.
+    static std::pmr::memory_resource* current()
+    {
+        return t_current;
+    }
+
+  private:
+    static inline thread_local std::pmr::memory_resource* t_current = nullptr;
+
+    std::vector<std::byte> m_initial;
+    std::pmr::monotonic_buffer_resource m_resource;
+};
+
+/// Allocator of ArenaJson: the current JsonArena if a Scope is open, else the heap.
+template <typename T>
+class ArenaAllocator
+{
+  public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept
+        : m_resource(JsonArena::current())
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+        : m_resource(other.resource())
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        if (m_resource)
+        {
+            return static_cast<T*>(m_resource->allocate(n * sizeof(T), alignof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        if (m_resource)
+        {
+            m_resource->deallocate(p, n * sizeof(T), alignof(T));
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    std::pmr::memory_resource* resource() const noexcept
+    {
+        return m_resource;
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept
+    {
+        return m_resource == other.resource();
+    }
+
+  private:
+    std::pmr::memory_resource* m_resource;
+};
+
+/// nlohmann::json with its nodes in the current JsonArena; dump() gives the same text.
+using ArenaJson = nlohmann::
+    basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, double,
+               ArenaAllocator>;
+
+/**
+ * @brief Serialise @p j into @p out, replacing its content but keeping its capacity, so a
+ *        response body reused across requests is not reallocated.
+ */
+template <typename BasicJson>
+void
+dumpInto(const BasicJson& j, std::string& out)
+{
+    out.clear();
+    nlohmann::detail::serializer<BasicJson> serializer(
+        nlohmann::detail::output_adapter<char, std::string>(out), ' ');
+    serializer.dump(j, false, false, 0);
+}
+
+} // namespace utils
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <charconv>    // for to_chars
+#include <cmath>       // for isfinite
+#include <concepts>    // for integral
+#include <cstdint>     // for uint8_t
+#include <string>      // for string
+#include <string_view> // for string_view
+#include <vector>      // for vector
+
+namespace utils
+{
+
+/**
+ * @brief Append-only JSON writer that serialises straight into a string.
+ *
+ * For large responses that would otherwise be built as an nlohmann::json DOM and dumped:
+ * values are formatted in place with no intermediate nodes. Output matches
+ * nlohmann::json::dump() for the same values (compact form, same string escaping, doubles
+ * always carry a fraction or exponent and non-finite doubles become null).
+ *
+ * The writer does not validate structure beyond inserting commas; callers pair
+ * begin/end calls and call key() before every member value.
+ *
+ * @code
+ * std::string out;
+ * utils::JsonWriter w(out);
+ * w.beginObject().key("ids").beginArray().value(1).value(2).endArray().endObject();
+ * // out == R"({"ids":[1,2]})"
+ * @endcode
+ */
+class JsonWriter
+{
+  public:
+    explicit JsonWriter(std::string& out)
+        : m_out(out)
+    {
+    }
+
+    JsonWriter& beginObject()
+    {
+        separate();
+        m_out.push_back('{');
+        m_first.push_back(true);
+        return *this;
+    }
+
+    JsonWriter& endObject()
+    {
+        m_first.pop_back();
+        m_out.push_back('}');
+        return *this;
+    }
+
+    JsonWriter& beginArray()
+    {
+        separate();
+        m_out.push_back('[');
+        m_first.push_back(true);
+        return *this;
+    }
+
+    JsonWriter& endArray()
+    {
+        m_first.pop_back();
+        m_out.push_back(']');
+        return *this;
+    }
+
+    JsonWriter& key(std::string_view name)
+    {
+        separate();
+        appendString(name);
+        m_out.push_back(':');
+        m_afterKey = true;
+        return *this;
+    }
+
+    JsonWriter& value(std::string_view s)
+    {
+        separate();
+        appendString(s);
+        return *this;
+    }
+
+    JsonWriter& value(const char* s)
+    {
+        return value(std::string_view(s));
+    }
+
+    JsonWriter& value(bool b)
+    {
+        separate();
+        m_out += b ? "true" : "false";
+        return *this;
+    }
+
+    template <std::integral T>
+    JsonWriter& value(T n)
+    {
+        separate();
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), n);
+        m_out.append(buf, res.ptr);
+        return *this;
+    }
+
+    JsonWriter& value(double d)
+    {
+        separate();
+        if (!std::isfinite(d))
+        {
+            m_out += "null";
+            return *this;
+        }
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), d);
+        std::string_view text(buf, res.ptr - buf);
+        m_out += text;
+        if (text.find_first_of(".e") == std::string_view::npos)
+        {
+            m_out += ".0";
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Append an already serialised JSON value as the next element.
+     */
+    JsonWriter& raw(std::string_view json)
+    {
+        separate();
+        m_out += json;
+        return *this;
+    }
+
+    template <typename Range>
+    JsonWriter& array(const Range& values)
+    {
+        beginArray();
+        for (const auto& v : values)
+        {
+            value(v);
+        }
+        return endArray();
+    }
+
+  private:
+    void separate()
+    {
+        if (m_afterKey)
+        {
+            m_afterKey = false;
+            return;
+        }
+        if (m_first.empty())
+        {
+            return;
+        }
+        if (!m_first.back())
+        {
+            m_out.push_back(',');
+        }
+        m_first.back() = false;
+    }
+
+    void appendString(std::string_view s)
+    {
+        static constexpr char HEX[] = "0123456789abcdef";
+        m_out.push_back('"');
+        for (char c : s)
+        {
+            switch (c)
+            {
+            case '"':
+                m_out += "\\\"";
+                break;
+            case '\\':
+                m_out += "\\\\";
+                break;
+            case '\b':
+                m_out += "\\b";
+                break;
+            case '\f':
+                m_out += "\\f";
+                break;
+            case '\n':
+                m_out += "\\n";
+                break;
+            case '\r':
+                m_out += "\\r";
+                break;
+            case '\t':
+                m_out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    m_out += "\\u00";
+                    m_out.push_back(HEX[(c >> 4) & 0xF]);
+                    m_out.push_back(HEX[c & 0xF]);
+                }
+                else
+                {
+                    m_out.push_back(c);
+                }
+            }
+        }
+        m_out.push_back('"');
+    }
+
+    std::string& m_out;
+    std::vector<uint8_t> m_first; // one entry per open object/array: no member written yet
+    bool m_afterKey = false;
+};
+
+} // namespace utils
@@ -16,6 +16,50 @@
 #include <memory>
 #include <string>
 
+#define LOG_ASYNC_QUEUE_SIZE 8192 // messages the async logger buffers; when full the oldest go
+
+// Compile-time floors of the hot-path subsystems: an NDT_LOG_* call below its subsystem's
+// floor compiles to nothing, whatever the runtime level. Raise the detail of one subsystem
+// with e.g. -DNDT_LOG_LEVEL_INGEST=SPDLOG_LEVEL_TRACE (see CMakeLists.txt).
+#ifndef NDT_LOG_LEVEL_INGEST
+#define NDT_LOG_LEVEL_INGEST SPDLOG_LEVEL_DEBUG // sFlow decode and apply, per sample
+#endif
+#ifndef NDT_LOG_LEVEL_CLASSIFIER
+#define NDT_LOG_LEVEL_CLASSIFIER SPDLOG_LEVEL_DEBUG // rule upserts and lookups
+#endif
+#ifndef NDT_LOG_LEVEL_PATHS
+#define NDT_LOG_LEVEL_PATHS SPDLOG_LEVEL_DEBUG // flow path resolution, per flow
+#endif
+#ifndef NDT_LOG_LEVEL_HTTP
+#define NDT_LOG_LEVEL_HTTP SPDLOG_LEVEL_TRACE // per-request logs of the NDT server
+#endif
+
+/**
+ * @brief Log at @p lvl for @p subsystem (INGEST, CLASSIFIER, PATHS, HTTP).
+ *
+ * Unlike SPDLOG_LOGGER_*, the arguments are only evaluated when the message is logged: the
+ * call is compiled out below the subsystem's floor (or SPDLOG_ACTIVE_LEVEL), and otherwise
+ * checks the runtime level before formatting anything (ipToString(), to_hex, dump()).
+ */
+#define NDT_LOG_AT(subsystem, lvl, ...)                                                            \
+    do                                                                                             \
+    {                                                                                              \
+        if constexpr ((lvl) >= NDT_LOG_LEVEL_##subsystem && (lvl) >= SPDLOG_ACTIVE_LEVEL)          \
+        {                                                                                          \
+            const auto& ndtLogger = Logger::instance();                                            \
+            constexpr auto ndtLevel = static_cast<spdlog::level::level_enum>(lvl);                 \
+            if (ndtLogger->should_log(ndtLevel))                                                   \
+            {                                                                                      \
+                ndtLogger->log(spdlog::source_loc{__FILE__, __LINE__, SPDLOG_FUNCTION},            \
+                               ndtLevel,                                                           \
+                               __VA_ARGS__);                                                       \
+            }                                                                                      \
+        }                                                                                          \
+    } while (0)
+#define NDT_LOG_TRACE(subsystem, ...) NDT_LOG_AT(subsystem, SPDLOG_LEVEL_TRACE, __VA_ARGS__)
+#define NDT_LOG_DEBUG(subsystem, ...) NDT_LOG_AT(subsystem, SPDLOG_LEVEL_DEBUG, __VA_ARGS__)
+#define NDT_LOG_INFO(subsystem, ...) NDT_LOG_AT(subsystem, SPDLOG_LEVEL_INFO, __VA_ARGS__)
+
 /**
  * @brief Runtime logging configuration options for the global logger.
  *
@@ -26,6 +70,9 @@ struct LogConfig
 {
     bool enableFile = false;
     spdlog::level::level_enum level = spdlog::level::info;
+    // Format and write on a background thread; logging threads only enqueue, and drop the
+    // oldest queued message rather than block when LOG_ASYNC_QUEUE_SIZE are waiting
+    bool async = false;
 };
 
 /**
@@ -46,7 +93,9 @@ struct LogConfig
  *
  * Threading:
  *  - spdlog is thread-safe; Logger::instance() returns a shared logger.
- *  - init() should be called once during startup before concurrent logging.
+ *  - init() should be called once during startup before concurrent logging; with
+ *    LogConfig::async it starts spdlog's writer thread, and shutdown() drains it.
+ *  - Hot paths log through NDT_LOG_*, which costs nothing when the level is off.
  */
 class Logger
 {
@@ -81,10 +130,14 @@ class Logger
     /**
      * @brief Access the global logger instance.
      *
-     * @return Shared pointer to the initialized spdlog logger.
+     * @return Shared pointer to the initialized spdlog logger (by reference, so logging
+     *         does not touch its reference count).
      * @note Logger::init() should be called before first use.
      */
-    static std::shared_ptr<spdlog::logger> instance();
+    static const std::shared_ptr<spdlog::logger>& instance();
+
+    /// Write what the async logger still queues and stop its thread; no-op when synchronous.
+    static void shutdown();
 
   private:
     static std::shared_ptr<spdlog::logger> m_logger;
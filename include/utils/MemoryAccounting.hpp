@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>         // for max
+#include <chrono>            // for milliseconds
+#include <cstddef>           // for size_t
+#include <cstdint>           // for int64_t
+#include <deque>             // for deque
+#include <functional>        // for function
+#include <list>              // for list
+#include <map>               // for map
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <optional>          // for optional
+#include <set>               // for set
+#include <string>            // for string
+#include <string_view>       // for string_view
+#include <unordered_map>     // for unordered_map, unordered_multimap
+#include <unordered_set>     // for unordered_set
+#include <utility>           // for pair
+#include <vector>            // for vector
+
+#include "utils/TaskScheduler.hpp" // for TaskScheduler
+
+#define MEMORY_ACCOUNTING_PERIOD_MS 10000 // between two runs of the estimators
+#define MEMORY_NODE_OVERHEAD 32           // header of a red-black tree node (std::map, std::set)
+
+namespace utils
+{
+
+/**
+ * @name Heap estimators
+ * @brief Bytes a container has taken from the heap for itself: its array, nodes and bucket
+ *        index, each allocation rounded up to what glibc malloc hands out. What its elements
+ *        own in turn (the characters of a std::string key, say) is the caller's to add.
+ * @{
+ */
+
+/// Bytes malloc uses for a request of @p bytes: a 16-byte aligned chunk with an 8-byte header.
+constexpr size_t
+heapChunk(size_t bytes)
+{
+    return bytes == 0 ? 0 : std::max<size_t>(32, (bytes + 8 + 15) & ~size_t{15});
+}
+
+inline size_t
+heapBytes(const std::string& s)
+{
+    // Up to 15 characters fit in the object itself
+    return s.capacity() > 15 ? heapChunk(s.capacity() + 1) : 0;
+}
+
+template <typename T, typename A>
+size_t
+heapBytes(const std::vector<T, A>& v)
+{
+    return heapChunk(v.capacity() * sizeof(T));
+}
+
+template <typename T, typename A>
+size_t
+heapBytes(const std::deque<T, A>& d)
+{
+    // 512-byte blocks (one element if larger), and the block map
+    const size_t perBlock = sizeof(T) < 512 ? 512 / sizeof(T) : 1;
+    const size_t blocks = d.size() / perBlock + 1;
+    return blocks * heapChunk(perBlock * sizeof(T)) + heapChunk((blocks + 8) * sizeof(void*));
+}
+
+template <typename T, typename A>
+size_t
+heapBytes(const std::list<T, A>& l)
+{
+    return l.size() * heapChunk(2 * sizeof(void*) + sizeof(T));
+}
+
+/// Nodes of a hash container (next pointer, value, cached hash) plus its bucket array.
+template <typename Container>
+size_t
+hashNodeBytes(const Container& c)
+{
+    return c.size() * heapChunk(2 * sizeof(void*) + sizeof(typename Container::value_type)) +
+           heapChunk(c.bucket_count() * sizeof(void*));
+}
+
+template <typename K, typename V, typename H, typename E, typename A>
+size_t
+heapBytes(const std::unordered_map<K, V, H, E, A>& m)
+{
+    return hashNodeBytes(m);
+}
+
+template <typename K, typename V, typename H, typename E, typename A>
+size_t
+heapBytes(const std::unordered_multimap<K, V, H, E, A>& m)
+{
+    return hashNodeBytes(m);
+}
+
+template <typename K, typename H, typename E, typename A>
+size_t
+heapBytes(const std::unordered_set<K, H, E, A>& s)
+{
+    return hashNodeBytes(s);
+}
+
+template <typename K, typename V, typename C, typename A>
+size_t
+heapBytes(const std::map<K, V, C, A>& m)
+{
+    return m.size() * heapChunk(MEMORY_NODE_OVERHEAD + sizeof(std::pair<const K, V>));
+}
+
+template <typename K, typename C, typename A>
+size_t
+heapBytes(const std::set<K, C, A>& s)
+{
+    return s.size() * heapChunk(MEMORY_NODE_OVERHEAD + sizeof(K));
+}
+
+/// A JSON document, recursively: its objects, arrays and strings.
+size_t heapBytes(const nlohmann::json& j);
+
+/** @} */
+
+/**
+ * @brief What one subsystem's containers hold, from its memoryUsage(): estimated bytes per
+ *        container and, for the bytes-per-item figures, how many items of each unit there are.
+ */
+class MemoryUsage
+{
+  public:
+    /// Account @p bytes to @p container (added to what it already has).
+    MemoryUsage& add(std::string_view container, size_t bytes);
+
+    /// @p count items of @p unit ("flow", "rule"), reported with the bytes each takes.
+    MemoryUsage& per(std::string_view unit, size_t count);
+
+    size_t totalBytes() const;
+
+    /// Bytes of @p container; 0 if it has none.
+    size_t bytes(std::string_view container) const;
+
+    const std::vector<std::pair<std::string, size_t>>& containers() const
+    {
+        return m_containers;
+    }
+
+    const std::vector<std::pair<std::string, size_t>>& units() const
+    {
+        return m_units;
+    }
+
+    /// {"bytes", "containers": {name: bytes}, and per unit "<unit>s" and "bytes_per_<unit>"}
+    nlohmann::json toJson() const;
+
+  private:
+    std::vector<std::pair<std::string, size_t>> m_containers; // in the order added
+    std::vector<std::pair<std::string, size_t>> m_units;
+};
+
+/**
+ * @brief Where NDT's memory goes: the estimated bytes of every subsystem's major containers,
+ *        for GET /ndt/debug/memory and /metrics.
+ *
+ * Subsystems register an estimator (their memoryUsage()) with add(). start() runs them all
+ * every period on the TaskScheduler, so the endpoints only read the last results; an
+ * estimator walks its containers under the same locks its readers take, which is too slow
+ * for a scrape of a large flow table. Estimates count the containers' heap and huge-page
+ * arrays by capacity, not the allocator's free lists; resident_bytes and heap_in_use_bytes
+ * of the process are reported beside them for comparison. Thread-safe.
+ */
+class MemoryAccounting
+{
+  public:
+    using Estimator = std::function<MemoryUsage()>;
+
+    static MemoryAccounting& instance();
+
+    MemoryAccounting(const MemoryAccounting&) = delete;
+    MemoryAccounting& operator=(const MemoryAccounting&) = delete;
+
+    /// Estimate @p subsystem with @p estimator from the next refresh on.
+    void add(std::string subsystem, Estimator estimator);
+
+    /// Refresh now and then every @p period; ignored once started.
+    void start(std::chrono::milliseconds period =
+                   std::chrono::milliseconds(MEMORY_ACCOUNTING_PERIOD_MS));
+
+    /// Run every estimator now (waiting for a refresh in progress instead of overlapping it).
+    void refresh();
+
+    /**
+     * @brief {"updated_at_ms", "period_ms", "resident_bytes", "heap_in_use_bytes" (null where
+     *        glibc cannot tell), "accounted_bytes", "subsystems": {name: MemoryUsage::toJson()}}
+     *        of the last refresh.
+     */
+    nlohmann::json toJson() const;
+
+    /// ndt_memory_estimated_bytes, ndt_memory_bytes_per_item and the process figures.
+    void appendMetrics(std::string& out) const;
+
+  private:
+    MemoryAccounting() = default;
+
+    std::mutex m_refreshMutex; // held by a refresh, over the estimators' runs
+    mutable std::mutex m_mutex;
+    std::vector<std::pair<std::string, Estimator>> m_estimators;
+    std::vector<std::pair<std::string, MemoryUsage>> m_usage; // of the last refresh
+    int64_t m_updatedAtMs = 0;
+    size_t m_residentBytes = 0;
+    std::optional<size_t> m_heapInUseBytes;
+    std::chrono::milliseconds m_period{0};
+    TaskScheduler::TaskId m_task = 0;
+};
+
+} // namespace utils
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>             // for array
+#include <atomic>            // for atomic
+#include <cstddef>           // for size_t
+#include <cstdint>           // for uint64_t
+#include <memory>            // for allocator
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <optional>          // for optional
+#include <string>            // for string
+#include <string_view>       // for string_view
+#include <unordered_map>     // for unordered_map
+#include <vector>            // for vector
+
+#define MEMORY_POLICY_MIN_BYTES (1 << 20) // smaller allocations stay on the heap
+#define MEMORY_HUGE_PAGE_BYTES (2 << 20)  // huge page size the regions are aligned to
+
+namespace utils
+{
+
+/// How the large regions of MemoryPolicy are backed.
+enum class HugePageMode
+{
+    Off,         // the heap, as any allocation
+    Transparent, // anonymous mappings aligned to huge pages, madvise(MADV_HUGEPAGE)
+    Explicit,    // MAP_HUGETLB from the reserved pool, Transparent when it is exhausted
+};
+
+/// The structures MemoryPolicy allocates for, each placed on the NUMA nodes its users run on.
+enum class MemoryKind
+{
+    IngestBuffers, // recvmmsg buffers of an ingest worker: the node of the allocating thread
+    FlowTable,     // flow table shards, shared by every worker: interleaved over all nodes
+    Classifier,    // compiled classifier subtables, read by every worker: interleaved
+};
+inline constexpr size_t MEMORY_KIND_COUNT = 3;
+
+struct MemoryPolicyConfig
+{
+    HugePageMode hugePages = HugePageMode::Transparent;
+    bool numa = true; // place the regions by MemoryKind on multi-node hosts
+};
+
+/**
+ * @brief Where the large, hot tables of the collector live: huge-page backed regions placed
+ *        on the NUMA nodes of the threads that use them.
+ *
+ * A region is an anonymous mapping of its own, so its huge pages and its NUMA policy
+ * (mbind() before first touch) apply to it alone. Allocations under MEMORY_POLICY_MIN_BYTES,
+ * and all of them when huge pages and NUMA placement are both off, are left to the heap
+ * (allocate() returns nullptr). PolicyAllocator puts the policy behind a standard allocator.
+ *
+ * countTlbMisses() opens dTLB load and miss counters (perf_event_open) for the calling thread,
+ * reported by statsJson() with the huge-page and per-node footprint of the process.
+ * Thread-safe.
+ */
+class MemoryPolicy
+{
+  public:
+    static MemoryPolicy& instance();
+
+    MemoryPolicy(const MemoryPolicy&) = delete;
+    MemoryPolicy& operator=(const MemoryPolicy&) = delete;
+
+    /// Call before the first allocation; regions allocated before keep their backing.
+    void configure(MemoryPolicyConfig config);
+
+    /// "off", "thp" or "explicit"; nullopt for anything else.
+    static std::optional<HugePageMode> parseHugePages(std::string_view text);
+
+    /// A region of @p bytes for @p kind, or nullptr if the heap should serve it.
+    void* allocate(size_t bytes, MemoryKind kind);
+
+    /// Unmap @p p if it is a region of allocate(); false if it is not.
+    bool deallocate(void* p);
+
+    /// Count the dTLB loads and misses of the calling thread, listed as @p thread.
+    void countTlbMisses(const std::string& thread);
+
+    /**
+     * @brief {"huge_pages", "numa", "nodes", "kinds": {kind: {"regions", "bytes",
+     *        "huge_bytes", "fallbacks"}}, "anon_huge_bytes", "hugetlb_bytes",
+     *        "node_bytes": [per node], "tlb": [{"thread", "loads", "misses"}]}; the last
+     *        four from /proc/self and perf, the process as a whole.
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Region
+    {
+        size_t bytes = 0;
+        MemoryKind kind = MemoryKind::FlowTable;
+        bool huge = false; // MAP_HUGETLB or MADV_HUGEPAGE
+    };
+
+    struct KindStats
+    {
+        std::atomic<uint64_t> regions{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> hugeBytes{0}; // in MAP_HUGETLB or MADV_HUGEPAGE regions
+        std::atomic<uint64_t> fallbacks{0}; // Explicit regions the pool could not back
+    };
+
+    struct TlbCounter
+    {
+        std::string thread;
+        int loadsFd = -1;
+        int missesFd = -1;
+    };
+
+    MemoryPolicy();
+
+    // mbind() @p p to the nodes of @p kind
+    void place(void* p, size_t bytes, MemoryKind kind) const;
+
+    std::atomic<HugePageMode> m_hugePages{HugePageMode::Transparent};
+    std::atomic<bool> m_numa{true};
+    std::vector<unsigned> m_nodes; // online NUMA nodes
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<void*, Region> m_regions;
+    std::vector<TlbCounter> m_tlbCounters;
+    std::array<KindStats, MEMORY_KIND_COUNT> m_stats;
+};
+
+/**
+ * @brief Standard allocator taking the arrays of @p Kind of at least MEMORY_POLICY_MIN_BYTES
+ *        from MemoryPolicy, the others from std::allocator.
+ */
+template <typename T, MemoryKind Kind>
+struct PolicyAllocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = PolicyAllocator<U, Kind>;
+    };
+
+    PolicyAllocator() = default;
+
+    template <typename U>
+    PolicyAllocator(const PolicyAllocator<U, Kind>&) noexcept
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        if (n * sizeof(T) >= MEMORY_POLICY_MIN_BYTES)
+        {
+            if (void* p = MemoryPolicy::instance().allocate(n * sizeof(T), Kind))
+            {
+                return static_cast<T*>(p);
+            }
+        }
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (n * sizeof(T) >= MEMORY_POLICY_MIN_BYTES && MemoryPolicy::instance().deallocate(p))
+        {
+            return;
+        }
+        std::allocator<T>{}.deallocate(p, n);
+    }
+
+    template <typename U>
+    bool operator==(const PolicyAllocator<U, Kind>&) const noexcept
+    {
+        return true;
+    }
+};
+
+} // namespace utils
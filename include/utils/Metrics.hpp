@@ -0,0 +1,211 @@
+#pragma once
+
+#include <array>         // for array
+#include <atomic>        // for atomic
+#include <chrono>        // for steady_clock
+#include <cstdint>       // for uint64_t
+#include <map>           // for map
+#include <memory>        // for unique_ptr
+#include <mutex>         // for mutex
+#include <string>        // for string
+#include <string_view>   // for string_view
+#include <vector>        // for vector
+
+#define METRICS_COUNTER_STRIPES 16 // slots of a Counter; threads add to their own, scrapes sum
+
+namespace utils
+{
+
+/// Slot of the calling thread in striped metrics, fixed on its first call.
+size_t metricsStripe();
+
+/**
+ * @brief Monotonic counter for hot paths.
+ *
+ * Each thread adds to its own cache line (one of METRICS_COUNTER_STRIPES, picked by
+ * metricsStripe()), so concurrent writers do not contend; value() sums the stripes.
+ */
+class Counter
+{
+  public:
+    void add(uint64_t n = 1)
+    {
+        m_stripes[metricsStripe()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+  private:
+    struct alignas(64) Stripe
+    {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Stripe, METRICS_COUNTER_STRIPES> m_stripes;
+};
+
+/// Value that goes up and down.
+class Gauge
+{
+  public:
+    void set(double value)
+    {
+        m_value.store(value, std::memory_order_relaxed);
+    }
+
+    void add(double delta)
+    {
+        m_value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    double value() const
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<double> m_value{0.0};
+};
+
+/**
+ * @brief Fixed-bucket histogram of observed values (seconds, for durations).
+ *
+ * The buckets are the upper bounds given at construction plus +Inf. observe() is one relaxed
+ * increment and one add; give each writer thread its own Histogram (e.g. by label) where the
+ * rate is high.
+ */
+class Histogram
+{
+  public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    void observe(std::chrono::steady_clock::duration duration)
+    {
+        observe(std::chrono::duration<double>(duration).count());
+    }
+
+    const std::vector<double>& bounds() const
+    {
+        return m_bounds;
+    }
+
+    /// Count of bucket @p i (not cumulative); i == bounds().size() is +Inf.
+    uint64_t bucketCount(size_t i) const
+    {
+        return m_buckets[i].load(std::memory_order_relaxed);
+    }
+
+    double sum() const
+    {
+        return m_sum.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+    std::atomic<double> m_sum{0.0};
+};
+
+/// Observes the time from its construction to its destruction into a Histogram.
+class ScopedTimer
+{
+  public:
+    explicit ScopedTimer(Histogram& histogram)
+        : m_histogram(histogram),
+          m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        m_histogram.observe(std::chrono::steady_clock::now() - m_start);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  private:
+    Histogram& m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+/// One line of a family written by MetricsRegistry::appendFamily().
+struct MetricSample
+{
+    std::string labels; // e.g. worker="0", without braces; "" for none
+    double value = 0.0;
+    std::string_view suffix = {}; // appended to the family name, e.g. "_total"
+};
+
+/**
+ * @brief Process-wide registry of the metrics served at GET /metrics.
+ *
+ * Metrics are created on first request and live as long as the process, so a hot path looks
+ * its metric up once and keeps the reference. Metrics of one name form a family and differ by
+ * their labels. render() writes them in the Prometheus text format (version 0.0.4);
+ * components whose numbers already exist (queue depths, table sizes) add them at scrape time
+ * with appendFamily() instead of registering.
+ */
+class MetricsRegistry
+{
+  public:
+    static MetricsRegistry& instance();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    Counter& counter(std::string_view name, std::string_view help, std::string_view labels = {});
+    Gauge& gauge(std::string_view name, std::string_view help, std::string_view labels = {});
+    /// @p bounds only counts the first time the family is created.
+    Histogram& histogram(std::string_view name,
+                         std::string_view help,
+                         std::string_view labels = {},
+                         const std::vector<double>& bounds = latencyBuckets());
+
+    /// Appends every registered family to @p out.
+    void render(std::string& out) const;
+
+    /// Appends one family of values known at scrape time; @p type is "counter" or "gauge".
+    static void appendFamily(std::string& out,
+                             std::string_view name,
+                             std::string_view type,
+                             std::string_view help,
+                             const std::vector<MetricSample>& samples);
+
+    /// key="value", with the value escaped as the text format wants.
+    static std::string label(std::string_view key, std::string_view value);
+
+    /// 1 us to 30 s, about three buckets per decade.
+    static const std::vector<double>& latencyBuckets();
+
+  private:
+    MetricsRegistry() = default;
+
+    enum class Type
+    {
+        Counter,
+        Gauge,
+        Histogram,
+    };
+
+    struct Family
+    {
+        Type type;
+        std::string help;
+        std::vector<double> bounds;
+        std::map<std::string, std::unique_ptr<Counter>, std::less<>> counters;
+        std::map<std::string, std::unique_ptr<Gauge>, std::less<>> gauges;
+        std::map<std::string, std::unique_ptr<Histogram>, std::less<>> histograms;
+    };
+
+    Family& family(std::string_view name, Type type, std::string_view help);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Family, std::less<>> m_families;
+};
+
+/// ndt_poller_cycle_seconds{poller="@p poller"}: how long one cycle of a periodic worker took.
+Histogram& pollerCycleHistogram(std::string_view poller);
+
+} // namespace utils
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>  // for atomic, memory_order
+#include <cstddef> // for size_t
+#include <memory>  // for unique_ptr
+#include <utility> // for move
+
+namespace utils
+{
+
+/**
+ * @brief Bounded lock-free multi-producer / multi-consumer queue.
+ *
+ * Any thread may call tryPush() and tryPop(). Each slot carries a sequence number telling
+ * whose turn it is (Vyukov's bounded MPMC queue): a producer claims a slot by advancing the
+ * tail with a CAS, writes it, then publishes it by bumping its sequence; consumers do the same
+ * on the head. size() is approximate.
+ *
+ * Capacity is rounded up to a power of two.
+ *
+ * @tparam T Element type; must be default constructible and move assignable.
+ */
+template <typename T>
+class MpmcQueue
+{
+  public:
+    explicit MpmcQueue(size_t capacity)
+        : m_capacity(roundUpPow2(capacity)),
+          m_mask(m_capacity - 1),
+          m_slots(std::make_unique<Slot[]>(m_capacity))
+    {
+        for (size_t i = 0; i < m_capacity; ++i)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /**
+     * @brief Enqueue one element.
+     * @return false if the queue is full; the element is left untouched.
+     */
+    bool tryPush(T&& value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = m_slots[tail & m_mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence - tail);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+                {
+                    slot.value = std::move(value);
+                    slot.sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // the slot still holds an element from a lap ago
+            }
+            else
+            {
+                tail = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Dequeue one element.
+     * @return false if the queue is empty.
+     */
+    bool tryPop(T& out)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = m_slots[head & m_mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence - (head + 1));
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+                {
+                    out = std::move(slot.value);
+                    slot.sequence.store(head + m_capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // not written yet
+            }
+            else
+            {
+                head = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+  private:
+    struct alignas(64) Slot
+    {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    static size_t roundUpPow2(size_t n)
+    {
+        size_t cap = 2;
+        while (cap < n)
+        {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+} // namespace utils
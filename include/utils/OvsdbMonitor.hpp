@@ -0,0 +1,127 @@
+#pragma once
+
+#include "utils/StopSignal.hpp" // for StopSignal
+#include <atomic>               // for atomic
+#include <cstdint>              // for uint32_t, uint64_t
+#include <functional>           // for function
+#include <map>                  // for map
+#include <memory>               // for shared_ptr
+#include <mutex>                // for mutex
+#include <nlohmann/json.hpp>    // for json
+#include <optional>             // for optional
+#include <string>               // for string
+#include <thread>               // for thread
+#include <unordered_map>        // for unordered_map
+#include <vector>               // for vector
+
+#define OVSDB_SOCKET_PATH "/var/run/openvswitch/db.sock" // ovsdb-server's default unix socket
+#define OVSDB_RECONNECT_MS 2000                          // wait between reconnect attempts
+#define OVSDB_REPLY_TIMEOUT_MS 2000                      // wait for the monitor's first reply
+#define OVSDB_READ_CHUNK 16384                           // bytes read from the socket at once
+
+namespace utils
+{
+
+/// The rows of the OVSDB Interface and Bridge tables that OvsdbMonitor follows.
+struct OvsdbState
+{
+    struct Interface
+    {
+        std::string name;
+        uint32_t ifindex = 0; // 0 while unset
+        uint32_t ofport = 0;  // 0 while unset or on error (-1)
+    };
+
+    std::unordered_map<std::string, Interface> interfaces; // by row UUID
+    std::unordered_map<std::string, std::string> bridges;  // row UUID -> bridge name
+    uint64_t version = 0;                                  // bumped by every update applied
+};
+
+/**
+ * @brief OVSDB JSON-RPC client that monitors the Interface (name, ifindex, ofport) and
+ *        Bridge (name) tables of the local Open vSwitch over its unix socket.
+ *
+ * start() connects, sends one "monitor" request and applies its reply as the initial state;
+ * a background thread then applies the "update" notifications ovsdb-server sends as ports
+ * and bridges come and go, and answers its "echo" keepalives. Each state is immutable once
+ * published: state() hands out a reference, and subscribers are called with every new one.
+ * When the server goes away the last state stays published and the thread reconnects every
+ * OVSDB_RECONNECT_MS, replacing the state with the new initial one.
+ *
+ * This replaces running and parsing "ovs-vsctl list interface" / "list-br" in Mininet mode.
+ * Thread-safe.
+ */
+class OvsdbMonitor
+{
+  public:
+    using Listener = std::function<void(const OvsdbState&)>;
+
+    static OvsdbMonitor& instance();
+
+    OvsdbMonitor(const OvsdbMonitor&) = delete;
+    OvsdbMonitor& operator=(const OvsdbMonitor&) = delete;
+
+    /**
+     * @brief Connect to @p socketPath and start monitoring, unless already running.
+     * @return false if the server could not be reached or did not answer the monitor request
+     *         within OVSDB_REPLY_TIMEOUT_MS; callers fall back to ovs-vsctl then.
+     */
+    bool start(const std::string& socketPath = OVSDB_SOCKET_PATH);
+    void stop();
+
+    /// The latest state; empty until start() succeeded.
+    std::shared_ptr<const OvsdbState> state() const;
+
+    /// Names of the bridges in the latest state, sorted.
+    std::vector<std::string> bridgeNames() const;
+
+    /**
+     * @brief Call @p listener with the current state now and with every new one, from the
+     *        monitor thread. A listener must not subscribe or unsubscribe.
+     * @return The id to unsubscribe() with.
+     */
+    uint64_t subscribe(Listener listener);
+
+    /// No call of that listener is running or will start once this returns.
+    void unsubscribe(uint64_t id);
+
+    /// {"connected", "interfaces", "bridges", "updates", "reconnects"}
+    nlohmann::json statsJson() const;
+
+  private:
+    OvsdbMonitor() = default;
+    ~OvsdbMonitor();
+
+    void run();
+    // Connect, send the monitor request and apply its reply; false (socket closed) on failure
+    bool openSession();
+    bool send(const nlohmann::json& message);
+    // The next message from the socket; nullopt once it is closed or fails
+    std::optional<nlohmann::json> readMessage();
+    // Answer an echo or apply an update; false if @p message is not one of those
+    bool handle(const nlohmann::json& message);
+    // Apply a <table-updates> object on top of the current state (or of none if @p initial)
+    void apply(const nlohmann::json& updates, bool initial);
+
+    std::mutex m_startMutex; // serialises start() and stop()
+    std::string m_socketPath;
+    std::thread m_thread;
+    StopSignal m_stop;
+
+    mutable std::mutex m_fdMutex; // lets stop() shut down the socket the thread reads
+    int m_fd = -1;
+    std::string m_buffer; // bytes read but not parsed yet; monitor thread (or start()) only
+
+    mutable std::mutex m_stateMutex;
+    std::shared_ptr<const OvsdbState> m_state = std::make_shared<const OvsdbState>();
+
+    std::mutex m_listenersMutex; // held while listeners run
+    std::map<uint64_t, Listener> m_listeners;
+    uint64_t m_nextListener = 1;
+
+    std::atomic<bool> m_connected{false};
+    std::atomic<uint64_t> m_updates{0};
+    std::atomic<uint64_t> m_reconnects{0};
+};
+
+} // namespace utils
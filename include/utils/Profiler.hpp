@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>    // for atomic
+#include <chrono>    // for seconds
+#include <cstdint>   // for uint64_t
+#include <mutex>     // for mutex
+#include <optional>  // for optional
+#include <stdexcept> // for runtime_error
+#include <string>    // for string
+
+#define PROFILER_DEFAULT_HZ 99 // samples per second and thread; off the timer tick
+#define PROFILER_MAX_HZ 1000
+#define PROFILER_MAX_SECONDS 300
+#define PROFILER_RING_PAGES 64 // data pages of each thread's sample ring (2^n)
+#define PROFILER_DRAIN_MS 100  // rings are read this often, and new threads picked up
+
+namespace utils
+{
+
+/// A profile could not be taken: no perf events, or no allocation profiler in this build.
+class ProfilerUnavailable : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief On-demand profiles of the running process, for GET /ndt/debug/profile.
+ *
+ * cpuProfile() samples every thread of the process (new ones included, picked up within
+ * PROFILER_DRAIN_MS) with a perf_event_open CPU clock at @p hz for @p duration, the kernel
+ * walking each sample's user stack by frame pointers (build with NDT_FRAME_POINTERS, the
+ * default, for full stacks). The result is in the gperftools CPU profile format followed by
+ * /proc/self/maps, which `pprof <ndtwin_kernel binary> <file>` reads and symbolizes.
+ *
+ * heapProfile() is the live allocations sampled by tcmalloc, in the pprof heap format, when
+ * the build links gperftools (NDT_GPERFTOOLS); tcmalloc samples only with
+ * TCMALLOC_SAMPLE_PARAMETER set in its environment.
+ *
+ * Disabled until setEnabled(true) (ndtwin_kernel's --enable-profiling). One profile is taken
+ * at a time; both return nullopt while another is in progress.
+ */
+class Profiler
+{
+  public:
+    static Profiler& instance();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void setEnabled(bool enabled);
+    bool enabled() const;
+
+    /**
+     * @brief Sample the process's CPU use for @p duration; blocks meanwhile.
+     * @throws ProfilerUnavailable if no thread could be sampled (perf_event_paranoid, seccomp).
+     */
+    std::optional<std::string> cpuProfile(std::chrono::seconds duration,
+                                          unsigned hz = PROFILER_DEFAULT_HZ);
+
+    /**
+     * @brief The sampled live heap.
+     * @throws ProfilerUnavailable if the build has no gperftools.
+     */
+    std::optional<std::string> heapProfile();
+
+    /// Profiles taken, and samples the kernel dropped for full rings in the last one.
+    uint64_t profilesTaken() const;
+    uint64_t lastLostSamples() const;
+
+  private:
+    Profiler() = default;
+
+    std::atomic<bool> m_enabled{false};
+    std::mutex m_running; // held while a profile is taken
+    std::atomic<uint64_t> m_profiles{0};
+    std::atomic<uint64_t> m_lastLost{0};
+};
+
+} // namespace utils
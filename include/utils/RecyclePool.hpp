@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef> // for size_t
+#include <cstdint> // for uint64_t
+#include <utility> // for move
+#include <vector>  // for vector
+
+namespace utils
+{
+
+/**
+ * @brief Bounded free list that recycles objects instead of destroying them.
+ *
+ * Objects handed to release() are reset and parked; acquire() returns a parked object if
+ * there is one, so the heap buffers it owns (vectors, strings, ...) are reused by the next
+ * owner instead of being freed and reallocated. At most maxIdle objects are parked; beyond
+ * that release() simply destroys the object.
+ *
+ * Not thread-safe: callers serialize access (e.g. under the lock of the table that owns
+ * the objects).
+ *
+ * @tparam T Default-constructible, move-constructible type with a reset() member that
+ *           clears its state while keeping allocated capacity.
+ */
+template <typename T>
+class RecyclePool
+{
+  public:
+    explicit RecyclePool(size_t maxIdle = 0)
+        : m_maxIdle(maxIdle)
+    {
+    }
+
+    void setMaxIdle(size_t maxIdle)
+    {
+        m_maxIdle = maxIdle;
+        if (m_idle.size() > maxIdle)
+        {
+            m_idle.resize(maxIdle);
+        }
+    }
+
+    /**
+     * @brief Take a recycled object, or a fresh one if none is parked.
+     */
+    T acquire()
+    {
+        ++m_acquired;
+        if (m_idle.empty())
+        {
+            return T{};
+        }
+        ++m_reused;
+        T obj = std::move(m_idle.back());
+        m_idle.pop_back();
+        return obj;
+    }
+
+    /**
+     * @brief Reset @p obj and park it for reuse (or drop it if the pool is full).
+     */
+    void release(T&& obj)
+    {
+        if (m_idle.size() >= m_maxIdle)
+        {
+            ++m_discarded;
+            return;
+        }
+        obj.reset();
+        m_idle.push_back(std::move(obj));
+        ++m_recycled;
+    }
+
+    size_t idle() const
+    {
+        return m_idle.size();
+    }
+
+    size_t maxIdle() const
+    {
+        return m_maxIdle;
+    }
+
+    /**
+     * @brief Bytes of the parked objects themselves (not what they own).
+     */
+    size_t memoryBytes() const
+    {
+        return m_idle.capacity() * sizeof(T);
+    }
+
+    uint64_t acquired() const
+    {
+        return m_acquired;
+    }
+
+    uint64_t reused() const
+    {
+        return m_reused;
+    }
+
+    uint64_t recycled() const
+    {
+        return m_recycled;
+    }
+
+    uint64_t discarded() const
+    {
+        return m_discarded;
+    }
+
+  private:
+    std::vector<T> m_idle;
+    size_t m_maxIdle;
+    uint64_t m_acquired = 0;
+    uint64_t m_reused = 0;
+    uint64_t m_recycled = 0;
+    uint64_t m_discarded = 0;
+};
+
+} // namespace utils
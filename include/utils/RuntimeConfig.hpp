@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>           // for int64_t
+#include <functional>        // for function
+#include <map>               // for map
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <string>            // for string
+#include <variant>           // for variant
+#include <vector>            // for vector
+
+namespace utils
+{
+
+/**
+ * @brief Process-wide tunables read at run time instead of compiled in: a JSON file at
+ *        startup (--config) and the HTTP API afterwards.
+ *
+ * Each subsystem defines its parameters where it reads them, with the compiled-in default
+ * and, for integers, the accepted range. The file ({"name": value, ...}) is loaded before the
+ * subsystems are built, so a definition takes the file's value if it has a valid one and the
+ * default otherwise (logged). A parameter defined with an @c onChange callback is live: set()
+ * validates the new value and calls the callback, which applies it (resizing a batch,
+ * changing an interval, ...). The others are read once, at startup or at the next start() of
+ * their subsystem, and only the file changes them.
+ *
+ * Thread-safe. Callbacks run on the caller of set(), without the registry's lock held, and
+ * must stay callable until the parameter is defined again or the process exits.
+ */
+class RuntimeConfig
+{
+  public:
+    using OnChange = std::function<void(int64_t)>;
+
+    static RuntimeConfig& instance();
+
+    RuntimeConfig(const RuntimeConfig&) = delete;
+    RuntimeConfig& operator=(const RuntimeConfig&) = delete;
+
+    /**
+     * @brief Read the parameter file at @p path; false if it is unreadable or not a JSON
+     *        object (logged), in which case every parameter keeps its default.
+     */
+    bool load(const std::string& path);
+
+    /**
+     * @brief Define integer @p name in [@p min, @p max], live if @p onChange is given.
+     * @return Its value: the file's, else the one set before, else @p defaultValue.
+     */
+    int64_t defineInt(const std::string& name,
+                      const std::string& help,
+                      int64_t defaultValue,
+                      int64_t min,
+                      int64_t max,
+                      OnChange onChange = {});
+
+    /// Define string @p name (not live, never empty); returns its value as defineInt() does.
+    std::string defineString(const std::string& name,
+                             const std::string& help,
+                             const std::string& defaultValue);
+
+    /**
+     * @brief Set the live parameters in @p changes ({"name": value, ...}) all at once, or
+     *        none of them if one is unknown, not live or out of range.
+     * @return Empty on success, otherwise what was wrong.
+     */
+    std::string set(const nlohmann::json& changes);
+
+    /// Names given by the file that nothing has defined (a typo, or an unused subsystem).
+    std::vector<std::string> undefinedNames() const;
+
+    /// {"name": {"value", "default", "min", "max", "live", "help"}}, min and max for integers.
+    nlohmann::json toJson() const;
+
+  private:
+    RuntimeConfig() = default;
+
+    using Value = std::variant<int64_t, std::string>;
+
+    struct Parameter
+    {
+        std::string help;
+        Value value;
+        Value defaultValue;
+        int64_t min = 0;
+        int64_t max = 0;
+        OnChange onChange;
+    };
+
+    // Why @p value cannot be @p param's value; empty if it can
+    static std::string invalid(const Parameter& param, const nlohmann::json& value);
+    Value define(const std::string& name, Parameter param);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Parameter> m_parameters;
+    nlohmann::json m_file = nlohmann::json::object(); // as loaded, including undefined names
+};
+
+} // namespace utils
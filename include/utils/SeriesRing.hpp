@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>  // for atomic, atomic_thread_fence, memory_order
+#include <cstddef> // for size_t
+#include <cstdint> // for int64_t, uint64_t
+#include <memory>  // for unique_ptr
+#include <vector>  // for vector
+
+namespace utils
+{
+
+/// One point of a SeriesRing.
+struct SeriesPoint
+{
+    int64_t timestampMs = 0;
+    uint64_t value = 0;
+    uint64_t peak = 0; // highest value the point stands for (a rollup), else value
+};
+
+/**
+ * @brief The latest points of one time series; one writer, any number of readers.
+ *
+ * push() overwrites the oldest point and never blocks, allocates or waits for readers.
+ * Readers copy without locking either: the fields are relaxed atomics, and the write count
+ * is read before and after the copy, so points the writer may have overwritten meanwhile are
+ * dropped from the result rather than returned torn (a seqlock over the whole ring).
+ */
+class SeriesRing
+{
+  public:
+    explicit SeriesRing(size_t capacity)
+        : m_capacity(capacity),
+          m_slots(std::make_unique<Slot[]>(capacity))
+    {
+    }
+
+    SeriesRing(const SeriesRing&) = delete;
+    SeriesRing& operator=(const SeriesRing&) = delete;
+
+    /// Writer side.
+    void push(const SeriesPoint& point)
+    {
+        const uint64_t n = m_written.load(std::memory_order_relaxed);
+        // A reader that sees any of the stores below also sees that slot n is being written
+        std::atomic_thread_fence(std::memory_order_release);
+        Slot& slot = m_slots[n % m_capacity];
+        slot.timestampMs.store(point.timestampMs, std::memory_order_relaxed);
+        slot.value.store(point.value, std::memory_order_relaxed);
+        slot.peak.store(point.peak, std::memory_order_relaxed);
+        m_written.store(n + 1, std::memory_order_release);
+    }
+
+    /// Append the points taken in [@p fromMs, @p toMs] to @p out, oldest first.
+    void read(int64_t fromMs, int64_t toMs, std::vector<SeriesPoint>& out) const
+    {
+        const uint64_t end = m_written.load(std::memory_order_acquire);
+        const uint64_t begin = end > m_capacity ? end - m_capacity : 0;
+        const size_t first = out.size();
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            const Slot& slot = m_slots[i % m_capacity];
+            out.push_back({slot.timestampMs.load(std::memory_order_relaxed),
+                           slot.value.load(std::memory_order_relaxed),
+                           slot.peak.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // Writes since the copy started (and one possibly under way) replaced the oldest points
+        const uint64_t after = m_written.load(std::memory_order_relaxed);
+        const uint64_t valid = after + 1 > m_capacity ? after + 1 - m_capacity : 0;
+
+        size_t kept = first;
+        for (uint64_t i = begin; i < end; ++i)
+        {
+            const SeriesPoint& point = out[first + (i - begin)];
+            if (i >= valid && point.timestampMs >= fromMs && point.timestampMs <= toMs)
+            {
+                out[kept++] = point;
+            }
+        }
+        out.resize(kept);
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+  private:
+    struct Slot
+    {
+        std::atomic<int64_t> timestampMs{0};
+        std::atomic<uint64_t> value{0};
+        std::atomic<uint64_t> peak{0};
+    };
+
+    const size_t m_capacity;
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<uint64_t> m_written{0};
+};
+
+} // namespace utils
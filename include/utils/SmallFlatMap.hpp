@@ -0,0 +1,198 @@
+#pragma once
+
+#include <array>       // for array
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint8_t
+#include <memory>      // for construct_at, destroy_at
+#include <tuple>       // for forward_as_tuple
+#include <type_traits> // for conditional_t
+#include <utility>     // for pair, piecewise_construct
+#include <vector>      // for vector
+
+namespace utils
+{
+
+/**
+ * @brief Tiny associative container with N entries stored inline.
+ *
+ * Keeps up to N (key, value) pairs inside the object and spills the rest into a vector.
+ * Lookup is a linear scan, which beats a tree or hash for the handful of entries it is
+ * meant for (e.g. the sFlow agents that saw one flow). Entries are only removed by clear().
+ *
+ * Iteration order is insertion order. References stay valid until the next insertion that
+ * spills into (and reallocates) the overflow vector.
+ *
+ * @tparam K Key type with operator==.
+ * @tparam V Default-constructible value type.
+ */
+template <typename K, typename V, size_t N>
+class SmallFlatMap
+{
+    static_assert(N > 0 && N < 256, "inline capacity must fit the uint8_t counter");
+
+  public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+
+    template <bool Const>
+    class Iterator
+    {
+      public:
+        using MapPtr = std::conditional_t<Const, const SmallFlatMap*, SmallFlatMap*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iterator(MapPtr map, size_t index)
+            : m_map(map),
+              m_index(index)
+        {
+        }
+
+        reference operator*() const
+        {
+            return m_map->at(m_index);
+        }
+
+        pointer operator->() const
+        {
+            return &m_map->at(m_index);
+        }
+
+        Iterator& operator++()
+        {
+            ++m_index;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return m_index == other.m_index;
+        }
+
+      private:
+        MapPtr m_map;
+        size_t m_index;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    iterator begin()
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end()
+    {
+        return iterator(this, size());
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, size());
+    }
+
+    size_t size() const
+    {
+        return m_inlineCount + m_overflow.size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * @brief Heap bytes of the entries beyond the inline ones (the rest is in the object).
+     */
+    size_t overflowBytes() const
+    {
+        return m_overflow.capacity() * sizeof(value_type);
+    }
+
+    iterator find(const K& key)
+    {
+        return iterator(this, indexOf(key));
+    }
+
+    const_iterator find(const K& key) const
+    {
+        return const_iterator(this, indexOf(key));
+    }
+
+    size_t count(const K& key) const
+    {
+        return indexOf(key) != size() ? 1 : 0;
+    }
+
+    /**
+     * @brief Return the value for @p key, default-constructing it on first use.
+     */
+    V& operator[](const K& key)
+    {
+        size_t idx = indexOf(key);
+        if (idx != size())
+        {
+            return at(idx).second;
+        }
+        if (m_inlineCount < N)
+        {
+            // Unused inline slots hold a default-constructed pair, so only the key is set
+            value_type& slot = m_inline[m_inlineCount++];
+            slot.first = key;
+            return slot.second;
+        }
+        return m_overflow
+            .emplace_back(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>())
+            .second;
+    }
+
+    /**
+     * @brief Remove all entries, keeping the overflow vector's capacity.
+     */
+    void clear()
+    {
+        for (size_t i = 0; i < m_inlineCount; ++i)
+        {
+            std::destroy_at(&m_inline[i]);
+            std::construct_at(&m_inline[i]);
+        }
+        m_inlineCount = 0;
+        m_overflow.clear();
+    }
+
+  private:
+    value_type& at(size_t i)
+    {
+        return i < m_inlineCount ? m_inline[i] : m_overflow[i - m_inlineCount];
+    }
+
+    const value_type& at(size_t i) const
+    {
+        return i < m_inlineCount ? m_inline[i] : m_overflow[i - m_inlineCount];
+    }
+
+    size_t indexOf(const K& key) const
+    {
+        for (size_t i = 0; i < size(); ++i)
+        {
+            if (at(i).first == key)
+            {
+                return i;
+            }
+        }
+        return size();
+    }
+
+    std::array<value_type, N> m_inline;
+    uint8_t m_inlineCount = 0;
+    std::vector<value_type> m_overflow;
+};
+
+} // namespace utils
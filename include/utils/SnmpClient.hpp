@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>                              // for atomic
+#include <boost/asio/executor_work_guard.hpp>  // for executor_work_guard
+#include <boost/asio/io_context.hpp>           // for io_context
+#include <boost/asio/ip/udp.hpp>               // for udp
+#include <boost/system/error_code.hpp>         // for error_code
+#include <chrono>                              // for milliseconds
+#include <cstdint>                             // for uint32_t, int64_t
+#include <functional>                          // for function
+#include <memory>                              // for shared_ptr
+#include <nlohmann/json.hpp>                   // for json
+#include <optional>                            // for optional
+#include <string>                              // for string
+#include <thread>                              // for thread
+#include <unordered_map>                       // for unordered_map
+#include <vector>                              // for vector
+
+#define SNMP_CLIENT_PORT 161                // agent UDP port
+#define SNMP_CLIENT_TIMEOUT_MS 1000         // for each attempt of a request
+#define SNMP_CLIENT_RETRIES 2               // extra attempts after a timeout
+#define SNMP_CLIENT_MAX_REPETITIONS 16      // varbinds asked for by each GETBULK of a walk
+#define SNMP_CLIENT_MAX_DATAGRAM 65507      // largest response accepted
+
+namespace utils
+{
+
+/// Object identifier as its arcs, e.g. {1, 3, 6, 1, 2, 1}.
+using SnmpOid = std::vector<uint32_t>;
+
+/// Parses a dotted OID ("1.3.6.1.2.1"); throws std::invalid_argument if malformed.
+SnmpOid parseSnmpOid(const std::string& dotted);
+
+/// One variable of a response.
+struct SnmpVarBind
+{
+    SnmpOid oid;
+    // INTEGER, Counter32, Gauge32, TimeTicks and Counter64 values; unset for others
+    std::optional<int64_t> integer;
+    // OCTET STRING (and Opaque) values
+    std::string octets;
+};
+
+/**
+ * @brief One request of an SnmpClient: a GET of @c oids, a walk of the subtree under the
+ *        single OID in @c oids, or a SET of each of @c oids to the INTEGER in @c integers.
+ */
+struct SnmpQuery
+{
+    enum class Kind
+    {
+        Get,
+        Walk,
+        Set,
+    };
+
+    uint32_t agentIp = 0; // network byte order, as in VertexProperties::ip
+    Kind kind = Kind::Get;
+    std::vector<SnmpOid> oids;
+    std::vector<int64_t> integers{}; // Set: one value per OID
+    std::string community = "public";
+};
+
+/**
+ * @brief Outcome of an SnmpQuery.
+ *
+ * A timeout, an undecodable response or an agent error (error-status) sets @c error. A GET
+ * keeps the agent's order; an OID the agent does not have is left out, as is the end of a
+ * walk. A SET that the agent refuses (read-only community, bad value) is an error.
+ */
+struct SnmpResponse
+{
+    std::vector<SnmpVarBind> values;
+    boost::system::error_code error;
+
+    bool ok() const
+    {
+        return !error;
+    }
+
+    /// The integer value of @p oid, or of the first variable when @p oid is empty.
+    std::optional<int64_t> integer(const SnmpOid& oid = {}) const;
+};
+
+struct SnmpRequestOptions
+{
+    std::chrono::milliseconds timeout{SNMP_CLIENT_TIMEOUT_MS};
+    unsigned retries = SNMP_CLIENT_RETRIES;
+};
+
+/**
+ * @brief Process-wide SNMPv2c client over one UDP socket.
+ *
+ * Replaces forking snmpget/snmpwalk for the device health polls. Requests of every agent are
+ * in flight at once on the client's own I/O thread; responses are matched to their request
+ * by request-id and decoded from BER straight into SnmpVarBinds. A walk is a sequence of
+ * GETBULK requests of SNMP_CLIENT_MAX_REPETITIONS varbinds each, until a variable falls
+ * outside the subtree or the agent reports the end of its MIB view.
+ *
+ * An attempt that gets no response within options.timeout is sent again, with a new
+ * request-id so a late answer to the old one is dropped, up to options.retries times.
+ *
+ * Callbacks run on the client thread and must not block: query() from a callback throws.
+ */
+class SnmpClient
+{
+  public:
+    using Callback = std::function<void(SnmpResponse)>;
+
+    static SnmpClient& instance();
+
+    SnmpClient(const SnmpClient&) = delete;
+    SnmpClient& operator=(const SnmpClient&) = delete;
+    ~SnmpClient();
+
+    /**
+     * @brief Send @p query and call @p done with its outcome on the client thread.
+     * @throws std::invalid_argument for a walk of other than one OID, a GET of none or a SET
+     *         without one value per OID.
+     */
+    void asyncQuery(SnmpQuery query, Callback done, const SnmpRequestOptions& options = {});
+
+    /**
+     * @brief Send all @p queries at once and wait for their outcomes, in the same order.
+     * @throws std::invalid_argument as asyncQuery().
+     * @throws std::logic_error when called from an SnmpClient callback.
+     */
+    std::vector<SnmpResponse> query(std::vector<SnmpQuery> queries,
+                                    const SnmpRequestOptions& options = {});
+
+    /**
+     * @brief {"requests", "responses", "retries", "timeouts", "errors", "stray_responses",
+     *        "in_flight"}.
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    class Operation;
+
+    SnmpClient();
+
+    // Start receiving the next datagram
+    void receive();
+    // Match a datagram to its Operation and let it continue
+    void onDatagram(size_t length);
+    // Give @p op a fresh request-id and send its next request (client thread)
+    void send(const std::shared_ptr<Operation>& op);
+    // Deliver the outcome of @p op, once (client thread)
+    void finish(const std::shared_ptr<Operation>& op, boost::system::error_code ec);
+
+    boost::asio::io_context m_ioc;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> m_work;
+    boost::asio::ip::udp::socket m_socket;
+    boost::asio::ip::udp::endpoint m_sender;
+    std::vector<unsigned char> m_receiveBuffer;
+    std::thread m_thread;
+
+    // In flight, by request-id; touched on the client thread only
+    std::unordered_map<int32_t, std::shared_ptr<Operation>> m_pending;
+    int32_t m_nextRequestId = 1;
+
+    std::atomic<uint64_t> m_requests{0};
+    std::atomic<uint64_t> m_responses{0};
+    std::atomic<uint64_t> m_retries{0};
+    std::atomic<uint64_t> m_timeouts{0};
+    std::atomic<uint64_t> m_errors{0};
+    std::atomic<uint64_t> m_strayResponses{0};
+    std::atomic<uint64_t> m_inFlight{0};
+};
+
+} // namespace utils
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>  // for atomic, memory_order
+#include <cstddef> // for size_t
+#include <utility> // for move
+#include <vector>  // for vector
+
+namespace utils
+{
+
+/**
+ * @brief Bounded lock-free single-producer / single-consumer ring buffer.
+ *
+ * Exactly one thread may call tryPush() and exactly one (other) thread may call tryPop().
+ * size() may be called from any thread and returns an approximate occupancy.
+ *
+ * Capacity is rounded up to a power of two. Producer and consumer indices live on separate
+ * cache lines, and each side caches the other's index so the fast path touches only its own
+ * line until the ring looks full or empty.
+ *
+ * @tparam T Element type; must be default constructible and move assignable.
+ */
+template <typename T>
+class SpscRing
+{
+  public:
+    explicit SpscRing(size_t capacity)
+        : m_slots(roundUpPow2(capacity)),
+          m_mask(m_slots.size() - 1)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /**
+     * @brief Enqueue one element (producer side).
+     * @return false if the ring is full; the element is left untouched.
+     */
+    bool tryPush(T&& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead == m_slots.size())
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead == m_slots.size())
+            {
+                return false;
+            }
+        }
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPush(const T& value)
+    {
+        T copy = value;
+        return tryPush(std::move(copy));
+    }
+
+    /**
+     * @brief Dequeue one element (consumer side).
+     * @return false if the ring is empty.
+     */
+    bool tryPop(T& out)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail)
+            {
+                return false;
+            }
+        }
+        out = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const
+    {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    size_t capacity() const
+    {
+        return m_slots.size();
+    }
+
+  private:
+    static size_t roundUpPow2(size_t n)
+    {
+        size_t cap = 2;
+        while (cap < n)
+        {
+            cap <<= 1;
+        }
+        return cap;
+    }
+
+    std::vector<T> m_slots;
+    const size_t m_mask;
+
+    // consumer-owned
+    alignas(64) std::atomic<size_t> m_head{0};
+    size_t m_cachedTail = 0;
+
+    // producer-owned
+    alignas(64) std::atomic<size_t> m_tail{0};
+    size_t m_cachedHead = 0;
+};
+
+} // namespace utils
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable> // for condition_variable
+#include <cstdint>            // for uint64_t
+#include <map>                // for map
+#include <mutex>              // for mutex
+#include <nlohmann/json.hpp>  // for json
+#include <string>             // for string
+#include <vector>             // for vector
+
+#define SSH_POOL_MAX_SESSIONS_PER_DEVICE 2 // sessions run at once on one switch, others wait
+#define SSH_POOL_PERSIST_SECONDS 300       // an idle master connection closes after this
+#define SSH_POOL_KEEPALIVE_SECONDS 15      // ServerAliveInterval of the master connection
+#define SSH_POOL_KEEPALIVE_COUNT 3         // unanswered keepalives before it is dropped
+#define SSH_POOL_CONNECT_TIMEOUT_SECONDS 10
+#define SSH_POOL_COMMAND_GAP_MS 1000       // between CLI lines, for the switch to show its prompt
+#define SSH_POOL_TIMEOUT_MS 30000          // of a whole session, then the ssh client is killed
+
+namespace utils
+{
+
+/// Outcome of SshSessionPool::run().
+struct SshResult
+{
+    std::string output; // what the switch CLI printed
+    bool ok = false;    // the session was established and ended before SSH_POOL_TIMEOUT_MS
+};
+
+/**
+ * @brief Process-wide pool of SSH connections to the switches.
+ *
+ * Each user@host gets one OpenSSH master connection (ControlMaster), opened by its first
+ * session and kept SSH_POOL_PERSIST_SECONDS after its last one, with keepalives so a dead
+ * switch is noticed. Later sessions are channels multiplexed over it: no TCP handshake, key
+ * exchange or authentication, so polling many switches costs their command time only.
+ *
+ * A session writes its CLI lines to the remote shell one after another, SSH_POOL_COMMAND_GAP_MS
+ * apart, while the output is read. At most SSH_POOL_MAX_SESSIONS_PER_DEVICE sessions run on
+ * a switch at once. When a session cannot reach the switch over an existing master connection
+ * (it went stale, say after the switch rebooted), the master is closed and the session retried
+ * once over a new one.
+ *
+ * The ssh client is run directly (no shell), with the options older switch SSH stacks need
+ * (KexAlgorithms/Ciphers/HostKeyAlgorithms) and host key checking off.
+ *
+ * Thread-safe; run() blocks.
+ */
+class SshSessionPool
+{
+  public:
+    static SshSessionPool& instance();
+
+    SshSessionPool(const SshSessionPool&) = delete;
+    SshSessionPool& operator=(const SshSessionPool&) = delete;
+    /// Closes the master connections.
+    ~SshSessionPool();
+
+    /// Run @p commands, one CLI line each, in one session on @p host as @p username.
+    SshResult run(const std::string& host,
+                  const std::string& username,
+                  const std::vector<std::string>& commands);
+
+    /// Per user@host: {"sessions", "failures", "reconnects", "active"}.
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Device
+    {
+        unsigned active = 0; // sessions running
+        uint64_t sessions = 0;
+        uint64_t failures = 0;
+        uint64_t reconnects = 0;
+    };
+
+    SshSessionPool();
+
+    // ssh argument list for @p destination (user@host), before any remote command
+    std::vector<std::string> sshArgs(const std::string& destination) const;
+    // One session over the (possibly new) master connection; @p connectionError is set when
+    // ssh could not reach the switch through it
+    SshResult runOnce(const std::string& destination,
+                      const std::vector<std::string>& commands,
+                      bool& connectionError);
+    // Close the master connection of @p destination; false if there was none
+    bool closeMaster(const std::string& destination);
+
+    std::string m_controlDir; // holds the master connections' sockets
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv; // a session ended
+    std::map<std::string, Device> m_devices;
+};
+
+} // namespace utils
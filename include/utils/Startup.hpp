@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>             // for steady_clock
+#include <condition_variable> // for condition_variable
+#include <cstdint>            // for int64_t
+#include <functional>         // for function
+#include <map>                // for map
+#include <mutex>              // for mutex
+#include <nlohmann/json.hpp>  // for json
+#include <string>             // for string
+#include <vector>             // for vector
+
+namespace utils
+{
+
+/// One subsystem's start for Startup::run().
+struct StartupStep
+{
+    std::string name;
+    std::vector<std::string> after; // steps whose start() must have returned first
+    std::function<void()> start;
+    // The subsystem calls Startup::markWarm(name) once it is warm (its first load or poll
+    // done); otherwise it is warm when start() returns
+    bool warmsLater = false;
+};
+
+/**
+ * @brief Starts the subsystems concurrently and tracks when each is warm, for the readiness
+ *        endpoint.
+ *
+ * run() gives every step its own thread as soon as the steps it comes after have returned,
+ * so slow starts (the topology load, ovs-vsctl, the first Ryu fetch, the HTTP bind) overlap
+ * instead of waiting on each other. A step that throws is failed, and so are the steps after
+ * it; the others go on.
+ *
+ * A subsystem is pending, starting, started (start() returned, warming up), warm or failed.
+ * The process is ready once every step is warm.
+ */
+class Startup
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static Startup& instance();
+
+    Startup(const Startup&) = delete;
+    Startup& operator=(const Startup&) = delete;
+
+    /**
+     * @brief Run @p steps as described above, returning once every start() has returned or
+     *        failed.
+     * @return Whether none failed.
+     */
+    bool run(std::vector<StartupStep> steps);
+
+    /// Subsystem @p name is warm; safe before its start() returns, and more than once.
+    void markWarm(const std::string& name);
+
+    /// Whether every step run() was given is warm.
+    bool ready() const;
+
+    /// {"ready", "subsystems": {name: {"state", "started_ms", "warm_ms", "error"}}}; times
+    /// are since Startup was first used, and present once reached.
+    nlohmann::json toJson() const;
+
+  private:
+    Startup() = default;
+
+    struct Subsystem
+    {
+        std::string state = "pending";
+        int64_t startedMs = -1; // start() returned
+        int64_t warmMs = -1;
+        bool warmsLater = false;
+        std::string error;
+    };
+
+    int64_t sinceLaunchMs() const;
+    // Record that @p name's start() returned, or threw @p error (caller holds m_mutex)
+    void finishNoLock(const std::string& name, const std::string& error);
+
+    const Clock::time_point m_launch = Clock::now();
+    mutable std::mutex m_mutex;
+    std::condition_variable m_finished; // a start() returned or failed
+    std::map<std::string, Subsystem> m_subsystems;
+};
+
+} // namespace utils
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>             // for duration, time_point
+#include <condition_variable> // for condition_variable
+#include <mutex>              // for mutex, lock_guard, unique_lock
+
+namespace utils
+{
+
+/**
+ * @brief Interruptible sleep for the periodic worker threads of a component.
+ *
+ * Workers wait between rounds with waitFor() / waitUntil() instead of
+ * std::this_thread::sleep_for(), and the component's stop() calls request(), which wakes
+ * every waiting worker at once: shutdown no longer waits out the rest of a period, and no
+ * worker has to poll a flag in short slices to stay responsive.
+ */
+class StopSignal
+{
+  public:
+    /// Arm for a new run (start() after a stop()).
+    void reset()
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopped = false;
+    }
+
+    /// Wake every waiter; waits return false until reset().
+    void request()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cv.notify_all();
+    }
+
+    bool requested() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_stopped;
+    }
+
+    /// Sleep for @p period; false if stop was requested (before or during the wait).
+    template <typename Rep, typename Period>
+    bool waitFor(const std::chrono::duration<Rep, Period>& period)
+    {
+        std::unique_lock lock(m_mutex);
+        return !m_cv.wait_for(lock, period, [this] { return m_stopped; });
+    }
+
+    /// Sleep until @p deadline; false if stop was requested (before or during the wait).
+    template <typename Clock, typename Duration>
+    bool waitUntil(const std::chrono::time_point<Clock, Duration>& deadline)
+    {
+        std::unique_lock lock(m_mutex);
+        return !m_cv.wait_until(lock, deadline, [this] { return m_stopped; });
+    }
+
+  private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopped = false;
+};
+
+} // namespace utils
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <chrono>             // for steady_clock
+#include <condition_variable> // for condition_variable
+#include <cstdint>            // for uint64_t
+#include <functional>         // for function
+#include <map>                // for map
+#include <memory>             // for shared_ptr
+#include <mutex>              // for mutex
+#include <nlohmann/json.hpp>  // for json
+#include <string>             // for string
+#include <thread>             // for thread
+#include <vector>             // for vector
+
+#define TASK_SCHEDULER_THREADS 3  // workers running the periodic tasks of all subsystems
+#define TASK_SCHEDULER_RESERVED 1 // of them, workers kept free for High tasks
+
+namespace utils
+{
+
+/// Which due task a free worker runs first.
+enum class TaskPriority
+{
+    High,   // short ticks that others read the results of (rates, purge, sampling)
+    Normal, // housekeeping
+    Low,    // polls that block on devices
+};
+
+struct TaskSchedulerConfig
+{
+    unsigned threads = TASK_SCHEDULER_THREADS;
+    std::vector<unsigned> cpus; // workers may only run on these CPUs; empty: any
+};
+
+/**
+ * @brief Process-wide pool of a few threads running the periodic jobs of every subsystem
+ *        (rate tick, purge, edge-flow expiry, history sampling, pings, device polls), in
+ *        place of a sleeping thread per job.
+ *
+ * A task runs every @c period, measured from when its last run was due, never overlapping
+ * itself; a run that ends after the next was due is followed by one run at once, not by a
+ * burst catching up. Among the due tasks a free worker takes the highest priority, then the
+ * one due longest. TASK_SCHEDULER_RESERVED workers only take High tasks, so jobs that block
+ * on devices cannot delay the ticks others depend on.
+ *
+ * Only latency-critical work keeps dedicated threads: sFlow ingest (optionally pinned),
+ * the I/O threads of the NDT server and the per-switch dispatch queues.
+ *
+ * The workers start with the first schedule(); configure() beforehand to change their
+ * number or CPUs. An exception thrown by a job is logged and the task keeps its schedule.
+ */
+class TaskScheduler
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    using TaskId = uint64_t;
+
+    static TaskScheduler& instance();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    ~TaskScheduler();
+
+    /// Set the pool up; ignored once the workers run.
+    void configure(TaskSchedulerConfig config);
+
+    /**
+     * @brief Run @p job every @p period, first after one period or at once if @p runNow.
+     * @return Id for runAt() and cancel().
+     */
+    TaskId schedule(std::string name,
+                    TaskPriority priority,
+                    Clock::duration period,
+                    std::function<void()> job,
+                    bool runNow = false);
+
+    /**
+     * @brief Bring the next run of @p id forward to @p when (never later than its period);
+     *        from the task's own job this sets when the job runs next, e.g. a random delay.
+     */
+    void runAt(TaskId id, Clock::time_point when);
+
+    /// Id of the task whose job the calling thread runs; 0 outside of jobs.
+    static TaskId current();
+
+    /**
+     * @brief Remove @p id, waiting for a run in progress to finish, so the job's captures
+     *        may be destroyed afterwards. From the task's own job it only removes it.
+     */
+    void cancel(TaskId id);
+
+    /// Cancel every task and join the workers.
+    void shutdown();
+
+    /**
+     * @brief {"threads", "reserved", "cpus", "busy", "tasks": [{"name", "priority",
+     *        "period_ms", "runs", "failures", "late_runs", "mean_run_ms", "max_run_ms",
+     *        "max_lag_ms"}]}; lag is how long after being due a run started, a late run one
+     *        that ended after the next was due.
+     */
+    nlohmann::json statsJson() const;
+
+  private:
+    struct Task
+    {
+        TaskId id = 0;
+        std::string name;
+        TaskPriority priority = TaskPriority::Normal;
+        Clock::duration period{};
+        std::function<void()> job;
+        Clock::time_point nextRun;
+        Clock::time_point requestedRun = Clock::time_point::max(); // runAt() while running
+        bool running = false;
+
+        uint64_t runs = 0;
+        uint64_t failures = 0;
+        uint64_t lateRuns = 0;
+        Clock::duration totalRun{};
+        Clock::duration maxRun{};
+        Clock::duration maxLag{};
+    };
+
+    TaskScheduler() = default;
+
+    void startNoLock();
+    void work(size_t index);
+    // Due task a worker may take now, or null; sets @p wakeAt to when to look again
+    std::shared_ptr<Task> pickNoLock(Clock::time_point now, Clock::time_point& wakeAt) const;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    TaskSchedulerConfig m_config;
+    std::map<TaskId, std::shared_ptr<Task>> m_tasks;
+    TaskId m_nextId = 1;
+    std::vector<std::thread> m_workers;
+    unsigned m_busy = 0;
+    unsigned m_busyUnreserved = 0; // workers running Normal or Low tasks
+    bool m_stopping = false;
+};
+
+} // namespace utils
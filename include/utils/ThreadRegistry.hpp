@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>            // for atomic
+#include <cstdint>           // for int64_t, uint64_t
+#include <ctime>             // for clockid_t
+#include <map>               // for map
+#include <memory>            // for shared_ptr
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <string>            // for string
+#include <vector>            // for vector
+
+#define THREAD_NAME_MAX 15 // kernel limit of a thread name, as top and perf show it
+
+namespace utils
+{
+
+/// Name the calling thread for top, perf and gdb, cut to THREAD_NAME_MAX characters.
+void setThreadName(const std::string& name);
+
+/**
+ * @brief Confine the calling thread to @p cpus (none: leave it as is).
+ * @return 0, or the error of pthread_setaffinity_np().
+ */
+int setThreadAffinity(const std::vector<unsigned>& cpus);
+
+/**
+ * @brief The process's long-lived threads, for GET /ndt/debug/threads: per thread its CPU
+ *        time (CLOCK_THREAD_CPUTIME_ID of the thread), how often it woke up for work and
+ *        how long its last round of work took.
+ *
+ * A thread registers by creating a Scope first thing, which also names it, and is listed
+ * until the Scope is destroyed. Loops that wait for work call wake() when they get some and
+ * idle() when done (or before waiting again); threads that don't only report their CPU
+ * time.
+ */
+class ThreadRegistry
+{
+  private:
+    struct Entry;
+
+  public:
+    class Scope
+    {
+      public:
+        explicit Scope(std::string name, const std::vector<unsigned>& cpus = {});
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void wake();
+        void idle();
+
+      private:
+        std::shared_ptr<Entry> m_entry;
+    };
+
+    static ThreadRegistry& instance();
+
+    ThreadRegistry(const ThreadRegistry&) = delete;
+    ThreadRegistry& operator=(const ThreadRegistry&) = delete;
+
+    /**
+     * @brief [{"name", "tid", "cpus", "cpu_ms", "wakeups", "last_iteration_us"}], the
+     *        busiest first; cpus is empty when the thread may run anywhere.
+     */
+    nlohmann::json toJson() const;
+
+  private:
+    struct Entry
+    {
+        std::string name;
+        int64_t tid = 0;
+        clockid_t clock{};
+        std::vector<unsigned> cpus;
+        std::atomic<uint64_t> wakeups{0};
+        std::atomic<int64_t> wokeAtNs{0};
+        std::atomic<int64_t> lastIterationNs{0};
+    };
+
+    ThreadRegistry() = default;
+
+    mutable std::mutex m_mutex;
+    std::map<Entry*, std::shared_ptr<Entry>> m_threads;
+};
+
+} // namespace utils
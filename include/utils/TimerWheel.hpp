@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm> // for max, min
+#include <cstddef>   // for size_t
+#include <cstdint>   // for int64_t
+#include <vector>    // for vector
+
+namespace utils
+{
+
+/**
+ * @brief Single-level hashed timer wheel for lazily re-checked deadlines.
+ *
+ * Time is divided into ticks of tickMs; slot (tick % slots) collects the keys due in that
+ * tick. advance(now) drains only the slots whose tick has passed, so its cost is
+ * proportional to the number of due keys, not to the number of scheduled ones.
+ *
+ * The wheel does not support cancellation or moving a key. Owners that keep extending a
+ * deadline (e.g. a flow that is still active) leave the old entry in place and, when it
+ * fires, check the real deadline and schedule() the key again. Deadlines further out than
+ * the wheel's horizon are parked in the last slot of the horizon and re-checked there.
+ *
+ * Not thread-safe: callers serialize access.
+ */
+template <typename Key>
+class TimerWheel
+{
+  public:
+    TimerWheel(int64_t tickMs, size_t slots)
+        : m_tickMs(tickMs),
+          m_slots(slots)
+    {
+    }
+
+    /**
+     * @brief Fire @p key at the first advance() whose time is >= @p deadlineMs.
+     */
+    void schedule(const Key& key, int64_t deadlineMs)
+    {
+        int64_t tick = (deadlineMs + m_tickMs - 1) / m_tickMs;
+        if (!m_started)
+        {
+            m_nextTick = tick;
+            m_started = true;
+        }
+        const int64_t horizon = m_nextTick + static_cast<int64_t>(m_slots.size()) - 1;
+        tick = std::min(std::max(tick, m_nextTick), horizon);
+        m_slots[static_cast<size_t>(tick) % m_slots.size()].push_back(key);
+        ++m_size;
+    }
+
+    /**
+     * @brief Invoke @p onDue(key) for every key whose tick is <= nowMs / tickMs.
+     *
+     * @p onDue may call schedule(); keys rescheduled from the callback land in a later tick
+     * and are not fired again within the same call.
+     */
+    template <typename OnDue>
+    void advance(int64_t nowMs, OnDue&& onDue)
+    {
+        if (!m_started)
+        {
+            return;
+        }
+        const int64_t nowTick = nowMs / m_tickMs;
+        // After a long stall (or clock jump) every slot is due once; no need to spin per tick
+        const int64_t lastTick =
+            std::min(nowTick, m_nextTick + static_cast<int64_t>(m_slots.size()) - 1);
+        int64_t tick = m_nextTick;
+        if (nowTick >= m_nextTick)
+        {
+            m_nextTick = nowTick + 1;
+        }
+        // Collect every due key before calling back, so reschedules cannot land in a slot
+        // that is still to be drained by this call
+        m_scratch.clear();
+        for (; tick <= lastTick; ++tick)
+        {
+            auto& slot = m_slots[static_cast<size_t>(tick) % m_slots.size()];
+            m_scratch.insert(m_scratch.end(), slot.begin(), slot.end());
+            slot.clear();
+        }
+        m_size -= m_scratch.size();
+        for (const Key& key : m_scratch)
+        {
+            onDue(key);
+        }
+    }
+
+    /**
+     * @brief Number of scheduled entries (including ones that will only be re-checked).
+     */
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * @brief Heap bytes of the slots and their entries, by capacity.
+     */
+    size_t memoryBytes() const
+    {
+        size_t bytes = (m_slots.capacity() + 1) * sizeof(std::vector<Key>) +
+                       m_scratch.capacity() * sizeof(Key);
+        for (const auto& slot : m_slots)
+        {
+            bytes += slot.capacity() * sizeof(Key);
+        }
+        return bytes;
+    }
+
+  private:
+    int64_t m_tickMs;
+    std::vector<std::vector<Key>> m_slots;
+    std::vector<Key> m_scratch;
+    int64_t m_nextTick = 0;
+    bool m_started = false;
+    size_t m_size = 0;
+};
+
+} // namespace utils
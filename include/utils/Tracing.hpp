@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>            // for steady_clock
+#include <cstdint>           // for uint64_t
+#include <deque>             // for deque
+#include <mutex>             // for mutex
+#include <nlohmann/json.hpp> // for json
+#include <optional>          // for optional
+#include <random>            // for mt19937_64
+#include <string>            // for string
+#include <string_view>       // for string_view
+#include <vector>            // for vector
+
+#define TRACE_KEEP_MAX 256        // traces kept for GET /ndt/debug/traces, oldest dropped first
+#define TRACE_SPANS_MAX 128       // spans kept per trace; later ones only feed the histograms
+#define TRACE_JOIN_WINDOW_MS 5000 // an untraced urgent flow batch joins a trace this recent
+
+namespace utils
+{
+
+/// 128-bit trace id as OpenTelemetry has it; all zero means "not traced".
+struct TraceId
+{
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    explicit operator bool() const
+    {
+        return high != 0 || low != 0;
+    }
+
+    bool operator==(const TraceId&) const = default;
+
+    /// 32 lowercase hex digits.
+    std::string toHex() const;
+
+    /// Parse toHex()'s form; nullopt for anything else, the all-zero id included.
+    static std::optional<TraceId> fromHex(std::string_view hex);
+};
+
+/**
+ * @brief Lightweight span tracing of failover, from the link failure to the flow-mods applied.
+ *
+ * A trace begins where a failure is received; its id then travels with the work (in the
+ * LinkStateChanged payload, the collector's path re-resolution queue and each FlowJob), and
+ * every stage that handles it records a span: event receipt, handler dispatch, path
+ * computation, dispatcher queue, southbound send and classifier confirmation. Each span also
+ * feeds ndt_failover_stage_seconds{stage}, and each traced flow batch that completes feeds
+ * ndt_failover_seconds with the time since its trace began.
+ *
+ * Only the TRACE_KEEP_MAX latest traces are kept, for toOtlpJson(). Stages record one span
+ * per trace and unit of work (a burst, a pass), not per flow, so the cost stays with the
+ * failures. Thread-safe.
+ */
+class Tracer
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static Tracer& instance();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /// Start a trace named @p name (the root span) at @p start; returns its id.
+    TraceId begin(std::string name, Clock::time_point start, nlohmann::json attributes = {});
+
+    /**
+     * @brief Record stage @p stage of @p trace from @p start to @p end. A trace no longer kept
+     *        still feeds the histogram; an untraced id (all zero) is ignored.
+     */
+    void span(TraceId trace,
+              std::string_view stage,
+              Clock::time_point start,
+              Clock::time_point end,
+              nlohmann::json attributes = {});
+
+    /// A piece of work of @p trace finished at @p end: observe ndt_failover_seconds.
+    void complete(TraceId trace, Clock::time_point end);
+
+    /// The latest trace begun within @p window, or the untraced id.
+    TraceId recent(Clock::duration window) const;
+
+    /**
+     * @brief The @p limit latest traces, newest first, as an OTLP/JSON ExportTraceServiceRequest
+     *        ({"resourceSpans": [...]}) with one root span per trace and its stages below it.
+     */
+    nlohmann::json toOtlpJson(size_t limit) const;
+
+  private:
+    Tracer();
+
+    struct Span
+    {
+        std::string name;
+        uint64_t id = 0;
+        Clock::time_point start;
+        Clock::time_point end;
+        nlohmann::json attributes;
+    };
+
+    struct Trace
+    {
+        TraceId id;
+        Span root; // end: the latest end of its spans
+        std::vector<Span> spans;
+    };
+
+    uint64_t randomNoLock();
+    // The kept trace @p id, or nullptr (caller holds m_mutex)
+    Trace* findNoLock(TraceId id);
+
+    // Unix time of steady time zero, to stamp spans with wall-clock times
+    const int64_t m_unixOffsetNs;
+    mutable std::mutex m_mutex;
+    std::mt19937_64 m_random;
+    std::deque<Trace> m_traces; // oldest first
+};
+
+} // namespace utils
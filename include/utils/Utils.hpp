@@ -3,6 +3,7 @@
 #include "utils/Logger.hpp"
 #include <arpa/inet.h>
 #include <array>
+#include <bit>
 #include <boost/asio/connect.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast/core.hpp>
@@ -32,7 +33,7 @@
  *  - timestamp helpers and formatting.
  *
  * @warning Some functions (execCommand, httpsPost) perform I/O and may throw.
- * @warning Functions using inet_ntoa/localtime rely on non-thread-safe libc APIs.
+ * @warning Functions using localtime rely on non-thread-safe libc APIs.
  *          Prefer thread-safe alternatives if called from multiple threads.
  */
 namespace utils
@@ -50,26 +51,102 @@ enum DeploymentMode
     TESTBED = 2
 };
 
+/// Longest dotted IPv4 string plus its terminator ("255.255.255.255").
+inline constexpr size_t IPV4_STRING_SIZE = 16;
+/// Longest MAC string plus its terminator ("aa:bb:cc:dd:ee:ff").
+inline constexpr size_t MAC_STRING_SIZE = 18;
+
+/**
+ * @brief Write an IPv4 address in dotted-decimal form to @p out, without allocating.
+ *
+ * @param ip IPv4 address in network byte order (in_addr.s_addr format).
+ * @param out At least IPV4_STRING_SIZE chars; NUL-terminated on return.
+ * @return Length written, without the terminator.
+ */
+constexpr size_t
+formatIp(uint32_t ip, char* out) noexcept
+{
+    size_t len = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        // s_addr holds the octets in memory order, first octet first
+        const int shift = std::endian::native == std::endian::little ? i * 8 : (3 - i) * 8;
+        unsigned octet = (ip >> shift) & 0xFF;
+        if (octet >= 100)
+        {
+            out[len++] = static_cast<char>('0' + octet / 100);
+        }
+        if (octet >= 10)
+        {
+            out[len++] = static_cast<char>('0' + octet / 10 % 10);
+        }
+        out[len++] = static_cast<char>('0' + octet % 10);
+        if (i < 3)
+        {
+            out[len++] = '.';
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Write a 48-bit MAC in "aa:bb:cc:dd:ee:ff" form to @p out, without allocating.
+ *
+ * @param mac MAC value (lower 48 bits used).
+ * @param out At least MAC_STRING_SIZE chars; NUL-terminated on return.
+ * @return Length written (17).
+ */
+constexpr size_t
+formatMac(uint64_t mac, char* out) noexcept
+{
+    constexpr char digits[] = "0123456789abcdef";
+    size_t len = 0;
+    for (int i = 5; i >= 0; --i)
+    {
+        unsigned byte = (mac >> (i * 8)) & 0xFF;
+        out[len++] = digits[byte >> 4];
+        out[len++] = digits[byte & 0xF];
+        if (i > 0)
+        {
+            out[len++] = ':';
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief IPv4 address (network byte order) to pass to fmt/spdlog as an argument.
+ *
+ * Formatted straight into the log buffer, so a log call costs no std::string, and with
+ * NDT_LOG_* nothing at all when the level is off:
+ * @code NDT_LOG_TRACE(INGEST, "Agent Address: {}", utils::Ipv4{agentIp}); @endcode
+ */
+struct Ipv4
+{
+    uint32_t addr;
+};
+
+/// 48-bit MAC to pass to fmt/spdlog as an argument; see Ipv4.
+struct Mac
+{
+    uint64_t addr;
+};
+
 /**
  * @brief Convert an IPv4 address to dotted-decimal string.
  *
  * @param ip IPv4 address (expected in network byte order, i.e., in_addr.s_addr format).
  * @return Dotted string (e.g., "10.10.10.12").
- * @throws std::runtime_error if conversion fails.
  *
- * @warning Uses inet_ntoa(), which is not thread-safe.
+ * Thread-safe; prefer formatIp() or Ipv4 where the string is not kept.
  */
 inline std::string
 ipToString(uint32_t ip)
 {
-    struct in_addr addr;
-    addr.s_addr = ip;
-    const char* s = inet_ntoa(addr);
-    if (!s)
-    {
-        throw std::runtime_error("inet_ntoa failed");
-    }
-    return std::string(s);
+    char buf[IPV4_STRING_SIZE];
+    return std::string(buf, formatIp(ip, buf));
 }
 
 /**
@@ -77,24 +154,15 @@ ipToString(uint32_t ip)
  *
  * @param ipVec IPv4 addresses (expected in network byte order).
  * @return Vector of dotted strings.
- * @throws std::runtime_error on conversion failure.
- *
- * @warning Uses inet_ntoa(), which is not thread-safe.
  */
 inline std::vector<std::string>
-ipToString(std::vector<uint32_t> ipVec)
+ipToString(const std::vector<uint32_t>& ipVec)
 {
     std::vector<std::string> res;
-    for (const auto& ip : ipVec)
+    res.reserve(ipVec.size());
+    for (uint32_t ip : ipVec)
     {
-        struct in_addr addr;
-        addr.s_addr = ip;
-        const char* s = inet_ntoa(addr);
-        if (!s)
-        {
-            throw std::runtime_error("inet_ntoa failed");
-        }
-        res.push_back(std::string(s));
+        res.push_back(ipToString(ip));
     }
     return res;
 }
@@ -221,6 +289,7 @@ hexStringToUint64(const std::string& hexStr)
  *
  * @warning This function executes via the shell. Do not pass untrusted input
  *          into @p cmd unless properly escaped/sanitized.
+ * @note Each call forks a shell; HTTP calls go through utils::HttpClient instead.
  */
 inline std::string
 execCommand(const std::string& cmd)
@@ -438,19 +507,28 @@ macToUint64(const std::string& mac)
 inline std::string
 macToString(uint64_t mac)
 {
-    std::ostringstream oss;
+    char buf[MAC_STRING_SIZE];
+    return std::string(buf, formatMac(mac, buf));
+}
+} // namespace utils
 
-    // Extract 6 bytes from the 48-bit MAC
-    for (int i = 5; i >= 0; --i)
+template <>
+struct fmt::formatter<utils::Ipv4> : fmt::formatter<fmt::string_view>
+{
+    auto format(utils::Ipv4 ip, fmt::format_context& ctx) const
     {
-        uint8_t byte = (mac >> (i * 8)) & 0xFF;
-        oss << std::hex << std::setw(2) << std::setfill('0') << (int)byte;
-        if (i > 0)
-        {
-            oss << ":";
-        }
+        char buf[utils::IPV4_STRING_SIZE];
+        return fmt::formatter<fmt::string_view>::format({buf, utils::formatIp(ip.addr, buf)}, ctx);
     }
+};
 
-    return oss.str();
-}
-} // namespace utils
+template <>
+struct fmt::formatter<utils::Mac> : fmt::formatter<fmt::string_view>
+{
+    auto format(utils::Mac mac, fmt::format_context& ctx) const
+    {
+        char buf[utils::MAC_STRING_SIZE];
+        return fmt::formatter<fmt::string_view>::format({buf, utils::formatMac(mac.addr, buf)},
+                                                        ctx);
+    }
+};
@@ -1 +1,383 @@
-#include "event_system/EventBus.hpp"
\ No newline at end of file
+#include "event_system/EventBus.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include <algorithm>
+#include <exception>
+
+namespace
+{
+
+constexpr std::array<const char*, EVENT_TYPE_COUNT> EVENT_TYPE_NAMES{"flow_added",
+                                                                     "link_failure_detected",
+                                                                     "idle_flow_purged",
+                                                                     "link_recovery_detected",
+                                                                     "switch_entered",
+                                                                     "switch_exited",
+                                                                     "link_state_changed",
+                                                                     "idle_flows_purged",
+                                                                     "link_congestion_changed",
+                                                                     "elephant_flow_detected",
+                                                                     "elephant_flow_ended"};
+
+// Events of one group run in publish order on one worker
+size_t
+orderingGroup(EventType type)
+{
+    switch (type)
+    {
+    case EventType::LinkFailureDetected:
+    case EventType::LinkRecoveryDetected:
+    case EventType::LinkStateChanged:
+    case EventType::LinkCongestionChanged:
+        return 0;
+    case EventType::SwitchEntered:
+    case EventType::SwitchExited:
+        return 1;
+    case EventType::FlowAdded:
+    case EventType::IdleFlowPurged:
+    case EventType::IdleFlowsPurged:
+    case EventType::ElephantFlowDetected:
+    case EventType::ElephantFlowEnded:
+        return 2;
+    }
+    return 0;
+}
+
+// Index of the worker whose handler is running on this thread, if any
+thread_local const EventBus* t_bus = nullptr;
+thread_local size_t t_worker = 0;
+
+void
+updateMax(std::atomic<uint64_t>& max, uint64_t value)
+{
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+} // namespace
+
+const char*
+eventTypeName(EventType type)
+{
+    return EVENT_TYPE_NAMES[static_cast<size_t>(type)];
+}
+
+EventBus::ChannelBase::ChannelBase(EventBus& bus, EventType type)
+    : m_bus(bus),
+      m_type(type),
+      m_worker(bus.m_workers.empty() ? 0 : orderingGroup(type) % bus.m_workers.size())
+{
+}
+
+EventBus::EventBus(unsigned workers)
+    : m_handlers(std::make_shared<HandlerMap>())
+{
+    auto& registry = utils::MetricsRegistry::instance();
+    for (size_t i = 0; i < EVENT_TYPE_COUNT; ++i)
+    {
+        const std::string labels = utils::MetricsRegistry::label("type", EVENT_TYPE_NAMES[i]);
+        m_stats[i].handlerSeconds = &registry.histogram(
+            "ndt_event_handler_seconds", "Time the handlers of one event took", labels);
+        m_stats[i].queueSeconds = &registry.histogram(
+            "ndt_event_queue_seconds", "Time an event waited for an EventBus worker", labels);
+        m_stats[i].queued = &registry.gauge(
+            "ndt_event_queue_depth", "Events queued on the EventBus and not delivered", labels);
+        m_stats[i].dropped = &registry.counter(
+            "ndt_event_dropped_total", "Events a full EventBus channel dropped", labels);
+        m_stats[i].merged =
+            &registry.counter("ndt_event_merged_total",
+                              "Events that replaced a queued one with the same key",
+                              labels);
+    }
+
+    for (unsigned i = 0; i < workers; ++i)
+    {
+        m_workers.push_back(std::make_unique<Worker>(EVENT_BUS_QUEUE_CAPACITY));
+    }
+    // Channels pick their worker from m_workers, so only once it is filled
+    for (size_t i = 0; i < EVENT_TYPE_COUNT; ++i)
+    {
+        m_eventChannels[i] = &channel<Event>(static_cast<EventType>(i));
+    }
+    for (size_t i = 0; i < m_workers.size(); ++i)
+    {
+        m_workers[i]->thread = std::thread(&EventBus::workerLoop, this, i);
+    }
+    if (!m_workers.empty())
+    {
+        m_flusher = std::thread(&EventBus::flushLoop, this);
+    }
+}
+
+EventBus::~EventBus()
+{
+    // Close the open coalescing windows first, so the workers still run their events
+    {
+        std::lock_guard<std::mutex> lock(m_flushMutex);
+        m_flushStopping = true;
+    }
+    m_flushCv.notify_one();
+    if (m_flusher.joinable())
+    {
+        m_flusher.join();
+    }
+
+    m_stopping.store(true);
+    for (auto& worker : m_workers)
+    {
+        worker->signal.fetch_add(1, std::memory_order_release);
+        worker->signal.notify_one();
+    }
+    for (auto& worker : m_workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+}
+
+void
+EventBus::registerHandler(EventType type, Handler handler)
+{
+    // Copy on write: dispatches in progress keep the handlers they started with
+    std::lock_guard<std::mutex> lock(m_handlersMutex);
+    auto next = std::make_shared<HandlerMap>(*m_handlers);
+    (*next)[type].push_back(std::move(handler));
+    m_handlers = std::move(next);
+    m_stats[static_cast<size_t>(type)].hasUntypedHandlers.store(true, std::memory_order_relaxed);
+}
+
+std::shared_ptr<const EventBus::HandlerMap>
+EventBus::handlers() const
+{
+    std::lock_guard<std::mutex> lock(m_handlersMutex);
+    return m_handlers;
+}
+
+void
+EventBus::emit(Event event)
+{
+    const EventType type = event.type;
+    m_eventChannels[static_cast<size_t>(type)]->publish(std::move(event));
+}
+
+void
+EventBus::emitSync(const Event& event)
+{
+    recordEmitted(event.type);
+    const auto start = std::chrono::steady_clock::now();
+    callUntyped(event, true);
+    recordHandled(event.type, std::chrono::steady_clock::now() - start);
+}
+
+void
+EventBus::callUntyped(const Event& event, bool rethrow)
+{
+    const std::shared_ptr<const HandlerMap> snapshot = handlers();
+    auto it = snapshot->find(event.type);
+    if (it == snapshot->end())
+    {
+        return;
+    }
+    for (const auto& handler : it->second)
+    {
+        try
+        {
+            handler(event); // Call all handlers for this event
+        }
+        catch (const std::exception& e)
+        {
+            handlerFailed(event.type, e, rethrow);
+        }
+    }
+}
+
+void
+EventBus::handlerFailed(EventType type, const std::exception& e, bool rethrow)
+{
+    m_stats[static_cast<size_t>(type)].handlerErrors.fetch_add(1, std::memory_order_relaxed);
+    if (rethrow)
+    {
+        throw; // still inside the caller's catch block
+    }
+    SPDLOG_LOGGER_ERROR(
+        Logger::instance(), "EventBus: {} handler threw: {}", eventTypeName(type), e.what());
+}
+
+void
+EventBus::recordHandled(EventType type, std::chrono::steady_clock::duration elapsed)
+{
+    TypeStats& stats = m_stats[static_cast<size_t>(type)];
+    const auto ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    stats.handled.fetch_add(1, std::memory_order_relaxed);
+    stats.handlerNs.fetch_add(ns, std::memory_order_relaxed);
+    updateMax(stats.maxHandlerNs, ns);
+    stats.handlerSeconds->observe(elapsed);
+    utils::FlightRecorder::instance().recordEvent(static_cast<uint8_t>(type), true, ns);
+}
+
+void
+EventBus::recordQueued(EventType type, double delta)
+{
+    m_stats[static_cast<size_t>(type)].queued->add(delta);
+}
+
+void
+EventBus::recordDropped(EventType type)
+{
+    TypeStats& stats = m_stats[static_cast<size_t>(type)];
+    stats.dropped->add();
+    stats.queued->add(-1);
+}
+
+void
+EventBus::recordMerged(EventType type)
+{
+    m_stats[static_cast<size_t>(type)].merged->add();
+}
+
+void
+EventBus::waitForRoom(size_t index)
+{
+    // The worker cannot make room while it runs the handler that is publishing, unless it
+    // runs its next delivery right here
+    if (t_bus == this && t_worker == index && runNext(index))
+    {
+        return;
+    }
+    std::this_thread::yield();
+}
+
+void
+EventBus::schedule(ChannelBase& channel)
+{
+    Worker& worker = *m_workers[channel.m_worker];
+    while (!worker.queue.tryPush(Task{&channel, std::chrono::steady_clock::now()}))
+    {
+        waitForRoom(channel.m_worker);
+    }
+    worker.signal.fetch_add(1, std::memory_order_release);
+    worker.signal.notify_one();
+}
+
+bool
+EventBus::runNext(size_t index)
+{
+    Task task;
+    if (!m_workers[index]->queue.tryPop(task))
+    {
+        return false;
+    }
+    m_stats[static_cast<size_t>(task.channel->m_type)].queueSeconds->observe(
+        std::chrono::steady_clock::now() - task.emittedAt);
+    task.channel->runOne();
+    return true;
+}
+
+void
+EventBus::workerLoop(size_t index)
+{
+    t_bus = this;
+    t_worker = index;
+    utils::ThreadRegistry::Scope thread("event-bus-" + std::to_string(index));
+    Worker& worker = *m_workers[index];
+    for (;;)
+    {
+        const uint64_t signal = worker.signal.load(std::memory_order_acquire);
+        if (runNext(index))
+        {
+            continue;
+        }
+        // Stop only once the queue is drained
+        if (m_stopping.load())
+        {
+            return;
+        }
+        thread.idle();
+        worker.signal.wait(signal, std::memory_order_acquire);
+        thread.wake();
+    }
+}
+
+bool
+EventBus::flushAfter(ChannelBase& channel, std::chrono::milliseconds window)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_flushMutex);
+        if (m_flushStopping)
+        {
+            return false;
+        }
+        m_flushes.emplace_back(std::chrono::steady_clock::now() + window, &channel);
+    }
+    m_flushCv.notify_one();
+    return true;
+}
+
+void
+EventBus::flushLoop()
+{
+    utils::ThreadRegistry::Scope thread("event-flush");
+    std::unique_lock<std::mutex> lock(m_flushMutex);
+    for (;;)
+    {
+        if (m_flushes.empty())
+        {
+            if (m_flushStopping)
+            {
+                return;
+            }
+            m_flushCv.wait(lock);
+            continue;
+        }
+        // A handful of channels coalesce, so a scan beats keeping a heap
+        auto next = std::min_element(m_flushes.begin(), m_flushes.end());
+        if (!m_flushStopping && std::chrono::steady_clock::now() < next->first)
+        {
+            m_flushCv.wait_until(lock, next->first);
+            continue;
+        }
+        ChannelBase* channel = next->second;
+        m_flushes.erase(next);
+        // flush() may wait for room at the worker, which must not hold up publishers
+        lock.unlock();
+        channel->flush();
+        lock.lock();
+    }
+}
+
+nlohmann::json
+EventBus::statsJson() const
+{
+    nlohmann::json out = nlohmann::json::object();
+    for (size_t i = 0; i < EVENT_TYPE_COUNT; ++i)
+    {
+        const TypeStats& stats = m_stats[i];
+        const uint64_t handled = stats.handled.load(std::memory_order_relaxed);
+        const double handlerMs =
+            static_cast<double>(stats.handlerNs.load(std::memory_order_relaxed)) / 1e6;
+        out[EVENT_TYPE_NAMES[i]] = {
+            {"emitted", stats.emitted.load(std::memory_order_relaxed)},
+            {"coalesced", stats.coalesced.load(std::memory_order_relaxed)},
+            {"queued", static_cast<int64_t>(stats.queued->value())},
+            {"dropped", stats.dropped->value()},
+            {"merged", stats.merged->value()},
+            {"handled", handled},
+            {"handler_errors", stats.handlerErrors.load(std::memory_order_relaxed)},
+            {"mean_handler_ms", handled == 0 ? 0.0 : handlerMs / handled},
+            {"max_handler_ms",
+             static_cast<double>(stats.maxHandlerNs.load(std::memory_order_relaxed)) / 1e6}};
+    }
+    nlohmann::json workers = nlohmann::json::array();
+    for (const auto& worker : m_workers)
+    {
+        workers.push_back({{"queued", worker->queue.size()}});
+    }
+    out["workers"] = std::move(workers);
+    return out;
+}
@@ -1,48 +1,67 @@
 #include "../setting/AppConfig.hpp"
 #include "common_types/GraphTypes.hpp"
+#include "common_types/TelemetrySegment.hpp"
 #include "event_system/EventBus.hpp"
+#include "event_system/EventPayloads.hpp"
 #include "ndt_core/application_management/ApplicationManager.hpp"
 #include "ndt_core/application_management/SimulationRequestManager.hpp"
 #include "ndt_core/collection/Classifier.hpp"
+#include "ndt_core/collection/ClusterLink.hpp"
 #include "ndt_core/collection/FlowLinkUsageCollector.hpp"
+#include "ndt_core/collection/SamplingRateController.hpp"
 #include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
 #include "ndt_core/data_management/HistoricalDataManager.hpp"
+#include "ndt_core/data_management/StateReplicator.hpp"
 #include "ndt_core/event_handling/ControllerAndOtherEventHandler.hpp"
+#include "ndt_core/http/HttpSession.hpp"
 #include "ndt_core/intent_translator/IntentTranslator.hpp"
 #include "ndt_core/lock_management/LockManager.hpp"
 #include "ndt_core/power_management/DeviceConfigurationAndPowerManager.hpp"
 #include "ndt_core/routing_management/Controller.hpp"
 #include "ndt_core/routing_management/FlowRoutingManager.hpp"
+#include "ndt_core/routing_management/FastReroute.hpp"
+#include "ndt_core/routing_management/OpenFlowChannel.hpp"
 #include "spdlog/spdlog.h"
+#include "utils/FlightRecorder.hpp"
+#include "utils/HistoryWriter.hpp"
 #include "utils/Logger.hpp"
-#include <atomic>
+#include "utils/MemoryAccounting.hpp"
+#include "utils/MemoryPolicy.hpp"
+#include "utils/Profiler.hpp"
+#include "utils/RuntimeConfig.hpp"
+#include "utils/Startup.hpp"
+#include "utils/TaskScheduler.hpp"
+#include <algorithm>
 #include <boost/asio/impl/io_context.ipp>
 #include <boost/asio/io_context.hpp>
+#include <cctype>
+#include <charconv>
 #include <chrono>
 #include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <unistd.h>
+#include <unordered_map>
 
 std::string SIM_SERVER_URL = AppConfig::SIM_SERVER_URL;
 std::string GW_IP = AppConfig::GW_IP;
 
-static std::atomic<bool> gShutdownRequested{false};
-
 struct DeploymentConfig {
     int mode;       
     bool useToken;  
 };
 
-void
-handleSigint(int)
-{
-    gShutdownRequested.store(true);
-}
-
 DeploymentConfig promptDeploymentConfig() {
     DeploymentConfig config = {-1, false};
     int aiChoice = -1;
@@ -81,6 +100,483 @@ DeploymentConfig promptDeploymentConfig() {
 
 
 
+// The value @p text of numeric flag @p flag; std::invalid_argument naming the flag unless it
+// is a whole number up to @p max
+unsigned long
+parseNumber(std::string_view flag,
+            std::string_view text,
+            unsigned long max = std::numeric_limits<unsigned long>::max())
+{
+    unsigned long value = 0;
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec == std::errc::result_out_of_range || (ec == std::errc() && value > max))
+    {
+        throw std::invalid_argument(std::string(flag) + ": '" + std::string(text) +
+                                    "' is out of range (at most " + std::to_string(max) + ")");
+    }
+    if (ec != std::errc() || end != text.data() + text.size())
+    {
+        throw std::invalid_argument(std::string(flag) + ": '" + std::string(text) +
+                                    "' is not a number");
+    }
+    return value;
+}
+
+// "a,b-c" as the CPUs a, b, ..., c, for @p flag
+std::vector<unsigned>
+parseCpuList(std::string_view flag, const std::string& text)
+{
+    std::vector<unsigned> cpus;
+    std::stringstream list(text);
+    std::string range;
+    while (std::getline(list, range, ','))
+    {
+        const size_t dash = range.find('-');
+        const unsigned max = std::numeric_limits<unsigned>::max() - 1;
+        const auto first = static_cast<unsigned>(parseNumber(flag, range.substr(0, dash), max));
+        const unsigned last =
+            dash == std::string::npos
+                ? first
+                : static_cast<unsigned>(parseNumber(flag, range.substr(dash + 1), max));
+        for (unsigned cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+sflow::IngestConfig
+parseIngestConfig(int argc, char* argv[])
+{
+    sflow::IngestConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--sflow-workers" && i + 1 < argc)
+        {
+            cfg.workerCount = parseNumber(arg, argv[++i]);
+        }
+        else if (arg == "--sflow-pin-cpu")
+        {
+            cfg.pinToCpu = true;
+        }
+        else if (arg == "--sflow-cpus" && i + 1 < argc)
+        {
+            cfg.cpus = parseCpuList(arg, argv[++i]);
+        }
+        else if (arg == "--sflow-ring" && i + 1 < argc)
+        {
+            cfg.ringCapacity = parseNumber(arg, argv[++i]);
+        }
+        else if (arg == "--sflow-kernel-filter")
+        {
+            cfg.kernelFilter = true;
+        }
+        else if (arg == "--sflow-io-uring")
+        {
+            cfg.ioUring = true;
+        }
+        else if (arg == "--sflow-capture-interface" && i + 1 < argc)
+        {
+            cfg.captureInterface = argv[++i];
+        }
+    }
+    return cfg;
+}
+
+sflow::FlowExportConfig
+parseFlowExportConfig(int argc, char* argv[])
+{
+    sflow::FlowExportConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--flow-export-dir" && i + 1 < argc)
+        {
+            cfg.directory = argv[++i];
+        }
+        else if (arg == "--flow-export-ipfix" && i + 1 < argc)
+        {
+            cfg.ipfixCollector = argv[++i];
+        }
+    }
+    return cfg;
+}
+
+// --telemetry-shm [name]: the shared-memory telemetry segment, TELEMETRY_SEGMENT_NAME unless
+// a name (starting with '/') is given; empty when off
+std::string
+parseTelemetrySegmentName(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--telemetry-shm")
+        {
+            return i + 1 < argc && argv[i + 1][0] == '/' ? argv[i + 1] : TELEMETRY_SEGMENT_NAME;
+        }
+    }
+    return {};
+}
+
+// Flow entries each switch model of doc/OpenflowCapacity.json holds; empty if it is unreadable
+std::unordered_map<std::string, size_t>
+loadFlowTableSizes(const char* path)
+{
+    std::ifstream file(path);
+    nlohmann::json capacity = nlohmann::json::parse(file, nullptr, false);
+    if (capacity.is_discarded())
+    {
+        SPDLOG_LOGGER_WARN(
+            Logger::instance(), "Cannot read {}: flow table capacity is not enforced", path);
+        return {};
+    }
+    return FlowTableCapacity::tableSizesByModel(capacity);
+}
+
+// --cluster-coordinator host:port (run as a node), --cluster-listen [port] (run as the
+// coordinator, on CLUSTER_PORT unless given)
+sflow::ClusterConfig
+parseClusterConfig(int argc, char* argv[])
+{
+    sflow::ClusterConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--cluster-coordinator" && i + 1 < argc)
+        {
+            cfg.coordinator = argv[++i];
+        }
+        else if (arg == "--cluster-listen")
+        {
+            cfg.listenPort = CLUSTER_PORT;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+            {
+                cfg.listenPort = static_cast<uint16_t>(parseNumber(arg, argv[++i], UINT16_MAX));
+            }
+        }
+    }
+    return cfg;
+}
+
+// --replicate-to host:port (primary of a hot standby), --standby [port] (stand by for a
+// primary, on REPLICATION_PORT unless given)
+ReplicationConfig
+parseReplicationConfig(int argc, char* argv[])
+{
+    ReplicationConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--replicate-to" && i + 1 < argc)
+        {
+            cfg.standby = argv[++i];
+        }
+        else if (arg == "--standby")
+        {
+            cfg.listenPort = REPLICATION_PORT;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+            {
+                cfg.listenPort = static_cast<uint16_t>(parseNumber(arg, argv[++i], UINT16_MAX));
+            }
+        }
+    }
+    return cfg;
+}
+
+// --sflow-max-samples-per-sec n (0: off), --sflow-max-sampling-rate n, --sflow-snmp-community
+// name (write access to the sFlow MIB)
+sflow::SamplingControlConfig
+parseSamplingControl(int argc, char* argv[])
+{
+    sflow::SamplingControlConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--sflow-max-samples-per-sec" && i + 1 < argc)
+        {
+            cfg.maxSamplesPerSecond = parseNumber(arg, argv[++i]);
+        }
+        else if (arg == "--sflow-max-sampling-rate" && i + 1 < argc)
+        {
+            cfg.maxSamplingRate = parseNumber(arg, argv[++i], UINT32_MAX);
+        }
+        else if (arg == "--sflow-snmp-community" && i + 1 < argc)
+        {
+            cfg.community = argv[++i];
+        }
+    }
+    return cfg;
+}
+
+// --flow-table-max-flows n (0: unbounded), --flow-table-max-mb n, --flow-eviction
+// least-recent|lowest-rate
+sflow::FlowTableLimits
+parseFlowTableLimits(int argc, char* argv[])
+{
+    sflow::FlowTableLimits limits;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--flow-table-max-flows" && i + 1 < argc)
+        {
+            limits.maxFlows = parseNumber(arg, argv[++i]);
+        }
+        else if (arg == "--flow-table-max-mb" && i + 1 < argc)
+        {
+            limits.maxBytes =
+                parseNumber(arg, argv[++i], std::numeric_limits<unsigned long>::max() >> 20)
+                << 20;
+        }
+        else if (arg == "--flow-eviction" && i + 1 < argc)
+        {
+            std::string policy(argv[++i]);
+            limits.policy = policy == "lowest-rate" ? sflow::FlowEvictionPolicy::LowestRate
+                                                    : sflow::FlowEvictionPolicy::LeastRecent;
+        }
+    }
+    return limits;
+}
+
+// --flow-aggregation five-tuple|host-pair|prefix-pair[+five-tuple], --flow-aggregation-prefix s/d
+sflow::FlowAggregationConfig
+parseFlowAggregation(int argc, char* argv[])
+{
+    sflow::FlowAggregationConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--flow-aggregation" && i + 1 < argc)
+        {
+            std::string mode(argv[++i]);
+            const std::string dual = "+five-tuple";
+            if (mode.size() > dual.size() && mode.ends_with(dual))
+            {
+                config.keepFiveTuple = true;
+                mode.resize(mode.size() - dual.size());
+            }
+            config.mode = mode == "host-pair"     ? sflow::FlowAggregation::HostPair
+                          : mode == "prefix-pair" ? sflow::FlowAggregation::PrefixPair
+                                                  : sflow::FlowAggregation::FiveTuple;
+        }
+        else if (arg == "--flow-aggregation-prefix" && i + 1 < argc)
+        {
+            std::string lengths(argv[++i]);
+            const size_t slash = lengths.find('/');
+            config.srcPrefixLength = parseNumber(arg, lengths.substr(0, slash), 32);
+            config.dstPrefixLength = slash == std::string::npos
+                                         ? config.srcPrefixLength
+                                         : parseNumber(arg, lengths.substr(slash + 1), 32);
+        }
+    }
+    return config;
+}
+
+// --huge-pages off|thp|explicit (thp by default), --no-numa
+utils::MemoryPolicyConfig
+parseMemoryPolicy(int argc, char* argv[])
+{
+    utils::MemoryPolicyConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--huge-pages" && i + 1 < argc)
+        {
+            if (auto mode = utils::MemoryPolicy::parseHugePages(argv[++i]))
+            {
+                cfg.hugePages = *mode;
+            }
+            else
+            {
+                std::cerr << "Unknown --huge-pages mode " << argv[i] << ", using thp\n";
+            }
+        }
+        else if (arg == "--no-numa")
+        {
+            cfg.numa = false;
+        }
+    }
+    return cfg;
+}
+
+// --scheduler-threads n, --scheduler-cpus a,b-c; with pinned sFlow workers (--sflow-pin-cpu or
+// --sflow-cpus) and no CPUs given, the scheduler gets the CPUs those workers leave free
+utils::TaskSchedulerConfig
+parseSchedulerConfig(int argc, char* argv[], const sflow::IngestConfig& ingest)
+{
+    utils::TaskSchedulerConfig cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--scheduler-threads" && i + 1 < argc)
+        {
+            cfg.threads = parseNumber(arg, argv[++i], UINT32_MAX);
+        }
+        else if (arg == "--scheduler-cpus" && i + 1 < argc)
+        {
+            cfg.cpus = parseCpuList(arg, argv[++i]);
+        }
+    }
+    const unsigned cpuCount = std::max(1u, std::thread::hardware_concurrency());
+    if (cfg.cpus.empty() && !ingest.cpus.empty())
+    {
+        for (unsigned cpu = 0; cpu < cpuCount; ++cpu)
+        {
+            if (std::find(ingest.cpus.begin(), ingest.cpus.end(), cpu) == ingest.cpus.end())
+            {
+                cfg.cpus.push_back(cpu);
+            }
+        }
+    }
+    else if (cfg.cpus.empty() && ingest.pinToCpu && ingest.workerCount < cpuCount)
+    {
+        for (unsigned cpu = ingest.workerCount; cpu < cpuCount; ++cpu)
+        {
+            cfg.cpus.push_back(cpu);
+        }
+    }
+    return cfg;
+}
+
+unsigned
+parseIoThreads(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--io-threads" && i + 1 < argc)
+        {
+            return ControllerAndOtherEventHandler::resolveIoThreads(
+                parseNumber(argv[i], argv[i + 1], UINT32_MAX));
+        }
+    }
+    return ControllerAndOtherEventHandler::resolveIoThreads();
+}
+
+unsigned
+parseEventWorkers(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--event-workers" && i + 1 < argc)
+        {
+            return parseNumber(argv[i], argv[i + 1], UINT32_MAX);
+        }
+    }
+    return EVENT_BUS_WORKERS;
+}
+
+size_t
+parseFlightRecorderRecords(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--flight-recorder" && i + 1 < argc)
+        {
+            return parseNumber(argv[i], argv[i + 1]);
+        }
+    }
+    return FLIGHT_RECORDER_RECORDS;
+}
+
+std::chrono::milliseconds
+parseEventCoalesceMs(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--event-coalesce-ms" && i + 1 < argc)
+        {
+            return std::chrono::milliseconds(parseNumber(argv[i], argv[i + 1], UINT32_MAX));
+        }
+    }
+    return std::chrono::milliseconds(EVENT_BUS_COALESCE_MS);
+}
+
+bool
+hasFlag(int argc, char* argv[], std::string_view flag)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (flag == argv[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Value after @p flag, or empty when it is not given
+std::string
+flagValue(int argc, char* argv[], std::string_view flag)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (flag == argv[i])
+        {
+            return argv[i + 1];
+        }
+    }
+    return {};
+}
+
+// Parses every numeric flag once, so that a malformed value is a usage error before anything
+// starts rather than an uncaught exception halfway through startup
+bool
+checkNumericFlags(int argc, char* argv[])
+{
+    try
+    {
+        parseSchedulerConfig(argc, argv, parseIngestConfig(argc, argv));
+        parseClusterConfig(argc, argv);
+        parseReplicationConfig(argc, argv);
+        parseSamplingControl(argc, argv);
+        parseFlowTableLimits(argc, argv);
+        parseFlowAggregation(argc, argv);
+        parseCpuList("--path-cpus", flagValue(argc, argv, "--path-cpus"));
+        parseIoThreads(argc, argv);
+        parseEventWorkers(argc, argv);
+        parseFlightRecorderRecords(argc, argv);
+        parseEventCoalesceMs(argc, argv);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cerr << e.what() << " (see --help)\n";
+        return false;
+    }
+    return true;
+}
+
+// --mode mininet|testbed (or NDT_MODE) starts without the prompt, with the intent translator
+// off unless --intent-translator on (or NDT_INTENT_TRANSLATOR=on). Without a mode the prompt
+// asks for both, or, when stdin is not a terminal (an orchestrated start), nullopt.
+std::optional<DeploymentConfig>
+parseDeploymentConfig(int argc, char* argv[])
+{
+    const auto setting = [argc, argv](std::string_view flag, const char* variable)
+    {
+        std::string value = flagValue(argc, argv, flag);
+        const char* fromEnv = std::getenv(variable);
+        return value.empty() && fromEnv ? std::string(fromEnv) : value;
+    };
+    const std::string mode = setting("--mode", "NDT_MODE");
+    if (mode.empty())
+    {
+        if (!isatty(STDIN_FILENO))
+        {
+            std::cerr << "No --mode (or NDT_MODE) given and no terminal to ask on\n";
+            return std::nullopt;
+        }
+        return promptDeploymentConfig();
+    }
+    const std::string translator = setting("--intent-translator", "NDT_INTENT_TRANSLATOR");
+    if ((mode != "mininet" && mode != "testbed") ||
+        (!translator.empty() && translator != "on" && translator != "off"))
+    {
+        std::cerr << "Usage: --mode mininet|testbed [--intent-translator on|off]\n";
+        return std::nullopt;
+    }
+    return DeploymentConfig{mode == "mininet" ? 1 : 2, translator == "on"};
+}
+
 std::string
 promptOpenAIModel()
 {
@@ -100,8 +596,16 @@ promptOpenAIModel()
 int
 main(int argc, char* argv[])
 {
-    // Temporarily use command line prompt to configure running mode.
-    DeploymentConfig config = promptDeploymentConfig();
+    if (!checkNumericFlags(argc, argv))
+    {
+        return 2;
+    }
+    const std::optional<DeploymentConfig> deployment = parseDeploymentConfig(argc, argv);
+    if (!deployment)
+    {
+        return 2;
+    }
+    DeploymentConfig config = *deployment;
     int mode = config.mode; 
 
     if (mode == 1) {
@@ -110,17 +614,67 @@ main(int argc, char* argv[])
         std::cout << "Running in Remote Testbed environment.\n";
     }
 
+    // Block SIGINT/SIGTERM before any thread starts (the async logger's included) so every
+    // thread inherits the mask and the signals stay pending until main() collects them with
+    // sigwait() below
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
+
     auto cfg = Logger::parse_cli_args(argc, argv);
     Logger::init(cfg);
     SPDLOG_LOGGER_INFO(Logger::instance(), "Logger Loads Successfully! level");
 
-    std::signal(SIGINT, handleSigint);
+    // Before the flow table and the classifier allocate anything large
+    utils::MemoryPolicy::instance().configure(parseMemoryPolicy(argc, argv));
+    // GET /ndt/debug/profile answers 403 unless asked for; profiles expose code addresses
+    utils::Profiler::instance().setEnabled(hasFlag(argc, argv, "--enable-profiling"));
+
+    // Before any thread records; --flight-recorder 0 turns it off
+    auto& flightRecorder = utils::FlightRecorder::instance();
+    flightRecorder.configure(parseFlightRecorderRecords(argc, argv));
+    if (flightRecorder.enabled())
+    {
+        const std::string dumpPath = flagValue(argc, argv, "--flight-recorder-dump");
+        flightRecorder.installCrashHandler(dumpPath.empty() ? FLIGHT_RECORDER_DUMP_PATH
+                                                            : dumpPath);
+    }
+
+    // Periodic jobs of all subsystems share the scheduler's workers; it starts with the first
+    const sflow::IngestConfig ingestConfig = parseIngestConfig(argc, argv);
+    utils::TaskScheduler::instance().configure(parseSchedulerConfig(argc, argv, ingestConfig));
 
-    net::io_context ioc{1};
+    // --config <file.json>: tuning parameters, before the subsystems define and read them
+    if (const std::string path = flagValue(argc, argv, "--config"); !path.empty())
+    {
+        utils::RuntimeConfig::instance().load(path);
+    }
+    auto& runtimeConfig = utils::RuntimeConfig::instance();
+    SIM_SERVER_URL = runtimeConfig.defineString(
+        "site.simulator_url", "URL of the simulation server", AppConfig::SIM_SERVER_URL);
+    GW_IP = runtimeConfig.defineString(
+        "site.gateway_ip", "Gateway the devices are configured through", AppConfig::GW_IP);
+    // Read at first use elsewhere; defined now so the file's values are checked at startup
+    topologyFile();
+    topologyFileMininet();
+    ryuAddress();
+    ryuAddresses();
+
+    // The concurrency hint must match the number of threads runServer() starts on it.
+    const unsigned ioThreads = parseIoThreads(argc, argv);
+    net::io_context ioc{static_cast<int>(ioThreads)};
 
     auto graph = std::make_shared<Graph>();
     auto graphMutex = std::make_shared<std::shared_mutex>();
-    auto eventBus = std::make_shared<EventBus>();
+    // 0 runs every handler on the thread that emits, as before the bus had workers
+    auto eventBus = std::make_shared<EventBus>(parseEventWorkers(argc, argv));
+    // A flapping link reaches the handlers once per window; 0 delivers every change
+    eventBus->channel<LinkStateChangedEventData>(EventType::LinkStateChanged).coalesce(
+        parseEventCoalesceMs(argc, argv));
+    eventBus->channel<LinkCongestionChangedEventData>(EventType::LinkCongestionChanged)
+        .coalesce(parseEventCoalesceMs(argc, argv));
     std::shared_ptr<FlowRoutingManager> flowRoutingManager;
     std::shared_ptr<DeviceConfigurationAndPowerManager> deviceConfigurationAndPowerManager;
     auto classifier = std::make_shared<ndtClassifier::Classifier>();
@@ -138,11 +692,38 @@ main(int argc, char* argv[])
                                                         eventBus,
                                                         mode,
                                                         classifier);
-
-    auto dataManager = std::make_unique<HistoricalDataManager>(topologyAndFlowMonitor, mode);
+    collector->setIngestConfig(ingestConfig);
+    collector->setFlowExportConfig(parseFlowExportConfig(argc, argv));
+    collector->setTelemetrySegment(parseTelemetrySegmentName(argc, argv));
+    collector->setSamplingControl(parseSamplingControl(argc, argv));
+    collector->setClusterConfig(parseClusterConfig(argc, argv));
+    collector->setCheckpointPath(flagValue(argc, argv, "--checkpoint"));
+    collector->setFlowTableLimits(parseFlowTableLimits(argc, argv));
+    collector->setFlowAggregation(parseFlowAggregation(argc, argv));
+    collector->setBidirectionalFlows(hasFlag(argc, argv, "--bidirectional-flows"));
+    collector->setFirstHopSampling(hasFlag(argc, argv, "--first-hop-sampling"));
+    collector->setPathThreadCpus(
+        parseCpuList("--path-cpus", flagValue(argc, argv, "--path-cpus")));
+    collector->setIncrementalRateEstimation(hasFlag(argc, argv, "--incremental-rates"));
+
+    // One instance records and serves the history endpoints
+    const std::chrono::minutes historyInterval(
+        runtimeConfig.defineInt("history.persist_interval_min",
+                                "Minutes between two snapshots of the history",
+                                HistoricalDataManager::DEFAULT_INTERVAL.count(),
+                                1,
+                                1440));
+    auto historicalDataManager = std::make_shared<HistoricalDataManager>(
+        topologyAndFlowMonitor, mode, historyInterval, collector);
 
     flowRoutingManager =
         std::make_shared<FlowRoutingManager>(topologyAndFlowMonitor, collector, eventBus);
+    // e.g. unix:/var/run/openvswitch/s{dpid}.mgmt; Ryu's REST API stays the fallback
+    if (const std::string endpoint = flagValue(argc, argv, "--openflow-southbound");
+        !endpoint.empty())
+    {
+        flowRoutingManager->setOpenFlowChannel(std::make_shared<OpenFlowChannel>(endpoint));
+    }
 
 
 
@@ -168,10 +749,39 @@ main(int argc, char* argv[])
 
     auto simManager = std::make_shared<SimulationRequestManager>(appManager, SIM_SERVER_URL);
 
-    auto historicalDataManager =
-        std::make_shared<HistoricalDataManager>(topologyAndFlowMonitor, mode);
-
-    auto controller = std::make_shared<Controller>(flowRoutingManager);
+    auto controller = std::make_shared<Controller>(flowRoutingManager, classifier);
+    // A switch's flow table size is its model's, the brand_name of its topology node
+    controller->capacity().setLimitSource(
+        [topologyAndFlowMonitor, sizes = loadFlowTableSizes("../doc/OpenflowCapacity.json")](
+            uint64_t dpid) -> std::optional<size_t> {
+            auto snapshot = topologyAndFlowMonitor->getGraphSnapshot(std::chrono::seconds(1));
+            for (auto v : boost::make_iterator_range(boost::vertices(snapshot->graph)))
+            {
+                const auto& vertex = snapshot->graph[v];
+                if (vertex.vertexType != VertexType::SWITCH || vertex.dpid != dpid)
+                {
+                    continue;
+                }
+                auto it = sizes.find(vertex.brandName);
+                if (it != sizes.end())
+                {
+                    return it->second;
+                }
+                break;
+            }
+            return std::nullopt;
+        });
+    // Re-poll a switch's OpenFlow table soon after flows are pushed to it
+    controller->dispatcher().setOnBurstApplied([deviceConfigurationAndPowerManager](uint64_t dpid) {
+        deviceConfigurationAndPowerManager->requestOpenFlowTablesPoll(dpid);
+    });
+    // Backup routes per link, pushed as soon as the link is reported down
+    std::shared_ptr<FastReroute> fastReroute;
+    if (hasFlag(argc, argv, "--fast-reroute"))
+    {
+        fastReroute = std::make_shared<FastReroute>(topologyAndFlowMonitor, *controller);
+        controller->setFastReroute(fastReroute);
+    }
 
     auto lockManager = std::make_shared<LockManager>();
 
@@ -188,27 +798,90 @@ main(int argc, char* argv[])
                                                          historicalDataManager,
                                                          controller,
                                                          lockManager,
-                                                         mode);
+                                                         mode,
+                                                         ioThreads);
+
+    const ReplicationConfig replication = parseReplicationConfig(argc, argv);
+    const bool standby = replication.listenPort != 0;
+    auto replicator = std::make_shared<StateReplicator>(replication, collector, lockManager);
+
+    // A standby serves HTTP only once it takes over from its primary (or fails to listen)
+    StateReplicator::Takeover onTakeover = [] {};
+    if (standby)
+    {
+        onTakeover = [handler] { handler->start(); };
+    }
 
-    topologyAndFlowMonitor->start();
-    collector->start();
-    dataManager->start();
-    handler->start();
-    deviceConfigurationAndPowerManager->start();
+    // Estimated every MEMORY_ACCOUNTING_PERIOD_MS for GET /ndt/debug/memory and /metrics; the
+    // estimators hold weak references so the singleton keeps no subsystem alive
+    auto& memoryAccounting = utils::MemoryAccounting::instance();
+    auto accountMemoryOf = [&memoryAccounting](const std::string& subsystem, auto weak) {
+        memoryAccounting.add(subsystem, [weak] {
+            auto owner = weak.lock();
+            return owner ? owner->memoryUsage() : utils::MemoryUsage{};
+        });
+    };
+    accountMemoryOf("collector", std::weak_ptr(collector));
+    accountMemoryOf("topology", std::weak_ptr(topologyAndFlowMonitor));
+    accountMemoryOf("classifier", std::weak_ptr(classifier));
+    accountMemoryOf("devices", std::weak_ptr(deviceConfigurationAndPowerManager));
+    if (intentTranslator)
+    {
+        accountMemoryOf("intent_translator", std::weak_ptr(intentTranslator));
+    }
+    memoryAccounting.add("http_response_caches", &HttpSession::memoryUsage);
+    memoryAccounting.start();
+
+    // The starts overlap; GET /ndt/readiness reports each subsystem until all are warm
+    std::vector<utils::StartupStep> steps{
+        {"topology", {}, [&] { topologyAndFlowMonitor->start(); }, true},
+        {"collector", {}, [&] { collector->start(); }},
+        {"history", {}, [&] { historicalDataManager->start(); }},
+        {"replication", {"collector"}, [&] { replicator->start(onTakeover); }},
+        {"devices", {}, [&] { deviceConfigurationAndPowerManager->start(); }, true}};
+    if (fastReroute)
+    {
+        steps.push_back({"fast_reroute", {"topology"}, [&] { fastReroute->start(*eventBus); }});
+    }
+    if (!standby)
+    {
+        steps.push_back({"http", {}, [&] { handler->start(); }});
+    }
+    const bool started = utils::Startup::instance().run(std::move(steps));
+    for (const std::string& name : runtimeConfig.undefinedNames())
+    {
+        SPDLOG_LOGGER_WARN(
+            Logger::instance(), "Runtime configuration: {} is not a known parameter", name);
+    }
 
-    while (!gShutdownRequested.load())
+    int received = 0;
+    if (started)
+    {
+        sigwait(&shutdownSignals, &received);
+        SPDLOG_LOGGER_INFO(
+            Logger::instance(), "Shutdown requested ({}). Cleaning up…", strsignal(received));
+    }
+    else
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        SPDLOG_LOGGER_CRITICAL(Logger::instance(), "A subsystem failed to start. Cleaning up…");
     }
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Shutdown requested. Cleaning up…");
 
+    if (fastReroute)
+    {
+        fastReroute->stop();
+    }
     topologyAndFlowMonitor->stop();
+    replicator->stop();
     collector->stop();
-    dataManager->stop();
+    historicalDataManager->stop();
     handler->stop();
     deviceConfigurationAndPowerManager->stop();
+    utils::TaskScheduler::instance().shutdown();
+    // After every producer: commits and syncs the history records they left queued
+    utils::HistoryWriter::instance().stop();
 
     SPDLOG_LOGGER_INFO(Logger::instance(), "All subsystems stopped. Exiting.");
+    Logger::shutdown();
 
-    return 0;
+    return started ? 0 : 1;
 }
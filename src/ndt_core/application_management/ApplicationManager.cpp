@@ -1,7 +1,9 @@
 #include "ndt_core/application_management/ApplicationManager.hpp"
 #include "spdlog/spdlog.h"
 #include "utils/Logger.hpp"
+#include <algorithm>
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
@@ -16,6 +18,40 @@
 
 namespace fs = std::filesystem;
 
+namespace
+{
+
+// Whether @p line of the exports file exports an application directory, <exportDir>/<digits>
+bool
+isAppExport(const std::string& line, const std::string& exportDir)
+{
+    size_t begin = line.find_first_not_of(" \t");
+    if (begin == std::string::npos || line[begin] == '#')
+    {
+        return false;
+    }
+    if (line[begin] == '"')
+    {
+        ++begin;
+    }
+    const std::string prefix = exportDir + "/";
+    if (line.compare(begin, prefix.size(), prefix) != 0)
+    {
+        return false;
+    }
+    size_t end = line.find_first_of(" \t\"", begin);
+    if (end == std::string::npos)
+    {
+        end = line.size();
+    }
+    const size_t idBegin = begin + prefix.size();
+    return end > idBegin && std::all_of(line.begin() + idBegin, line.begin() + end, [](char ch) {
+               return ch >= '0' && ch <= '9';
+           });
+}
+
+} // namespace
+
 ApplicationManager::ApplicationManager(const std::string& nfsExportDir,
                                        const std::string& nfsMountPoint)
     : m_nextAppId(1),
@@ -23,10 +59,19 @@ ApplicationManager::ApplicationManager(const std::string& nfsExportDir,
       m_nfsMountPoint(nfsMountPoint)
 {
     cleanupStaleEntries();
+    // Drops the entries of a previous run from the exports file, whether or not its folders remain
+    m_exportsDirty = true;
+    reconcileExports();
+    m_reconcileTask = utils::TaskScheduler::instance().schedule(
+        "nfs_export_reconcile",
+        utils::TaskPriority::Low,
+        std::chrono::milliseconds(NFS_RECONCILE_PERIOD_MS),
+        [this] { reconcileExports(); });
 }
 
 ApplicationManager::~ApplicationManager()
 {
+    utils::TaskScheduler::instance().cancel(m_reconcileTask);
     cleanupNFS();
 }
 
@@ -70,12 +115,10 @@ ApplicationManager::setupNFSForApp(int appId)
         return false;
     }
 
-    if (!updateNFSConfig(appId, appDir))
-    {
-        return false;
-    }
-
-    return reloadNFSServer();
+    m_exports.insert(appDir);
+    m_exportsDirty = true;
+    requestReconcile();
+    return true;
 }
 
 std::optional<std::string>
@@ -88,21 +131,97 @@ ApplicationManager::getSimulationCompletedUrl(int appId) const
     return m_registeredApps.at(appId).simulationCompletedUrl;
 }
 
-bool
-ApplicationManager::updateNFSConfig(int appId, const std::string& appDir)
+std::optional<std::string>
+ApplicationManager::getAppDirectory(int appId) const
 {
-    std::ofstream exportsFile("/etc/exports", std::ios::app);
-    if (!exportsFile)
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_registeredApps.count(appId))
     {
-        SPDLOG_LOGGER_WARN(Logger::instance(), "Could not open /etc/exports for writing.");
-        return false;
+        return std::nullopt;
     }
+    return m_nfsExportDir + "/" + std::to_string(appId);
+}
 
-    // Example: Allow all clients (rw, sync)
-    exportsFile << appDir << " *(rw,sync,no_subtree_check,root_squash,all_squash)\n";
-    exportsFile.close();
+void
+ApplicationManager::requestReconcile()
+{
+    if (m_reconcilePending || m_reconcileTask == 0)
+    {
+        return;
+    }
+    m_reconcilePending = true;
+    utils::TaskScheduler::instance().runAt(
+        m_reconcileTask,
+        utils::TaskScheduler::Clock::now() + std::chrono::milliseconds(NFS_RECONCILE_DEBOUNCE_MS));
+}
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Updated /etc/exports for App ID {}", appId);
+void
+ApplicationManager::reconcileExports()
+{
+    std::lock_guard<std::mutex> reconcileLock(m_reconcileMutex);
+    std::set<std::string> exports;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_reconcilePending = false;
+        if (!m_exportsDirty)
+        {
+            return;
+        }
+        m_exportsDirty = false;
+        exports = m_exports;
+    }
+
+    if (writeExportsFile(exports) && reloadNFSServer())
+    {
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Exporting {} application folders", exports.size());
+        return;
+    }
+    // Retried by the next periodic run, or sooner with the next change
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exportsDirty = true;
+}
+
+bool
+ApplicationManager::writeExportsFile(const std::set<std::string>& exports)
+{
+    std::string content;
+    {
+        std::ifstream in(NFS_EXPORTS_FILE);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!isAppExport(line, m_nfsExportDir))
+            {
+                content += line;
+                content += '\n';
+            }
+        }
+    }
+    for (const auto& dir : exports)
+    {
+        content += dir + " " NFS_EXPORT_OPTIONS "\n";
+    }
+
+    // Renamed over the original, so the NFS server never reads a partial file
+    const std::string tmp = std::string(NFS_EXPORTS_FILE) + ".ndt.tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out || !out.write(content.data(), content.size()) || !out.flush())
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(), "Could not write {}", tmp);
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), NFS_EXPORTS_FILE) != 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Could not replace {}: {}",
+                           NFS_EXPORTS_FILE,
+                           std::strerror(errno));
+        std::remove(tmp.c_str());
+        return false;
+    }
     return true;
 }
 
@@ -123,13 +242,18 @@ void ApplicationManager::cleanupNFS()
 {
     SPDLOG_INFO("Cleaning up registered NFS folders in {}", m_nfsExportDir);
 
-    for (const auto& folder : m_registeredFolders)
     {
-        cleanupAppFolder(folder); // Call the new reusable method
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& folder : m_registeredFolders)
+        {
+            cleanupAppFolder(folder); // Call the new reusable method
+        }
+        m_exports.clear();
+        m_exportsDirty = true;
     }
 
-    // Reload NFS exports to apply all changes
-    system("sudo exportfs -ra");
+    // Apply all removals with one rewrite and reload
+    reconcileExports();
 }
 
 bool
@@ -189,18 +313,7 @@ void ApplicationManager::cleanupAppFolder(const std::string& folder)
     {
         if (fs::exists(folder))
         {
-            // Unexport folder
-            std::string cmd = "sudo exportfs -u " + folder;
-            system(cmd.c_str());
-
-            // Escape slashes for sed
-            std::string escapedFolder = std::regex_replace(folder, std::regex("/"), "\\/");
-
-            // Remove from /etc/exports
-            std::string sedCmd = "sudo sed -i '/" + escapedFolder + "/d' /etc/exports";
-            system(sedCmd.c_str());
-
-            // Delete folder
+            // Its export goes with the next reconcileExports()
             fs::remove_all(folder);
             SPDLOG_INFO("Cleaned and deleted NFS folder: {}", folder);
         }
@@ -233,7 +346,4 @@ void ApplicationManager::cleanupStaleEntries()
             }
         }
     }
-
-    // Reload NFS server to make sure all stale entries are fully removed
-    system("sudo exportfs -ra");
 }
\ No newline at end of file
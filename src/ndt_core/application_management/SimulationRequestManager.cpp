@@ -1,55 +1,325 @@
 #include "ndt_core/application_management/SimulationRequestManager.hpp"
 #include "ndt_core/application_management/ApplicationManager.hpp"
+#include "utils/HttpClient.hpp"
 #include "utils/Logger.hpp"
-#include "utils/Utils.hpp"
-#include <iostream>
+#include "utils/Metrics.hpp"
 #include <memory>
 #include <nlohmann/json.hpp>
-#include <thread>
+#include <stdexcept>
+
+namespace
+{
+
+const char*
+stateName(int state)
+{
+    static const char* const names[] = {"queued", "submitting", "running", "failed", "completed"};
+    return names[state];
+}
+
+// app_id and case_id of a request or result body, which send them as strings or numbers
+std::string
+idField(const nlohmann::json& body, const char* key)
+{
+    if (!body.is_object() || !body.contains(key))
+    {
+        return "";
+    }
+    const nlohmann::json& value = body[key];
+    return value.is_string() ? value.get<std::string>() : value.dump();
+}
+
+utils::Counter&
+outcomeCounter(const char* outcome)
+{
+    return utils::MetricsRegistry::instance().counter(
+        "ndt_simulation_requests_total",
+        "Simulation run requests by outcome",
+        utils::MetricsRegistry::label("outcome", outcome));
+}
+
+} // namespace
 
 SimulationRequestManager::SimulationRequestManager(std::shared_ptr<ApplicationManager> appManager,
                                                    std::string simServerUrl)
     : m_applicatonManager(std::move(appManager)),
-      SIM_SERVER_URL(simServerUrl)
+      SIM_SERVER_URL(simServerUrl),
+      m_queuedGauge(utils::MetricsRegistry::instance().gauge(
+          "ndt_simulations_queued", "Simulation run requests waiting to be sent")),
+      m_inflightGauge(utils::MetricsRegistry::instance().gauge(
+          "ndt_simulations_inflight", "Simulation run requests being sent to the simulator")),
+      m_submitted(outcomeCounter("submitted")),
+      m_failed(outcomeCounter("failed")),
+      m_rejected(outcomeCounter("rejected")),
+      m_completed(outcomeCounter("completed"))
 {
 }
 
 SimulationRequestManager::~SimulationRequestManager() = default;
 
-std::string
+std::optional<uint64_t>
 SimulationRequestManager::requestSimulation(const std::string& body)
 {
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST \"" << SIM_SERVER_URL << "\" "
-        << "-H \"Content-Type: application/json\" " << "-d '" << body << "'";
+    const auto request = nlohmann::json::parse(body, nullptr, false);
+    std::vector<std::pair<uint64_t, std::string>> toSend;
+    uint64_t id = 0;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_queue.size() >= SIM_MAX_QUEUED)
+        {
+            m_rejected.add();
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "Simulation queue full, refusing request: {}",
+                               body);
+            return std::nullopt;
+        }
+        id = m_nextId++;
+        Simulation& simulation = m_simulations[id];
+        simulation.id = id;
+        simulation.appId = idField(request, "app_id");
+        simulation.caseId = idField(request, "case_id");
+        simulation.body = body;
+        simulation.createdAt = std::chrono::steady_clock::now();
+        m_order.push_back(id);
+        m_queue.push_back(id);
+        dispatchLocked(toSend);
+        trimLocked();
+    }
+    updateGauges();
+    send(std::move(toSend));
+    return id;
+}
 
-    std::string resp = utils::execCommand(cmd.str());
-    SPDLOG_LOGGER_INFO(Logger::instance(),
-                       "Requested simulation on {} - response: {}",
-                       SIM_SERVER_URL,
-                       resp);
-    return resp;
+void
+SimulationRequestManager::dispatchLocked(std::vector<std::pair<uint64_t, std::string>>& out)
+{
+    while (m_inflight < SIM_MAX_INFLIGHT && !m_queue.empty())
+    {
+        Simulation& simulation = m_simulations.at(m_queue.front());
+        m_queue.pop_front();
+        simulation.state = State::Submitting;
+        out.emplace_back(simulation.id, std::move(simulation.body));
+        ++m_inflight;
+    }
 }
 
 void
-SimulationRequestManager::onSimulationResult(int appId,
-                                             const std::string& body)
+SimulationRequestManager::send(std::vector<std::pair<uint64_t, std::string>> requests)
 {
-    // Forward the result asynchronously
-    std::thread([this, appId, body]() {
-        auto apiUrlOpt = m_applicatonManager->getSimulationCompletedUrl(appId);
-        if (!apiUrlOpt.has_value())
+    utils::HttpRequestOptions options;
+    options.timeout = std::chrono::milliseconds(SIM_REQUEST_TIMEOUT_MS);
+    options.retries = SIM_REQUEST_RETRIES;
+    std::weak_ptr<SimulationRequestManager> weak = weak_from_this();
+    for (auto& [id, body] : requests)
+    {
+        try
+        {
+            utils::HttpClient::instance().asyncRequest(
+                boost::beast::http::verb::post,
+                SIM_SERVER_URL,
+                std::move(body),
+                [weak, id](utils::HttpResponse response) {
+                    if (auto self = weak.lock())
+                    {
+                        self->onSubmitted(id,
+                                          response.status,
+                                          std::move(response.body),
+                                          response.error ? response.error.message() : "");
+                    }
+                },
+                options);
+        }
+        catch (const std::invalid_argument& e)
         {
-            SPDLOG_LOGGER_WARN(Logger::instance(), "Cannot get Url from appId: {}", appId);
+            onSubmitted(id, 0, "", e.what());
+        }
+    }
+}
+
+void
+SimulationRequestManager::onSubmitted(uint64_t id,
+                                      unsigned status,
+                                      std::string response,
+                                      std::string error)
+{
+    const bool accepted = error.empty() && status >= 200 && status < 300;
+    if (accepted)
+    {
+        m_submitted.add();
+        SPDLOG_LOGGER_INFO(Logger::instance(),
+                           "Requested simulation {} on {} - response: {}",
+                           id,
+                           SIM_SERVER_URL,
+                           response);
+    }
+    else
+    {
+        m_failed.add();
+        if (error.empty())
+        {
+            error = "Simulator answered " + std::to_string(status);
+        }
+        SPDLOG_LOGGER_ERROR(Logger::instance(),
+                            "Cannot request simulation {} on {}: {}",
+                            id,
+                            SIM_SERVER_URL,
+                            error);
+    }
+
+    std::vector<std::pair<uint64_t, std::string>> toSend;
+    {
+        std::lock_guard lock(m_mutex);
+        --m_inflight;
+        auto it = m_simulations.find(id);
+        if (it != m_simulations.end())
+        {
+            it->second.state = accepted ? State::Running : State::Failed;
+            it->second.simulatorStatus = status;
+            it->second.simulatorResponse = std::move(response);
+            it->second.error = std::move(error);
+        }
+        dispatchLocked(toSend);
+        trimLocked();
+    }
+    updateGauges();
+    send(std::move(toSend));
+}
+
+void
+SimulationRequestManager::trimLocked()
+{
+    while (m_order.size() > SIM_MAX_RECORDS)
+    {
+        auto it = m_simulations.find(m_order.front());
+        if (it != m_simulations.end() &&
+            (it->second.state == State::Queued || it->second.state == State::Submitting))
+        {
+            // Still in the pipeline; the queue bound keeps these few
             return;
         }
-        const std::string& apiUrl = apiUrlOpt.value();
+        if (it != m_simulations.end())
+        {
+            m_simulations.erase(it);
+        }
+        m_order.pop_front();
+    }
+}
+
+void
+SimulationRequestManager::updateGauges()
+{
+    std::lock_guard lock(m_mutex);
+    m_queuedGauge.set(static_cast<double>(m_queue.size()));
+    m_inflightGauge.set(static_cast<double>(m_inflight));
+}
+
+void
+SimulationRequestManager::onSimulationResult(int appId, const std::string& body)
+{
+    const std::string caseId = idField(nlohmann::json::parse(body, nullptr, false), "case_id");
+    {
+        std::lock_guard lock(m_mutex);
+        // The latest running request of the case is the one that finished
+        for (auto it = m_order.rbegin(); it != m_order.rend(); ++it)
+        {
+            auto simulation = m_simulations.find(*it);
+            if (simulation != m_simulations.end() &&
+                simulation->second.state == State::Running &&
+                simulation->second.appId == std::to_string(appId) &&
+                simulation->second.caseId == caseId)
+            {
+                simulation->second.state = State::Completed;
+                m_completed.add();
+                break;
+            }
+        }
+    }
+
+    auto apiUrlOpt = m_applicatonManager->getSimulationCompletedUrl(appId);
+    if (!apiUrlOpt.has_value())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Cannot get Url from appId: {}", appId);
+        return;
+    }
 
-        std::ostringstream cmd;
-        cmd << "curl -s -X POST \"" << apiUrl << "\" " << "-H \"Content-Type: application/json\" "
-            << "-d '" << body << "'";
+    // Forward the result asynchronously
+    utils::HttpRequestOptions options;
+    options.timeout = std::chrono::milliseconds(SIM_REQUEST_TIMEOUT_MS);
+    options.retries = SIM_REQUEST_RETRIES;
+    try
+    {
+        utils::HttpClient::instance().asyncRequest(
+            boost::beast::http::verb::post,
+            apiUrlOpt.value(),
+            body,
+            [appId](utils::HttpResponse response) {
+                if (!response.ok())
+                {
+                    SPDLOG_LOGGER_WARN(Logger::instance(),
+                                       "Cannot forward simulation result of app {}: {}",
+                                       appId,
+                                       response.error ? response.error.message()
+                                                      : std::to_string(response.status));
+                    return;
+                }
+                SPDLOG_LOGGER_INFO(Logger::instance(),
+                                   "Forwarded simulation result, response: {}",
+                                   response.body);
+            },
+            options);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Cannot forward simulation result of app {}: {}",
+                           appId,
+                           e.what());
+    }
+}
 
-        std::string result = utils::execCommand(cmd.str());
-        SPDLOG_LOGGER_INFO(Logger::instance(), "Forwarded simulation result, response: {}", result);
-    }).detach();
-}
\ No newline at end of file
+std::optional<nlohmann::json>
+SimulationRequestManager::statusJson(uint64_t id) const
+{
+    std::lock_guard lock(m_mutex);
+    auto it = m_simulations.find(id);
+    if (it == m_simulations.end())
+    {
+        return std::nullopt;
+    }
+    const Simulation& simulation = it->second;
+    nlohmann::json status{
+        {"simulation_id", simulation.id},
+        {"app_id", simulation.appId},
+        {"case_id", simulation.caseId},
+        {"state", stateName(static_cast<int>(simulation.state))},
+        {"elapsed_ms",
+         std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                               simulation.createdAt)
+             .count()},
+    };
+    if (simulation.simulatorStatus != 0)
+    {
+        status["simulator_status"] = simulation.simulatorStatus;
+        status["simulator_response"] = simulation.simulatorResponse;
+    }
+    if (!simulation.error.empty())
+    {
+        status["error"] = simulation.error;
+    }
+    return status;
+}
+
+nlohmann::json
+SimulationRequestManager::statsJson() const
+{
+    std::lock_guard lock(m_mutex);
+    return nlohmann::json{
+        {"queued", m_queue.size()},
+        {"inflight", m_inflight},
+        {"submitted", m_submitted.value()},
+        {"failed", m_failed.value()},
+        {"rejected", m_rejected.value()},
+        {"completed", m_completed.value()},
+        {"kept", m_simulations.size()},
+    };
+}
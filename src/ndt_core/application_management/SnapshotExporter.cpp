@@ -0,0 +1,306 @@
+#include "ndt_core/application_management/SnapshotExporter.hpp"
+#include "ndt_core/application_management/ApplicationManager.hpp"
+#include "ndt_core/collection/FlowLinkUsageCollector.hpp"
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace
+{
+
+size_t
+alignUp(size_t size)
+{
+    return (size + 7) & ~size_t(7);
+}
+
+// Append the records of one section to @p out and describe it in @p sections
+template <typename T>
+void
+appendSection(std::vector<char>& out,
+              std::vector<snapshot::SectionEntry>& sections,
+              snapshot::SectionId id,
+              const std::vector<T>& records)
+{
+    out.resize(alignUp(out.size()));
+    sections.push_back(snapshot::SectionEntry{static_cast<uint32_t>(id),
+                                              static_cast<uint32_t>(sizeof(T)),
+                                              out.size(),
+                                              records.size()});
+    const char* data = reinterpret_cast<const char*>(records.data());
+    out.insert(out.end(), data, data + records.size() * sizeof(T));
+}
+
+void
+writeFile(const std::string& path, const std::vector<char>& bytes)
+{
+    const std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot create " + tmp + ": " + std::strerror(errno));
+    }
+    size_t written = 0;
+    while (written < bytes.size())
+    {
+        ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            const int error = errno;
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            throw std::runtime_error("Cannot write " + tmp + ": " + std::strerror(error));
+        }
+        written += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    // Readers mapping the old file keep it; new ones see the complete new one
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        const int error = errno;
+        ::unlink(tmp.c_str());
+        throw std::runtime_error("Cannot rename " + tmp + ": " + std::strerror(error));
+    }
+}
+
+} // namespace
+
+SnapshotExporter::SnapshotExporter(std::shared_ptr<TopologyAndFlowMonitor> topologyAndFlowMonitor,
+                                   std::shared_ptr<sflow::FlowLinkUsageCollector> collector,
+                                   std::shared_ptr<ApplicationManager> appManager)
+    : m_topologyAndFlowMonitor(std::move(topologyAndFlowMonitor)),
+      m_collector(std::move(collector)),
+      m_appManager(std::move(appManager))
+{
+}
+
+SnapshotExporter::~SnapshotExporter()
+{
+    std::lock_guard lock(m_scheduleMutex);
+    for (const auto& [appId, task] : m_scheduled)
+    {
+        utils::TaskScheduler::instance().cancel(task);
+    }
+}
+
+std::shared_ptr<const SnapshotExporter::Encoded>
+SnapshotExporter::encode() const
+{
+    auto encoded = std::make_shared<Encoded>();
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const CsrGraph& csr = graphSnapshot->csr;
+    const Graph& graph = graphSnapshot->graph;
+
+    std::vector<snapshot::VertexRecord> vertices(csr.vertexCount());
+    std::vector<uint32_t> outOffsets(csr.vertexCount() + 1, 0);
+    for (CsrGraph::VertexId v = 0; v < csr.vertexCount(); ++v)
+    {
+        const VertexProperties& properties = graph[v];
+        snapshot::VertexRecord& record = vertices[v];
+        record.dpid = properties.dpid;
+        record.mac = properties.mac;
+        record.ip = properties.ip.empty() ? 0 : properties.ip.front();
+        record.type = static_cast<uint8_t>(properties.vertexType);
+        record.flags = (properties.isUp ? snapshot::FLAG_UP : 0) |
+                       (properties.isEnabled ? snapshot::FLAG_ENABLED : 0);
+        outOffsets[v] = csr.outBegin(v);
+    }
+    outOffsets[csr.vertexCount()] = static_cast<uint32_t>(csr.edgeCount());
+
+    std::vector<snapshot::EdgeRecord> edges(csr.edgeCount());
+    for (CsrGraph::EdgeId e = 0; e < csr.edgeCount(); ++e)
+    {
+        snapshot::EdgeRecord& record = edges[e];
+        record.source = csr.source(e);
+        record.target = csr.target(e);
+        record.srcInterface = csr.srcInterface(e);
+        record.dstInterface = csr.dstInterface(e);
+        record.linkBandwidth = csr.linkBandwidth(e);
+        record.linkBandwidthUsage = csr.linkBandwidthUsage(e);
+        record.utilization = csr.utilization(e);
+        record.flowCount = static_cast<uint32_t>(csr.flowCount(e));
+        record.flags = (csr.edgeUp(e) ? snapshot::FLAG_UP : 0) |
+                       (csr.edgeUsable(e) ? snapshot::FLAG_ENABLED : 0);
+    }
+
+    // Flows on the same path share its hops, as they do in the PathPool
+    std::vector<snapshot::FlowRecord> flows;
+    std::vector<snapshot::PathHopRecord> hops;
+    std::unordered_map<uint32_t, uint32_t> pathOffsets; // PathHandle::id() -> first hop
+    auto visit = [&](const sflow::FlowKey& key, const sflow::FlowInfo& info) {
+        snapshot::FlowRecord record{};
+        record.srcIp = key.srcIP;
+        record.dstIp = key.dstIP;
+        record.srcPort = key.srcPort;
+        record.dstPort = key.dstPort;
+        record.protocol = key.protocol;
+        const sflow::ImmediateRate rate = info.immediateRate();
+        record.flags = (rate.bps >= MICE_FLOW_UNDER_THRESHOLD ? snapshot::FLOW_ELEPHANT : 0) |
+                       (info.isAck ? snapshot::FLOW_ACK : 0);
+        record.rateBps = rate.bps;
+        record.packetRate = rate.pps;
+        record.startMs = info.startTime;
+        record.endMs = info.endTime;
+        if (!info.flowPath.empty())
+        {
+            auto [it, added] =
+                pathOffsets.try_emplace(info.flowPath.id(), static_cast<uint32_t>(hops.size()));
+            if (added)
+            {
+                for (const auto [dpid, port] : info.flowPath)
+                {
+                    hops.push_back(snapshot::PathHopRecord{dpid, port, 0});
+                }
+            }
+            record.pathOffset = it->second;
+            record.pathLength = static_cast<uint32_t>(info.flowPath.size());
+        }
+        flows.push_back(record);
+        return true;
+    };
+    m_collector->visitFlows(sflow::FlowQuery{}, visit);
+
+    std::vector<snapshot::SectionEntry> sections;
+    std::vector<char>& out = encoded->bytes;
+    constexpr size_t SECTIONS = 5;
+    out.resize(alignUp(sizeof(snapshot::FileHeader) + SECTIONS * sizeof(snapshot::SectionEntry)));
+    appendSection(out, sections, snapshot::SectionId::Vertices, vertices);
+    appendSection(out, sections, snapshot::SectionId::OutOffsets, outOffsets);
+    appendSection(out, sections, snapshot::SectionId::Edges, edges);
+    appendSection(out, sections, snapshot::SectionId::Flows, flows);
+    appendSection(out, sections, snapshot::SectionId::PathHops, hops);
+
+    snapshot::FileHeader header{};
+    std::memcpy(header.magic, snapshot::MAGIC, sizeof(header.magic));
+    header.formatVersion = snapshot::FORMAT_VERSION;
+    header.headerSize = sizeof(snapshot::FileHeader);
+    header.byteOrder = snapshot::BYTE_ORDER_MARK;
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    header.graphVersion = graphSnapshot->version;
+    header.takenAtMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+    std::memcpy(out.data(), &header, sizeof(header));
+    std::memcpy(out.data() + sizeof(header),
+                sections.data(),
+                sections.size() * sizeof(snapshot::SectionEntry));
+
+    encoded->graphVersion = graphSnapshot->version;
+    encoded->vertices = vertices.size();
+    encoded->edges = edges.size();
+    encoded->flows = flows.size();
+    encoded->pathHops = hops.size();
+    encoded->encodedAt = std::chrono::steady_clock::now();
+    return encoded;
+}
+
+std::shared_ptr<const SnapshotExporter::Encoded>
+SnapshotExporter::current()
+{
+    std::lock_guard lock(m_encodeMutex);
+    if (!m_encoded || std::chrono::steady_clock::now() - m_encoded->encodedAt >=
+                          std::chrono::milliseconds(SNAPSHOT_REUSE_MS))
+    {
+        m_encoded = encode();
+        m_encodings.fetch_add(1, std::memory_order_relaxed);
+    }
+    return m_encoded;
+}
+
+std::optional<nlohmann::json>
+SnapshotExporter::exportForApp(int appId)
+{
+    std::optional<std::string> directory = m_appManager->getAppDirectory(appId);
+    if (!directory)
+    {
+        return std::nullopt;
+    }
+    const std::string path = *directory + "/" + SNAPSHOT_FILE_NAME;
+    auto encoded = current();
+    try
+    {
+        writeFile(path, encoded->bytes);
+    }
+    catch (const std::runtime_error&)
+    {
+        m_failures.fetch_add(1, std::memory_order_relaxed);
+        throw;
+    }
+    m_exports.fetch_add(1, std::memory_order_relaxed);
+    m_lastBytes.store(encoded->bytes.size(), std::memory_order_relaxed);
+    return nlohmann::json{
+        {"path", path},
+        {"graph_version", encoded->graphVersion},
+        {"bytes", encoded->bytes.size()},
+        {"vertices", encoded->vertices},
+        {"edges", encoded->edges},
+        {"flows", encoded->flows},
+        {"path_hops", encoded->pathHops},
+    };
+}
+
+bool
+SnapshotExporter::schedule(int appId, std::chrono::milliseconds interval)
+{
+    if (!m_appManager->getAppDirectory(appId))
+    {
+        return false;
+    }
+    std::lock_guard lock(m_scheduleMutex);
+    if (auto it = m_scheduled.find(appId); it != m_scheduled.end())
+    {
+        utils::TaskScheduler::instance().cancel(it->second);
+        m_scheduled.erase(it);
+    }
+    if (interval.count() <= 0)
+    {
+        return true;
+    }
+    interval = std::max(interval, std::chrono::milliseconds(SNAPSHOT_MIN_INTERVAL_MS));
+    m_scheduled[appId] = utils::TaskScheduler::instance().schedule(
+        "snapshot_export_app_" + std::to_string(appId),
+        utils::TaskPriority::Normal,
+        interval,
+        [this, appId] {
+            try
+            {
+                exportForApp(appId);
+            }
+            catch (const std::runtime_error& e)
+            {
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "Snapshot export for app {} failed: {}",
+                                   appId,
+                                   e.what());
+            }
+        },
+        false);
+    return true;
+}
+
+nlohmann::json
+SnapshotExporter::statsJson() const
+{
+    size_t scheduled = 0;
+    {
+        std::lock_guard lock(m_scheduleMutex);
+        scheduled = m_scheduled.size();
+    }
+    return nlohmann::json{
+        {"exports", m_exports.load(std::memory_order_relaxed)},
+        {"encodings", m_encodings.load(std::memory_order_relaxed)},
+        {"failures", m_failures.load(std::memory_order_relaxed)},
+        {"scheduled_apps", scheduled},
+        {"last_bytes", m_lastBytes.load(std::memory_order_relaxed)},
+    };
+}
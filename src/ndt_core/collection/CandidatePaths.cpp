@@ -0,0 +1,394 @@
+#include "ndt_core/collection/CandidatePaths.hpp"
+#include "utils/Hash.hpp"
+#include "utils/MemoryAccounting.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <queue>
+#include <set>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+
+namespace
+{
+
+using Vertex = CsrGraph::VertexId;
+using Edge = CsrGraph::EdgeId;
+using VertexPath = std::vector<Vertex>;
+
+double
+edgeCost(const CsrGraph& graph, Edge e, PathWeight weight)
+{
+    switch (weight)
+    {
+    case PathWeight::HOP_COUNT:
+        return 1.0;
+    case PathWeight::UTILIZATION:
+        return 1.0 + std::clamp(graph.utilization(e) / 100.0, 0.0, 1.0);
+    case PathWeight::LEFT_BANDWIDTH:
+        if (graph.linkBandwidth(e) == 0)
+        {
+            return 2.0;
+        }
+        return 2.0 - std::clamp(static_cast<double>(graph.leftBandwidth(e)) /
+                                    graph.linkBandwidth(e),
+                                0.0,
+                                1.0);
+    }
+    return 1.0;
+}
+
+bool
+usableSwitch(const CsrGraph& graph, Vertex v)
+{
+    return graph.dpid(v) != 0 && graph.vertexUsable(v);
+}
+
+/**
+ * @brief Dijkstra over usable switches and links, reusing its buffers across searches.
+ *
+ * Vertices flagged in blockedVertex and links in blockedEdges (see edgeKey()) are skipped.
+ */
+struct SpurSearch
+{
+    SpurSearch(const CsrGraph& g, PathWeight w)
+        : graph(g),
+          weight(w),
+          vertexCount(g.vertexCount()),
+          dist(vertexCount),
+          prev(vertexCount),
+          blockedVertex(vertexCount, 0)
+    {
+    }
+
+    size_t edgeKey(Vertex u, Vertex v) const
+    {
+        return u * vertexCount + v;
+    }
+
+    std::optional<VertexPath> run(Vertex src, Vertex dst)
+    {
+        constexpr double kInf = std::numeric_limits<double>::infinity();
+        std::fill(dist.begin(), dist.end(), kInf);
+        using Item = std::pair<double, Vertex>;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+        dist[src] = 0;
+        prev[src] = NO_VERTEX;
+        queue.emplace(0.0, src);
+        while (!queue.empty())
+        {
+            auto [d, u] = queue.top();
+            queue.pop();
+            if (d > dist[u])
+            {
+                continue;
+            }
+            if (u == dst)
+            {
+                break;
+            }
+            for (Edge e = graph.outBegin(u); e != graph.outEnd(u); ++e)
+            {
+                const Vertex v = graph.target(e);
+                if (!graph.edgeUsable(e) || blockedVertex[v] || !usableSwitch(graph, v) ||
+                    blockedEdges.contains(edgeKey(u, v)))
+                {
+                    continue;
+                }
+                double next = d + edgeCost(graph, e, weight);
+                if (next < dist[v])
+                {
+                    dist[v] = next;
+                    prev[v] = u;
+                    queue.emplace(next, v);
+                }
+            }
+        }
+        if (dist[dst] == kInf)
+        {
+            return std::nullopt;
+        }
+        VertexPath path;
+        for (Vertex v = dst; v != NO_VERTEX; v = prev[v])
+        {
+            path.push_back(v);
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    double cost(const VertexPath& path) const
+    {
+        double total = 0;
+        for (size_t i = 0; i + 1 < path.size(); ++i)
+        {
+            total += edgeCost(graph, *graph.findEdge(path[i], path[i + 1]), weight);
+        }
+        return total;
+    }
+
+    static constexpr Vertex NO_VERTEX = UINT32_MAX;
+
+    const CsrGraph& graph;
+    PathWeight weight;
+    size_t vertexCount;
+    std::vector<double> dist;
+    std::vector<Vertex> prev;
+    std::vector<char> blockedVertex;
+    std::unordered_set<size_t> blockedEdges;
+};
+
+} // namespace
+
+std::vector<sflow::Path>
+kShortestSwitchPaths(const CsrGraph& graph,
+                     CsrGraph::VertexId src,
+                     CsrGraph::VertexId dst,
+                     const CandidatePathOptions& options)
+{
+    std::vector<sflow::Path> out;
+    const size_t vertexCount = graph.vertexCount();
+    if (options.k == 0 || src >= vertexCount || dst >= vertexCount ||
+        !usableSwitch(graph, src) || !usableSwitch(graph, dst))
+    {
+        return out;
+    }
+
+    SpurSearch search(graph, options.weight);
+    std::vector<VertexPath> accepted;
+    auto first = search.run(src, dst);
+    if (!first || first->size() - 1 > options.maxHops)
+    {
+        return out;
+    }
+    accepted.push_back(std::move(*first));
+
+    // Candidates by (cost, discovery order); seen holds every path accepted or queued
+    using Candidate = std::tuple<double, size_t, VertexPath>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    std::set<VertexPath> seen{accepted.front()};
+    size_t discovered = 0;
+
+    while (accepted.size() < options.k)
+    {
+        const VertexPath previous = accepted.back();
+        // Spur from every switch of the previous path but the destination
+        for (size_t i = 0; i + 1 < previous.size(); ++i)
+        {
+            const Vertex spur = previous[i];
+            search.blockedEdges.clear();
+            for (const auto& path : accepted)
+            {
+                if (path.size() > i + 1 && std::equal(path.begin(), path.begin() + i + 1,
+                                                      previous.begin()))
+                {
+                    search.blockedEdges.insert(search.edgeKey(path[i], path[i + 1]));
+                }
+            }
+            for (size_t j = 0; j < i; ++j)
+            {
+                search.blockedVertex[previous[j]] = 1;
+            }
+
+            auto spurPath = search.run(spur, dst);
+
+            for (size_t j = 0; j < i; ++j)
+            {
+                search.blockedVertex[previous[j]] = 0;
+            }
+            if (!spurPath)
+            {
+                continue;
+            }
+
+            VertexPath total(previous.begin(), previous.begin() + i);
+            total.insert(total.end(), spurPath->begin(), spurPath->end());
+            if (total.size() - 1 > options.maxHops || !seen.insert(total).second)
+            {
+                continue;
+            }
+            double cost = search.cost(total);
+            candidates.emplace(cost, discovered++, std::move(total));
+        }
+
+        if (candidates.empty())
+        {
+            break;
+        }
+        accepted.push_back(std::get<2>(candidates.top()));
+        candidates.pop();
+    }
+
+    out.reserve(accepted.size());
+    for (const auto& vertices : accepted)
+    {
+        sflow::Path path;
+        path.reserve(vertices.size());
+        for (size_t i = 0; i + 1 < vertices.size(); ++i)
+        {
+            auto e = *graph.findEdge(vertices[i], vertices[i + 1]);
+            path.emplace_back(graph.dpid(vertices[i]), graph.srcInterface(e));
+        }
+        path.emplace_back(graph.dpid(vertices.back()), 0U);
+        out.push_back(std::move(path));
+    }
+    return out;
+}
+
+std::vector<sflow::Path>
+allSimpleSwitchPaths(const CsrGraph& graph,
+                     CsrGraph::VertexId src,
+                     CsrGraph::VertexId dst,
+                     const CandidatePathOptions& options)
+{
+    std::vector<sflow::Path> out;
+    const size_t vertexCount = graph.vertexCount();
+    if (options.k == 0 || src >= vertexCount || dst >= vertexCount ||
+        !usableSwitch(graph, src) || !usableSwitch(graph, dst))
+    {
+        return out;
+    }
+    if (src == dst)
+    {
+        out.push_back({{graph.dpid(src), 0U}});
+        return out;
+    }
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeBudgetMs);
+    // One frame per switch of the current path: the switch and the next out-edge to try
+    std::vector<std::pair<Vertex, Edge>> stack;
+    stack.reserve(options.maxHops + 1);
+    std::vector<char> onPath(vertexCount, 0);
+    stack.emplace_back(src, graph.outBegin(src));
+    onPath[src] = 1;
+    size_t steps = 0;
+    while (!stack.empty() && out.size() < options.k)
+    {
+        if (++steps % ALL_PATHS_CLOCK_STRIDE == 0 && std::chrono::steady_clock::now() > deadline)
+        {
+            break;
+        }
+        auto& [u, next] = stack.back();
+        if (next == graph.outEnd(u))
+        {
+            onPath[u] = 0;
+            stack.pop_back();
+            continue;
+        }
+        const Edge e = next++;
+        const Vertex v = graph.target(e);
+        if (!graph.edgeUsable(e) || onPath[v] || !usableSwitch(graph, v))
+        {
+            continue;
+        }
+        if (v == dst)
+        {
+            // Each frame's edge is the one just before its cursor
+            sflow::Path path;
+            path.reserve(stack.size() + 1);
+            for (const auto& [w, cursor] : stack)
+            {
+                path.emplace_back(graph.dpid(w), graph.srcInterface(cursor - 1));
+            }
+            path.emplace_back(graph.dpid(dst), 0U);
+            out.push_back(std::move(path));
+        }
+        else if (stack.size() < options.maxHops)
+        {
+            onPath[v] = 1;
+            stack.emplace_back(v, graph.outBegin(v));
+        }
+    }
+    return out;
+}
+
+size_t
+CandidatePathCache::KeyHash::operator()(const Key& key) const
+{
+    return utils::hashWords({key.srcDpid,
+                             key.dstDpid,
+                             static_cast<uint64_t>(key.options.k),
+                             static_cast<uint64_t>(key.options.maxHops),
+                             static_cast<uint64_t>(key.options.weight),
+                             static_cast<uint64_t>(key.options.search),
+                             static_cast<uint64_t>(key.options.timeBudgetMs)});
+}
+
+std::optional<std::vector<sflow::Path>>
+CandidatePathCache::find(uint64_t graphVersion,
+                         uint64_t srcDpid,
+                         uint64_t dstDpid,
+                         const CandidatePathOptions& options)
+{
+    std::lock_guard lock(m_mutex);
+    syncVersion(graphVersion);
+    auto it = m_paths.find(Key{srcDpid, dstDpid, options});
+    if (graphVersion != m_version || it == m_paths.end())
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second;
+}
+
+void
+CandidatePathCache::insert(uint64_t graphVersion,
+                           uint64_t srcDpid,
+                           uint64_t dstDpid,
+                           const CandidatePathOptions& options,
+                           std::vector<sflow::Path> paths)
+{
+    std::lock_guard lock(m_mutex);
+    syncVersion(graphVersion);
+    // Computed against an older graph than the cache already holds: don't keep it
+    if (graphVersion != m_version)
+    {
+        return;
+    }
+    if (m_paths.size() >= CANDIDATE_PATHS_CACHE_MAX_PAIRS)
+    {
+        m_paths.clear();
+    }
+    m_paths.insert_or_assign(Key{srcDpid, dstDpid, options}, std::move(paths));
+}
+
+nlohmann::json
+CandidatePathCache::statsJson() const
+{
+    std::lock_guard lock(m_mutex);
+    return nlohmann::json{{"pairs", m_paths.size()},
+                          {"version", m_version},
+                          {"hits", m_hits.load(std::memory_order_relaxed)},
+                          {"misses", m_misses.load(std::memory_order_relaxed)}};
+}
+
+size_t
+CandidatePathCache::memoryBytes() const
+{
+    std::lock_guard lock(m_mutex);
+    size_t bytes = utils::heapBytes(m_paths);
+    for (const auto& [key, paths] : m_paths)
+    {
+        bytes += utils::heapBytes(paths);
+        for (const sflow::Path& path : paths)
+        {
+            bytes += utils::heapBytes(path);
+        }
+    }
+    return bytes;
+}
+
+void
+CandidatePathCache::syncVersion(uint64_t graphVersion)
+{
+    if (graphVersion > m_version)
+    {
+        m_paths.clear();
+        m_version = graphVersion;
+    }
+}
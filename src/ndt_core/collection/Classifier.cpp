@@ -1,19 +1,32 @@
 #include "ndt_core/collection/Classifier.hpp"
+#include "common_types/GraphTypes.hpp"
+#include "common_types/SFlowType.hpp"
+#include "utils/FlatHashMap.hpp"
+#include "utils/FlightRecorder.hpp"
+#include "utils/Hash.hpp"
+#include "utils/MemoryPolicy.hpp"
 #include "utils/Utils.hpp"
 
 #include <algorithm>
 #include <array>
+#include <bit>
+#include <atomic>
 #include <cctype>
+#include <chrono>
 #include <cstring>
+#include <exception>
 #include <memory>
 #include <mutex>
 #include <optional>
-#include <shared_mutex>
 #include <spdlog/fmt/bin_to_hex.h>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include <arpa/inet.h>
@@ -27,10 +40,16 @@ namespace ndtClassifier
  * This file contains all internal data structures and logic:
  * - canonical fixed-width key packing
  * - mask interning (deduplication)
+ * - effect interning (rules with the same actions share one RuleEffect)
  * - synthetic RuleId computation (tableId + coreHash)
  * - OVS-like subtable hashing (mask-grouped subtables)
- * - incremental update (mark-and-sweep pre poll epoch)
+ * - incremental update (mark-and-sweep pre poll epoch, skipped for unchanged polls)
+ * - incremental update from sflow::FlowDiff sets
  * - lookup (fast hashed match + highest priority selection)
+ * - compiled tables (read-only lookup form, rebuilt after each update), keyed by the bytes
+ *   each subtable's mask covers
+ * - group tables and multi-table pipeline lookup
+ * - read-copy-update publication of the compiled tables, so lookups take no lock
  */
 
 // ======================================================================
@@ -78,25 +97,25 @@ struct KeyBytes
     }
 };
 
-/** @brief Hash functor for  KeyBytes.
+/** @brief Hash functor for KeyBytes.
  *
  * @details
- * Uses 64-bit FNV-1a over the key bytes. This is good enough for hashtables here.
+ * Reads the key as kKeyBytes / 8 words and hashes them with @p Policy, instead of one
+ * multiply per byte as FNV-1a did.
  */
-struct KeyBytesHash
+template <typename Policy = utils::DefaultHashPolicy>
+struct BasicKeyBytesHash
 {
     size_t operator()(const KeyBytes& k) const noexcept
     {
-        uint64_t h = 1469598103934665603ULL;
-        for (uint8_t c : k.bytes)
-        {
-            h ^= c;
-            h *= 1099511628211ULL;
-        }
-        return static_cast<size_t>(h);
+        std::array<uint64_t, kKeyBytes / 8> words;
+        std::memcpy(words.data(), k.bytes.data(), kKeyBytes);
+        return static_cast<size_t>(Policy::hash(words.data(), words.size()));
     }
 };
 
+using KeyBytesHash = BasicKeyBytesHash<>;
+
 /** @brief Bitwise AND between a key and a mask (byte-wise).
  *
  * @param a Key bytes
@@ -173,6 +192,50 @@ packKey(const FlowKey& k) noexcept
     return out;
 }
 
+/** @brief Keep a lookup that matched nothing in the flight recorder, for post-mortems. */
+static inline void
+recordMiss(bool switchKnown, uint64_t dpid, uint8_t tableId, const FlowKey& k) noexcept
+{
+    utils::FlightRecorder::instance().recordClassifierMiss(
+        switchKnown, dpid, tableId, k.inPort, k.ipProto, k.ipv4Src, k.ipv4Dst, k.tpSrc, k.tpDst);
+}
+
+static inline uint32_t
+readU32Be(const std::array<uint8_t, kKeyBytes>& in, size_t off) noexcept
+{
+    uint32_t be;
+    std::memcpy(&be, in.data() + off, sizeof(be));
+    return ntohl(be);
+}
+
+static inline uint16_t
+readU16Be(const std::array<uint8_t, kKeyBytes>& in, size_t off) noexcept
+{
+    uint16_t be;
+    std::memcpy(&be, in.data() + off, sizeof(be));
+    return ntohs(be);
+}
+
+/** @brief OR packed mask bytes into a FlowKey-shaped mask (inverse of packKey()). */
+static inline void
+orUnpackedMask(const KeyBytes& m, FlowKey& out) noexcept
+{
+    out.inPort |= readU32Be(m.bytes, 0);
+    out.ethType |= readU16Be(m.bytes, 4);
+    out.ipProto |= m.bytes[6];
+    out.ipv4Src |= readU32Be(m.bytes, 8);
+    out.ipv4Dst |= readU32Be(m.bytes, 12);
+    out.tpSrc |= readU16Be(m.bytes, 16);
+    out.tpDst |= readU16Be(m.bytes, 18);
+    out.vlanTci |= readU16Be(m.bytes, 20);
+    uint64_t metadata = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        metadata = (metadata << 8) | m.bytes[24 + i];
+    }
+    out.metadata |= metadata;
+}
+
 // ======================================================================
 // Internal: mask interning
 // ======================================================================
@@ -195,6 +258,8 @@ struct Mask
  * In OVS, subtables are grouped by identical masks. Interning provides:
  * - less memory (one mask instance shared by many rules)
  * - faster comparisons (pointer equality instead of memcmp)
+ *
+ * Thread-safe, so switches can be updated in parallel.
  */
 class MaskIntern
 {
@@ -202,6 +267,7 @@ class MaskIntern
     /** @brief Intern (deduplicate) mask bytes and return a stable pointer.*/
     const Mask* interMask(const KeyBytes& maskBytes)
     {
+        std::lock_guard lock(mutex_);
         auto it = pool_.find(maskBytes);
         if (it != pool_.end())
         {
@@ -215,10 +281,125 @@ class MaskIntern
         return ret;
     }
 
+    size_t size() const
+    {
+        std::lock_guard lock(mutex_);
+        return pool_.size();
+    }
+
+    /** @brief Estimated heap bytes of the pool and its masks. */
+    size_t memoryBytes() const
+    {
+        std::lock_guard lock(mutex_);
+        return utils::heapBytes(pool_) + pool_.size() * sizeof(Mask);
+    }
+
   private:
+    mutable std::mutex mutex_;
     std::unordered_map<KeyBytes, std::unique_ptr<Mask>, KeyBytesHash> pool_;
 };
 
+// ======================================================================
+// Internal: effect interning
+// ======================================================================
+
+/** @brief Hash functor for RuleEffect (FNV-1a over its fields). */
+struct RuleEffectHash
+{
+    size_t operator()(const RuleEffect& e) const noexcept
+    {
+        uint64_t h = 1469598103934665603ULL;
+        const uint32_t gotoTable = e.gotoTable ? 0x100u | *e.gotoTable : 0;
+        const uint64_t groupId = e.groupId ? (uint64_t{1} << 32) | *e.groupId : 0;
+        for (uint64_t v : {uint64_t{gotoTable}, groupId, uint64_t{e.outputPorts.size()}})
+        {
+            h = (h ^ v) * 1099511628211ULL;
+        }
+        for (uint32_t port : e.outputPorts)
+        {
+            h = (h ^ port) * 1099511628211ULL;
+        }
+        return static_cast<size_t>(h);
+    }
+};
+
+struct RuleEffectEq
+{
+    bool operator()(const RuleEffect& a, const RuleEffect& b) const noexcept
+    {
+        return a.gotoTable == b.gotoTable && a.groupId == b.groupId &&
+               a.outputPorts == b.outputPorts;
+    }
+};
+
+/** @brief Interning pool sharing one RuleEffect among all rules with the same actions.
+ *
+ * @details
+ * A switch with 100k rules typically forwards to a few dozen ports, so rules and compiled
+ * tables point to a shared, immutable effect instead of each owning an outputPorts vector.
+ * The pool only holds weak references: an effect lives as long as a rule or a published
+ * table uses it, and sweep() forgets the ones that died. Thread-safe.
+ */
+class EffectIntern
+{
+  public:
+    std::shared_ptr<const RuleEffect> intern(const RuleEffect& effect)
+    {
+        std::lock_guard lock(mutex_);
+        auto it = pool_.find(effect);
+        if (it != pool_.end())
+        {
+            if (auto shared = it->second.lock())
+            {
+                return shared;
+            }
+            pool_.erase(it);
+        }
+        auto shared = std::make_shared<const RuleEffect>(effect);
+        pool_.emplace(effect, shared);
+        return shared;
+    }
+
+    /** @brief Drop the dead entries once the pool doubled since the last sweep. */
+    void sweep()
+    {
+        std::lock_guard lock(mutex_);
+        if (pool_.size() < 2 * sweptSize_ + 64)
+        {
+            return;
+        }
+        std::erase_if(pool_, [](const auto& entry) { return entry.second.expired(); });
+        sweptSize_ = pool_.size();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard lock(mutex_);
+        return pool_.size();
+    }
+
+    /** @brief Estimated heap bytes of the pool and the effects it references. */
+    size_t memoryBytes() const
+    {
+        std::lock_guard lock(mutex_);
+        size_t bytes = 0;
+        for (const auto& [effect, shared] : pool_)
+        {
+            // The key and the shared copy (with its control block), each with its ports
+            bytes += sizeof(std::pair<RuleEffect, std::weak_ptr<const RuleEffect>>) +
+                     2 * sizeof(void*) + sizeof(RuleEffect) + 2 * sizeof(long) +
+                     2 * effect.outputPorts.capacity() * sizeof(uint32_t);
+        }
+        return bytes;
+    }
+
+  private:
+    mutable std::mutex mutex_;
+    std::unordered_map<RuleEffect, std::weak_ptr<const RuleEffect>, RuleEffectHash, RuleEffectEq>
+        pool_;
+    size_t sweptSize_ = 0;
+};
+
 // ======================================================================
 // Internal: RuleId (coreHash)
 // ======================================================================
@@ -261,18 +442,25 @@ struct RuleIdHash
     }
 };
 
+/** @brief Continue an FNV-1a hash @p h over @p n bytes. */
 static inline uint64_t
-fnv1a64(const uint8_t* data, size_t n) noexcept
+fnv1a64Append(uint64_t h, const void* data, size_t n) noexcept
 {
-    uint64_t h = 1469598103934665603ULL;
+    const auto* bytes = static_cast<const uint8_t*>(data);
     for (size_t i = 0; i < n; ++i)
     {
-        h ^= data[i];
+        h ^= bytes[i];
         h *= 1099511628211ULL;
     }
     return h;
 }
 
+static inline uint64_t
+fnv1a64(const uint8_t* data, size_t n) noexcept
+{
+    return fnv1a64Append(1469598103934665603ULL, data, n);
+}
+
 /** @brief Fingerprint rule core semantics for stable identity (coreHash). */
 static inline uint64_t
 fingerprintRuleCore(const KeyBytes& maskBytes,
@@ -322,12 +510,10 @@ struct Subtable; // forward
  * @details
  * Stores:
  * - identity: RuleId(tableId, coreHash)
- * - match: mask + maskedValue
- * - effect: RuleEffect (OUTPUT/GROUP/goto)
+ * - match: mask + maskedValue (also the key of its bucket)
+ * - effect: RuleEffect (OUTPUT/GROUP/goto), shared through EffectIntern
  *
- * Also stores placement pointers for fast removal:
- * - subtable pointer
- * - bucketKey
+ * Also stores its subtable pointer for fast removal.
  */
 struct Rule
 {
@@ -337,13 +523,12 @@ struct Rule
 
     const Mask* mask = nullptr;
     KeyBytes maskedValue{};
-    RuleEffect effect{};
+    std::shared_ptr<const RuleEffect> effect;
 
     uint64_t lastSeenEpoch = 0;
 
     // placement for fast deletion
     Subtable* subtable = nullptr;
-    KeyBytes bucketKey{};
 };
 
 /** @brief Bucket of rules that share the same (key & mask) value inside a Subtable.
@@ -366,11 +551,14 @@ struct Bucket
  * - only scan candidate rules in the matched bucket
  *
  * maxPriority enables pruning: if maxPriority is below current best, skip subtable.
+ * Removing a rule only marks it stale; the next rebuildPriorityOrderIfNeeded() recomputes
+ * it once, instead of each removal scanning every bucket.
  */
 struct Subtable
 {
     const Mask* mask = nullptr;
     int maxPriority = -1;
+    bool maxPriorityStale = false;
     std::unordered_map<KeyBytes, Bucket, KeyBytesHash> buckets;
 
     void recomputeMaxPriority()
@@ -384,6 +572,274 @@ struct Subtable
             }
         }
         maxPriority = mp;
+        maxPriorityStale = false;
+    }
+};
+
+// ======================================================================
+// Internal: compiled (read-only) lookup form of a table
+// ======================================================================
+
+/** @brief Number of 64-bit words in KeyBytes. */
+static constexpr size_t kKeyWords = kKeyBytes / sizeof(uint64_t);
+
+/** @brief Key words in lookup stage order, as in OVS: metadata, then in_port/eth_type/ip_proto,
+ * then the IPv4 addresses, then the L4 ports and VLAN.
+ */
+static constexpr std::array<uint8_t, kKeyWords> kStageOrder{3, 0, 1, 2};
+
+/** @brief KeyBytes viewed as words, for the masks of the consulted-bits bookkeeping. */
+struct CompiledKey
+{
+    std::array<uint64_t, kKeyWords> words{};
+
+    bool operator==(const CompiledKey& other) const noexcept = default;
+};
+
+static inline CompiledKey
+toCompiledKey(const KeyBytes& k) noexcept
+{
+    CompiledKey out;
+    std::memcpy(out.words.data(), k.bytes.data(), kKeyBytes);
+    return out;
+}
+
+/** @brief A masked key cut down to the bytes its subtable's mask covers, packed in stage
+ * order into @p Words words, the rest zero: 8 bytes for eth_type + ipv4_dst/24 instead of 32.
+ */
+template <size_t Words>
+struct PackedKey
+{
+    std::array<uint64_t, Words> words{};
+
+    bool operator==(const PackedKey& other) const noexcept = default;
+
+    uint8_t* bytes() noexcept
+    {
+        return reinterpret_cast<uint8_t*>(words.data());
+    }
+};
+
+template <typename Policy = utils::DefaultHashPolicy>
+struct BasicPackedKeyHash
+{
+    template <size_t Words>
+    size_t operator()(const PackedKey<Words>& k) const noexcept
+    {
+        return static_cast<size_t>(Policy::hash(k.words.data(), Words));
+    }
+};
+
+using PackedKeyHash = BasicPackedKeyHash<>;
+
+/** @brief What a lookup returns about the rule it matched. */
+struct CompiledRule
+{
+    int priority = 0;
+    const RuleEffect* effect = nullptr; // kept alive by CompiledTable::effects
+};
+
+/** @brief Immutable snapshot of a TableClassifier, laid out for lookup.
+ *
+ * @details
+ * Each subtable stores its rules under their packed keys (PackedKey): only the key bytes its
+ * mask covers, so a probe gathers and hashes those bytes alone and the slot is as wide as
+ * the subtable needs, one to four words. A probe is then one hash and (usually) one slot
+ * compare. The table shares the interned effects of the rules it can return, so it stays
+ * valid after the writer changes or frees the mutable rules it was built from.
+ *
+ * Lookup is staged like OVS: the words a subtable's mask uses are checked in kStageOrder,
+ * and after each stage but the last the packed key so far must be the prefix of some rule,
+ * or the subtable is left early. Besides saving the final probe, this keeps the bits of
+ * the later stages out of the consulted mask reported by lookupWithMask(), so callers'
+ * megaflow-style caches get wider entries.
+ */
+struct CompiledTable
+{
+    /** @brief Rules and stage prefixes of a subtable whose packed keys take @p Words words. */
+    template <size_t Words>
+    struct PackedRules
+    {
+        using Key = PackedKey<Words>;
+        // Subtables of many rules are probed by every worker: huge pages, interleaved
+        template <typename V>
+        using Map = utils::FlatHashMap<
+            Key,
+            V,
+            PackedKeyHash,
+            std::equal_to<Key>,
+            utils::PolicyAllocator<std::pair<Key, V>, utils::MemoryKind::Classifier>>;
+        using KeySet = Map<uint8_t>;
+
+        // stagePrefixes[i]: the rules' packed keys cut after stage i (later bytes zero)
+        std::vector<KeySet> stagePrefixes;
+        Map<uint32_t> rules; // index into rules
+    };
+
+    struct CompiledSubtable
+    {
+        int maxPriority = -1;
+        CompiledKey mask;
+        std::array<uint8_t, kKeyWords> stageWords{}; // word index per stage
+        size_t stageCount = 0;                       // words of mask that are not zero
+        // Key bytes the mask covers, in stage order, with their mask bytes; stage i packs
+        // gather[stageEnd[i - 1] .. stageEnd[i])
+        std::array<uint8_t, kKeyBytes> gather{};
+        std::array<uint8_t, kKeyBytes> gatherMask{};
+        std::array<uint8_t, kKeyWords> stageEnd{};
+        std::variant<PackedRules<1>, PackedRules<2>, PackedRules<3>, PackedRules<4>> keys;
+
+        /** @brief Pack the masked bytes of stage @p stage of @p key into @p out. */
+        template <size_t Words>
+        void packStage(const KeyBytes& key, size_t stage, PackedKey<Words>& out) const noexcept
+        {
+            uint8_t* bytes = out.bytes();
+            for (size_t i = stage == 0 ? 0 : stageEnd[stage - 1]; i < stageEnd[stage]; ++i)
+            {
+                bytes[i] = key.bytes[gather[i]] & gatherMask[i];
+            }
+        }
+
+        /** @brief Index of the rule of this subtable matching @p key, or nullptr.
+         *
+         * @param[out] stagesUsed Stages whose bits the answer depended on.
+         */
+        template <size_t Words>
+        const uint32_t* probe(const PackedRules<Words>& packed,
+                              const KeyBytes& key,
+                              size_t& stagesUsed) const
+        {
+            PackedKey<Words> k;
+            for (size_t stage = 0; stage < stageCount; ++stage)
+            {
+                packStage(key, stage, k);
+                if (stage + 1 < stageCount && !packed.stagePrefixes[stage].contains(k))
+                {
+                    stagesUsed = stage + 1;
+                    return nullptr;
+                }
+            }
+            stagesUsed = stageCount;
+            auto it = packed.rules.find(k);
+            return it == packed.rules.end() ? nullptr : &it->second;
+        }
+    };
+
+    std::vector<CompiledSubtable> subtables; // by descending maxPriority
+    std::vector<CompiledRule> rules;
+    std::vector<std::shared_ptr<const RuleEffect>> effects; // distinct effects of rules
+
+    /** @brief Heap bytes held by the table (slot arrays and vectors at their capacity). */
+    size_t memoryBytes() const
+    {
+        auto flatBytes = [](const auto& map) {
+            using Map = std::decay_t<decltype(map)>;
+            return map.capacity() * (sizeof(typename Map::value_type) + 1);
+        };
+        size_t bytes = sizeof(*this) + subtables.capacity() * sizeof(CompiledSubtable) +
+                       rules.capacity() * sizeof(CompiledRule) +
+                       effects.capacity() * sizeof(std::shared_ptr<const RuleEffect>);
+        for (const auto& st : subtables)
+        {
+            std::visit(
+                [&](const auto& packed) {
+                    using KeySet = typename std::decay_t<decltype(packed)>::KeySet;
+                    bytes += flatBytes(packed.rules) +
+                             packed.stagePrefixes.capacity() * sizeof(KeySet);
+                    for (const auto& prefixes : packed.stagePrefixes)
+                    {
+                        bytes += flatBytes(prefixes);
+                    }
+                },
+                st.keys);
+        }
+        return bytes;
+    }
+
+    /** @brief Highest-priority rule matching @p keyBytes, or nullptr.
+     *
+     * @param[in,out] consulted If set, OR-ed with the mask bits the result depended on.
+     */
+    const CompiledRule* lookup(const KeyBytes& keyBytes, KeyBytes* consulted) const
+    {
+        const CompiledRule* best = nullptr;
+        int bestPriority = -1;
+
+        for (const auto& st : subtables)
+        {
+            // Only a strictly higher priority can replace the current best
+            if (st.maxPriority <= bestPriority)
+            {
+                break;
+            }
+
+            size_t stagesUsed = 0;
+            const uint32_t* index = std::visit(
+                [&](const auto& packed) { return st.probe(packed, keyBytes, stagesUsed); },
+                st.keys);
+
+            if (consulted)
+            {
+                CompiledKey used = toCompiledKey(*consulted);
+                for (size_t s = 0; s < stagesUsed; ++s)
+                {
+                    used.words[st.stageWords[s]] |= st.mask.words[st.stageWords[s]];
+                }
+                std::memcpy(consulted->bytes.data(), used.words.data(), kKeyBytes);
+            }
+
+            if (index && rules[*index].priority > bestPriority)
+            {
+                best = &rules[*index];
+                bestPriority = best->priority;
+            }
+        }
+        return best;
+    }
+
+    /** @brief lookup() of every key in @p keys, one subtable at a time.
+     *
+     * @param[out] best Matched rule per key (nullptr if none); same size as @p keys.
+     *
+     * @details
+     * Walking the subtables in the outer loop keeps one subtable's gather plan and hash maps
+     * hot for the whole batch. A key leaves the batch once no remaining subtable can beat its
+     * best priority, and the walk ends when no key is left.
+     */
+    void lookupBatch(const std::vector<KeyBytes>& keys,
+                     std::vector<const CompiledRule*>& best) const
+    {
+        best.assign(keys.size(), nullptr);
+        std::vector<int> bestPriority(keys.size(), -1);
+        std::vector<uint32_t> active(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            active[i] = static_cast<uint32_t>(i);
+        }
+
+        for (const auto& st : subtables)
+        {
+            std::erase_if(active, [&](uint32_t i) { return bestPriority[i] >= st.maxPriority; });
+            if (active.empty())
+            {
+                break;
+            }
+
+            std::visit(
+                [&](const auto& packed) {
+                    for (uint32_t i : active)
+                    {
+                        size_t stagesUsed = 0;
+                        const uint32_t* index = st.probe(packed, keys[i], stagesUsed);
+                        if (index && rules[*index].priority > bestPriority[i])
+                        {
+                            best[i] = &rules[*index];
+                            bestPriority[i] = best[i]->priority;
+                        }
+                    }
+                },
+                st.keys);
+        }
     }
 };
 
@@ -392,12 +848,15 @@ struct Subtable
  * @details
  * A table contains multiple subtables (one per unique mask).
  * 'subtablesByPriority' is cached ordering to speed lookup.
+ * 'viewStale' is set when rules change and cleared once a CompiledTable of the new rules is
+ * published.
  */
 struct TableClassifier
 {
     std::unordered_map<const Mask*, std::unique_ptr<Subtable>> byMask;
     std::vector<Subtable*> subtablesByPriority;
     bool priorityOrderDirty = true;
+    bool viewStale = true;
 
     /** @brief Get existing subtable or create a new one for a mask. */
     Subtable* getOrCreateSubtable(const Mask* mask)
@@ -428,6 +887,10 @@ struct TableClassifier
         subtablesByPriority.reserve(byMask.size());
         for (auto& [m, st] : byMask)
         {
+            if (st->maxPriorityStale)
+            {
+                st->recomputeMaxPriority();
+            }
             subtablesByPriority.push_back(st.get());
         }
 
@@ -440,18 +903,44 @@ struct TableClassifier
     }
 };
 
+/** @brief One bucket of an OpenFlow group. */
+struct GroupBucket
+{
+    uint32_t weight = 0;
+    RuleEffect effect{}; // outputPorts, and groupId for a chained group
+};
+
+/** @brief One OpenFlow group, as described by the last group poll. */
+struct GroupEntry
+{
+    GroupType type = GroupType::ALL;
+    std::vector<GroupBucket> buckets;
+    uint64_t totalWeight = 0; // sum of the bucket weights
+};
+
+/** @brief Groups of one switch by group id; immutable once published. */
+using GroupTable = std::unordered_map<uint32_t, GroupEntry>;
+
 /** @brief Per-switch classifier state.
  *
  * @details
  * - stores multiple OpenFlow tables
  * - owns all rules in rulesById
  * epoch increments per polling update; used for mark-and-sweep deletion
+ * rulesVersion is the classifier-wide version of the last poll that changed the rule set
+ * rawHash is hashFlowArray() of the last poll the rules were built from; unset once a
+ * FlowDiff changed them, so the next poll is parsed in full
+ * groups and groupsHash are the last polled group table and the hash of its JSON
  */
 struct SwitchClassifier
 {
     std::unordered_map<uint8_t, TableClassifier> tables;
     std::unordered_map<RuleId, std::unique_ptr<Rule>, RuleIdHash> rulesById;
     uint64_t epoch = 0;
+    uint64_t rulesVersion = 0;
+    std::optional<uint64_t> rawHash;
+    std::shared_ptr<const GroupTable> groups = std::make_shared<const GroupTable>();
+    std::optional<uint64_t> groupsHash;
 
     TableClassifier& getTable(uint8_t tableId)
     {
@@ -459,6 +948,167 @@ struct SwitchClassifier
     }
 };
 
+/** @brief Exact-match cache of one switch's table lookups, like the OVS EMC.
+ *
+ * @details
+ * Paths are recomputed continually for long-lived flows, so most lookups repeat a full key
+ * already seen on that switch. A slot remembers, for a (table, packed key), the rule
+ * CompiledTable::lookup() returned and the mask bits it consulted, stamped with the
+ * switch's rulesVersion: a hit is one hash and one compare instead of a walk over the
+ * subtables, and a slot from another version is a miss, so publishing new rules needs no
+ * flush. The rule pointer of a slot is only returned to a reader holding the view of that
+ * version, which keeps it alive.
+ *
+ * Slots are direct-mapped (a colliding key replaces the previous one) and split over
+ * CLASSIFIER_EMC_SHARDS locks, so concurrent readers only contend on the same shard.
+ */
+class ExactMatchCache
+{
+  public:
+    explicit ExactMatchCache(size_t entries)
+    {
+        const size_t perShard = std::max<size_t>(1, entries / CLASSIFIER_EMC_SHARDS);
+        for (Shard& shard : shards_)
+        {
+            shard.slots.resize(perShard);
+        }
+    }
+
+    /** @brief Slots for a switch of @p ruleCount rules, a power of two. */
+    static size_t entriesFor(size_t ruleCount)
+    {
+        return std::clamp<size_t>(std::bit_ceil(std::max<size_t>(ruleCount, 1)),
+                                  CLASSIFIER_EMC_MIN_ENTRIES,
+                                  CLASSIFIER_EMC_MAX_ENTRIES);
+    }
+
+    size_t entries() const
+    {
+        return shards_.size() * shards_.front().slots.size();
+    }
+
+    /** @brief table.lookup(@p key, @p consulted) through the cache.
+     *
+     * @param version rulesVersion of the SwitchView @p table belongs to.
+     */
+    const CompiledRule* lookup(uint64_t version,
+                               uint8_t tableId,
+                               const CompiledTable& table,
+                               const KeyBytes& key,
+                               FlowKey* consulted)
+    {
+        PackedKey<kKeyWords> words;
+        std::memcpy(words.words.data(), key.bytes.data(), kKeyBytes);
+        const size_t h = PackedKeyHash{}(words) ^ (size_t{tableId} * 0x9E3779B97F4A7C15ULL);
+        Shard& shard = shards_[h % CLASSIFIER_EMC_SHARDS];
+        Slot& slot = shard.slots[(h / CLASSIFIER_EMC_SHARDS) % shard.slots.size()];
+
+        const CompiledRule* rule = nullptr;
+        KeyBytes used;
+        bool hit = false;
+        {
+            std::lock_guard lock(shard.mutex);
+            hit = slot.version == version && slot.tableId == tableId && slot.key == key;
+            if (hit)
+            {
+                rule = slot.rule;
+                used = slot.consulted;
+                ++shard.hits;
+            }
+            else
+            {
+                ++shard.misses;
+            }
+        }
+        if (!hit)
+        {
+            rule = table.lookup(key, &used);
+            std::lock_guard lock(shard.mutex);
+            slot = Slot{version, tableId, key, used, rule};
+        }
+        if (consulted)
+        {
+            orUnpackedMask(used, *consulted);
+        }
+        return rule;
+    }
+
+    /** @brief Hit and miss counts since the cache was created. */
+    std::pair<uint64_t, uint64_t> counters() const
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        for (const Shard& shard : shards_)
+        {
+            std::lock_guard lock(shard.mutex);
+            hits += shard.hits;
+            misses += shard.misses;
+        }
+        return {hits, misses};
+    }
+
+    /** @brief Bytes of the slots. */
+    size_t memoryBytes() const
+    {
+        return entries() * sizeof(Slot);
+    }
+
+  private:
+    struct Slot
+    {
+        uint64_t version = 0; // 0: empty (published switches start at 1)
+        uint8_t tableId = 0;
+        KeyBytes key;
+        KeyBytes consulted;
+        const CompiledRule* rule = nullptr; // nullptr: the key matched no rule
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::vector<Slot> slots;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    std::array<Shard, CLASSIFIER_EMC_SHARDS> shards_;
+};
+
+/** @brief Published, immutable state of one switch: what lookups of that switch read.
+ *
+ * @details
+ * The exact-match cache is the only mutable part; it carries over to the switch's next
+ * view while the rule count keeps its size.
+ */
+struct SwitchView
+{
+    uint64_t rulesVersion = 0;
+    size_t ruleCount = 0;
+    std::unordered_map<uint8_t, std::shared_ptr<const CompiledTable>> tables;
+    std::shared_ptr<const GroupTable> groups;
+    std::shared_ptr<ExactMatchCache> emc;
+
+    /** @brief Highest-priority rule of table @p tableId matching @p key, or nullptr. */
+    const CompiledRule* lookup(uint8_t tableId, const KeyBytes& key, FlowKey* consulted) const
+    {
+        auto it = tables.find(tableId);
+        return it == tables.end() ? nullptr
+                                  : emc->lookup(rulesVersion, tableId, *it->second, key, consulted);
+    }
+};
+
+/** @brief Published, immutable state of the whole classifier.
+ *
+ * @details
+ * Each update publishes a new view (read-copy-update): switches the update did not change
+ * keep their SwitchView, and changed switches keep the CompiledTable of every table whose
+ * rules stayed the same. A view is freed once no reader holds it any more.
+ */
+struct ClassifierView
+{
+    std::unordered_map<uint64_t, std::shared_ptr<const SwitchView>> switches;
+};
+
 // ======================================================================
 // Internal: JSON + match parsing (supports masks for IPv4)
 // ======================================================================
@@ -514,7 +1164,7 @@ parseI32(const nlohmann::json& j)
     throw std::runtime_error("parseI32: unsupported json type");
 }
 
-/** @brief Extract the flow entry array from either supported JSON shape. */
+/** @brief Extract the flow (or group) entry array from either supported JSON shape. */
 static const nlohmann::json*
 extractFlowArray(const nlohmann::json& flowsNode, uint64_t dpid)
 {
@@ -648,49 +1298,22 @@ setU16MaskAll(KeyBytes& mb, size_t off)
     mb.bytes[off + 1] |= 0xFF;
 }
 
-/** @brief Build packed mask bytes and FlowKey value from a rule's "match" object.
+/** @brief Apply one match field of a rule to its packed mask bytes and FlowKey value.
  *
  * @details
  * - Converts supported match fields into FlowKey fields
- * - Computes cooresponding mask bytes (including IPv4 prefix masks)
+ * - Sets the cooresponding mask bytes (including IPv4 prefix masks)
  * - Leaves unsupported fields ignored (mask bits remain 0)
+ * OpenFlow 1.0 and 1.3 names of a field (dl_type/eth_type, ...) are treated alike.
  */
 static void
-buildMaskAndValueFromMatch(const nlohmann::json& match, KeyBytes& outMaskBytes, FlowKey& outValue)
+applyMatchField(const std::string& field,
+                const nlohmann::json& v,
+                KeyBytes& outMaskBytes,
+                FlowKey& outValue)
 {
-    outMaskBytes = KeyBytes{};
-    outValue = FlowKey{};
-
-    if (match.contains("in_port"))
-    {
-        outValue.inPort = static_cast<uint32_t>(parseU64(match.at("in_port")));
-        setU32MaskAll(outMaskBytes, 0);
-    }
-
-    if (match.contains("eth_type"))
-    {
-        outValue.ethType = static_cast<uint16_t>(parseU64(match.at("eth_type")));
-        setU16MaskAll(outMaskBytes, 4);
-    }
-    else if (match.contains("dl_type"))
-    {
-        outValue.ethType = static_cast<uint16_t>(parseU64(match.at("dl_type")));
-        setU16MaskAll(outMaskBytes, 4);
-    }
-
-    if (match.contains("ip_proto"))
-    {
-        outValue.ipProto = static_cast<uint8_t>(parseU64(match.at("ip_proto")));
-        outMaskBytes.bytes[6] |= 0xFF;
-    }
-    else if (match.contains("nw_proto"))
-    {
-        outValue.ipProto = static_cast<uint8_t>(parseU64(match.at("nw_proto")));
-        outMaskBytes.bytes[6] |= 0xFF;
-    }
-
-    auto applyIpv4Masked = [&](bool isSrc, const nlohmann::json& j) {
-        auto p = parseIpv4WithMaskOrPrefix(j);
+    auto applyIpv4Masked = [&](bool isSrc) {
+        auto p = parseIpv4WithMaskOrPrefix(v);
         if (!p)
         {
             return;
@@ -716,67 +1339,47 @@ buildMaskAndValueFromMatch(const nlohmann::json& match, KeyBytes& outMaskBytes,
         }
     };
 
-    if (match.contains("ipv4_src"))
-    {
-        applyIpv4Masked(true, match.at("ipv4_src"));
-    }
-    else if (match.contains("nw_src"))
-    {
-        applyIpv4Masked(true, match.at("nw_src"));
-    }
-
-    if (match.contains("ipv4_dst"))
-    {
-        applyIpv4Masked(false, match.at("ipv4_dst"));
-    }
-    else if (match.contains("nw_dst"))
+    if (field == "in_port")
     {
-        applyIpv4Masked(false, match.at("nw_dst"));
+        outValue.inPort = static_cast<uint32_t>(parseU64(v));
+        setU32MaskAll(outMaskBytes, 0);
     }
-
-    auto setTpSrc = [&](const nlohmann::json& v) {
-        outValue.tpSrc = static_cast<uint16_t>(parseU64(v));
-        setU16MaskAll(outMaskBytes, 16);
-    };
-    auto setTpDst = [&](const nlohmann::json& v) {
-        outValue.tpDst = static_cast<uint16_t>(parseU64(v));
-        setU16MaskAll(outMaskBytes, 18);
-    };
-
-    if (match.contains("tcp_src"))
+    else if (field == "eth_type" || field == "dl_type")
     {
-        setTpSrc(match.at("tcp_src"));
+        outValue.ethType = static_cast<uint16_t>(parseU64(v));
+        setU16MaskAll(outMaskBytes, 4);
     }
-    if (match.contains("tcp_dst"))
+    else if (field == "ip_proto" || field == "nw_proto")
     {
-        setTpDst(match.at("tcp_dst"));
+        outValue.ipProto = static_cast<uint8_t>(parseU64(v));
+        outMaskBytes.bytes[6] |= 0xFF;
     }
-    if (match.contains("udp_src"))
+    else if (field == "ipv4_src" || field == "nw_src")
     {
-        setTpSrc(match.at("udp_src"));
+        applyIpv4Masked(true);
     }
-    if (match.contains("udp_dst"))
+    else if (field == "ipv4_dst" || field == "nw_dst")
     {
-        setTpDst(match.at("udp_dst"));
+        applyIpv4Masked(false);
     }
-    if (match.contains("tp_src"))
+    else if (field == "tcp_src" || field == "udp_src" || field == "tp_src")
     {
-        setTpSrc(match.at("tp_src"));
+        outValue.tpSrc = static_cast<uint16_t>(parseU64(v));
+        setU16MaskAll(outMaskBytes, 16);
     }
-    if (match.contains("tp_dst"))
+    else if (field == "tcp_dst" || field == "udp_dst" || field == "tp_dst")
     {
-        setTpDst(match.at("tp_dst"));
+        outValue.tpDst = static_cast<uint16_t>(parseU64(v));
+        setU16MaskAll(outMaskBytes, 18);
     }
-
-    if (match.contains("vlan_vid"))
+    else if (field == "vlan_vid")
     {
-        outValue.vlanTci = static_cast<uint16_t>(parseU64(match.at("vlan_id")));
+        outValue.vlanTci = static_cast<uint16_t>(parseU64(v));
         setU16MaskAll(outMaskBytes, 20);
     }
-
-    if (match.contains("metadata"))
+    else if (field == "metadata")
     {
-        outValue.metadata = parseU64(match.at("metadata"));
+        outValue.metadata = parseU64(v);
         for (int i = 0; i < 8; ++i)
         {
             outMaskBytes.bytes[24 + i] = 0xFF;
@@ -784,6 +1387,18 @@ buildMaskAndValueFromMatch(const nlohmann::json& match, KeyBytes& outMaskBytes,
     }
 }
 
+/** @brief Build packed mask bytes and FlowKey value from a rule's "match" object. */
+static void
+buildMaskAndValueFromMatch(const nlohmann::json& match, KeyBytes& outMaskBytes, FlowKey& outValue)
+{
+    outMaskBytes = KeyBytes{};
+    outValue = FlowKey{};
+    for (const auto& [field, v] : match.items())
+    {
+        applyMatchField(field, v, outMaskBytes, outValue);
+    }
+}
+
 static inline std::string
 toUpper(std::string s)
 {
@@ -815,12 +1430,85 @@ parseUint(const std::string& s, uint32_t& out)
     return true;
 }
 
-/** @brief Parse an actions array into RuleEffect.
+/** @brief Parse one string action into RuleEffect.
  *
  * @details
- * Supports string actions like "OUTPUT:1" and "GROUP:10".
+ * Supports actions like "OUTPUT:1", "GROUP:10" and "GOTO_TABLE:1"; others are ignored.
  */
 static void
+parseActionString(const std::string& s, RuleEffect& effect)
+{
+    auto colon = s.find(':');
+    std::string kind = (colon == std::string::npos) ? s : s.substr(0, colon);
+    std::string rest = (colon == std::string::npos) ? "" : s.substr(colon + 1);
+
+    kind = toUpper(kind);
+
+    if (kind == "OUTPUT" && !rest.empty())
+    {
+        // rest might be:
+        // "1"
+        // "CONTROLLER"
+        // "CONTROLLER:65535"
+        // "LOCAL" / "FLOOD" / "NORMAL" ...
+
+        auto colon2 = rest.find(':');
+        std::string portStr = (colon2 == std::string::npos) ? rest : rest.substr(0, colon2);
+        portStr = toUpper(portStr);
+
+        // OpenFlow reserved ports (store as uint32_t constants)
+        constexpr uint32_t OFPP_CONTROLLER = 65535;
+        constexpr uint32_t OFPP_LOCAL = 65535;
+        // constexpr uint32_t OFPP_ANY = 65535;
+        constexpr uint32_t OFPP_FLOOD = 65535;
+        constexpr uint32_t OFPP_NORMAL = 65535;
+
+        uint32_t port = 0;
+        if (portStr == "CONTROLLER")
+        {
+            port = OFPP_CONTROLLER;
+        }
+        else if (portStr == "LOCAL")
+        {
+            port = OFPP_LOCAL;
+        }
+        else if (portStr == "FLOOD")
+        {
+            port = OFPP_FLOOD;
+        }
+        else if (portStr == "NORMAL")
+        {
+            port = OFPP_NORMAL;
+        }
+        else if (!parseUint(portStr, port))
+        {
+            // unknown OUTPUT target -> skip
+            return;
+        }
+
+        effect.outputPorts.push_back(port);
+    }
+    else if (kind == "GROUP" && !rest.empty())
+    {
+        uint32_t gid = 0;
+        if (parseUint(rest, gid))
+        {
+            effect.groupId = gid;
+        }
+    }
+    else if (kind == "GOTO_TABLE" && !rest.empty())
+    {
+        // Ryu's OF1.3 flow stats list instructions among the actions
+        uint32_t table = 0;
+        if (parseUint(rest, table) && table <= 0xFF)
+        {
+            effect.gotoTable = static_cast<uint8_t>(table);
+        }
+    }
+}
+
+/** @brief Parse an actions array into RuleEffect (see parseActionString()). */
+static void
 parseActionsArrayIntoEffect(const nlohmann::json& actions, RuleEffect& effect)
 {
     if (!actions.is_array())
@@ -832,65 +1520,25 @@ parseActionsArrayIntoEffect(const nlohmann::json& actions, RuleEffect& effect)
     {
         if (a.is_string())
         {
-            std::string s = a.get<std::string>();
-            auto colon = s.find(':');
-            std::string kind = (colon == std::string::npos) ? s : s.substr(0, colon);
-            std::string rest = (colon == std::string::npos) ? "" : s.substr(colon + 1);
-
-            kind = toUpper(kind);
-
-            if (kind == "OUTPUT" && !rest.empty())
-            {
-                // rest might be:
-                // "1"
-                // "CONTROLLER"
-                // "CONTROLLER:65535"
-                // "LOCAL" / "FLOOD" / "NORMAL" ...
-
-                auto colon2 = rest.find(':');
-                std::string portStr = (colon2 == std::string::npos) ? rest : rest.substr(0, colon2);
-                portStr = toUpper(portStr);
-
-                // OpenFlow reserved ports (store as uint32_t constants)
-                constexpr uint32_t OFPP_CONTROLLER = 65535;
-                constexpr uint32_t OFPP_LOCAL = 65535;
-                // constexpr uint32_t OFPP_ANY = 65535;
-                constexpr uint32_t OFPP_FLOOD = 65535;
-                constexpr uint32_t OFPP_NORMAL = 65535;
-
-                uint32_t port = 0;
-                if (portStr == "CONTROLLER")
-                {
-                    port = OFPP_CONTROLLER;
-                }
-                else if (portStr == "LOCAL")
-                {
-                    port = OFPP_LOCAL;
-                }
-                else if (portStr == "FLOOD")
-                {
-                    port = OFPP_FLOOD;
-                }
-                else if (portStr == "NORMAL")
-                {
-                    port = OFPP_NORMAL;
-                }
-                else if (!parseUint(portStr, port))
-                {
-                    // unknown OUTPUT target -> skip
-                    continue;
-                }
-
-                effect.outputPorts.push_back(port);
-            }
-            else if (kind == "GROUP" && !rest.empty())
+            parseActionString(a.get_ref<const std::string&>(), effect);
+        }
+        else if (a.is_object() && a.contains("type") && a.at("type").is_string())
+        {
+            // Ryu's flow-mod form, e.g. {"type": "OUTPUT", "port": 1}
+            const std::string& type = a.at("type").get_ref<const std::string&>();
+            const char* argument = type == "OUTPUT"       ? "port"
+                                   : type == "GROUP"      ? "group_id"
+                                   : type == "GOTO_TABLE" ? "table_id"
+                                                          : nullptr;
+            if (!argument || !a.contains(argument))
             {
-                uint32_t gid = 0;
-                if (parseUint(rest, gid))
-                {
-                    effect.groupId = gid;
-                }
+                parseActionString(type, effect);
+                continue;
             }
+            const auto& value = a.at(argument);
+            parseActionString(type + ":" +
+                                  (value.is_string() ? value.get<std::string>() : value.dump()),
+                              effect);
         }
     }
 }
@@ -935,139 +1583,796 @@ parseEffectFromFlowEntry(const nlohmann::json& flow)
 }
 
 // ======================================================================
-// Impl: update + lookup algorithms
+// Internal: poll fingerprint (fast path for unchanged tables)
 // ======================================================================
 
-/** @brief Hidden implementation.
+/** @brief Flow entry fields that move with traffic or time while the rule stays the same. */
+static bool
+isFlowCounterField(const std::string& key)
+{
+    return key == "byte_count" || key == "packet_count" || key == "duration_sec" ||
+           key == "duration_nsec" || key == "idle_age" || key == "hard_age";
+}
+
+/** @brief Continue FNV-1a hash @p h over a JSON value (type, content and object keys). */
+static uint64_t
+hashJsonValue(uint64_t h, const nlohmann::json& j)
+{
+    const auto type = static_cast<uint8_t>(j.type());
+    h = fnv1a64Append(h, &type, sizeof(type));
+    switch (j.type())
+    {
+    case nlohmann::json::value_t::object:
+        for (const auto& [key, value] : j.items())
+        {
+            h = fnv1a64Append(h, key.data(), key.size() + 1);
+            h = hashJsonValue(h, value);
+        }
+        break;
+    case nlohmann::json::value_t::array:
+        for (const auto& value : j)
+        {
+            h = hashJsonValue(h, value);
+        }
+        h = fnv1a64Append(h, &type, sizeof(type)); // closes the array
+        break;
+    case nlohmann::json::value_t::string:
+    {
+        const auto& str = j.get_ref<const std::string&>();
+        h = fnv1a64Append(h, str.data(), str.size() + 1);
+        break;
+    }
+    case nlohmann::json::value_t::number_integer:
+    case nlohmann::json::value_t::number_unsigned:
+    {
+        const uint64_t v = j.get<uint64_t>();
+        h = fnv1a64Append(h, &v, sizeof(v));
+        break;
+    }
+    case nlohmann::json::value_t::number_float:
+    {
+        const double v = j.get<double>();
+        h = fnv1a64Append(h, &v, sizeof(v));
+        break;
+    }
+    case nlohmann::json::value_t::boolean:
+    {
+        const uint8_t v = j.get<bool>() ? 1 : 0;
+        h = fnv1a64Append(h, &v, sizeof(v));
+        break;
+    }
+    default:
+        break;
+    }
+    return h;
+}
+
+/** @brief Fingerprint of a polled flow array, ignoring the counter fields of each entry.
  *
  * @details
- * Holds:
- * - global lock (shared_mutex)
- * - per-switch classifier state
- * - mask interning pool
- *
- * Update path:
- * - updateFromQueriedTables() takes unique _lock and calls updateOneSwitch()
- * - updateOneSwitch() increments epoch, upserts rules, then sweeps unseen rules
- *
- * Lookup path:
- * - lookup() takes shared_mutex and runs lookupInTableNoLock()
+ * Two polls with the same fingerprint list the same rules in the same order, so the second
+ * one can skip parsing. Entries reported in a different order only cost a full update.
  */
-struct Classifier::Impl
+static uint64_t
+hashFlowArray(const nlohmann::json& flowArray)
 {
-    mutable std::shared_mutex mutex;
-    MaskIntern maskIntern;
-    std::unordered_map<uint64_t, SwitchClassifier> switches;
-
-    /** @brief Parsed rule extracted from JSON before being inserted. */
-    struct ParsedRule
+    uint64_t h = 1469598103934665603ULL;
+    for (const auto& flow : flowArray)
     {
-        RuleId id{};
-        uint8_t tableId = 0;
-        int priority = 0;
-        const Mask* mask = nullptr;
-        KeyBytes maskedValue{};
-        RuleEffect effect{};
-    };
+        if (!flow.is_object())
+        {
+            h = hashJsonValue(h, flow);
+            continue;
+        }
+        for (const auto& [key, value] : flow.items())
+        {
+            if (isFlowCounterField(key))
+            {
+                continue;
+            }
+            h = fnv1a64Append(h, key.data(), key.size() + 1);
+            h = hashJsonValue(h, value);
+        }
+        const uint8_t endOfFlow = 0xFF;
+        h = fnv1a64Append(h, &endOfFlow, sizeof(endOfFlow));
+    }
+    return h;
+}
 
-    ParsedRule parseRuleFromJson(const nlohmann::json& flow)
-    {
-        ParsedRule pr;
+// ======================================================================
+// Internal: streaming parse of polled flow stats (no DOM)
+// ======================================================================
 
-        pr.tableId =
-            flow.contains("table_id") ? static_cast<uint8_t>(parseU64(flow.at("table_id"))) : 0;
+/** @brief Fields of one polled flow entry, before its mask is interned. */
+struct PolledRule
+{
+    uint8_t tableId = 0;
+    int priority = 0;
+    KeyBytes maskBytes{};
+    FlowKey value{};
+    RuleEffect effect{};
+};
 
-        pr.priority = flow.contains("priority") ? parseI32(flow.at("priority")) : 0;
+/** @brief SAX handler reading a Ryu /stats/flow/<dpid> response without building a DOM.
+ *
+ * @details
+ * Accepts {"<dpid>": [flow, ...]} or a bare [flow, ...]. It fingerprints the entries like
+ * hashFlowArray() does, counters excluded, but in the key order of the text, so the two
+ * fingerprints are not interchangeable. Given a vector, it also appends the PolledRule of
+ * every entry, read from "table_id", "priority", "match", "actions" and "instructions"
+ * the way parseRuleFromJson() reads them.
+ */
+class FlowStatsSax final : public nlohmann::json_sax<nlohmann::json>
+{
+  public:
+    explicit FlowStatsSax(std::vector<PolledRule>* rules)
+        : m_rules(rules)
+    {
+    }
 
-        KeyBytes maskBytes{};
-        FlowKey value{};
-        if (flow.contains("match") && flow.at("match").is_object())
-        {
-            buildMaskAndValueFromMatch(flow.at("match"), maskBytes, value);
-        }
+    uint64_t hash() const
+    {
+        return m_hash;
+    }
 
-        pr.mask = maskIntern.interMask(maskBytes);
+    size_t flowCount() const
+    {
+        return m_flowCount;
+    }
 
-        KeyBytes valueBytes = packKey(value);
-        pr.maskedValue = bitAnd(valueBytes, pr.mask->bytes);
+    bool null() override
+    {
+        return scalar(nlohmann::json());
+    }
 
-        pr.effect = parseEffectFromFlowEntry(flow);
+    bool boolean(bool val) override
+    {
+        return scalar(nlohmann::json(val));
+    }
 
-        pr.id = RuleId{pr.tableId,
-                       fingerprintRuleCore(pr.mask->bytes, pr.maskedValue, pr.priority, pr.effect)};
-        return pr;
+    bool number_integer(number_integer_t val) override
+    {
+        return scalar(nlohmann::json(val));
     }
 
-    /** @brief Insert a new rule into the OVS-like structure (subtable + bucket). */
-    void insertRuleIntoTables(SwitchClassifier& sw, Rule* r)
+    bool number_unsigned(number_unsigned_t val) override
     {
-        TableClassifier& tc = sw.getTable(r->tableId);
-        Subtable* st = tc.getOrCreateSubtable(r->mask);
+        return scalar(nlohmann::json(val));
+    }
 
-        KeyBytes bucketKey = r->maskedValue;
-        Bucket& bucket = st->buckets[bucketKey];
+    bool number_float(number_float_t val, const string_t& /*s*/) override
+    {
+        return scalar(nlohmann::json(val));
+    }
 
-        auto pos = std::lower_bound(
-            bucket.rules.begin(),
-            bucket.rules.end(),
-            r,
-            [](const Rule* a, const Rule* x) { return a->priority > x->priority; });
+    bool string(string_t& val) override
+    {
+        return scalar(nlohmann::json(std::move(val)));
+    }
 
-        bucket.rules.insert(pos, r);
+    bool binary(binary_t& /*val*/) override
+    {
+        return true;
+    }
 
-        r->subtable = st;
-        r->bucketKey = bucketKey;
+    bool start_object(std::size_t /*elements*/) override
+    {
+        return start(true);
+    }
 
-        if (!bucket.rules.empty())
+    bool key(string_t& val) override
+    {
+        Frame& top = m_frames.back();
+        m_skipValue = top.role == Role::Flow && isFlowCounterField(val);
+        if (!m_skipValue)
         {
-            st->maxPriority = std::max(st->maxPriority, bucket.rules.front()->priority);
+            m_hash = fnv1a64Append(m_hash, val.data(), val.size() + 1);
         }
-        tc.priorityOrderDirty = true;
+        top.key = std::move(val);
+        return true;
     }
 
-    /** @brief Remove a rule quickly using its stored placement info. */
-    void removeRuleFromTables(SwitchClassifier& sw, Rule* r)
+    bool end_object() override
     {
-        if (!r->subtable)
-        {
-            return;
-        }
+        return end();
+    }
 
-        Subtable* st = r->subtable;
-        auto it = st->buckets.find(r->bucketKey);
-        if (it != st->buckets.end())
-        {
-            auto& vec = it->second.rules;
-            auto vit = std::find(vec.begin(), vec.end(), r);
-            if (vit != vec.end())
-            {
-                vec.erase(vit);
-                if (vec.empty())
-                {
-                    st->buckets.erase(it);
-                }
-            }
-        }
+    bool start_array(std::size_t /*elements*/) override
+    {
+        return start(false);
+    }
 
-        st->recomputeMaxPriority();
-        sw.tables[r->tableId].priorityOrderDirty = true;
+    bool end_array() override
+    {
+        return end();
+    }
 
-        r->subtable = nullptr;
-        r->bucketKey = KeyBytes{};
+    bool parse_error(std::size_t /*position*/,
+                     const std::string& /*last_token*/,
+                     const nlohmann::detail::exception& /*ex*/) override
+    {
+        return false;
     }
 
-    /** @brief Insert a rule if new, or mark it as seen if it already exists. */
-    void upsertRule(SwitchClassifier& sw, const ParsedRule& pr)
+  private:
+    enum class Role : uint8_t
+    {
+        Root,               // {"<dpid>": ...}
+        FlowArray,          // [flow, ...]
+        Flow,               // one flow entry
+        Match,              // its "match"
+        Actions,            // its "actions"
+        Instructions,       // its "instructions"
+        Instruction,        // one of them
+        InstructionActions, // the "actions" of an instruction
+        Other,
+    };
+
+    struct Frame
     {
-        SPDLOG_LOGGER_TRACE(Logger::instance(),
-                            "tableId {} priority {} effect(output port) {} maskedValue {}",
-                            std::to_string(pr.tableId),
-                            std::to_string(pr.priority),
-                            std::to_string(pr.effect.outputPorts.front()),
-                            spdlog::to_hex(pr.maskedValue.bytes));
+        Role role = Role::Other;
+        bool isObject = false;
+        std::string key; // last key seen, for objects
+    };
 
-        auto it = sw.rulesById.find(pr.id);
-        if (it == sw.rulesById.end())
+    Role childRole(bool isObject) const
+    {
+        if (m_frames.empty())
+        {
+            return isObject ? Role::Root : Role::FlowArray;
+        }
+        const Frame& parent = m_frames.back();
+        switch (parent.role)
+        {
+        case Role::Root:
+            return isObject ? Role::Other : Role::FlowArray;
+        case Role::FlowArray:
+            return isObject ? Role::Flow : Role::Other;
+        case Role::Flow:
+            if (parent.key == "match" && isObject)
+            {
+                return Role::Match;
+            }
+            if (parent.key == "actions" && !isObject)
+            {
+                return Role::Actions;
+            }
+            if (parent.key == "instructions" && !isObject)
+            {
+                return Role::Instructions;
+            }
+            return Role::Other;
+        case Role::Instructions:
+            return isObject ? Role::Instruction : Role::Other;
+        case Role::Instruction:
+            return parent.key == "actions" && !isObject ? Role::InstructionActions : Role::Other;
+        default:
+            return Role::Other;
+        }
+    }
+
+    bool start(bool isObject)
+    {
+        const uint8_t tag = isObject ? '{' : '[';
+        m_hash = fnv1a64Append(m_hash, &tag, sizeof(tag));
+        m_skipValue = false;
+        const Role role = childRole(isObject);
+        if (role == Role::Flow && m_rules)
+        {
+            m_rules->emplace_back();
+        }
+        else if (role == Role::Instruction)
+        {
+            m_instructionType.clear();
+            m_instructionTable.reset();
+        }
+        m_frames.push_back(Frame{role, isObject, {}});
+        return true;
+    }
+
+    bool end()
+    {
+        const uint8_t tag = m_frames.back().isObject ? '}' : ']';
+        m_hash = fnv1a64Append(m_hash, &tag, sizeof(tag));
+        const Role role = m_frames.back().role;
+        m_frames.pop_back();
+        if (role == Role::Flow)
+        {
+            ++m_flowCount;
+        }
+        else if (role == Role::Instruction && m_rules && m_instructionTable &&
+                 toUpper(m_instructionType) == "GOTO_TABLE")
+        {
+            m_rules->back().effect.gotoTable = static_cast<uint8_t>(*m_instructionTable);
+        }
+        return true;
+    }
+
+    bool scalar(nlohmann::json&& v)
+    {
+        if (std::exchange(m_skipValue, false))
+        {
+            return true;
+        }
+        m_hash = hashJsonValue(m_hash, v);
+        if (!m_rules || m_frames.empty())
+        {
+            return true;
+        }
+
+        const Frame& top = m_frames.back();
+        switch (top.role)
+        {
+        case Role::Flow:
+            if (top.key == "table_id")
+            {
+                m_rules->back().tableId = static_cast<uint8_t>(parseU64(v));
+            }
+            else if (top.key == "priority")
+            {
+                m_rules->back().priority = parseI32(v);
+            }
+            break;
+        case Role::Match:
+            applyMatchField(top.key, v, m_rules->back().maskBytes, m_rules->back().value);
+            break;
+        case Role::Actions:
+        case Role::InstructionActions:
+            if (v.is_string())
+            {
+                parseActionString(v.get_ref<const std::string&>(), m_rules->back().effect);
+            }
+            break;
+        case Role::Instruction:
+            if (top.key == "type" && v.is_string())
+            {
+                m_instructionType = v.get<std::string>();
+            }
+            else if (top.key == "table_id")
+            {
+                m_instructionTable = parseU64(v);
+            }
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+    std::vector<PolledRule>* m_rules;
+    std::vector<Frame> m_frames;
+    uint64_t m_hash = 1469598103934665603ULL;
+    size_t m_flowCount = 0;
+    bool m_skipValue = false; // the next value belongs to a counter field
+    std::string m_instructionType;
+    std::optional<uint64_t> m_instructionTable;
+};
+
+// ======================================================================
+// Internal: group descriptions + resolution
+// ======================================================================
+
+/** @brief Group type from its name ("SELECT", "FF", ...) or ofp_group_type number. */
+static std::optional<GroupType>
+parseGroupType(const nlohmann::json& j)
+{
+    if (j.is_number_unsigned() || j.is_number_integer())
+    {
+        switch (j.get<int64_t>())
+        {
+        case 0:
+            return GroupType::ALL;
+        case 1:
+            return GroupType::SELECT;
+        case 2:
+            return GroupType::INDIRECT;
+        case 3:
+            return GroupType::FAST_FAILOVER;
+        default:
+            return std::nullopt;
+        }
+    }
+    if (!j.is_string())
+    {
+        return std::nullopt;
+    }
+    const std::string t = toUpper(j.get<std::string>());
+    if (t == "ALL")
+    {
+        return GroupType::ALL;
+    }
+    if (t == "SELECT")
+    {
+        return GroupType::SELECT;
+    }
+    if (t == "INDIRECT")
+    {
+        return GroupType::INDIRECT;
+    }
+    if (t == "FF" || t == "FAST_FAILOVER")
+    {
+        return GroupType::FAST_FAILOVER;
+    }
+    return std::nullopt;
+}
+
+/** @brief Parse a group description array into a GroupTable, skipping malformed entries. */
+static GroupTable
+parseGroupTable(const nlohmann::json& groupArray)
+{
+    GroupTable groups;
+    for (const auto& g : groupArray)
+    {
+        if (!g.is_object() || !g.contains("group_id") || !g.contains("type"))
+        {
+            continue;
+        }
+        auto type = parseGroupType(g.at("type"));
+        if (!type)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "unsupported group type {}",
+                               g.at("type").dump());
+            continue;
+        }
+
+        GroupEntry entry;
+        entry.type = *type;
+        if (g.contains("buckets") && g.at("buckets").is_array())
+        {
+            for (const auto& b : g.at("buckets"))
+            {
+                GroupBucket bucket;
+                bucket.weight =
+                    b.contains("weight") ? static_cast<uint32_t>(parseU64(b.at("weight"))) : 0;
+                if (b.contains("actions"))
+                {
+                    parseActionsArrayIntoEffect(b.at("actions"), bucket.effect);
+                }
+                entry.totalWeight += bucket.weight;
+                entry.buckets.push_back(std::move(bucket));
+            }
+        }
+        groups.insert_or_assign(static_cast<uint32_t>(parseU64(g.at("group_id"))),
+                                std::move(entry));
+    }
+    return groups;
+}
+
+/** @brief SELECT bucket for a flow with ecmpFlowHash() @p flowHash, or nullptr if none.
+ *
+ * @details
+ * The hash picks a point in [0, totalWeight) and the bucket covering it wins, so with equal
+ * weights bucket (flowHash % bucket count) is chosen, as selectEcmpMember() does. A group
+ * whose weights are all 0 is treated as equally weighted.
+ */
+static const GroupBucket*
+selectBucket(const GroupEntry& group, uint64_t flowHash)
+{
+    if (group.buckets.empty())
+    {
+        return nullptr;
+    }
+    if (group.totalWeight == 0)
+    {
+        return &group.buckets[flowHash % group.buckets.size()];
+    }
+    uint64_t point = flowHash % group.totalWeight;
+    for (const auto& bucket : group.buckets)
+    {
+        if (point < bucket.weight)
+        {
+            return &bucket;
+        }
+        point -= bucket.weight;
+    }
+    return &group.buckets.back();
+}
+
+static constexpr int kMaxGroupChain = 8; // groups a bucket may chain through
+
+/** @brief Execute group @p groupId of @p groups for @p key, appending to @p out.
+ *
+ * @param[in,out] consulted If not null, gets the 5-tuple fields when a SELECT bucket is
+ *        chosen by hash.
+ */
+static void
+resolveGroup(const GroupTable& groups,
+             uint32_t groupId,
+             const FlowKey& key,
+             PipelineEffect& out,
+             FlowKey* consulted,
+             int depth)
+{
+    auto it = groups.find(groupId);
+    if (it == groups.end() || depth >= kMaxGroupChain)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(), "group {} not resolved", groupId);
+        out.unresolvedGroup = true;
+        return;
+    }
+    out.groups.push_back(groupId);
+
+    const GroupEntry& group = it->second;
+    auto execute = [&](const GroupBucket& bucket) {
+        out.outputPorts.insert(out.outputPorts.end(),
+                               bucket.effect.outputPorts.begin(),
+                               bucket.effect.outputPorts.end());
+        if (bucket.effect.groupId)
+        {
+            resolveGroup(groups, *bucket.effect.groupId, key, out, consulted, depth + 1);
+        }
+    };
+
+    switch (group.type)
+    {
+    case GroupType::ALL:
+        for (const auto& bucket : group.buckets)
+        {
+            execute(bucket);
+        }
+        break;
+    case GroupType::SELECT:
+    {
+        const uint64_t flowHash =
+            ecmpFlowHash(key.ipv4Src, key.ipv4Dst, key.ipProto, key.tpSrc, key.tpDst);
+        if (consulted)
+        {
+            consulted->ipv4Src = ~0u;
+            consulted->ipv4Dst = ~0u;
+            consulted->ipProto = 0xFF;
+            consulted->tpSrc = 0xFFFF;
+            consulted->tpDst = 0xFFFF;
+        }
+        if (const GroupBucket* bucket = selectBucket(group, flowHash))
+        {
+            execute(*bucket);
+        }
+        break;
+    }
+    case GroupType::INDIRECT:
+    case GroupType::FAST_FAILOVER:
+        if (!group.buckets.empty())
+        {
+            execute(group.buckets.front());
+        }
+        break;
+    }
+}
+
+// ======================================================================
+// Impl: update + lookup algorithms
+// ======================================================================
+
+/** @brief Hidden implementation.
+ *
+ * @details
+ * Holds:
+ * - the writer's lock (updateMutex)
+ * - per-switch classifier state, only touched by the writer
+ * - mask interning pool
+ * - the published ClassifierView lookups read
+ *
+ * Update path:
+ * - updateFromQueriedTables() takes updateMutex and calls updateOneSwitch() for each
+ *   switch, the switches in parallel (forEachParallel()): a switch's update only touches its
+ *   own SwitchClassifier, the thread-safe interning pools and atomic counters
+ * - updateOneSwitch() returns early if the poll hashes like the last one; otherwise
+ *   replaceRules() increments epoch, upserts rules, then sweeps unseen rules
+ * - updateFromFlowStatsText() does the same per raw response through
+ *   updateOneSwitchFromText(), streaming the text with FlowStatsSax instead of a DOM
+ * - applyFlowDiffs() takes updateMutex and calls applyFlowDiff(), which inserts and removes
+ *   the listed rules by RuleId
+ * - updateGroupsFromQueriedTables() takes updateMutex and calls updateSwitchGroups()
+ * - publishView() compiles the changed tables into a new view (the switches in parallel),
+ *   swaps it in, and only then bumps rulesVersion
+ *
+ * Lookup path:
+ * - lookup() takes no lock: it reads the view through currentView() and probes the
+ *   CompiledTable of the table
+ * - lookupPipeline() does the same per table of the goto_table chain, then resolves groups
+ *   from the switch's published GroupTable
+ */
+struct Classifier::Impl
+{
+    std::mutex updateMutex; // held by the writer; guards switches, maskIntern and effectIntern
+    MaskIntern maskIntern;
+    EffectIntern effectIntern;
+    std::unordered_map<uint64_t, SwitchClassifier> switches;
+    // Bumped once per update that adds or removes a rule, after its view is published
+    std::atomic<uint64_t> rulesVersion{0};
+
+    // Held only to copy or swap the view pointer, never while building a view
+    mutable std::mutex viewMutex;
+    std::shared_ptr<const ClassifierView> view = std::make_shared<const ClassifierView>();
+    // Changes with every published view; unique across classifiers (0: the initial, empty one)
+    std::atomic<uint64_t> viewVersion{0};
+
+    /** @brief Update counters (guarded by updateMutex; the per-switch ones are atomic, as
+     *         switches are updated in parallel).
+     */
+    struct UpdateStats
+    {
+        std::atomic<uint64_t> polls{0};        // switch flow arrays passed to updateOneSwitch()
+        std::atomic<uint64_t> pollsSkipped{0}; // ... that hashed like the switch's previous poll
+        std::atomic<uint64_t> rulesParsed{0};  // flow entries parsed by the others
+        uint64_t diffChanges = 0;  // FlowChanges passed to applyFlowDiff()
+        uint64_t flowMods = 0;     // FlowMods passed to applyFlowMod()
+        uint64_t updateNs = 0;     // time spent in updates, publishing included
+    } updateStats;
+
+    /** @brief Adds the time from its construction to its destruction to updateNs. */
+    struct UpdateTimer
+    {
+        explicit UpdateTimer(UpdateStats& s)
+            : stats(s),
+              start(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~UpdateTimer()
+        {
+            stats.updateNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+        }
+
+        UpdateStats& stats;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    /** @brief Parsed rule extracted from JSON before being inserted. */
+    struct ParsedRule
+    {
+        RuleId id{};
+        uint8_t tableId = 0;
+        int priority = 0;
+        const Mask* mask = nullptr;
+        KeyBytes maskedValue{};
+        RuleEffect effect{};
+    };
+
+    /** @brief Intern the mask of @p polled and compute its RuleId. */
+    ParsedRule makeParsedRule(PolledRule&& polled)
+    {
+        ParsedRule pr;
+        pr.tableId = polled.tableId;
+        pr.priority = polled.priority;
+        pr.mask = maskIntern.interMask(polled.maskBytes);
+
+        KeyBytes valueBytes = packKey(polled.value);
+        pr.maskedValue = bitAnd(valueBytes, pr.mask->bytes);
+
+        pr.effect = std::move(polled.effect);
+
+        pr.id = RuleId{pr.tableId,
+                       fingerprintRuleCore(pr.mask->bytes, pr.maskedValue, pr.priority, pr.effect)};
+        return pr;
+    }
+
+    ParsedRule parseRuleFromJson(const nlohmann::json& flow)
+    {
+        PolledRule polled;
+
+        polled.tableId =
+            flow.contains("table_id") ? static_cast<uint8_t>(parseU64(flow.at("table_id"))) : 0;
+
+        polled.priority = flow.contains("priority") ? parseI32(flow.at("priority")) : 0;
+
+        if (flow.contains("match") && flow.at("match").is_object())
+        {
+            buildMaskAndValueFromMatch(flow.at("match"), polled.maskBytes, polled.value);
+        }
+
+        polled.effect = parseEffectFromFlowEntry(flow);
+        return makeParsedRule(std::move(polled));
+    }
+
+    /** @brief Rule of a FlowChange: IPv4 destination net/mask, priority and OUTPUT port.
+     *
+     * @details
+     * Same identity as the polled entry {"match": {"eth_type": 2048, "ipv4_dst": net/mask},
+     * "priority": priority, "actions": ["OUTPUT:outPort"]}.
+     */
+    ParsedRule parseRuleFromChange(const sflow::FlowChange& change,
+                                   uint32_t outPort,
+                                   uint8_t tableId)
+    {
+        FlowKey value{};
+        value.ethType = 0x0800;
+        value.ipv4Dst = ntohl(change.dstNet);
+
+        KeyBytes maskBytes{};
+        setU16MaskAll(maskBytes, 4);
+        const uint32_t maskBe = htonl(change.dstMask);
+        std::memcpy(maskBytes.bytes.data() + 12, &maskBe, sizeof(maskBe));
+
+        ParsedRule pr;
+        pr.tableId = tableId;
+        pr.priority = static_cast<int>(change.priority);
+        pr.mask = maskIntern.interMask(maskBytes);
+        pr.maskedValue = bitAnd(packKey(value), pr.mask->bytes);
+        pr.effect.outputPorts.push_back(outPort);
+        pr.id = RuleId{tableId,
+                       fingerprintRuleCore(pr.mask->bytes, pr.maskedValue, pr.priority, pr.effect)};
+        return pr;
+    }
+
+    /** @brief Insert a new rule into the OVS-like structure (subtable + bucket). */
+    void insertRuleIntoTables(SwitchClassifier& sw, Rule* r)
+    {
+        TableClassifier& tc = sw.getTable(r->tableId);
+        Subtable* st = tc.getOrCreateSubtable(r->mask);
+
+        Bucket& bucket = st->buckets[r->maskedValue];
+
+        auto pos = std::lower_bound(
+            bucket.rules.begin(),
+            bucket.rules.end(),
+            r,
+            [](const Rule* a, const Rule* x) { return a->priority > x->priority; });
+
+        bucket.rules.insert(pos, r);
+
+        r->subtable = st;
+
+        if (!bucket.rules.empty())
+        {
+            st->maxPriority = std::max(st->maxPriority, bucket.rules.front()->priority);
+        }
+        tc.priorityOrderDirty = true;
+        tc.viewStale = true;
+    }
+
+    /** @brief Remove a rule quickly using its stored placement info. */
+    void removeRuleFromTables(SwitchClassifier& sw, Rule* r)
+    {
+        if (!r->subtable)
+        {
+            return;
+        }
+
+        Subtable* st = r->subtable;
+        auto it = st->buckets.find(r->maskedValue);
+        if (it != st->buckets.end())
+        {
+            auto& vec = it->second.rules;
+            auto vit = std::find(vec.begin(), vec.end(), r);
+            if (vit != vec.end())
+            {
+                vec.erase(vit);
+                if (vec.empty())
+                {
+                    st->buckets.erase(it);
+                }
+            }
+        }
+
+        if (r->priority >= st->maxPriority)
+        {
+            st->maxPriorityStale = true;
+        }
+        sw.tables[r->tableId].priorityOrderDirty = true;
+        sw.tables[r->tableId].viewStale = true;
+
+        r->subtable = nullptr;
+    }
+
+    /** @brief Insert a rule if new, or mark it as seen if it already exists.
+     *
+     * @return true if the rule was inserted.
+     */
+    bool upsertRule(SwitchClassifier& sw, const ParsedRule& pr)
+    {
+        NDT_LOG_TRACE(CLASSIFIER,
+                      "tableId {} priority {} effect(output port) {} maskedValue {}",
+                      std::to_string(pr.tableId),
+                      std::to_string(pr.priority),
+                      std::to_string(pr.effect.outputPorts.front()),
+                      spdlog::to_hex(pr.maskedValue.bytes));
+
+        auto it = sw.rulesById.find(pr.id);
+        if (it == sw.rulesById.end())
         {
             auto r = std::make_unique<Rule>();
             r->id = pr.id;
@@ -1075,134 +2380,664 @@ struct Classifier::Impl
             r->priority = pr.priority;
             r->mask = pr.mask;
             r->maskedValue = pr.maskedValue;
-            r->effect = pr.effect;
+            r->effect = effectIntern.intern(pr.effect);
             r->lastSeenEpoch = sw.epoch;
 
             insertRuleIntoTables(sw, r.get());
             sw.rulesById.emplace(pr.id, std::move(r));
-            return;
+            return true;
         }
         it->second->lastSeenEpoch = sw.epoch;
+        return false;
     }
 
-    /** @brief Update a single switch based on the newly polled table.
+    /** @brief Make @p rules the rule set of @p sw.
      *
      * @details
      * Mark-and-sweep:
      * - epoch++
      * - upsert all polled rules (mark seen with lastSeenEpoch=epoch)
      * - delete any rule whose lastSennEpoch != epoch
+     *
+     * @return true if anything was inserted or deleted.
      */
-    void updateOneSwitch(uint64_t dpid, const nlohmann::json& flowArray)
+    bool replaceRules(SwitchClassifier& sw, const std::vector<ParsedRule>& rules)
     {
-        SwitchClassifier& sw = switches[dpid];
         sw.epoch++;
+        updateStats.rulesParsed += rules.size();
+
+        bool changed = false;
+        for (const auto& pr : rules)
+        {
+            changed |= upsertRule(sw, pr);
+        }
+
+        std::vector<RuleId> toDelete;
+        toDelete.reserve(sw.rulesById.size());
+        for (auto& [rid, rulePtr] : sw.rulesById)
+        {
+            if (rulePtr->lastSeenEpoch != sw.epoch)
+            {
+                toDelete.push_back(rid);
+            }
+        }
+
+        for (const auto& rid : toDelete)
+        {
+            auto it = sw.rulesById.find(rid);
+            if (it == sw.rulesById.end())
+            {
+                continue;
+            }
+            removeRuleFromTables(sw, it->second.get());
+            sw.rulesById.erase(it);
+        }
+        changed |= !toDelete.empty();
+
+        for (auto& [tableId, tc] : sw.tables)
+        {
+            (void)tableId;
+            tc.rebuildPriorityOrderIfNeeded();
+        }
+        return changed;
+    }
+
+    /** @brief Whether @p dpid was last built from a poll fingerprinted @p rawHash (counts the
+     *         poll as skipped if so).
+     */
+    bool pollUnchanged(uint64_t dpid, uint64_t rawHash)
+    {
+        updateStats.polls++;
+        auto it = switches.find(dpid);
+        if (it == switches.end() || it->second.rawHash != rawHash)
+        {
+            return false;
+        }
+        updateStats.pollsSkipped++;
+        return true;
+    }
+
+    /** @brief Update a single switch based on the newly polled table.
+     *
+     * @details
+     * A table that hashes like the previous poll of the switch is skipped; otherwise every
+     * entry is parsed and replaceRules() applies them.
+     *
+     * @return true if anything was inserted or deleted.
+     */
+    bool updateOneSwitch(uint64_t dpid, const nlohmann::json& flowArray)
+    {
+        const uint64_t rawHash = hashFlowArray(flowArray);
+        if (pollUnchanged(dpid, rawHash))
+        {
+            return false;
+        }
+
+        std::vector<ParsedRule> rules;
+        rules.reserve(flowArray.size());
+        for (const auto& flow : flowArray)
+        {
+            rules.push_back(parseRuleFromJson(flow));
+        }
+
+        SwitchClassifier& sw = switches.at(dpid);
+        sw.rawHash = rawHash;
+        return replaceRules(sw, rules);
+    }
+
+    /** @brief updateOneSwitch() from the raw text of a /stats/flow/<dpid> response.
+     *
+     * @details
+     * A first FlowStatsSax pass only fingerprints the text; the entries are read in a second
+     * pass if the fingerprint changed. Neither pass builds a DOM. Malformed text and
+     * responses without entries leave the switch as it is.
+     *
+     * @return true if anything was inserted or deleted.
+     */
+    bool updateOneSwitchFromText(uint64_t dpid, std::string_view text)
+    {
+        FlowStatsSax fingerprint(nullptr);
+        if (!nlohmann::json::sax_parse(text, &fingerprint))
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(), "unparsable flow stats of dpid {}", dpid);
+            return false;
+        }
+        if (fingerprint.flowCount() == 0 || pollUnchanged(dpid, fingerprint.hash()))
+        {
+            return false;
+        }
+
+        std::vector<PolledRule> polled;
+        polled.reserve(fingerprint.flowCount());
+        FlowStatsSax reader(&polled);
+        nlohmann::json::sax_parse(text, &reader);
+
+        std::vector<ParsedRule> rules;
+        rules.reserve(polled.size());
+        for (auto& p : polled)
+        {
+            rules.push_back(makeParsedRule(std::move(p)));
+        }
+
+        SwitchClassifier& sw = switches.at(dpid);
+        sw.rawHash = fingerprint.hash();
+        return replaceRules(sw, rules);
+    }
+
+    /** @brief Remove the rule @p id from @p sw if present.
+     *
+     * @return true if a rule was removed.
+     */
+    bool eraseRule(SwitchClassifier& sw, const RuleId& id)
+    {
+        auto it = sw.rulesById.find(id);
+        if (it == sw.rulesById.end())
+        {
+            return false;
+        }
+        removeRuleFromTables(sw, it->second.get());
+        sw.rulesById.erase(it);
+        return true;
+    }
+
+    /** @brief Apply the added, removed and modified rules of @p diff to table @p tableId.
+     *
+     * @details
+     * Removals of unknown rules and additions of known ones are no-ops. Leaves rawHash
+     * unset, so the next poll of the switch is parsed in full and overrides the diff.
+     *
+     * @return true if anything was inserted or deleted.
+     */
+    bool applyFlowDiff(const sflow::FlowDiff& diff, uint8_t tableId)
+    {
+        SwitchClassifier& sw = switches[diff.dpid];
+        updateStats.diffChanges += diff.added.size() + diff.removed.size() + diff.modified.size();
+
+        bool changed = false;
+        auto eraseOld = [&](const sflow::FlowChange& change) {
+            return eraseRule(sw, parseRuleFromChange(change, change.oldOutInterface, tableId).id);
+        };
+        for (const auto& change : diff.removed)
+        {
+            changed |= eraseOld(change);
+        }
+        for (const auto& change : diff.modified)
+        {
+            changed |= eraseOld(change);
+            changed |= upsertRule(sw, parseRuleFromChange(change, change.newOutInterface, tableId));
+        }
+        for (const auto& change : diff.added)
+        {
+            changed |= upsertRule(sw, parseRuleFromChange(change, change.newOutInterface, tableId));
+        }
+
+        if (changed)
+        {
+            sw.rawHash.reset();
+            sw.getTable(tableId).rebuildPriorityOrderIfNeeded();
+        }
+        return changed;
+    }
+
+    /** @brief The rules of @p sw in the table of @p pr that a flow-mod matching like @p pr
+     *         hits: with its mask, value and priority when @p strict, else those whose match
+     *         is the same or more specific, of any priority.
+     */
+    std::vector<const Rule*> rulesHitBy(const SwitchClassifier& sw,
+                                        const ParsedRule& pr,
+                                        bool strict) const
+    {
+        std::vector<const Rule*> hit;
+        if (strict)
+        {
+            auto table = sw.tables.find(pr.tableId);
+            if (table == sw.tables.end())
+            {
+                return hit;
+            }
+            auto subtable = table->second.byMask.find(pr.mask);
+            if (subtable == table->second.byMask.end())
+            {
+                return hit;
+            }
+            auto bucket = subtable->second->buckets.find(pr.maskedValue);
+            if (bucket == subtable->second->buckets.end())
+            {
+                return hit;
+            }
+            for (const Rule* r : bucket->second.rules)
+            {
+                if (r->priority == pr.priority)
+                {
+                    hit.push_back(r);
+                }
+            }
+            return hit;
+        }
+
+        for (const auto& [id, r] : sw.rulesById)
+        {
+            if (r->tableId == pr.tableId &&
+                bitAnd(r->mask->bytes, pr.mask->bytes) == pr.mask->bytes &&
+                bitAnd(r->maskedValue, pr.mask->bytes) == pr.maskedValue)
+            {
+                hit.push_back(r.get());
+            }
+        }
+        return hit;
+    }
+
+    /** @brief Apply @p mod to its switch the way the switch applied it (see applyFlowMods()).
+     *
+     * @details
+     * Leaves rawHash unset when it changed anything, like applyFlowDiff().
+     *
+     * @return true if anything was inserted or deleted.
+     */
+    bool applyFlowMod(const FlowMod& mod)
+    {
+        SwitchClassifier& sw = switches[mod.dpid];
+        updateStats.flowMods++;
+
+        PolledRule polled;
+        polled.tableId = mod.tableId;
+        polled.priority = mod.priority;
+        if (mod.match.is_object())
+        {
+            buildMaskAndValueFromMatch(mod.match, polled.maskBytes, polled.value);
+        }
+        parseActionsArrayIntoEffect(mod.actions, polled.effect);
+        const ParsedRule pr = makeParsedRule(std::move(polled));
+
+        const bool strict =
+            mod.command == FlowMod::Command::Add || mod.command == FlowMod::Command::DeleteStrict;
+        // The hit rules as they will be after the mod; taken before any is erased
+        std::vector<RuleId> erased;
+        std::vector<ParsedRule> replacements;
+        for (const Rule* r : rulesHitBy(sw, pr, strict))
+        {
+            if (mod.command == FlowMod::Command::Add && r->id == pr.id)
+            {
+                continue; // already there as is
+            }
+            erased.push_back(r->id);
+            if (mod.command == FlowMod::Command::Modify)
+            {
+                ParsedRule modified;
+                modified.tableId = r->tableId;
+                modified.priority = r->priority;
+                modified.mask = r->mask;
+                modified.maskedValue = r->maskedValue;
+                modified.effect = pr.effect;
+                modified.id = RuleId{modified.tableId,
+                                     fingerprintRuleCore(modified.mask->bytes,
+                                                         modified.maskedValue,
+                                                         modified.priority,
+                                                         modified.effect)};
+                replacements.push_back(std::move(modified));
+            }
+        }
+        if (mod.command == FlowMod::Command::Add)
+        {
+            replacements.push_back(pr);
+        }
+
+        bool changed = false;
+        for (const RuleId& id : erased)
+        {
+            changed |= eraseRule(sw, id);
+        }
+        for (const ParsedRule& replacement : replacements)
+        {
+            changed |= upsertRule(sw, replacement);
+        }
+
+        if (changed)
+        {
+            sw.rawHash.reset();
+            sw.getTable(pr.tableId).rebuildPriorityOrderIfNeeded();
+        }
+        return changed;
+    }
+
+    /** @brief Replace the groups of @p dpid with a polled description.
+     *
+     * @return true if the description changed.
+     */
+    bool updateSwitchGroups(uint64_t dpid, const nlohmann::json& groupArray)
+    {
+        SwitchClassifier& sw = switches[dpid];
+        const uint64_t groupsHash = hashJsonValue(1469598103934665603ULL, groupArray);
+        if (sw.groupsHash == groupsHash)
+        {
+            return false;
+        }
+        sw.groupsHash = groupsHash;
+        sw.groups = std::make_shared<const GroupTable>(parseGroupTable(groupArray));
+        return true;
+    }
+
+    /** @brief Build the CompiledTable of @p tc. */
+    static std::shared_ptr<const CompiledTable> compileTable(const TableClassifier& tc)
+    {
+        auto ct = std::make_shared<CompiledTable>();
+        ct->subtables.reserve(tc.subtablesByPriority.size());
+        std::unordered_set<const RuleEffect*> shared; // effects already in ct->effects
+        for (const Subtable* st : tc.subtablesByPriority)
+        {
+            if (st->buckets.empty())
+            {
+                continue;
+            }
+
+            auto& cs = ct->subtables.emplace_back();
+            cs.maxPriority = st->maxPriority;
+            cs.mask = toCompiledKey(st->mask->bytes);
+            size_t covered = 0;
+            for (uint8_t w : kStageOrder)
+            {
+                if (cs.mask.words[w] == 0)
+                {
+                    continue;
+                }
+                for (size_t b = size_t{w} * 8; b < size_t{w} * 8 + 8; ++b)
+                {
+                    if (st->mask->bytes.bytes[b] != 0)
+                    {
+                        cs.gather[covered] = static_cast<uint8_t>(b);
+                        cs.gatherMask[covered] = st->mask->bytes.bytes[b];
+                        ++covered;
+                    }
+                }
+                cs.stageEnd[cs.stageCount] = static_cast<uint8_t>(covered);
+                cs.stageWords[cs.stageCount++] = w;
+            }
+            switch (std::max<size_t>(1, (covered + 7) / 8))
+            {
+            case 1:
+                cs.keys.emplace<CompiledTable::PackedRules<1>>();
+                break;
+            case 2:
+                cs.keys.emplace<CompiledTable::PackedRules<2>>();
+                break;
+            case 3:
+                cs.keys.emplace<CompiledTable::PackedRules<3>>();
+                break;
+            default:
+                cs.keys.emplace<CompiledTable::PackedRules<4>>();
+                break;
+            }
+
+            std::visit(
+                [&](auto& packed) {
+                    packed.stagePrefixes.resize(cs.stageCount > 0 ? cs.stageCount - 1 : 0);
+                    packed.rules.reserve(st->buckets.size());
+
+                    for (const auto& [maskedValue, bucket] : st->buckets)
+                    {
+                        if (bucket.rules.empty())
+                        {
+                            continue;
+                        }
+                        typename std::decay_t<decltype(packed)>::Key key;
+                        for (size_t s = 0; s < cs.stageCount; ++s)
+                        {
+                            cs.packStage(maskedValue, s, key);
+                            if (s + 1 < cs.stageCount)
+                            {
+                                packed.stagePrefixes[s].try_emplace(key);
+                            }
+                        }
+                        const Rule* best = bucket.rules.front();
+                        packed.rules.try_emplace(key, static_cast<uint32_t>(ct->rules.size()));
+                        ct->rules.push_back(CompiledRule{best->priority, best->effect.get()});
+                        if (shared.insert(best->effect.get()).second)
+                        {
+                            ct->effects.push_back(best->effect);
+                        }
+                    }
+                },
+                cs.keys);
+        }
+        return ct;
+    }
+
+    /** @brief Run @p work(i) for every i below @p count, on up to CLASSIFIER_UPDATE_MAX_WORKERS
+     *         threads (the calling one included).
+     *
+     * @details
+     * Indices are claimed one at a time, so one large switch does not hold up a share of small
+     * ones. The first exception a call throws is rethrown once all threads are done.
+     */
+    template <typename Work>
+    static void forEachParallel(size_t count, const Work& work)
+    {
+        const size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+        const size_t workers =
+            std::min<size_t>({count, CLASSIFIER_UPDATE_MAX_WORKERS, cpus});
+        std::atomic<size_t> next{0};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        auto run = [&] {
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;)
+            {
+                try
+                {
+                    work(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(errorMutex);
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        };
 
-        for (const auto& flow : flowArray)
+        std::vector<std::thread> threads;
+        threads.reserve(workers > 1 ? workers - 1 : 0);
+        for (size_t t = 1; t < workers; ++t)
         {
-            ParsedRule pr = parseRuleFromJson(flow);
-            upsertRule(sw, pr);
+            threads.emplace_back(run);
         }
-
-        std::vector<RuleId> toDelete;
-        toDelete.reserve(sw.rulesById.size());
-        for (auto& [rid, rulePtr] : sw.rulesById)
+        run();
+        for (auto& thread : threads)
         {
-            if (rulePtr->lastSeenEpoch != sw.epoch)
-            {
-                toDelete.push_back(rid);
-            }
+            thread.join();
         }
-
-        for (const auto& rid : toDelete)
+        if (error)
         {
-            auto it = sw.rulesById.find(rid);
-            if (it == sw.rulesById.end())
+            std::rethrow_exception(error);
+        }
+    }
+
+    /** @brief Publish a view with the new rules of @p changedDpids (caller holds updateMutex).
+     *
+     * @details
+     * Only tables whose rules changed are compiled again. The view is swapped in before
+     * rulesVersion moves, so a reader that sees the new version also gets the new rules.
+     */
+    void publishView(const std::vector<uint64_t>& changedDpids)
+    {
+        // Shared by all classifiers, so a thread's cached version never matches another
+        // classifier's view
+        static std::atomic<uint64_t> publishedViews{0};
+
+        std::shared_ptr<const ClassifierView> old = loadView();
+        auto next = std::make_shared<ClassifierView>(*old);
+        const uint64_t version = rulesVersion.load(std::memory_order_relaxed) + 1;
+
+        // Each switch compiles only its own tables, so they are built in parallel
+        std::vector<std::shared_ptr<SwitchView>> built(changedDpids.size());
+        forEachParallel(changedDpids.size(), [&](size_t i) {
+            const uint64_t dpid = changedDpids[i];
+            SwitchClassifier& sw = switches.at(dpid);
+            sw.rulesVersion = version;
+
+            auto sv = std::make_shared<SwitchView>();
+            sv->rulesVersion = version;
+            sv->ruleCount = sw.rulesById.size();
+            sv->groups = sw.groups;
+            auto oldSwitch = old->switches.find(dpid);
+            const size_t emcEntries = ExactMatchCache::entriesFor(sv->ruleCount);
+            if (oldSwitch != old->switches.end() &&
+                oldSwitch->second->emc->entries() == emcEntries)
             {
-                continue;
+                sv->emc = oldSwitch->second->emc;
             }
-            removeRuleFromTables(sw, it->second.get());
-            sw.rulesById.erase(it);
+            else
+            {
+                sv->emc = std::make_shared<ExactMatchCache>(emcEntries);
+            }
+            for (auto& [tableId, tc] : sw.tables)
+            {
+                std::shared_ptr<const CompiledTable> compiled;
+                if (!tc.viewStale && oldSwitch != old->switches.end())
+                {
+                    auto oldTable = oldSwitch->second->tables.find(tableId);
+                    if (oldTable != oldSwitch->second->tables.end())
+                    {
+                        compiled = oldTable->second;
+                    }
+                }
+                if (!compiled)
+                {
+                    compiled = compileTable(tc);
+                    tc.viewStale = false;
+                }
+                sv->tables.emplace(tableId, std::move(compiled));
+            }
+            built[i] = std::move(sv);
+        });
+        for (size_t i = 0; i < changedDpids.size(); ++i)
+        {
+            next->switches.insert_or_assign(changedDpids[i], std::move(built[i]));
         }
 
-        for (auto& [tableId, tc] : sw.tables)
         {
-            (void)tableId;
-            tc.rebuildPriorityOrderIfNeeded();
+            std::lock_guard lock(viewMutex);
+            view = std::move(next);
         }
+        viewVersion.store(publishedViews.fetch_add(1, std::memory_order_relaxed) + 1,
+                          std::memory_order_release);
+        rulesVersion.store(version, std::memory_order_release);
+        effectIntern.sweep();
+    }
+
+    std::shared_ptr<const ClassifierView> loadView() const
+    {
+        std::lock_guard lock(viewMutex);
+        return view;
     }
 
-    /** @brief Lookup best matching rule in a single  OpenFlow table (no locking).
+    /** @brief The published view, as seen by the calling thread.
      *
      * @details
-     * Algorithm:
-     * - Convert key to packed bytes
-     * - Iterate subtables by descending maxPriority
-     * - For each subtable:
-     *   maskedKey = key & mask
-     *   bucket = buckets[maskedKey]
-     *   candidate = bucket.rules.front()
-     * - Choose the highest priority candidate
+     * Each thread keeps the view it last loaded and only goes through viewMutex again when
+     * viewVersion has moved, so steady-state lookups are an atomic load plus the probe,
+     * without lock or refcount traffic on a shared cache line. The reference stays valid
+     * until the thread's next call.
      */
-    const Rule* lookupInTableNoLock(const SwitchClassifier& sw,
-                                    uint8_t tableId,
-                                    const FlowKey& key) const
+    const ClassifierView& currentView() const
     {
-        auto tit = sw.tables.find(tableId);
-        if (tit == sw.tables.end())
+        struct Cached
         {
-            return nullptr;
-        }
+            uint64_t version = 0;
+            std::shared_ptr<const ClassifierView> view;
+        };
+        thread_local Cached cached;
 
-        const TableClassifier& tc = tit->second;
-        KeyBytes keyBytes = packKey(key);
-
-        SPDLOG_LOGGER_TRACE(Logger::instance(), "keyBytes {}", spdlog::to_hex(keyBytes.bytes));
+        const uint64_t version = viewVersion.load(std::memory_order_acquire);
+        if (!cached.view || cached.version != version)
+        {
+            // A view published in between is picked up again on the next call
+            cached.view = loadView();
+            cached.version = version;
+        }
+        return *cached.view;
+    }
 
-        const Rule* best = nullptr;
-        int bestPriority = -1;
+    /** @brief lookupPipeline() on the current view into @p out (cleared first, capacity
+     *         kept); @p consulted may be null. False if nothing matched.
+     */
+    bool runPipeline(uint64_t dpid,
+                     const FlowKey& key,
+                     FlowKey* consulted,
+                     PipelineEffect& out) const
+    {
+        out.outputPorts.clear();
+        out.tables.clear();
+        out.groups.clear();
+        out.unresolvedGroup = false;
+
+        const ClassifierView& v = currentView();
+        auto it = v.switches.find(dpid);
+        if (it == v.switches.end())
+        {
+            recordMiss(false, dpid, 0, key);
+            SPDLOG_LOGGER_WARN(Logger::instance(), "switch not found dpid {}", dpid);
+            return false;
+        }
+        const SwitchView& sw = *it->second;
+        const KeyBytes packed = packKey(key);
 
-        for (const auto& st : tc.subtablesByPriority)
+        uint8_t tableId = 0;
+        for (;;)
         {
-            if (st->maxPriority < bestPriority)
+            const CompiledRule* r = sw.lookup(tableId, packed, consulted);
+            if (!r)
             {
                 break;
             }
-
-            SPDLOG_LOGGER_TRACE(
-                Logger::instance(),
-                "mask {}",
-                spdlog::to_hex(st->mask->bytes.bytes.begin(), st->mask->bytes.bytes.end()));
-
-            KeyBytes maskedKey = bitAnd(keyBytes, st->mask->bytes);
-            auto it = st->buckets.find(maskedKey);
-            if (it == st->buckets.end())
+            out.tables.push_back(tableId);
+            out.outputPorts.insert(out.outputPorts.end(),
+                                   r->effect->outputPorts.begin(),
+                                   r->effect->outputPorts.end());
+            if (r->effect->groupId)
             {
-                continue;
+                resolveGroup(*sw.groups, *r->effect->groupId, key, out, consulted, 0);
             }
-
-            const auto& vec = it->second.rules;
-            if (!vec.empty())
+            // goto_table may only move forward, which also rules out loops
+            if (!r->effect->gotoTable || *r->effect->gotoTable <= tableId)
             {
-                const Rule* cand = vec.front();
-                if (cand->priority > bestPriority)
-                {
-                    best = cand;
-                    bestPriority = cand->priority;
-                }
-
-                SPDLOG_LOGGER_TRACE(
-                    Logger::instance(),
-                    "bestPriority key {}:{} -> {}:{}, maskedKey {}, effect(outport) {}",
-                    key.ipv4Src,
-                    key.tpSrc,
-                    key.ipv4Dst,
-                    key.tpDst,
-                    spdlog::to_hex(maskedKey.bytes),
-                    best->effect.outputPorts.front());
+                break;
             }
+            tableId = *r->effect->gotoTable;
         }
-        return best;
+
+        if (out.tables.empty())
+        {
+            recordMiss(true, dpid, 0, key);
+            SPDLOG_LOGGER_WARN(Logger::instance(), "no rule matched");
+            return false;
+        }
+        return true;
+    }
+
+    /** @brief SwitchView of @p dpid in @p v, or nullptr. */
+    static const SwitchView* findSwitch(const ClassifierView& v, uint64_t dpid)
+    {
+        auto it = v.switches.find(dpid);
+        if (it == v.switches.end())
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(), "switch not found dpid {}", dpid);
+            return nullptr;
+        }
+        return it->second.get();
+    }
+
+    /** @brief CompiledTable of (@p dpid, @p tableId) in @p v, or nullptr. */
+    static const CompiledTable* findTable(const ClassifierView& v, uint64_t dpid, uint8_t tableId)
+    {
+        const SwitchView* sw = findSwitch(v, dpid);
+        if (!sw)
+        {
+            return nullptr;
+        }
+        auto tit = sw->tables.find(tableId);
+        return tit == sw->tables.end() ? nullptr : tit->second.get();
     }
 };
 
@@ -1243,13 +3078,18 @@ Classifier::operator=(Classifier&& other) noexcept
 void
 Classifier::updateFromQueriedTables(const json& newTables)
 {
-    std::unique_lock lock(impl_->mutex);
+    std::lock_guard updateLock(impl_->updateMutex);
+    Impl::UpdateTimer timer(impl_->updateStats);
 
     if (!newTables.is_array())
     {
         return;
     }
 
+    // The last flow array of each switch: a switch listed twice in one poll ends up with its
+    // later table, as if they were applied in order
+    std::vector<std::pair<uint64_t, const json*>> polled;
+    std::unordered_map<uint64_t, size_t> polledIndex;
     for (const auto& sw : newTables)
     {
         uint64_t dpid = parseU64(sw.at("dpid"));
@@ -1261,50 +3101,492 @@ Classifier::updateFromQueriedTables(const json& newTables)
             continue;
         }
 
-        impl_->updateOneSwitch(dpid, *flowsArray);
+        auto [it, inserted] = polledIndex.try_emplace(dpid, polled.size());
+        if (inserted)
+        {
+            polled.emplace_back(dpid, flowsArray);
+            impl_->switches.try_emplace(dpid);
+        }
+        else
+        {
+            polled[it->second].second = flowsArray;
+        }
+    }
+
+    // Switches are independent, so each is parsed and updated on its own thread
+    std::vector<char> changed(polled.size(), 0);
+    Impl::forEachParallel(polled.size(), [&](size_t i) {
+        changed[i] = impl_->updateOneSwitch(polled[i].first, *polled[i].second);
+    });
+
+    std::vector<uint64_t> changedDpids;
+    for (size_t i = 0; i < polled.size(); ++i)
+    {
+        if (changed[i])
+        {
+            changedDpids.push_back(polled[i].first);
+        }
+    }
+    if (!changedDpids.empty())
+    {
+        std::sort(changedDpids.begin(), changedDpids.end());
+        impl_->publishView(changedDpids);
+    }
+}
+
+void
+Classifier::updateFromFlowStatsText(const std::vector<std::pair<uint64_t, std::string>>& responses)
+{
+    std::lock_guard updateLock(impl_->updateMutex);
+    Impl::UpdateTimer timer(impl_->updateStats);
+
+    // The last response of each switch, as for updateFromQueriedTables()
+    std::vector<const std::pair<uint64_t, std::string>*> polled;
+    std::unordered_map<uint64_t, size_t> polledIndex;
+    for (const auto& response : responses)
+    {
+        auto [it, inserted] = polledIndex.try_emplace(response.first, polled.size());
+        if (inserted)
+        {
+            polled.push_back(&response);
+            impl_->switches.try_emplace(response.first);
+        }
+        else
+        {
+            polled[it->second] = &response;
+        }
+    }
+
+    std::vector<char> changed(polled.size(), 0);
+    Impl::forEachParallel(polled.size(), [&](size_t i) {
+        const auto& [dpid, text] = *polled[i];
+        try
+        {
+            changed[i] = impl_->updateOneSwitchFromText(dpid, text);
+        }
+        catch (const std::exception& e)
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "flow stats of dpid {}: {}", dpid, e.what());
+        }
+    });
+
+    std::vector<uint64_t> changedDpids;
+    for (size_t i = 0; i < polled.size(); ++i)
+    {
+        if (changed[i])
+        {
+            changedDpids.push_back(polled[i]->first);
+        }
+    }
+    if (!changedDpids.empty())
+    {
+        std::sort(changedDpids.begin(), changedDpids.end());
+        impl_->publishView(changedDpids);
+    }
+}
+
+void
+Classifier::applyFlowDiffs(const std::vector<sflow::FlowDiff>& diffs, uint8_t tableId)
+{
+    std::lock_guard updateLock(impl_->updateMutex);
+    Impl::UpdateTimer timer(impl_->updateStats);
+
+    std::vector<uint64_t> changedDpids;
+    for (const auto& diff : diffs)
+    {
+        if (impl_->applyFlowDiff(diff, tableId))
+        {
+            changedDpids.push_back(diff.dpid);
+        }
+    }
+
+    if (!changedDpids.empty())
+    {
+        std::sort(changedDpids.begin(), changedDpids.end());
+        changedDpids.erase(std::unique(changedDpids.begin(), changedDpids.end()),
+                           changedDpids.end());
+        impl_->publishView(changedDpids);
+    }
+}
+
+void
+Classifier::applyFlowMods(const std::vector<FlowMod>& mods)
+{
+    std::lock_guard updateLock(impl_->updateMutex);
+    Impl::UpdateTimer timer(impl_->updateStats);
+
+    std::vector<uint64_t> changedDpids;
+    for (const auto& mod : mods)
+    {
+        try
+        {
+            if (impl_->applyFlowMod(mod))
+            {
+                changedDpids.push_back(mod.dpid);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "flow-mod for dpid {}: {}", mod.dpid, e.what());
+        }
+    }
+
+    if (!changedDpids.empty())
+    {
+        std::sort(changedDpids.begin(), changedDpids.end());
+        changedDpids.erase(std::unique(changedDpids.begin(), changedDpids.end()),
+                           changedDpids.end());
+        impl_->publishView(changedDpids);
+    }
+}
+
+void
+Classifier::updateGroupsFromQueriedTables(const json& newGroups)
+{
+    std::lock_guard updateLock(impl_->updateMutex);
+    Impl::UpdateTimer timer(impl_->updateStats);
+
+    if (!newGroups.is_array())
+    {
+        return;
+    }
+
+    std::vector<uint64_t> changedDpids;
+    for (const auto& sw : newGroups)
+    {
+        uint64_t dpid = parseU64(sw.at("dpid"));
+        const json* groupArray = extractFlowArray(sw.at("groups"), dpid);
+        if (!groupArray || !groupArray->is_array())
+        {
+            continue;
+        }
+
+        if (impl_->updateSwitchGroups(dpid, *groupArray))
+        {
+            changedDpids.push_back(dpid);
+        }
+    }
+
+    if (!changedDpids.empty())
+    {
+        std::sort(changedDpids.begin(), changedDpids.end());
+        changedDpids.erase(std::unique(changedDpids.begin(), changedDpids.end()),
+                           changedDpids.end());
+        impl_->publishView(changedDpids);
     }
 }
 
 std::optional<RuleEffect>
 Classifier::lookup(uint64_t dpid, const FlowKey& key, uint8_t tableId) const
 {
-    std::shared_lock lock(impl_->mutex);
+    const RuleEffect* effect = lookupEffect(dpid, key, nullptr, tableId);
+    if (!effect)
+    {
+        return std::nullopt;
+    }
 
-    auto it = impl_->switches.find(dpid);
-    if (it == impl_->switches.end())
+    NDT_LOG_TRACE(CLASSIFIER,
+                  "lookup for {}:{} -> {}:{} effect(output) {}",
+                  key.ipv4Src,
+                  key.tpSrc,
+                  key.ipv4Dst,
+                  key.tpDst,
+                  effect->outputPorts.front());
+
+    return *effect;
+}
+
+std::optional<RuleEffect>
+Classifier::lookupWithMask(uint64_t dpid,
+                           const FlowKey& key,
+                           FlowKey& consulted,
+                           uint8_t tableId) const
+{
+    const RuleEffect* effect = lookupEffect(dpid, key, &consulted, tableId);
+    if (!effect)
     {
-        SPDLOG_LOGGER_WARN(Logger::instance(), "switch not found dpid {}", dpid);
         return std::nullopt;
     }
+    return *effect;
+}
 
-    const Rule* r = impl_->lookupInTableNoLock(it->second, tableId, key);
+const RuleEffect*
+Classifier::lookupEffect(uint64_t dpid,
+                         const FlowKey& key,
+                         FlowKey* consulted,
+                         uint8_t tableId) const
+{
+    const SwitchView* sw = Impl::findSwitch(impl_->currentView(), dpid);
+    const CompiledRule* r = sw ? sw->lookup(tableId, packKey(key), consulted) : nullptr;
     if (!r)
     {
+        recordMiss(sw != nullptr, dpid, tableId, key);
         SPDLOG_LOGGER_WARN(Logger::instance(), "no rule matched");
+        return nullptr;
+    }
+    return r->effect;
+}
+
+std::optional<PipelineEffect>
+Classifier::lookupPipeline(uint64_t dpid, const FlowKey& key) const
+{
+    PipelineEffect out;
+    if (!impl_->runPipeline(dpid, key, nullptr, out))
+    {
         return std::nullopt;
     }
+    return out;
+}
 
-    SPDLOG_LOGGER_TRACE(Logger::instance(),
-                        "lookup for {}:{} -> {}:{} effect(output) {}",
-                        key.ipv4Src,
-                        key.tpSrc,
-                        key.ipv4Dst,
-                        key.tpDst,
-                        r->effect.outputPorts.front());
+std::optional<PipelineEffect>
+Classifier::lookupPipelineWithMask(uint64_t dpid, const FlowKey& key, FlowKey& consulted) const
+{
+    PipelineEffect out;
+    if (!impl_->runPipeline(dpid, key, &consulted, out))
+    {
+        return std::nullopt;
+    }
+    return out;
+}
 
-    return r->effect;
+bool
+Classifier::lookupPipelineInto(uint64_t dpid,
+                               const FlowKey& key,
+                               FlowKey* consulted,
+                               PipelineEffect& out) const
+{
+    return impl_->runPipeline(dpid, key, consulted, out);
+}
+
+void
+Classifier::lookupBatch(uint64_t dpid,
+                        std::span<const FlowKey> keys,
+                        std::span<std::optional<RuleEffect>> out,
+                        uint8_t tableId) const
+{
+    if (keys.size() != out.size())
+    {
+        throw std::invalid_argument("lookupBatch: keys and out differ in size");
+    }
+    std::fill(out.begin(), out.end(), std::nullopt);
+    if (keys.empty())
+    {
+        return;
+    }
+
+    const CompiledTable* table = Impl::findTable(impl_->currentView(), dpid, tableId);
+    if (!table)
+    {
+        return;
+    }
+
+    thread_local std::vector<KeyBytes> packed;
+    thread_local std::vector<const CompiledRule*> best;
+    packed.clear();
+    packed.reserve(keys.size());
+    for (const FlowKey& key : keys)
+    {
+        packed.push_back(packKey(key));
+    }
+    table->lookupBatch(packed, best);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (best[i])
+        {
+            out[i] = *best[i]->effect;
+        }
+    }
 }
 
 size_t
 Classifier::getRuleCount(uint64_t dpid) const
 {
-    std::shared_lock lock(impl_->mutex);
-    auto it = impl_->switches.find(dpid);
-    if (it == impl_->switches.end())
+    const ClassifierView& view = impl_->currentView();
+    auto it = view.switches.find(dpid);
+    return it == view.switches.end() ? 0 : it->second->ruleCount;
+}
+
+std::vector<sflow::FlowChange>
+Classifier::getIpv4DstRules(uint64_t dpid, uint8_t tableId) const
+{
+    // The mask of such a rule covers eth_type and some of ipv4_dst, nothing else
+    KeyBytes ethTypeOnly{};
+    setU16MaskAll(ethTypeOnly, 4);
+
+    std::vector<sflow::FlowChange> rules;
+    std::lock_guard updateLock(impl_->updateMutex);
+    auto sw = impl_->switches.find(dpid);
+    if (sw == impl_->switches.end())
+    {
+        return rules;
+    }
+    for (const auto& [id, rule] : sw->second.rulesById)
+    {
+        const RuleEffect& effect = *rule->effect;
+        if (rule->tableId != tableId || effect.outputPorts.size() != 1 || effect.gotoTable ||
+            effect.groupId || rule->priority < 0)
+        {
+            continue;
+        }
+        KeyBytes rest = rule->mask->bytes;
+        const uint32_t dstMask = readU32Be(rest.bytes, 12);
+        std::memset(rest.bytes.data() + 12, 0, sizeof(uint32_t));
+        if (!(rest == ethTypeOnly) || readU16Be(rule->maskedValue.bytes, 4) != 0x0800)
+        {
+            continue;
+        }
+        rules.push_back(sflow::FlowChange{htonl(readU32Be(rule->maskedValue.bytes, 12)),
+                                          dstMask,
+                                          static_cast<uint32_t>(rule->priority),
+                                          0,
+                                          effect.outputPorts.front()});
+    }
+    return rules;
+}
+
+uint64_t
+Classifier::getRulesVersion() const
+{
+    return impl_->rulesVersion.load(std::memory_order_acquire);
+}
+
+uint64_t
+Classifier::getRulesVersion(uint64_t dpid) const
+{
+    const ClassifierView& view = impl_->currentView();
+    auto it = view.switches.find(dpid);
+    return it == view.switches.end() ? 0 : it->second->rulesVersion;
+}
+
+std::unordered_map<uint64_t, uint64_t>
+Classifier::getRulesVersions() const
+{
+    const ClassifierView& view = impl_->currentView();
+    std::unordered_map<uint64_t, uint64_t> versions;
+    versions.reserve(view.switches.size());
+    for (const auto& [dpid, sw] : view.switches)
     {
-        return 0;
+        versions.emplace(dpid, sw->rulesVersion);
+    }
+    return versions;
+}
+
+nlohmann::json
+Classifier::statsJson() const
+{
+    const utils::MemoryUsage usage = memoryUsage();
+    const size_t writerBytes =
+        usage.bytes("rules") + usage.bytes("subtables") + usage.bytes("effects");
+    const size_t compiledBytes = usage.bytes("compiled_tables");
+
+    std::lock_guard updateLock(impl_->updateMutex);
+
+    size_t rules = 0;
+    size_t groups = 0;
+    size_t subtables = 0;
+    for (const auto& [dpid, sw] : impl_->switches)
+    {
+        (void)dpid;
+        rules += sw.rulesById.size();
+        groups += sw.groups->size();
+        for (const auto& [tableId, tc] : sw.tables)
+        {
+            (void)tableId;
+            subtables += tc.byMask.size();
+        }
+    }
+
+    size_t emcEntries = 0;
+    uint64_t emcHits = 0;
+    uint64_t emcMisses = 0;
+    for (const auto& [dpid, sw] : impl_->loadView()->switches)
+    {
+        (void)dpid;
+        const auto [hits, misses] = sw->emc->counters();
+        emcEntries += sw->emc->entries();
+        emcHits += hits;
+        emcMisses += misses;
+    }
+
+    const Impl::UpdateStats& st = impl_->updateStats;
+    const double updateSeconds = st.updateNs / 1e9;
+    return nlohmann::json{
+        {"switches", impl_->switches.size()},
+        {"rules", rules},
+        {"groups", groups},
+        {"masks", impl_->maskIntern.size()},
+        {"effects", impl_->effectIntern.size()},
+        {"subtables", subtables},
+        {"rule_bytes", writerBytes},
+        {"compiled_bytes", compiledBytes},
+        {"bytes_per_rule", rules == 0 ? 0.0 : double(writerBytes + compiledBytes) / rules},
+        {"exact_match_cache",
+         {{"entries", emcEntries},
+          {"hits", emcHits},
+          {"misses", emcMisses},
+          {"hit_rate",
+           emcHits + emcMisses ? static_cast<double>(emcHits) / (emcHits + emcMisses) : 0.0}}},
+        {"polls", st.polls.load()},
+        {"polls_skipped", st.pollsSkipped.load()},
+        {"rules_parsed", st.rulesParsed.load()},
+        {"diff_changes", st.diffChanges},
+        {"flow_mods", st.flowMods},
+        {"update_seconds", updateSeconds},
+        {"rules_parsed_per_second",
+         updateSeconds == 0 ? 0.0 : st.rulesParsed.load() / updateSeconds}};
+}
+
+utils::MemoryUsage
+Classifier::memoryUsage() const
+{
+    std::lock_guard updateLock(impl_->updateMutex);
+
+    size_t rules = 0;
+    size_t ruleBytes = 0;
+    size_t subtableBytes = 0;
+    for (const auto& [dpid, sw] : impl_->switches)
+    {
+        (void)dpid;
+        rules += sw.rulesById.size();
+        // Rule objects plus their rulesById node and Bucket slot
+        ruleBytes += sw.rulesById.size() * (sizeof(Rule) + sizeof(std::pair<RuleId, void*>) +
+                                            2 * sizeof(void*) + sizeof(Rule*));
+        for (const auto& [tableId, tc] : sw.tables)
+        {
+            (void)tableId;
+            for (const auto& [mask, st] : tc.byMask)
+            {
+                (void)mask;
+                subtableBytes += sizeof(Subtable) +
+                                 st->buckets.size() * (sizeof(std::pair<KeyBytes, Bucket>) +
+                                                       2 * sizeof(void*));
+            }
+        }
     }
-    return it->second.rulesById.size();
+
+    // The published tables only; a view still held by a reader is not counted
+    size_t compiledBytes = 0;
+    size_t emcBytes = 0;
+    for (const auto& [dpid, sw] : impl_->loadView()->switches)
+    {
+        (void)dpid;
+        for (const auto& [tableId, table] : sw->tables)
+        {
+            (void)tableId;
+            compiledBytes += table->memoryBytes();
+        }
+        emcBytes += sw->emc->memoryBytes();
+    }
+
+    utils::MemoryUsage usage;
+    usage.add("rules", ruleBytes)
+        .add("subtables", subtableBytes)
+        .add("effects", impl_->effectIntern.memoryBytes())
+        .add("masks", impl_->maskIntern.memoryBytes())
+        .add("compiled_tables", compiledBytes)
+        .add("exact_match_cache", emcBytes)
+        .per("rule", rules);
+    return usage;
 }
 
 } // namespace ndtClassifier
@@ -0,0 +1,303 @@
+#include "ndt_core/collection/ClusterLink.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sflow
+{
+
+namespace
+{
+
+constexpr size_t HEADER_SIZE = 16; // magic, version, reserved, count, base time
+constexpr size_t FLOW_RECORD_SIZE = 44;
+constexpr size_t COUNTER_RECORD_SIZE = 43;
+constexpr uint8_t KIND_COUNTER = 0;
+constexpr uint8_t KIND_FLOW = 1;
+constexpr uint8_t FLAG_ACK = 0x01;
+
+void
+putBig(std::string& out, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i-- > 0;)
+    {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Reads big-endian fields of a message front to back; bounds are checked once per record
+class Reader
+{
+  public:
+    Reader(const char* data, size_t length)
+        : m_data(reinterpret_cast<const uint8_t*>(data)),
+          m_left(length)
+    {
+    }
+
+    bool has(size_t bytes) const
+    {
+        return m_left >= bytes;
+    }
+
+    uint64_t get(size_t bytes)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            value = value << 8 | m_data[i];
+        }
+        m_data += bytes;
+        m_left -= bytes;
+        return value;
+    }
+
+  private:
+    const uint8_t* m_data;
+    size_t m_left;
+};
+
+void
+putHeader(std::string& out, int64_t baseMs)
+{
+    putBig(out, CLUSTER_MAGIC, 4);
+    putBig(out, CLUSTER_VERSION, 1);
+    putBig(out, 0, 1);
+    putBig(out, 0, 2); // count, patched when the message is full
+    putBig(out, static_cast<uint64_t>(baseMs), 8);
+}
+
+void
+putRecord(std::string& out, const IngestRecord& record, int64_t baseMs)
+{
+    const bool flow = std::holds_alternative<FlowSampleRecord>(record.sample);
+    putBig(out, flow ? KIND_FLOW : KIND_COUNTER, 1);
+    putBig(out, ntohl(record.agentIp), 4);
+    putBig(out, static_cast<uint32_t>(record.time.systemMs - baseMs), 4);
+    if (flow)
+    {
+        const auto& rec = std::get<FlowSampleRecord>(record.sample);
+        putBig(out, rec.sampleType, 1);
+        putBig(out, rec.samplingRate, 4);
+        putBig(out, rec.inputPort, 4);
+        putBig(out, rec.outputPort, 4);
+        putBig(out, rec.frameLength, 4);
+        putBig(out, rec.etherType, 2);
+        putBig(out, rec.protocol, 1);
+        putBig(out, rec.isAck ? FLAG_ACK : 0, 1);
+        putBig(out, ntohl(rec.srcIp), 4);
+        putBig(out, ntohl(rec.dstIp), 4);
+        putBig(out, rec.srcPort, 2);
+        putBig(out, rec.dstPort, 2);
+        putBig(out, rec.icmpType, 1);
+        putBig(out, rec.icmpCode, 1);
+    }
+    else
+    {
+        const auto& rec = std::get<CounterSampleRecord>(record.sample);
+        putBig(out, rec.sampleType, 1);
+        putBig(out, rec.sampleLength, 4);
+        putBig(out, rec.interfaceIndex, 4);
+        putBig(out, rec.interfaceStatus, 1);
+        putBig(out, rec.interfaceSpeed, 8);
+        putBig(out, rec.inputOctets, 8);
+        putBig(out, rec.outputOctets, 8);
+    }
+}
+
+} // namespace
+
+void
+encodeClusterMessages(const std::vector<IngestRecord>& records, std::vector<std::string>& out)
+{
+    constexpr size_t maxRecord = std::max(FLOW_RECORD_SIZE, COUNTER_RECORD_SIZE);
+    std::string* message = nullptr;
+    int64_t baseMs = 0;
+    uint16_t count = 0;
+    auto finish = [&] {
+        if (message != nullptr)
+        {
+            (*message)[6] = static_cast<char>(count >> 8);
+            (*message)[7] = static_cast<char>(count);
+        }
+    };
+    for (const auto& record : records)
+    {
+        if (message == nullptr || message->size() + maxRecord > CLUSTER_MESSAGE_SIZE)
+        {
+            finish();
+            message = &out.emplace_back();
+            message->reserve(CLUSTER_MESSAGE_SIZE);
+            baseMs = record.time.systemMs;
+            count = 0;
+            putHeader(*message, baseMs);
+        }
+        putRecord(*message, record, baseMs);
+        ++count;
+    }
+    finish();
+}
+
+bool
+decodeClusterMessage(const char* data, size_t length, std::vector<IngestRecord>& out)
+{
+    Reader in(data, length);
+    if (!in.has(HEADER_SIZE) || in.get(4) != CLUSTER_MAGIC || in.get(1) != CLUSTER_VERSION)
+    {
+        return false;
+    }
+    in.get(1);
+    const size_t count = in.get(2);
+    const int64_t baseMs = static_cast<int64_t>(in.get(8));
+
+    // The sender's system clock is only trusted for the age of the sample
+    const int64_t nowSystemMs = utils::getCurrentTimeMillisSystemClock();
+    const int64_t nowSteadyMs = utils::getCurrentTimeMillisSteadyClock();
+    const size_t first = out.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!in.has(9))
+        {
+            out.resize(first);
+            return false;
+        }
+        IngestRecord record;
+        const uint8_t kind = static_cast<uint8_t>(in.get(1));
+        record.agentIp = htonl(static_cast<uint32_t>(in.get(4)));
+        const int64_t systemMs = baseMs + static_cast<int32_t>(in.get(4));
+        const int64_t ageMs = std::max<int64_t>(nowSystemMs - systemMs, 0);
+        record.time = {nowSteadyMs - ageMs, nowSystemMs - ageMs};
+
+        if (kind == KIND_FLOW && in.has(FLOW_RECORD_SIZE - 9))
+        {
+            FlowSampleRecord rec;
+            rec.sampleType = static_cast<uint32_t>(in.get(1));
+            rec.samplingRate = static_cast<uint32_t>(in.get(4));
+            rec.inputPort = static_cast<uint32_t>(in.get(4));
+            rec.outputPort = static_cast<uint32_t>(in.get(4));
+            rec.frameLength = static_cast<uint32_t>(in.get(4));
+            rec.etherType = static_cast<uint16_t>(in.get(2));
+            rec.protocol = static_cast<uint8_t>(in.get(1));
+            rec.isAck = (in.get(1) & FLAG_ACK) != 0;
+            rec.srcIp = htonl(static_cast<uint32_t>(in.get(4)));
+            rec.dstIp = htonl(static_cast<uint32_t>(in.get(4)));
+            rec.srcPort = static_cast<uint16_t>(in.get(2));
+            rec.dstPort = static_cast<uint16_t>(in.get(2));
+            rec.icmpType = static_cast<uint16_t>(in.get(1));
+            rec.icmpCode = static_cast<uint16_t>(in.get(1));
+            record.sample = rec;
+        }
+        else if (kind == KIND_COUNTER && in.has(COUNTER_RECORD_SIZE - 9))
+        {
+            CounterSampleRecord rec;
+            rec.sampleType = static_cast<uint32_t>(in.get(1));
+            rec.sampleLength = static_cast<uint32_t>(in.get(4));
+            rec.interfaceIndex = static_cast<uint32_t>(in.get(4));
+            rec.interfaceStatus = static_cast<uint32_t>(in.get(1));
+            rec.interfaceSpeed = in.get(8);
+            rec.inputOctets = in.get(8);
+            rec.outputOctets = in.get(8);
+            record.sample = rec;
+        }
+        else
+        {
+            out.resize(first);
+            return false;
+        }
+        out.push_back(std::move(record));
+    }
+    return true;
+}
+
+ClusterForwarder::ClusterForwarder(std::string coordinator)
+    : m_coordinator(std::move(coordinator))
+{
+}
+
+ClusterForwarder::~ClusterForwarder()
+{
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+bool
+ClusterForwarder::open()
+{
+    const size_t colon = m_coordinator.rfind(':');
+    if (colon == std::string::npos)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Cluster: bad coordinator '{}'", m_coordinator);
+        return false;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    const std::string host = m_coordinator.substr(0, colon);
+    const std::string port = m_coordinator.substr(colon + 1);
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Cluster: cannot resolve '{}'", m_coordinator);
+        return false;
+    }
+    for (addrinfo* ai = result; ai && m_fd < 0; ai = ai->ai_next)
+    {
+        m_fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (m_fd >= 0 && ::connect(m_fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (m_fd < 0)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Cluster: cannot reach '{}'", m_coordinator);
+        return false;
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Forwarding decoded sFlow to {}", m_coordinator);
+    return true;
+}
+
+void
+ClusterForwarder::send(const std::vector<IngestRecord>& records)
+{
+    if (records.empty())
+    {
+        return;
+    }
+    thread_local std::vector<std::string> messages;
+    messages.clear();
+    encodeClusterMessages(records, messages);
+    for (const auto& message : messages)
+    {
+        if (m_fd < 0 || ::send(m_fd, message.data(), message.size(), MSG_DONTWAIT) < 0)
+        {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        m_messages.fetch_add(1, std::memory_order_relaxed);
+        m_bytes.fetch_add(message.size(), std::memory_order_relaxed);
+    }
+    m_records.fetch_add(records.size(), std::memory_order_relaxed);
+}
+
+nlohmann::json
+ClusterForwarder::statsJson() const
+{
+    return {{"coordinator", m_coordinator},
+            {"messages", m_messages.load(std::memory_order_relaxed)},
+            {"records", m_records.load(std::memory_order_relaxed)},
+            {"bytes", m_bytes.load(std::memory_order_relaxed)},
+            {"errors", m_errors.load(std::memory_order_relaxed)}};
+}
+
+} // namespace sflow
@@ -0,0 +1,391 @@
+#include "ndt_core/collection/CollectorCheckpoint.hpp"
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace sflow
+{
+
+namespace
+{
+
+constexpr uint8_t TAG_FLOW = 'F';
+constexpr uint8_t TAG_REMOVED = 'X';
+constexpr uint8_t TAG_COUNTER = 'C';
+constexpr uint8_t TAG_RULES = 'R';
+constexpr uint8_t TAG_END = 'E';
+
+constexpr uint8_t FLAG_ELEPHANT_PERIODICALLY = 0x01;
+constexpr uint8_t FLAG_ELEPHANT_IMMEDIATELY = 0x02;
+constexpr uint8_t FLAG_ACK = 0x04;
+constexpr uint8_t FLAG_PURE_ACK = 0x08;
+
+constexpr uint16_t HEADER_DELTA = 0x0001;
+constexpr size_t HEADER_SIZE = 32;
+constexpr size_t TRAILER_SIZE = 5; // end tag and checksum
+
+void
+putBig(std::string& out, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i-- > 0;)
+    {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void
+putKey(std::string& out, const FlowKey& key)
+{
+    putBig(out, key.srcIP, 4); // as stored, in network order
+    putBig(out, key.dstIP, 4);
+    putBig(out, key.srcPort, 2);
+    putBig(out, key.dstPort, 2);
+    putBig(out, key.protocol, 1);
+    putBig(out, key.icmpType, 2);
+    putBig(out, key.icmpCode, 2);
+}
+
+// Reads big-endian fields front to back; a read past the end yields 0 and fails the reader
+class Reader
+{
+  public:
+    Reader(const char* data, size_t length)
+        : m_data(reinterpret_cast<const uint8_t*>(data)),
+          m_left(length)
+    {
+    }
+
+    bool ok() const
+    {
+        return m_ok;
+    }
+
+    bool atEnd() const
+    {
+        return m_left == 0;
+    }
+
+    uint64_t get(size_t bytes)
+    {
+        if (m_left < bytes)
+        {
+            m_ok = false;
+            m_left = 0;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            value = value << 8 | m_data[i];
+        }
+        m_data += bytes;
+        m_left -= bytes;
+        return value;
+    }
+
+    const uint8_t* take(size_t bytes)
+    {
+        if (m_left < bytes)
+        {
+            m_ok = false;
+            m_left = 0;
+            return nullptr;
+        }
+        const uint8_t* data = m_data;
+        m_data += bytes;
+        m_left -= bytes;
+        return data;
+    }
+
+    FlowKey key()
+    {
+        FlowKey key{};
+        key.srcIP = static_cast<uint32_t>(get(4));
+        key.dstIP = static_cast<uint32_t>(get(4));
+        key.srcPort = static_cast<uint16_t>(get(2));
+        key.dstPort = static_cast<uint16_t>(get(2));
+        key.protocol = static_cast<uint8_t>(get(1));
+        key.icmpType = static_cast<uint16_t>(get(2));
+        key.icmpCode = static_cast<uint16_t>(get(2));
+        return key;
+    }
+
+  private:
+    const uint8_t* m_data;
+    size_t m_left;
+    bool m_ok = true;
+};
+
+uint32_t
+checksum(const char* data, size_t length)
+{
+    return static_cast<uint32_t>(
+        crc32(0L, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(length)));
+}
+
+} // namespace
+
+CheckpointWriter::CheckpointWriter(const CheckpointHeader& header)
+{
+    putBig(m_buffer, CHECKPOINT_MAGIC, 4);
+    putBig(m_buffer, CHECKPOINT_VERSION, 2);
+    putBig(m_buffer, header.delta ? HEADER_DELTA : 0, 2);
+    putBig(m_buffer, static_cast<uint64_t>(header.savedSystemMs), 8);
+    putBig(m_buffer, static_cast<uint64_t>(header.savedSteadyMs), 8);
+    putBig(m_buffer, header.topologyFingerprint, 8);
+}
+
+void
+CheckpointWriter::addFlow(const FlowKey& key, const FlowInfo& info)
+{
+    putBig(m_buffer, TAG_FLOW, 1);
+    putKey(m_buffer, key);
+    putKey(m_buffer, info.sampleKey);
+    putBig(m_buffer, static_cast<uint64_t>(info.startTime), 8);
+    putBig(m_buffer, static_cast<uint64_t>(info.endTime), 8);
+    // The immediate rates come from the sample windows: the stored fields are only kept up
+    // to date by flow_rates.immediate_sweep
+    const ImmediateRate immediate = info.immediateRate();
+    putBig(m_buffer, info.estimatedFlowSendingRatePeriodically, 8);
+    putBig(m_buffer, immediate.bps, 8);
+    putBig(m_buffer, info.estimatedPacketSendingRatePeriodically, 8);
+    putBig(m_buffer, immediate.pps, 8);
+    putBig(m_buffer, info.reverseAckBytes, 8);
+    putBig(m_buffer, info.reverseAckPackets, 8);
+    uint8_t flags = 0;
+    flags |= info.isElephantFlowPeriodically ? FLAG_ELEPHANT_PERIODICALLY : 0;
+    flags |= immediate.bps >= MICE_FLOW_UNDER_THRESHOLD ? FLAG_ELEPHANT_IMMEDIATELY : 0;
+    flags |= info.isAck ? FLAG_ACK : 0;
+    flags |= info.isPureAck ? FLAG_PURE_ACK : 0;
+    putBig(m_buffer, flags, 1);
+
+    size_t agents = std::min<size_t>(info.agentFlowStats.size(), UINT8_MAX);
+    putBig(m_buffer, agents, 1);
+    for (const auto& [agentKey, stats] : info.agentFlowStats)
+    {
+        if (agents-- == 0)
+        {
+            break;
+        }
+        putBig(m_buffer, agentKey.agentIP, 4);
+        putBig(m_buffer, agentKey.interfacePort, 4);
+        putBig(m_buffer, stats.ingressByteCountCurrent, 8);
+        putBig(m_buffer, stats.egressByteCountCurrent, 8);
+        putBig(m_buffer, stats.ingressByteCountPrevious, 8);
+        putBig(m_buffer, stats.egressByteCountPrevious, 8);
+        putBig(m_buffer, stats.ingresspacketCountCurrent, 8);
+        putBig(m_buffer, stats.egresspacketCountCurrent, 8);
+        putBig(m_buffer, stats.ingresspacketCountPrevious, 8);
+        putBig(m_buffer, stats.egresspacketCountPrevious, 8);
+        putBig(m_buffer, stats.avgByteRateInBps, 8);
+        putBig(m_buffer, stats.avgPacketRate, 8);
+        putBig(m_buffer, stats.samplingRate, 4);
+    }
+}
+
+void
+CheckpointWriter::addRemovedFlow(const FlowKey& key)
+{
+    putBig(m_buffer, TAG_REMOVED, 1);
+    putKey(m_buffer, key);
+}
+
+void
+CheckpointWriter::addCounter(uint64_t key, const CounterInfo& info)
+{
+    putBig(m_buffer, TAG_COUNTER, 1);
+    putBig(m_buffer, key, 8);
+    putBig(m_buffer, static_cast<uint64_t>(info.lastReportTimestampInMilliseconds), 8);
+    putBig(m_buffer, info.lastReceivedInputOctets, 8);
+    putBig(m_buffer, info.lastReceivedOutputOctets, 8);
+    putBig(m_buffer, info.inputByteCountOnALinkMultiplySampingRate, 8);
+    putBig(m_buffer, info.outputByteCountOnALink, 8);
+}
+
+void
+CheckpointWriter::addRules(const nlohmann::json& tables)
+{
+    const std::vector<uint8_t> cbor = nlohmann::json::to_cbor(tables);
+    putBig(m_buffer, TAG_RULES, 1);
+    putBig(m_buffer, cbor.size(), 4);
+    m_buffer.append(cbor.begin(), cbor.end());
+}
+
+std::string
+CheckpointWriter::finish() const
+{
+    std::string file = m_buffer;
+    putBig(file, TAG_END, 1);
+    putBig(file, checksum(file.data(), file.size()), 4);
+    return file;
+}
+
+size_t
+CheckpointWriter::commit(const std::string& path)
+{
+    const std::string file = finish();
+
+    const std::string temporary = path + ".tmp";
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        SPDLOG_LOGGER_ERROR(
+            Logger::instance(), "Checkpoint: cannot create {}: {}", temporary, strerror(errno));
+        return 0;
+    }
+    size_t written = 0;
+    while (written < file.size())
+    {
+        const ssize_t n = ::write(fd, file.data() + written, file.size() - written);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    const bool synced = written == file.size() && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!synced || ::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        SPDLOG_LOGGER_ERROR(
+            Logger::instance(), "Checkpoint: cannot write {}: {}", path, strerror(errno));
+        ::unlink(temporary.c_str());
+        return 0;
+    }
+    return file.size();
+}
+
+std::optional<Checkpoint>
+decodeCheckpoint(const std::string& data, std::string& error)
+{
+    if (data.size() < HEADER_SIZE + TRAILER_SIZE ||
+        static_cast<uint8_t>(data[data.size() - TRAILER_SIZE]) != TAG_END)
+    {
+        error = "truncated";
+        return std::nullopt;
+    }
+    Reader tail(data.data() + data.size() - 4, 4);
+    if (tail.get(4) != checksum(data.data(), data.size() - 4))
+    {
+        error = "corrupt";
+        return std::nullopt;
+    }
+
+    Reader r(data.data(), data.size() - TRAILER_SIZE);
+    if (r.get(4) != CHECKPOINT_MAGIC || r.get(2) != CHECKPOINT_VERSION)
+    {
+        error = "of another version";
+        return std::nullopt;
+    }
+    Checkpoint checkpoint;
+    checkpoint.header.delta = (r.get(2) & HEADER_DELTA) != 0;
+    checkpoint.header.savedSystemMs = static_cast<int64_t>(r.get(8));
+    checkpoint.header.savedSteadyMs = static_cast<int64_t>(r.get(8));
+    checkpoint.header.topologyFingerprint = r.get(8);
+
+    while (r.ok() && !r.atEnd())
+    {
+        const uint8_t tag = static_cast<uint8_t>(r.get(1));
+        if (tag == TAG_FLOW)
+        {
+            auto& [key, info] = checkpoint.flows.emplace_back();
+            key = r.key();
+            info.sampleKey = r.key();
+            info.startTime = static_cast<int64_t>(r.get(8));
+            info.endTime = static_cast<int64_t>(r.get(8));
+            info.estimatedFlowSendingRatePeriodically = r.get(8);
+            info.estimatedFlowSendingRateImmediately = r.get(8);
+            info.estimatedPacketSendingRatePeriodically = r.get(8);
+            info.estimatedPacketSendingRateImmediately = r.get(8);
+            info.reverseAckBytes = r.get(8);
+            info.reverseAckPackets = r.get(8);
+            const uint8_t flags = static_cast<uint8_t>(r.get(1));
+            info.isElephantFlowPeriodically = flags & FLAG_ELEPHANT_PERIODICALLY;
+            info.isElephantFlowImmediately = flags & FLAG_ELEPHANT_IMMEDIATELY;
+            info.isAck = flags & FLAG_ACK;
+            info.isPureAck = flags & FLAG_PURE_ACK;
+            const size_t agents = r.get(1);
+            for (size_t i = 0; i < agents && r.ok(); ++i)
+            {
+                AgentKey agentKey{};
+                agentKey.agentIP = static_cast<uint32_t>(r.get(4));
+                agentKey.interfacePort = static_cast<uint32_t>(r.get(4));
+                FlowStats& stats = info.agentFlowStats[agentKey];
+                stats.ingressByteCountCurrent = r.get(8);
+                stats.egressByteCountCurrent = r.get(8);
+                stats.ingressByteCountPrevious = r.get(8);
+                stats.egressByteCountPrevious = r.get(8);
+                stats.ingresspacketCountCurrent = r.get(8);
+                stats.egresspacketCountCurrent = r.get(8);
+                stats.ingresspacketCountPrevious = r.get(8);
+                stats.egresspacketCountPrevious = r.get(8);
+                stats.avgByteRateInBps = r.get(8);
+                stats.avgPacketRate = r.get(8);
+                stats.samplingRate = static_cast<uint32_t>(r.get(4));
+            }
+        }
+        else if (tag == TAG_REMOVED)
+        {
+            checkpoint.removed.push_back(r.key());
+        }
+        else if (tag == TAG_COUNTER)
+        {
+            auto& [key, info] = checkpoint.counters.emplace_back();
+            key = r.get(8);
+            info.lastReportTimestampInMilliseconds = static_cast<int64_t>(r.get(8));
+            info.lastReceivedInputOctets = r.get(8);
+            info.lastReceivedOutputOctets = r.get(8);
+            info.inputByteCountOnALinkMultiplySampingRate = r.get(8);
+            info.outputByteCountOnALink = r.get(8);
+        }
+        else if (tag == TAG_RULES)
+        {
+            const size_t length = r.get(4);
+            if (const uint8_t* cbor = r.take(length))
+            {
+                checkpoint.rules = nlohmann::json::from_cbor(cbor, cbor + length, true, false);
+            }
+        }
+        else
+        {
+            break; // unknown tag: the rest cannot be framed
+        }
+    }
+    if (!r.ok() || !r.atEnd() || checkpoint.rules.is_discarded())
+    {
+        error = "malformed";
+        return std::nullopt;
+    }
+    return checkpoint;
+}
+
+std::optional<Checkpoint>
+readCheckpoint(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return std::nullopt;
+    }
+    const std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string error;
+    std::optional<Checkpoint> checkpoint = decodeCheckpoint(file, error);
+    if (!checkpoint)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Checkpoint {} is {}; ignored", path, error);
+    }
+    return checkpoint;
+}
+
+} // namespace sflow
@@ -0,0 +1,73 @@
+#include "ndt_core/collection/CongestionIndex.hpp"
+
+static_assert(CONGESTION_BUCKETS <= 256, "bucket numbers are stored in a uint8_t");
+
+void
+CongestionIndex::reset(size_t edges)
+{
+    std::lock_guard lock(m_mutex);
+    for (auto& bucket : m_buckets)
+    {
+        bucket.clear();
+    }
+    m_bucketOf = std::make_unique<std::atomic<uint8_t>[]>(edges);
+    m_position.resize(edges);
+    m_size = edges;
+    m_buckets[0].reserve(edges);
+    for (size_t id = 0; id < edges; ++id)
+    {
+        m_position[id] = static_cast<uint32_t>(id);
+        m_buckets[0].push_back(static_cast<EdgeId>(id));
+    }
+}
+
+bool
+CongestionIndex::update(EdgeId id, double utilization)
+{
+    if (id >= m_size)
+    {
+        return false;
+    }
+    const size_t bucket = bucketOf(utilization);
+    if (m_bucketOf[id].load(std::memory_order_relaxed) == bucket)
+    {
+        return false;
+    }
+
+    std::lock_guard lock(m_mutex);
+    // Re-read under the lock: another update of the edge may have moved it meanwhile
+    const size_t old = m_bucketOf[id].load(std::memory_order_relaxed);
+    if (old == bucket)
+    {
+        return false;
+    }
+    auto& from = m_buckets[old];
+    const EdgeId last = from.back();
+    from[m_position[id]] = last;
+    m_position[last] = m_position[id];
+    from.pop_back();
+
+    m_position[id] = static_cast<uint32_t>(m_buckets[bucket].size());
+    m_buckets[bucket].push_back(id);
+    m_bucketOf[id].store(static_cast<uint8_t>(bucket), std::memory_order_relaxed);
+    return (old >= CONGESTION_HOTSPOT_PERCENT) != (bucket >= CONGESTION_HOTSPOT_PERCENT);
+}
+
+bool
+CongestionIndex::isHotspot(EdgeId id) const
+{
+    return id < m_size &&
+           m_bucketOf[id].load(std::memory_order_relaxed) >= CONGESTION_HOTSPOT_PERCENT;
+}
+
+size_t
+CongestionIndex::memoryBytes() const
+{
+    std::lock_guard lock(m_mutex);
+    size_t bytes = m_size * sizeof(std::atomic<uint8_t>) + m_position.capacity() * sizeof(uint32_t);
+    for (const auto& bucket : m_buckets)
+    {
+        bytes += bucket.capacity() * sizeof(EdgeId);
+    }
+    return bytes;
+}
@@ -0,0 +1,156 @@
+#include "ndt_core/collection/CsrGraph.hpp"
+#include "utils/MemoryAccounting.hpp"
+#include <algorithm>
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/range/iterator_range.hpp>
+
+CsrGraph
+CsrGraph::build(const Graph& graph)
+{
+    CsrGraph csr;
+    const size_t vertexCount = boost::num_vertices(graph);
+    const size_t edgeCount = boost::num_edges(graph);
+
+    csr.m_vertexDpid.reserve(vertexCount);
+    csr.m_vertexFlags.reserve(vertexCount);
+    for (VertexId v = 0; v < vertexCount; ++v)
+    {
+        const auto& props = graph[v];
+        csr.m_vertexDpid.push_back(props.dpid);
+        csr.m_vertexFlags.push_back((props.isUp ? UP : 0) | (props.isEnabled ? ENABLED : 0) |
+                                    (props.vertexType == VertexType::SWITCH ? SWITCH : 0));
+        if (props.vertexType == VertexType::SWITCH)
+        {
+            csr.m_switchByDpid.emplace_back(props.dpid, v);
+        }
+    }
+    // Stable, so the first switch of a dpid in vertex order is found first
+    std::stable_sort(csr.m_switchByDpid.begin(),
+                     csr.m_switchByDpid.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    csr.m_outOffsets.reserve(vertexCount + 1);
+    csr.m_source.reserve(edgeCount);
+    csr.m_target.reserve(edgeCount);
+    csr.m_descriptor.reserve(edgeCount);
+    for (VertexId v = 0; v < vertexCount; ++v)
+    {
+        csr.m_outOffsets.push_back(static_cast<EdgeId>(csr.m_target.size()));
+        const size_t first = csr.m_target.size();
+        for (auto e : boost::make_iterator_range(boost::out_edges(v, graph)))
+        {
+            csr.m_source.push_back(v);
+            csr.m_target.push_back(static_cast<VertexId>(boost::target(e, graph)));
+            csr.m_descriptor.push_back(e);
+        }
+        // setS already yields targets in order; findEdge() relies on it
+        if (!std::is_sorted(csr.m_target.begin() + first, csr.m_target.end()))
+        {
+            std::vector<std::pair<VertexId, Graph::edge_descriptor>> out;
+            for (size_t i = first; i < csr.m_target.size(); ++i)
+            {
+                out.emplace_back(csr.m_target[i], csr.m_descriptor[i]);
+            }
+            std::stable_sort(out.begin(), out.end(), [](const auto& a, const auto& b) {
+                return a.first < b.first;
+            });
+            for (size_t i = 0; i < out.size(); ++i)
+            {
+                csr.m_target[first + i] = out[i].first;
+                csr.m_descriptor[first + i] = out[i].second;
+            }
+        }
+    }
+    csr.m_outOffsets.push_back(static_cast<EdgeId>(csr.m_target.size()));
+
+    const size_t count = csr.m_target.size();
+    csr.m_edgeFlags.reserve(count);
+    csr.m_srcInterface.reserve(count);
+    csr.m_dstInterface.reserve(count);
+    csr.m_linkBandwidth.reserve(count);
+    csr.m_linkBandwidthUsage.reserve(count);
+    csr.m_leftBandwidth.reserve(count);
+    csr.m_utilization.reserve(count);
+    csr.m_flowCount.reserve(count);
+    for (const auto& descriptor : csr.m_descriptor)
+    {
+        const auto& props = graph[descriptor];
+        csr.m_edgeFlags.push_back((props.isUp ? UP : 0) | (props.isEnabled ? ENABLED : 0));
+        csr.m_srcInterface.push_back(props.srcInterface);
+        csr.m_dstInterface.push_back(props.dstInterface);
+        csr.m_linkBandwidth.push_back(props.linkBandwidth);
+        csr.m_linkBandwidthUsage.push_back(props.linkBandwidthUsage);
+        csr.m_leftBandwidth.push_back(props.leftBandwidth);
+        csr.m_utilization.push_back(props.linkBandwidthUtilization);
+        csr.m_flowCount.push_back(static_cast<uint32_t>(props.flowSet.size()));
+    }
+
+    csr.m_reverse.reserve(count);
+    for (EdgeId e = 0; e < count; ++e)
+    {
+        csr.m_reverse.push_back(
+            csr.findEdge(csr.m_target[e], csr.m_source[e]).value_or(NO_EDGE));
+    }
+
+    // In-edges by counting sort on the target, which keeps them by increasing id
+    csr.m_inOffsets.assign(vertexCount + 1, 0);
+    for (VertexId target : csr.m_target)
+    {
+        ++csr.m_inOffsets[target + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        csr.m_inOffsets[v + 1] += csr.m_inOffsets[v];
+    }
+    csr.m_inEdges.resize(count);
+    std::vector<EdgeId> fill(csr.m_inOffsets.begin(), csr.m_inOffsets.end() - 1);
+    for (EdgeId e = 0; e < count; ++e)
+    {
+        csr.m_inEdges[fill[csr.m_target[e]]++] = e;
+    }
+    return csr;
+}
+
+std::optional<CsrGraph::VertexId>
+CsrGraph::switchByDpid(uint64_t dpid) const
+{
+    auto it = std::lower_bound(m_switchByDpid.begin(),
+                               m_switchByDpid.end(),
+                               dpid,
+                               [](const auto& entry, uint64_t key) { return entry.first < key; });
+    if (it == m_switchByDpid.end() || it->first != dpid)
+    {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::optional<CsrGraph::EdgeId>
+CsrGraph::findEdge(VertexId u, VertexId v) const
+{
+    if (u >= vertexCount())
+    {
+        return std::nullopt;
+    }
+    auto first = m_target.begin() + m_outOffsets[u];
+    auto last = m_target.begin() + m_outOffsets[u + 1];
+    auto it = std::lower_bound(first, last, v);
+    if (it == last || *it != v)
+    {
+        return std::nullopt;
+    }
+    return static_cast<EdgeId>(it - m_target.begin());
+}
+
+size_t
+CsrGraph::memoryBytes() const
+{
+    using utils::heapBytes;
+    return heapBytes(m_vertexDpid) + heapBytes(m_vertexFlags) + heapBytes(m_outOffsets) +
+           heapBytes(m_inOffsets) + heapBytes(m_inEdges) + heapBytes(m_switchByDpid) +
+           heapBytes(m_source) + heapBytes(m_target) + heapBytes(m_reverse) +
+           heapBytes(m_edgeFlags) + heapBytes(m_srcInterface) + heapBytes(m_dstInterface) +
+           heapBytes(m_linkBandwidth) + heapBytes(m_linkBandwidthUsage) +
+           heapBytes(m_leftBandwidth) + heapBytes(m_utilization) + heapBytes(m_flowCount) +
+           heapBytes(m_descriptor);
+}
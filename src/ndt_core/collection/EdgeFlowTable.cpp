@@ -0,0 +1,263 @@
+#include "ndt_core/collection/EdgeFlowTable.hpp"
+#include "utils/MemoryAccounting.hpp"
+#include <algorithm>
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <mutex>
+
+void
+EdgeFlowTable::reset(const Graph& graph)
+{
+    size_t size = 0;
+    for (auto e : boost::make_iterator_range(boost::edges(graph)))
+    {
+        size = std::max<size_t>(size, graph[e].statsId + 1);
+    }
+
+    m_buckets = std::make_unique<Bucket[]>(size);
+    m_size = size;
+    m_vertexCount = boost::num_vertices(graph);
+    m_flowsInto = std::make_unique<std::atomic<uint64_t>[]>(m_vertexCount);
+    for (auto e : boost::make_iterator_range(boost::edges(graph)))
+    {
+        m_buckets[graph[e].statsId].target = static_cast<uint32_t>(boost::target(e, graph));
+    }
+    const uint64_t generation = m_generation.load(std::memory_order_acquire);
+    const uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        m_buckets[i].generation = generation;
+        m_buckets[i].modifiedAt = epoch;
+    }
+}
+
+bool
+EdgeFlowTable::touch(EdgeId id, const sflow::FlowKey& key)
+{
+    if (id >= m_size)
+    {
+        return false;
+    }
+
+    Bucket& bucket = m_buckets[id];
+    uint64_t generation = m_generation.load(std::memory_order_acquire);
+    {
+        std::shared_lock lock(bucket.mutex);
+        if (bucket.generation == generation &&
+            bucket.sets[generation % GENERATIONS].contains(key))
+        {
+            return false;
+        }
+    }
+
+    std::unique_lock lock(bucket.mutex);
+    // rotate() may have swept this bucket past the generation read above
+    generation = std::max(generation, bucket.generation);
+    if (size_t dropped = catchUp(bucket, generation))
+    {
+        addExpired(bucket, dropped);
+        stamp(bucket);
+    }
+
+    FlowSet& current = bucket.sets[generation % GENERATIONS];
+    if (current.contains(key))
+    {
+        return false;
+    }
+    bool known = false;
+    for (size_t age = 1; age < GENERATIONS && age <= generation; ++age)
+    {
+        known |= bucket.sets[(generation - age) % GENERATIONS].erase(key) != 0;
+    }
+    current.insert(key);
+    if (known)
+    {
+        return false;
+    }
+    m_flowsInto[bucket.target].fetch_add(1, std::memory_order_relaxed);
+    stamp(bucket);
+    return true;
+}
+
+size_t
+EdgeFlowTable::rotate(TimePoint now)
+{
+    const uint64_t generation = m_generation.load(std::memory_order_relaxed) + 1;
+    m_generationStart[generation % GENERATIONS].store(now.time_since_epoch().count(),
+                                                      std::memory_order_relaxed);
+    m_generation.store(generation, std::memory_order_release);
+
+    size_t expired = 0;
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        Bucket& bucket = m_buckets[i];
+        {
+            // Buckets whose outgoing sets are all empty are left to catch up lazily
+            std::shared_lock lock(bucket.mutex);
+            size_t lag = std::min<size_t>(generation - bucket.generation, GENERATIONS);
+            bool anyExpired = false;
+            for (size_t step = 1; step <= lag && !anyExpired; ++step)
+            {
+                anyExpired = !bucket.sets[(bucket.generation + step) % GENERATIONS].empty();
+            }
+            if (!anyExpired)
+            {
+                continue;
+            }
+        }
+        std::unique_lock lock(bucket.mutex);
+        if (size_t dropped = catchUp(bucket, std::max(generation, bucket.generation)))
+        {
+            expired += dropped;
+            m_flowsInto[bucket.target].fetch_sub(dropped, std::memory_order_relaxed);
+            stamp(bucket);
+        }
+    }
+
+    uint64_t tickExpired = expired + m_pendingExpired.exchange(0, std::memory_order_relaxed);
+    m_lastTickExpired.store(tickExpired, std::memory_order_relaxed);
+    m_totalExpired.fetch_add(tickExpired, std::memory_order_relaxed);
+    return tickExpired;
+}
+
+size_t
+EdgeFlowTable::count(EdgeId id) const
+{
+    if (id >= m_size)
+    {
+        return 0;
+    }
+    const Bucket& bucket = m_buckets[id];
+    std::shared_lock lock(bucket.mutex);
+    size_t n = 0;
+    for (size_t age = 0; age < GENERATIONS; ++age)
+    {
+        if (isLive(bucket, age))
+        {
+            n += bucket.sets[(bucket.generation - age) % GENERATIONS].size();
+        }
+    }
+    return n;
+}
+
+std::set<sflow::FlowKey>
+EdgeFlowTable::flows(EdgeId id) const
+{
+    std::set<sflow::FlowKey> out;
+    if (id >= m_size)
+    {
+        return out;
+    }
+    const Bucket& bucket = m_buckets[id];
+    std::shared_lock lock(bucket.mutex);
+    for (size_t age = 0; age < GENERATIONS; ++age)
+    {
+        if (isLive(bucket, age))
+        {
+            const FlowSet& set = bucket.sets[(bucket.generation - age) % GENERATIONS];
+            out.insert(set.begin(), set.end());
+        }
+    }
+    return out;
+}
+
+uint64_t
+EdgeFlowTable::flowsInto(size_t vertex) const
+{
+    return vertex < m_vertexCount ? m_flowsInto[vertex].load(std::memory_order_relaxed) : 0;
+}
+
+void
+EdgeFlowTable::materialize(Graph& graph) const
+{
+    for (auto e : boost::make_iterator_range(boost::edges(graph)))
+    {
+        auto& ep = graph[e];
+        ep.flowSet.clear();
+        if (ep.statsId >= m_size)
+        {
+            continue;
+        }
+        const Bucket& bucket = m_buckets[ep.statsId];
+        std::shared_lock lock(bucket.mutex);
+        for (size_t age = 0; age < GENERATIONS; ++age)
+        {
+            if (!isLive(bucket, age))
+            {
+                continue;
+            }
+            const uint64_t generation = bucket.generation - age;
+            auto start = TimePoint::duration(
+                m_generationStart[generation % GENERATIONS].load(std::memory_order_relaxed));
+            for (const auto& key : bucket.sets[generation % GENERATIONS])
+            {
+                ep.flowSet.emplace(key, TimePoint(start));
+            }
+        }
+    }
+}
+
+void
+EdgeFlowTable::modifiedAt(std::vector<uint64_t>& out) const
+{
+    out.resize(m_size);
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        std::shared_lock lock(m_buckets[i].mutex);
+        out[i] = m_buckets[i].modifiedAt;
+    }
+}
+
+size_t
+EdgeFlowTable::catchUp(Bucket& bucket, uint64_t generation)
+{
+    size_t lag = std::min<size_t>(generation - bucket.generation, GENERATIONS);
+    size_t dropped = 0;
+    for (size_t step = 1; step <= lag; ++step)
+    {
+        FlowSet& set = bucket.sets[(bucket.generation + step) % GENERATIONS];
+        dropped += set.size();
+        set.clear();
+    }
+    bucket.generation = generation;
+    return dropped;
+}
+
+bool
+EdgeFlowTable::isLive(const Bucket& bucket, size_t age) const
+{
+    if (age > bucket.generation)
+    {
+        return false;
+    }
+    return bucket.generation - age + GENERATIONS > m_generation.load(std::memory_order_acquire);
+}
+
+void
+EdgeFlowTable::stamp(Bucket& bucket)
+{
+    bucket.modifiedAt = m_epoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+void
+EdgeFlowTable::addExpired(const Bucket& bucket, size_t n)
+{
+    m_pendingExpired.fetch_add(n, std::memory_order_relaxed);
+    m_flowsInto[bucket.target].fetch_sub(n, std::memory_order_relaxed);
+}
+
+size_t
+EdgeFlowTable::memoryBytes() const
+{
+    size_t bytes = m_size * sizeof(Bucket) + m_vertexCount * sizeof(std::atomic<uint64_t>);
+    for (size_t id = 0; id < m_size; ++id)
+    {
+        const Bucket& bucket = m_buckets[id];
+        std::shared_lock lock(bucket.mutex);
+        for (const FlowSet& set : bucket.sets)
+        {
+            bytes += utils::heapBytes(set);
+        }
+    }
+    return bytes;
+}
@@ -1,9 +1,25 @@
 #include "ndt_core/collection/FlowLinkUsageCollector.hpp"
 #include "common_types/GraphTypes.hpp"
+#include "event_system/EventBus.hpp"
+#include "event_system/EventPayloads.hpp"
 #include "ndt_core/collection/Classifier.hpp"
+#include "ndt_core/collection/ClusterLink.hpp"
+#include "ndt_core/collection/CollectorCheckpoint.hpp"
+#include "ndt_core/collection/PacketRingCapture.hpp"
+#include "ndt_core/collection/SFlowDecoder.hpp"
+#include "ndt_core/collection/SamplingRateController.hpp"
+#include "ndt_core/collection/TelemetrySegmentWriter.hpp"
 #include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "ndt_core/collection/UringReceiver.hpp"
 #include "ndt_core/power_management/DeviceConfigurationAndPowerManager.hpp"
+#include "utils/CounterRates.hpp"
+#include "utils/FlightRecorder.hpp"
+#include "utils/HttpClient.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/OvsdbMonitor.hpp"
+#include "utils/RuntimeConfig.hpp"
+#include "utils/ThreadRegistry.hpp"
 #include "utils/Utils.hpp"
 #include <algorithm>
 #include <arpa/inet.h>
@@ -12,19 +28,24 @@
 #include <boost/graph/detail/edge.hpp>
 #include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <ctime>
 #include <errno.h>
 #include <exception>
 #include <fcntl.h>
+#include <functional>
 #include <initializer_list>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <netinet/in.h>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <poll.h>
+#include <pthread.h>
 #include <random>
+#include <sched.h>
 #include <set>
 #include <spdlog/spdlog.h>
 #include <sstream>
@@ -55,8 +76,7 @@ FlowLinkUsageCollector::FlowLinkUsageCollector(
     std::shared_ptr<EventBus> eventBus,
     int mode,
     std::shared_ptr<ndtClassifier::Classifier> classifier)
-    : m_sockfd(-1),
-      m_topologyAndFlowMonitor(std::move(topologyAndFlowMonitor)),
+    : m_topologyAndFlowMonitor(std::move(topologyAndFlowMonitor)),
       m_deviceConfigurationAndPowerManager(std::move(deviceManager)),
       m_eventBus(std::move(eventBus)),
       m_mode(static_cast<utils::DeploymentMode>(mode)),
@@ -69,6 +89,41 @@ FlowLinkUsageCollector::~FlowLinkUsageCollector()
     stop();
 }
 
+namespace
+{
+
+// The opposite direction of the TCP or UDP flow @p key
+FlowKey
+reversedKey(const FlowKey& key)
+{
+    FlowKey reverse = key;
+    std::swap(reverse.srcIP, reverse.dstIP);
+    std::swap(reverse.srcPort, reverse.dstPort);
+    return reverse;
+}
+
+// Time of a datagram the kernel stamped at @p receivedMs (system clock), moved onto the
+// steady clock by the offset between the two reads of @p batchTime
+IngestTime
+kernelIngestTime(int64_t receivedMs, const IngestTime& batchTime)
+{
+    IngestTime time;
+    // Never in the future: a clock step between the two must not reorder samples
+    time.systemMs = std::min(receivedMs, batchTime.systemMs);
+    time.steadyMs = batchTime.steadyMs - (batchTime.systemMs - time.systemMs);
+    return time;
+}
+
+// The sX-ethY ports of Mininet switches, without the local port (OFPP_LOCAL = 65534)
+bool
+isMininetSwitchPort(const std::string& name, uint32_t ifindex, uint32_t ofport)
+{
+    return ifindex > 0 && ofport > 0 && ofport != 65534 && name.rfind("s", 0) == 0 &&
+           name.find("-eth") != std::string::npos;
+}
+
+} // namespace
+
 std::string_view
 trim(std::string_view s)
 {
@@ -80,8 +135,7 @@ trim(std::string_view s)
 void
 FlowLinkUsageCollector::populateIfIndexToOfportMap()
 {
-    std::unique_lock lock(m_ifIndexMapMutex); // Lock for writing
-    m_ifIndexToOfportMap.clear();
+    auto map = std::make_shared<IfIndexMap>();
     SPDLOG_LOGGER_INFO(Logger::instance(), "Populating ifIndex to OFPort map...");
 
     FILE* pipe = popen("sudo ovs-vsctl list interface", "r");
@@ -115,12 +169,9 @@ FlowLinkUsageCollector::populateIfIndexToOfportMap()
             if (in_block && !temp_name_str.empty() && temp_ifindex > 0 && temp_ofport > 0 &&
                 temp_ofport != 65534)
             {
-                // We only care about ports that are not the "local" port (OFPP_LOCAL = 65534)
-                // And typically sX-ethY pattern
-                if (temp_name_str.rfind("s", 0) == 0 &&
-                    temp_name_str.find("-eth") != std::string::npos)
+                if (isMininetSwitchPort(temp_name_str, temp_ifindex, temp_ofport))
                 {
-                    m_ifIndexToOfportMap[temp_ifindex] = temp_ofport;
+                    (*map)[temp_ifindex] = temp_ofport;
                     SPDLOG_LOGGER_DEBUG(Logger::instance(),
                                         "Mapped ifIndex: {} to OFPort: {} for Name: {}",
                                         temp_ifindex,
@@ -210,9 +261,9 @@ FlowLinkUsageCollector::populateIfIndexToOfportMap()
     if (in_block && !temp_name_str.empty() && temp_ifindex > 0 && temp_ofport > 0 &&
         temp_ofport != 65534)
     {
-        if (temp_name_str.rfind("s", 0) == 0 && temp_name_str.find("-eth") != std::string::npos)
+        if (isMininetSwitchPort(temp_name_str, temp_ifindex, temp_ofport))
         {
-            m_ifIndexToOfportMap[temp_ifindex] = temp_ofport;
+            (*map)[temp_ifindex] = temp_ofport;
             SPDLOG_LOGGER_DEBUG(Logger::instance(),
                                 "Mapped ifIndex: {} to OFPort: {} for Name: {}",
                                 temp_ifindex,
@@ -250,1094 +301,4063 @@ FlowLinkUsageCollector::populateIfIndexToOfportMap()
     }
     SPDLOG_LOGGER_INFO(Logger::instance(),
                        "Finished populating ifIndex to OFPort map. Size: {}",
-                       m_ifIndexToOfportMap.size());
-    for (const auto& pair : m_ifIndexToOfportMap)
+                       map->size());
+    for (const auto& pair : *map)
     {
         SPDLOG_LOGGER_DEBUG(Logger::instance(),
                             "Final Map Entry: ifIndex {} -> OFPort {}",
                             pair.first,
                             pair.second);
     }
+    publishIfIndexMap(std::move(map));
 }
 
 void
-FlowLinkUsageCollector::start()
+FlowLinkUsageCollector::publishIfIndexMap(std::shared_ptr<const IfIndexMap> map)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Collector Starts Up");
+    // Shared by all instances, so a thread's cached version never matches another
+    // collector's map
+    static std::atomic<uint64_t> publishedMaps{0};
+
+    std::lock_guard lock(m_ifIndexMapMutex);
+    m_ifIndexToOfport = std::move(map);
+    m_ifIndexMapVersion.store(publishedMaps.fetch_add(1, std::memory_order_relaxed) + 1,
+                              std::memory_order_release);
+}
 
-    if (m_mode == utils::MININET)
+const FlowLinkUsageCollector::IfIndexMap&
+FlowLinkUsageCollector::ifIndexToOfport() const
+{
+    struct Cached
+    {
+        uint64_t version = 0;
+        std::shared_ptr<const IfIndexMap> map;
+    };
+    thread_local Cached cached;
+
+    const uint64_t version = m_ifIndexMapVersion.load(std::memory_order_acquire);
+    if (!cached.map || cached.version != version)
+    {
+        std::lock_guard lock(m_ifIndexMapMutex);
+        cached.map = m_ifIndexToOfport;
+        cached.version = version;
+    }
+    return *cached.map;
+}
+
+void
+FlowLinkUsageCollector::startIfIndexMap()
+{
+    utils::OvsdbMonitor& ovsdb = utils::OvsdbMonitor::instance();
+    if (!ovsdb.start())
     {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "OVSDB unreachable at {}, reading the port map from ovs-vsctl once",
+                           OVSDB_SOCKET_PATH);
         populateIfIndexToOfportMap();
+        return;
     }
+    // Ports that come and go are picked up as OVSDB reports them
+    m_ovsdbListener = ovsdb.subscribe([this](const utils::OvsdbState& state) {
+        auto map = std::make_shared<IfIndexMap>();
+        for (const auto& [uuid, interface] : state.interfaces)
+        {
+            if (isMininetSwitchPort(interface.name, interface.ifindex, interface.ofport))
+            {
+                (*map)[interface.ifindex] = interface.ofport;
+            }
+        }
+        SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                            "ifIndex to OFPort map from OVSDB update {}: {} ports",
+                            state.version,
+                            map->size());
+        publishIfIndexMap(std::move(map));
+    });
+}
 
-    // Call All Destination When Initialize
-    fetchAllDestinationPaths();
+void
+FlowLinkUsageCollector::setIngestConfig(const IngestConfig& config)
+{
+    if (m_running.load())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Ingest config changed while collector is running; ignored");
+        return;
+    }
+    m_ingestConfig = config;
+    if (m_ingestConfig.workerCount == 0)
+    {
+        m_ingestConfig.workerCount = 1;
+    }
+}
 
-    this->m_running.store(true);
-    m_pktRcvThread = thread(&FlowLinkUsageCollector::run, this);
-    m_calAvgFlowSendingRateThreadPeriodically =
-        thread(&FlowLinkUsageCollector::calAvgFlowSendingRatesPeriodically, this);
-    m_testCalAvgFlowSendingRatesRandomly =
-        thread(&FlowLinkUsageCollector::testCalAvgFlowSendingRatesRandomly, this);
-    m_purgeThread = thread(&FlowLinkUsageCollector::purgeIdleFlows, this);
-    // TODO
-    m_calFlowPathByQueried = thread(&FlowLinkUsageCollector::calFlowPathByQueried, this);
+void
+FlowLinkUsageCollector::setFlowTableLimits(const FlowTableLimits& limits)
+{
+    if (m_running.load())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Flow table limits changed while collector is running; ignored");
+        return;
+    }
+    m_flowTableLimits = limits;
 }
 
 void
-FlowLinkUsageCollector::stop()
+FlowLinkUsageCollector::setFlowAggregation(const FlowAggregationConfig& config)
 {
-    this->m_running.store(false);
+    if (m_running.load())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Flow aggregation changed while collector is running; ignored");
+        return;
+    }
+    m_aggregation = config;
+    m_aggregation.srcPrefixLength = std::min<uint8_t>(m_aggregation.srcPrefixLength, 32);
+    m_aggregation.dstPrefixLength = std::min<uint8_t>(m_aggregation.dstPrefixLength, 32);
+}
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Collector Stops");
+void
+FlowLinkUsageCollector::setBidirectionalFlows(bool enabled)
+{
+    if (m_running.load())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Bidirectional flows changed while collector is running; ignored");
+        return;
+    }
+    m_bidirectionalFlows = enabled;
+}
 
-    if (m_sockfd != -1)
+void
+FlowLinkUsageCollector::setFirstHopSampling(bool enabled)
+{
+    if (m_running.load())
     {
-        ::close(m_sockfd);
-        m_sockfd = -1;
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "First-hop sampling changed while collector is running; ignored");
+        return;
     }
-    if (m_pktRcvThread.joinable())
+    m_firstHopSampling = enabled;
+}
+
+void
+FlowLinkUsageCollector::setPathThreadCpus(std::vector<unsigned> cpus)
+{
+    if (m_running.load())
     {
-        m_pktRcvThread.join();
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Path thread CPUs changed while collector is running; ignored");
+        return;
     }
-    if (m_calAvgFlowSendingRateThreadPeriodically.joinable())
+    m_pathThreadCpus = std::move(cpus);
+}
+
+void
+FlowLinkUsageCollector::setFlowExportConfig(const FlowExportConfig& config)
+{
+    if (m_running.load())
     {
-        m_calAvgFlowSendingRateThreadPeriodically.join();
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Flow export config changed while collector is running; ignored");
+        return;
     }
-    if (m_testCalAvgFlowSendingRatesRandomly.joinable())
+    m_flowExporter.reset();
+    if (!config.directory.empty() || !config.ipfixCollector.empty())
     {
-        m_testCalAvgFlowSendingRatesRandomly.join();
+        m_flowExporter = std::make_unique<FlowRecordExporter>(config);
     }
-    if (m_purgeThread.joinable())
+}
+
+void
+FlowLinkUsageCollector::setTelemetrySegment(const std::string& name)
+{
+    if (m_running.load())
     {
-        m_purgeThread.join();
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Telemetry segment changed while collector is running; ignored");
+        return;
     }
-    if (m_calFlowPathByQueried.joinable())
+    m_telemetrySegment.reset();
+    if (!name.empty())
     {
-        m_calFlowPathByQueried.join();
+        m_telemetrySegment = std::make_unique<TelemetrySegmentWriter>(name);
     }
 }
 
 void
-FlowLinkUsageCollector::run()
+FlowLinkUsageCollector::setSamplingControl(const SamplingControlConfig& config)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Run");
+    if (m_running.load())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Sampling control changed while collector is running; ignored");
+        return;
+    }
+    m_samplingController.reset();
+    if (config.maxSamplesPerSecond > 0)
+    {
+        m_samplingController = std::make_unique<SamplingRateController>(config);
+    }
+}
 
-    // 1. Create UDP socket
-    m_sockfd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (m_sockfd < 0)
+void
+FlowLinkUsageCollector::setClusterConfig(const ClusterConfig& config)
+{
+    if (m_running.load())
     {
-        SPDLOG_LOGGER_ERROR(Logger::instance(), "socket() failed: {}", strerror(errno));
-        throw std::runtime_error("Failed to create UDP socket");
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Cluster config changed while collector is running; ignored");
+        return;
     }
+    m_clusterForwarder.reset();
+    if (!config.coordinator.empty())
+    {
+        m_clusterForwarder = std::make_unique<ClusterForwarder>(config.coordinator);
+    }
+    m_clusterListenPort = config.listenPort;
+}
 
-    // 2. Increase receive buffer
-    int rcvbuf = 4 * 1024 * 1024;
-    setsockopt(m_sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+void
+FlowLinkUsageCollector::setCheckpointPath(const std::string& path)
+{
+    if (m_running.load())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Checkpoint path changed while collector is running; ignored");
+        return;
+    }
+    m_checkpointPath = path;
+}
 
-    // 3. Allow address reuse
-    int reuse = 1;
-    setsockopt(m_sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+json
+FlowLinkUsageCollector::getIngestStatsJson() const
+{
+    json arr = json::array();
+    // start() builds the workers' stats before setting m_running; the API may be served first
+    const size_t workers = m_running.load() ? m_ingestStats.size() : 0;
+    for (size_t i = 0; i < workers; ++i)
+    {
+        const auto& stats = *m_ingestStats[i];
+        json worker = {{"worker", i},
+                       {"datagrams_received", stats.datagramsReceived.load()},
+                       {"bytes_received", stats.bytesReceived.load()},
+                       {"datagrams_truncated", stats.datagramsTruncated.load()},
+                       {"kernel_drops", stats.kernelDrops.load()},
+                       {"records_applied", stats.recordsApplied.load()},
+                       {"flow_samples_applied", stats.flowSamplesApplied.load()},
+                       {"flow_shard_locks", stats.flowShardLocks.load()},
+                       {"flow_samples_decoded", stats.flowSamplesDecoded.load()},
+                       {"counter_samples_decoded", stats.counterSamplesDecoded.load()},
+                       {"malformed_datagrams", stats.malformedDatagrams.load()},
+                       {"sample_errors", stats.sampleErrors.load()}};
+        uint64_t locks = stats.flowShardLocks.load();
+        worker["samples_per_lock"] =
+            locks ? static_cast<double>(stats.flowSamplesApplied.load()) / locks : 0.0;
+        if (i < m_ingestRings.size())
+        {
+            worker["ring_occupancy"] = m_ingestRings[i]->size();
+            worker["ring_capacity"] = m_ingestRings[i]->capacity();
+            worker["ring_overflows"] = stats.ringOverflows.load();
+        }
+        arr.push_back(std::move(worker));
+    }
+    return arr;
+}
 
-    // 4. Non-blocking mode
-    int flags = fcntl(m_sockfd, F_GETFL, 0);
-    fcntl(m_sockfd, F_SETFL, flags | O_NONBLOCK);
+void
+FlowLinkUsageCollector::appendMetrics(std::string& out) const
+{
+    using utils::MetricSample;
+    using utils::MetricsRegistry;
 
-    // 5. Bind
-    sockaddr_in bindAddr{};
-    bindAddr.sin_family = AF_INET;
-    bindAddr.sin_port = htons(SFLOW_PORT);
-    bindAddr.sin_addr.s_addr = INADDR_ANY;
-    if (::bind(m_sockfd, reinterpret_cast<sockaddr*>(&bindAddr), sizeof(bindAddr)) < 0)
+    std::vector<MetricSample> datagrams, bytes, samples, drops, errors, ringOccupancy;
+    const size_t workers = m_running.load() ? m_ingestStats.size() : 0;
+    for (size_t i = 0; i < workers; ++i)
     {
-        SPDLOG_LOGGER_ERROR(Logger::instance(), "bind() failed: {}", strerror(errno));
-        ::close(m_sockfd);
-        throw std::runtime_error("Failed to bind UDP socket");
+        const auto& stats = *m_ingestStats[i];
+        const std::string worker = MetricsRegistry::label("worker", std::to_string(i));
+        auto load = [](const std::atomic<uint64_t>& value) {
+            return static_cast<double>(value.load(std::memory_order_relaxed));
+        };
+        datagrams.push_back({worker, load(stats.datagramsReceived)});
+        bytes.push_back({worker, load(stats.bytesReceived)});
+        samples.push_back({worker + ",kind=\"flow\"", load(stats.flowSamplesDecoded)});
+        samples.push_back({worker + ",kind=\"counter\"", load(stats.counterSamplesDecoded)});
+        drops.push_back({worker + ",reason=\"truncated\"", load(stats.datagramsTruncated)});
+        drops.push_back({worker + ",reason=\"malformed\"", load(stats.malformedDatagrams)});
+        drops.push_back({worker + ",reason=\"kernel\"", load(stats.kernelDrops)});
+        drops.push_back({worker + ",reason=\"ring_overflow\"", load(stats.ringOverflows)});
+        errors.push_back({worker, load(stats.sampleErrors)});
+        if (i < m_ingestRings.size())
+        {
+            ringOccupancy.push_back({worker, static_cast<double>(m_ingestRings[i]->size())});
+        }
     }
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Listening for sFlow on UDP port {}", SFLOW_PORT);
+    size_t flows = 0;
+    size_t coldFlows = 0;
+    uint64_t heldBack = 0;
+    uint64_t evicted = 0;
+    uint64_t rejected = 0;
+    for (const auto& shard : m_flowInfoShards)
+    {
+        shared_lock lock(shard.mutex);
+        flows += shard.table.size() + shard.cold.size();
+        coldFlows += shard.cold.size();
+        heldBack += shard.heldBackSamples;
+        evicted += shard.evicted;
+        rejected += shard.rejected;
+    }
 
-    // 6. Prepare recvmmsg structures
-    constexpr int BATCH_SIZE = 32;
-    std::vector<std::array<char, BUFFER_SIZE>> buffers(BATCH_SIZE);
-    std::vector<iovec> iov(BATCH_SIZE);
-    std::vector<mmsghdr> msgs(BATCH_SIZE);
-    std::vector<sockaddr_in> srcAddrs(BATCH_SIZE);
-    std::vector<socklen_t> addrLens(BATCH_SIZE, sizeof(sockaddr_in));
+    MetricsRegistry::appendFamily(
+        out, "ndt_sflow_datagrams_total", "counter", "sFlow datagrams received", datagrams);
+    MetricsRegistry::appendFamily(
+        out, "ndt_sflow_bytes_total", "counter", "sFlow payload bytes received", bytes);
+    MetricsRegistry::appendFamily(
+        out, "ndt_sflow_samples_total", "counter", "sFlow samples decoded", samples);
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_sflow_drops_total",
+                                  "counter",
+                                  "sFlow datagrams or records dropped, by reason",
+                                  drops);
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_sflow_parse_errors_total",
+                                  "counter",
+                                  "Truncated or unknown sFlow samples",
+                                  errors);
+    if (!ringOccupancy.empty())
+    {
+        MetricsRegistry::appendFamily(out,
+                                      "ndt_sflow_ring_occupancy",
+                                      "gauge",
+                                      "Records waiting in the ingest ring of a worker",
+                                      ringOccupancy);
+    }
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_flow_table_flows",
+                                  "gauge",
+                                  "Flows in the flow table",
+                                  {{"", static_cast<double>(flows)}});
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_flow_table_cold_flows",
+                                  "gauge",
+                                  "Flows of the flow table kept as compact cold records",
+                                  {{"", static_cast<double>(coldFlows)}});
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_flow_admission_held_back_total",
+                                  "counter",
+                                  "Flow samples of flows the full flow table did not admit yet",
+                                  {{"", static_cast<double>(heldBack)}});
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_flow_table_evictions_total",
+                                  "counter",
+                                  "Flows evicted for new ones at the flow table bound",
+                                  {{"", static_cast<double>(evicted)}});
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_flow_table_rejected_total",
+                                  "counter",
+                                  "New flows refused at the flow table bound",
+                                  {{"", static_cast<double>(rejected)}});
+}
 
-    for (int i = 0; i < BATCH_SIZE; ++i)
+json
+FlowLinkUsageCollector::getFlowPoolStatsJson() const
+{
+    size_t idle = 0;
+    size_t capacity = 0;
+    uint64_t acquired = 0;
+    uint64_t reused = 0;
+    uint64_t recycled = 0;
+    uint64_t discarded = 0;
+    for (const auto& shard : m_flowInfoShards)
     {
-        iov[i].iov_base = buffers[i].data();
-        iov[i].iov_len = BUFFER_SIZE;
-        msgs[i].msg_hdr.msg_iov = &iov[i];
-        msgs[i].msg_hdr.msg_iovlen = 1;
-        msgs[i].msg_hdr.msg_name = &srcAddrs[i];
-        msgs[i].msg_hdr.msg_namelen = addrLens[i];
-        msgs[i].msg_hdr.msg_control = nullptr;
-        msgs[i].msg_hdr.msg_controllen = 0;
-        msgs[i].msg_hdr.msg_flags = 0;
-        msgs[i].msg_len = 0;
+        shared_lock lock(shard.mutex);
+        idle += shard.pool.idle();
+        capacity += shard.pool.maxIdle();
+        acquired += shard.pool.acquired();
+        reused += shard.pool.reused();
+        recycled += shard.pool.recycled();
+        discarded += shard.pool.discarded();
     }
+    return {{"idle", idle},
+            {"capacity", capacity},
+            {"acquired", acquired},
+            {"reused", reused},
+            {"recycled", recycled},
+            {"discarded", discarded},
+            {"reuse_rate", acquired ? static_cast<double>(reused) / acquired : 0.0}};
+}
 
-    // 7. Main loop: poll with timeout, then recvmmsg
-    struct pollfd pfd
+json
+FlowLinkUsageCollector::getFlowAdmissionStatsJson() const
+{
+    size_t engaged = 0;
+    uint64_t heldBackSamples = 0;
+    uint64_t heldBackBytes = 0;
+    uint64_t promoted = 0;
+    size_t sketchBytes = 0;
+    uint64_t evicted = 0;
+    uint64_t rejected = 0;
+    uint64_t reverseAcksMerged = 0;
+    uint64_t otherHopSamples = 0;
+    for (const auto& shard : m_flowInfoShards)
     {
-        m_sockfd, POLLIN, 0
-    };
+        shared_lock lock(shard.mutex);
+        engaged += shard.table.size() >= FLOW_ADMIT_FREE_FLOWS;
+        heldBackSamples += shard.heldBackSamples;
+        heldBackBytes += shard.heldBackBytes;
+        promoted += shard.promoted;
+        sketchBytes += shard.admission.memoryBytes();
+        evicted += shard.evicted;
+        rejected += shard.rejected;
+        reverseAcksMerged += shard.reverseAcksMerged;
+        otherHopSamples += shard.otherHopSamples;
+    }
+    return {{"engaged_shards", engaged},
+            {"free_flows_per_shard", FLOW_ADMIT_FREE_FLOWS},
+            {"min_bytes", FLOW_ADMIT_MIN_BYTES},
+            {"held_back_samples", heldBackSamples},
+            {"held_back_bytes", heldBackBytes},
+            {"promoted", promoted},
+            {"sketch_bytes", sketchBytes},
+            {"max_flows_per_shard", m_shardFlowCap},
+            {"eviction_policy",
+             m_flowTableLimits.policy == FlowEvictionPolicy::LowestRate ? "lowest_rate"
+                                                                        : "least_recent"},
+            {"evicted", evicted},
+            {"rejected", rejected},
+            {"bidirectional", m_bidirectionalFlows},
+            {"reverse_acks_merged", reverseAcksMerged},
+            {"first_hop_sampling", m_firstHopSampling},
+            {"other_hop_samples", otherHopSamples}};
+}
 
-    const int POLL_TIMEOUT_MS = 1000;
-    while (m_running.load())
+json
+FlowLinkUsageCollector::getFlowTierStatsJson() const
+{
+    size_t hot = 0;
+    size_t cold = 0;
+    size_t hotBytes = 0;
+    size_t coldBytes = 0;
+    uint64_t demotions = 0;
+    uint64_t promotions = 0;
+    for (const auto& shard : m_flowInfoShards)
     {
-        int ret = poll(&pfd, 1, POLL_TIMEOUT_MS);
-        if (ret < 0)
-        {
-            if (errno == EINTR)
-            {
-                continue;
-            }
-            SPDLOG_LOGGER_ERROR(Logger::instance(), "poll() failed: {}", strerror(errno));
-            break;
-        }
-        if (ret == 0)
-        {
-            continue; // timeout, recheck m_running
-        }
+        shared_lock lock(shard.mutex);
+        hot += shard.table.size();
+        cold += shard.cold.size();
+        hotBytes += shard.table.capacity() * (sizeof(FlowInfoMap::value_type) + 1);
+        coldBytes += shard.cold.capacity() * (sizeof(ColdFlowMap::value_type) + 1);
+        demotions += shard.demotions;
+        promotions += shard.coldPromotions;
+    }
+    return {{"cold_after_ms", m_flowColdAfterMs.load(std::memory_order_relaxed)},
+            {"hot_flows", hot},
+            {"cold_flows", cold},
+            {"hot_table_bytes", hotBytes},
+            {"cold_table_bytes", coldBytes},
+            {"hot_entry_bytes", sizeof(FlowInfoMap::value_type)},
+            {"cold_entry_bytes", sizeof(ColdFlowMap::value_type)},
+            {"demotions", demotions},
+            {"promotions", promotions}};
+}
 
-        int received = recvmmsg(m_sockfd, msgs.data(), BATCH_SIZE, 0, nullptr);
-        if (received < 0)
+utils::MemoryUsage
+FlowLinkUsageCollector::memoryUsage()
+{
+    utils::MemoryUsage usage;
+    size_t flows = 0;
+    for (const auto& shard : m_flowInfoShards)
+    {
+        shared_lock lock(shard.mutex);
+        flows += shard.table.size() + shard.cold.size();
+        // Agents beyond AGENT_STATS_INLINE spill into a vector of their own
+        size_t agentBytes = 0;
+        for (const auto& [key, info] : shard.table)
         {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-            {
-                continue;
-            }
-            if (errno == EBADF)
-            {
-                break; // socket closed
-            }
-            SPDLOG_LOGGER_ERROR(Logger::instance(), "recvmmsg() failed: {}", strerror(errno));
-            break;
+            agentBytes += info.agentFlowStats.overflowBytes();
         }
-
-        for (int i = 0; i < received; ++i)
+        const size_t queued = shard.rateDirty.capacity() + shard.pathPending.capacity() +
+                              shard.pathTouches.capacity() + shard.evictedKeys.capacity();
+        usage.add("hot_flows", shard.table.capacity() * (sizeof(FlowInfoMap::value_type) + 1))
+            .add("cold_flows", shard.cold.capacity() * (sizeof(ColdFlowMap::value_type) + 1))
+            .add("agent_overflow", agentBytes)
+            .add("flow_pool", shard.pool.memoryBytes())
+            .add("flow_expiry", shard.expiry.memoryBytes())
+            .add("admission_sketch", shard.admission.memoryBytes())
+            .add("flow_queues", queued * sizeof(FlowKey));
+    }
+    {
+        std::lock_guard lock(m_hopFlowsMutex);
+        size_t bytes = utils::heapBytes(m_hopFlows);
+        for (const auto& [hop, hopFlows] : m_hopFlows)
         {
-            if (msgs[i].msg_len > 0)
-            {
-                handlePacket(buffers[i].data());
-            }
-            msgs[i].msg_len = 0;
-            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            bytes += utils::heapBytes(hopFlows);
         }
+        usage.add("hop_flow_index", bytes);
     }
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Run loop exiting");
+    {
+        std::lock_guard lock(m_counterReportsMutex);
+        usage.add("counter_reports",
+                  m_counterReports.capacity() *
+                      (sizeof(decltype(m_counterReports)::value_type) + 1));
+    }
+    {
+        std::lock_guard lock(m_flowRemovalsMutex);
+        usage.add("flow_removals", utils::heapBytes(m_flowRemovals));
+    }
+    {
+        std::lock_guard lock(m_topFlowsMutex);
+        usage.add("top_flows", utils::heapBytes(m_topFlows));
+    }
+    size_t pathCacheBytes = 0;
+    for (const auto& cache : m_pathCaches)
+    {
+        pathCacheBytes += cache.memoryBytes();
+    }
+    size_t ringBytes = 0;
+    for (const auto& ring : m_ingestRings)
+    {
+        ringBytes += ring->capacity() * sizeof(IngestRecord);
+    }
+    usage.add("flow_path_caches", pathCacheBytes)
+        .add("path_pool", PathPool::instance().memoryBytes())
+        .add("traffic_matrix", m_trafficMatrix.statsJson()["memory_bytes"].get<size_t>())
+        .add("ingest_rings", ringBytes)
+        .per("flow", flows);
+    return usage;
 }
 
-// Destructor and stop() unchanged
-
-void
-FlowLinkUsageCollector::handlePacket(char* buffer)
+json
+FlowLinkUsageCollector::getFlowExportStatsJson() const
 {
-    uint32_t* data = (uint32_t*)buffer;
+    return m_flowExporter ? m_flowExporter->statsJson() : json(nullptr);
+}
 
-    uint32_t version = ntohl(data[0]);
+json
+FlowLinkUsageCollector::getTelemetrySegmentStatsJson() const
+{
+    return m_telemetrySegment ? m_telemetrySegment->statsJson() : json(nullptr);
+}
 
-    if (version != 5)
+json
+FlowLinkUsageCollector::getLinkLivenessStatsJson() const
+{
+    if (!m_linkLiveness)
     {
-        SPDLOG_LOGGER_WARN(Logger::instance(), "Unsupported SFlow Version {}", version);
-        return;
+        return nullptr;
     }
+    json stats = m_linkLiveness->statsJson();
+    stats["apply"] = m_linkLivenessApply.load(std::memory_order_relaxed);
+    stats["applied"] = m_livenessApplied.load(std::memory_order_relaxed);
+    stats["restored"] = m_livenessRestored.load(std::memory_order_relaxed);
+    return stats;
+}
 
-    uint32_t agentIp = data[2];
-    uint32_t sampleCount = ntohl(data[6]);
-    string agentIpStr = utils::ipToString(agentIp);
+json
+FlowLinkUsageCollector::getClusterStatsJson() const
+{
+    json coordinator = nullptr;
+    if (m_clusterListenPort != 0)
+    {
+        coordinator = {{"port", m_clusterListenPort},
+                       {"messages", m_clusterStats.datagramsReceived.load()},
+                       {"bytes", m_clusterStats.bytesReceived.load()},
+                       {"malformed", m_clusterStats.malformedDatagrams.load()},
+                       {"records", m_clusterStats.recordsApplied.load()}};
+    }
+    return {{"node", m_clusterForwarder ? m_clusterForwarder->statsJson() : json(nullptr)},
+            {"coordinator", std::move(coordinator)}};
+}
 
-    SPDLOG_LOGGER_TRACE(Logger::instance(), "Version: {}", version);
-    SPDLOG_LOGGER_TRACE(Logger::instance(), "Agent Address: {}", agentIpStr);
-    SPDLOG_LOGGER_TRACE(Logger::instance(), "Sample Count: {}", sampleCount);
+json
+FlowLinkUsageCollector::getCheckpointStatsJson() const
+{
+    if (m_checkpointPath.empty())
+    {
+        return nullptr;
+    }
+    return {{"path", m_checkpointPath},
+            {"writes", m_checkpointWrites.load()},
+            {"failures", m_checkpointFailures.load()},
+            {"bytes", m_checkpointBytes.load()},
+            {"restored", m_checkpointRestored}};
+}
 
-    uint32_t index = 7;
-    for (uint32_t i = 0; i < sampleCount; i++)
+uint64_t
+FlowLinkUsageCollector::topologyFingerprint() const
+{
+    // FNV-1a; getSwitchIps() is sorted, so the order the switches were learned in is moot
+    uint64_t hash = 0;
+    for (uint32_t ip : m_topologyAndFlowMonitor->getSwitchIps())
     {
-        uint32_t sampleType = ntohl(data[index]);
-        //================================================================
-        // Handle Counter Samples (Brocade Type 2 and HPE Type 4)
-        //================================================================
-        if (sampleType == 2 || sampleType == 4)
+        hash = hash == 0 ? 0xcbf29ce484222325ULL : hash;
+        for (int shift = 0; shift < 32; shift += 8)
         {
-            // Brocade (2) uses a base offset of 4.
-            // HPE (4) uses a base offset of 5.
-            uint32_t baseOffset = (sampleType == 2) ? 4 : 5;
-            const char* vendor = (sampleType == 2) ? "Brocade" : "HPE";
-
-            SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                "============{} Counter Sample ==============",
-                                vendor);
+            hash = (hash ^ ((ip >> shift) & 0xff)) * 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
 
-            uint32_t sampleLen = ntohl(data[index + 1]);
+void
+FlowLinkUsageCollector::coldFlowInfo(const ColdFlow& cold, FlowInfo& info)
+{
+    info.reset();
+    info.estimatedFlowSendingRatePeriodically = cold.flowRatePeriodically;
+    info.estimatedPacketSendingRatePeriodically = cold.packetRatePeriodically;
+    info.reverseAckBytes = cold.reverseAckBytes;
+    info.reverseAckPackets = cold.reverseAckPackets;
+    info.startTime = cold.startTime;
+    info.endTime = cold.endTime;
+    info.changedVersion = cold.changedVersion;
+    info.flowPath = cold.flowPath;
+    info.sampleKey = cold.sampleKey;
+    info.firstHopAgent = cold.firstHopAgent;
+    info.isElephantFlowPeriodically = cold.isElephantFlowPeriodically;
+    info.elephantAnnounced = cold.elephantAnnounced;
+    info.isAck = cold.isAck;
+    info.isPureAck = cold.isPureAck;
+}
 
-            uint64_t interfaceIndex, interfaceSpeed, inputOctets, outputOctets;
+template <typename Fn>
+bool
+FlowLinkUsageCollector::forEachFlowNoLock(const FlowTableShard& shard, Fn&& fn)
+{
+    for (const auto& [flowKey, flowInfo] : shard.table)
+    {
+        if (!fn(flowKey, flowInfo))
+        {
+            return false;
+        }
+    }
+    if (shard.cold.empty())
+    {
+        return true;
+    }
+    FlowInfo scratch;
+    for (const auto& [flowKey, cold] : shard.cold)
+    {
+        coldFlowInfo(cold, scratch);
+        if (!fn(flowKey, std::as_const(scratch)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-            if (sampleType == 2)
+CheckpointWriter
+FlowLinkUsageCollector::encodeState(CheckpointCursor& cursor)
+{
+    // Publish first: anything written after it is stamped with at least this version
+    const uint64_t version = publishFlowVersion();
+    const uint64_t since = cursor.flowVersion;
+    bool full;
+    {
+        std::lock_guard guard(m_flowRemovalsMutex);
+        full = since == 0 || since > version || since <= m_flowRemovalsFloor;
+    }
+    // Read before the tables, so tables newer than it are only sent once more
+    const uint64_t rulesVersion = m_classifier ? m_classifier->getRulesVersion() : 0;
+
+    CheckpointWriter writer({utils::getCurrentTimeMillisSystemClock(),
+                             utils::getCurrentTimeMillisSteadyClock(),
+                             topologyFingerprint(),
+                             !full});
+    for (auto& shard : m_flowInfoShards)
+    {
+        shared_lock lock(shard.mutex);
+        forEachFlowNoLock(shard, [&](const FlowKey& flowKey, const FlowInfo& info) {
+            if (full || info.changedVersion >= since)
             {
-                interfaceIndex = ntohl(data[index + baseOffset + 15 + 3]);
-
-                // Combine high and low 32-bit words to form 64-bit values
-                interfaceSpeed =
-                    (static_cast<uint64_t>(ntohl(data[index + baseOffset + 15 + 5])) << 32) |
-                    ntohl(data[index + baseOffset + 15 + 6]);
-                inputOctets =
-                    (static_cast<uint64_t>(ntohl(data[index + baseOffset + 15 + 9])) << 32) |
-                    ntohl(data[index + baseOffset + 15 + 10]);
-                outputOctets =
-                    (static_cast<uint64_t>(ntohl(data[index + baseOffset + 15 + 17])) << 32) |
-                    ntohl(data[index + baseOffset + 15 + 18]);
+                writer.addFlow(flowKey, info);
             }
-            else
+            return true;
+        });
+    }
+    if (!full)
+    {
+        // Read after the scan so a flow purged meanwhile is either written above or here
+        std::lock_guard guard(m_flowRemovalsMutex);
+        for (const auto& [removedAt, key] : m_flowRemovals)
+        {
+            if (removedAt >= since)
             {
-                interfaceIndex = ntohl(data[index + baseOffset + 3]);
-
-                // Combine high and low 32-bit words to form 64-bit values
-                interfaceSpeed =
-                    (static_cast<uint64_t>(ntohl(data[index + baseOffset + 5])) << 32) |
-                    ntohl(data[index + baseOffset + 6]);
-                inputOctets = (static_cast<uint64_t>(ntohl(data[index + baseOffset + 9])) << 32) |
-                              ntohl(data[index + baseOffset + 10]);
-                outputOctets = (static_cast<uint64_t>(ntohl(data[index + baseOffset + 17])) << 32) |
-                               ntohl(data[index + baseOffset + 18]);
+                writer.addRemovedFlow(key);
             }
+        }
+    }
+    {
+        std::lock_guard counterLock(m_counterReportsMutex);
+        for (const auto& [packedKey, counter] : m_counterReports)
+        {
+            writer.addCounter(packedKey, counter);
+        }
+    }
+    if (m_deviceConfigurationAndPowerManager && (full || rulesVersion != cursor.rulesVersion))
+    {
+        writer.addRules(*m_deviceConfigurationAndPowerManager->getOpenFlowTablesSnapshot());
+    }
+    cursor = {version, rulesVersion};
+    return writer;
+}
 
-            SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                "COUNTER SAMPLE {} from Agent {}: ifIndex={}, ifSpeed={}, "
-                                "ifInOctets={}, ifOutOctets={}",
-                                sampleType,
-                                agentIpStr,
-                                interfaceIndex,
-                                interfaceSpeed,
-                                inputOctets,
-                                outputOctets);
-
-            // Advance index past the current sample
-            index += (sampleLen / 4 + 2);
-
-            if (m_mode == utils::MININET)
-            {
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "==========================================\n");
-                continue;
-            }
+void
+FlowLinkUsageCollector::applyReplicatedState(Checkpoint& state)
+{
+    applyCheckpoint(state, true);
+}
 
-            int64_t now = utils::getCurrentTimeMillisSteadyClock();
-            pair<uint32_t, uint32_t> agentIpAndPort(agentIp, interfaceIndex);
+void
+FlowLinkUsageCollector::writeCheckpoint()
+{
+    CheckpointCursor cursor;
+    CheckpointWriter writer = encodeState(cursor);
 
-            // log time
-            // utils::logCurrentTimeSystemClock();
+    // Encoded under the locks, written out of them
+    const size_t bytes = writer.commit(m_checkpointPath);
+    if (bytes == 0)
+    {
+        m_checkpointFailures.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_checkpointWrites.fetch_add(1, std::memory_order_relaxed);
+    m_checkpointBytes.store(bytes, std::memory_order_relaxed);
+}
 
-            int64_t interval =
-                (now - m_counterReports[agentIpAndPort].lastReportTimestampInMilliseconds) / 1000;
-            if (interval == 0)
+FlowLinkUsageCollector::AppliedState
+FlowLinkUsageCollector::applyCheckpoint(Checkpoint& state, bool replace)
+{
+    AppliedState applied;
+    const int64_t nowSystemMs = utils::getCurrentTimeMillisSystemClock();
+    const int64_t nowSteadyMs = utils::getCurrentTimeMillisSteadyClock();
+    const int64_t ageMs = std::max<int64_t>(nowSystemMs - state.header.savedSystemMs, 0);
+
+    const uint64_t fingerprint = topologyFingerprint();
+    applied.topologyMatched = fingerprint != 0 && fingerprint == state.header.topologyFingerprint;
+    if (applied.topologyMatched)
+    {
+        if (m_classifier && state.rules.is_array())
+        {
+            m_classifier->updateFromQueriedTables(state.rules);
+            applied.rules = state.rules.size();
+        }
+        // Report times move to this process' steady clock through the wall clock
+        const int64_t shiftMs = nowSteadyMs - ageMs - state.header.savedSteadyMs;
+        std::lock_guard counterLock(m_counterReportsMutex);
+        for (auto& [packedKey, counter] : state.counters)
+        {
+            if (counter.lastReportTimestampInMilliseconds != 0)
             {
-                continue;
+                counter.lastReportTimestampInMilliseconds += shiftMs;
             }
+            m_counterReports[packedKey] = counter;
+        }
+        applied.counters = state.counters.size();
+    }
 
-            // Check if this is not the first report
-            if (m_counterReports[agentIpAndPort].lastReportTimestampInMilliseconds != 0)
+    bool pathsPending = false;
+    for (auto& [flowKey, info] : state.flows)
+    {
+        if (info.endTime + flowIdleTimeout() <= nowSystemMs)
+        {
+            continue;
+        }
+        FlowTableShard& shard = m_flowInfoShards[flowShardIndex(flowKey)];
+        unique_lock lock(shard.mutex);
+        auto it = findHotFlowNoLock(shard, flowKey);
+        uint64_t previousRate = 0;
+        if (it == shard.table.end())
+        {
+            if (m_shardFlowCap != 0 && shard.table.size() + shard.cold.size() >= m_shardFlowCap)
             {
-                SPDLOG_LOGGER_TRACE(
-                    Logger::instance(),
-                    "Agent Address: {}, Sample Len: {}, Iface Index: {}, Iface Speed: {}",
-                    agentIpStr,
-                    sampleLen,
-                    interfaceIndex,
-                    interfaceSpeed);
-
-                uint64_t avgIn = 0, avgOut = 0;
-                bool inNoOverflow = false, outNoOverflow = false;
+                continue;
+            }
+            it = shard.table.try_emplace(flowKey, shard.pool.acquire()).first;
+            it->second = std::move(info);
+            shard.expiry.schedule(flowKey, it->second.endTime + flowHotTimeout());
+            // Paths are resolved again, against the restored rules
+            shard.pathPending.push_back(flowKey);
+            pathsPending = true;
+        }
+        else if (!replace)
+        {
+            continue;
+        }
+        else
+        {
+            // Everything but the path, which stays the one resolved here
+            FlowInfo& current = it->second;
+            previousRate = current.estimatedFlowSendingRatePeriodically;
+            PathHandle path = std::move(current.flowPath);
+            const uint64_t pathVersion = current.pathVersion;
+            const uint32_t firstHopAgent = current.firstHopAgent;
+            current = std::move(info);
+            current.flowPath = std::move(path);
+            current.pathVersion = pathVersion;
+            current.firstHopAgent = firstHopAgent;
+        }
+        markFlowChanged(it->second);
+        const uint64_t rate = it->second.estimatedFlowSendingRatePeriodically;
+        if (rate != previousRate && inTrafficMatrix(flowKey))
+        {
+            // Straight into the matrix: m_matrixDeltas belongs to the rate task
+            const TrafficMatrix::Delta delta{flowKey.srcIP,
+                                             flowKey.dstIP,
+                                             static_cast<int64_t>(rate) -
+                                                 static_cast<int64_t>(previousRate)};
+            m_trafficMatrix.apply({&delta, 1});
+        }
+        ++applied.flows;
+    }
 
-                if (inputOctets >= m_counterReports[agentIpAndPort].lastReceivedInputOctets)
+    if (replace)
+    {
+        std::vector<FlowKey> removed = std::move(state.removed);
+        if (!state.header.delta)
+        {
+            // A full state lists every flow the primary has; drop the others
+            std::unordered_set<FlowKey, FlowKeyMixHash> listed;
+            listed.reserve(state.flows.size());
+            for (const auto& entry : state.flows)
+            {
+                listed.insert(entry.first);
+            }
+            for (auto& shard : m_flowInfoShards)
+            {
+                shared_lock lock(shard.mutex);
+                for (const auto& entry : shard.table)
                 {
-                    uint64_t inputOctetsDiff =
-                        inputOctets - m_counterReports[agentIpAndPort].lastReceivedInputOctets;
-                    avgIn = inputOctetsDiff * 8 / interval; // Calculate average bits per second
-                    inNoOverflow = true;
-                    SPDLOG_LOGGER_TRACE(Logger::instance(), "Average Link Usage (In): {}", avgIn);
+                    if (!listed.contains(entry.first))
+                    {
+                        removed.push_back(entry.first);
+                    }
                 }
-                if (outputOctets >= m_counterReports[agentIpAndPort].lastReceivedOutputOctets)
+                for (const auto& entry : shard.cold)
                 {
-                    uint64_t outputOctetsDiff =
-                        outputOctets - m_counterReports[agentIpAndPort].lastReceivedOutputOctets;
-                    avgOut = outputOctetsDiff * 8 / interval; // Calculate average bits per second
-                    outNoOverflow = true;
-                    SPDLOG_LOGGER_TRACE(Logger::instance(), "Average Link Usage (Out): {}", avgOut);
+                    if (!listed.contains(entry.first))
+                    {
+                        removed.push_back(entry.first);
+                    }
                 }
+            }
+        }
+        for (const auto& flowKey : removed)
+        {
+            FlowTableShard& shard = m_flowInfoShards[flowShardIndex(flowKey)];
+            unique_lock lock(shard.mutex);
+            if (auto it = shard.table.find(flowKey); it != shard.table.end())
+            {
+                removeFlowNoLock(shard, it);
+                ++applied.removed;
+            }
+            else if (auto cold = shard.cold.find(flowKey); cold != shard.cold.end())
+            {
+                removeColdFlowNoLock(shard, cold);
+                ++applied.removed;
+            }
+        }
+    }
 
-                uint64_t leftIn = (avgIn > interfaceSpeed) ? 0 : (interfaceSpeed - avgIn);
-                uint64_t leftOut = (avgOut > interfaceSpeed) ? 0 : (interfaceSpeed - avgOut);
+    if (pathsPending && !m_pathWork.exchange(true, std::memory_order_acq_rel))
+    {
+        m_pathCv.notify_one();
+    }
+    return applied;
+}
 
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "left_in in SFlow Collector: {} (bps)",
-                                    leftIn);
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "left_out in SFlow Collector: {} (bps)",
-                                    leftOut);
+void
+FlowLinkUsageCollector::restoreCheckpoint()
+{
+    std::optional<Checkpoint> checkpoint = readCheckpoint(m_checkpointPath);
+    if (!checkpoint)
+    {
+        return;
+    }
+    const int64_t ageMs =
+        utils::getCurrentTimeMillisSystemClock() - checkpoint->header.savedSystemMs;
+    if (ageMs < 0 || ageMs > CHECKPOINT_MAX_AGE_MS)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Checkpoint {} is {} ms old; not restored",
+                           m_checkpointPath,
+                           ageMs);
+        return;
+    }
 
-                if (inNoOverflow && outNoOverflow)
-                {
-                    m_topologyAndFlowMonitor->updateLinkInfo(agentIpAndPort,
-                                                             leftIn,
-                                                             leftOut,
-                                                             interfaceSpeed);
-                }
+    const AppliedState applied = applyCheckpoint(*checkpoint, false);
+    if (!applied.topologyMatched)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Switches differ from checkpoint {}; OpenFlow tables and link "
+                           "counters not restored",
+                           m_checkpointPath);
+    }
+    m_checkpointRestored = {{"age_ms", ageMs},
+                            {"flows", applied.flows},
+                            {"counters", applied.counters},
+                            {"rules", applied.rules}};
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Restored checkpoint {} ({} ms old): {} flows, {} link counters, {} "
+                       "switch tables",
+                       m_checkpointPath,
+                       ageMs,
+                       applied.flows,
+                       applied.counters,
+                       applied.rules);
+}
+
+void
+FlowLinkUsageCollector::defineRuntimeParameters()
+{
+    auto& config = utils::RuntimeConfig::instance();
+    m_sflowPort = static_cast<uint16_t>(
+        config.defineInt("sflow.port", "UDP port sFlow is received on", SFLOW_PORT, 1, 65535));
+    m_recvBufferBytes = static_cast<size_t>(
+        config.defineInt("sflow.buffer_bytes",
+                         "Receive buffer per datagram; longer datagrams are truncated",
+                         BUFFER_SIZE,
+                         1500,
+                         65535));
+    m_recvBatch = static_cast<int>(config.defineInt(
+        "sflow.recv_batch",
+        "Datagrams one recvmmsg() call of an ingest worker may return",
+        SFLOW_RECV_BATCH_SIZE,
+        1,
+        SFLOW_RECV_BATCH_MAX,
+        [this](int64_t value) { m_recvBatch = static_cast<int>(value); }));
+    m_rcvbufBytes = static_cast<int>(config.defineInt(
+        "sflow.rcvbuf_bytes",
+        "SO_RCVBUF of the sFlow sockets",
+        SFLOW_RCVBUF_BYTES,
+        64 << 10,
+        1 << 30,
+        [this](int64_t value) {
+            m_rcvbufBytes = static_cast<int>(value);
+            std::lock_guard lock(m_ingestFilterMutex);
+            const int bytes = static_cast<int>(value);
+            for (int sockfd : m_ingestSockets)
+            {
+                setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
             }
+        }));
+    m_flowIdleTimeoutMs = config.defineInt(
+        "flow.idle_timeout_ms",
+        "A flow without samples for this long is purged",
+        FLOW_IDLE_TIMEOUT,
+        1000,
+        3600000,
+        [this](int64_t value) { m_flowIdleTimeoutMs = value; });
+    m_flowColdAfterMs = config.defineInt(
+        "flow.cold_after_ms",
+        "A flow without samples for this long is kept as a compact cold record until it is "
+        "purged (0: never)",
+        FLOW_COLD_AFTER,
+        0,
+        3600000,
+        [this](int64_t value) { m_flowColdAfterMs = value; });
+    m_immediateSweep =
+        config.defineInt("flow_rates.immediate_sweep",
+                         "Re-evaluate the immediate rate of every flow every 0.5-2 s (1), or "
+                         "only those of the flows a query asks for (0)",
+                         0,
+                         0,
+                         1,
+                         [this](int64_t value) {
+                             m_immediateSweep = value != 0;
+                             if (value == 0)
+                             {
+                                 std::lock_guard guard(m_topFlowsMutex);
+                                 m_topFlows.clear();
+                             }
+                         }) != 0;
+    m_linkLivenessApply =
+        config.defineInt("link_liveness.apply",
+                         "Set links down on data-plane failures detected with confidence of at "
+                         "least LINK_LIVENESS_APPLY_CONFIDENCE (1), or only report them (0)",
+                         1,
+                         0,
+                         1,
+                         [this](int64_t value) { m_linkLivenessApply = value != 0; }) != 0;
+}
+
+void
+FlowLinkUsageCollector::start()
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Collector Starts Up");
+    defineRuntimeParameters();
+
+    size_t maxFlows = m_flowTableLimits.maxFlows;
+    if (m_flowTableLimits.maxBytes > 0)
+    {
+        const size_t budget = std::max<size_t>(m_flowTableLimits.maxBytes / FLOW_ENTRY_BYTES, 1);
+        maxFlows = maxFlows > 0 ? std::min(maxFlows, budget) : budget;
+    }
+    m_shardFlowCap = maxFlows > 0 ? std::max<size_t>(maxFlows / FLOW_TABLE_SHARD_COUNT, 1) : 0;
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Flow table bound: {} flows per shard ({} bytes per flow)",
+                       m_shardFlowCap,
+                       FLOW_ENTRY_BYTES);
+
+    if (m_mode == utils::MININET)
+    {
+        startIfIndexMap();
+    }
+
+    // Call All Destination When Initialize
+    fetchAllDestinationPaths();
+
+    const size_t workerCount = m_ingestConfig.workerCount;
+    m_ingestStats.clear();
+    m_ingestRings.clear();
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        m_ingestStats.push_back(std::make_unique<IngestWorkerStats>());
+        m_ingestStats.back()->decodeLatency = &utils::MetricsRegistry::instance().histogram(
+            "ndt_sflow_decode_seconds",
+            "Time to decode one sFlow datagram and hand off its samples",
+            utils::MetricsRegistry::label("worker", std::to_string(i)));
+        if (m_ingestConfig.ringCapacity > 0)
+        {
+            m_ingestRings.push_back(
+                std::make_unique<utils::SpscRing<IngestRecord>>(m_ingestConfig.ringCapacity));
+        }
+    }
+
+    if (m_flowExporter)
+    {
+        m_flowExporter->start();
+    }
+    if (m_telemetrySegment && !m_telemetrySegment->open())
+    {
+        m_telemetrySegment.reset();
+    }
+    if (!m_checkpointPath.empty())
+    {
+        restoreCheckpoint();
+    }
+    if (m_clusterForwarder && !m_clusterForwarder->open())
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Cluster node applies its own samples");
+        m_clusterForwarder.reset();
+    }
+
+    this->m_running.store(true);
+    for (size_t i = 0; i < workerCount; ++i)
+    {
+        if (!m_ingestRings.empty())
+        {
+            m_aggregatorThreads.emplace_back(&FlowLinkUsageCollector::aggregate, this, i);
+        }
+        m_pktRcvThreads.emplace_back(&FlowLinkUsageCollector::run, this, i);
+    }
+    auto& scheduler = utils::TaskScheduler::instance();
+    m_periodicTasks = {
+        scheduler.schedule("flow_rates",
+                           utils::TaskPriority::High,
+                           chrono::seconds(1),
+                           [this] { calAvgFlowSendingRatesPeriodically(); }),
+        scheduler.schedule("flow_rates_random_test",
+                           utils::TaskPriority::Normal,
+                           chrono::milliseconds(2000),
+                           [this] { testCalAvgFlowSendingRatesRandomly(); },
+                           true),
+        scheduler.schedule("flow_expiry",
+                           utils::TaskPriority::High,
+                           chrono::milliseconds(FLOW_EXPIRY_TICK_MS),
+                           [this] { purgeIdleFlows(); },
+                           true)};
+    if (m_ingestConfig.kernelFilter && m_ingestConfig.captureInterface.empty())
+    {
+        m_periodicTasks.push_back(
+            scheduler.schedule("ingest_filter",
+                               utils::TaskPriority::Normal,
+                               chrono::milliseconds(INGEST_FILTER_REFRESH_MS),
+                               [this] { refreshIngestFilter(); },
+                               true));
+    }
+    // Counter samples are ignored in MININET mode
+    if (m_mode != utils::MININET)
+    {
+        if (!m_linkLiveness)
+        {
+            m_linkLiveness = std::make_unique<LinkLivenessMonitor>();
+        }
+        m_periodicTasks.push_back(scheduler.schedule("link_liveness",
+                                                     utils::TaskPriority::High,
+                                                     chrono::milliseconds(LINK_LIVENESS_SWEEP_MS),
+                                                     [this] { sweepLinkLiveness(); }));
+    }
+    if (m_samplingController)
+    {
+        m_samplingDrops = 0;
+        m_periodicTasks.push_back(
+            scheduler.schedule("sampling_control",
+                               utils::TaskPriority::Low,
+                               chrono::milliseconds(SAMPLING_CONTROL_PERIOD_MS),
+                               [this] { controlSampling(); }));
+    }
+    if (!m_checkpointPath.empty())
+    {
+        m_periodicTasks.push_back(scheduler.schedule("checkpoint",
+                                                     utils::TaskPriority::Low,
+                                                     chrono::milliseconds(CHECKPOINT_INTERVAL_MS),
+                                                     [this] { writeCheckpoint(); }));
+    }
+    if (m_clusterListenPort != 0)
+    {
+        m_clusterThread = thread(&FlowLinkUsageCollector::receiveFromNodes, this);
+    }
+    // TODO
+    m_calFlowPathByQueried = thread(&FlowLinkUsageCollector::calFlowPathByQueried, this);
+}
+
+void
+FlowLinkUsageCollector::stop()
+{
+    this->m_running.store(false);
+    m_pathCv.notify_all();
 
-            // Update state for the next calculation
-            m_counterReports[agentIpAndPort].lastReportTimestampInMilliseconds = now;
-            m_counterReports[agentIpAndPort].lastReceivedInputOctets = inputOctets;
-            m_counterReports[agentIpAndPort].lastReceivedOutputOctets = outputOctets;
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Collector Stops");
 
-            SPDLOG_LOGGER_TRACE(Logger::instance(), "==========================================\n");
+    // Workers notice m_running within one poll timeout and close their own sockets
+    for (auto& t : m_pktRcvThreads)
+    {
+        if (t.joinable())
+        {
+            t.join();
         }
-        //================================================================
-        // Handle Flow Samples (Brocade Type 1 and HPE Type 3)
-        //================================================================
-        else if (sampleType == 1 || sampleType == 3)
+    }
+    m_pktRcvThreads.clear();
+    for (auto& t : m_aggregatorThreads)
+    {
+        if (t.joinable())
         {
-            unique_lock lock(m_flowInfoTableMutex);
-            uint32_t sampleLen = ntohl(data[index + 1]);
+            t.join();
+        }
+    }
+    m_aggregatorThreads.clear();
+    if (m_clusterThread.joinable())
+    {
+        m_clusterThread.join();
+    }
+    if (m_ovsdbListener != 0)
+    {
+        utils::OvsdbMonitor::instance().unsubscribe(m_ovsdbListener);
+        m_ovsdbListener = 0;
+    }
+    for (auto task : m_periodicTasks)
+    {
+        utils::TaskScheduler::instance().cancel(task);
+    }
+    m_periodicTasks.clear();
+    // Ingest has stopped, so this is the state a restart should pick up
+    if (!m_checkpointPath.empty())
+    {
+        writeCheckpoint();
+    }
+    // After the purge task, so the records of its last pass are written too
+    if (m_flowExporter)
+    {
+        m_flowExporter->stop();
+    }
+    if (m_telemetrySegment)
+    {
+        m_telemetrySegment->close();
+    }
+    if (m_calFlowPathByQueried.joinable())
+    {
+        m_calFlowPathByQueried.join();
+    }
+}
 
-            // 1. Extract flow data. Offsets differ by vendor.
-            uint32_t inputPort, outputPort, frameLength;
-            uint8_t protocol;
-            uint32_t srcIp, dstIp;
-            uint16_t srcPort, dstPort, icmpType, icmpCode;
-            uint32_t flowDataLength = 0;
-            uint32_t samplingRate = ntohl(data[index + 4]);
+int
+FlowLinkUsageCollector::openIngestSocket(bool reusePort, uint16_t port)
+{
+    // 1. Create UDP socket
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sockfd < 0)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "socket() failed: {}", strerror(errno));
+        throw std::runtime_error("Failed to create UDP socket");
+    }
 
-            uint16_t etherType = 0;
+    // 2. Increase receive buffer
+    int rcvbuf = m_rcvbufBytes.load(std::memory_order_relaxed);
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
 
-            bool isAckPacket = false;
-            const uint8_t TCP_ACK_FLAG = 0x10;
+    // 3. Allow address reuse; SO_REUSEPORT lets every worker bind SFLOW_PORT
+    int reuse = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (reusePort && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "SO_REUSEPORT failed: {}", strerror(errno));
+        ::close(sockfd);
+        throw std::runtime_error("Failed to enable SO_REUSEPORT");
+    }
 
-            if (sampleType == 1)
-            { // Brocade
-                samplingRate = ntohl(data[index + 4]);
-                inputPort = ntohl(data[index + 7]);
-                outputPort = 0;
-                if (m_mode == utils::MININET)
-                {
-                    flowDataLength = ntohl(data[index + 11]);
-                    SPDLOG_LOGGER_TRACE(Logger::instance(), "flowDataLength: {}", flowDataLength);
-                    index += flowDataLength / 4 + 2;
-                }
-                frameLength = ntohl(data[index + 13]);
+    // 4. Report socket queue overflows through ancillary data
+    int rxqOverflow = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_RXQ_OVFL, &rxqOverflow, sizeof(rxqOverflow));
+    // Kernel receive time of each datagram, so samples are not timed by when they are decoded
+    int timestamps = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &timestamps, sizeof(timestamps)) < 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "SO_TIMESTAMPNS failed, timing samples per batch: {}",
+                           strerror(errno));
+    }
 
-                etherType = ntohl(data[index + 19]) >> 16 & 0xFFFF;
+    // 5. Non-blocking mode
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
 
-                SPDLOG_LOGGER_TRACE(Logger::instance(), "etherType = 0x{:04x}", etherType);
-                if (etherType != 0x0800)
-                {
-                    SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                        "Not IPv4 packet, etherType {}",
-                                        etherType);
-                    if (m_mode == utils::MININET)
-                    {
-                        index += (sampleLen / 4 + 2 - (flowDataLength / 4 + 2));
-                    }
-                    else
-                    {
-                        index += (sampleLen / 4 + 2);
-                    }
-                    continue;
-                }
+    // 6. Bind
+    sockaddr_in bindAddr{};
+    bindAddr.sin_family = AF_INET;
+    bindAddr.sin_port = htons(port);
+    bindAddr.sin_addr.s_addr = INADDR_ANY;
+    if (::bind(sockfd, reinterpret_cast<sockaddr*>(&bindAddr), sizeof(bindAddr)) < 0)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "bind() failed: {}", strerror(errno));
+        ::close(sockfd);
+        throw std::runtime_error("Failed to bind UDP socket");
+    }
 
-                protocol = ntohl(data[index + 21]) & 0xFF;
-                srcIp = ipFromFrontBack(ntohl(data[index + 22]), ntohl(data[index + 23]));
-                dstIp = ipFromFrontBack(ntohl(data[index + 23]), ntohl(data[index + 24]));
-                if (protocol != 1)
-                {
-                    srcPort = ntohl(data[index + 24]) & 0xFFFF;
-                    dstPort = (ntohl(data[index + 25]) >> 16) & 0xFFFF;
-                    if (protocol == 6)
-                    {
-                        uint8_t tcpFlags = (ntohl(data[index + 28]) >> 8) & 0xFF;
+    return sockfd;
+}
 
-                        if (tcpFlags & TCP_ACK_FLAG)
-                        {
-                            isAckPacket = true;
-                        }
-                    }
-                }
-                else
-                {
-                    icmpType = (ntohl(data[index + 24]) >> 8) & 0xFF;
-                    icmpCode = ntohl(data[index + 24]) & 0xF;
-                }
-            }
-            else
-            { // HPE (sampleType == 3)
-                samplingRate = ntohl(data[index + 5]);
-                inputPort = ntohl(data[index + 9]);
-                outputPort = ntohl(data[index + 11]);
-                frameLength = ntohl(data[index + 12 + 4]);
+void
+FlowLinkUsageCollector::run(size_t workerId)
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Run (ingest worker {})", workerId);
 
-                etherType = ntohl(data[index + 12 + 6 + 5]) >> 16 & 0xFFFF;
+    std::vector<unsigned> cpus;
+    if (!m_ingestConfig.cpus.empty())
+    {
+        cpus.push_back(m_ingestConfig.cpus[workerId % m_ingestConfig.cpus.size()]);
+    }
+    else if (m_ingestConfig.pinToCpu)
+    {
+        cpus.push_back(workerId % std::max(1u, std::thread::hardware_concurrency()));
+    }
+    utils::ThreadRegistry::Scope thread("sflow-rx-" + std::to_string(workerId), cpus);
+    utils::MemoryPolicy::instance().countTlbMisses("sflow-rx-" + std::to_string(workerId));
 
-                SPDLOG_LOGGER_TRACE(Logger::instance(), "etherType = 0x{:04x}", etherType);
-                if (etherType != 0x0800)
-                {
-                    SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                        "Not IPv4 packet, etherType {}",
-                                        etherType);
-                    if (m_mode == utils::MININET)
-                    {
-                        index += (sampleLen / 4 + 2 - (flowDataLength / 4 + 2));
-                    }
-                    else
-                    {
-                        index += (sampleLen / 4 + 2);
-                    }
-                    continue;
-                }
+    if (!m_ingestConfig.captureInterface.empty())
+    {
+        captureFromRing(workerId);
+        return;
+    }
 
-                protocol = ntohl(data[index + 12 + 6 + 7]) & 0xFF;
-                srcIp = ipFromFrontBack(ntohl(data[index + 12 + 6 + 7 + 1]),
-                                        ntohl(data[index + 12 + 6 + 7 + 2]));
-                dstIp = ipFromFrontBack(ntohl(data[index + 12 + 6 + 7 + 2]),
-                                        ntohl(data[index + 12 + 6 + 7 + 3]));
-                if (protocol != 1)
-                {
-                    srcPort = ntohl(data[index + 12 + 6 + 7 + 3]) & 0xFFFF;
-                    dstPort = (ntohl(data[index + 12 + 6 + 7 + 4]) >> 16) & 0xFFFF;
-                    if (protocol == 6) // It's a TCP packet
-                    {
-                        uint8_t tcpFlags = (ntohl(data[index + 32]) >> 8) & 0xFF;
+    int sockfd = openIngestSocket(m_ingestConfig.workerCount > 1, m_sflowPort);
+    registerIngestSocket(sockfd);
+    IngestWorkerStats& stats = *m_ingestStats[workerId];
 
-                        if (tcpFlags & TCP_ACK_FLAG)
-                        {
-                            isAckPacket = true;
-                        }
-                    }
-                }
-                else
-                {
-                    icmpType = ntohl(data[index + 28] >> 8) & 0xFF;
-                    icmpCode = ntohl(data[index + 28]) & 0xF;
-                }
-            }
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Listening for sFlow on UDP port {} (worker {}/{})",
+                       m_sflowPort,
+                       workerId + 1,
+                       m_ingestConfig.workerCount);
+
+    if (m_ingestConfig.ioUring)
+    {
+        if (auto receiver = UringReceiver::create(sockfd))
+        {
+            receiveWithUring(workerId, *receiver);
+        }
+    }
+
+    // Prepare recvmmsg structures, again whenever "sflow.recv_batch" changes; the buffers are
+    // allocated (and first touched) here, on the worker's own CPU and NUMA node
+    constexpr size_t CONTROL_SIZE = CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(timespec));
+    const size_t bufferBytes = m_recvBufferBytes;
+    int batchSize = 0;
+    std::vector<char, utils::PolicyAllocator<char, utils::MemoryKind::IngestBuffers>> buffers;
+    std::vector<iovec> iov;
+    std::vector<mmsghdr> msgs;
+    std::vector<sockaddr_in> srcAddrs;
+    std::vector<std::array<uint64_t, (CONTROL_SIZE + 7) / 8>> controls;
+    std::vector<IngestRecord> batch;
+    auto resizeBatch = [&](int size) {
+        batchSize = size;
+        buffers.assign(size_t(size) * bufferBytes, 0);
+        iov.assign(size, {});
+        msgs.assign(size, {});
+        srcAddrs.assign(size, {});
+        controls.assign(size, {});
+        for (int i = 0; i < size; ++i)
+        {
+            iov[i].iov_base = buffers.data() + size_t(i) * bufferBytes;
+            iov[i].iov_len = bufferBytes;
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &srcAddrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[i].msg_hdr.msg_control = controls[i].data();
+            msgs[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+        }
+    };
+
+    // Main loop: poll with timeout, then recvmmsg
+    struct pollfd pfd
+    {
+        sockfd, POLLIN, 0
+    };
 
-            if (m_mode == utils::TESTBED)
+    const int POLL_TIMEOUT_MS = 1000;
+    while (m_running.load())
+    {
+        thread.idle();
+        int ret = poll(&pfd, 1, POLL_TIMEOUT_MS);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
             {
-                SPDLOG_LOGGER_TRACE(
-                    Logger::instance(),
-                    "FLOW SAMPLE from Agent {}: {} -> {} (Proto: {}, Len: {}, Input "
-                    "port: {}, Ouput port: {} ICMP type {} ICMP code {}, Sampling rate {})",
-                    agentIpStr,
-                    utils::ipToString(srcIp),
-                    utils::ipToString(dstIp),
-                    protocol,
-                    frameLength,
-                    inputPort,
-                    outputPort,
-                    icmpType,
-                    icmpCode,
-                    samplingRate);
+                continue;
             }
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "poll() failed: {}", strerror(errno));
+            break;
+        }
+        if (ret == 0)
+        {
+            continue; // timeout, recheck m_running
+        }
+        thread.wake();
 
-            // check whether it is pure ack
-            bool isPureAck = false;
-            if (protocol == 6) // Check if it's a TCP packet first
+        if (const int wanted = m_recvBatch.load(std::memory_order_relaxed); wanted != batchSize)
+        {
+            resizeBatch(wanted);
+        }
+        int received = recvmmsg(sockfd, msgs.data(), batchSize, 0, nullptr);
+        if (received < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                continue;
+            }
+            if (errno == EBADF)
+            {
+                break; // socket closed
+            }
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "recvmmsg() failed: {}", strerror(errno));
+            break;
+        }
+
+        // One read of each clock for the batch; kernel timestamps are moved onto the steady
+        // clock by the offset between the two
+        const IngestTime batchTime{utils::getCurrentTimeMillisSteadyClock(),
+                                   utils::getCurrentTimeMillisSystemClock()};
+        for (int i = 0; i < received; ++i)
+        {
+            msghdr& hdr = msgs[i].msg_hdr;
+            IngestTime time = batchTime;
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr;
+                 cmsg = CMSG_NXTHDR(&hdr, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+                {
+                    uint32_t drops = 0;
+                    std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                    stats.kernelDrops.store(drops, std::memory_order_relaxed);
+                }
+                else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+                {
+                    timespec ts{};
+                    std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                    time = kernelIngestTime(
+                        int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000, batchTime);
+                }
+            }
+
+            if (hdr.msg_flags & MSG_TRUNC)
+            {
+                stats.datagramsTruncated.fetch_add(1, std::memory_order_relaxed);
+            }
+            else if (msgs[i].msg_len > 0)
+            {
+                stats.datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+                stats.bytesReceived.fetch_add(msgs[i].msg_len, std::memory_order_relaxed);
+                utils::ScopedTimer decodeTimer(*stats.decodeLatency);
+                handlePacket(static_cast<const char*>(iov[i].iov_base),
+                             msgs[i].msg_len,
+                             workerId,
+                             time,
+                             batch);
+            }
+            msgs[i].msg_len = 0;
+            hdr.msg_namelen = sizeof(sockaddr_in);
+            hdr.msg_controllen = CONTROL_SIZE;
+            hdr.msg_flags = 0;
+        }
+
+        if (!batch.empty())
+        {
+            applyRecords(batch, stats);
+        }
+    }
+
+    unregisterIngestSocket(sockfd);
+    ::close(sockfd);
+
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Run loop exiting (worker {}): received {} datagrams, {} kernel drops",
+                       workerId,
+                       stats.datagramsReceived.load(),
+                       stats.kernelDrops.load());
+}
+
+void
+FlowLinkUsageCollector::registerIngestSocket(int sockfd)
+{
+    std::lock_guard lock(m_ingestFilterMutex);
+    m_ingestSockets.push_back(sockfd);
+    if (!m_ingestFilter.empty())
+    {
+        attachIngestFilter(sockfd);
+    }
+}
+
+void
+FlowLinkUsageCollector::unregisterIngestSocket(int sockfd)
+{
+    std::lock_guard lock(m_ingestFilterMutex);
+    std::erase(m_ingestSockets, sockfd);
+}
+
+bool
+FlowLinkUsageCollector::attachIngestFilter(int sockfd)
+{
+    sock_fprog program{static_cast<unsigned short>(m_ingestFilter.size()), m_ingestFilter.data()};
+    // Replaces the previous program atomically: every datagram sees one or the other
+    if (setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) < 0)
+    {
+        ++m_ingestFilterFailures;
+        SPDLOG_LOGGER_WARN(Logger::instance(), "SO_ATTACH_FILTER failed: {}", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void
+FlowLinkUsageCollector::refreshIngestFilter()
+{
+    IngestFilterSpec spec;
+    spec.agents = m_topologyAndFlowMonitor->getSwitchIps();
+    spec.dropCounterOnly = m_mode == utils::MININET;
+
+    std::lock_guard lock(m_ingestFilterMutex);
+    if (!m_ingestFilter.empty() && spec == m_ingestFilterSpec)
+    {
+        return;
+    }
+    if (spec.agents.size() > INGEST_FILTER_MAX_AGENTS)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "{} sFlow agents exceed the in-kernel filter's {}; not filtering agents",
+                           spec.agents.size(),
+                           INGEST_FILTER_MAX_AGENTS);
+    }
+    m_ingestFilter = compileIngestFilter(spec);
+    m_ingestFilterSpec = std::move(spec);
+    ++m_ingestFilterUpdates;
+    for (int sockfd : m_ingestSockets)
+    {
+        attachIngestFilter(sockfd);
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "sFlow socket filter: {} agents, {} instructions",
+                       m_ingestFilterSpec.agents.size(),
+                       m_ingestFilter.size());
+}
+
+void
+FlowLinkUsageCollector::controlSampling()
+{
+    std::unordered_map<uint32_t, uint64_t> samples;
+    uint64_t drops = 0;
+    for (const auto& stats : m_ingestStats)
+    {
+        {
+            std::lock_guard lock(stats->agentSamplesMutex);
+            for (const auto& [agentIp, count] : stats->agentFlowSamples)
+            {
+                samples[agentIp] += count;
+            }
+            stats->agentFlowSamples.clear();
+        }
+        drops += stats->kernelDrops.load(std::memory_order_relaxed) +
+                 stats->ringOverflows.load(std::memory_order_relaxed);
+    }
+    const bool dropping = drops > m_samplingDrops;
+    m_samplingDrops = drops;
+
+    std::vector<AgentSampleLoad> loads;
+    loads.reserve(samples.size());
+    for (const auto& [agentIp, count] : samples)
+    {
+        loads.push_back({agentIp, count * 1000.0 / SAMPLING_CONTROL_PERIOD_MS});
+    }
+    m_samplingController->step(loads, dropping);
+}
+
+json
+FlowLinkUsageCollector::getSamplingControlStatsJson() const
+{
+    if (!m_samplingController)
+    {
+        return json{{"enabled", false}};
+    }
+    json stats = m_samplingController->statsJson();
+    stats["enabled"] = true;
+    return stats;
+}
+
+json
+FlowLinkUsageCollector::getIngestFilterStatsJson() const
+{
+    std::lock_guard lock(m_ingestFilterMutex);
+    const bool agentCheck = m_ingestFilterSpec.agents.size() <= INGEST_FILTER_MAX_AGENTS;
+    return json{
+        {"enabled", !m_ingestFilter.empty()},
+        {"agents", agentCheck ? m_ingestFilterSpec.agents.size() : 0},
+        {"drop_counter_only", m_ingestFilterSpec.dropCounterOnly},
+        {"instructions", m_ingestFilter.size()},
+        {"sockets", m_ingestSockets.size()},
+        {"updates", m_ingestFilterUpdates},
+        {"attach_failures", m_ingestFilterFailures},
+    };
+}
+
+void
+FlowLinkUsageCollector::receiveWithUring(size_t workerId, UringReceiver& receiver)
+{
+    IngestWorkerStats& stats = *m_ingestStats[workerId];
+    const int POLL_TIMEOUT_MS = 1000;
+    std::vector<UringReceiver::Datagram> datagrams;
+    std::vector<IngestRecord> batch;
+    while (m_running.load() && receiver.poll(POLL_TIMEOUT_MS, datagrams))
+    {
+        const IngestTime batchTime{utils::getCurrentTimeMillisSteadyClock(),
+                                   utils::getCurrentTimeMillisSystemClock()};
+        for (const auto& datagram : datagrams)
+        {
+            if (datagram.socketDrops >= 0)
+            {
+                stats.kernelDrops.store(datagram.socketDrops, std::memory_order_relaxed);
+            }
+            if (datagram.truncated)
+            {
+                stats.datagramsTruncated.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (datagram.length == 0)
+            {
+                continue;
+            }
+            stats.datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+            stats.bytesReceived.fetch_add(datagram.length, std::memory_order_relaxed);
+            utils::ScopedTimer decodeTimer(*stats.decodeLatency);
+            handlePacket(datagram.data,
+                         datagram.length,
+                         workerId,
+                         datagram.receivedMs ? kernelIngestTime(datagram.receivedMs, batchTime)
+                                             : batchTime,
+                         batch);
+        }
+        if (!batch.empty())
+        {
+            applyRecords(batch, stats);
+        }
+    }
+}
+
+void
+FlowLinkUsageCollector::captureFromRing(size_t workerId)
+{
+    // One fanout group per process: the workers of this collector share it
+    const int fanoutGroup = m_ingestConfig.workerCount > 1 ? int(::getpid() & 0xffff) : -1;
+    PacketRingCapture capture(m_ingestConfig.captureInterface, m_sflowPort, fanoutGroup);
+    IngestWorkerStats& stats = *m_ingestStats[workerId];
+
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Capturing sFlow to UDP port {} on {} through a packet ring (worker {}/{})",
+                       m_sflowPort,
+                       m_ingestConfig.captureInterface,
+                       workerId + 1,
+                       m_ingestConfig.workerCount);
+
+    const int POLL_TIMEOUT_MS = 1000;
+    std::vector<PacketRingCapture::Datagram> datagrams;
+    std::vector<IngestRecord> batch;
+    int64_t dropsReadMs = 0;
+    while (m_running.load() && capture.poll(POLL_TIMEOUT_MS, datagrams))
+    {
+        const IngestTime batchTime{utils::getCurrentTimeMillisSteadyClock(),
+                                   utils::getCurrentTimeMillisSystemClock()};
+        for (const auto& datagram : datagrams)
+        {
+            stats.datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+            stats.bytesReceived.fetch_add(datagram.length, std::memory_order_relaxed);
+            utils::ScopedTimer decodeTimer(*stats.decodeLatency);
+            handlePacket(datagram.data,
+                         datagram.length,
+                         workerId,
+                         kernelIngestTime(datagram.receivedMs, batchTime),
+                         batch);
+        }
+        if (!batch.empty())
+        {
+            applyRecords(batch, stats);
+        }
+
+        // A system call each; once a second is enough for a counter
+        if (batchTime.steadyMs - dropsReadMs >= 1000)
+        {
+            dropsReadMs = batchTime.steadyMs;
+            stats.kernelDrops.store(capture.kernelDrops(), std::memory_order_relaxed);
+            stats.datagramsTruncated.store(capture.malformedFrames(), std::memory_order_relaxed);
+        }
+    }
+
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Capture loop exiting (worker {}): received {} datagrams, {} kernel drops",
+                       workerId,
+                       stats.datagramsReceived.load(),
+                       capture.kernelDrops());
+}
+
+void
+FlowLinkUsageCollector::aggregate(size_t workerId)
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Aggregator for ingest worker {} starts", workerId);
+    utils::ThreadRegistry::Scope thread("sflow-agg-" + std::to_string(workerId));
+    utils::MemoryPolicy::instance().countTlbMisses("sflow-agg-" + std::to_string(workerId));
+
+    constexpr size_t MAX_DRAIN = 1024;
+    auto& ring = *m_ingestRings[workerId];
+    IngestWorkerStats& stats = *m_ingestStats[workerId];
+    std::vector<IngestRecord> batch;
+    batch.reserve(MAX_DRAIN);
+    IngestRecord record;
+
+    while (m_running.load())
+    {
+        while (batch.size() < MAX_DRAIN && ring.tryPop(record))
+        {
+            batch.push_back(std::move(record));
+        }
+        if (batch.empty())
+        {
+            this_thread::sleep_for(chrono::microseconds(100));
+            continue;
+        }
+        thread.wake();
+        applyRecords(batch, stats);
+        thread.idle();
+    }
+
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Aggregator for ingest worker {} exiting", workerId);
+}
+
+void
+FlowLinkUsageCollector::receiveFromNodes()
+{
+    utils::ThreadRegistry::Scope thread("cluster-rx");
+    int sockfd = -1;
+    try
+    {
+        sockfd = openIngestSocket(false, m_clusterListenPort);
+    }
+    catch (const std::exception& e)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(),
+                            "Cluster coordinator cannot listen on port {}: {}",
+                            m_clusterListenPort,
+                            e.what());
+        return;
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Receiving cluster nodes' samples on port {}",
+                       m_clusterListenPort);
+
+    std::vector<char> buffer(BUFFER_SIZE);
+    std::vector<IngestRecord> batch;
+    while (m_running.load())
+    {
+        pollfd pfd{sockfd, POLLIN, 0};
+        if (::poll(&pfd, 1, 100) <= 0)
+        {
+            continue;
+        }
+        for (int i = 0; i < SFLOW_RECV_BATCH_SIZE; ++i)
+        {
+            const ssize_t n = ::recv(sockfd, buffer.data(), buffer.size(), 0);
+            if (n < 0)
+            {
+                break;
+            }
+            m_clusterStats.datagramsReceived.fetch_add(1, std::memory_order_relaxed);
+            m_clusterStats.bytesReceived.fetch_add(n, std::memory_order_relaxed);
+            if (!decodeClusterMessage(buffer.data(), n, batch))
+            {
+                m_clusterStats.malformedDatagrams.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (!batch.empty())
+        {
+            applyRecords(batch, m_clusterStats);
+        }
+    }
+    ::close(sockfd);
+}
+
+void
+FlowLinkUsageCollector::applyRecords(std::vector<IngestRecord>& records, IngestWorkerStats& stats)
+{
+    // A cluster node leaves the flow table to its coordinator
+    if (m_clusterForwarder)
+    {
+        m_clusterForwarder->send(records);
+        stats.recordsApplied.fetch_add(records.size(), std::memory_order_relaxed);
+        records.clear();
+        return;
+    }
+
+    // Reused across calls so the steady state does not allocate
+    thread_local std::vector<PreparedFlowSample> flowSamples;
+    thread_local std::vector<TimedCounterSample> counterSamples;
+    flowSamples.clear();
+    counterSamples.clear();
+
+    for (const auto& record : records)
+    {
+        if (const auto* counter = std::get_if<CounterSampleRecord>(&record.sample))
+        {
+            counterSamples.emplace_back(record.agentIp, *counter, record.time.steadyMs);
+        }
+        else if (auto prepared = prepareFlowSample(
+                     record.agentIp, std::get<FlowSampleRecord>(record.sample), record.time))
+        {
+            if (m_aggregation.mode == FlowAggregation::FiveTuple)
+            {
+                flowSamples.push_back(*prepared);
+                continue;
+            }
+            if (m_aggregation.keepFiveTuple)
+            {
+                flowSamples.push_back(*prepared);
+                prepared->touchesEdges = false;
+            }
+            prepared->key = aggregateKey(prepared->key);
+            prepared->shard = flowShardIndex(prepared->key);
+            flowSamples.push_back(*prepared);
+        }
+    }
+    if (!counterSamples.empty())
+    {
+        applyCounterSamples(counterSamples);
+    }
+
+    // Group by shard (stable, so samples of one flow keep their arrival order) and take
+    // each shard lock once for the whole group.
+    std::stable_sort(flowSamples.begin(),
+                     flowSamples.end(),
+                     [](const PreparedFlowSample& a, const PreparedFlowSample& b) {
+                         return a.shard < b.shard;
+                     });
+
+    uint64_t lockAcquisitions = 0;
+    for (size_t begin = 0; begin < flowSamples.size();)
+    {
+        size_t shardIndex = flowSamples[begin].shard;
+        size_t end = begin;
+        FlowTableShard& shard = m_flowInfoShards[shardIndex];
+        {
+            unique_lock lock(shard.mutex);
+            for (; end < flowSamples.size() && flowSamples[end].shard == shardIndex; ++end)
+            {
+                PreparedFlowSample& sample = flowSamples[end];
+                if (m_bidirectionalFlows && sample.isPureAck && mergeReverseAck(shard, sample))
+                {
+                    // The links it crossed belong to the reverse path, not the flow's
+                    sample.touchesEdges = false;
+                    continue;
+                }
+                sample.admitted = updateFlowInfo(shard, sample);
+            }
+        }
+        ++lockAcquisitions;
+        begin = end;
+    }
+
+    for (const auto& sample : flowSamples)
+    {
+        if (sample.admitted && sample.touchesEdges)
+        {
+            touchFlowEdges(sample);
+        }
+    }
+
+    stats.flowSamplesApplied.fetch_add(flowSamples.size(), std::memory_order_relaxed);
+    stats.flowShardLocks.fetch_add(lockAcquisitions, std::memory_order_relaxed);
+    stats.recordsApplied.fetch_add(records.size(), std::memory_order_relaxed);
+    records.clear();
+}
+
+void
+FlowLinkUsageCollector::handlePacket(const char* buffer,
+                                     size_t length,
+                                     size_t workerId,
+                                     const IngestTime& time,
+                                     std::vector<IngestRecord>& batch)
+{
+    DatagramView datagram(buffer, length);
+    IngestWorkerStats& stats = *m_ingestStats[workerId];
+    if (!datagram.valid())
+    {
+        stats.malformedDatagrams.fetch_add(1, std::memory_order_relaxed);
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Dropping malformed or unsupported sFlow datagram (version {}, {} "
+                           "bytes)",
+                           datagram.version(),
+                           length);
+        return;
+    }
+
+    uint32_t agentIp = datagram.agentIp();
+    utils::SpscRing<IngestRecord>* ring =
+        m_ingestRings.empty() ? nullptr : m_ingestRings[workerId].get();
+
+    NDT_LOG_TRACE(INGEST, "Version: {}", datagram.version());
+    NDT_LOG_TRACE(INGEST, "Agent Address: {}", utils::Ipv4{agentIp});
+    NDT_LOG_TRACE(INGEST, "Sample Count: {}", datagram.sampleCount());
+
+    // Either hand the record to this worker's aggregator or collect it for the batch that
+    // the receive loop applies after the whole recvmmsg batch has been decoded
+    auto dispatch = [&](IngestRecord&& record) {
+        if (ring == nullptr)
+        {
+            batch.push_back(std::move(record));
+        }
+        else if (!ring->tryPush(std::move(record)))
+        {
+            stats.ringOverflows.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    // The decoders of each agent, picked by the first sample type it sends rather than per
+    // sample. An agent's datagrams all reach one worker, so the cache is the worker's own
+    thread_local std::unordered_map<uint32_t, const DecoderProfile*> agentProfiles;
+    const DecoderProfile*& profile = agentProfiles[agentIp];
+    uint64_t flowSamples = 0;
+    utils::FlightRecorder& recorder = utils::FlightRecorder::instance();
+
+    for (const SampleView& sample : datagram)
+    {
+        const uint32_t type = sample.type();
+        if (profile == nullptr || !profile->decodes(type))
+        {
+            const DecoderProfile* found = profileForSampleType(type, m_mode == utils::MININET);
+            if (found == nullptr)
+            {
+                stats.sampleErrors.fetch_add(1, std::memory_order_relaxed);
+                SPDLOG_LOGGER_ERROR(Logger::instance(), "Unknown sampleType {}", type);
+                continue;
+            }
+            profile = found;
+            NDT_LOG_DEBUG(INGEST, "Agent {} decoded as {}", utils::Ipv4{agentIp}, profile->name);
+        }
+
+        if (type == profile->counterType)
+        {
+            if (auto rec = profile->decodeCounters(sample))
+            {
+                stats.counterSamplesDecoded.fetch_add(1, std::memory_order_relaxed);
+                recorder.recordCounterSample(agentIp,
+                                             rec->interfaceIndex,
+                                             rec->inputOctets,
+                                             rec->outputOctets,
+                                             rec->interfaceStatus);
+                dispatch({agentIp, *rec, time});
+            }
+            else
+            {
+                stats.sampleErrors.fetch_add(1, std::memory_order_relaxed);
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "Truncated counter sample type {} from agent {}",
+                                   type,
+                                   utils::Ipv4{agentIp});
+            }
+        }
+        else if (auto rec = profile->decodeFlows(sample))
+        {
+            stats.flowSamplesDecoded.fetch_add(1, std::memory_order_relaxed);
+            ++flowSamples;
+            recorder.recordFlowSample(agentIp,
+                                      rec->srcIp,
+                                      rec->dstIp,
+                                      rec->srcPort,
+                                      rec->dstPort,
+                                      rec->protocol,
+                                      rec->inputPort,
+                                      rec->outputPort,
+                                      rec->frameLength);
+            dispatch({agentIp, *rec, time});
+        }
+        else
+        {
+            stats.sampleErrors.fetch_add(1, std::memory_order_relaxed);
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "Truncated flow sample type {} from agent {}",
+                               type,
+                               utils::Ipv4{agentIp});
+        }
+    }
+
+    if (m_samplingController && flowSamples > 0)
+    {
+        std::lock_guard lock(stats.agentSamplesMutex);
+        stats.agentFlowSamples[agentIp] += flowSamples;
+    }
+}
+
+//================================================================
+// Handle Counter Samples (Brocade Type 2 and HPE Type 4)
+//================================================================
+void
+FlowLinkUsageCollector::applyCounterSamples(const std::vector<TimedCounterSample>& samples)
+{
+    thread_local std::vector<LinkCounterUpdate> updates;
+    updates.clear();
+
+    // One lock for the batch, each report timed by its datagram's arrival; a port reported
+    // twice within a second keeps only the first report, as it always did
+    {
+        std::lock_guard counterLock(m_counterReportsMutex);
+        for (const auto& [agentIp, rec, receivedMs] : samples)
+        {
+            if (auto update = handleCounterSample(agentIp, rec, receivedMs))
+            {
+                updates.push_back(*update);
+            }
+        }
+    }
+
+    for (const auto& update : updates)
+    {
+        m_topologyAndFlowMonitor->updateLinkInfo(
+            update.agentIpAndPort, update.leftIn, update.leftOut, update.interfaceSpeed);
+    }
+
+    if (!m_linkLiveness)
+    {
+        return;
+    }
+    thread_local std::vector<LinkLivenessMonitor::Transition> transitions;
+    transitions.clear();
+    for (const auto& [agentIp, rec, receivedMs] : samples)
+    {
+        m_linkLiveness->observe(agentIp,
+                                rec.interfaceIndex,
+                                rec.interfaceStatus,
+                                linkFlowCount(agentIp, rec.interfaceIndex),
+                                receivedMs,
+                                transitions);
+    }
+    handleLinkTransitions(transitions);
+}
+
+size_t
+FlowLinkUsageCollector::linkFlowCount(uint32_t agentIp, uint32_t ifIndex) const
+{
+    auto edge = m_topologyAndFlowMonitor->findEdgeByAgentIpAndPort({agentIp, ifIndex});
+    return edge ? m_topologyAndFlowMonitor->getEdgeStats(*edge).second : 0;
+}
+
+void
+FlowLinkUsageCollector::sweepLinkLiveness()
+{
+    std::vector<LinkLivenessMonitor::Transition> transitions;
+    m_linkLiveness->sweep(
+        utils::getCurrentTimeMillisSteadyClock(),
+        [this](uint32_t agentIp, uint32_t ifIndex) { return linkFlowCount(agentIp, ifIndex); },
+        transitions);
+    handleLinkTransitions(transitions);
+}
+
+void
+FlowLinkUsageCollector::handleLinkTransitions(
+    const std::vector<LinkLivenessMonitor::Transition>& transitions)
+{
+    for (const auto& transition : transitions)
+    {
+        auto edge = m_topologyAndFlowMonitor->findEdgeByAgentIpAndPort(
+            {transition.agentIp, transition.ifIndex});
+        if (!edge)
+        {
+            NDT_LOG_DEBUG(INGEST,
+                          "Port {}:{} {} ({}), no link on it",
+                          utils::Ipv4{transition.agentIp},
+                          transition.ifIndex,
+                          transition.down ? "down" : "up",
+                          linkFailureCauseName(transition.cause));
+            continue;
+        }
+        // Edges are only added while the static topology is loaded, so the descriptor found
+        // in the live graph is valid in the snapshot
+        auto snapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+        const EdgeProperties& props = snapshot->graph[*edge];
+        const LinkFailedEventPayload link{
+            props.srcDpid, props.srcInterface, props.dstDpid, props.dstInterface};
+        const uint64_t port = counterKey(transition.agentIp, transition.ifIndex);
+        auto reverse = m_topologyAndFlowMonitor->findReverseEdge(*edge);
+
+        if (!transition.down)
+        {
+            {
+                std::lock_guard lock(m_livenessDownMutex);
+                if (m_livenessDownPorts.erase(port) == 0)
+                {
+                    continue; // not set down by us: the controller reports its recovery
+                }
+            }
+            SPDLOG_LOGGER_INFO(Logger::instance(),
+                               "Link {}:{} -> {}:{} is up again in the sFlow counters",
+                               link.srcDpid,
+                               link.srcInterface,
+                               link.dstDpid,
+                               link.dstInterface);
+            LinkStateChangedEventData change;
+            {
+                auto transaction = m_topologyAndFlowMonitor->beginGraphTransaction();
+                transaction.setEdgeUp(*edge, true);
+                if (reverse)
+                {
+                    transaction.setEdgeUp(*reverse, true);
+                }
+                change = transaction.commit();
+            }
+            m_livenessRestored.fetch_add(1, std::memory_order_relaxed);
+            if (m_eventBus)
+            {
+                m_eventBus->channel<LinkStateChangedEventData>(EventType::LinkStateChanged)
+                    .publish(std::move(change));
+            }
+            continue;
+        }
+
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Link {}:{} -> {}:{} looks down in the sFlow counters ({}, confidence "
+                           "{:.2f}, {} ms since the port's last sample)",
+                           link.srcDpid,
+                           link.srcInterface,
+                           link.dstDpid,
+                           link.dstInterface,
+                           linkFailureCauseName(transition.cause),
+                           transition.confidence,
+                           transition.silentMs);
+        LinkFailureEventData event;
+        event.failedEdge = *edge;
+        event.link = link;
+        event.cause = transition.cause;
+        event.confidence = transition.confidence;
+        if (m_linkLivenessApply.load(std::memory_order_relaxed) && props.isUp &&
+            transition.confidence >= LINK_LIVENESS_APPLY_CONFIDENCE)
+        {
+            // As for a link_failure_detected notification: both directions down, the flows
+            // through them re-resolved, one failover trace
+            const auto detectedAt = std::chrono::steady_clock::now();
+            const utils::TraceId trace =
+                utils::Tracer::instance().begin("link_failure",
+                                                detectedAt,
+                                                {{"src_dpid", link.srcDpid},
+                                                 {"src_interface", link.srcInterface},
+                                                 {"dst_dpid", link.dstDpid},
+                                                 {"dst_interface", link.dstInterface},
+                                                 {"cause", linkFailureCauseName(transition.cause)},
+                                                 {"confidence", transition.confidence}});
+            LinkStateChangedEventData change;
+            {
+                auto transaction = m_topologyAndFlowMonitor->beginGraphTransaction();
+                transaction.setEdgeUp(*edge, false);
+                if (reverse)
+                {
+                    transaction.setEdgeUp(*reverse, false);
+                }
+                change = transaction.commit();
+            }
+            change.affectedFlows = invalidatePathsThrough(link.srcDpid, link.srcInterface, trace);
+            if (reverse)
+            {
+                auto reverseFlows = invalidatePathsThrough(link.dstDpid, link.dstInterface, trace);
+                change.affectedFlows.insert(
+                    change.affectedFlows.end(), reverseFlows.begin(), reverseFlows.end());
+            }
+            event.affectedFlows = change.affectedFlows;
+            event.applied = true;
+            change.trace = trace;
+            change.publishedAt = std::chrono::steady_clock::now();
+            {
+                std::lock_guard lock(m_livenessDownMutex);
+                m_livenessDownPorts.insert(port);
+            }
+            m_livenessApplied.fetch_add(1, std::memory_order_relaxed);
+            if (m_eventBus)
+            {
+                m_eventBus->channel<LinkStateChangedEventData>(EventType::LinkStateChanged)
+                    .publish(std::move(change));
+            }
+        }
+        if (m_eventBus)
+        {
+            m_eventBus->channel<LinkFailureEventData>(EventType::LinkFailureDetected)
+                .publish(std::move(event));
+        }
+    }
+}
+
+std::optional<FlowLinkUsageCollector::LinkCounterUpdate>
+FlowLinkUsageCollector::handleCounterSample(uint32_t agentIp,
+                                            const CounterSampleRecord& rec,
+                                            int64_t nowMs)
+{
+    NDT_LOG_TRACE(INGEST,
+                  "============{} Counter Sample ==============",
+                  (rec.sampleType == 2) ? "Brocade" : "HPE");
+
+    NDT_LOG_TRACE(INGEST,
+                  "COUNTER SAMPLE {} from Agent {}: ifIndex={}, ifSpeed={}, "
+                  "ifInOctets={}, ifOutOctets={}",
+                  rec.sampleType,
+                  utils::Ipv4{agentIp},
+                  rec.interfaceIndex,
+                  rec.interfaceSpeed,
+                  rec.inputOctets,
+                  rec.outputOctets);
+
+    if (m_mode == utils::MININET)
+    {
+        NDT_LOG_TRACE(INGEST, "==========================================\n");
+        return std::nullopt;
+    }
+
+    pair<uint32_t, uint32_t> agentIpAndPort(agentIp, rec.interfaceIndex);
+    CounterInfo& counter = m_counterReports[counterKey(agentIp, rec.interfaceIndex)];
+    std::optional<LinkCounterUpdate> update;
+
+    // Rates use the interval in milliseconds; reports less than a second apart are still
+    // skipped so a duplicate does not turn into a burst
+    const int64_t intervalMs = nowMs - counter.lastReportTimestampInMilliseconds;
+    if (intervalMs < 1000)
+    {
+        return std::nullopt;
+    }
+
+    // Check if this is not the first report
+    if (counter.lastReportTimestampInMilliseconds != 0)
+    {
+        NDT_LOG_TRACE(INGEST,
+                      "Agent Address: {}, Sample Len: {}, Iface Index: {}, Iface Speed: {}",
+                      utils::Ipv4{agentIp},
+                      rec.sampleLength,
+                      rec.interfaceIndex,
+                      rec.interfaceSpeed);
+
+        uint64_t avgIn = 0, avgOut = 0;
+        bool inNoOverflow = false, outNoOverflow = false;
+
+        if (rec.inputOctets >= counter.lastReceivedInputOctets)
+        {
+            uint64_t inputOctetsDiff = rec.inputOctets - counter.lastReceivedInputOctets;
+            avgIn = inputOctetsDiff * 8000 / intervalMs; // Calculate average bits per second
+            inNoOverflow = true;
+            NDT_LOG_TRACE(INGEST, "Average Link Usage (In): {}", avgIn);
+        }
+        if (rec.outputOctets >= counter.lastReceivedOutputOctets)
+        {
+            uint64_t outputOctetsDiff = rec.outputOctets - counter.lastReceivedOutputOctets;
+            avgOut = outputOctetsDiff * 8000 / intervalMs; // Calculate average bits per second
+            outNoOverflow = true;
+            NDT_LOG_TRACE(INGEST, "Average Link Usage (Out): {}", avgOut);
+        }
+
+        uint64_t leftIn = (avgIn > rec.interfaceSpeed) ? 0 : (rec.interfaceSpeed - avgIn);
+        uint64_t leftOut = (avgOut > rec.interfaceSpeed) ? 0 : (rec.interfaceSpeed - avgOut);
+
+        NDT_LOG_TRACE(INGEST, "left_in in SFlow Collector: {} (bps)", leftIn);
+        NDT_LOG_TRACE(INGEST, "left_out in SFlow Collector: {} (bps)", leftOut);
+
+        if (inNoOverflow && outNoOverflow)
+        {
+            update = LinkCounterUpdate{agentIpAndPort, leftIn, leftOut, rec.interfaceSpeed};
+        }
+    }
+
+    // Update state for the next calculation
+    counter.lastReportTimestampInMilliseconds = nowMs;
+    counter.lastReceivedInputOctets = rec.inputOctets;
+    counter.lastReceivedOutputOctets = rec.outputOctets;
+
+    NDT_LOG_TRACE(INGEST, "==========================================\n");
+    return update;
+}
+
+//================================================================
+// Handle Flow Samples (Brocade Type 1 and HPE Type 3)
+//================================================================
+std::optional<FlowLinkUsageCollector::PreparedFlowSample>
+FlowLinkUsageCollector::prepareFlowSample(uint32_t agentIp,
+                                          const FlowSampleRecord& rec,
+                                          const IngestTime& time)
+{
+    NDT_LOG_TRACE(INGEST, "etherType = 0x{:04x}", rec.etherType);
+    if (!rec.isIpv4())
+    {
+        NDT_LOG_TRACE(INGEST, "Not IPv4 packet, etherType {}", rec.etherType);
+        return std::nullopt;
+    }
+
+    uint32_t inputPort = rec.inputPort;
+    uint32_t outputPort = rec.outputPort;
+    uint32_t frameLength = rec.frameLength;
+    uint32_t samplingRate = rec.samplingRate;
+    uint8_t protocol = rec.protocol;
+
+    if (m_mode == utils::TESTBED)
+    {
+        NDT_LOG_TRACE(INGEST,
+                      "FLOW SAMPLE from Agent {}: {} -> {} (Proto: {}, Len: {}, Input "
+                      "port: {}, Ouput port: {} ICMP type {} ICMP code {}, Sampling rate {})",
+                      utils::Ipv4{agentIp},
+                      utils::Ipv4{rec.srcIp},
+                      utils::Ipv4{rec.dstIp},
+                      protocol,
+                      frameLength,
+                      inputPort,
+                      outputPort,
+                      rec.icmpType,
+                      rec.icmpCode,
+                      samplingRate);
+    }
+
+    // check whether it is pure ack
+    bool isPureAck = false;
+    if (protocol == 6) // Check if it's a TCP packet first
+    {
+        const uint32_t PURE_ACK_SIZE_THRESHOLD = 80; // Your proposed threshold
+
+        // isAck should be true if the ACK flag is set
+        if (rec.isAck && frameLength < PURE_ACK_SIZE_THRESHOLD)
+        {
+            NDT_LOG_TRACE(INGEST, "Pure ACK packet (size: {} bytes)", frameLength);
+            isPureAck = true;
+        }
+    }
+
+    // Process the extracted data using common logic.
+    if (protocol != 6 && protocol != 17 && protocol != 1) // TCP, UDP, or ICMP
+    {
+        return std::nullopt;
+    }
+
+    if (m_mode == utils::MININET)
+    {
+        // Lock-free unless OVSDB published a new map since this thread last looked
+        const IfIndexMap& ifIndexMap = ifIndexToOfport();
+        auto toOfport = [&ifIndexMap](uint32_t ifIndex) -> uint32_t {
+            auto ofportIt = ifIndexMap.find(ifIndex);
+            return ofportIt != ifIndexMap.end() ? ofportIt->second : 0;
+        };
+        inputPort = toOfport(inputPort);
+        outputPort = toOfport(outputPort);
+        NDT_LOG_TRACE(INGEST,
+                      "FLOW SAMPLE in Mininet from Agent {}: {} -> {} (Proto: {}, Len: {}, "
+                      "Input port: {}, Ouput port: {})",
+                      utils::Ipv4{agentIp},
+                      utils::Ipv4{rec.srcIp},
+                      utils::Ipv4{rec.dstIp},
+                      protocol,
+                      frameLength,
+                      inputPort,
+                      outputPort);
+    }
+
+    bool isIngress = (inputPort != 0); // Simple direction check
+    uint32_t relevantPort = isIngress ? inputPort : outputPort;
+
+    NDT_LOG_TRACE(INGEST,
+                  "Flow Sample Recieve Src Ip {}, Dst Ip {}",
+                  utils::Ipv4{rec.srcIp},
+                  utils::Ipv4{rec.dstIp});
+
+    FlowKey key = {};
+    if (protocol != 1)
+    {
+        key = {rec.srcIp, rec.dstIp, rec.srcPort, rec.dstPort, protocol};
+    }
+    else
+    {
+        key = {rec.srcIp, rec.dstIp, rec.icmpType, rec.icmpCode, protocol};
+    }
+
+    AgentKey agentKey = {agentIp, relevantPort};
+
+    if (m_mode == utils::MININET)
+    {
+        std::lock_guard counterLock(m_counterReportsMutex);
+        m_counterReports[counterKey(agentIp, relevantPort)]
+            .inputByteCountOnALinkMultiplySampingRate += uint64_t(frameLength) * samplingRate;
+    }
+
+    return PreparedFlowSample{key,
+                              key,
+                              agentKey,
+                              flowShardIndex(key),
+                              frameLength,
+                              samplingRate,
+                              isIngress,
+                              rec.isAck,
+                              isPureAck,
+                              time};
+}
+
+FlowKey
+FlowLinkUsageCollector::aggregateKey(const FlowKey& key) const
+{
+    const bool hosts = m_aggregation.mode == FlowAggregation::HostPair;
+    const uint32_t srcMask = utils::prefixToMaskHost(hosts ? 32 : m_aggregation.srcPrefixLength);
+    const uint32_t dstMask = utils::prefixToMaskHost(hosts ? 32 : m_aggregation.dstPrefixLength);
+    FlowKey aggregate{};
+    aggregate.srcIP = key.srcIP & srcMask;
+    aggregate.dstIP = key.dstIP & dstMask;
+    return aggregate;
+}
+
+bool
+FlowLinkUsageCollector::updateFlowInfo(FlowTableShard& shard, PreparedFlowSample& sample)
+{
+    const FlowKey& key = sample.key;
+    const AgentKey& agentKey = sample.agentKey;
+    uint32_t frameLength = sample.frameLength;
+    bool isIngress = sample.isIngress;
+
+    auto it = findHotFlowNoLock(shard, key);
+    bool isNewFlow = it == shard.table.end();
+    if (isNewFlow)
+    {
+        // A full shard only takes flows heavy enough to matter, so a scan or a burst of
+        // short-lived keys costs sketch counters instead of flow entries
+        const bool gated = shard.table.size() >= FLOW_ADMIT_FREE_FLOWS;
+        if (gated)
+        {
+            const uint32_t bytes = static_cast<uint32_t>(std::min<uint64_t>(
+                uint64_t(frameLength) * sample.samplingRate, std::numeric_limits<uint32_t>::max()));
+            if (shard.admission.add(FlowKeyMixHash{}(key), bytes) < FLOW_ADMIT_MIN_BYTES)
+            {
+                ++shard.heldBackSamples;
+                shard.heldBackBytes += bytes;
+                return false;
+            }
+        }
+        if (m_shardFlowCap != 0 && shard.table.size() + shard.cold.size() >= m_shardFlowCap &&
+            !evictFlowNoLock(shard))
+        {
+            ++shard.rejected;
+            return false;
+        }
+        shard.promoted += gated;
+        it = shard.table.try_emplace(key, shard.pool.acquire()).first;
+    }
+    FlowInfo& flowInfo = it->second;
+    if (m_firstHopSampling && flowInfo.firstHopAgent != 0 && key.protocol != 0)
+    {
+        // The links come from the path at the next rate tick
+        sample.touchesEdges = false;
+        if (agentKey.agentIP != flowInfo.firstHopAgent)
+        {
+            ++shard.otherHopSamples;
+            flowInfo.endTime = std::max(flowInfo.endTime, sample.time.systemMs);
+            return true;
+        }
+        if (!flowInfo.pathTouchPending)
+        {
+            flowInfo.pathTouchPending = true;
+            shard.pathTouches.push_back(key);
+        }
+    }
+    if (!flowInfo.pendingRateUpdate)
+    {
+        flowInfo.pendingRateUpdate = true;
+        shard.rateDirty.push_back(key);
+    }
+    markFlowChanged(flowInfo); // latest_sampled_time moves with every sample
+    if (!isNewFlow) // Existing flow
+    {
+        // Find flow stasts on an agent
+        flowInfo.isPureAck = sample.isPureAck;
+        flowInfo.isAck = sample.isAck;
+
+        NDT_LOG_TRACE(INGEST, "Ack?{} PureAck?{} ", flowInfo.isAck, flowInfo.isPureAck);
+
+        auto& stats = flowInfo.agentFlowStats[agentKey];
+        stats.samplingRate = sample.samplingRate;
+
+        if (isIngress)
+        {
+            stats.ingressByteCountCurrent += uint64_t(frameLength);
+            stats.ingresspacketCountCurrent += 1;
+        }
+        else
+        {
+            stats.egressByteCountCurrent += uint64_t(frameLength);
+            stats.egresspacketCountCurrent += 1;
+        }
+
+        // Samples of other workers' batches may be applied out of order
+        stats.packetQueue.push({frameLength, sample.time.steadyMs});
+        flowInfo.endTime = std::max(flowInfo.endTime, sample.time.systemMs);
+    }
+    else // New flow
+    {
+        flowInfo.sampleKey = sample.sampleKey;
+        flowInfo.startTime = sample.time.systemMs;
+        flowInfo.endTime = sample.time.systemMs;
+        shard.expiry.schedule(key, flowInfo.endTime + flowHotTimeout());
+        shard.pathPending.push_back(key);
+        if (!m_pathWork.exchange(true, std::memory_order_acq_rel))
+        {
+            m_pathCv.notify_one();
+        }
+
+        // Initialize stats for the new flow
+        auto& stats = flowInfo.agentFlowStats[agentKey];
+        stats.samplingRate = sample.samplingRate;
+        if (isIngress)
+        {
+            stats.ingressByteCountCurrent = uint64_t(frameLength);
+            stats.egressByteCountCurrent = 0;
+            stats.ingresspacketCountCurrent = 1;
+            stats.egresspacketCountCurrent = 0;
+        }
+        else
+        {
+            stats.egressByteCountCurrent = uint64_t(frameLength);
+            stats.ingressByteCountCurrent = 0;
+            stats.egresspacketCountCurrent = 1;
+            stats.ingresspacketCountCurrent = 0;
+        }
+        stats.packetQueue.push({frameLength, sample.time.steadyMs});
+    }
+
+    NDT_LOG_TRACE(INGEST,
+                  "Flow Table Entry Updated for {} -> {}. End Time: {}",
+                  utils::Ipv4{key.srcIP},
+                  utils::Ipv4{key.dstIP},
+                  flowInfo.endTime);
+    return true;
+}
+
+bool
+FlowLinkUsageCollector::mergeReverseAck(FlowTableShard& shard, const PreparedFlowSample& sample)
+{
+    const FlowKey& key = sample.key;
+    if (key.protocol != 6)
+    {
+        return false; // aggregated copies keep every sample
+    }
+    auto it = findHotFlowNoLock(shard, reversedKey(key));
+    if (it == shard.table.end())
+    {
+        return false;
+    }
+    FlowInfo& flowInfo = it->second;
+    flowInfo.reverseAckBytes += uint64_t(sample.frameLength) * sample.samplingRate;
+    flowInfo.reverseAckPackets += sample.samplingRate;
+    flowInfo.endTime = std::max(flowInfo.endTime, sample.time.systemMs);
+    markFlowChanged(flowInfo);
+    ++shard.reverseAcksMerged;
+    return true;
+}
+
+bool
+FlowLinkUsageCollector::evictFlowNoLock(FlowTableShard& shard)
+{
+    if (!shard.cold.empty())
+    {
+        // Cold flows are idle already, so the least recent of the compared ones goes first
+        auto victim = shard.cold.end();
+        auto it = shard.cold.fromSlot(shard.coldEvictionHand);
+        for (size_t compared = 0; compared < FLOW_EVICTION_SAMPLES; ++compared, ++it)
+        {
+            if (it == shard.cold.end())
+            {
+                it = shard.cold.begin();
+            }
+            if (victim == shard.cold.end() || it->second.endTime < victim->second.endTime)
+            {
+                victim = it;
+            }
+        }
+        shard.coldEvictionHand = it == shard.cold.end() ? 0 : it.index();
+        const FlowKey key = victim->first;
+        removeColdFlowNoLock(shard, victim);
+        shard.evictedKeys.push_back(key);
+        ++shard.evicted;
+        return true;
+    }
+
+    const bool byRate = m_flowTableLimits.policy == FlowEvictionPolicy::LowestRate;
+    uint64_t victimRate = 0;
+
+    // A clock hand over the slots: each eviction compares the next few flows, so the cost is
+    // constant and every flow is looked at as the hand goes round
+    auto victim = shard.table.end();
+    auto it = shard.table.fromSlot(shard.evictionHand);
+    for (size_t compared = 0; compared < FLOW_EVICTION_SAMPLES; ++compared, ++it)
+    {
+        if (it == shard.table.end())
+        {
+            it = shard.table.begin();
+        }
+        const FlowInfo& info = it->second;
+        if (info.isElephantFlowPeriodically)
+        {
+            continue;
+        }
+        // Only the compared flows' rates are evaluated
+        const uint64_t rate = info.immediateRate().bps;
+        if (rate >= MICE_FLOW_UNDER_THRESHOLD)
+        {
+            continue;
+        }
+        if (victim == shard.table.end() ||
+            (byRate && rate != victimRate ? rate < victimRate
+                                          : info.endTime < victim->second.endTime))
+        {
+            victim = it;
+            victimRate = rate;
+        }
+    }
+    shard.evictionHand = it == shard.table.end() ? 0 : it.index();
+    if (victim == shard.table.end())
+    {
+        return false;
+    }
+
+    const FlowKey key = victim->first;
+    NDT_LOG_DEBUG(INGEST,
+                  "Flow table full, evicting {} -> {}",
+                  utils::Ipv4{key.srcIP},
+                  utils::Ipv4{key.dstIP});
+    removeFlowNoLock(shard, victim);
+    shard.evictedKeys.push_back(key);
+    ++shard.evicted;
+    return true;
+}
+
+void
+FlowLinkUsageCollector::retireFlowNoLock(const FlowKey& flowKey, const FlowInfo& info)
+{
+    if (info.estimatedFlowSendingRatePeriodically != 0 && inTrafficMatrix(flowKey))
+    {
+        const int64_t rate = static_cast<int64_t>(info.estimatedFlowSendingRatePeriodically);
+        const TrafficMatrix::Delta removed{flowKey.srcIP, flowKey.dstIP, -rate};
+        m_trafficMatrix.apply({&removed, 1});
+    }
+    if (m_flowExporter)
+    {
+        // Only queued here; the exporter's thread does the I/O
+        m_flowExporter->offer(FlowRecord::from(flowKey, info));
+    }
+    if (!info.flowPath.empty())
+    {
+        std::lock_guard guard(m_hopFlowsMutex);
+        reindexFlowPathNoLock(flowKey, info.flowPath, {});
+    }
+}
+
+void
+FlowLinkUsageCollector::removeFlowNoLock(FlowTableShard& shard, FlowInfoMap::iterator it)
+{
+    const FlowKey flowKey = it->first;
+    retireFlowNoLock(flowKey, it->second);
+    shard.pool.release(std::move(it->second));
+    shard.table.erase(it);
+    // Still under the shard lock, so a delta reader either saw the flow or will see its
+    // tombstone
+    recordFlowRemoval(flowKey);
+}
+
+void
+FlowLinkUsageCollector::removeColdFlowNoLock(FlowTableShard& shard, ColdFlowMap::iterator it)
+{
+    const FlowKey flowKey = it->first;
+    // A recycled FlowInfo stands in for the record while the exporter copies it
+    FlowInfo info = shard.pool.acquire();
+    coldFlowInfo(it->second, info);
+    retireFlowNoLock(flowKey, info);
+    shard.pool.release(std::move(info));
+    shard.cold.erase(it);
+    recordFlowRemoval(flowKey);
+}
+
+bool
+FlowLinkUsageCollector::demoteFlowNoLock(FlowTableShard& shard, FlowInfoMap::iterator it)
+{
+    const FlowInfo& info = it->second;
+    // The rate tasks only look flows up in the hot table, so a flow they still have to
+    // visit (or whose rate they still have to bring down to zero) stays there
+    if (info.pendingRateUpdate || info.pathTouchPending ||
+        info.estimatedFlowSendingRatePeriodically != 0 ||
+        info.estimatedPacketSendingRatePeriodically != 0)
+    {
+        return false;
+    }
+    ColdFlow cold;
+    cold.flowRatePeriodically = info.estimatedFlowSendingRatePeriodically;
+    cold.packetRatePeriodically = info.estimatedPacketSendingRatePeriodically;
+    cold.reverseAckBytes = info.reverseAckBytes;
+    cold.reverseAckPackets = info.reverseAckPackets;
+    cold.startTime = info.startTime;
+    cold.endTime = info.endTime;
+    cold.changedVersion = info.changedVersion;
+    cold.flowPath = info.flowPath;
+    cold.sampleKey = info.sampleKey;
+    cold.firstHopAgent = info.firstHopAgent;
+    cold.isElephantFlowPeriodically = info.isElephantFlowPeriodically;
+    cold.elephantAnnounced = info.elephantAnnounced;
+    cold.isAck = info.isAck;
+    cold.isPureAck = info.isPureAck;
+    shard.cold.try_emplace(it->first, std::move(cold));
+    shard.pool.release(std::move(it->second));
+    shard.table.erase(it);
+    ++shard.demotions;
+    return true;
+}
+
+FlowLinkUsageCollector::FlowInfoMap::iterator
+FlowLinkUsageCollector::findHotFlowNoLock(FlowTableShard& shard, const FlowKey& key)
+{
+    auto it = shard.table.find(key);
+    if (it != shard.table.end() || shard.cold.empty())
+    {
+        return it;
+    }
+    auto cold = shard.cold.find(key);
+    if (cold == shard.cold.end())
+    {
+        return it;
+    }
+    // Past any bound or admission check: the flow already counts against the shard's bound,
+    // which covers the hot and cold flows together
+    it = shard.table.try_emplace(key, shard.pool.acquire()).first;
+    FlowInfo& info = it->second;
+    coldFlowInfo(cold->second, info);
+    shard.cold.erase(cold);
+    ++shard.coldPromotions;
+    // Resolved again, as the topology or the rules may have changed while it was cold; its
+    // expiry entry is still scheduled
+    shard.pathPending.push_back(key);
+    if (!m_pathWork.exchange(true, std::memory_order_acq_rel))
+    {
+        m_pathCv.notify_one();
+    }
+    return it;
+}
+
+void
+FlowLinkUsageCollector::touchFlowEdges(const PreparedFlowSample& sample)
+{
+    const FlowKey& key = sample.key; // the link's flow set holds the flow table's key
+    uint32_t agentIp = sample.agentKey.agentIP;
+    uint32_t relevantPort = sample.agentKey.interfacePort;
+    bool isIngress = sample.isIngress;
+
+    // 2. Update the network map using the CORRECT direction
+    if (hostPairs().contains(hostPairKey(sample.sampleKey.srcIP, sample.sampleKey.dstIP)))
+    {
+        if (isIngress)
+        {
+            // Use existing logic for ingress flows
+            if (auto edgeOpt =
+                    m_topologyAndFlowMonitor->findReverseEdgeByAgentIpAndPort(
+                        {agentIp, relevantPort}))
+            {
+                m_topologyAndFlowMonitor->touchEdgeFlow(edgeOpt.value(), key);
+            }
+        }
+        else
+        { // Egress flow
+            // Use a NEW function for egress flows that finds the link connected to the
+            // output port
+            if (auto edgeOpt = m_topologyAndFlowMonitor->findEdgeByAgentIpAndPort(
+                    {agentIp, relevantPort}))
+            {
+                m_topologyAndFlowMonitor->touchEdgeFlow(edgeOpt.value(), key);
+            }
+        }
+    }
+}
+
+void
+FlowLinkUsageCollector::setIncrementalRateEstimation(bool enabled)
+{
+    m_incrementalRates.store(enabled);
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Periodic rate estimation: {}",
+                       enabled ? "incremental" : "full sweep");
+}
+
+void
+FlowLinkUsageCollector::calAvgFlowSendingRatesPeriodically()
+{
+    static utils::Histogram& cycle = utils::pollerCycleHistogram("flow_rates");
+    utils::ScopedTimer cycleTimer(cycle);
+
+    if (m_incrementalRates.load())
+    {
+        for (size_t i = 0; i < m_flowInfoShards.size(); ++i)
+        {
+            estimateShardRatesIncrementally(m_flowInfoShards[i], m_rateFollowUps[i], m_rateScratch);
+            m_trafficMatrix.apply(m_matrixDeltas);
+            m_matrixDeltas.clear();
+        }
+    }
+    else
+    {
+        // Estimate average flow sending rate, one shard at a time
+        for (size_t i = 0; i < m_flowInfoShards.size(); ++i)
+        {
+            estimateShardRatesFully(m_flowInfoShards[i], m_rateFollowUps[i], m_rateScratch);
+            m_trafficMatrix.apply(m_matrixDeltas);
+            m_matrixDeltas.clear();
+        }
+    }
+    m_trafficMatrix.tick();
+    publishElephantTransitions();
+    if (m_firstHopSampling)
+    {
+        touchFlowPaths();
+    }
+
+    // Estimate left link bandwidth using flow sample
+    if (m_mode == utils::MININET)
+    {
+        std::lock_guard counterLock(m_counterReportsMutex);
+        for (auto& [packedKey, value] : m_counterReports)
+        {
+            const pair<uint32_t, uint32_t> key(packedKey >> 32, packedKey & 0xFFFFFFFF);
+            uint32_t agentIp = key.first;
+            uint32_t inputPort = key.second;
+            const CounterInfo& counter = value;
+
+            SPDLOG_LOGGER_TRACE(Logger::instance(),
+                                "Agent IP: {}, Input Port: {}, Bytes: {}",
+                                utils::Ipv4{agentIp},
+                                inputPort,
+                                counter.inputByteCountOnALinkMultiplySampingRate);
+
+            // TODO[IMPLEMENT]: Gain sampling rate from flow sample
+            // Store to graph
+            auto agentKeyOtherSideOpt = m_topologyAndFlowMonitor->getAgentKeyFromTheOtherSide(key);
+            if (!agentKeyOtherSideOpt.has_value())
+            {
+                SPDLOG_LOGGER_WARN(Logger::instance(), "Other Side Agent Miss");
+                continue;
+            }
+            m_topologyAndFlowMonitor->updateLinkInfoLeftLinkBandwidth(
+                agentKeyOtherSideOpt.value(),
+                counter.inputByteCountOnALinkMultiplySampingRate * 8);
+            value.inputByteCountOnALinkMultiplySampingRate = 0;
+        }
+    }
+
+    // Last, so the links carry the left bandwidth estimated just above
+    publishTelemetrySegment();
+}
+
+void
+FlowLinkUsageCollector::estimateShardRatesFully(FlowTableShard& shard,
+                                                std::vector<FlowKey>& followUps,
+                                                RateScratch& scratch)
+{
+    scratch.clear();
+    unique_lock lock(shard.mutex);
+    clearPendingRateUpdates(shard);
+    for (auto& [flowKey, info] : shard.table)
+    {
+        takeRateCounters(flowKey, info, scratch);
+    }
+    // Kept up to date so switching to the incremental sweep loses no decaying flow
+    computeRates(scratch, followUps);
+    // Nothing was added or erased under the lock, so the flows come in the order taken
+    size_t f = 0;
+    for (auto& [flowKey, info] : shard.table)
+    {
+        applyRates(scratch.flows[f++], info, scratch);
+    }
+}
+
+void
+FlowLinkUsageCollector::RateScratch::clear()
+{
+    flows.clear();
+    bytesCurrent.clear();
+    bytesPrevious.clear();
+    packetsCurrent.clear();
+    packetsPrevious.clear();
+    samplingRates.clear();
+}
+
+void
+FlowLinkUsageCollector::takeRateCounters(const FlowKey& key, FlowInfo& info, RateScratch& scratch)
+{
+    RateScratch::Flow flow{key, info.startTime, scratch.slots(), 0};
+    for (auto& [agentKey, stats] : info.agentFlowStats)
+    {
+        scratch.bytesCurrent.push_back(stats.ingressByteCountCurrent +
+                                       stats.egressByteCountCurrent);
+        scratch.bytesPrevious.push_back(stats.ingressByteCountPrevious +
+                                        stats.egressByteCountPrevious);
+        scratch.packetsCurrent.push_back(stats.ingresspacketCountCurrent +
+                                         stats.egresspacketCountCurrent);
+        scratch.packetsPrevious.push_back(stats.ingresspacketCountPrevious +
+                                          stats.egresspacketCountPrevious);
+        scratch.samplingRates.push_back(stats.samplingRate > 0 ? stats.samplingRate : 1);
+        // Roll over for the next interval
+        stats.ingressByteCountPrevious = stats.ingressByteCountCurrent;
+        stats.egressByteCountPrevious = stats.egressByteCountCurrent;
+        stats.ingresspacketCountPrevious = stats.ingresspacketCountCurrent;
+        stats.egresspacketCountPrevious = stats.egresspacketCountCurrent;
+        ++flow.agentCount;
+    }
+    scratch.flows.push_back(flow);
+}
+
+void
+FlowLinkUsageCollector::computeRates(RateScratch& scratch, std::vector<FlowKey>& followUps)
+{
+    // Per-agent rates of every slot at once, then the per-flow sums over their slots
+    const size_t slots = scratch.slots();
+    scratch.byteRates.resize(slots);
+    scratch.packetRates.resize(slots);
+    utils::counterRates(scratch.bytesCurrent.data(),
+                        scratch.bytesPrevious.data(),
+                        scratch.samplingRates.data(),
+                        3,
+                        scratch.byteRates.data(),
+                        slots);
+    utils::counterRates(scratch.packetsCurrent.data(),
+                        scratch.packetsPrevious.data(),
+                        scratch.samplingRates.data(),
+                        0,
+                        scratch.packetRates.data(),
+                        slots);
+
+    followUps.clear();
+    for (auto& flow : scratch.flows)
+    {
+        for (size_t i = flow.agentBegin; i < flow.agentBegin + flow.agentCount; ++i)
+        {
+            flow.flowRate += scratch.byteRates[i];
+            flow.packetRate += scratch.packetRates[i];
+            flow.hops += scratch.byteRates[i] != 0;
+        }
+        if (flow.packetRate != 0)
+        {
+            // Revisit next tick so the rates drop to zero if no more samples arrive
+            followUps.push_back(flow.key);
+        }
+    }
+}
+
+void
+FlowLinkUsageCollector::applyRates(const RateScratch::Flow& flow,
+                                   FlowInfo& info,
+                                   const RateScratch& scratch)
+{
+    size_t i = flow.agentBegin;
+    for (auto& [agentKey, stats] : info.agentFlowStats)
+    {
+        if (i == flow.agentBegin + flow.agentCount)
+        {
+            break; // agents that appeared after the counters were taken wait for the next tick
+        }
+        stats.avgByteRateInBps = scratch.byteRates[i];
+        stats.avgPacketRate = scratch.packetRates[i];
+        ++i;
+    }
+
+    // No hop saw the flow this tick: it stopped (or has no samples yet), and its rates go to
+    // zero so that it can end as an elephant and be demoted
+    const uint64_t flowRate = flow.hops == 0 ? 0 : flow.flowRate / flow.hops;
+    const uint64_t packetRate = flow.hops == 0 ? 0 : flow.packetRate / flow.hops;
+    // A flow sampled since the last tick also has immediate rates that decayed since its
+    // last sample, without any change of its own: listing it again bounds how stale the
+    // cached responses, ?since= deltas and telemetry stream get to one tick
+    if (flow.packetRate != 0 || flowRate != info.estimatedFlowSendingRatePeriodically ||
+        packetRate != info.estimatedPacketSendingRatePeriodically)
+    {
+        markFlowChanged(info);
+    }
+    noteRateChange(flow.key, info.estimatedFlowSendingRatePeriodically, flowRate);
+    info.estimatedFlowSendingRatePeriodically = flowRate;
+    info.estimatedPacketSendingRatePeriodically = packetRate;
+    if (flowRate >= MICE_FLOW_UNDER_THRESHOLD)
+    {
+        info.isElephantFlowPeriodically = true;
+    }
+    noteElephantState(flow.key, info);
+
+    SPDLOG_LOGGER_TRACE(Logger::instance(),
+                        "FlowKey: {} -> {} estimated rate (periodically) {} over {} hops",
+                        utils::Ipv4{flow.key.srcIP},
+                        utils::Ipv4{flow.key.dstIP},
+                        flowRate,
+                        flow.hops);
+}
+
+void
+FlowLinkUsageCollector::touchFlowPaths()
+{
+    m_pathTouchScratch.clear();
+    for (auto& shard : m_flowInfoShards)
+    {
+        unique_lock lock(shard.mutex);
+        for (const auto& key : shard.pathTouches)
+        {
+            auto it = shard.table.find(key);
+            if (it == shard.table.end())
+            {
+                continue;
+            }
+            it->second.pathTouchPending = false;
+            if (!it->second.flowPath.empty())
+            {
+                m_pathTouchScratch.emplace_back(
+                    key, it->second.sampleKey.srcIP, it->second.flowPath);
+            }
+        }
+        shard.pathTouches.clear();
+    }
+    // Without any shard lock, as touchFlowEdges()
+    for (const auto& [key, srcHostIp, path] : m_pathTouchScratch)
+    {
+        m_topologyAndFlowMonitor->touchPathFlow(key, srcHostIp, path);
+    }
+}
+
+bool
+FlowLinkUsageCollector::inTrafficMatrix(const FlowKey& key) const
+{
+    // With both kept, the aggregates (protocol 0) would count every flow twice
+    return m_aggregation.mode == FlowAggregation::FiveTuple || !m_aggregation.keepFiveTuple ||
+           key.protocol != 0;
+}
+
+void
+FlowLinkUsageCollector::noteRateChange(const FlowKey& key, uint64_t from, uint64_t to)
+{
+    if (from != to && inTrafficMatrix(key))
+    {
+        m_matrixDeltas.push_back(TrafficMatrix::Delta{
+            key.srcIP, key.dstIP, static_cast<int64_t>(to) - static_cast<int64_t>(from)});
+    }
+}
+
+void
+FlowLinkUsageCollector::noteElephantState(const FlowKey& key, FlowInfo& info)
+{
+    // Ending further down than it started keeps a flow hovering at the threshold from flapping
+    const uint64_t rate = info.estimatedFlowSendingRatePeriodically;
+    if (!info.elephantAnnounced && rate >= MICE_FLOW_UNDER_THRESHOLD)
+    {
+        info.elephantAnnounced = true;
+        m_elephantsDetected.flows.push_back({key, rate, info.flowPath});
+    }
+    else if (info.elephantAnnounced &&
+             rate < MICE_FLOW_UNDER_THRESHOLD / 100 * (100 - ELEPHANT_FLOW_HYSTERESIS))
+    {
+        info.elephantAnnounced = false;
+        m_elephantsEnded.flows.push_back({key, rate, info.flowPath});
+    }
+}
+
+void
+FlowLinkUsageCollector::publishElephantTransitions()
+{
+    // One event of each kind per tick, however many flows crossed
+    if (!m_elephantsDetected.flows.empty())
+    {
+        if (m_eventBus)
+        {
+            m_eventBus->channel<ElephantFlowEventData>(EventType::ElephantFlowDetected)
+                .publish(std::move(m_elephantsDetected));
+        }
+        m_elephantsDetected.flows.clear();
+    }
+    if (!m_elephantsEnded.flows.empty())
+    {
+        if (m_eventBus)
+        {
+            m_eventBus->channel<ElephantFlowEventData>(EventType::ElephantFlowEnded)
+                .publish(std::move(m_elephantsEnded));
+        }
+        m_elephantsEnded.flows.clear();
+    }
+}
+
+void
+FlowLinkUsageCollector::publishTelemetrySegment()
+{
+    if (!m_telemetrySegment)
+    {
+        return;
+    }
+    m_telemetrySegment->publishLinks(m_topologyAndFlowMonitor->getGraphSnapshot()->graph,
+                                     m_mode == utils::MININET);
+    if (m_immediateSweep)
+    {
+        std::lock_guard guard(m_topFlowsMutex);
+        m_telemetrySegment->publishTopFlows(m_topFlows);
+    }
+    else
+    {
+        m_telemetrySegment->publishTopFlows(selectTopKFlows(telemetry::MAX_TOP_FLOWS));
+    }
+    m_telemetrySegment->publishMatrix(m_trafficMatrix);
+}
+
+void
+FlowLinkUsageCollector::clearPendingRateUpdates(FlowTableShard& shard)
+{
+    for (const auto& key : shard.rateDirty)
+    {
+        auto it = shard.table.find(key);
+        if (it != shard.table.end())
+        {
+            it->second.pendingRateUpdate = false;
+        }
+    }
+    shard.rateDirty.clear();
+}
+
+void
+FlowLinkUsageCollector::estimateShardRatesIncrementally(FlowTableShard& shard,
+                                                        std::vector<FlowKey>& followUps,
+                                                        RateScratch& scratch)
+{
+    scratch.clear();
+
+    // 1. Under the lock: take the sampled flows (and last tick's still-moving ones), copy
+    //    their counters and roll the counters over, exactly like the full sweep does.
+    {
+        unique_lock lock(shard.mutex);
+        scratch.keys.swap(shard.rateDirty);
+        for (const auto& key : followUps)
+        {
+            auto it = shard.table.find(key);
+            if (it != shard.table.end() && !it->second.pendingRateUpdate)
+            {
+                it->second.pendingRateUpdate = true;
+                scratch.keys.push_back(key);
+            }
+        }
+
+        for (const auto& key : scratch.keys)
+        {
+            auto it = shard.table.find(key);
+            if (it == shard.table.end())
+            {
+                continue;
+            }
+            it->second.pendingRateUpdate = false;
+            takeRateCounters(key, it->second, scratch);
+        }
+        scratch.keys.clear();
+    }
+
+    // 2. Without the lock: per-agent rates and flow totals
+    computeRates(scratch, followUps);
+
+    // 3. Under the lock again: publish the results to flows that still exist
+    unique_lock lock(shard.mutex);
+    for (const auto& flow : scratch.flows)
+    {
+        auto it = shard.table.find(flow.key);
+        if (it == shard.table.end() || it->second.startTime != flow.startTime)
+        {
+            continue; // purged (and possibly re-created) meanwhile
+        }
+        applyRates(flow, it->second, scratch);
+    }
+}
+
+void
+FlowLinkUsageCollector::calAvgFlowSendingRatesImmediately()
+{
+    // Bounded min-heap of the fastest flows seen so far in this sweep
+    std::vector<RankedFlow> topFlows;
+    topFlows.reserve(FLOW_TOPK_TRACKED + 1);
+    auto rankFlow = [&topFlows](uint64_t rate, const FlowKey& key) {
+        if (topFlows.size() == FLOW_TOPK_TRACKED && rate <= topFlows.front().first)
+        {
+            return;
+        }
+        topFlows.emplace_back(rate, key);
+        std::push_heap(topFlows.begin(), topFlows.end(), std::greater<>());
+        if (topFlows.size() > FLOW_TOPK_TRACKED)
+        {
+            std::pop_heap(topFlows.begin(), topFlows.end(), std::greater<>());
+            topFlows.pop_back();
+        }
+    };
+
+    for (auto& shard : m_flowInfoShards)
+    {
+        unique_lock lock(shard.mutex);
+        for (auto& [flowKey, info] : shard.table)
+        {
+            const ImmediateRate rate = info.immediateRate();
+            if (rate.bps != info.estimatedFlowSendingRateImmediately ||
+                rate.pps != info.estimatedPacketSendingRateImmediately)
+            {
+                markFlowChanged(info);
+            }
+            info.estimatedFlowSendingRateImmediately = rate.bps;
+            info.estimatedPacketSendingRateImmediately = rate.pps;
+            info.isElephantFlowImmediately = rate.bps >= MICE_FLOW_UNDER_THRESHOLD;
+            rankFlow(rate.bps, flowKey);
+
+            SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                                "FlowKey: {} -> {}",
+                                utils::Ipv4{flowKey.srcIP},
+                                utils::Ipv4{flowKey.dstIP});
+            SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                                "Estimated packet sending rate (Immediately): {}",
+                                info.estimatedFlowSendingRateImmediately);
+        }
+    }
+
+    std::sort_heap(topFlows.begin(), topFlows.end(), std::greater<>());
+    std::lock_guard guard(m_topFlowsMutex);
+    m_topFlows.swap(topFlows);
+}
+
+void
+FlowLinkUsageCollector::testCalAvgFlowSendingRatesRandomly()
+{
+    uniform_int_distribution<> dist(500, 2000); // 500ms-2000ms between calls
+
+    if (m_immediateSweep)
+    {
+        calAvgFlowSendingRatesImmediately();
+    }
+
+    int waitTime = dist(m_randomRateTestGen);
+
+    SPDLOG_LOGGER_TRACE(Logger::instance(),
+                        "FlowLinkUsageCollector::testCalAvgFlowSendingRatesRandomly() "
+                        "Waiting for {} ms before next call...",
+                        waitTime);
+    auto& scheduler = utils::TaskScheduler::instance();
+    scheduler.runAt(utils::TaskScheduler::current(),
+                    utils::TaskScheduler::Clock::now() + chrono::milliseconds(waitTime));
+}
+
+inline string
+FlowLinkUsageCollector::ourIpToString(uint32_t ipFront, uint32_t ipBack)
+{
+    string res;
+    res = to_string((ipFront & 65535) >> 8) + "." + to_string(ipFront & 255) + "." +
+          to_string(ipBack >> 24) + "." + to_string((ipBack >> 16) & 255);
+    return res;
+}
+
+void
+FlowLinkUsageCollector::purgeIdleFlows()
+{
+    static utils::Histogram& cycle = utils::pollerCycleHistogram("flow_expiry");
+    const auto cycleStart = std::chrono::steady_clock::now();
+    int64_t now = utils::getCurrentTimeMillisSystemClock();
+
+    // Each shard only visits the flows whose expiry came due, under its own lock, so
+    // the cost follows the number of expiring flows rather than the table size.
+    const int64_t idleTimeout = flowIdleTimeout();
+    const int64_t hotTimeout = flowHotTimeout();
+    vector<FlowKey> purged;
+    for (auto& shard : m_flowInfoShards)
+    {
+        unique_lock lock(shard.mutex);
+        shard.admission.decay();
+        const uint64_t demotions = shard.demotions;
+        shard.expiry.advance(now, [&](const FlowKey& flowKey) {
+            auto it = shard.table.find(flowKey);
+            if (it == shard.table.end())
             {
-                const uint32_t PURE_ACK_SIZE_THRESHOLD = 80; // Your proposed threshold
-
-                // isAckPacket should be true if the ACK flag is set
-                if (isAckPacket && frameLength < PURE_ACK_SIZE_THRESHOLD)
+                auto cold = shard.cold.find(flowKey);
+                if (cold == shard.cold.end())
                 {
-                    SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                        "Pure ACK packet (size: {} bytes)",
-                                        frameLength);
-                    isPureAck = true;
+                    return;
                 }
+                if (now - cold->second.endTime < idleTimeout)
+                {
+                    shard.expiry.schedule(flowKey, cold->second.endTime + idleTimeout);
+                    return;
+                }
+                SPDLOG_LOGGER_INFO(Logger::instance(),
+                                   "Flow Key: {} -> {} idles (cold)",
+                                   utils::Ipv4{flowKey.srcIP},
+                                   utils::Ipv4{flowKey.dstIP});
+                removeColdFlowNoLock(shard, cold);
+                purged.push_back(flowKey);
+                return;
             }
-
-            // 2. Process the extracted data using common logic.
-            if (protocol == 6 || protocol == 17 || protocol == 1) // TCP, UDP, or ICMP
+            const FlowInfo& info = it->second;
+            const int64_t endTime = info.endTime;
+            const int64_t idle = now - endTime;
+            if (idle < idleTimeout)
             {
-                if (m_mode == utils::MININET)
+                if (idle < hotTimeout)
                 {
-                    inputPort = m_ifIndexToOfportMap[inputPort];
-                    outputPort = m_ifIndexToOfportMap[outputPort];
-                    SPDLOG_LOGGER_TRACE(
-                        Logger::instance(),
-                        "FLOW SAMPLE in Mininet from Agent {}: {} -> {} (Proto: {}, Len: {}, Input "
-                        "port: {}, Ouput port: {})",
-                        agentIpStr,
-                        utils::ipToString(srcIp),
-                        utils::ipToString(dstIp),
-                        protocol,
-                        frameLength,
-                        inputPort,
-                        outputPort);
+                    // Still active: check again once it could have cooled down
+                    shard.expiry.schedule(flowKey, endTime + hotTimeout);
                 }
-
-                bool isIngress = (inputPort != 0); // Simple direction check
-                uint32_t relevantPort = isIngress ? inputPort : outputPort;
-
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "Flow Sample Recieve Src Ip {}, Dst Ip {}",
-                                    utils::ipToString(srcIp),
-                                    utils::ipToString(dstIp));
-
-                FlowKey key = {};
-                if (protocol != 1)
+                else if (demoteFlowNoLock(shard, it))
                 {
-                    key = {srcIp, dstIp, srcPort, dstPort, protocol};
+                    // Cold now, until purged
+                    shard.expiry.schedule(flowKey, endTime + idleTimeout);
                 }
                 else
                 {
-                    key = {srcIp, dstIp, icmpType, icmpCode, protocol};
+                    // Its rates have yet to settle: try again next pass
+                    shard.expiry.schedule(flowKey, now + FLOW_EXPIRY_TICK_MS);
                 }
+                return;
+            }
+
+            SPDLOG_LOGGER_DEBUG(Logger::instance(), "Now: {} End Time: {}", now, info.endTime);
+            SPDLOG_LOGGER_INFO(Logger::instance(),
+                               "Flow Key: {} -> {} idles",
+                               utils::Ipv4{flowKey.srcIP},
+                               utils::Ipv4{flowKey.dstIP});
+            SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                                "info.estimatedFlowSendingRatePeriodically: {}",
+                                info.estimatedFlowSendingRatePeriodically);
+
+            removeFlowNoLock(shard, it);
+            purged.push_back(flowKey);
+        });
+        // Evicted flows are gone as well, for subscribers dropping per-flow state
+        purged.insert(purged.end(), shard.evictedKeys.begin(), shard.evictedKeys.end());
+        shard.evictedKeys.clear();
+        // Hand the slots of demoted flows back once the table has emptied out, or the hot
+        // table would stay as large as its busiest moment
+        if (shard.demotions != demotions && shard.table.size() * 4 < shard.table.capacity())
+        {
+            shard.table.shrink_to_fit();
+            shard.evictionHand = 0;
+        }
+    }
+
+    // Handlers run without any shard lock held
+    if (m_eventBus && !purged.empty())
+    {
+        // One event per pass, however many flows it removed
+        m_eventBus->channel<IdleFlowsPurgedEventData>(EventType::IdleFlowsPurged)
+            .publish(IdleFlowsPurgedEventData{std::move(purged)});
+    }
+
+    cycle.observe(std::chrono::steady_clock::now() - cycleStart);
+}
+
+size_t
+FlowLinkUsageCollector::flowShardIndex(const FlowKey& key) const
+{
+    if (m_bidirectionalFlows && key.protocol == 6)
+    {
+        // Both directions of a connection hash as the lower endpoint first
+        const bool lower = std::tie(key.srcIP, key.srcPort) < std::tie(key.dstIP, key.dstPort);
+        return FlowKeyHash{}(lower ? key : reversedKey(key)) % FLOW_TABLE_SHARD_COUNT;
+    }
+    return FlowKeyHash{}(key) % FLOW_TABLE_SHARD_COUNT;
+}
+
+FlowLinkUsageCollector::FlowTableShard&
+FlowLinkUsageCollector::flowShardFor(const FlowKey& key)
+{
+    return m_flowInfoShards[flowShardIndex(key)];
+}
+
+unordered_map<FlowKey, FlowInfo, FlowKeyHash>
+FlowLinkUsageCollector::getFlowInfoTable()
+{
+    unordered_map<FlowKey, FlowInfo, FlowKeyHash> snapshot;
+    for (const auto& shard : m_flowInfoShards)
+    {
+        shared_lock lock(shard.mutex);
+        forEachFlowNoLock(shard, [&](const FlowKey& flowKey, const FlowInfo& flowInfo) {
+            snapshot.emplace(flowKey, flowInfo);
+            return true;
+        });
+    }
+    return snapshot;
+}
 
-                AgentKey agentKey = {agentIp, relevantPort};
+bool
+FlowQuery::matches(const FlowKey& key, const FlowInfo& info) const
+{
+    auto inPrefix = [](uint32_t ip, const std::pair<uint32_t, uint8_t>& prefix) {
+        uint32_t mask = utils::prefixToMaskHost(std::min<uint8_t>(prefix.second, 32));
+        return (ip & mask) == (prefix.first & mask);
+    };
+    if ((srcPrefix && !inPrefix(key.srcIP, *srcPrefix)) ||
+        (dstPrefix && !inPrefix(key.dstIP, *dstPrefix)) ||
+        (protocol && key.protocol != *protocol) || (srcPort && key.srcPort != *srcPort) ||
+        (dstPort && key.dstPort != *dstPort) ||
+        (port && key.srcPort != *port && key.dstPort != *port))
+    {
+        return false;
+    }
+    if (elephant || minRateBps != 0)
+    {
+        const uint64_t bps = info.immediateRate().bps;
+        if ((elephant && (bps >= MICE_FLOW_UNDER_THRESHOLD) != *elephant) || bps < minRateBps)
+        {
+            return false;
+        }
+    }
+    if (dpid && std::none_of(info.flowPath.begin(), info.flowPath.end(), [&](const auto& hop) {
+            return hop.first == *dpid;
+        }))
+    {
+        return false;
+    }
+    if (edge)
+    {
+        const PathHandle& path = info.flowPath;
+        bool found = false;
+        for (size_t i = 1; i < path.size() && !found; ++i)
+        {
+            found = path[i - 1].first == edge->first && path[i].first == edge->second;
+        }
+        if (!found)
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-                if (m_mode == utils::MININET)
+size_t
+FlowLinkUsageCollector::visitFlows(const FlowQuery& query, const FlowVisitor& visitor) const
+{
+    size_t visited = 0;
+    for (const auto& shard : m_flowInfoShards)
+    {
+        shared_lock lock(shard.mutex);
+        const bool more =
+            forEachFlowNoLock(shard, [&](const FlowKey& flowKey, const FlowInfo& flowInfo) {
+                if (!query.matches(flowKey, flowInfo))
                 {
-                    m_counterReports[make_pair(agentIp, relevantPort)]
-                        .inputByteCountOnALinkMultiplySampingRate +=
-                        uint64_t(frameLength) * samplingRate;
+                    return true;
                 }
+                ++visited;
+                return visitor(flowKey, flowInfo);
+            });
+        if (!more)
+        {
+            return visited;
+        }
+    }
+    return visited;
+}
 
-                auto it = m_flowInfoTable.find(key);
-                if (it != m_flowInfoTable.end()) // Existing flow
-                {
-                    // Find flow stasts on an agent
-                    m_flowInfoTable[key].isPureAck = isPureAck;
-                    m_flowInfoTable[key].isAck = isAckPacket;
+namespace
+{
 
-                    SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                        "Ack?{} PureAck?{} ",
-                                        m_flowInfoTable[key].isAck,
-                                        m_flowInfoTable[key].isPureAck);
+// Total order over every FlowKey field (operator< ignores the ICMP type and code)
+auto
+flowKeyOrder(const FlowKey& key)
+{
+    return std::tie(
+        key.srcIP, key.dstIP, key.srcPort, key.dstPort, key.protocol, key.icmpType, key.icmpCode);
+}
 
-                    auto& stats = m_flowInfoTable[key].agentFlowStats[agentKey];
-                    stats.samplingRate = samplingRate;
+// Cursor text: "<shard>:<srcIP>:<dstIP>:<srcPort>:<dstPort>:<protocol>:<icmpType>:<icmpCode>",
+// or just "<shard>" for the start of a shard
+std::string
+encodeFlowCursor(size_t shard, const FlowKey& key)
+{
+    return std::to_string(shard) + ':' + std::to_string(key.srcIP) + ':' +
+           std::to_string(key.dstIP) + ':' + std::to_string(key.srcPort) + ':' +
+           std::to_string(key.dstPort) + ':' + std::to_string(key.protocol) + ':' +
+           std::to_string(key.icmpType) + ':' + std::to_string(key.icmpCode);
+}
 
-                    if (isIngress)
-                    {
-                        stats.ingressByteCountCurrent += uint64_t(frameLength);
-                        stats.ingresspacketCountCurrent += 1;
-                    }
-                    else
-                    {
-                        stats.egressByteCountCurrent += uint64_t(frameLength);
-                        stats.egresspacketCountCurrent += 1;
-                    }
+bool
+decodeFlowCursor(std::string_view cursor, size_t& shard, std::optional<FlowKey>& after)
+{
+    std::string text(cursor);
+    int consumed = 0;
+    if (std::sscanf(text.c_str(), "%zu%n", &shard, &consumed) == 1 &&
+        static_cast<size_t>(consumed) == text.size())
+    {
+        after.reset();
+        return shard < FLOW_TABLE_SHARD_COUNT;
+    }
 
-                    // log time
-                    // utils::logCurrentTimeSystemClock();
+    FlowKey key{};
+    unsigned protocol = 0;
+    if (std::sscanf(text.c_str(),
+                    "%zu:%u:%u:%hu:%hu:%u:%hu:%hu%n",
+                    &shard,
+                    &key.srcIP,
+                    &key.dstIP,
+                    &key.srcPort,
+                    &key.dstPort,
+                    &protocol,
+                    &key.icmpType,
+                    &key.icmpCode,
+                    &consumed) != 8 ||
+        static_cast<size_t>(consumed) != text.size() || shard >= FLOW_TABLE_SHARD_COUNT ||
+        protocol > 0xFF)
+    {
+        return false;
+    }
+    key.protocol = static_cast<uint8_t>(protocol);
+    after = key;
+    return true;
+}
 
-                    stats.packetQueue.push({frameLength, utils::getCurrentTimeMillisSteadyClock()});
-                    m_flowInfoTable[key].endTime = utils::getCurrentTimeMillisSystemClock();
-                }
-                else // New flow
-                {
-                    m_flowInfoTable[key].startTime = utils::getCurrentTimeMillisSystemClock();
-                    m_flowInfoTable[key].endTime = utils::getCurrentTimeMillisSystemClock();
+} // namespace
 
-                    // Initialize stats for the new flow
-                    auto& stats = m_flowInfoTable[key].agentFlowStats[agentKey];
-                    stats.samplingRate = samplingRate;
-                    if (isIngress)
-                    {
-                        stats.ingressByteCountCurrent = uint64_t(frameLength);
-                        stats.egressByteCountCurrent = 0;
-                        stats.ingresspacketCountCurrent = 1;
-                        stats.egresspacketCountCurrent = 0;
-                    }
-                    else
-                    {
-                        stats.egressByteCountCurrent = uint64_t(frameLength);
-                        stats.ingressByteCountCurrent = 0;
-                        stats.egresspacketCountCurrent = 1;
-                        stats.ingresspacketCountCurrent = 0;
-                    }
-                    stats.packetQueue.push({frameLength, utils::getCurrentTimeMillisSteadyClock()});
-                }
+nlohmann::json
+FlowLinkUsageCollector::queryFlowsJson(const FlowQuery& query,
+                                       std::string_view cursor,
+                                       size_t limit) const
+{
+    limit = std::clamp<size_t>(limit, 1, FLOW_QUERY_MAX_LIMIT);
 
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "Flow Table Entry Updated for {} -> {}. End Time: {}",
-                                    utils::ipToString(key.srcIP),
-                                    utils::ipToString(key.dstIP),
-                                    m_flowInfoTable[key].endTime);
+    // Resume strictly after (startShard, after) in (shard, key) order
+    size_t startShard = 0;
+    std::optional<FlowKey> after;
+    if (!cursor.empty() && !decodeFlowCursor(cursor, startShard, after))
+    {
+        throw std::invalid_argument("Invalid flow query cursor: " + std::string(cursor));
+    }
 
-                // 2. Update the network map using the CORRECT direction
-                if (m_allPathMap.count({key.srcIP, key.dstIP}))
-                {
-                    if (isIngress)
-                    {
-                        // Use existing logic for ingress flows
-                        if (auto edgeOpt =
-                                m_topologyAndFlowMonitor->findReverseEdgeByAgentIpAndPort(
-                                    {agentIp, relevantPort}))
-                        {
-                            m_topologyAndFlowMonitor->touchEdgeFlow(edgeOpt.value(), key);
-                        }
-                    }
-                    else
-                    { // Egress flow
-                        // Use a NEW function for egress flows that finds the link connected to the
-                        // output port
-                        if (auto edgeOpt = m_topologyAndFlowMonitor->findEdgeByAgentIpAndPort(
-                                {agentIp, relevantPort}))
-                        {
-                            m_topologyAndFlowMonitor->touchEdgeFlow(edgeOpt.value(), key);
-                        }
-                    }
-                }
-            }
-            // Adjust offset index for MININET
-            if (m_mode == utils::MININET)
+    // A matching flow, hot (info) or cold (cold)
+    struct Entry
+    {
+        const FlowKey* key;
+        const FlowInfo* info;
+        const ColdFlow* cold;
+    };
+    auto byKey = [](const Entry& a, const Entry& b) {
+        return flowKeyOrder(*a.key) < flowKeyOrder(*b.key);
+    };
+
+    nlohmann::json flows = nlohmann::json::array();
+    nlohmann::json nextCursor = nullptr;
+    std::vector<Entry> page;
+    for (size_t s = startShard; s < m_flowInfoShards.size() && flows.size() < limit; ++s)
+    {
+        const FlowTableShard& shard = m_flowInfoShards[s];
+        const size_t wanted = limit - flows.size();
+        shared_lock lock(shard.mutex);
+
+        // Keep the `wanted` smallest matching keys; trimming at 2x bounds the buffer
+        page.clear();
+        bool more = false;
+        auto consider = [&](const FlowKey& flowKey, const FlowInfo& flowInfo, const Entry& entry) {
+            if ((s == startShard && after && !(flowKeyOrder(*after) < flowKeyOrder(flowKey))) ||
+                !query.matches(flowKey, flowInfo))
             {
-                index += (sampleLen / 4 + 2 - (flowDataLength / 4 + 2));
+                return;
             }
-            else
+            page.push_back(entry);
+            if (page.size() >= 2 * wanted)
             {
-                index += (sampleLen / 4 + 2);
+                std::nth_element(page.begin(), page.begin() + wanted, page.end(), byKey);
+                page.resize(wanted);
+                more = true;
             }
+        };
+        for (const auto& [flowKey, flowInfo] : shard.table)
+        {
+            consider(flowKey, flowInfo, {&flowKey, &flowInfo, nullptr});
         }
-        //================================================================
-        // Handle Unknown Sample Types
-        //================================================================
-        else
+        FlowInfo scratch;
+        for (const auto& [flowKey, cold] : shard.cold)
         {
-            SPDLOG_LOGGER_ERROR(Logger::instance(), "Unknown sampleType {}", sampleType);
-            // Safely advance index to avoid an infinite loop if sampleLen is available
-            uint32_t sampleLen = ntohl(data[index + 1]);
-            if (sampleLen > 0)
-            {
-                index += (sampleLen / 4 + 2);
-            }
-            else
+            coldFlowInfo(cold, scratch);
+            consider(flowKey, scratch, {&flowKey, nullptr, &cold});
+        }
+        if (page.size() > wanted)
+        {
+            std::nth_element(page.begin(), page.begin() + wanted, page.end(), byKey);
+            page.resize(wanted);
+            more = true;
+        }
+        std::sort(page.begin(), page.end(), byKey);
+
+        for (const Entry& entry : page)
+        {
+            if (entry.cold)
             {
-                // Can't determine length, break to avoid getting stuck
-                break;
+                coldFlowInfo(*entry.cold, scratch);
             }
+            flows.push_back(flowInfoToJson(*entry.key, entry.cold ? scratch : *entry.info));
+        }
+        if (more)
+        {
+            nextCursor = encodeFlowCursor(s, *page.back().key);
+        }
+        else if (flows.size() == limit && s + 1 < m_flowInfoShards.size())
+        {
+            // Page filled exactly at the end of this shard; continue with the next one
+            nextCursor = std::to_string(s + 1);
         }
     }
+
+    return nlohmann::json{{"flows", std::move(flows)}, {"next_cursor", std::move(nextCursor)}};
 }
 
-void
-FlowLinkUsageCollector::calAvgFlowSendingRatesPeriodically()
+nlohmann::json
+FlowLinkUsageCollector::getPathCacheStatsJson() const
 {
-    while (m_running.load())
+    FlowPathCache::Stats total;
+    for (const auto& cache : m_pathCaches)
     {
-        this_thread::sleep_for(chrono::seconds(1));
+        total += cache.stats();
+    }
+    return total.toJson();
+}
 
-        // Estimate average flow sending rate
-        {
-            unique_lock lock(m_flowInfoTableMutex);
-            for (auto& [flowKey, info] : m_flowInfoTable)
-            {
-                uint64_t avgFlowSendingRateTemp = 0;
-                uint64_t avgPacketSendingRateTemp = 0;
-                int hopsCounter = 0;
-                for (auto& [agentKey, stats] : info.agentFlowStats)
-                {
-                    // --- 1. CALCULATE ALL RATES FOR THE CURRENT INTERVAL ---
+nlohmann::json
+FlowLinkUsageCollector::getClassifierStatsJson() const
+{
+    return m_classifier->statsJson();
+}
+
+nlohmann::json
+FlowLinkUsageCollector::flowInfoToJson(const FlowKey& flowKey, const FlowInfo& flowInfo)
+{
+    return flowRecordToJson(flowJsonRecord(flowKey, flowInfo));
+}
 
-                    uint32_t currentSamplingRate =
-                        (stats.samplingRate > 0) ? stats.samplingRate : 1;
+FlowLinkUsageCollector::FlowJsonRecord
+FlowLinkUsageCollector::flowJsonRecord(const FlowKey& flowKey, const FlowInfo& flowInfo)
+{
+    const ImmediateRate immediate = flowInfo.immediateRate();
+    return FlowJsonRecord{flowKey,
+                          flowInfo.estimatedFlowSendingRatePeriodically,
+                          immediate.bps,
+                          flowInfo.estimatedPacketSendingRatePeriodically,
+                          immediate.pps,
+                          flowInfo.reverseAckBytes,
+                          flowInfo.reverseAckPackets,
+                          flowInfo.startTime,
+                          flowInfo.endTime,
+                          flowInfo.flowPath};
+}
 
-                    // Calculate byte rate
-                    uint64_t byte_count_current =
-                        stats.ingressByteCountCurrent + stats.egressByteCountCurrent;
-                    uint64_t byte_count_previous =
-                        stats.ingressByteCountPrevious + stats.egressByteCountPrevious;
-                    stats.avgByteRateInBps =
-                        (byte_count_current - byte_count_previous) * 8 * currentSamplingRate;
+nlohmann::json
+FlowLinkUsageCollector::flowRecordToJson(const FlowJsonRecord& record)
+{
+    nlohmann::json j;
+
+    j["src_ip"] = record.key.srcIP;
+    j["dst_ip"] = record.key.dstIP;
+    j["src_port"] = record.key.srcPort;
+    j["dst_port"] = record.key.dstPort;
+    j["protocol_id"] = record.key.protocol;
+
+    j["estimated_flow_sending_rate_bps_in_the_proceeding_1sec_timeslot"] =
+        record.flowRatePeriodically;
+    j["estimated_flow_sending_rate_bps_in_the_last_sec"] = record.flowRateImmediately;
+    j["estimated_packet_rate_in_the_proceeding_1sec_timeslot"] = record.packetRatePeriodically;
+    j["estimated_packet_rate_in_the_last_sec"] = record.packetRateImmediately;
+    if (record.reverseAckPackets != 0)
+    {
+        j["reverse_ack_bytes"] = record.reverseAckBytes;
+        j["reverse_ack_packets"] = record.reverseAckPackets;
+    }
+    j["first_sampled_time"] = utils::formatTime(record.startTime);
+    j["latest_sampled_time"] = utils::formatTime(record.endTime);
+    j["path"] = nlohmann::json::array();
+    // TODO: Test Classifier
+    for (const auto& [node, interface] : record.path)
+    {
+        j["path"].push_back({{"node", node}, {"interface", interface}});
+    }
+    return j;
+}
 
-                    SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                        "Agent {}:{} Current ingress byte counter: {},Current "
-                                        "egress byte counter: {} stats.avgByteRateInBps {}",
-                                        utils::ipToString(agentKey.agentIP),
-                                        agentKey.interfacePort,
-                                        stats.ingressByteCountCurrent,
-                                        stats.egressByteCountCurrent,
-                                        stats.avgByteRateInBps);
-
-                    // Calculate packet rate
-                    uint64_t packetCountCurrent =
-                        stats.ingresspacketCountCurrent + stats.egresspacketCountCurrent;
-                    uint64_t packetCountPrevious =
-                        stats.ingresspacketCountPrevious + stats.egresspacketCountPrevious;
-                    stats.avgPacketRate =
-                        (packetCountCurrent - packetCountPrevious) * currentSamplingRate;
-
-                    // --- 2. AGGREGATE THE RESULTS  ---
-
-                    avgFlowSendingRateTemp += stats.avgByteRateInBps;
-                    avgPacketSendingRateTemp += stats.avgPacketRate;
-
-                    if (stats.avgByteRateInBps != 0)
-                    {
-                        hopsCounter++;
-                    }
+void
+FlowLinkUsageCollector::snapshotFlowShard(size_t s, std::vector<FlowJsonRecord>& out) const
+{
+    out.clear();
+    const FlowTableShard& shard = m_flowInfoShards[s];
+    shared_lock lock(shard.mutex);
+    out.reserve(shard.table.size() + shard.cold.size());
+    forEachFlowNoLock(shard, [&out](const FlowKey& flowKey, const FlowInfo& flowInfo) {
+        out.push_back(flowJsonRecord(flowKey, flowInfo));
+        return true;
+    });
+}
 
-                    // --- 3. UPDATE STATE FOR THE *NEXT* INTERVAL ---
-                    // All state updates are done together at the end.
+nlohmann::json
+FlowLinkUsageCollector::getFlowInfoJson()
+{
+    nlohmann::json result = nlohmann::json::array();
 
-                    stats.ingressByteCountPrevious = stats.ingressByteCountCurrent;
-                    stats.egressByteCountPrevious = stats.egressByteCountCurrent;
-                    stats.ingresspacketCountPrevious = stats.ingresspacketCountCurrent;
-                    stats.egresspacketCountPrevious = stats.egresspacketCountCurrent;
-                }
+    std::vector<FlowJsonRecord> records;
+    for (size_t s = 0; s < m_flowInfoShards.size(); ++s)
+    {
+        snapshotFlowShard(s, records);
+        for (const auto& record : records)
+        {
+            result.push_back(flowRecordToJson(record));
+        }
+    }
+
+    return result;
+}
 
-                if (hopsCounter == 0)
+std::string
+FlowLinkUsageCollector::getFlowInfoJsonText() const
+{
+    // Shards are claimed one at a time, so a crowded one does not hold up a whole share
+    std::array<std::string, FLOW_TABLE_SHARD_COUNT> fragments;
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        std::vector<FlowJsonRecord> records;
+        for (size_t s; (s = next.fetch_add(1, std::memory_order_relaxed)) < fragments.size();)
+        {
+            snapshotFlowShard(s, records);
+            std::string& out = fragments[s];
+            for (const auto& record : records)
+            {
+                if (!out.empty())
                 {
-                    continue;
+                    out += ',';
                 }
+                out += flowRecordToJson(record).dump();
+            }
+        }
+    };
+
+    const size_t workers = std::min<size_t>(
+        {FLOW_JSON_MAX_WORKERS, std::max(1u, std::thread::hardware_concurrency()),
+         fragments.size()});
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t t = 1; t < workers; ++t)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
 
-                SPDLOG_LOGGER_TRACE(Logger::instance(), "Hops counter: {}", hopsCounter);
+    size_t length = 2;
+    for (const auto& fragment : fragments)
+    {
+        length += fragment.size() + 1;
+    }
+    std::string body;
+    body.reserve(length);
+    body += '[';
+    for (const auto& fragment : fragments)
+    {
+        if (fragment.empty())
+        {
+            continue;
+        }
+        if (body.size() > 1)
+        {
+            body += ',';
+        }
+        body += fragment;
+    }
+    body += ']';
+    return body;
+}
 
-                uint64_t estimatedFlowSendingRatePeriodically =
-                    avgFlowSendingRateTemp / hopsCounter;
-                info.estimatedFlowSendingRatePeriodically = estimatedFlowSendingRatePeriodically;
+uint64_t
+FlowLinkUsageCollector::publishFlowVersion()
+{
+    if (m_flowsChanged.exchange(false, std::memory_order_acq_rel))
+    {
+        return m_flowVersion.fetch_add(1, std::memory_order_acq_rel) + 1;
+    }
+    return m_flowVersion.load(std::memory_order_acquire);
+}
 
-                if (estimatedFlowSendingRatePeriodically >= MICE_FLOW_UNDER_THRESHOLD)
-                {
-                    info.isElephantFlowPeriodically = true;
-                }
-                // else
-                // {
-                //     info.isElephantFlowPeriodically = false;
-                // }
-
-                uint64_t estimatedPacketSendingRatePeriodically =
-                    avgPacketSendingRateTemp / hopsCounter;
-                info.estimatedPacketSendingRatePeriodically =
-                    estimatedPacketSendingRatePeriodically;
-
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "FlowKey: {} -> {}",
-                                    utils::ipToString(flowKey.srcIP),
-                                    utils::ipToString(flowKey.dstIP));
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "Estimated flow sending rate (Periodically): {}",
-                                    estimatedFlowSendingRatePeriodically);
-            }
-        }
-
-        // Estimate left link bandwidth using flow sample
-        if (m_mode == utils::MININET)
-        {
-            for (auto& [key, value] : m_counterReports)
-            {
-                uint32_t agentIp = key.first;
-                uint32_t inputPort = key.second;
-                const CounterInfo& counter = value;
-
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "Agent IP: {}, Input Port: {}, Bytes: {}",
-                                    utils::ipToString(agentIp),
-                                    inputPort,
-                                    counter.inputByteCountOnALinkMultiplySampingRate);
-
-                // TODO[IMPLEMENT]: Gain sampling rate from flow sample
-                // Store to graph
-                auto agentKeyOtherSideOpt =
-                    m_topologyAndFlowMonitor->getAgentKeyFromTheOtherSide(key);
-                if (!agentKeyOtherSideOpt.has_value())
-                {
-                    SPDLOG_LOGGER_WARN(Logger::instance(), "Other Side Agent Miss");
-                    continue;
-                }
-                m_topologyAndFlowMonitor->updateLinkInfoLeftLinkBandwidth(
-                    agentKeyOtherSideOpt.value(),
-                    counter.inputByteCountOnALinkMultiplySampingRate * 8);
-                value.inputByteCountOnALinkMultiplySampingRate = 0;
+nlohmann::json
+FlowLinkUsageCollector::getFlowInfoDeltaJson(uint64_t since)
+{
+    // Publish first: anything written after it is stamped with at least this version
+    const uint64_t version = publishFlowVersion();
+    bool full;
+    {
+        std::lock_guard guard(m_flowRemovalsMutex);
+        full = since == 0 || since > version || since <= m_flowRemovalsFloor;
+    }
+
+    nlohmann::json flows = nlohmann::json::array();
+    for (const auto& shard : m_flowInfoShards)
+    {
+        shared_lock lock(shard.mutex);
+        forEachFlowNoLock(shard, [&](const FlowKey& flowKey, const FlowInfo& flowInfo) {
+            if (full || flowInfo.changedVersion >= since)
+            {
+                flows.push_back(flowInfoToJson(flowKey, flowInfo));
+            }
+            return true;
+        });
+    }
+
+    // Read after the scan so a flow purged meanwhile is either listed above or here
+    nlohmann::json removed = nlohmann::json::array();
+    if (!full)
+    {
+        std::lock_guard guard(m_flowRemovalsMutex);
+        for (const auto& [removedAt, key] : m_flowRemovals)
+        {
+            if (removedAt >= since)
+            {
+                removed.push_back({{"src_ip", key.srcIP},
+                                   {"dst_ip", key.dstIP},
+                                   {"src_port", key.srcPort},
+                                   {"dst_port", key.dstPort},
+                                   {"protocol_id", key.protocol}});
             }
         }
     }
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Exiting Loop of calAvgFlowSendingRatesPeriodically");
+
+    return nlohmann::json{{"version", version},
+                          {"full", full},
+                          {"flows", std::move(flows)},
+                          {"removed", std::move(removed)}};
 }
 
 void
-FlowLinkUsageCollector::calAvgFlowSendingRatesImmediately()
+FlowLinkUsageCollector::markFlowChanged(FlowInfo& info)
 {
-    unique_lock lock(m_flowInfoTableMutex);
-    for (auto& [flowKey, info] : m_flowInfoTable)
+    info.changedVersion = m_flowVersion.load(std::memory_order_acquire);
+    if (!m_flowsChanged.load(std::memory_order_relaxed))
     {
-        uint64_t accumulatedEstimatedBytes = 0;
-        uint64_t accumulatedEstimatedPackets = 0;
+        m_flowsChanged.store(true, std::memory_order_release);
+    }
+}
 
-        int hopsCounter = 0;
+void
+FlowLinkUsageCollector::recordFlowRemoval(const FlowKey& key)
+{
+    std::lock_guard guard(m_flowRemovalsMutex);
+    m_flowRemovals.emplace_back(m_flowVersion.load(std::memory_order_acquire), key);
+    if (m_flowRemovals.size() > FLOW_DELTA_TOMBSTONES)
+    {
+        m_flowRemovalsFloor = std::max(m_flowRemovalsFloor, m_flowRemovals.front().first);
+        m_flowRemovals.pop_front();
+    }
+    m_flowsChanged.store(true, std::memory_order_release);
+}
 
-        for (auto& [link_key, stats] : info.agentFlowStats)
+void
+FlowLinkUsageCollector::reindexFlowPathNoLock(const FlowKey& key,
+                                              const PathHandle& oldPath,
+                                              const PathHandle& newPath)
+{
+    // Entry 0 is the source host; a destination host entry has port 0
+    auto forEachSwitchHop = [](const PathHandle& path, auto&& fn) {
+        for (size_t i = 1; i < path.size(); ++i)
         {
-            AutoRefreshQueue& packetQueueTemp = stats.packetQueue;
-            uint32_t currentSamplingRate = (stats.samplingRate > 0) ? stats.samplingRate : 1;
-            if (packetQueueTemp.size())
+            if (path[i].second != 0)
             {
-                hopsCounter++;
+                fn(path[i]);
+            }
+        }
+    };
+    forEachSwitchHop(oldPath, [&](const PathHop& hop) {
+        auto it = m_hopFlows.find(hop);
+        if (it != m_hopFlows.end() && it->second.erase(key) && it->second.empty())
+        {
+            m_hopFlows.erase(it);
+        }
+    });
+    forEachSwitchHop(newPath, [&](const PathHop& hop) { m_hopFlows[hop].insert(key); });
+}
+
+std::vector<FlowKey>
+FlowLinkUsageCollector::invalidatePathsThrough(uint64_t dpid,
+                                               uint32_t port,
+                                               utils::TraceId trace)
+{
+    std::vector<FlowKey> affected;
+    {
+        std::lock_guard guard(m_hopFlowsMutex);
+        auto it = m_hopFlows.find(PathHop{dpid, port});
+        if (it == m_hopFlows.end())
+        {
+            return affected;
+        }
+        affected.assign(it->second.begin(), it->second.end());
+    }
+
+    for (const auto& key : affected)
+    {
+        FlowTableShard& shard = flowShardFor(key);
+        std::unique_lock<std::shared_mutex> lk(shard.mutex);
+        shard.pathPending.push_back(key);
+    }
+    if (trace)
+    {
+        // After the keys: a pass that takes the trace also resolves them
+        std::lock_guard lk(m_pathMutex);
+        m_pathTraces.emplace_back(trace, std::chrono::steady_clock::now());
+    }
+    m_pathWork.store(true, std::memory_order_release);
+    m_pathCv.notify_one();
+
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "{} flow paths cross {}:{}, queued for re-resolution",
+                       affected.size(),
+                       dpid,
+                       port);
+    return affected;
+}
+
+nlohmann::json
+FlowLinkUsageCollector::getTopKFlowInfoJson(int k)
+{
+    SPDLOG_LOGGER_DEBUG(Logger::instance(), "getTopKFlowInfoJson k={}", k);
+    nlohmann::json topKFlows = nlohmann::json::array();
+    if (k <= 0)
+    {
+        return topKFlows;
+    }
 
-                uint64_t estimatedBytes =
-                    static_cast<uint64_t>(packetQueueTemp.getSum()) * currentSamplingRate;
-                uint64_t estimatedPackets =
-                    static_cast<uint64_t>(packetQueueTemp.size()) * currentSamplingRate;
+    auto appendFlows = [&](const std::vector<RankedFlow>& ranked) {
+        for (const auto& [rate, key] : ranked)
+        {
+            if (topKFlows.size() == static_cast<size_t>(k))
+            {
+                break;
+            }
+            FlowTableShard& shard = flowShardFor(key);
+            shared_lock lock(shard.mutex);
+            if (auto it = shard.table.find(key); it != shard.table.end())
+            {
+                topKFlows.push_back(flowInfoToJson(key, it->second));
+            }
+            else if (auto cold = shard.cold.find(key); cold != shard.cold.end())
+            {
+                FlowInfo info;
+                coldFlowInfo(cold->second, info);
+                topKFlows.push_back(flowInfoToJson(key, info));
+            }
+        }
+    };
 
-                accumulatedEstimatedBytes += estimatedBytes;
-                accumulatedEstimatedPackets += estimatedPackets;
-                SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                    "accumulatedEstimatedBytes {}, accumulatedEstimatedPackets {}",
-                                    accumulatedEstimatedBytes,
-                                    accumulatedEstimatedPackets);
+    if (k <= FLOW_TOPK_TRACKED)
+    {
+        std::vector<RankedFlow> ranked;
+        {
+            std::lock_guard guard(m_topFlowsMutex);
+            ranked = m_topFlows;
+        }
+        // The ranking only covers the whole table when it is full; purged flows are skipped
+        if (ranked.size() == FLOW_TOPK_TRACKED)
+        {
+            appendFlows(ranked);
+            if (topKFlows.size() == static_cast<size_t>(k))
+            {
+                return topKFlows;
             }
+            topKFlows = nlohmann::json::array();
         }
+    }
 
-        SPDLOG_LOGGER_TRACE(Logger::instance(), "Hops Counter: {}", hopsCounter);
+    appendFlows(selectTopKFlows(k));
+    SPDLOG_LOGGER_DEBUG(Logger::instance(), "Top-K by selection: {} flows", topKFlows.size());
+    return topKFlows;
+}
 
-        if (hopsCounter == 0)
+std::vector<FlowLinkUsageCollector::RankedFlow>
+FlowLinkUsageCollector::selectTopKFlows(size_t k) const
+{
+    // Candidates by the rates kept up to date anyway, then only theirs evaluated
+    std::vector<RankedFlow> ranked;
+    for (const auto& shard : m_flowInfoShards)
+    {
+        shared_lock lock(shard.mutex);
+        for (const auto& [flowKey, flowInfo] : shard.table)
         {
-            // No activity, so clear the rates and continue
-            info.estimatedFlowSendingRateImmediately = 0;
-            info.estimatedPacketSendingRateImmediately = 0;
-            info.isElephantFlowImmediately = false;
-            continue;
+            ranked.emplace_back(std::max(flowInfo.estimatedFlowSendingRatePeriodically,
+                                         flowInfo.estimatedFlowSendingRateImmediately),
+                                flowKey);
         }
-
-        // TODO[IMPLEMENT]: Gain sampling rate from flow sample
-        info.estimatedFlowSendingRateImmediately = accumulatedEstimatedBytes * 8 / hopsCounter;
-
-        if (info.estimatedFlowSendingRateImmediately >= MICE_FLOW_UNDER_THRESHOLD)
+        for (const auto& [flowKey, cold] : shard.cold)
         {
-            info.isElephantFlowImmediately = true;
+            ranked.emplace_back(cold.flowRatePeriodically, flowKey);
         }
-        else
+    }
+    const size_t candidates = k * FLOW_TOPK_CANDIDATES;
+    if (ranked.size() > candidates)
+    {
+        std::nth_element(
+            ranked.begin(), ranked.begin() + candidates, ranked.end(), std::greater<>());
+        ranked.resize(candidates);
+    }
+
+    std::vector<FlowKey> keys;
+    keys.reserve(ranked.size());
+    for (const auto& [rate, key] : ranked)
+    {
+        keys.push_back(key);
+    }
+    const std::vector<std::optional<ImmediateRate>> rates = getImmediateRates(keys);
+    ranked.clear();
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (rates[i])
         {
-            info.isElephantFlowImmediately = false;
+            ranked.emplace_back(rates[i]->bps, keys[i]);
         }
-        // TODO[IMPLEMENT]: Gain sampling rate from flow sample
-        info.estimatedPacketSendingRateImmediately = accumulatedEstimatedBytes / hopsCounter;
-
-        SPDLOG_LOGGER_DEBUG(Logger::instance(),
-                            "FlowKey: {} -> {}",
-                            utils::ipToString(flowKey.srcIP),
-                            utils::ipToString(flowKey.dstIP));
-        SPDLOG_LOGGER_DEBUG(Logger::instance(),
-                            "Estimated packet sending rate (Immediately): {}",
-                            info.estimatedFlowSendingRateImmediately);
     }
-}
-
-void
-FlowLinkUsageCollector::testCalAvgFlowSendingRatesRandomly()
-{
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<> dist(500, 2000); // 500ms-2000ms between calls
 
-    while (m_running.load())
+    if (ranked.size() > k)
     {
-        calAvgFlowSendingRatesImmediately();
-
-        int waitTime = dist(gen);
-
-        SPDLOG_LOGGER_TRACE(Logger::instance(),
-                            "FlowLinkUsageCollector::testCalAvgFlowSendingRatesRandomly() "
-                            "Waiting for {} ms before next call...",
-                            waitTime);
-        this_thread::sleep_for(chrono::milliseconds(waitTime));
+        std::nth_element(ranked.begin(), ranked.begin() + k, ranked.end(), std::greater<>());
+        ranked.resize(k);
     }
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Exiting Loop of testCalAvgFlowSendingRatesRandomly");
+    std::sort(ranked.begin(), ranked.end(), std::greater<>());
+    return ranked;
 }
 
-inline string
-FlowLinkUsageCollector::ourIpToString(uint32_t ipFront, uint32_t ipBack)
+std::optional<ImmediateRate>
+FlowLinkUsageCollector::getImmediateRate(const FlowKey& key) const
 {
-    string res;
-    res = to_string((ipFront & 65535) >> 8) + "." + to_string(ipFront & 255) + "." +
-          to_string(ipBack >> 24) + "." + to_string((ipBack >> 16) & 255);
-    return res;
+    const FlowTableShard& shard = m_flowInfoShards[flowShardIndex(key)];
+    shared_lock lock(shard.mutex);
+    auto it = shard.table.find(key);
+    if (it == shard.table.end())
+    {
+        // A cold flow has no samples within the window
+        return shard.cold.contains(key) ? std::optional<ImmediateRate>(ImmediateRate{})
+                                        : std::nullopt;
+    }
+    return it->second.immediateRate();
 }
 
-inline uint32_t
-FlowLinkUsageCollector::ipFromFrontBack(uint32_t ipFront, uint32_t ipBack)
+std::vector<std::optional<ImmediateRate>>
+FlowLinkUsageCollector::getImmediateRates(std::span<const FlowKey> keys) const
 {
-    // extract octets in network‐order
-    uint8_t o1 = (ipFront >> 8) & 0xFF;
-    uint8_t o2 = ipFront & 0xFF;
-    uint8_t o3 = (ipBack >> 24) & 0xFF;
-    uint8_t o4 = (ipBack >> 16) & 0xFF;
-
-    // pack into a network‐order 32‑bit IP
-    uint32_t netOrder =
-        (uint32_t(o1) << 24) | (uint32_t(o2) << 16) | (uint32_t(o3) << 8) | (uint32_t(o4) << 0);
-
-    return ntohl(netOrder);
-}
+    std::vector<std::optional<ImmediateRate>> rates(keys.size());
+    // Positions of the keys, grouped by shard
+    std::vector<std::pair<size_t, size_t>> order;
+    order.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        order.emplace_back(flowShardIndex(keys[i]), i);
+    }
+    std::sort(order.begin(), order.end());
 
-void
-FlowLinkUsageCollector::purgeIdleFlows()
-{
-    while (m_running.load())
+    for (auto group = order.begin(); group != order.end();)
     {
-        vector<FlowKey> toRemove;
+        const FlowTableShard& shard = m_flowInfoShards[group->first];
+        shared_lock lock(shard.mutex);
+        for (; group != order.end() && &m_flowInfoShards[group->first] == &shard; ++group)
         {
-            shared_lock lock(m_flowInfoTableMutex);
-            int64_t now = utils::getCurrentTimeMillisSystemClock();
-
-            for (auto& [flowKey, info] : m_flowInfoTable)
+            auto it = shard.table.find(keys[group->second]);
+            if (it != shard.table.end())
             {
-                if (now <= info.endTime)
-                {
-                    continue;
-                }
-                int64_t idle_time = now - info.endTime;
-                if (idle_time >= FLOW_IDLE_TIMEOUT)
-                {
-                    toRemove.push_back(flowKey);
-
-                    SPDLOG_LOGGER_DEBUG(Logger::instance(),
-                                        "Now: {} End Time: {}",
-                                        now,
-                                        info.endTime);
-                    SPDLOG_LOGGER_INFO(Logger::instance(),
-                                       "Flow Key: {} -> {} idles",
-                                       utils::ipToString(flowKey.srcIP),
-                                       utils::ipToString(flowKey.dstIP));
-
-                    SPDLOG_LOGGER_DEBUG(
-                        Logger::instance(),
-                        "m_flowInfoTable[flowKey].estimatedFlowSendingRatePeriodically: "
-                        "{}",
-                        m_flowInfoTable[flowKey].estimatedFlowSendingRatePeriodically);
-                }
+                rates[group->second] = it->second.immediateRate();
             }
-        }
-
-        for (const auto& key : toRemove)
-        {
+            else if (shard.cold.contains(keys[group->second]))
             {
-                unique_lock lock(m_flowInfoTableMutex);
-                m_flowInfoTable.erase(key);
+                rates[group->second] = ImmediateRate{};
             }
         }
-
-        this_thread::sleep_for(chrono::milliseconds(1000));
     }
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Exiting Loop of purgeIdleFlows");
+    return rates;
 }
 
-unordered_map<FlowKey, FlowInfo, FlowKeyHash>
-FlowLinkUsageCollector::getFlowInfoTable()
+std::shared_ptr<const FlowLinkUsageCollector::HostPairTable>
+FlowLinkUsageCollector::hostPairsSnapshot() const
 {
-    shared_lock lock(m_flowInfoTableMutex);
-    return m_flowInfoTable;
+    std::lock_guard<std::mutex> lock(m_hostPairsMutex);
+    return m_hostPairs;
 }
 
-nlohmann::json
-FlowLinkUsageCollector::getFlowInfoJson()
+const FlowLinkUsageCollector::HostPairTable&
+FlowLinkUsageCollector::hostPairs() const
 {
-    shared_lock lock(m_flowInfoTableMutex);
-    nlohmann::json result = nlohmann::json::array();
-
-    for (const auto& [flowKey, flowInfo] : m_flowInfoTable)
+    struct Cached
     {
-        nlohmann::json j;
-
-        j["src_ip"] = flowKey.srcIP;
-        j["dst_ip"] = flowKey.dstIP;
-        j["src_port"] = flowKey.srcPort;
-        j["dst_port"] = flowKey.dstPort;
-        j["protocol_id"] = flowKey.protocol;
-
-        j["estimated_flow_sending_rate_bps_in_the_proceeding_1sec_timeslot"] =
-            flowInfo.estimatedFlowSendingRatePeriodically;
-        j["estimated_flow_sending_rate_bps_in_the_last_sec"] =
-            flowInfo.estimatedFlowSendingRateImmediately;
-        j["estimated_packet_rate_in_the_proceeding_1sec_timeslot"] =
-            flowInfo.estimatedPacketSendingRatePeriodically;
-        j["estimated_packet_rate_in_the_last_sec"] = flowInfo.estimatedPacketSendingRateImmediately;
-        j["first_sampled_time"] = utils::formatTime(flowInfo.startTime);
-        j["latest_sampled_time"] = utils::formatTime(flowInfo.endTime);
-        j["path"] = nlohmann::json::array();
-        // for (const auto& [node, interface] : m_allPathMap[{flowKey.srcIP, flowKey.dstIP}])
-        // {
-        //     j["path"].push_back({{"node", node}, {"interface", interface}});
-        // }
-        // TODO: Test Classifier
-        for (const auto& [node, interface] : flowInfo.flowPath)
-        {
-            j["path"].push_back({{"node", node}, {"interface", interface}});
-        }
+        uint64_t version = 0;
+        std::shared_ptr<const HostPairTable> table;
+    };
+    thread_local Cached cached;
 
-        result.push_back(j);
+    const uint64_t version = m_hostPairsVersion.load(std::memory_order_acquire);
+    if (!cached.table || cached.version != version)
+    {
+        // A table published in between is picked up again on the next call
+        cached.table = hostPairsSnapshot();
+        cached.version = version;
     }
-
-    return result;
+    return *cached.table;
 }
 
-nlohmann::json
-FlowLinkUsageCollector::getTopKFlowInfoJson(int k)
+void
+FlowLinkUsageCollector::updateHostPairs(const std::function<void(HostPairTable&)>& update)
 {
-    SPDLOG_LOGGER_DEBUG(Logger::instance(), "getTopKFlowInfoJson k={}", k);
-    shared_lock lock(m_flowInfoTableMutex);
-    nlohmann::json flowInfo = getFlowInfoJson();
-    SPDLOG_LOGGER_DEBUG(Logger::instance(), "Total flows: {}", flowInfo.size());
-
-    std::sort(flowInfo.begin(),
-              flowInfo.end(),
-              [](const nlohmann::json& a, const nlohmann::json& b) {
-                  return a["estimated_flow_sending_rate_bps_in_the_last_sec"].get<uint64_t>() >
-                         b["estimated_flow_sending_rate_bps_in_the_last_sec"].get<uint64_t>();
-              });
-
-    nlohmann::json topKFlows = nlohmann::json::array();
-    for (int i = 0; i < std::min(k, static_cast<int>(flowInfo.size())); ++i)
-    {
-        topKFlows.push_back(flowInfo[i]);
-    }
-
-    return topKFlows;
+    // Shared by all instances, so a thread's cached version never matches another
+    // collector's table
+    static std::atomic<uint64_t> publishedTables{0};
+
+    std::lock_guard<std::mutex> lock(m_hostPairsMutex);
+    auto table = std::make_shared<HostPairTable>(*m_hostPairs);
+    update(*table);
+    m_hostPairs = std::move(table);
+    m_hostPairsVersion.store(publishedTables.fetch_add(1, std::memory_order_relaxed) + 1,
+                             std::memory_order_release);
 }
 
 void
 FlowLinkUsageCollector::setAllPaths(std::vector<sflow::Path> allPathsVector)
 {
-    for (const auto& path : allPathsVector)
-    {
-        uint32_t srcIp = path.front().first;
-        uint32_t dstIp = path.back().first;
-
-        // Number of switches = total nodes - 2 (source and destination)
-        size_t switchCount = path.size() > 1 ? path.size() - 2 : 0;
-        SPDLOG_LOGGER_TRACE(Logger::instance(),
-                            "Path from {} -> {} passes through {} switches.",
-                            srcIp,
-                            dstIp,
-                            switchCount);
-        m_switchCountMap[{srcIp, dstIp}] = switchCount;
-
-        m_allPathMap[{srcIp, dstIp}] = path;
-    }
-
-    // Print out the map
-    // for (const auto& [key, value] : m_allPathMap)
-    // {
-    //     const auto& [srcIp, dstIp] = key;
-    //     std::ostringstream oss;
-
-    //     oss << "Path: ";
-    //     for (const auto& [nodeId, port] : value)
-    //     {
-    //         oss << "(" << nodeId << ", " << port << ") ";
-    //     }
+    size_t pairCount = 0;
+    updateHostPairs([&](HostPairTable& table) {
+        table.reserve(table.size() + allPathsVector.size());
+        for (const auto& path : allPathsVector)
+        {
+            uint32_t srcIp = path.front().first;
+            uint32_t dstIp = path.back().first;
 
-    //     SPDLOG_LOGGER_DEBUG(Logger::instance(), "Flow from {} -> {}: {}", srcIp, dstIp,
-    //     oss.str());
-    // }
+            // Number of switches = total nodes - 2 (source and destination)
+            size_t switchCount = path.size() > 1 ? path.size() - 2 : 0;
+            SPDLOG_LOGGER_TRACE(Logger::instance(),
+                                "Path from {} -> {} passes through {} switches.",
+                                srcIp,
+                                dstIp,
+                                switchCount);
+            table[hostPairKey(srcIp, dstIp)] = HostPairRoute{PathHandle(path), switchCount};
+        }
+        pairCount = table.size();
+    });
 
-    SPDLOG_LOGGER_DEBUG(Logger::instance(), "m_allPathMap size {}", m_allPathMap.size());
+    SPDLOG_LOGGER_DEBUG(Logger::instance(), "Host pair table size {}", pairCount);
 
     return;
 }
@@ -1345,7 +4365,13 @@ FlowLinkUsageCollector::setAllPaths(std::vector<sflow::Path> allPathsVector)
 std::map<std::pair<uint32_t, uint32_t>, Path>
 FlowLinkUsageCollector::getAllPaths()
 {
-    return m_allPathMap;
+    std::map<std::pair<uint32_t, uint32_t>, Path> allPaths;
+    for (const auto& [pair, route] : *hostPairsSnapshot())
+    {
+        allPaths.emplace(std::pair<uint32_t, uint32_t>(pair >> 32, uint32_t(pair)),
+                         route.path.path());
+    }
+    return allPaths;
 }
 
 void
@@ -1353,17 +4379,22 @@ FlowLinkUsageCollector::fetchAllDestinationPaths()
 {
     try
     {
-        // 1. Build and run the curl command
-        //    -s: silent mode
-        //    -H: set header
-        const std::string cmd = "curl -s "
-                                "-H \"User-Agent: NDT-client/1.1\" "
-                                "\"http://" +
-                                AppConfig::RYU_IP_AND_PORT + "/ryu_server/all_destination_paths\"";
-        const std::string output = utils::execCommand(cmd);
+        // 1. Query the controller
+        utils::HttpRequestOptions options;
+        options.headers.emplace_back("User-Agent", "NDT-client/1.1");
+        utils::HttpResponse response = utils::HttpClient::instance().get(
+            "http://" + ryuAddress() + "/ryu_server/all_destination_paths",
+            options);
+        if (response.error)
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                "Cannot pull all destination paths: {}",
+                                response.error.message());
+            return;
+        }
 
         // 2. Parse JSON
-        auto body = json::parse(output);
+        auto body = json::parse(response.body);
 
         // 3. Check status field
         if (!body.contains("status") || body["status"] != "success")
@@ -1417,7 +4448,7 @@ FlowLinkUsageCollector::fetchAllDestinationPaths()
     catch (const std::exception& e)
     {
         SPDLOG_LOGGER_ERROR(Logger::instance(),
-                            "Exception in pull_all_destination_paths (curl): {}",
+                            "Exception in pull_all_destination_paths: {}",
                             e.what());
     }
 }
@@ -1425,19 +4456,22 @@ FlowLinkUsageCollector::fetchAllDestinationPaths()
 void
 FlowLinkUsageCollector::setAllPath(std::pair<uint32_t, uint32_t> ipPair, Path path)
 {
-    m_allPathMap[ipPair] = path;
+    size_t switchCount = path.size() > 1 ? path.size() - 2 : 0;
+    updateHostPairs([&](HostPairTable& table) {
+        table[hostPairKey(ipPair.first, ipPair.second)] =
+            HostPairRoute{PathHandle(path), switchCount};
+    });
 }
 
 std::vector<uint32_t>
 FlowLinkUsageCollector::getAllHostIps()
 {
     std::set<uint32_t> allHostIps;
-    std::map<std::pair<uint32_t, uint32_t>, sflow::Path> allPaths = getAllPaths();
 
-    for (const auto& [flowPair, path] : allPaths)
+    for (const auto& [pair, route] : *hostPairsSnapshot())
     {
-        allHostIps.insert(flowPair.first);  // srcIp
-        allHostIps.insert(flowPair.second); // dstIp
+        allHostIps.insert(uint32_t(pair >> 32)); // srcIp
+        allHostIps.insert(uint32_t(pair));       // dstIp
     }
 
     std::vector<uint32_t> hostIpList(allHostIps.begin(), allHostIps.end());
@@ -1448,21 +4482,22 @@ FlowLinkUsageCollector::getAllHostIps()
 void
 FlowLinkUsageCollector::printAllPathMap()
 {
-    for (const auto& [key, value] : m_allPathMap)
+    for (const auto& [pair, route] : *hostPairsSnapshot())
     {
-        const auto& [srcIp, dstIp] = key;
+        const uint32_t srcIp = uint32_t(pair >> 32);
+        const uint32_t dstIp = uint32_t(pair);
         std::ostringstream oss;
 
         oss << "Path: ";
-        for (const auto& [nodeId, port] : value)
+        for (const auto& [nodeId, port] : route.path)
         {
             oss << "(" << nodeId << ", " << port << ") ";
         }
 
         SPDLOG_LOGGER_DEBUG(Logger::instance(),
                             "Flow from {} -> {}: {}",
-                            utils::ipToString(srcIp),
-                            utils::ipToString(dstIp),
+                            utils::Ipv4{srcIp},
+                            utils::Ipv4{dstIp},
                             oss.str());
     }
 }
@@ -1491,246 +4526,537 @@ popcount32(uint32_t x)
 std::optional<size_t>
 FlowLinkUsageCollector::getSwitchCount(std::pair<uint32_t, uint32_t> ipPair)
 {
-    // 1. Lock the mutex for thread-safe reading.
-    // A shared_lock allows multiple readers at the same time.
-    std::shared_lock<std::shared_mutex> lock(m_switchCountMapMutex);
-
-    // 2. Use the .find() method to look for the key.
-    // This is safer than operator[] because it doesn't insert a new element if the key isn't found.
-    auto it = m_switchCountMap.find(ipPair);
-
-    // 3. Check if the iterator is valid (i.e., the key was found).
-    if (it != m_switchCountMap.end())
+    const HostPairTable& table = hostPairs();
+    auto it = table.find(hostPairKey(ipPair.first, ipPair.second));
+    if (it != table.end())
     {
-        // The key exists, return the associated value (the switch count).
-        return it->second;
+        return it->second.switchCount;
     }
-
-    // 4. The key was not found, return an empty optional to indicate failure.
     return std::nullopt;
 }
 
 std::map<std::pair<uint32_t, uint32_t>, size_t>
 FlowLinkUsageCollector::getAllSwitchCounts()
 {
-    // 1. Acquire a shared lock for thread-safe reading of the map.
-    std::shared_lock<std::shared_mutex> lock(m_switchCountMapMutex);
+    std::map<std::pair<uint32_t, uint32_t>, size_t> switchCounts;
+    for (const auto& [pair, route] : *hostPairsSnapshot())
+    {
+        switchCounts.emplace(std::pair<uint32_t, uint32_t>(pair >> 32, uint32_t(pair)),
+                             route.switchCount);
+    }
+    return switchCounts;
+}
 
-    // 2. Return a copy of the entire map. This is thread-safe because
-    //    the caller gets a snapshot of the data and doesn't hold a lock.
-    return m_switchCountMap;
+std::vector<std::optional<uint64_t>>
+FlowLinkUsageCollector::getHostPairResiduals(
+    const std::vector<std::pair<uint32_t, uint32_t>>& ipPairs)
+{
+    const HostPairTable& table = hostPairs();
+    std::vector<PathHandle> paths(ipPairs.size());
+    for (size_t i = 0; i < ipPairs.size(); ++i)
+    {
+        auto it = table.find(hostPairKey(ipPairs[i].first, ipPairs[i].second));
+        if (it != table.end())
+        {
+            paths[i] = it->second.path;
+        }
+    }
+    return m_topologyAndFlowMonitor->getPathResiduals(paths);
 }
 
 json
-FlowLinkUsageCollector::getPathBetweenHostsJson(const std::string& srcHostName,
-                                                const std::string& dstHostName)
+FlowLinkUsageCollector::getPathsBetweenHostsJson(
+    const std::vector<std::pair<std::string, std::string>>& pairs)
 {
-    // 1. Find hosts using the member variable m_topologyAndFlowMonitor
-    auto srcHostOpt = m_topologyAndFlowMonitor->findVertexByDeviceName(srcHostName);
-    auto dstHostOpt = m_topologyAndFlowMonitor->findVertexByDeviceName(dstHostName);
-
-    // 2. Handle cases where one or both hosts are not found
-    if (!srcHostOpt.has_value() || !dstHostOpt.has_value())
+    // Every distinct host resolved once, under one graph lock
+    std::vector<std::string> names;
+    std::unordered_map<std::string, size_t> nameIndex;
+    for (const auto& [src, dst] : pairs)
     {
-        json errorJson;
-        errorJson["error"] = "One or both hosts could not be found in the topology.";
-        if (!srcHostOpt.has_value())
+        for (const std::string* name : {&src, &dst})
         {
-            errorJson["missing_hosts"].push_back(srcHostName);
+            if (nameIndex.emplace(*name, names.size()).second)
+            {
+                names.push_back(*name);
+            }
         }
-        if (!dstHostOpt.has_value())
+    }
+    std::vector<std::optional<uint32_t>> ips =
+        m_topologyAndFlowMonitor->getIpsByDeviceName(names);
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        in_addr addr;
+        if (!ips[i] && inet_aton(names[i].c_str(), &addr) != 0)
         {
-            errorJson["missing_hosts"].push_back(dstHostName);
+            ips[i] = addr.s_addr;
         }
-        return errorJson.dump();
     }
 
-    // 3. Get the IP addresses
-    auto graph = m_topologyAndFlowMonitor->getGraph();
-    uint32_t srcIp = graph[*srcHostOpt].ip[0];
-    uint32_t dstIp = graph[*dstHostOpt].ip[0];
-
-    // 4. Retrieve the path map from this collector
-    auto allPaths = this->getAllPaths();
-    auto it = allPaths.find({srcIp, dstIp});
-
-    if (it == allPaths.end())
+    const HostPairTable& table = hostPairs();
+    std::vector<const PathHandle*> paths(pairs.size());
+    std::vector<uint64_t> dpids;
+    for (size_t i = 0; i < pairs.size(); ++i)
     {
-        return "{\"error\":\"No active or known path found between the specified hosts.\"}";
+        const std::optional<uint32_t>& srcIp = ips[nameIndex.at(pairs[i].first)];
+        const std::optional<uint32_t>& dstIp = ips[nameIndex.at(pairs[i].second)];
+        if (!srcIp || !dstIp)
+        {
+            continue;
+        }
+        auto it = table.find(hostPairKey(*srcIp, *dstIp));
+        if (it == table.end())
+        {
+            continue;
+        }
+        paths[i] = &it->second.path;
+        // The hops between the two hosts
+        for (size_t hop = 1; hop + 1 < paths[i]->size(); ++hop)
+        {
+            dpids.push_back((*paths[i])[hop].first);
+        }
     }
+    const std::vector<std::string> switchNames =
+        m_topologyAndFlowMonitor->getSwitchNamesByDpid(dpids);
 
-    const auto& path = it->second;
-
-    // 5. Format the result
-    json result;
-    json pathJson = json::array();
-
-    if (path.size() > 2)
+    json results = json::array();
+    size_t nextSwitch = 0;
+    for (size_t i = 0; i < pairs.size(); ++i)
     {
-        for (size_t i = 1; i < path.size() - 1; ++i)
+        const auto& [srcHostName, dstHostName] = pairs[i];
+        json result{{"source_host", srcHostName}, {"destination_host", dstHostName}};
+        if (!paths[i])
         {
-            uint64_t dpid = path[i].first;
-            auto switchVertexOpt = m_topologyAndFlowMonitor->findSwitchByDpid(dpid);
-            if (switchVertexOpt.has_value())
+            json missing = json::array();
+            for (const std::string* name : {&srcHostName, &dstHostName})
+            {
+                if (!ips[nameIndex.at(*name)])
+                {
+                    missing.push_back(*name);
+                }
+            }
+            if (missing.empty())
             {
-                pathJson.push_back(graph[*switchVertexOpt].deviceName);
+                result["error"] = "No active or known path found between the specified hosts.";
             }
             else
             {
-                pathJson.push_back("unknown_switch_dpid_" + std::to_string(dpid));
+                result["error"] = "One or both hosts could not be found in the topology.";
+                result["missing_hosts"] = std::move(missing);
             }
+            results.push_back(std::move(result));
+            continue;
         }
-    }
 
-    result["source_host"] = srcHostName;
-    result["destination_host"] = dstHostName;
-    result["switch_path"] = pathJson;
+        json pathJson = json::array();
+        for (size_t hop = 1; hop + 1 < paths[i]->size(); ++hop, ++nextSwitch)
+        {
+            if (switchNames[nextSwitch].empty())
+            {
+                pathJson.push_back("unknown_switch_dpid_" + std::to_string(dpids[nextSwitch]));
+            }
+            else
+            {
+                pathJson.push_back(switchNames[nextSwitch]);
+            }
+        }
+        result["switch_count"] = pathJson.size();
+        result["switch_path"] = std::move(pathJson);
+        results.push_back(std::move(result));
+    }
+    return results;
+}
 
-    return result;
+json
+FlowLinkUsageCollector::getPathBetweenHostsJson(const std::string& srcHostName,
+                                                const std::string& dstHostName)
+{
+    return getPathsBetweenHostsJson({{srcHostName, dstHostName}}).at(0);
 }
 
 void
 FlowLinkUsageCollector::calFlowPathByQueried()
 {
-    using MapT = std::remove_reference_t<decltype(m_flowInfoTable)>;
-    using FlowInfoKey = typename MapT::key_type;
-
-    while (m_running.load(std::memory_order_relaxed))
-    {
-        // Snapshot keys under a shared/read lock
-        std::vector<FlowInfoKey> keys;
+    // Follow the classifier hop by hop from @p edge until a host is reached, recording the
+    // hops, the switches looked up and the key bits their rules consulted
+    utils::Histogram& classifierLookup = utils::MetricsRegistry::instance().histogram(
+        "ndt_classifier_lookup_seconds", "Time of one Classifier pipeline lookup");
+    auto walkClassifier = [this, &classifierLookup](Graph::edge_descriptor edge,
+                                 const ndtClassifier::FlowKey& fk,
+                                 const Graph& graph,
+                                 ndtClassifier::FlowKey& consulted,
+                                 FlowPathCache::Entry& entry) {
+        for (int hop = 0; hop < 100; ++hop)
         {
-            std::shared_lock<std::shared_mutex> lk(m_flowInfoTableMutex);
-            keys.reserve(m_flowInfoTable.size());
-            for (const auto& kv : m_flowInfoTable)
+            auto srcSw = boost::target(edge, graph);
+
+            // Reached host vertex?
+            if (graph[srcSw].dpid == 0)
+            {
+                entry.terminalIps = graph[srcSw].ip;
+                return true;
+            }
+
+            entry.switches.push_back(graph[srcSw].dpid);
+            // The whole pipeline, so goto_table chains and (SELECT) groups are followed; the
+            // effect is reused across hops and flows, so a lookup allocates nothing
+            thread_local ndtClassifier::PipelineEffect effect;
+            const auto lookupStart = std::chrono::steady_clock::now();
+            const bool matched =
+                m_classifier->lookupPipelineInto(graph[srcSw].dpid, fk, &consulted, effect);
+            classifierLookup.observe(std::chrono::steady_clock::now() - lookupStart);
+            if (!matched || effect.outputPorts.empty())
+            {
+                return false;
+            }
+
+            uint32_t outPort = effect.outputPorts.front();
+
+            NDT_LOG_DEBUG(PATHS,
+                          "effect outputPorts.size(): {} outputPorts.front() {}",
+                          effect.outputPorts.size(),
+                          outPort);
+
+            entry.hops.push_back(std::make_pair(graph[srcSw].dpid, outPort));
+
+            auto nextEdgeOpt = m_topologyAndFlowMonitor->findEdgeByDpidAndPort(
+                std::make_pair(graph[srcSw].dpid, outPort));
+
+            if (!nextEdgeOpt.has_value())
             {
-                keys.push_back(kv.first);
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "edge not found by dpid/port {}:{}",
+                                   graph[srcSw].dpid,
+                                   outPort);
+                return false;
             }
+
+            edge = *nextEdgeOpt;
         }
 
-        // Compute each path without holding m_flowInfoTableMutex
-        for (const auto& flowKey : keys)
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Exceed 100 hop (potential loop) {} -> {}",
+                           utils::Ipv4{htonl(fk.ipv4Src)},
+                           utils::Ipv4{htonl(fk.ipv4Dst)});
+        return false;
+    };
+
+    // Resolve the full path of @p flowKey from its source host; false if there is none
+    auto resolvePath = [&](const FlowKey& flowKey,
+                           const Graph& graph,
+                           uint64_t rulesVersion,
+                           FlowPathCache& cache,
+                           sflow::Path& path) {
+        ndtClassifier::FlowKey fk{};
+        fk.ipProto = flowKey.protocol;
+        fk.ipv4Dst = ntohl(flowKey.dstIP);
+        fk.ipv4Src = ntohl(flowKey.srcIP);
+        fk.tpDst = flowKey.dstPort;
+        fk.tpSrc = flowKey.srcPort;
+        fk.ethType = 0x0800;
+
+        NDT_LOG_DEBUG(PATHS,
+                      "flow {}:{} to {}:{} proto num {}",
+                      fk.ipv4Src,
+                      fk.tpSrc,
+                      fk.ipv4Dst,
+                      fk.tpDst,
+                      fk.ipProto);
+
+        if (fk.ipv4Src == 0 || fk.ipv4Dst == 0)
         {
-            sflow::Path path;
-            bool ok = true;
+            SPDLOG_LOGGER_WARN(Logger::instance(), "fk.ipv4Src == 0 || fk.ipv4Dst == 0");
+            return false;
+        }
 
-            ndtClassifier::FlowKey fk{};
-            fk.ipProto = flowKey.protocol;
-            fk.ipv4Dst = ntohl(flowKey.dstIP);
-            fk.ipv4Src = ntohl(flowKey.srcIP);
-            fk.tpDst = flowKey.dstPort;
-            fk.tpSrc = flowKey.srcPort;
-            fk.ethType = 0x0800;
+        auto attachment = m_topologyAndFlowMonitor->findHostAttachment(flowKey.srcIP);
+        if (!attachment.has_value())
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "edge not found flow: {} to {} protocol {} srcPort {} dstPort {}",
+                               utils::Ipv4{flowKey.srcIP},
+                               utils::Ipv4{flowKey.dstIP},
+                               flowKey.protocol,
+                               flowKey.srcPort,
+                               flowKey.dstPort);
+            return false;
+        }
 
-            SPDLOG_LOGGER_DEBUG(Logger::instance(),
-                                "flow {}:{} to {}:{} proto num {}",
-                                fk.ipv4Src,
-                                fk.tpSrc,
-                                fk.ipv4Dst,
-                                fk.tpDst,
-                                fk.ipProto);
+        auto edge = attachment->accessEdge;
+        path.push_back(std::make_pair(flowKey.srcIP, attachment->port));
 
-            if (fk.ipv4Src == 0 || fk.ipv4Dst == 0)
+        // Flows of one forwarding class share the walk from the ingress switch on
+        const uint64_t ingressDpid = attachment->dpid;
+        const FlowPathCache::Entry* cached =
+            ingressDpid != 0 ? cache.find(ingressDpid, fk) : nullptr;
+        FlowPathCache::Entry walked;
+        ndtClassifier::FlowKey consulted{};
+        if (!cached)
+        {
+            walked.rulesVersion = rulesVersion;
+            walked.ok = walkClassifier(edge, fk, graph, consulted, walked);
+        }
+        const FlowPathCache::Entry& entry = cached ? *cached : walked;
+        if (!entry.ok)
+        {
+            path.clear();
+        }
+        else
+        {
+            path.insert(path.end(), entry.hops.begin(), entry.hops.end());
+            if (std::find(entry.terminalIps.begin(), entry.terminalIps.end(), flowKey.dstIP) !=
+                entry.terminalIps.end())
             {
-                ok = false;
-                SPDLOG_LOGGER_WARN(Logger::instance(), "fk.ipv4Src == 0 || fk.ipv4Dst == 0");
+                path.push_back(std::make_pair(flowKey.dstIP, 0));
             }
-            else
+        }
+        const bool ok = entry.ok;
+        if (!cached && ingressDpid != 0)
+        {
+            cache.insert(ingressDpid, fk, consulted, std::move(walked));
+        }
+        return ok;
+    };
+
+    struct ResolvedPath
+    {
+        size_t shard;
+        FlowKey key;
+        PathHandle path;        // empty if the flow has no path
+        uint32_t firstHopAgent; // 0 if unknown
+    };
+
+    // Commit @p batch under one unique lock per flow-table shard (no operator[]; don’t insert)
+    auto commitPaths = [this](std::vector<ResolvedPath>& batch, uint64_t rulesVersion) {
+        std::sort(batch.begin(), batch.end(), [](const auto& a, const auto& b) {
+            return a.shard < b.shard;
+        });
+        for (auto first = batch.begin(); first != batch.end();)
+        {
+            const size_t index = first->shard;
+            auto last = std::find_if(
+                first, batch.end(), [index](const auto& r) { return r.shard != index; });
+            FlowTableShard& shard = m_flowInfoShards[index];
+            std::unique_lock<std::shared_mutex> lk(shard.mutex);
+            std::lock_guard guard(m_hopFlowsMutex);
+            for (; first != last; ++first)
             {
-                auto edgeOpt = m_topologyAndFlowMonitor->findEdgeByHostIp(flowKey.srcIP);
-                if (!edgeOpt.has_value())
+                auto it = shard.table.find(first->key);
+                if (it == shard.table.end())
                 {
-                    ok = false;
-                    SPDLOG_LOGGER_WARN(
-                        Logger::instance(),
-                        "edge not found flow: {} to {} protocol {} srcPort {} dstPort {}",
-                        utils::ipToString(flowKey.srcIP),
-                        utils::ipToString(flowKey.dstIP),
-                        flowKey.protocol,
-                        flowKey.srcPort,
-                        flowKey.dstPort);
+                    continue;
                 }
-                else
+                it->second.pathVersion = rulesVersion;
+                it->second.firstHopAgent = first->firstHopAgent;
+                if (first->path != it->second.flowPath)
                 {
-                    auto edge = *edgeOpt;
+                    reindexFlowPathNoLock(first->key, it->second.flowPath, first->path);
+                    it->second.flowPath = std::move(first->path);
+                    markFlowChanged(it->second);
+                }
+            }
+        }
+        batch.clear();
+    };
 
-                    auto graph = m_topologyAndFlowMonitor->getGraph();
+    // Flows of one source host enter at the same switch, so keep them on one worker (and
+    // path cache partition)
+    auto pathPartition = [](const FlowKey& flowKey) {
+        return static_cast<size_t>((flowKey.srcIP * 0x9E3779B97F4A7C15ULL) >> 32) %
+               FLOW_PATH_WORKERS;
+    };
 
-                    path.push_back(std::make_pair(flowKey.srcIP, graph[edge].dstInterface));
+    uint64_t resolvedIndexVersion = m_topologyAndFlowMonitor->getIndexVersion();
+    uint64_t resolvedRulesVersion = 0;
+    // (flow table key, 5-tuple whose path it takes): they differ for aggregated flows
+    std::array<std::vector<std::pair<FlowKey, FlowKey>>, FLOW_PATH_WORKERS> keys;
+    auto addKey = [&](const FlowKey& flowKey, const FlowInfo& flowInfo) {
+        const bool sampled = flowInfo.sampleKey.srcIP != 0 || flowInfo.sampleKey.dstIP != 0;
+        const FlowKey& pathKey = sampled ? flowInfo.sampleKey : flowKey;
+        keys[pathPartition(pathKey)].emplace_back(flowKey, pathKey);
+    };
 
-                    int hop = 0;
-                    for (hop = 0; hop < 100; ++hop)
-                    {
-                        auto srcSw = boost::target(edge, graph);
-
-                        // Reached host vertex?
-                        if (graph[srcSw].dpid == 0)
-                        {
-                            auto it = std::find(graph[srcSw].ip.begin(),
-                                                graph[srcSw].ip.end(),
-                                                flowKey.dstIP);
-                            if (it != graph[srcSw].ip.end())
-                            {
-                                path.push_back(std::make_pair(flowKey.dstIP, 0));
-                            }
-                            break;
-                        }
-
-                        auto effect = m_classifier->lookup(graph[srcSw].dpid, fk);
-                        if (!effect || effect->outputPorts.empty())
-                        {
-                            ok = false;
-                            break;
-                        }
-
-                        uint32_t outPort = effect->outputPorts.front();
-
-                        SPDLOG_LOGGER_DEBUG(Logger::instance(),
-                                            "effect outputPorts.size(): {} outputPorts.front() {}",
-                                            effect->outputPorts.size(),
-                                            outPort);
-
-                        path.push_back(std::make_pair(graph[srcSw].dpid, outPort));
-
-                        auto nextEdgeOpt = m_topologyAndFlowMonitor->findEdgeByDpidAndPort(
-                            std::make_pair(graph[srcSw].dpid, outPort));
-
-                        if (!nextEdgeOpt.has_value())
-                        {
-                            ok = false;
-                            SPDLOG_LOGGER_WARN(Logger::instance(),
-                                               "edge not found by dpid/port {}:{}",
-                                               graph[srcSw].dpid,
-                                               outPort);
-                            break;
-                        }
-
-                        edge = *nextEdgeOpt;
-                    }
+    // Compute the paths of one partition without holding any shard lock, committing them
+    // every FLOW_PATH_COMMIT_BATCH flows
+    auto resolvePartition = [&](size_t worker, const Graph& graph, uint64_t rulesVersion) {
+        std::vector<ResolvedPath> batch;
+        batch.reserve(std::min<size_t>(keys[worker].size(), FLOW_PATH_COMMIT_BATCH));
+        for (const auto& [flowKey, pathKey] : keys[worker])
+        {
+            sflow::Path path;
+            if (!resolvePath(pathKey, graph, rulesVersion, m_pathCaches[worker], path))
+            {
+                path.clear();
+            }
+            uint32_t firstHopAgent = 0;
+            if (m_firstHopSampling && !path.empty())
+            {
+                firstHopAgent =
+                    m_topologyAndFlowMonitor->getSwitchIpByDpid(path.front().first).value_or(0);
+            }
+            // Interned here, so the commit under the shard lock only compares ids
+            batch.push_back(
+                ResolvedPath{flowShardIndex(flowKey), flowKey, PathHandle(path), firstHopAgent});
+            if (batch.size() >= FLOW_PATH_COMMIT_BATCH)
+            {
+                commitPaths(batch, rulesVersion);
+            }
+        }
+        commitPaths(batch, rulesVersion);
+    };
+
+    utils::ThreadRegistry::Scope thread("flow-paths", m_pathThreadCpus);
+    while (m_running.load(std::memory_order_relaxed))
+    {
+        thread.idle();
+        {
+            std::unique_lock lk(m_pathMutex);
+            m_pathCv.wait_for(lk, std::chrono::milliseconds(FLOW_PATH_RECHECK_MS), [this] {
+                return m_pathWork.load(std::memory_order_acquire) ||
+                       !m_running.load(std::memory_order_relaxed);
+            });
+        }
+        thread.wake();
+        m_pathWork.store(false, std::memory_order_release);
+
+        // Failover traces whose flows this pass resolves, recorded once it is done
+        std::vector<std::pair<utils::TraceId, std::chrono::steady_clock::time_point>> traces;
+        {
+            std::lock_guard lk(m_pathMutex);
+            traces.swap(m_pathTraces);
+        }
+        auto recordTraces = [&traces](size_t flows) {
+            const auto end = std::chrono::steady_clock::now();
+            for (const auto& [trace, queuedAt] : traces)
+            {
+                utils::Tracer::instance().span(
+                    trace, "path_computation", queuedAt, end, {{"flows", flows}});
+            }
+        };
+
+        // Read both versions before resolving, so a change racing with this pass is caught
+        // by the next one
+        // Paths follow the classifier and the index lookups only, so link state changes
+        // (a failure, a disabled edge) do not invalidate them; flows crossing a failed link
+        // are queued by invalidatePathsThrough()
+        const uint64_t indexVersion = m_topologyAndFlowMonitor->getIndexVersion();
+        const uint64_t rulesVersion = m_classifier->getRulesVersion();
+        const bool topologyChanged = indexVersion != resolvedIndexVersion;
+        const bool rulesChanged = rulesVersion != resolvedRulesVersion;
+
+        // Which flows to resolve: new ones, plus every flow after a topology change, or after
+        // a rule change the flows without a path and those crossing a switch whose rules
+        // changed since their path was resolved
+        std::unordered_map<uint64_t, uint64_t> switchVersions;
+        if (rulesChanged && !topologyChanged)
+        {
+            switchVersions = m_classifier->getRulesVersions();
+        }
+        auto isStale = [&](const FlowInfo& info) {
+            if (topologyChanged || info.flowPath.empty())
+            {
+                return true;
+            }
+            return std::any_of(info.flowPath.begin(), info.flowPath.end(), [&](const auto& hop) {
+                auto it = switchVersions.find(hop.first);
+                return it != switchVersions.end() && it->second > info.pathVersion;
+            });
+        };
 
-                    if (hop >= 100)
+        for (auto& partition : keys)
+        {
+            partition.clear();
+        }
+        for (auto& shard : m_flowInfoShards)
+        {
+            if (topologyChanged || rulesChanged)
+            {
+                {
+                    std::unique_lock<std::shared_mutex> lk(shard.mutex);
+                    shard.pathPending.clear();
+                }
+                std::shared_lock<std::shared_mutex> lk(shard.mutex);
+                for (const auto& [flowKey, flowInfo] : shard.table)
+                {
+                    if (isStale(flowInfo))
                     {
-                        ok = false;
-                        SPDLOG_LOGGER_WARN(Logger::instance(),
-                                           "Exceed 100 hop (potential loop) {} -> {}",
-                                           utils::ipToString(flowKey.srcIP),
-                                           utils::ipToString(flowKey.dstIP));
+                        addKey(flowKey, flowInfo);
                     }
                 }
             }
-
-            // Commit the result under unique lock (no operator[]; don’t insert)
+            else
             {
-                std::unique_lock<std::shared_mutex> lk(m_flowInfoTableMutex);
-                auto it = m_flowInfoTable.find(flowKey);
-                if (it != m_flowInfoTable.end())
+                std::unique_lock<std::shared_mutex> lk(shard.mutex);
+                for (const auto& flowKey : shard.pathPending)
                 {
-                    it->second.flowPath = ok ? std::move(path) : sflow::Path{};
+                    if (auto it = shard.table.find(flowKey); it != shard.table.end())
+                    {
+                        addKey(flowKey, it->second);
+                    }
                 }
+                shard.pathPending.clear();
+            }
+        }
+        for (auto& cache : m_pathCaches)
+        {
+            if (topologyChanged)
+            {
+                cache.clear();
+            }
+            else if (rulesChanged)
+            {
+                cache.invalidate(switchVersions);
             }
         }
+        resolvedIndexVersion = indexVersion;
+        resolvedRulesVersion = rulesVersion;
 
-        std::this_thread::sleep_for(std::chrono::microseconds(1000));
+        size_t total = 0;
+        for (const auto& partition : keys)
+        {
+            total += partition.size();
+        }
+        if (total == 0)
+        {
+            recordTraces(0);
+            continue;
+        }
+        NDT_LOG_DEBUG(PATHS,
+                      "Resolving {} flow paths (topology changed {}, rules changed {})",
+                      total,
+                      topologyChanged,
+                      rulesChanged);
+
+        // One graph snapshot serves the whole pass; edge descriptors found below stay valid in
+        // it because edges are only added while the static topology is loaded
+        auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+        const Graph& graph = graphSnapshot->graph;
+
+        // Large passes (a reroute or cold start) are spread over FLOW_PATH_WORKERS threads;
+        // the classifier and topology lookups they make only take shared locks
+        if (total < FLOW_PATH_PARALLEL_MIN)
+        {
+            for (size_t worker = 0; worker < FLOW_PATH_WORKERS; ++worker)
+            {
+                resolvePartition(worker, graph, rulesVersion);
+            }
+            recordTraces(total);
+            continue;
+        }
+        std::vector<std::thread> workers;
+        workers.reserve(FLOW_PATH_WORKERS - 1);
+        for (size_t worker = 1; worker < FLOW_PATH_WORKERS; ++worker)
+        {
+            if (!keys[worker].empty())
+            {
+                workers.emplace_back(resolvePartition, worker, std::cref(graph), rulesVersion);
+            }
+        }
+        resolvePartition(0, graph, rulesVersion);
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        recordTraces(total);
     }
 }
 
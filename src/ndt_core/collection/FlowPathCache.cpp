@@ -0,0 +1,152 @@
+#include "ndt_core/collection/FlowPathCache.hpp"
+#include "utils/Hash.hpp"
+#include <algorithm>
+#include <initializer_list>
+
+namespace sflow
+{
+
+size_t
+FlowPathCache::KeyHash::operator()(const Key& key) const
+{
+    const auto& k = key.masked;
+    return utils::hashWords({key.ingressDpid,
+                             uint64_t(key.maskIndex),
+                             (uint64_t(k.ipv4Src) << 32) | k.ipv4Dst,
+                             (uint64_t(k.tpSrc) << 48) | (uint64_t(k.tpDst) << 32) |
+                                 (uint64_t(k.ethType) << 16) | (uint64_t(k.ipProto) << 8),
+                             (uint64_t(k.inPort) << 32) | k.vlanTci,
+                             k.metadata});
+}
+
+ndtClassifier::FlowKey
+FlowPathCache::applyMask(const ndtClassifier::FlowKey& key, const ndtClassifier::FlowKey& mask)
+{
+    ndtClassifier::FlowKey out;
+    out.inPort = key.inPort & mask.inPort;
+    out.ethType = key.ethType & mask.ethType;
+    out.ipProto = key.ipProto & mask.ipProto;
+    out.ipv4Src = key.ipv4Src & mask.ipv4Src;
+    out.ipv4Dst = key.ipv4Dst & mask.ipv4Dst;
+    out.tpSrc = key.tpSrc & mask.tpSrc;
+    out.tpDst = key.tpDst & mask.tpDst;
+    out.vlanTci = key.vlanTci & mask.vlanTci;
+    out.metadata = key.metadata & mask.metadata;
+    return out;
+}
+
+const FlowPathCache::Entry*
+FlowPathCache::find(uint64_t ingressDpid, const ndtClassifier::FlowKey& key)
+{
+    auto masks = m_masks.find(ingressDpid);
+    if (masks != m_masks.end())
+    {
+        for (uint32_t i = 0; i < masks->second.size(); ++i)
+        {
+            auto it = m_entries.find(Key{ingressDpid, i, applyMask(key, masks->second[i])});
+            if (it != m_entries.end())
+            {
+                m_hits.fetch_add(1, std::memory_order_relaxed);
+                return &it->second;
+            }
+        }
+    }
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void
+FlowPathCache::insert(uint64_t ingressDpid,
+                      const ndtClassifier::FlowKey& key,
+                      const ndtClassifier::FlowKey& consulted,
+                      Entry entry)
+{
+    if (m_entries.size() >= FLOW_PATH_CACHE_MAX_ENTRIES)
+    {
+        clear();
+    }
+
+    auto& masks = m_masks[ingressDpid];
+    auto maskIt = std::find(masks.begin(), masks.end(), consulted);
+    if (maskIt == masks.end())
+    {
+        masks.push_back(consulted);
+        maskIt = masks.end() - 1;
+        m_maskCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    Key cacheKey{
+        ingressDpid, static_cast<uint32_t>(maskIt - masks.begin()), applyMask(key, consulted)};
+    m_entries.insert_or_assign(cacheKey, std::move(entry));
+    m_size.store(m_entries.size(), std::memory_order_relaxed);
+}
+
+size_t
+FlowPathCache::invalidate(const std::unordered_map<uint64_t, uint64_t>& switchVersions)
+{
+    size_t dropped = std::erase_if(m_entries, [&](const auto& item) {
+        const Entry& entry = item.second;
+        return std::any_of(entry.switches.begin(), entry.switches.end(), [&](uint64_t dpid) {
+            auto it = switchVersions.find(dpid);
+            return it != switchVersions.end() && it->second > entry.rulesVersion;
+        });
+    });
+    m_size.store(m_entries.size(), std::memory_order_relaxed);
+    m_invalidations.fetch_add(dropped, std::memory_order_relaxed);
+    return dropped;
+}
+
+void
+FlowPathCache::clear()
+{
+    m_invalidations.fetch_add(m_entries.size(), std::memory_order_relaxed);
+    m_entries.clear();
+    m_masks.clear();
+    m_size.store(0, std::memory_order_relaxed);
+    m_maskCount.store(0, std::memory_order_relaxed);
+}
+
+FlowPathCache::Stats&
+FlowPathCache::Stats::operator+=(const Stats& o)
+{
+    entries += o.entries;
+    masks += o.masks;
+    hits += o.hits;
+    misses += o.misses;
+    invalidations += o.invalidations;
+    return *this;
+}
+
+nlohmann::json
+FlowPathCache::Stats::toJson() const
+{
+    return nlohmann::json{
+        {"entries", entries},
+        {"masks", masks},
+        {"hits", hits},
+        {"misses", misses},
+        {"hit_rate", hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0},
+        {"invalidations", invalidations}};
+}
+
+FlowPathCache::Stats
+FlowPathCache::stats() const
+{
+    Stats out;
+    out.entries = m_size.load(std::memory_order_relaxed);
+    out.masks = m_maskCount.load(std::memory_order_relaxed);
+    out.hits = m_hits.load(std::memory_order_relaxed);
+    out.misses = m_misses.load(std::memory_order_relaxed);
+    out.invalidations = m_invalidations.load(std::memory_order_relaxed);
+    return out;
+}
+
+size_t
+FlowPathCache::memoryBytes() const
+{
+    // An entry is a hash node (next pointer, cached hash, key and entry) in a bucket
+    const size_t entryBytes = 3 * sizeof(void*) + sizeof(Key) + sizeof(Entry);
+    return m_size.load(std::memory_order_relaxed) * entryBytes +
+           m_maskCount.load(std::memory_order_relaxed) * sizeof(ndtClassifier::FlowKey);
+}
+
+} // namespace sflow
@@ -0,0 +1,455 @@
+#include "ndt_core/collection/FlowRecordExporter.hpp"
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "utils/HistoryWriter.hpp"
+#include "utils/Logger.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace sflow
+{
+
+namespace
+{
+
+constexpr uint16_t IPFIX_VERSION = 10;
+constexpr uint16_t IPFIX_TEMPLATE_SET_ID = 2;
+constexpr uint16_t IPFIX_TEMPLATE_ID = 256;
+constexpr size_t IPFIX_SET_HEADER_SIZE = 4;
+
+// (information element id, length, enterprise-specific) of the data record, in order
+struct IpfixField
+{
+    uint16_t id;
+    uint16_t length;
+    bool enterprise;
+};
+constexpr IpfixField IPFIX_FIELDS[] = {
+    {8, 4, false},   // sourceIPv4Address
+    {12, 4, false},  // destinationIPv4Address
+    {7, 2, false},   // sourceTransportPort
+    {11, 2, false},  // destinationTransportPort
+    {4, 1, false},   // protocolIdentifier
+    {152, 8, false}, // flowStartMilliseconds
+    {153, 8, false}, // flowEndMilliseconds
+    {1, 8, false},   // octetDeltaCount
+    {2, 8, false},   // packetDeltaCount
+    {1, 8, true},    // path id
+    {2, 2, true},    // path hops
+    {3, 1, true},    // elephant flags: bit 0 periodically, bit 1 immediately
+};
+
+constexpr size_t
+ipfixRecordSize()
+{
+    size_t size = 0;
+    for (const IpfixField& field : IPFIX_FIELDS)
+    {
+        size += field.length;
+    }
+    return size;
+}
+
+void
+putBig(std::string& out, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i-- > 0;)
+    {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Overwrite the 16-bit length at @p pos
+void
+patchLength(std::string& out, size_t pos, size_t length)
+{
+    out[pos] = static_cast<char>(length >> 8);
+    out[pos + 1] = static_cast<char>(length);
+}
+
+// @p in as one gzip member; members can be concatenated into one valid file
+bool
+gzipMember(const std::string& in, std::string& out)
+{
+    z_stream zs{};
+    // 15 window bits + 16 selects the gzip wrapper instead of zlib's
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) !=
+        Z_OK)
+    {
+        return false;
+    }
+    out.resize(deflateBound(&zs, in.size()));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    const int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+
+} // namespace
+
+FlowRecord
+FlowRecord::from(const FlowKey& key, const FlowInfo& info)
+{
+    FlowRecord record;
+    record.key = key;
+    record.startMs = info.startTime;
+    record.endMs = info.endTime;
+    // Every agent on the path samples the same traffic: keep the fullest view
+    for (const auto& [agentKey, stats] : info.agentFlowStats)
+    {
+        const uint64_t rate = stats.samplingRate > 0 ? stats.samplingRate : 1;
+        const uint64_t bytes =
+            (stats.ingressByteCountCurrent + stats.egressByteCountCurrent) * rate;
+        if (bytes > record.bytes)
+        {
+            record.bytes = bytes;
+            record.packets =
+                (stats.ingresspacketCountCurrent + stats.egresspacketCountCurrent) * rate;
+        }
+    }
+    record.pathId = info.flowPath.fingerprint();
+    record.pathHops = static_cast<uint16_t>(info.flowPath.size());
+    record.elephantPeriodically = info.isElephantFlowPeriodically;
+    // From the sample windows: the stored flag is only kept by flow_rates.immediate_sweep
+    record.elephantImmediately = info.immediateRate().bps >= MICE_FLOW_UNDER_THRESHOLD;
+    return record;
+}
+
+FlowRecordExporter::FlowRecordExporter(FlowExportConfig config)
+    : m_config(std::move(config))
+{
+}
+
+FlowRecordExporter::~FlowRecordExporter()
+{
+    stop();
+}
+
+void
+FlowRecordExporter::start()
+{
+    if (m_running.exchange(true))
+    {
+        return;
+    }
+    m_thread = std::thread(&FlowRecordExporter::run, this);
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Flow record export started (directory '{}', IPFIX '{}')",
+                       m_config.directory,
+                       m_config.ipfixCollector);
+}
+
+void
+FlowRecordExporter::stop()
+{
+    {
+        std::lock_guard lock(m_wakeMutex);
+        m_running.store(false);
+    }
+    m_wakeCv.notify_one();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    // Its records still queued keep the file open until they are written
+    m_segment.reset();
+    if (m_ipfixFd >= 0)
+    {
+        ::close(m_ipfixFd);
+        m_ipfixFd = -1;
+    }
+}
+
+bool
+FlowRecordExporter::offer(FlowRecord record)
+{
+    if (!m_queue.tryPush(std::move(record)))
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_offered.fetch_add(1, std::memory_order_relaxed);
+    if (m_queue.size() >= FLOW_EXPORT_BATCH)
+    {
+        // A full batch is written now rather than at the next flush; a wakeup the writer
+        // misses only delays it until then
+        m_wakeCv.notify_one();
+    }
+    return true;
+}
+
+void
+FlowRecordExporter::run()
+{
+    utils::ThreadRegistry::Scope thread("flow-export");
+    std::vector<FlowRecord> batch;
+    batch.reserve(FLOW_EXPORT_BATCH);
+    bool running = true;
+    while (running)
+    {
+        {
+            std::unique_lock lock(m_wakeMutex);
+            m_wakeCv.wait_for(lock, std::chrono::milliseconds(FLOW_EXPORT_FLUSH_MS), [this] {
+                return !m_running.load() || m_queue.size() >= FLOW_EXPORT_BATCH;
+            });
+            running = m_running.load();
+        }
+
+        // Once stopping, this drains what the purge thread queued before it exited
+        FlowRecord record;
+        while (m_queue.tryPop(record))
+        {
+            batch.push_back(std::move(record));
+            if (batch.size() == FLOW_EXPORT_BATCH)
+            {
+                writeBatch(batch);
+                batch.clear();
+            }
+        }
+        if (!batch.empty())
+        {
+            writeBatch(batch);
+            batch.clear();
+        }
+    }
+}
+
+void
+FlowRecordExporter::writeBatch(const std::vector<FlowRecord>& batch)
+{
+    if (!m_config.directory.empty())
+    {
+        writeSegment(batch);
+    }
+    if (!m_config.ipfixCollector.empty())
+    {
+        sendIpfix(batch);
+    }
+    m_written.fetch_add(batch.size(), std::memory_order_relaxed);
+}
+
+void
+FlowRecordExporter::writeSegment(const std::vector<FlowRecord>& batch)
+{
+    // Segments are history too: not written while historical logging is disabled
+    if (!utils::HistoryWriter::instance().enabled())
+    {
+        return;
+    }
+    std::string text;
+    const auto now = std::chrono::steady_clock::now();
+    // A segment a member failed to be written to is given up rather than appended to after a
+    // partial member
+    if (m_segment && (m_segment->failed() ||
+                      now - m_segmentOpened >= std::chrono::seconds(FLOW_EXPORT_SEGMENT_SECONDS)))
+    {
+        m_segment.reset();
+    }
+    if (!m_segment)
+    {
+        std::time_t t = std::time(nullptr);
+        std::tm local_tm = *std::localtime(&t);
+        char nameBuf[32];
+        std::strftime(nameBuf, sizeof(nameBuf), "flows-%Y%m%d-%H%M%S.csv.gz", &local_tm);
+        const std::string path = m_config.directory + "/" + nameBuf;
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+            SPDLOG_LOGGER_ERROR(
+                Logger::instance(), "Flow export: cannot open {}: {}", path, strerror(errno));
+            return;
+        }
+        m_segment = std::make_shared<utils::HistoryFile>(fd, path);
+        m_segmentOpened = now;
+        m_segments.fetch_add(1, std::memory_order_relaxed);
+        text = "src_ip,dst_ip,src_port,dst_port,protocol,start_ms,end_ms,bytes,packets,path_id,"
+               "path_hops,elephant_periodically,elephant_immediately\n";
+    }
+
+    for (const FlowRecord& r : batch)
+    {
+        text += fmt::format("{},{},{},{},{},{},{},{},{},{:016x},{},{},{}\n",
+                            utils::ipToString(r.key.srcIP),
+                            utils::ipToString(r.key.dstIP),
+                            r.key.srcPort,
+                            r.key.dstPort,
+                            unsigned{r.key.protocol},
+                            r.startMs,
+                            r.endMs,
+                            r.bytes,
+                            r.packets,
+                            r.pathId,
+                            r.pathHops,
+                            int{r.elephantPeriodically},
+                            int{r.elephantImmediately});
+    }
+
+    std::string compressed;
+    if (!gzipMember(text, compressed))
+    {
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+        SPDLOG_LOGGER_ERROR(
+            Logger::instance(), "Flow export: {} records not compressed", batch.size());
+        return;
+    }
+    if (!utils::HistoryWriter::instance().submit(m_segment, std::move(compressed)))
+    {
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool
+FlowRecordExporter::openIpfixSocket()
+{
+    const std::string& target = m_config.ipfixCollector;
+    const size_t colon = target.rfind(':');
+    if (colon == std::string::npos)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Flow export: bad IPFIX collector '{}'", target);
+        return false;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    const std::string host = target.substr(0, colon);
+    const std::string port = target.substr(colon + 1);
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Flow export: cannot resolve '{}'", target);
+        return false;
+    }
+    for (addrinfo* ai = result; ai && m_ipfixFd < 0; ai = ai->ai_next)
+    {
+        m_ipfixFd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (m_ipfixFd >= 0 && ::connect(m_ipfixFd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            ::close(m_ipfixFd);
+            m_ipfixFd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (m_ipfixFd < 0)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Flow export: cannot reach '{}'", target);
+        return false;
+    }
+    m_templateDue = true;
+    return true;
+}
+
+void
+FlowRecordExporter::sendIpfix(const std::vector<FlowRecord>& batch)
+{
+    if (m_ipfixFd < 0 && !openIpfixSocket())
+    {
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    constexpr size_t recordSize = ipfixRecordSize();
+    std::string message;
+    size_t next = 0;
+    while (next < batch.size())
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const uint32_t exportTime = static_cast<uint32_t>(std::time(nullptr));
+        message.clear();
+        putBig(message, IPFIX_VERSION, 2);
+        putBig(message, 0, 2); // length, patched below
+        putBig(message, exportTime, 4);
+        putBig(message, m_ipfixSequence, 4);
+        putBig(message, 0, 4); // observation domain
+
+        // Over UDP the collector may have missed or forgotten it: send it again periodically
+        if (m_templateDue ||
+            now - m_templateSent >= std::chrono::seconds(FLOW_EXPORT_IPFIX_TEMPLATE_S))
+        {
+            const size_t setStart = message.size();
+            putBig(message, IPFIX_TEMPLATE_SET_ID, 2);
+            putBig(message, 0, 2);
+            putBig(message, IPFIX_TEMPLATE_ID, 2);
+            putBig(message, std::size(IPFIX_FIELDS), 2);
+            for (const IpfixField& field : IPFIX_FIELDS)
+            {
+                putBig(message, field.enterprise ? field.id | 0x8000 : field.id, 2);
+                putBig(message, field.length, 2);
+                if (field.enterprise)
+                {
+                    putBig(message, FLOW_EXPORT_IPFIX_PEN, 4);
+                }
+            }
+            patchLength(message, setStart + 2, message.size() - setStart);
+            m_templateDue = false;
+            m_templateSent = now;
+        }
+
+        const size_t room =
+            (FLOW_EXPORT_IPFIX_MTU - message.size() - IPFIX_SET_HEADER_SIZE) / recordSize;
+        const size_t count = std::min(room, batch.size() - next);
+        const size_t setStart = message.size();
+        putBig(message, IPFIX_TEMPLATE_ID, 2);
+        putBig(message, 0, 2);
+        for (size_t i = next; i < next + count; ++i)
+        {
+            const FlowRecord& r = batch[i];
+            // Addresses are kept in network order already
+            message.append(reinterpret_cast<const char*>(&r.key.srcIP), 4);
+            message.append(reinterpret_cast<const char*>(&r.key.dstIP), 4);
+            putBig(message, r.key.srcPort, 2);
+            putBig(message, r.key.dstPort, 2);
+            putBig(message, r.key.protocol, 1);
+            putBig(message, static_cast<uint64_t>(r.startMs), 8);
+            putBig(message, static_cast<uint64_t>(r.endMs), 8);
+            putBig(message, r.bytes, 8);
+            putBig(message, r.packets, 8);
+            putBig(message, r.pathId, 8);
+            putBig(message, r.pathHops, 2);
+            putBig(message, (r.elephantPeriodically ? 1 : 0) | (r.elephantImmediately ? 2 : 0), 1);
+        }
+        patchLength(message, setStart + 2, message.size() - setStart);
+        patchLength(message, 2, message.size());
+        next += count;
+
+        if (::send(m_ipfixFd, message.data(), message.size(), 0) !=
+            static_cast<ssize_t>(message.size()))
+        {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+            SPDLOG_LOGGER_WARN(
+                Logger::instance(), "Flow export: IPFIX send failed: {}", strerror(errno));
+            // Resolve and reconnect on the next batch
+            ::close(m_ipfixFd);
+            m_ipfixFd = -1;
+            return;
+        }
+        m_ipfixSequence += static_cast<uint32_t>(count);
+        m_ipfixMessages.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+nlohmann::json
+FlowRecordExporter::statsJson() const
+{
+    return {{"queued", m_queue.size()},
+            {"offered", m_offered.load(std::memory_order_relaxed)},
+            {"dropped", m_dropped.load(std::memory_order_relaxed)},
+            {"written", m_written.load(std::memory_order_relaxed)},
+            {"segments", m_segments.load(std::memory_order_relaxed)},
+            {"ipfix_messages", m_ipfixMessages.load(std::memory_order_relaxed)},
+            {"errors", m_errors.load(std::memory_order_relaxed)}};
+}
+
+} // namespace sflow
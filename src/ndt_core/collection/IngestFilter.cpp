@@ -0,0 +1,85 @@
+#include "ndt_core/collection/IngestFilter.hpp"
+#include <arpa/inet.h>
+
+namespace sflow
+{
+
+namespace
+{
+
+// A UDP socket filter sees the datagram from its UDP header
+constexpr uint32_t PAYLOAD = 8;
+// sFlow v5 header words, in bytes from the start of the payload
+constexpr uint32_t VERSION = 0;
+constexpr uint32_t ADDRESS_TYPE = 4;
+constexpr uint32_t AGENT = 8;
+constexpr uint32_t SAMPLE_COUNT = 24;
+constexpr uint32_t FIRST_SAMPLE = 28;
+
+constexpr uint32_t ACCEPT_ALL = 0xffffffff; // bytes of the datagram to keep
+
+} // namespace
+
+std::vector<sock_filter>
+compileIngestFilter(const IngestFilterSpec& spec)
+{
+    std::vector<sock_filter> program;
+    auto stmt = [&program](uint16_t code, uint32_t k) {
+        program.push_back(sock_filter{code, 0, 0, k});
+    };
+    auto jeq = [&program](uint32_t k, uint8_t jt, uint8_t jf) {
+        program.push_back(sock_filter{BPF_JMP | BPF_JEQ | BPF_K, jt, jf, k});
+    };
+    auto drop = [&stmt] { stmt(BPF_RET | BPF_K, 0); };
+    auto accept = [&stmt] { stmt(BPF_RET | BPF_K, ACCEPT_ALL); };
+
+    // Loads take network order words and yield them in host order
+    stmt(BPF_LD | BPF_W | BPF_ABS, PAYLOAD + VERSION);
+    jeq(5, 1, 0);
+    drop();
+    stmt(BPF_LD | BPF_W | BPF_ABS, PAYLOAD + ADDRESS_TYPE);
+    jeq(1, 1, 0);
+    drop();
+
+    if (!spec.agents.empty() && spec.agents.size() <= INGEST_FILTER_MAX_AGENTS)
+    {
+        // A match jumps over the rest of the list and the drop that ends it
+        stmt(BPF_LD | BPF_W | BPF_ABS, PAYLOAD + AGENT);
+        const uint32_t count = static_cast<uint32_t>(spec.agents.size());
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            jeq(ntohl(spec.agents[i]), 0, 1);
+            stmt(BPF_JMP | BPF_JA, 2 * (count - i) - 1);
+        }
+        drop();
+    }
+
+    if (spec.dropCounterOnly)
+    {
+        // M[0] = samples left, X = offset of the next one
+        stmt(BPF_LD | BPF_W | BPF_ABS, PAYLOAD + SAMPLE_COUNT);
+        stmt(BPF_ST, 0);
+        stmt(BPF_LDX | BPF_W | BPF_IMM, PAYLOAD + FIRST_SAMPLE);
+        for (int i = 0; i < INGEST_FILTER_SAMPLE_SCAN; ++i)
+        {
+            stmt(BPF_LD | BPF_MEM, 0);
+            jeq(0, 0, 1);
+            drop();
+            stmt(BPF_ALU | BPF_SUB | BPF_K, 1);
+            stmt(BPF_ST, 0);
+            stmt(BPF_LD | BPF_W | BPF_IND, 0); // sample type, as SampleView::isFlowSample()
+            jeq(1, 0, 1);
+            accept();
+            jeq(3, 0, 1);
+            accept();
+            stmt(BPF_LD | BPF_W | BPF_IND, 4); // sample length
+            stmt(BPF_ALU | BPF_ADD | BPF_K, 8);
+            stmt(BPF_ALU | BPF_ADD | BPF_X, 0);
+            stmt(BPF_MISC | BPF_TAX, 0);
+        }
+    }
+    accept();
+    return program;
+}
+
+} // namespace sflow
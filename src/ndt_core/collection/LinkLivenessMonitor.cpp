@@ -0,0 +1,142 @@
+#include "ndt_core/collection/LinkLivenessMonitor.hpp"
+#include "ndt_core/collection/SFlowDecoder.hpp"
+#include <algorithm>
+
+namespace sflow
+{
+
+void
+LinkLivenessMonitor::observe(uint32_t agentIp,
+                             uint32_t ifIndex,
+                             uint32_t status,
+                             size_t flows,
+                             int64_t nowMs,
+                             std::vector<Transition>& out)
+{
+    std::lock_guard lock(m_mutex);
+    int64_t& agentLastMs = m_agentLastMs[agentIp];
+    agentLastMs = std::max(agentLastMs, nowMs);
+
+    Port& port = m_ports[portKey(agentIp, ifIndex)];
+    const int64_t silentMs = port.lastMs != 0 ? nowMs - port.lastMs : 0;
+    // The gap of a port whose samples stopped is the outage, not its cadence
+    const bool stopped = port.down && port.cause == LinkFailureCause::CountersStopped;
+    if (port.lastMs != 0 && silentMs >= LINK_LIVENESS_MIN_INTERVAL_MS && !stopped)
+    {
+        const double interval = static_cast<double>(silentMs);
+        port.intervalMs = port.reports < 2 ? interval : port.intervalMs * 0.75 + interval * 0.25;
+        port.reports = std::min<uint32_t>(port.reports + 1, LINK_LIVENESS_MIN_REPORTS);
+    }
+    else if (port.lastMs == 0)
+    {
+        port.reports = 1;
+    }
+    port.lastMs = std::max(port.lastMs, nowMs);
+
+    const bool adminUp = status & IF_STATUS_ADMIN_UP;
+    const bool operUp = status & IF_STATUS_OPER_UP;
+    if (!adminUp || !operUp)
+    {
+        const LinkFailureCause cause =
+            adminUp ? LinkFailureCause::OperDown : LinkFailureCause::AdminDown;
+        if (!port.down || port.cause != cause)
+        {
+            port.down = true;
+            port.cause = cause;
+            port.confidence = 1.0;
+            countDetection(cause);
+            out.push_back({agentIp, ifIndex, true, cause, 1.0, silentMs});
+        }
+        return;
+    }
+    if (port.down)
+    {
+        port.down = false;
+        ++m_recoveries;
+        out.push_back({agentIp, ifIndex, false, port.cause, 1.0, silentMs});
+    }
+    port.flows = flows;
+}
+
+void
+LinkLivenessMonitor::sweep(int64_t nowMs,
+                           const std::function<size_t(uint32_t, uint32_t)>& flowsOn,
+                           std::vector<Transition>& out)
+{
+    std::lock_guard lock(m_mutex);
+    for (auto& [key, port] : m_ports)
+    {
+        if (port.reports < LINK_LIVENESS_MIN_REPORTS ||
+            (port.down && port.cause != LinkFailureCause::CountersStopped))
+        {
+            continue;
+        }
+        const int64_t silentMs = nowMs - port.lastMs;
+        if (silentMs <= port.intervalMs * (1 + LINK_LIVENESS_GRACE) + LINK_LIVENESS_JITTER_MS)
+        {
+            continue;
+        }
+
+        const uint32_t agentIp = static_cast<uint32_t>(key >> 32);
+        const uint32_t ifIndex = static_cast<uint32_t>(key);
+        double confidence = 0.5;
+        const int64_t dueMs = port.lastMs + static_cast<int64_t>(port.intervalMs);
+        confidence += m_agentLastMs[agentIp] > dueMs ? 0.3 : -0.3;
+        if (port.flows >= LINK_LIVENESS_DRAIN_MIN_FLOWS &&
+            flowsOn(agentIp, ifIndex) * 4 <= port.flows)
+        {
+            confidence += 0.2;
+        }
+        confidence = std::min(confidence, 1.0);
+        if (confidence < LINK_LIVENESS_MIN_CONFIDENCE ||
+            (port.down && confidence <= port.confidence))
+        {
+            continue;
+        }
+        if (!port.down)
+        {
+            countDetection(LinkFailureCause::CountersStopped);
+        }
+        port.down = true;
+        port.cause = LinkFailureCause::CountersStopped;
+        port.confidence = confidence;
+        out.push_back({agentIp, ifIndex, true, port.cause, confidence, silentMs});
+    }
+}
+
+void
+LinkLivenessMonitor::countDetection(LinkFailureCause cause)
+{
+    switch (cause)
+    {
+    case LinkFailureCause::OperDown:
+        ++m_operDown;
+        break;
+    case LinkFailureCause::AdminDown:
+        ++m_adminDown;
+        break;
+    case LinkFailureCause::CountersStopped:
+        ++m_countersStopped;
+        break;
+    case LinkFailureCause::Controller:
+        break;
+    }
+}
+
+nlohmann::json
+LinkLivenessMonitor::statsJson() const
+{
+    std::lock_guard lock(m_mutex);
+    const size_t down = std::count_if(
+        m_ports.begin(), m_ports.end(), [](const auto& entry) { return entry.second.down; });
+    return nlohmann::json{{"ports", m_ports.size()},
+                          {"down", down},
+                          {"detections",
+                           {{linkFailureCauseName(LinkFailureCause::OperDown), m_operDown},
+                            {linkFailureCauseName(LinkFailureCause::AdminDown), m_adminDown},
+                            {linkFailureCauseName(LinkFailureCause::CountersStopped),
+                             m_countersStopped}}},
+                          {"recoveries", m_recoveries}};
+}
+
+} // namespace sflow
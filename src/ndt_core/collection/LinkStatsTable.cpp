@@ -0,0 +1,259 @@
+#include "ndt_core/collection/LinkStatsTable.hpp"
+#include <algorithm>
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <cmath>
+#include <thread>
+
+void
+LinkStatsTable::reset(const Graph& graph)
+{
+    size_t size = 0;
+    for (auto e : boost::make_iterator_range(boost::edges(graph)))
+    {
+        size = std::max<size_t>(size, graph[e].statsId + 1);
+    }
+
+    m_slots = std::make_unique<Slot[]>(size);
+    m_size = size;
+    m_vertexCount = boost::num_vertices(graph);
+    m_loads = std::make_unique<VertexLoad[]>(m_vertexCount);
+    m_fabricLinks.store(0, std::memory_order_relaxed);
+    m_fabricSumPpb.store(0, std::memory_order_relaxed);
+    for (auto& bucket : m_fabricHistogram)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    for (auto e : boost::make_iterator_range(boost::edges(graph)))
+    {
+        const auto& ep = graph[e];
+        Slot& slot = m_slots[ep.statsId];
+        slot.source = static_cast<uint32_t>(boost::source(e, graph));
+        slot.target = static_cast<uint32_t>(boost::target(e, graph));
+        slot.fabric = graph[slot.source].vertexType == VertexType::SWITCH &&
+                      graph[slot.target].vertexType == VertexType::SWITCH;
+        slot.up = ep.isUp;
+        m_loads[slot.target].ingress.fetch_add(ep.linkBandwidthUsage, std::memory_order_relaxed);
+        m_loads[slot.source].egress.fetch_add(ep.linkBandwidthUsage, std::memory_order_relaxed);
+        storeFields(slot,
+                    LinkStats{.leftBandwidth = ep.leftBandwidth,
+                              .linkBandwidth = ep.linkBandwidth,
+                              .linkBandwidthUsage = ep.linkBandwidthUsage,
+                              .linkBandwidthUtilization = ep.linkBandwidthUtilization,
+                              .leftBandwidthFromFlowSample = ep.leftBandwidthFromFlowSample});
+        if (slot.fabric && slot.up)
+        {
+            moveFabricShare({}, fabricShare(loadFields(slot)));
+        }
+    }
+    // Every edge counts as changed for readers that saw the previous table
+    const uint64_t stamp = m_epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        m_slots[i].modifiedAt.store(stamp, std::memory_order_relaxed);
+    }
+}
+
+LinkStats
+LinkStatsTable::read(EdgeId id) const
+{
+    if (id >= m_size)
+    {
+        return {};
+    }
+
+    const Slot& slot = m_slots[id];
+    while (true)
+    {
+        uint32_t before = slot.seq.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        LinkStats stats = loadFields(slot);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == before)
+        {
+            return stats;
+        }
+    }
+}
+
+uint64_t
+LinkStatsTable::ingressLoad(size_t vertex) const
+{
+    return vertex < m_vertexCount ? m_loads[vertex].ingress.load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t
+LinkStatsTable::egressLoad(size_t vertex) const
+{
+    return vertex < m_vertexCount ? m_loads[vertex].egress.load(std::memory_order_relaxed) : 0;
+}
+
+void
+LinkStatsTable::setUp(EdgeId id, bool up)
+{
+    if (id >= m_size || m_slots[id].up == up)
+    {
+        return;
+    }
+    Slot& slot = m_slots[id];
+    if (slot.fabric)
+    {
+        const FabricShare share = fabricShare(loadFields(slot));
+        moveFabricShare(up ? FabricShare{} : share, up ? share : FabricShare{});
+    }
+    slot.up = up;
+}
+
+size_t
+LinkStatsTable::fabricLinks() const
+{
+    return m_fabricLinks.load(std::memory_order_relaxed);
+}
+
+double
+LinkStatsTable::fabricAverageUsage() const
+{
+    const uint64_t links = m_fabricLinks.load(std::memory_order_relaxed);
+    if (links == 0)
+    {
+        return 0;
+    }
+    return static_cast<double>(m_fabricSumPpb.load(std::memory_order_relaxed)) / 1e9 /
+           static_cast<double>(links);
+}
+
+double
+LinkStatsTable::fabricUsagePercentile(double q) const
+{
+    std::array<uint64_t, FABRIC_USAGE_BUCKETS> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < FABRIC_USAGE_BUCKETS; ++i)
+    {
+        counts[i] = m_fabricHistogram[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    const auto rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < FABRIC_USAGE_BUCKETS; ++i)
+    {
+        seen += counts[i];
+        if (seen >= std::max<uint64_t>(rank, 1))
+        {
+            // Upper end of the bucket; the last one holds everything from 100% up
+            return static_cast<double>(std::min<size_t>(i + 1, FABRIC_USAGE_BUCKETS - 1)) / 100;
+        }
+    }
+    return 1;
+}
+
+void
+LinkStatsTable::modifiedAt(std::vector<uint64_t>& out) const
+{
+    out.resize(m_size);
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        out[i] = m_slots[i].modifiedAt.load(std::memory_order_relaxed);
+    }
+}
+
+void
+LinkStatsTable::materialize(Graph& graph) const
+{
+    for (auto e : boost::make_iterator_range(boost::edges(graph)))
+    {
+        auto& ep = graph[e];
+        LinkStats stats = read(ep.statsId);
+        ep.leftBandwidth = stats.leftBandwidth;
+        ep.linkBandwidth = stats.linkBandwidth;
+        ep.linkBandwidthUsage = stats.linkBandwidthUsage;
+        ep.linkBandwidthUtilization = stats.linkBandwidthUtilization;
+        ep.leftBandwidthFromFlowSample = stats.leftBandwidthFromFlowSample;
+    }
+}
+
+uint32_t
+LinkStatsTable::lockSlot(Slot& slot)
+{
+    while (true)
+    {
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+        if (!(seq & 1) &&
+            slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire))
+        {
+            // Readers that observe any field written after this point also see the odd seq
+            std::atomic_thread_fence(std::memory_order_release);
+            return seq;
+        }
+        std::this_thread::yield();
+    }
+}
+
+LinkStats
+LinkStatsTable::loadFields(const Slot& slot)
+{
+    return LinkStats{
+        .leftBandwidth = slot.leftBandwidth.load(std::memory_order_relaxed),
+        .linkBandwidth = slot.linkBandwidth.load(std::memory_order_relaxed),
+        .linkBandwidthUsage = slot.linkBandwidthUsage.load(std::memory_order_relaxed),
+        .linkBandwidthUtilization = slot.linkBandwidthUtilization.load(std::memory_order_relaxed),
+        .leftBandwidthFromFlowSample =
+            slot.leftBandwidthFromFlowSample.load(std::memory_order_relaxed)};
+}
+
+void
+LinkStatsTable::storeFields(Slot& slot, const LinkStats& stats)
+{
+    slot.leftBandwidth.store(stats.leftBandwidth, std::memory_order_relaxed);
+    slot.linkBandwidth.store(stats.linkBandwidth, std::memory_order_relaxed);
+    slot.linkBandwidthUsage.store(stats.linkBandwidthUsage, std::memory_order_relaxed);
+    slot.linkBandwidthUtilization.store(stats.linkBandwidthUtilization, std::memory_order_relaxed);
+    slot.leftBandwidthFromFlowSample.store(stats.leftBandwidthFromFlowSample,
+                                           std::memory_order_relaxed);
+}
+
+LinkStatsTable::FabricShare
+LinkStatsTable::fabricShare(const LinkStats& stats)
+{
+    if (stats.linkBandwidthUsage == 0 || stats.linkBandwidth == 0)
+    {
+        return {};
+    }
+    return {true,
+            static_cast<uint64_t>(std::llround(static_cast<double>(stats.linkBandwidthUsage) /
+                                               static_cast<double>(stats.linkBandwidth) * 1e9))};
+}
+
+void
+LinkStatsTable::moveFabricShare(const FabricShare& from, const FabricShare& to)
+{
+    if (from == to)
+    {
+        return;
+    }
+    // 1e7 ppb is 1%
+    auto bucketOf = [](uint64_t ppb) {
+        return std::min<size_t>(ppb / 10'000'000, FABRIC_USAGE_BUCKETS - 1);
+    };
+    // Unsigned wrap-around turns the difference into a decrement, as for the vertex loads
+    m_fabricSumPpb.fetch_add(to.ppb - from.ppb, std::memory_order_relaxed);
+    if (from.counted)
+    {
+        m_fabricHistogram[bucketOf(from.ppb)].fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (to.counted)
+    {
+        m_fabricHistogram[bucketOf(to.ppb)].fetch_add(1, std::memory_order_relaxed);
+    }
+    m_fabricLinks.fetch_add(static_cast<uint64_t>(to.counted) -
+                                static_cast<uint64_t>(from.counted),
+                            std::memory_order_relaxed);
+}
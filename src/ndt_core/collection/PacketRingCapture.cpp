@@ -0,0 +1,238 @@
+#include "ndt_core/collection/PacketRingCapture.hpp"
+#include "utils/Logger.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sflow
+{
+
+namespace
+{
+
+constexpr size_t ETH_HEADER = 14;
+constexpr size_t UDP_HEADER = 8;
+
+uint16_t
+readU16(const unsigned char* p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+// tcpdump's "udp dst port <port>" restricted to IPv4: unfragmented (or first fragment) UDP
+// datagrams to the port. VLAN tags are out of the frame by now (the kernel moves them into
+// the packet's metadata before filters run).
+std::vector<sock_filter>
+udpPortFilter(uint16_t port)
+{
+    return {
+        {BPF_LD | BPF_H | BPF_ABS, 0, 0, 12},             // ethertype
+        {BPF_JMP | BPF_JEQ | BPF_K, 0, 8, ETH_P_IP},      // else drop
+        {BPF_LD | BPF_B | BPF_ABS, 0, 0, 23},             // IPv4 protocol
+        {BPF_JMP | BPF_JEQ | BPF_K, 0, 6, IPPROTO_UDP},   // else drop
+        {BPF_LD | BPF_H | BPF_ABS, 0, 0, 20},             // flags and fragment offset
+        {BPF_JMP | BPF_JSET | BPF_K, 4, 0, 0x1fff},       // a later fragment: drop
+        {BPF_LDX | BPF_B | BPF_MSH, 0, 0, ETH_HEADER},    // X = IPv4 header length
+        {BPF_LD | BPF_H | BPF_IND, 0, 0, ETH_HEADER + 2}, // UDP destination port
+        {BPF_JMP | BPF_JEQ | BPF_K, 0, 1, port},          // else drop
+        {BPF_RET | BPF_K, 0, 0, 0x40000},                 // accept the whole frame
+        {BPF_RET | BPF_K, 0, 0, 0},                       // drop
+    };
+}
+
+void
+throwErrno(int fd, const std::string& what)
+{
+    const int error = errno;
+    SPDLOG_LOGGER_ERROR(Logger::instance(), "{} failed: {}", what, strerror(error));
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+    throw std::runtime_error("Failed to set up the packet ring: " + what);
+}
+
+} // namespace
+
+PacketRingCapture::PacketRingCapture(const std::string& interface, uint16_t port, int fanoutGroup)
+{
+    const unsigned ifindex = if_nametoindex(interface.c_str());
+    if (ifindex == 0)
+    {
+        throwErrno(-1, "interface " + interface);
+    }
+
+    // Bound to no protocol until the filter is attached, so nothing unfiltered queues up
+    m_fd = ::socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (m_fd < 0)
+    {
+        throwErrno(-1, "socket(AF_PACKET)");
+    }
+
+    std::vector<sock_filter> code = udpPortFilter(port);
+    sock_fprog program{static_cast<unsigned short>(code.size()), code.data()};
+    if (setsockopt(m_fd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) < 0)
+    {
+        throwErrno(m_fd, "SO_ATTACH_FILTER");
+    }
+
+    int version = TPACKET_V3;
+    if (setsockopt(m_fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+    {
+        throwErrno(m_fd, "PACKET_VERSION");
+    }
+
+    tpacket_req3 request{};
+    request.tp_block_size = PACKET_RING_BLOCK_SIZE;
+    request.tp_block_nr = PACKET_RING_BLOCK_COUNT;
+    request.tp_frame_size = PACKET_RING_FRAME_SIZE;
+    request.tp_frame_nr = PACKET_RING_BLOCK_SIZE / PACKET_RING_FRAME_SIZE * PACKET_RING_BLOCK_COUNT;
+    request.tp_retire_blk_tov = PACKET_RING_BLOCK_TIMEOUT_MS;
+    if (setsockopt(m_fd, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) < 0)
+    {
+        throwErrno(m_fd, "PACKET_RX_RING");
+    }
+
+    m_ringSize = size_t(PACKET_RING_BLOCK_SIZE) * PACKET_RING_BLOCK_COUNT;
+    void* ring = ::mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (ring == MAP_FAILED)
+    {
+        throwErrno(m_fd, "mmap of the packet ring");
+    }
+    m_ring = static_cast<char*>(ring);
+
+    sockaddr_ll address{};
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = htons(ETH_P_IP);
+    address.sll_ifindex = static_cast<int>(ifindex);
+    if (::bind(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        ::munmap(m_ring, m_ringSize);
+        throwErrno(m_fd, "bind to " + interface);
+    }
+
+    if (fanoutGroup >= 0)
+    {
+        int fanout = (fanoutGroup & 0xffff) | (PACKET_FANOUT_HASH << 16);
+        if (setsockopt(m_fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0)
+        {
+            ::munmap(m_ring, m_ringSize);
+            throwErrno(m_fd, "PACKET_FANOUT");
+        }
+    }
+}
+
+PacketRingCapture::~PacketRingCapture()
+{
+    if (m_ring != nullptr)
+    {
+        ::munmap(m_ring, m_ringSize);
+    }
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+tpacket_block_desc*
+PacketRingCapture::block(size_t index) const
+{
+    return reinterpret_cast<tpacket_block_desc*>(m_ring + index * PACKET_RING_BLOCK_SIZE);
+}
+
+void
+PacketRingCapture::releaseBlocks()
+{
+    // The kernel may refill a block as soon as it sees TP_STATUS_KERNEL: every read of it
+    // must be done before
+    std::atomic_thread_fence(std::memory_order_release);
+    for (; m_heldBlocks > 0; --m_heldBlocks)
+    {
+        const size_t index =
+            (m_nextBlock + PACKET_RING_BLOCK_COUNT - m_heldBlocks) % PACKET_RING_BLOCK_COUNT;
+        block(index)->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    }
+}
+
+bool
+PacketRingCapture::poll(int timeoutMs, std::vector<Datagram>& out)
+{
+    out.clear();
+    releaseBlocks();
+
+    auto ready = [this] {
+        const bool user = block(m_nextBlock)->hdr.bh1.block_status & TP_STATUS_USER;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return user;
+    };
+    if (!ready())
+    {
+        pollfd pfd{m_fd, POLLIN | POLLERR, 0};
+        if (::poll(&pfd, 1, timeoutMs) < 0 && errno != EINTR)
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "poll() failed: {}", strerror(errno));
+            return false;
+        }
+    }
+
+    while (m_heldBlocks < PACKET_RING_BLOCK_COUNT && ready())
+    {
+        const tpacket_block_desc* desc = block(m_nextBlock);
+        const char* frame =
+            reinterpret_cast<const char*>(desc) + desc->hdr.bh1.offset_to_first_pkt;
+        for (uint32_t i = 0; i < desc->hdr.bh1.num_pkts; ++i)
+        {
+            const auto* header = reinterpret_cast<const tpacket3_hdr*>(frame);
+            const auto* bytes = reinterpret_cast<const unsigned char*>(frame + header->tp_mac);
+            const size_t length = header->tp_snaplen;
+            frame += header->tp_next_offset;
+
+            // The filter checked ethertype, protocol, fragment and port; what is left is
+            // whether the headers and the datagram fit in the frame
+            const size_t ipHeader = length > ETH_HEADER ? (bytes[ETH_HEADER] & 0x0f) * 4u : 0;
+            if (ipHeader < 20 || length < ETH_HEADER + ipHeader + UDP_HEADER)
+            {
+                ++m_malformed;
+                continue;
+            }
+            const unsigned char* udp = bytes + ETH_HEADER + ipHeader;
+            const size_t udpLength = readU16(udp + 4);
+            if (udpLength < UDP_HEADER || udp + udpLength > bytes + length)
+            {
+                ++m_malformed;
+                continue;
+            }
+            out.push_back(Datagram{reinterpret_cast<const char*>(udp + UDP_HEADER),
+                                   udpLength - UDP_HEADER,
+                                   int64_t(header->tp_sec) * 1000 + header->tp_nsec / 1000000});
+        }
+        m_nextBlock = (m_nextBlock + 1) % PACKET_RING_BLOCK_COUNT;
+        ++m_heldBlocks;
+    }
+    return true;
+}
+
+uint64_t
+PacketRingCapture::kernelDrops()
+{
+    // Reading the statistics resets them
+    tpacket_stats_v3 stats{};
+    socklen_t length = sizeof(stats);
+    if (getsockopt(m_fd, SOL_PACKET, PACKET_STATISTICS, &stats, &length) == 0)
+    {
+        m_drops += stats.tp_drops;
+    }
+    return m_drops;
+}
+
+} // namespace sflow
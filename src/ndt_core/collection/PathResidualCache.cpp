@@ -0,0 +1,105 @@
+#include "ndt_core/collection/PathResidualCache.hpp"
+#include "utils/MemoryAccounting.hpp"
+#include <mutex>
+
+void
+PathResidualCache::reset(size_t edges)
+{
+    m_marks = std::make_unique<EdgeMark[]>(edges);
+    m_size = edges;
+    std::unique_lock lock(m_mutex);
+    m_entries.clear();
+}
+
+void
+PathResidualCache::update(EdgeId id, uint64_t leftBandwidth, uint64_t linkBandwidth)
+{
+    if (id >= m_size)
+    {
+        return;
+    }
+    EdgeMark& mark = m_marks[id];
+    const uint64_t moved = leftBandwidth > mark.leftBandwidth ? leftBandwidth - mark.leftBandwidth
+                                                              : mark.leftBandwidth - leftBandwidth;
+    if (moved * 100 > linkBandwidth * PATH_RESIDUAL_CHANGE_PERCENT || linkBandwidth == 0)
+    {
+        mark.leftBandwidth = leftBandwidth;
+        mark.generation.fetch_add(1, std::memory_order_release);
+    }
+}
+
+uint64_t
+PathResidualCache::generation(EdgeId id) const
+{
+    return id < m_size ? m_marks[id].generation.load(std::memory_order_acquire) : 0;
+}
+
+std::optional<uint64_t>
+PathResidualCache::find(uint64_t graphVersion, const sflow::PathHandle& path) const
+{
+    std::shared_lock lock(m_mutex);
+    auto it = m_entries.find(path.id());
+    if (graphVersion != m_version || it == m_entries.end())
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    for (const auto& [edge, generation] : it->second.edges)
+    {
+        if (this->generation(edge) != generation)
+        {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            m_stale.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+    }
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second.residual;
+}
+
+void
+PathResidualCache::insert(uint64_t graphVersion,
+                          const sflow::PathHandle& path,
+                          uint64_t residual,
+                          std::vector<std::pair<EdgeId, uint64_t>> edges)
+{
+    std::unique_lock lock(m_mutex);
+    if (graphVersion > m_version)
+    {
+        m_entries.clear();
+        m_version = graphVersion;
+    }
+    // Computed against an older graph than the cache already holds: don't keep it
+    if (graphVersion != m_version)
+    {
+        return;
+    }
+    if (m_entries.size() >= PATH_RESIDUAL_CACHE_MAX_PATHS && !m_entries.count(path.id()))
+    {
+        m_entries.clear();
+    }
+    m_entries.insert_or_assign(path.id(), Entry{path, residual, std::move(edges)});
+}
+
+nlohmann::json
+PathResidualCache::statsJson() const
+{
+    std::shared_lock lock(m_mutex);
+    return nlohmann::json{{"paths", m_entries.size()},
+                          {"version", m_version},
+                          {"hits", m_hits.load(std::memory_order_relaxed)},
+                          {"misses", m_misses.load(std::memory_order_relaxed)},
+                          {"stale", m_stale.load(std::memory_order_relaxed)}};
+}
+
+size_t
+PathResidualCache::memoryBytes() const
+{
+    std::shared_lock lock(m_mutex);
+    size_t bytes = m_size * sizeof(EdgeMark) + utils::heapBytes(m_entries);
+    for (const auto& [path, entry] : m_entries)
+    {
+        bytes += utils::heapBytes(entry.edges);
+    }
+    return bytes;
+}
@@ -0,0 +1,275 @@
+#include "ndt_core/collection/RoutingEngine.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <openssl/sha.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+namespace
+{
+
+constexpr uint32_t kHostMask = 0xFFFFFFFFu; // /32
+constexpr uint32_t kPriority = 100;
+
+// Same text as utils::ipToString() (network byte order), without inet_ntoa's shared buffer
+size_t
+formatIp(uint32_t ip, char* out)
+{
+    unsigned char octets[4];
+    std::memcpy(octets, &ip, sizeof(octets));
+    char* p = out;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i > 0)
+        {
+            *p++ = '.';
+        }
+        p = std::to_chars(p, p + 3, octets[i]).ptr;
+    }
+    return static_cast<size_t>(p - out);
+}
+
+} // namespace
+
+RoutingEngine::RoutingEngine(const Graph& graph, const std::vector<Host>& hosts)
+    : m_csr(CsrGraph::build(graph)),
+      m_hosts(hosts)
+{
+}
+
+std::vector<sflow::Path>
+RoutingEngine::computeToDestination(uint32_t dstIp,
+                                    Vertex dstHost,
+                                    Vertex dstSwitch,
+                                    OpenflowTables& tables)
+{
+    Routes routes;
+    route(dstIp, dstHost, dstSwitch, m_scratch, routes);
+    RuleSets known;
+    merge(routes, tables, known);
+    return std::move(routes.paths);
+}
+
+std::vector<sflow::Path>
+RoutingEngine::computeAll(OpenflowTables& tables, size_t workers)
+{
+    if (workers == 0)
+    {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers = std::min({workers, static_cast<size_t>(ROUTING_MAX_WORKERS), m_hosts.size()});
+
+    // Destinations are claimed one at a time, so a slow one does not hold up a whole share
+    std::vector<Routes> routes(m_hosts.size());
+    std::atomic<size_t> next{0};
+    auto work = [&](Scratch& scratch) {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < m_hosts.size();)
+        {
+            const Host& dst = m_hosts[i];
+            route(dst.ip, dst.vertex, dst.attachedSwitch, scratch, routes[i]);
+        }
+    };
+
+    std::vector<Scratch> scratches(workers > 1 ? workers - 1 : 0);
+    std::vector<std::thread> threads;
+    threads.reserve(scratches.size());
+    for (auto& scratch : scratches)
+    {
+        threads.emplace_back(work, std::ref(scratch));
+    }
+    work(m_scratch);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    RuleSets known;
+    std::vector<sflow::Path> paths;
+    for (auto& destination : routes)
+    {
+        merge(destination, tables, known);
+        paths.insert(paths.end(),
+                     std::make_move_iterator(destination.paths.begin()),
+                     std::make_move_iterator(destination.paths.end()));
+    }
+    return paths;
+}
+
+uint64_t
+RoutingEngine::tieBreakRank(const char* dstIpText, size_t dstIpLength, uint64_t dpid)
+{
+    char text[48];
+    std::memcpy(text, dstIpText, dstIpLength);
+    char* end = std::to_chars(text + dstIpLength, text + sizeof(text), dpid).ptr;
+
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(text), static_cast<size_t>(end - text), hash);
+
+    uint64_t result = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        result = (result << 8) | hash[i];
+    }
+    return result;
+}
+
+void
+RoutingEngine::route(uint32_t dstIp,
+                     Vertex dstHost,
+                     Vertex dstSwitch,
+                     Scratch& scratch,
+                     Routes& out) const
+{
+    out.rules.clear();
+    out.paths.clear();
+
+    const size_t vertexCount = m_csr.vertexCount();
+    if (scratch.visited.size() != vertexCount)
+    {
+        scratch.visited.assign(vertexCount, 0);
+        scratch.parent.resize(vertexCount);
+        scratch.outPort.resize(vertexCount);
+        scratch.hasOutPort.resize(vertexCount);
+        scratch.stamp = 0;
+    }
+    if (++scratch.stamp == 0)
+    {
+        std::fill(scratch.visited.begin(), scratch.visited.end(), 0);
+        scratch.stamp = 1;
+    }
+    if (dstSwitch >= vertexCount)
+    {
+        return;
+    }
+
+    const uint32_t stamp = scratch.stamp;
+    const Vertex nullVertex = Graph::null_vertex();
+    const uint32_t net = dstIp & kHostMask;
+    char dstText[16];
+    const size_t dstLength = formatIp(dstIp, dstText);
+
+    scratch.queue.clear();
+    scratch.visited[dstSwitch] = stamp;
+    scratch.parent[dstSwitch] = nullVertex;
+    scratch.hasOutPort[dstSwitch] = false;
+    scratch.queue.push_back(dstSwitch);
+
+    for (size_t head = 0; head < scratch.queue.size(); ++head)
+    {
+        const Vertex current = scratch.queue[head];
+
+        // The switch forwards towards the vertex it was discovered from
+        const uint64_t dpid = m_csr.dpid(current);
+        if (scratch.parent[current] != nullVertex && scratch.hasOutPort[current] && dpid != 0)
+        {
+            out.rules.emplace_back(dpid, Rule{net, kHostMask, scratch.outPort[current], kPriority});
+        }
+
+        scratch.neighbors.clear();
+        for (auto edge = m_csr.outBegin(current); edge != m_csr.outEnd(current); ++edge)
+        {
+            const Vertex neighbor = m_csr.target(edge);
+            if (!m_csr.vertexUsable(neighbor) || !m_csr.edgeUsable(edge))
+            {
+                continue;
+            }
+            if (scratch.visited[neighbor] == stamp)
+            {
+                continue;
+            }
+            scratch.neighbors.emplace_back(
+                tieBreakRank(dstText, dstLength, m_csr.dpid(neighbor)), edge);
+        }
+        std::sort(scratch.neighbors.begin(), scratch.neighbors.end());
+
+        for (const auto& [rank, edge] : scratch.neighbors)
+        {
+            const Vertex neighbor = m_csr.target(edge);
+            const CsrGraph::EdgeId reverse = m_csr.reverse(edge);
+            scratch.visited[neighbor] = stamp;
+            scratch.parent[neighbor] = current;
+            const bool hasReverse = reverse != CsrGraph::NO_EDGE;
+            scratch.hasOutPort[neighbor] = hasReverse;
+            scratch.outPort[neighbor] = hasReverse ? m_csr.srcInterface(reverse) : 0;
+            scratch.queue.push_back(neighbor);
+        }
+    }
+
+    if (dstHost == nullVertex)
+    {
+        return;
+    }
+
+    // Paths from every source whose switch was reached, ending with the host port of the
+    // destination switch (whose rule is only added once some source reaches it)
+    auto hostEdge = m_csr.findEdge(dstSwitch, dstHost);
+    bool hostRuleAdded = false;
+    for (const Host& src : m_hosts)
+    {
+        if (src.ip == dstIp || src.attachedSwitch >= vertexCount ||
+            scratch.visited[src.attachedSwitch] != stamp)
+        {
+            continue;
+        }
+
+        sflow::Path path;
+        path.emplace_back(src.ip, src.switchPort);
+        for (Vertex v = src.attachedSwitch; v != dstSwitch; v = scratch.parent[v])
+        {
+            if (scratch.hasOutPort[v])
+            {
+                path.emplace_back(m_csr.dpid(v), scratch.outPort[v]);
+            }
+        }
+
+        if (hostEdge)
+        {
+            const uint32_t outPortToHost = m_csr.srcInterface(*hostEdge);
+            path.emplace_back(m_csr.dpid(dstSwitch), outPortToHost);
+            if (!hostRuleAdded)
+            {
+                out.rules.emplace_back(m_csr.dpid(dstSwitch),
+                                       Rule{net, kHostMask, outPortToHost, kPriority});
+                hostRuleAdded = true;
+            }
+        }
+
+        path.emplace_back(dstIp, 0);
+        out.paths.push_back(std::move(path));
+    }
+}
+
+void
+RoutingEngine::merge(Routes& routes, OpenflowTables& tables, RuleSets& known)
+{
+    for (const auto& [dpid, rule] : routes.rules)
+    {
+        auto& table = tables[dpid];
+        auto [it, fresh] = known.try_emplace(dpid);
+        if (fresh)
+        {
+            for (const auto& existing : table)
+            {
+                it->second.emplace(
+                    std::get<0>(existing), std::get<1>(existing), std::get<3>(existing));
+            }
+        }
+        // Rule identity is (net, mask, priority); the first output port wins
+        if (!it->second.emplace(std::get<0>(rule), std::get<1>(rule), std::get<3>(rule)).second)
+        {
+            continue;
+        }
+        table.push_back(rule);
+        SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                            "Added OF rule on switch {} for {} /32 -> outPort {} (pri={})",
+                            dpid,
+                            utils::Ipv4{std::get<0>(rule)},
+                            std::get<2>(rule),
+                            std::get<3>(rule));
+    }
+    routes.rules.clear();
+}
@@ -0,0 +1,346 @@
+#include "ndt_core/collection/SFlowDecoder.hpp"
+#include <arpa/inet.h>
+#include <cstring>
+
+namespace sflow
+{
+
+namespace
+{
+
+constexpr size_t WORD = sizeof(uint32_t);
+constexpr size_t DATAGRAM_HEADER_WORDS = 7; // version .. sample count (IPv4 agent)
+constexpr uint32_t ADDRESS_TYPE_IPV4 = 1;
+
+inline uint32_t
+loadWord(const unsigned char* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, WORD);
+    return ntohl(v);
+}
+
+/**
+ * @brief Reads words from a sample and remembers whether any read was out of bounds,
+ *        so decoders can do all reads first and check once.
+ */
+class WordReader
+{
+  public:
+    explicit WordReader(const SampleView& sample)
+        : m_sample(sample)
+    {
+    }
+
+    uint32_t operator()(size_t offset)
+    {
+        uint32_t v = 0;
+        if (!m_sample.word(offset, v))
+        {
+            m_ok = false;
+        }
+        return v;
+    }
+
+    uint64_t word64(size_t offset)
+    {
+        return (static_cast<uint64_t>((*this)(offset)) << 32) | (*this)(offset + 1);
+    }
+
+    bool ok() const
+    {
+        return m_ok;
+    }
+
+  private:
+    const SampleView& m_sample;
+    bool m_ok = true;
+};
+
+// The sampled IPv4 header is not word aligned in the exported records, so each address
+// straddles two words: the low half of one and the high half of the next.
+inline uint32_t
+ipFromFrontBack(uint32_t ipFront, uint32_t ipBack)
+{
+    uint8_t o1 = (ipFront >> 8) & 0xFF;
+    uint8_t o2 = ipFront & 0xFF;
+    uint8_t o3 = (ipBack >> 24) & 0xFF;
+    uint8_t o4 = (ipBack >> 16) & 0xFF;
+
+    uint32_t netOrder =
+        (uint32_t(o1) << 24) | (uint32_t(o2) << 16) | (uint32_t(o3) << 8) | (uint32_t(o4) << 0);
+
+    return ntohl(netOrder);
+}
+
+} // namespace
+
+uint32_t
+SampleView::type() const
+{
+    return m_words > 0 ? loadWord(m_base) : 0;
+}
+
+uint32_t
+SampleView::length() const
+{
+    return m_words > 1 ? loadWord(m_base + WORD) : 0;
+}
+
+bool
+SampleView::word(size_t offset, uint32_t& out) const
+{
+    if (offset >= m_words)
+    {
+        return false;
+    }
+    out = loadWord(m_base + offset * WORD);
+    return true;
+}
+
+SampleIterator::SampleIterator(const unsigned char* cursor,
+                               const unsigned char* end,
+                               uint32_t remaining)
+    : m_cursor(cursor),
+      m_end(end),
+      m_remaining(remaining)
+{
+    load();
+}
+
+void
+SampleIterator::load()
+{
+    if (m_remaining == 0)
+    {
+        return;
+    }
+
+    size_t available = static_cast<size_t>(m_end - m_cursor);
+    if (available < 2 * WORD)
+    {
+        m_remaining = 0;
+        return;
+    }
+
+    // Sample lengths are multiples of 4 per the sFlow v5 XDR encoding
+    size_t words = loadWord(m_cursor + WORD) / WORD + 2;
+    if (words > available / WORD)
+    {
+        m_remaining = 0;
+        return;
+    }
+    m_current = SampleView(m_cursor, words);
+}
+
+SampleIterator&
+SampleIterator::operator++()
+{
+    if (m_remaining == 0)
+    {
+        return *this;
+    }
+    m_cursor += m_current.sizeInWords() * WORD;
+    --m_remaining;
+    load();
+    return *this;
+}
+
+DatagramView::DatagramView(const char* buffer, size_t length)
+    : m_data(reinterpret_cast<const unsigned char*>(buffer)),
+      m_length(length)
+{
+    if (m_data == nullptr || m_length < DATAGRAM_HEADER_WORDS * WORD)
+    {
+        return;
+    }
+
+    m_version = loadWord(m_data);
+    if (m_version != 5 || loadWord(m_data + WORD) != ADDRESS_TYPE_IPV4)
+    {
+        return;
+    }
+
+    std::memcpy(&m_agentIp, m_data + 2 * WORD, WORD); // keep network order
+    m_sampleCount = loadWord(m_data + 6 * WORD);
+    m_valid = true;
+}
+
+SampleIterator
+DatagramView::begin() const
+{
+    if (!m_valid)
+    {
+        return end();
+    }
+    return SampleIterator(m_data + DATAGRAM_HEADER_WORDS * WORD, m_data + m_length, m_sampleCount);
+}
+
+SampleIterator
+DatagramView::end() const
+{
+    return SampleIterator();
+}
+
+template <typename Layout>
+std::optional<CounterSampleRecord>
+decodeCounterSampleAs(const SampleView& sample)
+{
+    if (sample.type() != Layout::TYPE)
+    {
+        return std::nullopt;
+    }
+
+    WordReader w(sample);
+    CounterSampleRecord rec;
+    rec.sampleType = Layout::TYPE;
+    rec.sampleLength = sample.length();
+    rec.interfaceIndex = w(Layout::BASE + 3);
+    rec.interfaceSpeed = w.word64(Layout::BASE + 5);
+    rec.interfaceStatus = w(Layout::BASE + 8);
+    rec.inputOctets = w.word64(Layout::BASE + 9);
+    rec.outputOctets = w.word64(Layout::BASE + 17);
+
+    if (!w.ok())
+    {
+        return std::nullopt;
+    }
+    return rec;
+}
+
+template <typename Layout>
+std::optional<FlowSampleRecord>
+decodeFlowSampleAs(const SampleView& sample)
+{
+    if (sample.type() != Layout::TYPE)
+    {
+        return std::nullopt;
+    }
+
+    constexpr uint8_t TCP_ACK_FLAG = 0x10;
+
+    WordReader w(sample);
+    FlowSampleRecord rec;
+    rec.sampleType = Layout::TYPE;
+
+    size_t shift = 0;
+    if constexpr (Layout::LEADING_RECORD_LENGTH.has_value())
+    {
+        shift = w(*Layout::LEADING_RECORD_LENGTH) / WORD + 2;
+    }
+    rec.samplingRate = w(Layout::SAMPLING_RATE);
+    rec.inputPort = w(Layout::INPUT_PORT);
+    if constexpr (Layout::OUTPUT_PORT.has_value())
+    {
+        rec.outputPort = w(*Layout::OUTPUT_PORT);
+    }
+    rec.frameLength = w(shift + Layout::FRAME_LENGTH);
+    rec.etherType = (w(shift + Layout::ETHER_TYPE) >> 16) & 0xFFFF;
+    // hdr is the word offset of the raw packet header fields used below
+    const size_t hdr = shift + Layout::HEADER;
+
+    if (!w.ok())
+    {
+        return std::nullopt;
+    }
+    if (!rec.isIpv4())
+    {
+        return rec;
+    }
+
+    rec.protocol = w(hdr) & 0xFF;
+    rec.srcIp = ipFromFrontBack(w(hdr + 1), w(hdr + 2));
+    rec.dstIp = ipFromFrontBack(w(hdr + 2), w(hdr + 3));
+    if (rec.protocol != 1)
+    {
+        rec.srcPort = w(hdr + 3) & 0xFFFF;
+        rec.dstPort = (w(hdr + 4) >> 16) & 0xFFFF;
+        if (rec.protocol == 6)
+        {
+            uint8_t tcpFlags = (w(hdr + 7) >> 8) & 0xFF;
+            rec.isAck = (tcpFlags & TCP_ACK_FLAG) != 0;
+        }
+    }
+    else
+    {
+        uint32_t icmp = w(hdr + 3);
+        rec.icmpType = (icmp >> 8) & 0xFF;
+        rec.icmpCode = icmp & 0xF;
+    }
+
+    if (!w.ok())
+    {
+        return std::nullopt;
+    }
+    return rec;
+}
+
+template std::optional<CounterSampleRecord>
+decodeCounterSampleAs<layout::BrocadeCounters>(const SampleView&);
+template std::optional<CounterSampleRecord>
+decodeCounterSampleAs<layout::HpeCounters>(const SampleView&);
+template std::optional<FlowSampleRecord>
+decodeFlowSampleAs<layout::BrocadeFlows>(const SampleView&);
+template std::optional<FlowSampleRecord>
+decodeFlowSampleAs<layout::MininetFlows>(const SampleView&);
+template std::optional<FlowSampleRecord>
+decodeFlowSampleAs<layout::HpeFlows>(const SampleView&);
+
+namespace
+{
+
+template <typename Counters, typename Flows>
+constexpr DecoderProfile
+makeProfile(const char* name)
+{
+    return DecoderProfile{name,
+                          Counters::TYPE,
+                          &decodeCounterSampleAs<Counters>,
+                          Flows::TYPE,
+                          &decodeFlowSampleAs<Flows>};
+}
+
+constexpr DecoderProfile BROCADE = makeProfile<layout::BrocadeCounters, layout::BrocadeFlows>(
+    "brocade");
+constexpr DecoderProfile MININET = makeProfile<layout::BrocadeCounters, layout::MininetFlows>(
+    "mininet");
+constexpr DecoderProfile HPE = makeProfile<layout::HpeCounters, layout::HpeFlows>("hpe");
+
+} // namespace
+
+const DecoderProfile*
+profileForSampleType(uint32_t type, bool mininet)
+{
+    for (const DecoderProfile* profile : {mininet ? &MININET : &BROCADE, &HPE})
+    {
+        if (profile->decodes(type))
+        {
+            return profile;
+        }
+    }
+    return nullptr;
+}
+
+std::optional<CounterSampleRecord>
+decodeCounterSample(const SampleView& sample)
+{
+    const DecoderProfile* profile = profileForSampleType(sample.type(), false);
+    if (profile == nullptr || sample.type() != profile->counterType)
+    {
+        return std::nullopt;
+    }
+    return profile->decodeCounters(sample);
+}
+
+std::optional<FlowSampleRecord>
+decodeFlowSample(const SampleView& sample, bool mininet)
+{
+    const DecoderProfile* profile = profileForSampleType(sample.type(), mininet);
+    if (profile == nullptr || sample.type() != profile->flowType)
+    {
+        return std::nullopt;
+    }
+    return profile->decodeFlows(sample);
+}
+
+} // namespace sflow
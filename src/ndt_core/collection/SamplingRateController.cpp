@@ -0,0 +1,193 @@
+#include "ndt_core/collection/SamplingRateController.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+
+namespace sflow
+{
+
+SamplingRateController::SamplingRateController(SamplingControlConfig config)
+    : m_config(std::move(config)),
+      m_rateOid(utils::parseSnmpOid(SAMPLING_CONTROL_RATE_OID))
+{
+}
+
+void
+SamplingRateController::discover(uint32_t agentIp, Agent& agent)
+{
+    agent.discovering = true;
+    utils::SnmpQuery query;
+    query.agentIp = agentIp;
+    query.kind = utils::SnmpQuery::Kind::Walk;
+    query.oids = {m_rateOid};
+    query.community = m_config.community;
+    utils::SnmpClient::instance().asyncQuery(
+        std::move(query), [this, agentIp](utils::SnmpResponse response) {
+            std::lock_guard lock(m_mutex);
+            Agent& agent = m_agents[agentIp];
+            agent.discovering = false;
+            for (const auto& value : response.values)
+            {
+                // Disabled samplers (rate 0) are left alone
+                if (value.integer && *value.integer > 0)
+                {
+                    agent.rows.push_back(value.oid);
+                    agent.rate =
+                        std::max(agent.rate, static_cast<uint32_t>(*value.integer));
+                }
+            }
+            agent.initialRate = agent.rate;
+            agent.unsupported = agent.rows.empty();
+            if (agent.unsupported)
+            {
+                ++m_snmpFailures;
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "sFlow agent {} has no sampler rows over SNMP{}",
+                                   utils::Ipv4{agentIp},
+                                   response.ok() ? "" : " (" + response.error.message() + ")");
+            }
+        });
+}
+
+void
+SamplingRateController::push(uint32_t agentIp, Agent& agent, uint32_t rate)
+{
+    utils::SnmpQuery query;
+    query.agentIp = agentIp;
+    query.kind = utils::SnmpQuery::Kind::Set;
+    query.oids = agent.rows;
+    query.integers.assign(agent.rows.size(), rate);
+    query.community = m_config.community;
+    const uint32_t previous = agent.rate;
+    agent.rate = rate; // assumed until the agent refuses
+    ++m_inFlight;
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "sFlow agent {}: sampling rate 1 in {} -> 1 in {}",
+                       utils::Ipv4{agentIp},
+                       previous,
+                       rate);
+    utils::SnmpClient::instance().asyncQuery(
+        std::move(query), [this, agentIp, previous](utils::SnmpResponse response) {
+            std::lock_guard lock(m_mutex);
+            --m_inFlight;
+            if (!response.ok())
+            {
+                ++m_snmpFailures;
+                m_agents[agentIp].rate = previous;
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "Setting the sampling rate of sFlow agent {} failed: {}",
+                                   utils::Ipv4{agentIp},
+                                   response.error.message());
+            }
+        });
+}
+
+void
+SamplingRateController::step(const std::vector<AgentSampleLoad>& loads, bool dropping)
+{
+    double total = 0;
+    for (const auto& load : loads)
+    {
+        total += load.samplesPerSecond;
+    }
+
+    std::lock_guard lock(m_mutex);
+    m_lastLoad = total;
+    if (m_inFlight > 0 || m_changed)
+    {
+        // The loads of this period were measured partly before the last changes
+        m_changed = false;
+        return;
+    }
+
+    const double budget = static_cast<double>(m_config.maxSamplesPerSecond);
+    const double target = budget * SAMPLING_CONTROL_TARGET;
+    std::vector<AgentSampleLoad> ordered = loads;
+    if (dropping || total > budget * SAMPLING_CONTROL_HIGH)
+    {
+        std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+            return a.samplesPerSecond > b.samplesPerSecond;
+        });
+        double projected = total;
+        for (const auto& load : ordered)
+        {
+            if (projected <= target && !dropping)
+            {
+                break;
+            }
+            Agent& agent = m_agents[load.agentIp];
+            if (agent.rows.empty())
+            {
+                if (!agent.discovering && !agent.unsupported)
+                {
+                    discover(load.agentIp, agent);
+                }
+                continue;
+            }
+            if (agent.rate * 2ull > m_config.maxSamplingRate)
+            {
+                continue;
+            }
+            push(load.agentIp, agent, agent.rate * 2);
+            ++m_raises;
+            m_changed = true;
+            projected -= load.samplesPerSecond / 2;
+            // Dropping: one agent per step, then see whether that was enough
+            if (dropping && projected <= target)
+            {
+                break;
+            }
+        }
+    }
+    else if (total < budget * SAMPLING_CONTROL_LOW)
+    {
+        std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+            return a.samplesPerSecond < b.samplesPerSecond;
+        });
+        double projected = total;
+        for (const auto& load : ordered)
+        {
+            auto it = m_agents.find(load.agentIp);
+            if (it == m_agents.end() || it->second.rate <= it->second.initialRate)
+            {
+                continue;
+            }
+            // Halving the rate doubles the agent's samples
+            if (projected + load.samplesPerSecond > target)
+            {
+                break;
+            }
+            push(load.agentIp, it->second, std::max(it->second.rate / 2, it->second.initialRate));
+            ++m_restores;
+            m_changed = true;
+            projected += load.samplesPerSecond;
+        }
+    }
+}
+
+nlohmann::json
+SamplingRateController::statsJson() const
+{
+    std::lock_guard lock(m_mutex);
+    nlohmann::json agents = nlohmann::json::array();
+    for (const auto& [agentIp, agent] : m_agents)
+    {
+        if (!agent.rows.empty())
+        {
+            agents.push_back({{"agent", utils::ipToString(agentIp)},
+                              {"rate", agent.rate},
+                              {"initial_rate", agent.initialRate},
+                              {"rows", agent.rows.size()}});
+        }
+    }
+    return nlohmann::json{
+        {"max_samples_per_second", m_config.maxSamplesPerSecond},
+        {"last_load", m_lastLoad},
+        {"agents", std::move(agents)},
+        {"raises", m_raises},
+        {"restores", m_restores},
+        {"snmp_failures", m_snmpFailures},
+    };
+}
+
+} // namespace sflow
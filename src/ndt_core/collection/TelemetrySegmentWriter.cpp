@@ -0,0 +1,231 @@
+#include "ndt_core/collection/TelemetrySegmentWriter.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace sflow
+{
+
+TelemetrySegmentWriter::TelemetrySegmentWriter(std::string name)
+    : m_name(std::move(name))
+{
+}
+
+TelemetrySegmentWriter::~TelemetrySegmentWriter()
+{
+    close();
+}
+
+bool
+TelemetrySegmentWriter::open()
+{
+    if (m_segment)
+    {
+        return true;
+    }
+    const int fd = ::shm_open(m_name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Cannot create the telemetry segment {}: {}",
+                           m_name,
+                           std::strerror(errno));
+        return false;
+    }
+    void* mapping = MAP_FAILED;
+    if (::ftruncate(fd, sizeof(telemetry::Segment)) == 0)
+    {
+        mapping =
+            ::mmap(nullptr, sizeof(telemetry::Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int error = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Cannot map the telemetry segment {}: {}",
+                           m_name,
+                           std::strerror(error));
+        ::shm_unlink(m_name.c_str());
+        return false;
+    }
+
+    auto* segment = static_cast<telemetry::Segment*>(mapping);
+    const bool sameLayout =
+        std::memcmp(segment->magic, telemetry::MAGIC, sizeof(telemetry::MAGIC)) == 0 &&
+        segment->layoutVersion == telemetry::LAYOUT_VERSION &&
+        segment->segmentSize == sizeof(telemetry::Segment);
+    if (sameLayout)
+    {
+        // Left by an earlier run: keep the sequences moving forward for readers still
+        // mapping it, and close a write that run did not finish
+        auto closeAbandoned = [](auto& section) {
+            const uint64_t seq = section.seq.load(std::memory_order_relaxed);
+            if (seq & 1)
+            {
+                section.count = 0;
+                section.seq.store(seq + 1, std::memory_order_release);
+            }
+        };
+        closeAbandoned(segment->links);
+        closeAbandoned(segment->topFlows);
+        closeAbandoned(segment->matrix);
+    }
+    else
+    {
+        std::memset(static_cast<void*>(segment), 0, sizeof(telemetry::Segment));
+        segment->layoutVersion = telemetry::LAYOUT_VERSION;
+        segment->segmentSize = sizeof(telemetry::Segment);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(segment->magic, telemetry::MAGIC, sizeof(telemetry::MAGIC));
+    }
+    segment->writerPid = static_cast<uint32_t>(::getpid());
+    m_segment = segment;
+    m_mapped.store(true, std::memory_order_relaxed);
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Publishing telemetry to shared memory {} ({} bytes)",
+                       m_name,
+                       sizeof(telemetry::Segment));
+    return true;
+}
+
+void
+TelemetrySegmentWriter::close()
+{
+    if (!m_segment)
+    {
+        return;
+    }
+    ::munmap(m_segment, sizeof(telemetry::Segment));
+    ::shm_unlink(m_name.c_str());
+    m_segment = nullptr;
+    m_mapped.store(false, std::memory_order_relaxed);
+}
+
+template <typename Section>
+void
+TelemetrySegmentWriter::beginWrite(Section& section)
+{
+    section.seq.store(section.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <typename Section>
+void
+TelemetrySegmentWriter::endWrite(Section& section, uint32_t count, uint32_t dropped)
+{
+    section.count = count;
+    section.dropped = dropped;
+    ++section.version;
+    section.updatedAtMs = utils::getCurrentTimeMillisSystemClock();
+    section.seq.store(section.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void
+TelemetrySegmentWriter::publishLinks(const Graph& graph, bool fromFlowSamples)
+{
+    if (!m_segment)
+    {
+        return;
+    }
+    telemetry::LinkSection& section = m_segment->links;
+    uint32_t count = 0;
+    uint32_t dropped = 0;
+    beginWrite(section);
+    for (auto ed : boost::make_iterator_range(boost::edges(graph)))
+    {
+        if (count == telemetry::MAX_LINKS)
+        {
+            ++dropped;
+            continue;
+        }
+        const auto& e = graph[ed];
+        section.records[count++] = {
+            e.srcDpid,
+            e.dstDpid,
+            e.srcInterface,
+            e.dstInterface,
+            e.linkBandwidth,
+            e.linkBandwidthUsage,
+            fromFlowSamples ? e.leftBandwidthFromFlowSample : e.leftBandwidth,
+            e.linkBandwidthUtilization,
+            static_cast<uint32_t>(e.flowSet.size()),
+            e.isUp ? telemetry::LINK_UP : 0u,
+        };
+    }
+    endWrite(section, count, dropped);
+    m_publications.fetch_add(1, std::memory_order_relaxed);
+    m_links.store(count, std::memory_order_relaxed);
+    m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+void
+TelemetrySegmentWriter::publishTopFlows(std::span<const std::pair<uint64_t, FlowKey>> ranked)
+{
+    if (!m_segment)
+    {
+        return;
+    }
+    m_rankedScratch.assign(ranked.begin(), ranked.end());
+    std::sort(m_rankedScratch.begin(), m_rankedScratch.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+    const uint32_t count =
+        static_cast<uint32_t>(std::min<size_t>(m_rankedScratch.size(), telemetry::MAX_TOP_FLOWS));
+
+    telemetry::FlowSection& section = m_segment->topFlows;
+    beginWrite(section);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const auto& [rate, key] = m_rankedScratch[i];
+        section.records[i] =
+            {key.srcIP, key.dstIP, key.srcPort, key.dstPort, key.protocol, {}, rate};
+    }
+    endWrite(section, count, static_cast<uint32_t>(m_rankedScratch.size() - count));
+    m_topFlows.store(count, std::memory_order_relaxed);
+}
+
+void
+TelemetrySegmentWriter::publishMatrix(const TrafficMatrix& matrix)
+{
+    if (!m_segment)
+    {
+        return;
+    }
+    // Copied out first, so the matrix lock is not held across the section's write
+    matrix.cells(m_cellScratch);
+    const uint32_t count =
+        static_cast<uint32_t>(std::min<size_t>(m_cellScratch.size(), telemetry::MAX_MATRIX_CELLS));
+    const uint32_t dropped = static_cast<uint32_t>(m_cellScratch.size() - count);
+
+    telemetry::MatrixSection& section = m_segment->matrix;
+    beginWrite(section);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const TrafficMatrix::Cell& cell = m_cellScratch[i];
+        section.records[i] = {cell.srcIp, cell.dstIp, cell.bps};
+    }
+    endWrite(section, count, dropped);
+    m_matrixCells.store(count, std::memory_order_relaxed);
+    m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+nlohmann::json
+TelemetrySegmentWriter::statsJson() const
+{
+    return nlohmann::json{{"name", m_name},
+                          {"mapped", m_mapped.load(std::memory_order_relaxed)},
+                          {"bytes", sizeof(telemetry::Segment)},
+                          {"publications", m_publications.load(std::memory_order_relaxed)},
+                          {"links", m_links.load(std::memory_order_relaxed)},
+                          {"top_flows", m_topFlows.load(std::memory_order_relaxed)},
+                          {"matrix_cells", m_matrixCells.load(std::memory_order_relaxed)},
+                          {"dropped", m_dropped.load(std::memory_order_relaxed)}};
+}
+
+} // namespace sflow
@@ -9,17 +9,22 @@
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
-#include <queue>
 #include <shared_mutex>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -35,17 +40,154 @@
 #include <boost/range/irange.hpp>
 #include <boost/range/iterator_range_core.hpp>
 #include <nlohmann/json.hpp>
-#include <openssl/sha.h>
 
 // --- Local Headers ---
+#include "event_system/EventBus.hpp"
+#include "utils/HttpClient.hpp"
 #include "utils/Logger.hpp"
+#include "utils/MemoryAccounting.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Startup.hpp"
+#include "utils/ThreadRegistry.hpp"
 #include "utils/Utils.hpp"
 
 using json = nlohmann::json;
 using namespace std;
 
-// ---Please change to your own RYU base url---
-static const std::string RYU_BASE_URL = "http://localhost:8080/v1.0/topology";
+namespace
+{
+
+// Estimated heap bytes of @p graph; those of the edges' flowSets are added to @p flowSetBytes
+size_t
+graphBytes(const Graph& graph, size_t& flowSetBytes)
+{
+    using utils::heapBytes;
+    using utils::heapChunk;
+    // vecS vertices, each with a setS tree of out-edges; a tree node holds the target and
+    // owns the EdgeProperties
+    size_t bytes = heapChunk(boost::num_vertices(graph) *
+                             (sizeof(VertexProperties) + sizeof(std::set<void*>)));
+    for (auto v : boost::make_iterator_range(boost::vertices(graph)))
+    {
+        const VertexProperties& vertex = graph[v];
+        bytes += heapBytes(vertex.ip) + heapBytes(vertex.deviceName) +
+                 heapBytes(vertex.nickName) + heapBytes(vertex.bridgeNameForMininet) +
+                 heapBytes(vertex.brandName) + heapBytes(vertex.bridgeConnectedPortsForMininet) +
+                 heapBytes(vertex.ecmpGroups);
+        for (const std::string& port : vertex.bridgeConnectedPortsForMininet)
+        {
+            bytes += heapBytes(port);
+        }
+        for (const EcmpGroup& group : vertex.ecmpGroups)
+        {
+            bytes += heapBytes(group.members);
+        }
+    }
+    for (auto e : boost::make_iterator_range(boost::edges(graph)))
+    {
+        const EdgeProperties& edge = graph[e];
+        bytes += heapChunk(MEMORY_NODE_OVERHEAD + 2 * sizeof(void*)) +
+                 heapChunk(sizeof(EdgeProperties)) + heapBytes(edge.srcIp) +
+                 heapBytes(edge.dstIp);
+        flowSetBytes += heapBytes(edge.flowSet);
+    }
+    return bytes;
+}
+
+// site.ryu_shards as parsed: inclusive dpid ranges and the index of their instance
+struct RyuShardMap
+{
+    std::vector<std::string> addresses; // ryuAddress() first
+    std::vector<std::tuple<uint64_t, uint64_t, size_t>> ranges;
+};
+
+uint64_t
+parseDpid(const std::string& text)
+{
+    size_t used = 0;
+    const uint64_t dpid = std::stoull(text, &used);
+    if (used != text.size())
+    {
+        throw std::invalid_argument("not a decimal dpid: " + text);
+    }
+    return dpid;
+}
+
+const RyuShardMap&
+ryuShardMap()
+{
+    static const RyuShardMap map = [] {
+        RyuShardMap parsed;
+        parsed.addresses.push_back(ryuAddress());
+        if (ryuShards() == "none")
+        {
+            return parsed;
+        }
+        std::stringstream shards(ryuShards());
+        for (std::string shard; std::getline(shards, shard, ';');)
+        {
+            const size_t equals = shard.find('=');
+            try
+            {
+                if (equals == std::string::npos || equals == 0)
+                {
+                    throw std::invalid_argument("expected host:port=dpids");
+                }
+                const std::string address = shard.substr(0, equals);
+                auto known = std::find(parsed.addresses.begin(), parsed.addresses.end(), address);
+                const size_t index = known - parsed.addresses.begin();
+                std::vector<std::tuple<uint64_t, uint64_t, size_t>> ranges;
+                std::stringstream dpids(shard.substr(equals + 1));
+                for (std::string item; std::getline(dpids, item, ',');)
+                {
+                    const size_t dash = item.find('-');
+                    const uint64_t first = parseDpid(item.substr(0, dash));
+                    const uint64_t last =
+                        dash == std::string::npos ? first : parseDpid(item.substr(dash + 1));
+                    if (last < first)
+                    {
+                        throw std::invalid_argument("empty range " + item);
+                    }
+                    ranges.emplace_back(first, last, index);
+                }
+                if (known == parsed.addresses.end())
+                {
+                    parsed.addresses.push_back(address);
+                }
+                parsed.ranges.insert(parsed.ranges.end(), ranges.begin(), ranges.end());
+            }
+            catch (const std::exception& e)
+            {
+                SPDLOG_LOGGER_ERROR(
+                    Logger::instance(), "site.ryu_shards: ignoring \"{}\": {}", shard, e.what());
+            }
+        }
+        return parsed;
+    }();
+    return map;
+}
+
+} // namespace
+
+const std::string&
+ryuAddressFor(uint64_t dpid)
+{
+    const RyuShardMap& map = ryuShardMap();
+    for (const auto& [first, last, index] : map.ranges)
+    {
+        if (first <= dpid && dpid <= last)
+        {
+            return map.addresses[index];
+        }
+    }
+    return map.addresses.front();
+}
+
+const std::vector<std::string>&
+ryuAddresses()
+{
+    return ryuShardMap().addresses;
+}
 
 TopologyAndFlowMonitor::TopologyAndFlowMonitor(std::shared_ptr<Graph> graph,
                                                std::shared_ptr<std::shared_mutex> graphMutex,
@@ -56,9 +198,6 @@ TopologyAndFlowMonitor::TopologyAndFlowMonitor(std::shared_ptr<Graph> graph,
       m_eventBus(std::move(eventBus)),
       m_mode(static_cast<utils::DeploymentMode>(mode))
 {
-    m_ryuUrl[0] = RYU_BASE_URL + "/switches";
-    m_ryuUrl[1] = RYU_BASE_URL + "/hosts";
-    m_ryuUrl[2] = RYU_BASE_URL + "/links";
 }
 
 TopologyAndFlowMonitor::~TopologyAndFlowMonitor()
@@ -71,7 +210,17 @@ TopologyAndFlowMonitor::start()
 {
     m_running.store(true);
     m_thread = thread(&TopologyAndFlowMonitor::run, this);
-    m_flushEdgeFlowLoop = thread(&TopologyAndFlowMonitor::flushEdgeFlowLoop, this);
+    m_flushEdgeFlowsTask = utils::TaskScheduler::instance().schedule(
+        "edge_flow_expiry",
+        utils::TaskPriority::High,
+        chrono::milliseconds(1000),
+        [this] { flushEdgeFlows(); },
+        true);
+    m_resyncTask = utils::TaskScheduler::instance().schedule(
+        "topology_resync",
+        utils::TaskPriority::Low,
+        chrono::seconds(TOPOLOGY_RESYNC_INTERVAL_S),
+        [this] { resyncFromController(); });
 }
 
 void
@@ -82,12 +231,23 @@ TopologyAndFlowMonitor::stop()
     {
         m_thread.join();
     }
+    utils::TaskScheduler::instance().cancel(m_flushEdgeFlowsTask);
+    m_flushEdgeFlowsTask = 0;
+    utils::TaskScheduler::instance().cancel(m_resyncTask);
+    m_resyncTask = 0;
+}
+
+void
+TopologyAndFlowMonitor::loadStaticTopology(const std::string& path)
+{
+    loadStaticTopologyFromFile(path);
+    initializeMappingsFromGraph();
 }
 
 void
 TopologyAndFlowMonitor::loadStaticTopologyFromFile(const std::string& path)
 {
-    std::ifstream file(path);
+    std::ifstream file(path, std::ios::binary);
     if (!file.is_open())
     {
         SPDLOG_LOGGER_ERROR(Logger::instance(), "Cannot open topology file:  {}", path);
@@ -96,18 +256,64 @@ TopologyAndFlowMonitor::loadStaticTopologyFromFile(const std::string& path)
 
     SPDLOG_LOGGER_INFO(Logger::instance(), "Load Static Topology File");
 
-    json j;
-    file >> j;
+    std::string contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    // An unchanged file is loaded from its compiled cache instead of parsing the JSON
+    const std::string cachePath = path + TOPOLOGY_CACHE_SUFFIX;
+    const uint64_t sourceHash = topology_cache::hash(contents);
+    std::optional<StaticTopology> topology = topology_cache::load(cachePath, sourceHash, m_mode);
+    if (topology)
+    {
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Static topology loaded from {}", cachePath);
+    }
+    else
+    {
+        topology = parseStaticTopology(json::parse(contents));
+        topology_cache::store(cachePath, sourceHash, m_mode, *topology);
+    }
+
+    auto lock = lockGraphForWrite();
+    std::vector<Graph::vertex_descriptor> vertices;
+    vertices.reserve(topology->vertices.size());
+    for (auto& vp : topology->vertices)
+    {
+        vertices.push_back(boost::add_vertex(std::move(vp), *m_graph));
+    }
 
-    // std::unique_lock lock(*m_graphMutex);
+    LinkStatsTable::EdgeId nextStatsId = 0;
+    for (auto& edge : topology->edges)
+    {
+        auto [e, added] = boost::add_edge(
+            vertices[edge.src], vertices[edge.dst], std::move(edge.props), *m_graph);
+        if (added)
+        {
+            (*m_graph)[e].statsId = nextStatsId++;
+        }
+    }
+
+    rebuildIndexNoLock();
+    m_linkStats.reset(*m_graph);
+    m_edgeFlows.reset(*m_graph);
+    m_congestion.reset(m_linkStats.size());
+    m_pathResiduals.reset(m_linkStats.size());
+    for (LinkStatsTable::EdgeId id = 0; id < m_linkStats.size(); ++id)
+    {
+        const LinkStats stats = m_linkStats.read(id);
+        m_congestion.update(id, stats.linkBandwidthUtilization);
+        m_pathResiduals.update(id, stats.leftBandwidth, stats.linkBandwidth);
+    }
+}
 
-    std::unordered_map<uint64_t, Graph::vertex_descriptor> dpidToVertex;
+StaticTopology
+TopologyAndFlowMonitor::parseStaticTopology(const json& j) const
+{
+    StaticTopology topology;
+    std::unordered_map<uint64_t, uint32_t> dpidToVertex;
+    std::unordered_map<uint32_t, uint32_t> ipToVertex;
 
     // Add nodes
     for (const auto& nodeJson : j["nodes"])
     {
-        // VertexProperties vp = nodeJson.get<VertexProperties>();
-        // Custom extraction (like from_json function)
         VertexProperties vp;
         vp.vertexType = static_cast<VertexType>(nodeJson.at("vertex_type").get<int>());
         vp.mac = nodeJson.at("mac").get<uint64_t>();
@@ -129,18 +335,38 @@ TopologyAndFlowMonitor::loadStaticTopologyFromFile(const std::string& path)
                                 vp.bridgeNameForMininet);
         }
 
-        auto v = boost::add_vertex(vp, *m_graph);
-
+        const auto v = static_cast<uint32_t>(topology.vertices.size());
         if (vp.vertexType == VertexType::SWITCH)
         {
             dpidToVertex[vp.dpid] = v;
         }
+        // Host endpoints below are resolved by IP; the first vertex with an IP wins, as in
+        // TopologyIndex
+        for (uint32_t ip : vp.ip)
+        {
+            ipToVertex.try_emplace(ip, v);
+        }
+        topology.vertices.push_back(std::move(vp));
     }
+
+    auto resolve = [&](uint64_t dpid, const std::vector<uint32_t>& ips) -> std::optional<uint32_t> {
+        // Switch by DPID, or host by IP if the DPID is 0
+        if (dpid != 0)
+        {
+            auto it = dpidToVertex.find(dpid);
+            return it == dpidToVertex.end() ? std::nullopt : std::optional<uint32_t>(it->second);
+        }
+        if (ips.empty())
+        {
+            return std::nullopt;
+        }
+        auto it = ipToVertex.find(ips[0]);
+        return it == ipToVertex.end() ? std::nullopt : std::optional<uint32_t>(it->second);
+    };
+
     // Add edges
     for (const auto& edgeJson : j["edges"])
     {
-        // EdgeProperties ep = edgeJson.get<EdgeProperties>();
-        // Custom extraction (like above, like from_json function)
         EdgeProperties ep;
         ep.isUp = false;
         ep.isEnabled = false;
@@ -156,44 +382,12 @@ TopologyAndFlowMonitor::loadStaticTopologyFromFile(const std::string& path)
             utils::ipStringVecToUint32Vec(edgeJson.at("dst_ip").get<std::vector<std::string>>());
         ep.dstDpid = edgeJson.at("dst_dpid").get<uint64_t>();
         ep.dstInterface = edgeJson.at("dst_interface").get<uint32_t>();
-        // ep.flowSet = std::set<sflow::FlowKey>();
-        ep.flowSet = {};
-
-        std::optional<Graph::vertex_descriptor> srcVertexOpt;
-        std::optional<Graph::vertex_descriptor> dstVertexOpt;
-
-        // Lookup switch by src DPID, or host by IP if src_dpid == 0
-        if (ep.srcDpid != 0)
-        {
-            auto it_src = dpidToVertex.find(ep.srcDpid);
-            if (it_src != dpidToVertex.end())
-            {
-                srcVertexOpt = it_src->second;
-            }
-        }
-        else if (!ep.srcIp.empty())
-        {
-            srcVertexOpt = findVertexByIp(ep.srcIp[0]);
-        }
 
-        // Lookup switch by dst DPID, or host by IP if dst_dpid == 0
-        if (ep.dstDpid != 0)
-        {
-            auto it_dst = dpidToVertex.find(ep.dstDpid);
-            if (it_dst != dpidToVertex.end())
-            {
-                dstVertexOpt = it_dst->second;
-            }
-        }
-        else if (!ep.dstIp.empty())
+        auto src = resolve(ep.srcDpid, ep.srcIp);
+        auto dst = resolve(ep.dstDpid, ep.dstIp);
+        if (src && dst)
         {
-            dstVertexOpt = findVertexByIp(ep.dstIp[0]);
-        }
-
-        // Add edge if both endpoints found
-        if (srcVertexOpt.has_value() && dstVertexOpt.has_value())
-        {
-            boost::add_edge(srcVertexOpt.value(), dstVertexOpt.value(), ep, *m_graph);
+            topology.edges.push_back({*src, *dst, std::move(ep)});
         }
         else
         {
@@ -205,318 +399,350 @@ TopologyAndFlowMonitor::loadStaticTopologyFromFile(const std::string& path)
                                ep.dstIp.empty() ? 0 : ep.dstIp[0]);
         }
     }
+    return topology;
+}
+
+void
+TopologyAndFlowMonitor::rebuildIndexNoLock()
+{
+    m_index = TopologyIndex::build(*m_graph);
+    m_indexVersion.fetch_add(1, std::memory_order_acq_rel);
+    SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                        "Topology index rebuilt: {} vertices, {} edges",
+                        m_index.vertexCount(),
+                        m_index.edgeCount());
 }
 
 std::optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findVertexByIp(uint32_t ip) const
 {
     std::shared_lock lock(*m_graphMutex);
+    return findVertexByIpNoLock(ip);
+}
 
-    for (auto [v_it, v_end] = boost::vertices(*m_graph); v_it != v_end; ++v_it)
+std::optional<Graph::vertex_descriptor>
+TopologyAndFlowMonitor::findVertexByIpNoLock(uint32_t ip) const
+{
+    return m_index.vertexByIp(ip);
+}
+
+std::optional<TopologyEvent::Type>
+TopologyEvent::parseType(std::string_view name)
+{
+    static const std::unordered_map<std::string_view, Type> types{
+        {"switch_enter", Type::SwitchEnter},
+        {"switch_leave", Type::SwitchLeave},
+        {"link_add", Type::LinkAdd},
+        {"link_delete", Type::LinkDelete},
+        {"host_add", Type::HostAdd},
+    };
+    auto it = types.find(name);
+    if (it == types.end())
     {
-        const auto& props = (*m_graph)[*v_it];
-        if (std::find(props.ip.begin(), props.ip.end(), ip) != props.ip.end())
-        {
-            return *v_it;
-        }
+        return std::nullopt;
     }
-
-    return std::nullopt;
+    return it->second;
 }
 
-std::optional<Graph::vertex_descriptor>
-TopologyAndFlowMonitor::findVertexByIpNoLock(uint32_t ip) const
+void
+TopologyAndFlowMonitor::resyncFromController()
 {
-    for (auto [v_it, v_end] = boost::vertices(*m_graph); v_it != v_end; ++v_it)
+    // GET switches, hosts and links of every Ryu instance, all at once
+    static constexpr std::array<const char*, 3> kinds{"/switches", "/hosts", "/links"};
+    const std::vector<std::string>& addresses = ryuAddresses();
+    auto& http = utils::HttpClient::instance();
+    std::vector<std::string> urls;
+    std::vector<std::future<utils::HttpResponse>> pending;
+    for (const std::string& address : addresses)
     {
-        const auto& props = (*m_graph)[*v_it];
-        if (std::find(props.ip.begin(), props.ip.end(), ip) != props.ip.end())
+        for (const char* kind : kinds)
         {
-            return *v_it;
+            urls.push_back("http://" + address + "/v1.0/topology" + kind);
+            pending.push_back(http.asyncRequest(boost::beast::http::verb::get, urls.back()));
         }
     }
+    std::vector<string> bodies(pending.size());
+    bool failed = false;
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        utils::HttpResponse response = pending[i].get();
+        if (response.error)
+        {
+            SPDLOG_LOGGER_ERROR(
+                Logger::instance(), "Error querying {}: {}", urls[i], response.error.message());
+            failed = true;
+        }
+        bodies[i] = std::move(response.body);
+    }
+    if (failed)
+    {
+        return;
+    }
+    if (addresses.size() > 1)
+    {
+        // Each instance lists its own switches: concatenate the lists of each kind
+        for (size_t kind = 0; kind < kinds.size(); ++kind)
+        {
+            json merged = json::array();
+            for (size_t i = kind; i < bodies.size(); i += kinds.size())
+            {
+                json part = json::parse(bodies[i], nullptr, false);
+                if (!part.is_array())
+                {
+                    SPDLOG_LOGGER_ERROR(Logger::instance(), "{} is not a JSON array", urls[i]);
+                    return;
+                }
+                for (json& item : part)
+                {
+                    merged.push_back(std::move(item));
+                }
+            }
+            bodies[kind] = merged.dump();
+        }
+    }
+    const string& switchesStr = bodies[0];
+    const string& hostsStr = bodies[1];
+    const string& linksStr = bodies[2];
 
-    return std::nullopt;
+    updateGraph(switchesStr, hostsStr, linksStr);
+    // Warm once the graph has the controller's view (a later resync if Ryu was not up yet)
+    utils::Startup::instance().markWarm("topology");
 }
 
 void
-TopologyAndFlowMonitor::fetchAndUpdateTopologyData()
+TopologyAndFlowMonitor::applySwitchNoLock(const json& sw, bool up)
 {
-    // Read static network topology
-    if (m_mode == utils::TESTBED)
+    // Note that the "dpid" is written in base 16
+    string switchDpidStr = sw.at("dpid").get<string>();
+    uint64_t switchDpidUint64 = stoull(switchDpidStr, nullptr, 16);
+
+    auto vertexSwitchOpt = findSwitchByDpidNoLock(switchDpidUint64);
+    if (!vertexSwitchOpt)
     {
-        loadStaticTopologyFromFile(TOPOLOGY_FILE);
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Switch ({}) not found in static network topology file",
+                           switchDpidStr);
+        return;
     }
-    else if (m_mode == utils::MININET)
+    (*m_graph)[*vertexSwitchOpt].isUp = up;
+    if (up)
     {
-        loadStaticTopologyFromFile(TOPOLOGY_FILE_MININET);
+        (*m_graph)[*vertexSwitchOpt].isEnabled = true;
     }
+    SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                        "Switch {} ({}) {}",
+                        switchDpidStr,
+                        switchDpidUint64,
+                        up ? "up" : "down");
+}
 
-    initializeMappingsFromGraph();
-
-    // GET switches
-    string curlCommand = "curl -s -X GET " + m_ryuUrl[0];
-    string switchesStr;
-    try
-    {
-        switchesStr = utils::execCommand(curlCommand);
-    }
-    catch (const exception& ex)
+void
+TopologyAndFlowMonitor::applyLinkNoLock(const json& link,
+                                        bool up,
+                                        LinkStateChangedEventData& changes)
+{
+    string srcDpidStr = link.at("src").value("dpid", "");
+    string srcPortStr = link.at("src").value("port_no", "");
+    string dstDpidStr = link.at("dst").value("dpid", "");
+    if (srcDpidStr.empty() || dstDpidStr.empty())
     {
-        cerr << "Error executing curl command: " << ex.what() << endl;
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Empty DPID");
         return;
     }
 
-    // GET hosts
-    curlCommand = "curl -s -X GET " + m_ryuUrl[1];
-    string hostsStr;
-    try
+    uint64_t srcDpid = stoull(srcDpidStr, nullptr, 16);
+    uint32_t srcPort = utils::portStringToUint(srcPortStr);
+    uint64_t dstDpid = stoull(dstDpidStr, nullptr, 16);
+    if (!findSwitchByDpidNoLock(srcDpid) || !findSwitchByDpidNoLock(dstDpid))
     {
-        hostsStr = utils::execCommand(curlCommand);
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Cannot Find Endpoints Switches ({} -> {})",
+                           srcDpidStr,
+                           dstDpidStr);
+        return;
     }
-    catch (const exception& ex)
+
+    // Ryu reports each direction as its own link
+    auto edgeOpt = findEdgeByDpidAndPortNoLock({srcDpid, srcPort});
+    if (!edgeOpt)
     {
-        cerr << "Error executing curl command: " << ex.what() << endl;
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Link (dpid {} port {}) not found in static network topology file",
+                           srcDpidStr,
+                           srcPortStr);
         return;
     }
-
-    // GET links
-    curlCommand = "curl -s -X GET " + m_ryuUrl[2];
-    string linksStr;
-    try
+    auto& edge = (*m_graph)[*edgeOpt];
+    if (edge.isUp != up)
     {
-        linksStr = utils::execCommand(curlCommand);
+        changes.changes.push_back({*edgeOpt, up});
     }
-    catch (const exception& ex)
+    edge.isUp = up;
+    m_linkStats.setUp(edge.statsId, up);
+    if (up)
     {
-        cerr << "Error executing curl command: " << ex.what() << endl;
-        return;
+        edge.isEnabled = true;
     }
-
-    updateGraph(switchesStr, hostsStr, linksStr);
 }
 
 void
-TopologyAndFlowMonitor::updateSwitches(const string& topologyData)
+TopologyAndFlowMonitor::applyHostNoLock(const json& host, LinkStateChangedEventData& changes)
 {
-    // Update Vertex(Switch) from ryu's REST api
-    try
+    const auto& vecIpStr = host.at("ipv4");
+    if (vecIpStr.empty())
     {
-        auto switchesInfoJson = json::parse(topologyData);
+        SPDLOG_LOGGER_DEBUG(Logger::instance(), "Skipping host with no IPv4 address");
+        return;
+    }
 
-        // PRINT JSON IN STRING PATTERN
-        SPDLOG_LOGGER_TRACE(Logger::instance(), "update switch json: {}", switchesInfoJson.dump(4));
+    auto vertexOpt = findVertexByMacNoLock(utils::macToUint64(host.at("mac")));
+    if (vertexOpt)
+    {
+        (*m_graph)[*vertexOpt].isUp = true;
+        (*m_graph)[*vertexOpt].isEnabled = true;
+    }
+    else
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Host ({}) not found in static network topology file",
+                           host["mac"].dump());
+    }
 
-        for (const auto& switchInfoJson : switchesInfoJson)
+    auto setUp = [&](Graph::edge_descriptor e) {
+        if (!(*m_graph)[e].isUp)
         {
-            // Note that the "dpid" is written in base 16
-            string switchDpidStr = switchInfoJson.value("dpid", "");
-            uint64_t switchDpidUint64 = stoull(switchDpidStr, nullptr, 16);
-
-            SPDLOG_LOGGER_INFO(Logger::instance(),
-                               "switchDpidStr {} switchDpidUint64 {}",
-                               switchDpidStr,
-                               switchDpidUint64);
-
-            // Update switch isUp status
-            // Keep Thread Safe
-            {
-                unique_lock lock(*m_graphMutex);
-                auto vertexSwitchOpt = findSwitchByDpidNoLock(switchDpidUint64);
-                if (vertexSwitchOpt)
-                {
-                    (*m_graph)[*vertexSwitchOpt].isUp = true;
-                    (*m_graph)[*vertexSwitchOpt].isEnabled = true;
-                }
-                else
-                {
-                    SPDLOG_LOGGER_WARN(Logger::instance(),
-                                       "Switch ({}) not found in static network topology file",
-                                       switchDpidStr);
-                }
-            }
+            changes.changes.push_back({e, true});
         }
+        (*m_graph)[e].isUp = true;
+        (*m_graph)[e].isEnabled = true;
+        m_linkStats.setUp((*m_graph)[e].statsId, true);
+    };
+
+    std::string ipStr = vecIpStr[0].get<std::string>();
+    uint32_t ip = utils::ipStringToUint32(ipStr);
+    auto edgeOpt = findEdgeByHostIpNoLock(ip);
+    if (edgeOpt)
+    {
+        setUp(*edgeOpt);
     }
-    catch (const json::parse_error& err)
+    else
     {
-        cerr << "JSON parse error: " << err.what() << endl;
-        return;
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Edge (host {} {} {}) not found in static network topology file",
+                           host["mac"].dump(),
+                           ipStr,
+                           ip);
     }
-}
 
-void
-TopologyAndFlowMonitor::updateHosts(const string& topologyData)
-{
-    // Update Vertex(Host) and Edge(Host to Switch) from ryu's REST api
-    try
+    auto switchOpt = findSwitchByDpidNoLock(utils::hexStringToUint64(host.at("port").at("dpid")));
+    if (switchOpt)
     {
-        auto hostsInfoJson = json::parse(topologyData);
-
-        // PRINT JSON IN STRING PATTERN
-        SPDLOG_LOGGER_TRACE(Logger::instance(), "update hosts json: {}", hostsInfoJson.dump(4));
-
-        for (const auto& host : hostsInfoJson)
+        auto edgeRevOpt = findEdgeBySrcAndDstIpNoLock((*m_graph)[*switchOpt].ip[0], ip);
+        if (edgeRevOpt)
         {
-            if (host["ipv4"].empty())
-            {
-                SPDLOG_LOGGER_DEBUG(Logger::instance(), "Skipping host with no IPv4 address");
-                continue;
-            }
-
-            auto vecIpStr = host["ipv4"];
-            auto vertexOpt = findVertexByMac(utils::macToUint64(host["mac"]));
-            if (vertexOpt)
-            {
-                unique_lock lock(*m_graphMutex);
-                (*m_graph)[*vertexOpt].isUp = true;
-                (*m_graph)[*vertexOpt].isEnabled = true;
-            }
-            else
-            {
-                SPDLOG_LOGGER_WARN(Logger::instance(),
-                                   "Host ({}) not found in static network topology file",
-                                   host["mac"].dump());
-            }
-
-            std::string ipStr = vecIpStr[0].get<std::string>();
-            uint32_t ip = utils::ipStringToUint32(ipStr);
-            auto edgeOpt = findEdgeByHostIp(ip);
+            setUp(*edgeRevOpt);
+        }
+        else
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "Rev Edge (host {}) not found in static network topology file",
+                               host["mac"].dump());
+        }
+    }
+}
 
-            if (edgeOpt)
-            {
-                unique_lock lock(*m_graphMutex);
-                (*m_graph)[*edgeOpt].isUp = true;
-                (*m_graph)[*edgeOpt].isEnabled = true;
-            }
-            else
-            {
-                SPDLOG_LOGGER_WARN(Logger::instance(),
-                                   "Edge (host {} {} {}) not found in static network topology file",
-                                   host["mac"].dump(),
-                                   ipStr,
-                                   ip);
-            }
+LinkStateChangedEventData
+TopologyAndFlowMonitor::applyTopologyEvents(const std::vector<TopologyEvent>& events)
+{
+    LinkStateChangedEventData changes;
+    bool linksReported = false;
 
-            auto vertexOpt2 = findSwitchByDpid(utils::hexStringToUint64(host["port"]["dpid"]));
-            if (vertexOpt2.has_value())
+    auto lock = lockGraphForWrite();
+    for (const auto& event : events)
+    {
+        try
+        {
+            switch (event.type)
             {
-                auto edgeRevOpt = findEdgeBySrcAndDstIp((*m_graph)[*vertexOpt2].ip[0],
-                                                        utils::ipStringToUint32(vecIpStr[0]));
-                if (edgeRevOpt.has_value())
-                {
-                    unique_lock lock(*m_graphMutex);
-                    (*m_graph)[edgeRevOpt.value()].isUp = true;
-                    (*m_graph)[edgeRevOpt.value()].isEnabled = true;
-                }
-                else
-                {
-                    SPDLOG_LOGGER_WARN(
-                        Logger::instance(),
-                        "Rev Edge (host {}) not found in static network topology file",
-                        host["mac"].dump());
-                }
+            case TopologyEvent::Type::SwitchEnter:
+            case TopologyEvent::Type::SwitchLeave:
+                applySwitchNoLock(event.body, event.type == TopologyEvent::Type::SwitchEnter);
+                break;
+            case TopologyEvent::Type::LinkAdd:
+            case TopologyEvent::Type::LinkDelete:
+                applyLinkNoLock(event.body, event.type == TopologyEvent::Type::LinkAdd, changes);
+                linksReported = true;
+                break;
+            case TopologyEvent::Type::HostAdd:
+                applyHostNoLock(event.body, changes);
+                break;
             }
         }
+        catch (const std::exception& e)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "Skipping topology event {}: {}",
+                               event.body.dump(),
+                               e.what());
+        }
     }
-    catch (const json::parse_error& err)
+
+    if (linksReported)
     {
-        cerr << "JSON parse error: " << err.what() << endl;
-        return;
+        // Keep the topology index in step with the links Ryu reports
+        rebuildIndexNoLock();
     }
+    SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                        "Applied {} topology events, {} edges changed state",
+                        events.size(),
+                        changes.changes.size());
+    return changes;
 }
 
 void
-TopologyAndFlowMonitor::updateLinks(const string& topologyData)
+TopologyAndFlowMonitor::updateGraph(const string& switchesStr,
+                                    const string& hostsStr,
+                                    const string& linksStr)
 {
-    // Update Vertex(Host) and Edge(Host to Switch) from ryu's REST api
+    // The full lists, as one batch of "entered"/"added" events
+    std::vector<TopologyEvent> events;
     try
     {
-        auto linksInfoJson = json::parse(topologyData);
-
-        // PRINT JSON IN STRING PATTERN
+        auto switchesInfoJson = json::parse(switchesStr);
+        auto hostsInfoJson = json::parse(hostsStr);
+        auto linksInfoJson = json::parse(linksStr);
+        SPDLOG_LOGGER_TRACE(Logger::instance(), "update switch json: {}", switchesInfoJson.dump(4));
+        SPDLOG_LOGGER_TRACE(Logger::instance(), "update hosts json: {}", hostsInfoJson.dump(4));
         SPDLOG_LOGGER_TRACE(Logger::instance(), "update links json: {}", linksInfoJson.dump(4));
 
-        for (const auto& link : linksInfoJson)
+        events.reserve(switchesInfoJson.size() + hostsInfoJson.size() + linksInfoJson.size());
+        for (auto& sw : switchesInfoJson)
         {
-            string srcDpidStr = link["src"].value("dpid", "");
-            string srcPortStr = link["src"].value("port_no", "");
-            string dstDpidStr = link["dst"].value("dpid", "");
-            string dstPortStr = link["dst"].value("port_no", "");
-            if (srcDpidStr.empty() || dstDpidStr.empty())
-            {
-                SPDLOG_LOGGER_WARN(Logger::instance(), "Empty DPID");
-                continue;
-            }
-
-            // Check if both switches exist in the graph
-            uint64_t srcDpid = stoull(srcDpidStr, nullptr, 16);
-            uint32_t srcPort = utils::portStringToUint(srcPortStr);
-            uint64_t dstDpid = stoull(dstDpidStr, nullptr, 16);
-            // uint64_t dstPort = utils::portStringToUint(dstPortStr);
-
-            auto srcVertexOpt = findSwitchByDpid(srcDpid);
-            auto dstVertexOpt = findSwitchByDpid(dstDpid);
-
-            if (!srcVertexOpt.has_value() or !dstVertexOpt.has_value())
-            {
-                SPDLOG_LOGGER_WARN(Logger::instance(), "Cannot Find Endpoints Switches");
-                return;
-            }
-
-            {
-                unique_lock lock(*m_graphMutex);
-                auto srcVertex = *srcVertexOpt;
-                // ==============================================
-                // auto dstVertex = *dstVertexOpt;
-                // auto [e, added] = boost::add_edge(srcVertex, dstVertex, *m_graph);
-                // if (added)
-                // {
-                //     (*m_graph)[e].isUp = true;
-                //     (*m_graph)[e].srcDpid = (*m_graph)[srcVertex].dpid;
-                //     (*m_graph)[e].srcIp = (*m_graph)[srcVertex].ip;
-                //     (*m_graph)[e].srcInterface = srcPort;
-                //     (*m_graph)[e].dstDpid = (*m_graph)[dstVertex].dpid;
-                //     (*m_graph)[e].dstIp = (*m_graph)[dstVertex].ip;
-                //     (*m_graph)[e].dstInterface = dstPort;
-                //     (*m_graph)[e].linkBandwidth = 1000000000;
-                // }
-                // ==============================================
-
-                // Update link isUp status
-                auto edgeOpt = findEdgeByDpidAndPortNoLock({(*m_graph)[srcVertex].dpid, srcPort});
-
-                if (edgeOpt.has_value())
-                {
-                    (*m_graph)[edgeOpt.value()].isUp = true;
-                    (*m_graph)[edgeOpt.value()].isEnabled = true;
-                }
-                else
-                {
-                    SPDLOG_LOGGER_WARN(
-                        Logger::instance(),
-                        "Link (dpid {} port {}) not found in static network topology file",
-                        srcDpidStr,
-                        srcPortStr);
-                }
-            }
+            events.push_back({TopologyEvent::Type::SwitchEnter, std::move(sw)});
+        }
+        for (auto& host : hostsInfoJson)
+        {
+            events.push_back({TopologyEvent::Type::HostAdd, std::move(host)});
+        }
+        for (auto& link : linksInfoJson)
+        {
+            events.push_back({TopologyEvent::Type::LinkAdd, std::move(link)});
         }
     }
     catch (const json::parse_error& err)
     {
-        cerr << "JSON parse error: " << err.what() << endl;
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Ryu topology JSON parse error: {}", err.what());
         return;
     }
-}
 
-void
-TopologyAndFlowMonitor::updateGraph(const string& switchesStr,
-                                    const string& hostsStr,
-                                    const string& linksStr)
-{
-    updateSwitches(switchesStr);
-    updateHosts(hostsStr);
-    updateLinks(linksStr);
+    LinkStateChangedEventData changes = applyTopologyEvents(events);
     SPDLOG_LOGGER_INFO(Logger::instance(), "\033[1;32mTopology Update From REST\033[0m");
+    if (!changes.changes.empty())
+    {
+        // Links that came back while no event reached us
+        m_eventBus->channel<LinkStateChangedEventData>(EventType::LinkStateChanged).publish(
+            std::move(changes));
+    }
     logGraph();
 }
 
@@ -634,22 +860,24 @@ TopologyAndFlowMonitor::updateLinkInfo(pair<uint32_t, uint32_t> agentIpAndPort,
                                        uint64_t leftOut,
                                        uint64_t interfaceSpeed)
 {
-    auto edgeOpt = findEdgeByAgentIpAndPort(agentIpAndPort);
+    // Counters live in m_linkStats; the shared lock only keeps the edge set stable
+    std::shared_lock lock(*m_graphMutex);
+    auto edgeOpt = findEdgeByAgentIpAndPortNoLock(agentIpAndPort);
     if (!edgeOpt.has_value())
     {
         // SPDLOG_LOGGER_ERROR(Logger::instance(), "Link not found for agentIpAndPort");
         // SPDLOG_LOGGER_ERROR(Logger::instance(),
         //                     "Agent_ip: {}, port: {}",
-        //                     utils::ipToString(agentIpAndPort.first),
+        //                     utils::Ipv4{agentIpAndPort.first},
         //                     agentIpAndPort.second);
         return;
     }
 
     auto edge = edgeOpt.value();
-    auto& edgeProps = (*m_graph)[edge];
+    const auto& edgeProps = (*m_graph)[edge];
 
     auto revEdgeAgentIpAndPort = make_pair(edgeProps.dstIp.front(), edgeProps.dstInterface);
-    auto revEdgeOpt = findEdgeByAgentIpAndPort(revEdgeAgentIpAndPort);
+    auto revEdgeOpt = findEdgeByAgentIpAndPortNoLock(revEdgeAgentIpAndPort);
 
     if (!revEdgeOpt)
     {
@@ -658,19 +886,31 @@ TopologyAndFlowMonitor::updateLinkInfo(pair<uint32_t, uint32_t> agentIpAndPort,
     }
 
     auto revEdge = *revEdgeOpt;
-    auto& revEdgeProps = (*m_graph)[revEdge];
+    const uint32_t revStatsId = (*m_graph)[revEdge].statsId;
+    LinkCongestionChangedEventData changes;
 
     // Edge: from src (agent) to dst
-    edgeProps.leftBandwidth = leftOut; // TX side: how much unused bandwidth remains
-    edgeProps.linkBandwidthUtilization = (1.0 - (double)leftOut / interfaceSpeed) * 100;
-    edgeProps.linkBandwidthUsage = interfaceSpeed - leftOut;
-    edgeProps.linkBandwidth = interfaceSpeed;
+    m_linkStats.modify(edgeProps.statsId, [&](LinkStats& stats) {
+        stats.leftBandwidth = leftOut; // TX side: how much unused bandwidth remains
+        stats.linkBandwidthUtilization = (1.0 - (double)leftOut / interfaceSpeed) * 100;
+        stats.linkBandwidthUsage = interfaceSpeed - leftOut;
+        stats.linkBandwidth = interfaceSpeed;
+        trackUtilization(edge, edgeProps.statsId, stats.linkBandwidthUtilization, changes);
+        m_pathResiduals.update(edgeProps.statsId, leftOut, interfaceSpeed);
+    });
 
     // Reverse Edge: from dst to src
-    revEdgeProps.leftBandwidth = leftIn; // RX side
-    revEdgeProps.linkBandwidthUtilization = (1.0 - (double)leftIn / interfaceSpeed) * 100;
-    revEdgeProps.linkBandwidthUsage = interfaceSpeed - leftIn;
-    revEdgeProps.linkBandwidth = interfaceSpeed;
+    m_linkStats.modify(revStatsId, [&](LinkStats& stats) {
+        stats.leftBandwidth = leftIn; // RX side
+        stats.linkBandwidthUtilization = (1.0 - (double)leftIn / interfaceSpeed) * 100;
+        stats.linkBandwidthUsage = interfaceSpeed - leftIn;
+        stats.linkBandwidth = interfaceSpeed;
+        trackUtilization(revEdge, revStatsId, stats.linkBandwidthUtilization, changes);
+        m_pathResiduals.update(revStatsId, leftIn, interfaceSpeed);
+    });
+
+    lock.unlock();
+    publishCongestion(std::move(changes));
 }
 
 void
@@ -678,147 +918,146 @@ TopologyAndFlowMonitor::updateLinkInfoLeftLinkBandwidth(
     std::pair<uint32_t, uint32_t> agentIpAndPort,
     uint64_t estimatedIn)
 {
-    auto edgeOpt = findEdgeByAgentIpAndPort(agentIpAndPort);
+    std::shared_lock lock(*m_graphMutex);
+    auto edgeOpt = findEdgeByAgentIpAndPortNoLock(agentIpAndPort);
     if (!edgeOpt.has_value())
     {
         SPDLOG_LOGGER_ERROR(Logger::instance(), "Link not found for agentIpAndPort");
         SPDLOG_LOGGER_ERROR(Logger::instance(),
                             "Agent_ip: {}, port: {}",
-                            utils::ipToString(agentIpAndPort.first),
+                            utils::Ipv4{agentIpAndPort.first},
                             agentIpAndPort.second);
         return;
     }
 
     auto edge = edgeOpt.value();
+    const uint32_t statsId = (*m_graph)[edge].statsId;
+    LinkCongestionChangedEventData changes;
 
-    {
-        std::unique_lock lock(*m_graphMutex);
-
-        auto& edgeProps = (*m_graph)[edge];
-
-        uint64_t leftIn =
-            estimatedIn > edgeProps.linkBandwidth ? 0 : edgeProps.linkBandwidth - estimatedIn;
-        edgeProps.leftBandwidthFromFlowSample = leftIn;
-        edgeProps.linkBandwidthUtilization = (1.0 - (double)leftIn / edgeProps.linkBandwidth) * 100;
-        edgeProps.linkBandwidthUsage =
-            leftIn > edgeProps.linkBandwidth ? 0 : edgeProps.linkBandwidth - leftIn;
+    m_linkStats.modify(statsId, [&](LinkStats& stats) {
+        uint64_t leftIn = estimatedIn > stats.linkBandwidth ? 0 : stats.linkBandwidth - estimatedIn;
+        stats.leftBandwidthFromFlowSample = leftIn;
+        stats.linkBandwidthUtilization = (1.0 - (double)leftIn / stats.linkBandwidth) * 100;
+        stats.linkBandwidthUsage = leftIn > stats.linkBandwidth ? 0 : stats.linkBandwidth - leftIn;
 
         SPDLOG_LOGGER_TRACE(
             Logger::instance(),
             "leftBandwidthFromFlowSample {}, linkBandwidthUtilization {}, linkBandwidthUsage {}",
-            edgeProps.leftBandwidthFromFlowSample,
-            edgeProps.linkBandwidthUtilization,
-            edgeProps.linkBandwidthUsage);
+            stats.leftBandwidthFromFlowSample,
+            stats.linkBandwidthUtilization,
+            stats.linkBandwidthUsage);
+        trackUtilization(edge, statsId, stats.linkBandwidthUtilization, changes);
+    });
+
+    lock.unlock();
+    publishCongestion(std::move(changes));
+}
+
+void
+TopologyAndFlowMonitor::trackUtilization(Graph::edge_descriptor e,
+                                         uint32_t statsId,
+                                         double utilization,
+                                         LinkCongestionChangedEventData& changes)
+{
+    if (m_congestion.update(statsId, utilization))
+    {
+        changes.changes.push_back({e, m_congestion.isHotspot(statsId), utilization});
     }
 }
 
-optional<Graph::vertex_descriptor>
-TopologyAndFlowMonitor::findSwitchByDpid(uint64_t dpid) const
+void
+TopologyAndFlowMonitor::publishCongestion(LinkCongestionChangedEventData&& changes)
 {
-    std::shared_lock lock(*m_graphMutex);
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
+    if (changes.changes.empty())
     {
-        if ((*m_graph)[*vi].vertexType == VertexType::SWITCH && (*m_graph)[*vi].dpid == dpid)
-        {
-            return *vi;
-        }
+        return;
     }
-    return nullopt;
+    m_eventBus->channel<LinkCongestionChangedEventData>(EventType::LinkCongestionChanged)
+        .publish(std::move(changes));
+}
+
+optional<Graph::vertex_descriptor>
+TopologyAndFlowMonitor::findSwitchByDpid(uint64_t dpid) const
+{
+    std::shared_lock lock(*m_graphMutex);
+    return findSwitchByDpidNoLock(dpid);
 }
 
 optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findSwitchByDpidNoLock(uint64_t dpid) const
 {
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
-    {
-        if ((*m_graph)[*vi].vertexType == VertexType::SWITCH && (*m_graph)[*vi].dpid == dpid)
-        {
-            return *vi;
-        }
-    }
-    return nullopt;
+    return m_index.switchByDpid(dpid);
 }
 
 optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findVertexByMac(uint64_t mac) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
-    {
-        if ((*m_graph)[*vi].mac == mac)
-        {
-            return *vi;
-        }
-    }
-    return nullopt;
+    return findVertexByMacNoLock(mac);
 }
 
 optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findVertexByMacNoLock(uint64_t mac) const
 {
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
-    {
-        if ((*m_graph)[*vi].mac == mac)
-        {
-            return *vi;
-        }
-    }
-    return nullopt;
+    return m_index.vertexByMac(mac);
 }
 
 optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findVertexByMininetBridgeName(const std::string& mininetBridgeName) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
-    {
-        if ((*m_graph)[*vi].bridgeNameForMininet == mininetBridgeName)
-        {
-            return *vi;
-        }
-    }
-    return nullopt;
+    return findVertexByMininetBridgeNameNoLock(mininetBridgeName);
 }
 
 optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findVertexByMininetBridgeNameNoLock(
     const std::string& mininetBridgeName) const
 {
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
-    {
-        if ((*m_graph)[*vi].bridgeNameForMininet == mininetBridgeName)
-        {
-            return *vi;
-        }
-    }
-    return nullopt;
+    return m_index.vertexByMininetBridgeName(mininetBridgeName);
 }
 
 optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findVertexByDeviceName(const std::string& deviceName) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
+    return findVertexByDeviceNameNoLock(deviceName);
+}
+
+optional<Graph::vertex_descriptor>
+TopologyAndFlowMonitor::findVertexByDeviceNameNoLock(const std::string& deviceName) const
+{
+    return m_index.vertexByDeviceName(deviceName);
+}
+
+std::vector<std::optional<uint32_t>>
+TopologyAndFlowMonitor::getIpsByDeviceName(const std::vector<std::string>& names) const
+{
+    std::vector<std::optional<uint32_t>> ips(names.size());
+    std::shared_lock lock(*m_graphMutex);
+    for (size_t i = 0; i < names.size(); ++i)
     {
-        if ((*m_graph)[*vi].deviceName == deviceName)
+        auto v = m_index.vertexByDeviceName(names[i]);
+        if (v && !(*m_graph)[*v].ip.empty())
         {
-            return *vi;
+            ips[i] = (*m_graph)[*v].ip.front();
         }
     }
-    return nullopt;
+    return ips;
 }
 
-optional<Graph::vertex_descriptor>
-TopologyAndFlowMonitor::findVertexByDeviceNameNoLock(const std::string& deviceName) const
+std::vector<std::string>
+TopologyAndFlowMonitor::getSwitchNamesByDpid(const std::vector<uint64_t>& dpids) const
 {
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
+    std::vector<std::string> names(dpids.size());
+    std::shared_lock lock(*m_graphMutex);
+    for (size_t i = 0; i < dpids.size(); ++i)
     {
-        if ((*m_graph)[*vi].deviceName == deviceName)
+        if (auto v = m_index.switchByDpid(dpids[i]))
         {
-            return *vi;
+            names[i] = (*m_graph)[*v].deviceName;
         }
     }
-    return nullopt;
+    return names;
 }
 
 optional<Graph::edge_descriptor>
@@ -826,39 +1065,14 @@ TopologyAndFlowMonitor::findEdgeByAgentIpAndPort(
     const pair<uint32_t, uint32_t>& agentIpAndPort) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.srcIp.front() == agentIpAndPort.first and
-            props.srcInterface == agentIpAndPort.second)
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return findEdgeByAgentIpAndPortNoLock(agentIpAndPort);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findReverseEdgeByAgentIpAndPortNoLock(
     const pair<uint32_t, uint32_t>& agentIpAndPort) const
 {
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.srcIp.front() == agentIpAndPort.first and
-            props.srcInterface == agentIpAndPort.second)
-        {
-            auto sourceNode = boost::source(edge, *m_graph);
-            auto targetNode = boost::target(edge, *m_graph);
-            auto reverseEdge = boost::edge(targetNode, sourceNode, *m_graph).first;
-            return reverseEdge;
-        }
-    }
-    return nullopt;
+    return m_index.reverseEdgeByAgentIpAndPort(agentIpAndPort.first, agentIpAndPort.second);
 }
 
 optional<Graph::edge_descriptor>
@@ -866,109 +1080,49 @@ TopologyAndFlowMonitor::findReverseEdgeByAgentIpAndPort(
     const pair<uint32_t, uint32_t>& agentIpAndPort) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.srcIp.front() == agentIpAndPort.first and
-            props.srcInterface == agentIpAndPort.second)
-        {
-            auto sourceNode = boost::source(edge, *m_graph);
-            auto targetNode = boost::target(edge, *m_graph);
-            auto reverseEdge = boost::edge(targetNode, sourceNode, *m_graph).first;
-            return reverseEdge;
-        }
-    }
-    return nullopt;
+    return findReverseEdgeByAgentIpAndPortNoLock(agentIpAndPort);
+}
+
+optional<Graph::edge_descriptor>
+TopologyAndFlowMonitor::findReverseEdge(Graph::edge_descriptor e) const
+{
+    std::shared_lock lock(*m_graphMutex);
+    return m_index.reverseEdgeByStatsId((*m_graph)[e].statsId);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeByAgentIpAndPortNoLock(
     const pair<uint32_t, uint32_t>& agentIpAndPort) const
 {
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.srcIp.front() == agentIpAndPort.first and
-            props.srcInterface == agentIpAndPort.second)
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return m_index.edgeByAgentIpAndPort(agentIpAndPort.first, agentIpAndPort.second);
 }
 
 std::optional<std::pair<uint32_t, uint32_t>>
 TopologyAndFlowMonitor::getAgentKeyFromTheOtherSide(
     const std::pair<uint32_t, uint32_t>& agentIpAndPort) const
-
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.dstIp.front() == agentIpAndPort.first and
-            props.dstInterface == agentIpAndPort.second)
-        {
-            return make_pair(props.srcIp.front(), props.srcInterface);
-        }
-    }
-    return nullopt;
+    return getAgentKeyFromTheOtherSideNoLock(agentIpAndPort);
 }
 
 std::optional<std::pair<uint32_t, uint32_t>>
 TopologyAndFlowMonitor::getAgentKeyFromTheOtherSideNoLock(
     const std::pair<uint32_t, uint32_t>& agentIpAndPort) const
-
 {
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.dstIp.front() == agentIpAndPort.first and
-            props.dstInterface == agentIpAndPort.second)
-        {
-            return make_pair(props.srcIp.front(), props.srcInterface);
-        }
-    }
-    return nullopt;
+    return m_index.otherSideOfAgentPort(agentIpAndPort.first, agentIpAndPort.second);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeByDpidAndPort(pair<uint64_t, uint32_t> dpid_and_port) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto [ei, eiEnd] = boost::edges(*m_graph); ei != eiEnd; ++ei)
-    {
-        const auto& eprop = (*m_graph)[*ei];
-
-        if (eprop.srcDpid == dpid_and_port.first && eprop.srcInterface == dpid_and_port.second)
-        {
-            return *ei;
-        }
-    }
-    return nullopt;
+    return findEdgeByDpidAndPortNoLock(dpid_and_port);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeByDpidAndPortNoLock(pair<uint64_t, uint32_t> dpid_and_port) const
 {
-    for (auto [ei, eiEnd] = boost::edges(*m_graph); ei != eiEnd; ++ei)
-    {
-        const auto& eprop = (*m_graph)[*ei];
-
-        if (eprop.srcDpid == dpid_and_port.first && eprop.srcInterface == dpid_and_port.second)
-        {
-            return *ei;
-        }
-    }
-    return nullopt;
+    return m_index.edgeByDpidAndPort(dpid_and_port.first, dpid_and_port.second);
 }
 
 optional<Graph::edge_descriptor>
@@ -976,19 +1130,7 @@ TopologyAndFlowMonitor::findEdgeBySrcAndDstDpid(
     pair<uint64_t, uint64_t> src_dpid_and_dst_dpid) const
 {
     std::shared_lock lock(*m_graphMutex);
-    SPDLOG_LOGGER_TRACE(Logger::instance(),
-                        "Enter TopologyAndFlowMonitor::findEdgeBySrcAndDstDpid");
-    for (auto [ei, eiEnd] = boost::edges(*m_graph); ei != eiEnd; ++ei)
-    {
-        const auto& eprop = (*m_graph)[*ei];
-
-        if (eprop.srcDpid == src_dpid_and_dst_dpid.first &&
-            eprop.dstDpid == src_dpid_and_dst_dpid.second)
-        {
-            return *ei;
-        }
-    }
-    return nullopt;
+    return findEdgeBySrcAndDstDpidNoLock(src_dpid_and_dst_dpid);
 }
 
 optional<Graph::edge_descriptor>
@@ -997,159 +1139,162 @@ TopologyAndFlowMonitor::findEdgeBySrcAndDstDpidNoLock(
 {
     SPDLOG_LOGGER_TRACE(Logger::instance(),
                         "Enter TopologyAndFlowMonitor::findEdgeBySrcAndDstDpid");
-    for (auto [ei, eiEnd] = boost::edges(*m_graph); ei != eiEnd; ++ei)
-    {
-        const auto& eprop = (*m_graph)[*ei];
-
-        if (eprop.srcDpid == src_dpid_and_dst_dpid.first &&
-            eprop.dstDpid == src_dpid_and_dst_dpid.second)
-        {
-            return *ei;
-        }
-    }
-    return nullopt;
+    return m_index.edgeBySrcAndDstDpid(src_dpid_and_dst_dpid.first, src_dpid_and_dst_dpid.second);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeByHostIp(uint32_t hostIp) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (find(props.srcIp.begin(), props.srcIp.end(), hostIp) != props.srcIp.end())
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return findEdgeByHostIpNoLock(hostIp);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findReverseEdgeByHostIp(uint32_t hostIp) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (find(props.dstIp.begin(), props.dstIp.end(), hostIp) != props.dstIp.end())
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return m_index.edgeByDstIp(hostIp);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeByHostIpNoLock(uint32_t hostIp) const
 {
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (find(props.srcIp.begin(), props.srcIp.end(), hostIp) != props.srcIp.end())
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return m_index.edgeBySrcIp(hostIp);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeByHostIp(vector<uint32_t> hostIp) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.srcIp == hostIp)
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return findEdgeByHostIpNoLock(std::move(hostIp));
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findReverseEdgeByHostIp(vector<uint32_t> hostIp) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.dstIp == hostIp)
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return m_index.edgeByDstIps(hostIp);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeByHostIpNoLock(vector<uint32_t> hostIp) const
 {
-    for (auto edgeIt = boost::edges(*m_graph).first; edgeIt != boost::edges(*m_graph).second;
-         ++edgeIt)
-    {
-        auto edge = *edgeIt;
-        const auto& props = (*m_graph)[edge];
-        if (props.srcIp == hostIp)
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return m_index.edgeBySrcIps(hostIp);
+}
+
+optional<TopologyIndex::HostAttachment>
+TopologyAndFlowMonitor::findHostAttachment(uint32_t hostIp) const
+{
+    std::shared_lock lock(*m_graphMutex);
+    return findHostAttachmentNoLock(hostIp);
+}
+
+optional<TopologyIndex::HostAttachment>
+TopologyAndFlowMonitor::findHostAttachmentNoLock(uint32_t hostIp) const
+{
+    return m_index.hostAttachment(hostIp);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeBySrcAndDstIp(uint32_t src_ip, uint32_t dst_ip) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (const auto& edge : boost::make_iterator_range(boost::edges(*m_graph)))
-    {
-        const auto& props = (*m_graph)[edge];
-        auto itSrc = find(props.srcIp.begin(), props.srcIp.end(), src_ip);
-        auto itDst = find(props.dstIp.begin(), props.dstIp.end(), dst_ip);
-        if (itSrc != props.srcIp.end() && itDst != props.dstIp.end())
-        {
-            return edge;
-        }
-    }
-    return nullopt;
+    return findEdgeBySrcAndDstIpNoLock(src_ip, dst_ip);
 }
 
 optional<Graph::edge_descriptor>
 TopologyAndFlowMonitor::findEdgeBySrcAndDstIpNoLock(uint32_t src_ip, uint32_t dst_ip) const
 {
-    for (const auto& edge : boost::make_iterator_range(boost::edges(*m_graph)))
+    return m_index.edgeBySrcAndDstIp(src_ip, dst_ip);
+}
+
+TopologyAndFlowMonitor::GraphTransaction::GraphTransaction(TopologyAndFlowMonitor& monitor)
+    : m_monitor(&monitor),
+      m_lock(monitor.lockGraphForWrite())
+{
+}
+
+TopologyAndFlowMonitor::GraphTransaction::~GraphTransaction()
+{
+    if (m_lock.owns_lock())
     {
-        const auto& props = (*m_graph)[edge];
-        auto itSrc = find(props.srcIp.begin(), props.srcIp.end(), src_ip);
-        auto itDst = find(props.dstIp.begin(), props.dstIp.end(), dst_ip);
-        if (itSrc != props.srcIp.end() && itDst != props.dstIp.end())
-        {
-            return edge;
-        }
+        commit();
+    }
+}
+
+void
+TopologyAndFlowMonitor::GraphTransaction::setEdgeUp(Graph::edge_descriptor e, bool up)
+{
+    if ((*m_monitor->m_graph)[e].isUp != up)
+    {
+        m_changes.changes.push_back({e, up});
+    }
+    if (up)
+    {
+        m_monitor->setEdgeUpNoLock(e);
+    }
+    else
+    {
+        m_monitor->setEdgeDownNoLock(e);
+    }
+}
+
+void
+TopologyAndFlowMonitor::GraphTransaction::setEdgeEnabled(Graph::edge_descriptor e, bool enabled)
+{
+    (*m_monitor->m_graph)[e].isEnabled = enabled;
+}
+
+void
+TopologyAndFlowMonitor::GraphTransaction::setVertexUp(Graph::vertex_descriptor v, bool up)
+{
+    (*m_monitor->m_graph)[v].isUp = up;
+}
+
+void
+TopologyAndFlowMonitor::GraphTransaction::setVertexEnabled(Graph::vertex_descriptor v,
+                                                           bool enabled)
+{
+    (*m_monitor->m_graph)[v].isEnabled = enabled;
+}
+
+void
+TopologyAndFlowMonitor::GraphTransaction::setVertexDeviceName(Graph::vertex_descriptor v,
+                                                              std::string name)
+{
+    (*m_monitor->m_graph)[v].deviceName = std::move(name);
+    m_rebuildIndex = true;
+}
+
+void
+TopologyAndFlowMonitor::GraphTransaction::setVertexNickname(Graph::vertex_descriptor v,
+                                                            std::string name)
+{
+    (*m_monitor->m_graph)[v].nickName = std::move(name);
+}
+
+LinkStateChangedEventData
+TopologyAndFlowMonitor::GraphTransaction::commit()
+{
+    if (m_rebuildIndex)
+    {
+        m_monitor->rebuildIndexNoLock();
+        m_rebuildIndex = false;
     }
-    return nullopt;
+    m_lock.unlock();
+    return std::move(m_changes);
+}
+
+TopologyAndFlowMonitor::GraphTransaction
+TopologyAndFlowMonitor::beginGraphTransaction()
+{
+    return GraphTransaction(*this);
 }
 
 void
 TopologyAndFlowMonitor::setEdgeDown(Graph::edge_descriptor e)
 {
-    // TODO[OPTIMIZE]: Use atomic<bool> in data structure
-    std::unique_lock lock(*m_graphMutex);
-    (*m_graph)[e].isUp = false;
-    SPDLOG_LOGGER_DEBUG(Logger::instance(), "setEdgeDown {}", (*m_graph)[e].isUp);
+    beginGraphTransaction().setEdgeUp(e, false);
 }
 
 void
@@ -1157,16 +1302,14 @@ TopologyAndFlowMonitor::setEdgeDownNoLock(Graph::edge_descriptor e)
 {
     // TODO[OPTIMIZE]: Use atomic<bool> in data structure
     (*m_graph)[e].isUp = false;
+    m_linkStats.setUp((*m_graph)[e].statsId, false);
     SPDLOG_LOGGER_DEBUG(Logger::instance(), "setEdgeDownNoLock {}", (*m_graph)[e].isUp);
 }
 
 void
 TopologyAndFlowMonitor::setEdgeUp(Graph::edge_descriptor e)
 {
-    // TODO[OPTIMIZE]: Use atomic<bool> in data structure
-    std::unique_lock lock(*m_graphMutex);
-    (*m_graph)[e].isUp = true;
-    SPDLOG_LOGGER_DEBUG(Logger::instance(), "setEdgeUp {}", (*m_graph)[e].isUp);
+    beginGraphTransaction().setEdgeUp(e, true);
 }
 
 void
@@ -1174,15 +1317,14 @@ TopologyAndFlowMonitor::setEdgeUpNoLock(Graph::edge_descriptor e)
 {
     // TODO[OPTIMIZE]: Use atomic<bool> in data structure
     (*m_graph)[e].isUp = true;
+    m_linkStats.setUp((*m_graph)[e].statsId, true);
     SPDLOG_LOGGER_DEBUG(Logger::instance(), "setEdgeUpNoLock {}", (*m_graph)[e].isUp);
 }
 
 void
 TopologyAndFlowMonitor::setEdgeEnable(Graph::edge_descriptor e)
 {
-    // TODO[OPTIMIZE]: Use atomic<bool> in data structure
-    std::unique_lock lock(*m_graphMutex);
-    (*m_graph)[e].isEnabled = true;
+    beginGraphTransaction().setEdgeEnabled(e, true);
 }
 
 void
@@ -1195,9 +1337,7 @@ TopologyAndFlowMonitor::setEdgeEnableNoLock(Graph::edge_descriptor e)
 void
 TopologyAndFlowMonitor::setEdgeDisable(Graph::edge_descriptor e)
 {
-    // TODO[OPTIMIZE]: Use atomic<bool> in data structure
-    std::unique_lock lock(*m_graphMutex);
-    (*m_graph)[e].isEnabled = false;
+    beginGraphTransaction().setEdgeEnabled(e, false);
 }
 
 void
@@ -1211,61 +1351,144 @@ pair<uint64_t, uint32_t>
 TopologyAndFlowMonitor::getEdgeStats(Graph::edge_descriptor e) const
 {
     std::shared_lock lock(*m_graphMutex);
-    const auto& edgeProps = (*m_graph)[e];
-    return {m_mode == utils::MININET ? edgeProps.leftBandwidthFromFlowSample
-                                     : edgeProps.leftBandwidth,
-            edgeProps.flowSet.size()};
+    return getEdgeStatsNoLock(e);
 }
 
 pair<uint64_t, uint32_t>
 TopologyAndFlowMonitor::getEdgeStatsNoLock(Graph::edge_descriptor e) const
 {
     const auto& edgeProps = (*m_graph)[e];
-    return {m_mode == utils::MININET ? edgeProps.leftBandwidthFromFlowSample
-                                     : edgeProps.leftBandwidth,
-            edgeProps.flowSet.size()};
+    LinkStats stats = m_linkStats.read(edgeProps.statsId);
+    return {m_mode == utils::MININET ? stats.leftBandwidthFromFlowSample : stats.leftBandwidth,
+            m_edgeFlows.count(edgeProps.statsId)};
 }
 
 
+std::optional<SwitchLoad>
+TopologyAndFlowMonitor::getSwitchLoad(uint64_t dpid) const
+{
+    std::shared_lock lock(*m_graphMutex);
+    auto v = findSwitchByDpidNoLock(dpid);
+    if (!v)
+    {
+        return std::nullopt;
+    }
+    return SwitchLoad{.ingressBps = m_linkStats.ingressLoad(*v),
+                      .egressBps = m_linkStats.egressLoad(*v),
+                      .flows = m_edgeFlows.flowsInto(*v)};
+}
+
 std::set<sflow::FlowKey>
 TopologyAndFlowMonitor::getEdgeFlowSet(Graph::edge_descriptor e) const
 {
     std::shared_lock<std::shared_mutex> lock(*m_graphMutex);
-    std::set<sflow::FlowKey> out;
-    const auto& mp = (*m_graph)[e].flowSet; // unordered_map<FlowKey, TimePoint>
-    for (const auto& kv : mp)
-    {
-        out.insert(kv.first);
-    }
-    return out;
+    return getEdgeFlowSetNoLock(e);
 }
 
 std::set<sflow::FlowKey>
 TopologyAndFlowMonitor::getEdgeFlowSetNoLock(Graph::edge_descriptor e) const
 {
-    std::set<sflow::FlowKey> out;
-    const auto& mp = (*m_graph)[e].flowSet; // unordered_map<FlowKey, TimePoint>
-    for (const auto& kv : mp)
-    {
-        out.insert(kv.first);
-    }
-    return out;
+    return m_edgeFlows.flows((*m_graph)[e].statsId);
 }
 
 Graph
 TopologyAndFlowMonitor::getGraph() const
 {
     std::shared_lock lock(*m_graphMutex);
-    return *m_graph;
+    Graph copy = *m_graph;
+    m_linkStats.materialize(copy);
+    m_edgeFlows.materialize(copy);
+    return copy;
 }
 
-void
-TopologyAndFlowMonitor::setVertexDeviceName(Graph::vertex_descriptor v, std::string name)
+std::string
+GraphSnapshot::versionToken() const
+{
+    return std::to_string(version) + "-" + std::to_string(statsEpoch) + "-" +
+           std::to_string(flowsEpoch);
+}
+
+bool
+GraphSnapshot::edgeChangedSince(const EdgeProperties& edge,
+                                uint64_t sinceStatsEpoch,
+                                uint64_t sinceFlowsEpoch) const
+{
+    auto stampOf = [&](const std::vector<uint64_t>& stamps) {
+        // Edges without a stamp are reported as changed
+        return edge.statsId < stamps.size() ? stamps[edge.statsId] : UINT64_MAX;
+    };
+    return stampOf(statsModifiedAt) > sinceStatsEpoch ||
+           stampOf(flowsModifiedAt) > sinceFlowsEpoch;
+}
+
+std::shared_ptr<const GraphSnapshot>
+TopologyAndFlowMonitor::getGraphSnapshot() const
+{
+    std::lock_guard guard(m_snapshotMutex);
+    if (m_snapshot && m_snapshot->version == m_graphVersion.load(std::memory_order_acquire) &&
+        m_snapshot->statsEpoch == m_linkStats.epoch() &&
+        m_snapshot->flowsEpoch == m_edgeFlows.epoch())
+    {
+        return m_snapshot;
+    }
+
+    auto snapshot = std::make_shared<GraphSnapshot>();
+    {
+        std::shared_lock lock(*m_graphMutex);
+        // Writers bump the version while holding the unique lock, so it is stable here
+        snapshot->version = m_graphVersion.load(std::memory_order_acquire);
+        // Read the epoch first: a concurrent counter update then only makes the copy look stale
+        snapshot->statsEpoch = m_linkStats.epoch();
+        snapshot->flowsEpoch = m_edgeFlows.epoch();
+        snapshot->graph = *m_graph;
+        m_linkStats.materialize(snapshot->graph);
+        m_edgeFlows.materialize(snapshot->graph);
+        m_linkStats.modifiedAt(snapshot->statsModifiedAt);
+        m_edgeFlows.modifiedAt(snapshot->flowsModifiedAt);
+    }
+    snapshot->csr = CsrGraph::build(snapshot->graph);
+    snapshot->takenAt = std::chrono::steady_clock::now();
+    m_snapshot = std::move(snapshot);
+    return m_snapshot;
+}
+
+std::shared_ptr<const GraphSnapshot>
+TopologyAndFlowMonitor::getGraphSnapshot(std::chrono::milliseconds maxAge) const
 {
     {
-        std::unique_lock lock(*m_graphMutex);
-        (*m_graph)[v].deviceName = name;
+        std::lock_guard guard(m_snapshotMutex);
+        if (m_snapshot && std::chrono::steady_clock::now() - m_snapshot->takenAt < maxAge)
+        {
+            return m_snapshot;
+        }
     }
+    return getGraphSnapshot();
+}
+
+uint64_t
+TopologyAndFlowMonitor::getGraphVersion() const
+{
+    return m_graphVersion.load(std::memory_order_acquire);
+}
+
+uint64_t
+TopologyAndFlowMonitor::getIndexVersion() const
+{
+    return m_indexVersion.load(std::memory_order_acquire);
+}
+
+std::unique_lock<std::shared_mutex>
+TopologyAndFlowMonitor::lockGraphForWrite()
+{
+    std::unique_lock lock(*m_graphMutex);
+    m_graphVersion.fetch_add(1, std::memory_order_acq_rel);
+    return lock;
+}
+
+void
+TopologyAndFlowMonitor::setVertexDeviceName(Graph::vertex_descriptor v, std::string name)
+{
+    beginGraphTransaction().setVertexDeviceName(v, name);
 
     // Also modify configuration file
     {
@@ -1275,11 +1498,11 @@ TopologyAndFlowMonitor::setVertexDeviceName(Graph::vertex_descriptor v, std::str
             std::ifstream ifs;
             if (m_mode == utils::DeploymentMode::MININET)
             {
-                ifs.open(TOPOLOGY_FILE_MININET);
+                ifs.open(topologyFileMininet());
             }
             else
             {
-                ifs.open(TOPOLOGY_FILE);
+                ifs.open(topologyFile());
             }
             if (!ifs.is_open())
             {
@@ -1327,8 +1550,8 @@ TopologyAndFlowMonitor::setVertexDeviceName(Graph::vertex_descriptor v, std::str
             throw std::runtime_error("No matching node in JSON");
         }
 
-        const auto tmp = m_mode == utils::DeploymentMode::TESTBED ? TOPOLOGY_FILE
-                                                                  : TOPOLOGY_FILE_MININET + ".tmp";
+        const auto tmp = m_mode == utils::DeploymentMode::TESTBED ? topologyFile()
+                                                                  : topologyFileMininet() + ".tmp";
         {
             std::ofstream ofs(tmp);
             if (!ofs.is_open())
@@ -1338,8 +1561,8 @@ TopologyAndFlowMonitor::setVertexDeviceName(Graph::vertex_descriptor v, std::str
             ofs << std::setw(2) << j << std::endl;
         }
         std::filesystem::rename(tmp,
-                                m_mode == utils::DeploymentMode::TESTBED ? TOPOLOGY_FILE
-                                                                         : TOPOLOGY_FILE_MININET);
+                                m_mode == utils::DeploymentMode::TESTBED ? topologyFile()
+                                                                         : topologyFileMininet());
     }
 }
 
@@ -1348,10 +1571,7 @@ TopologyAndFlowMonitor::setVertexNickname(Graph::vertex_descriptor v, std::strin
 {
     // 1. Update the nickname for the device in the live, in-memory graph.
     // This is protected by a mutex for thread safety.
-    {
-        std::unique_lock lock(*m_graphMutex);
-        (*m_graph)[v].nickName = nickname;
-    }
+    beginGraphTransaction().setVertexNickname(v, nickname);
 
     // 2. Update the nickname in the persistent JSON configuration file.
     {
@@ -1363,11 +1583,11 @@ TopologyAndFlowMonitor::setVertexNickname(Graph::vertex_descriptor v, std::strin
             std::ifstream ifs;
             if (m_mode == utils::DeploymentMode::MININET)
             {
-                ifs.open(TOPOLOGY_FILE_MININET);
+                ifs.open(topologyFileMininet());
             }
             else
             {
-                ifs.open(TOPOLOGY_FILE);
+                ifs.open(topologyFile());
             }
             if (!ifs.is_open())
             {
@@ -1416,8 +1636,8 @@ TopologyAndFlowMonitor::setVertexNickname(Graph::vertex_descriptor v, std::strin
         }
 
         // Safely write the modified JSON data back to the file.
-        const auto tmp = m_mode == utils::DeploymentMode::TESTBED ? TOPOLOGY_FILE
-                                                                  : TOPOLOGY_FILE_MININET + ".tmp";
+        const auto tmp = m_mode == utils::DeploymentMode::TESTBED ? topologyFile()
+                                                                  : topologyFileMininet() + ".tmp";
         {
             std::ofstream ofs(tmp);
             if (!ofs.is_open())
@@ -1427,17 +1647,28 @@ TopologyAndFlowMonitor::setVertexNickname(Graph::vertex_descriptor v, std::strin
             ofs << std::setw(2) << j << std::endl;
         }
         std::filesystem::rename(tmp,
-                                m_mode == utils::DeploymentMode::TESTBED ? TOPOLOGY_FILE
-                                                                         : TOPOLOGY_FILE_MININET);
+                                m_mode == utils::DeploymentMode::TESTBED ? topologyFile()
+                                                                         : topologyFileMininet());
     }
 }
 
 void
 TopologyAndFlowMonitor::run()
 {
+    utils::ThreadRegistry::Scope thread("topology");
     SPDLOG_LOGGER_INFO(Logger::instance(), "TopologyAndFlowMonitor Run");
 
-    fetchAndUpdateTopologyData();
+    // Read static network topology
+    if (m_mode == utils::TESTBED)
+    {
+        loadStaticTopology(topologyFile());
+    }
+    else if (m_mode == utils::MININET)
+    {
+        loadStaticTopology(topologyFileMininet());
+    }
+
+    resyncFromController();
 
     SPDLOG_LOGGER_INFO(Logger::instance(), "Exiting TopologyAndFlowMonitor's updating");
 }
@@ -1445,131 +1676,143 @@ TopologyAndFlowMonitor::run()
 vector<sflow::Path>
 TopologyAndFlowMonitor::getAllPathsBetweenTwoHosts(sflow::FlowKey flow_key,
                                                    uint64_t src_sw_dpid,
-                                                   uint64_t dst_sw_dpid)
-{
-    SPDLOG_LOGGER_INFO(Logger::instance(), "DFS Ready");
-    vector<sflow::Path> paths;
-    shared_lock lock(*m_graphMutex);
-
-    // 1. Locate source and destination switch vertices
-    Graph::vertex_descriptor src_v, dst_v;
-
-    auto srcVertexOpt = findSwitchByDpidNoLock(src_sw_dpid);
-    auto dstVertexOpt = findSwitchByDpidNoLock(dst_sw_dpid);
+                                                   uint64_t dst_sw_dpid)
+{
+    CandidatePathOptions options;
+    options.k = ALL_PATHS_DEFAULT_MAX_PATHS;
+    options.search = PathSearch::ALL_SIMPLE;
+    return getCandidatePaths(flow_key, src_sw_dpid, dst_sw_dpid, options);
+}
 
-    if (!srcVertexOpt or !dstVertexOpt)
+vector<sflow::Path>
+TopologyAndFlowMonitor::getCandidatePaths(const sflow::FlowKey& flowKey,
+                                          uint64_t swDpid,
+                                          uint64_t dstSwDpid,
+                                          const CandidatePathOptions& options)
+{
+    auto switchPaths = m_candidatePaths.find(getGraphVersion(), swDpid, dstSwDpid, options);
+    if (!switchPaths)
     {
-        SPDLOG_LOGGER_ERROR(Logger::instance(), "Cannot Find Certain Switches");
-        return paths;
+        auto srcVertexOpt = findSwitchByDpid(swDpid);
+        auto dstVertexOpt = findSwitchByDpid(dstSwDpid);
+        if (!srcVertexOpt || !dstVertexOpt)
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "Cannot Find Certain Switches");
+            return {};
+        }
+        // Vertices are never removed, so live descriptors are valid in the snapshot
+        auto snapshot = getGraphSnapshot();
+        switchPaths =
+            options.search == PathSearch::ALL_SIMPLE
+                ? allSimpleSwitchPaths(snapshot->csr, *srcVertexOpt, *dstVertexOpt, options)
+                : kShortestSwitchPaths(snapshot->csr, *srcVertexOpt, *dstVertexOpt, options);
+        m_candidatePaths.insert(snapshot->version, swDpid, dstSwDpid, options, *switchPaths);
     }
 
-    src_v = *srcVertexOpt;
-    dst_v = *dstVertexOpt;
-
-    // 2. Prepare for DFS
-    unordered_set<Graph::vertex_descriptor> visited;
-    visited.reserve(boost::num_vertices(*m_graph));
+    vector<sflow::Path> paths;
+    paths.reserve(switchPaths->size());
+    for (auto& hops : *switchPaths)
+    {
+        sflow::Path path;
+        path.reserve(hops.size() + 2);
+        path.emplace_back(flowKey.srcIP, 0U);
+        path.insert(path.end(), hops.begin(), hops.end());
+        path.emplace_back(flowKey.dstIP, 0U);
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
 
-    sflow::Path current_path;
-    current_path.push_back({flow_key.srcIP, 0U});
+json
+TopologyAndFlowMonitor::getCandidatePathCacheStatsJson() const
+{
+    return m_candidatePaths.statsJson();
+}
 
-    // 3. Recursive DFS lambda
-    function<void(Graph::vertex_descriptor)> dfs = [&](Graph::vertex_descriptor u) {
-        if (u == dst_v)
+std::vector<std::optional<uint64_t>>
+TopologyAndFlowMonitor::getPathResiduals(const std::vector<sflow::PathHandle>& paths)
+{
+    std::vector<std::optional<uint64_t>> residuals(paths.size());
+    std::vector<std::pair<PathResidualCache::EdgeId, uint64_t>> edges;
+    // Writers bump the version under the unique lock, so it is stable while this one is held
+    std::shared_lock lock(*m_graphMutex);
+    const uint64_t version = m_graphVersion.load(std::memory_order_acquire);
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        const sflow::PathHandle& path = paths[i];
+        if (path.empty())
         {
-            // Found a full path—store a copy
-            current_path.push_back({dst_sw_dpid, 0U});
-            current_path.push_back({flow_key.dstIP, 0U});
-            paths.push_back(current_path);
-            current_path.pop_back();
-            current_path.pop_back();
-            return;
+            continue;
         }
-        visited.insert(u);
-
-        // Explore all outgoing edges
-        auto [ei, eiEnd] = boost::out_edges(u, *m_graph);
-
-        for (; ei != eiEnd; ++ei)
+        residuals[i] = m_pathResiduals.find(version, path);
+        if (residuals[i])
         {
-            auto e = *ei;
-            auto v = boost::target(e, *m_graph);
-            if (visited.count(v))
+            continue;
+        }
+
+        edges.clear();
+        std::optional<uint64_t> residual;
+        auto visit = [&](std::optional<Graph::edge_descriptor> e) {
+            if (!e)
             {
-                continue;
+                return;
             }
-
-            const auto& ep = (*m_graph)[e];
-            // Only traverse the active and enabled links
-            if (ep.isUp && ep.isEnabled)
+            const EdgeProperties& props = (*m_graph)[*e];
+            // Generation first: a change after this read makes the entry stale, not wrong
+            edges.emplace_back(props.statsId, m_pathResiduals.generation(props.statsId));
+            const uint64_t left =
+                props.isUp && props.isEnabled ? m_linkStats.read(props.statsId).leftBandwidth : 0;
+            residual = std::min(residual.value_or(left), left);
+        };
+        size_t hop = 0;
+        for (const auto [node, port] : path)
+        {
+            std::optional<Graph::edge_descriptor> e = findEdgeByDpidAndPortNoLock({node, port});
+            if (!e && hop == 0 && node <= UINT32_MAX)
             {
-                current_path.push_back({ep.srcDpid, ep.srcInterface});
-                dfs(v);
-                current_path.pop_back();
+                e = findEdgeByHostIpNoLock(static_cast<uint32_t>(node));
             }
+            visit(e);
+            ++hop;
         }
-        visited.erase(u);
-    };
-
-    // 4. Kick off the search
-    SPDLOG_LOGGER_INFO(Logger::instance(), "DFS Start");
-    dfs(src_v);
-
-    string paths_str;
-    for (auto path : paths)
-    {
-        for (auto node : path)
+        if (residual)
         {
-            paths_str += "(" + to_string(node.first) + "," + to_string(node.second) + ") ";
+            m_pathResiduals.insert(version, path, *residual, edges);
         }
-        paths_str += "| ";
+        residuals[i] = residual;
     }
+    return residuals;
+}
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "{}", paths_str);
-    return paths;
+json
+TopologyAndFlowMonitor::getPathResidualCacheStatsJson() const
+{
+    return m_pathResiduals.statsJson();
 }
 
 optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findSwitchByIp(uint32_t ip) const
 {
     std::shared_lock lock(*m_graphMutex);
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
-    {
-        const auto& vprop = (*m_graph)[*vi];
-        if (vprop.vertexType == VertexType::SWITCH && vprop.ip.front() == ip)
-        {
-            return *vi;
-        }
-    }
-    return nullopt;
+    return findSwitchByIpNoLock(ip);
 }
 
 optional<Graph::vertex_descriptor>
 TopologyAndFlowMonitor::findSwitchByIpNoLock(uint32_t ip) const
 {
-    for (auto [vi, viEnd] = boost::vertices(*m_graph); vi != viEnd; ++vi)
-    {
-        const auto& vprop = (*m_graph)[*vi];
-        if (vprop.vertexType == VertexType::SWITCH && vprop.ip.front() == ip)
-        {
-            return *vi;
-        }
-    }
-    return nullopt;
+    return m_index.switchByIp(ip);
 }
 
 void
 TopologyAndFlowMonitor::setVertexDown(Graph::vertex_descriptor v)
 {
-    unique_lock lock(*m_graphMutex);
-    (*m_graph)[v].isUp = false;
+    beginGraphTransaction().setVertexUp(v, false);
 }
 
 void
 TopologyAndFlowMonitor::setVertexUp(Graph::vertex_descriptor v)
 {
-    unique_lock lock(*m_graphMutex);
-    (*m_graph)[v].isUp = true;
+    beginGraphTransaction().setVertexUp(v, true);
 }
 
 bool
@@ -1590,7 +1833,7 @@ void
 TopologyAndFlowMonitor::setMininetBridgePorts(Graph::vertex_descriptor v,
                                               std::vector<std::string> ports)
 {
-    unique_lock lock(*m_graphMutex);
+    auto lock = lockGraphForWrite();
     (*m_graph)[v].bridgeConnectedPortsForMininet = ports;
 }
 
@@ -1604,73 +1847,55 @@ TopologyAndFlowMonitor::getMininetBridgePorts(Graph::vertex_descriptor v)
 void
 TopologyAndFlowMonitor::setVertexEnable(Graph::vertex_descriptor v)
 {
-    unique_lock lock(*m_graphMutex);
-    (*m_graph)[v].isEnabled = true;
+    beginGraphTransaction().setVertexEnabled(v, true);
 }
 
 void
 TopologyAndFlowMonitor::setVertexDisable(Graph::vertex_descriptor v)
 {
-    unique_lock lock(*m_graphMutex);
-    (*m_graph)[v].isEnabled = false;
+    beginGraphTransaction().setVertexEnabled(v, false);
 }
 
 void
 TopologyAndFlowMonitor::disableSwitchAndEdges(uint64_t dpid)
 {
-    std::unique_lock lock(*m_graphMutex);
-    auto vertexOpt = findSwitchByDpidNoLock(dpid);
-    if (!vertexOpt)
-    {
-        return;
-    }
-
-    auto vertex = *vertexOpt;
-
-    (*m_graph)[vertex].isEnabled = false;
-
-    for (auto [ei, ei_end] = boost::edges(*m_graph); ei != ei_end; ++ei)
-    {
-        auto src_v = boost::source(*ei, *m_graph);
-        auto dst_v = boost::target(*ei, *m_graph);
-
-        if (src_v == vertex || dst_v == vertex)
-        {
-            (*m_graph)[*ei].isEnabled = false;
-        }
-    }
+    setSwitchAndEdgesEnabled(dpid, false);
 }
 
 void
 TopologyAndFlowMonitor::enableSwitchAndEdges(uint64_t dpid)
 {
-    std::unique_lock lock(*m_graphMutex);
+    setSwitchAndEdgesEnabled(dpid, true);
+}
+
+void
+TopologyAndFlowMonitor::setSwitchAndEdgesEnabled(uint64_t dpid, bool enabled)
+{
+    auto lock = lockGraphForWrite();
     auto vertexOpt = findSwitchByDpidNoLock(dpid);
     if (!vertexOpt)
     {
         return;
     }
 
-    auto vertex = *vertexOpt;
-
-    (*m_graph)[vertex].isEnabled = true;
-
-    for (auto [ei, ei_end] = boost::edges(*m_graph); ei != ei_end; ++ei)
+    // O(degree): the out-edges from the graph, the in-edges from the index
+    (*m_graph)[*vertexOpt].isEnabled = enabled;
+    for (auto [ei, eiEnd] = boost::out_edges(*vertexOpt, *m_graph); ei != eiEnd; ++ei)
     {
-        auto src_v = boost::source(*ei, *m_graph);
-        auto dst_v = boost::target(*ei, *m_graph);
-
-        if (src_v == vertex || dst_v == vertex)
-        {
-            (*m_graph)[*ei].isEnabled = true;
-        }
+        (*m_graph)[*ei].isEnabled = enabled;
+    }
+    for (const Graph::edge_descriptor& e : m_index.inEdges(*vertexOpt))
+    {
+        (*m_graph)[e].isEnabled = enabled;
     }
 }
 
 void
 TopologyAndFlowMonitor::initializeMappingsFromGraph()
 {
-    std::shared_lock lock(*m_graphMutex);
+    // Not a graph write, so the graph version stays
+    std::unique_lock lock(*m_graphMutex);
+    m_switchAddresses.clear();
     for (const auto& v : boost::make_iterator_range(boost::vertices(*m_graph)))
     {
         const auto& props = (*m_graph)[v];
@@ -1679,53 +1904,87 @@ TopologyAndFlowMonitor::initializeMappingsFromGraph()
         {
             continue;
         }
-
-        uint64_t dpid = props.dpid;
-        std::string ipStr = utils::ipToString(props.ip[0]);
-
-        m_dpidToIpStrMap[dpid] = ipStr;
-        m_dpidStrToIpStrMap[std::to_string(dpid)] = ipStr;
-        m_ipStrToDpidMap[ipStr] = dpid;
-        m_ipStrToDpidStrMap[ipStr] = std::to_string(dpid);
+        m_switchAddresses.insert(props.dpid, props.ip[0]);
     }
 
-    SPDLOG_LOGGER_TRACE(Logger::instance(), "=== m_dpidToIpStrMap ===");
-    for (const auto& [dpid, ip] : m_dpidToIpStrMap)
-    {
-        SPDLOG_LOGGER_TRACE(Logger::instance(), "{} -> {}", dpid, ip);
-    }
+    SPDLOG_LOGGER_TRACE(Logger::instance(), "=== switch dpid -> ip ===");
+    m_switchAddresses.forEach([](uint64_t dpid, uint32_t ip) {
+        SPDLOG_LOGGER_TRACE(Logger::instance(), "{} -> {}", dpid, utils::Ipv4{ip});
+    });
+}
 
-    SPDLOG_LOGGER_TRACE(Logger::instance(), "=== m_dpidStrToIpStrMap ===");
-    for (const auto& [dpidStr, ip] : m_dpidStrToIpStrMap)
+std::vector<uint32_t>
+TopologyAndFlowMonitor::getSwitchIps() const
+{
+    std::vector<uint32_t> ips;
     {
-        SPDLOG_LOGGER_TRACE(Logger::instance(), "{} -> {}", dpidStr, ip);
+        std::shared_lock lock(*m_graphMutex);
+        ips.reserve(m_switchAddresses.size());
+        m_switchAddresses.forEach([&ips](uint64_t, uint32_t ip) { ips.push_back(ip); });
     }
+    std::sort(ips.begin(), ips.end());
+    return ips;
+}
+
+std::optional<uint32_t>
+TopologyAndFlowMonitor::getSwitchIpByDpid(uint64_t dpid) const
+{
+    std::shared_lock lock(*m_graphMutex);
+    return m_switchAddresses.ipOf(dpid);
+}
+
+std::optional<uint64_t>
+TopologyAndFlowMonitor::getSwitchDpidByIp(uint32_t ip) const
+{
+    std::shared_lock lock(*m_graphMutex);
+    return m_switchAddresses.dpidOf(ip);
+}
 
-    SPDLOG_LOGGER_TRACE(Logger::instance(), "=== m_ipStrToDpidMap ===");
-    for (const auto& [ip, dpid] : m_ipStrToDpidMap)
+std::optional<std::string>
+TopologyAndFlowMonitor::getSwitchIpStrByDpid(uint64_t dpid) const
+{
+    auto ip = getSwitchIpByDpid(dpid);
+    if (!ip)
     {
-        SPDLOG_LOGGER_TRACE(Logger::instance(), "{} -> {}", ip, dpid);
+        return std::nullopt;
     }
+    return utils::ipToString(*ip);
+}
 
-    SPDLOG_LOGGER_TRACE(Logger::instance(), "=== m_ipStrToDpidStrMap ===");
-    for (const auto& [ip, dpidStr] : m_ipStrToDpidStrMap)
+std::optional<uint64_t>
+TopologyAndFlowMonitor::getSwitchDpidByIpStr(const std::string& ip) const
+{
+    in_addr addr{};
+    if (inet_pton(AF_INET, ip.c_str(), &addr) != 1)
     {
-        SPDLOG_LOGGER_TRACE(Logger::instance(), "{} -> {}", ip, dpidStr);
+        return std::nullopt;
     }
+    return getSwitchDpidByIp(addr.s_addr);
 }
 
-uint64_t
-TopologyAndFlowMonitor::hashDstIp(const std::string& str)
+std::vector<RoutingEngine::Host>
+TopologyAndFlowMonitor::routingHosts(const Graph& g, const std::vector<uint32_t>& hostIps) const
 {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256(reinterpret_cast<const unsigned char*>(str.c_str()), str.size(), hash);
-
-    uint64_t result = 0;
-    for (int i = 0; i < 8; ++i)
+    std::vector<RoutingEngine::Host> hosts;
+    hosts.reserve(hostIps.size());
+    std::shared_lock lock(*m_graphMutex);
+    for (uint32_t ip : hostIps)
     {
-        result = (result << 8) | hash[i];
+        auto hostOpt = findVertexByIpNoLock(ip);
+        if (!hostOpt.has_value())
+        {
+            continue;
+        }
+        auto attachment = findHostAttachmentNoLock(ip);
+        if (!attachment.has_value())
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(), "No edge found for host IP {}", ip);
+            continue;
+        }
+        hosts.push_back(
+            RoutingEngine::Host{ip, *hostOpt, attachment->attachedSwitch, attachment->port});
     }
-    return result;
+    return hosts;
 }
 
 std::vector<sflow::Path>
@@ -1737,194 +1996,29 @@ TopologyAndFlowMonitor::bfsAllPathsToDst(
     std::unordered_map<uint64_t, std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>>>&
         newOpenflowTables)
 {
-    constexpr uint32_t kHostMask = 0xFFFFFFFFu; // /32
-    constexpr uint32_t kPriority = 100;
-
-    auto ruleExists = [](const auto& flowTable, uint32_t net, uint32_t mask, uint32_t pri) {
-        return std::any_of(flowTable.begin(), flowTable.end(), [&](const auto& entry) {
-            return std::get<0>(entry) == net && std::get<1>(entry) == mask &&
-                   std::get<3>(entry) == pri; // include priority in identity
-        });
-    };
-
-    std::unordered_map<Graph::vertex_descriptor, Graph::vertex_descriptor> parent;
-    std::unordered_map<Graph::vertex_descriptor, bool> visited;
-    std::queue<Graph::vertex_descriptor> q;
-
-    visited[dstSwitch] = true;
-    Graph::vertex_descriptor NULL_NODE = Graph::null_vertex();
-    parent[dstSwitch] = NULL_NODE;
-    q.push(dstSwitch);
-
-    // BFS
-    while (!q.empty())
-    {
-        Graph::vertex_descriptor current = q.front();
-        q.pop();
-
-        Graph::vertex_descriptor prev = parent[current];
-
-        if (prev != NULL_NODE)
-        {
-            auto edgePair = boost::edge(current, prev, g);
-            if (edgePair.second)
-            {
-                const auto& edgeProps = g[edgePair.first];
-
-                uint64_t dpid = g[current].dpid;           // switch that will install the rule
-                uint32_t outPort = edgeProps.srcInterface; // port on *current* leading to prev
-                                                           // (depends on your edge model)
-
-                if (dpid != 0)
-                {
-                    auto& flowTable = newOpenflowTables[dpid];
-
-                    uint32_t net = dstIp & kHostMask;
-                    uint32_t mask = kHostMask;
-
-                    if (!ruleExists(flowTable, net, mask, kPriority))
-                    {
-                        flowTable.emplace_back(net, mask, outPort, kPriority);
-                        SPDLOG_LOGGER_INFO(
-                            Logger::instance(),
-                            "Added OF rule on switch {} for {} /32 -> outPort {} (pri={})",
-                            dpid,
-                            utils::ipToString(net),
-                            outPort,
-                            kPriority);
-                    }
-                }
-            }
-        }
-
-        // neighbor discovery
-        std::vector<Graph::vertex_descriptor> neighbors;
-        for (auto edge : boost::make_iterator_range(boost::out_edges(current, g)))
-        {
-            Graph::vertex_descriptor neighbor = boost::target(edge, g);
-
-            if (!g[neighbor].isUp || !g[neighbor].isEnabled)
-            {
-                continue;
-            }
-            if (!g[edge].isUp || !g[edge].isEnabled)
-            {
-                continue;
-            }
-            if (visited[neighbor])
-            {
-                continue;
-            }
-
-            neighbors.push_back(neighbor);
-        }
-
-        std::sort(neighbors.begin(),
-                  neighbors.end(),
-                  [this, &dstIp, &g](const auto& a, const auto& b) {
-                      std::string combinedA = utils::ipToString(dstIp) + std::to_string(g[a].dpid);
-                      std::string combinedB = utils::ipToString(dstIp) + std::to_string(g[b].dpid);
-                      return hashDstIp(combinedA) < hashDstIp(combinedB);
-                  });
-
-        for (Graph::vertex_descriptor neighbor : neighbors)
-        {
-            parent[neighbor] = current;
-            visited[neighbor] = true;
-            q.push(neighbor);
-        }
-    }
-
-    // Path reconstruction (mostly unchanged)
-    std::vector<sflow::Path> allPaths;
-
-    for (const auto& srcIp : allHostIps)
-    {
-        if (srcIp == dstIp)
-        {
-            continue;
-        }
-
-        auto srcHostOpt = findVertexByIp(srcIp);
-        if (!srcHostOpt.has_value())
-        {
-            continue;
-        }
-
-        sflow::Path path;
-        uint32_t srcOutPort = 0;
-        Graph::vertex_descriptor srcSwitch;
-
-        auto edgeOpt = findEdgeByHostIp(srcIp);
-        if (edgeOpt)
-        {
-            srcSwitch = boost::target(edgeOpt.value(), g);
-            srcOutPort = g[edgeOpt.value()].dstInterface;
-        }
-        else
-        {
-            SPDLOG_LOGGER_WARN(Logger::instance(), "No edge found for host IP {}", srcIp);
-            continue;
-        }
-
-        if (!visited[srcSwitch])
-        {
-            continue;
-        }
-
-        path.emplace_back(srcIp, srcOutPort);
-
-        Graph::vertex_descriptor v = srcSwitch;
-        while (v != dstSwitch)
-        {
-            Graph::vertex_descriptor nextHop = parent[v];
-            auto edgePair = boost::edge(v, nextHop, g);
-            if (edgePair.second)
-            {
-                uint64_t nodeId = g[v].dpid;
-                uint32_t outPort = g[edgePair.first].srcInterface;
-                path.emplace_back(nodeId, outPort);
-            }
-            v = nextHop;
-        }
-
-        // ---- FIXED dstSwitch -> dstHost edge handling ----
-        auto dstHostOpt = findVertexByIp(dstIp);
-        if (!dstHostOpt.has_value())
-        {
-            continue;
-        }
-
-        auto edgePair = boost::edge(dstSwitch, dstHostOpt.value(), g);
-        if (edgePair.second)
-        {
-            uint32_t outPortToHost = g[edgePair.first].srcInterface;
-
-            path.emplace_back(g[dstSwitch].dpid, outPortToHost);
-
-            // also store rule on dstSwitch
-            auto& flowTable = newOpenflowTables[g[dstSwitch].dpid];
-            uint32_t net = dstIp & kHostMask;
-            uint32_t mask = kHostMask;
-
-            if (!ruleExists(flowTable, net, mask, kPriority))
-            {
-                flowTable.emplace_back(net, mask, outPortToHost, kPriority);
-                SPDLOG_LOGGER_INFO(Logger::instance(),
-                                   "Added OF rule on switch {} for {} /32 -> outPort {} (pri={})",
-                                   g[dstSwitch].dpid,
-                                   utils::ipToString(net),
-                                   outPortToHost,
-                                   kPriority);
-            }
-        }
-        // -----------------------------------------------
-
-        path.emplace_back(dstIp, 0);
-        allPaths.push_back(std::move(path));
-    }
+    auto hosts = routingHosts(g, allHostIps);
+    auto dstHost = findVertexByIp(dstIp).value_or(Graph::null_vertex());
+    RoutingEngine engine(g, hosts);
+    return engine.computeToDestination(dstIp, dstHost, dstSwitch, newOpenflowTables);
+}
 
-    return allPaths;
+std::vector<sflow::Path>
+TopologyAndFlowMonitor::bfsAllPathsToAllDsts(const Graph& g,
+                                             const std::vector<uint32_t>& allHostIps,
+                                             RoutingEngine::OpenflowTables& newOpenflowTables)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto hosts = routingHosts(g, allHostIps);
+    RoutingEngine engine(g, hosts);
+    auto paths = engine.computeAll(newOpenflowTables);
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Computed {} paths to {} hosts in {} ms",
+                       paths.size(),
+                       hosts.size(),
+                       std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count());
+    return paths;
 }
 
 json
@@ -1938,11 +2032,12 @@ TopologyAndFlowMonitor::getStaticTopologyJson()
         result["nodes"] = json::array();
         result["edges"] = json::array();
 
-        auto graph = *m_graph;
+        // Only static attributes are read, in place under the shared lock
+        const Graph& graph = *m_graph;
         // Nodes
         for (auto vd : boost::make_iterator_range(boost::vertices(graph)))
         {
-            auto& v = graph[vd];
+            const auto& v = graph[vd];
             if (v.vertexType == VertexType::SWITCH)
             {
                 if (m_mode == utils::DeploymentMode::TESTBED)
@@ -1989,7 +2084,7 @@ TopologyAndFlowMonitor::getStaticTopologyJson()
         // Edges
         for (auto ed : boost::make_iterator_range(boost::edges(graph)))
         {
-            auto& e = graph[ed];
+            const auto& e = graph[ed];
 
             result["edges"].push_back({{"link_bandwidth_bps", e.linkBandwidth},
                                        {"src_ip", utils::ipToString(e.srcIp)},
@@ -2010,42 +2105,73 @@ TopologyAndFlowMonitor::getStaticTopologyJson()
 }
 
 double
-TopologyAndFlowMonitor::getAvgLinkUsage(const Graph& g) const
+TopologyAndFlowMonitor::getAvgLinkUsage() const
 {
-    int noneZeroEdgeNum = 0;
-    double sum = 0.0;
-
-    for (auto e : boost::make_iterator_range(boost::edges(g)))
-    {
-        if (!g[e].isUp)
-        {
-            continue;
-        }
-        auto targetNode = boost::target(e, *m_graph);
-        auto sourceNode = boost::source(e, *m_graph);
-        if (g[e].linkBandwidthUsage != 0 && g[sourceNode].vertexType != VertexType::HOST &&
-            g[targetNode].vertexType != VertexType::HOST)
-        {
-            SPDLOG_LOGGER_INFO(Logger::instance(),
-                               "{} to {} linkBandwidthUsage {} linkBandwidth {}",
-                               g[sourceNode].nickName,
-                               g[targetNode].nickName,
-                               g[e].linkBandwidthUsage,
-                               g[e].linkBandwidth);
-            noneZeroEdgeNum++;
-            sum += (static_cast<double>(g[e].linkBandwidthUsage) /
-                    static_cast<double>(g[e].linkBandwidth));
-        }
-    }
-
-    if (!noneZeroEdgeNum)
-    {
-        return 0;
-    }
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "none zero edge number {}", noneZeroEdgeNum);
+    return m_linkStats.fabricAverageUsage();
+}
 
-    return sum / static_cast<double>(noneZeroEdgeNum);
+void
+TopologyAndFlowMonitor::appendMetrics(std::string& out) const
+{
+    utils::MetricsRegistry::appendFamily(
+        out,
+        "ndt_fabric_links_active",
+        "gauge",
+        "Up switch-to-switch link directions carrying traffic",
+        {{"", static_cast<double>(m_linkStats.fabricLinks())}});
+    utils::MetricsRegistry::appendFamily(
+        out,
+        "ndt_fabric_link_usage_avg",
+        "gauge",
+        "Mean usage / bandwidth of the active switch-to-switch link directions",
+        {{"", m_linkStats.fabricAverageUsage()}});
+    utils::MetricsRegistry::appendFamily(
+        out,
+        "ndt_fabric_link_usage",
+        "gauge",
+        "Usage / bandwidth quantiles of the active switch-to-switch link directions, to 1%",
+        {{"quantile=\"0.5\"", m_linkStats.fabricUsagePercentile(0.5)},
+         {"quantile=\"0.9\"", m_linkStats.fabricUsagePercentile(0.9)},
+         {"quantile=\"0.99\"", m_linkStats.fabricUsagePercentile(0.99)}});
+}
+
+utils::MemoryUsage
+TopologyAndFlowMonitor::memoryUsage() const
+{
+    utils::MemoryUsage usage;
+    size_t edges = 0;
+    {
+        // The tables are resized with the graph, under its unique lock
+        std::shared_lock lock(*m_graphMutex);
+        size_t flowSetBytes = 0;
+        edges = boost::num_edges(*m_graph);
+        usage.add("graph", graphBytes(*m_graph, flowSetBytes))
+            .add("edge_flow_sets", flowSetBytes)
+            .add("topology_index", m_index.memoryBytes())
+            .add("link_stats", m_linkStats.memoryBytes())
+            .add("edge_flows", m_edgeFlows.memoryBytes())
+            .add("congestion_index", m_congestion.memoryBytes())
+            .add("path_residuals", m_pathResiduals.memoryBytes());
+    }
+    usage.add("candidate_paths", m_candidatePaths.memoryBytes());
+
+    std::shared_ptr<const GraphSnapshot> snapshot;
+    {
+        std::lock_guard guard(m_snapshotMutex);
+        snapshot = m_snapshot;
+    }
+    if (snapshot)
+    {
+        // Snapshots carry the current flowSets, which the live graph leaves empty
+        size_t flowSetBytes = 0;
+        const size_t graph = graphBytes(snapshot->graph, flowSetBytes);
+        usage.add("graph_snapshot",
+                  graph + snapshot->csr.memoryBytes() +
+                      utils::heapBytes(snapshot->statsModifiedAt) +
+                      utils::heapBytes(snapshot->flowsModifiedAt))
+            .add("edge_flow_sets", flowSetBytes);
+    }
+    return usage.per("edge", edges);
 }
 
 json
@@ -2100,22 +2226,24 @@ TopologyAndFlowMonitor::getLinkBandwidthBetweenSwitches(const std::string& ip1_s
 
     const auto& props1 = (*m_graph)[edge1_to_2];
     const auto& props2 = (*m_graph)[edge2_to_1];
+    LinkStats stats1 = m_linkStats.read(props1.statsId);
+    LinkStats stats2 = m_linkStats.read(props2.statsId);
 
     // 6. Populate the JSON object with the link's bandwidth information.
     result["link_found"] = true;
     result["status"] = (props1.isUp && props1.isEnabled) ? "up" : "down";
 
     // Direction from switch 1 to switch 2
-    result[ip1_str + "_to_" + ip2_str] = {{"total_bandwidth_bps", props1.linkBandwidth},
-                                          {"used_bandwidth_bps", props1.linkBandwidthUsage},
-                                          {"utilization", props1.linkBandwidthUtilization},
+    result[ip1_str + "_to_" + ip2_str] = {{"total_bandwidth_bps", stats1.linkBandwidth},
+                                          {"used_bandwidth_bps", stats1.linkBandwidthUsage},
+                                          {"utilization", stats1.linkBandwidthUtilization},
                                           {"source_port", props1.srcInterface},
                                           {"destination_port", props1.dstInterface}};
 
     // Direction from switch 2 to switch 1
-    result[ip2_str + "_to_" + ip1_str] = {{"total_bandwidth_bps", props2.linkBandwidth},
-                                          {"used_bandwidth_bps", props2.linkBandwidthUsage},
-                                          {"utilization", props2.linkBandwidthUtilization},
+    result[ip2_str + "_to_" + ip1_str] = {{"total_bandwidth_bps", stats2.linkBandwidth},
+                                          {"used_bandwidth_bps", stats2.linkBandwidthUsage},
+                                          {"utilization", stats2.linkBandwidthUtilization},
                                           {"source_port", props2.srcInterface},
                                           {"destination_port", props2.dstInterface}};
 
@@ -2132,148 +2260,154 @@ TopologyAndFlowMonitor::getTopKCongestedLinksJson(int k)
         return result;
     }
 
-    // Use the actual vertex descriptor type from your Graph definition.
-    using VertexDescriptor = Graph::vertex_descriptor;
+    result["top_k_links"] = getCongestedLinksJson(static_cast<size_t>(k), 0);
+    return result;
+}
 
+json
+TopologyAndFlowMonitor::getCongestedLinksJson(size_t k, double minUtilization)
+{
     struct LinkInfo
     {
-        VertexDescriptor v1; // FIX: Use the defined type.
-        VertexDescriptor v2; // FIX: Use the defined type.
+        Graph::edge_descriptor forward; // from the lower to the higher vertex id
+        Graph::edge_descriptor reverse;
+        LinkStats forwardStats;
+        LinkStats reverseStats;
         double max_utilization;
-
-        // Comparison operator to sort links by utilization in descending order.
-        bool operator<(const LinkInfo& other) const
-        {
-            return max_utilization > other.max_utilization;
-        }
     };
 
-    std::vector<LinkInfo> all_links;
     std::shared_lock lock(*m_graphMutex);
+    const Graph& graph = *m_graph;
+    std::unordered_set<LinkStatsTable::EdgeId> seen;
+    std::vector<LinkInfo> links;
 
-    auto edge_iter_pair = boost::edges(*m_graph);
-    for (auto it = edge_iter_pair.first; it != edge_iter_pair.second; ++it)
-    {
-        auto edge = *it;
-        VertexDescriptor src_v = boost::source(edge, *m_graph); // FIX: Use the defined type.
-        VertexDescriptor dst_v = boost::target(edge, *m_graph); // FIX: Use the defined type.
-
-        if (src_v < dst_v)
+    // Buckets come most utilised first, so once k links are in, the rest of the walk can only
+    // hold less utilised ones; the current bucket is finished since it is not ordered
+    m_congestion.visitDescending(minUtilization, [&](std::span<const CongestionIndex::EdgeId> ids) {
+        for (auto id : ids)
         {
-            auto edge_rev_pair = boost::edge(dst_v, src_v, *m_graph);
-            if (!edge_rev_pair.second)
+            auto e = m_index.edgeByStatsId(id);
+            if (!e)
+            {
+                continue;
+            }
+            auto u = boost::source(*e, graph);
+            auto v = boost::target(*e, graph);
+            auto [rev, hasReverse] = boost::edge(v, u, graph);
+            if (!hasReverse)
+            {
+                continue;
+            }
+            auto forward = u < v ? *e : rev;
+            auto reverse = u < v ? rev : *e;
+            if (!seen.insert(graph[forward].statsId).second)
+            {
+                continue;
+            }
+            const auto& fp = graph[forward];
+            const auto& rp = graph[reverse];
+            if (!(fp.isUp && fp.isEnabled && rp.isUp && rp.isEnabled))
             {
                 continue;
             }
 
-            const auto& props_fwd = (*m_graph)[edge];
-            const auto& props_rev = (*m_graph)[edge_rev_pair.first];
-
-            if (props_fwd.isUp && props_fwd.isEnabled && props_rev.isUp && props_rev.isEnabled)
+            LinkInfo link{forward, reverse, m_linkStats.read(fp.statsId),
+                          m_linkStats.read(rp.statsId), 0};
+            link.max_utilization = std::max(link.forwardStats.linkBandwidthUtilization,
+                                            link.reverseStats.linkBandwidthUtilization);
+            if (link.max_utilization >= minUtilization)
             {
-                double max_util = std::max(props_fwd.linkBandwidthUtilization,
-                                           props_rev.linkBandwidthUtilization);
-                all_links.push_back({src_v, dst_v, max_util});
+                links.push_back(link);
             }
         }
+        return k == 0 || links.size() < k;
+    });
+
+    std::sort(links.begin(), links.end(), [](const LinkInfo& a, const LinkInfo& b) {
+        return a.max_utilization > b.max_utilization;
+    });
+    if (k != 0 && links.size() > k)
+    {
+        links.resize(k);
     }
 
-    std::sort(all_links.begin(), all_links.end());
+    auto linkJson = [](const EdgeProperties& props, const LinkStats& stats) {
+        return json{{"total_bandwidth_bps", stats.linkBandwidth},
+                    {"used_bandwidth_bps", stats.linkBandwidthUsage},
+                    {"utilization", stats.linkBandwidthUtilization},
+                    {"source_port", props.srcInterface},
+                    {"destination_port", props.dstInterface}};
+    };
 
     json links_array = json::array();
-    size_t links_to_return = std::min(static_cast<size_t>(k), all_links.size());
-
-    for (size_t i = 0; i < links_to_return; ++i)
+    for (size_t i = 0; i < links.size(); ++i)
     {
-        const auto& link = all_links[i];
-        auto v1 = link.v1;
-        auto v2 = link.v2;
-
-        std::string ip1_str = utils::ipToString((*m_graph)[v1].ip).front();
-        std::string ip2_str = utils::ipToString((*m_graph)[v2].ip).front();
-
-        auto edge1_to_2 = boost::edge(v1, v2, *m_graph).first;
-        auto edge2_to_1 = boost::edge(v2, v1, *m_graph).first;
-        const auto& props1 = (*m_graph)[edge1_to_2];
-        const auto& props2 = (*m_graph)[edge2_to_1];
+        const auto& link = links[i];
+        std::string ip1_str =
+            utils::ipToString(graph[boost::source(link.forward, graph)].ip).front();
+        std::string ip2_str =
+            utils::ipToString(graph[boost::target(link.forward, graph)].ip).front();
 
         json link_json;
         link_json["rank"] = i + 1;
         link_json["status"] = "up";
-
-        // FIX: Removed extra semicolon from the end of the initializer list.
-        link_json[ip1_str + "_to_"s + ip2_str] = {{"total_bandwidth_bps", props1.linkBandwidth},
-                                                  {"used_bandwidth_bps", props1.linkBandwidthUsage},
-                                                  {"utilization", props1.linkBandwidthUtilization},
-                                                  {"source_port", props1.srcInterface},
-                                                  {"destination_port", props1.dstInterface}};
-
-        // FIX: Removed extra semicolon from the end of the initializer list.
-        link_json[ip2_str + "_to_"s + ip1_str] = {{"total_bandwidth_bps", props2.linkBandwidth},
-                                                  {"used_bandwidth_bps", props2.linkBandwidthUsage},
-                                                  {"utilization", props2.linkBandwidthUtilization},
-                                                  {"source_port", props2.srcInterface},
-                                                  {"destination_port", props2.dstInterface}};
+        link_json["max_utilization"] = link.max_utilization;
+        link_json[ip1_str + "_to_"s + ip2_str] = linkJson(graph[link.forward], link.forwardStats);
+        link_json[ip2_str + "_to_"s + ip1_str] = linkJson(graph[link.reverse], link.reverseStats);
 
         links_array.push_back(link_json);
     }
-
-    result["top_k_links"] = links_array;
-    return result;
+    return links_array;
 }
 
 void
-TopologyAndFlowMonitor::flushEdgeFlowLoop()
+TopologyAndFlowMonitor::flushEdgeFlows()
 {
-    SPDLOG_LOGGER_DEBUG(Logger::instance(), "flushEdgeFlowLoop started");
+    static utils::Histogram& cycle = utils::pollerCycleHistogram("edge_flow_expiry");
+    utils::ScopedTimer cycleTimer(cycle);
 
-    while (m_running.load())
+    // Start a new generation; flows unseen for EdgeFlowTable::GENERATIONS ticks drop out
+    std::shared_lock lock(*m_graphMutex);
+    size_t expired = m_edgeFlows.rotate(Clock::now());
+    if (expired != 0)
     {
-        // prune under graph lock
-        {
-            std::unique_lock lock(*m_graphMutex);
-            for (auto e : boost::make_iterator_range(boost::edges(*m_graph)))
-            {
-                auto& edge = (*m_graph)[e];
-                for (auto it = edge.flowSet.begin(); it != edge.flowSet.end();)
-                {
-                    const auto& k = it->first;   // FlowKey
-                    const auto& ts = it->second; // last_seen
-                    if (Clock::now() - ts > std::chrono::seconds(2))
-                    {
-                        SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                            "TTL expire flow {} -> {} on edge {}->{}",
-                                            utils::ipToString(k.srcIP),
-                                            utils::ipToString(k.dstIP),
-                                            edge.srcDpid,
-                                            edge.dstDpid);
-                        it = edge.flowSet.erase(it);
-                    }
-                    else
-                    {
-                        ++it;
-                    }
-                }
-            }
-        }
-
-        this_thread::sleep_for(chrono::milliseconds(1000));
+        SPDLOG_LOGGER_TRACE(Logger::instance(), "Expired {} edge flow memberships", expired);
     }
+}
 
-    SPDLOG_LOGGER_DEBUG(Logger::instance(), "flushEdgeFlowLoop stopped");
+json
+TopologyAndFlowMonitor::getEdgeFlowExpiryStatsJson() const
+{
+    return json{{"generations", EdgeFlowTable::GENERATIONS},
+                {"last_tick_expired", m_edgeFlows.lastTickExpired()},
+                {"total_expired", m_edgeFlows.totalExpired()}};
 }
 
 bool
 TopologyAndFlowMonitor::touchEdgeFlow(Graph::edge_descriptor e, const sflow::FlowKey& key)
 {
-    std::unique_lock lk(*m_graphMutex);
-    auto& mp = (*m_graph)[e].flowSet;
-    auto now = Clock::now();
+    std::shared_lock lock(*m_graphMutex);
+    return m_edgeFlows.touch((*m_graph)[e].statsId, key);
+}
 
-    auto [it, inserted] = mp.emplace(key, now);
-    if (!inserted)
+size_t
+TopologyAndFlowMonitor::touchPathFlow(const sflow::FlowKey& key,
+                                      uint32_t srcHostIp,
+                                      const sflow::PathHandle& path)
+{
+    std::shared_lock lock(*m_graphMutex);
+    size_t touched = 0;
+    auto touch = [&](std::optional<Graph::edge_descriptor> e) {
+        if (e)
+        {
+            m_edgeFlows.touch((*m_graph)[*e].statsId, key);
+            ++touched;
+        }
+    };
+    touch(findEdgeByHostIpNoLock(srcHostIp));
+    for (const auto [dpid, port] : path)
     {
-        it->second = now; // refresh last_seen
+        touch(findEdgeByDpidAndPortNoLock({dpid, port}));
     }
-    return inserted; // true if it was newly added
+    return touched;
 }
\ No newline at end of file
@@ -0,0 +1,394 @@
+#include "ndt_core/collection/TopologyCache.hpp"
+#include "utils/Logger.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <variant>
+
+namespace
+{
+
+constexpr char MAGIC[] = "NDTT1\n";
+constexpr size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+constexpr uint64_t MEMBER_PORT = 0;
+
+void
+putVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void
+putSigned(std::string& out, int64_t value)
+{
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void
+putString(std::string& out, const std::string& value)
+{
+    putVarint(out, value.size());
+    out.append(value);
+}
+
+void
+putIps(std::string& out, const std::vector<uint32_t>& ips)
+{
+    putVarint(out, ips.size());
+    for (uint32_t ip : ips)
+    {
+        putVarint(out, ip);
+    }
+}
+
+void
+putVertex(std::string& out, const VertexProperties& v)
+{
+    putVarint(out, static_cast<uint64_t>(v.vertexType));
+    putVarint(out, v.mac);
+    putIps(out, v.ip);
+    putVarint(out, v.dpid);
+    putString(out, v.deviceName);
+    putString(out, v.nickName);
+    putString(out, v.brandName);
+    putString(out, v.bridgeNameForMininet);
+    putSigned(out, v.deviceLayer);
+    putVarint(out, v.ecmpGroups.size());
+    for (const auto& group : v.ecmpGroups)
+    {
+        putVarint(out, group.members.size());
+        for (const auto& member : group.members)
+        {
+            putVarint(out, MEMBER_PORT);
+            putSigned(out, std::get<PortMember>(member).portId);
+        }
+    }
+}
+
+void
+putEdge(std::string& out, const StaticTopology::Edge& edge)
+{
+    const EdgeProperties& e = edge.props;
+    putVarint(out, edge.src);
+    putVarint(out, edge.dst);
+    putVarint(out, e.linkBandwidth);
+    putIps(out, e.srcIp);
+    putVarint(out, e.srcDpid);
+    putVarint(out, e.srcInterface);
+    putIps(out, e.dstIp);
+    putVarint(out, e.dstDpid);
+    putVarint(out, e.dstInterface);
+}
+
+// Reads advance @c pos and fail once the data runs out
+struct Cursor
+{
+    std::string_view data;
+    size_t pos;
+
+    bool varint(uint64_t& value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= data.size())
+            {
+                return false;
+            }
+            const auto byte = static_cast<uint8_t>(data[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename T>
+    bool number(T& value)
+    {
+        uint64_t raw = 0;
+        if (!varint(raw) || raw > std::numeric_limits<T>::max())
+        {
+            return false;
+        }
+        value = static_cast<T>(raw);
+        return true;
+    }
+
+    bool signedNumber(int& value)
+    {
+        uint64_t raw = 0;
+        if (!varint(raw))
+        {
+            return false;
+        }
+        const int64_t decoded = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        value = static_cast<int>(decoded);
+        return true;
+    }
+
+    // A count of items that each take at least one byte, so a corrupt count cannot make the
+    // caller reserve more than the file holds
+    bool count(size_t& value)
+    {
+        return number(value) && value <= data.size() - pos;
+    }
+
+    bool string(std::string& value)
+    {
+        size_t size = 0;
+        if (!count(size))
+        {
+            return false;
+        }
+        value.assign(data.substr(pos, size));
+        pos += size;
+        return true;
+    }
+
+    bool ips(std::vector<uint32_t>& value)
+    {
+        size_t size = 0;
+        if (!count(size))
+        {
+            return false;
+        }
+        value.resize(size);
+        for (auto& ip : value)
+        {
+            if (!number(ip))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool vertex(VertexProperties& v)
+    {
+        uint64_t type = 0;
+        size_t groups = 0;
+        if (!varint(type) || type > static_cast<uint64_t>(VertexType::HOST) || !number(v.mac) ||
+            !ips(v.ip) || !number(v.dpid) || !string(v.deviceName) || !string(v.nickName) ||
+            !string(v.brandName) || !string(v.bridgeNameForMininet) ||
+            !signedNumber(v.deviceLayer) || !count(groups))
+        {
+            return false;
+        }
+        v.vertexType = static_cast<VertexType>(type);
+        v.isUp = false;
+        v.isEnabled = false;
+        v.ecmpGroups.resize(groups);
+        for (auto& group : v.ecmpGroups)
+        {
+            size_t members = 0;
+            if (!count(members))
+            {
+                return false;
+            }
+            group.members.reserve(members);
+            for (size_t i = 0; i < members; ++i)
+            {
+                uint64_t kind = 0;
+                PortMember port;
+                if (!varint(kind) || kind != MEMBER_PORT || !signedNumber(port.portId))
+                {
+                    return false;
+                }
+                group.members.emplace_back(port);
+            }
+        }
+        return true;
+    }
+
+    bool edge(StaticTopology::Edge& edge, size_t vertexCount)
+    {
+        EdgeProperties& e = edge.props;
+        if (!number(edge.src) || !number(edge.dst) || edge.src >= vertexCount ||
+            edge.dst >= vertexCount || !number(e.linkBandwidth) || !ips(e.srcIp) ||
+            !number(e.srcDpid) || !number(e.srcInterface) || !ips(e.dstIp) ||
+            !number(e.dstDpid) || !number(e.dstInterface))
+        {
+            return false;
+        }
+        // As loadStaticTopologyFromFile() initialises a link read from the JSON
+        e.isUp = false;
+        e.isEnabled = false;
+        e.leftBandwidth = e.linkBandwidth;
+        e.linkBandwidthUsage = 0;
+        e.linkBandwidthUtilization = 0;
+        return true;
+    }
+};
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                m_data = static_cast<const char*>(addr);
+                m_size = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (m_data)
+        {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const
+    {
+        return {m_data, m_size};
+    }
+
+  private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+} // namespace
+
+namespace topology_cache
+{
+
+uint64_t
+hash(std::string_view data)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (char c : data)
+    {
+        h ^= static_cast<uint8_t>(c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+std::optional<StaticTopology>
+load(const std::string& path, uint64_t sourceHash, int mode)
+{
+    MappedFile file(path);
+    Cursor in{file.view(), MAGIC_SIZE};
+    if (in.data.substr(0, MAGIC_SIZE) != std::string_view(MAGIC, MAGIC_SIZE))
+    {
+        return std::nullopt;
+    }
+
+    uint64_t cachedHash = 0;
+    uint64_t cachedMode = 0;
+    if (!in.varint(cachedHash) || !in.varint(cachedMode) || cachedHash != sourceHash ||
+        cachedMode != static_cast<uint64_t>(mode))
+    {
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Topology cache {} is stale", path);
+        return std::nullopt;
+    }
+
+    StaticTopology topology;
+    size_t vertices = 0;
+    size_t edges = 0;
+    bool ok = in.count(vertices);
+    topology.vertices.resize(ok ? vertices : 0);
+    for (size_t i = 0; ok && i < vertices; ++i)
+    {
+        ok = in.vertex(topology.vertices[i]);
+    }
+    ok = ok && in.count(edges);
+    topology.edges.resize(ok ? edges : 0);
+    for (size_t i = 0; ok && i < edges; ++i)
+    {
+        ok = in.edge(topology.edges[i], vertices);
+    }
+    if (!ok || in.pos != in.data.size())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Topology cache {} is corrupt, ignored", path);
+        return std::nullopt;
+    }
+    return topology;
+}
+
+bool
+store(const std::string& path, uint64_t sourceHash, int mode, const StaticTopology& topology)
+{
+    std::string out(MAGIC, MAGIC_SIZE);
+    putVarint(out, sourceHash);
+    putVarint(out, static_cast<uint64_t>(mode));
+    putVarint(out, topology.vertices.size());
+    for (const auto& vertex : topology.vertices)
+    {
+        putVertex(out, vertex);
+    }
+    putVarint(out, topology.edges.size());
+    for (const auto& edge : topology.edges)
+    {
+        putEdge(out, edge);
+    }
+
+    const std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Cannot write topology cache {}: {}",
+                           tmp,
+                           strerror(errno));
+        return false;
+    }
+    size_t written = 0;
+    while (written < out.size())
+    {
+        const ssize_t n = ::write(fd, out.data() + written, out.size() - written);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    if (written != out.size() || std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Cannot write topology cache {}: {}",
+                           path,
+                           strerror(errno));
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace topology_cache
@@ -0,0 +1,265 @@
+#include "ndt_core/collection/TopologyIndex.hpp"
+#include "utils/MemoryAccounting.hpp"
+#include <boost/graph/adjacency_list.hpp>
+
+TopologyIndex
+TopologyIndex::build(const Graph& graph)
+{
+    TopologyIndex index;
+
+    // try_emplace keeps the first match everywhere, like the linear scans did
+    for (auto [vi, viEnd] = boost::vertices(graph); vi != viEnd; ++vi)
+    {
+        const auto& props = graph[*vi];
+        if (props.vertexType == VertexType::SWITCH)
+        {
+            index.m_switchByDpid.try_emplace(props.dpid, *vi);
+            if (!props.ip.empty())
+            {
+                index.m_switchByIp.try_emplace(props.ip.front(), *vi);
+            }
+        }
+        for (uint32_t ip : props.ip)
+        {
+            index.m_vertexByIp.try_emplace(ip, *vi);
+        }
+        index.m_vertexByMac.try_emplace(props.mac, *vi);
+        index.m_vertexByDeviceName.try_emplace(props.deviceName, *vi);
+        index.m_vertexByBridgeName.try_emplace(props.bridgeNameForMininet, *vi);
+        ++index.m_vertexCount;
+    }
+    index.m_inEdges.resize(index.m_vertexCount);
+
+    for (auto [ei, eiEnd] = boost::edges(graph); ei != eiEnd; ++ei)
+    {
+        const auto& props = graph[*ei];
+        index.m_inEdges[boost::target(*ei, graph)].push_back(*ei);
+        auto [reverseEdge, hasReverse] =
+            boost::edge(boost::target(*ei, graph), boost::source(*ei, graph), graph);
+        index.m_edgeByDpidAndPort.try_emplace({props.srcDpid, props.srcInterface}, *ei);
+        index.m_edgeBySrcAndDstDpid.try_emplace({props.srcDpid, props.dstDpid}, *ei);
+        for (uint32_t srcIp : props.srcIp)
+        {
+            index.m_edgeBySrcIp.try_emplace(srcIp, *ei);
+            for (uint32_t dstIp : props.dstIp)
+            {
+                index.m_edgeBySrcAndDstIp.try_emplace({srcIp, dstIp}, *ei);
+            }
+        }
+        for (uint32_t dstIp : props.dstIp)
+        {
+            index.m_edgeByDstIp.try_emplace(dstIp, *ei);
+        }
+        index.m_edgeBySrcIps.try_emplace(props.srcIp, *ei);
+        index.m_edgeByDstIps.try_emplace(props.dstIp, *ei);
+
+        const Vertex src = boost::source(*ei, graph);
+        const Vertex dst = boost::target(*ei, graph);
+        if (graph[src].vertexType == VertexType::HOST &&
+            graph[dst].vertexType == VertexType::SWITCH)
+        {
+            const HostAttachment attachment{src, *ei, dst, graph[dst].dpid, props.dstInterface};
+            for (uint32_t hostIp : props.srcIp)
+            {
+                index.m_hostAttachments.try_emplace(hostIp, attachment);
+            }
+        }
+
+        if (!props.srcIp.empty() && !props.dstIp.empty())
+        {
+            AgentPortEdges entry{*ei, std::nullopt};
+            if (hasReverse)
+            {
+                entry.reverse = reverseEdge;
+            }
+            index.m_edgeByAgentPort.try_emplace(
+                agentPortKey(props.srcIp.front(), props.srcInterface),
+                entry);
+            index.m_otherSideByAgentPort.try_emplace(
+                agentPortKey(props.dstIp.front(), props.dstInterface),
+                std::make_pair(props.srcIp.front(), props.srcInterface));
+        }
+        if (props.statsId >= index.m_edgeByStatsId.size())
+        {
+            index.m_edgeByStatsId.resize(props.statsId + 1);
+            index.m_reverseByStatsId.resize(props.statsId + 1);
+        }
+        if (!index.m_edgeByStatsId[props.statsId])
+        {
+            index.m_edgeByStatsId[props.statsId] = *ei;
+            if (hasReverse)
+            {
+                index.m_reverseByStatsId[props.statsId] = reverseEdge;
+            }
+        }
+        ++index.m_edgeCount;
+    }
+
+    return index;
+}
+
+std::optional<TopologyIndex::Vertex>
+TopologyIndex::switchByDpid(uint64_t dpid) const
+{
+    return lookup(m_switchByDpid, dpid);
+}
+
+std::optional<TopologyIndex::Vertex>
+TopologyIndex::switchByIp(uint32_t ip) const
+{
+    return lookup(m_switchByIp, ip);
+}
+
+std::optional<TopologyIndex::Vertex>
+TopologyIndex::vertexByIp(uint32_t ip) const
+{
+    return lookup(m_vertexByIp, ip);
+}
+
+std::optional<TopologyIndex::Vertex>
+TopologyIndex::vertexByMac(uint64_t mac) const
+{
+    return lookup(m_vertexByMac, mac);
+}
+
+std::optional<TopologyIndex::Vertex>
+TopologyIndex::vertexByDeviceName(const std::string& name) const
+{
+    return lookup(m_vertexByDeviceName, name);
+}
+
+std::optional<TopologyIndex::Vertex>
+TopologyIndex::vertexByMininetBridgeName(const std::string& name) const
+{
+    return lookup(m_vertexByBridgeName, name);
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeByDpidAndPort(uint64_t srcDpid, uint32_t srcInterface) const
+{
+    return lookup(m_edgeByDpidAndPort, std::make_pair(srcDpid, srcInterface));
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeBySrcAndDstDpid(uint64_t srcDpid, uint64_t dstDpid) const
+{
+    return lookup(m_edgeBySrcAndDstDpid, std::make_pair(srcDpid, dstDpid));
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeBySrcIp(uint32_t ip) const
+{
+    return lookup(m_edgeBySrcIp, ip);
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeByDstIp(uint32_t ip) const
+{
+    return lookup(m_edgeByDstIp, ip);
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeBySrcAndDstIp(uint32_t srcIp, uint32_t dstIp) const
+{
+    return lookup(m_edgeBySrcAndDstIp, std::make_pair(srcIp, dstIp));
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeBySrcIps(const std::vector<uint32_t>& ips) const
+{
+    return lookup(m_edgeBySrcIps, ips);
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeByDstIps(const std::vector<uint32_t>& ips) const
+{
+    return lookup(m_edgeByDstIps, ips);
+}
+
+std::optional<TopologyIndex::HostAttachment>
+TopologyIndex::hostAttachment(uint32_t hostIp) const
+{
+    return lookup(m_hostAttachments, hostIp);
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeByAgentIpAndPort(uint32_t agentIp, uint32_t port) const
+{
+    auto it = m_edgeByAgentPort.find(agentPortKey(agentIp, port));
+    if (it == m_edgeByAgentPort.end())
+    {
+        return std::nullopt;
+    }
+    return it->second.edge;
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::reverseEdgeByAgentIpAndPort(uint32_t agentIp, uint32_t port) const
+{
+    auto it = m_edgeByAgentPort.find(agentPortKey(agentIp, port));
+    if (it == m_edgeByAgentPort.end())
+    {
+        return std::nullopt;
+    }
+    return it->second.reverse;
+}
+
+std::optional<std::pair<uint32_t, uint32_t>>
+TopologyIndex::otherSideOfAgentPort(uint32_t agentIp, uint32_t port) const
+{
+    return lookup(m_otherSideByAgentPort, agentPortKey(agentIp, port));
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::edgeByStatsId(uint32_t id) const
+{
+    return id < m_edgeByStatsId.size() ? m_edgeByStatsId[id] : std::nullopt;
+}
+
+std::optional<TopologyIndex::Edge>
+TopologyIndex::reverseEdgeByStatsId(uint32_t id) const
+{
+    return id < m_reverseByStatsId.size() ? m_reverseByStatsId[id] : std::nullopt;
+}
+
+const std::vector<TopologyIndex::Edge>&
+TopologyIndex::inEdges(Vertex v) const
+{
+    static const std::vector<Edge> none;
+    return v < m_inEdges.size() ? m_inEdges[v] : none;
+}
+
+size_t
+TopologyIndex::memoryBytes() const
+{
+    using utils::heapBytes;
+    size_t bytes = heapBytes(m_switchByDpid) + heapBytes(m_switchByIp) +
+                   heapBytes(m_vertexByIp) + heapBytes(m_vertexByMac) +
+                   heapBytes(m_vertexByDeviceName) + heapBytes(m_vertexByBridgeName) +
+                   heapBytes(m_edgeByDpidAndPort) + heapBytes(m_edgeBySrcAndDstDpid) +
+                   heapBytes(m_edgeBySrcIp) + heapBytes(m_edgeByDstIp) +
+                   heapBytes(m_edgeBySrcAndDstIp) + heapBytes(m_edgeBySrcIps) +
+                   heapBytes(m_edgeByDstIps) + heapBytes(m_hostAttachments) +
+                   heapBytes(m_edgeByAgentPort) + heapBytes(m_otherSideByAgentPort) +
+                   heapBytes(m_edgeByStatsId) + heapBytes(m_reverseByStatsId) +
+                   heapBytes(m_inEdges);
+    for (const auto* names : {&m_vertexByDeviceName, &m_vertexByBridgeName})
+    {
+        for (const auto& [name, vertex] : *names)
+        {
+            bytes += heapBytes(name);
+        }
+    }
+    for (const auto* lists : {&m_edgeBySrcIps, &m_edgeByDstIps})
+    {
+        for (const auto& [ips, edge] : *lists)
+        {
+            bytes += heapBytes(ips);
+        }
+    }
+    for (const auto& edges : m_inEdges)
+    {
+        bytes += heapBytes(edges);
+    }
+    return bytes;
+}
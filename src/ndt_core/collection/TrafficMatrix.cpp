@@ -0,0 +1,149 @@
+#include "ndt_core/collection/TrafficMatrix.hpp"
+#include <algorithm>
+#include <limits>
+
+size_t
+TrafficMatrix::hostId(uint32_t ip)
+{
+    if (auto it = m_ids.find(ip); it != m_ids.end())
+    {
+        return it->second;
+    }
+    if (m_hosts.size() >= TRAFFIC_MATRIX_MAX_HOSTS)
+    {
+        return std::numeric_limits<size_t>::max();
+    }
+    const uint32_t id = static_cast<uint32_t>(m_hosts.size());
+    m_ids.emplace(ip, id);
+    m_hosts.push_back(ip);
+    if (id >= m_capacity)
+    {
+        grow(std::max<size_t>(16, m_capacity * 2));
+    }
+    return id;
+}
+
+void
+TrafficMatrix::grow(size_t capacity)
+{
+    std::vector<uint64_t> cells(capacity * capacity, 0);
+    for (size_t row = 0; row < m_capacity; ++row)
+    {
+        std::copy_n(m_cells.begin() + row * m_capacity, m_capacity, cells.begin() + row * capacity);
+    }
+    m_cells.swap(cells);
+    m_capacity = capacity;
+}
+
+void
+TrafficMatrix::apply(std::span<const Delta> deltas)
+{
+    if (deltas.empty())
+    {
+        return;
+    }
+    std::lock_guard lock(m_mutex);
+    for (const auto& delta : deltas)
+    {
+        const size_t src = hostId(delta.srcIp);
+        const size_t dst = hostId(delta.dstIp);
+        if (src >= m_hosts.size() || dst >= m_hosts.size())
+        {
+            ++m_untracked;
+            continue;
+        }
+        uint64_t& cell = m_cells[src * m_capacity + dst];
+        const bool wasZero = cell == 0;
+        // Unsigned wrap-around: the cell is a sum of rates, so never below zero in the end
+        cell += static_cast<uint64_t>(delta.bps);
+        if (wasZero != (cell == 0))
+        {
+            wasZero ? ++m_nonzero : --m_nonzero;
+        }
+        m_changed = true;
+    }
+}
+
+void
+TrafficMatrix::tick()
+{
+    std::lock_guard lock(m_mutex);
+    if (m_changed)
+    {
+        ++m_version;
+        m_changed = false;
+    }
+}
+
+uint64_t
+TrafficMatrix::version() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_version;
+}
+
+uint64_t
+TrafficMatrix::cells(std::vector<Cell>& out) const
+{
+    out.clear();
+    std::lock_guard lock(m_mutex);
+    out.reserve(m_nonzero);
+    const size_t hosts = m_hosts.size();
+    for (size_t src = 0; src < hosts && out.size() < m_nonzero; ++src)
+    {
+        const uint64_t* row = m_cells.data() + src * m_capacity;
+        for (size_t dst = 0; dst < hosts; ++dst)
+        {
+            if (row[dst] != 0)
+            {
+                out.push_back({m_hosts[src], m_hosts[dst], row[dst]});
+            }
+        }
+    }
+    return m_version;
+}
+
+nlohmann::json
+TrafficMatrix::sparseJson(uint64_t minBps) const
+{
+    nlohmann::json matrix = nlohmann::json::array();
+    std::lock_guard lock(m_mutex);
+    const size_t hosts = m_hosts.size();
+    size_t seen = 0;
+    // Rows past the last non-zero cell are skipped
+    for (size_t src = 0; src < hosts && seen < m_nonzero; ++src)
+    {
+        const uint64_t* row = m_cells.data() + src * m_capacity;
+        for (size_t dst = 0; dst < hosts; ++dst)
+        {
+            if (row[dst] == 0)
+            {
+                continue;
+            }
+            ++seen;
+            if (row[dst] >= minBps)
+            {
+                matrix.push_back({src, dst, row[dst]});
+            }
+        }
+    }
+    return nlohmann::json{
+        {"version", m_version},
+        {"hosts", m_hosts},
+        {"matrix", std::move(matrix)},
+    };
+}
+
+nlohmann::json
+TrafficMatrix::statsJson() const
+{
+    std::lock_guard lock(m_mutex);
+    return nlohmann::json{
+        {"hosts", m_hosts.size()},
+        {"capacity", m_capacity},
+        {"nonzero_cells", m_nonzero},
+        {"untracked_deltas", m_untracked},
+        {"memory_bytes", m_cells.size() * sizeof(uint64_t)},
+        {"version", m_version},
+    };
+}
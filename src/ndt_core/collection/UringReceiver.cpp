@@ -0,0 +1,240 @@
+#include "ndt_core/collection/UringReceiver.hpp"
+#include "utils/Logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#ifdef NDT_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace sflow
+{
+
+#ifdef NDT_HAVE_LIBURING
+
+namespace
+{
+
+constexpr int BUFFER_GROUP = 0;
+constexpr unsigned RING_ENTRIES = 8; // one recvmsg request is all that is ever queued
+constexpr size_t CONTROL_SIZE = CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(timespec));
+
+} // namespace
+
+struct UringReceiver::State
+{
+    int sockfd = -1;
+    io_uring ring{};
+    bool ringReady = false;
+    io_uring_buf_ring* buffers = nullptr;
+    std::vector<char> memory; // SFLOW_URING_BUFFERS x SFLOW_URING_BUFFER_SIZE
+    msghdr layout{};          // name and control room every completion is laid out with
+    std::vector<unsigned short> held; // buffer ids handed out by the last poll()
+    bool armed = false;
+    bool received = false;
+
+    ~State()
+    {
+        if (buffers != nullptr)
+        {
+            io_uring_free_buf_ring(&ring, buffers, SFLOW_URING_BUFFERS, BUFFER_GROUP);
+        }
+        if (ringReady)
+        {
+            io_uring_queue_exit(&ring);
+        }
+    }
+
+    // Queue buffer @p id as the @p slot-th of the next io_uring_buf_ring_advance()
+    void provide(unsigned short id, int slot)
+    {
+        io_uring_buf_ring_add(buffers,
+                              memory.data() + size_t(id) * SFLOW_URING_BUFFER_SIZE,
+                              SFLOW_URING_BUFFER_SIZE,
+                              id,
+                              io_uring_buf_ring_mask(SFLOW_URING_BUFFERS),
+                              slot);
+    }
+};
+
+UringReceiver::UringReceiver(std::unique_ptr<State> state)
+    : m_state(std::move(state))
+{
+}
+
+UringReceiver::~UringReceiver() = default;
+
+std::unique_ptr<UringReceiver>
+UringReceiver::create(int sockfd)
+{
+    auto state = std::make_unique<State>();
+    state->sockfd = sockfd;
+    int rc = io_uring_queue_init(RING_ENTRIES, &state->ring, 0);
+    if (rc < 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "io_uring unavailable, receiving sFlow with recvmmsg: {}",
+                           strerror(-rc));
+        return nullptr;
+    }
+    state->ringReady = true;
+
+    state->buffers =
+        io_uring_setup_buf_ring(&state->ring, SFLOW_URING_BUFFERS, BUFFER_GROUP, 0, &rc);
+    if (state->buffers == nullptr)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "io_uring buffer ring unavailable, receiving sFlow with recvmmsg: {}",
+                           strerror(-rc));
+        return nullptr;
+    }
+    state->memory.resize(size_t(SFLOW_URING_BUFFERS) * SFLOW_URING_BUFFER_SIZE);
+    for (unsigned short id = 0; id < SFLOW_URING_BUFFERS; ++id)
+    {
+        state->provide(id, id);
+    }
+    io_uring_buf_ring_advance(state->buffers, SFLOW_URING_BUFFERS);
+    state->held.reserve(SFLOW_URING_BUFFERS);
+
+    state->layout.msg_namelen = sizeof(sockaddr_in);
+    state->layout.msg_controllen = CONTROL_SIZE;
+    return std::unique_ptr<UringReceiver>(new UringReceiver(std::move(state)));
+}
+
+bool
+UringReceiver::poll(int timeoutMs, std::vector<Datagram>& out)
+{
+    State& s = *m_state;
+    out.clear();
+    for (size_t i = 0; i < s.held.size(); ++i)
+    {
+        s.provide(s.held[i], static_cast<int>(i));
+    }
+    io_uring_buf_ring_advance(s.buffers, static_cast<int>(s.held.size()));
+    s.held.clear();
+
+    // Re-armed after the kernel ended the previous request (out of buffers, or an error)
+    if (!s.armed)
+    {
+        io_uring_sqe* sqe = io_uring_get_sqe(&s.ring);
+        io_uring_prep_recvmsg_multishot(sqe, s.sockfd, &s.layout, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        s.armed = true;
+    }
+
+    if (io_uring_cq_ready(&s.ring) == 0)
+    {
+        __kernel_timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000000LL};
+        io_uring_cqe* first = nullptr;
+        const int rc = io_uring_submit_and_wait_timeout(&s.ring, &first, 1, &timeout, nullptr);
+        if (rc < 0 && rc != -ETIME && rc != -EINTR)
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "io_uring wait failed: {}", strerror(-rc));
+            return false;
+        }
+    }
+    else if (io_uring_sq_ready(&s.ring) > 0)
+    {
+        io_uring_submit(&s.ring);
+    }
+
+    io_uring_cqe* cqes[SFLOW_URING_BUFFERS];
+    const unsigned count = io_uring_peek_batch_cqe(&s.ring, cqes, SFLOW_URING_BUFFERS);
+    bool usable = true;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const io_uring_cqe* cqe = cqes[i];
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+        {
+            s.armed = false;
+        }
+        if (cqe->res < 0)
+        {
+            if (cqe->res == -EINVAL && !s.received)
+            {
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "Kernel lacks multishot recvmsg, receiving sFlow with recvmmsg");
+                usable = false;
+            }
+            else if (cqe->res != -ENOBUFS) // every buffer is out; re-armed once they are back
+            {
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "io_uring recvmsg failed: {}",
+                                   strerror(-cqe->res));
+            }
+            continue;
+        }
+        if (!(cqe->flags & IORING_CQE_F_BUFFER))
+        {
+            continue;
+        }
+
+        const auto id = static_cast<unsigned short>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        s.held.push_back(id);
+        char* buffer = s.memory.data() + size_t(id) * SFLOW_URING_BUFFER_SIZE;
+        io_uring_recvmsg_out* msg = io_uring_recvmsg_validate(buffer, cqe->res, &s.layout);
+        if (msg == nullptr)
+        {
+            continue;
+        }
+        Datagram datagram{static_cast<const char*>(io_uring_recvmsg_payload(msg, &s.layout)),
+                          io_uring_recvmsg_payload_length(msg, cqe->res, &s.layout),
+                          (msg->flags & MSG_TRUNC) != 0,
+                          0,
+                          -1};
+        for (cmsghdr* cmsg = io_uring_recvmsg_cmsg_firsthdr(msg, &s.layout); cmsg != nullptr;
+             cmsg = io_uring_recvmsg_cmsg_nexthdr(msg, &s.layout, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+            {
+                uint32_t drops = 0;
+                std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                datagram.socketDrops = drops;
+            }
+            else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            {
+                timespec ts{};
+                std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                datagram.receivedMs = int64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+            }
+        }
+        s.received = true;
+        out.push_back(datagram);
+    }
+    io_uring_cq_advance(&s.ring, count);
+    return usable;
+}
+
+#else
+
+struct UringReceiver::State
+{
+};
+
+UringReceiver::UringReceiver(std::unique_ptr<State> state)
+    : m_state(std::move(state))
+{
+}
+
+UringReceiver::~UringReceiver() = default;
+
+std::unique_ptr<UringReceiver>
+UringReceiver::create(int sockfd)
+{
+    SPDLOG_LOGGER_WARN(Logger::instance(), "Built without liburing, receiving sFlow with recvmmsg");
+    return nullptr;
+}
+
+bool
+UringReceiver::poll(int timeoutMs, std::vector<Datagram>& out)
+{
+    out.clear();
+    return false;
+}
+
+#endif
+
+} // namespace sflow
@@ -0,0 +1,207 @@
+#include "ndt_core/collection/WhatIfEvaluator.hpp"
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include <algorithm>
+#include <mutex>
+
+WhatIfEvaluator::WhatIfEvaluator(std::shared_ptr<const GraphSnapshot> snapshot)
+    : m_snapshot(std::move(snapshot))
+{
+    const CsrGraph& csr = m_snapshot->csr;
+    const size_t edgeCount = csr.edgeCount();
+    m_usage.resize(edgeCount);
+    m_capacity.resize(edgeCount);
+    for (CsrGraph::EdgeId e = 0; e < edgeCount; ++e)
+    {
+        if (!csr.edgeUsable(e))
+        {
+            continue;
+        }
+        m_usage[e] = csr.linkBandwidthUsage(e);
+        m_capacity[e] = csr.linkBandwidth(e);
+        if (m_capacity[e] != 0)
+        {
+            m_byUtilization.push_back(e);
+        }
+        if (csr.isSwitch(csr.source(e)))
+        {
+            m_edgeAt[csr.dpid(csr.source(e))][csr.srcInterface(e)] = e;
+        }
+    }
+    std::stable_sort(m_byUtilization.begin(),
+                     m_byUtilization.end(),
+                     [this](CsrGraph::EdgeId a, CsrGraph::EdgeId b) {
+                         return utilization(a, 0) > utilization(b, 0);
+                     });
+
+    for (CsrGraph::VertexId v = 0; v < csr.vertexCount(); ++v)
+    {
+        if (!csr.isSwitch(v))
+        {
+            for (uint32_t ip : m_snapshot->graph[v].ip)
+            {
+                m_hostByIp.emplace(ip, v);
+            }
+        }
+    }
+}
+
+std::shared_ptr<const WhatIfEvaluator>
+WhatIfEvaluator::forSnapshot(std::shared_ptr<const GraphSnapshot> snapshot)
+{
+    static std::mutex mutex;
+    static std::shared_ptr<const WhatIfEvaluator> latest;
+
+    std::lock_guard lock(mutex);
+    if (!latest || latest->m_snapshot != snapshot)
+    {
+        latest = std::make_shared<const WhatIfEvaluator>(std::move(snapshot));
+    }
+    return latest;
+}
+
+double
+WhatIfEvaluator::utilization(CsrGraph::EdgeId e, int64_t extraBps) const
+{
+    if (m_capacity[e] == 0)
+    {
+        return 0;
+    }
+    const int64_t load = std::max<int64_t>(0, static_cast<int64_t>(m_usage[e]) + extraBps);
+    return static_cast<double>(load) * 100.0 / static_cast<double>(m_capacity[e]);
+}
+
+std::optional<CsrGraph::EdgeId>
+WhatIfEvaluator::edgeAt(uint64_t dpid, uint32_t port) const
+{
+    auto sw = m_edgeAt.find(dpid);
+    if (sw == m_edgeAt.end())
+    {
+        return std::nullopt;
+    }
+    auto edge = sw->second.find(port);
+    if (edge == sw->second.end())
+    {
+        return std::nullopt;
+    }
+    return edge->second;
+}
+
+std::optional<sflow::Path>
+WhatIfEvaluator::pathThrough(const std::vector<uint64_t>& dpids, uint32_t dstIp) const
+{
+    const CsrGraph& csr = m_snapshot->csr;
+    sflow::Path path;
+    path.reserve(dpids.size() + 1);
+    for (size_t i = 0; i < dpids.size(); ++i)
+    {
+        const std::optional<CsrGraph::VertexId> from = csr.switchByDpid(dpids[i]);
+        if (!from)
+        {
+            return std::nullopt;
+        }
+        std::optional<CsrGraph::VertexId> to;
+        if (i + 1 < dpids.size())
+        {
+            to = csr.switchByDpid(dpids[i + 1]);
+        }
+        else if (dstIp != 0)
+        {
+            auto host = m_hostByIp.find(dstIp);
+            if (host == m_hostByIp.end())
+            {
+                return std::nullopt;
+            }
+            to = host->second;
+        }
+        else
+        {
+            path.emplace_back(dpids[i], 0);
+            break;
+        }
+        const std::optional<CsrGraph::EdgeId> edge = to ? csr.findEdge(*from, *to) : std::nullopt;
+        if (!edge || !csr.edgeUsable(*edge))
+        {
+            return std::nullopt;
+        }
+        path.emplace_back(dpids[i], csr.srcInterface(*edge));
+    }
+    if (dstIp != 0)
+    {
+        path.emplace_back(dstIp, 0);
+    }
+    return path;
+}
+
+WhatIfResult
+WhatIfEvaluator::evaluate(const std::vector<PathMove>& moves, size_t topLinks) const
+{
+    WhatIfResult result;
+    if (!m_byUtilization.empty())
+    {
+        result.maxBefore = utilization(m_byUtilization.front(), 0);
+    }
+
+    // Net change of each touched edge
+    std::unordered_map<CsrGraph::EdgeId, int64_t> deltas;
+    auto apply = [&](const sflow::Path& path, int64_t bps) {
+        for (const auto& [node, port] : path)
+        {
+            auto sw = m_edgeAt.find(node);
+            if (sw == m_edgeAt.end())
+            {
+                continue; // a host
+            }
+            auto edge = sw->second.find(port);
+            if (edge == sw->second.end())
+            {
+                result.unknownHops += port != 0;
+                continue;
+            }
+            deltas[edge->second] += bps;
+        }
+    };
+    for (const PathMove& move : moves)
+    {
+        const int64_t bps = static_cast<int64_t>(move.bps);
+        apply(move.oldPath, -bps);
+        apply(move.newPath, bps);
+    }
+
+    for (const auto& [edge, delta] : deltas)
+    {
+        const double after = utilization(edge, delta);
+        if (after > result.maxAfter)
+        {
+            result.maxAfter = after;
+            result.maxAfterEdge = edge;
+        }
+        if (delta != 0)
+        {
+            result.changed.push_back({edge, utilization(edge, 0), after});
+        }
+    }
+    // The busiest edge the moves leave alone
+    for (CsrGraph::EdgeId edge : m_byUtilization)
+    {
+        if (deltas.count(edge) == 0)
+        {
+            if (utilization(edge, 0) > result.maxAfter)
+            {
+                result.maxAfter = utilization(edge, 0);
+                result.maxAfterEdge = edge;
+            }
+            break;
+        }
+    }
+
+    std::sort(result.changed.begin(),
+              result.changed.end(),
+              [](const WhatIfResult::Link& a, const WhatIfResult::Link& b) {
+                  return a.after > b.after || (a.after == b.after && a.edge < b.edge);
+              });
+    if (topLinks != 0 && result.changed.size() > topLinks)
+    {
+        result.changed.resize(topLinks);
+    }
+    return result;
+}
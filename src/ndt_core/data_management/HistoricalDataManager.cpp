@@ -1,7 +1,10 @@
 #include "ndt_core/data_management/HistoricalDataManager.hpp"
 #include "common_types/GraphTypes.hpp"                    // for VertexProp...
+#include "ndt_core/collection/FlowLinkUsageCollector.hpp" // for FlowLinkUs...
 #include "ndt_core/collection/TopologyAndFlowMonitor.hpp" // for TopologyAn...
+#include "ndt_core/data_management/LinkHistoryStore.hpp"  // for LinkHistory...
 #include "spdlog/spdlog.h"                                // for SPDLOG_LOG...
+#include "utils/HistoryWriter.hpp"                        // for HistoryWriter
 #include "utils/Logger.hpp"                               // for Logger
 #include "utils/Utils.hpp"                                // for macToString
 #include <boost/graph/adjacency_list.hpp>                 // for source
@@ -10,21 +13,45 @@
 #include <boost/graph/detail/edge.hpp>                    // for edge_desc_...
 #include <boost/iterator/iterator_facade.hpp>             // for operator!=
 #include <boost/move/utility_core.hpp>                    // for move
+#include <algorithm>                                      // for nth_element
 #include <ctime>                                          // for strftime
 #include <filesystem>                                     // for create_dir...
-#include <fstream>                                        // for char_traits
+#include <memory>                                         // for unique_ptr
+#include <optional>                                       // for optional
 #include <string>                                         // for operator+
 #include <utility>                                        // for move
+#include <vector>                                         // for vector
 
-    HistoricalDataManager::HistoricalDataManager(std::shared_ptr<TopologyAndFlowMonitor> monitor,
-                                             int mode,
-                                             std::chrono::minutes interval)
+namespace
+{
+
+constexpr const char* MINUTE_FILE_SUFFIX = "-1m" LINK_HISTORY_FILE_SUFFIX;
+
+/// YYYYMMDD of the local day containing @p time
+std::string
+dayStem(std::time_t time)
+{
+    std::tm local_tm = *std::localtime(&time);
+    char dateBuf[9]; // YYYYMMDD
+    std::strftime(dateBuf, sizeof(dateBuf), "%Y%m%d", &local_tm);
+    return dateBuf;
+}
+
+} // namespace
+
+HistoricalDataManager::HistoricalDataManager(
+    std::shared_ptr<TopologyAndFlowMonitor> monitor,
+    int mode,
+    std::chrono::minutes interval,
+    std::shared_ptr<sflow::FlowLinkUsageCollector> collector)
     : m_topologyAndFlowMonitor(std::move(monitor)),
+      m_collector(std::move(collector)),
       m_mode(static_cast<utils::DeploymentMode>(mode)),
-      m_interval(interval)
+      m_interval(interval),
+      m_recentHistory(std::chrono::duration_cast<std::chrono::milliseconds>(interval).count())
 {
     // ensure our output directory exists
-    std::filesystem::create_directories("/home/of-controller-sflow-collector/LinkData");
+    std::filesystem::create_directories(HISTORICAL_DATA_DIR);
 }
 
 HistoricalDataManager::~HistoricalDataManager()
@@ -35,108 +62,217 @@ HistoricalDataManager::~HistoricalDataManager()
 void
 HistoricalDataManager::start()
 {
-    if (m_running.exchange(true) or m_mode == utils::DeploymentMode::MININET)
+    if (m_running.exchange(true))
     {
         // Already running
         return;
     }
-    m_thread = std::thread(&HistoricalDataManager::run, this);
+    m_task = utils::TaskScheduler::instance().schedule("history_sampler",
+                                                       utils::TaskPriority::High,
+                                                       std::chrono::seconds(1),
+                                                       [this] { sample(); },
+                                                       true);
     SPDLOG_LOGGER_INFO(Logger::instance(), "HistoricalDataManager started.");
 }
 
 void
 HistoricalDataManager::stop()
 {
-    m_running.store(false);
-    if (m_thread.joinable())
+    if (m_running.exchange(false))
     {
-        m_thread.join();
+        utils::TaskScheduler::instance().cancel(m_task);
+        m_task = 0;
         SPDLOG_LOGGER_INFO(Logger::instance(), "HistoricalDataManager stopped.");
     }
 }
 
 void
-HistoricalDataManager::run()
+HistoricalDataManager::sample()
 {
-    const std::string outDir = "/home/of-controller-sflow-collector/LinkData/";
-
-    while (m_running.load())
+    const std::string outDir = HISTORICAL_DATA_DIR;
+    // Only the testbed keeps files; Mininet runs get the in-memory history alone
+    const bool persist = m_mode != utils::DeploymentMode::MININET;
+    // Edges whose minute or period rollup closed in this tick
+    struct Rolled
     {
-        // 1. Fetch a snapshot clone of the graph
-        Graph graph = m_topologyAndFlowMonitor->getGraph();
-
-        // 2. Build timestamp strings
-        auto now = std::chrono::system_clock::now();
-        std::time_t t = std::chrono::system_clock::to_time_t(now);
-        std::tm local_tm = *std::localtime(&t);
-
-        char dateBuf[9]; // YYYYMMDD
-        std::strftime(dateBuf, sizeof(dateBuf), "%Y%m%d", &local_tm);
-
-        char dateTimeBuf[20]; // YYYY-MM-DD HH:MM:SS
-        std::strftime(dateTimeBuf, sizeof(dateTimeBuf), "%Y-%m-%d %H:%M:%S", &local_tm);
+        LinkHistoryEdge edge;
+        uint64_t linkBandwidth = 0;
+        std::optional<utils::SeriesPoint> minute;
+        std::optional<utils::SeriesPoint> period;
+    };
+    std::vector<Rolled> rolled;
+    std::vector<LinkHistoryWriter::Entry> entries;
 
-        // 3. Iterate each edge and append to per-link CSV under outDir
-        auto [ei, ei_end] = boost::edges(graph);
-        int edgeCnt = 0;
-        for (; ei != ei_end; ++ei)
+    auto append = [&](std::unique_ptr<LinkHistoryWriter>& writer,
+                      const std::string& path,
+                      auto rollup) {
+        entries.clear();
+        int64_t timestampMs = 0;
+        for (const Rolled& r : rolled)
         {
-            edgeCnt++;
-            SPDLOG_LOGGER_DEBUG(Logger::instance(), "edge cnt {}", edgeCnt);
-            auto u = boost::source(*ei, graph);
-            auto v = boost::target(*ei, graph);
-            auto& eprop = graph[*ei];
-            auto& up = graph[u];
-            auto& vp = graph[v];
-
-            SPDLOG_LOGGER_DEBUG(Logger::instance(),
-                                "{} {} {} {} {} {} {} {}",
-                                up.deviceName,
-                                vp.deviceName,
-                                up.dpid,
-                                vp.dpid,
-                                up.mac,
-                                vp.mac,
-                                up.vertexType == VertexType::SWITCH,
-                                vp.vertexType == VertexType::SWITCH);
-            const char* srcType = (up.vertexType == VertexType::SWITCH ? "switch" : "host");
-            const char* dstType = (vp.vertexType == VertexType::SWITCH ? "switch" : "host");
-
-            auto srcId = (up.vertexType == VertexType::SWITCH ? std::to_string(up.dpid)
-                                                              : utils::macToString(up.mac));
-            auto dstId = (vp.vertexType == VertexType::SWITCH ? std::to_string(vp.dpid)
-                                                              : utils::macToString(vp.mac));
-
-            // base filename: YYYYMMDD_srcDpid_dstDpid.csv
-            std::string baseName = std::string(dateBuf) + "_" + srcId + "_" + dstId + ".csv";
-
-            // full path under LinkData
-            std::string fullPath = outDir + baseName;
-
-            bool exists = std::filesystem::exists(fullPath);
-            std::ofstream ofs(fullPath, std::ios::app);
-            if (!exists)
+            if (const auto& point = r.*rollup)
             {
-                ofs << "date-time,srcType,srcId,dstType,dstId,link_bw,link_bw_usage\n";
+                entries.push_back({&r.edge, r.linkBandwidth, point->value});
+                timestampMs = point->timestampMs;
             }
+        }
+        if (entries.empty())
+        {
+            return;
+        }
+        if (!writer || !writer->ok() || writer->path() != path)
+        {
+            writer = std::make_unique<LinkHistoryWriter>(path);
+        }
+        if (!writer->append(timestampMs, entries))
+        {
+            SPDLOG_LOGGER_WARN(
+                Logger::instance(), "HistoricalDataManager: rollup not recorded in {}", path);
+        }
+        SPDLOG_LOGGER_DEBUG(Logger::instance(), "recorded {} edges to {}", entries.size(), path);
+    };
+
+    const auto now = std::chrono::system_clock::now();
+    const int64_t timestampMs =
+        std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
 
-            ofs << dateTimeBuf << "," << srcType << "," << srcId << "," << dstType << "," << dstId
-                << "," << eprop.linkBandwidth << "," << eprop.linkBandwidthUsage << "\n";
+    // 1. Sample the usage of every edge, naming the ones that complete a rollup
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
+    auto [ei, ei_end] = boost::edges(graph);
+    for (; ei != ei_end; ++ei)
+    {
+        const auto& up = graph[boost::source(*ei, graph)];
+        const auto& vp = graph[boost::target(*ei, graph)];
+        const bool srcIsSwitch = up.vertexType == VertexType::SWITCH;
+        const bool dstIsSwitch = vp.vertexType == VertexType::SWITCH;
+        const auto& eprop = graph[*ei];
+        auto closed = m_recentHistory.recordEdge({srcIsSwitch ? up.dpid : up.mac,
+                                                  dstIsSwitch ? vp.dpid : vp.mac},
+                                                 timestampMs,
+                                                 eprop.linkBandwidthUsage);
+        if (!closed.minute && !closed.period)
+        {
+            continue;
         }
+        rolled.push_back(
+            {{srcIsSwitch ? "switch" : "host",
+              srcIsSwitch ? std::to_string(up.dpid) : utils::macToString(up.mac),
+              dstIsSwitch ? "switch" : "host",
+              dstIsSwitch ? std::to_string(vp.dpid) : utils::macToString(vp.mac)},
+             eprop.linkBandwidth,
+             closed.minute,
+             closed.period});
+    }
 
-        // TODO[OPTIMIZW]: Change below methods to condition_variable (more efficient)
-        // 4) Sleep until next interval (or until stop() is called)
-        for (int i = 0; i < m_interval.count() * 60 && m_running.load(); ++i)
+    // 2. Sample the rate of every flow over the last second
+    if (m_collector)
+    {
+        m_collector->visitFlows(
+            sflow::FlowQuery{}, [&](const sflow::FlowKey& key, const sflow::FlowInfo& info) {
+                m_recentHistory.recordFlow(key, timestampMs, info.immediateRate().bps);
+                return true;
+            });
+    }
+    if (timestampMs - m_lastEvictMs >= 60'000)
+    {
+        m_recentHistory.evictIdle(timestampMs);
+        m_lastEvictMs = timestampMs;
+    }
+
+    // 3. Append the closed rollups to the day files
+    if (persist && utils::HistoryWriter::instance().enabled() && !rolled.empty())
+    {
+        const std::string day = dayStem(std::chrono::system_clock::to_time_t(now));
+        append(m_minuteWriter, outDir + day + MINUTE_FILE_SUFFIX, &Rolled::minute);
+        append(m_periodWriter, outDir + day + LINK_HISTORY_FILE_SUFFIX, &Rolled::period);
+    }
+}
+
+nlohmann::json
+HistoricalDataManager::queryLinkHistory(const std::string& srcId,
+                                        const std::string& dstId,
+                                        int64_t fromMs,
+                                        int64_t toMs,
+                                        int64_t stepMs) const
+{
+    const size_t stepCount = static_cast<size_t>((toMs - fromMs) / stepMs + 1);
+    std::vector<std::vector<uint64_t>> usage(stepCount);
+    std::vector<uint64_t> bandwidth(stepCount);
+
+    // One file per local day; the minute rollups where there are some, else the day file
+    std::time_t day = static_cast<std::time_t>(fromMs / 1000);
+    while (static_cast<int64_t>(day) * 1000 <= toMs)
+    {
+        const std::string stem = std::string(HISTORICAL_DATA_DIR) + dayStem(day);
+        std::string path = stem + MINUTE_FILE_SUFFIX;
+        if (!std::filesystem::exists(path))
+        {
+            path = stem + LINK_HISTORY_FILE_SUFFIX;
+        }
+        LinkHistoryReader reader(path);
+        const int64_t edgeId = reader.ok() ? reader.findEdge(srcId, dstId) : -1;
+        if (edgeId >= 0)
         {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            reader.scan(
+                [&](const LinkHistorySample& sample) {
+                    if (sample.edgeId == edgeId)
+                    {
+                        const auto step =
+                            static_cast<size_t>((sample.timestampMs - fromMs) / stepMs);
+                        usage[step].push_back(sample.linkBandwidthUsage);
+                        bandwidth[step] = sample.linkBandwidth;
+                    }
+                },
+                fromMs,
+                toMs);
         }
+
+        // Local midnight after day
+        std::tm next = *std::localtime(&day);
+        next.tm_mday += 1;
+        next.tm_hour = 0;
+        next.tm_min = 0;
+        next.tm_sec = 0;
+        next.tm_isdst = -1;
+        day = std::mktime(&next);
     }
 
+    nlohmann::json steps = nlohmann::json::array();
+    for (size_t i = 0; i < stepCount; ++i)
+    {
+        std::vector<uint64_t>& values = usage[i];
+        if (values.empty())
+        {
+            continue;
+        }
+        uint64_t sum = 0;
+        for (uint64_t value : values)
+        {
+            sum += value;
+        }
+        const uint64_t max = *std::max_element(values.begin(), values.end());
+        // Nearest rank
+        auto p95 = values.begin() + static_cast<ptrdiff_t>((values.size() * 95 + 99) / 100 - 1);
+        std::nth_element(values.begin(), p95, values.end());
+        steps.push_back({{"start_ms", fromMs + static_cast<int64_t>(i) * stepMs},
+                         {"samples", values.size()},
+                         {"avg", sum / values.size()},
+                         {"max", max},
+                         {"p95", *p95},
+                         {"link_bandwidth", bandwidth[i]}});
+    }
+    return {{"src", srcId},
+            {"dst", dstId},
+            {"from_ms", fromMs},
+            {"to_ms", toMs},
+            {"step_ms", stepMs},
+            {"steps", std::move(steps)}};
 }
 
-void 
+void
 HistoricalDataManager::setLoggingState(bool enable)
 {
-    m_loggingEnabled.store(enable);
+    utils::HistoryWriter::instance().setEnabled(enable);
     SPDLOG_LOGGER_INFO(Logger::instance(), "Historical data logging has been {}.", (enable ? "ENABLED" : "DISABLED"));
 }
@@ -0,0 +1,550 @@
+#include "ndt_core/data_management/LinkHistoryStore.hpp"
+#include "utils/HistoryWriter.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+namespace
+{
+
+constexpr char MAGIC[] = "NDTH1\n";
+constexpr size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+constexpr char INDEX_MAGIC[] = "NDTI1\n";
+constexpr size_t INDEX_MAGIC_SIZE = sizeof(INDEX_MAGIC) - 1;
+constexpr char TAG_EDGE = 'E';
+constexpr char TAG_SAMPLE = 'S';
+constexpr char TAG_KEYFRAME = 'K';
+
+void
+putVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void
+putSigned(std::string& out, int64_t value)
+{
+    // Zigzag: small negative numbers stay short too
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void
+putString(std::string& out, const std::string& value)
+{
+    putVarint(out, value.size());
+    out.append(value);
+}
+
+void
+putEdge(std::string& out, const LinkHistoryEdge& edge)
+{
+    out.push_back(TAG_EDGE);
+    putString(out, edge.srcType);
+    putString(out, edge.srcId);
+    putString(out, edge.dstType);
+    putString(out, edge.dstId);
+}
+
+void
+putKeyframe(std::string& out, const LinkHistoryKeyframe& keyframe)
+{
+    out.push_back(TAG_KEYFRAME);
+    putSigned(out, keyframe.timestampMs);
+    putVarint(out, keyframe.offset);
+    putVarint(out, keyframe.edgeCount);
+}
+
+// Bytes [@p offset, @p end) of @p path, or to its end; false if it cannot be read
+bool
+readFile(const std::string& path,
+         std::string& out,
+         uint64_t offset = 0,
+         uint64_t end = std::numeric_limits<uint64_t>::max())
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    const auto size = static_cast<uint64_t>(in.tellg());
+    end = std::min(end, size);
+    out.resize(offset < end ? end - offset : 0);
+    in.seekg(static_cast<std::streamoff>(offset));
+    in.read(out.data(), static_cast<std::streamsize>(out.size()));
+    out.resize(static_cast<size_t>(in.gcount()));
+    return true;
+}
+
+bool
+writeAll(int fd, const std::string& data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        const ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Reads advance @c pos and fail once the data runs out
+struct Cursor
+{
+    const std::string& data;
+    size_t pos;
+
+    bool varint(uint64_t& value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= data.size())
+            {
+                return false;
+            }
+            const auto byte = static_cast<uint8_t>(data[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool signedVarint(int64_t& value)
+    {
+        uint64_t raw = 0;
+        if (!varint(raw))
+        {
+            return false;
+        }
+        value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+    }
+
+    bool string(std::string& value)
+    {
+        uint64_t size = 0;
+        if (!varint(size) || size > data.size() - pos)
+        {
+            return false;
+        }
+        value.assign(data, pos, size);
+        pos += size;
+        return true;
+    }
+
+    bool edge(LinkHistoryEdge& value)
+    {
+        return string(value.srcType) && string(value.srcId) && string(value.dstType) &&
+               string(value.dstId);
+    }
+};
+
+constexpr int64_t MIN_TIME = std::numeric_limits<int64_t>::min();
+constexpr int64_t MAX_TIME = std::numeric_limits<int64_t>::max();
+
+} // namespace
+
+LinkHistoryReader::LinkHistoryReader(const std::string& path, bool useIndex)
+    : m_path(path)
+{
+    if (useIndex && loadIndex())
+    {
+        m_ok = true;
+        return;
+    }
+    m_edges.clear();
+    m_keyframes.clear();
+
+    std::string data;
+    if (!readFile(m_path, data) || data.compare(0, MAGIC_SIZE, MAGIC) != 0)
+    {
+        return;
+    }
+    m_ok = true;
+    m_keyframes.push_back({MIN_TIME, MAGIC_SIZE, 0});
+    m_validBytes =
+        decode(data, MAGIC_SIZE, 0, 0, &m_edges, &m_keyframes, nullptr, MIN_TIME, MAX_TIME);
+}
+
+bool
+LinkHistoryReader::loadIndex()
+{
+    std::string magic;
+    std::string index;
+    if (!readFile(m_path, magic, 0, MAGIC_SIZE) || magic != MAGIC ||
+        !readFile(m_path + LINK_HISTORY_INDEX_SUFFIX, index) ||
+        index.compare(0, INDEX_MAGIC_SIZE, INDEX_MAGIC) != 0)
+    {
+        return false;
+    }
+
+    m_keyframes.push_back({MIN_TIME, MAGIC_SIZE, 0});
+    Cursor in{index, INDEX_MAGIC_SIZE};
+    while (in.pos < index.size())
+    {
+        const char tag = index[in.pos++];
+        LinkHistoryEdge edge;
+        LinkHistoryKeyframe keyframe;
+        uint64_t edgeCount = 0;
+        if (tag == TAG_EDGE && in.edge(edge))
+        {
+            m_edges.push_back(std::move(edge));
+        }
+        else if (tag == TAG_KEYFRAME && in.signedVarint(keyframe.timestampMs) &&
+                 in.varint(keyframe.offset) && in.varint(edgeCount) &&
+                 keyframe.offset > m_keyframes.back().offset)
+        {
+            keyframe.edgeCount = static_cast<uint32_t>(edgeCount);
+            m_keyframes.push_back(keyframe);
+        }
+        else
+        {
+            // A torn last record: the entries before it are still good
+            break;
+        }
+    }
+    return true;
+}
+
+int64_t
+LinkHistoryReader::findEdge(const std::string& srcId, const std::string& dstId) const
+{
+    for (size_t i = 0; i < m_edges.size(); ++i)
+    {
+        if (m_edges[i].srcId == srcId && m_edges[i].dstId == dstId)
+        {
+            return static_cast<int64_t>(i);
+        }
+    }
+    return -1;
+}
+
+void
+LinkHistoryReader::scan(const std::function<void(const LinkHistorySample&)>& visit,
+                        int64_t fromMs,
+                        int64_t toMs) const
+{
+    if (!m_ok || fromMs > toMs)
+    {
+        return;
+    }
+    auto later = [](int64_t timestampMs, const LinkHistoryKeyframe& keyframe) {
+        return timestampMs < keyframe.timestampMs;
+    };
+    // The first keyframe is at the start of the file, so there is always one at or before
+    auto first = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), fromMs, later) - 1;
+    auto last = std::upper_bound(first, m_keyframes.end(), toMs, later);
+
+    std::string data;
+    if (readFile(m_path,
+                 data,
+                 first->offset,
+                 last == m_keyframes.end() ? std::numeric_limits<uint64_t>::max() : last->offset))
+    {
+        decode(data, 0, first->offset, first->edgeCount, nullptr, nullptr, &visit, fromMs, toMs);
+    }
+}
+
+size_t
+LinkHistoryReader::decode(const std::string& data,
+                          size_t pos,
+                          uint64_t baseOffset,
+                          uint32_t edgeCount,
+                          std::vector<LinkHistoryEdge>* edges,
+                          std::vector<LinkHistoryKeyframe>* keyframes,
+                          const std::function<void(const LinkHistorySample&)>* visit,
+                          int64_t fromMs,
+                          int64_t toMs)
+{
+    Cursor in{data, pos};
+    std::vector<LinkHistorySample> last(edgeCount); // by edge id, the values deltas are taken from
+    std::vector<LinkHistorySample> sample;
+    int64_t timestampMs = 0;
+
+    size_t complete = in.pos;
+    while (in.pos < data.size())
+    {
+        const size_t recordPos = in.pos;
+        const char tag = data[in.pos++];
+        if (tag == TAG_EDGE)
+        {
+            LinkHistoryEdge edge;
+            if (!in.edge(edge))
+            {
+                break;
+            }
+            if (edges)
+            {
+                edges->push_back(std::move(edge));
+            }
+            ++edgeCount;
+            last.emplace_back();
+        }
+        else if (tag == TAG_SAMPLE || tag == TAG_KEYFRAME)
+        {
+            int64_t delta = 0;
+            uint64_t count = 0;
+            if (!in.signedVarint(delta) || !in.varint(count) || count > edgeCount)
+            {
+                break;
+            }
+            sample.assign(count, LinkHistorySample{});
+            uint64_t id = 0;
+            bool valid = true;
+            for (uint64_t i = 0; i < count && valid; ++i)
+            {
+                uint64_t gap = 0;
+                valid = in.varint(gap) && (id += gap) < edgeCount;
+                sample[i].edgeId = static_cast<uint32_t>(id);
+            }
+            if (tag == TAG_KEYFRAME)
+            {
+                // Nothing before a keyframe counts
+                timestampMs = 0;
+                std::fill(last.begin(), last.end(), LinkHistorySample{});
+            }
+            for (uint64_t i = 0; i < count && valid; ++i)
+            {
+                int64_t change = 0;
+                valid = in.signedVarint(change);
+                sample[i].linkBandwidth = last[sample[i].edgeId].linkBandwidth + change;
+            }
+            for (uint64_t i = 0; i < count && valid; ++i)
+            {
+                int64_t change = 0;
+                valid = in.signedVarint(change);
+                sample[i].linkBandwidthUsage = last[sample[i].edgeId].linkBandwidthUsage + change;
+            }
+            if (!valid)
+            {
+                break;
+            }
+            timestampMs += delta;
+            if (timestampMs > toMs)
+            {
+                break;
+            }
+            if (keyframes && tag == TAG_KEYFRAME)
+            {
+                keyframes->push_back({timestampMs, baseOffset + recordPos, edgeCount});
+            }
+            for (LinkHistorySample& s : sample)
+            {
+                s.timestampMs = timestampMs;
+                last[s.edgeId] = s;
+                if (visit && timestampMs >= fromMs)
+                {
+                    (*visit)(s);
+                }
+            }
+        }
+        else
+        {
+            break;
+        }
+        complete = in.pos;
+    }
+    return baseOffset + complete;
+}
+
+LinkHistoryWriter::LinkHistoryWriter(std::string path)
+    : m_path(std::move(path))
+{
+    // Records of a previous writer of the file may still be queued
+    utils::HistoryWriter::instance().flush();
+    // Decode the whole file: the index may be missing what a crash left out of it
+    LinkHistoryReader existing(m_path, false);
+    const int fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        SPDLOG_LOGGER_ERROR(
+            Logger::instance(), "LinkHistoryWriter: cannot open {}: {}", m_path, strerror(errno));
+        return;
+    }
+    m_file = std::make_shared<utils::HistoryFile>(fd, m_path);
+
+    if (existing.ok())
+    {
+        // Carry on where the file left off, minus any record a crash cut short
+        m_size = existing.validBytes();
+        if (::ftruncate(fd, static_cast<off_t>(m_size)) != 0)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "LinkHistoryWriter: cannot trim {}: {}",
+                               m_path,
+                               strerror(errno));
+        }
+        for (const LinkHistoryEdge& edge : existing.edges())
+        {
+            m_ids.emplace(std::make_pair(edge.srcId, edge.dstId),
+                          static_cast<uint32_t>(m_last.size()));
+            m_last.emplace_back();
+        }
+        // The deltas of the next sample only depend on the samples since the last keyframe
+        existing.scan(
+            [this](const LinkHistorySample& sample) {
+                if (sample.timestampMs != m_lastTimestampMs || m_sinceKeyframe == 0)
+                {
+                    ++m_sinceKeyframe;
+                }
+                m_lastTimestampMs = sample.timestampMs;
+                m_last[sample.edgeId] = {sample.linkBandwidth, sample.linkBandwidthUsage};
+            },
+            existing.keyframes().back().timestampMs);
+        writeIndex(existing.edges(), existing.keyframes());
+        return;
+    }
+
+    // A new file, or one that is not ours: start over
+    if (::ftruncate(fd, 0) != 0 ||
+        ::write(fd, MAGIC, MAGIC_SIZE) != static_cast<ssize_t>(MAGIC_SIZE))
+    {
+        SPDLOG_LOGGER_ERROR(
+            Logger::instance(), "LinkHistoryWriter: cannot start {}: {}", m_path, strerror(errno));
+        m_file.reset();
+        return;
+    }
+    m_size = MAGIC_SIZE;
+    writeIndex({}, {});
+}
+
+LinkHistoryWriter::~LinkHistoryWriter() = default;
+
+void
+LinkHistoryWriter::writeIndex(const std::vector<LinkHistoryEdge>& edges,
+                              const std::vector<LinkHistoryKeyframe>& keyframes)
+{
+    const std::string indexPath = m_path + LINK_HISTORY_INDEX_SUFFIX;
+    const int fd =
+        ::open(indexPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    std::string index(INDEX_MAGIC, INDEX_MAGIC_SIZE);
+    for (const LinkHistoryEdge& edge : edges)
+    {
+        putEdge(index, edge);
+    }
+    for (size_t i = 1; i < keyframes.size(); ++i)
+    {
+        putKeyframe(index, keyframes[i]);
+    }
+    if (fd < 0 || !writeAll(fd, index))
+    {
+        // Readers then decode the whole history file instead
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "LinkHistoryWriter: cannot write {}: {}",
+                           indexPath,
+                           strerror(errno));
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return;
+    }
+    m_indexFile = std::make_shared<utils::HistoryFile>(fd, indexPath);
+}
+
+bool
+LinkHistoryWriter::append(int64_t timestampMs, const std::vector<Entry>& entries)
+{
+    if (!ok())
+    {
+        return false;
+    }
+
+    // Edge ids for the entries, defining the new ones ahead of the sample
+    m_buffer.clear();
+    m_indexBuffer.clear();
+    std::vector<std::pair<uint32_t, const Entry*>> sample;
+    sample.reserve(entries.size());
+    for (const Entry& entry : entries)
+    {
+        auto [it, added] = m_ids.try_emplace(std::make_pair(entry.edge->srcId, entry.edge->dstId),
+                                             static_cast<uint32_t>(m_last.size()));
+        if (added)
+        {
+            putEdge(m_buffer, *entry.edge);
+            putEdge(m_indexBuffer, *entry.edge);
+            m_last.emplace_back();
+        }
+        sample.emplace_back(it->second, &entry);
+    }
+    std::sort(sample.begin(), sample.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+    // An edge listed twice is recorded once
+    sample.erase(std::unique(sample.begin(),
+                             sample.end(),
+                             [](const auto& a, const auto& b) { return a.first == b.first; }),
+                 sample.end());
+
+    // A keyframe is encoded against zeros rather than the previous sample
+    const bool keyframe = m_sinceKeyframe >= LINK_HISTORY_KEYFRAME_SAMPLES;
+    std::vector<Last> base = keyframe ? std::vector<Last>(m_last.size()) : m_last;
+    std::vector<Last> next = m_last;
+    if (keyframe)
+    {
+        putKeyframe(m_indexBuffer,
+                    {timestampMs, m_size + m_buffer.size(), static_cast<uint32_t>(m_last.size())});
+    }
+    m_buffer.push_back(keyframe ? TAG_KEYFRAME : TAG_SAMPLE);
+    putSigned(m_buffer, timestampMs - (keyframe ? 0 : m_lastTimestampMs));
+    putVarint(m_buffer, sample.size());
+    uint32_t previousId = 0;
+    for (const auto& [id, entry] : sample)
+    {
+        putVarint(m_buffer, id - previousId);
+        previousId = id;
+    }
+    for (const auto& [id, entry] : sample)
+    {
+        putSigned(m_buffer, static_cast<int64_t>(entry->linkBandwidth - base[id].linkBandwidth));
+        next[id].linkBandwidth = entry->linkBandwidth;
+    }
+    for (const auto& [id, entry] : sample)
+    {
+        putSigned(m_buffer,
+                  static_cast<int64_t>(entry->linkBandwidthUsage - base[id].linkBandwidthUsage));
+        next[id].linkBandwidthUsage = entry->linkBandwidthUsage;
+    }
+
+    // Refused, the ids just handed out are not on disk: the file fails, and reopening it
+    // recovers a consistent state
+    const size_t size = m_buffer.size();
+    if (!utils::HistoryWriter::instance().submit(m_file, std::move(m_buffer)))
+    {
+        return false;
+    }
+    m_size += size;
+    m_lastTimestampMs = timestampMs;
+    m_last = std::move(next);
+    m_sinceKeyframe = keyframe ? 1 : m_sinceKeyframe + 1;
+
+    // Queued after the history record it points into; if it fails, reopening the history file
+    // rebuilds the index
+    if (m_indexFile && !m_indexFile->failed() && !m_indexBuffer.empty())
+    {
+        utils::HistoryWriter::instance().submit(m_indexFile, std::move(m_indexBuffer));
+    }
+    return true;
+}
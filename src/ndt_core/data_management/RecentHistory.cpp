@@ -0,0 +1,145 @@
+#include "ndt_core/data_management/RecentHistory.hpp"
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+
+constexpr int64_t MINUTE_MS = 60'000;
+
+} // namespace
+
+std::optional<utils::SeriesPoint>
+RecentHistory::Rollup::add(int64_t periodMs, const utils::SeriesPoint& point)
+{
+    const int64_t pointStart = point.timestampMs - point.timestampMs % periodMs;
+    std::optional<utils::SeriesPoint> closed;
+    if (startMs >= 0 && pointStart != startMs)
+    {
+        closed = utils::SeriesPoint{startMs, sum / count, peak};
+        count = 0;
+    }
+    if (count == 0)
+    {
+        startMs = pointStart;
+        sum = 0;
+        peak = 0;
+    }
+    sum += point.value;
+    peak = std::max(peak, point.peak);
+    ++count;
+    return closed;
+}
+
+RecentHistory::RecentHistory(int64_t persistPeriodMs)
+    : m_persistPeriodMs(std::max<int64_t>(persistPeriodMs, 1000))
+{
+}
+
+RecentHistory::Closed
+RecentHistory::record(Series& series, int64_t timestampMs, uint64_t value)
+{
+    const utils::SeriesPoint point{timestampMs, value, value};
+    series.seconds.push(point);
+    series.lastMs = timestampMs;
+    Closed closed;
+    closed.minute = series.minute.add(MINUTE_MS, point);
+    if (closed.minute)
+    {
+        series.minutes.push(*closed.minute);
+    }
+    closed.period = series.period.add(m_persistPeriodMs, point);
+    return closed;
+}
+
+RecentHistory::Closed
+RecentHistory::recordEdge(const EdgeKey& edge, int64_t timestampMs, uint64_t usage)
+{
+    // Only this thread changes the map, so it may look up without the lock
+    auto it = m_edges.find(edge);
+    if (it == m_edges.end())
+    {
+        auto series = std::make_unique<Series>();
+        std::unique_lock lock(m_mutex);
+        it = m_edges.emplace(edge, std::move(series)).first;
+    }
+    return record(*it->second, timestampMs, usage);
+}
+
+void
+RecentHistory::recordFlow(const sflow::FlowKey& flow, int64_t timestampMs, uint64_t rateBps)
+{
+    auto it = m_flows.find(flow);
+    if (it == m_flows.end())
+    {
+        if (m_flows.size() >= HISTORY_MAX_FLOW_SERIES)
+        {
+            m_flowsSkipped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto series = std::make_unique<Series>();
+        std::unique_lock lock(m_mutex);
+        it = m_flows.emplace(flow, std::move(series)).first;
+    }
+    record(*it->second, timestampMs, rateBps);
+}
+
+bool
+RecentHistory::tracksFlow(const sflow::FlowKey& flow) const
+{
+    return m_flows.count(flow) != 0;
+}
+
+void
+RecentHistory::evictIdle(int64_t nowMs)
+{
+    const int64_t cutoff = nowMs - static_cast<int64_t>(HISTORY_SECOND_POINTS) * 1000;
+    std::unique_lock lock(m_mutex);
+    std::erase_if(m_edges, [&](const auto& entry) { return entry.second->lastMs < cutoff; });
+    std::erase_if(m_flows, [&](const auto& entry) { return entry.second->lastMs < cutoff; });
+}
+
+std::vector<utils::SeriesPoint>
+RecentHistory::read(const Series* series, Resolution resolution, int64_t fromMs, int64_t toMs)
+{
+    std::vector<utils::SeriesPoint> points;
+    if (series)
+    {
+        const utils::SeriesRing& ring =
+            resolution == Resolution::Second ? series->seconds : series->minutes;
+        points.reserve(ring.capacity());
+        ring.read(fromMs, toMs, points);
+    }
+    return points;
+}
+
+std::vector<utils::SeriesPoint>
+RecentHistory::edgeHistory(const EdgeKey& edge,
+                           Resolution resolution,
+                           int64_t fromMs,
+                           int64_t toMs) const
+{
+    std::shared_lock lock(m_mutex);
+    auto it = m_edges.find(edge);
+    return read(it == m_edges.end() ? nullptr : it->second.get(), resolution, fromMs, toMs);
+}
+
+std::vector<utils::SeriesPoint>
+RecentHistory::flowHistory(const sflow::FlowKey& flow,
+                           Resolution resolution,
+                           int64_t fromMs,
+                           int64_t toMs) const
+{
+    std::shared_lock lock(m_mutex);
+    auto it = m_flows.find(flow);
+    return read(it == m_flows.end() ? nullptr : it->second.get(), resolution, fromMs, toMs);
+}
+
+nlohmann::json
+RecentHistory::statsJson() const
+{
+    std::shared_lock lock(m_mutex);
+    return {{"edges", m_edges.size()},
+            {"flows", m_flows.size()},
+            {"flows_skipped", m_flowsSkipped.load(std::memory_order_relaxed)}};
+}
@@ -0,0 +1,422 @@
+#include "ndt_core/data_management/StateReplicator.hpp"
+#include "ndt_core/collection/CollectorCheckpoint.hpp"    // for CheckpointCursor
+#include "ndt_core/collection/FlowLinkUsageCollector.hpp" // for FlowLinkUsageCollector
+#include "ndt_core/lock_management/LockManager.hpp"       // for LockManager
+#include "utils/Logger.hpp"                               // for Logger
+#include "utils/ThreadRegistry.hpp"                       // for ThreadRegistry
+#include "utils/Utils.hpp"                                // for getCurrentTimeMillis...
+#include <algorithm>                                      // for max
+#include <cerrno>                                         // for errno
+#include <cstring>                                        // for strerror
+#include <netdb.h>                                        // for getaddrinfo
+#include <netinet/in.h>                                   // for sockaddr_in
+#include <optional>                                       // for optional
+#include <poll.h>                                         // for poll
+#include <sys/socket.h>                                   // for socket
+#include <unistd.h>                                       // for close
+
+namespace
+{
+
+constexpr char FRAME_STATE = 'S';  // primary: CheckpointWriter::finish() bytes
+constexpr char FRAME_LEASES = 'L'; // primary: LockManager::exportLeases() as JSON text
+constexpr char FRAME_ACK = 'A';    // standby: savedSystemMs of the state it applied
+constexpr size_t FRAME_HEADER = 5; // length (of kind and payload) and kind
+constexpr int POLL_MS = 200;       // the standby re-checks stop() and failover this often
+
+void
+putBig(std::string& out, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i-- > 0;)
+    {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+uint64_t
+getBig(const char* data, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        value = value << 8 | static_cast<uint8_t>(data[i]);
+    }
+    return value;
+}
+
+/**
+ * Move the frame at the front of @p buffer into @p kind and @p payload; false if it has not
+ * fully arrived. @p bad is set if the frame cannot be one.
+ */
+bool
+takeFrame(std::string& buffer, char& kind, std::string& payload, bool& bad)
+{
+    if (buffer.size() < FRAME_HEADER)
+    {
+        return false;
+    }
+    const size_t length = getBig(buffer.data(), 4);
+    if (length == 0 || length > REPLICATION_MAX_FRAME)
+    {
+        bad = true;
+        return false;
+    }
+    if (buffer.size() < 4 + length)
+    {
+        return false;
+    }
+    kind = buffer[4];
+    payload.assign(buffer, FRAME_HEADER, length - 1);
+    buffer.erase(0, 4 + length);
+    return true;
+}
+
+} // namespace
+
+StateReplicator::StateReplicator(ReplicationConfig config,
+                                 std::shared_ptr<sflow::FlowLinkUsageCollector> collector,
+                                 std::shared_ptr<LockManager> lockManager)
+    : m_config(std::move(config)),
+      m_collector(std::move(collector)),
+      m_lockManager(std::move(lockManager)),
+      m_lag(utils::MetricsRegistry::instance().gauge(
+          "ndt_replication_lag_seconds",
+          "Age of the newest state the hot standby has (primary: acknowledged, standby: "
+          "applied)")),
+      m_bytes(utils::MetricsRegistry::instance().counter(
+          "ndt_replication_bytes_total", "Bytes exchanged with the other side of a standby pair")),
+      m_resyncs(utils::MetricsRegistry::instance().counter(
+          "ndt_replication_resyncs_total", "Replication connections started with the whole state"))
+{
+}
+
+StateReplicator::~StateReplicator()
+{
+    stop();
+}
+
+void
+StateReplicator::start(Takeover onTakeover)
+{
+    if (m_config.listenPort == 0)
+    {
+        onTakeover();
+        if (m_config.standby.empty())
+        {
+            return;
+        }
+        m_running.store(true);
+        m_thread = std::thread(&StateReplicator::runPrimary, this);
+        return;
+    }
+
+    m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const int on = 1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(m_config.listenPort);
+    if (m_listenFd < 0 ||
+        setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+        ::bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(m_listenFd, 1) != 0)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(),
+                            "Replication: cannot listen on port {}: {}; serving as primary",
+                            m_config.listenPort,
+                            strerror(errno));
+        if (m_listenFd >= 0)
+        {
+            ::close(m_listenFd);
+            m_listenFd = -1;
+        }
+        onTakeover();
+        return;
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Standing by for a primary on port {}; HTTP server held back",
+                       m_config.listenPort);
+    m_onTakeover = std::move(onTakeover);
+    m_running.store(true);
+    m_thread = std::thread(&StateReplicator::runStandby, this);
+}
+
+void
+StateReplicator::stop()
+{
+    {
+        std::lock_guard lock(m_waitMutex);
+        if (!m_running.exchange(false))
+        {
+            return;
+        }
+    }
+    m_waitCv.notify_all();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    closeConnection();
+    if (m_listenFd >= 0)
+    {
+        ::close(m_listenFd);
+        m_listenFd = -1;
+    }
+}
+
+void
+StateReplicator::waitFor(int64_t ms)
+{
+    std::unique_lock lock(m_waitMutex);
+    m_waitCv.wait_for(lock, std::chrono::milliseconds(ms), [this] { return !m_running.load(); });
+}
+
+void
+StateReplicator::closeConnection()
+{
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_inbox.clear();
+}
+
+bool
+StateReplicator::connectToStandby()
+{
+    const size_t colon = m_config.standby.rfind(':');
+    if (colon == std::string::npos)
+    {
+        return false;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    const std::string host = m_config.standby.substr(0, colon);
+    const std::string port = m_config.standby.substr(colon + 1);
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+    {
+        return false;
+    }
+    for (addrinfo* ai = result; ai && m_fd < 0; ai = ai->ai_next)
+    {
+        m_fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (m_fd >= 0 && ::connect(m_fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (m_fd < 0)
+    {
+        return false;
+    }
+    // A standby that stops reading must not hold the primary past its failover time
+    const timeval timeout{REPLICATION_FAILOVER_MS / 1000, (REPLICATION_FAILOVER_MS % 1000) * 1000};
+    setsockopt(m_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return true;
+}
+
+bool
+StateReplicator::sendFrame(char kind, const std::string& payload)
+{
+    std::string header;
+    putBig(header, payload.size() + 1, 4);
+    header.push_back(kind);
+    const std::string* parts[] = {&header, &payload};
+    for (const std::string* part : parts)
+    {
+        size_t sent = 0;
+        while (sent < part->size())
+        {
+            const ssize_t n =
+                ::send(m_fd, part->data() + sent, part->size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+    m_bytes.add(FRAME_HEADER + payload.size());
+    return true;
+}
+
+bool
+StateReplicator::readAcks()
+{
+    char buffer[512];
+    while (true)
+    {
+        const ssize_t n = ::recv(m_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n == 0)
+        {
+            return false;
+        }
+        if (n < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        m_inbox.append(buffer, static_cast<size_t>(n));
+        char kind = 0;
+        std::string payload;
+        bool bad = false;
+        while (takeFrame(m_inbox, kind, payload, bad))
+        {
+            if (kind == FRAME_ACK && payload.size() == 8)
+            {
+                m_ackedSystemMs = static_cast<int64_t>(getBig(payload.data(), 8));
+            }
+        }
+        if (bad)
+        {
+            return false;
+        }
+    }
+}
+
+void
+StateReplicator::runPrimary()
+{
+    utils::ThreadRegistry::Scope thread("replicate-out");
+    sflow::CheckpointCursor cursor;
+    bool wasConnected = false;
+    while (m_running.load())
+    {
+        if (m_fd < 0)
+        {
+            if (!connectToStandby())
+            {
+                if (wasConnected)
+                {
+                    SPDLOG_LOGGER_WARN(
+                        Logger::instance(), "Replication: standby {} lost", m_config.standby);
+                    wasConnected = false;
+                }
+                waitFor(REPLICATION_RETRY_MS);
+                continue;
+            }
+            SPDLOG_LOGGER_INFO(
+                Logger::instance(), "Replicating state to standby {}", m_config.standby);
+            wasConnected = true;
+            cursor = {};
+            m_resyncs.add();
+        }
+
+        const std::string state = m_collector->encodeState(cursor).finish();
+        const bool sent = sendFrame(FRAME_STATE, state) &&
+                          (!m_lockManager ||
+                           sendFrame(FRAME_LEASES, m_lockManager->exportLeases().dump()));
+        if (!sent || !readAcks())
+        {
+            closeConnection();
+            continue;
+        }
+        if (m_ackedSystemMs != 0)
+        {
+            const int64_t lagMs = utils::getCurrentTimeMillisSystemClock() - m_ackedSystemMs;
+            m_lag.set(static_cast<double>(std::max<int64_t>(lagMs, 0)) / 1000.0);
+        }
+        waitFor(REPLICATION_INTERVAL_MS);
+    }
+    closeConnection();
+}
+
+void
+StateReplicator::applyFrame(char kind, const std::string& payload)
+{
+    if (kind == FRAME_STATE)
+    {
+        std::string error;
+        std::optional<sflow::Checkpoint> state = sflow::decodeCheckpoint(payload, error);
+        if (!state)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(), "Replication: state frame is {}", error);
+            return;
+        }
+        m_collector->applyReplicatedState(*state);
+        const int64_t savedSystemMs = state->header.savedSystemMs;
+        const int64_t lagMs = utils::getCurrentTimeMillisSystemClock() - savedSystemMs;
+        m_lag.set(static_cast<double>(std::max<int64_t>(lagMs, 0)) / 1000.0);
+        std::string ack;
+        putBig(ack, static_cast<uint64_t>(savedSystemMs), 8);
+        sendFrame(FRAME_ACK, ack);
+    }
+    else if (kind == FRAME_LEASES && m_lockManager)
+    {
+        const auto leases = nlohmann::json::parse(payload, nullptr, false);
+        if (!leases.is_discarded())
+        {
+            m_lockManager->importLeases(leases);
+        }
+    }
+}
+
+void
+StateReplicator::runStandby()
+{
+    utils::ThreadRegistry::Scope thread("replicate-in");
+    int64_t lastFrameMs = 0; // steady clock; 0 until a primary has been heard from
+    char buffer[64 * 1024];
+    while (m_running.load())
+    {
+        pollfd pfd{m_fd >= 0 ? m_fd : m_listenFd, POLLIN, 0};
+        const int ready = ::poll(&pfd, 1, POLL_MS);
+        if (ready > 0 && m_fd < 0)
+        {
+            m_fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (m_fd >= 0)
+            {
+                SPDLOG_LOGGER_INFO(Logger::instance(), "Replication: primary connected");
+                m_resyncs.add();
+            }
+        }
+        else if (ready > 0)
+        {
+            const ssize_t n = ::recv(m_fd, buffer, sizeof(buffer), 0);
+            if (n <= 0 && !(n < 0 && errno == EINTR))
+            {
+                SPDLOG_LOGGER_WARN(Logger::instance(), "Replication: primary disconnected");
+                closeConnection();
+            }
+            else if (n > 0)
+            {
+                m_bytes.add(static_cast<uint64_t>(n));
+                m_inbox.append(buffer, static_cast<size_t>(n));
+                char kind = 0;
+                std::string payload;
+                bool bad = false;
+                while (takeFrame(m_inbox, kind, payload, bad))
+                {
+                    applyFrame(kind, payload);
+                    lastFrameMs = utils::getCurrentTimeMillisSteadyClock();
+                }
+                if (bad)
+                {
+                    SPDLOG_LOGGER_WARN(Logger::instance(), "Replication: bad frame; reconnecting");
+                    closeConnection();
+                }
+            }
+        }
+
+        const int64_t silentMs = utils::getCurrentTimeMillisSteadyClock() - lastFrameMs;
+        if (lastFrameMs != 0 && silentMs > REPLICATION_FAILOVER_MS)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "Replication: primary silent for {} ms; taking over",
+                               silentMs);
+            closeConnection();
+            ::close(m_listenFd);
+            m_listenFd = -1;
+            m_onTakeover();
+            return;
+        }
+    }
+}
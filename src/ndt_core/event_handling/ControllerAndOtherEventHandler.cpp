@@ -1,8 +1,12 @@
 #include "ndt_core/event_handling/ControllerAndOtherEventHandler.hpp"
+#include "ndt_core/application_management/SnapshotExporter.hpp"
+#include "ndt_core/http/AdmissionControl.hpp"
 #include "ndt_core/http/HttpSession.hpp"
+#include "ndt_core/http/TelemetryStream.hpp"
 #include "nlohmann/json.hpp" // for json
 #include "spdlog/spdlog.h"
 #include "utils/Logger.hpp"
+#include "utils/ThreadRegistry.hpp"
 #include "utils/Utils.hpp"
 #include "ndt_core/lock_management/LockManager.hpp"
 #include <algorithm> // for max
@@ -22,6 +26,7 @@
 #include <boost/asio/ip/detail/impl/endpoint.ipp>
 #include <boost/asio/ip/impl/address.hpp>
 #include <boost/asio/ip/tcp.hpp> // for tcp
+#include <boost/asio/strand.hpp>   // for make_strand
 #include <boost/system/detail/error_code.hpp>
 #include <exception>
 #include <mutex>
@@ -52,8 +57,10 @@ ControllerAndOtherEventHandler::ControllerAndOtherEventHandler(
     std::shared_ptr<Controller> ctrl,
     std::shared_ptr<LockManager> lockManager,
     int mode,
+    unsigned ioThreads,
     std::string api_url)
     : m_ioContext(ioc),
+      m_ioThreads(resolveIoThreads(ioThreads)),
       m_topologyAndFlowMonitor(std::move(topologyAndFlowMonitor)),
       m_flowLinkUsageCollector(std::move(collector)),
       m_flowRoutingManager(std::move(flowRoutingManager)),
@@ -67,6 +74,16 @@ ControllerAndOtherEventHandler::ControllerAndOtherEventHandler(
       m_apiUrl(std::move(api_url)),
       m_lockManager(std::move(lockManager))
 {
+    m_telemetryHub = std::make_shared<TelemetryHub>(m_topologyAndFlowMonitor,
+                                                    m_flowLinkUsageCollector,
+                                                    m_mode);
+    if (m_eventBus)
+    {
+        m_telemetryHub->followElephantFlows(*m_eventBus);
+    }
+    m_snapshotExporter = std::make_shared<SnapshotExporter>(m_topologyAndFlowMonitor,
+                                                            m_flowLinkUsageCollector,
+                                                            m_applicationManager);
 }
 
 ControllerAndOtherEventHandler::~ControllerAndOtherEventHandler()
@@ -80,6 +97,7 @@ ControllerAndOtherEventHandler::start()
     this->m_serverRunning.store(true);
 
     m_serverAcceptor = make_unique<tcp::acceptor>(m_ioContext, tcp::endpoint{tcp::v4(), NDT_PORT});
+    m_telemetryHub->start();
 
     this->m_serverThread = thread(&ControllerAndOtherEventHandler::runServer, this);
 }
@@ -98,6 +116,7 @@ ControllerAndOtherEventHandler::stop()
     // 1. Call io_context::stop()
     m_ioContext.stop();
     SPDLOG_LOGGER_INFO(Logger::instance(), "io_context stopped");
+    m_telemetryHub->stop();
 
     // 2. Close the acceptor
     if (m_serverAcceptor)
@@ -184,17 +203,23 @@ ControllerAndOtherEventHandler::stop()
 void
 ControllerAndOtherEventHandler::runServer()
 {
+    utils::setThreadName("http-server");
     const short port = NDT_PORT;
     SPDLOG_LOGGER_INFO(Logger::instance(), "Server Listening on port {}", port);
 
     doAccept(); // start async accept loop
 
-    // Run io_context (this can be in multiple threads)
+    // Run io_context on m_ioThreads threads; sessions are serialized by their own strands
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Running server io_context on {} threads", m_ioThreads);
     std::vector<std::thread> threadPool;
-    int threadCount = std::thread::hardware_concurrency();
-    for (int i = 0; i < threadCount; ++i)
+    for (unsigned i = 0; i < m_ioThreads; ++i)
     {
-        threadPool.emplace_back([this]() { m_ioContext.run(); });
+        threadPool.emplace_back(
+            [this, i]()
+            {
+                utils::ThreadRegistry::Scope thread("http-io-" + std::to_string(i));
+                m_ioContext.run();
+            });
     }
 
     for (auto& t : threadPool)
@@ -206,6 +231,16 @@ ControllerAndOtherEventHandler::runServer()
     SPDLOG_LOGGER_INFO(Logger::instance(), "Exiting Loop of run event server");
 }
 
+unsigned
+ControllerAndOtherEventHandler::resolveIoThreads(unsigned requested)
+{
+    if (requested > 0)
+    {
+        return requested;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
 json
 ControllerAndOtherEventHandler::parseFlowStatsText(const std::string& responseText)
 {
@@ -223,10 +258,20 @@ ControllerAndOtherEventHandler::parseFlowStatsText(const std::string& responseTe
 void
 ControllerAndOtherEventHandler::doAccept()
 {
-    auto sock = std::make_shared<tcp::socket>(m_ioContext);
+    // Each connection gets its own strand: the session's reads, writes and the completions
+    // posted back from the blocking pool never overlap, even with several I/O threads.
+    auto sock = std::make_shared<tcp::socket>(net::make_strand(m_ioContext));
 
     m_serverAcceptor->async_accept(*sock, [this, sock](boost::system::error_code ec) {
-        if (!ec && m_serverRunning.load())
+        AdmissionControl::ConnectionSlot slot;
+        if (!ec && m_serverRunning.load() && !AdmissionControl::instance().openConnection(slot))
+        {
+            // Past the control-plane reserve too: not worth reading the request
+            SPDLOG_LOGGER_WARN(Logger::instance(), "Too many connections, closing new one");
+            boost::system::error_code ignored;
+            sock->close(ignored);
+        }
+        else if (!ec && m_serverRunning.load())
         {
             SPDLOG_LOGGER_INFO(Logger::instance(), "Accepted new connection");
 
@@ -242,7 +287,10 @@ ControllerAndOtherEventHandler::doAccept()
                                           m_intentTranslator,
                                           m_historicalDataManager,
                                           m_controller,
-                                          m_lockManager)
+                                          m_lockManager,
+                                          m_telemetryHub,
+                                          m_snapshotExporter,
+                                          std::move(slot))
                 ->start();
         }
 
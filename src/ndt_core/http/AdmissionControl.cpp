@@ -0,0 +1,161 @@
+#include "ndt_core/http/AdmissionControl.hpp"
+#include <algorithm>
+#include <utility>
+
+AdmissionControl::ConnectionSlot::ConnectionSlot(bool overCapacity)
+    : m_held(true),
+      m_overCapacity(overCapacity)
+{
+}
+
+AdmissionControl::ConnectionSlot::ConnectionSlot(ConnectionSlot&& other) noexcept
+    : m_held(std::exchange(other.m_held, false)),
+      m_overCapacity(other.m_overCapacity)
+{
+}
+
+AdmissionControl::ConnectionSlot&
+AdmissionControl::ConnectionSlot::operator=(ConnectionSlot&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_held)
+        {
+            AdmissionControl::instance().m_connections.fetch_sub(1, std::memory_order_relaxed);
+        }
+        m_held = std::exchange(other.m_held, false);
+        m_overCapacity = other.m_overCapacity;
+    }
+    return *this;
+}
+
+AdmissionControl::ConnectionSlot::~ConnectionSlot()
+{
+    if (m_held)
+    {
+        AdmissionControl::instance().m_connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+AdmissionControl::ConnectionSlot
+AdmissionControl::ConnectionSlot::borrow() const
+{
+    ConnectionSlot slot;
+    slot.m_overCapacity = m_overCapacity;
+    return slot;
+}
+
+AdmissionControl&
+AdmissionControl::instance()
+{
+    static AdmissionControl control;
+    return control;
+}
+
+bool
+AdmissionControl::openConnection(ConnectionSlot& slot)
+{
+    const uint64_t open = m_connections.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (open > NDT_MAX_CONNECTIONS + NDT_CONNECTION_RESERVE)
+    {
+        m_connections.fetch_sub(1, std::memory_order_relaxed);
+        m_rejectedConnections.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slot = ConnectionSlot(open > NDT_MAX_CONNECTIONS);
+    return true;
+}
+
+bool
+AdmissionControl::allowRequest(const boost::asio::ip::address& client)
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_bucketsMutex);
+    if (m_buckets.size() >= NDT_RATE_LIMIT_MAX_CLIENTS && !m_buckets.contains(client))
+    {
+        // A bucket that has refilled completely holds no state worth keeping
+        std::erase_if(m_buckets, [now](const auto& entry) {
+            const double idle =
+                std::chrono::duration<double>(now - entry.second.refilledAt).count();
+            return entry.second.tokens + idle * NDT_RATE_LIMIT_RPS >= NDT_RATE_LIMIT_BURST;
+        });
+    }
+
+    auto [it, inserted] = m_buckets.try_emplace(client);
+    Bucket& bucket = it->second;
+    if (!inserted)
+    {
+        const double elapsed = std::chrono::duration<double>(now - bucket.refilledAt).count();
+        bucket.tokens = std::min<double>(NDT_RATE_LIMIT_BURST,
+                                         bucket.tokens + elapsed * NDT_RATE_LIMIT_RPS);
+    }
+    bucket.refilledAt = now;
+    if (bucket.tokens < 1.0)
+    {
+        m_rateLimited.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    bucket.tokens -= 1.0;
+    return true;
+}
+
+bool
+AdmissionControl::enterHeavy(std::string_view path)
+{
+    std::lock_guard<std::mutex> lock(m_endpointsMutex);
+    auto it = m_endpoints.find(std::string(path));
+    if (it == m_endpoints.end())
+    {
+        it = m_endpoints.emplace(std::string(path), Endpoint{}).first;
+    }
+    if (it->second.inFlight >= NDT_HEAVY_MAX_IN_FLIGHT)
+    {
+        ++it->second.busy;
+        return false;
+    }
+    ++it->second.inFlight;
+    return true;
+}
+
+void
+AdmissionControl::leaveHeavy(std::string_view path)
+{
+    std::lock_guard<std::mutex> lock(m_endpointsMutex);
+    auto it = m_endpoints.find(std::string(path));
+    if (it != m_endpoints.end() && it->second.inFlight > 0)
+    {
+        --it->second.inFlight;
+    }
+}
+
+void
+AdmissionControl::recordOverCapacity()
+{
+    m_overCapacity.fetch_add(1, std::memory_order_relaxed);
+}
+
+nlohmann::json
+AdmissionControl::statsJson() const
+{
+    nlohmann::json busy = nlohmann::json::object();
+    {
+        std::lock_guard<std::mutex> lock(m_endpointsMutex);
+        for (const auto& [path, endpoint] : m_endpoints)
+        {
+            busy[path] = endpoint.busy;
+        }
+    }
+    size_t clients = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_bucketsMutex);
+        clients = m_buckets.size();
+    }
+    return nlohmann::json{
+        {"connections", m_connections.load(std::memory_order_relaxed)},
+        {"max_connections", NDT_MAX_CONNECTIONS},
+        {"rejected_connections", m_rejectedConnections.load(std::memory_order_relaxed)},
+        {"over_capacity", m_overCapacity.load(std::memory_order_relaxed)},
+        {"rate_limited", m_rateLimited.load(std::memory_order_relaxed)},
+        {"clients", clients},
+        {"endpoint_busy", std::move(busy)}};
+}
@@ -0,0 +1,533 @@
+#include "ndt_core/http/Http2Session.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <array>
+#include <boost/asio/write.hpp>
+#include <cctype>
+#include <cstring>
+
+#ifdef NDT_HAVE_NGHTTP2
+#include <nghttp2/nghttp2.h>
+#endif
+
+struct Http2Session::Stream
+{
+    int32_t id = 0;
+    http::request<http::string_body> request;
+    uint64_t bodyLimit = NDT_HTTP_BODY_LIMIT;
+    bool tooLarge = false; // body past bodyLimit: discarded, answered 413
+    std::shared_ptr<http::response<http::string_body>> response;
+    size_t sent = 0; // body bytes of response handed to nghttp2
+};
+
+Http2Session::Http2Session(tcp::socket socket,
+                           AdmissionControl::ConnectionSlot slot,
+                           StreamFactory streams)
+    : m_socket(std::move(socket)),
+      m_slot(std::move(slot)),
+      m_streams(std::move(streams)),
+      m_in(HTTP2_READ_CHUNK)
+{
+}
+
+#ifndef NDT_HAVE_NGHTTP2
+
+bool
+Http2Session::supported()
+{
+    return false;
+}
+
+Http2Session::~Http2Session() = default;
+
+void
+Http2Session::start(std::string_view)
+{
+}
+
+void
+Http2Session::startUpgraded(std::string_view, std::string_view, http::request<http::string_body>)
+{
+}
+
+#else
+
+namespace
+{
+
+// RFC 7540 3.2.1: the HTTP2-Settings header is the SETTINGS payload in base64url, unpadded
+std::string
+decodeBase64Url(std::string_view text)
+{
+    std::string out;
+    uint32_t bits = 0;
+    int count = 0;
+    for (char c : text)
+    {
+        int value = -1;
+        if (c >= 'A' && c <= 'Z')
+        {
+            value = c - 'A';
+        }
+        else if (c >= 'a' && c <= 'z')
+        {
+            value = c - 'a' + 26;
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            value = c - '0' + 52;
+        }
+        else if (c == '-' || c == '+')
+        {
+            value = 62;
+        }
+        else if (c == '_' || c == '/')
+        {
+            value = 63;
+        }
+        else if (c == '=')
+        {
+            break;
+        }
+        else
+        {
+            return {};
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            out.push_back(static_cast<char>((bits >> count) & 0xFF));
+        }
+    }
+    return out;
+}
+
+// Header fields HTTP/2 forbids (RFC 7540 8.1.2.2); Beast's responses may carry them
+bool
+connectionSpecific(std::string_view name)
+{
+    return beast::iequals(name, "connection") || beast::iequals(name, "keep-alive") ||
+           beast::iequals(name, "proxy-connection") || beast::iequals(name, "transfer-encoding") ||
+           beast::iequals(name, "upgrade");
+}
+
+nghttp2_nv
+headerField(std::string_view name, std::string_view value)
+{
+    return {reinterpret_cast<uint8_t*>(const_cast<char*>(name.data())),
+            reinterpret_cast<uint8_t*>(const_cast<char*>(value.data())),
+            name.size(),
+            value.size(),
+            NGHTTP2_NV_FLAG_NONE};
+}
+
+} // namespace
+
+struct Http2Session::Callbacks
+{
+    static Http2Session& self(void* userData)
+    {
+        return *static_cast<Http2Session*>(userData);
+    }
+
+    static int onBeginHeaders(nghttp2_session*, const nghttp2_frame* frame, void* userData)
+    {
+        if (frame->hd.type != NGHTTP2_HEADERS || frame->headers.cat != NGHTTP2_HCAT_REQUEST)
+        {
+            return 0;
+        }
+        auto stream = std::make_unique<Stream>();
+        stream->id = frame->hd.stream_id;
+        stream->request.version(11);
+        self(userData).m_open[stream->id] = std::move(stream);
+        return 0;
+    }
+
+    static int onHeader(nghttp2_session*,
+                        const nghttp2_frame* frame,
+                        const uint8_t* name,
+                        size_t nameLength,
+                        const uint8_t* value,
+                        size_t valueLength,
+                        uint8_t,
+                        void* userData)
+    {
+        Stream* stream = self(userData).findStream(frame->hd.stream_id);
+        if (!stream || frame->hd.type != NGHTTP2_HEADERS)
+        {
+            return 0;
+        }
+        const std::string_view field(reinterpret_cast<const char*>(name), nameLength);
+        const std::string_view text(reinterpret_cast<const char*>(value), valueLength);
+        if (field == ":method")
+        {
+            stream->request.method_string(text);
+        }
+        else if (field == ":path")
+        {
+            stream->request.target(text);
+            stream->bodyLimit = HttpSession::bodyLimit(text);
+        }
+        else if (field == ":authority")
+        {
+            stream->request.set(http::field::host, text);
+        }
+        else if (field.empty() || field.front() != ':')
+        {
+            stream->request.insert(field, text);
+        }
+        return 0;
+    }
+
+    static int onDataChunk(nghttp2_session*,
+                           uint8_t,
+                           int32_t streamId,
+                           const uint8_t* data,
+                           size_t length,
+                           void* userData)
+    {
+        Stream* stream = self(userData).findStream(streamId);
+        if (!stream || stream->tooLarge)
+        {
+            return 0;
+        }
+        std::string& body = stream->request.body();
+        if (body.size() + length > stream->bodyLimit)
+        {
+            stream->tooLarge = true;
+            body.clear();
+            body.shrink_to_fit();
+            return 0;
+        }
+        body.append(reinterpret_cast<const char*>(data), length);
+        return 0;
+    }
+
+    static int onFrame(nghttp2_session*, const nghttp2_frame* frame, void* userData)
+    {
+        if ((frame->hd.type == NGHTTP2_HEADERS || frame->hd.type == NGHTTP2_DATA) &&
+            (frame->hd.flags & NGHTTP2_FLAG_END_STREAM))
+        {
+            self(userData).dispatch(frame->hd.stream_id);
+        }
+        return 0;
+    }
+
+    static int onStreamClose(nghttp2_session*, int32_t streamId, uint32_t, void* userData)
+    {
+        // A handler still running for it finds the stream gone and drops its response
+        self(userData).m_open.erase(streamId);
+        return 0;
+    }
+
+    static ssize_t readBody(nghttp2_session*,
+                            int32_t,
+                            uint8_t* buffer,
+                            size_t length,
+                            uint32_t* dataFlags,
+                            nghttp2_data_source* source,
+                            void*)
+    {
+        auto* stream = static_cast<Stream*>(source->ptr);
+        const std::string& body = stream->response->body();
+        const size_t n = std::min(length, body.size() - stream->sent);
+        std::memcpy(buffer, body.data() + stream->sent, n);
+        stream->sent += n;
+        if (stream->sent == body.size())
+        {
+            *dataFlags |= NGHTTP2_DATA_FLAG_EOF;
+        }
+        return static_cast<ssize_t>(n);
+    }
+};
+
+bool
+Http2Session::supported()
+{
+    return true;
+}
+
+Http2Session::~Http2Session()
+{
+    if (m_session)
+    {
+        nghttp2_session_del(m_session);
+    }
+}
+
+bool
+Http2Session::open()
+{
+    nghttp2_session_callbacks* callbacks = nullptr;
+    if (nghttp2_session_callbacks_new(&callbacks) != 0)
+    {
+        return false;
+    }
+    nghttp2_session_callbacks_set_on_begin_headers_callback(callbacks, &Callbacks::onBeginHeaders);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, &Callbacks::onHeader);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, &Callbacks::onDataChunk);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, &Callbacks::onFrame);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, &Callbacks::onStreamClose);
+    const int rv = nghttp2_session_server_new(&m_session, callbacks, this);
+    nghttp2_session_callbacks_del(callbacks);
+    if (rv != 0)
+    {
+        m_session = nullptr;
+        return false;
+    }
+    const nghttp2_settings_entry settings[] = {
+        {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, HTTP2_MAX_CONCURRENT_STREAMS},
+    };
+    return nghttp2_submit_settings(m_session, NGHTTP2_FLAG_NONE, settings, std::size(settings)) ==
+           0;
+}
+
+void
+Http2Session::start(std::string_view received)
+{
+    if (!open())
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Cannot start an HTTP/2 session");
+        return close();
+    }
+    NDT_LOG_DEBUG(HTTP, "HTTP/2 connection (prior knowledge)");
+    if (receive(received))
+    {
+        flush();
+        readMore();
+    }
+}
+
+void
+Http2Session::startUpgraded(std::string_view received,
+                            std::string_view settings,
+                            http::request<http::string_body> request)
+{
+    const std::string payload = decodeBase64Url(settings);
+    const bool head = request.method() == http::verb::head;
+    if (!open() || nghttp2_session_upgrade2(m_session,
+                                            reinterpret_cast<const uint8_t*>(payload.data()),
+                                            payload.size(),
+                                            head,
+                                            nullptr) != 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Refused an HTTP/2 upgrade with bad settings");
+        return close();
+    }
+    NDT_LOG_DEBUG(HTTP, "HTTP/2 connection (upgraded)");
+    auto stream = std::make_unique<Stream>();
+    stream->id = 1;
+    stream->bodyLimit = HttpSession::bodyLimit(request.target());
+    stream->request = std::move(request);
+    m_open[1] = std::move(stream);
+    dispatch(1);
+    if (receive(received))
+    {
+        flush();
+        readMore();
+    }
+}
+
+bool
+Http2Session::receive(std::string_view data)
+{
+    if (data.empty())
+    {
+        return true;
+    }
+    m_receiving = true;
+    const ssize_t rv = nghttp2_session_mem_recv(
+        m_session, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    m_receiving = false;
+    if (rv < 0)
+    {
+        NDT_LOG_DEBUG(HTTP, "HTTP/2 protocol error: {}", nghttp2_strerror(static_cast<int>(rv)));
+        // nghttp2 has queued a GOAWAY for most errors; flush() sends it and then closes
+        flush();
+        close();
+        return false;
+    }
+    return true;
+}
+
+void
+Http2Session::readMore()
+{
+    if (m_closed)
+    {
+        return;
+    }
+    m_socket.async_read_some(
+        net::buffer(m_in), [self = shared_from_this()](beast::error_code ec, std::size_t n) {
+            if (ec)
+            {
+                if (ec != net::error::eof && ec != net::error::operation_aborted)
+                {
+                    NDT_LOG_DEBUG(HTTP, "HTTP/2 read error: {}", ec.message());
+                }
+                return self->close();
+            }
+            if (self->receive({self->m_in.data(), n}))
+            {
+                self->flush();
+                self->readMore();
+            }
+        });
+}
+
+void
+Http2Session::flush()
+{
+    if (m_writing || m_receiving || !m_session)
+    {
+        return;
+    }
+    while (m_out.size() < HTTP2_WRITE_BATCH)
+    {
+        const uint8_t* data = nullptr;
+        const ssize_t n = nghttp2_session_mem_send(m_session, &data);
+        if (n <= 0)
+        {
+            break;
+        }
+        m_out.append(reinterpret_cast<const char*>(data), static_cast<size_t>(n));
+    }
+    if (m_out.empty())
+    {
+        if (!nghttp2_session_want_read(m_session) && !nghttp2_session_want_write(m_session))
+        {
+            close();
+        }
+        return;
+    }
+    m_writing = true;
+    net::async_write(m_socket,
+                     net::buffer(m_out),
+                     [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                         self->m_writing = false;
+                         self->m_out.clear();
+                         if (ec)
+                         {
+                             NDT_LOG_DEBUG(HTTP, "HTTP/2 write error: {}", ec.message());
+                             return self->close();
+                         }
+                         self->flush();
+                     });
+}
+
+void
+Http2Session::close()
+{
+    if (m_closed)
+    {
+        return;
+    }
+    m_closed = true;
+    beast::error_code ignored;
+    m_socket.shutdown(tcp::socket::shutdown_both, ignored);
+    m_socket.close(ignored);
+}
+
+Http2Session::Stream*
+Http2Session::findStream(int32_t streamId)
+{
+    auto it = m_open.find(streamId);
+    return it == m_open.end() ? nullptr : it->second.get();
+}
+
+void
+Http2Session::dispatch(int32_t streamId)
+{
+    Stream* stream = findStream(streamId);
+    if (!stream)
+    {
+        return;
+    }
+    if (stream->tooLarge)
+    {
+        auto response = std::make_shared<http::response<http::string_body>>(
+            http::status::payload_too_large, 11);
+        response->set(http::field::server, "ndt-server");
+        response->set(http::field::access_control_allow_origin, "*");
+        response->set(http::field::content_type, "application/json");
+        response->body() =
+            json{{"error", "Request body too large"}, {"limit", stream->bodyLimit}}.dump();
+        return respond(streamId, nullptr, std::move(response));
+    }
+
+    std::shared_ptr<HttpSession> session;
+    if (m_idle.empty())
+    {
+        session = m_streams();
+    }
+    else
+    {
+        session = std::move(m_idle.back());
+        m_idle.pop_back();
+    }
+    // Called on this connection's strand, maybe before serveStream() returns
+    session->serveStream(std::move(stream->request),
+                         [weak = weak_from_this(), streamId, session](
+                             std::shared_ptr<http::response<http::string_body>> response) {
+                             if (auto self = weak.lock())
+                             {
+                                 self->respond(streamId, session, std::move(response));
+                             }
+                         });
+}
+
+void
+Http2Session::respond(int32_t streamId,
+                      std::shared_ptr<HttpSession> session,
+                      std::shared_ptr<http::response<http::string_body>> response)
+{
+    if (session && m_idle.size() < HTTP2_IDLE_SESSIONS)
+    {
+        m_idle.push_back(std::move(session));
+    }
+    Stream* stream = findStream(streamId);
+    if (!stream || m_closed)
+    {
+        return; // reset by the client meanwhile
+    }
+
+    const std::string status = std::to_string(response->result_int());
+    std::vector<std::string> names; // lower case, as HTTP/2 requires
+    std::vector<nghttp2_nv> fields{headerField(":status", status)};
+    names.reserve(std::distance(response->begin(), response->end()));
+    for (const auto& field : *response)
+    {
+        if (connectionSpecific(field.name_string()))
+        {
+            continue;
+        }
+        std::string& name = names.emplace_back(field.name_string());
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        fields.push_back(headerField(name, field.value()));
+    }
+
+    stream->response = std::move(response);
+    stream->sent = 0;
+    nghttp2_data_provider body{};
+    body.source.ptr = stream;
+    body.read_callback = &Callbacks::readBody;
+    const bool hasBody = !stream->response->body().empty();
+    // nghttp2 copies the header fields before returning
+    const int rv = nghttp2_submit_response(
+        m_session, streamId, fields.data(), fields.size(), hasBody ? &body : nullptr);
+    if (rv != 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Cannot answer HTTP/2 stream {}: {}",
+                           streamId,
+                           nghttp2_strerror(rv));
+        nghttp2_submit_rst_stream(m_session, NGHTTP2_FLAG_NONE, streamId, NGHTTP2_INTERNAL_ERROR);
+    }
+    flush();
+}
+
+#endif
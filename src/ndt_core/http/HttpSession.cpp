@@ -1,29 +1,276 @@
 #include "ndt_core/http/HttpSession.hpp"
+#include "common_types/PathPool.hpp"
 #include "event_system/EventBus.hpp"
 #include "event_system/EventPayloads.hpp"
 #include "event_system/PayloadTypes.hpp"
 #include "event_system/RequestParser.hpp"
 #include "ndt_core/application_management/ApplicationManager.hpp"
 #include "ndt_core/application_management/SimulationRequestManager.hpp"
+#include "ndt_core/application_management/SnapshotExporter.hpp"
 #include "ndt_core/collection/FlowLinkUsageCollector.hpp"
 #include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "ndt_core/collection/WhatIfEvaluator.hpp"
 #include "ndt_core/data_management/HistoricalDataManager.hpp"
+#include "ndt_core/http/Http2Session.hpp"
+#include "ndt_core/http/TelemetryStream.hpp"
 #include "ndt_core/intent_translator/IntentTranslator.hpp"
 #include "ndt_core/lock_management/LockManager.hpp"
 #include "ndt_core/power_management/DeviceConfigurationAndPowerManager.hpp"
 #include "ndt_core/routing_management/Controller.hpp"
+#include "ndt_core/routing_management/FastReroute.hpp"
 #include "ndt_core/routing_management/FlowJob.hpp"
 #include "ndt_core/routing_management/FlowRoutingManager.hpp"
+#include "utils/BlockingPool.hpp"
+#include "utils/FlightRecorder.hpp"
+#include "utils/HistoryWriter.hpp"
+#include "utils/HttpEncoding.hpp"
+#include "utils/HttpClient.hpp"
+#include "utils/HttpsClient.hpp"
+#include "utils/JsonWriter.hpp"
 #include "utils/Logger.hpp"
+#include "utils/MemoryAccounting.hpp"
+#include "utils/MemoryPolicy.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Profiler.hpp"
+#include "utils/RuntimeConfig.hpp"
+#include "utils/SnmpClient.hpp"
+#include "utils/SshSessionPool.hpp"
+#include "utils/Startup.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include "utils/TaskScheduler.hpp"
+#include "utils/Tracing.hpp"
+#include <algorithm>
+#include <array>
+#include <boost/asio/steady_timer.hpp>
+#include <charconv>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <unordered_set>
 
 using json = nlohmann::json;
 
+QueryParams::QueryParams(std::string_view query)
+    : m_raw(query)
+{
+    while (!query.empty())
+    {
+        auto ampPos = query.find('&');
+        std::string_view pair = query.substr(0, ampPos);
+        auto eqPos = pair.find('=');
+        m_params.emplace_back(pair.substr(0, eqPos),
+                              eqPos == std::string_view::npos ? std::string_view{}
+                                                              : pair.substr(eqPos + 1));
+        if (ampPos == std::string_view::npos)
+        {
+            break;
+        }
+        query.remove_prefix(ampPos + 1);
+    }
+}
+
+std::string
+QueryParams::get(std::string_view key) const
+{
+    for (const auto& [name, value] : m_params)
+    {
+        if (name == key)
+        {
+            return std::string(value);
+        }
+    }
+    return "";
+}
+
+namespace
+{
+
+/**
+ * @brief Tag @p res with entity tag @p version and check it against If-None-Match.
+ *
+ * Returns true, with @p res turned into an empty 304 Not Modified, when the client already
+ * holds this version; the caller then skips building the body.
+ */
+bool
+matchETag(const http::request<http::string_body>& req, http::response<http::string_body>& res,
+          std::string_view version)
+{
+    std::string etag = "\"" + std::string(version) + "\"";
+    res.set(http::field::etag, etag);
+    std::string_view ifNoneMatch = req[http::field::if_none_match];
+    if (ifNoneMatch.empty() ||
+        (ifNoneMatch != "*" && ifNoneMatch.find(etag) == std::string_view::npos))
+    {
+        return false;
+    }
+    res.result(http::status::not_modified);
+    res.body().clear();
+    return true;
+}
+
+/// Encoded bodies of the read-only GET endpoints, shared by every session
+struct ResponseCaches
+{
+    utils::EncodedBodyCache graphData;
+    utils::EncodedBodyCache detectedFlows;
+    utils::EncodedBodyCache openflowTables;
+    utils::EncodedBodyCache powerReport;
+    utils::EncodedBodyCache cpuUtilization;
+    utils::EncodedBodyCache memoryUtilization;
+    utils::EncodedBodyCache temperature;
+    utils::EncodedBodyCache staticTopology;
+    utils::EncodedBodyCache openflowCapacity;
+    utils::EncodedBodyCache trafficMatrix;
+};
+
+ResponseCaches&
+responseCaches()
+{
+    static ResponseCaches caches;
+    return caches;
+}
+
+/**
+ * @brief Read from=, to= (ms since the epoch) and resolution=1s|1m of a history endpoint.
+ *
+ * Missing bounds leave the range open. Returns the name of a malformed parameter, else "".
+ */
+std::string
+parseHistoryRange(const QueryParams& query,
+                  int64_t& fromMs,
+                  int64_t& toMs,
+                  RecentHistory::Resolution& resolution)
+{
+    fromMs = std::numeric_limits<int64_t>::min();
+    toMs = std::numeric_limits<int64_t>::max();
+    for (auto [name, out] : {std::pair{"from", &fromMs}, std::pair{"to", &toMs}})
+    {
+        std::string text = query.get(name);
+        if (text.empty())
+        {
+            continue;
+        }
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), *out);
+        if (ec != std::errc() || ptr != text.data() + text.size())
+        {
+            return name;
+        }
+    }
+
+    std::string text = query.get("resolution");
+    if (text.empty() || text == "1s")
+    {
+        resolution = RecentHistory::Resolution::Second;
+    }
+    else if (text == "1m")
+    {
+        resolution = RecentHistory::Resolution::Minute;
+    }
+    else
+    {
+        return "resolution";
+    }
+    return "";
+}
+
+json
+historyJson(const std::vector<utils::SeriesPoint>& points)
+{
+    json out = json::array();
+    for (const utils::SeriesPoint& point : points)
+    {
+        out.push_back(
+            {{"timestamp_ms", point.timestampMs}, {"value", point.value}, {"peak", point.peak}});
+    }
+    return json{{"points", std::move(out)}};
+}
+
+struct LockRequest
+{
+    std::vector<std::string> resources;
+    std::string type; // set when locking one global lock by type
+    int ttl = LockManager::DEFAULT_TTL_SECONDS;
+    int waitMs = 0;
+};
+
+/**
+ * @brief Read an acquire_lock body into @p out; an unparsable body keeps the defaults.
+ * @return The malformed field, or "" if there is none.
+ */
+std::string
+parseLockRequest(const std::string& body, LockRequest& out)
+{
+    json request = json::parse(body, nullptr, false);
+    if (!request.is_object())
+    {
+        out.type = LockManager::DEFAULT_LOCK_TYPE_STR;
+        out.resources = {out.type};
+        return "";
+    }
+    out.ttl = request.value("ttl", LockManager::DEFAULT_TTL_SECONDS);
+    out.waitMs = std::min(request.value("wait_ms", 0), LOCK_MAX_WAIT_MS);
+    if (!request.contains("resources"))
+    {
+        out.type = request.value("type", LockManager::DEFAULT_LOCK_TYPE_STR);
+        out.resources = {out.type};
+        return "";
+    }
+    const json& resources = request["resources"];
+    if (!resources.is_array() || resources.empty() || resources.size() > LOCK_MAX_RESOURCES)
+    {
+        return "resources";
+    }
+    for (const json& name : resources)
+    {
+        auto resource = name.is_string()
+                            ? LockManager::normalizeResource(name.get<std::string>())
+                            : std::nullopt;
+        if (!resource)
+        {
+            return "resources";
+        }
+        out.resources.push_back(std::move(*resource));
+    }
+    return "";
+}
+
+void
+writeLockResult(http::response<http::string_body>& res,
+                const LockRequest& request,
+                std::optional<LockManager::Token> token)
+{
+    if (!token)
+    {
+        // Locked by another app or invalid type
+        res.result(http::status::locked);
+        res.body() = json{{"error", "Lock acquisition failed"},
+                          {"detail",
+                           request.type.empty()
+                               ? "Resources busy"
+                               : "System busy or invalid lock type: " + request.type}}
+                         .dump();
+        return;
+    }
+    json body{{"status", "locked"},
+              {"token", *token},
+              {"resources", request.resources},
+              {"ttl", std::clamp(request.ttl, 1, LOCK_MAX_TTL_SECONDS)}};
+    if (!request.type.empty())
+    {
+        body["type"] = request.type;
+    }
+    res.result(http::status::ok);
+    res.body() = body.dump();
+}
+
+} // namespace
+
 HttpSession::HttpSession(
     tcp::socket socket,
     std::shared_ptr<TopologyAndFlowMonitor> topologyAndFlowMonitor,
@@ -37,7 +284,10 @@ HttpSession::HttpSession(
     std::shared_ptr<IntentTranslator> intentTranslator,
     std::shared_ptr<HistoricalDataManager> historicalDataManager,
     std::shared_ptr<Controller> ctrl,
-    std::shared_ptr<LockManager> lockManager)
+    std::shared_ptr<LockManager> lockManager,
+    std::shared_ptr<TelemetryHub> telemetryHub,
+    std::shared_ptr<SnapshotExporter> snapshotExporter,
+    AdmissionControl::ConnectionSlot slot)
     : m_socket(std::move(socket)),
       m_topologyAndFlowMonitor(std::move(topologyAndFlowMonitor)),
       m_eventBus(std::move(eventBus)),
@@ -50,23 +300,231 @@ HttpSession::HttpSession(
       m_intentTranslator(std::move(intentTranslator)),
       m_historicalDataManager(std::move(historicalDataManager)),
       m_controller(std::move(ctrl)),
-      m_lockManager(std::move(lockManager))
+      m_lockManager(std::move(lockManager)),
+      m_telemetryHub(std::move(telemetryHub)),
+      m_snapshotExporter(std::move(snapshotExporter)),
+      m_slot(std::move(slot))
 {
+    beast::error_code ec;
+    m_clientAddress = m_socket.remote_endpoint(ec).address();
 }
 
 void
 HttpSession::start()
 {
+    if (Http2Session::supported())
+    {
+        return detectHttp2();
+    }
     readRequest();
 }
 
+void
+HttpSession::detectHttp2()
+{
+    m_socket.async_read_some(
+        m_buffer.prepare(HTTP2_READ_CHUNK),
+        [self = shared_from_this()](beast::error_code ec, std::size_t n) {
+            if (ec == net::error::eof)
+            {
+                return self->closeSocket();
+            }
+            if (ec)
+            {
+                SPDLOG_LOGGER_ERROR(Logger::instance(), "Read error: {}", ec.message());
+                return;
+            }
+            self->m_buffer.commit(n);
+            const std::string_view seen(static_cast<const char*>(self->m_buffer.data().data()),
+                                        self->m_buffer.size());
+            const std::string_view preface = Http2Session::PREFACE;
+            if (!preface.starts_with(seen.substr(0, preface.size())))
+            {
+                return self->readRequest(); // HTTP/1.x, parsed from what is in m_buffer
+            }
+            if (seen.size() < preface.size())
+            {
+                return self->detectHttp2();
+            }
+            self->startHttp2();
+        });
+}
+
+void
+HttpSession::startHttp2()
+{
+    const auto buffered = m_buffer.data();
+    std::make_shared<Http2Session>(std::move(m_socket),
+                                   std::move(m_slot),
+                                   [self = shared_from_this()] { return self->streamSession(); })
+        ->start({static_cast<const char*>(buffered.data()), buffered.size()});
+    m_buffer.consume(m_buffer.size());
+}
+
+bool
+HttpSession::upgradeToHttp2()
+{
+    const std::string_view settings = m_req["HTTP2-Settings"];
+    if (!Http2Session::supported() || !beast::iequals(m_req[http::field::upgrade], "h2c") ||
+        settings.empty() || m_req.version() != 11)
+    {
+        return false;
+    }
+    m_continue = http::response<http::empty_body>(http::status::switching_protocols, 11);
+    m_continue.set(http::field::connection, "Upgrade");
+    m_continue.set(http::field::upgrade, "h2c");
+    http::async_write(
+        m_socket,
+        m_continue,
+        [self = shared_from_this(), settings = std::string(settings)](beast::error_code ec,
+                                                                      std::size_t) {
+            if (ec)
+            {
+                SPDLOG_LOGGER_ERROR(Logger::instance(), "Write error: {}", ec.message());
+                return;
+            }
+            const auto buffered = self->m_buffer.data();
+            std::make_shared<Http2Session>(std::move(self->m_socket),
+                                           std::move(self->m_slot),
+                                           [self] { return self->streamSession(); })
+                ->startUpgraded({static_cast<const char*>(buffered.data()), buffered.size()},
+                                settings,
+                                std::move(self->m_req));
+            self->m_buffer.consume(self->m_buffer.size());
+        });
+    return true;
+}
+
+std::shared_ptr<HttpSession>
+HttpSession::streamSession()
+{
+    auto session = std::make_shared<HttpSession>(tcp::socket(m_socket.get_executor()),
+                                                 m_topologyAndFlowMonitor,
+                                                 m_eventBus,
+                                                 static_cast<int>(m_mode),
+                                                 m_flowLinkUsageCollector,
+                                                 m_flowRoutingManager,
+                                                 m_deviceConfigurationAndPowerManager,
+                                                 m_applicationManager,
+                                                 m_simulationRequestManager,
+                                                 m_intentTranslator,
+                                                 m_historicalDataManager,
+                                                 m_controller,
+                                                 m_lockManager,
+                                                 m_telemetryHub,
+                                                 m_snapshotExporter,
+                                                 m_slot.borrow());
+    session->m_clientAddress = m_clientAddress;
+    return session;
+}
+
+void
+HttpSession::serveStream(http::request<http::string_body> request, StreamDone done)
+{
+    m_req = std::move(request);
+    m_streamDone = std::move(done);
+    handleRequest();
+}
+
+std::uint64_t
+HttpSession::bodyLimit(std::string_view target)
+{
+    const auto& table = routes();
+    auto it = table.find(target.substr(0, target.find('?')));
+    return it != table.end() && it->second.largeBody ? NDT_HTTP_LARGE_BODY_LIMIT
+                                                      : NDT_HTTP_BODY_LIMIT;
+}
+
+utils::MemoryUsage
+HttpSession::memoryUsage()
+{
+    ResponseCaches& caches = responseCaches();
+    utils::MemoryUsage usage;
+    for (const auto& [name, cache] : {std::pair{"graph_data", &caches.graphData},
+                                      std::pair{"detected_flows", &caches.detectedFlows},
+                                      std::pair{"openflow_tables", &caches.openflowTables},
+                                      std::pair{"power_report", &caches.powerReport},
+                                      std::pair{"cpu_utilization", &caches.cpuUtilization},
+                                      std::pair{"memory_utilization", &caches.memoryUtilization},
+                                      std::pair{"temperature", &caches.temperature},
+                                      std::pair{"static_topology", &caches.staticTopology},
+                                      std::pair{"openflow_capacity", &caches.openflowCapacity},
+                                      std::pair{"traffic_matrix", &caches.trafficMatrix}})
+    {
+        usage.add(name, cache->statsJson()["cached_bytes"].get<size_t>());
+    }
+    return usage;
+}
+
 void
 HttpSession::readRequest()
 {
-    m_req = {}; // Clear request for reuse
+    m_query = {}; // Views into m_req
+    m_req = {};   // Clear request for reuse
+    m_parser.emplace();
+    // A Content-Length is checked against the limit as soon as the header is parsed, so start
+    // from the largest one and narrow it to the route's in onReadHeader()
+    m_parser->body_limit(NDT_HTTP_LARGE_BODY_LIMIT);
+    http::async_read_header(
+        m_socket,
+        m_buffer,
+        *m_parser,
+        beast::bind_front_handler(&HttpSession::onReadHeader, shared_from_this()));
+}
+
+void
+HttpSession::onReadHeader(beast::error_code ec, std::size_t bytes_transferred)
+{
+    boost::ignore_unused(bytes_transferred);
+
+    if (ec == http::error::end_of_stream)
+    {
+        return closeSocket();
+    }
+    if (ec == http::error::body_limit)
+    {
+        return rejectBody(NDT_HTTP_LARGE_BODY_LIMIT);
+    }
+    if (ec)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Read error: {}", ec.message());
+        return;
+    }
+
+    const auto& header = m_parser->get();
+    m_bodyLimit = bodyLimit(header.target());
+    if (auto length = m_parser->content_length(); length && *length > m_bodyLimit)
+    {
+        return rejectBody(m_bodyLimit);
+    }
+    m_parser->body_limit(m_bodyLimit); // still applies to a chunked body
+
+    if (!m_parser->is_done() && beast::iequals(header[http::field::expect], "100-continue"))
+    {
+        m_continue = http::response<http::empty_body>(http::status::continue_, header.version());
+        http::async_write(m_socket,
+                          m_continue,
+                          [self = shared_from_this()](beast::error_code ec, std::size_t) {
+                              if (ec)
+                              {
+                                  SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                                      "Write error: {}",
+                                                      ec.message());
+                                  return;
+                              }
+                              self->readBody();
+                          });
+        return;
+    }
+    readBody();
+}
+
+void
+HttpSession::readBody()
+{
     http::async_read(m_socket,
                      m_buffer,
-                     m_req,
+                     *m_parser,
                      beast::bind_front_handler(&HttpSession::onRead, shared_from_this()));
 }
 
@@ -79,22 +537,127 @@ HttpSession::onRead(beast::error_code ec, std::size_t bytes_transferred)
     {
         return closeSocket();
     }
+    if (ec == http::error::body_limit)
+    {
+        return rejectBody(m_bodyLimit);
+    }
     if (ec)
     {
         SPDLOG_LOGGER_ERROR(Logger::instance(), "Read error: {}", ec.message());
         return;
     }
 
+    m_req = m_parser->release();
+    m_parser.reset();
     handleRequest();
 }
 
+const std::unordered_map<std::string_view, HttpSession::Route>&
+HttpSession::routes()
+{
+    static const std::unordered_map<std::string_view, Route> table{
+        {"/ndt/link_failure_detected",
+         {nullptr, &HttpSession::handleLinkFailure, false, Admission::ControlPlane}},
+        {"/ndt/link_recovery_detected",
+         {nullptr, &HttpSession::handleLinkRecovery, false, Admission::ControlPlane}},
+        {"/ndt/topology_events",
+         {nullptr, &HttpSession::handleTopologyEvents, false, Admission::ControlPlane}},
+        {"/ndt/get_graph_data",
+         {&HttpSession::handleGetGraphData, nullptr, false, Admission::Heavy}},
+        {"/ndt/get_detected_flow_data",
+         {&HttpSession::handleGetDetectedFlowData, nullptr, false, Admission::Heavy}},
+        {"/ndt/query_flows", {&HttpSession::handleQueryFlows, nullptr, false, Admission::Heavy}},
+        {"/ndt/get_traffic_matrix", {&HttpSession::handleGetTrafficMatrix, nullptr}},
+        {"/ndt/get_collector_stats", {&HttpSession::handleGetCollectorStats, nullptr}},
+        {"/ndt/get_runtime_config", {&HttpSession::handleGetRuntimeConfig, nullptr}},
+        {"/ndt/readiness",
+         {&HttpSession::handleGetReadiness, nullptr, false, Admission::ControlPlane}},
+        {"/ndt/debug/threads", {&HttpSession::handleGetThreads, nullptr}},
+        {"/ndt/debug/traces", {&HttpSession::handleGetTraces, nullptr}},
+        {"/ndt/debug/profile", {&HttpSession::handleGetProfile, nullptr, true}},
+        {"/ndt/debug/flight_recorder", {&HttpSession::handleGetFlightRecorder, nullptr, true}},
+        {"/ndt/debug/memory", {&HttpSession::handleGetMemory, nullptr, true}},
+        {"/ndt/set_runtime_config", {nullptr, &HttpSession::handleSetRuntimeConfig}},
+        {"/metrics", {&HttpSession::handleGetMetrics, nullptr}},
+        {"/ndt/flow_batch_status", {&HttpSession::handleGetFlowBatchStatus, nullptr}},
+        {"/ndt/get_switch_openflow_table_entries",
+         {&HttpSession::handleGetSwitchOpenflowEntries, nullptr, false, Admission::Heavy}},
+        {"/ndt/get_power_report", {&HttpSession::handleGetPowerReport, nullptr}},
+        {"/ndt/get_switches_power_state", {&HttpSession::handleGetSwitchesPowerState, nullptr}},
+        {"/ndt/set_switches_power_state",
+         {nullptr, &HttpSession::handleSetSwitchesPowerState, true}},
+        {"/ndt/install_flow_entry", {nullptr, &HttpSession::handleInstallFlowEntry}},
+        {"/ndt/delete_flow_entry", {nullptr, &HttpSession::handleDeleteFlowEntry}},
+        {"/ndt/modify_flow_entry", {nullptr, &HttpSession::handleModifyFlowEntry}},
+        {"/ndt/install_group_entry", {nullptr, &HttpSession::handleInstallGroupEntry}},
+        {"/ndt/delete_group_entry", {nullptr, &HttpSession::handleDeleteGroupEntry}},
+        {"/ndt/modify_group_entry", {nullptr, &HttpSession::handleModifyGroupEntry}},
+        {"/ndt/install_meter_entry", {nullptr, &HttpSession::handleInstallMeterEntry}},
+        {"/ndt/delete_meter_entry", {nullptr, &HttpSession::handleDeleteMeterEntry}},
+        {"/ndt/modify_meter_entry", {nullptr, &HttpSession::handleModifyMeterEntry}},
+        {"/ndt/install_flow_entries_modify_flow_entries_and_delete_flow_entries",
+         {nullptr, &HttpSession::handleInstallModifyDeleteFlowEntries, false, Admission::Normal,
+          true}},
+        {"/ndt/reconcile_flow_entries",
+         {nullptr, &HttpSession::handleReconcileFlowEntries, false, Admission::Normal, true}},
+        {"/ndt/what_if_link_load",
+         {nullptr, &HttpSession::handleWhatIfLinkLoad, true, Admission::Heavy, true}},
+        {"/ndt/path_residuals",
+         {nullptr, &HttpSession::handleGetPathResiduals, false, Admission::Normal, true}},
+        {"/ndt/get_cpu_utilization", {&HttpSession::handleGetCpuUtilization, nullptr}},
+        {"/ndt/get_memory_utilization", {&HttpSession::handleGetMemoryUtilization, nullptr}},
+        {"/ndt/inform_switch_entered",
+         {&HttpSession::handleInformSwitchEntered, nullptr, false, Admission::ControlPlane}},
+        {"/ndt/modify_device_name", {nullptr, &HttpSession::handleModifyDeviceName}},
+        {"/ndt/received_a_simulation_case", {nullptr, &HttpSession::handleReceivedSimulationCase}},
+        {"/ndt/simulation_status", {&HttpSession::handleGetSimulationStatus, nullptr}},
+        {"/ndt/simulation_completed", {nullptr, &HttpSession::handleSimulationCompleted}},
+        {"/ndt/export_snapshot",
+         {nullptr, &HttpSession::handleExportSnapshot, true, Admission::Heavy}},
+        {"/ndt/get_static_topology_json", {&HttpSession::handleGetStaticTopology, nullptr}},
+        {"/ndt/inform_all_destination_paths",
+         {nullptr, &HttpSession::handleInformAllDestinationPaths}},
+        {"/ndt/app_register", {nullptr, &HttpSession::handleAppRegister}},
+        {"/ndt/intent_translator/text",
+         {nullptr, &HttpSession::handleInputTextIntent, true, Admission::Heavy}},
+        {"/ndt/get_nickname", {&HttpSession::handleGetNickname, nullptr}},
+        {"/ndt/modify_nickname", {nullptr, &HttpSession::handleModifyNickname}},
+        {"/ndt/get_temperature", {&HttpSession::handleGetTemperature, nullptr}},
+        {"/ndt/get_path_switch_count", {&HttpSession::handleGetPathSwitchCount, nullptr}},
+        {"/ndt/batch", {nullptr, &HttpSession::handleBatch, true, Admission::Heavy}},
+        {"/ndt/get_paths_between_hosts",
+         {nullptr, &HttpSession::handleGetPathsBetweenHosts, false, Admission::Normal, true}},
+        {"/ndt/get_openflow_capacity", {&HttpSession::handleGetOpenflowCapacity, nullptr, true}},
+        {"/ndt/historical_logging", {nullptr, &HttpSession::handleSetHistoricalLoggingState}},
+        {"/ndt/link_history", {&HttpSession::handleGetLinkHistory, nullptr}},
+        {"/ndt/flow_history", {&HttpSession::handleGetFlowHistory, nullptr}},
+        {"/ndt/history/link",
+         {&HttpSession::handleQueryLinkHistory, nullptr, true, Admission::Heavy}},
+        {"/ndt/get_average_link_usage", {&HttpSession::handleGetAvgLinkUsage, nullptr}},
+        {"/ndt/congested_links", {&HttpSession::handleGetCongestedLinks, nullptr}},
+        {"/ndt/get_total_input_traffic_load_passing_a_switch",
+         {nullptr, &HttpSession::handleGetTotalInputTrafficLoadPassingASwitch}},
+        {"/ndt/get_num_of_flows_passing_a_switch",
+         {nullptr, &HttpSession::handleGetNumOfFlowsPassingASwitch}},
+        {"/ndt/acquire_lock",
+         {nullptr, &HttpSession::handleAcquireLock, false, Admission::ControlPlane}},
+        {"/ndt/renew_lock",
+         {nullptr, &HttpSession::handleRenewLock, false, Admission::ControlPlane}},
+        {"/ndt/release_lock",
+         {nullptr, &HttpSession::handleReleaseLock, false, Admission::ControlPlane}},
+    };
+    return table;
+}
+
 void
 HttpSession::handleRequest()
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(),
-                       "Got request: {} {}",
-                       m_req.method_string(),
-                       m_req.target());
+    NDT_LOG_DEBUG(HTTP, "Got request: {} {}", m_req.method_string(), m_req.target());
+
+    if (!m_streamDone && m_req.count(http::field::upgrade) && upgradeToHttp2())
+    {
+        return;
+    }
 
     auto response =
         std::make_shared<http::response<http::string_body>>(http::status::ok, m_req.version());
@@ -108,231 +671,345 @@ HttpSession::handleRequest()
     response->set(http::field::access_control_max_age, "86400");
 
     response->set(http::field::content_type, "application/json");
+    response->body() = std::move(m_bodyBuffer);
+    m_bodyBuffer.clear();
 
-    try
+    const auto method = m_req.method();
+    const std::string_view target = m_req.target();
+
+    // OPTIONS
+    if (method == http::verb::options)
     {
-        const auto method = m_req.method();
-        const std::string_view target = m_req.target();
-        const std::string targetStr(target);
+        response->result(http::status::no_content); // 204 No Content
+        m_res = response;
+        writeResponse();
+        return;
+    }
 
-        // OPTIONS
-        if (method == http::verb::options)
+    // --- API ROUTING ---
+    const size_t qpos = target.find('?');
+    const auto& table = routes();
+    m_query = QueryParams(qpos == std::string_view::npos ? std::string_view{}
+                                                         : target.substr(qpos + 1));
+
+    Handler handler = &HttpSession::handleNotFound;
+    bool blocking = false;
+    Admission admission = Admission::Normal;
+    std::string_view path = target.substr(0, qpos);
+    if (auto it = table.find(path); it != table.end())
+    {
+        Handler routed = method == http::verb::get    ? it->second.get
+                         : method == http::verb::post ? it->second.post
+                                                      : nullptr;
+        if (routed)
         {
-            response->result(http::status::no_content); // 204 No Content
-            m_res = response;
-            writeResponse();
-            return;
+            handler = routed;
+            blocking = it->second.blocking;
+            admission = it->second.admission;
+            path = it->first; // outlives m_req, for leaveHeavy()
         }
+    }
 
-        // --- API ROUTING ---
-        if (method == http::verb::post && target == "/ndt/link_failure_detected")
-        {
-            handleLinkFailure(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/link_recovery_detected")
-        {
-            handleLinkRecovery(*response);
-        }
-        else if (method == http::verb::get && target == "/ndt/get_graph_data")
-        {
-            handleGetGraphData(*response);
-        }
-        else if (method == http::verb::get && target == "/ndt/get_detected_flow_data")
-        {
-            handleGetDetectedFlowData(*response);
-        }
-        else if (method == http::verb::get && target == "/ndt/get_switch_openflow_table_entries")
-        {
-            handleGetSwitchOpenflowEntries(*response);
-        }
-        else if (method == http::verb::get && target == "/ndt/get_power_report")
-        {
-            handleGetPowerReport(*response);
-        }
-        else if (method == http::verb::get && target.starts_with("/ndt/get_switches_power_state"))
-        {
-            handleGetSwitchesPowerState(*response);
-        }
-        else if (method == http::verb::post && target.starts_with("/ndt/set_switches_power_state"))
-        {
-            handleSetSwitchesPowerState(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/install_flow_entry")
-        {
-            handleInstallFlowEntry(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/delete_flow_entry")
-        {
-            handleDeleteFlowEntry(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/modify_flow_entry")
-        {
-            handleModifyFlowEntry(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/install_group_entry")
-        {
-            handleInstallGroupEntry(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/delete_group_entry")
-        {
-            handleDeleteGroupEntry(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/modify_group_entry")
-        {
-            handleModifyGroupEntry(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/install_meter_entry")
-        {
-            handleInstallMeterEntry(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/delete_meter_entry")
-        {
-            handleDeleteMeterEntry(*response);
-        }
-        else if (method == http::verb::post && target == "/ndt/modify_meter_entry")
-        {
-            handleModifyMeterEntry(*response);
-        }
-        else if (method == http::verb::post &&
-                 target == "/ndt/install_flow_entries_modify_flow_entries_and_delete_flow_entries")
-        {
-            handleInstallModifyDeleteFlowEntries(*response);
-        }
-        else if (method == http::verb::get && target == "/ndt/get_cpu_utilization")
-        {
-            handleGetCpuUtilization(*response);
-        }
-        else if (method == http::verb::get && target == "/ndt/get_memory_utilization")
-        {
-            handleGetMemoryUtilization(*response);
-        }
-        else if (method == http::verb::get && target.starts_with("/ndt/inform_switch_entered"))
-        {
-            handleInformSwitchEntered(*response);
-        }
-        else if (method == http::verb::post && target.starts_with("/ndt/modify_device_name"))
-        {
-            handleModifyDeviceName(*response);
-        }
-        else if (method == http::verb::post &&
-                 target.starts_with("/ndt/received_a_simulation_case"))
+    // Unknown paths share one label, so clients cannot grow the metric without bound
+    m_requestStart = std::chrono::steady_clock::now();
+    m_requestLatency = &utils::MetricsRegistry::instance().histogram(
+        "ndt_http_request_duration_seconds",
+        "Time from a request being parsed to its response being written",
+        utils::MetricsRegistry::label("route",
+                                      handler == &HttpSession::handleNotFound ? "unmatched"
+                                                                              : path));
+
+    if (!admit(admission, path, *response))
+    {
+        m_res = response;
+        writeResponse();
+        return;
+    }
+
+    // The telemetry stream keeps the connection, so it is not a table route
+    if (method == http::verb::get && path == "/ndt/telemetry_stream")
+    {
+        if (startTelemetryStream(*response))
         {
-            handleReceivedSimulationCase(*response);
+            return;
         }
-        else if (method == http::verb::post && target.starts_with("/ndt/simulation_completed"))
+        m_res = response;
+        writeResponse();
+        return;
+    }
+
+    // A waiting acquire is answered when the lease is granted, so it is not a table route either
+    if (method == http::verb::post && path == "/ndt/acquire_lock" && startLockWait(response))
+    {
+        return;
+    }
+
+    if (blocking)
+    {
+        // The session reads nothing more until the response is written, so m_req stays put
+        auto self = shared_from_this();
+        if (utils::BlockingPool::instance().tryPost([self, handler, response, admission, path] {
+                self->runHandler(handler, *response);
+                if (admission == Admission::Heavy)
+                {
+                    AdmissionControl::instance().leaveHeavy(path);
+                }
+                net::post(self->m_socket.get_executor(), [self, response] {
+                    self->m_res = response;
+                    self->writeResponse();
+                });
+            }))
         {
-            handleSimulationCompleted(*response);
+            return;
         }
-        else if (method == http::verb::get && target.starts_with("/ndt/get_static_topology_json"))
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Blocking work queue full, rejecting {} {}",
+                           m_req.method_string(),
+                           m_req.target());
+        response->result(http::status::service_unavailable);
+        response->body() = json{{"error", "Server busy"}}.dump();
+    }
+    else
+    {
+        runHandler(handler, *response);
+    }
+    if (admission == Admission::Heavy)
+    {
+        AdmissionControl::instance().leaveHeavy(path);
+    }
+
+    m_res = response;
+    writeResponse();
+}
+
+bool
+HttpSession::startTelemetryStream(http::response<http::string_body>& res)
+{
+    if (m_streamDone)
+    {
+        res.result(http::status::http_version_not_supported);
+        res.body() = json{{"error", "telemetry_stream needs HTTP/1.1"}}.dump();
+        return false;
+    }
+
+    auto parseNumber = [](const std::string& text, auto& out) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return ec == std::errc() && ptr == text.data() + text.size();
+    };
+    auto parsePrefix = [&](const std::string& text, std::pair<uint32_t, uint8_t>& out) {
+        size_t slash = text.find('/');
+        unsigned length = 32;
+        if (slash != std::string::npos && (!parseNumber(text.substr(slash + 1), length) ||
+                                           length > 32))
         {
-            handleGetStaticTopology(*response);
+            return false;
         }
-        else if (method == http::verb::post &&
-                 target.starts_with("/ndt/inform_all_destination_paths"))
+        out = {utils::ipStringToUint32(text.substr(0, slash)), static_cast<uint8_t>(length)};
+        return true;
+    };
+
+    TelemetryFilter filter;
+    uint64_t intervalMs = TELEMETRY_STREAM_DEFAULT_INTERVAL_MS;
+    std::string bad;
+    std::string text = m_query.get("interval_ms");
+    if (!text.empty() && !parseNumber(text, intervalMs))
+    {
+        bad = "interval_ms";
+    }
+    text = m_query.get("dpid");
+    uint64_t dpid = 0;
+    if (!text.empty())
+    {
+        if (parseNumber(text, dpid))
         {
-            handleInformAllDestinationPaths(*response);
+            filter.dpid = dpid;
         }
-        else if (method == http::verb::post && target.starts_with("/ndt/app_register"))
+        else
         {
-            handleAppRegister(*response);
+            bad = "dpid";
         }
-        else if (method == http::verb::post && target.starts_with("/ndt/intent_translator/text"))
+    }
+    text = m_query.get("edge");
+    if (!text.empty())
+    {
+        size_t dash = text.find('-');
+        uint64_t src = 0;
+        uint64_t dst = 0;
+        if (dash != std::string::npos && parseNumber(text.substr(0, dash), src) &&
+            parseNumber(text.substr(dash + 1), dst))
         {
-            handleInputTextIntent(*response);
+            filter.edge = {src, dst};
         }
-        else if (method == http::verb::get && target.starts_with("/ndt/get_nickname"))
+        else
         {
-            handleGetNickname(*response);
+            bad = "edge";
         }
-        else if (method == http::verb::post && target == "/ndt/modify_nickname")
+    }
+    for (const char* name : {"src", "dst"})
+    {
+        text = m_query.get(name);
+        std::pair<uint32_t, uint8_t> prefix;
+        if (text.empty())
         {
-            handleModifyNickname(*response);
+            continue;
         }
-        else if (method == http::verb::get && target.starts_with("/ndt/get_temperature"))
+        try
         {
-            handleGetTemperature(*response);
+            if (!parsePrefix(text, prefix))
+            {
+                bad = name;
+                continue;
+            }
         }
-        else if (method == http::verb::get && target.starts_with("/ndt/get_path_switch_count"))
+        catch (const std::exception&)
         {
-            handleGetPathSwitchCount(*response);
-        }
-        else if (method == http::verb::get && target.starts_with("/ndt/get_openflow_capacity"))
-        {
-            handleGetOpenflowCapacity(*response);
-        }
-        else if (method == http::verb::post && target.starts_with("/ndt/historical_logging"))
-        {
-            handleSetHistoricalLoggingState(*response);
-        }
-        else if (method == http::verb::get && target.starts_with("/ndt/get_average_link_usage"))
-        {
-            handleGetAvgLinkUsage(*response);
-        }
-        else if (method == http::verb::post &&
-                 target.starts_with("/ndt/get_total_input_traffic_load_passing_a_switch"))
-        {
-            handleGetTotalInputTrafficLoadPassingASwitch(*response);
-        }
-        else if (method == http::verb::post &&
-                 target.starts_with("/ndt/get_num_of_flows_passing_a_switch"))
-        {
-            handleGetNumOfFlowsPassingASwitch(*response);
-        }
-        else if (method == http::verb::post && target.starts_with("/ndt/acquire_lock"))
-        {
-            handleAcquireLock(*response);
-        }
-        else if (method == http::verb::post && target.starts_with("/ndt/renew_lock"))
-        {
-            handleRenewLock(*response);
-        }
-        else if (method == http::verb::post && target.starts_with("/ndt/release_lock"))
-        {
-            handleReleaseLock(*response);
-        }
-        else
-        {
-            handleNotFound(*response);
+            bad = name;
+            continue;
         }
+        (name[0] == 's' ? filter.srcPrefix : filter.dstPrefix) = prefix;
+    }
+
+    if (!bad.empty())
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "Invalid parameter: " + bad}}.dump();
+        return false;
+    }
+
+    std::make_shared<TelemetryStreamSession>(std::move(m_socket),
+                                             std::move(m_slot),
+                                             m_telemetryHub,
+                                             std::move(filter),
+                                             std::chrono::milliseconds(intervalMs))
+        ->start();
+    return true;
+}
+
+bool
+HttpSession::admit(Admission admission, std::string_view path,
+                   http::response<http::string_body>& res)
+{
+    auto& control = AdmissionControl::instance();
+    if (admission == Admission::ControlPlane)
+    {
+        return true;
+    }
+    if (m_slot.overCapacity())
+    {
+        control.recordOverCapacity();
+        res.result(http::status::service_unavailable);
+        res.keep_alive(false);
+        res.body() = json{{"error", "Too many connections"}}.dump();
+    }
+    else if (!control.allowRequest(m_clientAddress))
+    {
+        res.result(http::status::too_many_requests);
+        res.body() = json{{"error", "Rate limit exceeded"}}.dump();
+    }
+    else if (admission == Admission::Heavy && !control.enterHeavy(path))
+    {
+        res.result(http::status::service_unavailable);
+        res.body() = json{{"error", "Endpoint busy"}}.dump();
+    }
+    else
+    {
+        return true;
+    }
+    SPDLOG_LOGGER_WARN(Logger::instance(),
+                       "Refused {} {} from {}: {}",
+                       m_req.method_string(),
+                       path,
+                       m_clientAddress.to_string(),
+                       res.result_int());
+    res.set(http::field::retry_after, "1");
+    return false;
+}
+
+void
+HttpSession::runHandler(Handler handler, http::response<http::string_body>& res)
+{
+    // Handlers run one at a time per session, on one thread each
+    utils::JsonArena::Scope arena(m_arena);
+    try
+    {
+        (this->*handler)(res);
     }
     catch (const json::exception& e)
     {
-        response->result(http::status::bad_request);
-        response->body() = json{{"error", "JSON parsing error"}, {"details", e.what()}}.dump();
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "JSON parsing error"}, {"details", e.what()}}.dump();
         SPDLOG_LOGGER_ERROR(Logger::instance(), "JSON exception in request handler: {}", e.what());
     }
     catch (const std::exception& e)
     {
-        response->result(http::status::internal_server_error);
-        response->body() = json{{"error", "Internal server error"}, {"details", e.what()}}.dump();
+        res.result(http::status::internal_server_error);
+        res.body() = json{{"error", "Internal server error"}, {"details", e.what()}}.dump();
         SPDLOG_LOGGER_ERROR(Logger::instance(),
                             "Standard exception in request handler: {}",
                             e.what());
     }
     catch (...)
     {
-        response->result(http::status::internal_server_error);
-        response->body() = json{{"error", "An unknown error occurred"}}.dump();
+        res.result(http::status::internal_server_error);
+        res.body() = json{{"error", "An unknown error occurred"}}.dump();
         SPDLOG_LOGGER_ERROR(Logger::instance(), "Unknown exception in request handler.");
     }
+}
 
-    m_res = response;
-    writeResponse();
+void
+HttpSession::writeEncodedBody(http::response<http::string_body>& res,
+                              const std::function<std::string()>& render,
+                              utils::EncodedBodyCache* cache, std::string_view key,
+                              std::string_view version)
+{
+    const auto format = utils::negotiateFormat(m_req[http::field::accept]);
+    const auto encoding = utils::negotiateEncoding(m_req[http::field::accept_encoding]);
+    const utils::EncodedBody body = cache
+                                        ? cache->get(key, version, format, encoding, render)
+                                        : utils::encodeBody(render(), format, encoding);
+    res.body() = *body.data;
+    res.set(http::field::content_type, utils::contentType(body.format));
+    if (body.encoding != utils::ContentEncoding::Identity)
+    {
+        res.set(http::field::content_encoding, utils::toString(body.encoding));
+    }
+    res.set(http::field::vary, "Accept, Accept-Encoding");
 }
 
 void
 HttpSession::writeResponse()
 {
+    if (m_streamDone)
+    {
+        return finishStream();
+    }
     m_res->prepare_payload();
-    SPDLOG_LOGGER_TRACE(Logger::instance(),
-                        "Server reply with status {}: {}",
-                        m_res->result_int(),
-                        m_res->body());
+    NDT_LOG_TRACE(HTTP, "Server reply with status {}: {}", m_res->result_int(), m_res->body());
     http::async_write(m_socket,
                       *m_res,
                       beast::bind_front_handler(&HttpSession::onWrite, shared_from_this()));
 }
 
+void
+HttpSession::finishStream()
+{
+    m_res->prepare_payload();
+    NDT_LOG_TRACE(HTTP, "Stream reply with status {}: {}", m_res->result_int(), m_res->body());
+    // Queued for the connection rather than written, but the handler's work is done
+    if (m_requestLatency)
+    {
+        m_requestLatency->observe(std::chrono::steady_clock::now() - m_requestStart);
+        m_requestLatency = nullptr;
+    }
+    if (auto fn = std::exchange(after_write_, nullptr))
+    {
+        utils::BlockingPool::instance().post(std::move(fn));
+    }
+    m_query = {};
+    m_req = {};
+    std::exchange(m_streamDone, nullptr)(std::move(m_res));
+}
+
 void
 HttpSession::onWrite(beast::error_code ec, std::size_t bytes_transferred)
 {
@@ -344,6 +1021,12 @@ HttpSession::onWrite(beast::error_code ec, std::size_t bytes_transferred)
         return;
     }
 
+    if (m_requestLatency)
+    {
+        m_requestLatency->observe(std::chrono::steady_clock::now() - m_requestStart);
+        m_requestLatency = nullptr;
+    }
+
     // Take & clear the hook so it runs at most once
     auto fn = std::move(after_write_);
     after_write_ = nullptr;
@@ -351,7 +1034,7 @@ HttpSession::onWrite(beast::error_code ec, std::size_t bytes_transferred)
     // Offload heavy work so we don't block the I/O thread
     if (fn)
     {
-        std::thread(std::move(fn)).detach();
+        utils::BlockingPool::instance().post(std::move(fn));
     }
 
     // Honor keep-alive
@@ -361,10 +1044,32 @@ HttpSession::onWrite(beast::error_code ec, std::size_t bytes_transferred)
         return;
     }
 
+    if (m_res->body().capacity() <= NDT_HTTP_BODY_BUFFER_KEEP)
+    {
+        m_bodyBuffer = std::move(m_res->body());
+        m_bodyBuffer.clear();
+    }
     m_res.reset(); // free the just-sent message
     readRequest(); // continue serving next request
 }
 
+void
+HttpSession::rejectBody(std::uint64_t limit)
+{
+    SPDLOG_LOGGER_WARN(Logger::instance(), "Request body over {} bytes, closing", limit);
+    const unsigned version = m_parser ? m_parser->get().version() : 11;
+    m_parser.reset();
+    auto response = std::make_shared<http::response<http::string_body>>(
+        http::status::payload_too_large, version);
+    response->set(http::field::server, "ndt-server");
+    response->set(http::field::access_control_allow_origin, "*");
+    response->set(http::field::content_type, "application/json");
+    response->keep_alive(false); // the unread body is still on the connection
+    response->body() = json{{"error", "Request body too large"}, {"limit", limit}}.dump();
+    m_res = response;
+    writeResponse();
+}
+
 void
 HttpSession::closeSocket()
 {
@@ -400,18 +1105,46 @@ HttpSession::handleLinkFailure(http::response<http::string_body>& res)
         res.body() = R"({"error":"edge not found in topology"})";
         return;
     }
-    m_topologyAndFlowMonitor->setEdgeDown(fwdOpt.value());
-    m_eventBus->emit(Event{.type = EventType::LinkFailureDetected,
-                           .payload = LinkFailureEventData{fwdOpt.value()}});
-
-    auto revOpt = m_topologyAndFlowMonitor->findEdgeBySrcAndDstDpid({data->dstDpid, data->srcDpid});
+    // Failover trace, from the request's arrival until the reroutes it causes are applied
+    const utils::TraceId trace =
+        utils::Tracer::instance().begin("link_failure",
+                                        m_requestStart,
+                                        {{"src_dpid", data->srcDpid},
+                                         {"src_interface", data->srcInterface},
+                                         {"dst_dpid", data->dstDpid},
+                                         {"dst_interface", data->dstInterface}});
+    // Both directions down under one graph lock and version bump
+    auto revOpt = m_topologyAndFlowMonitor->findReverseEdge(fwdOpt.value());
+    LinkStateChangedEventData change;
+    {
+        auto transaction = m_topologyAndFlowMonitor->beginGraphTransaction();
+        transaction.setEdgeUp(fwdOpt.value(), false);
+        if (revOpt)
+        {
+            transaction.setEdgeUp(revOpt.value(), false);
+        }
+        change = transaction.commit();
+    }
+    change.affectedFlows = m_flowLinkUsageCollector->invalidatePathsThrough(
+        data->srcDpid, data->srcInterface, trace);
     if (revOpt)
     {
-        m_topologyAndFlowMonitor->setEdgeDown(revOpt.value());
-        m_eventBus->emit(Event{.type = EventType::LinkFailureDetected,
-                               .payload = LinkFailureEventData{revOpt.value()}});
+        auto reverseFlows = m_flowLinkUsageCollector->invalidatePathsThrough(
+            data->dstDpid, data->dstInterface, trace);
+        change.affectedFlows.insert(
+            change.affectedFlows.end(), reverseFlows.begin(), reverseFlows.end());
     }
-    res.body() = R"({"status":"link failure processed"})";
+    change.trace = trace;
+    change.publishedAt = std::chrono::steady_clock::now();
+    utils::Tracer::instance().span(trace,
+                                   "event_receipt",
+                                   m_requestStart,
+                                   change.publishedAt,
+                                   {{"affected_flows", change.affectedFlows.size()}});
+    // Both directions in one event, merged with any other change in the coalescing window
+    m_eventBus->channel<LinkStateChangedEventData>(EventType::LinkStateChanged).publish(
+        std::move(change));
+    res.body() = json{{"status", "link failure processed"}, {"trace_id", trace.toHex()}}.dump();
 }
 
 void
@@ -447,149 +1180,880 @@ HttpSession::handleLinkRecovery(http::response<http::string_body>& res)
         res.body() = R"({"error":"edge not found in topology"})";
         return;
     }
-    m_topologyAndFlowMonitor->setEdgeUp(fwdOpt.value());
-    // TODO: Emit LinkRecoveryDetected event
-
-    auto revOpt = m_topologyAndFlowMonitor->findEdgeBySrcAndDstDpid({dstDpid, srcDpid});
-    if (revOpt)
+    auto revOpt = m_topologyAndFlowMonitor->findReverseEdge(fwdOpt.value());
+    LinkStateChangedEventData change;
     {
-        m_topologyAndFlowMonitor->setEdgeUp(revOpt.value());
+        auto transaction = m_topologyAndFlowMonitor->beginGraphTransaction();
+        transaction.setEdgeUp(fwdOpt.value(), true);
+        if (revOpt)
+        {
+            transaction.setEdgeUp(revOpt.value(), true);
+        }
+        change = transaction.commit();
     }
+    m_eventBus->channel<LinkStateChangedEventData>(EventType::LinkStateChanged).publish(
+        std::move(change));
     res.body() = R"({"status":"link recovery processed"})";
 }
 
 void
-HttpSession::handleGetGraphData(http::response<http::string_body>& res)
+HttpSession::handleTopologyEvents(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Graph Data");
-    json result;
-    result["nodes"] = json::array();
-    result["edges"] = json::array();
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Topology Events");
+    json body = json::parse(m_req.body());
+    const json& items = body.at("events");
 
-    auto graph = m_topologyAndFlowMonitor->getGraph();
-    for (auto vd : boost::make_iterator_range(boost::vertices(graph)))
+    std::vector<TopologyEvent> events;
+    events.reserve(items.size());
+    std::vector<std::pair<uint64_t, uint32_t>> linksDown;
+    for (const auto& item : items)
     {
-        result["nodes"].push_back(graph[vd]);
+        std::string typeName = item.at("type").get<std::string>();
+        auto type = TopologyEvent::parseType(typeName);
+        if (!type)
+        {
+            res.result(http::status::bad_request);
+            res.body() = json{{"error", "Unknown topology event type: " + typeName}}.dump();
+            return;
+        }
+        switch (*type)
+        {
+        case TopologyEvent::Type::SwitchEnter:
+        case TopologyEvent::Type::SwitchLeave:
+            events.push_back({*type, item.at("switch")});
+            break;
+        case TopologyEvent::Type::LinkAdd:
+        case TopologyEvent::Type::LinkDelete:
+            events.push_back({*type, item.at("link")});
+            break;
+        case TopologyEvent::Type::HostAdd:
+            events.push_back({*type, item.at("host")});
+            break;
+        }
+        if (*type == TopologyEvent::Type::LinkDelete)
+        {
+            const json& src = events.back().body.at("src");
+            try
+            {
+                linksDown.emplace_back(
+                    utils::hexStringToUint64(src.at("dpid").get<std::string>()),
+                    utils::portStringToUint(src.value("port_no", "")));
+            }
+            catch (const std::invalid_argument&)
+            {
+                res.result(http::status::bad_request);
+                res.body() = json{{"error", "Invalid dpid: " + src.at("dpid").dump()}}.dump();
+                return;
+            }
+        }
     }
 
-    for (auto ed : boost::make_iterator_range(boost::edges(graph)))
+    LinkStateChangedEventData change = m_topologyAndFlowMonitor->applyTopologyEvents(events);
+    // Links going down start a failover trace, as POST /ndt/link_failure_detected does
+    utils::TraceId trace;
+    if (!linksDown.empty())
+    {
+        trace = utils::Tracer::instance().begin(
+            "topology_link_down", m_requestStart, {{"links_down", linksDown.size()}});
+    }
+    for (const auto& [dpid, port] : linksDown)
+    {
+        auto flows = m_flowLinkUsageCollector->invalidatePathsThrough(dpid, port, trace);
+        change.affectedFlows.insert(change.affectedFlows.end(), flows.begin(), flows.end());
+    }
+    const size_t changed = change.changes.size();
+    if (changed > 0)
+    {
+        change.trace = trace;
+        change.publishedAt = std::chrono::steady_clock::now();
+        utils::Tracer::instance().span(trace,
+                                       "event_receipt",
+                                       m_requestStart,
+                                       change.publishedAt,
+                                       {{"affected_flows", change.affectedFlows.size()}});
+        m_eventBus->channel<LinkStateChangedEventData>(EventType::LinkStateChanged).publish(
+            std::move(change));
+    }
+    json applied{{"status", "topology events applied"},
+                 {"events", events.size()},
+                 {"changed_links", changed}};
+    if (trace)
     {
-        auto& e = graph[ed];
+        applied["trace_id"] = trace.toHex();
+    }
+    res.body() = applied.dump();
+}
 
-        auto& ep = graph[ed];
-        json flowsJson = json::array();
+void
+HttpSession::handleGetGraphData(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Graph Data");
 
-        for (const auto& [key, last_seen] : ep.flowSet)
+    // ?fields=a,b,c keeps only those members of each node/edge; ?exclude_flow_set=true drops
+    // the (largest) flow_set member
+    std::unordered_set<std::string> fields;
+    std::string fieldsParam = m_query.get("fields");
+    for (size_t start = 0; start < fieldsParam.size();)
+    {
+        size_t end = std::min(fieldsParam.find(',', start), fieldsParam.size());
+        if (end > start)
+        {
+            fields.emplace(fieldsParam.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    std::string excludeParam = m_query.get("exclude_flow_set");
+    const bool excludeFlowSet = excludeParam == "true" || excludeParam == "1";
+    auto wanted = [&](std::string_view name) {
+        if (excludeFlowSet && name == "flow_set")
         {
-            (void)last_seen; // silence unused warning
-            flowsJson.push_back(key);
+            return false;
         }
+        return fields.empty() || fields.contains(std::string(name));
+    };
 
-        result["edges"].push_back(
-            {{"is_up", e.isUp},
-             {"link_bandwidth_bps", e.linkBandwidth},
-             {"left_link_bandwidth_bps",
-              m_mode == utils::DeploymentMode::MININET ? e.leftBandwidthFromFlowSample
-                                                       : e.leftBandwidth},
-             {"link_bandwidth_usage_bps", e.linkBandwidthUsage},
-             {"link_bandwidth_utilization_percent", e.linkBandwidthUtilization},
-             {"src_ip", e.srcIp},
-             {"src_dpid", e.srcDpid},
-             {"src_interface", e.srcInterface},
-             {"dst_ip", e.dstIp},
-             {"dst_dpid", e.dstDpid},
-             {"dst_interface", e.dstInterface},
-             {"flow_set", flowsJson},
-             {"is_enabled", e.isEnabled}});
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
+    const std::string version = graphSnapshot->versionToken();
+    if (matchETag(m_req, res, version))
+    {
+        NDT_LOG_DEBUG(HTTP, "get_graph_data not modified");
+        return;
     }
-    res.body() = result.dump();
-    SPDLOG_LOGGER_INFO(Logger::instance(), "get_graph_data success");
-}
 
-void
-HttpSession::handleGetDetectedFlowData(http::response<http::string_body>& res)
-{
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Detected Flow Data");
-    res.body() = m_flowLinkUsageCollector->getFlowInfoJson().dump();
-}
+    // ?since=<version> (an ETag value without quotes) returns only the edges whose counters
+    // or flows changed since then. A topology change in between makes the answer full.
+    std::string sinceParam = m_query.get("since");
+    const bool delta = !sinceParam.empty();
+    bool full = true;
+    uint64_t sinceStats = 0;
+    uint64_t sinceFlows = 0;
+    if (delta)
+    {
+        unsigned long long g = 0;
+        unsigned long long st = 0;
+        unsigned long long fl = 0;
+        if (std::sscanf(sinceParam.c_str(), "%llu-%llu-%llu", &g, &st, &fl) == 3 &&
+            g == graphSnapshot->version)
+        {
+            full = false;
+            sinceStats = st;
+            sinceFlows = fl;
+        }
+    }
 
-void
-HttpSession::handleGetSwitchOpenflowEntries(http::response<http::string_body>& res)
-{
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Swithc OpenFlow Entries");
-    res.body() = m_deviceConfigurationAndPowerManager->getOpenFlowTables().dump();
+    // Serialise straight into a string instead of building a json DOM. Members are written
+    // in the same (sorted) order nlohmann::json::dump() used, so the output is unchanged.
+    auto render = [&] {
+        std::string body;
+        body.reserve(256 * (boost::num_vertices(graph) + boost::num_edges(graph)));
+        utils::JsonWriter w(body);
+
+        auto writeEdge = [&](const EdgeProperties& e) {
+            w.beginObject();
+            if (wanted("dst_dpid"))
+            {
+                w.key("dst_dpid").value(e.dstDpid);
+            }
+            if (wanted("dst_interface"))
+            {
+                w.key("dst_interface").value(e.dstInterface);
+            }
+            if (wanted("dst_ip"))
+            {
+                w.key("dst_ip").array(e.dstIp);
+            }
+            if (wanted("flow_set"))
+            {
+                w.key("flow_set").beginArray();
+                for (const auto& [key, lastSeen] : e.flowSet)
+                {
+                    (void)lastSeen;
+                    w.beginObject()
+                        .key("dst_ip")
+                        .value(key.dstIP)
+                        .key("dst_port")
+                        .value(key.dstPort)
+                        .key("protocol_number")
+                        .value(key.protocol)
+                        .key("src_ip")
+                        .value(key.srcIP)
+                        .key("src_port")
+                        .value(key.srcPort)
+                        .endObject();
+                }
+                w.endArray();
+            }
+            if (wanted("is_enabled"))
+            {
+                w.key("is_enabled").value(e.isEnabled);
+            }
+            if (wanted("is_up"))
+            {
+                w.key("is_up").value(e.isUp);
+            }
+            if (wanted("left_link_bandwidth_bps"))
+            {
+                w.key("left_link_bandwidth_bps")
+                    .value(m_mode == utils::DeploymentMode::MININET ? e.leftBandwidthFromFlowSample
+                                                                    : e.leftBandwidth);
+            }
+            if (wanted("link_bandwidth_bps"))
+            {
+                w.key("link_bandwidth_bps").value(e.linkBandwidth);
+            }
+            if (wanted("link_bandwidth_usage_bps"))
+            {
+                w.key("link_bandwidth_usage_bps").value(e.linkBandwidthUsage);
+            }
+            if (wanted("link_bandwidth_utilization_percent"))
+            {
+                w.key("link_bandwidth_utilization_percent").value(e.linkBandwidthUtilization);
+            }
+            if (wanted("src_dpid"))
+            {
+                w.key("src_dpid").value(e.srcDpid);
+            }
+            if (wanted("src_interface"))
+            {
+                w.key("src_interface").value(e.srcInterface);
+            }
+            if (wanted("src_ip"))
+            {
+                w.key("src_ip").array(e.srcIp);
+            }
+            w.endObject();
+        };
+        auto writeNode = [&](const VertexProperties& v) {
+            w.beginObject();
+            if (wanted("brand_name"))
+            {
+                w.key("brand_name").value(v.brandName);
+            }
+            if (wanted("device_layer"))
+            {
+                w.key("device_layer").value(v.deviceLayer);
+            }
+            if (wanted("device_name"))
+            {
+                w.key("device_name").value(v.deviceName);
+            }
+            if (wanted("dpid"))
+            {
+                w.key("dpid").value(v.dpid);
+            }
+            if (wanted("ecmp_groups"))
+            {
+                // Few and small; reuse the existing to_json
+                w.key("ecmp_groups").raw(json(v.ecmpGroups).dump());
+            }
+            if (wanted("ip"))
+            {
+                w.key("ip").array(v.ip);
+            }
+            if (wanted("is_enabled"))
+            {
+                w.key("is_enabled").value(v.isEnabled);
+            }
+            if (wanted("is_up"))
+            {
+                w.key("is_up").value(v.isUp);
+            }
+            if (wanted("mac"))
+            {
+                w.key("mac").value(v.mac);
+            }
+            if (wanted("nickname"))
+            {
+                w.key("nickname").value(v.nickName);
+            }
+            if (wanted("vertex_type"))
+            {
+                w.key("vertex_type").value(static_cast<int>(v.vertexType));
+            }
+            w.endObject();
+        };
+
+        w.beginObject().key("edges").beginArray();
+        for (auto ed : boost::make_iterator_range(boost::edges(graph)))
+        {
+            const auto& e = graph[ed];
+            if (full || graphSnapshot->edgeChangedSince(e, sinceStats, sinceFlows))
+            {
+                writeEdge(e);
+            }
+        }
+        w.endArray();
+
+        if (delta)
+        {
+            w.key("full").value(full);
+        }
+
+        // Vertex attributes only change with the topology version, so a delta has no nodes
+        w.key("nodes").beginArray();
+        if (full)
+        {
+            for (auto vd : boost::make_iterator_range(boost::vertices(graph)))
+            {
+                writeNode(graph[vd]);
+            }
+        }
+        w.endArray();
+
+        if (delta)
+        {
+            w.key("version").value(version);
+        }
+        w.endObject();
+        return body;
+    };
+
+    // Pollers asking the same thing of the same snapshot share one body
+    writeEncodedBody(res, render, &responseCaches().graphData, m_query.raw(), version);
+
+    NDT_LOG_DEBUG(HTTP, "get_graph_data success");
 }
 
 void
-HttpSession::handleGetPowerReport(http::response<http::string_body>& res)
+HttpSession::handleGetDetectedFlowData(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Power Report");
-    res.body() = m_deviceConfigurationAndPowerManager->getPowerReport().dump();
+    NDT_LOG_DEBUG(HTTP, "Handle Get Detected Flow Data");
+    // The flow version doubles as the ETag; ?since=<version> returns only what changed. The
+    // rate tick moves it for flows whose immediate rates decay without new samples, so a
+    // cached body is at most one tick behind them
+    const uint64_t version = m_flowLinkUsageCollector->publishFlowVersion();
+    if (matchETag(m_req, res, std::to_string(version)))
+    {
+        NDT_LOG_DEBUG(HTTP, "get_detected_flow_data not modified");
+        return;
+    }
+
+    std::string sinceParam = m_query.get("since");
+    if (!sinceParam.empty())
+    {
+        uint64_t since = 0;
+        std::from_chars(sinceParam.data(), sinceParam.data() + sinceParam.size(), since);
+        writeEncodedBody(
+            res,
+            [&] { return m_flowLinkUsageCollector->getFlowInfoDeltaJson(since).dump(); },
+            &responseCaches().detectedFlows,
+            sinceParam,
+            std::to_string(version));
+        return;
+    }
+    writeEncodedBody(
+        res,
+        [this] { return m_flowLinkUsageCollector->getFlowInfoJsonText(); },
+        &responseCaches().detectedFlows,
+        "",
+        std::to_string(version));
 }
 
 void
-HttpSession::handleGetSwitchesPowerState(http::response<http::string_body>& res)
+HttpSession::handleGetTrafficMatrix(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Switches Power State");
-    // TODO[OPTIMIZATION] remove try catch part after modifying error handling in
-    // m_deviceConfigurationAndPowerManager
-    try
+    NDT_LOG_DEBUG(HTTP, "Handle Get Traffic Matrix");
+    uint64_t minBps = 0;
+    const std::string text = m_query.get("min_bps");
+    if (!text.empty())
     {
-        json body = m_deviceConfigurationAndPowerManager->getSwitchesPowerState(
-            std::string(m_req.target()));
-        res.body() = body.dump();
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), minBps);
+        if (ec != std::errc() || ptr != text.data() + text.size())
+        {
+            res.result(http::status::bad_request);
+            res.body() = json{{"error", "Invalid parameter: min_bps"}}.dump();
+            return;
+        }
     }
-    catch (const std::runtime_error& e)
+
+    const TrafficMatrix& matrix = m_flowLinkUsageCollector->trafficMatrix();
+    const std::string version = std::to_string(matrix.version());
+    if (matchETag(m_req, res, version))
     {
-        res.result(http::status::not_found);
-        res.body() = json::object({{"error", e.what()}}).dump();
-        SPDLOG_LOGGER_WARN(Logger::instance(), "get_switches_power_state: {}", e.what());
+        return;
     }
+    writeEncodedBody(
+        res,
+        [&] { return matrix.sparseJson(minBps).dump(); },
+        &responseCaches().trafficMatrix,
+        text,
+        version);
 }
 
 void
-HttpSession::handleSetSwitchesPowerState(http::response<http::string_body>& res)
+HttpSession::handleQueryFlows(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Set Switches Power State");
-    // Helper to parse query params from a target string
-    auto get_param = [](std::string_view target, std::string_view key) -> std::string {
-        auto qpos = target.find('?');
-        if (qpos == std::string_view::npos)
+    NDT_LOG_DEBUG(HTTP, "Handle Query Flows");
+
+    auto parseNumber = [](const std::string& text, auto& out) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return ec == std::errc() && ptr == text.data() + text.size();
+    };
+    auto parsePrefix = [&](const std::string& text, std::pair<uint32_t, uint8_t>& out) {
+        size_t slash = text.find('/');
+        unsigned length = 32;
+        if (slash != std::string::npos && (!parseNumber(text.substr(slash + 1), length) ||
+                                           length > 32))
         {
-            return "";
+            return false;
         }
-        target.remove_prefix(qpos + 1);
-        while (!target.empty())
-        {
-            auto key_end = target.find('=');
-            if (key_end == std::string_view::npos)
+        out = {utils::ipStringToUint32(text.substr(0, slash)), static_cast<uint8_t>(length)};
+        return true;
+    };
+
+    sflow::FlowQuery query;
+    size_t limit = 100;
+    std::string bad;
+    try
+    {
+        auto number = [&]<typename T>(const char* name, std::optional<T>& out) {
+            std::string text = m_query.get(name);
+            T value{};
+            if (text.empty())
+            {
+                return;
+            }
+            if (!parseNumber(text, value))
             {
-                break;
+                bad = name;
+                return;
             }
-            if (target.substr(0, key_end) == key)
+            out = value;
+        };
+        number("protocol", query.protocol);
+        number("src_port", query.srcPort);
+        number("dst_port", query.dstPort);
+        number("port", query.port);
+        number("dpid", query.dpid);
+        std::optional<uint64_t> minRate;
+        number("min_rate_bps", minRate);
+        query.minRateBps = minRate.value_or(0);
+        std::optional<size_t> limitParam;
+        number("limit", limitParam);
+        limit = limitParam.value_or(limit);
+
+        for (const char* name : {"src", "dst"})
+        {
+            std::string text = m_query.get(name);
+            std::pair<uint32_t, uint8_t> prefix;
+            if (text.empty())
             {
-                target.remove_prefix(key_end + 1);
-                auto val_end = target.find('&');
-                return std::string(target.substr(0, val_end));
+                continue;
             }
-            auto amp_pos = target.find('&');
-            if (amp_pos == std::string_view::npos)
+            if (!parsePrefix(text, prefix))
             {
-                break;
+                bad = name;
+                continue;
             }
-            target.remove_prefix(amp_pos + 1);
+            (name[0] == 's' ? query.srcPrefix : query.dstPrefix) = prefix;
         }
-        return "";
-    };
 
-    std::string ip = get_param(m_req.target(), "ip");
-    std::string action = get_param(m_req.target(), "action");
+        std::string elephant = m_query.get("elephant");
+        if (!elephant.empty())
+        {
+            query.elephant = elephant == "true" || elephant == "1";
+        }
 
-    if (ip.empty() || (action != "on" && action != "off"))
+        std::string edge = m_query.get("edge");
+        if (!edge.empty())
+        {
+            size_t dash = edge.find('-');
+            uint64_t src = 0;
+            uint64_t dst = 0;
+            if (dash == std::string::npos || !parseNumber(edge.substr(0, dash), src) ||
+                !parseNumber(edge.substr(dash + 1), dst))
+            {
+                bad = "edge";
+            }
+            query.edge = std::make_pair(src, dst);
+        }
+    }
+    catch (const std::invalid_argument&)
     {
-        res.result(http::status::bad_request);
-        res.body() = R"({"error":"Missing or invalid ip/action"})";
-        return;
+        bad = "src/dst";
+    }
+
+    if (!bad.empty())
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "Invalid query parameter"}, {"parameter", bad}}.dump();
+        return;
+    }
+
+    try
+    {
+        res.body() = m_flowLinkUsageCollector
+                         ->queryFlowsJson(query, m_query.get("cursor"), limit)
+                         .dump();
+    }
+    catch (const std::invalid_argument& e)
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", e.what()}}.dump();
+    }
+}
+
+void
+HttpSession::handleGetCollectorStats(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Collector Stats");
+    res.body() =
+        json{{"ingest_workers", m_flowLinkUsageCollector->getIngestStatsJson()},
+             {"ingest_filter", m_flowLinkUsageCollector->getIngestFilterStatsJson()},
+             {"sampling_control", m_flowLinkUsageCollector->getSamplingControlStatsJson()},
+             {"flow_pool", m_flowLinkUsageCollector->getFlowPoolStatsJson()},
+             {"flow_admission", m_flowLinkUsageCollector->getFlowAdmissionStatsJson()},
+             {"flow_tiers", m_flowLinkUsageCollector->getFlowTierStatsJson()},
+             {"traffic_matrix", m_flowLinkUsageCollector->trafficMatrix().statsJson()},
+             {"flow_export", m_flowLinkUsageCollector->getFlowExportStatsJson()},
+             {"telemetry_segment", m_flowLinkUsageCollector->getTelemetrySegmentStatsJson()},
+             {"link_liveness", m_flowLinkUsageCollector->getLinkLivenessStatsJson()},
+             {"cluster", m_flowLinkUsageCollector->getClusterStatsJson()},
+             {"checkpoint", m_flowLinkUsageCollector->getCheckpointStatsJson()},
+             {"path_cache", m_flowLinkUsageCollector->getPathCacheStatsJson()},
+             {"path_pool", sflow::PathPool::instance().statsJson()},
+             {"path_residual_cache", m_topologyAndFlowMonitor->getPathResidualCacheStatsJson()},
+             {"classifier", m_flowLinkUsageCollector->getClassifierStatsJson()},
+             {"edge_flow_expiry", m_topologyAndFlowMonitor->getEdgeFlowExpiryStatsJson()},
+             {"http_client", utils::HttpClient::instance().statsJson()},
+             {"https_client", utils::HttpsClient::instance().statsJson()},
+             {"snmp_client", utils::SnmpClient::instance().statsJson()},
+             {"liveness", m_deviceConfigurationAndPowerManager->getLivenessStatsJson()},
+             {"poll_scheduler", m_deviceConfigurationAndPowerManager->getPollSchedulerStatsJson()},
+             {"ssh_sessions", utils::SshSessionPool::instance().statsJson()},
+             {"event_bus", m_eventBus->statsJson()},
+             {"flow_dispatcher", m_controller->dispatcher().statsJson()},
+             {"openflow_southbound", m_flowRoutingManager->openFlowStatsJson()},
+             {"blocking_pool", utils::BlockingPool::instance().statsJson()},
+             {"history_writer", utils::HistoryWriter::instance().statsJson()},
+             {"memory", utils::MemoryPolicy::instance().statsJson()},
+             {"task_scheduler", utils::TaskScheduler::instance().statsJson()},
+             {"locks", m_lockManager->statusJson()},
+             {"simulations", m_simulationRequestManager->statsJson()},
+             {"response_cache",
+              {{"graph_data", responseCaches().graphData.statsJson()},
+               {"detected_flow_data", responseCaches().detectedFlows.statsJson()},
+               {"switch_openflow_table_entries", responseCaches().openflowTables.statsJson()},
+               {"power_report", responseCaches().powerReport.statsJson()},
+               {"cpu_utilization", responseCaches().cpuUtilization.statsJson()},
+               {"memory_utilization", responseCaches().memoryUtilization.statsJson()},
+               {"temperature", responseCaches().temperature.statsJson()},
+               {"static_topology_json", responseCaches().staticTopology.statsJson()},
+               {"openflow_capacity", responseCaches().openflowCapacity.statsJson()}}},
+             {"telemetry_stream", m_telemetryHub->statsJson()},
+             {"snapshot_export", m_snapshotExporter->statsJson()},
+             {"admission", AdmissionControl::instance().statsJson()},
+             {"flow_batches", m_controller->batchTracker().statsJson()},
+             {"flow_table_capacity", m_controller->capacity().statsJson()},
+             {"flow_reconciler", m_controller->reconciler().statsJson()},
+             {"fast_reroute",
+              m_controller->fastReroute() ? m_controller->fastReroute()->statsJson()
+                                          : json(nullptr)},
+             {"recent_history",
+              m_historicalDataManager ? m_historicalDataManager->recentHistory().statsJson()
+                                      : json(nullptr)}}
+            .dump();
+}
+
+void
+HttpSession::handleGetReadiness(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Readiness");
+    const json readiness = utils::Startup::instance().toJson();
+    if (!readiness.at("ready").get<bool>())
+    {
+        res.result(http::status::service_unavailable);
+    }
+    res.body() = readiness.dump();
+}
+
+void
+HttpSession::handleGetThreads(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Threads");
+    res.body() = json{{"threads", utils::ThreadRegistry::instance().toJson()}}.dump();
+}
+
+void
+HttpSession::handleGetTraces(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Traces");
+    size_t limit = 20;
+    const std::string text = m_query.get("limit");
+    if (!text.empty())
+    {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), limit);
+        if (ec != std::errc() || ptr != text.data() + text.size() || limit == 0)
+        {
+            res.result(http::status::bad_request);
+            res.body() = R"({"error":"Invalid parameter: limit"})";
+            return;
+        }
+    }
+    res.body() = utils::Tracer::instance().toOtlpJson(limit).dump();
+}
+
+void
+HttpSession::handleGetFlightRecorder(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Flight Recorder");
+    auto& recorder = utils::FlightRecorder::instance();
+    if (!recorder.enabled())
+    {
+        res.result(http::status::not_found);
+        res.body() = R"({"error":"The flight recorder is off; see --flight-recorder"})";
+        return;
+    }
+
+    size_t limit = SIZE_MAX;
+    const std::string limitText = m_query.get("limit");
+    if (!limitText.empty())
+    {
+        auto [ptr, ec] =
+            std::from_chars(limitText.data(), limitText.data() + limitText.size(), limit);
+        if (ec != std::errc() || ptr != limitText.data() + limitText.size() || limit == 0)
+        {
+            res.result(http::status::bad_request);
+            res.body() = R"({"error":"Invalid parameter: limit"})";
+            return;
+        }
+    }
+    std::optional<utils::FlightRecordKind> kind;
+    if (const std::string kindText = m_query.get("kind"); !kindText.empty())
+    {
+        kind = utils::FlightRecorder::kindFromName(kindText);
+        if (!kind)
+        {
+            res.result(http::status::bad_request);
+            res.body() = R"({"error":"Invalid parameter: kind"})";
+            return;
+        }
+    }
+    const std::string format = m_query.get("format");
+    if (format == "binary")
+    {
+        // The crash dump's format, for ndt_flight_dump
+        res.set(http::field::content_type, "application/octet-stream");
+        res.body() = recorder.dump();
+        return;
+    }
+    if (!format.empty() && format != "json")
+    {
+        res.result(http::status::bad_request);
+        res.body() = R"({"error":"Invalid parameter: format"})";
+        return;
+    }
+
+    json out = utils::FlightRecorder::decode(recorder.dump(), kind, limit);
+    for (json& thread : out["threads"])
+    {
+        for (json& record : thread["records"])
+        {
+            if (auto type = record.find("event_type");
+                type != record.end() && type->get<size_t>() < EVENT_TYPE_COUNT)
+            {
+                record["event"] = eventTypeName(static_cast<EventType>(type->get<size_t>()));
+            }
+        }
+    }
+    res.body() = out.dump();
+}
+
+void
+HttpSession::handleGetMemory(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Memory");
+    const std::string refresh = m_query.get("refresh");
+    if (!refresh.empty() && refresh != "0" && refresh != "1")
+    {
+        res.result(http::status::bad_request);
+        res.body() = R"({"error":"Invalid parameter: refresh"})";
+        return;
+    }
+    auto& accounting = utils::MemoryAccounting::instance();
+    if (refresh == "1")
+    {
+        accounting.refresh();
+    }
+    res.body() = accounting.toJson().dump();
+}
+
+void
+HttpSession::handleGetProfile(http::response<http::string_body>& res)
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Profile");
+    auto& profiler = utils::Profiler::instance();
+    if (!profiler.enabled())
+    {
+        res.result(http::status::forbidden);
+        res.body() = R"({"error":"Profiling is disabled; start NDT with --enable-profiling"})";
+        return;
+    }
+
+    auto parseNumber = [](const std::string& text, unsigned& out, unsigned max) {
+        if (text.empty())
+        {
+            return true;
+        }
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return ec == std::errc() && ptr == text.data() + text.size() && out > 0 && out <= max;
+    };
+    unsigned seconds = 10;
+    unsigned hz = PROFILER_DEFAULT_HZ;
+    const std::string type = m_query.get("type");
+    std::string bad;
+    if (!parseNumber(m_query.get("seconds"), seconds, PROFILER_MAX_SECONDS))
+    {
+        bad = "seconds";
+    }
+    else if (!parseNumber(m_query.get("hz"), hz, PROFILER_MAX_HZ))
+    {
+        bad = "hz";
+    }
+    else if (!type.empty() && type != "cpu" && type != "heap")
+    {
+        bad = "type";
+    }
+    if (!bad.empty())
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "Invalid parameter: " + bad}}.dump();
+        return;
+    }
+
+    std::optional<std::string> profile;
+    try
+    {
+        profile = type == "heap" ? profiler.heapProfile()
+                                 : profiler.cpuProfile(std::chrono::seconds(seconds), hz);
+    }
+    catch (const utils::ProfilerUnavailable& e)
+    {
+        res.result(http::status::not_implemented);
+        res.body() = json{{"error", "Profiling unavailable"}, {"details", e.what()}}.dump();
+        return;
+    }
+    if (!profile)
+    {
+        res.result(http::status::conflict);
+        res.body() = R"({"error":"Another profile is being taken"})";
+        return;
+    }
+    res.set(http::field::content_type, "application/octet-stream");
+    res.set(http::field::content_disposition,
+            type == "heap" ? "attachment; filename=\"ndt.heap\""
+                           : "attachment; filename=\"ndt.prof\"");
+    res.body() = std::move(*profile);
+}
+
+void
+HttpSession::handleGetRuntimeConfig(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Runtime Config");
+    res.body() = utils::RuntimeConfig::instance().toJson().dump();
+}
+
+void
+HttpSession::handleSetRuntimeConfig(http::response<http::string_body>& res)
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Set Runtime Config");
+    const json body = json::parse(m_req.body(), nullptr, false);
+    if (std::string error = utils::RuntimeConfig::instance().set(body); !error.empty())
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", error}}.dump();
+        return;
+    }
+    res.body() = utils::RuntimeConfig::instance().toJson().dump();
+}
+
+void
+HttpSession::handleGetMetrics(http::response<http::string_body>& res)
+{
+    std::string out;
+    utils::MetricsRegistry::instance().render(out);
+    m_flowLinkUsageCollector->appendMetrics(out);
+    m_topologyAndFlowMonitor->appendMetrics(out);
+    m_controller->dispatcher().appendMetrics(out);
+    utils::MemoryAccounting::instance().appendMetrics(out);
+
+    const json pool = utils::BlockingPool::instance().statsJson();
+    utils::MetricsRegistry::appendFamily(
+        out,
+        "ndt_blocking_pool_tasks",
+        "gauge",
+        "Tasks of the blocking pool, by state",
+        {{"state=\"queued\"", pool["queued"].get<double>()},
+         {"state=\"running\"", pool["running"].get<double>()}});
+    utils::MetricsRegistry::appendFamily(out,
+                                         "ndt_blocking_pool_rejected_total",
+                                         "counter",
+                                         "Tasks refused because the blocking pool queue was full",
+                                         {{"", pool["rejected"].get<double>()}});
+
+    res.set(http::field::content_type, "text/plain; version=0.0.4; charset=utf-8");
+    res.body() = std::move(out);
+}
+
+void
+HttpSession::handleGetSwitchOpenflowEntries(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Swithc OpenFlow Entries");
+    // Read the version first: the tables can only be newer than it, never older
+    const uint64_t version = m_deviceConfigurationAndPowerManager->openFlowTablesVersion();
+    writeEncodedBody(
+        res,
+        [this] { return m_deviceConfigurationAndPowerManager->getOpenFlowTables().dump(); },
+        &responseCaches().openflowTables,
+        "",
+        std::to_string(version));
+}
+
+void
+HttpSession::handleGetPowerReport(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Power Report");
+    writeEncodedBody(
+        res,
+        [this] { return m_deviceConfigurationAndPowerManager->getPowerReport().dump(); },
+        &responseCaches().powerReport,
+        "",
+        std::to_string(m_deviceConfigurationAndPowerManager->statusVersion()));
+}
+
+void
+HttpSession::handleGetSwitchesPowerState(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Switches Power State");
+    // TODO[OPTIMIZATION] remove try catch part after modifying error handling in
+    // m_deviceConfigurationAndPowerManager
+    try
+    {
+        json body = m_deviceConfigurationAndPowerManager->getSwitchesPowerState(
+            std::string(m_req.target()));
+        res.body() = body.dump();
+    }
+    catch (const std::runtime_error& e)
+    {
+        res.result(http::status::not_found);
+        res.body() = json::object({{"error", e.what()}}).dump();
+        SPDLOG_LOGGER_WARN(Logger::instance(), "get_switches_power_state: {}", e.what());
+    }
+}
+
+void
+HttpSession::handleSetSwitchesPowerState(http::response<http::string_body>& res)
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Set Switches Power State");
+    std::string ip = m_query.get("ip");
+    std::string action = m_query.get("action");
+
+    if (ip.empty() || (action != "on" && action != "off"))
+    {
+        res.result(http::status::bad_request);
+        res.body() = R"({"error":"Missing or invalid ip/action"})";
+        return;
     }
 
     bool ok = m_deviceConfigurationAndPowerManager->setSwitchPowerState(ip, action);
@@ -653,66 +2117,66 @@ void
 HttpSession::handleInstallGroupEntry(http::response<http::string_body>& res)
 {
     SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Install Group Entry");
-    auto jsonData = json::parse(m_req.body());
 
-    m_flowRoutingManager->installAGroupEntry(jsonData);
+    json j;
+    j["install_group_entries"] = json::array({json::parse(m_req.body())});
 
-    res.body() = R"({"status":"Group entry installed"})";
+    processFlowBatch(j, res);
 }
 
 void
 HttpSession::handleDeleteGroupEntry(http::response<http::string_body>& res)
 {
     SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Delete Group Entry");
-    auto jsonData = json::parse(m_req.body());
 
-    m_flowRoutingManager->deleteAGroupEntry(jsonData);
+    json j;
+    j["delete_group_entries"] = json::array({json::parse(m_req.body())});
 
-    res.body() = R"({"status":"Group entry deleted"})";
+    processFlowBatch(j, res);
 }
 
 void
 HttpSession::handleModifyGroupEntry(http::response<http::string_body>& res)
 {
     SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Modify Group Entry");
-    auto jsonData = json::parse(m_req.body());
 
-    m_flowRoutingManager->modifyAGroupEntry(jsonData);
+    json j;
+    j["modify_group_entries"] = json::array({json::parse(m_req.body())});
 
-    res.body() = R"({"status":"Group entry modified"})";
+    processFlowBatch(j, res);
 }
 
 void
 HttpSession::handleInstallMeterEntry(http::response<http::string_body>& res)
 {
     SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Install Meter Entry");
-    auto jsonData = json::parse(m_req.body());
 
-    m_flowRoutingManager->installAMeterEntry(jsonData);
+    json j;
+    j["install_meter_entries"] = json::array({json::parse(m_req.body())});
 
-    res.body() = R"({"status":"Meter entry installed"})";
+    processFlowBatch(j, res);
 }
 
 void
 HttpSession::handleDeleteMeterEntry(http::response<http::string_body>& res)
 {
     SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Delete Meter Entry");
-    auto jsonData = json::parse(m_req.body());
 
-    m_flowRoutingManager->deleteAMeterEntry(jsonData);
+    json j;
+    j["delete_meter_entries"] = json::array({json::parse(m_req.body())});
 
-    res.body() = R"({"status":"Meter entry deleted"})";
+    processFlowBatch(j, res);
 }
 
 void
 HttpSession::handleModifyMeterEntry(http::response<http::string_body>& res)
 {
     SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Modify Meter Entry");
-    auto jsonData = json::parse(m_req.body());
 
-    m_flowRoutingManager->modifyAMeterEntry(jsonData);
+    json j;
+    j["modify_meter_entries"] = json::array({json::parse(m_req.body())});
 
-    res.body() = R"({"status":"Meter entry modified"})";
+    processFlowBatch(j, res);
 }
 
 static FlowJob
@@ -754,13 +2218,32 @@ makeDeleteJob(const nlohmann::json& entry)
     return j;
 }
 
+// A Ryu groupentry/meterentry body as a job; the id identifies it within the switch's queue
+static FlowJob
+makeGroupMeterJob(const nlohmann::json& entry, FlowTarget target, FlowOp op)
+{
+    const char* idKey = target == FlowTarget::Group ? "group_id" : "meter_id";
+    if (!entry.contains(idKey) || !entry.at(idKey).is_number_unsigned())
+    {
+        throw std::invalid_argument(std::string(idKey) + " must be a non-negative integer");
+    }
+
+    FlowJob j;
+    j.dpid = entry.at("dpid").get<uint64_t>();
+    j.op = op;
+    j.target = target;
+    j.entry = entry;
+
+    return j;
+}
+
 void
 HttpSession::processFlowBatch(const json& j, http::response<http::string_body>& res)
 {
     std::vector<std::pair<std::vector<std::pair<uint32_t, uint32_t>>, uint32_t>>
         affectedFlowsAndDstIpForEachModifiedEntry;
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "j {}", j.dump(2));
+    NDT_LOG_DEBUG(HTTP, "Flow batch {}", j.dump());
 
     const auto& ins = j.value("install_flow_entries", json::array());
     const auto& mods = j.value("modify_flow_entries", json::array());
@@ -777,12 +2260,38 @@ HttpSession::processFlowBatch(const json& j, http::response<http::string_body>&
         return;
     }
 
+    // Group and meter entries go first, so a flow in the same batch finds its group installed
+    static const std::array<std::tuple<const char*, FlowTarget, FlowOp>, 6> groupMeterArrays{{
+        {"install_group_entries", FlowTarget::Group, FlowOp::Install},
+        {"modify_group_entries", FlowTarget::Group, FlowOp::Modify},
+        {"delete_group_entries", FlowTarget::Group, FlowOp::Delete},
+        {"install_meter_entries", FlowTarget::Meter, FlowOp::Install},
+        {"modify_meter_entries", FlowTarget::Meter, FlowOp::Modify},
+        {"delete_meter_entries", FlowTarget::Meter, FlowOp::Delete},
+    }};
+
     // Build jobs
     std::vector<FlowJob> jobs;
     jobs.reserve(ins.size() + mods.size() + dels.size());
+    utils::TraceId trace;
 
     try
     {
+        for (const auto& [key, target, op] : groupMeterArrays)
+        {
+            if (!j.contains(key))
+            {
+                continue;
+            }
+            if (!j.at(key).is_array())
+            {
+                throw std::invalid_argument(std::string(key) + " must be an array");
+            }
+            for (const auto& e : j.at(key))
+            {
+                jobs.emplace_back(makeGroupMeterJob(e, target, op));
+            }
+        }
         for (const auto& e : ins)
         {
             jobs.emplace_back(makeInstallJob(e));
@@ -795,24 +2304,121 @@ HttpSession::processFlowBatch(const json& j, http::response<http::string_body>&
         {
             jobs.emplace_back(makeDeleteJob(e));
         }
+
+        const std::optional<FlowLane> lane =
+            flowLaneFromString(j.value("lane", std::string(toString(FlowLane::Normal))));
+        if (!lane)
+        {
+            throw std::invalid_argument("lane must be urgent, normal or bulk");
+        }
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        if (j.contains("deadline_ms"))
+        {
+            deadline = std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(j.at("deadline_ms").get<uint64_t>());
+        }
+        // The failover this batch reroutes around: as given, or for an urgent batch the
+        // failure traced last, if recent enough
+        if (j.contains("trace_id"))
+        {
+            std::optional<utils::TraceId> given =
+                utils::TraceId::fromHex(j.at("trace_id").get<std::string>());
+            if (!given)
+            {
+                throw std::invalid_argument("trace_id must be 32 hex digits");
+            }
+            trace = *given;
+        }
+        else if (*lane == FlowLane::Urgent)
+        {
+            trace = utils::Tracer::instance().recent(
+                std::chrono::milliseconds(TRACE_JOIN_WINDOW_MS));
+        }
+        for (FlowJob& job : jobs)
+        {
+            job.lane = *lane;
+            job.deadline = deadline;
+            job.trace = trace;
+        }
     }
     catch (const std::exception& ex)
     {
-        SPDLOG_LOGGER_DEBUG(Logger::instance(), "request body {}", j.dump());
+        NDT_LOG_DEBUG(HTTP, "request body {}", j.dump());
         SPDLOG_LOGGER_ERROR(Logger::instance(), "Bad entry in request: {}", ex.what());
         res.result(http::status::bad_request);
         res.body() = R"({"error":"Bad entry"})";
         return;
     }
 
-    // Enqueue once; dispatcher drains per-DPID on worker threads
+    const std::string asyncParam = m_query.get("async");
+    const bool async = j.value("async", false) || asyncParam == "1" || asyncParam == "true";
+
+    // Refuse up front what the switches' flow tables have no room for
+    const std::vector<FlowTableCapacity::Rejection> rejections =
+        m_controller->capacity().admit(jobs);
+    if (!rejections.empty())
+    {
+        json switches = json::array();
+        for (const auto& rejection : rejections)
+        {
+            switches.push_back(rejection.toJson());
+        }
+        res.result(http::status::insufficient_storage);
+        res.body() =
+            json{{"error", "Flow table capacity exceeded"}, {"switches", std::move(switches)}}
+                .dump();
+        return;
+    }
+
+    // Enqueue once; dispatcher drains per-DPID on worker threads and reports to the tracker
+    const uint64_t batchId = m_controller->batchTracker().track(jobs);
     m_controller->dispatcher().enqueue(std::move(jobs));
 
+    json body{{"batch_id", batchId}};
+    if (trace)
+    {
+        body["trace_id"] = trace.toHex();
+    }
+    if (async)
+    {
+        // TODO: Immediately update the table
+        after_write_ = [manager = m_deviceConfigurationAndPowerManager, j] {
+            manager->updateOpenFlowTables(j);
+        };
+        res.result(http::status::accepted);
+        body["status"] = "accepted";
+        res.body() = body.dump();
+        return;
+    }
+
     // TODO: Immediately update the table
     m_deviceConfigurationAndPowerManager->updateOpenFlowTables(j);
 
+    body["status"] = "Flows installed, modified and deleted";
+    res.body() = body.dump();
+}
 
-    res.body() = R"({"status":"Flows installed, modified and deleted"})";
+void
+HttpSession::handleGetFlowBatchStatus(http::response<http::string_body>& res)
+{
+    const std::string text = m_query.get("id");
+    uint64_t id = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), id);
+    if (text.empty() || ec != std::errc() || ptr != text.data() + text.size())
+    {
+        res.result(http::status::bad_request);
+        res.body() = R"({"error":"Invalid parameter: id"})";
+        return;
+    }
+
+    std::optional<json> status = m_controller->batchTracker().statusJson(id);
+    if (!status)
+    {
+        res.result(http::status::not_found);
+        res.body() = R"({"error":"Unknown batch id"})";
+        return;
+    }
+    res.body() = status->dump();
 }
 
 void
@@ -824,33 +2430,530 @@ HttpSession::handleInstallModifyDeleteFlowEntries(http::response<http::string_bo
 }
 
 void
-HttpSession::handleGetCpuUtilization(http::response<http::string_body>& res)
+HttpSession::handleReconcileFlowEntries(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get CPU Utilization");
-    res.body() = m_deviceConfigurationAndPowerManager->getCpuUtilization().dump();
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Reconcile Flow Entries");
+    const json j = json::parse(m_req.body());
+
+    // Validate every switch before reconciling any, so a bad entry changes nothing
+    std::string ns;
+    std::vector<std::pair<uint64_t, std::vector<sflow::FlowChange>>> desired;
+    try
+    {
+        ns = j.at("namespace").get<std::string>();
+        if (ns.empty())
+        {
+            throw std::invalid_argument("namespace must not be empty");
+        }
+        for (const auto& sw : j.at("switches"))
+        {
+            std::vector<sflow::FlowChange> rules;
+            for (const auto& entry : sw.value("flow_entries", json::array()))
+            {
+                rules.push_back(FlowReconciler::parseEntry(entry));
+            }
+            desired.emplace_back(sw.at("dpid").get<uint64_t>(), std::move(rules));
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Bad reconcile request: {}", ex.what());
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", std::string("Bad entry: ") + ex.what()}}.dump();
+        return;
+    }
+
+    std::vector<sflow::FlowDiff> diffs;
+    json summary = json::array();
+    for (const auto& [dpid, rules] : desired)
+    {
+        size_t unchanged = 0;
+        sflow::FlowDiff diff = m_controller->reconciler().reconcile(ns, dpid, rules, unchanged);
+        summary.push_back({{"dpid", dpid},
+                           {"added", diff.added.size()},
+                           {"modified", diff.modified.size()},
+                           {"removed", diff.removed.size()},
+                           {"unchanged", unchanged}});
+        diffs.push_back(std::move(diff));
+    }
+
+    json batch = FlowReconciler::toFlowBatch(diffs);
+    if (batch.at("install_flow_entries").empty() && batch.at("delete_flow_entries").empty())
+    {
+        res.body() =
+            json{{"status", "Already reconciled"}, {"switches", std::move(summary)}}.dump();
+        return;
+    }
+    for (const char* key : {"lane", "deadline_ms", "async", "trace_id"})
+    {
+        if (j.contains(key))
+        {
+            batch[key] = j.at(key);
+        }
+    }
+    processFlowBatch(batch, res);
+    if (res.result() == http::status::ok || res.result() == http::status::accepted)
+    {
+        json body = json::parse(res.body());
+        body["switches"] = std::move(summary);
+        res.body() = body.dump();
+    }
 }
 
 void
-HttpSession::handleGetMemoryUtilization(http::response<http::string_body>& res)
+HttpSession::handleWhatIfLinkLoad(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Memory Utilization");
-    res.body() = m_deviceConfigurationAndPowerManager->getMemoryUtilization().dump();
+    NDT_LOG_DEBUG(HTTP, "Handle What-If Link Load");
+    const auto start = std::chrono::steady_clock::now();
+    const std::shared_ptr<const WhatIfEvaluator> evaluator =
+        WhatIfEvaluator::forSnapshot(m_topologyAndFlowMonitor->getGraphSnapshot(
+            std::chrono::milliseconds(WHAT_IF_SNAPSHOT_MAX_AGE_MS)));
+
+    // One move of a scenario: the flows of a selector, or new traffic of a given rate
+    struct Move
+    {
+        uint32_t srcIp = 0;
+        uint32_t dstIp = 0;
+        std::optional<uint16_t> srcPort;
+        std::optional<uint16_t> dstPort;
+        std::optional<uint8_t> protocol;
+        std::optional<uint64_t> bps;
+        std::optional<sflow::Path> path; // nullopt if the requested path has no usable link
+    };
+    struct Scenario
+    {
+        std::vector<Move> moves;
+        std::vector<PathMove> pathMoves;
+        uint64_t movedBps = 0;
+        size_t flows = 0;
+    };
+
+    const json j = json::parse(m_req.body());
+    std::vector<Scenario> scenarios;
+    size_t topLinks = WHAT_IF_TOP_LINKS;
+    try
+    {
+        const json& list = j.at("scenarios");
+        if (!list.is_array() || list.size() > WHAT_IF_MAX_SCENARIOS)
+        {
+            throw std::invalid_argument("scenarios must be an array of at most " +
+                                        std::to_string(WHAT_IF_MAX_SCENARIOS));
+        }
+        topLinks = j.value("top_links", topLinks);
+        scenarios.resize(list.size());
+        for (size_t s = 0; s < list.size(); ++s)
+        {
+            for (const auto& entry : list[s].at("moves"))
+            {
+                Move move;
+                move.srcIp = utils::ipStringToUint32(entry.at("src_ip").get<std::string>());
+                move.dstIp = utils::ipStringToUint32(entry.at("dst_ip").get<std::string>());
+                if (entry.contains("src_port"))
+                {
+                    move.srcPort = entry.at("src_port").get<uint16_t>();
+                }
+                if (entry.contains("dst_port"))
+                {
+                    move.dstPort = entry.at("dst_port").get<uint16_t>();
+                }
+                if (entry.contains("protocol"))
+                {
+                    move.protocol = entry.at("protocol").get<uint8_t>();
+                }
+                if (entry.contains("bps"))
+                {
+                    move.bps = entry.at("bps").get<uint64_t>();
+                }
+                // Either switch dpids in order, or explicit [dpid, output port] hops
+                const json& hops = entry.at("path");
+                if (!hops.is_array() || hops.empty())
+                {
+                    throw std::invalid_argument("path must be a non-empty array");
+                }
+                if (hops.front().is_array())
+                {
+                    sflow::Path path;
+                    for (const auto& hop : hops)
+                    {
+                        path.emplace_back(hop.at(0).get<uint64_t>(), hop.at(1).get<uint32_t>());
+                    }
+                    path.emplace_back(move.dstIp, 0);
+                    move.path = std::move(path);
+                }
+                else
+                {
+                    move.path = evaluator->pathThrough(hops.get<std::vector<uint64_t>>(),
+                                                       move.dstIp);
+                }
+                scenarios[s].moves.push_back(std::move(move));
+            }
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Bad what-if request: {}", ex.what());
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", std::string("Bad request: ") + ex.what()}}.dump();
+        return;
+    }
+
+    // New traffic moves as given; flow selectors take their flows' periodic rates, found in
+    // one pass over the flow table for all scenarios
+    std::unordered_map<uint64_t, std::vector<std::pair<size_t, size_t>>> selectors;
+    for (size_t s = 0; s < scenarios.size(); ++s)
+    {
+        Scenario& scenario = scenarios[s];
+        for (size_t m = 0; m < scenario.moves.size(); ++m)
+        {
+            const Move& move = scenario.moves[m];
+            if (!move.path)
+            {
+                continue;
+            }
+            if (move.bps)
+            {
+                scenario.pathMoves.push_back({*move.bps, {}, *move.path});
+                scenario.movedBps += *move.bps;
+            }
+            else
+            {
+                selectors[(uint64_t(move.srcIp) << 32) | move.dstIp].emplace_back(s, m);
+            }
+        }
+    }
+    if (!selectors.empty())
+    {
+        m_flowLinkUsageCollector->visitFlows(
+            {}, [&](const sflow::FlowKey& key, const sflow::FlowInfo& info) {
+                auto it = selectors.find((uint64_t(key.srcIP) << 32) | key.dstIP);
+                if (it == selectors.end())
+                {
+                    return true;
+                }
+                for (const auto& [s, m] : it->second)
+                {
+                    const Move& move = scenarios[s].moves[m];
+                    if ((move.srcPort && *move.srcPort != key.srcPort) ||
+                        (move.dstPort && *move.dstPort != key.dstPort) ||
+                        (move.protocol && *move.protocol != key.protocol))
+                    {
+                        continue;
+                    }
+                    const uint64_t rate = info.estimatedFlowSendingRatePeriodically;
+                    scenarios[s].pathMoves.push_back({rate, info.flowPath.path(), *move.path});
+                    scenarios[s].movedBps += rate;
+                    ++scenarios[s].flows;
+                }
+                return true;
+            });
+    }
+
+    const CsrGraph& csr = evaluator->snapshot().csr;
+    // Built in the request's arena, like the rest of the response
+    using utils::ArenaJson;
+    auto linkJson = [&csr](CsrGraph::EdgeId e) {
+        return ArenaJson{{"src_dpid", csr.dpid(csr.source(e))},
+                    {"src_interface", csr.srcInterface(e)},
+                    {"dst_dpid", csr.dpid(csr.target(e))},
+                    {"dst_interface", csr.dstInterface(e)}};
+    };
+    ArenaJson results = ArenaJson::array();
+    for (const Scenario& scenario : scenarios)
+    {
+        const auto unroutable =
+            std::find_if(scenario.moves.begin(), scenario.moves.end(), [](const Move& move) {
+                return !move.path;
+            });
+        if (unroutable != scenario.moves.end())
+        {
+            results.push_back(
+                {{"error",
+                  "No usable path for " + utils::ipToString(unroutable->srcIp) + " -> " +
+                      utils::ipToString(unroutable->dstIp)}});
+            continue;
+        }
+        const WhatIfResult result = evaluator->evaluate(scenario.pathMoves, topLinks);
+        ArenaJson links = ArenaJson::array();
+        for (const WhatIfResult::Link& link : result.changed)
+        {
+            ArenaJson entry = linkJson(link.edge);
+            entry["utilization_before"] = link.before;
+            entry["utilization_after"] = link.after;
+            links.push_back(std::move(entry));
+        }
+        results.push_back(
+            {{"max_utilization_after", result.maxAfter},
+             {"max_utilization_delta", result.maxAfter - result.maxBefore},
+             {"max_link",
+              result.maxAfterEdge == CsrGraph::NO_EDGE ? ArenaJson()
+                                                       : linkJson(result.maxAfterEdge)},
+             {"moved_bps", scenario.movedBps},
+             {"flows", scenario.flows},
+             {"links", std::move(links)},
+             {"unknown_hops", result.unknownHops}});
+    }
+
+    const ArenaJson body{{"graph_version", evaluator->snapshot().version},
+                         {"max_utilization_before", evaluator->evaluate({}).maxBefore},
+                         {"results", std::move(results)},
+                         {"elapsed_us",
+                          std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count()}};
+    utils::dumpInto(body, res.body());
 }
 
 void
-HttpSession::handleInformSwitchEntered(http::response<http::string_body>& res)
+HttpSession::handleGetPathResiduals(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Inform Switch Entered");
+    NDT_LOG_DEBUG(HTTP, "Handle Get Path Residuals");
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    try
+    {
+        const json j = json::parse(m_req.body());
+        for (const auto& pair : j.at("pairs"))
+        {
+            pairs.emplace_back(utils::ipStringToUint32(pair.at("src_ip").get<std::string>()),
+                               utils::ipStringToUint32(pair.at("dst_ip").get<std::string>()));
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", std::string("Bad request: ") + ex.what()}}.dump();
+        return;
+    }
 
-    std::string_view target = m_req.target();
-    auto pos = target.find("?dpid=");
-    if (pos == std::string_view::npos)
+    utils::ArenaJson residuals = utils::ArenaJson::array();
+    for (const std::optional<uint64_t>& residual :
+         m_flowLinkUsageCollector->getHostPairResiduals(pairs))
+    {
+        residuals.push_back(residual ? utils::ArenaJson(*residual) : utils::ArenaJson());
+    }
+    utils::dumpInto(utils::ArenaJson{{"residuals", std::move(residuals)}}, res.body());
+}
+
+void
+HttpSession::handleBatch(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Batch");
+    json queries;
+    try
+    {
+        queries = json::parse(m_req.body()).at("queries");
+        if (!queries.is_array() || queries.size() > NDT_BATCH_MAX_QUERIES)
+        {
+            throw std::invalid_argument("queries must be an array of at most " +
+                                        std::to_string(NDT_BATCH_MAX_QUERIES));
+        }
+    }
+    catch (const std::exception& ex)
     {
         res.result(http::status::bad_request);
-        res.body() = R"({"error":"Missing dpid parameter"})";
+        res.body() = json{{"error", std::string("Bad request: ") + ex.what()}}.dump();
         return;
     }
-    std::string dpidStr(target.substr(pos + 6));
+
+    // One graph snapshot and one status report for every sub-query
+    const std::shared_ptr<const GraphSnapshot> snapshot =
+        m_topologyAndFlowMonitor->getGraphSnapshot();
+    const std::shared_ptr<const DeviceStatus> status =
+        m_deviceConfigurationAndPowerManager->getDeviceStatus();
+    const Graph& graph = snapshot->graph;
+    const CsrGraph& csr = snapshot->csr;
+
+    // Switches by device name and address, built on the first device lookup
+    std::unordered_map<std::string, CsrGraph::VertexId> switchByName;
+    auto findSwitch = [&](const json& device) -> std::optional<CsrGraph::VertexId> {
+        if (device.is_number_unsigned())
+        {
+            return csr.switchByDpid(device.get<uint64_t>());
+        }
+        if (switchByName.empty())
+        {
+            for (CsrGraph::VertexId v = 0; v < csr.vertexCount(); ++v)
+            {
+                if (csr.isSwitch(v))
+                {
+                    switchByName.emplace(graph[v].deviceName, v);
+                    for (uint32_t ip : graph[v].ip)
+                    {
+                        switchByName.emplace(utils::ipToString(ip), v);
+                    }
+                }
+            }
+        }
+        auto it = switchByName.find(device.get<std::string>());
+        return it == switchByName.end() ? std::nullopt : std::optional(it->second);
+    };
+    auto metricJson = [](const DeviceMetric* metric) -> json {
+        if (!metric)
+        {
+            return nullptr;
+        }
+        switch (metric->state)
+        {
+        case DeviceMetric::State::Down:
+            return "down";
+        case DeviceMetric::State::Unsupported:
+            return "unsupported";
+        default:
+            return metric->value;
+        }
+    };
+    auto linkJson = [&](CsrGraph::EdgeId e) {
+        return json{{"total_bandwidth_bps", csr.linkBandwidth(e)},
+                    {"used_bandwidth_bps", csr.linkBandwidthUsage(e)},
+                    {"left_bandwidth_bps", csr.leftBandwidth(e)},
+                    {"utilization", csr.utilization(e)},
+                    {"source_port", csr.srcInterface(e)},
+                    {"destination_port", csr.dstInterface(e)},
+                    {"status", csr.edgeUsable(e) ? "up" : "down"}};
+    };
+
+    json results = json::array();
+    // Path sub-queries are answered together once the others are done
+    std::vector<std::pair<std::string, std::string>> pathPairs;
+    std::vector<size_t> pathSlots;
+    for (const json& query : queries)
+    {
+        json result;
+        try
+        {
+            const std::string type = query.at("type").get<std::string>();
+            if (type == "device_metrics")
+            {
+                const std::optional<CsrGraph::VertexId> v = findSwitch(query.at("device"));
+                if (!v)
+                {
+                    throw std::invalid_argument("Switch not found in topology");
+                }
+                const uint64_t dpid = csr.dpid(*v);
+                result = {{"dpid", dpid},
+                          {"name", graph[*v].deviceName},
+                          {"ip", graph[*v].ip.empty() ? "" : utils::ipToString(graph[*v].ip[0])},
+                          {"is_up", csr.vertexUsable(*v)}};
+                const std::array<std::pair<const char*, const DeviceMetrics*>, 4> metrics{{
+                    {"power", &status->power},
+                    {"cpu", &status->cpu},
+                    {"memory", &status->memory},
+                    {"temperature", &status->temperature},
+                }};
+                const json wanted = query.value("metrics", json::array());
+                for (const auto& [name, values] : metrics)
+                {
+                    if (wanted.empty() ||
+                        std::find(wanted.begin(), wanted.end(), name) != wanted.end())
+                    {
+                        result[name] = metricJson(DeviceStatus::find(*values, dpid));
+                    }
+                }
+            }
+            else if (type == "link_bandwidth")
+            {
+                const std::optional<CsrGraph::VertexId> src = findSwitch(query.at("src"));
+                const std::optional<CsrGraph::VertexId> dst = findSwitch(query.at("dst"));
+                if (!src || !dst)
+                {
+                    throw std::invalid_argument(
+                        "One or both switches could not be found in the topology.");
+                }
+                const std::optional<CsrGraph::EdgeId> forward = csr.findEdge(*src, *dst);
+                if (!forward)
+                {
+                    throw std::invalid_argument(
+                        "No direct link found between the specified switches.");
+                }
+                result = {{"src_dpid", csr.dpid(*src)},
+                          {"dst_dpid", csr.dpid(*dst)},
+                          {"forward", linkJson(*forward)}};
+                if (const CsrGraph::EdgeId reverse = csr.reverse(*forward);
+                    reverse != CsrGraph::NO_EDGE)
+                {
+                    result["reverse"] = linkJson(reverse);
+                }
+            }
+            else if (type == "switch_count")
+            {
+                const std::optional<size_t> count = m_flowLinkUsageCollector->getSwitchCount(
+                    {utils::ipStringToUint32(query.at("src_ip").get<std::string>()),
+                     utils::ipStringToUint32(query.at("dst_ip").get<std::string>())});
+                if (!count)
+                {
+                    throw std::invalid_argument("Path not found for the given IPs.");
+                }
+                result = {{"switch_count", *count}};
+            }
+            else if (type == "path")
+            {
+                pathPairs.emplace_back(query.at("src").get<std::string>(),
+                                       query.at("dst").get<std::string>());
+                pathSlots.push_back(results.size());
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown query type: " + type);
+            }
+        }
+        catch (const std::exception& ex)
+        {
+            result = {{"error", ex.what()}};
+        }
+        if (query.is_object() && query.contains("id"))
+        {
+            result["id"] = query.at("id");
+        }
+        results.push_back(std::move(result));
+    }
+    if (!pathPairs.empty())
+    {
+        json paths = m_flowLinkUsageCollector->getPathsBetweenHostsJson(pathPairs);
+        for (size_t i = 0; i < pathSlots.size(); ++i)
+        {
+            json& slot = results[pathSlots[i]];
+            for (auto& [key, value] : paths[i].items())
+            {
+                slot[key] = std::move(value);
+            }
+        }
+    }
+
+    res.body() = json{{"graph_version", snapshot->versionToken()},
+                      {"status_version", status->version},
+                      {"results", std::move(results)}}
+                     .dump();
+}
+
+void
+HttpSession::handleGetCpuUtilization(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get CPU Utilization");
+    writeEncodedBody(
+        res,
+        [this] { return m_deviceConfigurationAndPowerManager->getCpuUtilization().dump(); },
+        &responseCaches().cpuUtilization,
+        "",
+        std::to_string(m_deviceConfigurationAndPowerManager->statusVersion()));
+}
+
+void
+HttpSession::handleGetMemoryUtilization(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Memory Utilization");
+    writeEncodedBody(
+        res,
+        [this] { return m_deviceConfigurationAndPowerManager->getMemoryUtilization().dump(); },
+        &responseCaches().memoryUtilization,
+        "",
+        std::to_string(m_deviceConfigurationAndPowerManager->statusVersion()));
+}
+
+void
+HttpSession::handleInformSwitchEntered(http::response<http::string_body>& res)
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Inform Switch Entered");
+
+    std::string dpidStr = m_query.get("dpid");
     if (dpidStr.empty())
     {
         res.result(http::status::bad_request);
@@ -867,8 +2970,10 @@ HttpSession::handleInformSwitchEntered(http::response<http::string_body>& res)
         return;
     }
 
-    m_topologyAndFlowMonitor->setVertexUp(*switchVertexOpt);
-    m_topologyAndFlowMonitor->setVertexEnable(*switchVertexOpt);
+    auto transaction = m_topologyAndFlowMonitor->beginGraphTransaction();
+    transaction.setVertexUp(*switchVertexOpt, true);
+    transaction.setVertexEnabled(*switchVertexOpt, true);
+    transaction.commit();
     res.body() = R"({"status":"Switch set to up"})";
 }
 
@@ -894,32 +2999,94 @@ HttpSession::handleModifyDeviceName(http::response<http::string_body>& res)
     else
     {
         res.result(http::status::bad_request);
-        res.body() = R"({"error":"Invalid vertex_type. Must be 0 (switch) or 1 (host)."})";
+        res.body() = R"({"error":"Invalid vertex_type. Must be 0 (switch) or 1 (host)."})";
+        return;
+    }
+
+    if (!vertexOpt)
+    {
+        res.result(http::status::not_found);
+        res.body() = R"({"error":"Device not found."})";
+        return;
+    }
+
+    m_topologyAndFlowMonitor->setVertexDeviceName(vertexOpt.value(), newName);
+    res.body() = R"({"status":"Device name updated successfully."})";
+}
+
+void
+HttpSession::handleReceivedSimulationCase(http::response<http::string_body>& res)
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Recieved Simulation Case");
+
+    std::optional<uint64_t> id = m_simulationRequestManager->requestSimulation(m_req.body());
+    res.set(http::field::content_type, "application/json");
+    if (!id)
+    {
+        res.result(http::status::service_unavailable);
+        res.set(http::field::retry_after, "1");
+        res.body() = R"({"error":"Too many simulation requests queued"})";
+        return;
+    }
+    res.result(http::status::accepted);
+    res.body() = json{{"status", "queued"}, {"simulation_id", *id}}.dump();
+}
+
+void
+HttpSession::handleGetSimulationStatus(http::response<http::string_body>& res)
+{
+    const std::string text = m_query.get("id");
+    uint64_t id = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), id);
+    if (text.empty() || ec != std::errc() || ptr != text.data() + text.size())
+    {
+        res.result(http::status::bad_request);
+        res.body() = R"({"error":"Invalid parameter: id"})";
         return;
     }
 
-    if (!vertexOpt)
+    std::optional<json> status = m_simulationRequestManager->statusJson(id);
+    if (!status)
     {
         res.result(http::status::not_found);
-        res.body() = R"({"error":"Device not found."})";
+        res.body() = R"({"error":"Unknown simulation id"})";
         return;
     }
-
-    m_topologyAndFlowMonitor->setVertexDeviceName(vertexOpt.value(), newName);
-    res.body() = R"({"status":"Device name updated successfully."})";
+    res.body() = status->dump();
 }
 
 void
-HttpSession::handleReceivedSimulationCase(http::response<http::string_body>& res)
+HttpSession::handleExportSnapshot(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Recieved Simulation Case");
-
-    std::string resp = m_simulationRequestManager->requestSimulation(m_req.body());
+    NDT_LOG_DEBUG(HTTP, "Handle Export Snapshot");
+    json body = json::parse(m_req.body());
+    const int appId = body.at("app_id").get<int>();
+    std::optional<int64_t> intervalMs;
+    if (body.contains("interval_ms"))
+    {
+        intervalMs = body["interval_ms"].get<int64_t>();
+        if (*intervalMs < 0)
+        {
+            res.result(http::status::bad_request);
+            res.body() = R"({"error":"Invalid parameter: interval_ms"})";
+            return;
+        }
+    }
 
-    res.result(http::status::accepted);
-    res.set(http::field::content_type, "application/json");
-    std::string bodyStr = std::string("{\"status\":\"") + resp + "\"}";
-    res.body() = std::move(bodyStr);
+    std::optional<json> result = m_snapshotExporter->exportForApp(appId);
+    if (!result)
+    {
+        res.result(http::status::not_found);
+        res.body() = R"({"error":"Unknown app_id"})";
+        return;
+    }
+    if (intervalMs)
+    {
+        m_snapshotExporter->schedule(appId, std::chrono::milliseconds(*intervalMs));
+        (*result)["interval_ms"] =
+            *intervalMs == 0 ? 0 : std::max<int64_t>(*intervalMs, SNAPSHOT_MIN_INTERVAL_MS);
+    }
+    res.body() = result->dump();
 }
 
 void
@@ -940,8 +3107,16 @@ HttpSession::handleSimulationCompleted(http::response<http::string_body>& res)
 void
 HttpSession::handleGetStaticTopology(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Static Topology");
-    res.body() = m_topologyAndFlowMonitor->getStaticTopologyJson();
+    NDT_LOG_DEBUG(HTTP, "Handle Get Static Topology");
+    // Built from the graph's static attributes: vertices, edges and the names the index is
+    // rebuilt for. Link state and counter changes leave the index version, and so the cached
+    // raw and compressed bodies, alone.
+    writeEncodedBody(
+        res,
+        [this] { return m_topologyAndFlowMonitor->getStaticTopologyJson(); },
+        &responseCaches().staticTopology,
+        "",
+        std::to_string(m_topologyAndFlowMonitor->getIndexVersion()));
 }
 
 void
@@ -1042,7 +3217,7 @@ HttpSession::handleInputTextIntent(http::response<http::string_body>& res)
             this->m_intentTranslator->inputTextIntent(body["prompt"].get<std::string>(),
                                                       body["session"].get<std::string>());
         json result = resultPtr;
-        SPDLOG_LOGGER_DEBUG(Logger::instance(), "Intent translator result: {}", result.dump());
+        NDT_LOG_DEBUG(HTTP, "Intent translator result: {}", result.dump());
         res.result(http::status::ok);
         res.body() = result.dump();
     }
@@ -1061,62 +3236,12 @@ void
 HttpSession::handleGetNickname(http::response<http::string_body>& res)
 {
     //  Log the incoming request for debugging purposes.
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Nickname");
-
-    //  helper function to easily parse query parameters (e.g., "?dpid=123") from the request URL.
-    auto get_param = [](std::string_view target, std::string_view key) -> std::string {
-        // 1. Find the start of the query string (the '?'). If it doesn't exist, there are no
-        // parameters.
-        auto qpos = target.find('?');
-        if (qpos == std::string_view::npos)
-        {
-            return "";
-        }
-
-        // 2. Remove the path part of the URL, leaving only the query string (e.g.,
-        // "dpid=123&action=on").
-        target.remove_prefix(qpos + 1);
-
-        // 3. Loop through the remaining string, which contains key=value pairs separated by '&'.
-        while (!target.empty())
-        {
-            // 4. Find the '=' to separate the key from the value.
-            auto key_end = target.find('=');
-            if (key_end == std::string_view::npos)
-            {
-                break; // Malformed pair, stop parsing.
-            }
-
-            // 5. Check if the current key is the one we're looking for.
-            if (target.substr(0, key_end) == key)
-            {
-                // It's a match! Remove the key and '='.
-                target.remove_prefix(key_end + 1);
-
-                // Find the end of the value (the next '&').
-                auto val_end = target.find('&');
-
-                // Extract the value and return it as a new std::string.
-                return std::string(target.substr(0, val_end));
-            }
-
-            // 6. If it wasn't a match, skip to the next key-value pair.
-            auto amp_pos = target.find('&');
-            if (amp_pos == std::string_view::npos)
-            {
-                break; // No more pairs, stop parsing.
-            }
-            target.remove_prefix(amp_pos + 1);
-        }
-
-        // 7. If the loop finishes without finding the key, return an empty string.
-        return "";
-    };
+    NDT_LOG_DEBUG(HTTP, "Handle Get Nickname");
 
     // Extract all possible identifiers from the URL
-    std::string dpidStr = get_param(m_req.target(), "dpid");
-    std::string macStr = get_param(m_req.target(), "mac");
-    std::string nameStr = get_param(m_req.target(), "name");
+    std::string dpidStr = m_query.get("dpid");
+    std::string macStr = m_query.get("mac");
+    std::string nameStr = m_query.get("name");
 
     // Check that at least one identifier was provided
     if (dpidStr.empty() && macStr.empty() && nameStr.empty())
@@ -1127,7 +3252,8 @@ HttpSession::handleGetNickname(http::response<http::string_body>& res)
     }
 
     std::optional<Graph::vertex_descriptor> vertexOpt;
-    auto graph = m_topologyAndFlowMonitor->getGraph();
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
 
     // Search with a clear priority: DPID > MAC > Name
     if (!dpidStr.empty())
@@ -1217,7 +3343,8 @@ HttpSession::handleModifyNickname(http::response<http::string_body>& res)
         else if (type == "name")
         {
             std::string name = identifier.at("value").get<std::string>();
-            auto graph = m_topologyAndFlowMonitor->getGraph();
+            auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+            const Graph& graph = graphSnapshot->graph;
             for (auto vd : boost::make_iterator_range(boost::vertices(graph)))
             {
                 if (graph[vd].deviceName == name || graph[vd].nickName == name)
@@ -1259,48 +3386,46 @@ HttpSession::handleModifyNickname(http::response<http::string_body>& res)
 void
 HttpSession::handleGetTemperature(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Temperature");
-    res.body() = m_deviceConfigurationAndPowerManager->getTemperature().dump();
+    NDT_LOG_DEBUG(HTTP, "Handle Get Temperature");
+    writeEncodedBody(
+        res,
+        [this] { return m_deviceConfigurationAndPowerManager->getTemperature().dump(); },
+        &responseCaches().temperature,
+        "",
+        std::to_string(m_deviceConfigurationAndPowerManager->statusVersion()));
 }
 
 void
-HttpSession::handleGetPathSwitchCount(http::response<http::string_body>& res)
+HttpSession::handleGetPathsBetweenHosts(http::response<http::string_body>& res)
 {
-    // This helper lambda remains the same.
-    auto get_param = [](std::string_view target, std::string_view key) -> std::string {
-        auto qpos = target.find('?');
-        if (qpos == std::string_view::npos)
-        {
-            return "";
-        }
-        target.remove_prefix(qpos + 1);
-        while (!target.empty())
+    NDT_LOG_DEBUG(HTTP, "Handle Get Paths Between Hosts");
+    std::vector<std::pair<std::string, std::string>> pairs;
+    try
+    {
+        const json j = json::parse(m_req.body());
+        for (const auto& pair : j.at("pairs"))
         {
-            auto key_end = target.find('=');
-            if (key_end == std::string_view::npos)
-            {
-                break;
-            }
-            if (target.substr(0, key_end) == key)
-            {
-                target.remove_prefix(key_end + 1);
-                auto val_end = target.find('&');
-                return std::string(target.substr(0, val_end));
-            }
-            auto amp_pos = target.find('&');
-            if (amp_pos == std::string_view::npos)
-            {
-                break;
-            }
-            target.remove_prefix(amp_pos + 1);
+            pairs.emplace_back(pair.at("src").get<std::string>(),
+                               pair.at("dst").get<std::string>());
         }
-        return "";
-    };
+    }
+    catch (const std::exception& ex)
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", std::string("Bad request: ") + ex.what()}}.dump();
+        return;
+    }
+    res.body() =
+        json{{"paths", m_flowLinkUsageCollector->getPathsBetweenHostsJson(pairs)}}.dump();
+}
 
-    std::string target(m_req.target());
-    std::string srcIpStr = get_param(target, "src_ip");
-    std::string dstIpStr = get_param(target, "dst_ip");
-    json responseJson;
+void
+HttpSession::handleGetPathSwitchCount(http::response<http::string_body>& res)
+{
+    std::string srcIpStr = m_query.get("src_ip");
+    std::string dstIpStr = m_query.get("dst_ip");
+    // One object per host pair when listing them all: kept in the request's arena
+    utils::ArenaJson responseJson;
     res.set(http::field::content_type, "application/json");
 
 
@@ -1308,10 +3433,7 @@ HttpSession::handleGetPathSwitchCount(http::response<http::string_body>& res)
     if (!srcIpStr.empty() && !dstIpStr.empty())
     {
         // This is the ORIGINAL logic for fetching a single path's count.
-        SPDLOG_LOGGER_INFO(Logger::instance(),
-                           "Handle Get Path Switch Count for {} -> {}",
-                           srcIpStr,
-                           dstIpStr);
+        NDT_LOG_DEBUG(HTTP, "Handle Get Path Switch Count for {} -> {}", srcIpStr, dstIpStr);
 
         uint32_t srcIp = utils::ipStringToUint32(srcIpStr);
         uint32_t dstIp = utils::ipStringToUint32(dstIpStr);
@@ -1336,7 +3458,7 @@ HttpSession::handleGetPathSwitchCount(http::response<http::string_body>& res)
     // If parameters are missing, return all path counts.
     else
     {
-        SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get All Path Switch Counts");
+        NDT_LOG_DEBUG(HTTP, "Handle Get All Path Switch Counts");
 
         // This call is correct.
         auto allCounts = m_flowLinkUsageCollector->getAllSwitchCounts();
@@ -1344,45 +3466,57 @@ HttpSession::handleGetPathSwitchCount(http::response<http::string_body>& res)
         res.result(http::status::ok);
         responseJson["status"] = "success";
 
-        json dataArray = json::array();
+        utils::ArenaJson dataArray = utils::ArenaJson::array();
 
         // The key from the map is an "ipPair", not a "flow" struct.
         for (const auto& [ipPair, count] : allCounts)
         {
-            json flowData;
+            utils::ArenaJson flowData;
 
             // Use .first for the source IP and .second for the destination IP.
             flowData["src_ip"] = utils::ipToString(ipPair.first);
             flowData["dst_ip"] = utils::ipToString(ipPair.second);
             flowData["switch_count"] = count;
 
-            dataArray.push_back(flowData);
+            dataArray.push_back(std::move(flowData));
         }
 
-        responseJson["data"] = dataArray;
+        responseJson["data"] = std::move(dataArray);
     }
 
-    res.body() = responseJson.dump();
+    utils::dumpInto(responseJson, res.body());
 }
 
 void
 HttpSession::handleGetOpenflowCapacity(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Openflow Capacity");
-    std::ifstream file("../doc/OpenflowCapacity.json");
-    if (!file.is_open())
+    NDT_LOG_DEBUG(HTTP, "Handle Get Openflow Capacity");
+    const char* path = "../doc/OpenflowCapacity.json";
+    // The file is only read and parsed again after it was modified
+    std::error_code ec;
+    const auto modified = std::filesystem::last_write_time(path, ec);
+    if (ec)
     {
         SPDLOG_LOGGER_ERROR(Logger::instance(), "Cannot open OpenflowCapacity.json");
         return;
     }
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Load OpenflowCapacity.json");
-
-    json j;
-    file >> j;
-
-    res.result(http::status::ok);
-    res.body() = j.dump();
+    writeEncodedBody(
+        res,
+        [path] {
+            std::ifstream file(path);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Cannot open OpenflowCapacity.json");
+            }
+            SPDLOG_LOGGER_INFO(Logger::instance(), "Load OpenflowCapacity.json");
+            json j;
+            file >> j;
+            return j.dump();
+        },
+        &responseCaches().openflowCapacity,
+        "",
+        std::to_string(modified.time_since_epoch().count()));
 }
 
 void
@@ -1390,38 +3524,7 @@ HttpSession::handleSetHistoricalLoggingState(http::response<http::string_body>&
 {
     SPDLOG_LOGGER_INFO(Logger::instance(), "API request to set historical logging state");
 
-    // Helper to parse query params from a target string
-    auto get_param = [](std::string_view target, std::string_view key) -> std::string {
-        auto qpos = target.find('?');
-        if (qpos == std::string_view::npos)
-        {
-            return "";
-        }
-        target.remove_prefix(qpos + 1);
-        while (!target.empty())
-        {
-            auto key_end = target.find('=');
-            if (key_end == std::string_view::npos)
-            {
-                break;
-            }
-            if (target.substr(0, key_end) == key)
-            {
-                target.remove_prefix(key_end + 1);
-                auto val_end = target.find('&');
-                return std::string(target.substr(0, val_end));
-            }
-            auto amp_pos = target.find('&');
-            if (amp_pos == std::string_view::npos)
-            {
-                break;
-            }
-            target.remove_prefix(amp_pos + 1);
-        }
-        return "";
-    };
-
-    std::string state = get_param(m_req.target(), "state");
+    std::string state = m_query.get("state");
 
     if (state != "enable" && state != "disable")
     {
@@ -1450,40 +3553,246 @@ HttpSession::handleSetHistoricalLoggingState(http::response<http::string_body>&
              "."}}.dump();
 }
 
+void
+HttpSession::handleGetLinkHistory(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Link History");
+
+    // A switch by dpid, a host by MAC
+    auto parseEndpoint = [](const std::string& text, uint64_t& out) {
+        if (text.find(':') != std::string::npos)
+        {
+            if (text.size() != 17)
+            {
+                return false;
+            }
+            try
+            {
+                out = utils::macToUint64(text);
+            }
+            catch (const std::invalid_argument&)
+            {
+                return false;
+            }
+            return true;
+        }
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return !text.empty() && ec == std::errc() && ptr == text.data() + text.size();
+    };
+
+    RecentHistory::EdgeKey edge;
+    int64_t fromMs = 0;
+    int64_t toMs = 0;
+    RecentHistory::Resolution resolution{};
+    std::string bad = parseHistoryRange(m_query, fromMs, toMs, resolution);
+    if (!parseEndpoint(m_query.get("dst"), edge.second))
+    {
+        bad = "dst";
+    }
+    if (!parseEndpoint(m_query.get("src"), edge.first))
+    {
+        bad = "src";
+    }
+    if (!bad.empty())
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "Invalid query parameter"}, {"parameter", bad}}.dump();
+        return;
+    }
+    if (!m_historicalDataManager)
+    {
+        res.body() = R"({"status": "error", "message": "Historical data manager not available."})";
+        res.result(http::status::internal_server_error);
+        return;
+    }
+
+    res.body() =
+        historyJson(
+            m_historicalDataManager->recentHistory().edgeHistory(edge, resolution, fromMs, toMs))
+            .dump();
+}
+
+void
+HttpSession::handleGetFlowHistory(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Flow History");
+
+    auto parseNumber = [](const std::string& text, auto& out) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return !text.empty() && ec == std::errc() && ptr == text.data() + text.size();
+    };
+
+    sflow::FlowKey flow{};
+    int64_t fromMs = 0;
+    int64_t toMs = 0;
+    RecentHistory::Resolution resolution{};
+    std::string bad = parseHistoryRange(m_query, fromMs, toMs, resolution);
+    if (!parseNumber(m_query.get("protocol"), flow.protocol))
+    {
+        bad = "protocol";
+    }
+    if (!parseNumber(m_query.get("dst_port"), flow.dstPort))
+    {
+        bad = "dst_port";
+    }
+    if (!parseNumber(m_query.get("src_port"), flow.srcPort))
+    {
+        bad = "src_port";
+    }
+    try
+    {
+        flow.dstIP = utils::ipStringToUint32(m_query.get("dst_ip"));
+        flow.srcIP = utils::ipStringToUint32(m_query.get("src_ip"));
+    }
+    catch (const std::invalid_argument&)
+    {
+        bad = "src_ip/dst_ip";
+    }
+    if (!bad.empty())
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "Invalid query parameter"}, {"parameter", bad}}.dump();
+        return;
+    }
+    if (!m_historicalDataManager)
+    {
+        res.body() = R"({"status": "error", "message": "Historical data manager not available."})";
+        res.result(http::status::internal_server_error);
+        return;
+    }
+
+    res.body() =
+        historyJson(
+            m_historicalDataManager->recentHistory().flowHistory(flow, resolution, fromMs, toMs))
+            .dump();
+}
+
+void
+HttpSession::handleQueryLinkHistory(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Query Link History");
+
+    auto parseNumber = [](const std::string& text, int64_t& out) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return ec == std::errc() && ptr == text.data() + text.size();
+    };
+    auto number = [&](const char* name, int64_t& out) {
+        std::string text = m_query.get(name);
+        return text.empty() || parseNumber(text, out);
+    };
+
+    const std::string src = m_query.get("src");
+    const std::string dst = m_query.get("dst");
+    int64_t toMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+    int64_t fromMs = -1;
+    int64_t stepMs = 60'000;
+    std::string bad;
+    if (src.empty())
+    {
+        bad = "src";
+    }
+    else if (dst.empty())
+    {
+        bad = "dst";
+    }
+    else if (!number("to", toMs) || toMs < 0)
+    {
+        bad = "to";
+    }
+    else if (!number("from", fromMs) || fromMs > toMs)
+    {
+        bad = "from";
+    }
+    else if (!number("step", stepMs) || stepMs <= 0)
+    {
+        bad = "step";
+    }
+    if (fromMs < 0)
+    {
+        fromMs = std::max<int64_t>(toMs - 3'600'000, 0);
+    }
+    if (bad.empty() && (toMs - fromMs > int64_t{HISTORY_QUERY_MAX_DAYS} * 86'400'000 ||
+                        (toMs - fromMs) / stepMs >= HISTORY_QUERY_MAX_STEPS))
+    {
+        bad = "from/to/step";
+    }
+    if (!bad.empty())
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "Invalid query parameter"}, {"parameter", bad}}.dump();
+        return;
+    }
+    if (!m_historicalDataManager)
+    {
+        res.body() = R"({"status": "error", "message": "Historical data manager not available."})";
+        res.result(http::status::internal_server_error);
+        return;
+    }
+
+    res.body() = m_historicalDataManager->queryLinkHistory(src, dst, fromMs, toMs, stepMs).dump();
+}
+
 void
 HttpSession::handleGetAvgLinkUsage(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Avg Link Usage");
-    double avgLinkUsage =
-        m_topologyAndFlowMonitor->getAvgLinkUsage(m_topologyAndFlowMonitor->getGraph());
+    NDT_LOG_DEBUG(HTTP, "Handle Get Avg Link Usage");
+    res.result(http::status::ok);
+    res.body() =
+        json{{"status", "success"},
+             {"avg_link_usage", m_topologyAndFlowMonitor->getAvgLinkUsage()},
+             {"active_links", m_topologyAndFlowMonitor->getActiveFabricLinks()},
+             {"link_usage_percentiles",
+              {{"p50", m_topologyAndFlowMonitor->getLinkUsagePercentile(0.5)},
+               {"p90", m_topologyAndFlowMonitor->getLinkUsagePercentile(0.9)},
+               {"p99", m_topologyAndFlowMonitor->getLinkUsagePercentile(0.99)}}}}
+            .dump();
+}
+
+void
+HttpSession::handleGetCongestedLinks(http::response<http::string_body>& res)
+{
+    NDT_LOG_DEBUG(HTTP, "Handle Get Congested Links");
+    auto parseNumber = [](const std::string& text, auto& out) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return ec == std::errc() && ptr == text.data() + text.size();
+    };
+
+    double minUtilization = CONGESTION_HOTSPOT_PERCENT;
+    size_t k = 0;
+    std::string text = m_query.get("min_utilization");
+    if (!text.empty() && (!parseNumber(text, minUtilization) || !(minUtilization >= 0)))
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "Invalid parameter: min_utilization"}}.dump();
+        return;
+    }
+    text = m_query.get("k");
+    if (!text.empty() && !parseNumber(text, k))
+    {
+        res.result(http::status::bad_request);
+        res.body() = json{{"error", "Invalid parameter: k"}}.dump();
+        return;
+    }
+
     res.result(http::status::ok);
-    res.body() = json{{"status", "success"}, {"avg_link_usage", avgLinkUsage}}.dump();
+    res.body() = json{{"status", "success"},
+                      {"min_utilization", minUtilization},
+                      {"links", m_topologyAndFlowMonitor->getCongestedLinksJson(k, minUtilization)}}
+                     .dump();
 }
 
 void
 HttpSession::handleGetTotalInputTrafficLoadPassingASwitch(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Total Input Traffic Load Passing A Switch");
+    NDT_LOG_DEBUG(HTTP, "Handle Get Total Input Traffic Load Passing A Switch");
     auto jsonData = json::parse(m_req.body());
     if (jsonData.contains("dpid"))
     {
         auto dpid = jsonData.at("dpid").get<uint64_t>();
-        auto g = m_topologyAndFlowMonitor->getGraph();
-        uint64_t totalLoad = 0;
-        for (const auto& ed : boost::make_iterator_range(boost::edges(g)))
-        {
-            const auto& e = g[ed];
-            // TODO: Debug
-            if (e.dstDpid == dpid)
-            {
-                SPDLOG_LOGGER_INFO(Logger::instance(),
-                                   "edge {} to {} link usage {}",
-                                   e.srcDpid,
-                                   e.dstDpid,
-                                   e.linkBandwidthUsage);
-                totalLoad += e.linkBandwidthUsage;
-            }
-        }
+        auto load = m_topologyAndFlowMonitor->getSwitchLoad(dpid);
+        uint64_t totalLoad = load ? load->ingressBps : 0;
         res.body() =
             json{{"status", "success"}, {"total_input_traffic_load_bps", totalLoad}}.dump();
     }
@@ -1497,21 +3806,13 @@ HttpSession::handleGetTotalInputTrafficLoadPassingASwitch(http::response<http::s
 void
 HttpSession::handleGetNumOfFlowsPassingASwitch(http::response<http::string_body>& res)
 {
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Get Num Of Flows Passing A Switch");
+    NDT_LOG_DEBUG(HTTP, "Handle Get Num Of Flows Passing A Switch");
     auto jsonData = json::parse(m_req.body());
     if (jsonData.contains("dpid"))
     {
         auto dpid = jsonData.at("dpid").get<uint64_t>();
-        auto g = m_topologyAndFlowMonitor->getGraph();
-        int numOfFlows = 0;
-        for (const auto& ed : boost::make_iterator_range(boost::edges(g)))
-        {
-            const auto& e = g[ed];
-            if (e.dstDpid == dpid)
-            {
-                numOfFlows += e.flowSet.size();
-            }
-        }
+        auto load = m_topologyAndFlowMonitor->getSwitchLoad(dpid);
+        uint64_t numOfFlows = load ? load->flows : 0;
         res.body() = json{{"status", "success"}, {"num_of_flows", numOfFlows}}.dump();
     }
     else
@@ -1538,38 +3839,21 @@ HttpSession::handleAcquireLock(http::response<http::string_body>& res)
     SPDLOG_LOGGER_INFO(Logger::instance(), "Handle Acquire Lock");
     try
     {
-        // Use constants defined in the header for default values
-        int ttl = LockManager::DEFAULT_TTL_SECONDS;
-        std::string lockType = LockManager::DEFAULT_LOCK_TYPE_STR;
-
-        try
-        {
-            auto jsonBody = json::parse(m_req.body());
-            // If "type" or "ttl" are missing in JSON, use the defaults
-            lockType = jsonBody.value("type", LockManager::DEFAULT_LOCK_TYPE_STR);
-            ttl = jsonBody.value("ttl", LockManager::DEFAULT_TTL_SECONDS);
-        }
-        catch (...)
+        LockRequest request;
+        if (std::string bad = parseLockRequest(m_req.body(), request); !bad.empty())
         {
-            // Keep default values if JSON parsing fails
+            res.result(http::status::bad_request);
+            res.body() = json{{"error", "Invalid " + bad}}.dump();
+            return;
         }
 
-        // Pass the string to LockManager; it will handle Enum conversion internally
-        bool success = m_lockManager->acquireLock(lockType, ttl);
-
-        if (success)
-        {
-            res.result(http::status::ok);
-            res.body() = json{{"status", "locked"}, {"type", lockType}, {"ttl", ttl}}.dump();
-        }
-        else
+        std::optional<LockManager::Token> token;
+        if (request.type.empty() || m_lockManager->isValidType(request.type))
         {
-            // Locked by another app or invalid type
-            res.result(http::status::locked);
-            res.body() = json{{"error", "Lock acquisition failed"},
-                              {"detail", "System busy or invalid lock type: " + lockType}}
-                             .dump();
+            token =
+                m_lockManager->tryAcquire(request.resources, request.ttl, !request.type.empty());
         }
+        writeLockResult(res, request, token);
     }
     catch (...)
     {
@@ -1578,6 +3862,69 @@ HttpSession::handleAcquireLock(http::response<http::string_body>& res)
     }
 }
 
+bool
+HttpSession::startLockWait(const std::shared_ptr<http::response<http::string_body>>& response)
+{
+    auto request = std::make_shared<LockRequest>();
+    if (!parseLockRequest(m_req.body(), *request).empty() || request->waitMs <= 0 ||
+        (!request->type.empty() && !m_lockManager->isValidType(request->type)))
+    {
+        return false;
+    }
+
+    auto self = shared_from_this();
+    auto timer = std::make_shared<net::steady_timer>(m_socket.get_executor(),
+                                                     std::chrono::milliseconds(request->waitMs));
+    const LockManager::WaitId waitId = m_lockManager->acquireAsync(
+        request->resources,
+        request->ttl,
+        [self, response, request, timer](std::optional<LockManager::Token> token) {
+            net::post(self->m_socket.get_executor(), [self, response, request, timer, token] {
+                timer->cancel();
+                beast::error_code ignored;
+                self->m_socket.cancel(ignored); // the disconnect watch below
+                writeLockResult(*response, *request, token);
+                self->m_res = response;
+                self->writeResponse();
+            });
+        },
+        !request->type.empty());
+    if (waitId != 0)
+    {
+        timer->async_wait([self, response, request, waitId](beast::error_code ec) {
+            // Once cancelWait() fails the grant is already on its way to the session
+            if (ec || !self->m_lockManager->cancelWait(waitId))
+            {
+                return;
+            }
+            beast::error_code ignored;
+            self->m_socket.cancel(ignored);
+            writeLockResult(*response, *request, std::nullopt);
+            self->m_res = response;
+            self->writeResponse();
+        });
+        // Nothing is read while waiting, so a client that gives up is only seen by the socket
+        // turning readable with nothing to read; it then leaves the queue at once
+        m_socket.async_wait(tcp::socket::wait_read, [self, timer, waitId](beast::error_code ec) {
+            if (ec)
+            {
+                return;
+            }
+            char byte;
+            const size_t peeked =
+                self->m_socket.receive(net::buffer(&byte, 1), tcp::socket::message_peek, ec);
+            // Bytes of a pipelined request are left for the session to read afterwards
+            if ((peeked == 0 || ec) && self->m_lockManager->cancelWait(waitId))
+            {
+                NDT_LOG_DEBUG(HTTP, "Client left while waiting for a lock");
+                timer->cancel();
+                self->m_socket.close(ec);
+            }
+        });
+    }
+    return true;
+}
+
 void
 HttpSession::handleRenewLock(http::response<http::string_body>& res)
 {
@@ -1587,6 +3934,7 @@ HttpSession::handleRenewLock(http::response<http::string_body>& res)
         // Use constants defined in the header for default values
         int ttl = LockManager::DEFAULT_TTL_SECONDS;
         std::string lockType = LockManager::DEFAULT_LOCK_TYPE_STR;
+        std::optional<LockManager::Token> token;
 
         try
         {
@@ -1599,22 +3947,37 @@ HttpSession::handleRenewLock(http::response<http::string_body>& res)
             {
                 lockType = jsonBody.value("type", LockManager::DEFAULT_LOCK_TYPE_STR);
             }
+            if (jsonBody.contains("token"))
+            {
+                token = jsonBody["token"].get<LockManager::Token>();
+            }
         }
         catch (...)
         {
         }
 
-        if (m_lockManager->renew(lockType, ttl))
+        if (token ? m_lockManager->renew(*token, ttl) : m_lockManager->renew(lockType, ttl))
         {
+            json body{{"status", "renewed"}, {"ttl", std::clamp(ttl, 1, LOCK_MAX_TTL_SECONDS)}};
+            if (token)
+            {
+                body["token"] = *token;
+            }
+            else
+            {
+                body["type"] = lockType;
+            }
             res.result(http::status::ok);
-            res.body() = json{{"status", "renewed"}, {"type", lockType}, {"ttl", ttl}}.dump();
+            res.body() = body.dump();
         }
         else
         {
             res.result(http::status::precondition_failed); // 412 Precondition Failed
             res.body() =
                 json{{"error", "Renew failed"},
-                     {"detail", "Lock '" + lockType + "' is expired, not held, or invalid type"}}
+                     {"detail",
+                      token ? "Lease " + std::to_string(*token) + " is expired or not held"
+                            : "Lock '" + lockType + "' is expired, not held, or invalid type"}}
                     .dump();
         }
     }
@@ -1633,6 +3996,7 @@ HttpSession::handleReleaseLock(http::response<http::string_body>& res)
     {
         // Use constants defined in the header for default values
         std::string lockType = LockManager::DEFAULT_LOCK_TYPE_STR;
+        std::optional<LockManager::Token> token;
 
         try
         {
@@ -1641,15 +4005,34 @@ HttpSession::handleReleaseLock(http::response<http::string_body>& res)
             {
                 lockType = jsonBody.value("type", LockManager::DEFAULT_LOCK_TYPE_STR);
             }
+            if (jsonBody.contains("token"))
+            {
+                token = jsonBody["token"].get<LockManager::Token>();
+            }
         }
         catch (...)
         {
         }
 
-        m_lockManager->unlock(lockType);
-
-        res.result(http::status::ok);
-        res.body() = json{{"status", "released"}, {"type", lockType}}.dump();
+        if (!token)
+        {
+            m_lockManager->unlock(lockType);
+            res.result(http::status::ok);
+            res.body() = json{{"status", "released"}, {"type", lockType}}.dump();
+        }
+        else if (m_lockManager->release(*token))
+        {
+            res.result(http::status::ok);
+            res.body() = json{{"status", "released"}, {"token", *token}}.dump();
+        }
+        else
+        {
+            res.result(http::status::precondition_failed);
+            res.body() = json{{"error", "Release failed"},
+                              {"detail", "Lease " + std::to_string(*token) +
+                                             " is expired or not held"}}
+                             .dump();
+        }
     }
     catch (...)
     {
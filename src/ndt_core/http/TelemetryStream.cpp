@@ -0,0 +1,558 @@
+#include "ndt_core/http/TelemetryStream.hpp"
+#include "event_system/EventBus.hpp"
+#include "event_system/EventPayloads.hpp"
+#include "ndt_core/collection/FlowLinkUsageCollector.hpp"
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "utils/Logger.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include <algorithm>
+#include <boost/asio/write.hpp>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace net = boost::asio;
+using json = nlohmann::json;
+
+namespace
+{
+
+bool
+inPrefix(uint32_t ip, const std::pair<uint32_t, uint8_t>& prefix)
+{
+    uint32_t mask = utils::prefixToMaskHost(std::min<uint8_t>(prefix.second, 32));
+    return (ip & mask) == (prefix.first & mask);
+}
+
+sflow::FlowKey
+flowKeyFromJson(const json& j)
+{
+    sflow::FlowKey key{};
+    key.srcIP = j.at("src_ip").get<uint32_t>();
+    key.dstIP = j.at("dst_ip").get<uint32_t>();
+    key.srcPort = j.at("src_port").get<uint16_t>();
+    key.dstPort = j.at("dst_port").get<uint16_t>();
+    key.protocol = j.at("protocol_id").get<uint8_t>();
+    return key;
+}
+
+} // namespace
+
+bool
+TelemetryFilter::matches(const TelemetryEdgeItem& item) const
+{
+    if (dpid && item.srcDpid != *dpid && item.dstDpid != *dpid)
+    {
+        return false;
+    }
+    return !edge || (item.srcDpid == edge->first && item.dstDpid == edge->second);
+}
+
+bool
+TelemetryFilter::matches(const TelemetryFlowItem& item) const
+{
+    if ((srcPrefix && !inPrefix(item.key.srcIP, *srcPrefix)) ||
+        (dstPrefix && !inPrefix(item.key.dstIP, *dstPrefix)))
+    {
+        return false;
+    }
+    const auto& path = item.pathDpids;
+    if (dpid && std::find(path.begin(), path.end(), *dpid) == path.end())
+    {
+        return false;
+    }
+    if (edge)
+    {
+        for (size_t i = 1; i < path.size(); ++i)
+        {
+            if (path[i - 1] == edge->first && path[i] == edge->second)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+TelemetryHub::TelemetryHub(std::shared_ptr<TopologyAndFlowMonitor> topologyAndFlowMonitor,
+                           std::shared_ptr<sflow::FlowLinkUsageCollector> collector,
+                           utils::DeploymentMode mode)
+    : m_topologyAndFlowMonitor(std::move(topologyAndFlowMonitor)),
+      m_collector(std::move(collector)),
+      m_mode(mode)
+{
+}
+
+TelemetryHub::~TelemetryHub()
+{
+    stop();
+}
+
+void
+TelemetryHub::start()
+{
+    if (m_running.exchange(true))
+    {
+        return;
+    }
+    m_thread = std::thread(&TelemetryHub::run, this);
+}
+
+void
+TelemetryHub::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        if (!m_running.exchange(false))
+        {
+            return;
+        }
+    }
+    m_wakeCv.notify_all();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void
+TelemetryHub::followElephantFlows(EventBus& bus)
+{
+    std::weak_ptr<TelemetryHub> weak = weak_from_this();
+    bus.channel<ElephantFlowEventData>(EventType::ElephantFlowDetected)
+        .subscribe([weak](const ElephantFlowEventData& data) {
+            if (auto hub = weak.lock())
+            {
+                hub->queueElephantFlows(data, "detected");
+            }
+        });
+    bus.channel<ElephantFlowEventData>(EventType::ElephantFlowEnded)
+        .subscribe([weak](const ElephantFlowEventData& data) {
+            if (auto hub = weak.lock())
+            {
+                hub->queueElephantFlows(data, "ended");
+            }
+        });
+}
+
+void
+TelemetryHub::queueElephantFlows(const ElephantFlowEventData& data, const char* event)
+{
+    if (m_subscribers.load(std::memory_order_relaxed) == 0)
+    {
+        return;
+    }
+    std::vector<TelemetryFlowItem> items;
+    items.reserve(data.flows.size());
+    for (const auto& flow : data.flows)
+    {
+        TelemetryFlowItem item{flow.flowKey,
+                               {},
+                               json{{"event", event},
+                                    {"src_ip", flow.flowKey.srcIP},
+                                    {"dst_ip", flow.flowKey.dstIP},
+                                    {"src_port", flow.flowKey.srcPort},
+                                    {"dst_port", flow.flowKey.dstPort},
+                                    {"protocol_id", flow.flowKey.protocol},
+                                    {"rate_bps", flow.rateBps}}
+                                   .dump()};
+        for (const auto& [node, interface] : flow.path)
+        {
+            item.pathDpids.push_back(node);
+        }
+        items.push_back(std::move(item));
+    }
+    std::lock_guard<std::mutex> lock(m_elephantsMutex);
+    m_elephants.insert(m_elephants.end(),
+                       std::make_move_iterator(items.begin()),
+                       std::make_move_iterator(items.end()));
+}
+
+void
+TelemetryHub::subscribe()
+{
+    m_subscribers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+TelemetryHub::unsubscribe()
+{
+    m_subscribers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+uint64_t
+TelemetryHub::latestSeq() const
+{
+    std::lock_guard<std::mutex> lock(m_historyMutex);
+    return m_nextSeq - 1;
+}
+
+std::vector<std::shared_ptr<const TelemetryUpdate>>
+TelemetryHub::updatesSince(uint64_t seq, bool& gap) const
+{
+    std::vector<std::shared_ptr<const TelemetryUpdate>> updates;
+    std::lock_guard<std::mutex> lock(m_historyMutex);
+    gap = !m_history.empty() && m_history.front()->seq > seq + 1;
+    for (const auto& update : m_history)
+    {
+        if (update->seq > seq)
+        {
+            updates.push_back(update);
+        }
+    }
+    return updates;
+}
+
+json
+TelemetryHub::statsJson() const
+{
+    return json{{"subscribers", m_subscribers.load(std::memory_order_relaxed)},
+                {"updates", latestSeq()},
+                {"last_edges", m_lastEdges.load(std::memory_order_relaxed)},
+                {"last_flows", m_lastFlows.load(std::memory_order_relaxed)},
+                {"tick_ms", TELEMETRY_HUB_TICK_MS}};
+}
+
+void
+TelemetryHub::run()
+{
+    utils::ThreadRegistry::Scope thread("telemetry");
+    while (m_running.load())
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wakeCv.wait_for(lock, std::chrono::milliseconds(TELEMETRY_HUB_TICK_MS), [this] {
+                return !m_running.load();
+            });
+        }
+        if (!m_running.load())
+        {
+            break;
+        }
+        if (m_subscribers.load(std::memory_order_relaxed) == 0)
+        {
+            // Nobody listens: forget the baseline instead of diffing for no one
+            m_baselined = false;
+            std::lock_guard<std::mutex> lock(m_elephantsMutex);
+            m_elephants.clear();
+            continue;
+        }
+
+        try
+        {
+            if (!m_baselined)
+            {
+                resetBaseline();
+                continue;
+            }
+            auto update = collect();
+            if (!update)
+            {
+                continue;
+            }
+            m_lastEdges.store(update->edges.size(), std::memory_order_relaxed);
+            m_lastFlows.store(update->flows.size() + update->removedFlows.size(),
+                              std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(m_historyMutex);
+            update->seq = m_nextSeq++;
+            m_history.push_back(std::move(update));
+            if (m_history.size() > TELEMETRY_HUB_HISTORY)
+            {
+                m_history.pop_front();
+            }
+        }
+        catch (const std::exception& e)
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "Telemetry hub tick failed: {}", e.what());
+        }
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Exiting Loop of telemetry hub");
+}
+
+void
+TelemetryHub::resetBaseline()
+{
+    auto snapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    m_topologyVersion = snapshot->version;
+    m_statsEpoch = snapshot->statsEpoch;
+    m_flowsEpoch = snapshot->flowsEpoch;
+    m_flowVersion = m_collector->publishFlowVersion();
+    m_baselined = true;
+}
+
+std::shared_ptr<TelemetryUpdate>
+TelemetryHub::collect()
+{
+    auto update = std::make_shared<TelemetryUpdate>();
+
+    // Links whose counters (updateLinkInfo) or flow sets changed since the previous tick
+    auto snapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = snapshot->graph;
+    update->topologyChanged = snapshot->version != m_topologyVersion;
+    for (auto ed : boost::make_iterator_range(boost::edges(graph)))
+    {
+        const auto& e = graph[ed];
+        if (!update->topologyChanged &&
+            !snapshot->edgeChangedSince(e, m_statsEpoch, m_flowsEpoch))
+        {
+            continue;
+        }
+        const uint64_t left = m_mode == utils::DeploymentMode::MININET
+                                  ? e.leftBandwidthFromFlowSample
+                                  : e.leftBandwidth;
+        update->edges.push_back(
+            {e.srcDpid,
+             e.dstDpid,
+             e.srcInterface,
+             e.dstInterface,
+             json{{"src_dpid", e.srcDpid},
+                  {"src_interface", e.srcInterface},
+                  {"dst_dpid", e.dstDpid},
+                  {"dst_interface", e.dstInterface},
+                  {"is_up", e.isUp},
+                  {"left_link_bandwidth_bps", left},
+                  {"link_bandwidth_usage_bps", e.linkBandwidthUsage},
+                  {"link_bandwidth_utilization_percent", e.linkBandwidthUtilization},
+                  {"flow_count", e.flowSet.size()}}
+                 .dump()});
+    }
+    m_topologyVersion = snapshot->version;
+    m_statsEpoch = snapshot->statsEpoch;
+    m_flowsEpoch = snapshot->flowsEpoch;
+
+    // Flows re-rated by the once-per-second tick, new or purged since the previous tick
+    if (m_collector->publishFlowVersion() != m_flowVersion)
+    {
+        json delta = m_collector->getFlowInfoDeltaJson(m_flowVersion);
+        m_flowVersion = delta.at("version").get<uint64_t>();
+        update->flowsFull = delta.at("full").get<bool>();
+        for (const auto& flow : delta.at("flows"))
+        {
+            TelemetryFlowItem item{flowKeyFromJson(flow), {}, flow.dump()};
+            for (const auto& hop : flow.at("path"))
+            {
+                item.pathDpids.push_back(hop.at("node").get<uint64_t>());
+            }
+            update->flows.push_back(std::move(item));
+        }
+        for (const auto& removed : delta.at("removed"))
+        {
+            update->removedFlows.push_back({flowKeyFromJson(removed), {}, removed.dump()});
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_elephantsMutex);
+        update->elephantFlows.swap(m_elephants);
+    }
+
+    if (!update->topologyChanged && !update->flowsFull && update->edges.empty() &&
+        update->flows.empty() && update->removedFlows.empty() && update->elephantFlows.empty())
+    {
+        return nullptr;
+    }
+    return update;
+}
+
+TelemetryStreamSession::TelemetryStreamSession(boost::asio::ip::tcp::socket socket,
+                                               AdmissionControl::ConnectionSlot slot,
+                                               std::shared_ptr<TelemetryHub> hub,
+                                               TelemetryFilter filter,
+                                               std::chrono::milliseconds interval)
+    : m_socket(std::move(socket)),
+      m_slot(std::move(slot)),
+      m_timer(m_socket.get_executor()),
+      m_hub(std::move(hub)),
+      m_filter(std::move(filter)),
+      m_interval(std::max(interval, std::chrono::milliseconds(TELEMETRY_STREAM_MIN_INTERVAL_MS)))
+{
+    m_hub->subscribe();
+}
+
+TelemetryStreamSession::~TelemetryStreamSession()
+{
+    m_hub->unsubscribe();
+}
+
+void
+TelemetryStreamSession::start()
+{
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Telemetry stream started, interval {} ms",
+                       m_interval.count());
+    m_seq = m_hub->latestSeq();
+    // No Content-Length: the event stream runs until the connection closes
+    write("HTTP/1.1 200 OK\r\n"
+          "Server: ndt-server\r\n"
+          "Content-Type: text/event-stream\r\n"
+          "Cache-Control: no-cache\r\n"
+          "Access-Control-Allow-Origin: *\r\n"
+          "Connection: close\r\n"
+          "\r\n");
+}
+
+void
+TelemetryStreamSession::scheduleTick()
+{
+    m_timer.expires_after(m_interval);
+    m_timer.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+        if (!ec)
+        {
+            self->onTick();
+        }
+    });
+}
+
+void
+TelemetryStreamSession::onTick()
+{
+    bool gap = false;
+    auto updates = m_hub->updatesSince(m_seq, gap);
+    if (gap)
+    {
+        m_seq = updates.empty() ? m_hub->latestSeq() : updates.back()->seq;
+        write("event: resync\ndata: {}\n\n");
+        return;
+    }
+    if (!updates.empty())
+    {
+        m_seq = updates.back()->seq;
+        m_out.clear();
+        if (appendEvent(updates))
+        {
+            write(std::move(m_out));
+            return;
+        }
+    }
+    if (std::chrono::steady_clock::now() - m_lastWrite >=
+        std::chrono::milliseconds(TELEMETRY_STREAM_HEARTBEAT_MS))
+    {
+        // Also how a closed connection is noticed while nothing changes
+        write(": heartbeat\n\n");
+        return;
+    }
+    scheduleTick();
+}
+
+void
+TelemetryStreamSession::write(std::string data)
+{
+    m_out = std::move(data);
+    net::async_write(m_socket,
+                     net::buffer(m_out),
+                     [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+                         if (ec)
+                         {
+                             SPDLOG_LOGGER_INFO(Logger::instance(),
+                                                "Telemetry stream closed: {}",
+                                                ec.message());
+                             boost::system::error_code ignored;
+                             self->m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both,
+                                                     ignored);
+                             return;
+                         }
+                         self->m_lastWrite = std::chrono::steady_clock::now();
+                         self->scheduleTick();
+                     });
+}
+
+bool
+TelemetryStreamSession::appendEvent(
+    const std::vector<std::shared_ptr<const TelemetryUpdate>>& updates)
+{
+    // Newest state of each link and flow over the updates; a flow is either upserted or
+    // removed depending on what happened to it last
+    using EdgeId = std::tuple<uint64_t, uint32_t, uint64_t, uint32_t>;
+    std::map<EdgeId, const TelemetryEdgeItem*> edges;
+    std::unordered_map<sflow::FlowKey, std::pair<const TelemetryFlowItem*, bool>,
+                       sflow::FlowKeyHash>
+        flows;
+    std::vector<const std::string*> elephantJson;
+    bool topologyChanged = false;
+    bool flowsFull = false;
+    for (const auto& update : updates)
+    {
+        topologyChanged |= update->topologyChanged;
+        if (update->flowsFull)
+        {
+            flowsFull = true;
+            flows.clear();
+        }
+        for (const auto& edge : update->edges)
+        {
+            if (m_filter.matches(edge))
+            {
+                edges[{edge.srcDpid, edge.srcInterface, edge.dstDpid, edge.dstInterface}] = &edge;
+            }
+        }
+        for (const auto& flow : update->flows)
+        {
+            if (m_filter.matches(flow))
+            {
+                flows[flow.key] = {&flow, false};
+            }
+        }
+        for (const auto& flow : update->removedFlows)
+        {
+            // The path of a purged flow is gone, so only the prefixes can filter it out
+            if ((!m_filter.srcPrefix || inPrefix(flow.key.srcIP, *m_filter.srcPrefix)) &&
+                (!m_filter.dstPrefix || inPrefix(flow.key.dstIP, *m_filter.dstPrefix)))
+            {
+                flows[flow.key] = {&flow, true};
+            }
+        }
+        // Transitions are events rather than state: every one is kept, in order
+        for (const auto& flow : update->elephantFlows)
+        {
+            if (m_filter.matches(flow))
+            {
+                elephantJson.push_back(&flow.json);
+            }
+        }
+    }
+    if (!topologyChanged && !flowsFull && edges.empty() && flows.empty() && elephantJson.empty())
+    {
+        return false;
+    }
+
+    auto appendList = [this](const char* name, auto&& items) {
+        m_out += ",\"";
+        m_out += name;
+        m_out += "\":[";
+        bool first = true;
+        for (const std::string* json : items)
+        {
+            if (!first)
+            {
+                m_out += ',';
+            }
+            first = false;
+            m_out += *json;
+        }
+        m_out += ']';
+    };
+    std::vector<const std::string*> edgeJson;
+    std::vector<const std::string*> flowJson;
+    std::vector<const std::string*> removedJson;
+    for (const auto& [id, edge] : edges)
+    {
+        edgeJson.push_back(&edge->json);
+    }
+    for (const auto& [key, entry] : flows)
+    {
+        (entry.second ? removedJson : flowJson).push_back(&entry.first->json);
+    }
+
+    const uint64_t seq = updates.back()->seq;
+    m_out += "id: " + std::to_string(seq) + "\nevent: telemetry\ndata: {\"seq\":" +
+             std::to_string(seq) + ",\"topology_changed\":" +
+             (topologyChanged ? "true" : "false") +
+             ",\"flows_full\":" + (flowsFull ? "true" : "false");
+    appendList("edges", edgeJson);
+    appendList("flows", flowJson);
+    appendList("removed_flows", removedJson);
+    appendList("elephant_flows", elephantJson);
+    m_out += "}\n\n";
+    return true;
+}
@@ -1,8 +1,110 @@
 #include "ndt_core/intent_translator/IntentTranslator.hpp"
 #include "ndt_core/intent_translator/LLMResponseTypes.hpp"
+#include "utils/FanOut.hpp"
 #include "utils/Logger.hpp"
 #include "utils/Utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <exception>
 #include <iostream>
+#include <optional>
+#include <vector>
+
+namespace
+{
+
+// Tasks that only look at the topology, counters or device state
+bool
+isReadOnlyTask(llmResponse::TaskType type)
+{
+    switch (type)
+    {
+        case llmResponse::TaskType::GET_TOP_K_FLOWS:
+        case llmResponse::TaskType::GET_SWITCH_CPU_UTILIZATION:
+        case llmResponse::TaskType::GET_TOTAL_POWER_CONSUMPTION:
+        case llmResponse::TaskType::GET_A_SWITCH_CPU_UTILIZATION:
+        case llmResponse::TaskType::GET_A_SWITCH_POWER_CONSUMPTION:
+        case llmResponse::TaskType::GET_A_LINK_BANDWIDTH_UTILIZATION:
+        case llmResponse::TaskType::GET_TOP_K_CONGESTED_LINKS:
+        case llmResponse::TaskType::GET_TOP_K_BANDWIDTH_USERS:
+        case llmResponse::TaskType::GET_PATH:
+        case llmResponse::TaskType::GET_ACTIVE_FLOW_COUNT:
+        case llmResponse::TaskType::GET_FLOW_ENTRY_COUNT:
+        case llmResponse::TaskType::GET_FLOW_ENTRIES:
+        case llmResponse::TaskType::GET_NETWORK_TOPOLOGY:
+        case llmResponse::TaskType::GET_ALL_HOSTS:
+        case llmResponse::TaskType::GET_LINK_LATENCY:
+        case llmResponse::TaskType::GET_PACKET_LOSS_RATE:
+        case llmResponse::TaskType::GET_SWITCH_PORTS:
+        case llmResponse::TaskType::GET_SWITCH_MEMORY_UTILIZATION:
+        case llmResponse::TaskType::GET_SWITCH_TEMPERATURE:
+        case llmResponse::TaskType::GET_PATH_SWITCH_COUNT:
+        case llmResponse::TaskType::GET_SWITCH_CAPABILITIES:
+        case llmResponse::TaskType::GET_DEVICE_UPTIME:
+        case llmResponse::TaskType::PING_HOST:
+        case llmResponse::TaskType::TRACEROUTE_HOST:
+        case llmResponse::TaskType::GET_ARP_TABLE:
+        case llmResponse::TaskType::GET_MAC_TABLE:
+        case llmResponse::TaskType::GET_PORT_STATISTICS:
+        case llmResponse::TaskType::GET_DEVICE_LOGS:
+        case llmResponse::TaskType::GET_DEVICE_HEALTH:
+            return true;
+        default:
+            return false;
+    }
+}
+
+template <llmResponse::TaskType T>
+std::optional<std::string>
+deviceNameOf(const llmResponse::Task* task)
+{
+    return llmResponse::taskAs<T>(*task).deviceName;
+}
+
+// The single device a mutating task changes, or nullopt if it may touch several (blocking a
+// host, rerouting a flow, toggling logging...)
+std::optional<std::string>
+mutatedDevice(const llmResponse::Task* task)
+{
+    using namespace llmResponse;
+    switch (task->type)
+    {
+        case TaskType::DISABLE_SWITCH:
+            return deviceNameOf<TaskType::DISABLE_SWITCH>(task);
+        case TaskType::ENABLE_SWITCH:
+            return deviceNameOf<TaskType::ENABLE_SWITCH>(task);
+        case TaskType::POWEROFF_SWITCH:
+            return deviceNameOf<TaskType::POWEROFF_SWITCH>(task);
+        case TaskType::POWERON_SWITCH:
+            return deviceNameOf<TaskType::POWERON_SWITCH>(task);
+        case TaskType::INSTALL_FLOW_ENTRY:
+            return deviceNameOf<TaskType::INSTALL_FLOW_ENTRY>(task);
+        case TaskType::MODIFY_FLOW_ENTRY:
+            return deviceNameOf<TaskType::MODIFY_FLOW_ENTRY>(task);
+        case TaskType::DELETE_FLOW_ENTRY:
+            return deviceNameOf<TaskType::DELETE_FLOW_ENTRY>(task);
+        case TaskType::SET_SWITCH_POWER_STATE:
+            return deviceNameOf<TaskType::SET_SWITCH_POWER_STATE>(task);
+        case TaskType::SET_DEVICE_NICKNAME:
+            return deviceNameOf<TaskType::SET_DEVICE_NICKNAME>(task);
+        case TaskType::INSTALL_GROUP_ENTRY:
+            return deviceNameOf<TaskType::INSTALL_GROUP_ENTRY>(task);
+        case TaskType::INSTALL_METER_ENTRY:
+            return deviceNameOf<TaskType::INSTALL_METER_ENTRY>(task);
+        case TaskType::RESTART_DEVICE:
+            return deviceNameOf<TaskType::RESTART_DEVICE>(task);
+        case TaskType::BACKUP_CONFIGURATION:
+            return deviceNameOf<TaskType::BACKUP_CONFIGURATION>(task);
+        case TaskType::RESTORE_CONFIGURATION:
+            return deviceNameOf<TaskType::RESTORE_CONFIGURATION>(task);
+        case TaskType::SET_PORT_STATUS:
+            return deviceNameOf<TaskType::SET_PORT_STATUS>(task);
+        default:
+            return std::nullopt;
+    }
+}
+
+} // namespace
 
 IntentTranslator::IntentTranslator(
     std::shared_ptr<DeviceConfigurationAndPowerManager> deviceConfigManager,
@@ -36,6 +138,22 @@ IntentTranslator::inputTextIntent(
 {
     SPDLOG_LOGGER_INFO(Logger::instance(), "Input text intent: {}", inputText);
 
+    const std::string cacheKey = normalizeIntent(inputText);
+    if (auto cached = this->lookupCachedAnswer(cacheKey))
+    {
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Intent cache hit, skipping the answer agent: {}", cacheKey);
+        std::unique_ptr<llmResponse::LLMResponse> cachedAns = *cached;
+        llmResponse::Answer* ans = dynamic_cast<llmResponse::Answer*>(cachedAns.get());
+        if (ans != nullptr)
+        {
+            this->performTasks(ans->tasks);
+            return cachedAns;
+        }
+    }
+    // A follow-up is read in the light of the conversation, so only the first message of a
+    // session maps its text to its tasks on its own
+    const bool standalone = !this->m_answerAgent->hasSession(sessionId);
+
     int maxRetryCount = 5;
     std::unique_ptr<llmResponse::LLMResponse> result;
     while (maxRetryCount--)
@@ -73,20 +191,11 @@ IntentTranslator::inputTextIntent(
         throw std::runtime_error("Failed to cast final answer to Answer type");
     }
 
-    for (const auto& task: ans->tasks)
+    if (standalone)
     {
-        try
-        {
-            std::string res = this->performTask(task.get());
-            task->result = res;
-        }
-        catch (const std::exception &e)
-        {
-            SPDLOG_LOGGER_ERROR(Logger::instance(), "Failed to perform task: {}, error: {}", 
-                llmResponse::taskTypeToString(task->type), e.what());
-            throw;
-        }
+        this->cacheAnswer(cacheKey, *ans);
     }
+    this->performTasks(ans->tasks);
 
     //this->cleanSession(sessionId);
 
@@ -181,8 +290,8 @@ IntentTranslator::performAgentsNegotiation(const std::string &sessionId)
     return historyDiscussion.back().second["msg"];
 }
 
-optional<std::string>
-IntentTranslator::getSwitchIpByName(const std::string &switchName)
+optional<uint32_t>
+IntentTranslator::findSwitchIpByName(const std::string &switchName)
 {
     auto vdOpt = this->m_topologyAndFlowMonitor->findVertexByMininetBridgeName(switchName);
     if (!vdOpt.has_value())
@@ -190,14 +299,192 @@ IntentTranslator::getSwitchIpByName(const std::string &switchName)
         SPDLOG_LOGGER_WARN(Logger::instance(), "Switch {} not found in topology", switchName);
         return std::nullopt;
     }
-    auto graph = this->m_topologyAndFlowMonitor->getGraph();
+    auto graphSnapshot = this->m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
     auto& vertex = graph[vdOpt.value()];
     if (vertex.vertexType != VertexType::SWITCH)
     {
         SPDLOG_LOGGER_WARN(Logger::instance(), "Vertex {} is not a switch", switchName);
         return std::nullopt;
     }
-    return utils::ipToString(vertex.ip[0]);
+    return vertex.ip[0];
+}
+
+optional<std::string>
+IntentTranslator::getSwitchIpByName(const std::string &switchName)
+{
+    auto ipOpt = this->findSwitchIpByName(switchName);
+    if (!ipOpt.has_value())
+    {
+        return std::nullopt;
+    }
+    return utils::ipToString(*ipOpt);
+}
+
+optional<uint64_t>
+IntentTranslator::getSwitchDpidByName(const std::string &switchName)
+{
+    auto ipOpt = this->findSwitchIpByName(switchName);
+    if (!ipOpt.has_value())
+    {
+        return std::nullopt;
+    }
+    return this->m_topologyAndFlowMonitor->getSwitchDpidByIp(*ipOpt);
+}
+
+std::string
+IntentTranslator::normalizeIntent(const std::string &inputText)
+{
+    // Case, runs of white space and trailing punctuation do not change what is asked
+    std::string key;
+    key.reserve(inputText.size());
+    bool space = false;
+    for (unsigned char c : inputText)
+    {
+        if (std::isspace(c))
+        {
+            space = !key.empty();
+            continue;
+        }
+        if (space)
+        {
+            key += ' ';
+            space = false;
+        }
+        key += static_cast<char>(std::tolower(c));
+    }
+    while (!key.empty() && (key.back() == '?' || key.back() == '.' || key.back() == '!'))
+    {
+        key.pop_back();
+    }
+    return key;
+}
+
+std::optional<json>
+IntentTranslator::lookupCachedAnswer(const std::string &key)
+{
+    std::lock_guard lock(this->m_intentCacheMutex);
+    auto it = this->m_intentCache.find(key);
+    if (it == this->m_intentCache.end())
+    {
+        return std::nullopt;
+    }
+    if (it->second.expiresAt <= std::chrono::steady_clock::now())
+    {
+        this->m_intentCache.erase(it);
+        return std::nullopt;
+    }
+    return it->second.answer;
+}
+
+void
+IntentTranslator::cacheAnswer(const std::string &key, const llmResponse::Answer &answer)
+{
+    if (key.empty() || answer.tasks.empty())
+    {
+        return;
+    }
+    for (const auto& task : answer.tasks)
+    {
+        // Mutations must be asked for, and confirmed, each time
+        if (!isReadOnlyTask(task->type))
+        {
+            return;
+        }
+    }
+    json answerJson = answer;
+
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard lock(this->m_intentCacheMutex);
+    if (this->m_intentCache.size() >= INTENT_CACHE_MAX_ENTRIES && !this->m_intentCache.count(key))
+    {
+        std::erase_if(this->m_intentCache, [now](const auto& entry) { return entry.second.expiresAt <= now; });
+    }
+    if (this->m_intentCache.size() >= INTENT_CACHE_MAX_ENTRIES && !this->m_intentCache.count(key))
+    {
+        auto oldest = std::min_element(this->m_intentCache.begin(), this->m_intentCache.end(),
+            [](const auto& a, const auto& b) { return a.second.expiresAt < b.second.expiresAt; });
+        this->m_intentCache.erase(oldest);
+    }
+    this->m_intentCache[key] = {std::move(answerJson), now + std::chrono::milliseconds(INTENT_CACHE_TTL_MS)};
+}
+
+void
+IntentTranslator::performTasks(const std::vector<std::unique_ptr<llmResponse::Task>>& tasks)
+{
+    // Split the list into stages run one after the other. A stage holds either reads, each
+    // in a lane of its own, or mutations with one lane per device, so a read never overlaps
+    // a mutation listed before or after it, and the changes to one device keep their order.
+    // A mutation whose device is not known gets a stage to itself.
+    struct Stage
+    {
+        bool readOnly = true;
+        bool open = true;                 // later tasks may still join it
+        std::vector<std::string> devices; // device of each lane, mutating stages only
+        std::vector<std::vector<llmResponse::Task*>> lanes;
+    };
+    std::vector<Stage> stages;
+    for (const auto& task : tasks)
+    {
+        const bool readOnly = isReadOnlyTask(task->type);
+        const std::optional<std::string> device =
+            readOnly ? std::nullopt : mutatedDevice(task.get());
+        const bool exclusive = !readOnly && !device.has_value();
+
+        if (stages.empty() || !stages.back().open || stages.back().readOnly != readOnly ||
+            exclusive)
+        {
+            stages.emplace_back();
+            stages.back().readOnly = readOnly;
+            stages.back().open = !exclusive;
+        }
+        Stage& stage = stages.back();
+        if (readOnly || exclusive)
+        {
+            stage.lanes.push_back({task.get()});
+            continue;
+        }
+        size_t lane = 0;
+        while (lane < stage.devices.size() && stage.devices[lane] != *device)
+        {
+            ++lane;
+        }
+        if (lane == stage.devices.size())
+        {
+            stage.devices.push_back(*device);
+            stage.lanes.emplace_back();
+        }
+        stage.lanes[lane].push_back(task.get());
+    }
+
+    for (const Stage& stage : stages)
+    {
+        std::vector<std::exception_ptr> errors(stage.lanes.size());
+        utils::fanOut("performTasks", stage.lanes.size(), [&](size_t lane) {
+            for (llmResponse::Task* task : stage.lanes[lane])
+            {
+                try
+                {
+                    task->result = this->performTask(task);
+                }
+                catch (const std::exception &e)
+                {
+                    SPDLOG_LOGGER_ERROR(Logger::instance(), "Failed to perform task: {}, error: {}",
+                        llmResponse::taskTypeToString(task->type), e.what());
+                    // Later changes to the same device assumed this one succeeded
+                    errors[lane] = std::current_exception();
+                    return;
+                }
+            }
+        });
+        for (const auto& error : errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    }
 }
 
 std::string
@@ -208,29 +495,29 @@ IntentTranslator::performTask(llmResponse::Task* task)
     {
         case llmResponse::TaskType::DISABLE_SWITCH:
         {
-            llmResponse::DisableSwitchTask* disableTask = dynamic_cast<llmResponse::DisableSwitchTask*>(task);
-            auto deviceIpOpt = this->getSwitchIpByName(disableTask->deviceName);
-            if (deviceIpOpt.has_value())
+            auto* disableTask = &llmResponse::taskAs<llmResponse::TaskType::DISABLE_SWITCH>(*task);
+            auto dpidOpt = this->getSwitchDpidByName(disableTask->deviceName);
+            if (dpidOpt.has_value())
             {
-                uint64_t dpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[deviceIpOpt.value()];
+                uint64_t dpid = dpidOpt.value();
                 this->m_topologyAndFlowMonitor->disableSwitchAndEdges(dpid);
             }
             break;
         }
         case llmResponse::TaskType::ENABLE_SWITCH:
         {
-            llmResponse::EnableSwitchTask* enableTask = dynamic_cast<llmResponse::EnableSwitchTask*>(task);
-            auto deviceIpOpt = this->getSwitchIpByName(enableTask->deviceName);
-            if (deviceIpOpt.has_value())
+            auto* enableTask = &llmResponse::taskAs<llmResponse::TaskType::ENABLE_SWITCH>(*task);
+            auto dpidOpt = this->getSwitchDpidByName(enableTask->deviceName);
+            if (dpidOpt.has_value())
             {
-                uint64_t dpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[deviceIpOpt.value()];
+                uint64_t dpid = dpidOpt.value();
                 this->m_topologyAndFlowMonitor->enableSwitchAndEdges(dpid);
             }
             break;
         }
         case llmResponse::TaskType::POWEROFF_SWITCH:
         {
-            llmResponse::PowerOffSwitchTask* poweroffTask = dynamic_cast<llmResponse::PowerOffSwitchTask*>(task);
+            auto* poweroffTask = &llmResponse::taskAs<llmResponse::TaskType::POWEROFF_SWITCH>(*task);
             auto deviceIpOpt = this->getSwitchIpByName(poweroffTask->deviceName);
             if (deviceIpOpt.has_value())
             {
@@ -241,7 +528,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::POWERON_SWITCH:
         {
-            llmResponse::PowerOnSwitchTask* powerOnTask = dynamic_cast<llmResponse::PowerOnSwitchTask*>(task);
+            auto* powerOnTask = &llmResponse::taskAs<llmResponse::TaskType::POWERON_SWITCH>(*task);
             auto deviceIpOpt = this->getSwitchIpByName(powerOnTask->deviceName);
             if (deviceIpOpt.has_value())
             {
@@ -251,11 +538,11 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::INSTALL_FLOW_ENTRY:
         {
-            llmResponse::InstallFlowEntryTask* installTask = dynamic_cast<llmResponse::InstallFlowEntryTask*>(task);
-            auto deviceIpOpt = this->getSwitchIpByName(installTask->deviceName);
-            if (deviceIpOpt.has_value())
+            auto* installTask = &llmResponse::taskAs<llmResponse::TaskType::INSTALL_FLOW_ENTRY>(*task);
+            auto dpidOpt = this->getSwitchDpidByName(installTask->deviceName);
+            if (dpidOpt.has_value())
             {
-                uint64_t dpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[deviceIpOpt.value()];
+                uint64_t dpid = dpidOpt.value();
                 json installTaskJson = *installTask;
                 json match = installTaskJson["parameters"]["match"];
 
@@ -274,11 +561,11 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::MODIFY_FLOW_ENTRY:
         {
-            llmResponse::ModifyFlowEntryTask* modifyTask = dynamic_cast<llmResponse::ModifyFlowEntryTask*>(task);
-            auto deviceIpOpt = this->getSwitchIpByName(modifyTask->deviceName);
-            if (deviceIpOpt.has_value())
+            auto* modifyTask = &llmResponse::taskAs<llmResponse::TaskType::MODIFY_FLOW_ENTRY>(*task);
+            auto dpidOpt = this->getSwitchDpidByName(modifyTask->deviceName);
+            if (dpidOpt.has_value())
             {
-                uint64_t dpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[deviceIpOpt.value()];
+                uint64_t dpid = dpidOpt.value();
                 json modifyTaskJson = *modifyTask;
                 json match = modifyTaskJson["parameters"]["match"];
 
@@ -297,11 +584,11 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::DELETE_FLOW_ENTRY:
         {
-            llmResponse::DeleteFlowEntryTask* deleteTask = dynamic_cast<llmResponse::DeleteFlowEntryTask*>(task);
-            auto deviceIpOpt = this->getSwitchIpByName(deleteTask->deviceName);
-            if (deviceIpOpt.has_value())
+            auto* deleteTask = &llmResponse::taskAs<llmResponse::TaskType::DELETE_FLOW_ENTRY>(*task);
+            auto dpidOpt = this->getSwitchDpidByName(deleteTask->deviceName);
+            if (dpidOpt.has_value())
             {
-                uint64_t dpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[deviceIpOpt.value()];
+                uint64_t dpid = dpidOpt.value();
                 json deleteTaskJson = *deleteTask;
                 this->m_flowRoutingManager->deleteAnEntry(dpid, deleteTaskJson["parameters"]["match"]);
             }
@@ -309,7 +596,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::GET_TOP_K_FLOWS:
         {
-            llmResponse::GetTopKFlowsTask* getTopKFlowTask = dynamic_cast<llmResponse::GetTopKFlowsTask*>(task);
+            auto* getTopKFlowTask = &llmResponse::taskAs<llmResponse::TaskType::GET_TOP_K_FLOWS>(*task);
             json topKFlows = this->m_flowLinkUsageCollector->getTopKFlowInfoJson(getTopKFlowTask->k);
             return topKFlows.dump();
         }
@@ -326,7 +613,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::GET_A_SWITCH_CPU_UTILIZATION: 
         {
-            llmResponse::GetASwitchCpuUtilizationTask* getSingleSwitchCpuReport = dynamic_cast<llmResponse:: GetASwitchCpuUtilizationTask*>(task);
+            auto* getSingleSwitchCpuReport = &llmResponse::taskAs<llmResponse::TaskType::GET_A_SWITCH_CPU_UTILIZATION>(*task);
             json cpuSingleSwitchConsumption;
             auto deviceIpOpt = this->getSwitchIpByName(getSingleSwitchCpuReport->deviceName);
             if (deviceIpOpt.has_value()){
@@ -337,7 +624,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::GET_A_SWITCH_POWER_CONSUMPTION: 
         {
-            llmResponse::GetASwitchPowerConsumptionTask* getASwitchPowerConsumptionTask = dynamic_cast<llmResponse::GetASwitchPowerConsumptionTask*>(task);
+            auto* getASwitchPowerConsumptionTask = &llmResponse::taskAs<llmResponse::TaskType::GET_A_SWITCH_POWER_CONSUMPTION>(*task);
             json powerSingleSwitchConsumption;
             auto deviceIpOpt = this->getSwitchIpByName(getASwitchPowerConsumptionTask->deviceName);
             if (deviceIpOpt.has_value()){
@@ -348,8 +635,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
         case llmResponse::TaskType::GET_A_LINK_BANDWIDTH_UTILIZATION:
         {   
             
-            // 1. Safely cast the generic task to our specific task type
-            llmResponse::GetALinkBandwidthUtilizationTask*  getLinkBandwidthTask = dynamic_cast<llmResponse::GetALinkBandwidthUtilizationTask*>(task);
+            auto* getLinkBandwidthTask = &llmResponse::taskAs<llmResponse::TaskType::GET_A_LINK_BANDWIDTH_UTILIZATION>(*task);
             json linkBandwidth; // Default to an empty JSON object
 
             // 2. Get the DPIDs for both device names provided in the task
@@ -381,52 +667,30 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::GET_TOP_K_CONGESTED_LINKS:
         {
-            // 1. Safely cast the generic task to our specific task type
-            llmResponse::GetTopKCongestedLinksTask* getTopKLinksTask = 
-                dynamic_cast<llmResponse::GetTopKCongestedLinksTask*>(task);
-            
-            // 2. Check if the cast was successful
-            if (!getTopKLinksTask)
-            {
-                SPDLOG_LOGGER_ERROR(Logger::instance(), "Task cast to GetTopKCongestedLinksTask failed.");
-                return {"error:" "Internal server error during task processing."};
-            }
+            auto* getTopKLinksTask = &llmResponse::taskAs<llmResponse::TaskType::GET_TOP_K_CONGESTED_LINKS>(*task);
 
-            // 3. Call the manager to get the top K congested links as a JSON object
+            // Call the manager to get the top K congested links as a JSON object
             json topKLinks = this->m_topologyAndFlowMonitor->getTopKCongestedLinksJson(getTopKLinksTask->k);
 
-            // 4. Return the resulting JSON as a string
+            // Return the resulting JSON as a string
             return topKLinks.dump();
 
         }
         case llmResponse::TaskType::GET_TOP_K_BANDWIDTH_USERS: 
         {
-            // 1. Safely cast the generic task to our specific task type.
-            auto* getTopKUsersTask =
-                dynamic_cast<llmResponse::GetTopKBandwidthUsersTask*>(task);
-            
-            if (!getTopKUsersTask)
-            {
-                SPDLOG_LOGGER_ERROR(Logger::instance(), "Task cast to GetTopKBandwidthUsersTask failed.");
-                return {"error:" "Internal server error during task processing."};
-            }
+            auto* getTopKUsersTask = &llmResponse::taskAs<llmResponse::TaskType::GET_TOP_K_BANDWIDTH_USERS>(*task);
 
-            // 2. Call the collector to get the top K flows. The source IPs in these
+            // Call the collector to get the top K flows. The source IPs in these
             //    flows represent the top bandwidth users.
             json topKUsers = this->m_flowLinkUsageCollector->getTopKFlowInfoJson(getTopKUsersTask->k);
 
-            // 3. Return the resulting JSON as a string.
+            // Return the resulting JSON as a string.
             return topKUsers.dump();
 
         }    
         case llmResponse::TaskType::GET_PATH:
         {
-            llmResponse::GetPathTask* getPathTask = dynamic_cast<llmResponse::GetPathTask*>(task);
-            if (!getPathTask)
-            {
-                SPDLOG_LOGGER_ERROR(Logger::instance(), "Task cast to GetPathTask failed.");
-                return {"error" "Internal server error during task processing."};
-            }
+            auto* getPathTask = &llmResponse::taskAs<llmResponse::TaskType::GET_PATH>(*task);
 
             json path = this->m_flowLinkUsageCollector->getPathBetweenHostsJson(
                 getPathTask->srcHostName,
@@ -438,9 +702,9 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::GET_ACTIVE_FLOW_COUNT:
         {
-            // Get the current flow table from the collector
-            auto flowTable = this->m_flowLinkUsageCollector->getFlowInfoTable();
-            size_t flowCount = flowTable.size();
+            // Count the flows in place instead of copying the table
+            size_t flowCount = this->m_flowLinkUsageCollector->visitFlows(
+                {}, [](const sflow::FlowKey&, const sflow::FlowInfo&) { return true; });
             json result;
             result["active_flow_count"] = flowCount;
             // Return the JSON object as a string
@@ -448,9 +712,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::GET_FLOW_ENTRY_COUNT:  
         {
-            llmResponse::GetFlowEntryCountTask* getCountTask =
-                dynamic_cast<llmResponse::GetFlowEntryCountTask*>(task);
-            if (!getCountTask) { /* ... error handling ... */ }
+            auto* getCountTask = &llmResponse::taskAs<llmResponse::TaskType::GET_FLOW_ENTRY_COUNT>(*task);
 
             // Call the helper function
             auto flowEntriesOpt = this->getFlowEntriesForSwitch(getCountTask->deviceName);
@@ -469,9 +731,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::GET_FLOW_ENTRIES:  
         {
-            llmResponse::GetFlowEntriesTask* getEntriesTask =
-                dynamic_cast<llmResponse::GetFlowEntriesTask*>(task);
-            if (!getEntriesTask) { /* ... error handling ... */ }
+            auto* getEntriesTask = &llmResponse::taskAs<llmResponse::TaskType::GET_FLOW_ENTRIES>(*task);
 
             // Call the same helper function
             auto flowEntriesOpt = getFlowEntriesForSwitch(getEntriesTask->deviceName);
@@ -493,7 +753,8 @@ IntentTranslator::performTask(llmResponse::Task* task)
         case llmResponse::TaskType::GET_NETWORK_TOPOLOGY:
         {
 
-            auto graph = this->m_topologyAndFlowMonitor->getGraph();
+            auto graphSnapshot = this->m_topologyAndFlowMonitor->getGraphSnapshot();
+            const Graph& graph = graphSnapshot->graph;
             json topoJson;
             topoJson["switches"] = json::array();
             topoJson["hosts"] = json::array();
@@ -545,7 +806,8 @@ IntentTranslator::performTask(llmResponse::Task* task)
         case llmResponse::TaskType::GET_ALL_HOSTS:
         {
 
-            auto graph = this->m_topologyAndFlowMonitor->getGraph();
+            auto graphSnapshot = this->m_topologyAndFlowMonitor->getGraphSnapshot();
+            const Graph& graph = graphSnapshot->graph;
             json hostsJson = json::array();
             for (auto [vi, viEnd] = boost::vertices(graph); vi != viEnd; ++vi)
             {
@@ -563,7 +825,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
 
         case llmResponse::TaskType::BLOCK_HOST:
         {
-            auto* blockTask = dynamic_cast<llmResponse::BlockHostTask*>(task);
+            auto* blockTask = &llmResponse::taskAs<llmResponse::TaskType::BLOCK_HOST>(*task);
             if (!blockTask) return "{\"error\": \"Task cast failed\"}";
 
 
@@ -573,7 +835,8 @@ IntentTranslator::performTask(llmResponse::Task* task)
                 return "{\"error\": \"Host not found in topology\", \"host\": \"" + blockTask->host_id + "\"}";
             }
 
-            auto graph = this->m_topologyAndFlowMonitor->getGraph();
+            auto graphSnapshot = this->m_topologyAndFlowMonitor->getGraphSnapshot();
+            const Graph& graph = graphSnapshot->graph;
             auto hostVd = *hostVertexOpt;
             auto& hostProp = graph[hostVd];
 
@@ -640,24 +903,25 @@ IntentTranslator::performTask(llmResponse::Task* task)
 
         case llmResponse::TaskType::GET_PACKET_LOSS_RATE:
         {
-            auto* lossTask = dynamic_cast<llmResponse::GetPacketLossRateTask*>(task);
+            auto* lossTask = &llmResponse::taskAs<llmResponse::TaskType::GET_PACKET_LOSS_RATE>(*task);
             if (!lossTask) return "{\"error\": \"Task cast failed\"}";
 
 
-            auto srcIpOpt = this->getSwitchIpByName(lossTask->src);
-            auto dstIpOpt = this->getSwitchIpByName(lossTask->dst);
+            auto srcDpidOpt = this->getSwitchDpidByName(lossTask->src);
+            auto dstDpidOpt = this->getSwitchDpidByName(lossTask->dst);
 
-            if (srcIpOpt.has_value() && dstIpOpt.has_value())
+            if (srcDpidOpt.has_value() && dstDpidOpt.has_value())
             {
-                uint64_t srcDpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[*srcIpOpt];
-                uint64_t dstDpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[*dstIpOpt];
+                uint64_t srcDpid = *srcDpidOpt;
+                uint64_t dstDpid = *dstDpidOpt;
 
 
                 auto edgeOpt = this->m_topologyAndFlowMonitor->findEdgeBySrcAndDstDpid({srcDpid, dstDpid});
 
                 if (edgeOpt.has_value())
                 {
-                    auto graph = this->m_topologyAndFlowMonitor->getGraph();
+                    auto graphSnapshot = this->m_topologyAndFlowMonitor->getGraphSnapshot();
+                    const Graph& graph = graphSnapshot->graph;
                     const auto& edge = graph[*edgeOpt];
 
                     double lossRate = 0.0;
@@ -697,7 +961,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
 
         case llmResponse::TaskType::GET_SWITCH_PORTS:
         {
-            auto* portsTask = dynamic_cast<llmResponse::GetSwitchPortsTask*>(task);
+            auto* portsTask = &llmResponse::taskAs<llmResponse::TaskType::GET_SWITCH_PORTS>(*task);
             if (!portsTask) return "{\"error\": \"Task cast failed\"}";
 
  
@@ -708,7 +972,8 @@ IntentTranslator::performTask(llmResponse::Task* task)
                 return "{\"error\": \"Switch not found\", \"device\": \"" + portsTask->deviceName + "\"}";
             }
 
-            auto graph = this->m_topologyAndFlowMonitor->getGraph();
+            auto graphSnapshot = this->m_topologyAndFlowMonitor->getGraphSnapshot();
+            const Graph& graph = graphSnapshot->graph;
             auto swVd = *switchVertexOpt;
             
 
@@ -783,10 +1048,12 @@ IntentTranslator::performTask(llmResponse::Task* task)
 
         case llmResponse::TaskType::GET_PATH_SWITCH_COUNT:
         {
-            //llmResponse::GetPathSwitchCountTask* pathTask = dynamic_cast<llmResponse::GetPathSwitchCountTask*>(task);
-            // Assuming a topology monitor can calculate the hop count.
-            //this->m_topologyMonitor->getPathSwitchCount(pathTask->src, pathTask->dst);
-            break;
+            auto* pathTask = &llmResponse::taskAs<llmResponse::TaskType::GET_PATH_SWITCH_COUNT>(*task);
+
+            // Same lookup as GET_PATH; the count is the number of switches on the path
+            json path = this->m_flowLinkUsageCollector->getPathBetweenHostsJson(pathTask->src, pathTask->dst);
+            path.erase("switch_path");
+            return path.dump();
         }
 
         case llmResponse::TaskType::SET_DEVICE_NICKNAME:
@@ -820,10 +1087,10 @@ IntentTranslator::performTask(llmResponse::Task* task)
         {
             //llmResponse::InstallGroupEntryTask* groupTask = dynamic_cast<llmResponse::InstallGroupEntryTask*>(task);
             /*
-            auto deviceIpOpt = this->getSwitchIpByName(groupTask->deviceName);
-            if (deviceIpOpt.has_value())
+            auto dpidOpt = this->getSwitchDpidByName(groupTask->deviceName);
+            if (dpidOpt.has_value())
             {
-                uint64_t dpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[deviceIpOpt.value()];
+                uint64_t dpid = dpidOpt.value();
                 // Assuming a flow manager can install OpenFlow group entries.
                 this->m_flowManager->installGroupEntry(dpid, groupTask->group_id, groupTask->group_type, groupTask->buckets);
             }
@@ -835,10 +1102,10 @@ IntentTranslator::performTask(llmResponse::Task* task)
         {
             //llmResponse::InstallMeterEntryTask* meterTask = dynamic_cast<llmResponse::InstallMeterEntryTask*>(task);
             /*
-            auto deviceIpOpt = this->getSwitchIpByName(meterTask->deviceName);
-            if (deviceIpOpt.has_value())
+            auto dpidOpt = this->getSwitchDpidByName(meterTask->deviceName);
+            if (dpidOpt.has_value())
             {
-                uint64_t dpid = this->m_topologyAndFlowMonitor->m_ipStrToDpidMap[deviceIpOpt.value()];
+                uint64_t dpid = dpidOpt.value();
                 // Assuming a flow manager can install OpenFlow meter entries.
                 this->m_flowManager->installMeterEntry(dpid, meterTask->meter_id, meterTask->flags, meterTask->bands);
             }
@@ -907,7 +1174,7 @@ IntentTranslator::performTask(llmResponse::Task* task)
         }
         case llmResponse::TaskType::REQUEST_UI_FORM:
         {
-            auto* uiTask = dynamic_cast<llmResponse::RequestUIFormTask*>(task);
+            auto* uiTask = &llmResponse::taskAs<llmResponse::TaskType::REQUEST_UI_FORM>(*task);
             if (!uiTask) return "{\"error\": \"Task cast failed\"}";
             
             SPDLOG_LOGGER_INFO(Logger::instance(), 
@@ -930,6 +1197,39 @@ IntentTranslator::cleanSession(const std::string &sessionId)
     this->m_validationAgent->cleanSession(sessionId);
 }
 
+utils::MemoryUsage
+IntentTranslator::memoryUsage()
+{
+    utils::MemoryUsage usage;
+    const utils::MemoryUsage answer = this->m_answerAgent->memoryUsage();
+    for (const auto &[container, bytes] : answer.containers())
+    {
+        usage.add("answer_" + container, bytes);
+    }
+    for (const auto &[container, bytes] : this->m_validationAgent->memoryUsage().containers())
+    {
+        usage.add("validation_" + container, bytes);
+    }
+    {
+        std::lock_guard lock(this->m_intentCacheMutex);
+        size_t bytes = utils::heapBytes(this->m_intentCache);
+        for (const auto &[key, cached] : this->m_intentCache)
+        {
+            bytes += utils::heapBytes(key) + utils::heapBytes(cached.answer);
+        }
+        usage.add("intent_cache", bytes);
+    }
+    // Both agents keep a session for each session id
+    for (const auto &[unit, count] : answer.units())
+    {
+        if (unit == "session")
+        {
+            usage.per(unit, count);
+        }
+    }
+    return usage;
+}
+
 std::optional<nlohmann::json>
 IntentTranslator::getFlowEntriesForSwitch(const std::string& deviceName)
 {
@@ -940,15 +1240,16 @@ IntentTranslator::getFlowEntriesForSwitch(const std::string& deviceName)
         SPDLOG_LOGGER_WARN(Logger::instance(), "Switch '{}' not found in topology.", deviceName);
         return std::nullopt; // Switch not found
     }
-    auto graph = m_topologyAndFlowMonitor->getGraph();
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
     uint64_t dpid = graph[*switchVertexOpt].dpid;
     std::string dpid_str = std::to_string(dpid);
 
     // 2. Get the current flow tables for all switches
-    json openflowTables = this->m_deviceConfigManager->getOpenFlowTables();
+    auto openflowTables = this->m_deviceConfigManager->getOpenFlowTablesSnapshot();
 
     // 3. Find the specific switch's table and return its flow entries
-    for (const auto& switchTable : openflowTables)
+    for (const auto& switchTable : *openflowTables)
     {
         if (switchTable["dpid"].get<uint64_t>() == dpid)
         {
@@ -1,12 +1,126 @@
 #include "ndt_core/intent_translator/LLMAgent.hpp"
 #include "common_types/GraphTypes.hpp"
+#include "utils/HttpsClient.hpp"
 #include "utils/Utils.hpp"
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <random>
+#include <thread>
 
 using Clock = std::chrono::steady_clock;
 
+namespace
+{
+
+/**
+ * @brief Server-sent events of a streamed Responses API call, fed as the body arrives.
+ *
+ * Keeps the final response object of the "response.completed" (or "response.failed")
+ * event, which has the same fields as the body of an unstreamed call.
+ */
+class ResponseStream
+{
+  public:
+    explicit ResponseStream(Clock::time_point start)
+        : m_start(start)
+    {
+    }
+
+    void
+    feed(std::string_view chunk)
+    {
+        for (char c : chunk)
+        {
+            if (c != '\r')
+            {
+                m_pending += c;
+            }
+        }
+        size_t end;
+        while ((end = m_pending.find("\n\n")) != std::string::npos)
+        {
+            this->onEvent(std::string_view(m_pending).substr(0, end));
+            m_pending.erase(0, end + 2);
+        }
+    }
+
+    bool completed() const
+    {
+        return !m_response.is_null();
+    }
+
+    json& response()
+    {
+        return m_response;
+    }
+
+    // Bytes that were not an event, e.g. the JSON body of an error status
+    const std::string& unparsed() const
+    {
+        return m_pending;
+    }
+
+  private:
+    void
+    onEvent(std::string_view event)
+    {
+        std::string data;
+        while (!event.empty())
+        {
+            const size_t eol = event.find('\n');
+            std::string_view line = event.substr(0, eol);
+            event = eol == std::string_view::npos ? std::string_view() : event.substr(eol + 1);
+            if (line.starts_with("data:"))
+            {
+                line.remove_prefix(line.starts_with("data: ") ? 6 : 5);
+                data.append(line);
+            }
+        }
+        if (data.empty() || data == "[DONE]")
+        {
+            return;
+        }
+        json message = json::parse(data, nullptr, false);
+        if (message.is_discarded() || !message.contains("type"))
+        {
+            return;
+        }
+        const std::string type = message["type"].get<std::string>();
+        if (type == "response.output_text.delta" && !m_firstDelta)
+        {
+            m_firstDelta = true;
+            SPDLOG_LOGGER_INFO(Logger::instance(), "OpenAI API first output after {} ms",
+                std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_start).count());
+        }
+        else if (type == "response.completed" || type == "response.failed")
+        {
+            m_response = std::move(message["response"]);
+        }
+        else if (type == "error")
+        {
+            m_response = json{{"error", std::move(message)}};
+        }
+    }
+
+    Clock::time_point m_start;
+    std::string m_pending;
+    json m_response;
+    bool m_firstDelta = false;
+};
+
+// Full jitter: uniform in [0, min(cap, base * 2^(attempt - 1))]
+std::chrono::milliseconds
+backoffDelay(int attempt)
+{
+    thread_local std::mt19937 rng{std::random_device{}()};
+    const int64_t ceiling = std::min<int64_t>(LLM_AGENT_BACKOFF_MAX_MS,
+        static_cast<int64_t>(LLM_AGENT_BACKOFF_BASE_MS) << std::min(attempt - 1, 20));
+    return std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(0, ceiling)(rng));
+}
+
+} // namespace
+
 LLMAgent::LLMAgent(
     std::string systemPromptFilePath,
     std::shared_ptr<TopologyAndFlowMonitor> topologyAndFlowMonitor,
@@ -34,6 +148,12 @@ LLMAgent::LLMAgent(
     }
     this->m_apiKey = apiKey;
 
+    this->m_responseTime = &utils::MetricsRegistry::instance().histogram(
+        "ndt_llm_response_seconds",
+        "Time from sending a request to the LLM to its complete response",
+        utils::MetricsRegistry::label(
+            "agent", std::filesystem::path(this->m_systemPromptFilePath).stem().string()));
+
     // Check if m_model string contains "mini" or "nano", if not, set m_rateLimit to true
     if (this->m_model.find("mini") == std::string::npos && this->m_model.find("nano") == std::string::npos)
     {
@@ -60,16 +180,20 @@ LLMAgent::shellEscapeSingleQuotes(const std::string &str) {
 }
 
 std::string
-LLMAgent::getLastMsgId(const std::string &sessionId) const 
+LLMAgent::getLastMsgId(const std::string &sessionId)
 {
-    auto it = m_sessionIdToMsgMap.find(sessionId);
-    if (it == m_sessionIdToMsgMap.end()) return "";
-
-    for (auto msgIt = it->second.rbegin(); msgIt != it->second.rend(); ++msgIt)
-        if (msgIt->first == LLMAgent::Role::AGENT)
-            return msgIt->second["id"].get<std::string>();
-
-    return "";
+    std::string id;
+    this->m_sessions.read(sessionId, [&id](const Session &session) {
+        for (auto msgIt = session.messages.rbegin(); msgIt != session.messages.rend(); ++msgIt)
+        {
+            if (msgIt->first == LLMAgent::Role::AGENT)
+            {
+                id = msgIt->second["id"].get<std::string>();
+                return;
+            }
+        }
+    });
+    return id;
 }
 
 std::unique_ptr<llmResponse::LLMResponse>
@@ -80,66 +204,89 @@ LLMAgent::callOpenAIApi(
     SPDLOG_LOGGER_DEBUG(Logger::instance(), "callOpenAIApi: sessionId: {}", sessionId);
     std::string lastMsgId = this->getLastMsgId(sessionId);
 
-    // std::string currentFlowEntries = this->getCurrentFlowEntries();
-    // SPDLOG_LOGGER_DEBUG(Logger::instance(), "flow entries:\n{}\n", currentFlowEntries);
-
-    std::ifstream in(m_systemPromptFilePath);
-    std::string systemPrompt((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    // The instructions are not carried over by previous_response_id, so they go with every
+    // call; the topology and flow entries are input items, which the chain keeps, so they go
+    // only when they differ from what the session has already seen
+    SessionContext sentContext;
+    std::string contextUpdate = this->getContextUpdate(sessionId, sentContext);
     json payload;
-
-    std::string instructions = systemPrompt;
-    // Check if this is the first message in the session (no previous message ID exists)
-    // dont send topo every session
-    if (lastMsgId.empty())
+    payload["model"] = this->m_model;
+    payload["instructions"] = this->getSystemPrompt();
+    if (contextUpdate.empty())
     {
-        SPDLOG_LOGGER_INFO(Logger::instance(), "First message in session {}, sending topology.", sessionId);
-        //instructions += this->getCurrentTopology(); // Append topology only for the first message
+        payload["input"] = inputText;
+    }
+    else
+    {
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Sending {} bytes of changed context in session {}.",
+            contextUpdate.size(), sessionId);
+        payload["input"] = json::array({
+            {{"role", "developer"}, {"content", std::move(contextUpdate)}},
+            {{"role", "user"}, {"content", inputText}},
+        });
     }
-
-    payload["model"] = this->m_model;
-    payload["instructions"] = instructions; //+ this->getCurrentFlowEntries();
-    payload["input"]  = inputText;
     // payload["reasoning"]["effort"] = "minimal";
     if (!lastMsgId.empty())
     {
         payload["previous_response_id"] = lastMsgId;
     }
+    // Streamed, so a stalled or failing answer shows up before the whole body is due
+    payload["stream"] = true;
     std::string data = payload.dump();
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "httpsPost: send request to openai api.");
+    utils::HttpRequestOptions options;
+    options.timeout = std::chrono::milliseconds(LLM_AGENT_READ_TIMEOUT_MS);
+    options.headers.emplace_back("Authorization", "Bearer " + this->m_apiKey);
+    options.headers.emplace_back("Accept", "text/event-stream");
 
-    auto start = Clock::now();
-    std::string response;
-    try
-    {
-        response = utils::httpsPost("https://api.openai.com/v1/responses", data, "application/json", "Bearer " + this->m_apiKey);
-    }
-    catch (const std::exception &e)
-    {
-        SPDLOG_LOGGER_ERROR(Logger::instance(), "Failed to call openai API: {}", e.what());
-        return nullptr;
-    }
-    auto end = Clock::now();
-    
-    if (this->m_rateLimit)
-    {
-        SPDLOG_LOGGER_INFO(Logger::instance(), "Rate limit enabled, waiting for 45 seconds.");
-        std::this_thread::sleep_for(std::chrono::milliseconds(20000));
-    }
-    int responseTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Input{}, time{}", inputText, responseTimeMs );
-    this->m_responseTime.push_back(responseTimeMs);
     json responseJson;
-    try
+    int64_t responseTimeMs = 0;
+    for (int attempt = 1;; ++attempt)
     {
-        responseJson = json::parse(response);
-    }
-    catch (const json::parse_error &e)
-    {
-        SPDLOG_LOGGER_ERROR(Logger::instance(), "Failed to parse OpenAI API response: {}", e.what());
-        return nullptr;
+        this->waitForRateLimit();
+        SPDLOG_LOGGER_INFO(Logger::instance(), "send request to openai api, attempt {}.", attempt);
+
+        auto start = Clock::now();
+        ResponseStream stream(start);
+        utils::HttpResponse response;
+        try
+        {
+            response = utils::HttpsClient::instance().post(
+                LLM_AGENT_API_URL, data, options, [&stream](std::string_view chunk) { stream.feed(chunk); });
+        }
+        catch (const std::exception &e)
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "Failed to call openai API: {}", e.what());
+            return nullptr;
+        }
+        auto end = Clock::now();
+        responseTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Input{}, time{}", inputText, responseTimeMs );
+
+        if (response.ok() && stream.completed())
+        {
+            this->m_responseTime->observe(end - start);
+            responseJson = std::move(stream.response());
+            break;
+        }
+
+        // Throttled, a server error, or a dropped stream: worth another try; other statuses
+        // would fail the same way again
+        const bool retryable = response.error || response.status == 429 || response.status >= 500 ||
+                               (response.ok() && !stream.completed());
+        SPDLOG_LOGGER_WARN(Logger::instance(), "OpenAI API call failed (status {}, {}): {}",
+            response.status, response.error ? response.error.message() : "no transport error",
+            stream.unparsed());
+        if (!retryable || attempt >= LLM_AGENT_MAX_ATTEMPTS)
+        {
+            return nullptr;
+        }
+        auto delay = backoffDelay(attempt);
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Retrying openai API call in {} ms", delay.count());
+        std::this_thread::sleep_for(delay);
     }
 
+
     if (!responseJson["error"].is_null())
     {
         SPDLOG_LOGGER_ERROR(Logger::instance(), "OpenAI API error: {}", responseJson["error"].dump());
@@ -168,36 +315,156 @@ LLMAgent::callOpenAIApi(
         return nullptr;
     }
 
-    this->m_sessionIdToMsgMap[sessionId].push_back( {LLMAgent::Role::USER, json{{"msg", inputText}}} );
-    this->m_sessionIdToMsgMap[sessionId].push_back(
-        {LLMAgent::Role::AGENT, json{
+    this->m_sessions.update(sessionId, [&](Session &session) {
+        session.messages.push_back({LLMAgent::Role::USER, json{{"msg", inputText}}});
+        session.messages.push_back({LLMAgent::Role::AGENT, json{
             {"id", responseJson["id"]},
             {"msg", resultJson}
         }});
+        while (session.messages.size() > LLM_SESSION_MAX_MESSAGES)
+        {
+            session.messages.pop_front();
+        }
+        session.tokens.first += inputTokens;
+        session.tokens.second += outputTokens;
+        session.context = sentContext;
+        session.responses++;
+        session.responseTimeMs += responseTimeMs;
+    });
+
+    return resPtr;
+}
 
-    if (this->m_sessionTokensCount.find(sessionId) == this->m_sessionTokensCount.end())
+std::string
+LLMAgent::getSystemPrompt()
+{
+    std::error_code ec;
+    auto modified = std::filesystem::last_write_time(this->m_systemPromptFilePath, ec);
+    std::lock_guard lock(this->m_promptMutex);
+    if (!this->m_systemPromptLoaded || (!ec && modified != this->m_systemPromptModified))
     {
-        this->m_sessionTokensCount[sessionId] = {inputTokens, outputTokens};
+        std::ifstream in(this->m_systemPromptFilePath);
+        this->m_systemPrompt.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        this->m_systemPromptModified = modified;
+        this->m_systemPromptLoaded = true;
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Loaded system prompt {} ({} bytes)",
+            this->m_systemPromptFilePath, this->m_systemPrompt.size());
     }
-    else
+    return this->m_systemPrompt;
+}
+
+std::string
+LLMAgent::getContextUpdate(const std::string &sessionId, SessionContext &sent)
+{
+    const uint64_t graphVersion = this->m_topologyAndFlowMonitor->getGraphVersion();
+    const uint64_t flowTablesVersion = this->m_deviceConfigManager->openFlowTablesVersion();
+
+    SessionContext previous;
+    this->m_sessions.read(sessionId, [&previous](const Session &session) { previous = session.context; });
+    sent = previous;
+
+    std::lock_guard lock(this->m_contextMutex);
+    try
+    {
+        // Rendered once per version of their source, whichever session asks
+        if (!this->m_topologyContext.valid || this->m_topologyContext.version != graphVersion)
+        {
+            this->m_topologyContext = {graphVersion, this->getCurrentTopology(), true};
+        }
+        if (!this->m_flowEntriesContext.valid || this->m_flowEntriesContext.version != flowTablesVersion)
+        {
+            this->m_flowEntriesContext = {flowTablesVersion, this->getCurrentFlowEntries(), true};
+        }
+    }
+    catch (const std::exception &e)
     {
-        this->m_sessionTokensCount[sessionId].first += inputTokens;
-        this->m_sessionTokensCount[sessionId].second += outputTokens;
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Failed to render the context, not sending it: {}", e.what());
+        return "";
     }
 
-    return resPtr;
+    // A new version often renders the same text (counters moved, no switch or link changed),
+    // so compare what the session was last sent by content
+    sent.topologyHash = std::hash<std::string>{}(this->m_topologyContext.text);
+    sent.flowEntriesHash = std::hash<std::string>{}(this->m_flowEntriesContext.text);
+
+    std::string update;
+    if (sent.topologyHash != previous.topologyHash)
+    {
+        update += this->m_topologyContext.text + "\n\n";
+    }
+    if (sent.flowEntriesHash != previous.flowEntriesHash)
+    {
+        update += this->m_flowEntriesContext.text;
+    }
+    return update;
+}
+
+void
+LLMAgent::waitForRateLimit()
+{
+    if (!this->m_rateLimit)
+    {
+        return;
+    }
+    // Reserve the next slot, then wait for it without the lock
+    Clock::time_point slot;
+    {
+        std::lock_guard lock(this->m_rateLimitMutex);
+        slot = std::max(Clock::now(), this->m_nextCallAt);
+        this->m_nextCallAt = slot + std::chrono::milliseconds(LLM_AGENT_RATE_LIMIT_INTERVAL_MS);
+    }
+    if (slot > Clock::now())
+    {
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Rate limit enabled, waiting {} ms.",
+            std::chrono::duration_cast<std::chrono::milliseconds>(slot - Clock::now()).count());
+        std::this_thread::sleep_until(slot);
+    }
+}
+
+bool
+LLMAgent::hasSession(const std::string &sessionId)
+{
+    return this->m_sessions.contains(sessionId);
+}
+
+utils::MemoryUsage
+LLMAgent::memoryUsage()
+{
+    utils::MemoryUsage usage;
+    size_t messages = 0;
+    usage.add("sessions", this->m_sessions.memoryBytes([&messages](const Session &session) {
+        messages += session.messages.size();
+        size_t bytes = utils::heapBytes(session.messages);
+        for (const auto &[role, msg] : session.messages)
+        {
+            bytes += utils::heapBytes(msg);
+        }
+        return bytes;
+    }));
+    {
+        std::lock_guard lock(this->m_promptMutex);
+        usage.add("system_prompt", utils::heapBytes(this->m_systemPrompt));
+    }
+    {
+        std::lock_guard lock(this->m_contextMutex);
+        usage.add("contexts",
+                  utils::heapBytes(this->m_topologyContext.text) +
+                      utils::heapBytes(this->m_flowEntriesContext.text));
+    }
+    return usage.per("session", this->m_sessions.size()).per("message", messages);
 }
 
 std::vector<std::pair<LLMAgent::Role, json>>
 LLMAgent::getSessionMsgs(const std::string &sessionId)
 {
-    auto it = m_sessionIdToMsgMap.find(sessionId);
-    if (it == m_sessionIdToMsgMap.end())
+    std::vector<std::pair<LLMAgent::Role, json>> msgs;
+    if (!this->m_sessions.read(sessionId, [&msgs](const Session &session) {
+            msgs.assign(session.messages.begin(), session.messages.end());
+        }))
     {
         SPDLOG_LOGGER_ERROR(Logger::instance(), "Session ID not found: {}", sessionId);
-        return {};
     }
-    return it->second;
+    return msgs;
 }
 
 std::string
@@ -206,7 +473,8 @@ LLMAgent::getCurrentTopology()
     std::string switchDescription, hostDescription, edgeDescription;
     int switchCnt = 0, hostCnt = 0, edgeCnt = 0;
 
-    Graph graph = this->m_topologyAndFlowMonitor->getGraph();
+    auto graphSnapshot = this->m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
 
     for (auto [vi, viEnd] = boost::vertices(graph); vi != viEnd; ++vi)
     {
@@ -250,16 +518,24 @@ LLMAgent::getCurrentTopology()
 std::string
 LLMAgent::getCurrentFlowEntries()
 {
-    json openflowTable = this->m_deviceConfigManager->getOpenFlowTables();
+    // Shared with the device manager, not copied; read only
+    auto openflowTable = this->m_deviceConfigManager->getOpenFlowTablesSnapshot();
     
     std::string openflowTableStr;
-    for (auto& switchTable: openflowTable)
+    for (const auto& switchTable: *openflowTable)
     {
-        openflowTableStr += ("dpid:" + std::to_string(switchTable["dpid"].get<int>()) + "\n");
-        for (auto& entry: switchTable["flows"][std::to_string(switchTable["dpid"].get<int>())])
+        const std::string dpidStr = std::to_string(switchTable.at("dpid").get<int>());
+        openflowTableStr += ("dpid:" + dpidStr + "\n");
+        const json& flows = switchTable.at("flows");
+        auto switchFlows = flows.find(dpidStr);
+        if (switchFlows == flows.end())
+        {
+            continue;
+        }
+        for (const auto& entry: *switchFlows)
         {
             std::string action;
-            if (entry["actions"].empty())
+            if (!entry.contains("actions") || entry["actions"].empty())
             {
                 action = "DROP";
             }
@@ -268,7 +544,7 @@ LLMAgent::getCurrentFlowEntries()
                 action = entry["actions"][0].get<std::string>();
             }
 
-            json match = entry["match"];
+            json match = entry.value("match", json::object());
             if (match.contains("dl_type"))
             {
                 match.erase("dl_type");
@@ -278,7 +554,7 @@ LLMAgent::getCurrentFlowEntries()
                 "{} {} {}\n",
                 match.dump(),
                 action,
-                entry["priority"].get<int>() == 10 ? "" : std::to_string(entry["priority"].get<int>())
+                entry.at("priority").get<int>() == 10 ? "" : std::to_string(entry.at("priority").get<int>())
             );
 
             openflowTableStr += entryStr;
@@ -295,32 +571,17 @@ void
 LLMAgent::cleanSession(const std::string &sessionId)
 {
     SPDLOG_LOGGER_DEBUG(Logger::instance(), "cleanSession: sessionId: {}", sessionId);
-    auto it = m_sessionIdToMsgMap.find(sessionId);
-    if (it == m_sessionIdToMsgMap.end())
+    std::optional<Session> session = this->m_sessions.take(sessionId);
+    if (!session.has_value())
     {
         SPDLOG_LOGGER_ERROR(Logger::instance(), "Session ID not found: {}", sessionId);
         return;
     }
-    auto tokensIt = m_sessionTokensCount.find(sessionId);
-
-    int agentRespondCount = it->second.size();
-    for (const auto& msg : it->second)
-        if (msg.first == LLMAgent::Role::USER) 
-            agentRespondCount--;
 
-    std::string respondTime;
-    for (const auto& time : this->m_responseTime)
-    {
-        respondTime += std::to_string(time) + " ";
-    }
-    respondTime += "ms";
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Session {} agent respond count: {}", sessionId, agentRespondCount);
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Session {} agent respond count: {}", sessionId, session->responses);
     SPDLOG_LOGGER_INFO(Logger::instance(), "Session {} total input tokens: {}, total output tokens: {}", 
-        sessionId, tokensIt->second.first, tokensIt->second.second);
-    SPDLOG_LOGGER_INFO(Logger::instance(), "Session {} response time: {}", sessionId, respondTime);
-
-    m_sessionIdToMsgMap.erase(it);
-    m_sessionTokensCount.erase(tokensIt);
+        sessionId, session->tokens.first, session->tokens.second);
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Session {} mean response time: {} ms", sessionId,
+        session->responses ? session->responseTimeMs / static_cast<int64_t>(session->responses) : 0);
     SPDLOG_LOGGER_DEBUG(Logger::instance(), "finish cleanSession: sessionId: {}", sessionId);
 }
@@ -0,0 +1,528 @@
+#include "ndt_core/lock_management/LockManager.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+
+namespace
+{
+
+bool
+isGlobalLock(const std::string& name)
+{
+    return name == "routing_lock" || name == "graph_lock" || name == "power_lock";
+}
+
+bool
+isRoutingDomain(const std::string& name)
+{
+    return name.starts_with("switch:") || name.starts_with("link:") || name.starts_with("flow:");
+}
+
+bool
+conflicts(const std::string& a, const std::string& b)
+{
+    return a == b || (a == "routing_lock" && isRoutingDomain(b)) ||
+           (b == "routing_lock" && isRoutingDomain(a));
+}
+
+bool
+overlaps(const std::vector<std::string>& a, const std::vector<std::string>& b)
+{
+    for (const auto& x : a)
+    {
+        for (const auto& y : b)
+        {
+            if (conflicts(x, y))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// A DPID in decimal or 0x-prefixed hex
+std::optional<uint64_t>
+parseDpid(const std::string& text)
+{
+    if (text.empty() || text[0] == '-' || text[0] == '+')
+    {
+        return std::nullopt;
+    }
+    errno = 0;
+    char* end = nullptr;
+    const unsigned long long value = std::strtoull(text.c_str(), &end, 0);
+    if (errno != 0 || *end != '\0')
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+int
+clampTtl(int ttlSeconds)
+{
+    return std::clamp(ttlSeconds, 1, LOCK_MAX_TTL_SECONDS);
+}
+
+void
+sortUnique(std::vector<std::string>& resources)
+{
+    std::sort(resources.begin(), resources.end());
+    resources.erase(std::unique(resources.begin(), resources.end()), resources.end());
+}
+
+} // namespace
+
+LockManager::LockManager()
+    : m_waitTime(utils::MetricsRegistry::instance().histogram(
+          "ndt_lock_wait_seconds", "Time lock acquires spent queued before being granted")),
+      m_abandonedWaits(utils::MetricsRegistry::instance().counter(
+          "ndt_lock_waits_abandoned_total", "Queued lock acquires given up before a grant"))
+{
+    m_expiryTask =
+        utils::TaskScheduler::instance().schedule("lock_expiry",
+                                                  utils::TaskPriority::High,
+                                                  std::chrono::milliseconds(LOCK_EXPIRY_CHECK_MS),
+                                                  [this] { pump(); });
+}
+
+LockManager::~LockManager()
+{
+    utils::TaskScheduler::instance().cancel(m_expiryTask);
+}
+
+std::optional<std::string>
+LockManager::normalizeResource(const std::string& name)
+{
+    if (isGlobalLock(name))
+    {
+        return name;
+    }
+    if (name.starts_with("switch:"))
+    {
+        auto dpid = parseDpid(name.substr(7));
+        return dpid ? std::optional("switch:" + std::to_string(*dpid)) : std::nullopt;
+    }
+    if (name.starts_with("link:"))
+    {
+        const auto dash = name.find('-', 5);
+        if (dash == std::string::npos)
+        {
+            return std::nullopt;
+        }
+        auto a = parseDpid(name.substr(5, dash - 5));
+        auto b = parseDpid(name.substr(dash + 1));
+        if (!a || !b)
+        {
+            return std::nullopt;
+        }
+        return "link:" + std::to_string(std::min(*a, *b)) + "-" +
+               std::to_string(std::max(*a, *b));
+    }
+    if (name.starts_with("flow:"))
+    {
+        std::string address = name.substr(5);
+        int length = 32;
+        if (const auto slash = address.find('/'); slash != std::string::npos)
+        {
+            const std::string lengthText = address.substr(slash + 1);
+            address.resize(slash);
+            if (lengthText.empty() || lengthText.size() > 2 ||
+                !std::all_of(lengthText.begin(), lengthText.end(), ::isdigit))
+            {
+                return std::nullopt;
+            }
+            length = std::stoi(lengthText);
+        }
+        if (length > 32)
+        {
+            return std::nullopt;
+        }
+        try
+        {
+            return "flow:" + utils::ipToString(utils::ipStringToUint32(address)) + "/" +
+                   std::to_string(length);
+        }
+        catch (const std::invalid_argument&)
+        {
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+bool
+LockManager::isValidType(const std::string& typeStr) const
+{
+    return isGlobalLock(typeStr);
+}
+
+void
+LockManager::reapExpired(Clock::time_point now)
+{
+    for (auto it = m_leases.begin(); it != m_leases.end();)
+    {
+        if (it->second.expiry > now)
+        {
+            ++it;
+            continue;
+        }
+        const Token token = it->first;
+        ++it;
+        endLease(token);
+    }
+}
+
+bool
+LockManager::isFree(const std::vector<std::string>& resources) const
+{
+    for (const auto& resource : resources)
+    {
+        if (m_holders.contains(resource) || (resource == "routing_lock" && m_routingDomainHeld) ||
+            (isRoutingDomain(resource) && m_holders.contains("routing_lock")))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+LockManager::queuedBefore(const std::vector<std::string>& resources,
+                          std::list<Waiter>::const_iterator end) const
+{
+    for (auto it = m_waiters.cbegin(); it != end; ++it)
+    {
+        if (overlaps(resources, it->resources))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+LockManager::Token
+LockManager::grant(const std::vector<std::string>& resources,
+                   int ttlSeconds,
+                   bool legacy,
+                   Clock::time_point now)
+{
+    const Token token = m_nextToken++;
+    for (const auto& resource : resources)
+    {
+        m_holders.emplace(resource, token);
+        m_routingDomainHeld += isRoutingDomain(resource);
+    }
+    m_leases.emplace(token,
+                     Lease{resources, now + std::chrono::seconds(clampTtl(ttlSeconds)), legacy});
+    return token;
+}
+
+void
+LockManager::endLease(Token token)
+{
+    auto it = m_leases.find(token);
+    if (it == m_leases.end())
+    {
+        return;
+    }
+    for (const auto& resource : it->second.resources)
+    {
+        m_holders.erase(resource);
+        m_routingDomainHeld -= isRoutingDomain(resource);
+    }
+    m_leases.erase(it);
+}
+
+std::optional<LockManager::Clock::time_point>
+LockManager::grantWaiters(Clock::time_point now, Ready& ready)
+{
+    for (auto it = m_waiters.begin(); it != m_waiters.end();)
+    {
+        if (!isFree(it->resources) || queuedBefore(it->resources, it))
+        {
+            ++it;
+            continue;
+        }
+        const Token token = grant(it->resources, it->ttlSeconds, it->legacy, now);
+        m_waitTime.observe(now - it->queuedAt);
+        ready.emplace_back(std::move(it->done), token);
+        it = m_waiters.erase(it);
+    }
+    if (m_waiters.empty() || m_leases.empty())
+    {
+        return std::nullopt;
+    }
+    auto earliest = m_leases.begin()->second.expiry;
+    for (const auto& [token, lease] : m_leases)
+    {
+        earliest = std::min(earliest, lease.expiry);
+    }
+    return earliest;
+}
+
+void
+LockManager::finish(Ready& ready, std::optional<Clock::time_point> wakeAt)
+{
+    if (wakeAt)
+    {
+        // Grant the next waiter when the lease blocking it expires, not a period later
+        utils::TaskScheduler::instance().runAt(m_expiryTask, *wakeAt);
+    }
+    for (auto& [done, token] : ready)
+    {
+        try
+        {
+            done(token);
+        }
+        catch (const std::exception& e)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(), "Lock grant callback failed: {}", e.what());
+        }
+    }
+}
+
+void
+LockManager::pump()
+{
+    Ready ready;
+    std::optional<Clock::time_point> wakeAt;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_waiters.empty() && m_leases.empty())
+        {
+            return;
+        }
+        const auto now = Clock::now();
+        reapExpired(now);
+        wakeAt = grantWaiters(now, ready);
+    }
+    finish(ready, wakeAt);
+}
+
+std::optional<LockManager::Token>
+LockManager::tryAcquire(std::vector<std::string> resources, int ttlSeconds, bool legacy)
+{
+    std::optional<Token> token;
+    acquireAsync(
+        std::move(resources),
+        ttlSeconds,
+        [&token](std::optional<Token> granted) { token = granted; },
+        legacy,
+        false);
+    return token;
+}
+
+LockManager::WaitId
+LockManager::acquireAsync(std::vector<std::string> resources,
+                          int ttlSeconds,
+                          Granted done,
+                          bool legacy,
+                          bool wait)
+{
+    sortUnique(resources);
+    std::optional<Token> token;
+    Ready ready;
+    std::optional<Clock::time_point> wakeAt;
+    WaitId id = 0;
+    {
+        std::lock_guard lock(m_mutex);
+        const auto now = Clock::now();
+        // Expired leases may let earlier waiters go first
+        reapExpired(now);
+        grantWaiters(now, ready);
+        if (isFree(resources) && !queuedBefore(resources, m_waiters.cend()))
+        {
+            token = grant(resources, ttlSeconds, legacy, now);
+        }
+        else if (wait && m_waiters.size() < LOCK_MAX_WAITERS)
+        {
+            id = m_nextWaitId++;
+            m_waiters.push_back(Waiter{id, std::move(resources), ttlSeconds, legacy, done, now});
+        }
+        wakeAt = grantWaiters(now, ready);
+    }
+    finish(ready, wakeAt);
+    if (id == 0)
+    {
+        done(token);
+    }
+    return id;
+}
+
+bool
+LockManager::cancelWait(WaitId id)
+{
+    Ready ready;
+    std::optional<Clock::time_point> wakeAt;
+    {
+        std::lock_guard lock(m_mutex);
+        auto it = std::find_if(
+            m_waiters.begin(), m_waiters.end(), [id](const Waiter& w) { return w.id == id; });
+        if (it == m_waiters.end())
+        {
+            return false;
+        }
+        m_waiters.erase(it);
+        m_abandonedWaits.add();
+        // Waiters queued behind it may have been held back only by it
+        wakeAt = grantWaiters(Clock::now(), ready);
+    }
+    finish(ready, wakeAt);
+    return true;
+}
+
+bool
+LockManager::renew(Token token, int ttlSeconds)
+{
+    std::lock_guard lock(m_mutex);
+    const auto now = Clock::now();
+    auto it = m_leases.find(token);
+    if (it == m_leases.end() || it->second.expiry <= now)
+    {
+        return false;
+    }
+    it->second.expiry = now + std::chrono::seconds(clampTtl(ttlSeconds));
+    return true;
+}
+
+bool
+LockManager::release(Token token)
+{
+    Ready ready;
+    std::optional<Clock::time_point> wakeAt;
+    {
+        std::lock_guard lock(m_mutex);
+        const auto now = Clock::now();
+        auto it = m_leases.find(token);
+        if (it == m_leases.end() || it->second.expiry <= now)
+        {
+            return false;
+        }
+        endLease(token);
+        reapExpired(now);
+        wakeAt = grantWaiters(now, ready);
+    }
+    finish(ready, wakeAt);
+    return true;
+}
+
+bool
+LockManager::acquireLock(const std::string& lockNameStr, int ttlSeconds)
+{
+    if (!isGlobalLock(lockNameStr))
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Invalid lock type requested: {}", lockNameStr);
+        return false;
+    }
+    return tryAcquire({lockNameStr}, ttlSeconds, true).has_value();
+}
+
+bool
+LockManager::renew(const std::string& lockNameStr, int ttlSeconds)
+{
+    Token token = 0;
+    {
+        std::lock_guard lock(m_mutex);
+        auto holder = m_holders.find(lockNameStr);
+        if (holder == m_holders.end() || !m_leases.at(holder->second).legacy)
+        {
+            return false;
+        }
+        token = holder->second;
+    }
+    return renew(token, ttlSeconds);
+}
+
+void
+LockManager::unlock(const std::string& lockNameStr)
+{
+    Token token = 0;
+    {
+        std::lock_guard lock(m_mutex);
+        auto holder = m_holders.find(lockNameStr);
+        if (holder == m_holders.end() || !m_leases.at(holder->second).legacy)
+        {
+            return;
+        }
+        token = holder->second;
+    }
+    release(token);
+}
+
+nlohmann::json
+LockManager::statusJson()
+{
+    std::lock_guard lock(m_mutex);
+    const auto now = Clock::now();
+    reapExpired(now);
+    auto leases = nlohmann::json::array();
+    for (const auto& [token, lease] : m_leases)
+    {
+        leases.push_back(
+            {{"token", token},
+             {"resources", lease.resources},
+             {"expires_in_ms",
+              std::chrono::duration_cast<std::chrono::milliseconds>(lease.expiry - now).count()}});
+    }
+    return nlohmann::json{
+        {"leases", std::move(leases)}, {"waiters", m_waiters.size()}, {"next_token", m_nextToken}};
+}
+
+nlohmann::json
+LockManager::exportLeases()
+{
+    std::lock_guard lock(m_mutex);
+    const auto now = Clock::now();
+    reapExpired(now);
+    auto leases = nlohmann::json::array();
+    for (const auto& [token, lease] : m_leases)
+    {
+        leases.push_back(
+            {{"token", token},
+             {"resources", lease.resources},
+             {"expires_in_ms",
+              std::chrono::duration_cast<std::chrono::milliseconds>(lease.expiry - now).count()},
+             {"legacy", lease.legacy}});
+    }
+    return nlohmann::json{{"leases", std::move(leases)}, {"next_token", m_nextToken}};
+}
+
+void
+LockManager::importLeases(const nlohmann::json& exported)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        const auto now = Clock::now();
+        m_leases.clear();
+        m_holders.clear();
+        m_routingDomainHeld = 0;
+        for (const auto& entry : exported.value("leases", nlohmann::json::array()))
+        {
+            const Token token = entry.value("token", Token{0});
+            const auto expiresInMs = entry.value("expires_in_ms", int64_t{0});
+            if (token == 0 || expiresInMs <= 0)
+            {
+                continue;
+            }
+            Lease lease;
+            lease.resources = entry.value("resources", std::vector<std::string>{});
+            lease.expiry = now + std::chrono::milliseconds(expiresInMs);
+            lease.legacy = entry.value("legacy", false);
+            for (const auto& resource : lease.resources)
+            {
+                m_holders.emplace(resource, token);
+                m_routingDomainHeld += isRoutingDomain(resource);
+            }
+            m_leases.emplace(token, std::move(lease));
+            m_nextToken = std::max(m_nextToken, token + 1);
+        }
+        m_nextToken = std::max(m_nextToken, exported.value("next_token", Token{1}));
+    }
+    // Waiters blocked by a lease the import dropped may go now
+    pump();
+}
@@ -5,35 +5,131 @@
 #include "nlohmann/json.hpp"                              // for basic_json
 #include "spdlog/spdlog-inl.h"                            // for default_lo...
 #include "spdlog/spdlog.h"                                // for SPDLOG_LOG...
+#include "utils/FanOut.hpp"                               // for fanOut
+#include "utils/HttpClient.hpp"                           // for HttpClient
+#include "utils/IcmpProber.hpp"                           // for IcmpProber
 #include "utils/Logger.hpp"                               // for Logger
+#include "utils/Metrics.hpp"                              // for pollerCycleHistogram
+#include "utils/OvsdbMonitor.hpp"                         // for OvsdbMonitor
 #include "utils/SSHHelper.hpp"                            // for getPowerRe...
+#include "utils/SnmpClient.hpp"                           // for SnmpClient
+#include "utils/Startup.hpp"                              // for Startup
 #include "utils/Utils.hpp"                                // for Deployment...
 #include <algorithm>                                      // for find_if
+#include <array>                                          // for array
 #include <boost/graph/detail/adjacency_list.hpp>          // for vertices
 #include <boost/iterator/iterator_categories.hpp>         // for random_acc...
 #include <boost/iterator/iterator_facade.hpp>             // for operator!=
 #include <boost/range/irange.hpp>                         // for integer_it...
 #include <boost/range/iterator_range_core.hpp>            // for iterator_r...
 #include <chrono>                                         // for seconds
+#include <condition_variable>                             // for condition_variable
 #include <cstdint>                                        // for uint32_t
 #include <cstdlib>                                        // for system
 #include <ctype.h>                                        // for isdigit
 #include <exception>                                      // for exception
 #include <fstream>                                        // for basic_ostream
+#include <functional>                                     // for function
+#include <future>                                         // for future
 #include <iomanip>                                        // for std::setw and std::setfill
+#include <mutex>                                          // for mutex, lock_guard
 #include <optional>                                       // for optional
 #include <random>                                         // for random_device
-#include <regex>                                          // for regex_search
 #include <spdlog/fmt/fmt.h>                               // for format
 #include <sstream>                                        // for basic_ostr...
 #include <stdexcept>                                      // for runtime_error
 #include <stdio.h>                                        // for fgets, pclose
-#include <thread>                                         // for thread
+#include <system_error>                                   // for system_error
 #include <utility>                                        // for pair, move
 
 using namespace std;
 using json = nlohmann::json;
 
+namespace
+{
+
+// Device health OIDs: HPE 5520 (Comware) and Brocade ICX 7250
+const utils::SnmpOid HPE_CPU_OID = utils::parseSnmpOid("1.3.6.1.4.1.25506.2.6.1.1.1.1.6.212");
+const utils::SnmpOid HPE_MEMORY_OID = utils::parseSnmpOid("1.3.6.1.4.1.25506.2.6.1.1.1.1.8.212");
+const utils::SnmpOid HPE_TEMPERATURE_OID =
+    utils::parseSnmpOid("1.3.6.1.4.1.25506.2.6.1.1.1.1.12.212");
+const utils::SnmpOid HPE_POWER_TABLE_OID = utils::parseSnmpOid("1.3.6.1.4.1.25506.8.35.9.1.1.1.6");
+const utils::SnmpOid BROCADE_CPU_OID = utils::parseSnmpOid("1.3.6.1.4.1.1991.1.1.2.1.52.0");
+const utils::SnmpOid BROCADE_MEMORY_OID = utils::parseSnmpOid("1.3.6.1.4.1.1991.1.1.2.1.53.0");
+
+utils::SnmpQuery
+snmpGet(uint32_t ip, const utils::SnmpOid& oid)
+{
+    return {ip, utils::SnmpQuery::Kind::Get, {oid}};
+}
+
+// The first integer of @p response, or -1 when the agent gave none
+int
+snmpInteger(const utils::SnmpResponse& response)
+{
+    const auto value = response.integer();
+    return response.ok() && value ? static_cast<int>(*value) : -1;
+}
+
+// Whether switch @p vp is polled for @p metric this round: it is due, or @p previous has no
+// reading of it to keep. Otherwise that reading is copied to @p result.
+bool
+pollNow(const PollScheduler& scheduler,
+        PollMetric metric,
+        const VertexProperties& vp,
+        const DeviceMetrics& previous,
+        DeviceMetrics& result)
+{
+    const DeviceMetric* last = DeviceStatus::find(previous, vp.dpid);
+    if (last == nullptr || last->state != DeviceMetric::State::Ok ||
+        scheduler.due(metric, vp.ip.front()))
+    {
+        return true;
+    }
+    result.push_back(*last);
+    return false;
+}
+
+// Sort @p result by dpid; nullopt when it then equals @p previous
+std::optional<DeviceMetrics>
+changedReport(DeviceMetrics result, const DeviceMetrics& previous)
+{
+    std::sort(result.begin(), result.end(), [](const DeviceMetric& a, const DeviceMetric& b) {
+        return a.dpid < b.dpid;
+    });
+    if (result == previous)
+    {
+        return std::nullopt;
+    }
+    return result;
+}
+
+// {"<ip>": value} of the switches in @p metrics; @p unsupported describes the Unsupported ones
+json
+metricsByIpJson(const DeviceMetrics& metrics, const char* unsupported = "")
+{
+    json out = json::object();
+    for (const DeviceMetric& metric : metrics)
+    {
+        json& slot = out[utils::ipToString(metric.ip)];
+        switch (metric.state)
+        {
+        case DeviceMetric::State::Ok:
+            slot = metric.value;
+            break;
+        case DeviceMetric::State::Down:
+            slot = "The switch is down.";
+            break;
+        case DeviceMetric::State::Unsupported:
+            slot = unsupported;
+            break;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
 DeviceConfigurationAndPowerManager::DeviceConfigurationAndPowerManager(
     shared_ptr<TopologyAndFlowMonitor> topoMonitor,
     int mode,
@@ -41,15 +137,16 @@ DeviceConfigurationAndPowerManager::DeviceConfigurationAndPowerManager(
     shared_ptr<ndtClassifier::Classifier> classifier)
     : m_topologyAndFlowMonitor(std::move(topoMonitor)),
       m_mode(static_cast<utils::DeploymentMode>(mode)),
-      m_cachedPowerReport(nlohmann::json::array()),
-      m_cachedCpuReport(nlohmann::json::object()),
-      m_cachedMemoryReport(nlohmann::json::object()),
-      m_cachedTemperatureReport(nlohmann::json::object()),
+      m_smartPlugTable(std::make_shared<SmartPlugTable>()),
+      m_deviceStatus(std::make_shared<DeviceStatus>()),
+      m_cachedOpenFlowTables(std::make_shared<json>(json::array())),
       GW_IP(gwUrl),
       m_classifier(classifier)
 {
 }
 
+DeviceConfigurationAndPowerManager::~DeviceConfigurationAndPowerManager() = default;
+
 void
 DeviceConfigurationAndPowerManager::start()
 {
@@ -57,32 +154,55 @@ DeviceConfigurationAndPowerManager::start()
 
     if (m_mode == utils::DeploymentMode::TESTBED)
     {
-        fetchSmartPlugInfoFromFile(TOPOLOGY_FILE);
+        reloadSmartPlugTableIfChanged(topologyFile());
+        try
+        {
+            m_icmpProber = std::make_unique<utils::IcmpProber>();
+        }
+        catch (const std::system_error& e)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "No ICMP socket ({}), falling back to ping subprocesses",
+                               e.what());
+        }
     }
 
+    m_stop.reset();
     this->m_running.store(true);
-    m_pingThread = thread(&DeviceConfigurationAndPowerManager::pingWorker, this, 1);
-    m_statusUpdateThread = thread(&DeviceConfigurationAndPowerManager::statusUpdateWorker, this);
-    m_openflowTablesUpdateThread =
-        thread(&DeviceConfigurationAndPowerManager::openflowTablesUpdateWorker, this);
+    // Pings and polls block on the switches, so they run at low priority
+    auto& scheduler = utils::TaskScheduler::instance();
+    m_pingTask = scheduler.schedule(
+        "switch_liveness", utils::TaskPriority::Low, std::chrono::seconds(1), [this] {
+            pingWorker();
+        });
+    m_statusUpdateTask = scheduler.schedule(
+        "device_status",
+        utils::TaskPriority::Low,
+        std::chrono::milliseconds(POLL_SCHEDULER_MAX_SLEEP_MS),
+        [this] { statusUpdateWorker(); },
+        true);
+    m_openflowTablesUpdateTask = scheduler.schedule(
+        "openflow_tables",
+        utils::TaskPriority::Low,
+        std::chrono::milliseconds(POLL_SCHEDULER_MAX_SLEEP_MS),
+        [this] { openflowTablesUpdateWorker(); },
+        true);
 }
 
 void
 DeviceConfigurationAndPowerManager::stop()
 {
     this->m_running.store(false);
+    m_stop.request();
 
     SPDLOG_LOGGER_INFO(Logger::instance(), "Collector Stops");
 
-    if (m_pingThread.joinable())
-    {
-        m_pingThread.join();
-    }
-
-    if (m_statusUpdateThread.joinable())
-    {
-        m_statusUpdateThread.join();
-    }
+    auto& scheduler = utils::TaskScheduler::instance();
+    scheduler.cancel(m_pingTask);
+    scheduler.cancel(m_statusUpdateTask);
+    scheduler.cancel(m_openflowTablesUpdateTask.exchange(0));
+    m_pingTask = 0;
+    m_statusUpdateTask = 0;
 }
 
 std::string
@@ -125,39 +245,53 @@ json
 DeviceConfigurationAndPowerManager::queryTestbed(const std::string& ipParam) const
 {
     json result = json::object();
-    std::vector<SwitchInfo> toQuery;
+    const std::shared_ptr<const SmartPlugTable> plugs = getSmartPlugTable();
+    std::vector<const SwitchInfo*> toQuery;
 
     SPDLOG_LOGGER_INFO(Logger::instance(), "query testbed {}", ipParam);
 
     // 1. decide which switches to query
     if (ipParam.empty())
     {
-        toQuery = switchSmartPlugTable;
+        for (const SwitchInfo& si : plugs->switches)
+        {
+            toQuery.push_back(&si);
+        }
         SPDLOG_LOGGER_INFO(Logger::instance(), "toQuery size: {}", toQuery.size());
     }
     else
     {
-        auto it = std::find_if(switchSmartPlugTable.begin(),
-                               switchSmartPlugTable.end(),
-                               [&](auto& si) { return si.switchIp == ipParam; });
-        if (it == switchSmartPlugTable.end())
+        const SwitchInfo* si = plugs->findByIp(ipParam);
+        if (si == nullptr)
         {
             throw std::runtime_error("Unknown switch IP");
         }
-        toQuery.push_back(*it);
+        toQuery.push_back(si);
     }
 
-    // TODO: Do it parallelly
-    // 2. for each switch, call the Flask /relay proxy with resource=outlet
-    for (auto& si : toQuery)
+    // 2. for each switch, call the Flask /relay proxy with resource=outlet, all at once
+    std::vector<std::future<utils::HttpResponse>> pending;
+    pending.reserve(toQuery.size());
+    for (const SwitchInfo* si : toQuery)
+    {
+        pending.push_back(utils::HttpClient::instance().asyncRequest(
+            boost::beast::http::verb::get,
+            fmt::format("http://{}:8000/relay?ip={}&resource=outlet&index={}",
+                        GW_IP,
+                        si->plugIp,
+                        si->plugIdx)));
+    }
+    for (size_t i = 0; i < toQuery.size(); ++i)
     {
+        const SwitchInfo& si = *toQuery[i];
         try
         {
-            std::ostringstream cmd;
-            cmd << "curl -k -s -X GET " << "\"http://" << GW_IP << ":8000/relay"
-                << "?ip=" << si.plugIp << "&resource=outlet" << "&index=" << si.plugIdx << "\"";
-
-            std::string raw = utils::execCommand(cmd.str());
+            utils::HttpResponse response = pending[i].get();
+            if (response.error)
+            {
+                throw std::runtime_error(response.error.message());
+            }
+            const std::string& raw = response.body;
 
             std::string status;
             try
@@ -212,7 +346,8 @@ DeviceConfigurationAndPowerManager::queryMininet(const std::string& ipParam) con
 
     if (ipParam.empty())
     {
-        auto graph = m_topologyAndFlowMonitor->getGraph();
+        auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+        const Graph& graph = graphSnapshot->graph;
         for (auto v : boost::make_iterator_range(vertices(graph)))
         {
             if (graph[v].vertexType == VertexType::SWITCH)
@@ -265,10 +400,10 @@ DeviceConfigurationAndPowerManager::pingSwitch(const std::string& ip, int timeou
             return true;
         }
 
-        // If not last attempt, wait a bit before retrying
-        if (attempt < max_attempts)
+        // If not last attempt, wait a bit before retrying; shutting down ends the retries
+        if (attempt < max_attempts && !m_stop.waitFor(retry_delay))
         {
-            std::this_thread::sleep_for(retry_delay);
+            break;
         }
     }
 
@@ -276,90 +411,119 @@ DeviceConfigurationAndPowerManager::pingSwitch(const std::string& ip, int timeou
 }
 
 void
-DeviceConfigurationAndPowerManager::pingWorker(int interval_sec = 1)
+DeviceConfigurationAndPowerManager::pingWorker()
 {
-    while (m_running.load())
-    {
-        std::this_thread::sleep_for(std::chrono::seconds(interval_sec));
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
+    auto [vi, vi_end] = boost::vertices(graph);
 
-        Graph graph = m_topologyAndFlowMonitor->getGraph();
-        auto [vi, vi_end] = boost::vertices(graph);
+    if (m_mode == utils::DeploymentMode::TESTBED)
+    {
+        // Edits of the plug mapping take effect here, off the request path
+        reloadSmartPlugTableIfChanged(topologyFile());
 
-        std::vector<std::string> listOvsBridges;
-        if (m_mode == utils::DeploymentMode::MININET)
+        // Every address is probed at once, so a dead switch delays no other
+        std::vector<std::pair<Graph::vertex_descriptor, uint32_t>> targets;
+        std::vector<uint32_t> ips;
+        for (; vi != vi_end; ++vi)
         {
-            listOvsBridges = [&]() {
-                std::vector<std::string> bridges;
-                FILE* fp = popen("sudo ovs-vsctl list-br", "r");
-                if (!fp)
+            if (graph[*vi].vertexType == VertexType::SWITCH)
+            {
+                for (uint32_t ip : graph[*vi].ip)
                 {
-                    SPDLOG_LOGGER_ERROR(Logger::instance(), "Failed to run command");
-                    return bridges;
+                    targets.emplace_back(*vi, ip);
+                    ips.push_back(ip);
                 }
-
-                char buf[128];
-                while (fgets(buf, sizeof(buf), fp))
-                {
-                    std::string line(buf);
-                    // Trim trailing newline and whitespace
-                    line.erase(line.find_last_not_of(" \n\r\t") + 1);
-                    if (!line.empty())
-                    {
-                        bridges.push_back(line);
-                    }
-                }
-
-                pclose(fp);
-                return bridges;
-            }();
+            }
+        }
+        std::vector<char> alive(targets.size(), 0);
+        if (m_icmpProber)
+        {
+            const auto results = m_icmpProber->probe(ips);
+            for (size_t i = 0; i < results.size(); ++i)
+            {
+                alive[i] = results[i].alive;
+            }
+        }
+        else
+        {
+            utils::fanOut("pingWorker", targets.size(), [&](size_t i) {
+                alive[i] = pingSwitch(utils::ipToString(ips[i]), 5);
+            });
         }
 
-        for (; vi != vi_end; ++vi)
+        // Every result under one graph lock and version bump
+        auto transaction = m_topologyAndFlowMonitor->beginGraphTransaction();
+        for (size_t i = 0; i < targets.size(); ++i)
         {
-            auto v = *vi;
-            if (graph[v].vertexType == VertexType::SWITCH)
+            const auto v = targets[i].first;
+            if (!alive[i])
             {
-                if (m_mode == utils::DeploymentMode::TESTBED)
-                {
-                    vector<uint32_t> ipVector = graph[v].ip;
+                SPDLOG_LOGGER_DEBUG(Logger::instance(), "{} ping unreachable", graph[v].deviceName);
+                transaction.setVertexUp(v, false);
+                transaction.setVertexEnabled(v, false);
+                // TODO: Emit switch failed event
+            }
+            else
+            {
+                transaction.setVertexUp(v, true);
+                SPDLOG_LOGGER_TRACE(Logger::instance(), "{} ping reachable", graph[v].deviceName);
+            }
+        }
+        return;
+    }
 
-                    for (uint32_t ip : ipVector)
-                    {
-                        bool alive = pingSwitch(utils::ipToString(ip), 5);
-                        if (!alive)
-                        {
-                            SPDLOG_LOGGER_DEBUG(Logger::instance(),
-                                                "{} ping unreachable",
-                                                graph[v].deviceName);
-                            m_topologyAndFlowMonitor->setVertexDown(v);
-                            m_topologyAndFlowMonitor->setVertexDisable(v);
-                            // TODO: Emit switch failed event
-                        }
-                        else
-                        {
-                            m_topologyAndFlowMonitor->setVertexUp(v);
-                            SPDLOG_LOGGER_TRACE(Logger::instance(),
-                                                "{} ping reachable",
-                                                graph[v].deviceName);
-                        }
-                    }
-                }
-                else
+    std::vector<std::string> listOvsBridges;
+    if (m_mode == utils::DeploymentMode::MININET && utils::OvsdbMonitor::instance().start())
+    {
+        listOvsBridges = utils::OvsdbMonitor::instance().bridgeNames();
+    }
+    else if (m_mode == utils::DeploymentMode::MININET)
+    {
+        listOvsBridges = [&]() {
+            std::vector<std::string> bridges;
+            FILE* fp = popen("sudo ovs-vsctl list-br", "r");
+            if (!fp)
+            {
+                SPDLOG_LOGGER_ERROR(Logger::instance(), "Failed to run command");
+                return bridges;
+            }
+
+            char buf[128];
+            while (fgets(buf, sizeof(buf), fp))
+            {
+                std::string line(buf);
+                // Trim trailing newline and whitespace
+                line.erase(line.find_last_not_of(" \n\r\t") + 1);
+                if (!line.empty())
                 {
-                    std::string swName = graph[v].bridgeNameForMininet;
-                    if (std::find(listOvsBridges.begin(), listOvsBridges.end(), swName) !=
-                        listOvsBridges.end())
-                    {
-                        SPDLOG_LOGGER_DEBUG(Logger::instance(), "{} reachable", swName);
-                    }
-                    else
-                    {
-                        SPDLOG_LOGGER_DEBUG(Logger::instance(), "{} unreachable", swName);
-                        m_topologyAndFlowMonitor->setVertexDown(v);
-                        // TODO: Emit switch failed event
-                    }
+                    bridges.push_back(line);
                 }
             }
+
+            pclose(fp);
+            return bridges;
+        }();
+    }
+
+    auto transaction = m_topologyAndFlowMonitor->beginGraphTransaction();
+    for (; vi != vi_end; ++vi)
+    {
+        auto v = *vi;
+        if (graph[v].vertexType == VertexType::SWITCH)
+        {
+            std::string swName = graph[v].bridgeNameForMininet;
+            if (std::find(listOvsBridges.begin(), listOvsBridges.end(), swName) !=
+                listOvsBridges.end())
+            {
+                SPDLOG_LOGGER_DEBUG(Logger::instance(), "{} reachable", swName);
+            }
+            else
+            {
+                SPDLOG_LOGGER_DEBUG(Logger::instance(), "{} unreachable", swName);
+                transaction.setVertexUp(v, false);
+                // TODO: Emit switch failed event
+            }
         }
     }
 }
@@ -371,20 +535,24 @@ DeviceConfigurationAndPowerManager::setSwitchPowerState(std::string ip,
 {
     try
     {
-        // 1. Build curl POST command
-        //    -s           : silent
-        //    -X POST      : HTTP POST
-        //    -H "Host: …"
-        //    -H "User-Agent: …"
-        std::ostringstream cmd;
-        cmd << "curl -s -X POST " << "-H \"Host: 127.0.0.1\" "
-            << "-H \"User-Agent: Beast-C++-Client\" "
-            // Quote full URL so shell expands safely
-            << "\"http://" << GW_IP << ":8000/relay?ip=" << si.plugIp << "&index=" << si.plugIdx
-            << "&method=" << action << "\"";
-
-        // 2. Execute and grab raw HTML response
-        std::string raw = utils::execCommand(cmd.str());
+        // 1. POST to the relay
+        utils::HttpRequestOptions options;
+        options.headers = {{"Host", "127.0.0.1"}, {"User-Agent", "Beast-C++-Client"}};
+        utils::HttpResponse response = utils::HttpClient::instance().post(
+            fmt::format("http://{}:8000/relay?ip={}&index={}&method={}",
+                        GW_IP,
+                        si.plugIp,
+                        si.plugIdx,
+                        action),
+            {},
+            options);
+        if (response.error)
+        {
+            throw std::runtime_error(response.error.message());
+        }
+
+        // 2. Grab the raw HTML response
+        const std::string& raw = response.body;
 
         // 3. Extract status text between the 2nd '>' and next '<'
         std::string status = raw;
@@ -432,67 +600,68 @@ DeviceConfigurationAndPowerManager::setSwitchPowerState(std::string ip,
     }
 }
 
-json
-DeviceConfigurationAndPowerManager::fetchMemoryReportInternal()
+std::optional<DeviceMetrics>
+DeviceConfigurationAndPowerManager::fetchMemoryReportInternal(const DeviceMetrics& previous)
 {
-    nlohmann::json result_json;
-    Graph graph = m_topologyAndFlowMonitor->getGraph();
+    DeviceMetrics result;
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
 
+    // Every due switch is queried at once; the answers are filled in below
+    std::vector<size_t> queried; // entries of result
+    std::vector<utils::SnmpQuery> queries;
     for (auto v : boost::make_iterator_range(vertices(graph)))
     {
         const auto& vp = graph[v];
-        if (vp.vertexType != VertexType::SWITCH || !vp.isUp)
+        if (vp.vertexType != VertexType::SWITCH || !vp.isUp ||
+            !pollNow(m_pollScheduler, PollMetric::Memory, vp, previous, result))
         {
             continue;
         }
-
-        std::string ip_str = utils::ipToString(vp.ip.front());
-        int memory = -1;
-
+        result.push_back({vp.dpid, vp.ip.front()});
         if (m_mode == utils::DeploymentMode::MININET)
         {
             // dummy between 10 and 59
-            memory = 10 + (std::hash<std::string>{}(ip_str) % 50);
-        }
-        else if (vp.brandName == "HPE5520")
-        {
-            auto cmd = fmt::format("snmpget -v2c -c public {} 1.3.6.1.4.1.25506.2.6.1.1.1.1.8.212",
-                                   ip_str);
-            std::string snmp_result = utils::execCommand(cmd);
-
-            static const std::regex re(R"(INTEGER:\s*(\d+))");
-            std::smatch match;
-            if (std::regex_search(snmp_result, match, re))
-            {
-                memory = std::stoi(match[1]);
-            }
-        }
-        else
-        {
-            auto cmd =
-                fmt::format("snmpget -v2c -c public {} 1.3.6.1.4.1.1991.1.1.2.1.53.0", ip_str);
-
-            std::string snmp_result = utils::execCommand(cmd);
-
-            std::smatch match;
-            static const std::regex regex(R"(Gauge32:\s*(\d+))");
-            if (std::regex_search(snmp_result, match, regex))
-            {
-                memory = std::stoi(match[1]);
-            }
+            const std::string ip_str = utils::ipToString(vp.ip.front());
+            result.back().value = 10 + (std::hash<std::string>{}(ip_str) % 50);
+            m_pollScheduler.report(PollMetric::Memory, vp.ip.front(), true);
+            continue;
         }
-
-        result_json[ip_str] = memory;
+        queries.push_back(snmpGet(vp.ip.front(),
+                                  vp.brandName == "HPE5520" ? HPE_MEMORY_OID : BROCADE_MEMORY_OID));
+        queried.push_back(result.size() - 1);
     }
 
-    return result_json;
+    auto responses = utils::SnmpClient::instance().query(std::move(queries));
+    for (size_t i = 0; i < responses.size(); ++i)
+    {
+        DeviceMetric& metric = result[queried[i]];
+        metric.value = snmpInteger(responses[i]);
+        m_pollScheduler.report(PollMetric::Memory, metric.ip, responses[i].ok());
+    }
+    return changedReport(std::move(result), previous);
 }
 
-json
-DeviceConfigurationAndPowerManager::fetchOpenFlowTablesInternal()
+DeviceConfigurationAndPowerManager::FlowStatsResponses
+DeviceConfigurationAndPowerManager::fetchOpenFlowTablesInternal(std::vector<uint64_t>& upDpids)
 {
-    nlohmann::json result = nlohmann::json::array();
-    auto graph = m_topologyAndFlowMonitor->getGraph();
+    // Every due switch is queried at once over the shared HTTP client. The flow stats are
+    // collected in the order they arrive, and whatever has arrived is fed to the classifier
+    // while the slower switches are still answering; each switch once per poll.
+    struct Arrivals
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::pair<uint64_t, utils::HttpResponse>> flows;
+    };
+    auto arrivals = std::make_shared<Arrivals>();
+    std::vector<std::pair<uint64_t, std::future<utils::HttpResponse>>> pendingGroups;
+    auto& http = utils::HttpClient::instance();
+
+    FlowStatsResponses result;
+    nlohmann::json groups = nlohmann::json::array();
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
 
     for (auto v : boost::make_iterator_range(vertices(graph)))
     {
@@ -501,34 +670,126 @@ DeviceConfigurationAndPowerManager::fetchOpenFlowTablesInternal()
         {
             continue;
         }
+        upDpids.push_back(props.dpid);
+        if (!m_pollScheduler.due(PollMetric::OpenFlowTables, props.dpid))
+        {
+            continue;
+        }
 
+        // Flow entries, and group descriptions so the classifier can resolve GROUP actions
         uint64_t dpid = props.dpid;
-        std::string cmd =
-            fmt::format("curl -s -X GET http://{}/stats/flow/{}", AppConfig::RYU_IP_AND_PORT, dpid);
-
+        std::string flowUrl = fmt::format("http://{}/stats/flow/{}", ryuAddressFor(dpid), dpid);
+        std::string groupUrl =
+            fmt::format("http://{}/stats/groupdesc/{}", ryuAddressFor(dpid), dpid);
         SPDLOG_LOGGER_INFO(spdlog::default_logger(),
                            "DeviceManager: querying switch {} -> `{}`",
                            dpid,
-                           cmd);
+                           flowUrl);
+        http.asyncRequest(boost::beast::http::verb::get,
+                          flowUrl,
+                          {},
+                          [arrivals, dpid](utils::HttpResponse response) {
+                              {
+                                  std::lock_guard<std::mutex> lock(arrivals->mutex);
+                                  arrivals->flows.emplace_back(dpid, std::move(response));
+                              }
+                              arrivals->cv.notify_one();
+                          });
+        pendingGroups.emplace_back(dpid,
+                                   http.asyncRequest(boost::beast::http::verb::get, groupUrl));
+    }
 
-        std::string raw = utils::execCommand(cmd);
-        SPDLOG_LOGGER_TRACE(spdlog::default_logger(),
-                            "DeviceManager: raw response for {}: {}",
-                            dpid,
-                            raw);
+    std::vector<std::pair<uint64_t, utils::HttpResponse>> arrived;
+    for (size_t received = 0; received < pendingGroups.size(); received += arrived.size())
+    {
+        arrived.clear();
+        {
+            std::unique_lock<std::mutex> lock(arrivals->mutex);
+            arrivals->cv.wait(lock, [&] { return !arrivals->flows.empty(); });
+            arrived.swap(arrivals->flows);
+        }
 
-        // TODO[DEBUG]: parseFlowStatsTextToJson may throw; let caller handle exceptions
-        nlohmann::json flows = parseFlowStatsTextToJson(raw);
+        FlowStatsResponses fresh;
+        for (auto& [dpid, flows] : arrived)
+        {
+            // A switch that did not answer keeps its last table, and is polled again after a
+            // backoff
+            m_pollScheduler.report(PollMetric::OpenFlowTables, dpid, flows.ok());
+            if (!flows.ok())
+            {
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "DeviceManager: flow stats of switch {} failed ({}, status {})",
+                                   dpid,
+                                   flows.error.message(),
+                                   flows.status);
+                continue;
+            }
+            SPDLOG_LOGGER_TRACE(spdlog::default_logger(),
+                                "DeviceManager: raw response for {}: {}",
+                                dpid,
+                                flows.body);
+            fresh.emplace_back(dpid, std::move(flows.body));
+        }
 
-        result.push_back({{"dpid", dpid}, {"flows", flows}});
+        // The classifier streams the raw responses; the JSON of getOpenFlowTables() is only
+        // built when someone asks for it
+        m_classifier->updateFromFlowStatsText(fresh);
+        std::move(fresh.begin(), fresh.end(), std::back_inserter(result));
+    }
 
-        // TODO: Test Classifier
-        m_classifier->updateFromQueriedTables(result);
+    for (auto& [dpid, pending] : pendingGroups)
+    {
+        nlohmann::json groupDescs = parseFlowStatsTextToJson(pending.get().body);
+        // Ryu answers {"<dpid>": [...]}; anything else is a failed query, not "no groups"
+        if (groupDescs.is_object())
+        {
+            groups.push_back({{"dpid", dpid}, {"groups", groupDescs}});
+        }
     }
+    m_classifier->updateGroupsFromQueriedTables(groups);
 
     return result;
 }
 
+void
+DeviceConfigurationAndPowerManager::materializeOpenFlowTablesNoLock()
+{
+    if (!m_openflowTablesStale)
+    {
+        return;
+    }
+    json& tables = mutableOpenFlowTablesNoLock();
+    // Each poll covers only the switches that were due; the others keep their entry
+    for (const auto& [dpid, raw] : m_cachedFlowStats)
+    {
+        json entry{{"dpid", dpid}, {"flows", parseFlowStatsTextToJson(raw)}};
+        auto it = std::find_if(tables.begin(), tables.end(), [dpid = dpid](const json& sw) {
+            return sw.at("dpid").get<uint64_t>() == dpid;
+        });
+        if (it != tables.end())
+        {
+            *it = std::move(entry);
+        }
+        else
+        {
+            tables.push_back(std::move(entry));
+        }
+    }
+    m_cachedFlowStats.clear();
+    m_openflowTablesStale = false;
+}
+
+json&
+DeviceConfigurationAndPowerManager::mutableOpenFlowTablesNoLock()
+{
+    // Readers only take a reference under the lock, so nobody can start sharing it now
+    if (m_cachedOpenFlowTables.use_count() > 1)
+    {
+        m_cachedOpenFlowTables = std::make_shared<json>(*m_cachedOpenFlowTables);
+    }
+    return *m_cachedOpenFlowTables;
+}
+
 json
 DeviceConfigurationAndPowerManager::parseFlowStatsTextToJson(const std::string& responseText) const
 {
@@ -608,16 +869,29 @@ DeviceConfigurationAndPowerManager::parseFlowStatsTextToJson(const std::string&
 //     }
 // }
 
-json
-DeviceConfigurationAndPowerManager::fetchPowerReportInternal()
+std::optional<DeviceMetrics>
+DeviceConfigurationAndPowerManager::fetchPowerReportInternal(const DeviceMetrics& previous)
 {
-    nlohmann::json result = nlohmann::json::array();
+    DeviceMetrics result;
 
     // Prepare RNG for MININET
     static std::mt19937_64 gen{std::random_device{}()};
     static std::uniform_int_distribution<uint64_t> dis(0, UINT64_MAX >> 4);
 
-    auto graph = m_topologyAndFlowMonitor->getGraph();
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
+
+    // Due HPE switches are walked over SNMP and the others read over SSH after the loop, all
+    // at once; these are their entries
+    struct PowerTarget
+    {
+        size_t entry;
+        uint32_t ip;
+        std::string ipStr;
+    };
+    std::vector<PowerTarget> snmpTargets;
+    std::vector<utils::SnmpQuery> queries;
+    std::vector<PowerTarget> sshTargets;
     for (auto v : boost::make_iterator_range(vertices(graph)))
     {
         const auto& props = graph[v];
@@ -629,7 +903,13 @@ DeviceConfigurationAndPowerManager::fetchPowerReportInternal()
         }
         else if (!props.isUp)
         {
-            result.push_back({{"dpid", dpid}, {"power_consumed", 0}});
+            result.push_back({dpid, props.ip.front(), 0, DeviceMetric::State::Down});
+            continue;
+        }
+
+        // Not due, or backing off: keep the last reading
+        if (!pollNow(m_pollScheduler, PollMetric::Power, props, previous, result))
+        {
             continue;
         }
 
@@ -637,10 +917,10 @@ DeviceConfigurationAndPowerManager::fetchPowerReportInternal()
         {
             // fake/demo value
             power_mW = dis(gen);
+            m_pollScheduler.report(PollMetric::Power, props.ip.front(), true);
         }
         else if (m_mode == utils::DeploymentMode::TESTBED)
         {
-            const std::string username = "admin";
             std::string ip_str = utils::ipToString(props.ip.front());
 
             SPDLOG_INFO("Getting power report from DPID {} at IP {}", dpid, ip_str);
@@ -648,41 +928,53 @@ DeviceConfigurationAndPowerManager::fetchPowerReportInternal()
             // hpe switch
             if (props.brandName == "HPE5520")
             {
-                auto cmd =
-                    fmt::format("snmpwalk -v2c -c public {} 1.3.6.1.4.1.25506.8.35.9.1.1.1.6",
-                                ip_str);
-                std::string snmp_result = utils::execCommand(cmd);
-
-                static const std::regex re(R"(INTEGER:\s*(\d+))");
-                std::smatch match;
-                if (std::regex_search(snmp_result, match, re))
-                {
-                    power_mW = std::stoi(match[1]);
-                }
-                SPDLOG_DEBUG("Get HPE switch power ip{} power{}", ip_str, power_mW);
+                snmpTargets.push_back({result.size(), props.ip.front(), std::move(ip_str)});
+                queries.push_back(
+                    {props.ip.front(), utils::SnmpQuery::Kind::Walk, {HPE_POWER_TABLE_OID}});
             }
             // brocade
             else
             {
-                std::string raw = getPowerReportViaSsh(ip_str, username);
-                power_mW = parsePowerOutput(raw);
-                if (power_mW == 0 && !raw.empty())
-                {
-                    SPDLOG_WARN("Could not parse power value from raw: {}", raw);
-                }
-                else if (raw.empty())
-                {
-                    SPDLOG_WARN("Empty SSH output for {}", ip_str);
-                }
-
-                SPDLOG_DEBUG("Brocade Switch Raw SSH output for {}: {}", ip_str, raw);
+                sshTargets.push_back({result.size(), props.ip.front(), std::move(ip_str)});
             }
         }
 
-        result.push_back({{"dpid", dpid}, {"power_consumed", power_mW}});
+        result.push_back({dpid, props.ip.front(), static_cast<int64_t>(power_mW)});
     }
 
-    return result;
+    std::vector<uint64_t> sshPower(sshTargets.size(), 0);
+    utils::fanOut("fetchPowerReportInternal", sshTargets.size(), [&](size_t i) {
+        const std::string& ip_str = sshTargets[i].ipStr;
+        std::string raw = getPowerReportViaSsh(ip_str, "admin");
+        m_pollScheduler.report(PollMetric::Power, sshTargets[i].ip, !raw.empty());
+        sshPower[i] = parsePowerOutput(raw);
+        if (sshPower[i] == 0 && !raw.empty())
+        {
+            SPDLOG_WARN("Could not parse power value from raw: {}", raw);
+        }
+        else if (raw.empty())
+        {
+            SPDLOG_WARN("Empty SSH output for {}", ip_str);
+        }
+
+        SPDLOG_DEBUG("Brocade Switch Raw SSH output for {}: {}", ip_str, raw);
+    });
+    for (size_t i = 0; i < sshTargets.size(); ++i)
+    {
+        result[sshTargets[i].entry].value = static_cast<int64_t>(sshPower[i]);
+    }
+
+    auto responses = utils::SnmpClient::instance().query(std::move(queries));
+    for (size_t i = 0; i < responses.size(); ++i)
+    {
+        // The first entry of the power table, as snmpwalk printed it first
+        const int power_mW = std::max(snmpInteger(responses[i]), 0);
+        m_pollScheduler.report(PollMetric::Power, snmpTargets[i].ip, responses[i].ok());
+        DeviceMetric& entry = result[snmpTargets[i].entry];
+        entry.value = power_mW;
+        SPDLOG_DEBUG("Get HPE switch power dpid{} power{}", entry.dpid, power_mW);
+    }
+    return changedReport(std::move(result), previous);
 }
 
 bool
@@ -692,16 +984,15 @@ DeviceConfigurationAndPowerManager::setSwitchPowerState(const std::string& ip,
     if (m_mode == utils::DeploymentMode::TESTBED)
     {
         // find the SwitchInfo entry
-        auto it = std::find_if(switchSmartPlugTable.begin(),
-                               switchSmartPlugTable.end(),
-                               [&](const auto& si) { return si.switchIp == ip; });
-        if (it == switchSmartPlugTable.end())
+        const std::shared_ptr<const SmartPlugTable> plugs = getSmartPlugTable();
+        const SwitchInfo* si = plugs->findByIp(ip);
+        if (si == nullptr)
         {
             SPDLOG_LOGGER_DEBUG(Logger::instance(), "switch not found {}", ip);
             return false;
         }
 
-        return setPowerStateTestbed(*it, action);
+        return setPowerStateTestbed(*si, action);
     }
     else if (m_mode == utils::DeploymentMode::MININET)
     {
@@ -724,19 +1015,18 @@ DeviceConfigurationAndPowerManager::setPowerStateTestbed(const SwitchInfo& si,
     //   resource = "outlet"   (or "bank"/"device" if you extend SwitchInfo)
     //   index    = the plug number
     //   method   = action
-    auto cmd = fmt::format("curl -s -X POST "
-                           "\"http://{}:8000/relay"
+    auto url = fmt::format("http://{}:8000/relay"
                            "?ip={}"
                            "&resource=outlet"
                            "&index={}"
-                           "&method={}\"",
+                           "&method={}",
                            GW_IP,
                            si.plugIp,
                            si.plugIdx,
                            action);
 
-    int rc = std::system(cmd.c_str());
-    return rc == 0;
+    // Like curl's exit status: the relay was reached, whatever it answered
+    return !utils::HttpClient::instance().post(url, {}).error;
 }
 
 bool
@@ -749,10 +1039,11 @@ DeviceConfigurationAndPowerManager::setPowerStateMininet(uint32_t ipUint, const
     }
     else
     {
-        SPDLOG_LOGGER_DEBUG(Logger::instance(), "ipUint {}", utils::ipToString(ipUint));
+        SPDLOG_LOGGER_DEBUG(Logger::instance(), "ipUint {}", utils::Ipv4{ipUint});
     }
 
-    auto g = m_topologyAndFlowMonitor->getGraph();
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& g = graphSnapshot->graph;
     auto node = nodeOpt.value();
     const std::string swName = g[node].bridgeNameForMininet;
     auto dpid = g[node].dpid;
@@ -830,114 +1121,101 @@ DeviceConfigurationAndPowerManager::setPowerStateMininet(uint32_t ipUint, const
     return true;
 }
 
-json
-DeviceConfigurationAndPowerManager::fetchCpuReportInternal()
+std::optional<DeviceMetrics>
+DeviceConfigurationAndPowerManager::fetchCpuReportInternal(const DeviceMetrics& previous)
 {
-    nlohmann::json result;
-    auto graph = m_topologyAndFlowMonitor->getGraph();
+    DeviceMetrics result;
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
 
+    // Every due switch is queried at once; the answers are filled in below
+    std::vector<size_t> queried; // entries of result
+    std::vector<utils::SnmpQuery> queries;
     for (auto v : boost::make_iterator_range(vertices(graph)))
     {
         const auto& vp = graph[v];
-        if (vp.vertexType != VertexType::SWITCH || !vp.isUp)
+        if (vp.vertexType != VertexType::SWITCH || !vp.isUp ||
+            !pollNow(m_pollScheduler, PollMetric::Cpu, vp, previous, result))
         {
             continue;
         }
-
-        std::string ip_str = utils::ipToString(vp.ip.front());
-        int cpu = -1;
-
+        result.push_back({vp.dpid, vp.ip.front()});
         if (m_mode == utils::DeploymentMode::MININET)
         {
             // dummy: 10–59
-            cpu = 10 + (std::hash<std::string>{}(ip_str) % 50);
-        }
-        else if (vp.brandName == "HPE5520")
-        {
-            auto cmd = fmt::format("snmpget -v2c -c public {} 1.3.6.1.4.1.25506.2.6.1.1.1.1.6.212",
-                                   ip_str);
-            std::string snmp_result = utils::execCommand(cmd);
-
-            static const std::regex re(R"(INTEGER:\s*(\d+))");
-            std::smatch match;
-            if (std::regex_search(snmp_result, match, re))
-            {
-                cpu = std::stoi(match[1]);
-            }
-        }
-        else
-        {
-            // SNMP OID for CPU (Brocade ICX 7250)
-            auto cmd =
-                fmt::format("snmpget -v2c -c public {} 1.3.6.1.4.1.1991.1.1.2.1.52.0", ip_str);
-            std::string snmp_result = utils::execCommand(cmd);
-
-            static const std::regex re(R"(Gauge32:\s*(\d+))");
-            std::smatch match;
-            if (std::regex_search(snmp_result, match, re))
-            {
-                cpu = std::stoi(match[1]);
-            }
+            const std::string ip_str = utils::ipToString(vp.ip.front());
+            result.back().value = 10 + (std::hash<std::string>{}(ip_str) % 50);
+            m_pollScheduler.report(PollMetric::Cpu, vp.ip.front(), true);
+            continue;
         }
-
-        result[ip_str] = cpu;
+        queries.push_back(
+            snmpGet(vp.ip.front(), vp.brandName == "HPE5520" ? HPE_CPU_OID : BROCADE_CPU_OID));
+        queried.push_back(result.size() - 1);
     }
 
-    return result;
+    auto responses = utils::SnmpClient::instance().query(std::move(queries));
+    for (size_t i = 0; i < responses.size(); ++i)
+    {
+        DeviceMetric& metric = result[queried[i]];
+        metric.value = snmpInteger(responses[i]);
+        m_pollScheduler.report(PollMetric::Cpu, metric.ip, responses[i].ok());
+    }
+    return changedReport(std::move(result), previous);
 }
 
-json
-DeviceConfigurationAndPowerManager::fetchTemperatureReportInternal()
+std::optional<DeviceMetrics>
+DeviceConfigurationAndPowerManager::fetchTemperatureReportInternal(const DeviceMetrics& previous)
 {
-    nlohmann::json result;
-    auto graph = m_topologyAndFlowMonitor->getGraph();
+    DeviceMetrics result;
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
 
+    // Every due switch is queried at once; the answers are filled in below
+    std::vector<size_t> queried; // entries of result
+    std::vector<utils::SnmpQuery> queries;
     for (auto v : boost::make_iterator_range(vertices(graph)))
     {
         const auto& vp = graph[v];
-
-        std::string ip_str = utils::ipToString(vp.ip.front());
         if (vp.vertexType != VertexType::SWITCH)
         {
             continue;
         }
         else if (!vp.isUp)
         {
-            result[ip_str] = "The switch is down.";
+            result.push_back({vp.dpid, vp.ip.front(), -1, DeviceMetric::State::Down});
             continue;
         }
         else if (vp.brandName != "HPE5520" && m_mode != utils::DeploymentMode::MININET)
         {
-            result[ip_str] = "The temperature function only supports the HPE 5520.";
+            result.push_back({vp.dpid, vp.ip.front(), -1, DeviceMetric::State::Unsupported});
             continue;
         }
-
-        int temp = -1; // Temperature in Celsius
-
-        if (m_mode == utils::DeploymentMode::MININET)
+        else if (!pollNow(m_pollScheduler, PollMetric::Temperature, vp, previous, result))
         {
-            // Dummy value for Mininet simulation: 25–49°C
-            temp = 25 + (std::hash<std::string>{}(ip_str) % 25);
+            continue;
         }
-        else
+        result.push_back({vp.dpid, vp.ip.front()});
+        if (m_mode == utils::DeploymentMode::MININET)
         {
-            auto cmd = fmt::format("snmpget -v2c -c public {} 1.3.6.1.4.1.25506.2.6.1.1.1.1.12.212",
-                                   ip_str);
-            std::string snmp_result = utils::execCommand(cmd);
-
-            // The regex for parsing an INTEGER response
-            static const std::regex re(R"(INTEGER:\s*(\d+))");
-            std::smatch match;
-            if (std::regex_search(snmp_result, match, re))
-            {
-                temp = std::stoi(match[1]);
-            }
+            // Dummy value for Mininet simulation: 25–49°C
+            const std::string ip_str = utils::ipToString(vp.ip.front());
+            result.back().value = 25 + (std::hash<std::string>{}(ip_str) % 25);
+            m_pollScheduler.report(PollMetric::Temperature, vp.ip.front(), true);
+            continue;
         }
-
-        result[ip_str] = temp;
+        queries.push_back(snmpGet(vp.ip.front(), HPE_TEMPERATURE_OID));
+        queried.push_back(result.size() - 1);
     }
 
-    return result;
+    // Temperature in Celsius, -1 when unknown
+    auto responses = utils::SnmpClient::instance().query(std::move(queries));
+    for (size_t i = 0; i < responses.size(); ++i)
+    {
+        DeviceMetric& metric = result[queried[i]];
+        metric.value = snmpInteger(responses[i]);
+        m_pollScheduler.report(PollMetric::Temperature, metric.ip, responses[i].ok());
+    }
+    return changedReport(std::move(result), previous);
 }
 
 void
@@ -952,36 +1230,89 @@ DeviceConfigurationAndPowerManager::fetchSmartPlugInfoFromFile(const std::string
 
     SPDLOG_LOGGER_INFO(Logger::instance(), "Load Static Topology File from {}", path);
 
-    json j;
-    file >> j;
-
-    // Add nodes
-    for (const auto& nodeJson : j["nodes"])
+    auto table = std::make_shared<SmartPlugTable>();
+    try
     {
-        // VertexProperties vp = nodeJson.get<VertexProperties>();
-        // Custom extraction (like from_json function)
-        VertexProperties vp;
-        vp.vertexType = static_cast<VertexType>(nodeJson.at("vertex_type").get<int>());
-        vp.ip = utils::ipStringVecToUint32Vec(nodeJson.at("ip").get<std::vector<std::string>>());
+        json j;
+        file >> j;
 
-        if (vp.vertexType == VertexType::SWITCH and m_mode == utils::DeploymentMode::TESTBED)
+        // Add nodes
+        for (const auto& nodeJson : j.at("nodes"))
         {
-            if (vp.ip.empty())
+            const auto vertexType = static_cast<VertexType>(nodeJson.at("vertex_type").get<int>());
+            if (vertexType != VertexType::SWITCH || m_mode != utils::DeploymentMode::TESTBED)
+            {
+                continue;
+            }
+            const auto ips =
+                utils::ipStringVecToUint32Vec(nodeJson.at("ip").get<std::vector<std::string>>());
+            if (ips.empty())
             {
                 SPDLOG_LOGGER_WARN(Logger::instance(), "vertex has no ip");
                 continue;
             }
-            string swIpStr = utils::ipToString(vp.ip.front());
-            string smartPlugIpStr = nodeJson.at("smart_plug_ip").get<std::string>();
-            int smartPlugOutLet = nodeJson.at("smart_plug_outlet").get<int>();
-            switchSmartPlugTable.emplace_back(swIpStr, smartPlugIpStr, smartPlugOutLet);
+            SwitchInfo si{utils::ipToString(ips.front()),
+                          nodeJson.at("smart_plug_ip").get<std::string>(),
+                          nodeJson.at("smart_plug_outlet").get<int>(),
+                          nodeJson.value("dpid", uint64_t{0})};
             SPDLOG_LOGGER_INFO(Logger::instance(),
                                "Load Smart Plug Info {} {} {}",
-                               swIpStr,
-                               smartPlugIpStr,
-                               smartPlugOutLet);
+                               si.switchIp,
+                               si.plugIp,
+                               si.plugIdx);
+            table->byIp[si.switchIp] = table->switches.size();
+            if (si.dpid != 0)
+            {
+                table->byDpid[si.dpid] = table->switches.size();
+            }
+            table->switches.push_back(std::move(si));
         }
     }
+    catch (const std::exception& e)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(),
+                            "Cannot load the smart plugs from {}, keeping the last ones: {}",
+                            path,
+                            e.what());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_smartPlugMutex);
+    m_smartPlugTable = std::move(table);
+}
+
+void
+DeviceConfigurationAndPowerManager::reloadSmartPlugTableIfChanged(const std::string& path)
+{
+    std::error_code ec;
+    const auto modified = std::filesystem::last_write_time(path, ec);
+    if (ec || modified == m_smartPlugFileTime)
+    {
+        return;
+    }
+    m_smartPlugFileTime = modified;
+    fetchSmartPlugInfoFromFile(path);
+}
+
+const SwitchInfo*
+SmartPlugTable::findByIp(const std::string& ip) const
+{
+    auto it = byIp.find(ip);
+    return it != byIp.end() ? &switches[it->second] : nullptr;
+}
+
+const SwitchInfo*
+SmartPlugTable::findByDpid(uint64_t dpid) const
+{
+    auto it = byDpid.find(dpid);
+    return it != byDpid.end() ? &switches[it->second] : nullptr;
+}
+
+std::shared_ptr<const SmartPlugTable>
+DeviceConfigurationAndPowerManager::getSmartPlugTable() const
+{
+    std::lock_guard<std::mutex> lock(m_smartPlugMutex);
+    return m_smartPlugTable;
 }
 
 nlohmann::json
@@ -991,7 +1322,8 @@ DeviceConfigurationAndPowerManager::getSingleSwitchPowerReport(const std::string
     static std::mt19937_64 gen{std::random_device{}()};
     static std::uniform_int_distribution<uint64_t> dis(0, UINT64_MAX >> 4);
 
-    auto graph = m_topologyAndFlowMonitor->getGraph();
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
 
     // Helper lambda to calculate power for a single switch's properties.
     auto calculate_power_for_switch = [&](const auto& props,
@@ -1010,17 +1342,9 @@ DeviceConfigurationAndPowerManager::getSingleSwitchPowerReport(const std::string
             if (props.brandName == "HPE5520")
             {
                 // HPE switch (SNMP)
-                auto cmd =
-                    fmt::format("snmpwalk -v2c -c public {} 1.3.6.1.4.1.25506.8.35.9.1.1.1.6",
-                                ip_str);
-                std::string snmp_result = utils::execCommand(cmd);
-
-                static const std::regex re(R"(INTEGER:\s*(\d+))");
-                std::smatch match;
-                if (std::regex_search(snmp_result, match, re))
-                {
-                    power_mW = std::stoi(match[1]);
-                }
+                auto responses = utils::SnmpClient::instance().query(
+                    {{props.ip.front(), utils::SnmpQuery::Kind::Walk, {HPE_POWER_TABLE_OID}}});
+                power_mW = std::max(snmpInteger(responses.front()), 0);
                 SPDLOG_DEBUG("Get HPE switch power ip{} power{}", ip_str, power_mW);
             }
             else
@@ -1071,7 +1395,8 @@ json
 DeviceConfigurationAndPowerManager::getSingleSwitchCpuReport(const std::string& deviceIdentifier)
 {
     nlohmann::json result;
-    auto graph = m_topologyAndFlowMonitor->getGraph();
+    auto graphSnapshot = m_topologyAndFlowMonitor->getGraphSnapshot();
+    const Graph& graph = graphSnapshot->graph;
     int cpu = -1;
 
     // --- FIX 1: Use a pointer instead of std::optional<T&> ---
@@ -1109,29 +1434,12 @@ DeviceConfigurationAndPowerManager::getSingleSwitchCpuReport(const std::string&
     {
         cpu = 10 + (std::hash<std::string>{}(deviceIdentifier) % 50);
     }
-    else if (targetSwitch->brandName == "HPE5520")
-    {
-        auto cmd = fmt::format("snmpget -v2c -c public {} 1.3.6.1.4.1.25506.2.6.1.1.1.1.6.212",
-                               deviceIdentifier);
-        std::string snmp_result = utils::execCommand(cmd);
-        static const std::regex re(R"(INTEGER:\s*(\d+))");
-        std::smatch match;
-        if (std::regex_search(snmp_result, match, re))
-        {
-            cpu = std::stoi(match[1]);
-        }
-    }
     else
     {
-        auto cmd = fmt::format("snmpget -v2c -c public {} 1.3.6.1.4.1.1991.1.1.2.1.52.0",
-                               deviceIdentifier);
-        std::string snmp_result = utils::execCommand(cmd);
-        static const std::regex re(R"(Gauge32:\s*(\d+))");
-        std::smatch match;
-        if (std::regex_search(snmp_result, match, re))
-        {
-            cpu = std::stoi(match[1]);
-        }
+        auto responses = utils::SnmpClient::instance().query(
+            {snmpGet(targetSwitch->ip.front(),
+                     targetSwitch->brandName == "HPE5520" ? HPE_CPU_OID : BROCADE_CPU_OID)});
+        cpu = snmpInteger(responses.front());
     }
     return {{"dpid", targetSwitch->dpid}, {"cpu_usage", cpu}};
 }
@@ -1139,114 +1447,260 @@ DeviceConfigurationAndPowerManager::getSingleSwitchCpuReport(const std::string&
 void
 DeviceConfigurationAndPowerManager::statusUpdateWorker()
 {
-    // Main update loop
-    while (m_running.load())
+    static utils::Histogram& cycle = utils::pollerCycleHistogram("device_status");
+    const auto cycleStart = std::chrono::steady_clock::now();
+    try
     {
-        try
-        {
-            // 1. Fetch new data (SLOW part, no lock held)
-            json newPower = fetchPowerReportInternal();
-            json newCpu = fetchCpuReportInternal();
-            json newMemory = fetchMemoryReportInternal();
-            json newTemp = fetchTemperatureReportInternal();
+        // Runs of this task never overlap, so the snapshot cannot change under it
+        const std::shared_ptr<const DeviceStatus> previous = getDeviceStatus();
+
+        // 1. Fetch new data (SLOW part, no lock held), the four reports at once; each polls
+        //    only its due switches and keeps the previous readings of the others
+        using Fetch = std::optional<DeviceMetrics> (DeviceConfigurationAndPowerManager::*)(
+            const DeviceMetrics&);
+        const std::array<Fetch, 4> fetches{
+            &DeviceConfigurationAndPowerManager::fetchPowerReportInternal,
+            &DeviceConfigurationAndPowerManager::fetchCpuReportInternal,
+            &DeviceConfigurationAndPowerManager::fetchMemoryReportInternal,
+            &DeviceConfigurationAndPowerManager::fetchTemperatureReportInternal};
+        const std::array<const DeviceMetrics*, 4> last{
+            &previous->power, &previous->cpu, &previous->memory, &previous->temperature};
+        std::array<std::optional<DeviceMetrics>, 4> fresh;
+        utils::fanOut("statusUpdateWorker", fetches.size(), [&](size_t i) {
+            fresh[i] = (this->*fetches[i])(*last[i]);
+        });
 
-            // 2. Lock and update caches (FAST part)
+        // 2. Publish a new snapshot (FAST part); a report that did not change, or whose
+        //    fetch threw, keeps its previous readings
+        if (fresh[0] || fresh[1] || fresh[2] || fresh[3])
+        {
+            auto status = std::make_shared<DeviceStatus>(*previous);
+            const std::array<DeviceMetrics*, 4> reports{
+                &status->power, &status->cpu, &status->memory, &status->temperature};
+            for (size_t i = 0; i < reports.size(); ++i)
             {
-                std::lock_guard<std::shared_mutex> lock(m_statusMutex);
-                m_cachedPowerReport = std::move(newPower);
-                m_cachedCpuReport = std::move(newCpu);
-                m_cachedMemoryReport = std::move(newMemory);
-                m_cachedTemperatureReport = std::move(newTemp);
+                if (fresh[i])
+                {
+                    *reports[i] = std::move(*fresh[i]);
+                }
             }
-        }
-        catch (const std::exception& e)
-        {
-            SPDLOG_LOGGER_ERROR(Logger::instance(), "Error in statusUpdateWorker: {}", e.what());
-        }
-
-        // 3. Sleep for 10 seconds (in an interruptible way)
-        for (int i = 0; i < 10; ++i) // 10 * 1s = 10s sleep
-        {
-            if (!m_running.load())
+            status->version = m_statusVersion.load(std::memory_order_relaxed) + 1;
             {
-                break; // Exit loop early if stop() was called
+                std::lock_guard<std::mutex> lock(m_statusMutex);
+                m_deviceStatus = std::move(status);
             }
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            m_statusVersion.fetch_add(1, std::memory_order_relaxed);
         }
     }
+    catch (const std::exception& e)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Error in statusUpdateWorker: {}", e.what());
+    }
+    cycle.observe(std::chrono::steady_clock::now() - cycleStart);
+
+    // Next round when a switch comes due (or pollSoon() brings one forward)
+    utils::TaskScheduler::instance().runAt(
+        utils::TaskScheduler::current(),
+        m_pollScheduler.nextWake(
+            {PollMetric::Power, PollMetric::Cpu, PollMetric::Memory, PollMetric::Temperature}));
 }
 
 void
 DeviceConfigurationAndPowerManager::openflowTablesUpdateWorker()
 {
-    // Main update loop
-    while (m_running.load())
+    static utils::Histogram& cycle = utils::pollerCycleHistogram("openflow_tables");
+    const auto cycleStart = std::chrono::steady_clock::now();
+    try
     {
-        try
+        // 1. Fetch new data of the due switches (SLOW part, no lock held)
+        std::vector<uint64_t> upDpids;
+        FlowStatsResponses newTables = fetchOpenFlowTablesInternal(upDpids);
+        std::sort(upDpids.begin(), upDpids.end());
+
+        // 2. Lock and update caches (FAST part); parsed on the next getOpenFlowTables().
+        //    Switches no longer up are dropped, the others keep their last poll.
+        std::lock_guard<std::shared_mutex> lock(m_openflowTablesMutex);
+        const auto isDown = [&](uint64_t dpid) {
+            return !std::binary_search(upDpids.begin(), upDpids.end(), dpid);
+        };
+        bool changed = !newTables.empty();
+        std::erase_if(m_cachedFlowStats, [&](const auto& polled) { return isDown(polled.first); });
+        const auto isDownEntry = [&](const json& sw) {
+            return isDown(sw.at("dpid").get<uint64_t>());
+        };
+        if (std::any_of(m_cachedOpenFlowTables->begin(),
+                        m_cachedOpenFlowTables->end(),
+                        isDownEntry))
         {
-            // 1. Fetch new data (SLOW part, no lock held)
-            json newTables = fetchOpenFlowTablesInternal();
-
-            // 2. Lock and update caches (FAST part)
-            {
-                std::lock_guard<std::shared_mutex> lock(m_openflowTablesMutex);
-                m_cachedOpenFlowTables = std::move(newTables);
-            }
+            json& tables = mutableOpenFlowTablesNoLock();
+            tables.erase(std::remove_if(tables.begin(), tables.end(), isDownEntry), tables.end());
+            changed = true;
         }
-        catch (const std::exception& e)
+        if (changed)
         {
-            SPDLOG_LOGGER_ERROR(Logger::instance(),
-                                "Error in openflowTablesUpdateWorker: {}",
-                                e.what());
+            std::move(newTables.begin(), newTables.end(), std::back_inserter(m_cachedFlowStats));
+            m_openflowTablesStale = true;
+            m_openflowTablesVersion.fetch_add(1, std::memory_order_relaxed);
         }
+    }
+    catch (const std::exception& e)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(),
+                            "Error in openflowTablesUpdateWorker: {}",
+                            e.what());
+    }
+    cycle.observe(std::chrono::steady_clock::now() - cycleStart);
+    // The first round has the switches' tables cached
+    utils::Startup::instance().markWarm("devices");
 
-        // 3. Sleep for 10 seconds (in an interruptible way)
-        for (int i = 0; i < 10; ++i) // 10 * 1s = 10s sleep
+    // Next round when a switch comes due (or pollSoon() brings one forward)
+    utils::TaskScheduler::instance().runAt(utils::TaskScheduler::current(),
+                                           m_pollScheduler.nextWake({PollMetric::OpenFlowTables}));
+}
+
+void
+DeviceConfigurationAndPowerManager::requestOpenFlowTablesPoll(uint64_t dpid)
+{
+    const auto due = m_pollScheduler.pollSoon(PollMetric::OpenFlowTables, dpid);
+    utils::TaskScheduler::instance().runAt(m_openflowTablesUpdateTask.load(), due);
+}
+
+json
+DeviceConfigurationAndPowerManager::getPollSchedulerStatsJson() const
+{
+    return m_pollScheduler.statsJson();
+}
+
+json
+DeviceConfigurationAndPowerManager::getLivenessStatsJson() const
+{
+    return m_icmpProber ? m_icmpProber->statsJson() : json::object();
+}
+
+utils::MemoryUsage
+DeviceConfigurationAndPowerManager::memoryUsage() const
+{
+    utils::MemoryUsage usage;
+    size_t switches = 0;
+    if (const std::shared_ptr<const DeviceStatus> status = getDeviceStatus())
+    {
+        usage.add("device_status",
+                  utils::heapChunk(sizeof(DeviceStatus)) + utils::heapBytes(status->power) +
+                      utils::heapBytes(status->cpu) + utils::heapBytes(status->memory) +
+                      utils::heapBytes(status->temperature));
+        switches = status->power.size();
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(m_openflowTablesMutex);
+        usage.add("openflow_tables",
+                  m_cachedOpenFlowTables ? utils::heapBytes(*m_cachedOpenFlowTables) : 0);
+        size_t pending = utils::heapBytes(m_cachedFlowStats);
+        for (const auto& [dpid, response] : m_cachedFlowStats)
         {
-            if (!m_running.load())
-            {
-                break; // Exit loop early if stop() was called
-            }
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            pending += utils::heapBytes(response);
+        }
+        usage.add("pending_flow_stats", pending);
+    }
+
+    if (const std::shared_ptr<const SmartPlugTable> plugs = getSmartPlugTable())
+    {
+        size_t bytes = utils::heapChunk(sizeof(SmartPlugTable)) +
+                       utils::heapBytes(plugs->switches) + utils::heapBytes(plugs->byIp) +
+                       utils::heapBytes(plugs->byDpid);
+        for (const SwitchInfo& info : plugs->switches)
+        {
+            bytes += utils::heapBytes(info.switchIp) + utils::heapBytes(info.plugIp);
+        }
+        for (const auto& [ip, index] : plugs->byIp)
+        {
+            bytes += utils::heapBytes(ip);
         }
+        usage.add("smart_plugs", bytes);
     }
+    return usage.per("switch", switches);
+}
+
+const DeviceMetric*
+DeviceStatus::find(const DeviceMetrics& metrics, uint64_t dpid)
+{
+    auto it = std::lower_bound(metrics.begin(),
+                               metrics.end(),
+                               dpid,
+                               [](const DeviceMetric& m, uint64_t d) { return m.dpid < d; });
+    return it != metrics.end() && it->dpid == dpid ? &*it : nullptr;
+}
+
+std::shared_ptr<const DeviceStatus>
+DeviceConfigurationAndPowerManager::getDeviceStatus() const
+{
+    std::lock_guard<std::mutex> lock(m_statusMutex);
+    return m_deviceStatus;
 }
 
 json
 DeviceConfigurationAndPowerManager::getTemperature()
 {
-    std::shared_lock<std::shared_mutex> lock(m_statusMutex);
-    return m_cachedTemperatureReport;
+    return metricsByIpJson(getDeviceStatus()->temperature,
+                           "The temperature function only supports the HPE 5520.");
 }
 
 json
 DeviceConfigurationAndPowerManager::getPowerReport()
 {
-    std::shared_lock<std::shared_mutex> lock(m_statusMutex);
-    return m_cachedPowerReport;
+    json out = json::array();
+    for (const DeviceMetric& metric : getDeviceStatus()->power)
+    {
+        out.push_back({{"dpid", metric.dpid}, {"power_consumed", metric.value}});
+    }
+    return out;
 }
 
 json
 DeviceConfigurationAndPowerManager::getCpuUtilization()
 {
-    std::shared_lock<std::shared_mutex> lock(m_statusMutex);
-    return m_cachedCpuReport;
+    return metricsByIpJson(getDeviceStatus()->cpu);
 }
 
 json
 DeviceConfigurationAndPowerManager::getMemoryUtilization()
 {
-    std::shared_lock<std::shared_mutex> lock(m_statusMutex);
-    return m_cachedMemoryReport;
+    return metricsByIpJson(getDeviceStatus()->memory);
 }
 
 json
 DeviceConfigurationAndPowerManager::getOpenFlowTables()
 {
-    std::shared_lock<std::shared_mutex> lock(m_openflowTablesMutex);
+    return *getOpenFlowTablesSnapshot();
+}
+
+std::shared_ptr<const json>
+DeviceConfigurationAndPowerManager::getOpenFlowTablesSnapshot()
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(m_openflowTablesMutex);
+        if (!m_openflowTablesStale)
+        {
+            return m_cachedOpenFlowTables;
+        }
+    }
+    std::lock_guard<std::shared_mutex> lock(m_openflowTablesMutex);
+    materializeOpenFlowTablesNoLock();
     return m_cachedOpenFlowTables;
 }
 
+uint64_t
+DeviceConfigurationAndPowerManager::statusVersion() const
+{
+    return m_statusVersion.load(std::memory_order_relaxed);
+}
+
+uint64_t
+DeviceConfigurationAndPowerManager::openFlowTablesVersion() const
+{
+    return m_openflowTablesVersion.load(std::memory_order_relaxed);
+}
+
 static uint32_t
 parseIpv4U32(const nlohmann::json& v)
 {
@@ -1279,10 +1733,12 @@ DeviceConfigurationAndPowerManager::updateOpenFlowTables(const json& j)
     const auto& dels = j.value("delete_flow_entries", json::array());
 
     std::lock_guard<std::shared_mutex> lock(m_openflowTablesMutex);
+    materializeOpenFlowTablesNoLock();
+    json& tables = mutableOpenFlowTablesNoLock();
 
     // Get (or create) the flow array for a given dpid.
-    auto getFlowsArrayForDpid = [this](uint64_t dpid) -> json& {
-        for (auto& sw : m_cachedOpenFlowTables)
+    auto getFlowsArrayForDpid = [&tables](uint64_t dpid) -> json& {
+        for (auto& sw : tables)
         {
             if (sw.at("dpid").get<uint64_t>() == dpid)
             {
@@ -1295,9 +1751,9 @@ DeviceConfigurationAndPowerManager::updateOpenFlowTables(const json& j)
         sw["flows"] = json::object();
         sw["flows"][std::to_string(dpid)] = json::array();
 
-        m_cachedOpenFlowTables.push_back(std::move(sw));
+        tables.push_back(std::move(sw));
 
-        return m_cachedOpenFlowTables.back()["flows"][std::to_string(dpid)];
+        return tables.back()["flows"][std::to_string(dpid)];
     };
 
     // Build or match identifier fields for a flow.
@@ -1390,4 +1846,5 @@ DeviceConfigurationAndPowerManager::updateOpenFlowTables(const json& j)
     {
         deleteOne(e);
     }
+    m_openflowTablesVersion.fetch_add(1, std::memory_order_relaxed);
 }
\ No newline at end of file
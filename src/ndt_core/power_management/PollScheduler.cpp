@@ -0,0 +1,149 @@
+#include "ndt_core/power_management/PollScheduler.hpp"
+#include "utils/RuntimeConfig.hpp"
+#include <algorithm> // for min
+#include <string>    // for string
+
+namespace
+{
+
+constexpr std::array<const char*, POLL_METRIC_COUNT> METRIC_NAMES{
+    "power", "cpu", "memory", "temperature", "openflow_tables"};
+
+} // namespace
+
+PollScheduler::PollScheduler()
+    : m_random(std::random_device{}())
+{
+    const std::array<int, POLL_METRIC_COUNT> intervals{POLL_INTERVAL_POWER_MS,
+                                                       POLL_INTERVAL_CPU_MS,
+                                                       POLL_INTERVAL_MEMORY_MS,
+                                                       POLL_INTERVAL_TEMPERATURE_MS,
+                                                       POLL_INTERVAL_OPENFLOW_TABLES_MS};
+    for (size_t i = 0; i < POLL_METRIC_COUNT; ++i)
+    {
+        const auto metric = static_cast<PollMetric>(i);
+        const int64_t ms = utils::RuntimeConfig::instance().defineInt(
+            std::string("poll.") + METRIC_NAMES[i] + "_interval_ms",
+            std::string("Base interval between polls of a device's ") + METRIC_NAMES[i],
+            intervals[i],
+            1000,
+            3600000,
+            [this, metric](int64_t value)
+            { setInterval(metric, std::chrono::milliseconds(value)); });
+        m_metrics[i].interval = std::chrono::milliseconds(ms);
+    }
+}
+
+void
+PollScheduler::setInterval(PollMetric metric, std::chrono::milliseconds interval)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_metrics[static_cast<size_t>(metric)].interval = interval;
+}
+
+bool
+PollScheduler::due(PollMetric metric, uint64_t device) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const MetricState& state = m_metrics[static_cast<size_t>(metric)];
+    auto it = state.devices.find(device);
+    const auto horizon = Clock::now() + std::chrono::milliseconds(POLL_SCHEDULER_COALESCE_MS);
+    return it == state.devices.end() || it->second.nextDue <= horizon;
+}
+
+PollScheduler::Clock::duration
+PollScheduler::nextIntervalNoLock(const MetricState& state, unsigned failures)
+{
+    const auto maxBackoff = std::chrono::milliseconds(POLL_SCHEDULER_MAX_BACKOFF_MS);
+    auto interval = state.interval;
+    for (unsigned i = 0; i < failures && interval < maxBackoff; ++i)
+    {
+        interval *= 2;
+    }
+    interval = std::min(interval, std::max(maxBackoff, state.interval));
+
+    const auto span = interval.count() * POLL_SCHEDULER_JITTER_PERCENT / 100;
+    std::uniform_int_distribution<int64_t> jitter(-span, span);
+    return interval + std::chrono::milliseconds(jitter(m_random));
+}
+
+void
+PollScheduler::report(PollMetric metric, uint64_t device, bool ok)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    MetricState& state = m_metrics[static_cast<size_t>(metric)];
+    DeviceState& deviceState = state.devices[device];
+    ++state.polls;
+    if (ok)
+    {
+        deviceState.failures = 0;
+    }
+    else
+    {
+        ++deviceState.failures;
+        ++state.failures;
+    }
+    deviceState.nextDue = Clock::now() + nextIntervalNoLock(state, deviceState.failures);
+}
+
+PollScheduler::Clock::time_point
+PollScheduler::pollSoon(PollMetric metric, uint64_t device)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    MetricState& state = m_metrics[static_cast<size_t>(metric)];
+    ++state.soonRequests;
+    // A device never polled yet is due already
+    const auto now = Clock::now();
+    auto it = state.devices.find(device);
+    if (it == state.devices.end())
+    {
+        return now;
+    }
+    const auto soon = now + std::chrono::milliseconds(POLL_SCHEDULER_SOON_MS);
+    it->second.nextDue = std::min(it->second.nextDue, soon);
+    return it->second.nextDue;
+}
+
+PollScheduler::Clock::time_point
+PollScheduler::nextWake(std::initializer_list<PollMetric> metrics) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto now = Clock::now();
+    auto wakeAt = now + std::chrono::milliseconds(POLL_SCHEDULER_MAX_SLEEP_MS);
+    for (PollMetric metric : metrics)
+    {
+        // A device overdue already was passed over by the last poll (it is down, say), so
+        // only the periodic wakeup retries it
+        for (const auto& [device, deviceState] : m_metrics[static_cast<size_t>(metric)].devices)
+        {
+            if (deviceState.nextDue > now)
+            {
+                wakeAt = std::min(wakeAt, deviceState.nextDue);
+            }
+        }
+    }
+    return wakeAt;
+}
+
+nlohmann::json
+PollScheduler::statsJson() const
+{
+    nlohmann::json out = nlohmann::json::object();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < POLL_METRIC_COUNT; ++i)
+    {
+        const MetricState& state = m_metrics[i];
+        size_t backingOff = 0;
+        for (const auto& [device, deviceState] : state.devices)
+        {
+            backingOff += deviceState.failures > 0;
+        }
+        out[METRIC_NAMES[i]] = {{"interval_ms", state.interval.count()},
+                                {"devices", state.devices.size()},
+                                {"backing_off", backingOff},
+                                {"polls", state.polls},
+                                {"failures", state.failures},
+                                {"soon_requests", state.soonRequests}};
+    }
+    return out;
+}
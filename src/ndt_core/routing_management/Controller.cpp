@@ -1,38 +1,46 @@
 #include "ndt_core/routing_management/Controller.hpp"
+#include "ndt_core/collection/Classifier.hpp"
 #include "ndt_core/routing_management/FlowRoutingManager.hpp"
+#include "utils/RuntimeConfig.hpp"
+#include "utils/Tracing.hpp"
+#include <algorithm>
 
-Controller::Controller(std::shared_ptr<FlowRoutingManager> flowRoutingManager)
+Controller::Controller(std::shared_ptr<FlowRoutingManager> flowRoutingManager,
+                       std::shared_ptr<ndtClassifier::Classifier> classifier)
     : m_flowRoutingManager(std::move(flowRoutingManager)),
+      m_classifier(std::move(classifier)),
       dispatcher_(
-          // SenderFn: batch send using your existing flow manager
-          [this](const std::vector<FlowJob>& batch) {
-              for (const auto& job : batch)
-              {
-                  switch (job.op)
-                  {
-                  case FlowOp::Install:
-                      m_flowRoutingManager->installAnEntry(job.dpid,
-                                                           job.priority,
-                                                           job.match,
-                                                           job.actions,
-                                                           job.idleTimeout);
-                      break;
-                  case FlowOp::Modify:
-                      m_flowRoutingManager->modifyAnEntry(job.dpid,
-                                                          job.priority,
-                                                          job.match,
-                                                          job.actions);
-                      break;
-                  case FlowOp::Delete:
-                      m_flowRoutingManager->deleteAnEntry(job.dpid, job.match, job.priority);
-                      break;
-                  }
-              }
-              // (Optional) fence/Barrier here if your southbound supports it
+          // SenderFn: one pipelined push per burst, fenced by a barrier if asked, then
+          // written through to the classifier
+          [this](const std::vector<FlowJob>& batch, bool fence) {
+              const auto sendStart = std::chrono::steady_clock::now();
+              std::vector<bool> results = m_flowRoutingManager->applyFlowJobs(batch, fence);
+              const auto sent = std::chrono::steady_clock::now();
+              writeThrough(batch, results);
+              traceBurst(batch, sendStart, sent, std::chrono::steady_clock::now());
+              return results;
           },
-          /*burstSize*/ 2000,
-          /*fencePerBurst*/ false)
+          /*burstSize*/ FLOW_DISPATCHER_BURST_SIZE,
+          /*fencePerBurst*/ true),
+      capacity_([this](uint64_t dpid) {
+          return m_classifier ? m_classifier->getRuleCount(dpid) : size_t{0};
+      }),
+      reconciler_(m_classifier)
 {
+    dispatcher_.setBurstSize(utils::RuntimeConfig::instance().defineInt(
+        "dispatcher.burst_size",
+        "Flow jobs the dispatcher pushes to one switch at once",
+        FLOW_DISPATCHER_BURST_SIZE,
+        1,
+        100000,
+        [this](int64_t value) { dispatcher_.setBurstSize(static_cast<size_t>(value)); }));
+    capacity_.setHeadroom(static_cast<unsigned>(utils::RuntimeConfig::instance().defineInt(
+        "dispatcher.table_headroom_pct",
+        "Share of a switch's flow table (%) flow batches may fill before they are refused",
+        FLOW_CAPACITY_HEADROOM_PERCENT,
+        1,
+        100,
+        [this](int64_t value) { capacity_.setHeadroom(static_cast<unsigned>(value)); })));
     dispatcher_.start();
 }
 
@@ -40,3 +48,82 @@ Controller::~Controller()
 {
     dispatcher_.stop();
 }
+
+void
+Controller::traceBurst(const std::vector<FlowJob>& batch,
+                       std::chrono::steady_clock::time_point sendStart,
+                       std::chrono::steady_clock::time_point sent,
+                       std::chrono::steady_clock::time_point confirmed)
+{
+    std::vector<std::pair<utils::TraceId, size_t>> traces; // jobs per trace; few, if any
+    for (const FlowJob& job : batch)
+    {
+        if (!job.trace)
+        {
+            continue;
+        }
+        auto it = std::find_if(traces.begin(), traces.end(), [&](const auto& seen) {
+            return seen.first == job.trace;
+        });
+        if (it == traces.end())
+        {
+            traces.emplace_back(job.trace, 1);
+        }
+        else
+        {
+            ++it->second;
+        }
+    }
+    utils::Tracer& tracer = utils::Tracer::instance();
+    for (const auto& [trace, jobs] : traces)
+    {
+        const nlohmann::json attributes{{"dpid", batch.front().dpid}, {"jobs", jobs}};
+        tracer.span(trace, "southbound_send", sendStart, sent, attributes);
+        tracer.span(trace, "classifier_confirmation", sent, confirmed, attributes);
+    }
+}
+
+void
+Controller::writeThrough(const std::vector<FlowJob>& batch, const std::vector<bool>& results)
+{
+    if (!m_classifier)
+    {
+        return;
+    }
+
+    std::vector<ndtClassifier::FlowMod> mods;
+    mods.reserve(batch.size());
+    for (size_t i = 0; i < batch.size() && i < results.size(); ++i)
+    {
+        // Groups come from the group polls
+        if (!results[i] || batch[i].target != FlowTarget::Flow)
+        {
+            continue;
+        }
+        const FlowJob& job = batch[i];
+        ndtClassifier::FlowMod mod;
+        mod.dpid = job.dpid;
+        mod.priority = job.priority;
+        mod.match = job.match;
+        mod.actions = job.actions;
+        switch (job.op)
+        {
+        case FlowOp::Install:
+            mod.command = ndtClassifier::FlowMod::Command::Add;
+            break;
+        case FlowOp::Modify:
+            mod.command = ndtClassifier::FlowMod::Command::Modify;
+            break;
+        case FlowOp::Delete:
+            // As FlowRoutingManager sends it: delete_strict unless the priority is -1
+            mod.command = job.priority == -1 ? ndtClassifier::FlowMod::Command::Delete
+                                             : ndtClassifier::FlowMod::Command::DeleteStrict;
+            break;
+        }
+        mods.push_back(std::move(mod));
+    }
+    if (!mods.empty())
+    {
+        m_classifier->applyFlowMods(mods);
+    }
+}
@@ -0,0 +1,324 @@
+#include "ndt_core/routing_management/FastReroute.hpp"
+#include "event_system/EventBus.hpp"
+#include "event_system/EventPayloads.hpp"
+#include "ndt_core/collection/RoutingEngine.hpp"
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "ndt_core/routing_management/Controller.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Tracing.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+
+namespace
+{
+
+// Output port of each switch towards @p host, as RoutingEngine routes it
+std::unordered_map<uint64_t, uint32_t>
+portsTowards(RoutingEngine& engine, const RoutingEngine::Host& host)
+{
+    RoutingEngine::OpenflowTables tables;
+    engine.computeToDestination(host.ip, host.vertex, host.attachedSwitch, tables);
+    std::unordered_map<uint64_t, uint32_t> ports;
+    for (const auto& [dpid, rules] : tables)
+    {
+        for (const auto& [net, mask, out, priority] : rules)
+        {
+            ports.emplace(dpid, out);
+        }
+    }
+    return ports;
+}
+
+// The rule RoutingEngine gives a switch forwarding to @p ip through @p port, as an urgent job
+FlowJob
+makeRerouteJob(uint64_t dpid, uint32_t ip, uint32_t port)
+{
+    FlowJob job;
+    job.dpid = dpid;
+    job.op = FlowOp::Install;
+    job.priority = 100;
+    job.match = {{"eth_type", 0x0800}, {"ipv4_dst", utils::ipToString(ip)}};
+    job.actions = nlohmann::json::array({{{"type", "OUTPUT"}, {"port", port}}});
+    job.lane = FlowLane::Urgent;
+    return job;
+}
+
+} // namespace
+
+FastReroute::FastReroute(std::shared_ptr<TopologyAndFlowMonitor> topologyMonitor,
+                         Controller& controller)
+    : m_topologyMonitor(std::move(topologyMonitor)),
+      m_controller(controller)
+{
+}
+
+FastReroute::~FastReroute()
+{
+    stop();
+}
+
+void
+FastReroute::start(EventBus& eventBus)
+{
+    eventBus.channel<LinkStateChangedEventData>(EventType::LinkStateChanged)
+        .subscribe([this](const LinkStateChangedEventData& event) { onLinkStateChanged(event); });
+    m_refreshTask = utils::TaskScheduler::instance().schedule(
+        "fast_reroute_refresh",
+        utils::TaskPriority::Low,
+        std::chrono::milliseconds(FAST_REROUTE_REFRESH_MS),
+        [this] { refresh(); },
+        true);
+}
+
+void
+FastReroute::stop()
+{
+    utils::TaskScheduler::instance().cancel(m_refreshTask);
+    m_refreshTask = 0;
+}
+
+void
+FastReroute::refresh()
+{
+    std::lock_guard refreshLock(m_refreshMutex);
+    const auto start = std::chrono::steady_clock::now();
+    // Link counters change all the time; a snapshot one period old is recent enough
+    std::shared_ptr<const GraphSnapshot> snapshot =
+        m_topologyMonitor->getGraphSnapshot(std::chrono::milliseconds(FAST_REROUTE_REFRESH_MS));
+    const bool graphChanged = snapshot->version != m_graphVersion;
+    if (!graphChanged && snapshot->flowsEpoch == m_flowsEpoch)
+    {
+        return;
+    }
+    const Graph& graph = snapshot->graph;
+
+    // Routed hosts, and the up switch-to-switch links with their edges
+    std::vector<RoutingEngine::Host> hosts;
+    std::unordered_map<uint32_t, size_t> hostByIp;
+    std::map<LinkKey, std::vector<Graph::edge_descriptor>> links;
+    for (auto [it, end] = boost::edges(graph); it != end; ++it)
+    {
+        const Graph::vertex_descriptor src = boost::source(*it, graph);
+        const Graph::vertex_descriptor dst = boost::target(*it, graph);
+        if (graph[src].vertexType == VertexType::HOST &&
+            graph[dst].vertexType == VertexType::SWITCH)
+        {
+            for (uint32_t ip : graph[src].ip)
+            {
+                if (hostByIp.emplace(ip, hosts.size()).second)
+                {
+                    hosts.push_back({ip, src, dst, graph[*it].dstInterface});
+                }
+            }
+        }
+        else if (graph[src].vertexType == VertexType::SWITCH &&
+                 graph[dst].vertexType == VertexType::SWITCH)
+        {
+            links[{std::min(src, dst), std::max(src, dst)}].push_back(*it);
+        }
+    }
+
+    std::map<LinkKey, Backup> backups;
+    {
+        std::lock_guard lock(m_mutex);
+        for (auto& [key, backup] : m_backups)
+        {
+            if (links.count(key) != 0)
+            {
+                backups.emplace(key, std::move(backup));
+            }
+        }
+    }
+
+    std::optional<RoutingEngine> baseEngine;
+    std::unordered_map<uint32_t, std::unordered_map<uint64_t, uint32_t>> basePorts;
+    std::optional<Graph> work; // the graph with one link at a time taken down
+    uint64_t recomputed = 0;
+    for (const auto& [key, edges] : links)
+    {
+        bool up = true;
+        bool flowsChanged = false;
+        for (const Graph::edge_descriptor& edge : edges)
+        {
+            const EdgeProperties& props = graph[edge];
+            up = up && props.isUp && props.isEnabled;
+            flowsChanged = flowsChanged || props.statsId >= snapshot->flowsModifiedAt.size() ||
+                           snapshot->flowsModifiedAt[props.statsId] > m_flowsEpoch;
+        }
+        if (!up)
+        {
+            backups.erase(key);
+            continue;
+        }
+        if (!graphChanged && !flowsChanged && backups.count(key) != 0)
+        {
+            continue;
+        }
+
+        // Destinations of the flows crossing the link, either way
+        std::vector<uint32_t> destinations;
+        for (const Graph::edge_descriptor& edge : edges)
+        {
+            for (const auto& [flow, lastSeen] : graph[edge].flowSet)
+            {
+                if (hostByIp.count(flow.dstIP) != 0)
+                {
+                    destinations.push_back(flow.dstIP);
+                }
+            }
+        }
+        std::sort(destinations.begin(), destinations.end());
+        destinations.erase(std::unique(destinations.begin(), destinations.end()),
+                           destinations.end());
+        auto known = backups.find(key);
+        if (!graphChanged && known != backups.end() && known->second.destinations == destinations)
+        {
+            continue;
+        }
+
+        Backup backup;
+        backup.destinations = destinations;
+        if (!destinations.empty())
+        {
+            if (!baseEngine)
+            {
+                baseEngine.emplace(graph, hosts);
+                work.emplace(graph);
+            }
+            for (const Graph::edge_descriptor& edge : edges)
+            {
+                (*work)[edge].isUp = false;
+            }
+            RoutingEngine engine(*work, hosts);
+            for (const Graph::edge_descriptor& edge : edges)
+            {
+                (*work)[edge].isUp = true;
+            }
+
+            for (uint32_t ip : destinations)
+            {
+                const RoutingEngine::Host& host = hosts[hostByIp.at(ip)];
+                auto base = basePorts.find(ip);
+                if (base == basePorts.end())
+                {
+                    base = basePorts.emplace(ip, portsTowards(*baseEngine, host)).first;
+                }
+                std::vector<std::pair<uint64_t, uint32_t>> changed;
+                for (const auto& [dpid, port] : portsTowards(engine, host))
+                {
+                    auto before = base->second.find(dpid);
+                    if (before == base->second.end() || before->second != port)
+                    {
+                        changed.emplace_back(dpid, port);
+                    }
+                }
+                std::sort(changed.begin(), changed.end());
+                for (const auto& [dpid, port] : changed)
+                {
+                    backup.jobs.push_back(makeRerouteJob(dpid, ip, port));
+                }
+            }
+        }
+        backups[key] = std::move(backup);
+        ++recomputed;
+    }
+
+    m_graphVersion = snapshot->version;
+    m_flowsEpoch = snapshot->flowsEpoch;
+    std::lock_guard lock(m_mutex);
+    m_backups = std::move(backups);
+    ++m_refreshes;
+    m_linksRecomputed += recomputed;
+    m_lastRefresh = std::chrono::steady_clock::now() - start;
+}
+
+size_t
+FastReroute::onLinkStateChanged(const LinkStateChangedEventData& event)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<LinkKey> down;
+    for (const LinkStateChangedEventData::Change& change : event.changes)
+    {
+        const size_t src = change.edge.m_source;
+        const size_t dst = change.edge.m_target;
+        const LinkKey key{std::min(src, dst), std::max(src, dst)};
+        if (!change.up && std::find(down.begin(), down.end(), key) == down.end())
+        {
+            down.push_back(key);
+        }
+    }
+    if (down.empty())
+    {
+        return 0;
+    }
+
+    std::vector<FlowJob> jobs;
+    {
+        std::lock_guard lock(m_mutex);
+        for (const LinkKey& key : down)
+        {
+            auto it = m_backups.find(key);
+            if (it == m_backups.end() || it->second.jobs.empty())
+            {
+                ++m_misses;
+                continue;
+            }
+            if (it->second.sent)
+            {
+                continue;
+            }
+            it->second.sent = true;
+            ++m_failovers;
+            jobs.insert(jobs.end(), it->second.jobs.begin(), it->second.jobs.end());
+        }
+        m_jobsSent += jobs.size();
+    }
+    if (jobs.empty())
+    {
+        return 0;
+    }
+
+    for (FlowJob& job : jobs)
+    {
+        job.trace = event.trace;
+    }
+    const size_t count = jobs.size();
+    const uint64_t batchId = m_controller.batchTracker().track(jobs);
+    m_controller.dispatcher().enqueue(std::move(jobs));
+    utils::Tracer::instance().span(event.trace,
+                                   "fast_reroute",
+                                   start,
+                                   std::chrono::steady_clock::now(),
+                                   {{"jobs", count}, {"batch_id", batchId}});
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Fast reroute: queued {} backup flow jobs for {} failed link(s) as batch {}",
+                       count,
+                       down.size(),
+                       batchId);
+    return count;
+}
+
+nlohmann::json
+FastReroute::statsJson() const
+{
+    std::lock_guard lock(m_mutex);
+    size_t destinations = 0;
+    size_t jobs = 0;
+    for (const auto& [key, backup] : m_backups)
+    {
+        destinations += backup.destinations.size();
+        jobs += backup.jobs.size();
+    }
+    return {{"links", m_backups.size()},
+            {"destinations", destinations},
+            {"jobs", jobs},
+            {"refreshes", m_refreshes},
+            {"links_recomputed", m_linksRecomputed},
+            {"last_refresh_ms",
+             std::chrono::duration<double, std::milli>(m_lastRefresh).count()},
+            {"failovers", m_failovers},
+            {"jobs_sent", m_jobsSent},
+            {"misses", m_misses}};
+}
@@ -0,0 +1,125 @@
+#include "ndt_core/routing_management/FlowBatchTracker.hpp"
+
+void
+FlowBatchTracker::Batch::report(size_t index, FlowJobOutcome outcome)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if (outcomes[index])
+    {
+        return;
+    }
+    outcomes[index] = outcome;
+    if (--remaining == 0)
+    {
+        doneAt = std::chrono::steady_clock::now();
+        completedCounter->fetch_add(1, std::memory_order_relaxed);
+        utils::Tracer::instance().complete(trace, doneAt);
+    }
+}
+
+nlohmann::json
+FlowBatchTracker::Batch::toJson() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    size_t applied = 0;
+    nlohmann::json failed = nlohmann::json::array();
+    nlohmann::json expired = nlohmann::json::array();
+    for (size_t i = 0; i < outcomes.size(); ++i)
+    {
+        if (!outcomes[i])
+        {
+            continue;
+        }
+        switch (*outcomes[i])
+        {
+        case FlowJobOutcome::Applied:
+            ++applied;
+            break;
+        case FlowJobOutcome::Failed:
+            failed.push_back(i);
+            break;
+        case FlowJobOutcome::Expired:
+            expired.push_back(i);
+            break;
+        }
+    }
+    const auto end = remaining == 0 ? doneAt : std::chrono::steady_clock::now();
+    return nlohmann::json{
+        {"batch_id", id},
+        {"state", remaining == 0 ? "done" : "pending"},
+        {"total", outcomes.size()},
+        {"applied", applied},
+        {"failed", failed.size()},
+        {"expired", expired.size()},
+        {"elapsed_ms", std::chrono::duration<double, std::milli>(end - createdAt).count()},
+        {"failed_jobs", std::move(failed)},
+        {"expired_jobs", std::move(expired)}};
+}
+
+uint64_t
+FlowBatchTracker::track(std::vector<FlowJob>& jobs)
+{
+    std::shared_ptr<Batch> batch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        batch = std::make_shared<Batch>(m_nextId++, jobs.size());
+        batch->completedCounter = m_completed;
+        batch->trace = jobs.empty() ? utils::TraceId{} : jobs.front().trace;
+        if (jobs.empty())
+        {
+            batch->doneAt = batch->createdAt;
+            m_completed->fetch_add(1, std::memory_order_relaxed);
+        }
+        m_batches.emplace(batch->id, batch);
+        m_order.push_back(batch->id);
+        if (m_order.size() > FLOW_BATCH_TRACKER_MAX_BATCHES)
+        {
+            m_batches.erase(m_order.front());
+            m_order.pop_front();
+        }
+    }
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i].onDone = [batch, i, done = std::move(jobs[i].onDone)](FlowJobOutcome outcome) {
+            if (done)
+            {
+                done(outcome);
+            }
+            batch->report(i, outcome);
+        };
+    }
+    return batch->id;
+}
+
+std::optional<nlohmann::json>
+FlowBatchTracker::statusJson(uint64_t id) const
+{
+    std::shared_ptr<Batch> batch;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_batches.find(id);
+        if (it == m_batches.end())
+        {
+            return std::nullopt;
+        }
+        batch = it->second;
+    }
+    return batch->toJson();
+}
+
+nlohmann::json
+FlowBatchTracker::statsJson() const
+{
+    uint64_t batches = 0;
+    size_t kept = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        batches = m_nextId - 1;
+        kept = m_batches.size();
+    }
+    const uint64_t completed = m_completed->load(std::memory_order_relaxed);
+    return nlohmann::json{{"batches", batches},
+                          {"pending", batches - completed},
+                          {"completed", completed},
+                          {"kept", kept}};
+}
@@ -1,4 +1,101 @@
 #include "ndt_core/routing_management/FlowDispatcher.hpp"
+#include "utils/FlightRecorder.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include "utils/Tracing.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <string>
+
+namespace {
+
+// Entry a job targets: (priority, match), or the group or meter id. json objects keep their
+// keys sorted, so the dump is canonical whatever order the match fields arrived in.
+std::string entryKey(const FlowJob& job) {
+    switch (job.target) {
+    case FlowTarget::Flow: break;
+    case FlowTarget::Group: return "group|" + job.entry.value("group_id", nlohmann::json()).dump();
+    case FlowTarget::Meter: return "meter|" + job.entry.value("meter_id", nlohmann::json()).dump();
+    }
+    return std::to_string(job.priority) + '|' + job.match.dump();
+}
+
+// Send order within a burst: groups and meters are added or changed before the flow entries
+// that may reference them, and removed after the flow entries that stopped referencing them
+int dependencyRank(const FlowJob& job) {
+    if (job.target == FlowTarget::Flow) return 1;
+    return job.op == FlowOp::Delete ? 2 : 0;
+}
+
+// Net effect of @p first followed by @p second on the same entry, or nullopt when they
+// cancel out. @p startedWithInstall: the ops folded into @p first began with an Install,
+// so the entry did not exist before them.
+std::optional<FlowJob> combine(FlowJob first, FlowJob second, bool startedWithInstall) {
+    // Whichever job survives reports for both
+    if (first.onDone && second.onDone) {
+        second.onDone = [a = std::move(first.onDone), b = std::move(second.onDone)](
+                            FlowJobOutcome outcome) {
+            a(outcome);
+            b(outcome);
+        };
+    } else if (first.onDone) {
+        second.onDone = std::move(first.onDone);
+    }
+    first.onDone = second.onDone;
+    // Likewise the trace, the later job's if it has one
+    if (!second.trace) second.trace = first.trace;
+    first.trace = second.trace;
+    switch (second.op) {
+    case FlowOp::Install:
+        return second;                          // an add replaces whatever was there
+    case FlowOp::Modify:
+        if (first.op == FlowOp::Delete) return first;   // nothing left to modify
+        first.actions = std::move(second.actions);      // an Install stays an add
+        first.entry = std::move(second.entry);
+        return first;
+    case FlowOp::Delete:
+        if (startedWithInstall) {                       // install + delete
+            if (second.onDone) second.onDone(FlowJobOutcome::Applied);
+            return std::nullopt;
+        }
+        return second;
+    }
+    return second;
+}
+
+// Wait histogram bucket: 0 below 1 ms, i below 2^i ms, the last one open-ended
+size_t waitBucket(std::chrono::steady_clock::duration wait) {
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(wait).count();
+    size_t bucket = 0;
+    while (bucket + 1 < FLOW_DISPATCHER_WAIT_BUCKETS && ms >= (int64_t{1} << bucket)) ++bucket;
+    return bucket;
+}
+
+std::chrono::milliseconds maxWait(FlowLane lane) {
+    switch (lane) {
+    case FlowLane::Urgent: return std::chrono::milliseconds::max();
+    case FlowLane::Normal: return std::chrono::milliseconds(FLOW_DISPATCHER_NORMAL_MAX_WAIT_MS);
+    case FlowLane::Bulk: return std::chrono::milliseconds(FLOW_DISPATCHER_BULK_MAX_WAIT_MS);
+    }
+    return std::chrono::milliseconds::max();
+}
+
+} // namespace
+
+void FlowDispatcher::noteTraced_(std::vector<TracedWait>& traced, utils::TraceId trace,
+                                 std::chrono::steady_clock::time_point enqueuedAt) {
+    // A burst carries few traces, if any
+    auto it = std::find_if(traced.begin(), traced.end(),
+                           [&](const TracedWait& wait) { return wait.trace == trace; });
+    if (it == traced.end()) {
+        traced.push_back(TracedWait{trace, enqueuedAt, 1});
+        return;
+    }
+    it->enqueuedAt = std::min(it->enqueuedAt, enqueuedAt);
+    ++it->jobs;
+}
 
 FlowDispatcher::FlowDispatcher(SenderFn sender, size_t burstSize, bool fencePerBurst)
 : sender_(std::move(sender)), burstSize_(burstSize), fencePerBurst_(fencePerBurst) {}
@@ -9,64 +106,317 @@ void FlowDispatcher::start() { running_ = true; }
 
 void FlowDispatcher::stop() {
     running_ = false;
-    cv_.notify_all();
-    for (auto& [dpid, th] : workers_) {
-        if (th.joinable()) th.join();
+    std::vector<std::thread> workers;
+    {
+        std::shared_lock<std::shared_mutex> lk(queuesMtx_);
+        for (auto& [dpid, sq] : queues_) {
+            // Under the switch's lock, so its worker can't miss the wakeup
+            std::lock_guard<std::mutex> qlk(sq->mtx);
+            sq->cv.notify_one();
+            if (sq->worker.joinable()) workers.push_back(std::move(sq->worker));
+        }
     }
-    workers_.clear();
+    for (auto& th : workers) th.join();
 }
 
-void FlowDispatcher::enqueue(const FlowJob& job) {
+FlowDispatcher::SwitchQueue& FlowDispatcher::queueFor_(uint64_t dpid) {
     {
-        std::lock_guard<std::mutex> lk(mtx_);
-        auto& q = queues_[job.dpid];
-        q.push_back(job);
-        if (!workers_.count(job.dpid)) {
-            // spawn worker lazily per DPID
-            workers_[job.dpid] = std::thread(&FlowDispatcher::workerLoop_, this, job.dpid);
-        }
+        std::shared_lock<std::shared_mutex> lk(queuesMtx_);
+        auto it = queues_.find(dpid);
+        if (it != queues_.end()) return *it->second;
     }
-    cv_.notify_all();
+    std::unique_lock<std::shared_mutex> lk(queuesMtx_);
+    auto& sq = queues_[dpid];
+    if (!sq) sq = std::make_unique<SwitchQueue>();
+    return *sq;
 }
 
-void FlowDispatcher::enqueue(std::vector<FlowJob> jobs) {
+void FlowDispatcher::push_(uint64_t dpid, std::vector<FlowJob>& jobs) {
+    SwitchQueue& sq = queueFor_(dpid);
+    const auto now = std::chrono::steady_clock::now();
     {
-        std::lock_guard<std::mutex> lk(mtx_);
+        std::lock_guard<std::mutex> lk(sq.mtx);
         for (auto& job : jobs) {
-            queues_[job.dpid].push_back(std::move(job));
-            if (!workers_.count(job.dpid)) {
-                workers_[job.dpid] = std::thread(&FlowDispatcher::workerLoop_, this, job.dpid);
-            }
+            const auto lane = static_cast<size_t>(job.lane);
+            laneStats_[lane].queued.fetch_add(1, std::memory_order_relaxed);
+            sq.lanes[lane].push_back(Pending{std::move(job), now});
+        }
+        if (!sq.worker.joinable()) {
+            // spawn worker lazily per DPID; only this switch's enqueuers wait for it
+            sq.worker = std::thread(&FlowDispatcher::workerLoop_, this, std::ref(sq), dpid);
         }
     }
-    cv_.notify_all();
+    sq.cv.notify_one();
+}
+
+void FlowDispatcher::enqueue(const FlowJob& job) {
+    std::vector<FlowJob> one{job};
+    push_(job.dpid, one);
+}
+
+void FlowDispatcher::enqueue(std::vector<FlowJob> jobs) {
+    // Group by switch, keeping each switch's jobs in order, to take each lock once
+    std::unordered_map<uint64_t, std::vector<FlowJob>> byDpid;
+    for (auto& job : jobs) {
+        byDpid[job.dpid].push_back(std::move(job));
+    }
+    for (auto& [dpid, group] : byDpid) {
+        push_(dpid, group);
+    }
 }
 
-void FlowDispatcher::workerLoop_(uint64_t dpid) {
+void FlowDispatcher::setOnBurstApplied(BurstFn fn) { onBurstApplied_ = std::move(fn); }
+
+void FlowDispatcher::setBurstSize(size_t burstSize) {
+    burstSize_.store(std::max<size_t>(burstSize, 1), std::memory_order_relaxed);
+}
+
+void FlowDispatcher::workerLoop_(SwitchQueue& sq, uint64_t dpid) {
+    utils::ThreadRegistry::Scope thread("dispatch-" + std::to_string(dpid));
     std::vector<FlowJob> burst;
-    burst.reserve(burstSize_);
+    burst.reserve(burstSize_.load(std::memory_order_relaxed));
+    std::vector<TracedWait> traced;
 
     while (true) {
+        thread.idle();
         {
-            std::unique_lock<std::mutex> lk(mtx_);
-            cv_.wait(lk, [&]{
-                return !running_ || !queues_[dpid].empty();
+            std::unique_lock<std::mutex> lk(sq.mtx);
+            sq.cv.wait(lk, [&]{
+                return !running_ || !sq.empty();
             });
-            if (!running_ && queues_[dpid].empty()) break;
+            if (!running_ && sq.empty()) break;
 
             burst.clear();
-            auto& q = queues_[dpid];
+            traced.clear();
+            takeBurst_(sq, burst, traced);
+        }
+        thread.wake();
+        const auto takenAt = std::chrono::steady_clock::now();
+        for (const TracedWait& wait : traced) {
+            utils::Tracer::instance().span(wait.trace, "dispatcher_queue", wait.enqueuedAt,
+                                           takenAt, {{"dpid", dpid}, {"jobs", wait.jobs}});
+        }
+        coalescedJobs_.fetch_add(coalesce_(burst), std::memory_order_relaxed);
+        orderDependencies_(burst);
+        if (!burst.empty()) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<bool> results = sender_(burst, fencePerBurst_); // one southbound push
+            auto latency = std::chrono::steady_clock::now() - t0;
+
+            size_t failed = std::count(results.begin(), results.end(), false);
+            if (results.size() < burst.size()) failed += burst.size() - results.size();
+            auto& recorder = utils::FlightRecorder::instance();
+            for (size_t i = 0; i < burst.size(); ++i) {
+                const FlowJob& job = burst[i];
+                recorder.recordFlowJob(dpid, static_cast<uint8_t>(job.op),
+                                       static_cast<uint8_t>(job.target),
+                                       static_cast<uint8_t>(job.lane), job.priority,
+                                       i < results.size() && results[i]);
+            }
+            if (failed > 0) {
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "FlowDispatcher: {} of {} jobs for switch {} failed",
+                                   failed, burst.size(), dpid);
+            }
+            recordBurst_(burst.size(), failed, latency);
+            complete_(burst, results);
+            if (onBurstApplied_ && failed < burst.size()) onBurstApplied_(dpid);
+        }
+    }
+}
+
+void FlowDispatcher::takeBurst_(SwitchQueue& sq, std::vector<FlowJob>& burst,
+                                std::vector<TracedWait>& traced) {
+    const auto now = std::chrono::steady_clock::now();
 
-            // Optional: coalesce pending ops by (match key) here if desired.
+    // Starving lanes first, then by priority
+    std::array<size_t, FLOW_LANE_COUNT> order;
+    size_t n = 0;
+    for (size_t lane = 0; lane < FLOW_LANE_COUNT; ++lane) {
+        const auto& q = sq.lanes[lane];
+        if (!q.empty() && now - q.front().enqueuedAt > maxWait(static_cast<FlowLane>(lane))) {
+            order[n++] = lane;
+        }
+    }
+    for (size_t lane = 0; lane < FLOW_LANE_COUNT; ++lane) {
+        if (std::find(order.begin(), order.begin() + n, lane) == order.begin() + n) {
+            order[n++] = lane;
+        }
+    }
 
-            while (!q.empty() && burst.size() < burstSize_) {
-                burst.push_back(std::move(q.front()));
-                q.pop_front();
+    const size_t burstSize = burstSize_.load(std::memory_order_relaxed);
+    size_t expired = 0;
+    for (size_t lane : order) {
+        auto& q = sq.lanes[lane];
+        LaneStats& stats = laneStats_[lane];
+        while (!q.empty() && burst.size() < burstSize) {
+            Pending& p = q.front();
+            stats.queued.fetch_sub(1, std::memory_order_relaxed);
+            stats.waitHistogram[waitBucket(now - p.enqueuedAt)].fetch_add(
+                1, std::memory_order_relaxed);
+            if (p.job.deadline && *p.job.deadline < now) {
+                stats.expired.fetch_add(1, std::memory_order_relaxed);
+                ++expired;
+                if (p.job.onDone) p.job.onDone(FlowJobOutcome::Expired);
+            } else {
+                if (p.job.trace) noteTraced_(traced, p.job.trace, p.enqueuedAt);
+                burst.push_back(std::move(p.job));
             }
+            q.pop_front();
         }
-        if (!burst.empty()) {
-            sender_(burst);           // send to southbound in one big push
-            // if (fencePerBurst_) ... issue a barrier/commit here inside sender_
+    }
+    if (expired > 0) {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "FlowDispatcher: dropped {} jobs past their deadline", expired);
+    }
+}
+
+size_t FlowDispatcher::coalesce_(std::vector<FlowJob>& burst) {
+    struct Slot {
+        size_t index;            // of the entry's op in `out`
+        bool startedWithInstall;
+    };
+    std::unordered_map<std::string, Slot> pending;
+    std::vector<std::optional<FlowJob>> out;
+    out.reserve(burst.size());
+
+    for (auto& job : burst) {
+        if (job.target == FlowTarget::Flow && job.op == FlowOp::Delete && job.priority == -1) {
+            // A non-strict delete may remove any entry: nothing merges across it
+            pending.clear();
+            out.emplace_back(std::move(job));
+            continue;
+        }
+        std::string key = entryKey(job);
+        auto it = pending.find(key);
+        if (it == pending.end()) {
+            pending.emplace(std::move(key), Slot{out.size(), job.op == FlowOp::Install});
+            out.emplace_back(std::move(job));
+            continue;
+        }
+        // Replace the earlier op with the merged one, sent where the later op was
+        Slot& slot = it->second;
+        std::optional<FlowJob> merged =
+            combine(std::move(*out[slot.index]), std::move(job), slot.startedWithInstall);
+        out[slot.index].reset();
+        if (!merged) {
+            pending.erase(it);
+            continue;
+        }
+        slot.index = out.size();
+        out.emplace_back(std::move(merged));
+    }
+
+    const size_t before = burst.size();
+    burst.clear();
+    for (auto& job : out) {
+        if (job) burst.push_back(std::move(*job));
+    }
+    return before - burst.size();
+}
+
+void FlowDispatcher::orderDependencies_(std::vector<FlowJob>& burst) {
+    if (std::all_of(burst.begin(), burst.end(),
+                    [](const FlowJob& job) { return job.target == FlowTarget::Flow; })) {
+        return;
+    }
+    std::stable_sort(burst.begin(), burst.end(), [](const FlowJob& a, const FlowJob& b) {
+        return dependencyRank(a) < dependencyRank(b);
+    });
+}
+
+void FlowDispatcher::complete_(std::vector<FlowJob>& burst, const std::vector<bool>& results) {
+    for (size_t i = 0; i < burst.size(); ++i) {
+        if (!burst[i].onDone) continue;
+        const bool ok = i < results.size() && results[i];
+        burst[i].onDone(ok ? FlowJobOutcome::Applied : FlowJobOutcome::Failed);
+    }
+}
+
+void FlowDispatcher::recordBurst_(size_t jobs, size_t failed, std::chrono::nanoseconds latency) {
+    const uint64_t ns = latency.count();
+    bursts_.fetch_add(1, std::memory_order_relaxed);
+    jobsSent_.fetch_add(jobs, std::memory_order_relaxed);
+    jobsFailed_.fetch_add(failed, std::memory_order_relaxed);
+    burstNs_.fetch_add(ns, std::memory_order_relaxed);
+    lastBurstNs_.store(ns, std::memory_order_relaxed);
+    uint64_t max = maxBurstNs_.load(std::memory_order_relaxed);
+    while (ns > max && !maxBurstNs_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+nlohmann::json FlowDispatcher::statsJson() const {
+    const uint64_t bursts = bursts_.load(std::memory_order_relaxed);
+    const double burstMs = burstNs_.load(std::memory_order_relaxed) / 1e6;
+    nlohmann::json lanes = nlohmann::json::object();
+    for (size_t lane = 0; lane < FLOW_LANE_COUNT; ++lane) {
+        const LaneStats& stats = laneStats_[lane];
+        nlohmann::json histogram = nlohmann::json::array();
+        for (size_t bucket = 0; bucket < FLOW_DISPATCHER_WAIT_BUCKETS; ++bucket) {
+            histogram.push_back(
+                {{"lt_ms", bucket + 1 < FLOW_DISPATCHER_WAIT_BUCKETS
+                               ? nlohmann::json(uint64_t{1} << bucket)
+                               : nlohmann::json(nullptr)},
+                 {"count", stats.waitHistogram[bucket].load(std::memory_order_relaxed)}});
+        }
+        lanes[toString(static_cast<FlowLane>(lane))] = {
+            {"queued", stats.queued.load(std::memory_order_relaxed)},
+            {"expired", stats.expired.load(std::memory_order_relaxed)},
+            {"wait_ms_histogram", std::move(histogram)}};
+    }
+    return nlohmann::json{
+        {"bursts", bursts},
+        {"jobs", jobsSent_.load(std::memory_order_relaxed)},
+        {"failed_jobs", jobsFailed_.load(std::memory_order_relaxed)},
+        {"coalesced_jobs", coalescedJobs_.load(std::memory_order_relaxed)},
+        {"fence_per_burst", fencePerBurst_},
+        {"last_burst_ms", lastBurstNs_.load(std::memory_order_relaxed) / 1e6},
+        {"max_burst_ms", maxBurstNs_.load(std::memory_order_relaxed) / 1e6},
+        {"mean_burst_ms", bursts == 0 ? 0.0 : burstMs / bursts},
+        {"lanes", lanes}};
+}
+
+void FlowDispatcher::appendMetrics(std::string& out) const {
+    using utils::MetricsRegistry;
+    auto load = [](const std::atomic<uint64_t>& value) {
+        return static_cast<double>(value.load(std::memory_order_relaxed));
+    };
+    std::vector<utils::MetricSample> queued, expired, wait;
+    for (size_t lane = 0; lane < FLOW_LANE_COUNT; ++lane) {
+        const LaneStats& stats = laneStats_[lane];
+        const std::string label =
+            MetricsRegistry::label("lane", toString(static_cast<FlowLane>(lane)));
+        queued.push_back({label, load(stats.queued)});
+        expired.push_back({label, load(stats.expired)});
+        // The wait buckets are powers of two in ms; Prometheus wants cumulative counts in s
+        uint64_t cumulative = 0;
+        for (size_t bucket = 0; bucket < FLOW_DISPATCHER_WAIT_BUCKETS; ++bucket) {
+            cumulative += stats.waitHistogram[bucket].load(std::memory_order_relaxed);
+            char le[32] = "+Inf";
+            if (bucket + 1 < FLOW_DISPATCHER_WAIT_BUCKETS) {
+                std::snprintf(le, sizeof(le), "%g", (uint64_t{1} << bucket) / 1e3);
+            }
+            wait.push_back({label + ",le=\"" + le + "\"", static_cast<double>(cumulative),
+                            "_bucket"});
         }
+        wait.push_back({label, static_cast<double>(cumulative), "_count"});
     }
+    MetricsRegistry::appendFamily(out, "ndt_flow_dispatcher_queued_jobs", "gauge",
+                                  "Flow jobs waiting in the dispatcher, by lane", queued);
+    MetricsRegistry::appendFamily(out, "ndt_flow_dispatcher_expired_jobs_total", "counter",
+                                  "Flow jobs dropped because their deadline passed", expired);
+    MetricsRegistry::appendFamily(out, "ndt_flow_dispatcher_wait_seconds", "histogram",
+                                  "Time flow jobs waited in the dispatcher queue", wait);
+    MetricsRegistry::appendFamily(out, "ndt_flow_dispatcher_bursts_total", "counter",
+                                  "Bursts sent to the switches", {{"", load(bursts_)}});
+    MetricsRegistry::appendFamily(out, "ndt_flow_dispatcher_jobs_total", "counter",
+                                  "Flow jobs sent to the switches", {{"", load(jobsSent_)}});
+    MetricsRegistry::appendFamily(out, "ndt_flow_dispatcher_failed_jobs_total", "counter",
+                                  "Flow jobs the switches failed to apply",
+                                  {{"", load(jobsFailed_)}});
+    MetricsRegistry::appendFamily(out, "ndt_flow_dispatcher_coalesced_jobs_total", "counter",
+                                  "Flow jobs merged away before sending",
+                                  {{"", load(coalescedJobs_)}});
+    MetricsRegistry::appendFamily(out, "ndt_flow_dispatcher_burst_seconds_total", "counter",
+                                  "Time spent sending bursts",
+                                  {{"", load(burstNs_) / 1e9}});
 }
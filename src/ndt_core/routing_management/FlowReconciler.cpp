@@ -0,0 +1,254 @@
+#include "ndt_core/routing_management/FlowReconciler.hpp"
+#include "ndt_core/collection/Classifier.hpp"
+#include "utils/Utils.hpp"
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+
+namespace
+{
+
+// Host-order netmask of "a.b.c.d/len" or "a.b.c.d/m.m.m.m" after the slash
+uint32_t
+parseNetmask(const std::string& text)
+{
+    if (text.find('.') != std::string::npos)
+    {
+        return ntohl(utils::ipStringToUint32(text));
+    }
+    size_t used = 0;
+    const unsigned long length = std::stoul(text, &used);
+    if (used != text.size() || length > 32)
+    {
+        throw std::invalid_argument("bad ipv4_dst prefix length: " + text);
+    }
+    return length == 0 ? 0 : 0xffffffffu << (32 - length);
+}
+
+uint32_t
+parseOutputPort(const nlohmann::json& action)
+{
+    if (action.is_string())
+    {
+        // As Ryu prints it
+        const std::string& text = action.get_ref<const std::string&>();
+        if (text.rfind("OUTPUT:", 0) != 0)
+        {
+            throw std::invalid_argument("only a single OUTPUT action can be reconciled");
+        }
+        return static_cast<uint32_t>(std::stoul(text.substr(7)));
+    }
+    if (!action.is_object() || action.value("type", std::string()) != "OUTPUT" ||
+        !action.contains("port") || !action.at("port").is_number_integer() ||
+        action.at("port").get<int64_t>() < 0)
+    {
+        throw std::invalid_argument("only a single OUTPUT action to a port number can be "
+                                    "reconciled");
+    }
+    return action.at("port").get<uint32_t>();
+}
+
+std::string
+formatIpv4Dst(uint32_t netBe, uint32_t mask)
+{
+    std::string text = utils::ipToString(netBe);
+    if (mask == 0xffffffffu)
+    {
+        return text;
+    }
+    const int length = __builtin_popcount(mask);
+    if (mask == (length == 0 ? 0 : 0xffffffffu << (32 - length)))
+    {
+        return text + "/" + std::to_string(length);
+    }
+    return text + "/" + utils::ipToString(htonl(mask));
+}
+
+} // namespace
+
+FlowReconciler::FlowReconciler(std::shared_ptr<ndtClassifier::Classifier> classifier)
+    : m_classifier(std::move(classifier))
+{
+}
+
+sflow::FlowChange
+FlowReconciler::parseEntry(const nlohmann::json& entry)
+{
+    const int priority = entry.value("priority", 0);
+    if (priority < 0 || priority > 0xffff)
+    {
+        throw std::invalid_argument("priority must be 0 to 65535");
+    }
+
+    const nlohmann::json& match = entry.at("match");
+    std::optional<std::string> ipv4Dst;
+    bool ipv4 = false;
+    for (const auto& [key, value] : match.items())
+    {
+        if (key == "eth_type" || key == "dl_type")
+        {
+            ipv4 = value.is_number_integer() && value.get<int64_t>() == 0x0800;
+        }
+        else if ((key == "ipv4_dst" || key == "nw_dst") && value.is_string())
+        {
+            ipv4Dst = value.get<std::string>();
+        }
+        else
+        {
+            throw std::invalid_argument(
+                "only eth_type 2048 and ipv4_dst can be reconciled, not " + key);
+        }
+    }
+    if (!ipv4 || !ipv4Dst)
+    {
+        throw std::invalid_argument("the match needs eth_type 2048 and ipv4_dst");
+    }
+
+    const nlohmann::json& actions = entry.at("actions");
+    if (!actions.is_array() || actions.size() != 1)
+    {
+        throw std::invalid_argument("only a single OUTPUT action can be reconciled");
+    }
+
+    const size_t slash = ipv4Dst->find('/');
+    const uint32_t mask =
+        slash == std::string::npos ? 0xffffffffu : parseNetmask(ipv4Dst->substr(slash + 1));
+    const uint32_t address = utils::ipStringToUint32(ipv4Dst->substr(0, slash));
+    return sflow::FlowChange{address & htonl(mask),
+                             mask,
+                             static_cast<uint32_t>(priority),
+                             0,
+                             parseOutputPort(actions.front())};
+}
+
+nlohmann::json
+FlowReconciler::toFlowBatch(const std::vector<sflow::FlowDiff>& diffs)
+{
+    auto entryOf = [](uint64_t dpid, const sflow::FlowChange& change) {
+        return nlohmann::json{
+            {"dpid", dpid},
+            {"priority", change.priority},
+            {"match",
+             {{"eth_type", 0x0800}, {"ipv4_dst", formatIpv4Dst(change.dstNet, change.dstMask)}}}};
+    };
+
+    nlohmann::json installs = nlohmann::json::array();
+    nlohmann::json deletes = nlohmann::json::array();
+    for (const sflow::FlowDiff& diff : diffs)
+    {
+        for (const auto* changes : {&diff.added, &diff.modified})
+        {
+            for (const sflow::FlowChange& change : *changes)
+            {
+                nlohmann::json entry = entryOf(diff.dpid, change);
+                entry["actions"] = nlohmann::json::array(
+                    {{{"type", "OUTPUT"}, {"port", change.newOutInterface}}});
+                installs.push_back(std::move(entry));
+            }
+        }
+        for (const sflow::FlowChange& change : diff.removed)
+        {
+            deletes.push_back(entryOf(diff.dpid, change));
+        }
+    }
+    return {{"install_flow_entries", std::move(installs)},
+            {"delete_flow_entries", std::move(deletes)}};
+}
+
+sflow::FlowDiff
+FlowReconciler::reconcile(const std::string& ns,
+                          uint64_t dpid,
+                          const std::vector<sflow::FlowChange>& desired,
+                          size_t& unchanged)
+{
+    using Rules = std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>>;
+    auto keyOf = [](const sflow::FlowChange& change) {
+        return sflow::Key{change.dstNet, change.dstMask, change.priority};
+    };
+
+    RuleSet desiredKeys;
+    Rules newRules;
+    newRules.reserve(desired.size());
+    for (const sflow::FlowChange& change : desired)
+    {
+        desiredKeys.insert(keyOf(change));
+        newRules.emplace_back(
+            change.dstNet, change.dstMask, change.newOutInterface, change.priority);
+    }
+
+    std::lock_guard lock(m_mutex);
+    const Scope scope{ns, dpid};
+    auto owned = m_owned.find(scope);
+
+    // The switch's rules the desired set speaks for: those it lists or the namespace owns
+    Rules oldRules;
+    if (m_classifier)
+    {
+        for (const sflow::FlowChange& rule : m_classifier->getIpv4DstRules(dpid))
+        {
+            const sflow::Key key = keyOf(rule);
+            if (desiredKeys.count(key) != 0 ||
+                (owned != m_owned.end() && owned->second.count(key) != 0))
+            {
+                oldRules.emplace_back(
+                    rule.dstNet, rule.dstMask, rule.newOutInterface, rule.priority);
+            }
+        }
+    }
+
+    std::vector<sflow::FlowDiff> diffs =
+        sflow::getFlowTableDiff({{dpid, std::move(oldRules)}}, {{dpid, std::move(newRules)}});
+    sflow::FlowDiff diff =
+        diffs.empty() ? sflow::FlowDiff{dpid, {}, {}, {}} : std::move(diffs.front());
+    unchanged = desiredKeys.size() - diff.added.size() - diff.modified.size();
+
+    RuleSet nowOwned = std::move(desiredKeys);
+    for (const sflow::FlowChange& change : diff.removed)
+    {
+        nowOwned.insert(keyOf(change));
+    }
+    if (nowOwned.empty())
+    {
+        if (owned != m_owned.end())
+        {
+            m_owned.erase(owned);
+        }
+    }
+    else if (owned != m_owned.end())
+    {
+        owned->second = std::move(nowOwned);
+    }
+    else
+    {
+        m_owned.emplace(scope, std::move(nowOwned));
+    }
+
+    ++m_reconciles;
+    m_desired += desired.size();
+    m_added += diff.added.size();
+    m_modified += diff.modified.size();
+    m_removed += diff.removed.size();
+    m_unchanged += unchanged;
+    return diff;
+}
+
+nlohmann::json
+FlowReconciler::statsJson() const
+{
+    std::lock_guard lock(m_mutex);
+    std::unordered_set<std::string> namespaces;
+    size_t ownedRules = 0;
+    for (const auto& [scope, rules] : m_owned)
+    {
+        namespaces.insert(scope.first);
+        ownedRules += rules.size();
+    }
+    return {{"namespaces", namespaces.size()},
+            {"owned_rules", ownedRules},
+            {"reconciles", m_reconciles},
+            {"desired_rules", m_desired},
+            {"added", m_added},
+            {"modified", m_modified},
+            {"removed", m_removed},
+            {"unchanged", m_unchanged}};
+}
@@ -1,20 +1,25 @@
 #include "ndt_core/routing_management/FlowRoutingManager.hpp"
-#include "event_system/EventBus.hpp"                      // for Event
-#include "event_system/EventPayloads.hpp"                 // for FlowAd...
-#include "event_system/PayloadTypes.hpp"                  // for FlowAd...
-#include "ndt_core/collection/FlowLinkUsageCollector.hpp" // for FlowLi...
-#include "ndt_core/collection/TopologyAndFlowMonitor.hpp" // for Topolo...
-#include "nlohmann/json.hpp"                              // for basic_...
-#include "spdlog/spdlog.h"                                // for SPDLOG...
-#include "utils/Logger.hpp"                               // for Logger
-#include "utils/Utils.hpp"                                // for ipToSt...
-#include <any>                                            // for any_cast
-#include <functional>                                     // for function
-#include <sstream>                                        // for basic_...
-#include <stddef.h>                                       // for size_t
-#include <unordered_map>                                  // for unorde...
-#include <utility>                                        // for pair
-#include <vector>                                         // for vector
+#include "event_system/EventBus.hpp"                       // for Event
+#include "event_system/EventPayloads.hpp"                  // for FlowAd...
+#include "event_system/PayloadTypes.hpp"                   // for FlowAd...
+#include "ndt_core/collection/FlowLinkUsageCollector.hpp"  // for FlowLi...
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"  // for Topolo...
+#include "ndt_core/routing_management/FlowJob.hpp"         // for FlowJob
+#include "ndt_core/routing_management/OpenFlowChannel.hpp" // for OpenFl...
+#include "nlohmann/json.hpp"                               // for basic_...
+#include "spdlog/spdlog.h"                                 // for SPDLOG...
+#include "utils/HttpClient.hpp"                            // for HttpClient
+#include "utils/Logger.hpp"                                // for Logger
+#include "utils/Metrics.hpp"                               // for MetricsRegistry
+#include "utils/Utils.hpp"                                 // for ipToSt...
+#include <algorithm>                                       // for fill
+#include <any>                                             // for any_cast
+#include <functional>                                      // for function
+#include <stdexcept>                                       // for invalid_...
+#include <stddef.h>                                        // for size_t
+#include <unordered_map>                                   // for unorde...
+#include <utility>                                         // for pair
+#include <vector>                                          // for vector
 
 using json = nlohmann::json;
 
@@ -32,30 +37,85 @@ FlowRoutingManager::~FlowRoutingManager()
 {
 }
 
-void
-FlowRoutingManager::deleteAnEntry(uint64_t dpid, json match, int priority)
+namespace
 {
-    json jsonData;
-    jsonData["dpid"] = dpid;
-    jsonData["match"] = match;
-
-    std::ostringstream cmd;
 
-    if (priority == -1)
+// Ryu REST path and body applying @p job; a Delete with priority -1 is non-strict
+std::pair<std::string, json>
+ryuFlowEntryRequest(const FlowJob& job)
+{
+    if (job.target != FlowTarget::Flow)
     {
-        cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/flowentry/delete "
-            << "-H \"Content-Type: application/json\" " << "-d '" << jsonData.dump() << "'";
+        json entry = job.entry;
+        entry["dpid"] = job.dpid;
+        const std::string path = job.target == FlowTarget::Group ? "/stats/groupentry/"
+                                                                  : "/stats/meterentry/";
+        switch (job.op)
+        {
+        case FlowOp::Install:
+            return {path + "add", std::move(entry)};
+        case FlowOp::Modify:
+            return {path + "modify", std::move(entry)};
+        case FlowOp::Delete:
+            return {path + "delete", std::move(entry)};
+        }
+        throw std::invalid_argument("Unknown FlowOp");
     }
-    else
+
+    json jsonData;
+    jsonData["dpid"] = job.dpid;
+    jsonData["match"] = job.match;
+
+    switch (job.op)
     {
-        jsonData["priority"] = priority;
-        cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT
-            << "/stats/flowentry/delete_strict " << "-H \"Content-Type: application/json\" "
-            << "-d '" << jsonData.dump() << "'";
+    case FlowOp::Install:
+        jsonData["priority"] = job.priority;
+        jsonData["actions"] = job.actions;
+        if (job.idleTimeout != -1)
+        {
+            jsonData["idle_timeout"] = job.idleTimeout;
+        }
+        return {"/stats/flowentry/add", std::move(jsonData)};
+    case FlowOp::Modify:
+        jsonData["priority"] = job.priority;
+        jsonData["actions"] = job.actions;
+        return {"/stats/flowentry/modify", std::move(jsonData)};
+    case FlowOp::Delete:
+        if (job.priority == -1)
+        {
+            return {"/stats/flowentry/delete", std::move(jsonData)};
+        }
+        jsonData["priority"] = job.priority;
+        return {"/stats/flowentry/delete_strict", std::move(jsonData)};
     }
+    throw std::invalid_argument("Unknown FlowOp");
+}
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
+// URL of @p path on the Ryu instance serving switch @p dpid
+std::string
+ryuUrl(uint64_t dpid, const std::string& path)
+{
+    return "http://" + ryuAddressFor(dpid) + path;
+}
+
+void
+countFlowMods(const char* channel, size_t count)
+{
+    utils::MetricsRegistry::instance()
+        .counter("ndt_southbound_flow_mods_total",
+                 "Flow-mods sent to the switches, by southbound channel",
+                 utils::MetricsRegistry::label("channel", channel))
+        .add(count);
+}
+
+} // namespace
+
+void
+FlowRoutingManager::deleteAnEntry(uint64_t dpid, json match, int priority)
+{
+    auto [path, jsonData] =
+        ryuFlowEntryRequest(FlowJob{dpid, FlowOp::Delete, priority, std::move(match), {}});
+    postToRyu(path, jsonData);
 }
 
 void
@@ -65,103 +125,152 @@ FlowRoutingManager::installAnEntry(uint64_t dpid,
                                    json action,
                                    int idleTimeout)
 {
-    json jsonData;
-    jsonData["dpid"] = dpid;
-    jsonData["priority"] = priority;
-    jsonData["match"] = match;
-    jsonData["actions"] = action;
-    if (idleTimeout != -1)
+    auto [path, jsonData] = ryuFlowEntryRequest(
+        FlowJob{dpid, FlowOp::Install, priority, std::move(match), std::move(action), idleTimeout});
+    postToRyu(path, jsonData);
+}
+
+void
+FlowRoutingManager::modifyAnEntry(uint64_t dpid, int priority, json match, json action)
+{
+    auto [path, jsonData] = ryuFlowEntryRequest(
+        FlowJob{dpid, FlowOp::Modify, priority, std::move(match), std::move(action)});
+    postToRyu(path, jsonData);
+}
+
+std::vector<bool>
+FlowRoutingManager::applyFlowJobs(const std::vector<FlowJob>& jobs, bool barrier)
+{
+    std::vector<bool> results(jobs.size(), false);
+    if (jobs.empty())
     {
-        jsonData["idle_timeout"] = idleTimeout;
+        return results;
     }
 
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/flowentry/add "
-        << "-H \"Content-Type: application/json\" " << "-d '" << jsonData.dump() << "'";
+    if (m_openFlowChannel)
+    {
+        if (std::optional<std::vector<bool>> applied = m_openFlowChannel->apply(jobs, barrier))
+        {
+            countFlowMods("openflow", jobs.size());
+            return std::move(*applied);
+        }
+    }
+    countFlowMods("ryu", jobs.size());
+
+    std::vector<utils::HttpRequest> requests;
+    requests.reserve(jobs.size() + 1);
+    for (const FlowJob& job : jobs)
+    {
+        auto [path, jsonData] = ryuFlowEntryRequest(job);
+        requests.push_back(
+            {boost::beast::http::verb::post, ryuUrl(job.dpid, path), jsonData.dump()});
+    }
+    if (barrier)
+    {
+        // Ryu answers a stats request only once the switch has replied to it
+        const uint64_t dpid = jobs.front().dpid;
+        requests.push_back({boost::beast::http::verb::get,
+                            ryuUrl(dpid, "/stats/desc/" + std::to_string(dpid)),
+                            {}});
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "POST {} flow entries to switch {}{}",
+                       jobs.size(),
+                       jobs.front().dpid,
+                       barrier ? " with a barrier" : "");
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
+    std::vector<utils::HttpResponse> responses =
+        utils::HttpClient::instance().pipeline(std::move(requests));
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        results[i] = responses[i].ok();
+        if (!results[i])
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                "Ryu rejected flow entry {} of the batch for switch {} (HTTP {}): {}",
+                                i,
+                                jobs[i].dpid,
+                                responses[i].status,
+                                responses[i].error ? responses[i].error.message()
+                                                   : responses[i].body);
+        }
+    }
+    if (barrier && !responses.back().ok())
+    {
+        // Nothing confirms the switch applied the batch
+        SPDLOG_LOGGER_ERROR(Logger::instance(),
+                            "Barrier after the batch for switch {} failed (HTTP {}): {}",
+                            jobs.front().dpid,
+                            responses.back().status,
+                            responses.back().error ? responses.back().error.message()
+                                                   : responses.back().body);
+        std::fill(results.begin(), results.end(), false);
+    }
+    return results;
 }
 
 void
-FlowRoutingManager::modifyAnEntry(uint64_t dpid, int priority, json match, json action)
+FlowRoutingManager::setOpenFlowChannel(std::shared_ptr<OpenFlowChannel> channel)
 {
-    json jsonData;
-    jsonData["dpid"] = dpid;
-    jsonData["priority"] = priority;
-    jsonData["match"] = match;
-    jsonData["actions"] = action;
-
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/flowentry/modify "
-        << "-H \"Content-Type: application/json\" " << "-d '" << jsonData.dump() << "'";
+    m_openFlowChannel = std::move(channel);
+}
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
+json
+FlowRoutingManager::openFlowStatsJson() const
+{
+    return m_openFlowChannel ? m_openFlowChannel->statsJson() : json();
 }
 
 void
 FlowRoutingManager::installAGroupEntry(json j)
 {
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/groupentry/add "
-        << "-H \"Content-Type: application/json\" " << "-d '" << j.dump() << "'";
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
+    postToRyu("/stats/groupentry/add", j);
 }
 
 void
 FlowRoutingManager::deleteAGroupEntry(json j)
 {
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/groupentry/delete "
-        << "-H \"Content-Type: application/json\" " << "-d '" << j.dump() << "'";
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
+    postToRyu("/stats/groupentry/delete", j);
 }
 
 void
 FlowRoutingManager::modifyAGroupEntry(json j)
 {
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/groupentry/modify "
-        << "-H \"Content-Type: application/json\" " << "-d '" << j.dump() << "'";
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
+    postToRyu("/stats/groupentry/modify", j);
 }
 
 void
 FlowRoutingManager::installAMeterEntry(json j)
 {
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/meterentry/add "
-        << "-H \"Content-Type: application/json\" " << "-d '" << j.dump() << "'";
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
+    postToRyu("/stats/meterentry/add", j);
 }
 
 void
 FlowRoutingManager::deleteAMeterEntry(json j)
 {
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/meterentry/delete "
-        << "-H \"Content-Type: application/json\" " << "-d '" << j.dump() << "'";
-
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
+    postToRyu("/stats/meterentry/delete", j);
 }
 
 void
 FlowRoutingManager::modifyAMeterEntry(json j)
 {
-    std::ostringstream cmd;
-    cmd << "curl -s -X POST http://" << AppConfig::RYU_IP_AND_PORT << "/stats/meterentry/modify "
-        << "-H \"Content-Type: application/json\" " << "-d '" << j.dump() << "'";
+    postToRyu("/stats/meterentry/modify", j);
+}
 
-    SPDLOG_LOGGER_INFO(Logger::instance(), "execCommand: {}", cmd.str());
-    utils::execCommand(cmd.str());
-}
\ No newline at end of file
+void
+FlowRoutingManager::postToRyu(const std::string& path, const json& body)
+{
+    const std::string url = ryuUrl(body.value("dpid", uint64_t{0}), path);
+    const std::string payload = body.dump();
+    SPDLOG_LOGGER_INFO(Logger::instance(), "POST {} {}", url, payload);
+    utils::HttpResponse response = utils::HttpClient::instance().post(url, payload);
+    if (!response.ok())
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(),
+                            "Ryu rejected POST {} (HTTP {}): {}",
+                            path,
+                            response.status,
+                            response.error ? response.error.message() : response.body);
+    }
+}
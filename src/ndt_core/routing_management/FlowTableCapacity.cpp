@@ -0,0 +1,207 @@
+#include "ndt_core/routing_management/FlowTableCapacity.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+
+// Entries @p job adds to its switch's flow tables: a non-strict delete may remove any number,
+// so it counts for none, and groups and meters have tables of their own
+int64_t
+entryDelta(const FlowJob& job)
+{
+    if (job.target != FlowTarget::Flow)
+    {
+        return 0;
+    }
+    switch (job.op)
+    {
+    case FlowOp::Install:
+        return 1;
+    case FlowOp::Delete:
+        return job.priority == -1 ? 0 : -1;
+    case FlowOp::Modify:
+        return 0;
+    }
+    return 0;
+}
+
+} // namespace
+
+nlohmann::json
+FlowTableCapacity::Rejection::toJson() const
+{
+    const size_t over = installed + pending + requested - limit;
+    return nlohmann::json{{"dpid", dpid},
+                          {"limit", limit},
+                          {"installed", installed},
+                          {"pending", pending},
+                          {"requested", requested},
+                          {"evict_hint", {{"entries", over}, {"below_priority", belowPriority}}}};
+}
+
+FlowTableCapacity::FlowTableCapacity(CountFn installed)
+    : m_installed(std::move(installed))
+{
+}
+
+void
+FlowTableCapacity::setLimitSource(LimitFn limit)
+{
+    m_limit = std::move(limit);
+}
+
+void
+FlowTableCapacity::setHeadroom(unsigned percent)
+{
+    m_headroom.store(std::clamp(percent, 1u, 100u), std::memory_order_relaxed);
+}
+
+FlowTableCapacity::Switch&
+FlowTableCapacity::switchFor(uint64_t dpid)
+{
+    auto& sw = m_switches[dpid];
+    if (!sw)
+    {
+        sw = std::make_unique<Switch>();
+    }
+    if (!sw->table && m_limit)
+    {
+        sw->table = m_limit(dpid);
+    }
+    return *sw;
+}
+
+size_t
+FlowTableCapacity::limitOf(const Switch& sw) const
+{
+    return *sw.table * m_headroom.load(std::memory_order_relaxed) / 100;
+}
+
+std::vector<FlowTableCapacity::Rejection>
+FlowTableCapacity::admit(std::vector<FlowJob>& jobs)
+{
+    struct Demand
+    {
+        int64_t entries = 0;
+        int lowestPriority = std::numeric_limits<int>::max();
+    };
+    std::unordered_map<uint64_t, Demand> demand;
+    for (const FlowJob& job : jobs)
+    {
+        const int64_t delta = entryDelta(job);
+        if (delta == 0)
+        {
+            continue;
+        }
+        Demand& d = demand[job.dpid];
+        d.entries += delta;
+        if (delta > 0)
+        {
+            d.lowestPriority = std::min(d.lowestPriority, job.priority);
+        }
+    }
+    if (demand.empty())
+    {
+        m_admitted.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+
+    std::vector<Rejection> rejections;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [dpid, d] : demand)
+    {
+        Switch& sw = switchFor(dpid);
+        if (d.entries <= 0 || !sw.table)
+        {
+            continue;
+        }
+        const size_t limit = limitOf(sw);
+        const size_t installed = m_installed ? m_installed(dpid) : 0;
+        const size_t pending =
+            static_cast<size_t>(std::max<int64_t>(sw.pending.load(std::memory_order_relaxed), 0));
+        const size_t requested = static_cast<size_t>(d.entries);
+        if (installed + pending + requested > limit)
+        {
+            rejections.push_back({dpid, limit, installed, pending, requested, d.lowestPriority});
+        }
+    }
+    if (!rejections.empty())
+    {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        m_rejectedJobs.fetch_add(jobs.size(), std::memory_order_relaxed);
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "Flow batch of {} jobs refused: {} switches lack flow table room, "
+                           "switch {} first",
+                           jobs.size(),
+                           rejections.size(),
+                           rejections.front().dpid);
+        return rejections;
+    }
+
+    for (FlowJob& job : jobs)
+    {
+        const int64_t delta = entryDelta(job);
+        if (delta == 0)
+        {
+            continue;
+        }
+        Switch* sw = m_switches.at(job.dpid).get();
+        sw->pending.fetch_add(delta, std::memory_order_relaxed);
+        job.onDone = [sw, delta, done = std::move(job.onDone)](FlowJobOutcome outcome) {
+            sw->pending.fetch_sub(delta, std::memory_order_relaxed);
+            if (done)
+            {
+                done(outcome);
+            }
+        };
+    }
+    m_admitted.fetch_add(1, std::memory_order_relaxed);
+    return {};
+}
+
+std::unordered_map<std::string, size_t>
+FlowTableCapacity::tableSizesByModel(const nlohmann::json& capacity)
+{
+    std::unordered_map<std::string, size_t> sizes;
+    if (!capacity.is_object())
+    {
+        return sizes;
+    }
+    for (const auto& [model, spec] : capacity.items())
+    {
+        size_t entries = 0;
+        for (const auto& table : spec.value("tables", nlohmann::json::array()))
+        {
+            entries += table.value("max_entries", size_t{0});
+        }
+        if (entries > 0)
+        {
+            sizes.emplace(model, entries);
+        }
+    }
+    return sizes;
+}
+
+nlohmann::json
+FlowTableCapacity::statsJson() const
+{
+    nlohmann::json switches = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& [dpid, sw] : m_switches)
+        {
+            switches.push_back(
+                {{"dpid", dpid},
+                 {"limit", sw->table ? nlohmann::json(limitOf(*sw)) : nlohmann::json(nullptr)},
+                 {"installed", m_installed ? m_installed(dpid) : 0},
+                 {"pending", sw->pending.load(std::memory_order_relaxed)}});
+        }
+    }
+    return nlohmann::json{{"headroom_percent", m_headroom.load(std::memory_order_relaxed)},
+                          {"admitted_batches", m_admitted.load(std::memory_order_relaxed)},
+                          {"rejected_batches", m_rejected.load(std::memory_order_relaxed)},
+                          {"rejected_jobs", m_rejectedJobs.load(std::memory_order_relaxed)},
+                          {"switches", std::move(switches)}};
+}
@@ -0,0 +1,951 @@
+#include "ndt_core/routing_management/OpenFlowChannel.hpp"
+#include "ndt_core/routing_management/FlowJob.hpp" // for FlowJob
+#include "utils/Logger.hpp"                        // for Logger
+#include <algorithm>                               // for min
+#include <arpa/inet.h>                             // for inet_pton
+#include <cerrno>                                  // for errno
+#include <cstdio>                                  // for sscanf
+#include <cstring>                                 // for strerror
+#include <map>                                     // for map
+#include <netdb.h>                                 // for getaddrinfo
+#include <netinet/in.h>                            // for IPPROTO_TCP
+#include <netinet/tcp.h>                           // for TCP_NODELAY
+#include <poll.h>                                  // for poll
+#include <sys/socket.h>                            // for socket
+#include <sys/un.h>                                // for sockaddr_un
+#include <unistd.h>                                // for close
+
+namespace
+{
+
+constexpr uint8_t OFP_VERSION = 0x04; // OpenFlow 1.3
+constexpr size_t OFP_HEADER_SIZE = 8;
+
+// ofp_type
+constexpr uint8_t OFPT_HELLO = 0;
+constexpr uint8_t OFPT_ERROR = 1;
+constexpr uint8_t OFPT_ECHO_REQUEST = 2;
+constexpr uint8_t OFPT_ECHO_REPLY = 3;
+constexpr uint8_t OFPT_FEATURES_REQUEST = 5;
+constexpr uint8_t OFPT_FEATURES_REPLY = 6;
+constexpr uint8_t OFPT_FLOW_MOD = 14;
+constexpr uint8_t OFPT_BARRIER_REQUEST = 20;
+constexpr uint8_t OFPT_BARRIER_REPLY = 21;
+
+// ofp_flow_mod_command
+constexpr uint8_t OFPFC_ADD = 0;
+constexpr uint8_t OFPFC_MODIFY = 1;
+constexpr uint8_t OFPFC_DELETE = 3;
+constexpr uint8_t OFPFC_DELETE_STRICT = 4;
+
+constexpr uint32_t OFP_NO_BUFFER = 0xffffffff;
+constexpr uint32_t OFPP_ANY = 0xffffffff;
+constexpr uint32_t OFPG_ANY = 0xffffffff;
+constexpr uint16_t OFPCML_MAX = 0xffe5; // max_len of an OUTPUT action, as Ryu sends it
+constexpr uint16_t OFPVID_PRESENT = 0x1000;
+
+// OXM fields of class OFPXMC_OPENFLOW_BASIC
+constexpr uint16_t OFPXMC_OPENFLOW_BASIC = 0x8000;
+constexpr uint8_t OXM_IN_PORT = 0;
+constexpr uint8_t OXM_METADATA = 2;
+constexpr uint8_t OXM_ETH_DST = 3;
+constexpr uint8_t OXM_ETH_SRC = 4;
+constexpr uint8_t OXM_ETH_TYPE = 5;
+constexpr uint8_t OXM_VLAN_VID = 6;
+constexpr uint8_t OXM_IP_PROTO = 10;
+constexpr uint8_t OXM_IPV4_SRC = 11;
+constexpr uint8_t OXM_IPV4_DST = 12;
+constexpr uint8_t OXM_TCP_SRC = 13;
+constexpr uint8_t OXM_TCP_DST = 14;
+constexpr uint8_t OXM_UDP_SRC = 15;
+constexpr uint8_t OXM_UDP_DST = 16;
+
+// ofp_instruction_type, ofp_action_type
+constexpr uint16_t OFPIT_GOTO_TABLE = 1;
+constexpr uint16_t OFPIT_APPLY_ACTIONS = 4;
+constexpr uint16_t OFPAT_OUTPUT = 0;
+constexpr uint16_t OFPAT_GROUP = 22;
+
+void
+putBig(std::string& out, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i-- > 0;)
+    {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+uint64_t
+getBig(const char* data, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        value = value << 8 | static_cast<uint8_t>(data[i]);
+    }
+    return value;
+}
+
+void
+setBig(std::string& out, size_t offset, uint64_t value, size_t bytes)
+{
+    for (size_t i = bytes; i-- > 0;)
+    {
+        out[offset + i] = static_cast<char>(value);
+        value >>= 8;
+    }
+}
+
+std::string
+ofpHeader(uint8_t type, uint32_t xid, uint16_t length = OFP_HEADER_SIZE)
+{
+    std::string out;
+    out.push_back(static_cast<char>(OFP_VERSION));
+    out.push_back(static_cast<char>(type));
+    putBig(out, length, 2);
+    putBig(out, xid, 4);
+    return out;
+}
+
+// A number, or a string of one in any base std::stoull reads ("2048", "0x800")
+std::optional<uint64_t>
+jsonUint(const nlohmann::json& value)
+{
+    if (value.is_number_unsigned())
+    {
+        return value.get<uint64_t>();
+    }
+    if (value.is_number_integer())
+    {
+        const int64_t n = value.get<int64_t>();
+        return n < 0 ? std::nullopt : std::optional<uint64_t>(static_cast<uint64_t>(n));
+    }
+    if (value.is_string())
+    {
+        const std::string& text = value.get_ref<const std::string&>();
+        try
+        {
+            size_t used = 0;
+            const uint64_t n = std::stoull(text, &used, 0);
+            return used == text.size() ? std::optional<uint64_t>(n) : std::nullopt;
+        }
+        catch (const std::exception&)
+        {
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+// "a.b.c.d", "a.b.c.d/len" or "a.b.c.d/m.m.m.m", in host byte order
+bool
+parseIpv4(const std::string& text, uint32_t& address, uint32_t& mask)
+{
+    const size_t slash = text.find('/');
+    in_addr parsed{};
+    if (inet_pton(AF_INET, text.substr(0, slash).c_str(), &parsed) != 1)
+    {
+        return false;
+    }
+    address = ntohl(parsed.s_addr);
+    mask = 0xffffffff;
+    if (slash == std::string::npos)
+    {
+        return true;
+    }
+    const std::string suffix = text.substr(slash + 1);
+    if (suffix.find('.') != std::string::npos)
+    {
+        if (inet_pton(AF_INET, suffix.c_str(), &parsed) != 1)
+        {
+            return false;
+        }
+        mask = ntohl(parsed.s_addr);
+        return true;
+    }
+    const std::optional<uint64_t> length = jsonUint(suffix);
+    if (!length || *length > 32)
+    {
+        return false;
+    }
+    mask = *length == 0 ? 0 : 0xffffffffu << (32 - *length);
+    return true;
+}
+
+// "aa:bb:cc:dd:ee:ff", optionally "/mask" of the same form
+bool
+parseMac(const std::string& text, uint64_t& address, uint64_t& mask)
+{
+    auto parseOne = [](const std::string& part, uint64_t& out) {
+        unsigned b[6];
+        char extra;
+        if (std::sscanf(part.c_str(),
+                        "%2x:%2x:%2x:%2x:%2x:%2x%c",
+                        &b[0],
+                        &b[1],
+                        &b[2],
+                        &b[3],
+                        &b[4],
+                        &b[5],
+                        &extra) != 6)
+        {
+            return false;
+        }
+        out = 0;
+        for (unsigned byte : b)
+        {
+            out = out << 8 | byte;
+        }
+        return true;
+    };
+    const size_t slash = text.find('/');
+    mask = 0xffffffffffffULL;
+    return parseOne(text.substr(0, slash), address) &&
+           (slash == std::string::npos || parseOne(text.substr(slash + 1), mask));
+}
+
+struct OxmValue
+{
+    uint64_t value = 0;
+    uint64_t mask = 0;
+    size_t bytes = 0;
+    bool masked = false;
+};
+
+// The OXM fields of a Ryu match, by field number; false if it uses anything unsupported
+bool
+collectOxm(const nlohmann::json& match, std::map<uint8_t, OxmValue>& fields)
+{
+    if (match.is_null())
+    {
+        return true;
+    }
+    if (!match.is_object())
+    {
+        return false;
+    }
+    // tp_src and tp_dst name the TCP or UDP port according to ip_proto
+    std::optional<uint64_t> ipProto;
+    for (const char* key : {"ip_proto", "nw_proto"})
+    {
+        if (match.contains(key))
+        {
+            ipProto = jsonUint(match.at(key));
+        }
+    }
+
+    for (const auto& [key, value] : match.items())
+    {
+        uint8_t field = 0;
+        size_t bytes = 0;
+        if (key == "in_port")
+        {
+            field = OXM_IN_PORT, bytes = 4;
+        }
+        else if (key == "eth_type" || key == "dl_type")
+        {
+            field = OXM_ETH_TYPE, bytes = 2;
+        }
+        else if (key == "vlan_vid" || key == "dl_vlan")
+        {
+            field = OXM_VLAN_VID, bytes = 2;
+        }
+        else if (key == "ip_proto" || key == "nw_proto")
+        {
+            field = OXM_IP_PROTO, bytes = 1;
+        }
+        else if (key == "tcp_src" || key == "tcp_dst" || key == "udp_src" || key == "udp_dst")
+        {
+            field = key == "tcp_src"   ? OXM_TCP_SRC
+                    : key == "tcp_dst" ? OXM_TCP_DST
+                    : key == "udp_src" ? OXM_UDP_SRC
+                                       : OXM_UDP_DST;
+            bytes = 2;
+        }
+        else if (key == "tp_src" || key == "tp_dst")
+        {
+            if (!ipProto || (*ipProto != 6 && *ipProto != 17))
+            {
+                return false;
+            }
+            const bool tcp = *ipProto == 6;
+            field = key == "tp_src" ? (tcp ? OXM_TCP_SRC : OXM_UDP_SRC)
+                                    : (tcp ? OXM_TCP_DST : OXM_UDP_DST);
+            bytes = 2;
+        }
+        else if (key == "ipv4_src" || key == "nw_src" || key == "ipv4_dst" || key == "nw_dst")
+        {
+            uint32_t address = 0;
+            uint32_t mask = 0;
+            if (!value.is_string() ||
+                !parseIpv4(value.get_ref<const std::string&>(), address, mask))
+            {
+                return false;
+            }
+            field = key == "ipv4_src" || key == "nw_src" ? OXM_IPV4_SRC : OXM_IPV4_DST;
+            fields[field] = OxmValue{address & mask, mask, 4, mask != 0xffffffff};
+            continue;
+        }
+        else if (key == "eth_src" || key == "dl_src" || key == "eth_dst" || key == "dl_dst")
+        {
+            uint64_t address = 0;
+            uint64_t mask = 0;
+            if (!value.is_string() ||
+                !parseMac(value.get_ref<const std::string&>(), address, mask))
+            {
+                return false;
+            }
+            field = key == "eth_src" || key == "dl_src" ? OXM_ETH_SRC : OXM_ETH_DST;
+            fields[field] = OxmValue{address & mask, mask, 6, mask != 0xffffffffffffULL};
+            continue;
+        }
+        else if (key == "metadata")
+        {
+            // "value" or "value/mask"
+            std::string text = value.is_string() ? value.get<std::string>() : value.dump();
+            const size_t slash = text.find('/');
+            const std::optional<uint64_t> metadata = jsonUint(text.substr(0, slash));
+            const std::optional<uint64_t> mask = slash == std::string::npos
+                                                     ? std::optional<uint64_t>(~0ULL)
+                                                     : jsonUint(text.substr(slash + 1));
+            if (!metadata || !mask)
+            {
+                return false;
+            }
+            fields[OXM_METADATA] = OxmValue{*metadata & *mask, *mask, 8, *mask != ~0ULL};
+            continue;
+        }
+        else
+        {
+            return false;
+        }
+
+        const std::optional<uint64_t> number = jsonUint(value);
+        if (!number || (bytes < 8 && *number >> (8 * bytes) != 0))
+        {
+            return false;
+        }
+        uint64_t encoded = *number;
+        if (field == OXM_VLAN_VID && value.is_number())
+        {
+            // As Ryu: a plain VLAN id matches frames tagged with it
+            encoded |= OFPVID_PRESENT;
+        }
+        fields[field] = OxmValue{encoded, 0, bytes, false};
+    }
+    return true;
+}
+
+// ofp_match (OXM) of @p fields, padded to 8 bytes
+void
+putMatch(std::string& out, const std::map<uint8_t, OxmValue>& fields)
+{
+    const size_t start = out.size();
+    putBig(out, 1, 2); // OFPMT_OXM
+    putBig(out, 0, 2); // length, set below
+    for (const auto& [field, oxm] : fields)
+    {
+        putBig(out, OFPXMC_OPENFLOW_BASIC, 2);
+        out.push_back(static_cast<char>(field << 1 | (oxm.masked ? 1 : 0)));
+        out.push_back(static_cast<char>(oxm.masked ? 2 * oxm.bytes : oxm.bytes));
+        putBig(out, oxm.value, oxm.bytes);
+        if (oxm.masked)
+        {
+            putBig(out, oxm.mask, oxm.bytes);
+        }
+    }
+    setBig(out, start + 2, out.size() - start, 2);
+    out.append((8 - (out.size() - start) % 8) % 8, '\0');
+}
+
+// A Ryu port number or name
+std::optional<uint32_t>
+outputPort(const nlohmann::json& port)
+{
+    if (port.is_string())
+    {
+        static const std::map<std::string, uint32_t, std::less<>> names{
+            {"IN_PORT", 0xfffffff8},
+            {"TABLE", 0xfffffff9},
+            {"NORMAL", 0xfffffffa},
+            {"FLOOD", 0xfffffffb},
+            {"ALL", 0xfffffffc},
+            {"CONTROLLER", 0xfffffffd},
+            {"LOCAL", 0xfffffffe}};
+        auto it = names.find(port.get_ref<const std::string&>());
+        if (it != names.end())
+        {
+            return it->second;
+        }
+    }
+    const std::optional<uint64_t> number = jsonUint(port);
+    if (!number || *number > 0xffffffff)
+    {
+        return std::nullopt;
+    }
+    return static_cast<uint32_t>(*number);
+}
+
+// Instructions of Ryu actions; false if one is not supported
+bool
+putInstructions(std::string& out, const nlohmann::json& actions)
+{
+    if (actions.is_null())
+    {
+        return true;
+    }
+    if (!actions.is_array())
+    {
+        return false;
+    }
+    std::string applied;
+    std::optional<uint8_t> gotoTable;
+    for (const auto& action : actions)
+    {
+        if (!action.is_object() || !action.contains("type") || !action.at("type").is_string())
+        {
+            return false;
+        }
+        const std::string& type = action.at("type").get_ref<const std::string&>();
+        if (type == "OUTPUT")
+        {
+            const std::optional<uint32_t> port =
+                action.contains("port") ? outputPort(action.at("port")) : std::nullopt;
+            if (!port)
+            {
+                return false;
+            }
+            putBig(applied, OFPAT_OUTPUT, 2);
+            putBig(applied, 16, 2);
+            putBig(applied, *port, 4);
+            putBig(applied, OFPCML_MAX, 2);
+            applied.append(6, '\0');
+        }
+        else if (type == "GROUP")
+        {
+            const std::optional<uint64_t> group =
+                action.contains("group_id") ? jsonUint(action.at("group_id")) : std::nullopt;
+            if (!group || *group > 0xffffffff)
+            {
+                return false;
+            }
+            putBig(applied, OFPAT_GROUP, 2);
+            putBig(applied, 8, 2);
+            putBig(applied, *group, 4);
+        }
+        else if (type == "GOTO_TABLE")
+        {
+            const std::optional<uint64_t> table =
+                action.contains("table_id") ? jsonUint(action.at("table_id")) : std::nullopt;
+            if (!table || *table > 254)
+            {
+                return false;
+            }
+            gotoTable = static_cast<uint8_t>(*table);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (!applied.empty())
+    {
+        putBig(out, OFPIT_APPLY_ACTIONS, 2);
+        putBig(out, 8 + applied.size(), 2);
+        out.append(4, '\0');
+        out += applied;
+    }
+    if (gotoTable)
+    {
+        putBig(out, OFPIT_GOTO_TABLE, 2);
+        putBig(out, 8, 2);
+        out.push_back(static_cast<char>(*gotoTable));
+        out.append(3, '\0');
+    }
+    return true;
+}
+
+// The endpoint of @p dpid: @p endpointTemplate with {dpid} replaced
+std::string
+endpointOf(const std::string& endpointTemplate, uint64_t dpid)
+{
+    std::string endpoint = endpointTemplate;
+    for (size_t at; (at = endpoint.find("{dpid}")) != std::string::npos;)
+    {
+        endpoint.replace(at, 6, std::to_string(dpid));
+    }
+    return endpoint;
+}
+
+// Socket connected to "unix:<path>" or "tcp:<host>:<port>", or -1
+int
+connectTo(const std::string& endpoint)
+{
+    // connect() gives up after SO_SNDTIMEO on Linux
+    timeval timeout{};
+    timeout.tv_sec = OPENFLOW_CONNECT_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (OPENFLOW_CONNECT_TIMEOUT_MS % 1000) * 1000;
+
+    if (endpoint.rfind("unix:", 0) == 0)
+    {
+        const std::string path = endpoint.substr(5);
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            return -1;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+    if (endpoint.rfind("tcp:", 0) != 0)
+    {
+        return -1;
+    }
+    const size_t colon = endpoint.rfind(':');
+    if (colon <= 4)
+    {
+        return -1;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    const std::string host = endpoint.substr(4, colon - 4);
+    const std::string port = endpoint.substr(colon + 1);
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+    {
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* ai = result; ai && fd < 0; ai = ai->ai_next)
+    {
+        fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            ::close(fd);
+            fd = -1;
+            continue;
+        }
+        const int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+} // namespace
+
+std::optional<std::string>
+encodeFlowMod(const FlowJob& job, uint32_t xid)
+{
+    std::map<uint8_t, OxmValue> fields;
+    if (job.target != FlowTarget::Flow || !collectOxm(job.match, fields))
+    {
+        return std::nullopt;
+    }
+
+    uint8_t command = OFPFC_ADD;
+    switch (job.op)
+    {
+    case FlowOp::Install:
+        command = OFPFC_ADD;
+        break;
+    case FlowOp::Modify:
+        command = OFPFC_MODIFY;
+        break;
+    case FlowOp::Delete:
+        // As FlowRoutingManager sends it to Ryu: strict unless the priority is -1
+        command = job.priority == -1 ? OFPFC_DELETE : OFPFC_DELETE_STRICT;
+        break;
+    }
+
+    std::string out = ofpHeader(OFPT_FLOW_MOD, xid);
+    putBig(out, 0, 8); // cookie
+    putBig(out, 0, 8); // cookie_mask
+    out.push_back(0);  // table_id
+    out.push_back(static_cast<char>(command));
+    putBig(out, job.op == FlowOp::Install ? std::clamp(job.idleTimeout, 0, 0xffff) : 0, 2);
+    putBig(out, 0, 2); // hard_timeout
+    putBig(out, std::clamp(job.priority, 0, 0xffff), 2);
+    putBig(out, OFP_NO_BUFFER, 4);
+    putBig(out, OFPP_ANY, 4);
+    putBig(out, OFPG_ANY, 4);
+    putBig(out, 0, 2); // flags
+    out.append(2, '\0');
+    putMatch(out, fields);
+    if (job.op != FlowOp::Delete && !putInstructions(out, job.actions))
+    {
+        return std::nullopt;
+    }
+    if (out.size() > 0xffff)
+    {
+        return std::nullopt;
+    }
+    setBig(out, 2, out.size(), 2);
+    return out;
+}
+
+OpenFlowChannel::OpenFlowChannel(std::string endpointTemplate)
+    : m_endpointTemplate(std::move(endpointTemplate))
+{
+    SPDLOG_LOGGER_INFO(
+        Logger::instance(), "Pushing flow-mods over OpenFlow at {}", m_endpointTemplate);
+}
+
+OpenFlowChannel::~OpenFlowChannel()
+{
+    std::lock_guard lock(m_mutex);
+    for (auto& [dpid, connection] : m_connections)
+    {
+        std::lock_guard connectionLock(connection->mutex);
+        closeNoLock(*connection);
+    }
+}
+
+OpenFlowChannel::Connection&
+OpenFlowChannel::connectionFor(uint64_t dpid)
+{
+    std::lock_guard lock(m_mutex);
+    auto& connection = m_connections[dpid];
+    if (!connection)
+    {
+        connection = std::make_unique<Connection>();
+    }
+    return *connection;
+}
+
+bool
+OpenFlowChannel::connectNoLock(Connection& connection, uint64_t dpid)
+{
+    const std::string endpoint = endpointOf(m_endpointTemplate, dpid);
+    connection.fd = connectTo(endpoint);
+    if (connection.fd < 0)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "OpenFlow: cannot connect to switch {} at {}: {}; using Ryu",
+                           dpid,
+                           endpoint,
+                           strerror(errno));
+        return false;
+    }
+    connection.pending.clear();
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(OPENFLOW_CONNECT_TIMEOUT_MS);
+    auto awaitType = [&](uint8_t type, std::string& message) {
+        for (;;)
+        {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0 ||
+                readMessageNoLock(connection, message, left) != ReadResult::Message)
+            {
+                return false;
+            }
+            if (static_cast<uint8_t>(message[1]) == type)
+            {
+                return true;
+            }
+        }
+    };
+
+    // The handshake uses xid 0, which bursts never do
+    std::string message;
+    bool ok = sendAllNoLock(connection, ofpHeader(OFPT_HELLO, 0)) &&
+              awaitType(OFPT_HELLO, message);
+    if (ok && static_cast<uint8_t>(message[0]) < OFP_VERSION)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "OpenFlow: switch {} at {} does not speak OpenFlow 1.3; using Ryu",
+                           dpid,
+                           endpoint);
+        ok = false;
+    }
+    ok = ok && sendAllNoLock(connection, ofpHeader(OFPT_FEATURES_REQUEST, 0)) &&
+         awaitType(OFPT_FEATURES_REPLY, message) && message.size() >= OFP_HEADER_SIZE + 8;
+    if (ok && getBig(message.data() + OFP_HEADER_SIZE, 8) != dpid)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "OpenFlow: {} is switch {:x}, not {:x}; using Ryu",
+                           endpoint,
+                           getBig(message.data() + OFP_HEADER_SIZE, 8),
+                           dpid);
+        ok = false;
+    }
+    if (!ok)
+    {
+        closeNoLock(connection);
+        return false;
+    }
+    connection.connected.store(true, std::memory_order_relaxed);
+    SPDLOG_LOGGER_INFO(
+        Logger::instance(), "OpenFlow: connected to switch {} at {}", dpid, endpoint);
+    return true;
+}
+
+void
+OpenFlowChannel::closeNoLock(Connection& connection)
+{
+    if (connection.fd >= 0)
+    {
+        ::close(connection.fd);
+        connection.fd = -1;
+    }
+    connection.pending.clear();
+    connection.connected.store(false, std::memory_order_relaxed);
+}
+
+bool
+OpenFlowChannel::sendAllNoLock(Connection& connection, const std::string& bytes)
+{
+    size_t sent = 0;
+    while (sent < bytes.size())
+    {
+        const ssize_t n =
+            ::send(connection.fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+OpenFlowChannel::ReadResult
+OpenFlowChannel::readMessageNoLock(Connection& connection,
+                                   std::string& message,
+                                   std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;)
+    {
+        std::string& pending = connection.pending;
+        if (pending.size() >= OFP_HEADER_SIZE)
+        {
+            const size_t length = getBig(pending.data() + 2, 2);
+            if (length < OFP_HEADER_SIZE)
+            {
+                return ReadResult::Closed;
+            }
+            if (pending.size() >= length)
+            {
+                message.assign(pending, 0, length);
+                pending.erase(0, length);
+                if (static_cast<uint8_t>(message[1]) != OFPT_ECHO_REQUEST)
+                {
+                    return ReadResult::Message;
+                }
+                // The switch drops connections that leave its probes unanswered
+                std::string reply = message;
+                reply[0] = static_cast<char>(OFP_VERSION);
+                reply[1] = static_cast<char>(OFPT_ECHO_REPLY);
+                if (!sendAllNoLock(connection, reply))
+                {
+                    return ReadResult::Closed;
+                }
+                continue;
+            }
+        }
+
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        pollfd pfd{connection.fd, POLLIN, 0};
+        const int ready = ::poll(&pfd, 1, static_cast<int>(std::max<int64_t>(left.count(), 0)));
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ready < 0)
+        {
+            return ReadResult::Closed;
+        }
+        if (ready == 0)
+        {
+            return ReadResult::Timeout;
+        }
+        char buffer[65536];
+        const ssize_t n = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return ReadResult::Closed;
+        }
+        pending.append(buffer, static_cast<size_t>(n));
+    }
+}
+
+bool
+OpenFlowChannel::drainNoLock(Connection& connection, uint64_t dpid)
+{
+    std::string message;
+    for (;;)
+    {
+        switch (readMessageNoLock(connection, message, std::chrono::milliseconds(0)))
+        {
+        case ReadResult::Timeout:
+            return true;
+        case ReadResult::Closed:
+            return false;
+        case ReadResult::Message:
+            if (static_cast<uint8_t>(message[1]) == OFPT_ERROR &&
+                message.size() >= OFP_HEADER_SIZE + 4)
+            {
+                // Left over from a burst sent without a barrier
+                connection.errors.fetch_add(1, std::memory_order_relaxed);
+                SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                    "OpenFlow: switch {} rejected a flow-mod (type {}, code {})",
+                                    dpid,
+                                    getBig(message.data() + OFP_HEADER_SIZE, 2),
+                                    getBig(message.data() + OFP_HEADER_SIZE + 2, 2));
+            }
+            break;
+        }
+    }
+}
+
+std::optional<std::vector<bool>>
+OpenFlowChannel::apply(const std::vector<FlowJob>& jobs, bool barrier)
+{
+    if (jobs.empty())
+    {
+        return std::vector<bool>{};
+    }
+    const uint64_t dpid = jobs.front().dpid;
+    Connection& connection = connectionFor(dpid);
+    std::lock_guard lock(connection.mutex);
+
+    const uint32_t firstXid = connection.nextXid;
+    std::string burst;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        std::optional<std::string> flowMod =
+            encodeFlowMod(jobs[i], firstXid + static_cast<uint32_t>(i));
+        if (!flowMod)
+        {
+            SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                                "OpenFlow: cannot encode {} {}; sending the burst through Ryu",
+                                jobs[i].match.dump(),
+                                jobs[i].actions.dump());
+            return std::nullopt;
+        }
+        burst += *flowMod;
+    }
+    const uint32_t barrierXid = firstXid + static_cast<uint32_t>(jobs.size());
+    if (barrier)
+    {
+        burst += ofpHeader(OFPT_BARRIER_REQUEST, barrierXid);
+    }
+
+    if (connection.fd >= 0 && !drainNoLock(connection, dpid))
+    {
+        closeNoLock(connection);
+    }
+    if (connection.fd < 0)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < connection.retryAt || !connectNoLock(connection, dpid))
+        {
+            connection.retryAt = std::max(connection.retryAt,
+                                          now + std::chrono::milliseconds(OPENFLOW_RETRY_MS));
+            return std::nullopt;
+        }
+    }
+    // Skipping 0 when the xids wrap around
+    connection.nextXid = barrierXid + 1 == 0 ? 1 : barrierXid + 1;
+
+    std::vector<bool> results(jobs.size(), true);
+    if (!sendAllNoLock(connection, burst))
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(),
+                            "OpenFlow: sending {} flow-mods to switch {} failed: {}",
+                            jobs.size(),
+                            dpid,
+                            strerror(errno));
+        closeNoLock(connection);
+        std::fill(results.begin(), results.end(), false);
+        return results;
+    }
+    connection.flowMods.fetch_add(jobs.size(), std::memory_order_relaxed);
+    if (!barrier)
+    {
+        return results;
+    }
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(OPENFLOW_BARRIER_TIMEOUT_MS);
+    std::string message;
+    for (;;)
+    {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0 ||
+            readMessageNoLock(connection, message, left) != ReadResult::Message)
+        {
+            // Nothing confirms the switch applied the burst
+            SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                "OpenFlow: no barrier reply from switch {} after {} flow-mods",
+                                dpid,
+                                jobs.size());
+            closeNoLock(connection);
+            std::fill(results.begin(), results.end(), false);
+            return results;
+        }
+        const uint8_t type = static_cast<uint8_t>(message[1]);
+        const uint32_t xid = static_cast<uint32_t>(getBig(message.data() + 4, 4));
+        if (type == OFPT_BARRIER_REPLY && xid == barrierXid)
+        {
+            return results;
+        }
+        if (type == OFPT_ERROR && message.size() >= OFP_HEADER_SIZE + 4)
+        {
+            connection.errors.fetch_add(1, std::memory_order_relaxed);
+            const uint32_t index = xid - firstXid;
+            if (index < jobs.size())
+            {
+                results[index] = false;
+            }
+            SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                "OpenFlow: switch {} rejected flow-mod {} of the burst "
+                                "(type {}, code {})",
+                                dpid,
+                                index,
+                                getBig(message.data() + OFP_HEADER_SIZE, 2),
+                                getBig(message.data() + OFP_HEADER_SIZE + 2, 2));
+        }
+    }
+}
+
+nlohmann::json
+OpenFlowChannel::statsJson() const
+{
+    nlohmann::json switches = nlohmann::json::object();
+    std::lock_guard lock(m_mutex);
+    for (const auto& [dpid, connection] : m_connections)
+    {
+        switches[std::to_string(dpid)] = {
+            {"connected", connection->connected.load(std::memory_order_relaxed)},
+            {"flow_mods", connection->flowMods.load(std::memory_order_relaxed)},
+            {"errors", connection->errors.load(std::memory_order_relaxed)}};
+    }
+    return {{"endpoint", m_endpointTemplate}, {"switches", std::move(switches)}};
+}
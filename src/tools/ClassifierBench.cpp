@@ -0,0 +1,400 @@
+/**
+ * @file ClassifierBench.cpp
+ * @brief Update and lookup timings of ndtClassifier::Classifier on generated tables of
+ *        1k, 10k and 100k rules, written as JSON to compare commits.
+ *
+ * For each table size in --rules, one switch gets that many rules in the proportions of a
+ * data-center table (see classifier_rules::generate()), and the tool times:
+ *   - updateFromQueriedTables and updateFromFlowStatsText of the whole table into an empty
+ *     Classifier, and updateFromQueriedTables after --churn percent of the rules changed;
+ *   - lookup of --keys distinct keys (mostly exact-match cache misses), and of a working set
+ *     that fits the cache (hits);
+ *   - lookupEffect, lookupBatch (in batches of BENCH_BATCH keys) and lookupPipeline over the
+ *     distinct keys;
+ *   - the linear scan of classifier_rules::linearLookup() over the same keys, as the
+ *     baseline the subtables are there to beat.
+ *
+ * --hit-ratio of the keys are built to match a rule, the others are random. Each result
+ * gives the mean and the p50/p99 of the batches, in nanoseconds per operation (per key for
+ * lookupBatch); each table size also reports Classifier::statsJson(). The JSON document goes
+ * to stdout (or --out), progress to stderr.
+ *
+ * Usage:
+ *   ndt_classifier_bench [--rules <n,n,...>] [--keys <n>] [--hit-ratio <0..1>]
+ *                        [--churn <percent>] [--repeat <n>] [--label <text>] [--seed <n>]
+ *                        [--out <file>]
+ */
+#include "ClassifierRules.hpp"
+#include "ndt_core/collection/Classifier.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+using ndtClassifier::Classifier;
+using ndtClassifier::FlowKey;
+
+#define BENCH_BATCH 256             // operations per timed batch
+#define BENCH_DPID 1                // the switch the rules are loaded on
+#define BENCH_DEFAULT_KEYS 100000   // distinct lookup keys
+#define BENCH_DEFAULT_HIT_RATIO 0.9 // keys built to match a rule
+#define BENCH_DEFAULT_CHURN 1.0     // percent of the rules changed between two polls
+#define BENCH_DEFAULT_REPEAT 3      // passes over each workload
+#define BENCH_CACHED_KEYS 1024      // working set of the cached lookups, within the cache
+#define BENCH_LINEAR_MAX_KEYS 2000  // keys of the linear scan, so 100k rules stay quick
+
+namespace
+{
+
+struct BenchConfig
+{
+    std::vector<size_t> rules = {1000, 10000, 100000};
+    size_t keys = BENCH_DEFAULT_KEYS;
+    double hitRatio = BENCH_DEFAULT_HIT_RATIO;
+    double churn = BENCH_DEFAULT_CHURN;
+    size_t repeat = BENCH_DEFAULT_REPEAT;
+    std::string label;
+    uint64_t seed = 1;
+    std::string outPath; // empty: stdout
+};
+
+std::vector<size_t>
+parseSizes(const std::string& value)
+{
+    std::vector<size_t> sizes;
+    std::stringstream list(value);
+    std::string item;
+    while (std::getline(list, item, ','))
+    {
+        sizes.push_back(std::max(1UL, std::stoul(item)));
+    }
+    if (sizes.empty())
+    {
+        throw std::invalid_argument("--rules needs at least one size");
+    }
+    return sizes;
+}
+
+BenchConfig
+parseArgs(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/ClassifierBench.cpp\n");
+            std::exit(0);
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--rules")
+        {
+            config.rules = parseSizes(value);
+        }
+        else if (arg == "--keys")
+        {
+            config.keys = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--hit-ratio")
+        {
+            config.hitRatio = std::clamp(std::stod(value), 0.0, 1.0);
+        }
+        else if (arg == "--churn")
+        {
+            config.churn = std::clamp(std::stod(value), 0.0, 100.0);
+        }
+        else if (arg == "--repeat")
+        {
+            config.repeat = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--label")
+        {
+            config.label = value;
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = std::stoull(value);
+        }
+        else if (arg == "--out")
+        {
+            config.outPath = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    return config;
+}
+
+//================================================================
+// Timing
+//================================================================
+
+/// Keep @p value alive so the work producing it is not optimized away.
+template <typename T>
+inline void
+keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/// Nanoseconds per operation of timed batches, reported as one JSON result.
+class Measurement
+{
+  public:
+    explicit Measurement(std::string name)
+        : m_name(std::move(name))
+    {
+    }
+
+    /// Time @p op(i) for i in [0, count), in batches; each call counts as @p opsPerCall ops.
+    template <typename Op>
+    void run(size_t count, Op&& op, size_t opsPerCall = 1)
+    {
+        const size_t callsPerBatch = std::max<size_t>(1, BENCH_BATCH / opsPerCall);
+        for (size_t begin = 0; begin < count; begin += callsPerBatch)
+        {
+            const size_t end = std::min(count, begin + callsPerBatch);
+            const auto start = Clock::now();
+            for (size_t i = begin; i < end; ++i)
+            {
+                op(i);
+            }
+            const double ns =
+                std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            const size_t ops = (end - begin) * opsPerCall;
+            m_batches.push_back(ns / ops);
+            m_ops += ops;
+            m_totalNs += ns;
+        }
+    }
+
+    json result()
+    {
+        std::sort(m_batches.begin(), m_batches.end());
+        auto at = [&](double q) {
+            return m_batches.empty()
+                       ? 0.0
+                       : m_batches[std::min(m_batches.size() - 1,
+                                            static_cast<size_t>(m_batches.size() * q))];
+        };
+        const double mean = m_ops ? m_totalNs / m_ops : 0.0;
+        std::fprintf(stderr,
+                     "  %-44s %12.1f ns/op  p99 %12.1f  (%zu ops)\n",
+                     m_name.c_str(),
+                     mean,
+                     at(0.99),
+                     m_ops);
+        return {{"name", m_name},
+                {"ops", m_ops},
+                {"ns_per_op", mean},
+                {"p50_ns", at(0.50)},
+                {"p99_ns", at(0.99)}};
+    }
+
+  private:
+    std::string m_name;
+    std::vector<double> m_batches;
+    size_t m_ops = 0;
+    double m_totalNs = 0;
+};
+
+//================================================================
+// Benchmarks
+//================================================================
+
+/// Full loads of the table, and an update after config.churn percent of it changed.
+void
+benchUpdates(const BenchConfig& config,
+             const std::vector<classifier_rules::Rule>& rules,
+             std::mt19937_64& rng,
+             json& results)
+{
+    const json tables = classifier_rules::tablesJson(BENCH_DPID, rules);
+    const std::vector<std::pair<uint64_t, std::string>> text = {
+        {BENCH_DPID, classifier_rules::flowStatsText(BENCH_DPID, rules)}};
+
+    std::vector<classifier_rules::Rule> churned = rules;
+    const size_t changes = static_cast<size_t>(rules.size() * config.churn / 100.0);
+    const auto replacements = classifier_rules::generate(changes, rng, false);
+    for (size_t i = 0; i < changes; ++i)
+    {
+        churned[rng() % churned.size()] = replacements[i];
+    }
+    const json churnedTables = classifier_rules::tablesJson(BENCH_DPID, churned);
+
+    Measurement fullJson("updateFromQueriedTables/full");
+    Measurement fullText("updateFromFlowStatsText/full");
+    Measurement churn("updateFromQueriedTables/churn " + std::to_string(changes));
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        Classifier fromJson;
+        fullJson.run(1, [&](size_t) { fromJson.updateFromQueriedTables(tables); });
+        churn.run(1, [&](size_t) { fromJson.updateFromQueriedTables(churnedTables); });
+
+        Classifier fromText;
+        fullText.run(1, [&](size_t) { fromText.updateFromFlowStatsText(text); });
+    }
+    results.push_back(fullJson.result());
+    results.push_back(fullText.result());
+    results.push_back(churn.result());
+}
+
+void
+benchLookups(const BenchConfig& config,
+             const Classifier& classifier,
+             const std::vector<classifier_rules::Rule>& rules,
+             const std::vector<FlowKey>& keys,
+             json& results)
+{
+    Measurement lookup("lookup");
+    Measurement cached("lookup/cached " + std::to_string(BENCH_CACHED_KEYS) + " keys");
+    Measurement effect("lookupEffect");
+    Measurement batch("lookupBatch");
+    Measurement pipeline("lookupPipeline");
+    Measurement linear("linear scan");
+    const size_t cachedKeys = std::min<size_t>(BENCH_CACHED_KEYS, keys.size());
+    const size_t linearKeys = std::min<size_t>(BENCH_LINEAR_MAX_KEYS, keys.size());
+    std::vector<std::optional<ndtClassifier::RuleEffect>> out(BENCH_BATCH);
+
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        lookup.run(keys.size(), [&](size_t i) {
+            auto e = classifier.lookup(BENCH_DPID, keys[i]);
+            keep(e);
+        });
+        for (size_t pass = 0; pass < keys.size() / cachedKeys; ++pass)
+        {
+            cached.run(cachedKeys, [&](size_t i) {
+                auto e = classifier.lookup(BENCH_DPID, keys[i]);
+                keep(e);
+            });
+        }
+        effect.run(keys.size(), [&](size_t i) {
+            const ndtClassifier::RuleEffect* e = classifier.lookupEffect(BENCH_DPID, keys[i]);
+            keep(e);
+        });
+        // the last batch may be short, so it is left out of the per-key figure
+        batch.run(
+            keys.size() / BENCH_BATCH,
+            [&](size_t b) {
+                classifier.lookupBatch(
+                    BENCH_DPID,
+                    std::span<const FlowKey>(keys.data() + b * BENCH_BATCH, BENCH_BATCH),
+                    out);
+                keep(out);
+            },
+            BENCH_BATCH);
+        pipeline.run(keys.size(), [&](size_t i) {
+            auto e = classifier.lookupPipeline(BENCH_DPID, keys[i]);
+            keep(e);
+        });
+        linear.run(linearKeys, [&](size_t i) {
+            auto port = classifier_rules::linearLookup(rules, keys[i]);
+            keep(port);
+        });
+    }
+    results.push_back(lookup.result());
+    results.push_back(cached.result());
+    results.push_back(effect.result());
+    if (keys.size() >= BENCH_BATCH)
+    {
+        results.push_back(batch.result());
+    }
+    results.push_back(pipeline.result());
+    results.push_back(linear.result());
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    LogConfig logConfig;
+    logConfig.level = spdlog::level::err; // lookup() warns of every miss
+    Logger::init(logConfig);
+    BenchConfig config;
+    try
+    {
+        config = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    json tables = json::array();
+    try
+    {
+        for (const size_t count : config.rules)
+        {
+            std::mt19937_64 rng(config.seed);
+            const auto rules = classifier_rules::generate(count, rng, false);
+            std::vector<FlowKey> keys;
+            keys.reserve(config.keys);
+            for (size_t i = 0; i < config.keys; ++i)
+            {
+                keys.push_back(classifier_rules::randomKey(rules, rng, config.hitRatio));
+            }
+            std::fprintf(stderr, "%zu rules, %zu keys\n", count, keys.size());
+
+            json results = json::array();
+            benchUpdates(config, rules, rng, results);
+            Classifier classifier;
+            classifier.updateFromQueriedTables(classifier_rules::tablesJson(BENCH_DPID, rules));
+            benchLookups(config, classifier, rules, keys, results);
+            tables.push_back({{"rules", count},
+                              {"classifier", classifier.statsJson()},
+                              {"results", results}});
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    const json document = {{"label", config.label},
+                           {"config",
+                            {{"rules", config.rules},
+                             {"keys", config.keys},
+                             {"hit_ratio", config.hitRatio},
+                             {"churn_percent", config.churn},
+                             {"repeat", config.repeat},
+                             {"batch", BENCH_BATCH},
+                             {"seed", config.seed}}},
+                           {"tables", tables}};
+    if (config.outPath.empty())
+    {
+        std::printf("%s\n", document.dump(2).c_str());
+        return 0;
+    }
+    std::ofstream out(config.outPath);
+    out << document.dump(2) << '\n';
+    if (!out)
+    {
+        std::fprintf(stderr, "Cannot write %s\n", config.outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,412 @@
+/**
+ * @file ClassifierFuzz.cpp
+ * @brief Differential fuzzer of ndtClassifier::Classifier against a linear scan of the same
+ *        rules.
+ *
+ * A switch starts with --rules generated rules of distinct priorities, so every key has a
+ * single right answer: the output port of the highest-priority rule it matches, which
+ * classifier_rules::linearLookup() finds by scanning them all. Each iteration then changes
+ * --churn percent of the rules (removed, added, or given another output port) and hands the
+ * change to the Classifier the way the collector would, in turn:
+ *   - a poll through updateFromQueriedTables;
+ *   - a poll through updateFromFlowStatsText;
+ *   - the flow-mods (Add, DeleteStrict) through applyFlowMods.
+ *
+ * --keys random keys are then looked up with lookup, lookupEffect, lookupWithMask,
+ * lookupPipeline and lookupBatch, and every result is compared with the linear scan. The
+ * mask lookupWithMask reports is checked too: the key with random bits flipped outside it
+ * must get the same answer from the linear scan. getRuleCount must equal the rule count.
+ *
+ * The first mismatch stops the run with exit code 1, after writing the rules, the key and
+ * both answers to --dump; the rules are in the updateFromQueriedTables shape, so the case
+ * replays without this tool. Progress goes to stderr.
+ *
+ * Usage:
+ *   ndt_classifier_fuzz [--rules <n>] [--iterations <n>] [--keys <n>] [--churn <percent>]
+ *                       [--seed <n>] [--dump <file>]
+ */
+#include "ClassifierRules.hpp"
+#include "ndt_core/collection/Classifier.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using json = nlohmann::json;
+using ndtClassifier::Classifier;
+using ndtClassifier::FlowKey;
+using ndtClassifier::FlowMod;
+using classifier_rules::Rule;
+
+#define FUZZ_DPID 1                 // the switch the rules are loaded on
+#define FUZZ_DEFAULT_RULES 2000     // rules of the switch
+#define FUZZ_DEFAULT_ITERATIONS 300 // rule changes, each followed by lookups
+#define FUZZ_DEFAULT_KEYS 2000      // keys looked up per iteration
+#define FUZZ_DEFAULT_CHURN 5.0      // percent of the rules changed per iteration
+#define FUZZ_HIT_RATIO 0.8          // keys built to match a rule
+#define FUZZ_DEFAULT_DUMP "classifier_fuzz_failure.json"
+
+namespace
+{
+
+struct FuzzConfig
+{
+    size_t rules = FUZZ_DEFAULT_RULES;
+    size_t iterations = FUZZ_DEFAULT_ITERATIONS;
+    size_t keys = FUZZ_DEFAULT_KEYS;
+    double churn = FUZZ_DEFAULT_CHURN;
+    uint64_t seed = 1;
+    std::string dumpPath = FUZZ_DEFAULT_DUMP;
+};
+
+FuzzConfig
+parseArgs(int argc, char* argv[])
+{
+    FuzzConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/ClassifierFuzz.cpp\n");
+            std::exit(0);
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--rules")
+        {
+            config.rules = std::stoul(value);
+        }
+        else if (arg == "--iterations")
+        {
+            config.iterations = std::stoul(value);
+        }
+        else if (arg == "--keys")
+        {
+            config.keys = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--churn")
+        {
+            config.churn = std::clamp(std::stod(value), 0.0, 100.0);
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = std::stoull(value);
+        }
+        else if (arg == "--dump")
+        {
+            config.dumpPath = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    if (config.rules > CLASSIFIER_RULES_MAX_PRIORITY / 2)
+    {
+        throw std::invalid_argument("--rules is at most " +
+                                    std::to_string(CLASSIFIER_RULES_MAX_PRIORITY / 2) +
+                                    ", so that the rules added keep distinct priorities");
+    }
+    return config;
+}
+
+/// How an iteration hands its rule changes to the Classifier.
+enum class Update
+{
+    Poll,      // updateFromQueriedTables
+    PollText,  // updateFromFlowStatsText
+    FlowMods,  // applyFlowMods
+};
+
+const char*
+updateName(Update update)
+{
+    switch (update)
+    {
+    case Update::Poll:
+        return "updateFromQueriedTables";
+    case Update::PollText:
+        return "updateFromFlowStatsText";
+    case Update::FlowMods:
+        return "applyFlowMods";
+    }
+    return "";
+}
+
+/// The rules of the switch as the linear scan sees them, and the priorities they use.
+class RuleSet
+{
+  public:
+    RuleSet(size_t count, std::mt19937_64& rng)
+        : m_taken(CLASSIFIER_RULES_MAX_PRIORITY + 1, false)
+    {
+        m_rules = classifier_rules::generate(count, rng, true);
+        for (const auto& rule : m_rules)
+        {
+            m_taken[rule.priority] = true;
+        }
+    }
+
+    const std::vector<Rule>& rules() const
+    {
+        return m_rules;
+    }
+
+    /**
+     * @brief Change @p count rules: about a third removed, a third added and a third given
+     *        another output port.
+     * @return The flow-mods that make the same change on the switch.
+     */
+    std::vector<FlowMod> churn(size_t count, std::mt19937_64& rng)
+    {
+        std::vector<FlowMod> mods;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const unsigned kind = rng() % 3;
+            if (kind == 0 && !m_rules.empty())
+            {
+                const size_t victim = rng() % m_rules.size();
+                mods.push_back(classifier_rules::flowMod(
+                    FUZZ_DPID, m_rules[victim], FlowMod::Command::DeleteStrict));
+                m_taken[m_rules[victim].priority] = false;
+                m_rules[victim] = m_rules.back();
+                m_rules.pop_back();
+            }
+            else if (kind == 1 && !m_rules.empty())
+            {
+                Rule& rule = m_rules[rng() % m_rules.size()];
+                rule.outPort = rule.outPort % CLASSIFIER_RULES_PORTS + 1;
+                mods.push_back(classifier_rules::flowMod(FUZZ_DPID, rule, FlowMod::Command::Add));
+            }
+            else if (m_rules.size() < CLASSIFIER_RULES_MAX_PRIORITY)
+            {
+                const Rule rule = classifier_rules::generate(1, rng, true, &m_taken).front();
+                m_taken[rule.priority] = true;
+                m_rules.push_back(rule);
+                mods.push_back(classifier_rules::flowMod(FUZZ_DPID, rule, FlowMod::Command::Add));
+            }
+        }
+        return mods;
+    }
+
+  private:
+    std::vector<Rule> m_rules;
+    std::vector<bool> m_taken; // by priority
+};
+
+/// The single output port of an effect, as linearLookup() reports a match.
+std::optional<uint32_t>
+portOf(const ndtClassifier::RuleEffect* effect)
+{
+    if (!effect || effect->outputPorts.size() != 1)
+    {
+        return effect ? std::optional<uint32_t>(UINT32_MAX) : std::nullopt;
+    }
+    return effect->outputPorts.front();
+}
+
+json
+portJson(const std::optional<uint32_t>& port)
+{
+    return port ? json(*port) : json(nullptr);
+}
+
+/// @p key with random bits flipped where @p consulted is clear.
+FlowKey
+flipUnconsulted(const FlowKey& key, const FlowKey& consulted, std::mt19937_64& rng)
+{
+    FlowKey out = key;
+    out.inPort ^= static_cast<uint32_t>(rng()) & ~consulted.inPort;
+    out.ethType ^= static_cast<uint16_t>(rng()) & ~consulted.ethType;
+    out.ipProto ^= static_cast<uint8_t>(rng()) & ~consulted.ipProto;
+    out.ipv4Src ^= static_cast<uint32_t>(rng()) & ~consulted.ipv4Src;
+    out.ipv4Dst ^= static_cast<uint32_t>(rng()) & ~consulted.ipv4Dst;
+    out.tpSrc ^= static_cast<uint16_t>(rng()) & ~consulted.tpSrc;
+    out.tpDst ^= static_cast<uint16_t>(rng()) & ~consulted.tpDst;
+    out.vlanTci ^= static_cast<uint16_t>(rng()) & ~consulted.vlanTci;
+    out.metadata ^= rng() & ~consulted.metadata;
+    return out;
+}
+
+/// A lookup whose answer differs from the linear scan's.
+struct Mismatch
+{
+    std::string call;
+    FlowKey key;
+    std::optional<uint32_t> expected;
+    std::optional<uint32_t> got;
+};
+
+/// Every lookup of @p keys against the linear scan; the first mismatch, if any.
+std::optional<Mismatch>
+check(const Classifier& classifier,
+      const std::vector<Rule>& rules,
+      const std::vector<FlowKey>& keys,
+      std::mt19937_64& rng)
+{
+    std::vector<std::optional<ndtClassifier::RuleEffect>> batch(keys.size());
+    classifier.lookupBatch(FUZZ_DPID, keys, batch);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        const FlowKey& key = keys[i];
+        const std::optional<uint32_t> expected = classifier_rules::linearLookup(rules, key);
+
+        const auto effect = classifier.lookup(FUZZ_DPID, key);
+        if (auto got = portOf(effect ? &*effect : nullptr); got != expected)
+        {
+            return Mismatch{"lookup", key, expected, got};
+        }
+        if (auto got = portOf(classifier.lookupEffect(FUZZ_DPID, key)); got != expected)
+        {
+            return Mismatch{"lookupEffect", key, expected, got};
+        }
+        if (auto got = portOf(batch[i] ? &*batch[i] : nullptr); got != expected)
+        {
+            return Mismatch{"lookupBatch", key, expected, got};
+        }
+
+        FlowKey consulted;
+        const auto masked = classifier.lookupWithMask(FUZZ_DPID, key, consulted);
+        if (auto got = portOf(masked ? &*masked : nullptr); got != expected)
+        {
+            return Mismatch{"lookupWithMask", key, expected, got};
+        }
+        const FlowKey flipped = flipUnconsulted(key, consulted, rng);
+        if (auto other = classifier_rules::linearLookup(rules, flipped); other != expected)
+        {
+            return Mismatch{"lookupWithMask consulted mask", flipped, other, expected};
+        }
+
+        const auto pipeline = classifier.lookupPipeline(FUZZ_DPID, key);
+        std::optional<uint32_t> got;
+        if (pipeline)
+        {
+            got = pipeline->outputPorts.size() == 1 ? pipeline->outputPorts.front() : UINT32_MAX;
+        }
+        if (got != expected)
+        {
+            return Mismatch{"lookupPipeline", key, expected, got};
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    LogConfig logConfig;
+    logConfig.level = spdlog::level::err; // lookup() warns of every miss
+    Logger::init(logConfig);
+    FuzzConfig config;
+    try
+    {
+        config = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    std::mt19937_64 rng(config.seed);
+    RuleSet ruleSet(config.rules, rng);
+    Classifier classifier;
+    classifier.updateFromQueriedTables(classifier_rules::tablesJson(FUZZ_DPID, ruleSet.rules()));
+    const size_t changes = std::max<size_t>(1, config.rules * config.churn / 100.0);
+    size_t lookups = 0;
+
+    for (size_t iteration = 0; iteration <= config.iterations; ++iteration)
+    {
+        // iteration 0 checks the initial load
+        const Update update = static_cast<Update>(iteration % 3);
+        if (iteration > 0)
+        {
+            const std::vector<FlowMod> mods = ruleSet.churn(changes, rng);
+            switch (update)
+            {
+            case Update::Poll:
+                classifier.updateFromQueriedTables(
+                    classifier_rules::tablesJson(FUZZ_DPID, ruleSet.rules()));
+                break;
+            case Update::PollText:
+                classifier.updateFromFlowStatsText(
+                    {{FUZZ_DPID, classifier_rules::flowStatsText(FUZZ_DPID, ruleSet.rules())}});
+                break;
+            case Update::FlowMods:
+                classifier.applyFlowMods(mods);
+                break;
+            }
+        }
+
+        std::vector<FlowKey> keys;
+        keys.reserve(config.keys);
+        for (size_t i = 0; i < config.keys; ++i)
+        {
+            keys.push_back(classifier_rules::randomKey(ruleSet.rules(), rng, FUZZ_HIT_RATIO));
+        }
+        std::optional<Mismatch> mismatch = check(classifier, ruleSet.rules(), keys, rng);
+        const size_t ruleCount = classifier.getRuleCount(FUZZ_DPID);
+        if (!mismatch && ruleCount != ruleSet.rules().size())
+        {
+            mismatch = Mismatch{"getRuleCount", FlowKey{}, ruleSet.rules().size(), ruleCount};
+        }
+        lookups += keys.size();
+
+        if (mismatch)
+        {
+            std::fprintf(stderr,
+                         "iteration %zu after %s: %s differs from the linear scan\n",
+                         iteration,
+                         iteration > 0 ? updateName(update) : "the initial load",
+                         mismatch->call.c_str());
+            const json report = {
+                {"seed", config.seed},
+                {"iteration", iteration},
+                {"update", iteration > 0 ? updateName(update) : "updateFromQueriedTables"},
+                {"call", mismatch->call},
+                {"key", classifier_rules::keyJson(mismatch->key)},
+                {"expected", portJson(mismatch->expected)},
+                {"got", portJson(mismatch->got)},
+                {"tables", classifier_rules::tablesJson(FUZZ_DPID, ruleSet.rules())}};
+            std::ofstream out(config.dumpPath);
+            out << report.dump(2) << '\n';
+            if (!out)
+            {
+                std::fprintf(stderr, "Cannot write %s\n", config.dumpPath.c_str());
+            }
+            else
+            {
+                std::fprintf(stderr, "Case written to %s\n", config.dumpPath.c_str());
+            }
+            return 1;
+        }
+        if (iteration % 50 == 0)
+        {
+            std::fprintf(stderr,
+                         "iteration %zu: %zu rules, %zu lookups checked\n",
+                         iteration,
+                         ruleSet.rules().size(),
+                         lookups);
+        }
+    }
+    std::fprintf(stderr,
+                 "%zu iterations, %zu lookups, no mismatch\n",
+                 config.iterations,
+                 lookups);
+    return 0;
+}
@@ -0,0 +1,342 @@
+#include "ClassifierRules.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <bit>
+#include <stdexcept>
+
+using json = nlohmann::json;
+using ndtClassifier::FlowKey;
+
+#define CLASSIFIER_RULES_NET 0x0A000000U // 10.0.0.0, the addresses the rules match ...
+#define CLASSIFIER_RULES_NET_BITS 12     // ... within 10.0.0.0/12
+#define CLASSIFIER_RULES_VLANS 16        // VLAN ids in use
+#define CLASSIFIER_RULES_METADATA 8      // metadata values in use
+
+namespace classifier_rules
+{
+
+namespace
+{
+
+uint32_t
+prefixMask(unsigned length)
+{
+    return length == 0 ? 0 : ~0U << (32 - length);
+}
+
+uint32_t
+randomAddress(std::mt19937_64& rng)
+{
+    return CLASSIFIER_RULES_NET | (rng() & ((1U << (32 - CLASSIFIER_RULES_NET_BITS)) - 1));
+}
+
+uint16_t
+randomTpPort(std::mt19937_64& rng)
+{
+    static const uint16_t wellKnown[] = {22, 53, 80, 443, 5201, 8080};
+    std::bernoulli_distribution ephemeral(0.3);
+    if (ephemeral(rng))
+    {
+        return static_cast<uint16_t>(1024 + rng() % 64512);
+    }
+    return wellKnown[rng() % std::size(wellKnown)];
+}
+
+std::string
+ipString(uint32_t hostOrder)
+{
+    char text[INET_ADDRSTRLEN];
+    const uint32_t address = htonl(hostOrder);
+    inet_ntop(AF_INET, &address, text, sizeof(text));
+    return text;
+}
+
+std::string
+prefixString(uint32_t address, uint32_t mask)
+{
+    return ipString(address) + "/" + std::to_string(std::popcount(mask));
+}
+
+/// The fields of @p key on the bits of @p mask, the others zero.
+FlowKey
+masked(const FlowKey& key, const FlowKey& mask)
+{
+    FlowKey out;
+    out.inPort = key.inPort & mask.inPort;
+    out.ethType = key.ethType & mask.ethType;
+    out.ipProto = key.ipProto & mask.ipProto;
+    out.ipv4Src = key.ipv4Src & mask.ipv4Src;
+    out.ipv4Dst = key.ipv4Dst & mask.ipv4Dst;
+    out.tpSrc = key.tpSrc & mask.tpSrc;
+    out.tpDst = key.tpDst & mask.tpDst;
+    out.vlanTci = key.vlanTci & mask.vlanTci;
+    out.metadata = key.metadata & mask.metadata;
+    return out;
+}
+
+/// A random key over the fields the rules match, not derived from any rule.
+FlowKey
+freeKey(std::mt19937_64& rng)
+{
+    std::bernoulli_distribution ipv4(0.95);
+    std::bernoulli_distribution tcp(0.8);
+    std::bernoulli_distribution tagged(0.1);
+    FlowKey key;
+    key.inPort = 1 + rng() % CLASSIFIER_RULES_PORTS;
+    key.ethType = ipv4(rng) ? 0x0800 : 0x86DD;
+    key.ipProto = tcp(rng) ? 6 : 17;
+    key.ipv4Src = randomAddress(rng);
+    key.ipv4Dst = randomAddress(rng);
+    key.tpSrc = randomTpPort(rng);
+    key.tpDst = randomTpPort(rng);
+    key.vlanTci = tagged(rng) ? 1 + rng() % CLASSIFIER_RULES_VLANS : 0;
+    key.metadata = tagged(rng) ? 1 + rng() % CLASSIFIER_RULES_METADATA : 0;
+    return key;
+}
+
+/// A rule of one of the shapes generate() documents, priority left to the caller.
+Rule
+randomRule(std::mt19937_64& rng)
+{
+    std::discrete_distribution<int> shape({50, 15, 20, 10, 5});
+    std::discrete_distribution<int> dstLength({1, 3, 4}); // /16, /24, /32
+    std::bernoulli_distribution coin(0.5);
+    static const unsigned dstLengths[] = {16, 24, 32};
+
+    Rule rule;
+    rule.outPort = 1 + rng() % CLASSIFIER_RULES_PORTS;
+    rule.mask.ethType = 0xFFFF;
+    rule.value.ethType = 0x0800;
+    switch (shape(rng))
+    {
+    case 0: // route
+        rule.mask.ipv4Dst = prefixMask(dstLengths[dstLength(rng)]);
+        break;
+    case 1: // source and destination pair
+        rule.mask.ipv4Src = prefixMask(coin(rng) ? 24 : 32);
+        rule.mask.ipv4Dst = prefixMask(coin(rng) ? 24 : 32);
+        break;
+    case 2: // 5-tuple ACL entry
+        rule.mask.ipProto = 0xFF;
+        rule.mask.ipv4Src = prefixMask(coin(rng) ? 24 : 32);
+        rule.mask.ipv4Dst = prefixMask(32);
+        rule.mask.tpDst = 0xFFFF;
+        rule.mask.tpSrc = coin(rng) && coin(rng) ? 0xFFFF : 0;
+        break;
+    case 3: // route of one ingress port
+        rule.mask.inPort = 0xFFFFFFFF;
+        rule.mask.ipv4Dst = prefixMask(24);
+        break;
+    default: // VLAN or metadata
+        if (coin(rng))
+        {
+            rule.mask.vlanTci = 0xFFFF;
+        }
+        else
+        {
+            rule.mask.metadata = ~0ULL;
+        }
+        rule.mask.ipv4Dst = prefixMask(16);
+        break;
+    }
+    FlowKey value = freeKey(rng);
+    value.ethType = 0x0800;
+    value.vlanTci = 1 + rng() % CLASSIFIER_RULES_VLANS;
+    value.metadata = 1 + rng() % CLASSIFIER_RULES_METADATA;
+    rule.value = masked(value, rule.mask);
+    return rule;
+}
+
+} // namespace
+
+std::vector<Rule>
+generate(size_t count,
+         std::mt19937_64& rng,
+         bool uniquePriorities,
+         const std::vector<bool>* taken)
+{
+    std::vector<int> priorities;
+    if (uniquePriorities)
+    {
+        for (int p = 1; p <= CLASSIFIER_RULES_MAX_PRIORITY; ++p)
+        {
+            if (!taken || static_cast<size_t>(p) >= taken->size() || !(*taken)[p])
+            {
+                priorities.push_back(p);
+            }
+        }
+        if (count > priorities.size())
+        {
+            throw std::invalid_argument("At most " + std::to_string(priorities.size()) +
+                                        " more rules with unique priorities");
+        }
+        std::shuffle(priorities.begin(), priorities.end(), rng);
+    }
+
+    std::vector<Rule> rules;
+    rules.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        Rule rule = randomRule(rng);
+        rule.priority = uniquePriorities
+                            ? priorities[i]
+                            : static_cast<int>(1 + rng() % CLASSIFIER_RULES_MAX_PRIORITY);
+        rules.push_back(rule);
+    }
+    return rules;
+}
+
+bool
+matches(const Rule& rule, const FlowKey& key)
+{
+    return masked(key, rule.mask) == rule.value;
+}
+
+std::optional<uint32_t>
+linearLookup(const std::vector<Rule>& rules, const FlowKey& key)
+{
+    const Rule* best = nullptr;
+    for (const auto& rule : rules)
+    {
+        if ((!best || rule.priority > best->priority) && matches(rule, key))
+        {
+            best = &rule;
+        }
+    }
+    if (!best)
+    {
+        return std::nullopt;
+    }
+    return best->outPort;
+}
+
+FlowKey
+randomKey(const std::vector<Rule>& rules, std::mt19937_64& rng, double hitRatio)
+{
+    FlowKey key = freeKey(rng);
+    std::bernoulli_distribution hit(hitRatio);
+    if (rules.empty() || !hit(rng))
+    {
+        return key;
+    }
+    const Rule& rule = rules[rng() % rules.size()];
+    key.inPort = (key.inPort & ~rule.mask.inPort) | rule.value.inPort;
+    key.ethType = (key.ethType & ~rule.mask.ethType) | rule.value.ethType;
+    key.ipProto = (key.ipProto & ~rule.mask.ipProto) | rule.value.ipProto;
+    key.ipv4Src = (key.ipv4Src & ~rule.mask.ipv4Src) | rule.value.ipv4Src;
+    key.ipv4Dst = (key.ipv4Dst & ~rule.mask.ipv4Dst) | rule.value.ipv4Dst;
+    key.tpSrc = (key.tpSrc & ~rule.mask.tpSrc) | rule.value.tpSrc;
+    key.tpDst = (key.tpDst & ~rule.mask.tpDst) | rule.value.tpDst;
+    key.vlanTci = (key.vlanTci & ~rule.mask.vlanTci) | rule.value.vlanTci;
+    key.metadata = (key.metadata & ~rule.mask.metadata) | rule.value.metadata;
+    return key;
+}
+
+json
+matchJson(const Rule& rule)
+{
+    json match = json::object();
+    if (rule.mask.inPort)
+    {
+        match["in_port"] = rule.value.inPort;
+    }
+    if (rule.mask.ethType)
+    {
+        match["eth_type"] = rule.value.ethType;
+    }
+    if (rule.mask.ipProto)
+    {
+        match["ip_proto"] = rule.value.ipProto;
+    }
+    if (rule.mask.ipv4Src)
+    {
+        match["ipv4_src"] = prefixString(rule.value.ipv4Src, rule.mask.ipv4Src);
+    }
+    if (rule.mask.ipv4Dst)
+    {
+        match["ipv4_dst"] = prefixString(rule.value.ipv4Dst, rule.mask.ipv4Dst);
+    }
+    if (rule.mask.tpSrc)
+    {
+        match[rule.value.ipProto == 17 ? "udp_src" : "tcp_src"] = rule.value.tpSrc;
+    }
+    if (rule.mask.tpDst)
+    {
+        match[rule.value.ipProto == 17 ? "udp_dst" : "tcp_dst"] = rule.value.tpDst;
+    }
+    if (rule.mask.vlanTci)
+    {
+        match["vlan_vid"] = rule.value.vlanTci;
+    }
+    if (rule.mask.metadata)
+    {
+        match["metadata"] = rule.value.metadata;
+    }
+    return match;
+}
+
+json
+flowJson(const Rule& rule)
+{
+    return {{"priority", rule.priority},
+            {"cookie", 0},
+            {"idle_timeout", 0},
+            {"hard_timeout", 0},
+            {"byte_count", 0},
+            {"packet_count", 0},
+            {"duration_sec", 0},
+            {"duration_nsec", 0},
+            {"table_id", 0},
+            {"match", matchJson(rule)},
+            {"actions", json::array({"OUTPUT:" + std::to_string(rule.outPort)})}};
+}
+
+json
+tablesJson(uint64_t dpid, const std::vector<Rule>& rules)
+{
+    json flows = json::array();
+    for (const auto& rule : rules)
+    {
+        flows.push_back(flowJson(rule));
+    }
+    return json::array({{{"dpid", dpid}, {"flows", std::move(flows)}}});
+}
+
+std::string
+flowStatsText(uint64_t dpid, const std::vector<Rule>& rules)
+{
+    json flows = json::array();
+    for (const auto& rule : rules)
+    {
+        flows.push_back(flowJson(rule));
+    }
+    return json{{std::to_string(dpid), std::move(flows)}}.dump();
+}
+
+ndtClassifier::FlowMod
+flowMod(uint64_t dpid, const Rule& rule, ndtClassifier::FlowMod::Command command)
+{
+    ndtClassifier::FlowMod mod;
+    mod.dpid = dpid;
+    mod.command = command;
+    mod.priority = rule.priority;
+    mod.match = matchJson(rule);
+    mod.actions = json::array({"OUTPUT:" + std::to_string(rule.outPort)});
+    return mod;
+}
+
+json
+keyJson(const FlowKey& key)
+{
+    return {{"in_port", key.inPort},
+            {"eth_type", key.ethType},
+            {"ip_proto", key.ipProto},
+            {"ipv4_src", ipString(key.ipv4Src)},
+            {"ipv4_dst", ipString(key.ipv4Dst)},
+            {"tp_src", key.tpSrc},
+            {"tp_dst", key.tpDst},
+            {"vlan_vid", key.vlanTci},
+            {"metadata", key.metadata}};
+}
+
+} // namespace classifier_rules
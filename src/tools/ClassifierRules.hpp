@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ndt_core/collection/Classifier.hpp" // for FlowKey, FlowMod
+#include <cstdint>                            // for uint32_t, uint64_t
+#include <nlohmann/json.hpp>                  // for json
+#include <optional>                           // for optional
+#include <random>                             // for mt19937_64
+#include <string>                             // for string
+#include <vector>                             // for vector
+
+#define CLASSIFIER_RULES_MAX_PRIORITY 65535 // OpenFlow priorities are 16 bits
+#define CLASSIFIER_RULES_PORTS 48           // switch ports, for in_port and the OUTPUT actions
+
+namespace classifier_rules
+{
+
+/**
+ * @brief One OpenFlow rule of a generated table, with a single OUTPUT action.
+ *
+ * mask and value are in the layout of ndtClassifier::FlowKey: a field the rule matches has
+ * its mask bits set (a prefix for the IPv4 fields, all bits otherwise) and value is already
+ * masked.
+ */
+struct Rule
+{
+    ndtClassifier::FlowKey mask;
+    ndtClassifier::FlowKey value;
+    int priority = 0;
+    uint32_t outPort = 0;
+};
+
+/**
+ * @brief @p count rules in the proportions of a data-center switch table.
+ *
+ * Half route on an IPv4 destination prefix (/16, /24 or /32), the rest are source and
+ * destination pairs, 5-tuple ACL entries, in_port-qualified routes, and VLAN or metadata
+ * rules. Addresses are drawn from 10.0.0.0/12 so that random keys match often. With
+ * @p uniquePriorities no two rules share a priority, so the highest-priority match of any
+ * key is a single rule; @p count must then be at most CLASSIFIER_RULES_MAX_PRIORITY, and
+ * @p taken (if given) lists priorities already in use that are skipped as well.
+ */
+std::vector<Rule> generate(size_t count,
+                           std::mt19937_64& rng,
+                           bool uniquePriorities,
+                           const std::vector<bool>* taken = nullptr);
+
+/// Whether @p key matches @p rule, i.e. equals its value on the bits of its mask.
+bool matches(const Rule& rule, const ndtClassifier::FlowKey& key);
+
+/**
+ * @brief The reference result: the output port of the highest-priority rule matching @p key,
+ *        by scanning every rule.
+ */
+std::optional<uint32_t> linearLookup(const std::vector<Rule>& rules,
+                                     const ndtClassifier::FlowKey& key);
+
+/**
+ * @brief A key for a lookup: with probability @p hitRatio, the value of a random rule with
+ *        the bits outside its mask randomized (so it matches that rule or a higher one),
+ *        otherwise a random key over the same fields.
+ */
+ndtClassifier::FlowKey randomKey(const std::vector<Rule>& rules,
+                                 std::mt19937_64& rng,
+                                 double hitRatio);
+
+/// The "match" object of @p rule, with the OpenFlow 1.3 field names.
+nlohmann::json matchJson(const Rule& rule);
+
+/// The flow entry of @p rule as Ryu lists it under /stats/flow/<dpid>.
+nlohmann::json flowJson(const Rule& rule);
+
+/// The rules of switch @p dpid, in the shape Classifier::updateFromQueriedTables() takes.
+nlohmann::json tablesJson(uint64_t dpid, const std::vector<Rule>& rules);
+
+/// The Ryu /stats/flow/<dpid> response body of the rules, for updateFromFlowStatsText().
+std::string flowStatsText(uint64_t dpid, const std::vector<Rule>& rules);
+
+/// The flow-mod that adds (or DeleteStrict-removes) @p rule on switch @p dpid.
+ndtClassifier::FlowMod flowMod(uint64_t dpid,
+                               const Rule& rule,
+                               ndtClassifier::FlowMod::Command command);
+
+/// @p key as a JSON object, for reports.
+nlohmann::json keyJson(const ndtClassifier::FlowKey& key);
+
+} // namespace classifier_rules
@@ -0,0 +1,649 @@
+/**
+ * @file FailoverBench.cpp
+ * @brief Fails links of a running MININET-mode NDTwin one at a time and measures how fast
+ *        its flows fail over, for the failover latency SLO.
+ *
+ * Setup: Mininet built from the static topology (by default
+ * setting/StaticNetworkTopologyMininet_10Switches.json), NDTwin started in MININET mode on
+ * the same file (with --fast-reroute if that is what is measured) and traffic between the
+ * hosts, e.g. iperf3 pairs. --traffic runs a shell command for the length of the benchmark
+ * to start that traffic, and is stopped at the end.
+ *
+ * Each trial takes the next switch-to-switch link carrying detected flows and:
+ *   1. with --ovs, sets its two ports down on their bridges (ovs-ofctl mod-port), so the
+ *      traffic really loses the link;
+ *   2. posts /ndt/link_failure_detected as Ryu would, keeping the returned trace_id;
+ *   3. polls /ndt/get_detected_flow_data until no flow that crossed the link is resolved
+ *      through it any more and every one has a path again (path convergence), and until
+ *      their rates are back to --recovery of what they were before (traffic recovery);
+ *   4. reads the trial's trace from /ndt/debug/traces: the time from the failure to the last
+ *      classifier_confirmation span is when its flow-mods were applied, and each span gives
+ *      the time of its stage;
+ *   5. brings the link back (ports up, /ndt/link_recovery_detected) and waits --settle-ms.
+ *
+ * The report gives each trial and p50/p99/max per measure, and with --json writes them to
+ * a file to compare releases.
+ *
+ * Usage:
+ *   ndt_failover_bench [--ndt http://127.0.0.1:8000]
+ *                      [--topology setting/StaticNetworkTopologyMininet_10Switches.json]
+ *                      [--trials <n>] [--ovs] [--traffic <shell command>]
+ *                      [--warmup-s <s>] [--settle-ms <ms>] [--timeout-ms <ms>]
+ *                      [--poll-ms <ms>] [--recovery <0..1>] [--json <file>]
+ */
+#include "utils/HttpClient.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/wait.h>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+#define BENCH_DEFAULT_TOPOLOGY "setting/StaticNetworkTopologyMininet_10Switches.json"
+#define BENCH_DEFAULT_TRIALS 10
+#define BENCH_DEFAULT_WARMUP_S 10       // for the traffic to be detected before the first trial
+#define BENCH_DEFAULT_SETTLE_MS 5000    // after bringing a link back
+#define BENCH_DEFAULT_TIMEOUT_MS 30000  // a trial not converged by then is reported as such
+#define BENCH_DEFAULT_POLL_MS 20        // between two reads of the detected flows
+#define BENCH_DEFAULT_RECOVERY 0.9      // share of the pre-failure rate that counts as recovered
+#define BENCH_TRACE_WAIT_MS 2000        // for the last spans of a trace once traffic recovered
+
+namespace
+{
+
+struct BenchConfig
+{
+    std::string ndtUrl = "http://127.0.0.1:8000";
+    std::string topologyPath = BENCH_DEFAULT_TOPOLOGY;
+    size_t trials = BENCH_DEFAULT_TRIALS;
+    bool ovs = false;
+    std::string trafficCommand;
+    uint64_t warmupSeconds = BENCH_DEFAULT_WARMUP_S;
+    uint64_t settleMs = BENCH_DEFAULT_SETTLE_MS;
+    uint64_t timeoutMs = BENCH_DEFAULT_TIMEOUT_MS;
+    uint64_t pollMs = BENCH_DEFAULT_POLL_MS;
+    double recovery = BENCH_DEFAULT_RECOVERY;
+    std::string jsonPath;
+};
+
+BenchConfig
+parseArgs(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/FailoverBench.cpp\n");
+            std::exit(0);
+        }
+        if (arg == "--ovs")
+        {
+            config.ovs = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--ndt")
+        {
+            config.ndtUrl = value;
+        }
+        else if (arg == "--topology")
+        {
+            config.topologyPath = value;
+        }
+        else if (arg == "--trials")
+        {
+            config.trials = std::stoul(value);
+        }
+        else if (arg == "--traffic")
+        {
+            config.trafficCommand = value;
+        }
+        else if (arg == "--warmup-s")
+        {
+            config.warmupSeconds = std::stoull(value);
+        }
+        else if (arg == "--settle-ms")
+        {
+            config.settleMs = std::stoull(value);
+        }
+        else if (arg == "--timeout-ms")
+        {
+            config.timeoutMs = std::stoull(value);
+        }
+        else if (arg == "--poll-ms")
+        {
+            config.pollMs = std::max<uint64_t>(1, std::stoull(value));
+        }
+        else if (arg == "--recovery")
+        {
+            config.recovery = std::stod(value);
+        }
+        else if (arg == "--json")
+        {
+            config.jsonPath = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    return config;
+}
+
+//================================================================
+// Topology and flows
+//================================================================
+
+struct Link
+{
+    uint64_t srcDpid;
+    uint32_t srcPort;
+    uint64_t dstDpid;
+    uint32_t dstPort;
+    std::string srcBridge;
+    std::string dstBridge;
+
+    json body() const
+    {
+        return {{"src_dpid", srcDpid},
+                {"src_interface", srcPort},
+                {"dst_dpid", dstDpid},
+                {"dst_interface", dstPort}};
+    }
+
+    std::string name() const
+    {
+        return std::to_string(srcDpid) + ":" + std::to_string(srcPort) + "-" +
+               std::to_string(dstDpid) + ":" + std::to_string(dstPort);
+    }
+};
+
+/// The switch-to-switch links of the topology file, each once.
+std::vector<Link>
+loadLinks(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    const json topology = json::parse(in);
+    std::map<uint64_t, std::string> bridges; // switches by dpid
+    for (const auto& node : topology.at("nodes"))
+    {
+        if (node.value("vertex_type", 1) == 0)
+        {
+            bridges[node.at("dpid").get<uint64_t>()] =
+                node.value("bridge_name", node.value("device_name", ""));
+        }
+    }
+    std::vector<Link> links;
+    for (const auto& edge : topology.at("edges"))
+    {
+        const uint64_t src = edge.value("src_dpid", 0ULL);
+        const uint64_t dst = edge.value("dst_dpid", 0ULL);
+        if (!bridges.count(src) || !bridges.count(dst) || src > dst)
+        {
+            continue;
+        }
+        links.push_back({src,
+                         edge.at("src_interface").get<uint32_t>(),
+                         dst,
+                         edge.at("dst_interface").get<uint32_t>(),
+                         bridges[src],
+                         bridges[dst]});
+    }
+    return links;
+}
+
+using FlowId = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>;
+
+struct FlowState
+{
+    bool crosses = false; // resolved through the link of the trial
+    bool routed = false;  // resolved to some path
+    double bps = 0;
+};
+
+bool
+pathCrosses(const json& path, const Link& link)
+{
+    for (size_t i = 0; i + 1 < path.size(); ++i)
+    {
+        const uint64_t node = path[i].value("node", 0ULL);
+        const uint64_t next = path[i + 1].value("node", 0ULL);
+        const uint32_t port = path[i].value("interface", 0U);
+        if ((node == link.srcDpid && port == link.srcPort && next == link.dstDpid) ||
+            (node == link.dstDpid && port == link.dstPort && next == link.srcDpid))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<std::map<FlowId, FlowState>>
+readFlows(const BenchConfig& config, const Link& link)
+{
+    auto response =
+        utils::HttpClient::instance().get(config.ndtUrl + "/ndt/get_detected_flow_data");
+    if (!response.ok())
+    {
+        return std::nullopt;
+    }
+    std::map<FlowId, FlowState> flows;
+    for (const auto& flow : json::parse(response.body))
+    {
+        const FlowId id{flow.value("src_ip", 0U),
+                        flow.value("dst_ip", 0U),
+                        flow.value("src_port", 0U),
+                        flow.value("dst_port", 0U),
+                        flow.value("protocol_id", 0U)};
+        const json path = flow.value("path", json::array());
+        flows[id] = {pathCrosses(path, link),
+                     !path.empty(),
+                     flow.value("estimated_flow_sending_rate_bps_in_the_last_sec", 0.0)};
+    }
+    return flows;
+}
+
+size_t
+countCrossing(const std::map<FlowId, FlowState>& flows)
+{
+    return std::count_if(
+        flows.begin(), flows.end(), [](const auto& entry) { return entry.second.crosses; });
+}
+
+//================================================================
+// Failure injection
+//================================================================
+
+void
+setPorts(const BenchConfig& config, const Link& link, bool up)
+{
+    if (!config.ovs)
+    {
+        return;
+    }
+    const char* state = up ? "up" : "down";
+    for (const auto& [bridge, port] :
+         {std::pair{link.srcBridge, link.srcPort}, std::pair{link.dstBridge, link.dstPort}})
+    {
+        const std::string command =
+            "ovs-ofctl mod-port " + bridge + " " + std::to_string(port) + " " + state;
+        if (std::system(command.c_str()) != 0)
+        {
+            std::fprintf(stderr, "'%s' failed\n", command.c_str());
+        }
+    }
+}
+
+pid_t
+startTraffic(const std::string& command)
+{
+    pid_t pid = ::fork();
+    if (pid == 0)
+    {
+        ::setpgid(0, 0);
+        ::execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+        std::_Exit(127);
+    }
+    return pid;
+}
+
+void
+stopTraffic(pid_t pid)
+{
+    if (pid > 0)
+    {
+        ::kill(-pid, SIGTERM);
+        ::waitpid(pid, nullptr, 0);
+    }
+}
+
+//================================================================
+// Trials
+//================================================================
+
+struct Trial
+{
+    std::string link;
+    std::string traceId;
+    size_t flows = 0;                     // crossing the link before the failure
+    std::optional<double> convergenceMs;  // no affected flow resolved through the link
+    std::optional<double> recoveryMs;     // affected flows back to their rates
+    std::optional<double> appliedMs;      // last classifier_confirmation span, from the trace
+    std::map<std::string, double> stageMs; // span durations, summed per stage
+};
+
+double
+msBetween(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+/// Fill the trace measures of @p trial from /ndt/debug/traces; false if its trace is not there.
+bool
+readTrace(const BenchConfig& config, Trial& trial)
+{
+    auto response = utils::HttpClient::instance().get(config.ndtUrl + "/ndt/debug/traces?limit=8");
+    if (!response.ok())
+    {
+        return false;
+    }
+    const json traces = json::parse(response.body, nullptr, false);
+    if (traces.is_discarded())
+    {
+        return false;
+    }
+    std::optional<uint64_t> failureStart;
+    std::optional<uint64_t> lastConfirmation;
+    std::map<std::string, double> stages;
+    for (const auto& resource : traces.value("resourceSpans", json::array()))
+    {
+        for (const auto& scope : resource.value("scopeSpans", json::array()))
+        {
+            for (const auto& span : scope.value("spans", json::array()))
+            {
+                if (span.value("traceId", "") != trial.traceId)
+                {
+                    continue;
+                }
+                const uint64_t start = std::stoull(span.value("startTimeUnixNano", "0"));
+                const uint64_t end = std::stoull(span.value("endTimeUnixNano", "0"));
+                const std::string name = span.value("name", "");
+                if (name == "link_failure")
+                {
+                    failureStart = start;
+                    continue;
+                }
+                stages[name] += (end - start) / 1e6;
+                if (name == "classifier_confirmation")
+                {
+                    lastConfirmation = std::max(lastConfirmation.value_or(0), end);
+                }
+            }
+        }
+    }
+    if (!failureStart)
+    {
+        return false;
+    }
+    trial.stageMs = std::move(stages);
+    if (lastConfirmation)
+    {
+        trial.appliedMs = (*lastConfirmation - *failureStart) / 1e6;
+    }
+    return true;
+}
+
+Trial
+runTrial(const BenchConfig& config, const Link& link)
+{
+    auto& client = utils::HttpClient::instance();
+    Trial trial;
+    trial.link = link.name();
+    auto before = readFlows(config, link);
+    if (!before)
+    {
+        throw std::runtime_error("Cannot read the detected flows at " + config.ndtUrl);
+    }
+    std::map<FlowId, double> affected; // pre-failure rates
+    for (const auto& [id, state] : *before)
+    {
+        if (state.crosses)
+        {
+            affected[id] = state.bps;
+        }
+    }
+    trial.flows = affected.size();
+
+    const auto start = Clock::now();
+    setPorts(config, link, false);
+    auto response = client.post(config.ndtUrl + "/ndt/link_failure_detected", link.body().dump());
+    if (!response.ok())
+    {
+        setPorts(config, link, true);
+        throw std::runtime_error("link_failure_detected answered " +
+                                 std::to_string(response.status) + " for " + link.name());
+    }
+    trial.traceId = json::parse(response.body).value("trace_id", "");
+
+    const auto deadline = start + std::chrono::milliseconds(config.timeoutMs);
+    while (Clock::now() < deadline && (!trial.convergenceMs || !trial.recoveryMs))
+    {
+        const auto flows = readFlows(config, link);
+        const auto now = Clock::now();
+        if (flows)
+        {
+            bool converged = true;
+            bool recovered = true;
+            for (const auto& [id, bps] : affected)
+            {
+                auto it = flows->find(id);
+                if (it == flows->end() || it->second.crosses || !it->second.routed)
+                {
+                    converged = false;
+                    recovered = false;
+                    break;
+                }
+                recovered = recovered && it->second.bps >= config.recovery * bps;
+            }
+            if (converged && !trial.convergenceMs)
+            {
+                trial.convergenceMs = msBetween(start, now);
+            }
+            if (recovered && !trial.recoveryMs)
+            {
+                trial.recoveryMs = msBetween(start, now);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(config.pollMs));
+    }
+
+    // The confirmation spans may still be closing when the traffic is back
+    const auto traceDeadline = Clock::now() + std::chrono::milliseconds(BENCH_TRACE_WAIT_MS);
+    while (!trial.traceId.empty() && (!readTrace(config, trial) || !trial.appliedMs) &&
+           Clock::now() < traceDeadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(config.pollMs * 5));
+    }
+
+    setPorts(config, link, true);
+    client.post(config.ndtUrl + "/ndt/link_recovery_detected", link.body().dump());
+    std::this_thread::sleep_for(std::chrono::milliseconds(config.settleMs));
+    return trial;
+}
+
+//================================================================
+// Report
+//================================================================
+
+struct Summary
+{
+    size_t count = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+Summary
+summarize(std::vector<double> values)
+{
+    Summary summary;
+    if (values.empty())
+    {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    summary.count = values.size();
+    summary.p50 = values[values.size() / 2];
+    summary.p99 = values[std::min(values.size() - 1, values.size() * 99 / 100)];
+    summary.max = values.back();
+    return summary;
+}
+
+std::string
+formatMs(const std::optional<double>& ms)
+{
+    char text[32];
+    if (!ms)
+    {
+        return "timeout";
+    }
+    std::snprintf(text, sizeof(text), "%.1f", *ms);
+    return text;
+}
+
+json
+report(const std::vector<Trial>& trials)
+{
+    std::map<std::string, std::vector<double>> measures;
+    json result = {{"trials", json::array()}};
+    std::printf("%-24s %6s %14s %14s %14s\n",
+                "link",
+                "flows",
+                "converged ms",
+                "applied ms",
+                "recovered ms");
+    for (const auto& trial : trials)
+    {
+        std::printf("%-24s %6zu %14s %14s %14s\n",
+                    trial.link.c_str(),
+                    trial.flows,
+                    formatMs(trial.convergenceMs).c_str(),
+                    formatMs(trial.appliedMs).c_str(),
+                    formatMs(trial.recoveryMs).c_str());
+        json entry = {{"link", trial.link},
+                      {"trace_id", trial.traceId},
+                      {"flows", trial.flows},
+                      {"stages_ms", trial.stageMs}};
+        for (const auto& [name, value] : {std::pair{"convergence_ms", trial.convergenceMs},
+                                          std::pair{"applied_ms", trial.appliedMs},
+                                          std::pair{"recovery_ms", trial.recoveryMs}})
+        {
+            entry[name] = value ? json(*value) : json(nullptr);
+            if (value)
+            {
+                measures[name].push_back(*value);
+            }
+        }
+        for (const auto& [stage, ms] : trial.stageMs)
+        {
+            measures["stage " + stage].push_back(ms);
+        }
+        result["trials"].push_back(std::move(entry));
+    }
+
+    std::printf("\n%-32s %6s %10s %10s %10s\n", "measure (ms)", "n", "p50", "p99", "max");
+    for (const auto& [name, values] : measures)
+    {
+        const Summary summary = summarize(values);
+        std::printf("%-32s %6zu %10.1f %10.1f %10.1f\n",
+                    name.c_str(),
+                    summary.count,
+                    summary.p50,
+                    summary.p99,
+                    summary.max);
+        result["summary"][name] = {{"count", summary.count},
+                                   {"p50", summary.p50},
+                                   {"p99", summary.p99},
+                                   {"max", summary.max}};
+    }
+    return result;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    Logger::init(LogConfig{});
+    BenchConfig config;
+    std::vector<Link> links;
+    try
+    {
+        config = parseArgs(argc, argv);
+        links = loadLinks(config.topologyPath);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+    if (links.empty())
+    {
+        std::fprintf(stderr, "No switch-to-switch link in %s\n", config.topologyPath.c_str());
+        return 2;
+    }
+
+    const pid_t traffic = config.trafficCommand.empty() ? 0 : startTraffic(config.trafficCommand);
+    std::this_thread::sleep_for(std::chrono::seconds(config.warmupSeconds));
+
+    std::vector<Trial> trials;
+    int status = 0;
+    try
+    {
+        size_t next = 0;
+        size_t idle = 0; // links passed over in a row for carrying no flow
+        while (trials.size() < config.trials && idle < links.size())
+        {
+            const Link& link = links[next++ % links.size()];
+            auto flows = readFlows(config, link);
+            if (!flows)
+            {
+                throw std::runtime_error("Cannot read the detected flows at " + config.ndtUrl);
+            }
+            if (countCrossing(*flows) == 0)
+            {
+                ++idle;
+                continue;
+            }
+            idle = 0;
+            trials.push_back(runTrial(config, link));
+        }
+        if (trials.empty())
+        {
+            std::fprintf(stderr, "No detected flow crosses a switch-to-switch link\n");
+            status = 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        status = 1;
+    }
+    stopTraffic(traffic);
+
+    if (!trials.empty())
+    {
+        const json result = report(trials);
+        if (!config.jsonPath.empty())
+        {
+            std::ofstream(config.jsonPath) << result.dump(2) << '\n';
+        }
+    }
+    return status;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file FlightDump.cpp
+ * @brief Prints a flight recorder image as JSON: the file ndtwin_kernel writes when it
+ *        crashes (--flight-recorder-dump), or GET /ndt/debug/flight_recorder?format=binary.
+ *
+ * Records are listed per thread, oldest first, as GET /ndt/debug/flight_recorder lists them.
+ *
+ * Usage:
+ *   ndt_flight_dump [--kind sample|classifier_miss|flow_job|event] [--limit <records per thread>]
+ *                   [<image file, default ndt_flight_recorder.bin>]
+ */
+#include "event_system/EventBus.hpp"
+#include "utils/FlightRecorder.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace
+{
+
+struct DumpConfig
+{
+    std::string path = FLIGHT_RECORDER_DUMP_PATH;
+    std::optional<utils::FlightRecordKind> kind;
+    size_t limit = SIZE_MAX;
+};
+
+DumpConfig
+parseArgs(int argc, char* argv[])
+{
+    DumpConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/FlightDump.cpp\n");
+            std::exit(0);
+        }
+        if (!arg.starts_with("--"))
+        {
+            config.path = arg;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--kind")
+        {
+            config.kind = utils::FlightRecorder::kindFromName(value);
+            if (!config.kind)
+            {
+                throw std::invalid_argument("Unknown record kind " + value);
+            }
+        }
+        else if (arg == "--limit")
+        {
+            config.limit = std::stoull(value);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    return config;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    DumpConfig config;
+    try
+    {
+        config = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    std::ifstream in(config.path, std::ios::binary);
+    if (!in)
+    {
+        std::fprintf(stderr, "Cannot read %s\n", config.path.c_str());
+        return 1;
+    }
+    const std::string image{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+    nlohmann::json out;
+    try
+    {
+        out = utils::FlightRecorder::decode(image, config.kind, config.limit);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::fprintf(stderr, "%s: %s\n", config.path.c_str(), e.what());
+        return 1;
+    }
+    for (auto& thread : out["threads"])
+    {
+        for (auto& record : thread["records"])
+        {
+            if (auto type = record.find("event_type");
+                type != record.end() && type->get<size_t>() < EVENT_TYPE_COUNT)
+            {
+                record["event"] = eventTypeName(static_cast<EventType>(type->get<size_t>()));
+            }
+        }
+    }
+    std::cout << out.dump(2) << '\n';
+    return 0;
+}
@@ -0,0 +1,498 @@
+/**
+ * @file HashBench.cpp
+ * @brief Distribution and throughput of the hash policies of utils/Hash.hpp on flow keys,
+ *        written as JSON to compare policies and commits.
+ *
+ * Each policy hashes the key sets through sflow::BasicFlowKeyHash<Policy>, the way the flow
+ * table does; "hash-combine" is the boost-style combine over std::hash the policies replaced,
+ * as a baseline. The key sets:
+ *   - sequential-src: source addresses counting up from 10.0.0.1, one destination and port;
+ *   - sequential-port: source ports counting up, as from a single host (the next source
+ *     address every 65536 keys);
+ *   - fat-tree: hosts of 10.0.0.0/16 in random pairs, ephemeral ports to a few services;
+ *   - random: uniformly random 5-tuples.
+ *
+ * For every policy and key set, --keys keys go into 2^b buckets (the smallest power of two
+ * at least --keys / --load) by the low bits, as FlatHashMap places slots and the flow
+ * shards are picked, and by the high bits; the result gives the chi-square of each divided
+ * by its degrees of freedom (about 1 for a uniform hash, far above for clustering), the
+ * largest bucket, the chi-square of the 7-bit control tags FlatHashMap keeps from the top
+ * bits, and the number of full 64-bit collisions. Avalanche flips each of the 104 key bits
+ * of --avalanche-keys keys and reports the mean fraction of output bits that change (0.5 is
+ * ideal) and the worst output bit's deviation from 0.5.
+ *
+ * Throughput is the mean and p50/p99 of batches of BENCH_BATCH hashes, in nanoseconds per
+ * hash, of the flow keys and of 4-word keys the size of the classifier's packed key. The JSON
+ * document goes to stdout (or --out), progress to stderr.
+ *
+ * Usage:
+ *   ndt_hash_bench [--keys <n>] [--load <keys per bucket>] [--avalanche-keys <n>]
+ *                  [--repeat <n>] [--label <text>] [--seed <n>] [--out <file>]
+ */
+#include "common_types/SFlowType.hpp"
+#include "utils/Hash.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+#define BENCH_BATCH 256                   // hashes per timed batch
+#define BENCH_DEFAULT_KEYS 1000000        // keys of each key set
+#define BENCH_DEFAULT_LOAD 1.0            // keys per bucket of the distribution
+#define BENCH_DEFAULT_AVALANCHE_KEYS 2000 // keys whose bits the avalanche test flips
+#define BENCH_DEFAULT_REPEAT 3            // passes of the throughput benchmarks
+#define BENCH_TAG_BITS 7                  // FlatHashMap's control tag, from the top bits
+#define BENCH_KEY_BITS 104                // bits of a 5-tuple: two addresses, two ports, protocol
+#define BENCH_WIDE_WORDS 4                // words of the classifier's packed key
+#if defined(__SSE4_2__)
+#define BENCH_SSE4_2 true // Crc32cHashPolicy is built
+#else
+#define BENCH_SSE4_2 false
+#endif
+
+namespace
+{
+
+struct BenchConfig
+{
+    size_t keys = BENCH_DEFAULT_KEYS;
+    double load = BENCH_DEFAULT_LOAD;
+    size_t avalancheKeys = BENCH_DEFAULT_AVALANCHE_KEYS;
+    size_t repeat = BENCH_DEFAULT_REPEAT;
+    std::string label;
+    uint64_t seed = 1;
+    std::string outPath; // empty: stdout
+};
+
+BenchConfig
+parseArgs(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/HashBench.cpp\n");
+            std::exit(0);
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--keys")
+        {
+            config.keys = std::max(16UL, std::stoul(value));
+        }
+        else if (arg == "--load")
+        {
+            config.load = std::max(0.01, std::stod(value));
+        }
+        else if (arg == "--avalanche-keys")
+        {
+            config.avalancheKeys = std::stoul(value);
+        }
+        else if (arg == "--repeat")
+        {
+            config.repeat = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--label")
+        {
+            config.label = value;
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = std::stoull(value);
+        }
+        else if (arg == "--out")
+        {
+            config.outPath = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    return config;
+}
+
+//================================================================
+// Hashes
+//================================================================
+
+/// The FlowKey hash before the policies: boost-style hashCombine over std::hash of each field.
+struct CombineFlowKeyHash
+{
+    template <typename T>
+    static void combine(size_t& seed, const T& value)
+    {
+        seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    size_t operator()(const sflow::FlowKey& key) const noexcept
+    {
+        size_t seed = 0;
+        combine(seed, key.srcIP);
+        combine(seed, key.dstIP);
+        combine(seed, key.srcPort);
+        combine(seed, key.dstPort);
+        combine(seed, key.protocol);
+        return seed;
+    }
+};
+
+/// The same for a key of BENCH_WIDE_WORDS words.
+struct CombineHashPolicy
+{
+    static uint64_t hash(const uint64_t* words, size_t count) noexcept
+    {
+        size_t seed = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            CombineFlowKeyHash::combine(seed, words[i]);
+        }
+        return seed;
+    }
+};
+
+//================================================================
+// Key sets
+//================================================================
+
+struct KeySet
+{
+    std::string name;
+    std::vector<sflow::FlowKey> keys;
+};
+
+std::vector<KeySet>
+makeKeySets(const BenchConfig& config)
+{
+    std::mt19937_64 rng(config.seed);
+    std::vector<KeySet> sets(4);
+    sets[0].name = "sequential-src";
+    sets[1].name = "sequential-port";
+    sets[2].name = "fat-tree";
+    sets[3].name = "random";
+    static const uint16_t services[] = {22, 53, 80, 443, 5201};
+    std::uniform_int_distribution<uint32_t> host(1, 65534);
+    std::uniform_int_distribution<uint32_t> ephemeral(32768, 60999);
+    for (auto& set : sets)
+    {
+        set.keys.reserve(config.keys);
+    }
+    for (size_t i = 0; i < config.keys; ++i)
+    {
+        sflow::FlowKey key;
+        key.srcIP = htonl(0x0A000001U + static_cast<uint32_t>(i));
+        key.dstIP = htonl(0xAC100001U);
+        key.srcPort = 40000;
+        key.dstPort = 5201;
+        key.protocol = 6;
+        sets[0].keys.push_back(key);
+
+        key.srcIP = htonl(0x0A000001U + static_cast<uint32_t>(i >> 16));
+        key.srcPort = static_cast<uint16_t>(i);
+        sets[1].keys.push_back(key);
+
+        key.srcIP = htonl(0x0A000000U | host(rng));
+        key.dstIP = htonl(0x0A000000U | host(rng));
+        key.srcPort = static_cast<uint16_t>(ephemeral(rng));
+        key.dstPort = services[rng() % std::size(services)];
+        key.protocol = key.dstPort == 53 ? 17 : 6;
+        sets[2].keys.push_back(key);
+
+        key.srcIP = static_cast<uint32_t>(rng());
+        key.dstIP = static_cast<uint32_t>(rng());
+        key.srcPort = static_cast<uint16_t>(rng());
+        key.dstPort = static_cast<uint16_t>(rng());
+        key.protocol = static_cast<uint8_t>(rng());
+        sets[3].keys.push_back(key);
+    }
+    return sets;
+}
+
+//================================================================
+// Distribution
+//================================================================
+
+/// Chi-square of @p counts against a uniform spread, over its degrees of freedom.
+double
+chiSquarePerDegree(const std::vector<uint32_t>& counts, size_t total)
+{
+    const double expected = double(total) / counts.size();
+    double chi = 0;
+    for (const uint32_t c : counts)
+    {
+        chi += (c - expected) * (c - expected) / expected;
+    }
+    return chi / (counts.size() - 1);
+}
+
+/// @p key with bit @p bit of its 104 flipped (addresses, then ports, then protocol).
+sflow::FlowKey
+flipBit(sflow::FlowKey key, unsigned bit)
+{
+    if (bit < 32)
+    {
+        key.srcIP ^= 1U << bit;
+    }
+    else if (bit < 64)
+    {
+        key.dstIP ^= 1U << (bit - 32);
+    }
+    else if (bit < 80)
+    {
+        key.srcPort ^= static_cast<uint16_t>(1U << (bit - 64));
+    }
+    else if (bit < 96)
+    {
+        key.dstPort ^= static_cast<uint16_t>(1U << (bit - 80));
+    }
+    else
+    {
+        key.protocol ^= static_cast<uint8_t>(1U << (bit - 96));
+    }
+    return key;
+}
+
+template <typename Hash>
+json
+distribution(const BenchConfig& config, const KeySet& set)
+{
+    const Hash hasher;
+    const size_t n = set.keys.size();
+    const unsigned bits =
+        std::max(1U, static_cast<unsigned>(std::bit_width(
+                         static_cast<size_t>(std::ceil(n / config.load)) - 1)));
+    const size_t buckets = size_t{1} << bits;
+    std::vector<uint32_t> low(buckets);
+    std::vector<uint32_t> high(buckets);
+    std::vector<uint32_t> tags(size_t{1} << BENCH_TAG_BITS);
+    std::vector<uint64_t> hashes;
+    hashes.reserve(n);
+    for (const auto& key : set.keys)
+    {
+        const uint64_t h = hasher(key);
+        ++low[h & (buckets - 1)];
+        ++high[h >> (64 - bits)];
+        ++tags[h >> (64 - BENCH_TAG_BITS)];
+        hashes.push_back(h);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    const size_t collisions =
+        n - (std::unique(hashes.begin(), hashes.end()) - hashes.begin());
+
+    // avalanche: how often each output bit changes when one input bit does
+    std::array<uint64_t, 64> flips{};
+    size_t trials = 0;
+    for (size_t k = 0; k < std::min(config.avalancheKeys, n); ++k)
+    {
+        const sflow::FlowKey& key = set.keys[k * (n / std::min(config.avalancheKeys, n))];
+        const uint64_t h = hasher(key);
+        for (unsigned bit = 0; bit < BENCH_KEY_BITS; ++bit)
+        {
+            const uint64_t diff = h ^ static_cast<uint64_t>(hasher(flipBit(key, bit)));
+            for (unsigned out = 0; out < 64; ++out)
+            {
+                flips[out] += (diff >> out) & 1;
+            }
+            ++trials;
+        }
+    }
+    double mean = 0;
+    double worst = 0;
+    for (const uint64_t f : flips)
+    {
+        const double p = trials ? double(f) / trials : 0.0;
+        mean += p / 64;
+        worst = std::max(worst, std::abs(p - 0.5));
+    }
+
+    return {{"buckets", buckets},
+            {"chi2_low", chiSquarePerDegree(low, n)},
+            {"chi2_high", chiSquarePerDegree(high, n)},
+            {"max_bucket_low", *std::max_element(low.begin(), low.end())},
+            {"max_bucket_high", *std::max_element(high.begin(), high.end())},
+            {"chi2_tags", chiSquarePerDegree(tags, n)},
+            {"collisions", collisions},
+            {"avalanche_mean", mean},
+            {"avalanche_worst_bias", worst}};
+}
+
+//================================================================
+// Throughput
+//================================================================
+
+/// Keep @p value alive so the work producing it is not optimized away.
+template <typename T>
+inline void
+keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/// Mean and p50/p99 of batches of @p count calls of @p op(i), in ns per call.
+template <typename Op>
+json
+timeBatches(size_t count, size_t repeat, Op&& op)
+{
+    std::vector<double> batches;
+    double totalNs = 0;
+    size_t ops = 0;
+    for (size_t r = 0; r < repeat; ++r)
+    {
+        for (size_t begin = 0; begin < count; begin += BENCH_BATCH)
+        {
+            const size_t end = std::min(count, begin + BENCH_BATCH);
+            const auto start = Clock::now();
+            for (size_t i = begin; i < end; ++i)
+            {
+                op(i);
+            }
+            const double ns =
+                std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            batches.push_back(ns / (end - begin));
+            totalNs += ns;
+            ops += end - begin;
+        }
+    }
+    std::sort(batches.begin(), batches.end());
+    auto at = [&](double q) {
+        return batches.empty() ? 0.0
+                               : batches[std::min(batches.size() - 1,
+                                                  static_cast<size_t>(batches.size() * q))];
+    };
+    return {{"ops", ops},
+            {"ns_per_op", ops ? totalNs / ops : 0.0},
+            {"p50_ns", at(0.50)},
+            {"p99_ns", at(0.99)}};
+}
+
+/// Distribution on every key set and throughput of @p Hash and @p Policy, as one result.
+template <typename Hash, typename Policy>
+json
+benchPolicy(const char* name,
+            const BenchConfig& config,
+            const std::vector<KeySet>& sets,
+            const std::vector<std::array<uint64_t, BENCH_WIDE_WORDS>>& wide)
+{
+    std::fprintf(stderr, "%s\n", name);
+    json keySets = json::object();
+    for (const auto& set : sets)
+    {
+        const json d = distribution<Hash>(config, set);
+        std::fprintf(stderr,
+                     "  %-16s chi2/df low %8.3f high %8.3f tags %8.3f  collisions %zu  "
+                     "avalanche %.3f (worst bias %.3f)\n",
+                     set.name.c_str(),
+                     d.at("chi2_low").get<double>(),
+                     d.at("chi2_high").get<double>(),
+                     d.at("chi2_tags").get<double>(),
+                     d.at("collisions").get<size_t>(),
+                     d.at("avalanche_mean").get<double>(),
+                     d.at("avalanche_worst_bias").get<double>());
+        keySets[set.name] = d;
+    }
+
+    const Hash hasher;
+    const auto& keys = sets.back().keys;
+    const json flowKey = timeBatches(keys.size(), config.repeat, [&](size_t i) {
+        const size_t h = hasher(keys[i]);
+        keep(h);
+    });
+    const json wideKey = timeBatches(wide.size(), config.repeat, [&](size_t i) {
+        const uint64_t h = Policy::hash(wide[i].data(), BENCH_WIDE_WORDS);
+        keep(h);
+    });
+    std::fprintf(stderr,
+                 "  %-16s %.2f ns/hash flow key, %.2f ns/hash %d-word key\n",
+                 "throughput",
+                 flowKey.at("ns_per_op").get<double>(),
+                 wideKey.at("ns_per_op").get<double>(),
+                 BENCH_WIDE_WORDS);
+    return {{"policy", name},
+            {"key_sets", keySets},
+            {"flow_key", flowKey},
+            {"wide_key", wideKey}};
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    BenchConfig config;
+    try
+    {
+        config = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    const std::vector<KeySet> sets = makeKeySets(config);
+    std::vector<std::array<uint64_t, BENCH_WIDE_WORDS>> wide(config.keys);
+    std::mt19937_64 rng(config.seed);
+    for (auto& words : wide)
+    {
+        for (auto& word : words)
+        {
+            word = rng();
+        }
+    }
+
+    json results = json::array();
+    results.push_back(
+        benchPolicy<sflow::BasicFlowKeyHash<utils::WyHashPolicy>, utils::WyHashPolicy>(
+            "wyhash", config, sets, wide));
+#if defined(__SSE4_2__)
+    results.push_back(
+        benchPolicy<sflow::BasicFlowKeyHash<utils::Crc32cHashPolicy>, utils::Crc32cHashPolicy>(
+            "crc32c", config, sets, wide));
+#endif
+    results.push_back(benchPolicy<CombineFlowKeyHash, CombineHashPolicy>(
+        "hash-combine", config, sets, wide));
+
+    const json document = {{"label", config.label},
+                           {"config",
+                            {{"keys", config.keys},
+                             {"load", config.load},
+                             {"avalanche_keys", config.avalancheKeys},
+                             {"repeat", config.repeat},
+                             {"batch", BENCH_BATCH},
+                             {"seed", config.seed},
+                             {"sse4_2", BENCH_SSE4_2}}},
+                           {"results", results}};
+    if (config.outPath.empty())
+    {
+        std::printf("%s\n", document.dump(2).c_str());
+        return 0;
+    }
+    std::ofstream out(config.outPath);
+    out << document.dump(2) << '\n';
+    if (!out)
+    {
+        std::fprintf(stderr, "Cannot write %s\n", config.outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
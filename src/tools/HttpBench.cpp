@@ -0,0 +1,585 @@
+/**
+ * @file HttpBench.cpp
+ * @brief Replays a mix of NDT API calls at a running NDTwin at a fixed concurrency and
+ *        reports throughput and latency percentiles per route.
+ *
+ * Each of --concurrency workers keeps one HTTP/1.1 keep-alive connection and sends its next
+ * request as soon as the previous one is answered (closed loop), picking the operation by the
+ * weights of --mix:
+ *   - graph: GET /ndt/get_graph_data;
+ *   - flows: GET /ndt/get_detected_flow_data;
+ *   - lock: POST /ndt/acquire_lock, /ndt/renew_lock and /ndt/release_lock in turn, each timed
+ *     as its own route, on a resource only that worker takes (switch:<base + worker>), so
+ *     workers never wait for each other's leases;
+ *   - batch: POST /ndt/install_flow_entries_modify_flow_entries_and_delete_flow_entries with
+ *     one install on a --dpids switch and the delete of the worker's previous install, so the
+ *     flow tables do not grow. Sent with async unless --sync-batches, so the time is that of
+ *     the handler and not of the controller.
+ *
+ * Requests answered with a status other than 2xx, or failing on the connection (which is
+ * then opened again), are counted as errors of their route and left out of its latencies.
+ *
+ * Usage:
+ *   ndt_http_bench [--ndt http://127.0.0.1:8000] [--concurrency <n>] [--duration <s>]
+ *                  [--warmup <s>] [--mix graph=40,flows=40,lock=10,batch=10]
+ *                  [--dpids 1,2,...] [--lock-base <n>] [--sync-batches] [--seed <n>]
+ */
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = boost::beast::http;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+#define BENCH_DEFAULT_CONCURRENCY 16   // workers, one connection each
+#define BENCH_DEFAULT_DURATION_S 10    // measured time
+#define BENCH_DEFAULT_WARMUP_S 1       // time before measuring, to open connections and warm caches
+#define BENCH_DEFAULT_LOCK_BASE 100000 // first dpid of the switch:<dpid> lock resources
+#define BENCH_REQUEST_TIMEOUT_S 30     // a request still unanswered by then fails
+#define BENCH_MATCH_NET 0x0AFE0000U    // 10.254.0.0, destinations of the installed entries
+
+namespace
+{
+
+enum class Op
+{
+    Graph,
+    Flows,
+    Lock,
+    Batch,
+};
+
+struct BenchConfig
+{
+    std::string host = "127.0.0.1";
+    std::string port = "8000";
+    unsigned concurrency = BENCH_DEFAULT_CONCURRENCY;
+    uint64_t durationSeconds = BENCH_DEFAULT_DURATION_S;
+    uint64_t warmupSeconds = BENCH_DEFAULT_WARMUP_S;
+    std::vector<std::pair<Op, unsigned>> mix = {
+        {Op::Graph, 40}, {Op::Flows, 40}, {Op::Lock, 10}, {Op::Batch, 10}};
+    std::vector<uint64_t> dpids = {1};
+    uint64_t lockBase = BENCH_DEFAULT_LOCK_BASE;
+    bool asyncBatches = true;
+    uint64_t seed = 1;
+};
+
+Op
+parseOp(std::string_view name)
+{
+    if (name == "graph")
+    {
+        return Op::Graph;
+    }
+    if (name == "flows")
+    {
+        return Op::Flows;
+    }
+    if (name == "lock")
+    {
+        return Op::Lock;
+    }
+    if (name == "batch")
+    {
+        return Op::Batch;
+    }
+    throw std::invalid_argument("Unknown operation " + std::string(name) +
+                                " (graph, flows, lock or batch)");
+}
+
+std::vector<std::string>
+splitList(const std::string& value)
+{
+    std::vector<std::string> items;
+    std::istringstream in(value);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+BenchConfig
+parseArgs(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/HttpBench.cpp\n");
+            std::exit(0);
+        }
+        if (arg == "--sync-batches")
+        {
+            config.asyncBatches = false;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--ndt")
+        {
+            std::string_view rest(value);
+            if (rest.rfind("http://", 0) != 0)
+            {
+                throw std::invalid_argument("--ndt must be an http:// URL");
+            }
+            rest.remove_prefix(7);
+            rest = rest.substr(0, rest.find('/'));
+            size_t colon = rest.rfind(':');
+            config.host = std::string(rest.substr(0, colon));
+            config.port =
+                colon == std::string_view::npos ? "80" : std::string(rest.substr(colon + 1));
+        }
+        else if (arg == "--concurrency")
+        {
+            config.concurrency = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--duration")
+        {
+            config.durationSeconds = std::stoull(value);
+        }
+        else if (arg == "--warmup")
+        {
+            config.warmupSeconds = std::stoull(value);
+        }
+        else if (arg == "--mix")
+        {
+            config.mix.clear();
+            for (const auto& item : splitList(value))
+            {
+                size_t eq = item.find('=');
+                if (eq == std::string::npos)
+                {
+                    throw std::invalid_argument("--mix items are <operation>=<weight>");
+                }
+                config.mix.emplace_back(parseOp(item.substr(0, eq)),
+                                        std::stoul(item.substr(eq + 1)));
+            }
+        }
+        else if (arg == "--dpids")
+        {
+            config.dpids.clear();
+            for (const auto& item : splitList(value))
+            {
+                config.dpids.push_back(std::stoull(item, nullptr, 0));
+            }
+        }
+        else if (arg == "--lock-base")
+        {
+            config.lockBase = std::stoull(value);
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = std::stoull(value);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    unsigned total = 0;
+    for (const auto& [op, weight] : config.mix)
+    {
+        total += weight;
+    }
+    if (total == 0)
+    {
+        throw std::invalid_argument("--mix has no operation of positive weight");
+    }
+    if (config.dpids.empty())
+    {
+        throw std::invalid_argument("--dpids is empty");
+    }
+    return config;
+}
+
+//================================================================
+// Per-route results
+//================================================================
+
+struct RouteStats
+{
+    std::vector<uint64_t> ns; // latencies of the 2xx answers
+    uint64_t errors = 0;
+    std::map<unsigned, uint64_t> statuses; // non-2xx statuses, 0 for connection failures
+
+    void merge(const RouteStats& other)
+    {
+        ns.insert(ns.end(), other.ns.begin(), other.ns.end());
+        errors += other.errors;
+        for (const auto& [status, count] : other.statuses)
+        {
+            statuses[status] += count;
+        }
+    }
+};
+
+using Results = std::map<std::string, RouteStats>; // by route
+
+//================================================================
+// Workers
+//================================================================
+
+/**
+ * @brief One closed-loop client: a keep-alive connection and the state its lock and batch
+ *        operations carry from one request to the next.
+ */
+class Worker
+{
+  public:
+    Worker(const BenchConfig& config, unsigned index)
+        : m_config(config),
+          m_index(index),
+          m_rng(config.seed * 7919 + index),
+          m_stream(m_ioc)
+    {
+        for (const auto& [op, weight] : config.mix)
+        {
+            m_weights.push_back(weight);
+        }
+    }
+
+    /// Run until @p stop is set; requests answered before @p measureFrom are not recorded.
+    void run(const std::atomic<bool>& stop, Clock::time_point measureFrom)
+    {
+        std::discrete_distribution<size_t> pick(m_weights.begin(), m_weights.end());
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            m_measuring = Clock::now() >= measureFrom;
+            switch (m_config.mix[pick(m_rng)].first)
+            {
+            case Op::Graph:
+                send(http::verb::get, "/ndt/get_graph_data", {});
+                break;
+            case Op::Flows:
+                send(http::verb::get, "/ndt/get_detected_flow_data", {});
+                break;
+            case Op::Lock:
+                lockCycle();
+                break;
+            case Op::Batch:
+                flowBatch();
+                break;
+            }
+        }
+        // Leave no lease and no installed entry behind
+        m_measuring = false;
+        if (m_lockToken)
+        {
+            send(http::verb::post, "/ndt/release_lock", json{{"token", *m_lockToken}}.dump());
+        }
+        if (m_lastInstall)
+        {
+            json body;
+            body["delete_flow_entries"] = json::array({entry(*m_lastInstall, false)});
+            send(http::verb::post,
+                 "/ndt/install_flow_entries_modify_flow_entries_and_delete_flow_entries",
+                 body.dump());
+        }
+    }
+
+    const Results& results() const
+    {
+        return m_results;
+    }
+
+  private:
+    struct Installed
+    {
+        uint64_t dpid;
+        uint32_t dstIp;
+    };
+
+    void lockCycle()
+    {
+        json acquire = {{"resources", {"switch:" + std::to_string(m_config.lockBase + m_index)}},
+                        {"ttl", 5}};
+        auto body = send(http::verb::post, "/ndt/acquire_lock", acquire.dump());
+        if (!body)
+        {
+            return;
+        }
+        m_lockToken = json::parse(*body, nullptr, false).value("token", 0ULL);
+        send(http::verb::post, "/ndt/renew_lock", json{{"token", *m_lockToken}, {"ttl", 5}}.dump());
+        if (send(http::verb::post, "/ndt/release_lock", json{{"token", *m_lockToken}}.dump()))
+        {
+            m_lockToken.reset();
+        }
+    }
+
+    void flowBatch()
+    {
+        // 10.254.<worker>.<n>/32, on the switches in turn
+        Installed next{m_config.dpids[m_batches % m_config.dpids.size()],
+                       BENCH_MATCH_NET | ((m_index & 0xFF) << 8) | (m_batches & 0xFF)};
+        ++m_batches;
+        json body;
+        body["install_flow_entries"] = json::array({entry(next, true)});
+        if (m_lastInstall)
+        {
+            body["delete_flow_entries"] = json::array({entry(*m_lastInstall, false)});
+        }
+        if (m_config.asyncBatches)
+        {
+            body["async"] = true;
+        }
+        body["lane"] = "bulk";
+        if (send(http::verb::post,
+                 "/ndt/install_flow_entries_modify_flow_entries_and_delete_flow_entries",
+                 body.dump()))
+        {
+            m_lastInstall = next;
+        }
+    }
+
+    static json entry(const Installed& installed, bool withActions)
+    {
+        const uint32_t ip = installed.dstIp;
+        json e = {{"dpid", installed.dpid},
+                  {"priority", 1},
+                  {"match",
+                   {{"eth_type", 2048},
+                    {"ipv4_dst",
+                     std::to_string(ip >> 24) + "." + std::to_string((ip >> 16) & 0xFF) + "." +
+                         std::to_string((ip >> 8) & 0xFF) + "." + std::to_string(ip & 0xFF)}}}};
+        if (withActions)
+        {
+            e["actions"] = json::array({{{"type", "OUTPUT"}, {"port", 1}}});
+        }
+        return e;
+    }
+
+    /// Send one request and record it under @p target; the body of a 2xx answer.
+    std::optional<std::string> send(http::verb method, const std::string& target, std::string body)
+    {
+        http::request<http::string_body> request{method, target, 11};
+        request.set(http::field::host, m_config.host);
+        request.keep_alive(true);
+        if (!body.empty())
+        {
+            request.set(http::field::content_type, "application/json");
+            request.body() = std::move(body);
+        }
+        request.prepare_payload();
+
+        const auto start = Clock::now();
+        unsigned status = 0;
+        http::response<http::string_body> response;
+        try
+        {
+            if (!m_connected)
+            {
+                asio::ip::tcp::resolver resolver(m_ioc);
+                m_stream.expires_after(std::chrono::seconds(BENCH_REQUEST_TIMEOUT_S));
+                m_stream.connect(resolver.resolve(m_config.host, m_config.port));
+                m_stream.socket().set_option(asio::ip::tcp::no_delay(true));
+                m_connected = true;
+            }
+            m_stream.expires_after(std::chrono::seconds(BENCH_REQUEST_TIMEOUT_S));
+            http::write(m_stream, request);
+            http::read(m_stream, m_buffer, response);
+            status = response.result_int();
+            if (!response.keep_alive())
+            {
+                disconnect();
+            }
+        }
+        catch (const std::exception&)
+        {
+            disconnect();
+        }
+        const auto elapsed = Clock::now() - start;
+
+        const bool ok = status >= 200 && status < 300;
+        if (m_measuring)
+        {
+            RouteStats& stats = m_results[target];
+            if (ok)
+            {
+                stats.ns.push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+            else
+            {
+                ++stats.errors;
+                ++stats.statuses[status];
+            }
+        }
+        if (!ok)
+        {
+            return std::nullopt;
+        }
+        return std::move(response.body());
+    }
+
+    void disconnect()
+    {
+        beast::error_code ignored;
+        m_stream.socket().shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+        m_stream.close();
+        m_buffer.clear();
+        m_connected = false;
+    }
+
+    const BenchConfig& m_config;
+    const unsigned m_index;
+    std::mt19937_64 m_rng;
+    std::vector<unsigned> m_weights;
+    asio::io_context m_ioc;
+    beast::tcp_stream m_stream;
+    beast::flat_buffer m_buffer;
+    bool m_connected = false;
+    bool m_measuring = false;
+    std::optional<uint64_t> m_lockToken;
+    std::optional<Installed> m_lastInstall;
+    uint32_t m_batches = 0;
+    Results m_results;
+};
+
+double
+percentileMs(const std::vector<uint64_t>& sorted, double q)
+{
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * q));
+    return sorted[index] / 1e6;
+}
+
+void
+printReport(Results& results, double seconds)
+{
+    std::printf("%-72s %9s %7s %9s %9s %9s\n",
+                "route",
+                "req/s",
+                "errors",
+                "p50 ms",
+                "p99 ms",
+                "p999 ms");
+    uint64_t total = 0;
+    for (auto& [route, stats] : results)
+    {
+        total += stats.ns.size();
+        if (stats.ns.empty())
+        {
+            std::printf("%-72s %9.1f %7lu %9s %9s %9s\n",
+                        route.c_str(),
+                        0.0,
+                        stats.errors,
+                        "-",
+                        "-",
+                        "-");
+        }
+        else
+        {
+            std::sort(stats.ns.begin(), stats.ns.end());
+            std::printf("%-72s %9.1f %7lu %9.3f %9.3f %9.3f\n",
+                        route.c_str(),
+                        stats.ns.size() / seconds,
+                        stats.errors,
+                        percentileMs(stats.ns, 0.50),
+                        percentileMs(stats.ns, 0.99),
+                        percentileMs(stats.ns, 0.999));
+        }
+        for (const auto& [status, count] : stats.statuses)
+        {
+            if (status == 0)
+            {
+                std::printf("  %lu connection failures\n", count);
+            }
+            else
+            {
+                std::printf("  %lu answered %u\n", count, status);
+            }
+        }
+    }
+    std::printf("Total: %.1f req/s answered 2xx\n", total / seconds);
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    BenchConfig config;
+    try
+    {
+        config = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < config.concurrency; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(config, i));
+    }
+
+    std::atomic<bool> stop{false};
+    const auto measureFrom = Clock::now() + std::chrono::seconds(config.warmupSeconds);
+    std::vector<std::thread> threads;
+    for (auto& worker : workers)
+    {
+        threads.emplace_back([&, w = worker.get()] { w->run(stop, measureFrom); });
+    }
+    std::printf("%u workers against %s:%s for %lu s after %lu s of warmup\n",
+                config.concurrency,
+                config.host.c_str(),
+                config.port.c_str(),
+                config.durationSeconds,
+                config.warmupSeconds);
+    std::this_thread::sleep_until(measureFrom + std::chrono::seconds(config.durationSeconds));
+    const double seconds = std::chrono::duration<double>(Clock::now() - measureFrom).count();
+    stop = true;
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    Results merged;
+    for (const auto& worker : workers)
+    {
+        for (const auto& [route, stats] : worker->results())
+        {
+            merged[route].merge(stats);
+        }
+    }
+    if (merged.empty())
+    {
+        std::fprintf(stderr, "No request was answered\n");
+        return 1;
+    }
+    printReport(merged, seconds);
+    return 0;
+}
@@ -0,0 +1,591 @@
+/**
+ * @file MicroBench.cpp
+ * @brief Per-operation timings of the data structures on the collector's inner loops,
+ *        written as JSON to compare commits.
+ *
+ * Covered:
+ *   - AutoRefreshQueue and TimeWheelRateCounter push and getSum, with the samples a flow
+ *     gets from one agent at --sample-rate per second;
+ *   - FlowKeyHash, and insert/find (hit and miss) in unordered_map<FlowKey, FlowInfo>;
+ *   - the per-flow agent maps, std::map<AgentKey, FlowStats> and AgentFlowStatsMap, updated
+ *     as the agents of a flow report it;
+ *   - utils::ipToString and utils::macToString;
+ *   - touchEdgeFlow on the links of a fat-tree loaded into TopologyAndFlowMonitor;
+ *   - to_json/from_json of VertexProperties and from_json of EdgeProperties (which has no
+ *     to_json), with --flows-per-edge keys in flow_set.
+ *
+ * The workload follows a fat-tree deployment: --flows distinct 5-tuples between --hosts
+ * hosts, 90 % TCP, and paths of 1, 3 or 5 switches (same edge switch, same pod, across pods)
+ * in proportions 10/30/60, each switch being an agent that samples the flow.
+ *
+ * Operations are timed in batches of BENCH_BATCH; each result gives the mean and the
+ * p50/p99 of the batches, in nanoseconds per operation. The JSON document goes to stdout
+ * (or --out), progress to stderr.
+ *
+ * Usage:
+ *   ndt_micro_bench [--flows <n>] [--hosts <n>] [--k <fat-tree k>] [--flows-per-edge <n>]
+ *                   [--sample-rate <per s>] [--repeat <n>] [--label <text>] [--seed <n>]
+ *                   [--out <file>]
+ */
+#include "TopologyGenerator.hpp"
+#include "common_types/GraphTypes.hpp"
+#include "common_types/SFlowType.hpp"
+#include "event_system/EventBus.hpp"
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "ndt_core/collection/TopologyCache.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+#define BENCH_BATCH 256                 // operations per timed batch
+#define BENCH_DEFAULT_FLOWS 100000      // distinct flows
+#define BENCH_DEFAULT_HOSTS 1024        // hosts the flows run between
+#define BENCH_DEFAULT_K 8               // fat-tree of the touchEdgeFlow benchmark
+#define BENCH_DEFAULT_FLOWS_PER_EDGE 64 // flow_set keys of the EdgeProperties JSON
+#define BENCH_DEFAULT_SAMPLE_RATE 100   // samples per second of one flow at one agent
+#define BENCH_DEFAULT_REPEAT 3          // passes over each workload
+
+namespace
+{
+
+struct BenchConfig
+{
+    size_t flows = BENCH_DEFAULT_FLOWS;
+    size_t hosts = BENCH_DEFAULT_HOSTS;
+    unsigned k = BENCH_DEFAULT_K;
+    size_t flowsPerEdge = BENCH_DEFAULT_FLOWS_PER_EDGE;
+    unsigned sampleRate = BENCH_DEFAULT_SAMPLE_RATE;
+    size_t repeat = BENCH_DEFAULT_REPEAT;
+    std::string label;
+    uint64_t seed = 1;
+    std::string outPath; // empty: stdout
+};
+
+BenchConfig
+parseArgs(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/MicroBench.cpp\n");
+            std::exit(0);
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--flows")
+        {
+            config.flows = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--hosts")
+        {
+            config.hosts = std::max(2UL, std::stoul(value));
+        }
+        else if (arg == "--k")
+        {
+            config.k = std::stoul(value);
+        }
+        else if (arg == "--flows-per-edge")
+        {
+            config.flowsPerEdge = std::stoul(value);
+        }
+        else if (arg == "--sample-rate")
+        {
+            config.sampleRate = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--repeat")
+        {
+            config.repeat = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--label")
+        {
+            config.label = value;
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = std::stoull(value);
+        }
+        else if (arg == "--out")
+        {
+            config.outPath = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    return config;
+}
+
+//================================================================
+// Timing
+//================================================================
+
+/// Keep @p value alive so the work producing it is not optimized away.
+template <typename T>
+inline void
+keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/// Nanoseconds per operation of timed batches, reported as one JSON result.
+class Measurement
+{
+  public:
+    explicit Measurement(std::string name)
+        : m_name(std::move(name))
+    {
+    }
+
+    /// Time @p op(i) for i in [0, count), in batches.
+    template <typename Op>
+    void run(size_t count, Op&& op)
+    {
+        for (size_t begin = 0; begin < count; begin += BENCH_BATCH)
+        {
+            const size_t end = std::min(count, begin + BENCH_BATCH);
+            const auto start = Clock::now();
+            for (size_t i = begin; i < end; ++i)
+            {
+                op(i);
+            }
+            const double ns =
+                std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            m_batches.push_back(ns / (end - begin));
+            m_ops += end - begin;
+            m_totalNs += ns;
+        }
+    }
+
+    json result()
+    {
+        std::sort(m_batches.begin(), m_batches.end());
+        auto at = [&](double q) {
+            return m_batches.empty()
+                       ? 0.0
+                       : m_batches[std::min(m_batches.size() - 1,
+                                            static_cast<size_t>(m_batches.size() * q))];
+        };
+        const double mean = m_ops ? m_totalNs / m_ops : 0.0;
+        std::fprintf(stderr,
+                     "  %-44s %10.1f ns/op  p99 %10.1f  (%zu ops)\n",
+                     m_name.c_str(),
+                     mean,
+                     at(0.99),
+                     m_ops);
+        return {{"name", m_name},
+                {"ops", m_ops},
+                {"ns_per_op", mean},
+                {"p50_ns", at(0.50)},
+                {"p99_ns", at(0.99)}};
+    }
+
+  private:
+    std::string m_name;
+    std::vector<double> m_batches;
+    size_t m_ops = 0;
+    double m_totalNs = 0;
+};
+
+//================================================================
+// Workload
+//================================================================
+
+int64_t
+nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               Clock::now().time_since_epoch())
+        .count();
+}
+
+struct Flow
+{
+    sflow::FlowKey key;
+    std::vector<sflow::AgentKey> agents; // the switches of its path, ingress port each
+};
+
+std::vector<Flow>
+makeFlows(const BenchConfig& config, std::mt19937_64& rng)
+{
+    std::uniform_int_distribution<uint32_t> host(0, config.hosts - 1);
+    std::uniform_int_distribution<uint32_t> port(1024, 65535);
+    std::uniform_int_distribution<uint32_t> agentIp(1, 4096);
+    std::uniform_int_distribution<uint32_t> agentPort(1, 48);
+    std::discrete_distribution<int> pathKind({10, 30, 60}); // 1, 3, 5 switches
+    std::bernoulli_distribution tcp(0.9);
+
+    std::vector<Flow> flows;
+    flows.reserve(config.flows);
+    std::unordered_map<sflow::FlowKey, bool, sflow::FlowKeyHash> seen;
+    while (flows.size() < config.flows)
+    {
+        Flow flow;
+        flow.key.srcIP = htonl(0xAC100000U + host(rng));
+        flow.key.dstIP = htonl(0xAC100000U + host(rng));
+        flow.key.srcPort = static_cast<uint16_t>(port(rng));
+        flow.key.dstPort = tcp(rng) ? 5201 : 53;
+        flow.key.protocol = flow.key.dstPort == 5201 ? 6 : 17;
+        if (flow.key.srcIP == flow.key.dstIP || !seen.emplace(flow.key, true).second)
+        {
+            continue;
+        }
+        const int switches = 1 + 2 * pathKind(rng);
+        for (int s = 0; s < switches; ++s)
+        {
+            flow.agents.push_back({agentIp(rng), agentPort(rng)});
+        }
+        flows.push_back(std::move(flow));
+    }
+    return flows;
+}
+
+//================================================================
+// Benchmarks
+//================================================================
+
+/// push() and getSum() of a window receiving config.sampleRate samples per second.
+template <typename Window>
+void
+benchWindow(const BenchConfig& config, const char* name, json& results)
+{
+    const int64_t spacing = std::max<int64_t>(1, 1000 / config.sampleRate);
+    const size_t count = config.flows;
+    Window window;
+    const int64_t base = nowMs() - static_cast<int64_t>(count) * spacing;
+    Measurement push(std::string(name) + "/push");
+    push.run(count, [&](size_t i) {
+        window.push(
+            {static_cast<uint32_t>(64 + i % 1400), base + static_cast<int64_t>(i) * spacing});
+    });
+    results.push_back(push.result());
+
+    Measurement sum(std::string(name) + "/getSum");
+    sum.run(count, [&](size_t) {
+        const uint64_t s = window.getSum();
+        keep(s);
+    });
+    results.push_back(sum.result());
+}
+
+void
+benchFlowTable(const BenchConfig& config, const std::vector<Flow>& flows, json& results)
+{
+    Measurement hash("FlowKeyHash");
+    const sflow::FlowKeyHash hasher;
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        hash.run(flows.size(), [&](size_t i) {
+            const size_t h = hasher(flows[i].key);
+            keep(h);
+        });
+    }
+    results.push_back(hash.result());
+
+    Measurement insert("unordered_map<FlowKey,FlowInfo>/insert");
+    Measurement findHit("unordered_map<FlowKey,FlowInfo>/find hit");
+    Measurement findMiss("unordered_map<FlowKey,FlowInfo>/find miss");
+    std::vector<sflow::FlowKey> misses;
+    misses.reserve(flows.size());
+    for (const auto& flow : flows)
+    {
+        sflow::FlowKey miss = flow.key;
+        miss.srcPort ^= 1; // the same hosts on another port: a miss but for rare collisions
+        misses.push_back(miss);
+    }
+    std::vector<size_t> order(flows.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    std::mt19937_64 rng(config.seed);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        std::unordered_map<sflow::FlowKey, sflow::FlowInfo, sflow::FlowKeyHash> table;
+        insert.run(flows.size(), [&](size_t i) { table.try_emplace(flows[i].key); });
+        findHit.run(flows.size(), [&](size_t i) {
+            auto it = table.find(flows[order[i]].key);
+            keep(it);
+        });
+        findMiss.run(flows.size(), [&](size_t i) {
+            auto it = table.find(misses[order[i]]);
+            keep(it);
+        });
+    }
+    results.push_back(insert.result());
+    results.push_back(findHit.result());
+    results.push_back(findMiss.result());
+}
+
+/// One sample of a flow from each of its agents: the counters of that agent's entry updated.
+template <typename AgentMap>
+void
+benchAgentMap(const BenchConfig& config,
+              const std::vector<Flow>& flows,
+              const char* name,
+              json& results)
+{
+    Measurement update(std::string(name) + "/update");
+    std::vector<AgentMap> maps(flows.size());
+    std::vector<std::pair<uint32_t, uint32_t>> samples; // flow, agent
+    for (uint32_t f = 0; f < flows.size(); ++f)
+    {
+        for (uint32_t a = 0; a < flows[f].agents.size(); ++a)
+        {
+            samples.emplace_back(f, a);
+        }
+    }
+    std::mt19937_64 rng(config.seed);
+    std::shuffle(samples.begin(), samples.end(), rng);
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        update.run(samples.size(), [&](size_t i) {
+            const auto [f, a] = samples[i];
+            sflow::FlowStats& stats = maps[f][flows[f].agents[a]];
+            stats.ingressByteCountCurrent += 1500;
+            stats.ingresspacketCountCurrent += 1;
+        });
+    }
+    results.push_back(update.result());
+}
+
+void
+benchStrings(const BenchConfig& config, const std::vector<Flow>& flows, json& results)
+{
+    Measurement ip("utils::ipToString");
+    Measurement mac("utils::macToString");
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        ip.run(flows.size(), [&](size_t i) {
+            const std::string s = utils::ipToString(flows[i].key.srcIP);
+            keep(s);
+        });
+        mac.run(flows.size(), [&](size_t i) {
+            const std::string s =
+                utils::macToString(0x020000000000ULL | (uint64_t(flows[i].key.dstIP) << 8));
+            keep(s);
+        });
+    }
+    results.push_back(ip.result());
+    results.push_back(mac.result());
+}
+
+/// touchEdgeFlow for every flow on as many fat-tree links as its path has switches.
+void
+benchTouchEdgeFlow(const BenchConfig& config, const std::vector<Flow>& flows, json& results)
+{
+    topology_gen::TopologySpec spec;
+    spec.k = config.k;
+    const json topology = topology_gen::generate(spec);
+    const std::string path = (std::filesystem::temp_directory_path() /
+                              ("ndt_micro_bench_" + topology_gen::specName(spec) + ".json"))
+                                 .string();
+    std::ofstream(path) << topology.dump() << '\n';
+
+    auto graph = std::make_shared<Graph>();
+    TopologyAndFlowMonitor monitor(graph,
+                                   std::make_shared<std::shared_mutex>(),
+                                   std::make_shared<EventBus>(0),
+                                   utils::TESTBED);
+    monitor.loadStaticTopology(path);
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + TOPOLOGY_CACHE_SUFFIX);
+
+    std::vector<Graph::edge_descriptor> edges;
+    for (const auto& edge : topology.at("edges"))
+    {
+        if (edge.at("src_dpid").get<uint64_t>() == 0)
+        {
+            continue; // out of a host
+        }
+        if (auto e = monitor.findEdgeByDpidAndPort(
+                {edge.at("src_dpid").get<uint64_t>(), edge.at("src_interface").get<uint32_t>()}))
+        {
+            edges.push_back(*e);
+        }
+    }
+    if (edges.empty())
+    {
+        std::fprintf(stderr, "  touchEdgeFlow: no link of %s found\n", path.c_str());
+        return;
+    }
+
+    std::mt19937_64 rng(config.seed);
+    std::uniform_int_distribution<size_t> pick(0, edges.size() - 1);
+    std::vector<std::pair<Graph::edge_descriptor, const sflow::FlowKey*>> touches;
+    for (const auto& flow : flows)
+    {
+        for (size_t hop = 0; hop < flow.agents.size(); ++hop)
+        {
+            touches.emplace_back(edges[pick(rng)], &flow.key);
+        }
+    }
+    Measurement touch("TopologyAndFlowMonitor::touchEdgeFlow");
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        touch.run(touches.size(), [&](size_t i) {
+            const bool added = monitor.touchEdgeFlow(touches[i].first, *touches[i].second);
+            keep(added);
+        });
+    }
+    results.push_back(touch.result());
+
+    // The graph's vertices, for the JSON benchmarks
+    std::vector<VertexProperties> vertices;
+    for (auto [v, vEnd] = boost::vertices(*graph); v != vEnd; ++v)
+    {
+        vertices.push_back((*graph)[*v]);
+    }
+    std::vector<json> vertexJson;
+    Measurement toJson("to_json(VertexProperties)");
+    Measurement fromJson("from_json(VertexProperties)");
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        vertexJson.assign(vertices.size(), json());
+        toJson.run(vertices.size(), [&](size_t i) { vertexJson[i] = vertices[i]; });
+        fromJson.run(vertices.size(), [&](size_t i) {
+            VertexProperties v = vertexJson[i].get<VertexProperties>();
+            keep(v);
+        });
+    }
+    results.push_back(toJson.result());
+    results.push_back(fromJson.result());
+}
+
+void
+benchEdgeJson(const BenchConfig& config, const std::vector<Flow>& flows, json& results)
+{
+    json flowSet = json::array();
+    for (size_t i = 0; i < std::min(config.flowsPerEdge, flows.size()); ++i)
+    {
+        flowSet.push_back(flows[i].key);
+    }
+    const json edge = {{"is_up", true},
+                       {"is_enabled", true},
+                       {"left_link_bandwidth_bps", 60000000000ULL},
+                       {"link_bandwidth_bps", 100000000000ULL},
+                       {"link_bandwidth_usage_bps", 40000000000ULL},
+                       {"link_bandwidth_utilization_percent", 40.0},
+                       {"src_ip", json::array({0x0100000AU})},
+                       {"src_dpid", 1},
+                       {"src_interface", 1},
+                       {"dst_ip", json::array({0x0200000AU})},
+                       {"dst_dpid", 2},
+                       {"dst_interface", 1},
+                       {"flow_set", flowSet}};
+    Measurement fromJson("from_json(EdgeProperties) flow_set " + std::to_string(flowSet.size()));
+    const size_t count = std::max<size_t>(BENCH_BATCH, flows.size() / 64);
+    for (size_t r = 0; r < config.repeat; ++r)
+    {
+        fromJson.run(count, [&](size_t) {
+            EdgeProperties e = edge.get<EdgeProperties>();
+            keep(e);
+        });
+    }
+    results.push_back(fromJson.result());
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    LogConfig logConfig;
+    logConfig.level = spdlog::level::warn;
+    Logger::init(logConfig);
+    BenchConfig config;
+    try
+    {
+        config = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    std::mt19937_64 rng(config.seed);
+    const std::vector<Flow> flows = makeFlows(config, rng);
+    size_t agents = 0;
+    for (const auto& flow : flows)
+    {
+        agents += flow.agents.size();
+    }
+    std::fprintf(stderr,
+                 "%zu flows between %zu hosts, %.2f agents per flow\n",
+                 flows.size(),
+                 config.hosts,
+                 double(agents) / flows.size());
+
+    json results = json::array();
+    try
+    {
+        benchWindow<sflow::AutoRefreshQueue>(config, "AutoRefreshQueue", results);
+        benchWindow<sflow::TimeWheelRateCounter>(config, "TimeWheelRateCounter", results);
+        benchFlowTable(config, flows, results);
+        benchAgentMap<std::map<sflow::AgentKey, sflow::FlowStats>>(
+            config, flows, "map<AgentKey,FlowStats>", results);
+        benchAgentMap<sflow::AgentFlowStatsMap>(config, flows, "AgentFlowStatsMap", results);
+        benchStrings(config, flows, results);
+        benchTouchEdgeFlow(config, flows, results);
+        benchEdgeJson(config, flows, results);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    const json document = {{"label", config.label},
+                           {"config",
+                            {{"flows", config.flows},
+                             {"hosts", config.hosts},
+                             {"agents_per_flow", double(agents) / flows.size()},
+                             {"k", config.k},
+                             {"flows_per_edge", config.flowsPerEdge},
+                             {"sample_rate", config.sampleRate},
+                             {"repeat", config.repeat},
+                             {"batch", BENCH_BATCH},
+                             {"seed", config.seed}}},
+                           {"results", results}};
+    if (config.outPath.empty())
+    {
+        std::printf("%s\n", document.dump(2).c_str());
+        return 0;
+    }
+    std::ofstream out(config.outPath);
+    out << document.dump(2) << '\n';
+    if (!out)
+    {
+        std::fprintf(stderr, "Cannot write %s\n", config.outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
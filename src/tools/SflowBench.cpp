@@ -0,0 +1,996 @@
+/**
+ * @file SflowBench.cpp
+ * @brief Replays captured or synthetic sFlow datagrams at a running NDTwin and reports how
+ *        its collector kept up.
+ *
+ * Datagrams come from a capture (pcap, or a raw dump of 4-byte big-endian lengths each
+ * followed by one datagram) or are generated as Brocade (types 1 and 2) or HPE (types 3 and
+ * 4) flow and counter samples, laid out as SFlowDecoder reads them. They are sent over UDP
+ * to the collector's socket at a fixed rate for a fixed time.
+ *
+ * The collector's own counters are read before and after the run, from
+ * /ndt/get_collector_stats and /metrics, so the report covers what it received and applied:
+ * samples per second, datagrams lost (in the network stack, the kernel socket queue or an
+ * ingest ring), the p99 of ndt_sflow_decode_seconds and, with --pid, the growth of its
+ * resident memory.
+ *
+ * With --expect-idle, the run is also a check that flows which stop sending cool down: once
+ * the datagrams stop, every detected flow must report zero rates (periodic and immediate)
+ * and no flow may be left in the hot table (/ndt/get_collector_stats "flow_tiers") within
+ * the given time, or the bench exits 1. The bench also follows /ndt/telemetry_stream for
+ * the run, and every flow announced as an elephant must have ended by then. It needs an
+ * NDTwin fed only by the bench, and a flow.cold_after_ms well below that time.
+ *
+ * Usage:
+ *   ndt_sflow_bench [--target 127.0.0.1:6343] [--ndt http://127.0.0.1:8000] [--pid <pid>]
+ *                   [--rate <datagrams/s, 0: unpaced>] [--duration <s>] [--settle-ms <ms>]
+ *                   [--expect-idle <s>]
+ *                   [--replay <file> | --vendor brocade|hpe --agents <n> --ports <n>
+ *                    --flows <n> --samples <per datagram> --counter-every <n>
+ *                    --sampling-rate <n> --utilization <0..1>]
+ */
+#include "utils/HttpClient.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+#define BENCH_DEFAULT_RATE 10000            // datagrams per second
+#define BENCH_DEFAULT_DURATION_S 10         // sending time
+#define BENCH_DEFAULT_SETTLE_MS 1000        // wait before reading the collector's counters again
+#define BENCH_PACING_BURST 32               // datagrams sent between two clock checks
+#define BENCH_PORT_SPEED_BPS 10000000000ULL // ports of the synthetic counter samples
+#define BENCH_IDLE_POLL_MS 500              // between two looks at the flows with --expect-idle
+#define BENCH_STREAM_INTERVAL_MS 200        // ?interval_ms= of the telemetry stream followed
+
+namespace
+{
+
+struct BenchConfig
+{
+    std::string targetHost = "127.0.0.1";
+    uint16_t targetPort = 6343;
+    std::string ndtUrl = "http://127.0.0.1:8000";
+    std::optional<long> pid;
+    uint64_t rate = BENCH_DEFAULT_RATE;
+    uint64_t durationSeconds = BENCH_DEFAULT_DURATION_S;
+    uint64_t settleMs = BENCH_DEFAULT_SETTLE_MS;
+    uint64_t expectIdleSeconds = 0; // 0: no cool-down check
+    std::string replayPath;
+    bool hpe = false;
+    uint32_t agents = 4;
+    uint32_t ports = 48;
+    uint32_t flows = 4096;
+    uint32_t samplesPerDatagram = 8;
+    uint32_t counterEvery = 8; // every n-th sample is a counter sample (0: none)
+    uint32_t samplingRate = 1024;
+    double utilization = 0.3; // of the ports in synthetic counter samples
+};
+
+BenchConfig
+parseArgs(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/SflowBench.cpp\n");
+            std::exit(0);
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--target")
+        {
+            size_t colon = value.rfind(':');
+            config.targetHost = value.substr(0, colon);
+            if (colon != std::string::npos)
+            {
+                config.targetPort = static_cast<uint16_t>(std::stoul(value.substr(colon + 1)));
+            }
+        }
+        else if (arg == "--ndt")
+        {
+            config.ndtUrl = value;
+        }
+        else if (arg == "--pid")
+        {
+            config.pid = std::stol(value);
+        }
+        else if (arg == "--rate")
+        {
+            config.rate = std::stoull(value);
+        }
+        else if (arg == "--duration")
+        {
+            config.durationSeconds = std::stoull(value);
+        }
+        else if (arg == "--settle-ms")
+        {
+            config.settleMs = std::stoull(value);
+        }
+        else if (arg == "--expect-idle")
+        {
+            config.expectIdleSeconds = std::stoull(value);
+        }
+        else if (arg == "--replay")
+        {
+            config.replayPath = value;
+        }
+        else if (arg == "--vendor")
+        {
+            if (value != "brocade" && value != "hpe")
+            {
+                throw std::invalid_argument("--vendor must be brocade or hpe");
+            }
+            config.hpe = value == "hpe";
+        }
+        else if (arg == "--agents")
+        {
+            config.agents = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--ports")
+        {
+            config.ports = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--flows")
+        {
+            config.flows = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--samples")
+        {
+            config.samplesPerDatagram = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--counter-every")
+        {
+            config.counterEvery = std::stoul(value);
+        }
+        else if (arg == "--sampling-rate")
+        {
+            config.samplingRate = std::stoul(value);
+        }
+        else if (arg == "--utilization")
+        {
+            config.utilization = std::clamp(std::stod(value), 0.0, 1.0);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    return config;
+}
+
+//================================================================
+// Captured datagrams
+//================================================================
+
+uint32_t
+readBe32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+uint16_t
+readBe16(const unsigned char* p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief UDP payload of a captured link-layer frame, if it is IPv4/UDP to @p port.
+ *
+ * Handles Ethernet (with VLAN tags), Linux cooked capture and raw IP link types.
+ */
+std::optional<std::string>
+udpPayload(const unsigned char* frame, size_t length, uint32_t linkType, uint16_t port)
+{
+    size_t offset = 0;
+    uint16_t etherType = 0;
+    switch (linkType)
+    {
+    case 1: // Ethernet
+        offset = 12;
+        while (offset + 2 <= length)
+        {
+            etherType = readBe16(frame + offset);
+            offset += 2;
+            if (etherType != 0x8100 && etherType != 0x88A8)
+            {
+                break;
+            }
+            offset += 2; // VLAN tag
+        }
+        break;
+    case 113: // Linux cooked capture
+        if (length < 16)
+        {
+            return std::nullopt;
+        }
+        etherType = readBe16(frame + 14);
+        offset = 16;
+        break;
+    case 101: // Raw IP
+        etherType = 0x0800;
+        break;
+    default:
+        return std::nullopt;
+    }
+
+    if (etherType != 0x0800 || offset + 20 > length)
+    {
+        return std::nullopt;
+    }
+    const unsigned char* ip = frame + offset;
+    const size_t ipHeader = (ip[0] & 0x0F) * 4;
+    if (ip[9] != 17 || offset + ipHeader + 8 > length)
+    {
+        return std::nullopt;
+    }
+    const unsigned char* udp = ip + ipHeader;
+    if (readBe16(udp + 2) != port)
+    {
+        return std::nullopt;
+    }
+    const size_t udpLength = readBe16(udp + 4);
+    const size_t payload = std::min(udpLength, length - offset - ipHeader) - 8;
+    return std::string(reinterpret_cast<const char*>(udp + 8), payload);
+}
+
+/**
+ * @brief Datagrams of a pcap file (sFlow to @p port only) or of a raw length-prefixed dump.
+ */
+std::vector<std::string>
+loadCapture(const std::string& path, uint16_t port)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)), {});
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    std::vector<std::string> datagrams;
+
+    const uint32_t magic = data.size() >= 4 ? readBe32(bytes) : 0;
+    const bool pcapBigEndian = magic == 0xA1B2C3D4 || magic == 0xA1B23C4D;
+    const bool pcapLittleEndian = magic == 0xD4C3B2A1 || magic == 0x4D3CB2A1;
+    if (pcapBigEndian || pcapLittleEndian)
+    {
+        auto read32 = [&](size_t offset) {
+            uint32_t v = readBe32(bytes + offset);
+            return pcapBigEndian ? v : __builtin_bswap32(v);
+        };
+        if (data.size() < 24)
+        {
+            throw std::runtime_error("Truncated pcap header in " + path);
+        }
+        const uint32_t linkType = read32(20);
+        for (size_t offset = 24; offset + 16 <= data.size();)
+        {
+            const size_t captured = read32(offset + 8);
+            offset += 16;
+            if (offset + captured > data.size())
+            {
+                break;
+            }
+            if (auto payload = udpPayload(bytes + offset, captured, linkType, port))
+            {
+                datagrams.push_back(std::move(*payload));
+            }
+            offset += captured;
+        }
+    }
+    else
+    {
+        for (size_t offset = 0; offset + 4 <= data.size();)
+        {
+            const size_t length = readBe32(bytes + offset);
+            offset += 4;
+            if (offset + length > data.size())
+            {
+                break;
+            }
+            datagrams.emplace_back(data, offset, length);
+            offset += length;
+        }
+    }
+    return datagrams;
+}
+
+//================================================================
+// Synthetic datagrams
+//================================================================
+
+/**
+ * @brief Builds one sample word by word at the offsets SFlowDecoder reads.
+ */
+class SampleWriter
+{
+  public:
+    SampleWriter(uint32_t type, size_t words)
+        : m_words(words, 0)
+    {
+        m_words[0] = type;
+        m_words[1] = static_cast<uint32_t>((words - 2) * 4);
+    }
+
+    void set(size_t offset, uint32_t value)
+    {
+        m_words[offset] = value;
+    }
+
+    void set64(size_t offset, uint64_t value)
+    {
+        m_words[offset] = static_cast<uint32_t>(value >> 32);
+        m_words[offset + 1] = static_cast<uint32_t>(value);
+    }
+
+    void appendTo(std::string& out) const
+    {
+        for (uint32_t word : m_words)
+        {
+            uint32_t be = htonl(word);
+            out.append(reinterpret_cast<const char*>(&be), sizeof(be));
+        }
+    }
+
+  private:
+    std::vector<uint32_t> m_words;
+};
+
+class SyntheticSource
+{
+  public:
+    explicit SyntheticSource(const BenchConfig& config)
+        : m_config(config),
+          m_start(Clock::now())
+    {
+    }
+
+    std::string next()
+    {
+        const uint32_t agent = m_agent++ % m_config.agents;
+        std::string out;
+        for (uint32_t word : {5U, 1U, agentAddress(agent), 0U, m_sequence++, uptimeMs(),
+                              m_config.samplesPerDatagram})
+        {
+            uint32_t be = htonl(word);
+            out.append(reinterpret_cast<const char*>(&be), sizeof(be));
+        }
+        for (uint32_t i = 0; i < m_config.samplesPerDatagram; ++i)
+        {
+            const bool counter =
+                m_config.counterEvery != 0 && ++m_sampleCount % m_config.counterEvery == 0;
+            if (counter)
+            {
+                counterSample(out);
+            }
+            else
+            {
+                flowSample(out);
+            }
+        }
+        return out;
+    }
+
+  private:
+    // 10.255.a.b, in the host order the datagram header word is built from
+    static uint32_t agentAddress(uint32_t agent)
+    {
+        return (10U << 24) | (255U << 16) | ((agent + 1) & 0xFFFF);
+    }
+
+    uint32_t uptimeMs() const
+    {
+        return static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_start)
+                .count());
+    }
+
+    void counterSample(std::string& out)
+    {
+        const uint32_t ifIndex = m_counterPort++ % m_config.ports + 1;
+        // Octets grow with the configured utilisation since the start of the run
+        const double seconds = std::chrono::duration<double>(Clock::now() - m_start).count();
+        const auto octets =
+            static_cast<uint64_t>(BENCH_PORT_SPEED_BPS / 8 * m_config.utilization * seconds);
+
+        // Brocade: base offset 4 plus a 15-word leading record; HPE: base offset 5
+        const size_t base = m_config.hpe ? 5 : 4 + 15;
+        SampleWriter sample(m_config.hpe ? 4 : 2, base + 21);
+        sample.set(base + 3, ifIndex);
+        sample.set64(base + 5, BENCH_PORT_SPEED_BPS);
+        sample.set64(base + 9, octets);
+        sample.set64(base + 17, octets);
+        sample.appendTo(out);
+    }
+
+    void flowSample(std::string& out)
+    {
+        const uint32_t flow = m_flowDist(m_rng) % m_config.flows;
+        const uint32_t inputPort = flow % m_config.ports + 1;
+        const uint32_t frameLength = 64 + flow % 1400;
+
+        size_t hdr = 0;
+        SampleWriter sample(m_config.hpe ? 3 : 1, m_config.hpe ? 36 : 32);
+        if (m_config.hpe)
+        {
+            sample.set(5, m_config.samplingRate);
+            sample.set(9, inputPort);
+            sample.set(11, 0);
+            sample.set(16, frameLength);
+            sample.set(23, 0x0800U << 16);
+            hdr = 25;
+        }
+        else
+        {
+            sample.set(4, m_config.samplingRate);
+            sample.set(7, inputPort);
+            sample.set(13, frameLength);
+            sample.set(19, 0x0800U << 16);
+            hdr = 21;
+        }
+
+        // 10.0.x.y -> 10.1.x.y, TCP; addresses straddle words as in the exported header
+        const uint32_t host = flow / m_config.ports;
+        const uint16_t srcLow = static_cast<uint16_t>(host);
+        const uint16_t dstLow = static_cast<uint16_t>(host * 7 + 1);
+        const uint16_t srcPort = static_cast<uint16_t>(10000 + flow % 50000);
+        const uint16_t dstPort = 443;
+        sample.set(hdr, 6);
+        sample.set(hdr + 1, (10U << 8) | 0U);
+        sample.set(hdr + 2, (uint32_t(srcLow) << 16) | (10U << 8) | 1U);
+        sample.set(hdr + 3, (uint32_t(dstLow) << 16) | srcPort);
+        sample.set(hdr + 4, uint32_t(dstPort) << 16);
+        sample.set(hdr + 7, 0x10U << 8); // ACK
+        sample.appendTo(out);
+    }
+
+    const BenchConfig& m_config;
+    Clock::time_point m_start;
+    uint32_t m_agent = 0;
+    uint32_t m_sequence = 0;
+    uint64_t m_sampleCount = 0;
+    uint32_t m_counterPort = 0;
+    std::mt19937 m_rng{42};
+    std::uniform_int_distribution<uint32_t> m_flowDist;
+};
+
+//================================================================
+// Collector counters
+//================================================================
+
+struct CollectorCounters
+{
+    uint64_t datagrams = 0;
+    uint64_t samples = 0;
+    uint64_t recordsApplied = 0;
+    uint64_t kernelDrops = 0;
+    uint64_t ringOverflows = 0;
+    uint64_t malformed = 0;
+    std::map<double, double> decodeBuckets; // upper bound -> cumulative count, all workers
+    std::optional<uint64_t> rssKb;
+};
+
+std::optional<uint64_t>
+residentKb(long pid)
+{
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.rfind("VmRSS:", 0) == 0)
+        {
+            return std::stoull(line.substr(6));
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<CollectorCounters>
+readCounters(const BenchConfig& config)
+{
+    auto& client = utils::HttpClient::instance();
+    auto stats = client.get(config.ndtUrl + "/ndt/get_collector_stats");
+    auto metrics = client.get(config.ndtUrl + "/metrics");
+    if (!stats.ok() || !metrics.ok())
+    {
+        return std::nullopt;
+    }
+
+    CollectorCounters counters;
+    for (const auto& worker : json::parse(stats.body).at("ingest_workers"))
+    {
+        counters.datagrams += worker.value("datagrams_received", 0ULL);
+        counters.samples += worker.value("flow_samples_decoded", 0ULL) +
+                            worker.value("counter_samples_decoded", 0ULL);
+        counters.recordsApplied += worker.value("records_applied", 0ULL);
+        counters.kernelDrops += worker.value("kernel_drops", 0ULL);
+        counters.ringOverflows += worker.value("ring_overflows", 0ULL);
+        counters.malformed += worker.value("malformed_datagrams", 0ULL);
+    }
+
+    // ndt_sflow_decode_seconds_bucket{worker="0",le="1e-05"} 42
+    constexpr std::string_view PREFIX = "ndt_sflow_decode_seconds_bucket{";
+    std::istringstream lines(metrics.body);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.rfind(PREFIX, 0) != 0)
+        {
+            continue;
+        }
+        size_t le = line.find("le=\"");
+        size_t close = line.find("\"}", le);
+        if (le == std::string::npos || close == std::string::npos)
+        {
+            continue;
+        }
+        const double bound = std::strtod(line.substr(le + 4, close - le - 4).c_str(), nullptr);
+        counters.decodeBuckets[bound] += std::strtod(line.c_str() + close + 2, nullptr);
+    }
+
+    if (config.pid)
+    {
+        counters.rssKb = residentKb(*config.pid);
+    }
+    return counters;
+}
+
+// Upper bound of the bucket holding quantile @p q of the observations between two reads
+std::optional<double>
+quantile(const CollectorCounters& before, const CollectorCounters& after, double q)
+{
+    if (after.decodeBuckets.empty())
+    {
+        return std::nullopt;
+    }
+    auto delta = [&](double bound) {
+        auto it = before.decodeBuckets.find(bound);
+        return after.decodeBuckets.at(bound) - (it == before.decodeBuckets.end() ? 0 : it->second);
+    };
+    const double total = delta(after.decodeBuckets.rbegin()->first);
+    if (total <= 0)
+    {
+        return std::nullopt;
+    }
+    for (const auto& [bound, cumulative] : after.decodeBuckets)
+    {
+        if (delta(bound) >= q * total)
+        {
+            return bound;
+        }
+    }
+    return std::nullopt;
+}
+
+//================================================================
+// Sending
+//================================================================
+
+struct SendResult
+{
+    uint64_t datagrams = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    double seconds = 0;
+};
+
+template <typename Next>
+SendResult
+sendFor(const BenchConfig& config, Next&& next)
+{
+    int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.targetPort);
+    if (sock < 0 || ::inet_pton(AF_INET, config.targetHost.c_str(), &addr.sin_addr) != 1 ||
+        ::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        throw std::runtime_error("Cannot open a UDP socket to " + config.targetHost);
+    }
+
+    SendResult result;
+    const auto start = Clock::now();
+    const auto end = start + std::chrono::seconds(config.durationSeconds);
+    const std::chrono::duration<double> period(config.rate ? 1.0 / config.rate : 0.0);
+    for (auto now = start; now < end; now = Clock::now())
+    {
+        for (int i = 0; i < BENCH_PACING_BURST; ++i)
+        {
+            const std::string& datagram = next();
+            if (::send(sock, datagram.data(), datagram.size(), 0) < 0)
+            {
+                ++result.errors;
+                continue;
+            }
+            ++result.datagrams;
+            result.bytes += datagram.size();
+        }
+        if (config.rate)
+        {
+            std::this_thread::sleep_until(
+                start + std::chrono::duration_cast<Clock::duration>(period * result.datagrams));
+        }
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    ::close(sock);
+    return result;
+}
+
+//================================================================
+// Cool-down check
+//================================================================
+
+struct FlowTableState
+{
+    size_t flows = 0;       // detected, hot or cold
+    size_t movingFlows = 0; // with any non-zero rate
+    uint64_t hotFlows = 0;
+    uint64_t coldFlows = 0;
+    uint64_t demotions = 0;
+};
+
+std::optional<FlowTableState>
+readFlowTable(const BenchConfig& config)
+{
+    auto& client = utils::HttpClient::instance();
+    auto flows = client.get(config.ndtUrl + "/ndt/get_detected_flow_data");
+    auto stats = client.get(config.ndtUrl + "/ndt/get_collector_stats");
+    if (!flows.ok() || !stats.ok())
+    {
+        return std::nullopt;
+    }
+
+    FlowTableState state;
+    for (const auto& flow : json::parse(flows.body))
+    {
+        ++state.flows;
+        for (const char* rate : {"estimated_flow_sending_rate_bps_in_the_proceeding_1sec_timeslot",
+                                 "estimated_flow_sending_rate_bps_in_the_last_sec",
+                                 "estimated_packet_rate_in_the_proceeding_1sec_timeslot",
+                                 "estimated_packet_rate_in_the_last_sec"})
+        {
+            if (flow.value(rate, 0ULL) != 0)
+            {
+                ++state.movingFlows;
+                break;
+            }
+        }
+    }
+    const json tiers = json::parse(stats.body).at("flow_tiers");
+    state.hotFlows = tiers.value("hot_flows", 0ULL);
+    state.coldFlows = tiers.value("cold_flows", 0ULL);
+    state.demotions = tiers.value("demotions", 0ULL);
+    return state;
+}
+
+/**
+ * @brief Follows /ndt/telemetry_stream on a plain socket and keeps the flows announced as
+ *        elephants ("elephant_flows" items with "event": "detected") that have not ended.
+ */
+class ElephantWatch
+{
+  public:
+    explicit ElephantWatch(const std::string& ndtUrl)
+    {
+        // http://host[:port][/...]
+        const size_t scheme = ndtUrl.find("://");
+        std::string rest = ndtUrl.substr(scheme == std::string::npos ? 0 : scheme + 3);
+        rest = rest.substr(0, rest.find('/'));
+        const size_t colon = rest.rfind(':');
+        const std::string host = rest.substr(0, colon);
+        const auto port = static_cast<uint16_t>(
+            colon == std::string::npos ? 80 : std::stoul(rest.substr(colon + 1)));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        m_sock = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (m_sock < 0 || ::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+            ::connect(m_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+        {
+            throw std::runtime_error("Cannot connect to " + ndtUrl);
+        }
+        // Bounded reads, so that the reader sees the stop flag
+        timeval timeout{0, BENCH_STREAM_INTERVAL_MS * 1000};
+        ::setsockopt(m_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        const std::string request = "GET /ndt/telemetry_stream?interval_ms=" +
+                                    std::to_string(BENCH_STREAM_INTERVAL_MS) +
+                                    " HTTP/1.1\r\nHost: " + host + "\r\n\r\n";
+        if (::send(m_sock, request.data(), request.size(), 0) < 0)
+        {
+            ::close(m_sock);
+            throw std::runtime_error("Cannot request the telemetry stream of " + ndtUrl);
+        }
+        m_thread = std::thread([this] { run(); });
+    }
+
+    ~ElephantWatch()
+    {
+        m_stop = true;
+        m_thread.join();
+        ::close(m_sock);
+    }
+
+    ElephantWatch(const ElephantWatch&) = delete;
+    ElephantWatch& operator=(const ElephantWatch&) = delete;
+
+    size_t detected() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_detected;
+    }
+
+    size_t ended() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_ended;
+    }
+
+    size_t unended() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_elephants.size();
+    }
+
+  private:
+    void run()
+    {
+        std::string buffer;
+        char chunk[4096];
+        while (!m_stop)
+        {
+            const ssize_t n = ::recv(m_sock, chunk, sizeof(chunk), 0);
+            if (n == 0)
+            {
+                return; // closed by the server
+            }
+            if (n < 0)
+            {
+                continue; // timed out
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+            for (size_t end; (end = buffer.find('\n')) != std::string::npos;)
+            {
+                if (buffer.rfind("data: ", 0) == 0)
+                {
+                    handleEvent(buffer.substr(6, end - 6));
+                }
+                buffer.erase(0, end + 1);
+            }
+        }
+    }
+
+    void handleEvent(const std::string& data)
+    {
+        const json event = json::parse(data, nullptr, false);
+        if (!event.is_object() || !event.contains("elephant_flows"))
+        {
+            return;
+        }
+        std::lock_guard lock(m_mutex);
+        for (const auto& flow : event["elephant_flows"])
+        {
+            const std::string key = json::array({flow.value("src_ip", 0U),
+                                                 flow.value("dst_ip", 0U),
+                                                 flow.value("src_port", 0U),
+                                                 flow.value("dst_port", 0U),
+                                                 flow.value("protocol_id", 0U)})
+                                        .dump();
+            if (flow.value("event", "") == "detected")
+            {
+                ++m_detected;
+                m_elephants.insert(key);
+            }
+            else
+            {
+                ++m_ended;
+                m_elephants.erase(key);
+            }
+        }
+    }
+
+    int m_sock = -1;
+    std::atomic<bool> m_stop{false};
+    std::thread m_thread;
+    mutable std::mutex m_mutex;
+    size_t m_detected = 0;
+    size_t m_ended = 0;
+    std::set<std::string> m_elephants; // detected and not ended yet
+};
+
+// Whether every flow stopped moving and left the hot table within --expect-idle
+bool
+waitForIdle(const BenchConfig& config)
+{
+    const auto deadline = Clock::now() + std::chrono::seconds(config.expectIdleSeconds);
+    std::optional<FlowTableState> state;
+    for (;;)
+    {
+        state = readFlowTable(config);
+        if (state && state->movingFlows == 0 && state->hotFlows == 0)
+        {
+            std::printf("Idle: %zu flows at zero rates, %lu cold, %lu demotions\n",
+                        state->flows,
+                        state->coldFlows,
+                        state->demotions);
+            return true;
+        }
+        if (Clock::now() >= deadline)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_IDLE_POLL_MS));
+    }
+    if (!state)
+    {
+        std::fprintf(stderr, "Flow table unavailable at %s\n", config.ndtUrl.c_str());
+        return false;
+    }
+    std::fprintf(stderr,
+                 "Not idle after %lu s: %zu of %zu flows still report a rate, %lu flows hot\n",
+                 config.expectIdleSeconds,
+                 state->movingFlows,
+                 state->flows,
+                 state->hotFlows);
+    return false;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    Logger::init(LogConfig{});
+    BenchConfig config;
+    try
+    {
+        config = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    std::vector<std::string> capture;
+    if (!config.replayPath.empty())
+    {
+        capture = loadCapture(config.replayPath, config.targetPort);
+        if (capture.empty())
+        {
+            std::fprintf(stderr, "No sFlow datagrams in %s\n", config.replayPath.c_str());
+            return 1;
+        }
+        std::printf("Replaying %zu datagrams from %s\n", capture.size(), config.replayPath.c_str());
+    }
+
+    const auto before = readCounters(config);
+    if (!before)
+    {
+        std::printf("Collector counters unavailable at %s; reporting the sender side only\n",
+                    config.ndtUrl.c_str());
+    }
+
+    // Subscribed before the first datagram, so that no announcement is missed
+    std::unique_ptr<ElephantWatch> elephants;
+    if (config.expectIdleSeconds != 0)
+    {
+        try
+        {
+            elephants = std::make_unique<ElephantWatch>(config.ndtUrl);
+        }
+        catch (const std::exception& e)
+        {
+            std::fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+    }
+
+    SendResult sent;
+    if (capture.empty())
+    {
+        SyntheticSource source(config);
+        std::string datagram;
+        sent = sendFor(config, [&]() -> const std::string& { return datagram = source.next(); });
+    }
+    else
+    {
+        size_t index = 0;
+        sent = sendFor(config,
+                       [&]() -> const std::string& { return capture[index++ % capture.size()]; });
+    }
+
+    std::printf("Sent %lu datagrams (%.0f/s, %.1f MB/s) in %.2f s, %lu send errors\n",
+                sent.datagrams,
+                sent.datagrams / sent.seconds,
+                sent.bytes / sent.seconds / 1e6,
+                sent.seconds,
+                sent.errors);
+
+    if (!before)
+    {
+        return config.expectIdleSeconds != 0 ? 1 : 0;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(config.settleMs));
+    const auto after = readCounters(config);
+    if (!after)
+    {
+        std::fprintf(stderr, "Collector counters unavailable after the run\n");
+        return 1;
+    }
+
+    const uint64_t received = after->datagrams - before->datagrams;
+    const uint64_t lost = sent.datagrams > received ? sent.datagrams - received : 0;
+    std::printf("Collector: %lu datagrams, %.0f samples/s decoded, %.0f records/s applied\n",
+                received,
+                (after->samples - before->samples) / sent.seconds,
+                (after->recordsApplied - before->recordsApplied) / sent.seconds);
+    std::printf("Drops: %.3f%% of sent (%lu), kernel queue %lu, ingest rings %lu, malformed %lu\n",
+                sent.datagrams ? 100.0 * lost / sent.datagrams : 0.0,
+                lost,
+                after->kernelDrops - before->kernelDrops,
+                after->ringOverflows - before->ringOverflows,
+                after->malformed - before->malformed);
+    if (auto p99 = quantile(*before, *after, 0.99))
+    {
+        std::printf("Decode latency p99: <= %.1f us per datagram\n", *p99 * 1e6);
+    }
+    if (before->rssKb && after->rssKb)
+    {
+        std::printf("Resident memory: %lu -> %lu kB (%+ld kB)\n",
+                    *before->rssKb,
+                    *after->rssKb,
+                    static_cast<long>(*after->rssKb) - static_cast<long>(*before->rssKb));
+    }
+    if (config.expectIdleSeconds != 0)
+    {
+        if (!waitForIdle(config))
+        {
+            return 1;
+        }
+        // Transitions of the last rate tick reach the stream with its next push
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * BENCH_STREAM_INTERVAL_MS));
+        std::printf("Elephant flows: %zu detected, %zu ended\n",
+                    elephants->detected(),
+                    elephants->ended());
+        if (elephants->unended() != 0)
+        {
+            std::fprintf(stderr,
+                         "%zu elephant flows stopped sending but never ended\n",
+                         elephants->unended());
+            return 1;
+        }
+    }
+    return 0;
+}
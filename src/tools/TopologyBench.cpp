@@ -0,0 +1,579 @@
+/**
+ * @file TopologyBench.cpp
+ * @brief Loads static topology files into TopologyAndFlowMonitor and times its topology
+ *        operations, to size hardware for large fabrics and compare indexing changes.
+ *
+ * For each file, without a controller:
+ *   - load: loadStaticTopology() parsing the JSON (its compiled cache removed first), then
+ *     again into a fresh graph from the cache it wrote;
+ *   - up: every switch, link and host reported up in one applyTopologyEvents() batch;
+ *   - lookups: findSwitchByDpid, findVertexByIp, findEdgeByDpidAndPort, findEdgeByHostIp,
+ *     findEdgeBySrcAndDstDpid and findHostAttachment on random keys of the topology;
+ *   - getGraph: the deep copy of the graph;
+ *   - bfsAllPathsToDst: the /32 rules and paths of all hosts towards random hosts;
+ *   - getAllPathsBetweenTwoHosts: random host pairs;
+ *   - counters and top-K: updateLinkInfo() on every switch link with random utilization,
+ *     then getTopKCongestedLinksJson().
+ *
+ * --suite generates the fat-trees of k = 8 to 48 and a leaf-spine and a random-regular
+ * topology (see TopologyGenerator.hpp) into --dir first and runs on those.
+ *
+ * Usage:
+ *   ndt_topology_bench [--suite [--dir <dir>] [--max-k <k>]] [<topology.json> ...]
+ *                      [--lookups <n>] [--pairs <n>] [--destinations <n>] [--repeat <n>]
+ *                      [--top-k <n>] [--seed <n>]
+ */
+#include "TopologyGenerator.hpp"
+#include "event_system/EventBus.hpp"
+#include "ndt_core/collection/TopologyAndFlowMonitor.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+#define BENCH_DEFAULT_LOOKUPS 100000 // random keys per find* function
+#define BENCH_DEFAULT_PAIRS 200      // host pairs for getAllPathsBetweenTwoHosts
+#define BENCH_DEFAULT_DESTINATIONS 8 // destination hosts for bfsAllPathsToDst
+#define BENCH_DEFAULT_REPEAT 20      // getGraph copies and top-K queries
+#define BENCH_DEFAULT_TOP_K 10       // links asked of getTopKCongestedLinksJson
+#define BENCH_SUITE_DIR "/tmp/ndt_topology_bench"
+
+namespace
+{
+
+struct BenchConfig
+{
+    std::vector<std::string> files;
+    bool suite = false;
+    std::string suiteDir = BENCH_SUITE_DIR;
+    unsigned maxK = 48; // largest fat-tree of the suite
+    size_t lookups = BENCH_DEFAULT_LOOKUPS;
+    size_t pairs = BENCH_DEFAULT_PAIRS;
+    size_t destinations = BENCH_DEFAULT_DESTINATIONS;
+    size_t repeat = BENCH_DEFAULT_REPEAT;
+    int topK = BENCH_DEFAULT_TOP_K;
+    uint64_t seed = 1;
+};
+
+BenchConfig
+parseArgs(int argc, char* argv[])
+{
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/TopologyBench.cpp\n");
+            std::exit(0);
+        }
+        if (arg == "--suite")
+        {
+            config.suite = true;
+            continue;
+        }
+        if (!arg.starts_with("--"))
+        {
+            config.files.emplace_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--dir")
+        {
+            config.suiteDir = value;
+        }
+        else if (arg == "--max-k")
+        {
+            config.maxK = std::stoul(value);
+        }
+        else if (arg == "--lookups")
+        {
+            config.lookups = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--pairs")
+        {
+            config.pairs = std::stoul(value);
+        }
+        else if (arg == "--destinations")
+        {
+            config.destinations = std::stoul(value);
+        }
+        else if (arg == "--repeat")
+        {
+            config.repeat = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--top-k")
+        {
+            config.topK = std::stoi(value);
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = std::stoull(value);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    if (!config.suite && config.files.empty())
+    {
+        throw std::invalid_argument("No topology files given (or --suite)");
+    }
+    return config;
+}
+
+//================================================================
+// Timing
+//================================================================
+
+/// Durations of repeated calls of one operation.
+class Samples
+{
+  public:
+    void add(Clock::duration d)
+    {
+        m_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+
+    /// Time @p fn once and record it.
+    template <typename Fn>
+    void time(Fn&& fn)
+    {
+        const auto start = Clock::now();
+        fn();
+        add(Clock::now() - start);
+    }
+
+    /// "<label>  mean ...  p99 ...  max ..." in the unit that suits the mean.
+    void print(const char* label)
+    {
+        if (m_ns.empty())
+        {
+            std::printf("  %-28s (no samples)\n", label);
+            return;
+        }
+        std::sort(m_ns.begin(), m_ns.end());
+        double sum = 0;
+        for (uint64_t ns : m_ns)
+        {
+            sum += ns;
+        }
+        const double mean = sum / m_ns.size();
+        const double p99 = m_ns[std::min(m_ns.size() - 1, m_ns.size() * 99 / 100)];
+        const double max = m_ns.back();
+        const char* unit = "ns";
+        double scale = 1;
+        if (mean >= 1e6)
+        {
+            unit = "ms";
+            scale = 1e6;
+        }
+        else if (mean >= 1e3)
+        {
+            unit = "us";
+            scale = 1e3;
+        }
+        std::printf("  %-28s mean %9.2f %s  p99 %9.2f %s  max %9.2f %s  (%zu)\n",
+                    label,
+                    mean / scale,
+                    unit,
+                    p99 / scale,
+                    unit,
+                    max / scale,
+                    unit,
+                    m_ns.size());
+    }
+
+  private:
+    std::vector<uint64_t> m_ns;
+};
+
+double
+msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//================================================================
+// Topology under test
+//================================================================
+
+std::string
+hexString(uint64_t value, int width)
+{
+    char text[24];
+    std::snprintf(text, sizeof(text), "%0*lx", width, value);
+    return text;
+}
+
+std::string
+macString(uint64_t mac)
+{
+    char text[18];
+    std::snprintf(text,
+                  sizeof(text),
+                  "%02lx:%02lx:%02lx:%02lx:%02lx:%02lx",
+                  (mac >> 40) & 0xff,
+                  (mac >> 32) & 0xff,
+                  (mac >> 24) & 0xff,
+                  (mac >> 16) & 0xff,
+                  (mac >> 8) & 0xff,
+                  mac & 0xff);
+    return text;
+}
+
+/// What the benchmark draws its keys from, read from the topology file.
+struct TopologyKeys
+{
+    struct SwitchLink
+    {
+        uint64_t srcDpid;
+        uint32_t srcPort;
+        uint32_t srcIp; // network byte order, as sFlow agents are keyed
+        uint64_t dstDpid;
+        uint64_t bps;
+    };
+
+    std::vector<uint64_t> switchDpids;
+    std::vector<uint32_t> hostIps; // network byte order
+    std::vector<SwitchLink> links; // one per direction
+    std::vector<TopologyEvent> upEvents;
+};
+
+/// The keys of @p topology and the Ryu events reporting all of it up, as Ryu would send them.
+TopologyKeys
+readKeys(const json& topology)
+{
+    TopologyKeys keys;
+    std::unordered_map<std::string, uint64_t> hostMacs;
+    for (const auto& node : topology.at("nodes"))
+    {
+        if (node.at("vertex_type").get<int>() == 0)
+        {
+            const uint64_t dpid = node.at("dpid").get<uint64_t>();
+            keys.switchDpids.push_back(dpid);
+            keys.upEvents.push_back(
+                {TopologyEvent::Type::SwitchEnter, {{"dpid", hexString(dpid, 16)}}});
+        }
+        else if (!node.at("ip").empty())
+        {
+            const std::string ip = node.at("ip")[0].get<std::string>();
+            keys.hostIps.push_back(utils::ipStringToUint32(ip));
+            hostMacs[ip] = node.at("mac").get<uint64_t>();
+        }
+    }
+
+    for (const auto& edge : topology.at("edges"))
+    {
+        const uint64_t srcDpid = edge.at("src_dpid").get<uint64_t>();
+        const uint64_t dstDpid = edge.at("dst_dpid").get<uint64_t>();
+        if (srcDpid == 0)
+        {
+            // Host to switch: the host as Ryu reports it, on the switch port it is attached to
+            const std::string ip = edge.at("src_ip")[0].get<std::string>();
+            const uint32_t port = edge.at("dst_interface").get<uint32_t>();
+            keys.upEvents.push_back({TopologyEvent::Type::HostAdd,
+                                     {{"mac", macString(hostMacs[ip])},
+                                      {"ipv4", {ip}},
+                                      {"port",
+                                       {{"dpid", hexString(dstDpid, 16)},
+                                        {"port_no", hexString(port, 8)}}}}});
+            continue;
+        }
+        if (dstDpid == 0)
+        {
+            continue;
+        }
+        const uint32_t srcPort = edge.at("src_interface").get<uint32_t>();
+        keys.links.push_back(
+            {srcDpid,
+             srcPort,
+             utils::ipStringToUint32(edge.at("src_ip")[0].get<std::string>()),
+             dstDpid,
+             edge.at("link_bandwidth_bps").get<uint64_t>()});
+        keys.upEvents.push_back(
+            {TopologyEvent::Type::LinkAdd,
+             {{"src", {{"dpid", hexString(srcDpid, 16)}, {"port_no", hexString(srcPort, 8)}}},
+              {"dst",
+               {{"dpid", hexString(dstDpid, 16)},
+                {"port_no", hexString(edge.at("dst_interface").get<uint32_t>(), 8)}}}}});
+    }
+    return keys;
+}
+
+/// A monitor over a graph of its own, as ndtwin_kernel sets them up.
+struct Monitor
+{
+    Monitor()
+        : graph(std::make_shared<Graph>()),
+          mutex(std::make_shared<std::shared_mutex>()),
+          bus(std::make_shared<EventBus>(0)),
+          monitor(graph, mutex, bus, utils::TESTBED)
+    {
+    }
+
+    std::shared_ptr<Graph> graph;
+    std::shared_ptr<std::shared_mutex> mutex;
+    std::shared_ptr<EventBus> bus;
+    TopologyAndFlowMonitor monitor;
+};
+
+//================================================================
+// Benchmark
+//================================================================
+
+void
+runFile(const BenchConfig& config, const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::fprintf(stderr, "Cannot open %s\n", path.c_str());
+        return;
+    }
+    const TopologyKeys keys = readKeys(json::parse(file));
+    std::printf("== %s: %zu switches, %zu hosts, %zu switch links\n",
+                path.c_str(),
+                keys.switchDpids.size(),
+                keys.hostIps.size(),
+                keys.links.size() / 2);
+    if (keys.switchDpids.empty() || keys.hostIps.empty())
+    {
+        std::printf("  (no switches or hosts, skipped)\n");
+        return;
+    }
+    std::mt19937_64 rng(config.seed);
+    auto pick = [&rng](const auto& values) -> const auto& {
+        return values[std::uniform_int_distribution<size_t>(0, values.size() - 1)(rng)];
+    };
+
+    // Load: the JSON, then the compiled cache it leaves next to the file
+    std::filesystem::remove(path + TOPOLOGY_CACHE_SUFFIX);
+    {
+        Monitor parsed;
+        const auto start = Clock::now();
+        parsed.monitor.loadStaticTopology(path);
+        std::printf("  %-28s %9.2f ms\n", "load (parse JSON)", msSince(start));
+    }
+    Monitor m;
+    auto start = Clock::now();
+    m.monitor.loadStaticTopology(path);
+    std::printf("  %-28s %9.2f ms\n", "load (compiled cache)", msSince(start));
+    TopologyAndFlowMonitor& monitor = m.monitor;
+
+    start = Clock::now();
+    const auto changes = monitor.applyTopologyEvents(keys.upEvents);
+    std::printf("  %-28s %9.2f ms  (%zu events, %zu edges up)\n",
+                "applyTopologyEvents (up)",
+                msSince(start),
+                keys.upEvents.size(),
+                changes.changes.size());
+
+    // Lookups, each on keys drawn beforehand so the draw is not timed
+    size_t found = 0;
+    auto lookups = [&](const char* label, const auto& keysOf, auto&& find) {
+        std::vector<std::decay_t<decltype(keysOf[0])>> drawn;
+        drawn.reserve(config.lookups);
+        for (size_t i = 0; i < config.lookups; ++i)
+        {
+            drawn.push_back(pick(keysOf));
+        }
+        Samples samples;
+        for (const auto& key : drawn)
+        {
+            samples.time([&] { found += find(key).has_value(); });
+        }
+        samples.print(label);
+    };
+    std::vector<std::pair<uint64_t, uint32_t>> dpidPorts;
+    std::vector<std::pair<uint64_t, uint64_t>> dpidPairs;
+    for (const auto& link : keys.links)
+    {
+        dpidPorts.emplace_back(link.srcDpid, link.srcPort);
+        dpidPairs.emplace_back(link.srcDpid, link.dstDpid);
+    }
+    lookups("findSwitchByDpid", keys.switchDpids, [&](uint64_t dpid) {
+        return monitor.findSwitchByDpid(dpid);
+    });
+    lookups("findVertexByIp", keys.hostIps, [&](uint32_t ip) {
+        return monitor.findVertexByIp(ip);
+    });
+    if (!dpidPorts.empty())
+    {
+        lookups("findEdgeByDpidAndPort", dpidPorts, [&](const auto& key) {
+            return monitor.findEdgeByDpidAndPort(key);
+        });
+        lookups("findEdgeBySrcAndDstDpid", dpidPairs, [&](const auto& key) {
+            return monitor.findEdgeBySrcAndDstDpid(key);
+        });
+    }
+    lookups("findEdgeByHostIp", keys.hostIps, [&](uint32_t ip) {
+        return monitor.findEdgeByHostIp(ip);
+    });
+    lookups("findHostAttachment", keys.hostIps, [&](uint32_t ip) {
+        return monitor.findHostAttachment(ip);
+    });
+
+    Samples copies;
+    for (size_t i = 0; i < config.repeat; ++i)
+    {
+        copies.time([&] { found += boost::num_edges(monitor.getGraph()) > 0; });
+    }
+    copies.print("getGraph (copy)");
+
+    // Routing towards random hosts over one copy, as the routing manager does
+    const Graph graph = monitor.getGraph();
+    Samples bfs;
+    size_t rules = 0;
+    for (size_t i = 0; i < config.destinations; ++i)
+    {
+        const uint32_t dstIp = pick(keys.hostIps);
+        auto attachment = monitor.findHostAttachment(dstIp);
+        if (!attachment)
+        {
+            continue;
+        }
+        RoutingEngine::OpenflowTables tables;
+        bfs.time([&] {
+            found += monitor
+                         .bfsAllPathsToDst(
+                             graph, attachment->attachedSwitch, dstIp, keys.hostIps, tables)
+                         .size();
+        });
+        for (const auto& [dpid, entries] : tables)
+        {
+            rules += entries.size();
+        }
+    }
+    bfs.print("bfsAllPathsToDst");
+    if (config.destinations)
+    {
+        std::printf(
+            "  %-28s %9.0f per destination\n", "  rules", double(rules) / config.destinations);
+    }
+
+    Samples paths;
+    size_t pathCount = 0;
+    for (size_t i = 0; i < config.pairs; ++i)
+    {
+        sflow::FlowKey key{};
+        key.srcIP = pick(keys.hostIps);
+        key.dstIP = pick(keys.hostIps);
+        auto src = monitor.findHostAttachment(key.srcIP);
+        auto dst = monitor.findHostAttachment(key.dstIP);
+        if (!src || !dst)
+        {
+            continue;
+        }
+        paths.time([&] {
+            pathCount += monitor.getAllPathsBetweenTwoHosts(key, src->dpid, dst->dpid).size();
+        });
+    }
+    paths.print("getAllPathsBetweenTwoHosts");
+    if (config.pairs)
+    {
+        std::printf("  %-28s %9.1f per pair\n", "  paths", double(pathCount) / config.pairs);
+    }
+
+    // Counters of every switch link, as the sFlow counter samples would set them
+    Samples counters;
+    std::uniform_real_distribution<double> utilization(0.0, 1.0);
+    for (const auto& link : keys.links)
+    {
+        const auto left = static_cast<uint64_t>(link.bps * (1.0 - utilization(rng)));
+        counters.time(
+            [&] { monitor.updateLinkInfo({link.srcIp, link.srcPort}, left, left, link.bps); });
+    }
+    counters.print("updateLinkInfo");
+
+    Samples topK;
+    for (size_t i = 0; i < config.repeat; ++i)
+    {
+        topK.time([&] { found += monitor.getTopKCongestedLinksJson(config.topK).size(); });
+    }
+    topK.print("getTopKCongestedLinksJson");
+
+    // Keeps the lookups from being optimized away, and shows they found something
+    std::printf("  (%zu results)\n", found);
+}
+
+/// Generate the suite into config.suiteDir; the paths written.
+std::vector<std::string>
+writeSuite(const BenchConfig& config)
+{
+    std::filesystem::create_directories(config.suiteDir);
+    std::vector<std::string> paths;
+    for (const auto& spec : topology_gen::standardSuite())
+    {
+        if (spec.kind == topology_gen::Kind::FatTree && spec.k > config.maxK)
+        {
+            continue;
+        }
+        const std::string path = config.suiteDir + "/" + topology_gen::specName(spec) + ".json";
+        const auto start = Clock::now();
+        std::ofstream(path) << topology_gen::generate(spec).dump() << '\n';
+        std::printf("Generated %s in %.0f ms\n", path.c_str(), msSince(start));
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    LogConfig logConfig;
+    logConfig.level = spdlog::level::warn;
+    Logger::init(logConfig);
+    BenchConfig config;
+    try
+    {
+        config = parseArgs(argc, argv);
+        if (config.suite)
+        {
+            auto generated = writeSuite(config);
+            config.files.insert(config.files.end(), generated.begin(), generated.end());
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    for (const auto& path : config.files)
+    {
+        try
+        {
+            runFile(config, path);
+        }
+        catch (const std::exception& e)
+        {
+            std::fprintf(stderr, "%s: %s\n", path.c_str(), e.what());
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file TopologyGen.cpp
+ * @brief Writes a synthetic fat-tree, leaf-spine or random-regular topology as a static
+ *        topology file, to load in place of the ones under setting/.
+ *
+ * The file has the schema of StaticNetworkTopology_*.json; see TopologyGenerator.hpp for the
+ * addresses and ports it hands out. Without --out it is written to stdout.
+ *
+ * Usage:
+ *   ndt_topology_gen --kind fat-tree --k <even ports>
+ *   ndt_topology_gen --kind leaf-spine --leaves <n> --spines <n> --hosts <per leaf>
+ *   ndt_topology_gen --kind random-regular --switches <n> --degree <n> --hosts <per switch>
+ *                    [--seed <n>]
+ *   common: [--link-gbps <n>] [--host-gbps <n>] [--mininet] [--out <file>]
+ */
+#include "TopologyGenerator.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace
+{
+
+struct GenConfig
+{
+    topology_gen::TopologySpec spec;
+    std::string outPath; // empty: stdout
+};
+
+GenConfig
+parseArgs(int argc, char* argv[])
+{
+    GenConfig config;
+    topology_gen::TopologySpec& spec = config.spec;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg(argv[i]);
+        if (arg == "--help" || arg == "-h")
+        {
+            std::printf("See the usage in the header of src/tools/TopologyGen.cpp\n");
+            std::exit(0);
+        }
+        if (arg == "--mininet")
+        {
+            spec.mininet = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("Missing value for " + std::string(arg));
+        }
+        const std::string value(argv[++i]);
+        if (arg == "--kind")
+        {
+            spec.kind = topology_gen::parseKind(value);
+        }
+        else if (arg == "--k")
+        {
+            spec.k = std::stoul(value);
+        }
+        else if (arg == "--leaves")
+        {
+            spec.leaves = std::stoul(value);
+        }
+        else if (arg == "--spines")
+        {
+            spec.spines = std::stoul(value);
+        }
+        else if (arg == "--hosts")
+        {
+            spec.hostsPerLeaf = std::stoul(value);
+        }
+        else if (arg == "--switches")
+        {
+            spec.switches = std::stoul(value);
+        }
+        else if (arg == "--degree")
+        {
+            spec.degree = std::stoul(value);
+        }
+        else if (arg == "--seed")
+        {
+            spec.seed = std::stoull(value);
+        }
+        else if (arg == "--link-gbps")
+        {
+            spec.linkBps = std::stoull(value) * 1000000000ULL;
+        }
+        else if (arg == "--host-gbps")
+        {
+            spec.hostBps = std::stoull(value) * 1000000000ULL;
+        }
+        else if (arg == "--out")
+        {
+            config.outPath = value;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        }
+    }
+    return config;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    GenConfig config;
+    nlohmann::json topology;
+    try
+    {
+        config = parseArgs(argc, argv);
+        topology = topology_gen::generate(config.spec);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    if (config.outPath.empty())
+    {
+        std::cout << topology.dump(4) << '\n';
+        return 0;
+    }
+    std::ofstream out(config.outPath);
+    out << topology.dump(4) << '\n';
+    if (!out)
+    {
+        std::fprintf(stderr, "Cannot write %s\n", config.outPath.c_str());
+        return 1;
+    }
+    std::fprintf(stderr,
+                 "%s: %zu nodes, %zu edges written to %s\n",
+                 topology_gen::specName(config.spec).c_str(),
+                 topology["nodes"].size(),
+                 topology["edges"].size(),
+                 config.outPath.c_str());
+    return 0;
+}
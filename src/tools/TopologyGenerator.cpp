@@ -0,0 +1,364 @@
+#include "TopologyGenerator.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+using json = nlohmann::json;
+
+#define TOPOGEN_SWITCH_NET 0x0a000000U     // 10.0.0.0
+#define TOPOGEN_HOST_NET 0xac100000U       // 172.16.0.0
+#define TOPOGEN_HOST_MAC 0x020000000000ULL // locally administered
+#define TOPOGEN_MAX_RESTARTS 1000          // random-regular pairings given up before failing
+
+namespace topology_gen
+{
+
+namespace
+{
+
+std::string
+ipString(uint32_t hostOrder)
+{
+    char text[INET_ADDRSTRLEN];
+    const uint32_t address = htonl(hostOrder);
+    inet_ntop(AF_INET, &address, text, sizeof(text));
+    return text;
+}
+
+/// Nodes and edges of the topology being generated, ports handed out per switch.
+class Builder
+{
+  public:
+    explicit Builder(const TopologySpec& spec)
+        : m_spec(spec)
+    {
+    }
+
+    /// Index of a new switch named @p name.
+    size_t addSwitch(const std::string& name)
+    {
+        const size_t index = m_switches.size();
+        const uint64_t dpid = index + 1;
+        const std::string ip = ipString(TOPOGEN_SWITCH_NET + static_cast<uint32_t>(index) + 1);
+        json node = {{"brand_name", "Synthetic"},
+                     {"device_layer", 3},
+                     {"device_name", name},
+                     {"nickname", name},
+                     {"dpid", dpid},
+                     {"ip", {ip}},
+                     {"mac", 0},
+                     {"vertex_type", 0}};
+        if (m_spec.mininet)
+        {
+            node["bridge_name"] = name;
+        }
+        m_nodes.push_back(std::move(node));
+        m_switches.push_back({dpid, ip, 0});
+        return index;
+    }
+
+    /// Link switches @p a and @p b, both directions.
+    void link(size_t a, size_t b)
+    {
+        Switch& left = m_switches[a];
+        Switch& right = m_switches[b];
+        const uint32_t leftPort = ++left.ports;
+        const uint32_t rightPort = ++right.ports;
+        m_edges.push_back(edge(left.dpid, leftPort, left.ip, right.dpid, rightPort, right.ip));
+        m_edges.push_back(edge(right.dpid, rightPort, right.ip, left.dpid, leftPort, left.ip));
+    }
+
+    /// A new host on switch @p sw, both directions of its link.
+    void addHost(size_t sw)
+    {
+        const size_t index = m_hosts++;
+        const std::string name = "h" + std::to_string(index + 1);
+        const std::string ip = ipString(TOPOGEN_HOST_NET + static_cast<uint32_t>(index) + 1);
+        m_nodes.push_back({{"brand_name", ""},
+                           {"device_layer", 4},
+                           {"device_name", name},
+                           {"nickname", name},
+                           {"dpid", 0},
+                           {"ip", {ip}},
+                           {"mac", TOPOGEN_HOST_MAC + index + 1},
+                           {"vertex_type", 1}});
+
+        Switch& s = m_switches[sw];
+        const uint32_t port = ++s.ports;
+        m_edges.push_back(edge(0, 0, ip, s.dpid, port, s.ip, m_spec.hostBps));
+        m_edges.push_back(edge(s.dpid, port, s.ip, 0, 0, ip, m_spec.hostBps));
+    }
+
+    json finish()
+    {
+        return {{"nodes", std::move(m_nodes)}, {"edges", std::move(m_edges)}};
+    }
+
+  private:
+    struct Switch
+    {
+        uint64_t dpid;
+        std::string ip;
+        uint32_t ports; // handed out so far
+    };
+
+    json edge(uint64_t srcDpid,
+              uint32_t srcPort,
+              const std::string& srcIp,
+              uint64_t dstDpid,
+              uint32_t dstPort,
+              const std::string& dstIp,
+              uint64_t bps = 0) const
+    {
+        return {{"src_dpid", srcDpid},
+                {"src_interface", srcPort},
+                {"src_ip", {srcIp}},
+                {"dst_dpid", dstDpid},
+                {"dst_interface", dstPort},
+                {"dst_ip", {dstIp}},
+                {"link_bandwidth_bps", bps ? bps : m_spec.linkBps}};
+    }
+
+    const TopologySpec& m_spec;
+    json m_nodes = json::array();
+    json m_edges = json::array();
+    std::vector<Switch> m_switches;
+    size_t m_hosts = 0;
+};
+
+json
+fatTree(const TopologySpec& spec)
+{
+    const unsigned k = spec.k;
+    if (k < 2 || k % 2 != 0)
+    {
+        throw std::invalid_argument("fat-tree k must be even and at least 2");
+    }
+    const unsigned half = k / 2;
+    Builder builder(spec);
+
+    std::vector<size_t> cores;
+    for (unsigned c = 0; c < half * half; ++c)
+    {
+        cores.push_back(builder.addSwitch("core" + std::to_string(c)));
+    }
+    for (unsigned pod = 0; pod < k; ++pod)
+    {
+        const std::string prefix = "p" + std::to_string(pod);
+        std::vector<size_t> aggs;
+        for (unsigned a = 0; a < half; ++a)
+        {
+            aggs.push_back(builder.addSwitch(prefix + "agg" + std::to_string(a)));
+            // Aggregation switch a of every pod reaches the same half of the core
+            for (unsigned c = 0; c < half; ++c)
+            {
+                builder.link(aggs.back(), cores[a * half + c]);
+            }
+        }
+        for (unsigned e = 0; e < half; ++e)
+        {
+            const size_t edge = builder.addSwitch(prefix + "edge" + std::to_string(e));
+            for (size_t agg : aggs)
+            {
+                builder.link(edge, agg);
+            }
+            for (unsigned h = 0; h < half; ++h)
+            {
+                builder.addHost(edge);
+            }
+        }
+    }
+    return builder.finish();
+}
+
+json
+leafSpine(const TopologySpec& spec)
+{
+    if (spec.leaves == 0 || spec.spines == 0)
+    {
+        throw std::invalid_argument("leaf-spine needs at least one leaf and one spine");
+    }
+    Builder builder(spec);
+    std::vector<size_t> spines;
+    for (unsigned s = 0; s < spec.spines; ++s)
+    {
+        spines.push_back(builder.addSwitch("spine" + std::to_string(s)));
+    }
+    for (unsigned l = 0; l < spec.leaves; ++l)
+    {
+        const size_t leaf = builder.addSwitch("leaf" + std::to_string(l));
+        for (size_t spine : spines)
+        {
+            builder.link(leaf, spine);
+        }
+        for (unsigned h = 0; h < spec.hostsPerLeaf; ++h)
+        {
+            builder.addHost(leaf);
+        }
+    }
+    return builder.finish();
+}
+
+/**
+ * @brief Links of a random @p d-regular graph of @p n switches: the d stubs of every switch
+ *        paired at random, self-loops and parallel links refused, a pairing that gets stuck
+ *        started over.
+ */
+std::vector<std::pair<unsigned, unsigned>>
+randomRegularLinks(unsigned n, unsigned d, uint64_t seed)
+{
+    if (d == 0 || d >= n || (uint64_t(n) * d) % 2 != 0)
+    {
+        throw std::invalid_argument("random-regular needs 0 < degree < switches and an even "
+                                    "switches * degree");
+    }
+    std::mt19937_64 rng(seed);
+    for (unsigned attempt = 0; attempt < TOPOGEN_MAX_RESTARTS; ++attempt)
+    {
+        std::vector<unsigned> stubs;
+        stubs.reserve(uint64_t(n) * d);
+        for (unsigned v = 0; v < n; ++v)
+        {
+            stubs.insert(stubs.end(), d, v);
+        }
+        std::set<std::pair<unsigned, unsigned>> links;
+        bool stuck = false;
+        while (!stubs.empty() && !stuck)
+        {
+            stuck = true;
+            // Enough tries that only a pairing with no way out gives up
+            for (unsigned tries = 0; tries < 64 + 4 * d; ++tries)
+            {
+                std::uniform_int_distribution<size_t> pick(0, stubs.size() - 1);
+                const size_t i = pick(rng);
+                const size_t j = pick(rng);
+                const auto link = std::minmax(stubs[i], stubs[j]);
+                if (i == j || link.first == link.second || links.count(link))
+                {
+                    continue;
+                }
+                links.insert(link);
+                // Remove the higher position first so the lower one stays valid
+                for (size_t position : {std::max(i, j), std::min(i, j)})
+                {
+                    stubs[position] = stubs.back();
+                    stubs.pop_back();
+                }
+                stuck = false;
+                break;
+            }
+        }
+        if (!stuck)
+        {
+            return {links.begin(), links.end()};
+        }
+    }
+    throw std::runtime_error("random-regular: no pairing found");
+}
+
+json
+randomRegular(const TopologySpec& spec)
+{
+    const auto links = randomRegularLinks(spec.switches, spec.degree, spec.seed);
+    Builder builder(spec);
+    for (unsigned s = 0; s < spec.switches; ++s)
+    {
+        builder.addSwitch("s" + std::to_string(s));
+    }
+    for (const auto& [a, b] : links)
+    {
+        builder.link(a, b);
+    }
+    for (unsigned s = 0; s < spec.switches; ++s)
+    {
+        for (unsigned h = 0; h < spec.hostsPerLeaf; ++h)
+        {
+            builder.addHost(s);
+        }
+    }
+    return builder.finish();
+}
+
+} // namespace
+
+Kind
+parseKind(std::string_view name)
+{
+    if (name == "fat-tree")
+    {
+        return Kind::FatTree;
+    }
+    if (name == "leaf-spine")
+    {
+        return Kind::LeafSpine;
+    }
+    if (name == "random-regular")
+    {
+        return Kind::RandomRegular;
+    }
+    throw std::invalid_argument("Unknown topology kind " + std::string(name));
+}
+
+std::string
+specName(const TopologySpec& spec)
+{
+    switch (spec.kind)
+    {
+    case Kind::FatTree:
+        return "fat-tree-k" + std::to_string(spec.k);
+    case Kind::LeafSpine:
+        return "leaf-spine-" + std::to_string(spec.leaves) + "x" + std::to_string(spec.spines);
+    case Kind::RandomRegular:
+        return "random-regular-" + std::to_string(spec.switches) + "d" +
+               std::to_string(spec.degree);
+    }
+    return "unknown";
+}
+
+json
+generate(const TopologySpec& spec)
+{
+    switch (spec.kind)
+    {
+    case Kind::FatTree:
+        return fatTree(spec);
+    case Kind::LeafSpine:
+        return leafSpine(spec);
+    case Kind::RandomRegular:
+        return randomRegular(spec);
+    }
+    throw std::invalid_argument("Unknown topology kind");
+}
+
+std::vector<TopologySpec>
+standardSuite()
+{
+    std::vector<TopologySpec> suite;
+    for (unsigned k : {8, 16, 24, 32, 48})
+    {
+        TopologySpec spec;
+        spec.kind = Kind::FatTree;
+        spec.k = k;
+        suite.push_back(spec);
+    }
+
+    TopologySpec leafSpine;
+    leafSpine.kind = Kind::LeafSpine;
+    leafSpine.leaves = 128;
+    leafSpine.spines = 16;
+    leafSpine.hostsPerLeaf = 32;
+    suite.push_back(leafSpine);
+
+    TopologySpec random;
+    random.kind = Kind::RandomRegular;
+    random.switches = 1024;
+    random.degree = 8;
+    random.hostsPerLeaf = 8;
+    suite.push_back(random);
+    return suite;
+}
+
+} // namespace topology_gen
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>           // for uint64_t
+#include <nlohmann/json.hpp> // for json
+#include <string>            // for string
+#include <string_view>       // for string_view
+#include <vector>            // for vector
+
+#define TOPOGEN_LINK_BPS 100000000000ULL // switch-to-switch links
+#define TOPOGEN_HOST_BPS 25000000000ULL  // host links
+
+namespace topology_gen
+{
+
+/// The shapes generate() builds.
+enum class Kind
+{
+    FatTree,       // k-ary fat-tree: (k/2)^2 core, k pods of k/2 aggregation and k/2 edge switches
+    LeafSpine,     // every leaf linked to every spine, hosts on the leaves
+    RandomRegular, // switches of equal degree linked at random, hosts on every switch
+};
+
+struct TopologySpec
+{
+    Kind kind = Kind::FatTree;
+    unsigned k = 8;              // FatTree: even port count, k^3/4 hosts
+    unsigned leaves = 32;        // LeafSpine
+    unsigned spines = 8;         // LeafSpine
+    unsigned hostsPerLeaf = 16;  // LeafSpine, and the hosts of each RandomRegular switch
+    unsigned switches = 256;     // RandomRegular
+    unsigned degree = 8;         // RandomRegular: links of each switch to other switches
+    uint64_t seed = 1;           // RandomRegular
+    uint64_t linkBps = TOPOGEN_LINK_BPS;
+    uint64_t hostBps = TOPOGEN_HOST_BPS;
+    bool mininet = false; // add the bridge_name a MININET deployment reads of its switches
+};
+
+/// "fat-tree", "leaf-spine" or "random-regular"; throws std::invalid_argument otherwise.
+Kind parseKind(std::string_view name);
+
+/// Short name of @p spec, e.g. "fat-tree-k8", for file names and reports.
+std::string specName(const TopologySpec& spec);
+
+/**
+ * @brief A static topology of the shape of @p spec, in the schema of the StaticNetworkTopology
+ *        files under setting/ ({"nodes", "edges"}, every link listed in both directions).
+ *
+ * Switches get DPIDs from 1 and addresses from 10.0.0.1, hosts one address each from
+ * 172.16.0.1 and locally administered MACs; ports are numbered from 1 per switch in the order
+ * its links are made. Throws std::invalid_argument for a spec that has no such topology (odd
+ * k, a degree the switch count cannot take).
+ */
+nlohmann::json generate(const TopologySpec& spec);
+
+/// The fat-trees of k = 8 to 48 and a leaf-spine and a random-regular one of similar sizes.
+std::vector<TopologySpec> standardSuite();
+
+} // namespace topology_gen
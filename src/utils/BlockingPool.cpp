@@ -0,0 +1,116 @@
+#include "utils/BlockingPool.hpp"
+#include "utils/Logger.hpp"
+#include <boost/asio/post.hpp>
+
+namespace utils
+{
+
+namespace
+{
+
+void
+storeMax(std::atomic<uint64_t>& max, uint64_t value)
+{
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current &&
+           !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+} // namespace
+
+BlockingPool&
+BlockingPool::instance()
+{
+    static BlockingPool pool;
+    return pool;
+}
+
+BlockingPool::BlockingPool()
+    : m_pool(BLOCKING_POOL_THREADS)
+{
+}
+
+BlockingPool::~BlockingPool()
+{
+    m_pool.join();
+}
+
+bool
+BlockingPool::tryPost(std::function<void()> work)
+{
+    if (m_queued.fetch_add(1, std::memory_order_relaxed) >= BLOCKING_POOL_MAX_QUEUED)
+    {
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    boost::asio::post(m_pool,
+                      [this, work = std::move(work), queuedAt = std::chrono::steady_clock::now()] {
+                          run(work, queuedAt);
+                      });
+    return true;
+}
+
+void
+BlockingPool::post(std::function<void()> work)
+{
+    m_queued.fetch_add(1, std::memory_order_relaxed);
+    boost::asio::post(m_pool,
+                      [this, work = std::move(work), queuedAt = std::chrono::steady_clock::now()] {
+                          run(work, queuedAt);
+                      });
+}
+
+void
+BlockingPool::run(const std::function<void()>& work,
+                  std::chrono::steady_clock::time_point queuedAt)
+{
+    const auto start = std::chrono::steady_clock::now();
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    m_running.fetch_add(1, std::memory_order_relaxed);
+    try
+    {
+        work();
+    }
+    catch (const std::exception& e)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Blocking task threw: {}", e.what());
+    }
+    catch (...)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Blocking task threw an unknown exception");
+    }
+    const auto end = std::chrono::steady_clock::now();
+    m_running.fetch_sub(1, std::memory_order_relaxed);
+    m_completed.fetch_add(1, std::memory_order_relaxed);
+
+    const uint64_t waitNs = std::chrono::nanoseconds(start - queuedAt).count();
+    const uint64_t runNs = std::chrono::nanoseconds(end - start).count();
+    m_waitNs.fetch_add(waitNs, std::memory_order_relaxed);
+    m_runNs.fetch_add(runNs, std::memory_order_relaxed);
+    storeMax(m_maxWaitNs, waitNs);
+    storeMax(m_maxRunNs, runNs);
+}
+
+nlohmann::json
+BlockingPool::statsJson() const
+{
+    const uint64_t completed = m_completed.load(std::memory_order_relaxed);
+    auto meanMs = [completed](const std::atomic<uint64_t>& totalNs) {
+        return completed == 0 ? 0.0 : totalNs.load(std::memory_order_relaxed) / 1e6 / completed;
+    };
+    return nlohmann::json{
+        {"threads", BLOCKING_POOL_THREADS},
+        {"queued", m_queued.load(std::memory_order_relaxed)},
+        {"running", m_running.load(std::memory_order_relaxed)},
+        {"completed", completed},
+        {"rejected", m_rejected.load(std::memory_order_relaxed)},
+        {"mean_wait_ms", meanMs(m_waitNs)},
+        {"max_wait_ms", m_maxWaitNs.load(std::memory_order_relaxed) / 1e6},
+        {"mean_run_ms", meanMs(m_runNs)},
+        {"max_run_ms", m_maxRunNs.load(std::memory_order_relaxed) / 1e6}};
+}
+
+} // namespace utils
@@ -0,0 +1,87 @@
+#include "utils/CounterRates.hpp"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace utils
+{
+
+namespace
+{
+
+void
+counterRatesScalar(const uint64_t* current,
+                   const uint64_t* previous,
+                   const uint32_t* samplingRate,
+                   unsigned shift,
+                   uint64_t* out,
+                   size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = ((current[i] - previous[i]) << shift) * samplingRate[i];
+    }
+}
+
+#if defined(__x86_64__)
+// Built for AVX2 whatever the target of the rest of the build; only called where the CPU has it
+__attribute__((target("avx2"))) void
+counterRatesAvx2(const uint64_t* current,
+                 const uint64_t* previous,
+                 const uint32_t* samplingRate,
+                 unsigned shift,
+                 uint64_t* out,
+                 size_t n)
+{
+    const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current + i));
+        const __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i));
+        const __m256i rate = _mm256_cvtepu32_epi64(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(samplingRate + i)));
+        const __m256i delta = _mm256_sll_epi64(_mm256_sub_epi64(cur, prev), count);
+        // No 64x64 multiply below AVX-512: the two 32-bit halves of the delta times the
+        // 32-bit sampling rate, the high product shifted back into place
+        const __m256i low = _mm256_mul_epu32(delta, rate);
+        const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(delta, 32), rate);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+    }
+    counterRatesScalar(current + i, previous + i, samplingRate + i, shift, out + i, n - i);
+}
+#endif
+
+} // namespace
+
+bool
+counterRatesVectorized()
+{
+#if defined(__x86_64__)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+void
+counterRates(const uint64_t* current,
+             const uint64_t* previous,
+             const uint32_t* samplingRate,
+             unsigned shift,
+             uint64_t* out,
+             size_t n)
+{
+#if defined(__x86_64__)
+    if (counterRatesVectorized())
+    {
+        counterRatesAvx2(current, previous, samplingRate, shift, out, n);
+        return;
+    }
+#endif
+    counterRatesScalar(current, previous, samplingRate, shift, out, n);
+}
+
+} // namespace utils
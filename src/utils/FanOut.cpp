@@ -0,0 +1,58 @@
+#include "utils/FanOut.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+
+void
+fanOut(std::string_view name,
+       size_t count,
+       const std::function<void(size_t)>& task,
+       size_t maxConcurrency,
+       std::chrono::milliseconds slowTarget)
+{
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+        {
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                task(i);
+            }
+            catch (const std::exception& e)
+            {
+                SPDLOG_LOGGER_ERROR(Logger::instance(), "{} target {} failed: {}", name, i, e.what());
+            }
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed > slowTarget)
+            {
+                SPDLOG_LOGGER_WARN(
+                    Logger::instance(),
+                    "{} target {} took {} ms",
+                    name,
+                    i,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+            }
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    const size_t threads = std::min(count, std::max<size_t>(maxConcurrency, 1));
+    for (size_t i = 1; i < threads; ++i)
+    {
+        helpers.emplace_back(work);
+    }
+    work();
+    for (auto& helper : helpers)
+    {
+        helper.join();
+    }
+}
+
+} // namespace utils
@@ -0,0 +1,487 @@
+#include "utils/FlightRecorder.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Utils.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace utils
+{
+
+struct FlightRecorder::Ring
+{
+    std::atomic<uint64_t> head{0}; // records ever written
+    std::atomic<uint64_t> base{0}; // first record of the current thread, if the ring was reused
+    std::atomic<int32_t> tid{0};
+    std::atomic<bool> live{false};
+    char name[16] = {};
+    uint64_t mask = 0;
+    std::unique_ptr<FlightRecord[]> slots;
+};
+
+namespace
+{
+
+constexpr char IMAGE_MAGIC[8] = {'N', 'D', 'T', 'F', 'R', '0', '0', '1'};
+
+struct ImageHeader
+{
+    char magic[8];
+    uint32_t recordSize;
+    uint32_t rings;
+    int64_t monotonicNs; // of the dump, to turn record times into wall-clock times
+    int64_t realtimeNs;
+};
+
+struct RingHeader
+{
+    int32_t tid;
+    uint32_t live;
+    char name[16];
+    uint64_t records;
+};
+
+// The calling thread's ring; released to other threads when the thread exits
+struct ThreadRing
+{
+    FlightRecorder::Ring* ring = nullptr;
+    bool refused = false; // no ring to be had, recording disabled for the thread
+
+    ~ThreadRing()
+    {
+        if (ring)
+        {
+            ring->live.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadRing t_ring;
+
+int64_t
+clockNs(clockid_t clock)
+{
+    timespec ts{};
+    ::clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+ImageHeader
+imageHeader(uint32_t rings)
+{
+    ImageHeader header{};
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    header.recordSize = sizeof(FlightRecord);
+    header.rings = rings;
+    header.monotonicNs = clockNs(CLOCK_MONOTONIC);
+    header.realtimeNs = clockNs(CLOCK_REALTIME);
+    return header;
+}
+
+RingHeader
+ringHeader(const FlightRecorder::Ring& ring, uint64_t records)
+{
+    RingHeader header{};
+    header.tid = ring.tid.load(std::memory_order_relaxed);
+    header.live = ring.live.load(std::memory_order_relaxed) ? 1 : 0;
+    std::memcpy(header.name, ring.name, sizeof(header.name));
+    header.name[sizeof(header.name) - 1] = '\0';
+    header.records = records;
+    return header;
+}
+
+// Async-signal-safe
+void
+writeAll(int fd, const void* data, size_t size)
+{
+    const char* p = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+template <typename T>
+void
+append(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+constexpr const char* KIND_NAMES[] = {"sample", "classifier_miss", "flow_job", "event"};
+// In FlowOp, FlowTarget and FlowLane order
+constexpr const char* FLOW_OPS[] = {"install", "modify", "delete"};
+constexpr const char* FLOW_TARGETS[] = {"flow", "group", "meter"};
+constexpr const char* FLOW_LANES[] = {"urgent", "normal", "bulk"};
+
+template <size_t N>
+nlohmann::json
+nameOf(const char* const (&names)[N], unsigned index)
+{
+    return index < N ? nlohmann::json(names[index]) : nlohmann::json(index);
+}
+
+nlohmann::json
+recordToJson(const FlightRecord& r, int64_t realtimeOffsetNs)
+{
+    nlohmann::json out{{"time_ns", r.timeNs + realtimeOffsetNs},
+                       {"kind", nameOf(KIND_NAMES, static_cast<unsigned>(r.kind))}};
+    const uint64_t* w = r.words;
+    switch (r.kind)
+    {
+    case FlightRecordKind::Sample:
+        out["agent"] = ipToString(r.value);
+        if (r.code == 0)
+        {
+            out["sample"] = "flow";
+            out["src_ip"] = ipToString(static_cast<uint32_t>(w[0] >> 32));
+            out["dst_ip"] = ipToString(static_cast<uint32_t>(w[0]));
+            out["src_port"] = static_cast<uint16_t>(w[1] >> 16);
+            out["dst_port"] = static_cast<uint16_t>(w[1]);
+            out["protocol"] = r.small;
+            out["input_port"] = static_cast<uint32_t>(w[2] >> 32);
+            out["output_port"] = static_cast<uint32_t>(w[2]);
+            out["frame_length"] = w[3];
+        }
+        else
+        {
+            out["sample"] = "counter";
+            out["interface_index"] = w[0];
+            out["input_octets"] = w[1];
+            out["output_octets"] = w[2];
+            out["interface_status"] = w[3];
+        }
+        break;
+    case FlightRecordKind::ClassifierMiss:
+        out["reason"] = r.code == 0 ? "no_switch" : "no_rule";
+        out["dpid"] = w[0];
+        out["table_id"] = r.value;
+        out["in_port"] = w[3];
+        out["protocol"] = r.small;
+        out["src_ip"] = ipToString(htonl(static_cast<uint32_t>(w[1] >> 32)));
+        out["dst_ip"] = ipToString(htonl(static_cast<uint32_t>(w[1])));
+        out["src_port"] = static_cast<uint16_t>(w[2] >> 16);
+        out["dst_port"] = static_cast<uint16_t>(w[2]);
+        break;
+    case FlightRecordKind::FlowJob:
+        out["dpid"] = w[0];
+        out["op"] = nameOf(FLOW_OPS, r.code);
+        out["target"] = nameOf(FLOW_TARGETS, r.small >> 8);
+        out["lane"] = nameOf(FLOW_LANES, r.small & 0xFF);
+        out["priority"] = static_cast<int64_t>(w[1]);
+        out["sent"] = r.value != 0;
+        break;
+    case FlightRecordKind::Event:
+        // The EventType's number; EventBus users name it with eventTypeName()
+        out["event_type"] = r.code;
+        if (r.small != 0)
+        {
+            out["phase"] = "handled";
+            out["handler_ns"] = w[0];
+        }
+        else
+        {
+            out["phase"] = "emitted";
+        }
+        break;
+    }
+    return out;
+}
+
+} // namespace
+
+FlightRecorder&
+FlightRecorder::instance()
+{
+    // Never destroyed: threads record until they exit, some after static destruction began
+    static FlightRecorder* recorder = new FlightRecorder();
+    return *recorder;
+}
+
+void
+FlightRecorder::configure(size_t recordsPerThread)
+{
+    size_t capacity = 0;
+    if (recordsPerThread > 0)
+    {
+        capacity = 2;
+        while (capacity < recordsPerThread)
+        {
+            capacity <<= 1;
+        }
+    }
+    m_recordsPerThread.store(capacity, std::memory_order_relaxed);
+}
+
+bool
+FlightRecorder::enabled() const
+{
+    return m_recordsPerThread.load(std::memory_order_relaxed) > 0;
+}
+
+void
+FlightRecorder::record(FlightRecordKind kind,
+                       uint8_t code,
+                       uint16_t small,
+                       uint32_t value,
+                       uint64_t w0,
+                       uint64_t w1,
+                       uint64_t w2,
+                       uint64_t w3)
+{
+    Ring* ring = t_ring.ring;
+    if (ring == nullptr)
+    {
+        if (t_ring.refused || !enabled() || (ring = attach()) == nullptr)
+        {
+            return;
+        }
+    }
+
+    // Only this thread writes the ring; dump() checks head again after copying, so a slot
+    // it read while being rewritten is dropped
+    const uint64_t pos = ring->head.load(std::memory_order_relaxed);
+    FlightRecord& r = ring->slots[pos & ring->mask];
+    r.timeNs = clockNs(CLOCK_MONOTONIC);
+    r.kind = kind;
+    r.code = code;
+    r.small = small;
+    r.value = value;
+    r.words[0] = w0;
+    r.words[1] = w1;
+    r.words[2] = w2;
+    r.words[3] = w3;
+    ring->head.store(pos + 1, std::memory_order_release);
+}
+
+FlightRecorder::Ring*
+FlightRecorder::attach()
+{
+    std::lock_guard lock(m_attachMutex);
+    Ring* ring = nullptr;
+    const size_t count = m_ringCount.load(std::memory_order_relaxed);
+    if (count < FLIGHT_RECORDER_MAX_THREADS)
+    {
+        auto owned = std::make_unique<Ring>();
+        const size_t capacity = m_recordsPerThread.load(std::memory_order_relaxed);
+        owned->slots = std::make_unique<FlightRecord[]>(capacity);
+        owned->mask = capacity - 1;
+        ring = owned.get();
+        m_ringStorage.push_back(std::move(owned));
+    }
+    else
+    {
+        for (size_t i = 0; i < count && ring == nullptr; ++i)
+        {
+            Ring* candidate = m_rings[i].load(std::memory_order_relaxed);
+            if (!candidate->live.load(std::memory_order_acquire))
+            {
+                ring = candidate;
+                // The exited thread's records are no longer listed, rather than under our tid
+                ring->base.store(ring->head.load(std::memory_order_relaxed),
+                                 std::memory_order_release);
+            }
+        }
+        if (ring == nullptr)
+        {
+            t_ring.refused = true;
+            return nullptr;
+        }
+    }
+
+    ring->tid.store(static_cast<int32_t>(::syscall(SYS_gettid)), std::memory_order_relaxed);
+    ::pthread_getname_np(::pthread_self(), ring->name, sizeof(ring->name));
+    ring->live.store(true, std::memory_order_release);
+    if (count < FLIGHT_RECORDER_MAX_THREADS)
+    {
+        m_rings[count].store(ring, std::memory_order_release);
+        m_ringCount.store(count + 1, std::memory_order_release);
+    }
+    t_ring.ring = ring;
+    return ring;
+}
+
+std::string
+FlightRecorder::dump() const
+{
+    const size_t count = m_ringCount.load(std::memory_order_acquire);
+    std::string out;
+    append(out, imageHeader(static_cast<uint32_t>(count)));
+
+    std::vector<FlightRecord> copy;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Ring& ring = *m_rings[i].load(std::memory_order_acquire);
+        const uint64_t capacity = ring.mask + 1;
+        const uint64_t head = ring.head.load(std::memory_order_acquire);
+        const uint64_t first = std::max(ring.base.load(std::memory_order_acquire),
+                                        head > capacity ? head - capacity : 0);
+        copy.resize(head - first);
+        for (uint64_t pos = first; pos < head; ++pos)
+        {
+            copy[pos - first] = ring.slots[pos & ring.mask];
+        }
+        // Records the thread overwrote meanwhile, and the one it may be writing, are dropped
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t after = ring.head.load(std::memory_order_relaxed);
+        const uint64_t valid = after >= capacity ? after - capacity + 1 : 0;
+        const size_t skip = valid > first ? std::min<size_t>(valid - first, copy.size()) : 0;
+
+        append(out, ringHeader(ring, copy.size() - skip));
+        out.append(reinterpret_cast<const char*>(copy.data() + skip),
+                   (copy.size() - skip) * sizeof(FlightRecord));
+    }
+    return out;
+}
+
+void
+FlightRecorder::writeImage(int fd) const
+{
+    const size_t count = m_ringCount.load(std::memory_order_acquire);
+    const ImageHeader header = imageHeader(static_cast<uint32_t>(count));
+    writeAll(fd, &header, sizeof(header));
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Ring& ring = *m_rings[i].load(std::memory_order_acquire);
+        const uint64_t capacity = ring.mask + 1;
+        const uint64_t head = ring.head.load(std::memory_order_acquire);
+        const uint64_t first = std::max(ring.base.load(std::memory_order_acquire),
+                                        head > capacity ? head - capacity : 0);
+        const RingHeader rh = ringHeader(ring, head - first);
+        writeAll(fd, &rh, sizeof(rh));
+
+        // Oldest first: from the oldest slot to the ring's end, then from its start
+        const uint64_t start = first & ring.mask;
+        const uint64_t toEnd = std::min(head - first, capacity - start);
+        writeAll(fd, ring.slots.get() + start, toEnd * sizeof(FlightRecord));
+        writeAll(fd, ring.slots.get(), (head - first - toEnd) * sizeof(FlightRecord));
+    }
+}
+
+void
+FlightRecorder::onCrash(int signal)
+{
+    static std::atomic<bool> dumped{false};
+    if (!dumped.exchange(true))
+    {
+        const FlightRecorder& recorder = instance();
+        const int fd = ::open(recorder.m_crashPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd >= 0)
+        {
+            recorder.writeImage(fd);
+            ::close(fd);
+        }
+    }
+    // The handler was reset on entry: the signal now takes its default action
+    ::raise(signal);
+}
+
+void
+FlightRecorder::installCrashHandler(const std::string& path)
+{
+    const size_t length = std::min(path.size(), sizeof(m_crashPath) - 1);
+    std::memcpy(m_crashPath, path.data(), length);
+    m_crashPath[length] = '\0';
+
+    struct sigaction action{};
+    action.sa_handler = &FlightRecorder::onCrash;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESETHAND | SA_NODEFER;
+    for (int signal : {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT})
+    {
+        ::sigaction(signal, &action, nullptr);
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Flight recorder dumps to {} on a crash", m_crashPath);
+}
+
+nlohmann::json
+FlightRecorder::decode(std::string_view image, std::optional<FlightRecordKind> kind, size_t limit)
+{
+    size_t offset = 0;
+    auto take = [&](void* out, size_t size) {
+        if (image.size() - offset < size)
+        {
+            throw std::invalid_argument("Flight recorder image is truncated");
+        }
+        std::memcpy(out, image.data() + offset, size);
+        offset += size;
+    };
+
+    ImageHeader header{};
+    take(&header, sizeof(header));
+    if (std::memcmp(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+        header.recordSize != sizeof(FlightRecord))
+    {
+        throw std::invalid_argument("Not a flight recorder image of this version");
+    }
+    const int64_t realtimeOffsetNs = header.realtimeNs - header.monotonicNs;
+
+    nlohmann::json threads = nlohmann::json::array();
+    for (uint32_t i = 0; i < header.rings; ++i)
+    {
+        RingHeader rh{};
+        take(&rh, sizeof(rh));
+        if ((image.size() - offset) / sizeof(FlightRecord) < rh.records)
+        {
+            throw std::invalid_argument("Flight recorder image is truncated");
+        }
+        const char* records = image.data() + offset;
+        offset += rh.records * sizeof(FlightRecord);
+
+        // The newest @p limit records of the kind, listed oldest first
+        std::vector<FlightRecord> kept;
+        for (uint64_t j = rh.records; j > 0 && kept.size() < limit; --j)
+        {
+            FlightRecord r;
+            std::memcpy(&r, records + (j - 1) * sizeof(FlightRecord), sizeof(r));
+            if (!kind || r.kind == *kind)
+            {
+                kept.push_back(r);
+            }
+        }
+        nlohmann::json list = nlohmann::json::array();
+        for (auto it = kept.rbegin(); it != kept.rend(); ++it)
+        {
+            list.push_back(recordToJson(*it, realtimeOffsetNs));
+        }
+        rh.name[sizeof(rh.name) - 1] = '\0';
+        threads.push_back({{"tid", rh.tid},
+                           {"name", std::string(rh.name)},
+                           {"live", rh.live != 0},
+                           {"records", std::move(list)}});
+    }
+    return {{"dumped_at_ns", header.realtimeNs}, {"threads", std::move(threads)}};
+}
+
+std::optional<FlightRecordKind>
+FlightRecorder::kindFromName(std::string_view name)
+{
+    for (size_t i = 0; i < std::size(KIND_NAMES); ++i)
+    {
+        if (name == KIND_NAMES[i])
+        {
+            return static_cast<FlightRecordKind>(i);
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace utils
@@ -0,0 +1,290 @@
+#include "utils/HistoryWriter.hpp"
+#include "utils/Logger.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace utils
+{
+
+namespace
+{
+
+bool
+writeAll(int fd, const std::string& data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        const ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+HistoryFile::HistoryFile(int fd, std::string path)
+    : m_fd(fd),
+      m_path(std::move(path))
+{
+}
+
+HistoryFile::~HistoryFile()
+{
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+HistoryWriter&
+HistoryWriter::instance()
+{
+    static HistoryWriter writer;
+    return writer;
+}
+
+HistoryWriter::HistoryWriter()
+    : m_lastSync(std::chrono::steady_clock::now()),
+      m_thread([this] { run(); })
+{
+}
+
+HistoryWriter::~HistoryWriter()
+{
+    stop();
+}
+
+bool
+HistoryWriter::submit(const std::shared_ptr<HistoryFile>& file, std::string bytes)
+{
+    if (file->failed() || !m_enabled.load(std::memory_order_relaxed))
+    {
+        refuse(*file);
+        return false;
+    }
+    bool due = false;
+    {
+        std::lock_guard lock(m_mutex);
+        if (!m_running || m_queuedBytes + bytes.size() > HISTORY_WRITER_QUEUE_BYTES)
+        {
+            refuse(*file);
+            return false;
+        }
+        m_queuedBytes += bytes.size();
+        ++m_submittedSeq;
+        m_queue.push_back({file, std::move(bytes)});
+        due = m_queuedBytes >= HISTORY_WRITER_COMMIT_BYTES;
+    }
+    if (due)
+    {
+        m_wakeCv.notify_one();
+    }
+    return true;
+}
+
+void
+HistoryWriter::refuse(HistoryFile& file)
+{
+    m_refused.fetch_add(1, std::memory_order_relaxed);
+    if (!file.m_failed.exchange(true, std::memory_order_acq_rel) &&
+        m_enabled.load(std::memory_order_relaxed))
+    {
+        SPDLOG_LOGGER_WARN(
+            Logger::instance(), "HistoryWriter: record for {} refused, file given up", file.m_path);
+    }
+}
+
+void
+HistoryWriter::flush()
+{
+    std::unique_lock lock(m_mutex);
+    const uint64_t target = m_submittedSeq;
+    if (m_syncedSeq >= target)
+    {
+        return;
+    }
+    m_flushWanted = true;
+    m_wakeCv.notify_one();
+    m_doneCv.wait(lock, [this, target] { return m_syncedSeq >= target; });
+}
+
+void
+HistoryWriter::stop()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeCv.notify_one();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void
+HistoryWriter::setEnabled(bool enable)
+{
+    m_enabled.store(enable, std::memory_order_relaxed);
+}
+
+void
+HistoryWriter::run()
+{
+    ThreadRegistry::Scope thread("history-writer");
+    std::vector<Record> records;
+    std::unique_lock lock(m_mutex);
+    for (;;)
+    {
+        m_wakeCv.wait_for(lock, std::chrono::milliseconds(HISTORY_WRITER_COMMIT_MS), [this] {
+            return !m_running || m_flushWanted ||
+                   m_queuedBytes >= HISTORY_WRITER_COMMIT_BYTES;
+        });
+        records.swap(m_queue);
+        m_queuedBytes = 0;
+        const uint64_t seq = m_submittedSeq;
+        const bool running = m_running;
+        const bool flushing = m_flushWanted || !running;
+        m_flushWanted = false;
+        lock.unlock();
+
+        const auto start = std::chrono::steady_clock::now();
+        if (!records.empty())
+        {
+            commit(records);
+            records.clear();
+        }
+        sync(flushing);
+        const uint64_t ns = std::chrono::nanoseconds(std::chrono::steady_clock::now() - start)
+                                .count();
+        if (ns > m_maxCommitNs.load(std::memory_order_relaxed))
+        {
+            m_maxCommitNs.store(ns, std::memory_order_relaxed);
+        }
+
+        lock.lock();
+        if (flushing)
+        {
+            m_syncedSeq = seq;
+            m_doneCv.notify_all();
+        }
+        if (!running)
+        {
+            return;
+        }
+    }
+}
+
+void
+HistoryWriter::commit(std::vector<Record>& records)
+{
+    // The records of each file, concatenated in submission order; files rarely number more
+    // than a handful, so they are looked up linearly
+    std::vector<std::pair<HistoryFile*, std::string>> writes;
+    for (Record& record : records)
+    {
+        if (record.file->failed())
+        {
+            continue;
+        }
+        auto it = std::find_if(writes.begin(), writes.end(), [&](const auto& write) {
+            return write.first == record.file.get();
+        });
+        if (it == writes.end())
+        {
+            writes.emplace_back(record.file.get(), std::move(record.bytes));
+        }
+        else
+        {
+            it->second += record.bytes;
+        }
+    }
+
+    for (auto& [file, bytes] : writes)
+    {
+        if (!writeAll(file->m_fd, bytes))
+        {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+            file->m_failed.store(true, std::memory_order_release);
+            SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                "HistoryWriter: write to {} failed: {}",
+                                file->m_path,
+                                strerror(errno));
+            continue;
+        }
+        m_writes.fetch_add(1, std::memory_order_relaxed);
+        m_bytes.fetch_add(bytes.size(), std::memory_order_relaxed);
+        if (!file->m_dirty)
+        {
+            file->m_dirty = true;
+            // Keeps the descriptor open until it is synced
+            auto owner = std::find_if(records.begin(), records.end(), [file](const Record& r) {
+                return r.file.get() == file;
+            });
+            m_unsynced.push_back(owner->file);
+        }
+    }
+    m_commits.fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+HistoryWriter::sync(bool all)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (!all && now - m_lastSync < std::chrono::milliseconds(HISTORY_WRITER_SYNC_MS))
+    {
+        return;
+    }
+    m_lastSync = now;
+    for (const std::shared_ptr<HistoryFile>& file : m_unsynced)
+    {
+        file->m_dirty = false;
+        if (::fdatasync(file->m_fd) != 0)
+        {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "HistoryWriter: fdatasync of {} failed: {}",
+                               file->m_path,
+                               strerror(errno));
+            continue;
+        }
+        m_syncs.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_unsynced.clear();
+}
+
+nlohmann::json
+HistoryWriter::statsJson() const
+{
+    size_t queuedBytes = 0;
+    uint64_t submitted = 0;
+    {
+        std::lock_guard lock(m_mutex);
+        queuedBytes = m_queuedBytes;
+        submitted = m_submittedSeq;
+    }
+    return nlohmann::json{{"enabled", enabled()},
+                          {"queued_bytes", queuedBytes},
+                          {"submitted", submitted},
+                          {"refused", m_refused.load(std::memory_order_relaxed)},
+                          {"commits", m_commits.load(std::memory_order_relaxed)},
+                          {"writes", m_writes.load(std::memory_order_relaxed)},
+                          {"bytes", m_bytes.load(std::memory_order_relaxed)},
+                          {"syncs", m_syncs.load(std::memory_order_relaxed)},
+                          {"errors", m_errors.load(std::memory_order_relaxed)},
+                          {"max_commit_ms", m_maxCommitNs.load(std::memory_order_relaxed) / 1e6}};
+}
+
+} // namespace utils
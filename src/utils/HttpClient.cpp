@@ -0,0 +1,590 @@
+#include "utils/HttpClient.hpp"
+#include "utils/Logger.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+#include <boost/url/parse.hpp>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+namespace utils
+{
+
+namespace
+{
+
+// Host, port and Beast request for @p url; throws std::invalid_argument for other than http://
+struct PreparedRequest
+{
+    std::string host;
+    std::string port;
+    http::request<http::string_body> request;
+};
+
+PreparedRequest
+prepareRequest(http::verb method,
+               const std::string& url,
+               std::string body,
+               const HttpRequestOptions& options)
+{
+    auto parsed = boost::urls::parse_uri(url);
+    if (!parsed || parsed->scheme() != "http" || parsed->host().empty())
+    {
+        throw std::invalid_argument("Unsupported HTTP URL: " + url);
+    }
+    PreparedRequest out;
+    out.host = parsed->host();
+    out.port = parsed->port().empty() ? "80" : std::string(parsed->port());
+    std::string target = parsed->encoded_path().empty() ? "/" : std::string(parsed->encoded_path());
+    if (parsed->has_query())
+    {
+        target += "?" + std::string(parsed->encoded_query());
+    }
+
+    http::request<http::string_body>& request = out.request;
+    request.method(method);
+    request.target(target);
+    request.version(11);
+    request.set(http::field::host, parsed->port().empty() ? out.host : out.host + ":" + out.port);
+    request.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    if (!body.empty())
+    {
+        request.set(http::field::content_type, options.contentType);
+    }
+    for (const auto& [name, value] : options.headers)
+    {
+        request.set(name, value);
+    }
+    request.keep_alive(true);
+    request.body() = std::move(body);
+    request.prepare_payload();
+    return out;
+}
+
+} // namespace
+
+/**
+ * @brief Requests to one host sent on one connection: waits for a connection slot, connects
+ *        or reuses an idle connection, then writes the requests while reading the responses.
+ *
+ * A single request is retried on a new connection after a transport error. Handlers run on
+ * the connection's strand, so the state needs no lock.
+ */
+class HttpClient::Operation : public std::enable_shared_from_this<Operation>
+{
+  public:
+    using Done = std::function<void(std::vector<HttpResponse>)>;
+
+    Operation(HttpClient& client,
+              std::string host,
+              std::string port,
+              std::vector<std::string> urls,
+              std::vector<http::request<http::string_body>> requests,
+              const HttpRequestOptions& options,
+              Done done)
+        : m_client(client),
+          m_host(std::move(host)),
+          m_port(std::move(port)),
+          m_hostKey(m_host + ":" + m_port),
+          m_urls(std::move(urls)),
+          m_requests(std::move(requests)),
+          m_timeout(options.timeout),
+          m_attemptsLeft(m_requests.size() == 1 ? options.retries : 0),
+          m_done(std::move(done)),
+          m_resolver(client.m_ioc)
+    {
+    }
+
+    const std::string& hostKey() const
+    {
+        return m_hostKey;
+    }
+
+    // Start on a slot of the host, with an idle connection if @p stream is set
+    void run(std::unique_ptr<beast::tcp_stream> stream)
+    {
+        m_stream = std::move(stream);
+        m_reused = m_stream != nullptr;
+        if (m_reused)
+        {
+            m_client.m_connectionsReused.fetch_add(1, std::memory_order_relaxed);
+            // Onto the connection's strand before touching it
+            asio::dispatch(m_stream->get_executor(),
+                           beast::bind_front_handler(&Operation::send, shared_from_this()));
+        }
+        else
+        {
+            connect();
+        }
+    }
+
+  private:
+    void connect()
+    {
+        m_resolver.async_resolve(m_host,
+                                 m_port,
+                                 beast::bind_front_handler(&Operation::onResolve,
+                                                           shared_from_this()));
+    }
+
+    void onResolve(beast::error_code ec, tcp::resolver::results_type results)
+    {
+        if (ec)
+        {
+            return fail(ec);
+        }
+        m_client.m_connectionsOpened.fetch_add(1, std::memory_order_relaxed);
+        m_stream = std::make_unique<beast::tcp_stream>(asio::make_strand(m_client.m_ioc));
+        m_stream->expires_after(m_timeout);
+        m_stream->async_connect(results,
+                                beast::bind_front_handler(&Operation::onConnect,
+                                                          shared_from_this()));
+    }
+
+    void onConnect(beast::error_code ec, tcp::endpoint)
+    {
+        if (ec)
+        {
+            return fail(ec);
+        }
+        send();
+    }
+
+    // Writing and reading run side by side, so a long pipeline can't fill both directions
+    void send()
+    {
+        m_buffer.clear();
+        m_written = 0;
+        m_read = 0;
+        m_error = {};
+        m_serverCloses = false;
+        m_chains = 2;
+        m_stream->expires_after(m_timeout);
+        writeNext();
+        readNext();
+    }
+
+    void writeNext()
+    {
+        if (m_written == m_requests.size())
+        {
+            return chainDone();
+        }
+        http::async_write(*m_stream,
+                          m_requests[m_written],
+                          beast::bind_front_handler(&Operation::onWrite, shared_from_this()));
+    }
+
+    void onWrite(beast::error_code ec, size_t)
+    {
+        if (ec)
+        {
+            // The responses still expected will not come
+            stop(ec);
+            return chainDone();
+        }
+        ++m_written;
+        writeNext();
+    }
+
+    void readNext()
+    {
+        if (m_read == m_requests.size())
+        {
+            return chainDone();
+        }
+        m_parser.emplace();
+        m_parser->body_limit(HTTP_CLIENT_MAX_BODY_BYTES);
+        http::async_read(*m_stream,
+                         m_buffer,
+                         *m_parser,
+                         beast::bind_front_handler(&Operation::onRead, shared_from_this()));
+    }
+
+    void onRead(beast::error_code ec, size_t)
+    {
+        if (ec)
+        {
+            stop(ec);
+            return chainDone();
+        }
+        http::response<http::string_body> response = m_parser->release();
+        m_responses.push_back(HttpResponse{response.result_int(), std::move(response.body()), {}});
+        ++m_read;
+        if (!response.keep_alive())
+        {
+            m_serverCloses = true;
+            if (m_read < m_requests.size())
+            {
+                stop(http::error::end_of_stream);
+            }
+            return chainDone();
+        }
+        m_stream->expires_after(m_timeout);
+        readNext();
+    }
+
+    // Record the first error and abort the other direction
+    void stop(beast::error_code ec)
+    {
+        if (!m_error)
+        {
+            m_error = ec;
+            m_stream->close();
+        }
+    }
+
+    void chainDone()
+    {
+        if (--m_chains > 0)
+        {
+            return;
+        }
+        if (m_error)
+        {
+            return fail(m_error);
+        }
+        if (m_serverCloses)
+        {
+            m_stream.reset();
+        }
+        else
+        {
+            m_stream->expires_never();
+        }
+        finish();
+    }
+
+    void fail(beast::error_code ec)
+    {
+        m_stream.reset();
+        if (m_read == 0)
+        {
+            // A kept-alive connection the server closed meanwhile; the slot stays ours
+            if (m_reused && ec != beast::error::timeout)
+            {
+                m_reused = false;
+                m_client.m_staleConnections.fetch_add(1, std::memory_order_relaxed);
+                return connect();
+            }
+            if (m_attemptsLeft > 0)
+            {
+                --m_attemptsLeft;
+                m_reused = false;
+                m_client.m_retries.fetch_add(1, std::memory_order_relaxed);
+                return connect();
+            }
+        }
+        const size_t failed = m_requests.size() - m_responses.size();
+        m_client.m_failures.fetch_add(failed, std::memory_order_relaxed);
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "HTTP {} {} failed: {}{}",
+                           std::string(http::to_string(m_requests[m_responses.size()].method())),
+                           m_urls[m_responses.size()],
+                           ec.message(),
+                           failed > 1 ? fmt::format(" (and {} pipelined after it)", failed - 1)
+                                      : std::string());
+        while (m_responses.size() < m_requests.size())
+        {
+            m_responses.push_back(HttpResponse{0, {}, ec});
+        }
+        finish();
+    }
+
+    void finish()
+    {
+        m_client.release(m_hostKey, std::move(m_stream));
+        m_done(std::move(m_responses));
+    }
+
+    HttpClient& m_client;
+    std::string m_host;
+    std::string m_port;
+    std::string m_hostKey;
+    std::vector<std::string> m_urls;
+    std::vector<http::request<http::string_body>> m_requests;
+    std::chrono::milliseconds m_timeout;
+    unsigned m_attemptsLeft;
+    Done m_done;
+
+    tcp::resolver m_resolver;
+    std::unique_ptr<beast::tcp_stream> m_stream;
+    bool m_reused = false;
+    beast::flat_buffer m_buffer;
+    std::optional<http::response_parser<http::string_body>> m_parser;
+    std::vector<HttpResponse> m_responses;
+    size_t m_written = 0;
+    size_t m_read = 0;
+    int m_chains = 0;
+    bool m_serverCloses = false;
+    beast::error_code m_error;
+};
+
+HttpClient&
+HttpClient::instance()
+{
+    static HttpClient client;
+    return client;
+}
+
+HttpClient::HttpClient()
+    : m_ioc(HTTP_CLIENT_THREADS),
+      m_work(asio::make_work_guard(m_ioc))
+{
+    for (int i = 0; i < HTTP_CLIENT_THREADS; ++i)
+    {
+        m_threads.emplace_back([this, i] {
+            ThreadRegistry::Scope thread("http-client-" + std::to_string(i));
+            for (;;)
+            {
+                try
+                {
+                    m_ioc.run();
+                    return;
+                }
+                catch (const std::exception& e)
+                {
+                    SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                        "HttpClient callback threw: {}",
+                                        e.what());
+                }
+            }
+        });
+    }
+}
+
+HttpClient::~HttpClient()
+{
+    m_work.reset();
+    m_ioc.stop();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void
+HttpClient::asyncRequest(http::verb method,
+                         const std::string& url,
+                         std::string body,
+                         Callback done,
+                         const HttpRequestOptions& options)
+{
+    PreparedRequest prepared = prepareRequest(method, url, std::move(body), options);
+    std::vector<http::request<http::string_body>> requests;
+    requests.push_back(std::move(prepared.request));
+
+    m_requests.fetch_add(1, std::memory_order_relaxed);
+    acquire(std::make_shared<Operation>(
+        *this,
+        std::move(prepared.host),
+        std::move(prepared.port),
+        std::vector<std::string>{url},
+        std::move(requests),
+        options,
+        [done = std::move(done)](std::vector<HttpResponse> responses) {
+            done(std::move(responses.front()));
+        }));
+}
+
+std::future<HttpResponse>
+HttpClient::asyncRequest(http::verb method,
+                         const std::string& url,
+                         std::string body,
+                         const HttpRequestOptions& options)
+{
+    auto promise = std::make_shared<std::promise<HttpResponse>>();
+    std::future<HttpResponse> future = promise->get_future();
+    asyncRequest(
+        method,
+        url,
+        std::move(body),
+        [promise](HttpResponse response) { promise->set_value(std::move(response)); },
+        options);
+    return future;
+}
+
+HttpResponse
+HttpClient::request(http::verb method,
+                    const std::string& url,
+                    std::string body,
+                    const HttpRequestOptions& options)
+{
+    // The callback waited for would have to run on this very thread
+    if (m_ioc.get_executor().running_in_this_thread())
+    {
+        throw std::logic_error("HttpClient::request() called from an HttpClient callback");
+    }
+    return asyncRequest(method, url, std::move(body), options).get();
+}
+
+void
+HttpClient::asyncPipeline(std::vector<HttpRequest> requests,
+                          std::function<void(std::vector<HttpResponse>)> done,
+                          const HttpRequestOptions& options)
+{
+    if (requests.empty())
+    {
+        asio::post(m_ioc, [done = std::move(done)] { done({}); });
+        return;
+    }
+    std::string host;
+    std::string port;
+    std::vector<std::string> urls;
+    std::vector<http::request<http::string_body>> prepared;
+    urls.reserve(requests.size());
+    prepared.reserve(requests.size());
+    for (auto& request : requests)
+    {
+        PreparedRequest one =
+            prepareRequest(request.method, request.url, std::move(request.body), options);
+        if (prepared.empty())
+        {
+            host = std::move(one.host);
+            port = std::move(one.port);
+        }
+        else if (one.host != host || one.port != port)
+        {
+            throw std::invalid_argument("Pipelined requests go to different hosts: " +
+                                        request.url);
+        }
+        urls.push_back(std::move(request.url));
+        prepared.push_back(std::move(one.request));
+    }
+
+    m_requests.fetch_add(prepared.size(), std::memory_order_relaxed);
+    m_pipelinedRequests.fetch_add(prepared.size(), std::memory_order_relaxed);
+    acquire(std::make_shared<Operation>(*this,
+                                        std::move(host),
+                                        std::move(port),
+                                        std::move(urls),
+                                        std::move(prepared),
+                                        options,
+                                        std::move(done)));
+}
+
+std::vector<HttpResponse>
+HttpClient::pipeline(std::vector<HttpRequest> requests, const HttpRequestOptions& options)
+{
+    if (m_ioc.get_executor().running_in_this_thread())
+    {
+        throw std::logic_error("HttpClient::pipeline() called from an HttpClient callback");
+    }
+    auto promise = std::make_shared<std::promise<std::vector<HttpResponse>>>();
+    std::future<std::vector<HttpResponse>> future = promise->get_future();
+    asyncPipeline(
+        std::move(requests),
+        [promise](std::vector<HttpResponse> responses) {
+            promise->set_value(std::move(responses));
+        },
+        options);
+    return future.get();
+}
+
+HttpResponse
+HttpClient::get(const std::string& url, const HttpRequestOptions& options)
+{
+    return request(http::verb::get, url, {}, options);
+}
+
+HttpResponse
+HttpClient::post(const std::string& url, std::string body, const HttpRequestOptions& options)
+{
+    return request(http::verb::post, url, std::move(body), options);
+}
+
+nlohmann::json
+HttpClient::statsJson() const
+{
+    size_t open = 0;
+    size_t idle = 0;
+    size_t queued = 0;
+    {
+        std::lock_guard lock(m_poolMutex);
+        for (const auto& [key, pool] : m_hosts)
+        {
+            open += pool.open;
+            idle += pool.idle.size();
+            queued += pool.waiting.size();
+        }
+    }
+    return nlohmann::json{
+        {"requests", m_requests.load(std::memory_order_relaxed)},
+        {"pipelined_requests", m_pipelinedRequests.load(std::memory_order_relaxed)},
+        {"failures", m_failures.load(std::memory_order_relaxed)},
+        {"retries", m_retries.load(std::memory_order_relaxed)},
+        {"connections_opened", m_connectionsOpened.load(std::memory_order_relaxed)},
+        {"connections_reused", m_connectionsReused.load(std::memory_order_relaxed)},
+        {"stale_connections", m_staleConnections.load(std::memory_order_relaxed)},
+        {"open_connections", open},
+        {"idle_connections", idle},
+        {"queued_requests", queued}};
+}
+
+void
+HttpClient::acquire(const std::shared_ptr<Operation>& op)
+{
+    std::unique_ptr<beast::tcp_stream> stream;
+    {
+        std::lock_guard lock(m_poolMutex);
+        HostPool& pool = m_hosts[op->hostKey()];
+        if (!pool.idle.empty())
+        {
+            stream = std::move(pool.idle.back());
+            pool.idle.pop_back();
+        }
+        else if (pool.open < HTTP_CLIENT_MAX_CONNECTIONS_PER_HOST)
+        {
+            ++pool.open;
+        }
+        else
+        {
+            pool.waiting.push_back(op);
+            return;
+        }
+    }
+    // Not run inline: a synchronous caller may be holding locks its callback needs
+    asio::post(m_ioc, [op, stream = std::move(stream)]() mutable { op->run(std::move(stream)); });
+}
+
+void
+HttpClient::release(const std::string& hostKey, std::unique_ptr<beast::tcp_stream> stream)
+{
+    std::shared_ptr<Operation> next;
+    {
+        std::lock_guard lock(m_poolMutex);
+        HostPool& pool = m_hosts[hostKey];
+        if (pool.waiting.empty())
+        {
+            if (stream)
+            {
+                pool.idle.push_back(std::move(stream));
+            }
+            else
+            {
+                --pool.open;
+            }
+            return;
+        }
+        next = std::move(pool.waiting.front());
+        pool.waiting.pop_front();
+    }
+    // The slot passes to the next request, with the connection if it stays open
+    asio::post(m_ioc,
+               [next, stream = std::move(stream)]() mutable { next->run(std::move(stream)); });
+}
+
+} // namespace utils
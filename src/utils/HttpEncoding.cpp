@@ -0,0 +1,295 @@
+#include "utils/HttpEncoding.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
+#ifdef NDT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace utils
+{
+
+namespace
+{
+
+std::string_view
+trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+/**
+ * @brief Call @p fn(token) for each entry of a comma separated header value, skipping the
+ *        ones whose "q" parameter is 0. Tokens are lower-cased; @p fn returns true to stop.
+ */
+template <typename Fn>
+void
+forEachAccepted(std::string_view header, Fn fn)
+{
+    while (!header.empty())
+    {
+        size_t comma = header.find(',');
+        std::string_view entry = header.substr(0, comma);
+        header.remove_prefix(comma == std::string_view::npos ? header.size() : comma + 1);
+
+        size_t semi = entry.find(';');
+        std::string token(trim(entry.substr(0, semi)));
+        bool refused = false;
+        while (semi != std::string_view::npos)
+        {
+            entry.remove_prefix(semi + 1);
+            semi = entry.find(';');
+            std::string_view param = trim(entry.substr(0, semi));
+            if (param.starts_with("q=") || param.starts_with("Q="))
+            {
+                std::string_view q = param.substr(2);
+                refused = q.find_first_not_of("0.") == std::string_view::npos;
+            }
+        }
+        for (char& c : token)
+        {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        if (!refused && !token.empty() && fn(token))
+        {
+            return;
+        }
+    }
+}
+
+std::string
+gzipCompress(std::string_view in)
+{
+    z_stream zs{};
+    // 15 window bits + 16 selects the gzip wrapper instead of zlib's
+    if (deflateInit2(&zs, HTTP_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        throw std::runtime_error("deflateInit2 failed");
+    }
+    std::string out(deflateBound(&zs, in.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    const int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END)
+    {
+        throw std::runtime_error("gzip compression failed");
+    }
+    return out;
+}
+
+#ifdef NDT_HAVE_ZSTD
+std::string
+zstdCompress(std::string_view in)
+{
+    std::string out(ZSTD_compressBound(in.size()), '\0');
+    const size_t n = ZSTD_compress(out.data(), out.size(), in.data(), in.size(), HTTP_ZSTD_LEVEL);
+    if (ZSTD_isError(n))
+    {
+        throw std::runtime_error(std::string("zstd compression failed: ") +
+                                 ZSTD_getErrorName(n));
+    }
+    out.resize(n);
+    return out;
+}
+#endif
+
+/// Encode shared JSON text; Json/Identity hands back @p json itself without copying it.
+EncodedBody
+encodeShared(const std::shared_ptr<const std::string>& json, BodyFormat format,
+             ContentEncoding encoding)
+{
+    EncodedBody result;
+    result.format = format;
+    result.data = json;
+    if (format != BodyFormat::Json)
+    {
+        const auto doc = nlohmann::json::parse(*json);
+        const std::vector<uint8_t> bytes = format == BodyFormat::Cbor
+                                               ? nlohmann::json::to_cbor(doc)
+                                               : nlohmann::json::to_msgpack(doc);
+        result.data = std::make_shared<const std::string>(bytes.begin(), bytes.end());
+    }
+
+    if (result.data->size() < HTTP_COMPRESS_MIN_BYTES)
+    {
+        return result;
+    }
+    switch (encoding)
+    {
+    case ContentEncoding::Gzip:
+        result.data = std::make_shared<const std::string>(gzipCompress(*result.data));
+        result.encoding = encoding;
+        break;
+#ifdef NDT_HAVE_ZSTD
+    case ContentEncoding::Zstd:
+        result.data = std::make_shared<const std::string>(zstdCompress(*result.data));
+        result.encoding = encoding;
+        break;
+#endif
+    default:
+        break;
+    }
+    return result;
+}
+
+} // namespace
+
+std::string_view
+toString(ContentEncoding encoding)
+{
+    switch (encoding)
+    {
+    case ContentEncoding::Gzip:
+        return "gzip";
+    case ContentEncoding::Zstd:
+        return "zstd";
+    default:
+        return "";
+    }
+}
+
+std::string_view
+contentType(BodyFormat format)
+{
+    switch (format)
+    {
+    case BodyFormat::Cbor:
+        return "application/cbor";
+    case BodyFormat::MsgPack:
+        return "application/msgpack";
+    default:
+        return "application/json";
+    }
+}
+
+ContentEncoding
+negotiateEncoding(std::string_view acceptEncoding)
+{
+    ContentEncoding best = ContentEncoding::Identity;
+    forEachAccepted(acceptEncoding, [&best](const std::string& coding) {
+#ifdef NDT_HAVE_ZSTD
+        if (coding == "zstd")
+        {
+            best = ContentEncoding::Zstd;
+            return true;
+        }
+#endif
+        if (coding == "gzip" || coding == "x-gzip")
+        {
+            best = ContentEncoding::Gzip;
+        }
+        return false;
+    });
+    return best;
+}
+
+BodyFormat
+negotiateFormat(std::string_view accept)
+{
+    BodyFormat format = BodyFormat::Json;
+    forEachAccepted(accept, [&format](const std::string& type) {
+        if (type == "application/cbor")
+        {
+            format = BodyFormat::Cbor;
+            return true;
+        }
+        if (type == "application/msgpack" || type == "application/x-msgpack" ||
+            type == "application/vnd.msgpack")
+        {
+            format = BodyFormat::MsgPack;
+            return true;
+        }
+        return false;
+    });
+    return format;
+}
+
+EncodedBody
+encodeBody(std::string json, BodyFormat format, ContentEncoding encoding)
+{
+    return encodeShared(std::make_shared<const std::string>(std::move(json)), format, encoding);
+}
+
+EncodedBody
+EncodedBodyCache::get(std::string_view key, std::string_view version, BodyFormat format,
+                      ContentEncoding encoding, const std::function<std::string()>& render)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(std::string(key));
+    if (it == m_entries.end())
+    {
+        if (m_entries.size() >= HTTP_BODY_CACHE_MAX_KEYS)
+        {
+            auto oldest = std::min_element(
+                m_entries.begin(), m_entries.end(), [](const auto& a, const auto& b) {
+                    return a.second.lastUse < b.second.lastUse;
+                });
+            m_cachedBytes.fetch_sub(oldest->second.bytes, std::memory_order_relaxed);
+            m_entries.erase(oldest);
+        }
+        it = m_entries.emplace(std::string(key), Entry{}).first;
+    }
+    Entry& entry = it->second;
+    entry.lastUse = ++m_uses;
+    if (entry.version != version)
+    {
+        m_cachedBytes.fetch_sub(entry.bytes, std::memory_order_relaxed);
+        entry = Entry{std::string(version), nullptr, {}, 0, entry.lastUse};
+    }
+
+    EncodedBody& slot =
+        entry.variants[static_cast<size_t>(format) * kEncodings + static_cast<size_t>(encoding)];
+    if (slot.data)
+    {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return slot;
+    }
+
+    uint64_t added = 0;
+    if (!entry.json)
+    {
+        entry.json = std::make_shared<const std::string>(render());
+        m_renders.fetch_add(1, std::memory_order_relaxed);
+        added += entry.json->size();
+    }
+    slot = encodeShared(entry.json, format, encoding);
+    m_encodes.fetch_add(1, std::memory_order_relaxed);
+    if (slot.data != entry.json)
+    {
+        added += slot.data->size();
+    }
+    entry.bytes += added;
+    m_cachedBytes.fetch_add(added, std::memory_order_relaxed);
+    return slot;
+}
+
+nlohmann::json
+EncodedBodyCache::statsJson() const
+{
+    size_t keys = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        keys = m_entries.size();
+    }
+    return nlohmann::json{{"keys", keys},
+                          {"hits", m_hits.load(std::memory_order_relaxed)},
+                          {"renders", m_renders.load(std::memory_order_relaxed)},
+                          {"encodes", m_encodes.load(std::memory_order_relaxed)},
+                          {"cached_bytes", m_cachedBytes.load(std::memory_order_relaxed)}};
+}
+
+} // namespace utils
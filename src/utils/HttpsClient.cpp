@@ -0,0 +1,266 @@
+#include "utils/HttpsClient.hpp"
+#include "utils/Logger.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/asio/ssl/host_name_verification.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl/ssl_stream.hpp>
+#include <boost/beast/version.hpp>
+#include <boost/url/parse.hpp>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <stdexcept>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace asio = boost::asio;
+namespace ssl = asio::ssl;
+using tcp = asio::ip::tcp;
+
+namespace utils
+{
+
+/**
+ * @brief A TLS connection with its own io_context, driven by the requesting thread.
+ *
+ * Operations are started asynchronously and run to completion with run(), so the
+ * tcp_stream expiry bounds each of them; blocking Beast calls would ignore it.
+ */
+struct HttpsClient::Connection
+{
+    explicit Connection(ssl::context& context)
+        : stream(ioc, context)
+    {
+    }
+
+    template <typename Start>
+    beast::error_code
+    run(std::chrono::milliseconds timeout, Start&& start)
+    {
+        beast::error_code ec;
+        beast::get_lowest_layer(stream).expires_after(timeout);
+        start([&ec](beast::error_code result, auto&&...) { ec = result; });
+        ioc.restart();
+        ioc.run();
+        return ec;
+    }
+
+    asio::io_context ioc;
+    beast::ssl_stream<beast::tcp_stream> stream;
+    beast::flat_buffer buffer;
+    std::chrono::steady_clock::time_point idleSince;
+};
+
+HttpsClient&
+HttpsClient::instance()
+{
+    static HttpsClient client;
+    return client;
+}
+
+HttpsClient::HttpsClient()
+    : m_ssl(ssl::context::tls_client)
+{
+    m_ssl.set_default_verify_paths();
+    m_ssl.set_verify_mode(ssl::verify_peer);
+}
+
+HttpsClient::~HttpsClient() = default;
+
+std::unique_ptr<HttpsClient::Connection>
+HttpsClient::takeIdle(const std::string& hostKey)
+{
+    const auto oldest = std::chrono::steady_clock::now() -
+                        std::chrono::milliseconds(HTTPS_CLIENT_IDLE_TIMEOUT_MS);
+    std::lock_guard lock(m_idleMutex);
+    auto it = m_idle.find(hostKey);
+    if (it == m_idle.end())
+    {
+        return nullptr;
+    }
+    auto& idle = it->second;
+    while (!idle.empty())
+    {
+        std::unique_ptr<Connection> connection = std::move(idle.back());
+        idle.pop_back();
+        if (connection->idleSince >= oldest)
+        {
+            return connection;
+        }
+    }
+    return nullptr;
+}
+
+void
+HttpsClient::putIdle(const std::string& hostKey, std::unique_ptr<Connection> connection)
+{
+    connection->idleSince = std::chrono::steady_clock::now();
+    std::lock_guard lock(m_idleMutex);
+    auto& idle = m_idle[hostKey];
+    if (idle.size() < HTTPS_CLIENT_MAX_IDLE_PER_HOST)
+    {
+        idle.push_back(std::move(connection));
+    }
+}
+
+HttpResponse
+HttpsClient::post(const std::string& url,
+                  std::string body,
+                  const HttpRequestOptions& options,
+                  const ChunkCallback& onChunk)
+{
+    auto parsed = boost::urls::parse_uri(url);
+    if (!parsed || parsed->scheme() != "https" || parsed->host().empty())
+    {
+        throw std::invalid_argument("Unsupported HTTPS URL: " + url);
+    }
+    const std::string host = parsed->host();
+    const std::string port = parsed->port().empty() ? "443" : std::string(parsed->port());
+    const std::string hostKey = host + ":" + port;
+    std::string target =
+        parsed->encoded_path().empty() ? "/" : std::string(parsed->encoded_path());
+    if (parsed->has_query())
+    {
+        target += "?" + std::string(parsed->encoded_query());
+    }
+
+    http::request<http::string_body> request{http::verb::post, target, 11};
+    request.set(http::field::host, parsed->port().empty() ? host : hostKey);
+    request.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    request.set(http::field::content_type, options.contentType);
+    for (const auto& [name, value] : options.headers)
+    {
+        request.set(name, value);
+    }
+    request.keep_alive(true);
+    request.body() = std::move(body);
+    request.prepare_payload();
+
+    m_requests.fetch_add(1, std::memory_order_relaxed);
+    HttpResponse response;
+    for (;;)
+    {
+        std::unique_ptr<Connection> connection = takeIdle(hostKey);
+        const bool reused = connection != nullptr;
+        beast::error_code ec;
+        if (reused)
+        {
+            m_connectionsReused.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            connection = std::make_unique<Connection>(m_ssl);
+            tcp::resolver resolver(connection->ioc);
+            const auto endpoints = resolver.resolve(host, port, ec);
+            if (!ec)
+            {
+                ec = connection->run(options.timeout, [&](auto handler) {
+                    beast::get_lowest_layer(connection->stream).async_connect(endpoints, handler);
+                });
+            }
+            if (!ec && !SSL_set_tlsext_host_name(connection->stream.native_handle(), host.c_str()))
+            {
+                ec = beast::error_code(static_cast<int>(::ERR_get_error()),
+                                       asio::error::get_ssl_category());
+            }
+            if (!ec)
+            {
+                connection->stream.set_verify_callback(ssl::host_name_verification(host));
+                ec = connection->run(options.timeout, [&](auto handler) {
+                    connection->stream.async_handshake(ssl::stream_base::client, handler);
+                });
+            }
+            m_connectionsOpened.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        http::response_parser<http::buffer_body> parser;
+        parser.body_limit(HTTP_CLIENT_MAX_BODY_BYTES);
+        if (!ec)
+        {
+            ec = connection->run(options.timeout, [&](auto handler) {
+                http::async_write(connection->stream, request, handler);
+            });
+        }
+        if (!ec)
+        {
+            ec = connection->run(options.timeout, [&](auto handler) {
+                http::async_read_header(connection->stream, connection->buffer, parser, handler);
+            });
+        }
+        if (ec && reused && !parser.got_some())
+        {
+            // The server closed the connection while it was idle
+            m_staleConnections.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        char chunk[HTTPS_CLIENT_READ_CHUNK];
+        while (!ec && !parser.is_done())
+        {
+            parser.get().body().data = chunk;
+            parser.get().body().size = sizeof(chunk);
+            ec = connection->run(options.timeout, [&](auto handler) {
+                http::async_read(connection->stream, connection->buffer, parser, handler);
+            });
+            if (ec == http::error::need_buffer)
+            {
+                ec = {};
+            }
+            const size_t read = sizeof(chunk) - parser.get().body().size;
+            if (read == 0)
+            {
+                continue;
+            }
+            if (onChunk)
+            {
+                onChunk(std::string_view(chunk, read));
+            }
+            else
+            {
+                response.body.append(chunk, read);
+            }
+        }
+
+        if (ec)
+        {
+            m_failures.fetch_add(1, std::memory_order_relaxed);
+            SPDLOG_LOGGER_WARN(Logger::instance(), "HTTPS POST {} failed: {}", url, ec.message());
+            response.status = 0;
+            response.body.clear();
+            response.error = ec;
+            return response;
+        }
+        response.status = parser.get().result_int();
+        if (parser.keep_alive())
+        {
+            putIdle(hostKey, std::move(connection));
+        }
+        return response;
+    }
+}
+
+nlohmann::json
+HttpsClient::statsJson() const
+{
+    size_t idle = 0;
+    {
+        std::lock_guard lock(m_idleMutex);
+        for (const auto& [key, connections] : m_idle)
+        {
+            idle += connections.size();
+        }
+    }
+    return nlohmann::json{
+        {"requests", m_requests.load(std::memory_order_relaxed)},
+        {"failures", m_failures.load(std::memory_order_relaxed)},
+        {"connections_opened", m_connectionsOpened.load(std::memory_order_relaxed)},
+        {"connections_reused", m_connectionsReused.load(std::memory_order_relaxed)},
+        {"stale_connections", m_staleConnections.load(std::memory_order_relaxed)},
+        {"idle_connections", idle},
+    };
+}
+
+} // namespace utils
@@ -0,0 +1,208 @@
+#include "utils/IcmpProber.hpp"
+#include "utils/Utils.hpp"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace utils
+{
+
+namespace
+{
+
+uint16_t
+icmpChecksum(const unsigned char* data, size_t length)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < length; i += 2)
+    {
+        sum += static_cast<uint32_t>(data[i] << 8 | data[i + 1]);
+    }
+    if (length & 1)
+    {
+        sum += static_cast<uint32_t>(data[length - 1] << 8);
+    }
+    while (sum >> 16)
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return static_cast<uint16_t>(~sum);
+}
+
+} // namespace
+
+IcmpProber::IcmpProber()
+{
+    m_fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_ICMP);
+    if (m_fd < 0)
+    {
+        m_fd = ::socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_ICMP);
+        m_raw = true;
+    }
+    if (m_fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "ICMP socket");
+    }
+    m_id = static_cast<uint16_t>(std::random_device{}());
+}
+
+IcmpProber::~IcmpProber()
+{
+    ::close(m_fd);
+}
+
+bool
+IcmpProber::sendEcho(uint32_t ip, uint16_t seq)
+{
+    unsigned char packet[sizeof(icmphdr)] = {};
+    auto* header = reinterpret_cast<icmphdr*>(packet);
+    header->type = ICMP_ECHO;
+    header->code = 0;
+    header->un.echo.id = htons(m_id);
+    header->un.echo.sequence = htons(seq);
+    header->checksum = htons(icmpChecksum(packet, sizeof(packet)));
+
+    sockaddr_in to{};
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = ip;
+    const ssize_t n =
+        ::sendto(m_fd, packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&to), sizeof(to));
+    return n == static_cast<ssize_t>(sizeof(packet));
+}
+
+std::vector<IcmpProbeResult>
+IcmpProber::probe(const std::vector<uint32_t>& ips)
+{
+    using Clock = std::chrono::steady_clock;
+    std::vector<IcmpProbeResult> results(ips.size());
+    std::vector<uint64_t> sent(ips.size(), 0);
+
+    // Requests in flight: seq -> (address index, sent at)
+    std::unordered_map<uint16_t, std::pair<size_t, Clock::time_point>> inFlight;
+    size_t answered = 0;
+    for (int attempt = 0; attempt < ICMP_PROBE_ATTEMPTS && answered < ips.size(); ++attempt)
+    {
+        for (size_t i = 0; i < ips.size(); ++i)
+        {
+            if (results[i].alive)
+            {
+                continue;
+            }
+            const uint16_t seq = m_nextSeq++;
+            if (sendEcho(ips[i], seq))
+            {
+                inFlight[seq] = {i, Clock::now()};
+                ++sent[i];
+            }
+        }
+
+        const auto deadline = Clock::now() + std::chrono::milliseconds(ICMP_PROBE_TIMEOUT_MS);
+        while (answered < ips.size())
+        {
+            const auto left =
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+            pollfd pfd{m_fd, POLLIN, 0};
+            if (left.count() <= 0 || ::poll(&pfd, 1, static_cast<int>(left.count())) <= 0)
+            {
+                break;
+            }
+
+            unsigned char buffer[1500];
+            sockaddr_in from{};
+            socklen_t fromLength = sizeof(from);
+            const ssize_t n = ::recvfrom(m_fd,
+                                         buffer,
+                                         sizeof(buffer),
+                                         MSG_DONTWAIT,
+                                         reinterpret_cast<sockaddr*>(&from),
+                                         &fromLength);
+            if (n <= 0)
+            {
+                continue;
+            }
+            const auto receivedAt = Clock::now();
+
+            // A raw socket hands over the IP header too, and every ICMP packet of the host
+            size_t offset = 0;
+            if (m_raw)
+            {
+                offset = static_cast<size_t>(buffer[0] & 0x0F) * 4;
+            }
+            if (static_cast<size_t>(n) < offset + sizeof(icmphdr))
+            {
+                continue;
+            }
+            const auto* reply = reinterpret_cast<const icmphdr*>(buffer + offset);
+            if (reply->type != ICMP_ECHOREPLY || (m_raw && ntohs(reply->un.echo.id) != m_id))
+            {
+                continue;
+            }
+            auto it = inFlight.find(ntohs(reply->un.echo.sequence));
+            if (it == inFlight.end() || ips[it->second.first] != from.sin_addr.s_addr)
+            {
+                continue;
+            }
+            IcmpProbeResult& result = results[it->second.first];
+            if (!result.alive)
+            {
+                result.alive = true;
+                result.rttMs =
+                    std::chrono::duration<double, std::milli>(receivedAt - it->second.second)
+                        .count();
+                ++answered;
+            }
+            inFlight.erase(it);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    ++m_probes;
+    for (size_t i = 0; i < ips.size(); ++i)
+    {
+        DeviceStats& stats = m_devices[ips[i]];
+        stats.sent += sent[i];
+        stats.alive = results[i].alive;
+        if (results[i].alive)
+        {
+            ++stats.received;
+            stats.avgRttMs = stats.received == 1
+                                 ? results[i].rttMs
+                                 : ICMP_RTT_EWMA_WEIGHT * results[i].rttMs +
+                                       (1.0 - ICMP_RTT_EWMA_WEIGHT) * stats.avgRttMs;
+            stats.lastRttMs = results[i].rttMs;
+        }
+    }
+    return results;
+}
+
+nlohmann::json
+IcmpProber::statsJson() const
+{
+    nlohmann::json devices = nlohmann::json::object();
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    for (const auto& [ip, stats] : m_devices)
+    {
+        const double loss =
+            stats.sent == 0 ? 0.0 : 1.0 - static_cast<double>(stats.received) / stats.sent;
+        devices[ipToString(ip)] = {
+            {"sent", stats.sent},
+            {"received", stats.received},
+            {"loss", loss},
+            {"last_rtt_ms", stats.lastRttMs},
+            {"avg_rtt_ms", stats.avgRttMs},
+            {"alive", stats.alive}};
+    }
+    return nlohmann::json{
+        {"socket", m_raw ? "raw" : "dgram"}, {"probes", m_probes}, {"devices", std::move(devices)}};
+}
+
+} // namespace utils
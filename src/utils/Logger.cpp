@@ -1,5 +1,6 @@
 #include "utils/Logger.hpp"
 #include <iostream>
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <vector>
@@ -36,13 +37,114 @@ Logger::parse_cli_args(int argc, char* argv[])
         {
             cfg.level = parse_level(argv[++i]);
         }
+        else if (arg == "--log-async")
+        {
+            cfg.async = true;
+        }
         else if (arg == "--help" || arg == "-h")
         {
             std::cout << "Usage: " << argv[0]
-                      << " [--logfile|-f] [--loglevel|-l <level>]\n"
+                      << " [--logfile|-f] [--loglevel|-l <level>] [--log-async] "
+                         "[--sflow-workers <n>] "
+                         "[--sflow-pin-cpu] [--sflow-ring <n>] [--incremental-rates] "
+                         "[--scheduler-threads <n>] [--scheduler-cpus <list>] "
+                         "[--openflow-southbound <endpoint>] [--fast-reroute] [--io-threads <n>] "
+                         "[--event-workers <n>] [--event-coalesce-ms <ms>] "
+                         "[--flow-export-dir <dir>] [--flow-export-ipfix <host:port>] "
+                         "[--flow-table-max-flows <n>] [--flow-table-max-mb <n>] "
+                         "[--flow-eviction <policy>] [--flow-aggregation <mode>] "
+                         "[--flow-aggregation-prefix <s/d>] [--bidirectional-flows] "
+                         "[--first-hop-sampling] [--sflow-capture-interface <if>] "
+                         "[--sflow-io-uring] [--sflow-kernel-filter] "
+                         "[--sflow-max-samples-per-sec <n>] [--sflow-max-sampling-rate <n>] "
+                         "[--sflow-snmp-community <name>] [--cluster-coordinator <host:port>] "
+                         "[--cluster-listen [port]] [--checkpoint <path>] "
+                         "[--replicate-to <host:port>] [--standby [port]] [--config <file>] "
+                         "[--mode mininet|testbed] [--intent-translator on|off] "
+                         "[--path-cpus <list>] [--sflow-cpus <list>] [--telemetry-shm [/name]] "
+                         "[--huge-pages <mode>] [--no-numa] [--enable-profiling] "
+                         "[--flight-recorder <records>] [--flight-recorder-dump <path>]\n"
                          "  --logfile, -f       also write logs to netdt.log\n"
                          "  --loglevel, -l lvl  set log level: trace, debug, info, "
-                         "warn, err, critical, off\n";
+                         "warn, err, critical, off\n"
+                         "  --log-async         format and write logs on a background thread\n"
+                         "  --sflow-workers n   receive sFlow on n SO_REUSEPORT sockets\n"
+                         "  --sflow-pin-cpu     pin each sFlow worker to its own CPU\n"
+                         "  --sflow-ring n      decode into an n-entry ring drained by an "
+                         "aggregator thread\n"
+                         "  --incremental-rates only re-estimate flows sampled in the last "
+                         "interval\n"
+                         "  --scheduler-threads n  run the periodic tasks on n threads\n"
+                         "  --scheduler-cpus list  confine those threads to CPUs, e.g. 4-7 "
+                         "(default: the CPUs pinned sFlow workers leave free)\n"
+                         "  --openflow-southbound endpoint  push flow-mods over OpenFlow, "
+                         "e.g. unix:/var/run/openvswitch/s{dpid}.mgmt\n"
+                         "  --fast-reroute      push precomputed backup routes when a link "
+                         "fails\n"
+                         "  --io-threads n      run the REST API on n threads (default: one per "
+                         "core)\n"
+                         "  --event-workers n   deliver events to the handlers on n threads "
+                         "(default 2; 0: on the thread that emits them)\n"
+                         "  --event-coalesce-ms ms  deliver the state and congestion changes of a "
+                         "link at most once per ms (default 5; 0: every change)\n"
+                         "  --flow-export-dir dir  write the records of purged flows to gzipped "
+                         "CSV segments in dir\n"
+                         "  --flow-export-ipfix host:port  send the same records to an IPFIX "
+                         "collector over UDP\n"
+                         "  --flow-table-max-flows n  hold at most n flows (default 1048576; 0: "
+                         "unbounded)\n"
+                         "  --flow-table-max-mb n  hold at most n MiB of flows\n"
+                         "  --flow-eviction policy  flows evicted at those limits: least-recent "
+                         "(default) or lowest-rate\n"
+                         "  --flow-aggregation mode  key flows by five-tuple (default), host-pair "
+                         "or prefix-pair; append +five-tuple to keep the 5-tuple flows as well\n"
+                         "  --flow-aggregation-prefix s/d  source and destination prefix lengths "
+                         "of prefix-pair (default 24/24)\n"
+                         "  --bidirectional-flows  merge the pure ACKs of a TCP connection into "
+                         "the flow of the opposite direction\n"
+                         "  --first-hop-sampling  count the samples of a flow from its first "
+                         "switch only\n"
+                         "  --sflow-capture-interface if  read sFlow from a packet ring on "
+                         "interface if instead of UDP sockets\n"
+                         "  --sflow-io-uring    receive sFlow through io_uring where the build and "
+                         "kernel support it\n"
+                         "  --sflow-kernel-filter  drop datagrams of unknown agents (and, in "
+                         "Mininet mode, counter-only ones) in the kernel\n"
+                         "  --sflow-max-samples-per-sec n  raise the agents' sampling rates to "
+                         "keep all flow samples under n per second (default 0: off)\n"
+                         "  --sflow-max-sampling-rate n  never sample more sparsely than 1 in n "
+                         "(default 65536)\n"
+                         "  --sflow-snmp-community name  SNMP community with write access to the "
+                         "sFlow MIB (default private)\n"
+                         "  --cluster-coordinator host:port  run as a cluster node that forwards "
+                         "its samples to the coordinator\n"
+                         "  --cluster-listen [port]  run as the cluster coordinator (default port "
+                         "6344)\n"
+                         "  --checkpoint path   checkpoint the collector to path and restore it "
+                         "from there at start\n"
+                         "  --replicate-to host:port  replicate the state to a hot standby\n"
+                         "  --standby [port]    stand by for a primary and take over when it goes "
+                         "silent (default port 6345)\n"
+                         "  --config file       load tuning parameters from a JSON file\n"
+                         "  --mode mode         mininet or testbed, instead of asking at the "
+                         "prompt (or NDT_MODE)\n"
+                         "  --intent-translator on|off  with --mode, whether to start the intent "
+                         "translator (default off; or NDT_INTENT_TRANSLATOR)\n"
+                         "  --path-cpus list    confine the path resolution thread to CPUs, e.g. "
+                         "2-3\n"
+                         "  --sflow-cpus list   pin sFlow worker i to the i-th CPU of list rather "
+                         "than to CPU i\n"
+                         "  --telemetry-shm [/name]  publish links, top flows and the traffic "
+                         "matrix to a shared-memory segment (default /ndt_telemetry)\n"
+                         "  --huge-pages mode   back the large tables with off, thp (default) or "
+                         "explicit huge pages\n"
+                         "  --no-numa           do not place the large tables on the NUMA nodes of "
+                         "their threads\n"
+                         "  --enable-profiling  serve GET /ndt/debug/profile (403 otherwise)\n"
+                         "  --flight-recorder n keep the last n records of each thread (default "
+                         "4096; 0: off)\n"
+                         "  --flight-recorder-dump path  write them to path on a crash (default "
+                         "ndt_flight_recorder.bin)\n";
             std::exit(0);
         }
     }
@@ -64,7 +166,21 @@ Logger::init(const LogConfig& cfg)
         sinks.push_back(file_sink);
     }
 
-    m_logger = std::make_shared<spdlog::logger>("netdt", sinks.begin(), sinks.end());
+    if (cfg.async)
+    {
+        // One writer thread keeps the messages in order
+        spdlog::init_thread_pool(LOG_ASYNC_QUEUE_SIZE, 1);
+        m_logger =
+            std::make_shared<spdlog::async_logger>("netdt",
+                                                   sinks.begin(),
+                                                   sinks.end(),
+                                                   spdlog::thread_pool(),
+                                                   spdlog::async_overflow_policy::overrun_oldest);
+    }
+    else
+    {
+        m_logger = std::make_shared<spdlog::logger>("netdt", sinks.begin(), sinks.end());
+    }
     spdlog::register_logger(m_logger);
     spdlog::set_default_logger(m_logger);
     spdlog::set_level(cfg.level);
@@ -80,8 +196,18 @@ Logger::init(const LogConfig& cfg)
     );
 }
 
-std::shared_ptr<spdlog::logger>
+const std::shared_ptr<spdlog::logger>&
 Logger::instance()
 {
     return m_logger;
 }
+
+void
+Logger::shutdown()
+{
+    if (m_logger)
+    {
+        m_logger->flush();
+    }
+    spdlog::shutdown();
+}
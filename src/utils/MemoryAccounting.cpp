@@ -0,0 +1,294 @@
+#include "utils/MemoryAccounting.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include <exception>
+#include <fstream>
+#include <malloc.h>
+#include <unistd.h>
+
+namespace utils
+{
+
+namespace
+{
+
+size_t
+residentBytes()
+{
+    // size resident ... in pages
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    if (!(statm >> pages >> resident))
+    {
+        return 0;
+    }
+    return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+std::optional<size_t>
+heapInUseBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 info = ::mallinfo2();
+    // Small and large chunks in use, and the chunks malloc mmap()ed on its own
+    return info.uordblks + info.hblkhd;
+#else
+    return std::nullopt;
+#endif
+}
+
+} // namespace
+
+size_t
+heapBytes(const nlohmann::json& j)
+{
+    switch (j.type())
+    {
+    case nlohmann::json::value_t::object:
+    {
+        const auto& object = j.get_ref<const nlohmann::json::object_t&>();
+        size_t bytes = heapChunk(sizeof(object)) + heapBytes(object);
+        for (const auto& [key, value] : object)
+        {
+            bytes += heapBytes(key) + heapBytes(value);
+        }
+        return bytes;
+    }
+    case nlohmann::json::value_t::array:
+    {
+        const auto& array = j.get_ref<const nlohmann::json::array_t&>();
+        size_t bytes = heapChunk(sizeof(array)) + heapBytes(array);
+        for (const auto& value : array)
+        {
+            bytes += heapBytes(value);
+        }
+        return bytes;
+    }
+    case nlohmann::json::value_t::string:
+    {
+        const auto& string = j.get_ref<const nlohmann::json::string_t&>();
+        return heapChunk(sizeof(string)) + heapBytes(string);
+    }
+    case nlohmann::json::value_t::binary:
+    {
+        const auto& binary = j.get_ref<const nlohmann::json::binary_t&>();
+        return heapChunk(sizeof(binary)) + heapChunk(binary.capacity());
+    }
+    default:
+        return 0;
+    }
+}
+
+MemoryUsage&
+MemoryUsage::add(std::string_view container, size_t bytes)
+{
+    for (auto& [name, total] : m_containers)
+    {
+        if (name == container)
+        {
+            total += bytes;
+            return *this;
+        }
+    }
+    m_containers.emplace_back(container, bytes);
+    return *this;
+}
+
+MemoryUsage&
+MemoryUsage::per(std::string_view unit, size_t count)
+{
+    m_units.emplace_back(unit, count);
+    return *this;
+}
+
+size_t
+MemoryUsage::totalBytes() const
+{
+    size_t total = 0;
+    for (const auto& [name, bytes] : m_containers)
+    {
+        total += bytes;
+    }
+    return total;
+}
+
+size_t
+MemoryUsage::bytes(std::string_view container) const
+{
+    for (const auto& [name, bytes] : m_containers)
+    {
+        if (name == container)
+        {
+            return bytes;
+        }
+    }
+    return 0;
+}
+
+nlohmann::json
+MemoryUsage::toJson() const
+{
+    const size_t total = totalBytes();
+    nlohmann::json containers = nlohmann::json::object();
+    for (const auto& [name, bytes] : m_containers)
+    {
+        containers[name] = bytes;
+    }
+    nlohmann::json out{{"bytes", total}, {"containers", std::move(containers)}};
+    for (const auto& [unit, count] : m_units)
+    {
+        out[unit + "s"] = count;
+        out["bytes_per_" + unit] = count == 0 ? 0.0 : static_cast<double>(total) / count;
+    }
+    return out;
+}
+
+MemoryAccounting&
+MemoryAccounting::instance()
+{
+    // Never destroyed: the scheduler may still refresh while statics are torn down
+    static MemoryAccounting* accounting = new MemoryAccounting();
+    return *accounting;
+}
+
+void
+MemoryAccounting::add(std::string subsystem, Estimator estimator)
+{
+    std::lock_guard lock(m_mutex);
+    m_estimators.emplace_back(std::move(subsystem), std::move(estimator));
+}
+
+void
+MemoryAccounting::start(std::chrono::milliseconds period)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_task != 0)
+        {
+            return;
+        }
+        m_period = period;
+    }
+    const TaskScheduler::TaskId task = TaskScheduler::instance().schedule(
+        "memory_accounting", TaskPriority::Low, period, [this] { refresh(); }, true);
+    std::lock_guard lock(m_mutex);
+    m_task = task;
+}
+
+void
+MemoryAccounting::refresh()
+{
+    std::lock_guard refreshLock(m_refreshMutex);
+    std::vector<std::pair<std::string, Estimator>> estimators;
+    {
+        std::lock_guard lock(m_mutex);
+        estimators = m_estimators;
+    }
+
+    std::vector<std::pair<std::string, MemoryUsage>> usage;
+    usage.reserve(estimators.size());
+    for (const auto& [subsystem, estimator] : estimators)
+    {
+        try
+        {
+            usage.emplace_back(subsystem, estimator());
+        }
+        catch (const std::exception& e)
+        {
+            SPDLOG_LOGGER_WARN(
+                Logger::instance(), "Memory accounting of {} failed: {}", subsystem, e.what());
+        }
+    }
+    const size_t resident = residentBytes();
+    const std::optional<size_t> heapInUse = heapInUseBytes();
+    const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+
+    std::lock_guard lock(m_mutex);
+    m_usage = std::move(usage);
+    m_residentBytes = resident;
+    m_heapInUseBytes = heapInUse;
+    m_updatedAtMs = now;
+}
+
+nlohmann::json
+MemoryAccounting::toJson() const
+{
+    std::lock_guard lock(m_mutex);
+    size_t accounted = 0;
+    nlohmann::json subsystems = nlohmann::json::object();
+    for (const auto& [subsystem, usage] : m_usage)
+    {
+        accounted += usage.totalBytes();
+        subsystems[subsystem] = usage.toJson();
+    }
+    return {{"updated_at_ms", m_updatedAtMs},
+            {"period_ms", m_period.count()},
+            {"resident_bytes", m_residentBytes},
+            {"heap_in_use_bytes",
+             m_heapInUseBytes ? nlohmann::json(*m_heapInUseBytes) : nlohmann::json(nullptr)},
+            {"accounted_bytes", accounted},
+            {"subsystems", std::move(subsystems)}};
+}
+
+void
+MemoryAccounting::appendMetrics(std::string& out) const
+{
+    std::vector<MetricSample> containers;
+    std::vector<MetricSample> perItem;
+    size_t resident = 0;
+    std::optional<size_t> heapInUse;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_updatedAtMs == 0)
+        {
+            return;
+        }
+        for (const auto& [subsystem, usage] : m_usage)
+        {
+            const std::string subsystemLabel = MetricsRegistry::label("subsystem", subsystem);
+            for (const auto& [container, bytes] : usage.containers())
+            {
+                containers.push_back(
+                    {subsystemLabel + "," + MetricsRegistry::label("container", container),
+                     static_cast<double>(bytes)});
+            }
+            const size_t total = usage.totalBytes();
+            for (const auto& [unit, count] : usage.units())
+            {
+                perItem.push_back({subsystemLabel + "," + MetricsRegistry::label("unit", unit),
+                                   count == 0 ? 0.0 : static_cast<double>(total) / count});
+            }
+        }
+        resident = m_residentBytes;
+        heapInUse = m_heapInUseBytes;
+    }
+
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_memory_estimated_bytes",
+                                  "gauge",
+                                  "Estimated memory of each major container, by subsystem",
+                                  containers);
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_memory_bytes_per_item",
+                                  "gauge",
+                                  "Estimated memory of a subsystem divided by its flows or rules",
+                                  perItem);
+    MetricsRegistry::appendFamily(out,
+                                  "ndt_memory_resident_bytes",
+                                  "gauge",
+                                  "Resident set size of the process at the last accounting",
+                                  {{"", static_cast<double>(resident)}});
+    if (heapInUse)
+    {
+        MetricsRegistry::appendFamily(out,
+                                      "ndt_memory_heap_in_use_bytes",
+                                      "gauge",
+                                      "Bytes malloc has handed out at the last accounting",
+                                      {{"", static_cast<double>(*heapInUse)}});
+    }
+}
+
+} // namespace utils
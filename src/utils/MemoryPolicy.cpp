@@ -0,0 +1,408 @@
+#include "utils/MemoryPolicy.hpp"
+#include "utils/Logger.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <linux/mempolicy.h>
+#include <linux/perf_event.h>
+#include <map>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace utils
+{
+
+namespace
+{
+
+constexpr size_t NODE_MASK_WORDS = 16; // 1024 nodes
+constexpr size_t WORD_BITS = sizeof(unsigned long) * 8;
+
+const char*
+kindName(MemoryKind kind)
+{
+    switch (kind)
+    {
+    case MemoryKind::IngestBuffers:
+        return "ingest_buffers";
+    case MemoryKind::FlowTable:
+        return "flow_table";
+    case MemoryKind::Classifier:
+        return "classifier";
+    }
+    return "unknown";
+}
+
+const char*
+hugePageModeName(HugePageMode mode)
+{
+    switch (mode)
+    {
+    case HugePageMode::Off:
+        return "off";
+    case HugePageMode::Transparent:
+        return "thp";
+    case HugePageMode::Explicit:
+        return "explicit";
+    }
+    return "unknown";
+}
+
+// The nodes of /sys/devices/system/node/online ("0", "0-1", "0,2-3"); just node 0 without it
+std::vector<unsigned>
+onlineNodes()
+{
+    std::ifstream in("/sys/devices/system/node/online");
+    std::string text;
+    std::vector<unsigned> nodes;
+    if (in >> text)
+    {
+        std::stringstream list(text);
+        std::string range;
+        while (std::getline(list, range, ','))
+        {
+            const size_t dash = range.find('-');
+            const unsigned first = std::stoul(range.substr(0, dash));
+            const unsigned last =
+                dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+            for (unsigned node = first; node <= last && node < NODE_MASK_WORDS * WORD_BITS;
+                 ++node)
+            {
+                nodes.push_back(node);
+            }
+        }
+    }
+    if (nodes.empty())
+    {
+        nodes.push_back(0);
+    }
+    return nodes;
+}
+
+int
+openTlbCounter(uint64_t result)
+{
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(
+        ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+nlohmann::json
+readCounter(int fd)
+{
+    uint64_t value = 0;
+    if (fd < 0 || ::read(fd, &value, sizeof(value)) != sizeof(value))
+    {
+        return nullptr;
+    }
+    return value;
+}
+
+} // namespace
+
+MemoryPolicy&
+MemoryPolicy::instance()
+{
+    static MemoryPolicy policy;
+    return policy;
+}
+
+MemoryPolicy::MemoryPolicy()
+    : m_nodes(onlineNodes())
+{
+}
+
+void
+MemoryPolicy::configure(MemoryPolicyConfig config)
+{
+    m_hugePages.store(config.hugePages, std::memory_order_relaxed);
+    m_numa.store(config.numa, std::memory_order_relaxed);
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Memory policy: huge pages {}, NUMA placement {} ({} nodes)",
+                       hugePageModeName(config.hugePages),
+                       config.numa ? "on" : "off",
+                       m_nodes.size());
+}
+
+std::optional<HugePageMode>
+MemoryPolicy::parseHugePages(std::string_view text)
+{
+    if (text == "off")
+    {
+        return HugePageMode::Off;
+    }
+    if (text == "thp")
+    {
+        return HugePageMode::Transparent;
+    }
+    if (text == "explicit")
+    {
+        return HugePageMode::Explicit;
+    }
+    return std::nullopt;
+}
+
+void*
+MemoryPolicy::allocate(size_t bytes, MemoryKind kind)
+{
+    const HugePageMode mode = m_hugePages.load(std::memory_order_relaxed);
+    const bool numa = m_numa.load(std::memory_order_relaxed) && m_nodes.size() > 1;
+    if (mode == HugePageMode::Off && !numa)
+    {
+        return nullptr;
+    }
+    KindStats& stats = m_stats[static_cast<size_t>(kind)];
+    const size_t length =
+        (bytes + MEMORY_HUGE_PAGE_BYTES - 1) & ~size_t{MEMORY_HUGE_PAGE_BYTES - 1};
+
+    void* p = MAP_FAILED;
+    if (mode == HugePageMode::Explicit)
+    {
+        p = ::mmap(nullptr,
+                   length,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                   -1,
+                   0);
+        if (p == MAP_FAILED)
+        {
+            stats.fallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    const bool hugetlb = p != MAP_FAILED;
+    if (!hugetlb)
+    {
+        // Over-map by a huge page and trim, so the region starts on a huge page boundary
+        void* raw = ::mmap(nullptr,
+                           length + MEMORY_HUGE_PAGE_BYTES,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1,
+                           0);
+        if (raw == MAP_FAILED)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "MemoryPolicy: cannot map {} bytes for {}: {}",
+                               length,
+                               kindName(kind),
+                               strerror(errno));
+            return nullptr;
+        }
+        const uintptr_t start = (reinterpret_cast<uintptr_t>(raw) + MEMORY_HUGE_PAGE_BYTES - 1) &
+                                ~uintptr_t{MEMORY_HUGE_PAGE_BYTES - 1};
+        const size_t head = start - reinterpret_cast<uintptr_t>(raw);
+        if (head > 0)
+        {
+            ::munmap(raw, head);
+        }
+        if (head < MEMORY_HUGE_PAGE_BYTES)
+        {
+            ::munmap(reinterpret_cast<void*>(start + length), MEMORY_HUGE_PAGE_BYTES - head);
+        }
+        p = reinterpret_cast<void*>(start);
+        if (mode != HugePageMode::Off)
+        {
+            ::madvise(p, length, MADV_HUGEPAGE);
+        }
+    }
+    if (numa)
+    {
+        place(p, length, kind);
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_regions.emplace(p, Region{length, kind, mode != HugePageMode::Off});
+    }
+    stats.regions.fetch_add(1, std::memory_order_relaxed);
+    stats.bytes.fetch_add(length, std::memory_order_relaxed);
+    if (mode != HugePageMode::Off)
+    {
+        stats.hugeBytes.fetch_add(length, std::memory_order_relaxed);
+    }
+    return p;
+}
+
+bool
+MemoryPolicy::deallocate(void* p)
+{
+    Region region;
+    {
+        std::lock_guard lock(m_mutex);
+        auto it = m_regions.find(p);
+        if (it == m_regions.end())
+        {
+            return false;
+        }
+        region = it->second;
+        m_regions.erase(it);
+    }
+    ::munmap(p, region.bytes);
+    KindStats& stats = m_stats[static_cast<size_t>(region.kind)];
+    stats.regions.fetch_sub(1, std::memory_order_relaxed);
+    stats.bytes.fetch_sub(region.bytes, std::memory_order_relaxed);
+    if (region.huge)
+    {
+        stats.hugeBytes.fetch_sub(region.bytes, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void
+MemoryPolicy::place(void* p, size_t bytes, MemoryKind kind) const
+{
+    unsigned long mask[NODE_MASK_WORDS] = {};
+    int policy = MPOL_INTERLEAVE;
+    if (kind == MemoryKind::IngestBuffers)
+    {
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 ||
+            node >= NODE_MASK_WORDS * WORD_BITS)
+        {
+            return;
+        }
+        policy = MPOL_PREFERRED;
+        mask[node / WORD_BITS] |= 1UL << (node % WORD_BITS);
+    }
+    else
+    {
+        for (unsigned node : m_nodes)
+        {
+            mask[node / WORD_BITS] |= 1UL << (node % WORD_BITS);
+        }
+    }
+    if (::syscall(SYS_mbind, p, bytes, policy, mask, NODE_MASK_WORDS * WORD_BITS, 0) != 0)
+    {
+        SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                            "MemoryPolicy: mbind of {} bytes for {} failed: {}",
+                            bytes,
+                            kindName(kind),
+                            strerror(errno));
+    }
+}
+
+void
+MemoryPolicy::countTlbMisses(const std::string& thread)
+{
+    TlbCounter counter{thread,
+                       openTlbCounter(PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+                       openTlbCounter(PERF_COUNT_HW_CACHE_RESULT_MISS)};
+    if (counter.missesFd < 0)
+    {
+        SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                            "MemoryPolicy: no dTLB counters for {}: {}",
+                            thread,
+                            strerror(errno));
+        if (counter.loadsFd >= 0)
+        {
+            ::close(counter.loadsFd);
+        }
+        return;
+    }
+    std::lock_guard lock(m_mutex);
+    m_tlbCounters.push_back(std::move(counter));
+}
+
+nlohmann::json
+MemoryPolicy::statsJson() const
+{
+    nlohmann::json kinds = nlohmann::json::object();
+    for (size_t k = 0; k < MEMORY_KIND_COUNT; ++k)
+    {
+        const KindStats& stats = m_stats[k];
+        kinds[kindName(static_cast<MemoryKind>(k))] = {
+            {"regions", stats.regions.load(std::memory_order_relaxed)},
+            {"bytes", stats.bytes.load(std::memory_order_relaxed)},
+            {"huge_bytes", stats.hugeBytes.load(std::memory_order_relaxed)},
+            {"fallbacks", stats.fallbacks.load(std::memory_order_relaxed)}};
+    }
+
+    // "AnonHugePages:  2048 kB" and the like
+    uint64_t anonHugeKb = 0;
+    uint64_t hugetlbKb = 0;
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    std::string field;
+    uint64_t kb = 0;
+    while (rollup >> field >> kb)
+    {
+        if (field == "AnonHugePages:")
+        {
+            anonHugeKb = kb;
+        }
+        else if (field == "Private_Hugetlb:" || field == "Shared_Hugetlb:")
+        {
+            hugetlbKb += kb;
+        }
+        rollup.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+
+    // "N<node>=<pages>" per mapping, in pages of "kernelpagesize_kB=<kB>"
+    std::map<unsigned, uint64_t> nodeKb;
+    std::ifstream numaMaps("/proc/self/numa_maps");
+    std::string line;
+    while (std::getline(numaMaps, line))
+    {
+        std::stringstream tokens(line);
+        std::string token;
+        uint64_t pageKb = 4;
+        std::vector<std::pair<unsigned, uint64_t>> pages;
+        while (tokens >> token)
+        {
+            const size_t eq = token.find('=');
+            if (eq == std::string::npos)
+            {
+                continue;
+            }
+            if (token.starts_with("kernelpagesize_kB"))
+            {
+                pageKb = std::stoull(token.substr(eq + 1));
+            }
+            else if (token.size() > 1 && token[0] == 'N' && std::isdigit(token[1]))
+            {
+                pages.emplace_back(std::stoul(token.substr(1, eq - 1)),
+                                   std::stoull(token.substr(eq + 1)));
+            }
+        }
+        for (const auto& [node, count] : pages)
+        {
+            nodeKb[node] += count * pageKb;
+        }
+    }
+    nlohmann::json nodeBytes = nlohmann::json::array();
+    for (const auto& [node, nodeTotalKb] : nodeKb)
+    {
+        nodeBytes.push_back({{"node", node}, {"bytes", nodeTotalKb << 10}});
+    }
+
+    nlohmann::json tlb = nlohmann::json::array();
+    {
+        std::lock_guard lock(m_mutex);
+        for (const TlbCounter& counter : m_tlbCounters)
+        {
+            tlb.push_back({{"thread", counter.thread},
+                           {"loads", readCounter(counter.loadsFd)},
+                           {"misses", readCounter(counter.missesFd)}});
+        }
+    }
+
+    return nlohmann::json{{"huge_pages", hugePageModeName(m_hugePages.load())},
+                          {"numa", m_numa.load()},
+                          {"nodes", m_nodes.size()},
+                          {"kinds", std::move(kinds)},
+                          {"anon_huge_bytes", anonHugeKb << 10},
+                          {"hugetlb_bytes", hugetlbKb << 10},
+                          {"node_bytes", std::move(nodeBytes)},
+                          {"tlb", std::move(tlb)}};
+}
+
+} // namespace utils
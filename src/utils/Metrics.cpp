@@ -0,0 +1,280 @@
+#include "utils/Metrics.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace utils
+{
+
+namespace
+{
+
+void
+appendValue(std::string& out, double value)
+{
+    char buffer[32];
+    int n = std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    out.append(buffer, static_cast<size_t>(n));
+}
+
+void
+appendHeader(std::string& out, std::string_view name, std::string_view type, std::string_view help)
+{
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void
+appendSample(std::string& out,
+             std::string_view name,
+             std::string_view suffix,
+             std::string_view labels,
+             double value)
+{
+    out.append(name).append(suffix);
+    if (!labels.empty())
+    {
+        out.append("{").append(labels).append("}");
+    }
+    out.append(" ");
+    appendValue(out, value);
+    out.append("\n");
+}
+
+// @p labels with le="@p bound" added
+std::string
+withLe(std::string_view labels, std::string_view bound)
+{
+    std::string result(labels);
+    if (!result.empty())
+    {
+        result += ',';
+    }
+    result += "le=\"";
+    result += bound;
+    result += '"';
+    return result;
+}
+
+} // namespace
+
+size_t
+metricsStripe()
+{
+    static std::atomic<size_t> next{0};
+    thread_local const size_t stripe =
+        next.fetch_add(1, std::memory_order_relaxed) % METRICS_COUNTER_STRIPES;
+    return stripe;
+}
+
+uint64_t
+Counter::value() const
+{
+    uint64_t total = 0;
+    for (const auto& stripe : m_stripes)
+    {
+        total += stripe.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+    : m_bounds(std::move(bounds)),
+      m_buckets(new std::atomic<uint64_t>[m_bounds.size() + 1])
+{
+    std::sort(m_bounds.begin(), m_bounds.end());
+    for (size_t i = 0; i <= m_bounds.size(); ++i)
+    {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void
+Histogram::observe(double value)
+{
+    // Buckets are few; a linear scan beats a binary search on them
+    size_t i = 0;
+    while (i < m_bounds.size() && value > m_bounds[i])
+    {
+        ++i;
+    }
+    m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+MetricsRegistry&
+MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Family&
+MetricsRegistry::family(std::string_view name, Type type, std::string_view help)
+{
+    auto it = m_families.find(name);
+    if (it == m_families.end())
+    {
+        Family created{type, std::string(help), {}, {}, {}, {}};
+        it = m_families.emplace(std::string(name), std::move(created)).first;
+    }
+    else if (it->second.type != type)
+    {
+        throw std::logic_error("Metric " + std::string(name) + " registered with another type");
+    }
+    return it->second;
+}
+
+Counter&
+MetricsRegistry::counter(std::string_view name, std::string_view help, std::string_view labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& metrics = family(name, Type::Counter, help).counters;
+    auto it = metrics.find(labels);
+    if (it == metrics.end())
+    {
+        it = metrics.emplace(std::string(labels), std::make_unique<Counter>()).first;
+    }
+    return *it->second;
+}
+
+Gauge&
+MetricsRegistry::gauge(std::string_view name, std::string_view help, std::string_view labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& metrics = family(name, Type::Gauge, help).gauges;
+    auto it = metrics.find(labels);
+    if (it == metrics.end())
+    {
+        it = metrics.emplace(std::string(labels), std::make_unique<Gauge>()).first;
+    }
+    return *it->second;
+}
+
+Histogram&
+MetricsRegistry::histogram(std::string_view name,
+                           std::string_view help,
+                           std::string_view labels,
+                           const std::vector<double>& bounds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Family& f = family(name, Type::Histogram, help);
+    if (f.histograms.empty())
+    {
+        f.bounds = bounds;
+    }
+    auto it = f.histograms.find(labels);
+    if (it == f.histograms.end())
+    {
+        it = f.histograms.emplace(std::string(labels), std::make_unique<Histogram>(f.bounds))
+                 .first;
+    }
+    return *it->second;
+}
+
+void
+MetricsRegistry::render(std::string& out) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [name, f] : m_families)
+    {
+        switch (f.type)
+        {
+        case Type::Counter:
+            appendHeader(out, name, "counter", f.help);
+            for (const auto& [labels, counter] : f.counters)
+            {
+                appendSample(out, name, "", labels, static_cast<double>(counter->value()));
+            }
+            break;
+        case Type::Gauge:
+            appendHeader(out, name, "gauge", f.help);
+            for (const auto& [labels, gauge] : f.gauges)
+            {
+                appendSample(out, name, "", labels, gauge->value());
+            }
+            break;
+        case Type::Histogram:
+            appendHeader(out, name, "histogram", f.help);
+            for (const auto& [labels, histogram] : f.histograms)
+            {
+                const auto& bounds = histogram->bounds();
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i <= bounds.size(); ++i)
+                {
+                    cumulative += histogram->bucketCount(i);
+                    std::string le = "+Inf";
+                    if (i < bounds.size())
+                    {
+                        le.clear();
+                        appendValue(le, bounds[i]);
+                    }
+                    appendSample(
+                        out, name, "_bucket", withLe(labels, le), static_cast<double>(cumulative));
+                }
+                appendSample(out, name, "_sum", labels, histogram->sum());
+                appendSample(out, name, "_count", labels, static_cast<double>(cumulative));
+            }
+            break;
+        }
+    }
+}
+
+void
+MetricsRegistry::appendFamily(std::string& out,
+                              std::string_view name,
+                              std::string_view type,
+                              std::string_view help,
+                              const std::vector<MetricSample>& samples)
+{
+    appendHeader(out, name, type, help);
+    for (const auto& sample : samples)
+    {
+        appendSample(out, name, sample.suffix, sample.labels, sample.value);
+    }
+}
+
+std::string
+MetricsRegistry::label(std::string_view key, std::string_view value)
+{
+    std::string result(key);
+    result += "=\"";
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '\\':
+            result += "\\\\";
+            break;
+        case '"':
+            result += "\\\"";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        default:
+            result += c;
+        }
+    }
+    result += '"';
+    return result;
+}
+
+const std::vector<double>&
+MetricsRegistry::latencyBuckets()
+{
+    static const std::vector<double> buckets{1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4,
+                                             2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3, 1e-2, 2.5e-2,
+                                             5e-2, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0};
+    return buckets;
+}
+
+Histogram&
+pollerCycleHistogram(std::string_view poller)
+{
+    return MetricsRegistry::instance().histogram("ndt_poller_cycle_seconds",
+                                                 "Duration of one cycle of a periodic worker",
+                                                 MetricsRegistry::label("poller", poller));
+}
+
+} // namespace utils
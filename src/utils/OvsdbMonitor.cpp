@@ -0,0 +1,441 @@
+#include "utils/OvsdbMonitor.hpp"
+#include "utils/Logger.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace utils
+{
+
+namespace
+{
+
+// Length of the first complete JSON value at the front of @p buffer, 0 if it has not all
+// arrived yet; ovsdb-server sends its messages back to back with no delimiter
+size_t
+messageLength(std::string_view buffer)
+{
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+        const char c = buffer[i];
+        if (inString)
+        {
+            if (escaped)
+            {
+                escaped = false;
+            }
+            else if (c == '\\')
+            {
+                escaped = true;
+            }
+            else if (c == '"')
+            {
+                inString = false;
+            }
+        }
+        else if (c == '"')
+        {
+            inString = true;
+        }
+        else if (c == '{' || c == '[')
+        {
+            ++depth;
+        }
+        else if ((c == '}' || c == ']') && --depth == 0)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// An optional integer column; unset ones are the empty set ["set", []]
+uint32_t
+integerColumn(const nlohmann::json& row, const char* column)
+{
+    auto it = row.find(column);
+    if (it == row.end() || !it->is_number_integer())
+    {
+        return 0;
+    }
+    const int64_t value = it->get<int64_t>();
+    return value > 0 ? static_cast<uint32_t>(value) : 0;
+}
+
+void
+setReceiveTimeout(int fd, std::chrono::milliseconds timeout)
+{
+    timeval tv{};
+    tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+    tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+} // namespace
+
+OvsdbMonitor&
+OvsdbMonitor::instance()
+{
+    static OvsdbMonitor monitor;
+    return monitor;
+}
+
+OvsdbMonitor::~OvsdbMonitor()
+{
+    stop();
+}
+
+bool
+OvsdbMonitor::start(const std::string& socketPath)
+{
+    std::lock_guard startLock(m_startMutex);
+    if (m_thread.joinable())
+    {
+        return true;
+    }
+    m_socketPath = socketPath;
+    if (!openSession())
+    {
+        return false;
+    }
+    m_stop.reset();
+    m_thread = std::thread(&OvsdbMonitor::run, this);
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Monitoring OVSDB at {}: {} interfaces, {} bridges",
+                       m_socketPath,
+                       state()->interfaces.size(),
+                       state()->bridges.size());
+    return true;
+}
+
+void
+OvsdbMonitor::stop()
+{
+    std::lock_guard startLock(m_startMutex);
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+    m_stop.request();
+    {
+        std::lock_guard lock(m_fdMutex);
+        if (m_fd >= 0)
+        {
+            ::shutdown(m_fd, SHUT_RDWR);
+        }
+    }
+    m_thread.join();
+    std::lock_guard lock(m_fdMutex);
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_connected.store(false, std::memory_order_relaxed);
+}
+
+bool
+OvsdbMonitor::openSession()
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, m_socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                            "Cannot connect to OVSDB at {}: {}",
+                            m_socketPath,
+                            std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    {
+        std::lock_guard lock(m_fdMutex);
+        m_fd = fd;
+    }
+    m_buffer.clear();
+
+    auto fail = [this] {
+        std::lock_guard lock(m_fdMutex);
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    };
+    const nlohmann::json request{
+        {"method", "monitor"},
+        {"params",
+         {"Open_vSwitch",
+          nullptr,
+          {{"Interface", {{"columns", {"name", "ifindex", "ofport"}}}},
+           {"Bridge", {{"columns", {"name"}}}}}}},
+        {"id", 0}};
+    if (!send(request))
+    {
+        return fail();
+    }
+
+    // The reply carries the initial rows; echoes may come first
+    setReceiveTimeout(fd, std::chrono::milliseconds(OVSDB_REPLY_TIMEOUT_MS));
+    while (true)
+    {
+        std::optional<nlohmann::json> message = readMessage();
+        if (!message)
+        {
+            SPDLOG_LOGGER_WARN(Logger::instance(),
+                               "No monitor reply from OVSDB at {}",
+                               m_socketPath);
+            return fail();
+        }
+        if (message->value("id", nlohmann::json()) == 0)
+        {
+            if (!message->value("error", nlohmann::json()).is_null() ||
+                !message->contains("result"))
+            {
+                SPDLOG_LOGGER_WARN(Logger::instance(),
+                                   "OVSDB monitor request failed: {}",
+                                   message->dump());
+                return fail();
+            }
+            apply(message->at("result"), true);
+            break;
+        }
+        handle(*message);
+    }
+    setReceiveTimeout(fd, std::chrono::milliseconds(0));
+    m_connected.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+bool
+OvsdbMonitor::send(const nlohmann::json& message)
+{
+    const std::string text = message.dump();
+    size_t sent = 0;
+    while (sent < text.size())
+    {
+        const ssize_t n = ::send(m_fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::optional<nlohmann::json>
+OvsdbMonitor::readMessage()
+{
+    while (true)
+    {
+        if (const size_t length = messageLength(m_buffer))
+        {
+            nlohmann::json message =
+                nlohmann::json::parse(m_buffer.begin(), m_buffer.begin() + length, nullptr, false);
+            m_buffer.erase(0, length);
+            if (message.is_discarded())
+            {
+                SPDLOG_LOGGER_WARN(Logger::instance(), "Skipping malformed OVSDB message");
+                continue;
+            }
+            return message;
+        }
+        char chunk[OVSDB_READ_CHUNK];
+        const ssize_t n = ::read(m_fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return std::nullopt;
+        }
+        m_buffer.append(chunk, static_cast<size_t>(n));
+    }
+}
+
+bool
+OvsdbMonitor::handle(const nlohmann::json& message)
+{
+    const std::string method = message.value("method", "");
+    if (method == "echo")
+    {
+        send({{"id", message.at("id")}, {"result", message.at("params")}, {"error", nullptr}});
+        return true;
+    }
+    if (method == "update")
+    {
+        // params: [<json-value> given with the monitor request, <table-updates>]
+        const nlohmann::json& params = message.at("params");
+        if (params.is_array() && params.size() == 2)
+        {
+            apply(params[1], false);
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+OvsdbMonitor::apply(const nlohmann::json& updates, bool initial)
+{
+    std::shared_ptr<OvsdbState> next;
+    {
+        std::lock_guard lock(m_stateMutex);
+        next = initial ? std::make_shared<OvsdbState>() : std::make_shared<OvsdbState>(*m_state);
+    }
+
+    // A row update without "new" is a deletion; "new" holds every monitored column
+    if (auto table = updates.find("Interface"); table != updates.end())
+    {
+        for (const auto& [uuid, row] : table->items())
+        {
+            auto newRow = row.find("new");
+            if (newRow == row.end())
+            {
+                next->interfaces.erase(uuid);
+                continue;
+            }
+            next->interfaces[uuid] = {newRow->value("name", ""),
+                                      integerColumn(*newRow, "ifindex"),
+                                      integerColumn(*newRow, "ofport")};
+        }
+    }
+    if (auto table = updates.find("Bridge"); table != updates.end())
+    {
+        for (const auto& [uuid, row] : table->items())
+        {
+            auto newRow = row.find("new");
+            if (newRow == row.end())
+            {
+                next->bridges.erase(uuid);
+                continue;
+            }
+            next->bridges[uuid] = newRow->value("name", "");
+        }
+    }
+    next->version = m_updates.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    std::shared_ptr<const OvsdbState> published = std::move(next);
+    {
+        std::lock_guard lock(m_stateMutex);
+        m_state = published;
+    }
+    std::lock_guard lock(m_listenersMutex);
+    for (const auto& [id, listener] : m_listeners)
+    {
+        listener(*published);
+    }
+}
+
+void
+OvsdbMonitor::run()
+{
+    utils::ThreadRegistry::Scope thread("ovsdb");
+    while (!m_stop.requested())
+    {
+        std::optional<nlohmann::json> message = readMessage();
+        if (message)
+        {
+            thread.wake();
+            if (!handle(*message))
+            {
+                SPDLOG_LOGGER_DEBUG(Logger::instance(),
+                                    "Ignoring OVSDB message {}",
+                                    message->dump());
+            }
+            thread.idle();
+            continue;
+        }
+
+        // The server went away (or stop() shut the socket): keep the last state and reconnect
+        m_connected.store(false, std::memory_order_relaxed);
+        {
+            std::lock_guard lock(m_fdMutex);
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        if (m_stop.requested())
+        {
+            break;
+        }
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Lost the OVSDB connection, reconnecting");
+        while (m_stop.waitFor(std::chrono::milliseconds(OVSDB_RECONNECT_MS)))
+        {
+            if (openSession())
+            {
+                m_reconnects.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+        }
+    }
+}
+
+std::shared_ptr<const OvsdbState>
+OvsdbMonitor::state() const
+{
+    std::lock_guard lock(m_stateMutex);
+    return m_state;
+}
+
+std::vector<std::string>
+OvsdbMonitor::bridgeNames() const
+{
+    std::shared_ptr<const OvsdbState> current = state();
+    std::vector<std::string> names;
+    names.reserve(current->bridges.size());
+    for (const auto& [uuid, name] : current->bridges)
+    {
+        names.push_back(name);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+uint64_t
+OvsdbMonitor::subscribe(Listener listener)
+{
+    std::lock_guard lock(m_listenersMutex);
+    listener(*state());
+    const uint64_t id = m_nextListener++;
+    m_listeners.emplace(id, std::move(listener));
+    return id;
+}
+
+void
+OvsdbMonitor::unsubscribe(uint64_t id)
+{
+    std::lock_guard lock(m_listenersMutex);
+    m_listeners.erase(id);
+}
+
+nlohmann::json
+OvsdbMonitor::statsJson() const
+{
+    std::shared_ptr<const OvsdbState> current = state();
+    return {{"connected", m_connected.load(std::memory_order_relaxed)},
+            {"interfaces", current->interfaces.size()},
+            {"bridges", current->bridges.size()},
+            {"updates", m_updates.load(std::memory_order_relaxed)},
+            {"reconnects", m_reconnects.load(std::memory_order_relaxed)}};
+}
+
+} // namespace utils
@@ -0,0 +1,340 @@
+#include "utils/Profiler.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <linux/perf_event.h>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#ifdef NDT_HAVE_GPERFTOOLS
+#include <gperftools/malloc_extension.h>
+#endif
+
+namespace utils
+{
+
+namespace
+{
+
+/// One thread's sampling event and the ring the kernel writes its samples to.
+struct ThreadSampler
+{
+    int fd = -1;
+    void* ring = nullptr;
+    size_t ringBytes = 0;
+
+    ThreadSampler() = default;
+    ThreadSampler(const ThreadSampler&) = delete;
+    ThreadSampler& operator=(const ThreadSampler&) = delete;
+
+    ~ThreadSampler()
+    {
+        if (ring)
+        {
+            ::munmap(ring, ringBytes);
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+};
+
+std::vector<pid_t>
+processThreads()
+{
+    std::vector<pid_t> tids;
+    DIR* dir = ::opendir("/proc/self/task");
+    if (!dir)
+    {
+        return tids;
+    }
+    while (dirent* entry = ::readdir(dir))
+    {
+        if (entry->d_name[0] != '.')
+        {
+            tids.push_back(static_cast<pid_t>(std::strtol(entry->d_name, nullptr, 10)));
+        }
+    }
+    ::closedir(dir);
+    return tids;
+}
+
+// Sampling event of thread @p tid; errno set and nullptr on failure
+std::unique_ptr<ThreadSampler>
+openSampler(pid_t tid, unsigned hz)
+{
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    // The software clock works without a PMU, in VMs and containers alike
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_CPU_CLOCK;
+    attr.freq = 1;
+    attr.sample_freq = hz;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_callchain_kernel = 1;
+    attr.disabled = 1;
+
+    auto sampler = std::make_unique<ThreadSampler>();
+    sampler->fd = static_cast<int>(
+        ::syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    if (sampler->fd < 0)
+    {
+        return nullptr;
+    }
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    sampler->ringBytes = (PROFILER_RING_PAGES + 1) * page;
+    void* ring =
+        ::mmap(nullptr, sampler->ringBytes, PROT_READ | PROT_WRITE, MAP_SHARED, sampler->fd, 0);
+    if (ring == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    sampler->ring = ring;
+    ::ioctl(sampler->fd, PERF_EVENT_IOC_ENABLE, 0);
+    return sampler;
+}
+
+using Stacks = std::map<std::vector<uint64_t>, uint64_t>; // leaf first -> samples
+
+// Take the records the kernel wrote to @p sampler's ring since the last call
+void
+drain(ThreadSampler& sampler, Stacks& stacks, uint64_t& lost)
+{
+    auto* meta = static_cast<perf_event_mmap_page*>(sampler.ring);
+    const auto* data = static_cast<const uint8_t*>(sampler.ring) + meta->data_offset;
+    const uint64_t size = meta->data_size;
+    const uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+    uint64_t tail = meta->data_tail;
+
+    std::vector<uint8_t> record;
+    while (tail < head)
+    {
+        perf_event_header header;
+        for (size_t i = 0; i < sizeof(header); ++i)
+        {
+            reinterpret_cast<uint8_t*>(&header)[i] = data[(tail + i) % size];
+        }
+        if (header.size < sizeof(header))
+        {
+            break;
+        }
+        record.resize(header.size);
+        for (size_t i = 0; i < header.size; ++i)
+        {
+            record[i] = data[(tail + i) % size];
+        }
+        tail += header.size;
+
+        if (header.type == PERF_RECORD_LOST && header.size >= sizeof(header) + 16)
+        {
+            uint64_t count = 0;
+            std::memcpy(&count, record.data() + sizeof(header) + 8, sizeof(count));
+            lost += count;
+            continue;
+        }
+        if (header.type != PERF_RECORD_SAMPLE)
+        {
+            continue;
+        }
+        // u32 pid, tid; u64 nr; u64 ips[nr]
+        const size_t ipsAt = sizeof(header) + 8 + 8;
+        if (header.size < ipsAt)
+        {
+            continue;
+        }
+        uint64_t nr = 0;
+        std::memcpy(&nr, record.data() + sizeof(header) + 8, sizeof(nr));
+        nr = std::min<uint64_t>(nr, (header.size - ipsAt) / 8);
+        std::vector<uint64_t> stack;
+        stack.reserve(nr);
+        for (uint64_t i = 0; i < nr; ++i)
+        {
+            uint64_t ip = 0;
+            std::memcpy(&ip, record.data() + ipsAt + i * 8, sizeof(ip));
+            if (ip < PERF_CONTEXT_MAX) // not a PERF_CONTEXT_USER/KERNEL marker
+            {
+                stack.push_back(ip);
+            }
+        }
+        if (!stack.empty())
+        {
+            ++stacks[std::move(stack)];
+        }
+    }
+    __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+void
+appendWord(std::string& out, uint64_t word)
+{
+    out.append(reinterpret_cast<const char*>(&word), sizeof(word));
+}
+
+// gperftools CPU profile: header, one record per stack, trailer, then the mappings
+std::string
+encodeCpuProfile(const Stacks& stacks, unsigned hz)
+{
+    std::string out;
+    for (uint64_t word : {0ULL, 3ULL, 0ULL, 1000000ULL / hz, 0ULL})
+    {
+        appendWord(out, word);
+    }
+    for (const auto& [stack, count] : stacks)
+    {
+        appendWord(out, count);
+        appendWord(out, stack.size());
+        for (uint64_t ip : stack)
+        {
+            appendWord(out, ip);
+        }
+    }
+    for (uint64_t word : {0ULL, 1ULL, 0ULL})
+    {
+        appendWord(out, word);
+    }
+    std::ifstream maps("/proc/self/maps");
+    out.append(std::istreambuf_iterator<char>(maps), std::istreambuf_iterator<char>());
+    return out;
+}
+
+} // namespace
+
+Profiler&
+Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void
+Profiler::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool
+Profiler::enabled() const
+{
+    return m_enabled;
+}
+
+std::optional<std::string>
+Profiler::cpuProfile(std::chrono::seconds duration, unsigned hz)
+{
+    std::unique_lock running(m_running, std::try_to_lock);
+    if (!running)
+    {
+        return std::nullopt;
+    }
+    hz = std::clamp(hz, 1U, static_cast<unsigned>(PROFILER_MAX_HZ));
+
+    std::unordered_map<pid_t, std::unique_ptr<ThreadSampler>> samplers;
+    int lastError = 0;
+    auto addThreads = [&] {
+        for (pid_t tid : processThreads())
+        {
+            if (samplers.count(tid))
+            {
+                continue;
+            }
+            auto sampler = openSampler(tid, hz);
+            if (!sampler)
+            {
+                // The thread may have exited meanwhile; it is not tried again
+                lastError = errno;
+            }
+            samplers.emplace(tid, std::move(sampler));
+        }
+    };
+    addThreads();
+    size_t sampled = 0;
+    for (const auto& [tid, sampler] : samplers)
+    {
+        sampled += sampler != nullptr;
+    }
+    if (sampled == 0)
+    {
+        throw ProfilerUnavailable(std::string("perf_event_open failed: ") +
+                                  std::strerror(lastError) +
+                                  " (see /proc/sys/kernel/perf_event_paranoid)");
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "CPU profile of {} threads for {} s at {} Hz",
+                       sampled,
+                       duration.count(),
+                       hz);
+
+    Stacks stacks;
+    uint64_t lost = 0;
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(PROFILER_DRAIN_MS));
+        for (auto& [tid, sampler] : samplers)
+        {
+            if (sampler)
+            {
+                drain(*sampler, stacks, lost);
+            }
+        }
+        addThreads();
+    }
+    for (auto& [tid, sampler] : samplers)
+    {
+        if (sampler)
+        {
+            ::ioctl(sampler->fd, PERF_EVENT_IOC_DISABLE, 0);
+            drain(*sampler, stacks, lost);
+        }
+    }
+
+    ++m_profiles;
+    m_lastLost = lost;
+    return encodeCpuProfile(stacks, hz);
+}
+
+std::optional<std::string>
+Profiler::heapProfile()
+{
+#ifdef NDT_HAVE_GPERFTOOLS
+    std::unique_lock running(m_running, std::try_to_lock);
+    if (!running)
+    {
+        return std::nullopt;
+    }
+    std::string out;
+    MallocExtension::instance()->GetHeapSample(&out);
+    ++m_profiles;
+    return out;
+#else
+    throw ProfilerUnavailable("Built without gperftools (configure with -DNDT_GPERFTOOLS=ON)");
+#endif
+}
+
+uint64_t
+Profiler::profilesTaken() const
+{
+    return m_profiles;
+}
+
+uint64_t
+Profiler::lastLostSamples() const
+{
+    return m_lastLost;
+}
+
+} // namespace utils
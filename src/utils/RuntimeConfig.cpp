@@ -0,0 +1,195 @@
+#include "utils/RuntimeConfig.hpp"
+#include "utils/Logger.hpp"
+#include <fstream>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+
+RuntimeConfig&
+RuntimeConfig::instance()
+{
+    static RuntimeConfig config;
+    return config;
+}
+
+bool
+RuntimeConfig::load(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Cannot read runtime configuration {}", path);
+        return false;
+    }
+    nlohmann::json file = nlohmann::json::parse(in, nullptr, false);
+    if (!file.is_object())
+    {
+        SPDLOG_LOGGER_ERROR(
+            Logger::instance(), "Runtime configuration {} is not a JSON object; ignored", path);
+        return false;
+    }
+    std::lock_guard lock(m_mutex);
+    m_file = std::move(file);
+    SPDLOG_LOGGER_INFO(
+        Logger::instance(), "Runtime configuration {}: {} parameters", path, m_file.size());
+    return true;
+}
+
+std::string
+RuntimeConfig::invalid(const Parameter& param, const nlohmann::json& value)
+{
+    if (std::holds_alternative<std::string>(param.defaultValue))
+    {
+        return value.is_string() && !value.get_ref<const std::string&>().empty()
+                   ? ""
+                   : "expected a non-empty string";
+    }
+    if (!value.is_number_integer())
+    {
+        return "expected an integer";
+    }
+    const int64_t v = value.get<int64_t>();
+    if (v < param.min || v > param.max)
+    {
+        return "expected " + std::to_string(param.min) + ".." + std::to_string(param.max);
+    }
+    return "";
+}
+
+RuntimeConfig::Value
+RuntimeConfig::define(const std::string& name, Parameter param)
+{
+    std::lock_guard lock(m_mutex);
+    auto it = m_parameters.find(name);
+    if (it != m_parameters.end())
+    {
+        // Defined again (a subsystem restarted): keep the value, take the new callback
+        it->second.onChange = std::move(param.onChange);
+        return it->second.value;
+    }
+    param.value = param.defaultValue;
+    if (auto configured = m_file.find(name); configured != m_file.end())
+    {
+        const std::string error = invalid(param, *configured);
+        if (error.empty() && configured->is_string())
+        {
+            param.value = configured->get<std::string>();
+        }
+        else if (error.empty())
+        {
+            param.value = configured->get<int64_t>();
+        }
+        else
+        {
+            SPDLOG_LOGGER_ERROR(Logger::instance(),
+                                "Runtime configuration: {} = {}: {}; using the default",
+                                name,
+                                configured->dump(),
+                                error);
+        }
+    }
+    return m_parameters.emplace(name, std::move(param)).first->second.value;
+}
+
+int64_t
+RuntimeConfig::defineInt(const std::string& name,
+                         const std::string& help,
+                         int64_t defaultValue,
+                         int64_t min,
+                         int64_t max,
+                         OnChange onChange)
+{
+    Parameter param{help, {}, defaultValue, min, max, std::move(onChange)};
+    return std::get<int64_t>(define(name, std::move(param)));
+}
+
+std::string
+RuntimeConfig::defineString(const std::string& name,
+                            const std::string& help,
+                            const std::string& defaultValue)
+{
+    Parameter param{help, {}, defaultValue, 0, 0, {}};
+    return std::get<std::string>(define(name, std::move(param)));
+}
+
+std::string
+RuntimeConfig::set(const nlohmann::json& changes)
+{
+    if (!changes.is_object() || changes.empty())
+    {
+        return "expected a JSON object of parameter values";
+    }
+    std::vector<std::pair<OnChange, int64_t>> apply;
+    {
+        std::lock_guard lock(m_mutex);
+        for (const auto& [name, value] : changes.items())
+        {
+            auto it = m_parameters.find(name);
+            if (it == m_parameters.end())
+            {
+                return name + ": unknown parameter";
+            }
+            if (!it->second.onChange)
+            {
+                return name + ": only read at startup; set it in the configuration file";
+            }
+            if (std::string error = invalid(it->second, value); !error.empty())
+            {
+                return name + ": " + error;
+            }
+        }
+        for (const auto& [name, value] : changes.items())
+        {
+            Parameter& param = m_parameters.at(name);
+            param.value = value.get<int64_t>();
+            apply.emplace_back(param.onChange, value.get<int64_t>());
+        }
+    }
+    for (const auto& [onChange, value] : apply)
+    {
+        onChange(value);
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Runtime configuration changed: {}", changes.dump());
+    return "";
+}
+
+std::vector<std::string>
+RuntimeConfig::undefinedNames() const
+{
+    std::lock_guard lock(m_mutex);
+    std::vector<std::string> names;
+    for (const auto& [name, value] : m_file.items())
+    {
+        if (!m_parameters.contains(name))
+        {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+nlohmann::json
+RuntimeConfig::toJson() const
+{
+    std::lock_guard lock(m_mutex);
+    nlohmann::json out = nlohmann::json::object();
+    for (const auto& [name, param] : m_parameters)
+    {
+        nlohmann::json entry;
+        std::visit([&entry](const auto& v) { entry["value"] = v; }, param.value);
+        std::visit([&entry](const auto& v) { entry["default"] = v; }, param.defaultValue);
+        if (std::holds_alternative<int64_t>(param.defaultValue))
+        {
+            entry["min"] = param.min;
+            entry["max"] = param.max;
+        }
+        entry["live"] = static_cast<bool>(param.onChange);
+        entry["help"] = param.help;
+        out[name] = std::move(entry);
+    }
+    return out;
+}
+
+} // namespace utils
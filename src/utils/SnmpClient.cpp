@@ -0,0 +1,701 @@
+#include "utils/SnmpClient.hpp"
+#include "utils/Logger.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include <arpa/inet.h>
+#include <boost/asio/ip/address_v4.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <climits>
+#include <exception>
+#include <future>
+#include <stdexcept>
+
+namespace asio = boost::asio;
+using udp = asio::ip::udp;
+
+namespace utils
+{
+
+namespace
+{
+
+// BER tags of SNMPv2c (RFC 3416)
+constexpr uint8_t BER_INTEGER = 0x02;
+constexpr uint8_t BER_OCTET_STRING = 0x04;
+constexpr uint8_t BER_NULL = 0x05;
+constexpr uint8_t BER_OID = 0x06;
+constexpr uint8_t BER_SEQUENCE = 0x30;
+constexpr uint8_t BER_COUNTER32 = 0x41;
+constexpr uint8_t BER_GAUGE32 = 0x42;
+constexpr uint8_t BER_TIMETICKS = 0x43;
+constexpr uint8_t BER_OPAQUE = 0x44;
+constexpr uint8_t BER_COUNTER64 = 0x46;
+constexpr uint8_t BER_NO_SUCH_OBJECT = 0x80;
+constexpr uint8_t BER_NO_SUCH_INSTANCE = 0x81;
+constexpr uint8_t BER_END_OF_MIB_VIEW = 0x82;
+constexpr uint8_t PDU_GET = 0xA0;
+constexpr uint8_t PDU_RESPONSE = 0xA2;
+constexpr uint8_t PDU_SET = 0xA3;
+constexpr uint8_t PDU_GET_BULK = 0xA5;
+constexpr int64_t SNMP_VERSION_2C = 1;
+
+void
+appendTlv(std::string& out, uint8_t tag, const std::string& content)
+{
+    out += static_cast<char>(tag);
+    const size_t length = content.size();
+    if (length < 0x80)
+    {
+        out += static_cast<char>(length);
+    }
+    else
+    {
+        // Long form: 0x80 | count, then the length big-endian
+        unsigned char bytes[sizeof(size_t)];
+        size_t count = 0;
+        for (size_t rest = length; rest != 0; rest >>= 8)
+        {
+            bytes[count++] = static_cast<unsigned char>(rest & 0xFF);
+        }
+        out += static_cast<char>(0x80 | count);
+        while (count != 0)
+        {
+            out += static_cast<char>(bytes[--count]);
+        }
+    }
+    out += content;
+}
+
+std::string
+encodeInteger(int64_t value)
+{
+    // Shortest two's complement: drop leading bytes that only repeat the sign
+    unsigned char bytes[8];
+    for (int i = 7; i >= 0; --i)
+    {
+        bytes[i] = static_cast<unsigned char>(value & 0xFF);
+        value >>= 8;
+    }
+    int first = 0;
+    while (first < 7 && ((bytes[first] == 0x00 && !(bytes[first + 1] & 0x80)) ||
+                         (bytes[first] == 0xFF && (bytes[first + 1] & 0x80))))
+    {
+        ++first;
+    }
+    std::string content(reinterpret_cast<const char*>(bytes + first), 8 - first);
+    std::string out;
+    appendTlv(out, BER_INTEGER, content);
+    return out;
+}
+
+void
+appendBase128(std::string& out, uint32_t value)
+{
+    unsigned char bytes[5];
+    int count = 0;
+    do
+    {
+        bytes[count++] = static_cast<unsigned char>(value & 0x7F);
+        value >>= 7;
+    } while (value != 0);
+    while (count > 1)
+    {
+        out += static_cast<char>(bytes[--count] | 0x80);
+    }
+    out += static_cast<char>(bytes[0]);
+}
+
+std::string
+encodeOid(const SnmpOid& oid)
+{
+    std::string content;
+    appendBase128(content, oid[0] * 40 + oid[1]);
+    for (size_t i = 2; i < oid.size(); ++i)
+    {
+        appendBase128(content, oid[i]);
+    }
+    std::string out;
+    appendTlv(out, BER_OID, content);
+    return out;
+}
+
+// A GetRequest or SetRequest (@p a, @p b = error-status, error-index) or GetBulkRequest
+// (non-repeaters, max-repetitions) for @p oids, wrapped in its message. A SetRequest gives
+// each OID the INTEGER of the same index in @p integers, the others NULL.
+std::string
+encodeRequest(const std::string& community,
+              uint8_t pdu,
+              int32_t requestId,
+              int64_t a,
+              int64_t b,
+              const std::vector<SnmpOid>& oids,
+              const std::vector<int64_t>& integers = {})
+{
+    std::string varbinds;
+    for (size_t i = 0; i < oids.size(); ++i)
+    {
+        std::string value;
+        if (pdu == PDU_SET)
+        {
+            value = encodeInteger(integers[i]);
+        }
+        else
+        {
+            appendTlv(value, BER_NULL, {});
+        }
+        appendTlv(varbinds, BER_SEQUENCE, encodeOid(oids[i]) + value);
+    }
+    std::string pduContent = encodeInteger(requestId) + encodeInteger(a) + encodeInteger(b);
+    appendTlv(pduContent, BER_SEQUENCE, varbinds);
+
+    std::string message = encodeInteger(SNMP_VERSION_2C);
+    appendTlv(message, BER_OCTET_STRING, community);
+    appendTlv(message, pdu, pduContent);
+    std::string out;
+    appendTlv(out, BER_SEQUENCE, message);
+    return out;
+}
+
+// Bytes left to decode
+struct BerSpan
+{
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+// Take one TLV off the front of @p in
+bool
+readTlv(BerSpan& in, uint8_t& tag, BerSpan& content)
+{
+    if (in.size < 2)
+    {
+        return false;
+    }
+    tag = in.data[0];
+    size_t length = in.data[1];
+    size_t header = 2;
+    if (length & 0x80)
+    {
+        const size_t count = length & 0x7F;
+        if (count == 0 || count > 4 || in.size < 2 + count)
+        {
+            return false;
+        }
+        length = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            length = (length << 8) | in.data[2 + i];
+        }
+        header += count;
+    }
+    if (in.size - header < length)
+    {
+        return false;
+    }
+    content = {in.data + header, length};
+    in.data += header + length;
+    in.size -= header + length;
+    return true;
+}
+
+bool
+readExpected(BerSpan& in, uint8_t expected, BerSpan& content)
+{
+    uint8_t tag = 0;
+    return readTlv(in, tag, content) && tag == expected;
+}
+
+// INTEGER is signed; the application types (Counter32, Gauge32, ...) are unsigned
+bool
+decodeInteger(BerSpan content, bool isSigned, int64_t& value)
+{
+    if (content.size == 0 || content.size > 9)
+    {
+        return false;
+    }
+    uint64_t bits = isSigned && (content.data[0] & 0x80) ? ~uint64_t{0} : 0;
+    for (size_t i = 0; i < content.size; ++i)
+    {
+        bits = (bits << 8) | content.data[i];
+    }
+    value = static_cast<int64_t>(bits);
+    return true;
+}
+
+bool
+readInteger(BerSpan& in, int64_t& value)
+{
+    BerSpan content;
+    return readExpected(in, BER_INTEGER, content) && decodeInteger(content, true, value);
+}
+
+bool
+decodeOid(BerSpan content, SnmpOid& oid)
+{
+    oid.clear();
+    uint64_t arc = 0;
+    for (size_t i = 0; i < content.size; ++i)
+    {
+        arc = (arc << 7) | (content.data[i] & 0x7F);
+        if (arc > UINT32_MAX)
+        {
+            return false;
+        }
+        if (!(content.data[i] & 0x80))
+        {
+            if (oid.empty())
+            {
+                // The first subidentifier packs two arcs
+                const uint32_t first = arc < 80 ? static_cast<uint32_t>(arc / 40) : 2;
+                oid.push_back(first);
+                oid.push_back(static_cast<uint32_t>(arc - first * 40));
+            }
+            else
+            {
+                oid.push_back(static_cast<uint32_t>(arc));
+            }
+            arc = 0;
+        }
+    }
+    return !oid.empty() && arc == 0;
+}
+
+// A decoded Response PDU
+struct DecodedResponse
+{
+    int32_t requestId = 0;
+    int64_t errorStatus = 0;
+    std::vector<SnmpVarBind> values;
+    std::vector<uint8_t> types; // BER tag of each value
+};
+
+bool
+decodeResponse(BerSpan datagram, DecodedResponse& out)
+{
+    BerSpan message, pdu, field;
+    int64_t version = 0;
+    int64_t requestId = 0;
+    int64_t errorIndex = 0;
+    if (!readExpected(datagram, BER_SEQUENCE, message) || !readInteger(message, version) ||
+        version != SNMP_VERSION_2C || !readExpected(message, BER_OCTET_STRING, field) ||
+        !readExpected(message, PDU_RESPONSE, pdu) || !readInteger(pdu, requestId) ||
+        !readInteger(pdu, out.errorStatus) || !readInteger(pdu, errorIndex))
+    {
+        return false;
+    }
+    out.requestId = static_cast<int32_t>(requestId);
+
+    BerSpan varbinds, varbind, oid, value;
+    if (!readExpected(pdu, BER_SEQUENCE, varbinds))
+    {
+        return false;
+    }
+    while (varbinds.size != 0)
+    {
+        uint8_t type = 0;
+        SnmpVarBind bind;
+        if (!readExpected(varbinds, BER_SEQUENCE, varbind) ||
+            !readExpected(varbind, BER_OID, oid) || !decodeOid(oid, bind.oid) ||
+            !readTlv(varbind, type, value))
+        {
+            return false;
+        }
+        switch (type)
+        {
+        case BER_INTEGER:
+        case BER_COUNTER32:
+        case BER_GAUGE32:
+        case BER_TIMETICKS:
+        case BER_COUNTER64: {
+            int64_t number = 0;
+            if (!decodeInteger(value, type == BER_INTEGER, number))
+            {
+                return false;
+            }
+            bind.integer = number;
+            break;
+        }
+        case BER_OCTET_STRING:
+        case BER_OPAQUE:
+            bind.octets.assign(reinterpret_cast<const char*>(value.data), value.size);
+            break;
+        default:
+            break;
+        }
+        out.values.push_back(std::move(bind));
+        out.types.push_back(type);
+    }
+    return true;
+}
+
+bool
+isException(uint8_t type)
+{
+    return type == BER_NO_SUCH_OBJECT || type == BER_NO_SUCH_INSTANCE ||
+           type == BER_END_OF_MIB_VIEW;
+}
+
+bool
+inSubtree(const SnmpOid& root, const SnmpOid& oid)
+{
+    return oid.size() > root.size() && std::equal(root.begin(), root.end(), oid.begin());
+}
+
+void
+validate(const SnmpQuery& query)
+{
+    if (query.kind == SnmpQuery::Kind::Walk ? query.oids.size() != 1 : query.oids.empty())
+    {
+        throw std::invalid_argument("SNMP walk needs one OID, a GET at least one");
+    }
+    if (query.kind == SnmpQuery::Kind::Set && query.integers.size() != query.oids.size())
+    {
+        throw std::invalid_argument("SNMP SET needs one value per OID");
+    }
+    for (const auto& oid : query.oids)
+    {
+        if (oid.size() < 2 || oid[0] > 2 || (oid[0] < 2 && oid[1] >= 40))
+        {
+            throw std::invalid_argument("Malformed SNMP OID");
+        }
+    }
+}
+
+} // namespace
+
+SnmpOid
+parseSnmpOid(const std::string& dotted)
+{
+    SnmpOid oid;
+    size_t pos = dotted.empty() || dotted[0] != '.' ? 0 : 1;
+    while (pos < dotted.size())
+    {
+        size_t end = dotted.find('.', pos);
+        if (end == std::string::npos)
+        {
+            end = dotted.size();
+        }
+        if (end == pos || dotted.find_first_not_of("0123456789", pos) < end)
+        {
+            throw std::invalid_argument("Malformed SNMP OID: " + dotted);
+        }
+        const unsigned long arc = std::stoul(dotted.substr(pos, end - pos));
+        if (arc > UINT32_MAX)
+        {
+            throw std::invalid_argument("Malformed SNMP OID: " + dotted);
+        }
+        oid.push_back(static_cast<uint32_t>(arc));
+        pos = end + 1;
+    }
+    if (oid.size() < 2)
+    {
+        throw std::invalid_argument("Malformed SNMP OID: " + dotted);
+    }
+    return oid;
+}
+
+std::optional<int64_t>
+SnmpResponse::integer(const SnmpOid& oid) const
+{
+    if (oid.empty())
+    {
+        return values.empty() ? std::nullopt : values.front().integer;
+    }
+    for (const auto& value : values)
+    {
+        if (value.oid == oid)
+        {
+            return value.integer;
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief One SnmpQuery in flight: its attempts and, for a walk, the GETBULKs after the first.
+ *        Lives on the client thread.
+ */
+class SnmpClient::Operation
+{
+  public:
+    Operation(asio::io_context& ioc,
+              SnmpQuery query,
+              Callback done,
+              const SnmpRequestOptions& options)
+        : query(std::move(query)),
+          done(std::move(done)),
+          options(options),
+          agent(asio::ip::address_v4(ntohl(this->query.agentIp)), SNMP_CLIENT_PORT),
+          timer(ioc),
+          cursor(this->query.oids.front())
+    {
+    }
+
+    SnmpQuery query;
+    Callback done;
+    SnmpRequestOptions options;
+    udp::endpoint agent;
+    asio::steady_timer timer;
+    SnmpOid cursor;         // walk: the last OID received, where the next GETBULK starts
+    int32_t requestId = 0;  // of the request in flight
+    unsigned attempt = 0;   // of the request in flight
+    bool finished = false;
+    SnmpResponse response;
+};
+
+SnmpClient&
+SnmpClient::instance()
+{
+    static SnmpClient client;
+    return client;
+}
+
+SnmpClient::SnmpClient()
+    : m_ioc(1),
+      m_work(asio::make_work_guard(m_ioc)),
+      m_socket(m_ioc, udp::v4()),
+      m_receiveBuffer(SNMP_CLIENT_MAX_DATAGRAM)
+{
+    receive();
+    m_thread = std::thread([this] {
+        ThreadRegistry::Scope thread("snmp-client");
+        for (;;)
+        {
+            try
+            {
+                m_ioc.run();
+                return;
+            }
+            catch (const std::exception& e)
+            {
+                SPDLOG_LOGGER_ERROR(Logger::instance(), "SnmpClient callback threw: {}", e.what());
+            }
+        }
+    });
+}
+
+SnmpClient::~SnmpClient()
+{
+    m_work.reset();
+    m_ioc.stop();
+    m_thread.join();
+}
+
+void
+SnmpClient::asyncQuery(SnmpQuery query, Callback done, const SnmpRequestOptions& options)
+{
+    validate(query);
+    auto op = std::make_shared<Operation>(m_ioc, std::move(query), std::move(done), options);
+    m_inFlight.fetch_add(1, std::memory_order_relaxed);
+    asio::post(m_ioc, [this, op] { send(op); });
+}
+
+std::vector<SnmpResponse>
+SnmpClient::query(std::vector<SnmpQuery> queries, const SnmpRequestOptions& options)
+{
+    // The callbacks waited for would have to run on this very thread
+    if (m_ioc.get_executor().running_in_this_thread())
+    {
+        throw std::logic_error("SnmpClient::query() called from an SnmpClient callback");
+    }
+    for (const auto& query : queries)
+    {
+        validate(query);
+    }
+
+    std::vector<std::future<SnmpResponse>> futures;
+    futures.reserve(queries.size());
+    for (auto& query : queries)
+    {
+        auto promise = std::make_shared<std::promise<SnmpResponse>>();
+        futures.push_back(promise->get_future());
+        asyncQuery(
+            std::move(query),
+            [promise](SnmpResponse response) { promise->set_value(std::move(response)); },
+            options);
+    }
+
+    std::vector<SnmpResponse> responses;
+    responses.reserve(futures.size());
+    for (auto& future : futures)
+    {
+        responses.push_back(future.get());
+    }
+    return responses;
+}
+
+void
+SnmpClient::send(const std::shared_ptr<Operation>& op)
+{
+    m_pending.erase(op->requestId);
+    const int32_t requestId = m_nextRequestId;
+    m_nextRequestId = m_nextRequestId == INT32_MAX ? 1 : m_nextRequestId + 1;
+    op->requestId = requestId;
+    m_pending[requestId] = op;
+
+    std::shared_ptr<std::string> datagram;
+    switch (op->query.kind)
+    {
+    case SnmpQuery::Kind::Get:
+        datagram = std::make_shared<std::string>(
+            encodeRequest(op->query.community, PDU_GET, requestId, 0, 0, op->query.oids));
+        break;
+    case SnmpQuery::Kind::Set:
+        // Resent as is after a timeout: setting the same values again is harmless
+        datagram = std::make_shared<std::string>(encodeRequest(op->query.community,
+                                                               PDU_SET,
+                                                               requestId,
+                                                               0,
+                                                               0,
+                                                               op->query.oids,
+                                                               op->query.integers));
+        break;
+    case SnmpQuery::Kind::Walk:
+        datagram = std::make_shared<std::string>(encodeRequest(op->query.community,
+                                                               PDU_GET_BULK,
+                                                               requestId,
+                                                               0,
+                                                               SNMP_CLIENT_MAX_REPETITIONS,
+                                                               {op->cursor}));
+        break;
+    }
+    m_requests.fetch_add(1, std::memory_order_relaxed);
+
+    m_socket.async_send_to(asio::buffer(*datagram),
+                           op->agent,
+                           [this, op, datagram](boost::system::error_code ec, size_t) {
+                               if (ec)
+                               {
+                                   finish(op, ec);
+                               }
+                           });
+
+    op->timer.expires_after(op->options.timeout);
+    op->timer.async_wait([this, op, requestId](boost::system::error_code ec) {
+        if (ec || op->finished || op->requestId != requestId)
+        {
+            return;
+        }
+        if (op->attempt < op->options.retries)
+        {
+            ++op->attempt;
+            m_retries.fetch_add(1, std::memory_order_relaxed);
+            send(op);
+            return;
+        }
+        m_timeouts.fetch_add(1, std::memory_order_relaxed);
+        finish(op, asio::error::timed_out);
+    });
+}
+
+void
+SnmpClient::receive()
+{
+    m_socket.async_receive_from(asio::buffer(m_receiveBuffer),
+                                m_sender,
+                                [this](boost::system::error_code ec, size_t length) {
+                                    if (ec == asio::error::operation_aborted)
+                                    {
+                                        return;
+                                    }
+                                    if (!ec)
+                                    {
+                                        onDatagram(length);
+                                    }
+                                    receive();
+                                });
+}
+
+void
+SnmpClient::onDatagram(size_t length)
+{
+    DecodedResponse decoded;
+    auto it = m_pending.end();
+    if (decodeResponse({m_receiveBuffer.data(), length}, decoded))
+    {
+        it = m_pending.find(decoded.requestId);
+    }
+    if (it == m_pending.end() || it->second->agent.address() != m_sender.address())
+    {
+        m_strayResponses.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_responses.fetch_add(1, std::memory_order_relaxed);
+    std::shared_ptr<Operation> op = it->second;
+
+    if (decoded.errorStatus != 0)
+    {
+        finish(op, boost::system::errc::make_error_code(boost::system::errc::protocol_error));
+        return;
+    }
+
+    if (op->query.kind != SnmpQuery::Kind::Walk)
+    {
+        for (size_t i = 0; i < decoded.values.size(); ++i)
+        {
+            if (!isException(decoded.types[i]))
+            {
+                op->response.values.push_back(std::move(decoded.values[i]));
+            }
+        }
+        finish(op, {});
+        return;
+    }
+
+    // Walk: keep what is still under the root and ask for more from the last of it
+    const SnmpOid& root = op->query.oids.front();
+    for (size_t i = 0; i < decoded.values.size(); ++i)
+    {
+        SnmpVarBind& value = decoded.values[i];
+        if (isException(decoded.types[i]) || !inSubtree(root, value.oid) ||
+            !std::lexicographical_compare(
+                op->cursor.begin(), op->cursor.end(), value.oid.begin(), value.oid.end()))
+        {
+            finish(op, {});
+            return;
+        }
+        op->cursor = value.oid;
+        op->response.values.push_back(std::move(value));
+    }
+    if (decoded.values.empty())
+    {
+        finish(op, {});
+        return;
+    }
+    op->attempt = 0;
+    send(op);
+}
+
+void
+SnmpClient::finish(const std::shared_ptr<Operation>& op, boost::system::error_code ec)
+{
+    if (op->finished)
+    {
+        return;
+    }
+    op->finished = true;
+    m_pending.erase(op->requestId);
+    op->timer.cancel();
+    if (ec && ec != asio::error::timed_out)
+    {
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_inFlight.fetch_sub(1, std::memory_order_relaxed);
+    op->response.error = ec;
+    op->done(std::move(op->response));
+}
+
+nlohmann::json
+SnmpClient::statsJson() const
+{
+    return nlohmann::json{{"requests", m_requests.load(std::memory_order_relaxed)},
+                          {"responses", m_responses.load(std::memory_order_relaxed)},
+                          {"retries", m_retries.load(std::memory_order_relaxed)},
+                          {"timeouts", m_timeouts.load(std::memory_order_relaxed)},
+                          {"errors", m_errors.load(std::memory_order_relaxed)},
+                          {"stray_responses", m_strayResponses.load(std::memory_order_relaxed)},
+                          {"in_flight", m_inFlight.load(std::memory_order_relaxed)}};
+}
+
+} // namespace utils
@@ -0,0 +1,300 @@
+#include "utils/SshSessionPool.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace utils
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Exit status of the ssh client when it could not connect (or the master socket is stale)
+constexpr int SSH_CONNECTION_ERROR = 255;
+
+struct SpawnResult
+{
+    std::string output;
+    int exitStatus = -1; // -1 when killed or not started
+    bool timedOut = false;
+};
+
+// Run @p args (args[0] is looked up in PATH) with @p lines written to its stdin
+// SSH_POOL_COMMAND_GAP_MS apart, collecting its stdout; killed after @p timeout
+SpawnResult
+spawn(const std::vector<std::string>& args,
+      const std::vector<std::string>& lines,
+      std::chrono::milliseconds timeout)
+{
+    SpawnResult result;
+    std::vector<char*> argv;
+    for (const std::string& arg : args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    int in[2];
+    int out[2];
+    if (::pipe2(in, O_CLOEXEC) != 0)
+    {
+        return result;
+    }
+    if (::pipe2(out, O_CLOEXEC) != 0)
+    {
+        ::close(in[0]);
+        ::close(in[1]);
+        return result;
+    }
+
+    const pid_t pid = ::fork();
+    if (pid == 0)
+    {
+        // Child: only async-signal-safe calls until exec
+        ::dup2(in[0], STDIN_FILENO);
+        ::dup2(out[1], STDOUT_FILENO);
+        const int devNull = ::open("/dev/null", O_WRONLY);
+        if (devNull >= 0)
+        {
+            ::dup2(devNull, STDERR_FILENO);
+        }
+        ::execvp(argv[0], argv.data());
+        ::_exit(127);
+    }
+    ::close(in[0]);
+    ::close(out[1]);
+    if (pid < 0)
+    {
+        ::close(in[1]);
+        ::close(out[0]);
+        return result;
+    }
+
+    const auto deadline = Clock::now() + timeout;
+    auto nextWrite = Clock::now();
+    size_t nextLine = 0;
+    int writeFd = in[1];
+    for (;;)
+    {
+        auto now = Clock::now();
+        if (writeFd >= 0 && now >= nextWrite)
+        {
+            // The ssh client may be gone already: a failed write just ends the input
+            bool written = true;
+            if (nextLine < lines.size())
+            {
+                const std::string line = lines[nextLine++] + "\n";
+                written = ::write(writeFd, line.data(), line.size()) ==
+                          static_cast<ssize_t>(line.size());
+                nextWrite = now + std::chrono::milliseconds(SSH_POOL_COMMAND_GAP_MS);
+            }
+            if (!written || nextLine == lines.size())
+            {
+                ::close(writeFd);
+                writeFd = -1;
+            }
+        }
+        if (now >= deadline)
+        {
+            result.timedOut = true;
+            break;
+        }
+
+        const auto wakeAt = writeFd >= 0 ? std::min(nextWrite, deadline) : deadline;
+        const auto wait = std::chrono::ceil<std::chrono::milliseconds>(wakeAt - now);
+        pollfd pfd{out[0], POLLIN, 0};
+        const int ready = ::poll(&pfd, 1, static_cast<int>(wait.count()));
+        if (ready < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (ready > 0)
+        {
+            char buffer[4096];
+            const ssize_t n = ::read(out[0], buffer, sizeof(buffer));
+            if (n <= 0)
+            {
+                break; // EOF: the session ended
+            }
+            result.output.append(buffer, static_cast<size_t>(n));
+        }
+    }
+
+    if (writeFd >= 0)
+    {
+        ::close(writeFd);
+    }
+    ::close(out[0]);
+    if (result.timedOut)
+    {
+        ::kill(pid, SIGKILL);
+    }
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    if (WIFEXITED(status))
+    {
+        result.exitStatus = WEXITSTATUS(status);
+    }
+    return result;
+}
+
+} // namespace
+
+SshSessionPool&
+SshSessionPool::instance()
+{
+    static SshSessionPool pool;
+    return pool;
+}
+
+SshSessionPool::SshSessionPool()
+{
+    // A session whose ssh client died must fail its write, not kill the process
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::string dir = (std::filesystem::temp_directory_path() / "ndt-ssh-XXXXXX").string();
+    if (::mkdtemp(dir.data()) != nullptr)
+    {
+        m_controlDir = dir;
+    }
+    else
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(),
+                           "SshSessionPool: no control directory, SSH connections are not reused");
+    }
+}
+
+SshSessionPool::~SshSessionPool()
+{
+    if (m_controlDir.empty())
+    {
+        return;
+    }
+    for (const auto& [destination, device] : m_devices)
+    {
+        closeMaster(destination);
+    }
+    std::error_code ec;
+    std::filesystem::remove_all(m_controlDir, ec);
+}
+
+std::vector<std::string>
+SshSessionPool::sshArgs(const std::string& destination) const
+{
+    std::vector<std::string> args{
+        "ssh",
+        "-T",
+        "-oKexAlgorithms=+diffie-hellman-group1-sha1",
+        "-oCiphers=+aes128-cbc",
+        "-oHostKeyAlgorithms=+ssh-rsa",
+        "-oStrictHostKeyChecking=no",
+        "-oUserKnownHostsFile=/dev/null",
+        "-oBatchMode=yes",
+        "-oConnectTimeout=" + std::to_string(SSH_POOL_CONNECT_TIMEOUT_SECONDS),
+        "-oServerAliveInterval=" + std::to_string(SSH_POOL_KEEPALIVE_SECONDS),
+        "-oServerAliveCountMax=" + std::to_string(SSH_POOL_KEEPALIVE_COUNT)};
+    if (!m_controlDir.empty())
+    {
+        args.push_back("-oControlMaster=auto");
+        args.push_back("-oControlPath=" + m_controlDir + "/%C");
+        args.push_back("-oControlPersist=" + std::to_string(SSH_POOL_PERSIST_SECONDS));
+    }
+    args.push_back(destination);
+    return args;
+}
+
+SshResult
+SshSessionPool::runOnce(const std::string& destination,
+                        const std::vector<std::string>& commands,
+                        bool& connectionError)
+{
+    SpawnResult spawned =
+        spawn(sshArgs(destination), commands, std::chrono::milliseconds(SSH_POOL_TIMEOUT_MS));
+    connectionError = spawned.exitStatus == SSH_CONNECTION_ERROR;
+    SshResult result;
+    result.output = std::move(spawned.output);
+    result.ok = !spawned.timedOut && spawned.exitStatus >= 0 && !connectionError &&
+                spawned.exitStatus != 127;
+    return result;
+}
+
+bool
+SshSessionPool::closeMaster(const std::string& destination)
+{
+    if (m_controlDir.empty())
+    {
+        return false;
+    }
+    std::vector<std::string> args = sshArgs(destination);
+    args.insert(args.end() - 1, {"-O", "exit"});
+    return spawn(args, {}, std::chrono::seconds(SSH_POOL_CONNECT_TIMEOUT_SECONDS)).exitStatus == 0;
+}
+
+SshResult
+SshSessionPool::run(const std::string& host,
+                    const std::string& username,
+                    const std::vector<std::string>& commands)
+{
+    const std::string destination = username + "@" + host;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Device& device = m_devices[destination]; // std::map: stays put while others are added
+        m_cv.wait(lock, [&] { return device.active < SSH_POOL_MAX_SESSIONS_PER_DEVICE; });
+        ++device.active;
+        ++device.sessions;
+    }
+
+    bool connectionError = false;
+    SshResult result = runOnce(destination, commands, connectionError);
+    bool reconnected = false;
+    // A master connection whose switch stopped answering fails every session over it until
+    // closed; when there was none, the switch itself is unreachable and is not tried again
+    if (connectionError && closeMaster(destination))
+    {
+        reconnected = true;
+        result = runOnce(destination, commands, connectionError);
+    }
+    if (!result.ok)
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(), "SshSessionPool: session on {} failed", destination);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Device& device = m_devices[destination];
+        --device.active;
+        device.failures += !result.ok;
+        device.reconnects += reconnected;
+    }
+    m_cv.notify_all();
+    return result;
+}
+
+nlohmann::json
+SshSessionPool::statsJson() const
+{
+    nlohmann::json out = nlohmann::json::object();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [destination, device] : m_devices)
+    {
+        out[destination] = {{"sessions", device.sessions},
+                            {"failures", device.failures},
+                            {"reconnects", device.reconnects},
+                            {"active", device.active}};
+    }
+    return out;
+}
+
+} // namespace utils
@@ -0,0 +1,184 @@
+#include "utils/Startup.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <utility>
+
+namespace utils
+{
+
+Startup&
+Startup::instance()
+{
+    static Startup startup;
+    return startup;
+}
+
+int64_t
+Startup::sinceLaunchMs() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - m_launch)
+        .count();
+}
+
+void
+Startup::finishNoLock(const std::string& name, const std::string& error)
+{
+    Subsystem& subsystem = m_subsystems.at(name);
+    subsystem.startedMs = sinceLaunchMs();
+    if (!error.empty())
+    {
+        subsystem.state = "failed";
+        subsystem.error = error;
+        SPDLOG_LOGGER_ERROR(Logger::instance(), "Startup: {} failed: {}", name, error);
+        return;
+    }
+    if (!subsystem.warmsLater || subsystem.warmMs >= 0)
+    {
+        subsystem.state = "warm";
+        subsystem.warmMs = subsystem.warmMs >= 0 ? subsystem.warmMs : subsystem.startedMs;
+    }
+    else
+    {
+        subsystem.state = "started";
+    }
+    SPDLOG_LOGGER_INFO(
+        Logger::instance(), "Startup: {} started after {} ms", name, subsystem.startedMs);
+}
+
+bool
+Startup::run(std::vector<StartupStep> steps)
+{
+    std::vector<std::string> names;
+    {
+        std::lock_guard lock(m_mutex);
+        for (const StartupStep& step : steps)
+        {
+            m_subsystems[step.name].warmsLater = step.warmsLater;
+            names.push_back(step.name);
+        }
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(steps.size());
+    for (StartupStep& step : steps)
+    {
+        threads.emplace_back(
+            [this, step = std::move(step)]
+            {
+                // Wait for the steps this one comes after, and give up if one of them failed
+                std::string error;
+                {
+                    std::unique_lock lock(m_mutex);
+                    for (const std::string& dependency : step.after)
+                    {
+                        auto it = m_subsystems.find(dependency);
+                        if (it == m_subsystems.end())
+                        {
+                            error = "unknown step " + dependency;
+                            break;
+                        }
+                        m_finished.wait(lock, [&it] { return it->second.startedMs >= 0; });
+                        if (it->second.state == "failed")
+                        {
+                            error = dependency + " failed";
+                            break;
+                        }
+                    }
+                    m_subsystems.at(step.name).state = error.empty() ? "starting" : "failed";
+                }
+                if (error.empty())
+                {
+                    try
+                    {
+                        step.start();
+                    }
+                    catch (const std::exception& e)
+                    {
+                        error = e.what();
+                    }
+                }
+                std::lock_guard lock(m_mutex);
+                finishNoLock(step.name, error);
+                m_finished.notify_all();
+            });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    std::lock_guard lock(m_mutex);
+    const bool failed = std::any_of(names.begin(),
+                                    names.end(),
+                                    [this](const std::string& name)
+                                    { return m_subsystems.at(name).state == "failed"; });
+    if (!failed)
+    {
+        SPDLOG_LOGGER_INFO(Logger::instance(), "Startup: all subsystems started");
+    }
+    return !failed;
+}
+
+void
+Startup::markWarm(const std::string& name)
+{
+    std::lock_guard lock(m_mutex);
+    auto it = m_subsystems.find(name);
+    if (it == m_subsystems.end() || it->second.warmMs >= 0 || it->second.state == "failed")
+    {
+        return;
+    }
+    it->second.warmMs = sinceLaunchMs();
+    if (it->second.startedMs >= 0)
+    {
+        it->second.state = "warm";
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(), "Startup: {} warm after {} ms", name, it->second.warmMs);
+}
+
+bool
+Startup::ready() const
+{
+    std::lock_guard lock(m_mutex);
+    if (m_subsystems.empty())
+    {
+        return false;
+    }
+    for (const auto& [name, subsystem] : m_subsystems)
+    {
+        if (subsystem.state != "warm")
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+nlohmann::json
+Startup::toJson() const
+{
+    nlohmann::json subsystems = nlohmann::json::object();
+    {
+        std::lock_guard lock(m_mutex);
+        for (const auto& [name, subsystem] : m_subsystems)
+        {
+            nlohmann::json entry{{"state", subsystem.state}};
+            if (subsystem.startedMs >= 0 && subsystem.state != "failed")
+            {
+                entry["started_ms"] = subsystem.startedMs;
+            }
+            if (subsystem.warmMs >= 0 && subsystem.state == "warm")
+            {
+                entry["warm_ms"] = subsystem.warmMs;
+            }
+            if (!subsystem.error.empty())
+            {
+                entry["error"] = subsystem.error;
+            }
+            subsystems[name] = std::move(entry);
+        }
+    }
+    return {{"ready", ready()}, {"subsystems", std::move(subsystems)}};
+}
+
+} // namespace utils
@@ -0,0 +1,300 @@
+#include "utils/TaskScheduler.hpp"
+#include "utils/Logger.hpp"
+#include "utils/ThreadRegistry.hpp"
+#include <algorithm>
+
+namespace utils
+{
+
+namespace
+{
+
+// Task whose job this thread is running, so cancel() from the job does not wait for itself
+thread_local TaskScheduler::TaskId t_currentTask = 0;
+
+const char*
+priorityName(TaskPriority priority)
+{
+    switch (priority)
+    {
+    case TaskPriority::High:
+        return "high";
+    case TaskPriority::Normal:
+        return "normal";
+    case TaskPriority::Low:
+        return "low";
+    }
+    return "unknown";
+}
+
+double
+toMs(TaskScheduler::Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+} // namespace
+
+TaskScheduler&
+TaskScheduler::instance()
+{
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    shutdown();
+}
+
+void
+TaskScheduler::configure(TaskSchedulerConfig config)
+{
+    std::lock_guard lock(m_mutex);
+    if (!m_workers.empty())
+    {
+        SPDLOG_LOGGER_WARN(Logger::instance(), "Task scheduler already running, not reconfigured");
+        return;
+    }
+    config.threads = std::max(config.threads, 1u);
+    m_config = std::move(config);
+}
+
+void
+TaskScheduler::startNoLock()
+{
+    if (!m_workers.empty() || m_stopping)
+    {
+        return;
+    }
+    for (size_t i = 0; i < m_config.threads; ++i)
+    {
+        m_workers.emplace_back(&TaskScheduler::work, this, i);
+    }
+    SPDLOG_LOGGER_INFO(Logger::instance(),
+                       "Task scheduler started with {} workers ({} reserved for high priority)",
+                       m_config.threads,
+                       std::min<unsigned>(TASK_SCHEDULER_RESERVED, m_config.threads - 1));
+}
+
+TaskScheduler::TaskId
+TaskScheduler::schedule(std::string name,
+                        TaskPriority priority,
+                        Clock::duration period,
+                        std::function<void()> job,
+                        bool runNow)
+{
+    auto task = std::make_shared<Task>();
+    task->name = std::move(name);
+    task->priority = priority;
+    task->period = std::max<Clock::duration>(period, std::chrono::milliseconds(1));
+    task->job = std::move(job);
+    task->nextRun = runNow ? Clock::now() : Clock::now() + task->period;
+
+    std::lock_guard lock(m_mutex);
+    task->id = m_nextId++;
+    m_tasks.emplace(task->id, task);
+    startNoLock();
+    m_cv.notify_all();
+    return task->id;
+}
+
+TaskScheduler::TaskId
+TaskScheduler::current()
+{
+    return t_currentTask;
+}
+
+void
+TaskScheduler::runAt(TaskId id, Clock::time_point when)
+{
+    std::lock_guard lock(m_mutex);
+    auto it = m_tasks.find(id);
+    if (it == m_tasks.end())
+    {
+        return;
+    }
+    Task& task = *it->second;
+    if (task.running)
+    {
+        // Applied when the run in progress ends
+        task.requestedRun = std::min(task.requestedRun, when);
+    }
+    else if (when < task.nextRun)
+    {
+        task.nextRun = when;
+        m_cv.notify_all();
+    }
+}
+
+void
+TaskScheduler::cancel(TaskId id)
+{
+    std::unique_lock lock(m_mutex);
+    auto it = m_tasks.find(id);
+    if (it == m_tasks.end())
+    {
+        return;
+    }
+    std::shared_ptr<Task> task = it->second;
+    m_tasks.erase(it);
+    if (t_currentTask != id)
+    {
+        m_cv.wait(lock, [&] { return !task->running; });
+    }
+}
+
+void
+TaskScheduler::shutdown()
+{
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+        m_tasks.clear();
+        workers.swap(m_workers);
+    }
+    m_cv.notify_all();
+    for (auto& worker : workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+std::shared_ptr<TaskScheduler::Task>
+TaskScheduler::pickNoLock(Clock::time_point now, Clock::time_point& wakeAt) const
+{
+    const unsigned reserved = std::min<unsigned>(TASK_SCHEDULER_RESERVED, m_config.threads - 1);
+    const bool unreservedFree = m_busyUnreserved < m_config.threads - reserved;
+
+    std::shared_ptr<Task> best;
+    for (const auto& [id, task] : m_tasks)
+    {
+        if (task->running)
+        {
+            continue; // looked at again when the run ends
+        }
+        if (task->nextRun > now)
+        {
+            wakeAt = std::min(wakeAt, task->nextRun);
+            continue;
+        }
+        if (task->priority != TaskPriority::High && !unreservedFree)
+        {
+            continue; // waits for a Normal or Low run to end
+        }
+        if (!best || task->priority < best->priority ||
+            (task->priority == best->priority && task->nextRun < best->nextRun))
+        {
+            best = task;
+        }
+    }
+    return best;
+}
+
+void
+TaskScheduler::work(size_t index)
+{
+    ThreadRegistry::Scope thread("scheduler-" + std::to_string(index), m_config.cpus);
+
+    std::unique_lock lock(m_mutex);
+    while (!m_stopping)
+    {
+        auto wakeAt = Clock::time_point::max();
+        std::shared_ptr<Task> task = pickNoLock(Clock::now(), wakeAt);
+        if (!task)
+        {
+            if (wakeAt == Clock::time_point::max())
+            {
+                m_cv.wait(lock);
+            }
+            else
+            {
+                m_cv.wait_until(lock, wakeAt);
+            }
+            continue;
+        }
+
+        const bool unreserved = task->priority != TaskPriority::High;
+        task->running = true;
+        ++m_busy;
+        m_busyUnreserved += unreserved;
+        const auto due = task->nextRun;
+        lock.unlock();
+
+        thread.wake();
+        const auto start = Clock::now();
+        bool ok = true;
+        t_currentTask = task->id;
+        try
+        {
+            task->job();
+        }
+        catch (const std::exception& e)
+        {
+            ok = false;
+            SPDLOG_LOGGER_ERROR(Logger::instance(), "Task {} threw: {}", task->name, e.what());
+        }
+        catch (...)
+        {
+            ok = false;
+            SPDLOG_LOGGER_ERROR(
+                Logger::instance(), "Task {} threw an unknown exception", task->name);
+        }
+        t_currentTask = 0;
+        const auto end = Clock::now();
+        thread.idle();
+
+        lock.lock();
+        --m_busy;
+        m_busyUnreserved -= unreserved;
+        task->running = false;
+        ++task->runs;
+        task->failures += !ok;
+        task->totalRun += end - start;
+        task->maxRun = std::max(task->maxRun, end - start);
+        task->maxLag = std::max(task->maxLag, start - due);
+
+        auto next = due + task->period;
+        if (next < end)
+        {
+            // Fell behind: run once more now rather than catch up in a burst
+            ++task->lateRuns;
+            next = end;
+        }
+        task->nextRun = std::min(next, task->requestedRun);
+        task->requestedRun = Clock::time_point::max();
+        // Wakes cancel() and the workers a Normal or Low task was waiting for
+        m_cv.notify_all();
+    }
+}
+
+nlohmann::json
+TaskScheduler::statsJson() const
+{
+    std::lock_guard lock(m_mutex);
+    nlohmann::json tasks = nlohmann::json::array();
+    for (const auto& [id, task] : m_tasks)
+    {
+        tasks.push_back(
+            {{"name", task->name},
+             {"priority", priorityName(task->priority)},
+             {"period_ms", toMs(task->period)},
+             {"runs", task->runs},
+             {"failures", task->failures},
+             {"late_runs", task->lateRuns},
+             {"mean_run_ms", task->runs == 0 ? 0.0 : toMs(task->totalRun) / task->runs},
+             {"max_run_ms", toMs(task->maxRun)},
+             {"max_lag_ms", toMs(task->maxLag)}});
+    }
+    return {{"threads", m_config.threads},
+            {"reserved", std::min<unsigned>(TASK_SCHEDULER_RESERVED, m_config.threads - 1)},
+            {"cpus", m_config.cpus},
+            {"busy", m_busy},
+            {"tasks", std::move(tasks)}};
+}
+
+} // namespace utils
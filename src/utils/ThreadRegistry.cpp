@@ -0,0 +1,136 @@
+#include "utils/ThreadRegistry.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace utils
+{
+
+namespace
+{
+
+int64_t
+steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+void
+setThreadName(const std::string& name)
+{
+    pthread_setname_np(pthread_self(), name.substr(0, THREAD_NAME_MAX).c_str());
+}
+
+int
+setThreadAffinity(const std::vector<unsigned>& cpus)
+{
+    if (cpus.empty())
+    {
+        return 0;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (unsigned cpu : cpus)
+    {
+        CPU_SET(cpu, &cpuset);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+}
+
+ThreadRegistry&
+ThreadRegistry::instance()
+{
+    // Never destroyed: the threads of other singletons unregister while those are destroyed
+    static ThreadRegistry* registry = new ThreadRegistry();
+    return *registry;
+}
+
+ThreadRegistry::Scope::Scope(std::string name, const std::vector<unsigned>& cpus)
+    : m_entry(std::make_shared<Entry>())
+{
+    setThreadName(name);
+    if (int rc = setThreadAffinity(cpus); rc != 0)
+    {
+        SPDLOG_LOGGER_WARN(
+            Logger::instance(), "Failed to set the CPUs of thread {}: {}", name, strerror(rc));
+    }
+    m_entry->name = std::move(name);
+    m_entry->tid = static_cast<int64_t>(::syscall(SYS_gettid));
+    m_entry->cpus = cpus;
+    pthread_getcpuclockid(pthread_self(), &m_entry->clock);
+
+    ThreadRegistry& registry = instance();
+    std::lock_guard lock(registry.m_mutex);
+    registry.m_threads.emplace(m_entry.get(), m_entry);
+}
+
+ThreadRegistry::Scope::~Scope()
+{
+    // Before the thread exits: its CPU clock is only valid while it runs
+    ThreadRegistry& registry = instance();
+    std::lock_guard lock(registry.m_mutex);
+    registry.m_threads.erase(m_entry.get());
+}
+
+void
+ThreadRegistry::Scope::wake()
+{
+    m_entry->wakeups.fetch_add(1, std::memory_order_relaxed);
+    m_entry->wokeAtNs.store(steadyNs(), std::memory_order_relaxed);
+}
+
+void
+ThreadRegistry::Scope::idle()
+{
+    // Once per wake(), so a loop may call it before each wait, timeouts included
+    const int64_t wokeAt = m_entry->wokeAtNs.exchange(0, std::memory_order_relaxed);
+    if (wokeAt != 0)
+    {
+        m_entry->lastIterationNs.store(steadyNs() - wokeAt, std::memory_order_relaxed);
+    }
+}
+
+nlohmann::json
+ThreadRegistry::toJson() const
+{
+    std::vector<std::pair<int64_t, nlohmann::json>> threads;
+    {
+        std::lock_guard lock(m_mutex);
+        threads.reserve(m_threads.size());
+        for (const auto& [key, entry] : m_threads)
+        {
+            timespec cpu{};
+            clock_gettime(entry->clock, &cpu);
+            const int64_t cpuNs = cpu.tv_sec * 1000000000LL + cpu.tv_nsec;
+            threads.emplace_back(
+                cpuNs,
+                nlohmann::json{
+                    {"name", entry->name},
+                    {"tid", entry->tid},
+                    {"cpus", entry->cpus},
+                    {"cpu_ms", cpuNs / 1000000},
+                    {"wakeups", entry->wakeups.load(std::memory_order_relaxed)},
+                    {"last_iteration_us",
+                     entry->lastIterationNs.load(std::memory_order_relaxed) / 1000}});
+        }
+    }
+    std::sort(threads.begin(),
+              threads.end(),
+              [](const auto& a, const auto& b) { return a.first > b.first; });
+    nlohmann::json out = nlohmann::json::array();
+    for (auto& [cpuNs, thread] : threads)
+    {
+        out.push_back(std::move(thread));
+    }
+    return out;
+}
+
+} // namespace utils
@@ -0,0 +1,253 @@
+#include "utils/Tracing.hpp"
+#include "utils/Metrics.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+
+namespace utils
+{
+
+namespace
+{
+
+int64_t
+nanoseconds(Tracer::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+std::string
+hex64(uint64_t value)
+{
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+    return buffer;
+}
+
+// OTLP/JSON attributes ([{"key", "value": {"stringValue"|"intValue"|...}}]) of a flat object
+nlohmann::json
+otlpAttributes(const nlohmann::json& attributes)
+{
+    nlohmann::json out = nlohmann::json::array();
+    if (!attributes.is_object())
+    {
+        return out;
+    }
+    for (const auto& [key, value] : attributes.items())
+    {
+        nlohmann::json typed;
+        if (value.is_boolean())
+        {
+            typed["boolValue"] = value.get<bool>();
+        }
+        else if (value.is_number_integer())
+        {
+            // 64-bit integers are strings in OTLP/JSON
+            typed["intValue"] = value.dump();
+        }
+        else if (value.is_number())
+        {
+            typed["doubleValue"] = value.get<double>();
+        }
+        else if (value.is_string())
+        {
+            typed["stringValue"] = value.get<std::string>();
+        }
+        else
+        {
+            typed["stringValue"] = value.dump();
+        }
+        out.push_back({{"key", key}, {"value", std::move(typed)}});
+    }
+    return out;
+}
+
+} // namespace
+
+std::string
+TraceId::toHex() const
+{
+    return hex64(high) + hex64(low);
+}
+
+std::optional<TraceId>
+TraceId::fromHex(std::string_view hex)
+{
+    TraceId id;
+    if (hex.size() != 32)
+    {
+        return std::nullopt;
+    }
+    auto parse = [](std::string_view half, uint64_t& out) {
+        auto [ptr, ec] = std::from_chars(half.data(), half.data() + half.size(), out, 16);
+        return ec == std::errc() && ptr == half.data() + half.size();
+    };
+    if (!parse(hex.substr(0, 16), id.high) || !parse(hex.substr(16), id.low) || !id)
+    {
+        return std::nullopt;
+    }
+    return id;
+}
+
+Tracer&
+Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer()
+    : m_unixOffsetNs(nanoseconds(std::chrono::system_clock::now().time_since_epoch()) -
+                     nanoseconds(Clock::now().time_since_epoch())),
+      m_random(std::random_device{}())
+{
+}
+
+uint64_t
+Tracer::randomNoLock()
+{
+    uint64_t value = 0;
+    while (value == 0)
+    {
+        value = m_random();
+    }
+    return value;
+}
+
+Tracer::Trace*
+Tracer::findNoLock(TraceId id)
+{
+    // Newest first: the traces still being worked on are the recent ones
+    for (auto it = m_traces.rbegin(); it != m_traces.rend(); ++it)
+    {
+        if (it->id == id)
+        {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+TraceId
+Tracer::begin(std::string name, Clock::time_point start, nlohmann::json attributes)
+{
+    std::lock_guard lock(m_mutex);
+    Trace trace;
+    trace.id = TraceId{randomNoLock(), randomNoLock()};
+    trace.root = Span{std::move(name), randomNoLock(), start, start, std::move(attributes)};
+    m_traces.push_back(std::move(trace));
+    if (m_traces.size() > TRACE_KEEP_MAX)
+    {
+        m_traces.pop_front();
+    }
+    return m_traces.back().id;
+}
+
+void
+Tracer::span(TraceId trace,
+             std::string_view stage,
+             Clock::time_point start,
+             Clock::time_point end,
+             nlohmann::json attributes)
+{
+    if (!trace)
+    {
+        return;
+    }
+    MetricsRegistry::instance()
+        .histogram("ndt_failover_stage_seconds",
+                   "Time spent in each stage of a traced failover",
+                   MetricsRegistry::label("stage", stage))
+        .observe(end - start);
+
+    std::lock_guard lock(m_mutex);
+    Trace* kept = findNoLock(trace);
+    if (kept == nullptr)
+    {
+        return;
+    }
+    kept->root.end = std::max(kept->root.end, end);
+    if (kept->spans.size() < TRACE_SPANS_MAX)
+    {
+        kept->spans.push_back(
+            Span{std::string(stage), randomNoLock(), start, end, std::move(attributes)});
+    }
+}
+
+void
+Tracer::complete(TraceId trace, Clock::time_point end)
+{
+    if (!trace)
+    {
+        return;
+    }
+    std::lock_guard lock(m_mutex);
+    Trace* kept = findNoLock(trace);
+    if (kept == nullptr)
+    {
+        return;
+    }
+    kept->root.end = std::max(kept->root.end, end);
+    MetricsRegistry::instance()
+        .histogram("ndt_failover_seconds",
+                   "Time from a link failure until a flow batch rerouting around it was applied")
+        .observe(end - kept->root.start);
+}
+
+TraceId
+Tracer::recent(Clock::duration window) const
+{
+    std::lock_guard lock(m_mutex);
+    if (m_traces.empty() || Clock::now() - m_traces.back().root.start > window)
+    {
+        return TraceId{};
+    }
+    return m_traces.back().id;
+}
+
+nlohmann::json
+Tracer::toOtlpJson(size_t limit) const
+{
+    auto unixNs = [this](Clock::time_point at) {
+        return std::to_string(m_unixOffsetNs + nanoseconds(at.time_since_epoch()));
+    };
+    auto toJson = [&](const Span& span, const std::string& traceId, uint64_t parent) {
+        nlohmann::json out{{"traceId", traceId},
+                           {"spanId", hex64(span.id)},
+                           {"name", span.name},
+                           {"kind", 1}, // SPAN_KIND_INTERNAL
+                           {"startTimeUnixNano", unixNs(span.start)},
+                           {"endTimeUnixNano", unixNs(span.end)},
+                           {"attributes", otlpAttributes(span.attributes)}};
+        if (parent != 0)
+        {
+            out["parentSpanId"] = hex64(parent);
+        }
+        return out;
+    };
+
+    nlohmann::json spans = nlohmann::json::array();
+    {
+        std::lock_guard lock(m_mutex);
+        size_t n = 0;
+        for (auto it = m_traces.rbegin(); it != m_traces.rend() && n < limit; ++it, ++n)
+        {
+            const std::string traceId = it->id.toHex();
+            spans.push_back(toJson(it->root, traceId, 0));
+            for (const Span& span : it->spans)
+            {
+                spans.push_back(toJson(span, traceId, it->root.id));
+            }
+        }
+    }
+    nlohmann::json resource{
+        {"attributes", otlpAttributes(nlohmann::json{{"service.name", "ndt"}})}};
+    nlohmann::json scope{{"scope", {{"name", "ndt.failover"}}}, {"spans", std::move(spans)}};
+    return nlohmann::json{
+        {"resourceSpans",
+         nlohmann::json::array(
+             {{{"resource", std::move(resource)},
+               {"scopeSpans", nlohmann::json::array({std::move(scope)})}}})}};
+}
+
+} // namespace utils